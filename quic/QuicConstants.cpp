@@ -16,6 +16,8 @@ folly::StringPiece congestionControlTypeToString(CongestionControlType type) {
       return kCongestionControlCubicStr;
     case CongestionControlType::BBR:
       return kCongestionControlBbrStr;
+    case CongestionControlType::BBR2:
+      return kCongestionControlBbr2Str;
     case CongestionControlType::Copa:
       return kCongestionControlCopaStr;
     case CongestionControlType::NewReno:
@@ -33,6 +35,8 @@ folly::Optional<CongestionControlType> congestionControlStrToType(
     return quic::CongestionControlType::Cubic;
   } else if (str == kCongestionControlBbrStr) {
     return quic::CongestionControlType::BBR;
+  } else if (str == kCongestionControlBbr2Str) {
+    return quic::CongestionControlType::BBR2;
   } else if (str == kCongestionControlCopaStr) {
     return quic::CongestionControlType::Copa;
   } else if (str == kCongestionControlNewRenoStr) {
@@ -53,6 +57,10 @@ QuicBatchingMode getQuicBatchingMode(uint32_t val) {
       return QuicBatchingMode::BATCHING_MODE_SENDMMSG;
     case static_cast<uint32_t>(QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO):
       return QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO;
+    case static_cast<uint32_t>(QuicBatchingMode::BATCHING_MODE_IO_URING):
+      return QuicBatchingMode::BATCHING_MODE_IO_URING;
+    case static_cast<uint32_t>(QuicBatchingMode::BATCHING_MODE_AUTO):
+      return QuicBatchingMode::BATCHING_MODE_AUTO;
       // no default
   }
 
@@ -97,6 +105,10 @@ folly::StringPiece writeDataReasonString(WriteDataReason reason) {
       return "Reset";
     case WriteDataReason::PATHCHALLENGE:
       return "PathChallenge";
+    case WriteDataReason::DATAGRAM:
+      return "Datagram";
+    case WriteDataReason::PMTU_PROBE:
+      return "PmtuProbe";
     case WriteDataReason::NO_WRITE:
       return "NoWrite";
   }
@@ -47,6 +47,17 @@ constexpr uint16_t kDefaultMsgSizeBackOffSize = 50;
 // larger than this, unless configured otherwise.
 constexpr uint16_t kDefaultUDPReadBufferSize = 1500;
 
+// Room the pooled packet buffers leave past the packet size for the header
+// and the cipher overhead.
+constexpr uint16_t kPacketBufferPoolHeadroom = 64;
+
+// Stream writes of at most this many bytes are copied into the write buffer
+// when small writes are packed, larger ones are chained.
+constexpr size_t kDefaultPackedStreamWriteMaxLength = 512;
+// Size of the pages small stream writes are packed into, each holds about a
+// dozen packets of stream data.
+constexpr size_t kDefaultPackedStreamWritePageSize = 16 * 1024;
+
 constexpr uint16_t kMaxNumCoalescedPackets = 5;
 // As per version 20 of the spec, transport parameters for private use must
 // have ids with first byte being 0xff.
@@ -97,6 +108,12 @@ enum class FrameType : uint8_t {
   // CONNECTION_CLOSE_APP_ERR frametype is use to indicate application errors
   CONNECTION_CLOSE_APP_ERR = 0x1D,
   HANDSHAKE_DONE = 0x1E,
+  // DATAGRAM frames of RFC 9221, the second one with a length field.
+  DATAGRAM = 0x30,
+  DATAGRAM_LEN = 0x31,
+  IMMEDIATE_ACK = 0xAC, // subject to change
+  ACK_FREQUENCY = 0xAF, // subject to change
+  STREAM_REPAIR = 0xFC, // experimental
   MIN_STREAM_DATA = 0xFE, // subject to change
   EXPIRED_STREAM_DATA = 0xFF, // subject to change
 };
@@ -174,6 +191,7 @@ enum class LocalErrorCode : uint32_t {
   STREAM_LIMIT_EXCEEDED = 0x40000018,
   CONNECTION_ABANDONED = 0x40000019,
   CALLBACK_ALREADY_INSTALLED = 0x4000001A,
+  CONNECTION_HANDED_OFF = 0x4000001B,
 };
 
 enum class QuicNodeType : bool {
@@ -197,6 +215,18 @@ using TransportPartialReliabilitySetting = bool;
 
 constexpr uint16_t kPartialReliabilityParameterId = 0xFF00; // subject to change
 
+// min_ack_delay, advertised by endpoints that take ACK_FREQUENCY frames.
+constexpr uint16_t kMinAckDelayParameterId = 0xDE1A; // subject to change
+
+// max_datagram_frame_size of RFC 9221, advertised by endpoints that take
+// DATAGRAM frames.
+constexpr uint16_t kMaxDatagramFrameSizeParameterId = 0x0020;
+
+// Bytes of read stream data kept for undoing STREAM_REPAIR frames, advertised
+// by endpoints that take them.
+constexpr uint16_t kStreamRepairReceiveWindowParameterId =
+    0xFEC0; // experimental
+
 constexpr uint32_t kDrainFactor = 3;
 
 // batching mode
@@ -205,6 +235,12 @@ enum class QuicBatchingMode : uint32_t {
   BATCHING_MODE_GSO = 1,
   BATCHING_MODE_SENDMMSG = 2,
   BATCHING_MODE_SENDMMSG_GSO = 3,
+  // packets are submitted as sendmsg operations on an io_uring, falls back to
+  // BATCHING_MODE_SENDMMSG when io_uring is not available
+  BATCHING_MODE_IO_URING = 4,
+  // the best the socket supports, BATCHING_MODE_SENDMMSG_GSO with GSO and
+  // BATCHING_MODE_SENDMMSG without
+  BATCHING_MODE_AUTO = 5,
 };
 
 QuicBatchingMode getQuicBatchingMode(uint32_t val);
@@ -213,6 +249,29 @@ QuicBatchingMode getQuicBatchingMode(uint32_t val);
 // by BATCHING_MODE_GSO
 constexpr uint32_t kDefaultQuicMaxBatchSize = 16;
 
+// Largest batch picked by adaptiveWriteBatchSize, this is also the most
+// segments the kernel takes in a single GSO send.
+constexpr uint32_t kMaxAdaptiveWriteBatchSize = 64;
+
+// Smallest batch sent with MSG_ZEROCOPY, below this pinning the pages and
+// handling the completion costs more than copying the data.
+constexpr size_t kMinZeroCopySendSize = 16 * 1024;
+
+// Size of the read buffers with UDP_GRO, a coalesced datagram can be as large
+// as the biggest UDP datagram.
+constexpr size_t kGROReadBufferSize = 65535;
+
+// ECN codepoints, the two low bits of the IP TOS or traffic class byte.
+constexpr uint8_t kEcnMask = 0x03;
+constexpr uint8_t kEcnNotEct = 0x00;
+constexpr uint8_t kEcnEct1 = 0x01;
+constexpr uint8_t kEcnEct0 = 0x02;
+constexpr uint8_t kEcnCe = 0x03;
+
+// Default number of packets of not yet created connections a server worker
+// queues when it limits the connections created per loop.
+constexpr size_t kDefaultMaxAcceptQueueSize = 1024;
+
 // rfc6298:
 constexpr int kRttAlpha = 8;
 constexpr int kRttBeta = 4;
@@ -232,6 +291,16 @@ constexpr uint32_t kReorderingThreshold = 3;
 constexpr DurationRep kDefaultTimeReorderingThreshDividend = 5;
 constexpr DurationRep kDefaultTimeReorderingThreshDivisor = 4;
 
+// The RACK reordering window grows in steps of a quarter of the min rtt, every
+// ack that shows reordering adds a step, up to this many of them. It never
+// exceeds the srtt.
+constexpr DurationRep kRackReorderWindowDivisor = 4;
+constexpr uint16_t kRackMaxReorderWindowMultiplier = 16;
+
+// Number of lost packets per packet number space that are remembered to tell
+// apart a spurious loss when one of them is acked.
+constexpr size_t kMaxRecentlyLostPackets = 64;
+
 constexpr auto kPacketToSendForPTO = 2;
 
 // Maximum number of packets to write per writeConnectionDataToSocket call.
@@ -243,18 +312,35 @@ constexpr uint64_t kDefaultMinBurstPackets = 5;
 // but the notifications can get delayed if the event loop is busy
 // this is subject to testing but I would suggest a value >= 200usec
 constexpr std::chrono::microseconds kDefaultPacingTimerTickInterval{1000};
+// Default interval a PacingAccuracyObserver reports the send rate over
+constexpr std::chrono::milliseconds kDefaultPacingObserverInterval{200};
+
+// How often a server worker reports what its stats counters counted.
+constexpr std::chrono::milliseconds kDefaultStatsCountersInterval{1000};
+// How many loopers a shared looper queue runs per loop iteration by default
+constexpr uint32_t kDefaultMaxLooperRunsPerLoop = 4096;
+// Number of priority classes the deferred writes of a worker are served in
+constexpr uint8_t kDeferredWritePriorityClasses = 4;
 // Fraction of RTT that is used to limit how long a write function can loop
 constexpr DurationRep kDefaultWriteLimitRttFraction = 25;
 
 // Congestion control:
 constexpr folly::StringPiece kCongestionControlCubicStr = "cubic";
 constexpr folly::StringPiece kCongestionControlBbrStr = "bbr";
+constexpr folly::StringPiece kCongestionControlBbr2Str = "bbr2";
 constexpr folly::StringPiece kCongestionControlCopaStr = "copa";
 constexpr folly::StringPiece kCongestionControlNewRenoStr = "newreno";
 constexpr folly::StringPiece kCongestionControlNoneStr = "none";
 
 constexpr DurationRep kPersistentCongestionThreshold = 3;
-enum class CongestionControlType : uint8_t { Cubic, NewReno, Copa, BBR, None };
+enum class CongestionControlType : uint8_t {
+  Cubic,
+  NewReno,
+  Copa,
+  BBR,
+  BBR2,
+  None
+};
 folly::StringPiece congestionControlTypeToString(CongestionControlType type);
 folly::Optional<CongestionControlType> congestionControlStrToType(
     folly::StringPiece str);
@@ -307,12 +393,32 @@ constexpr float kCubicTCPFriendlyEstimateIncreaseFactor =
 // Default flow control window for HTTP/2 + 1K for headers
 constexpr uint64_t kDefaultStreamWindowSize = (64 + 1) * 1024;
 constexpr uint64_t kDefaultConnectionWindowSize = 1024 * 1024;
+// How large auto tuned receive windows can grow by default
+constexpr uint64_t kDefaultMaxAutoTunedStreamWindowSize = 16 * 1024 * 1024;
+constexpr uint64_t kDefaultMaxAutoTunedConnectionWindowSize = 24 * 1024 * 1024;
+// How large auto tuned stream limits can grow by default
+constexpr uint64_t kDefaultMaxAutoTunedStreamLimit = 16 * 1024;
+// An auto tuned stream window grows the connection window to at least this
+// many times its size, so that the connection doesn't block the stream.
+constexpr double kAutoTunedConnectionToStreamWindowRatio = 1.5;
+// The smallest receive window the receive buffer limit of a worker shrinks
+// windows to, so that connections keep making progress.
+constexpr uint64_t kMinBufferLimitedWindowSize = 16 * 1024;
+// A coalesced stream window update goes out right away once the peer has less
+// than 1 / kUrgentWindowUpdateDivisor of the stream window left to send.
+constexpr uint64_t kUrgentWindowUpdateDivisor = 4;
+// Bytes of a packet coalesced stream window updates that aren't urgent can
+// take by default, about a dozen MAX_STREAM_DATA frames.
+constexpr uint32_t kDefaultMaxCoalescedWindowUpdateBytes = 128;
 
 /* Stream Limits */
 constexpr uint64_t kDefaultMaxStreamsBidirectional = 2048;
 constexpr uint64_t kDefaultMaxStreamsUnidirectional = 2048;
 constexpr uint64_t kMaxStreamId = 1ull << 62;
 constexpr uint64_t kMaxMaxStreams = 1ull << 60;
+// App writes of a stream whose latencies are tracked at a time, the writes
+// past that aren't sampled.
+constexpr size_t kMaxStreamWriteLatencySamples = 32;
 
 /* Idle timeout parameters */
 // Default idle timeout to advertise.
@@ -344,9 +450,56 @@ constexpr uint16_t kDefaultRxPacketsBeforeAckAfterInit = 10;
 constexpr double kAckTimerFactor = 0.25;
 // max ack timeout: 25ms
 constexpr std::chrono::microseconds kMaxAckTimeout = 25000us;
+// Smallest ack delay we can do, advertised as min_ack_delay.
+constexpr std::chrono::microseconds kMinAckDelay = 1000us;
+
+/* ACK_FREQUENCY */
+// Acks to ask the peer for per congestion window.
+constexpr uint64_t kAckFrequencyAcksPerCwnd = 4;
+// Largest packet tolerance we ask the peer for or follow.
+constexpr uint64_t kMaxAckFrequencyPacketTolerance = 256;
+
+/* DATAGRAM */
+// Largest DATAGRAM frame we advertise taking when datagrams are enabled.
+constexpr uint16_t kMaxDatagramFrameSize = 65535;
+// Datagrams the send and receive queues hold before dropping the oldest.
+constexpr uint32_t kDefaultMaxDatagramsBuffered = 75;
+// Datagrams can take whole packets from the stream data
+constexpr uint8_t kDefaultDatagramWriteSharePercent = 100;
+
+/* STREAM_REPAIR */
+// Stream frames one STREAM_REPAIR frame covers by default.
+constexpr uint32_t kDefaultStreamRepairMaxFrames = 4;
+// Most ranges a STREAM_REPAIR frame we take may cover.
+constexpr uint64_t kMaxStreamRepairFrames = 32;
+// Room left in a packet for the header, the frame fields and the aead tag
+// next to the repair data.
+constexpr uint64_t kStreamRepairPacketOverhead = 128;
+
+/* Path MTU discovery */
+// Largest packet probed for by default, what an ethernet MTU of 1500 leaves
+// for the UDP payload over IPv6.
+constexpr uint16_t kDefaultMaxPmtuProbeSize = 1452;
+// The search stops once the packet size is known this closely.
+constexpr uint16_t kPmtuSearchResolution = 16;
+// Losses of a probe size before it is taken as too large for the path
+constexpr uint8_t kMaxPmtuProbeLosses = 3;
+
+/* Jumbo frames */
+// What a 9000 byte MTU leaves for the UDP payload over IPv6
+constexpr uint16_t kJumboFrameUDPPayload = 8952;
+// A default stream window is only a handful of jumbo packets.
+constexpr uint64_t kJumboFrameStreamWindowSize = 1024 * 1024;
+constexpr uint64_t kJumboFrameConnectionWindowSize = 16 * 1024 * 1024;
 
 constexpr uint64_t kAckPurgingThresh = 10;
 
+// Most ACK ranges kept per packet number space. ACKs of our ACKs purge the
+// ranges as they go, this bounds them when those don't come, e.g. under heavy
+// loss or reordering. More than fit in the ACK frame of a full size packet
+// once the gaps are a few packets long.
+constexpr size_t kMaxReceivedAckBlocks = 256;
+
 // Default number of packets to buffer if keys are not present.
 constexpr uint32_t kDefaultMaxBufferedPackets = 20;
 
@@ -382,6 +535,17 @@ constexpr std::chrono::milliseconds kHappyEyeballsV4Delay = 100ms;
 constexpr std::chrono::milliseconds kHappyEyeballsConnAttemptDelayWithCache =
     15s;
 
+// Between the attempts after the second one, the Connection Attempt Delay
+// RFC 8305 recommends.
+constexpr std::chrono::milliseconds kHappyEyeballsNextAttemptDelay = 250ms;
+
+// Number of hosts a BasicQuicHappyEyeballsCache keeps the winner of.
+constexpr size_t kDefaultHappyEyeballsCacheSize = 1000;
+
+// Cached winners older than this are raced again, the networks of a client
+// change too often for them to be trusted longer.
+constexpr std::chrono::minutes kHappyEyeballsCacheMaxAge = 10min;
+
 constexpr size_t kMaxNumTokenSourceAddresses = 3;
 
 // Amount of time to retain zero rtt keys until they are dropped after handshake
@@ -390,12 +554,48 @@ constexpr std::chrono::seconds kTimeToRetainZeroRttKeys = 20s;
 
 constexpr std::chrono::seconds kTimeToRetainLastCongestionAndRttState = 60s;
 
+// Caps on where a connection starts from the congestion state an earlier
+// connection to the same peer cached.
+constexpr uint64_t kDefaultWarmStartMaxCwndInMss = 200;
+constexpr std::chrono::seconds kDefaultWarmStartMaxAge = 1h;
+// Number of peers a BasicCongestionStateCache keeps the state of.
+constexpr size_t kDefaultCongestionStateCacheSize = 10000;
+// Number of congestion control groups a registry holds before it first
+// sweeps out the ones without members.
+constexpr size_t kMinCongestionControlGroupSweepThreshold = 64;
+// Number of connections a worker snapshots at a time for the server's
+// connection snapshots, before it goes back to its loop.
+constexpr size_t kConnectionSnapshotBatchSize = 64;
+// How long a client trusts a cert chain it verified before, without
+// verifying it again.
+constexpr std::chrono::seconds kDefaultCertVerificationCacheLifetime = 1h;
+
 constexpr uint32_t kMaxNumMigrationsAllowed = 6;
 
 constexpr auto kExpectedNumOfParamsInTheTicket = 8;
 
 constexpr auto kStatelessResetTokenSecretLength = 32;
 
+// Length of the MAC that authenticates a Retry token
+constexpr size_t kRetryTokenTagLength = 16;
+// How long a Retry token stays valid after the server issued it
+constexpr std::chrono::seconds kRetryTokenLifetime{10};
+// The window over which a worker counts its handshakes to decide whether new
+// connections have to Retry first
+constexpr std::chrono::seconds kHandshakeAdmissionWindow{1};
+// The loop time over which a worker's OverloadController measures its load
+constexpr std::chrono::milliseconds kOverloadSampleWindow{100};
+// How far below the threshold of a level the load drops before it is left
+constexpr double kOverloadHysteresis = 0.1;
+// Lag a single loop of a worker can add before the worker is fully loaded
+constexpr std::chrono::microseconds kDefaultOverloadMaxLoopLag{50000};
+// What the initial windows of new connections are divided by under load
+constexpr uint64_t kOverloadWindowDivisor = 4;
+// The window over which a worker counts the stateless resets it sends
+constexpr std::chrono::seconds kStatelessResetRateLimitWindow{1};
+// The window over which a worker counts the version negotiations it sends
+constexpr std::chrono::seconds kVersionNegotiationRateLimitWindow{1};
+
 constexpr uint64_t kDefaultActiveConnectionIdLimit = 7;
 
 // default capability of QUIC partial reliability
@@ -448,6 +648,8 @@ enum class WriteDataReason {
   SIMPLE,
   RESET,
   PATHCHALLENGE,
+  DATAGRAM,
+  PMTU_PROBE,
 };
 
 enum class NoWriteReason {
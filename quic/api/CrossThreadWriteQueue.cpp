@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/CrossThreadWriteQueue.h>
+
+#include <quic/api/QuicTransportBase.h>
+
+namespace quic {
+
+CrossThreadWriteQueue::CrossThreadWriteQueue(
+    size_t capacity,
+    folly::EventBase* evb,
+    std::weak_ptr<QuicTransportBase> transport)
+    : queue_(std::max<size_t>(capacity, 1)),
+      evb_(evb),
+      transport_(std::move(transport)) {}
+
+bool CrossThreadWriteQueue::submit(
+    StreamId id,
+    Buf& data,
+    bool eof,
+    QuicSocket::DeliveryCallback* cb) {
+  Write write;
+  write.id = id;
+  write.data = std::move(data);
+  write.eof = eof;
+  write.cb = cb;
+  if (!queue_.write(std::move(write))) {
+    data = std::move(write.data);
+    return false;
+  }
+  if (!drainScheduled_.exchange(true, std::memory_order_acq_rel)) {
+    auto evb = evb_.load(std::memory_order_acquire);
+    if (evb) {
+      scheduleDrain(evb);
+    } else {
+      // setEventBase schedules the drain on the next event base.
+      drainScheduled_.store(false, std::memory_order_release);
+    }
+  }
+  return true;
+}
+
+void CrossThreadWriteQueue::setEventBase(folly::EventBase* evb) {
+  evb_.store(evb, std::memory_order_release);
+  if (evb && !queue_.isEmpty() &&
+      !drainScheduled_.exchange(true, std::memory_order_acq_rel)) {
+    scheduleDrain(evb);
+  }
+}
+
+void CrossThreadWriteQueue::scheduleDrain(folly::EventBase* evb) {
+  evb->runInEventBaseThread(
+      [self = shared_from_this(), evb] { self->drain(evb); });
+}
+
+void CrossThreadWriteQueue::drain(folly::EventBase* evb) {
+  // Cleared first, so a write submitted while draining schedules another.
+  drainScheduled_.store(false, std::memory_order_release);
+  auto current = evb_.load(std::memory_order_acquire);
+  if (current != evb) {
+    // The transport moved on, the writes are drained where it is now.
+    if (current && !queue_.isEmpty() &&
+        !drainScheduled_.exchange(true, std::memory_order_acq_rel)) {
+      scheduleDrain(current);
+    }
+    return;
+  }
+  auto transport = transport_.lock();
+  if (!transport) {
+    return;
+  }
+  std::vector<QuicSocket::StreamWrite> writes;
+  Write write;
+  while (queue_.read(write)) {
+    writes.emplace_back(write.id, std::move(write.data), write.eof, write.cb);
+  }
+  if (writes.empty()) {
+    return;
+  }
+  auto results = transport->writeChains(std::move(writes), false);
+  for (const auto& result : results) {
+    if (result.hasError()) {
+      VLOG(4) << "Dropping cross thread write, error="
+              << toString(result.error()) << " " << *transport;
+    }
+  }
+}
+
+} // namespace quic
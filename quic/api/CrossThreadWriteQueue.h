@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/MPMCQueue.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/api/QuicSocket.h>
+
+#include <atomic>
+#include <memory>
+
+namespace quic {
+
+class QuicTransportBase;
+
+/**
+ * The writes to a transport submitted from threads other than its event
+ * base's, see QuicSocket::getCrossThreadWriteQueue. Submitting doesn't take
+ * a lock, only a bounded lock free queue, and the first write of a batch
+ * wakes up the event base, which then writes everything queued by then with
+ * QuicSocket::writeChains.
+ *
+ * The writes of a connection that closed in the meantime are dropped. The
+ * delivery callbacks of the writes are called on the event base's thread.
+ */
+class CrossThreadWriteQueue
+    : public std::enable_shared_from_this<CrossThreadWriteQueue> {
+ public:
+  CrossThreadWriteQueue(
+      size_t capacity,
+      folly::EventBase* evb,
+      std::weak_ptr<QuicTransportBase> transport);
+
+  /**
+   * Submits a write from any thread. Returns false, and leaves data with the
+   * caller, if the queue is full.
+   */
+  bool submit(
+      StreamId id,
+      Buf& data,
+      bool eof,
+      QuicSocket::DeliveryCallback* cb = nullptr);
+
+  size_t capacity() const {
+    return queue_.capacity();
+  }
+
+  /**
+   * Follows the transport to another event base, or none while it is
+   * detached. Only called on the transport's event base.
+   */
+  void setEventBase(folly::EventBase* evb);
+
+ private:
+  struct Write {
+    StreamId id{0};
+    Buf data;
+    bool eof{false};
+    QuicSocket::DeliveryCallback* cb{nullptr};
+  };
+
+  void scheduleDrain(folly::EventBase* evb);
+  void drain(folly::EventBase* evb);
+
+  folly::MPMCQueue<Write> queue_;
+  std::atomic<folly::EventBase*> evb_;
+  // whether a drain is scheduled on the event base, so that the writes after
+  // the first one of a batch don't wake it up again
+  std::atomic<bool> drainScheduled_{false};
+  std::weak_ptr<QuicTransportBase> transport_;
+};
+
+} // namespace quic
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/DeferredWriteScheduler.h>
+
+#include <quic/api/QuicBatchWriter.h>
+#include <quic/api/QuicTransportBase.h>
+
+#include <algorithm>
+
+namespace quic {
+
+DeferredWriteScheduler::DeferredWriteScheduler(folly::EventBase* evb)
+    : evb_(evb) {}
+
+void DeferredWriteScheduler::setMultiDestBatchWriter(
+    std::shared_ptr<MultiDestBatchWriter> writer) {
+  multiDestWriter_ = std::move(writer);
+}
+
+void DeferredWriteScheduler::setBudgets(
+    uint64_t quantum,
+    uint64_t loopBytesBudget,
+    std::chrono::microseconds loopTimeBudget) {
+  quantum_ = quantum;
+  loopBytesBudget_ = loopBytesBudget;
+  loopTimeBudget_ = loopTimeBudget;
+  if (!quantum_) {
+    deficits_.clear();
+  }
+}
+
+void DeferredWriteScheduler::scheduleWrite(QuicTransportBase* transport) {
+  CHECK(transport);
+  if (pending_.insert(transport).second) {
+    auto priority = std::min<uint8_t>(
+        transport->getTransportSettings().deferredWritePriority,
+        kDeferredWritePriorityClasses - 1);
+    queues_[priority].push_back(transport);
+  }
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+}
+
+void DeferredWriteScheduler::cancelWrite(QuicTransportBase* transport) {
+  if (pending_.erase(transport)) {
+    for (auto& queue : queues_) {
+      std::replace(queue.begin(), queue.end(), transport, nullptr);
+    }
+  }
+  deficits_.erase(transport);
+  if (pending_.empty() && isLoopCallbackScheduled()) {
+    cancelLoopCallback();
+  }
+}
+
+bool DeferredWriteScheduler::isWriteScheduled(
+    QuicTransportBase* transport) const {
+  return pending_.count(transport) > 0;
+}
+
+size_t DeferredWriteScheduler::numScheduled() const {
+  return pending_.size();
+}
+
+int64_t DeferredWriteScheduler::getDeficit(
+    QuicTransportBase* transport) const {
+  auto it = deficits_.find(transport);
+  return it == deficits_.end() ? 0 : it->second;
+}
+
+uint64_t DeferredWriteScheduler::runWrite(
+    std::deque<QuicTransportBase*>& queue) {
+  auto transport = queue.front();
+  queue.pop_front();
+  if (!transport) {
+    return 0;
+  }
+  folly::Optional<uint64_t> maxBytes;
+  if (quantum_) {
+    auto& deficit = deficits_[transport];
+    deficit += static_cast<int64_t>(quantum_);
+    if (deficit <= 0) {
+      // Still paying off what it wrote over its deficit in an earlier turn.
+      queue.push_back(transport);
+      return 0;
+    }
+    maxBytes = deficit;
+  }
+  pending_.erase(transport);
+  // A write may close, and cancel, any of the other transports, and has the
+  // transport schedule again if it has more to write.
+  auto bytesWritten = transport->writeDeferredData(maxBytes);
+  if (quantum_) {
+    if (pending_.count(transport)) {
+      deficits_[transport] -= static_cast<int64_t>(bytesWritten);
+    } else {
+      // Flows without data don't get to save up.
+      deficits_.erase(transport);
+    }
+  }
+  return bytesWritten;
+}
+
+void DeferredWriteScheduler::runLoopCallback() noexcept {
+  auto start = Clock::now();
+  uint64_t bytesWritten = 0;
+  bool withinBudget = true;
+  for (auto& queue : queues_) {
+    // The transports that schedule again while writing wait for the next
+    // iteration.
+    for (auto turns = queue.size(); turns > 0 && withinBudget; turns--) {
+      bytesWritten += runWrite(queue);
+      withinBudget = (!loopBytesBudget_ || bytesWritten < loopBytesBudget_) &&
+          (loopTimeBudget_.count() == 0 ||
+           Clock::now() - start < loopTimeBudget_);
+    }
+  }
+  if (!pending_.empty() && !isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+  if (multiDestWriter_) {
+    multiDestWriter_->flush();
+  }
+}
+
+} // namespace quic
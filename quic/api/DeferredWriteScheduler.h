@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/container/F14Map.h>
+#include <folly/container/F14Set.h>
+#include <folly/io/async/EventBase.h>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+
+namespace quic {
+
+class MultiDestBatchWriter;
+class QuicTransportBase;
+
+/**
+ * Runs the writes of many transports sharing an event base from a single
+ * loop callback at the end of the loop iteration, instead of each transport
+ * driving its own write looper. When a MultiDestBatchWriter is set, it is
+ * flushed right after all the transports wrote, so that the packets of every
+ * connection, ACK-only ones included, leave in as few syscalls as possible.
+ *
+ * The transports write in the order of their deferredWritePriority class,
+ * and round robin within a class. With a quantum set, a transport writes at
+ * most its deficit per round, the quantum plus what it didn't use of the
+ * previous rounds while it had data, so that bulk flows can't crowd out the
+ * small ones. A budget of bytes or time per loop iteration stops the round,
+ * and the transports that didn't get their turn go first in the next one.
+ *
+ * Transports are tracked by raw pointer; a transport must cancel its write
+ * before it goes away.
+ */
+class DeferredWriteScheduler : public folly::EventBase::LoopCallback {
+ public:
+  explicit DeferredWriteScheduler(folly::EventBase* evb);
+  ~DeferredWriteScheduler() override = default;
+
+  void setMultiDestBatchWriter(std::shared_ptr<MultiDestBatchWriter> writer);
+
+  /**
+   * The bytes a transport may write per round, and what all the writes of a
+   * loop iteration may take. 0 for no limit.
+   */
+  void setBudgets(
+      uint64_t quantum,
+      uint64_t loopBytesBudget,
+      std::chrono::microseconds loopTimeBudget);
+
+  /**
+   * Makes the transport write at the end of the current loop iteration. If
+   * this is called while the scheduled writes are running, the transport
+   * writes again in the next iteration.
+   */
+  void scheduleWrite(QuicTransportBase* transport);
+
+  void cancelWrite(QuicTransportBase* transport);
+
+  bool isWriteScheduled(QuicTransportBase* transport) const;
+
+  // number of transports waiting to write
+  size_t numScheduled() const;
+
+  // what the transport may write in its next turn beyond the quantum
+  int64_t getDeficit(QuicTransportBase* transport) const;
+
+  void runLoopCallback() noexcept override;
+
+ private:
+  /**
+   * Gives the transport at the front of the class its turn. Returns the
+   * bytes it wrote.
+   */
+  uint64_t runWrite(std::deque<QuicTransportBase*>& queue);
+
+  folly::EventBase* evb_;
+  folly::F14FastSet<QuicTransportBase*> pending_;
+  // the transports waiting in each class, in the order of their turns;
+  // cancelled ones are set to null
+  std::array<std::deque<QuicTransportBase*>, kDeferredWritePriorityClasses>
+      queues_;
+  // only tracked when there is a quantum
+  folly::F14FastMap<QuicTransportBase*, int64_t> deficits_;
+  uint64_t quantum_{0};
+  uint64_t loopBytesBudget_{0};
+  std::chrono::microseconds loopTimeBudget_{0};
+  std::shared_ptr<MultiDestBatchWriter> multiDestWriter_;
+};
+
+} // namespace quic
@@ -8,7 +8,9 @@
 
 #include <quic/api/IoBufQuicBatch.h>
 
+#include <quic/common/PipelineTiming.h>
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
+#include <quic/state/QuicStateFunctions.h>
 
 namespace quic {
 IOBufQuicBatch::IOBufQuicBatch(
@@ -21,29 +23,41 @@ IOBufQuicBatch::IOBufQuicBatch(
       sock_(sock),
       peerAddress_(peerAddress),
       conn_(conn),
-      happyEyeballsState_(happyEyeballsState) {}
+      happyEyeballsState_(happyEyeballsState) {
+  batchWriter_->setEcn(isEcnMarkingEnabled(conn_) ? kEcnEct0 : kEcnNotEct);
+}
 
 bool IOBufQuicBatch::write(
     std::unique_ptr<folly::IOBuf>&& buf,
-    size_t encodedSize) {
-  pktSent_++;
-
+    size_t encodedSize,
+    const CryptoOffloadMetadata* offloadMetadata) {
   // see if we need to flush the prev buffer(s)
   if (batchWriter_->needsFlush(encodedSize)) {
     // continue even if we get an error here
-    flush();
+    flush(QuicTransportStatsCallback::WriteFlushReason::SIZE_CHANGE);
+  }
+
+  pktSent_++;
+  pktsInBatch_++;
+
+  if (offloadMetadata) {
+    batchWriter_->addOffloadMetadata(*offloadMetadata);
   }
 
   // try to append the new buffers
   if (batchWriter_->append(std::move(buf), encodedSize)) {
     // return if we get an error here
-    return flush();
+    return flush(QuicTransportStatsCallback::WriteFlushReason::WRITER_FULL);
   }
 
   return true;
 }
 
-bool IOBufQuicBatch::flush() {
+bool IOBufQuicBatch::flush(
+    QuicTransportStatsCallback::WriteFlushReason reason) {
+  if (!batchWriter_->empty()) {
+    QUIC_STATS(conn_.infoCallback, onWriteFlush, reason);
+  }
   bool ret = flushInternal();
   reset();
 
@@ -57,6 +71,33 @@ void IOBufQuicBatch::setContinueOnNetworkUnreachable(
 
 void IOBufQuicBatch::reset() {
   batchWriter_->reset();
+  batchWriter_->clearTxTime();
+  batchWriter_->clearOffloadMetadata();
+  pktsInBatch_ = 0;
+}
+
+void IOBufQuicBatch::setTxTime() {
+  // The batch leaves right after the previous one, unless the connection
+  // has been idle since.
+  auto interval = conn_.pacer->getPacketInterval();
+  conn_.nextTxTime = std::max(Clock::now(), conn_.nextTxTime);
+  batchWriter_->setTxTime(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          conn_.nextTxTime.time_since_epoch())
+          .count(),
+      interval.count());
+  conn_.nextTxTime +=
+      std::chrono::duration_cast<Clock::duration>(interval * pktsInBatch_);
+}
+
+void IOBufQuicBatch::writeToRacingPeerAddresses(
+    folly::AsyncUDPSocket& sock,
+    const std::vector<folly::SocketAddress>& peerAddresses) {
+  // The race is decided by which address answers first, a failed write to
+  // one of them does not end it.
+  for (const auto& peerAddress : peerAddresses) {
+    batchWriter_->write(sock, peerAddress);
+  }
 }
 
 bool IOBufQuicBatch::isNetworkUnreachable(int err) {
@@ -84,22 +125,45 @@ bool IOBufQuicBatch::flushInternal() {
     return true;
   }
 
+  if (isConnectionPacedInKernel(conn_)) {
+    setTxTime();
+  }
+
+  auto numMessages = batchWriter_->numMessages();
+  auto batchSize = batchWriter_->size();
   bool written = false;
   if (happyEyeballsState_.shouldWriteToFirstSocket) {
-    auto consumed = batchWriter_->write(sock_, peerAddress_);
+    auto consumed = QUIC_PIPELINE_TIMED(
+        SocketWrite, batchWriter_->write(sock_, peerAddress_));
     written = (consumed >= 0);
+    if (written && numMessages > 0) {
+      QUIC_STATS(
+          conn_.infoCallback,
+          onWriteSyscall,
+          numMessages,
+          pktsInBatch_,
+          batchSize);
+    }
     happyEyeballsState_.shouldWriteToFirstSocket =
         (consumed >= 0 || isRetriableError(errno));
 
     if (!happyEyeballsState_.shouldWriteToFirstSocket) {
       sock_.pauseRead();
+    } else {
+      writeToRacingPeerAddresses(
+          sock_, happyEyeballsState_.firstSocketPeerAddresses);
     }
   }
 
   // If error occured on first socket, kick off second socket immediately
-  if (!written && happyEyeballsState_.connAttemptDelayTimeout &&
+  if (!written && happyEyeballsState_.secondPeerAddress.isInitialized() &&
+      !happyEyeballsState_.secondSocketStarted &&
+      happyEyeballsState_.connAttemptDelayTimeout &&
       happyEyeballsState_.connAttemptDelayTimeout->isScheduled()) {
-    happyEyeballsState_.connAttemptDelayTimeout->cancelTimeout();
+    // The timer is left for the attempts after the second one
+    if (happyEyeballsState_.pendingPeerAddresses.empty()) {
+      happyEyeballsState_.connAttemptDelayTimeout->cancelTimeout();
+    }
     happyEyeballsStartSecondSocket(happyEyeballsState_);
   }
 
@@ -117,6 +181,10 @@ bool IOBufQuicBatch::flushInternal() {
         (consumed >= 0 || isRetriableError(errno));
     if (!happyEyeballsState_.shouldWriteToSecondSocket) {
       happyEyeballsState_.secondSocket->pauseRead();
+    } else {
+      writeToRacingPeerAddresses(
+          *happyEyeballsState_.secondSocket,
+          happyEyeballsState_.secondSocketPeerAddresses);
     }
   }
 
@@ -163,6 +231,14 @@ bool IOBufQuicBatch::flushInternal() {
 
   // Reset the deadline after successful write
   conn_.continueOnNetworkUnreachableDeadline = folly::none;
+  if (conn_.statsCounters) {
+    conn_.statsCounters->add(QuicTransportStatsCounters::Counter::WriteBatches);
+    conn_.statsCounters->add(
+        QuicTransportStatsCounters::Counter::PacketsInWriteBatches,
+        pktsInBatch_);
+  } else {
+    QUIC_STATS(conn_.infoCallback, onWriteBatch, pktsInBatch_);
+  }
 
   return true; // success, not done yet
 }
@@ -23,10 +23,16 @@ class IOBufQuicBatch {
 
   ~IOBufQuicBatch() = default;
 
-  // returns true if it succeeds and false if the loop should end
-  bool write(std::unique_ptr<folly::IOBuf>&& buf, size_t encodedSize);
+  // returns true if it succeeds and false if the loop should end. The
+  // metadata is set for packets left to the writer's CryptoOffload to seal.
+  bool write(
+      std::unique_ptr<folly::IOBuf>&& buf,
+      size_t encodedSize,
+      const CryptoOffloadMetadata* offloadMetadata = nullptr);
 
-  bool flush();
+  bool flush(
+      QuicTransportStatsCallback::WriteFlushReason reason =
+          QuicTransportStatsCallback::WriteFlushReason::END_OF_WRITE);
 
   FOLLY_ALWAYS_INLINE uint64_t getPktSent() const {
     return pktSent_;
@@ -37,9 +43,17 @@ class IOBufQuicBatch {
  private:
   void reset();
 
+  // stamps the pending batch with departure times from the pacer
+  void setTxTime();
+
   // flushes the internal buffers
   bool flushInternal();
 
+  // writes the pending batch to the later attempts of a happy eyeballs race
+  void writeToRacingPeerAddresses(
+      folly::AsyncUDPSocket& sock,
+      const std::vector<folly::SocketAddress>& peerAddresses);
+
   bool isNetworkUnreachable(int err);
 
   /**
@@ -53,6 +67,8 @@ class IOBufQuicBatch {
   QuicConnectionStateBase& conn_;
   QuicConnectionStateBase::HappyEyeballsState& happyEyeballsState_;
   uint64_t pktSent_{0};
+  // packets in the batch which has not been flushed yet
+  uint64_t pktsInBatch_{0};
   bool continueOnNetworkUnreachable_{false};
 };
 
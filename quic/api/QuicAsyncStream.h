@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Portability.h>
+
+#if FOLLY_HAS_COROUTINES
+
+#include <folly/experimental/coro/Coroutine.h>
+#include <quic/api/QuicSocket.h>
+
+#include <memory>
+#include <utility>
+
+namespace quic {
+
+/**
+ * A stream of a QuicSocket for coroutines:
+ *
+ *   QuicAsyncStream stream(sock, id);
+ *   auto data = co_await stream.read();
+ *   co_await stream.write(std::move(response), true);
+ *   co_await stream.delivered(offset);
+ *
+ * The object is the stream's read, write and delivery callback for as long
+ * as it lives, and an operation that can't complete right away keeps the
+ * handle of the awaiting coroutine in it, so waiting adds no allocation to
+ * what the transport does. The transport calls these callbacks straight from
+ * its readable streams and pending write callbacks, so there is no queue in
+ * between either.
+ * One read, one write and one delivery wait can be pending at a time, and a
+ * write wait must be over before the object goes away. It is used on the
+ * transport's event base only, and the awaiting coroutine is resumed from
+ * inside the transport's callbacks.
+ *
+ * Only built with coroutine support, see FOLLY_HAS_COROUTINES.
+ */
+class QuicAsyncStream : private QuicSocket::ReadCallback,
+                        private QuicSocket::WriteCallback,
+                        private QuicSocket::DeliveryCallback {
+ public:
+  using ReadResult = folly::Expected<std::pair<Buf, bool>, LocalErrorCode>;
+  using WriteResult = QuicSocket::WriteResult;
+
+  QuicAsyncStream(std::shared_ptr<QuicSocket> sock, StreamId id)
+      : sock_(std::move(sock)), id_(id) {
+    // Fails for the streams only this side sends on. Reads are paused until
+    // a coroutine waits for them.
+    if (sock_->setReadCallback(id_, this).hasValue()) {
+      readCallbackSet_ = true;
+      sock_->pauseRead(id_);
+    }
+  }
+
+  ~QuicAsyncStream() override {
+    readWaiter_ = nullptr;
+    writeWaiter_ = nullptr;
+    deliveryWaiter_ = nullptr;
+    if (readCallbackSet_ && !eofRead_) {
+      sock_->setReadCallback(id_, nullptr);
+    }
+    sock_->cancelDeliveryCallbacksForStream(id_);
+  }
+
+  QuicAsyncStream(const QuicAsyncStream&) = delete;
+  QuicAsyncStream& operator=(const QuicAsyncStream&) = delete;
+
+  StreamId getId() const {
+    return id_;
+  }
+
+  class ReadAwaiter {
+   public:
+    ReadAwaiter(QuicAsyncStream& stream, size_t maxLen)
+        : stream_(stream), maxLen_(maxLen) {}
+
+    bool await_ready() {
+      if (stream_.readError_) {
+        result_ = folly::makeUnexpected(*stream_.readError_);
+        return true;
+      }
+      if (!stream_.readCallbackSet_) {
+        result_ = folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+        return true;
+      }
+      return tryRead();
+    }
+
+    void await_suspend(folly::coro::coroutine_handle<> waiter) {
+      stream_.readWaiter_ = waiter;
+      stream_.sock_->resumeRead(stream_.id_);
+    }
+
+    ReadResult await_resume() {
+      if (!result_) {
+        if (stream_.readError_) {
+          result_ = folly::makeUnexpected(*stream_.readError_);
+        } else {
+          tryRead();
+        }
+      }
+      return std::move(*result_);
+    }
+
+   private:
+    // whether there was something to read, the result is set if so
+    bool tryRead() {
+      auto result = stream_.sock_->read(stream_.id_, maxLen_);
+      if (result.hasValue() && !result->first && !result->second) {
+        return false;
+      }
+      if (result.hasValue() && result->second) {
+        stream_.eofRead_ = true;
+      }
+      result_ = std::move(result);
+      return true;
+    }
+
+    QuicAsyncStream& stream_;
+    size_t maxLen_;
+    folly::Optional<ReadResult> result_;
+  };
+
+  /**
+   * Reads up to maxLen bytes, 0 for all there is, waiting until there is
+   * some data or the eof. An error once the stream failed.
+   */
+  ReadAwaiter read(size_t maxLen = 0) {
+    return ReadAwaiter(*this, maxLen);
+  }
+
+  class WriteAwaiter {
+   public:
+    WriteAwaiter(QuicAsyncStream& stream, Buf data, bool eof)
+        : stream_(stream), data_(std::move(data)), eof_(eof) {}
+
+    bool await_ready() {
+      auto flowControl = stream_.sock_->getStreamFlowControl(stream_.id_);
+      return flowControl.hasError() || flowControl->sendWindowAvailable > 0;
+    }
+
+    bool await_suspend(folly::coro::coroutine_handle<> waiter) {
+      if (stream_.sock_->notifyPendingWriteOnStream(stream_.id_, &stream_)
+              .hasError()) {
+        // the write then fails the same way in await_resume
+        return false;
+      }
+      stream_.writeWaiter_ = waiter;
+      return true;
+    }
+
+    WriteResult await_resume() {
+      if (stream_.writeError_) {
+        return folly::makeUnexpected(*stream_.writeError_);
+      }
+      return stream_.sock_->writeChain(
+          stream_.id_, std::move(data_), eof_, false);
+    }
+
+   private:
+    QuicAsyncStream& stream_;
+    Buf data_;
+    bool eof_;
+  };
+
+  /**
+   * Writes data, and the eof if set, once the peer's flow control lets the
+   * stream send anything.
+   */
+  WriteAwaiter write(Buf data, bool eof = false) {
+    return WriteAwaiter(*this, std::move(data), eof);
+  }
+
+  class DeliveryAwaiter {
+   public:
+    DeliveryAwaiter(QuicAsyncStream& stream, uint64_t offset)
+        : stream_(stream), offset_(offset) {}
+
+    bool await_ready() {
+      return false;
+    }
+
+    bool await_suspend(folly::coro::coroutine_handle<> waiter) {
+      stream_.delivered_ = false;
+      stream_.deliveryWaiter_ = waiter;
+      if (stream_.sock_->registerDeliveryCallback(
+              stream_.id_, offset_, &stream_)
+              .hasError()) {
+        stream_.deliveryWaiter_ = nullptr;
+        return false;
+      }
+      return true;
+    }
+
+    bool await_resume() {
+      return stream_.delivered_;
+    }
+
+   private:
+    QuicAsyncStream& stream_;
+    uint64_t offset_;
+  };
+
+  /**
+   * Waits until the peer acknowledged the stream up to offset. False if the
+   * wait was canceled, e.g. the stream was reset.
+   */
+  DeliveryAwaiter delivered(uint64_t offset) {
+    return DeliveryAwaiter(*this, offset);
+  }
+
+ private:
+  static void resume(folly::coro::coroutine_handle<>& waiter) {
+    if (waiter) {
+      std::exchange(waiter, nullptr).resume();
+    }
+  }
+
+  // ReadCallback
+  void readAvailable(StreamId) noexcept override {
+    // paused again until the next read waits
+    sock_->pauseRead(id_);
+    resume(readWaiter_);
+  }
+
+  void readError(
+      StreamId,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    readCallbackSet_ = false;
+    readError_ = error.first.asLocalErrorCode()
+        ? *error.first.asLocalErrorCode()
+        : LocalErrorCode::STREAM_CLOSED;
+    resume(readWaiter_);
+  }
+
+  // WriteCallback
+  void onStreamWriteReady(StreamId, uint64_t) noexcept override {
+    resume(writeWaiter_);
+  }
+
+  void onStreamWriteError(
+      StreamId,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    writeError_ = error.first.asLocalErrorCode()
+        ? *error.first.asLocalErrorCode()
+        : LocalErrorCode::STREAM_CLOSED;
+    resume(writeWaiter_);
+  }
+
+  // DeliveryCallback
+  void onDeliveryAck(StreamId, uint64_t, std::chrono::microseconds) override {
+    delivered_ = true;
+    resume(deliveryWaiter_);
+  }
+
+  void onCanceled(StreamId, uint64_t) override {
+    delivered_ = false;
+    resume(deliveryWaiter_);
+  }
+
+  std::shared_ptr<QuicSocket> sock_;
+  StreamId id_;
+  bool readCallbackSet_{false};
+  bool eofRead_{false};
+  folly::Optional<LocalErrorCode> readError_;
+  folly::Optional<LocalErrorCode> writeError_;
+  bool delivered_{false};
+  folly::coro::coroutine_handle<> readWaiter_;
+  folly::coro::coroutine_handle<> writeWaiter_;
+  folly::coro::coroutine_handle<> deliveryWaiter_;
+};
+
+} // namespace quic
+
+#endif // FOLLY_HAS_COROUTINES
@@ -8,15 +8,428 @@
 
 #include <quic/api/QuicBatchWriter.h>
 
+#include <quic/common/XdpSocket.h>
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/io/async/EventHandler.h>
+#include <folly/net/NetOps.h>
+
+#if MVFST_HAVE_LIBURING
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#endif
+#ifndef SCM_TXTIME
+#define SCM_TXTIME SO_TXTIME
+#endif
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define QUIC_HAVE_ZEROCOPY 1
+#endif
+#endif
+
+namespace {
+// the kernel refuses GSO messages with more segments than this
+constexpr size_t kMaxGSOSegments = 64;
+// GSO messages still have to fit in a single UDP datagram
+constexpr size_t kMaxGSOMessageSize = 65507;
+
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+// room for a UDP_SEGMENT, an SCM_TXTIME and an IP_TOS or IPV6_TCLASS message
+struct SendControl {
+  alignas(struct cmsghdr) char
+      buf[CMSG_SPACE(sizeof(uint16_t)) + CMSG_SPACE(sizeof(uint64_t)) +
+          CMSG_SPACE(sizeof(int))];
+};
+
+/**
+ * Adds the control message setting the ECN codepoint of a message to
+ * address at cm.
+ */
+void writeEcnControl(
+    struct cmsghdr* cm,
+    const folly::SocketAddress& address,
+    uint8_t ecn) {
+  bool ipv6 = address.getFamily() == AF_INET6;
+  cm->cmsg_level = ipv6 ? IPPROTO_IPV6 : IPPROTO_IP;
+  cm->cmsg_type = ipv6 ? IPV6_TCLASS : IP_TOS;
+  cm->cmsg_len = CMSG_LEN(sizeof(int));
+  int tos = ecn;
+  memcpy(CMSG_DATA(cm), &tos, sizeof(tos));
+}
+
+// the control message with the metadata of the packets of an offloaded send
+struct OffloadControl {
+  int level;
+  int type;
+  const std::vector<quic::CryptoOffloadMetadata>& metadata;
+};
+
+/**
+ * Writes count messages to address with one sendmmsg(). gso and txTimes may
+ * be null, otherwise they hold the segment size and the departure time of
+ * each message. Every message is sent with the ECN codepoint ecn. A send for
+ * a CryptoOffload, with offload set, has to be a single message. Returns the
+ * number of messages sent.
+ */
+int sendMessages(
+    folly::NetworkSocket fd,
+    const folly::SocketAddress& address,
+    std::unique_ptr<folly::IOBuf>* bufs,
+    size_t count,
+    const int* gso,
+    const uint64_t* txTimes,
+    uint8_t ecn,
+    int flags,
+    const OffloadControl* offload = nullptr) {
+  DCHECK(!offload || count == 1);
+  struct sockaddr_storage addr;
+  socklen_t addrLen = address.getAddress(&addr);
+  size_t numIovecs = 0;
+  for (size_t i = 0; i < count; ++i) {
+    numIovecs += bufs[i]->countChainElements();
+  }
+  std::vector<struct iovec> iovecs;
+  iovecs.reserve(numIovecs);
+  std::vector<struct mmsghdr> msgs(count);
+  std::vector<SendControl> controls(count);
+  // the metadata doesn't fit in a SendControl
+  std::unique_ptr<char[]> offloadControl;
+  size_t offloadLen = offload
+      ? CMSG_SPACE(
+            offload->metadata.size() * sizeof(quic::CryptoOffloadMetadata))
+      : 0;
+  for (size_t i = 0; i < count; ++i) {
+    auto& msg = msgs[i].msg_hdr;
+    msg.msg_name = &addr;
+    msg.msg_namelen = addrLen;
+    msg.msg_iov = iovecs.data() + iovecs.size();
+    for (auto range : *bufs[i]) {
+      struct iovec iov;
+      iov.iov_base = const_cast<uint8_t*>(range.data());
+      iov.iov_len = range.size();
+      iovecs.push_back(iov);
+    }
+    msg.msg_iovlen = bufs[i]->countChainElements();
+    bool segmented = gso && gso[i] > 0;
+    size_t controlLen = (segmented ? CMSG_SPACE(sizeof(uint16_t)) : 0) +
+        (txTimes ? CMSG_SPACE(sizeof(uint64_t)) : 0) +
+        (ecn != kEcnNotEct ? CMSG_SPACE(sizeof(int)) : 0) + offloadLen;
+    if (!controlLen) {
+      continue;
+    }
+    if (offloadLen) {
+      // zeroed, CMSG_NXTHDR looks at the header after the current one
+      offloadControl.reset(new char[controlLen]());
+      msg.msg_control = offloadControl.get();
+    } else {
+      msg.msg_control = controls[i].buf;
+    }
+    msg.msg_controllen = controlLen;
+    struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    if (segmented) {
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      auto segmentSize = folly::to<uint16_t>(gso[i]);
+      memcpy(CMSG_DATA(cm), &segmentSize, sizeof(segmentSize));
+      cm = CMSG_NXTHDR(&msg, cm);
+    }
+    if (txTimes) {
+      cm->cmsg_level = SOL_SOCKET;
+      cm->cmsg_type = SCM_TXTIME;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+      memcpy(CMSG_DATA(cm), &txTimes[i], sizeof(uint64_t));
+      cm = CMSG_NXTHDR(&msg, cm);
+    }
+    if (ecn != kEcnNotEct) {
+      writeEcnControl(cm, address, ecn);
+      cm = CMSG_NXTHDR(&msg, cm);
+    }
+    if (offload) {
+      auto len =
+          offload->metadata.size() * sizeof(quic::CryptoOffloadMetadata);
+      cm->cmsg_level = offload->level;
+      cm->cmsg_type = offload->type;
+      cm->cmsg_len = CMSG_LEN(len);
+      memcpy(CMSG_DATA(cm), offload->metadata.data(), len);
+    }
+  }
+  return folly::netops::sendmmsg(fd, msgs.data(), count, flags);
+}
+#endif
+
+} // namespace
+
 namespace quic {
+// ZeroCopyBufferTracker
+ZeroCopyBufferTracker::ZeroCopyBufferTracker(folly::NetworkSocket fd)
+    : fd_(fd) {}
+
+bool ZeroCopyBufferTracker::enableZeroCopy(
+    FOLLY_MAYBE_UNUSED folly::AsyncUDPSocket& sock) {
+#ifdef QUIC_HAVE_ZEROCOPY
+  int val = 1;
+  return folly::netops::setsockopt(
+             sock.getNetworkSocket(),
+             SOL_SOCKET,
+             SO_ZEROCOPY,
+             &val,
+             sizeof(val)) == 0;
+#else
+  return false;
+#endif
+}
+
+ssize_t ZeroCopyBufferTracker::writeGSO(
+    const folly::SocketAddress& address,
+    std::unique_ptr<folly::IOBuf>& buf,
+    int gso,
+    const uint64_t* txTime,
+    uint8_t ecn) {
+  auto len = buf->computeChainDataLength();
+  int ret = writemGSO(address, &buf, 1, &gso, txTime, ecn);
+  if (ret <= 0) {
+    return -1;
+  }
+  return len;
+}
+
+int ZeroCopyBufferTracker::writemGSO(
+    FOLLY_MAYBE_UNUSED const folly::SocketAddress& address,
+    FOLLY_MAYBE_UNUSED std::unique_ptr<folly::IOBuf>* bufs,
+    FOLLY_MAYBE_UNUSED size_t count,
+    FOLLY_MAYBE_UNUSED const int* gso,
+    FOLLY_MAYBE_UNUSED const uint64_t* txTimes,
+    FOLLY_MAYBE_UNUSED uint8_t ecn) {
+#ifdef QUIC_HAVE_ZEROCOPY
+  int ret = sendMessages(
+      fd_, address, bufs, count, gso, txTimes, ecn, MSG_ZEROCOPY);
+  for (int i = 0; i < ret; ++i) {
+    onSend(std::move(bufs[i]));
+  }
+  return ret;
+#else
+  errno = EOPNOTSUPP;
+  return -1;
+#endif
+}
+
+void ZeroCopyBufferTracker::onSend(std::unique_ptr<folly::IOBuf> buf) {
+  pending_.emplace_back(nextId_++, std::move(buf));
+}
+
+void ZeroCopyBufferTracker::onCompletion(uint32_t lo, uint32_t hi) {
+  // unsigned arithmetic keeps this right when the ids wrap around
+  uint32_t span = hi - lo;
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    if (it->first - lo <= span) {
+      if (bufPool_) {
+        bufPool_->releaseChain(std::move(it->second));
+      }
+      it = pending_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool ZeroCopyBufferTracker::handleErrMessage(
+    FOLLY_MAYBE_UNUSED const cmsghdr& cmsg) {
+#ifdef QUIC_HAVE_ZEROCOPY
+  if ((cmsg.cmsg_level == SOL_IP && cmsg.cmsg_type == IP_RECVERR) ||
+      (cmsg.cmsg_level == SOL_IPV6 && cmsg.cmsg_type == IPV6_RECVERR)) {
+    const struct sock_extended_err* serr =
+        reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(&cmsg));
+    if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+      onCompletion(serr->ee_info, serr->ee_data);
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+void ZeroCopyBufferTracker::leakPending() {
+  for (auto& send : pending_) {
+    FOLLY_MAYBE_UNUSED auto leaked = send.second.release();
+  }
+  pending_.clear();
+}
+
+namespace {
+
+// Owns a socket the transport is done with until its zerocopy sends are
+// complete, see closeAfterZeroCopySends.
+class ZeroCopySocketCloser
+    : public folly::AsyncUDPSocket::ErrMessageCallback {
+ public:
+  ZeroCopySocketCloser(
+      std::unique_ptr<folly::AsyncUDPSocket> sock,
+      std::shared_ptr<ZeroCopyBufferTracker> tracker)
+      : sock_(std::move(sock)), tracker_(std::move(tracker)) {}
+
+  static void start(
+      std::unique_ptr<folly::AsyncUDPSocket> sock,
+      std::shared_ptr<ZeroCopyBufferTracker> tracker) {
+    auto evb = sock->getEventBase();
+    auto closer = std::make_shared<ZeroCopySocketCloser>(
+        std::move(sock), std::move(tracker));
+    // the pool belongs to the connection, which may go away first
+    closer->tracker_->setBufferPool(nullptr);
+    closer->self_ = closer;
+    closer->sock_->setErrMessageCallback(closer.get());
+    evb->runOnDestruction(
+        [weak = std::weak_ptr<ZeroCopySocketCloser>(closer)] {
+          if (auto self = weak.lock()) {
+            self->abandon();
+          }
+        });
+  }
+
+  void errMessage(const cmsghdr& cmsg) noexcept override {
+    tracker_->handleErrMessage(cmsg);
+    if (tracker_->numPending() == 0) {
+      finish();
+    }
+  }
+
+  void errMessageError(
+      const folly::AsyncSocketException& ex) noexcept override {
+    VLOG(4) << "Error queue of a closing zerocopy socket failed: "
+            << ex.what();
+    tracker_->leakPending();
+    finish();
+  }
+
+ private:
+  // Closes the socket on the next loop, not from inside its own callback.
+  void finish() {
+    if (!self_) {
+      return;
+    }
+    sock_->setErrMessageCallback(nullptr);
+    sock_->getEventBase()->runInLoop(
+        [self = std::move(self_)] { self->sock_->close(); });
+  }
+
+  void abandon() {
+    tracker_->leakPending();
+    sock_->setErrMessageCallback(nullptr);
+    sock_->close();
+    self_.reset();
+  }
+
+  std::unique_ptr<folly::AsyncUDPSocket> sock_;
+  std::shared_ptr<ZeroCopyBufferTracker> tracker_;
+  // keeps this alive until the socket is closed
+  std::shared_ptr<ZeroCopySocketCloser> self_;
+};
+
+} // namespace
+
+void closeAfterZeroCopySends(
+    std::unique_ptr<folly::AsyncUDPSocket> sock,
+    std::shared_ptr<ZeroCopyBufferTracker> tracker) {
+  if (tracker && tracker->numPending() > 0 &&
+      tracker->socket() == sock->getNetworkSocket()) {
+    sock->pauseRead();
+    ZeroCopySocketCloser::start(std::move(sock), std::move(tracker));
+    return;
+  }
+  sock->close();
+}
+
 // BatchWriter
 bool BatchWriter::needsFlush(size_t /*unused*/) {
   return false;
 }
 
+void BatchWriter::setEcn(FOLLY_MAYBE_UNUSED uint8_t ecn) {
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  ecn_ = ecn;
+#endif
+}
+
+bool BatchWriter::useZeroCopy(folly::AsyncUDPSocket& sock, size_t size) const {
+  return zeroCopyTracker_ && size >= kMinZeroCopySendSize &&
+      zeroCopyTracker_->socket() == sock.getNetworkSocket();
+}
+
+std::vector<uint64_t> BatchWriter::getTxTimes(
+    const std::unique_ptr<folly::IOBuf>* bufs,
+    size_t count,
+    const int* gso) const {
+  std::vector<uint64_t> txTimes;
+  if (!txTime_) {
+    return txTimes;
+  }
+  txTimes.reserve(count);
+  uint64_t txTime = *txTime_;
+  for (size_t i = 0; i < count; ++i) {
+    txTimes.push_back(txTime);
+    uint64_t numPackets = 1;
+    if (gso && gso[i] > 0) {
+      auto len = bufs[i]->computeChainDataLength();
+      numPackets = (len + gso[i] - 1) / gso[i];
+    }
+    txTime += numPackets * txTimeInterval_;
+  }
+  return txTimes;
+}
+
+int BatchWriter::writeWithControl(
+    FOLLY_MAYBE_UNUSED folly::AsyncUDPSocket& sock,
+    FOLLY_MAYBE_UNUSED const folly::SocketAddress& address,
+    FOLLY_MAYBE_UNUSED std::unique_ptr<folly::IOBuf>* bufs,
+    FOLLY_MAYBE_UNUSED size_t count,
+    FOLLY_MAYBE_UNUSED const int* gso) {
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  auto txTimes = getTxTimes(bufs, count, gso);
+  folly::Optional<OffloadControl> offload;
+  if (!offloadMetadata_.empty()) {
+    DCHECK(cryptoOffload_);
+    offload.emplace(OffloadControl{
+        cryptoOffload_->getControlLevel(),
+        cryptoOffload_->getControlType(),
+        offloadMetadata_});
+  }
+  return sendMessages(
+      sock.getNetworkSocket(),
+      address,
+      bufs,
+      count,
+      gso,
+      txTimes.empty() ? nullptr : txTimes.data(),
+      ecn_,
+      0 /* flags */,
+      offload.get_pointer());
+#else
+  errno = EOPNOTSUPP;
+  return -1;
+#endif
+}
+
+void BatchWriter::releaseBuf(std::unique_ptr<folly::IOBuf>&& buf) {
+  if (bufPool_) {
+    bufPool_->releaseChain(std::move(buf));
+  } else {
+    buf.reset();
+  }
+}
+
 // SinglePacketBatchWriter
 void SinglePacketBatchWriter::reset() {
-  buf_.reset();
+  releaseBuf(std::move(buf_));
 }
 
 bool SinglePacketBatchWriter::append(
@@ -31,6 +444,10 @@ bool SinglePacketBatchWriter::append(
 ssize_t SinglePacketBatchWriter::write(
     folly::AsyncUDPSocket& sock,
     const folly::SocketAddress& address) {
+  if (needsControl()) {
+    auto len = buf_->computeChainDataLength();
+    return (writeWithControl(sock, address, &buf_, 1, nullptr) > 0) ? len : -1;
+  }
   return sock.write(address, buf_);
 }
 
@@ -39,7 +456,7 @@ GSOPacketBatchWriter::GSOPacketBatchWriter(size_t maxBufs)
     : maxBufs_(maxBufs) {}
 
 void GSOPacketBatchWriter::reset() {
-  buf_.reset(nullptr);
+  releaseBuf(std::move(buf_));
   currBufs_ = 0;
   prevSize_ = 0;
 }
@@ -86,6 +503,21 @@ bool GSOPacketBatchWriter::append(
 ssize_t GSOPacketBatchWriter::write(
     folly::AsyncUDPSocket& sock,
     const folly::SocketAddress& address) {
+  int gso = (currBufs_ > 1) ? static_cast<int>(prevSize_) : 0;
+  // the zerocopy sends don't carry the metadata of offloaded packets
+  if (currBufs_ > 1 && offloadMetadata_.empty() && useZeroCopy(sock, size())) {
+    auto txTimes = getTxTimes(&buf_, 1, &gso);
+    auto ret = zeroCopyTracker_->writeGSO(
+        address, buf_, gso, txTimes.empty() ? nullptr : txTimes.data(), ecn_);
+    if (ret >= 0) {
+      return ret;
+    }
+    // fall back to a regular send, the buffer is still ours
+  }
+  if (needsControl()) {
+    auto len = buf_->computeChainDataLength();
+    return (writeWithControl(sock, address, &buf_, 1, &gso) > 0) ? len : -1;
+  }
   return (currBufs_ > 1)
       ? sock.writeGSO(address, buf_, static_cast<int>(prevSize_))
       : sock.write(address, buf_);
@@ -105,7 +537,14 @@ size_t SendmmsgPacketBatchWriter::size() const {
   return currSize_;
 }
 
+size_t SendmmsgPacketBatchWriter::numMessages() const {
+  return bufs_.size();
+}
+
 void SendmmsgPacketBatchWriter::reset() {
+  for (auto& buf : bufs_) {
+    releaseBuf(std::move(buf));
+  }
   bufs_.clear();
   currSize_ = 0;
 }
@@ -130,6 +569,14 @@ ssize_t SendmmsgPacketBatchWriter::write(
     folly::AsyncUDPSocket& sock,
     const folly::SocketAddress& address) {
   CHECK_GT(bufs_.size(), 0);
+  if (needsControl()) {
+    int ret =
+        writeWithControl(sock, address, bufs_.data(), bufs_.size(), nullptr);
+    if (ret <= 0) {
+      return -1;
+    }
+    return (static_cast<size_t>(ret) == bufs_.size()) ? currSize_ : 0;
+  }
   if (bufs_.size() == 1) {
     return sock.write(address, bufs_[0]);
   }
@@ -163,7 +610,14 @@ size_t SendmmsgGSOPacketBatchWriter::size() const {
   return currSize_;
 }
 
+size_t SendmmsgGSOPacketBatchWriter::numMessages() const {
+  return bufs_.size();
+}
+
 void SendmmsgGSOPacketBatchWriter::reset() {
+  for (auto& buf : bufs_) {
+    releaseBuf(std::move(buf));
+  }
   bufs_.clear();
   gso_.clear();
   currBufs_ = 0;
@@ -214,6 +668,29 @@ ssize_t SendmmsgGSOPacketBatchWriter::write(
     folly::AsyncUDPSocket& sock,
     const folly::SocketAddress& address) {
   CHECK_GT(bufs_.size(), 0);
+  if (useZeroCopy(sock, currSize_)) {
+    auto txTimes = getTxTimes(bufs_.data(), bufs_.size(), gso_.data());
+    int ret = zeroCopyTracker_->writemGSO(
+        address,
+        bufs_.data(),
+        bufs_.size(),
+        gso_.data(),
+        txTimes.empty() ? nullptr : txTimes.data(),
+        ecn_);
+    if (ret > 0) {
+      // a partial write needs to return a different number than currSize_
+      return (static_cast<size_t>(ret) == bufs_.size()) ? currSize_ : 0;
+    }
+    // fall back to a regular send, the buffers are still ours
+  }
+  if (needsControl()) {
+    int ret = writeWithControl(
+        sock, address, bufs_.data(), bufs_.size(), gso_.data());
+    if (ret <= 0) {
+      return -1;
+    }
+    return (static_cast<size_t>(ret) == bufs_.size()) ? currSize_ : 0;
+  }
   if (bufs_.size() == 1) {
     return (currBufs_ > 1) ? sock.writeGSO(address, bufs_[0], gso_[0])
                            : sock.write(address, bufs_[0]);
@@ -234,11 +711,642 @@ ssize_t SendmmsgGSOPacketBatchWriter::write(
   return 0;
 }
 
+#if MVFST_HAVE_LIBURING
+// The messages of one io_uring write and all the memory they point to. The
+// kernel reads it until the last of the sends completes, so the ring owns it
+// from the submission on.
+struct IOUringSends {
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs;
+  std::vector<struct msghdr> msgs;
+  std::vector<struct iovec> iovecs;
+  std::vector<SendControl> controls;
+  struct sockaddr_storage addr;
+  // sends of the messages that have not completed yet
+  size_t pending{0};
+};
+
+namespace {
+// number of submission queue entries, also caps the size of a batch
+constexpr unsigned kIOUringEntries = 256;
+// completed IOUringSends kept for the next writes of the thread
+constexpr size_t kMaxFreeIOUringSends = 8;
+
+/**
+ * The io_uring of a thread, shared by all the writers of that thread. Sends
+ * are submitted without waiting for them, their completions are reaped once
+ * the eventfd registered with the ring becomes readable on the event base of
+ * the writers. The ring is never torn down while a send is in flight.
+ */
+class IOUringSender : public folly::EventHandler {
+ public:
+  IOUringSender() {
+    if (io_uring_queue_init(kIOUringEntries, &ring_, 0) != 0) {
+      return;
+    }
+    eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd_ < 0 || io_uring_register_eventfd(&ring_, eventFd_) != 0) {
+      if (eventFd_ >= 0) {
+        close(eventFd_);
+      }
+      io_uring_queue_exit(&ring_);
+      return;
+    }
+    initialized_ = true;
+  }
+
+  ~IOUringSender() override {
+    *self_ = nullptr;
+    if (!initialized_) {
+      return;
+    }
+    detach();
+    if (inflight_ > 0) {
+      // The kernel may still read the messages, leave them and the ring be.
+      LOG(ERROR) << "Leaking an io_uring with " << inflight_
+                 << " sends in flight";
+      return;
+    }
+    io_uring_queue_exit(&ring_);
+    close(eventFd_);
+  }
+
+  bool initialized() const {
+    return initialized_;
+  }
+
+  std::unique_ptr<IOUringSends> acquireSends() {
+    if (freeSends_.empty()) {
+      return std::make_unique<IOUringSends>();
+    }
+    auto sends = std::move(freeSends_.back());
+    freeSends_.pop_back();
+    return sends;
+  }
+
+  /**
+   * Queues the messages of sends on fd and submits them. Returns the number
+   * of messages queued, which is less than all of them once the completion
+   * queue has no room left.
+   */
+  size_t send(
+      folly::EventBase* evb,
+      int fd,
+      std::unique_ptr<IOUringSends> sends) {
+    attach(evb);
+    reap();
+    size_t room = *ring_.cq.kring_entries - inflight_;
+    size_t count = std::min(sends->msgs.size(), room);
+    size_t queued = 0;
+    for (; queued < count; ++queued) {
+      auto sqe = io_uring_get_sqe(&ring_);
+      if (!sqe) {
+        break;
+      }
+      io_uring_prep_sendmsg(sqe, fd, &sends->msgs[queued], 0);
+      io_uring_sqe_set_data(sqe, sends.get());
+    }
+    if (queued == 0) {
+      recycle(std::move(sends));
+      return 0;
+    }
+    sends->pending = queued;
+    inflight_ += queued;
+    // freed by reap() with the last completion
+    sends.release();
+    // Entries the kernel doesn't take now stay on the submission queue and go
+    // with the next submission.
+    int ret = io_uring_submit(&ring_);
+    if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+      LOG(ERROR) << "io_uring submit error " << folly::errnoStr(-ret);
+    }
+    return queued;
+  }
+
+  void handlerReady(uint16_t /* events */) noexcept override {
+    uint64_t count;
+    while (read(eventFd_, &count, sizeof(count)) == sizeof(count)) {
+    }
+    reap();
+    if (io_uring_sq_ready(&ring_) > 0) {
+      io_uring_submit(&ring_);
+    }
+  }
+
+ private:
+  void attach(folly::EventBase* evb) {
+    if (evb_ == evb) {
+      return;
+    }
+    detach();
+    evb_ = evb;
+    initHandler(evb, folly::NetworkSocket::fromFd(eventFd_));
+    // pending completions must not keep the loop running
+    registerInternalHandler(
+        folly::EventHandler::READ | folly::EventHandler::PERSIST);
+    evb->runOnDestruction([self = self_, evb] {
+      if (*self && (*self)->evb_ == evb) {
+        (*self)->detach();
+      }
+    });
+  }
+
+  // Waits for the sends in flight and stops watching the event base.
+  void detach() {
+    if (!evb_) {
+      return;
+    }
+    drain();
+    unregisterHandler();
+    evb_ = nullptr;
+  }
+
+  void drain() {
+    reap();
+    while (inflight_ > 0) {
+      int ret = io_uring_submit_and_wait(&ring_, 1);
+      if (ret < 0 && ret != -EINTR) {
+        LOG(ERROR) << "io_uring wait error " << folly::errnoStr(-ret);
+        return;
+      }
+      reap();
+    }
+  }
+
+  void reap() {
+    struct io_uring_cqe* cqe = nullptr;
+    while (io_uring_peek_cqe(&ring_, &cqe) == 0 && cqe) {
+      auto sends = static_cast<IOUringSends*>(io_uring_cqe_get_data(cqe));
+      if (cqe->res < 0) {
+        VLOG(4) << "io_uring send error " << folly::errnoStr(-cqe->res);
+      }
+      io_uring_cqe_seen(&ring_, cqe);
+      inflight_--;
+      if (--sends->pending == 0) {
+        recycle(std::unique_ptr<IOUringSends>(sends));
+      }
+    }
+  }
+
+  void recycle(std::unique_ptr<IOUringSends> sends) {
+    sends->bufs.clear();
+    if (freeSends_.size() < kMaxFreeIOUringSends) {
+      freeSends_.push_back(std::move(sends));
+    }
+  }
+
+  struct io_uring ring_;
+  int eventFd_{-1};
+  bool initialized_{false};
+  folly::EventBase* evb_{nullptr};
+  size_t inflight_{0};
+  std::vector<std::unique_ptr<IOUringSends>> freeSends_;
+  // lets the destruction callbacks of the event bases outlive the sender
+  std::shared_ptr<IOUringSender*> self_{
+      std::make_shared<IOUringSender*>(this)};
+};
+
+IOUringSender& getIOUringSender() {
+  static thread_local IOUringSender sender;
+  return sender;
+}
+} // namespace
+
+// IOUringPacketBatchWriter
+IOUringPacketBatchWriter::IOUringPacketBatchWriter(size_t maxBufs)
+    : maxBufs_(
+          std::min<size_t>(std::max<size_t>(1, maxBufs), kIOUringEntries)) {
+  bufs_.reserve(maxBufs_);
+}
+
+IOUringPacketBatchWriter::~IOUringPacketBatchWriter() = default;
+
+bool IOUringPacketBatchWriter::isAvailable() {
+  return getIOUringSender().initialized();
+}
+
+bool IOUringPacketBatchWriter::empty() const {
+  return !currSize_;
+}
+
+size_t IOUringPacketBatchWriter::size() const {
+  return currSize_;
+}
+
+size_t IOUringPacketBatchWriter::numMessages() const {
+  return bufs_.size();
+}
+
+void IOUringPacketBatchWriter::reset() {
+  for (auto& buf : bufs_) {
+    releaseBuf(std::move(buf));
+  }
+  bufs_.clear();
+  currSize_ = 0;
+}
+
+bool IOUringPacketBatchWriter::append(
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t size) {
+  bufs_.emplace_back(std::move(buf));
+  currSize_ += size;
+
+  // reached max buffers
+  if (FOLLY_UNLIKELY(bufs_.size() == maxBufs_)) {
+    return true;
+  }
+
+  // does not need to be flushed yet
+  return false;
+}
+
+ssize_t IOUringPacketBatchWriter::write(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
+  CHECK_GT(bufs_.size(), 0);
+  auto& sender = getIOUringSender();
+  CHECK(sender.initialized());
+  if (!sends_) {
+    sends_ = sender.acquireSends();
+  }
+  auto& sends = *sends_;
+
+  socklen_t addrLen = address.getAddress(&sends.addr);
+  size_t numIovecs = 0;
+  for (const auto& buf : bufs_) {
+    numIovecs += buf->countChainElements();
+  }
+  // The same batch can go to more than one address, the sends share the
+  // packets with the batch. A shared buffer isn't recycled into the pool.
+  sends.bufs.clear();
+  sends.iovecs.clear();
+  sends.iovecs.reserve(numIovecs);
+  sends.msgs.assign(bufs_.size(), msghdr{});
+  auto txTimes = getTxTimes(bufs_.data(), bufs_.size(), nullptr);
+  sends.controls.resize(needsControl() ? bufs_.size() : 0);
+  for (size_t i = 0; i < bufs_.size(); ++i) {
+    sends.bufs.emplace_back(bufs_[i]->clone());
+    auto& msg = sends.msgs[i];
+    msg.msg_name = &sends.addr;
+    msg.msg_namelen = addrLen;
+    msg.msg_iov = sends.iovecs.data() + sends.iovecs.size();
+    for (auto range : *sends.bufs.back()) {
+      struct iovec iov;
+      iov.iov_base = const_cast<uint8_t*>(range.data());
+      iov.iov_len = range.size();
+      sends.iovecs.push_back(iov);
+    }
+    msg.msg_iovlen = sends.bufs.back()->countChainElements();
+    if (!sends.controls.empty()) {
+      msg.msg_control = sends.controls[i].buf;
+      msg.msg_controllen =
+          (txTimes.empty() ? 0 : CMSG_SPACE(sizeof(uint64_t))) +
+          (ecn_ != kEcnNotEct ? CMSG_SPACE(sizeof(int)) : 0);
+      struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+      if (!txTimes.empty()) {
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_TXTIME;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+        memcpy(CMSG_DATA(cm), &txTimes[i], sizeof(uint64_t));
+        cm = CMSG_NXTHDR(&msg, cm);
+      }
+      if (ecn_ != kEcnNotEct) {
+        writeEcnControl(cm, address, ecn_);
+      }
+    }
+  }
+
+  // The completions are reaped on the event base, a send that fails there is
+  // a lost packet like any other.
+  size_t queued = sender.send(
+      sock.getEventBase(), sock.getNetworkSocket().toFd(), std::move(sends_));
+  if (queued == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  if (queued == bufs_.size()) {
+    return currSize_;
+  }
+
+  // this is a partial write - we just need to
+  // return a different number than currSize_
+  return 0;
+}
+#endif
+
+// MultiDestBatchWriter
+MultiDestBatchWriter::MultiDestBatchWriter(
+    folly::EventBase* evb,
+    size_t maxEntries)
+    : evb_(evb), maxEntries_(std::max<size_t>(1, maxEntries)) {
+  entries_.reserve(maxEntries_);
+}
+
+bool MultiDestBatchWriter::empty() const {
+  return entries_.empty();
+}
+
+size_t MultiDestBatchWriter::size() const {
+  return currSize_;
+}
+
+size_t MultiDestBatchWriter::numEntries() const {
+  return entries_.size();
+}
+
+bool MultiDestBatchWriter::canCoalesce(
+    const Entry& entry,
+    size_t bufSize,
+    uint8_t ecn) const {
+  return gsoSupported_ && !entry.closed && entry.ecn == ecn &&
+      bufSize <= entry.segmentSize &&
+      entry.numSegments < kMaxGSOSegments &&
+      entry.size + bufSize <= kMaxGSOMessageSize;
+}
+
+void MultiDestBatchWriter::add(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address,
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t bufSize,
+    uint8_t ecn) {
+  auto fd = sock.getNetworkSocket();
+  if (!entries_.empty() && fd != fd_) {
+    flush(QuicTransportStatsCallback::WriteFlushReason::END_OF_WRITE);
+  }
+  if (entries_.empty()) {
+    fd_ = fd;
+    gsoSupported_ = sock.getGSO() >= 0;
+  }
+  currSize_ += bufSize;
+
+  auto it = lastEntry_.find(address);
+  if (it != lastEntry_.end() &&
+      canCoalesce(entries_[it->second], bufSize, ecn)) {
+    auto& entry = entries_[it->second];
+    entry.buf->prependChain(std::move(buf));
+    entry.numSegments++;
+    entry.size += bufSize;
+    // a shorter segment ends the message
+    entry.closed = bufSize < entry.segmentSize;
+    return;
+  }
+
+  Entry entry;
+  entry.address = address;
+  entry.buf = std::move(buf);
+  entry.segmentSize = bufSize;
+  entry.numSegments = 1;
+  entry.size = bufSize;
+  entry.ecn = ecn;
+  lastEntry_[address] = entries_.size();
+  entries_.push_back(std::move(entry));
+
+  if (entries_.size() >= maxEntries_) {
+    flush(QuicTransportStatsCallback::WriteFlushReason::WRITER_FULL);
+  } else if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+}
+
+int MultiDestBatchWriter::flush(
+    QuicTransportStatsCallback::WriteFlushReason reason) {
+  if (entries_.empty()) {
+    return 0;
+  }
+  QUIC_STATS(infoCallback_, onWriteFlush, reason);
+  size_t numIovecs = 0;
+  for (const auto& entry : entries_) {
+    numIovecs += entry.buf->countChainElements();
+  }
+  // all the iovecs have to be in place before the messages point into them
+  std::vector<struct iovec> iovecs;
+  iovecs.reserve(numIovecs);
+  for (const auto& entry : entries_) {
+    for (auto range : *entry.buf) {
+      struct iovec iov;
+      iov.iov_base = const_cast<uint8_t*>(range.data());
+      iov.iov_len = range.size();
+      iovecs.push_back(iov);
+    }
+  }
+
+  std::vector<struct mmsghdr> msgs(entries_.size());
+  std::vector<struct sockaddr_storage> addrs(entries_.size());
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  std::vector<SendControl> controls(entries_.size());
+#endif
+  size_t iovIndex = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const auto& entry = entries_[i];
+    auto& msg = msgs[i].msg_hdr;
+    msg.msg_name = &addrs[i];
+    msg.msg_namelen = entry.address.getAddress(&addrs[i]);
+    msg.msg_iov = iovecs.data() + iovIndex;
+    msg.msg_iovlen = entry.buf->countChainElements();
+    iovIndex += msg.msg_iovlen;
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+    bool segmented = entry.numSegments > 1;
+    size_t controlLen = (segmented ? CMSG_SPACE(sizeof(uint16_t)) : 0) +
+        (entry.ecn != kEcnNotEct ? CMSG_SPACE(sizeof(int)) : 0);
+    if (controlLen) {
+      msg.msg_control = controls[i].buf;
+      msg.msg_controllen = controlLen;
+      struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+      if (segmented) {
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        auto segmentSize = folly::to<uint16_t>(entry.segmentSize);
+        memcpy(CMSG_DATA(cm), &segmentSize, sizeof(segmentSize));
+        cm = CMSG_NXTHDR(&msg, cm);
+      }
+      if (entry.ecn != kEcnNotEct) {
+        writeEcnControl(cm, entry.address, entry.ecn);
+      }
+    }
+#endif
+  }
+
+  size_t sent = 0;
+  int errnoCopy = 0;
+  while (sent < msgs.size()) {
+    int ret = folly::netops::sendmmsg(
+        fd_, msgs.data() + sent, msgs.size() - sent, 0);
+    if (ret <= 0) {
+      errnoCopy = errno;
+      QUIC_STATS(
+          infoCallback_,
+          onUDPSocketWriteError,
+          QuicTransportStatsCallback::errnoToSocketErrorType(errnoCopy));
+      break;
+    }
+    if (infoCallback_) {
+      size_t packets = 0;
+      size_t bytes = 0;
+      for (size_t i = sent; i < sent + ret; ++i) {
+        packets += entries_[i].numSegments;
+        bytes += entries_[i].size;
+      }
+      infoCallback_->onWriteSyscall(ret, packets, bytes);
+    }
+    sent += ret;
+  }
+  if (sent < msgs.size()) {
+    // Whatever is left is treated the same as a loss on the wire.
+    VLOG(4) << "Dropping " << (msgs.size() - sent) << " of " << msgs.size()
+            << " messages on sendmmsg error " << folly::errnoStr(errnoCopy);
+  }
+  reset();
+  return (sent == 0) ? -1 : static_cast<int>(sent);
+}
+
+void MultiDestBatchWriter::runLoopCallback() noexcept {
+  flush(QuicTransportStatsCallback::WriteFlushReason::END_OF_LOOP);
+}
+
+void MultiDestBatchWriter::reset() {
+  for (auto& entry : entries_) {
+    if (bufPool_) {
+      bufPool_->releaseChain(std::move(entry.buf));
+    }
+  }
+  entries_.clear();
+  lastEntry_.clear();
+  currSize_ = 0;
+  if (isLoopCallbackScheduled()) {
+    cancelLoopCallback();
+  }
+}
+
+// MultiDestPacketBatchWriter
+MultiDestPacketBatchWriter::MultiDestPacketBatchWriter(
+    MultiDestBatchWriter& writer,
+    size_t maxBufs)
+    : writer_(writer), maxBufs_(std::max<size_t>(1, maxBufs)) {
+  bufs_.reserve(maxBufs_);
+  sizes_.reserve(maxBufs_);
+}
+
+bool MultiDestPacketBatchWriter::empty() const {
+  return !currSize_;
+}
+
+size_t MultiDestPacketBatchWriter::size() const {
+  return currSize_;
+}
+
+void MultiDestPacketBatchWriter::reset() {
+  for (auto& buf : bufs_) {
+    releaseBuf(std::move(buf));
+  }
+  bufs_.clear();
+  sizes_.clear();
+  currSize_ = 0;
+}
+
+bool MultiDestPacketBatchWriter::append(
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t size) {
+  bufs_.emplace_back(std::move(buf));
+  sizes_.push_back(size);
+  currSize_ += size;
+  return bufs_.size() == maxBufs_;
+}
+
+ssize_t MultiDestPacketBatchWriter::write(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
+  CHECK_GT(bufs_.size(), 0);
+  for (size_t i = 0; i < bufs_.size(); ++i) {
+    writer_.add(sock, address, std::move(bufs_[i]), sizes_[i], ecn_);
+  }
+  // The packets are on their way as far as the connection can tell, errors
+  // at flush time are handled by the shared writer.
+  return currSize_;
+}
+
+XdpPacketBatchWriter::XdpPacketBatchWriter(
+    XdpSocket& xdpSocket,
+    size_t maxBufs)
+    : xdpSocket_(xdpSocket), maxBufs_(maxBufs) {
+  bufs_.reserve(maxBufs);
+}
+
+bool XdpPacketBatchWriter::empty() const {
+  return !currSize_;
+}
+
+size_t XdpPacketBatchWriter::size() const {
+  return currSize_;
+}
+
+void XdpPacketBatchWriter::reset() {
+  for (auto& buf : bufs_) {
+    releaseBuf(std::move(buf));
+  }
+  bufs_.clear();
+  currSize_ = 0;
+}
+
+bool XdpPacketBatchWriter::append(
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t size) {
+  bufs_.emplace_back(std::move(buf));
+  currSize_ += size;
+  return bufs_.size() == maxBufs_;
+}
+
+ssize_t XdpPacketBatchWriter::write(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
+  CHECK_GT(bufs_.size(), 0);
+  ssize_t written = 0;
+  for (auto& buf : bufs_) {
+    auto len = buf->computeChainDataLength();
+    // The frames are copied out of the buffer, it goes back to the pool with
+    // the reset.
+    if (xdpSocket_.write(address, *buf, 0, ecn_)) {
+      written += len;
+      continue;
+    }
+    int ret = needsControl()
+        ? writeWithControl(sock, address, &buf, 1, nullptr)
+        : (sock.write(address, buf) < 0 ? -1 : 1);
+    if (ret <= 0) {
+      xdpSocket_.flush();
+      return written > 0 ? written : -1;
+    }
+    written += len;
+  }
+  xdpSocket_.flush();
+  return written;
+}
+
+QuicBatchingMode resolveBatchingMode(
+    folly::AsyncUDPSocket& sock,
+    QuicBatchingMode batchingMode) {
+  if (batchingMode != QuicBatchingMode::BATCHING_MODE_AUTO) {
+    return batchingMode;
+  }
+  return sock.getGSO() >= 0 ? QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO
+                            : QuicBatchingMode::BATCHING_MODE_SENDMMSG;
+}
+
 // BatchWriterFactory
 std::unique_ptr<BatchWriter> BatchWriterFactory::makeBatchWriter(
     folly::AsyncUDPSocket& sock,
     const quic::QuicBatchingMode& batchingMode,
-    uint32_t batchSize) {
+    uint32_t batchSize,
+    MultiDestBatchWriter* multiDestWriter,
+    XdpSocket* xdpSocket) {
+  if (xdpSocket) {
+    return std::make_unique<XdpPacketBatchWriter>(*xdpSocket, batchSize);
+  }
+  if (multiDestWriter) {
+    return std::make_unique<MultiDestPacketBatchWriter>(
+        *multiDestWriter, batchSize);
+  }
   switch (batchingMode) {
     case quic::QuicBatchingMode::BATCHING_MODE_NONE:
       return std::make_unique<SinglePacketBatchWriter>();
@@ -258,6 +1366,18 @@ std::unique_ptr<BatchWriter> BatchWriterFactory::makeBatchWriter(
 
       return std::make_unique<SendmmsgPacketBatchWriter>(batchSize);
     }
+    case quic::QuicBatchingMode::BATCHING_MODE_IO_URING: {
+#if MVFST_HAVE_LIBURING
+      if (IOUringPacketBatchWriter::isAvailable()) {
+        return std::make_unique<IOUringPacketBatchWriter>(batchSize);
+      }
+#endif
+
+      return std::make_unique<SendmmsgPacketBatchWriter>(batchSize);
+    }
+    case quic::QuicBatchingMode::BATCHING_MODE_AUTO:
+      return makeBatchWriter(
+          sock, resolveBatchingMode(sock, batchingMode), batchSize);
       // no default so we can catch missing case at compile time
   }
 
@@ -8,11 +8,114 @@
 
 #pragma once
 
+#include <folly/Optional.h>
+#include <folly/container/F14Map.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
 #include <quic/QuicConstants.h>
+#include <quic/common/BufUtil.h>
+#include <quic/handshake/CryptoOffload.h>
+#include <quic/state/QuicTransportStatsCallback.h>
+
+#include <deque>
 
 namespace quic {
+
+/**
+ * Keeps the buffers of MSG_ZEROCOPY sends on one socket alive until the
+ * kernel reports on the socket error queue that it no longer needs them. The
+ * kernel numbers the zerocopy sends of a socket from 0, one for each
+ * successful sendmsg and one for each message of a sendmmsg.
+ */
+class ZeroCopyBufferTracker {
+ public:
+  explicit ZeroCopyBufferTracker(folly::NetworkSocket fd);
+  ~ZeroCopyBufferTracker() = default;
+
+  /**
+   * Turns on SO_ZEROCOPY on the socket. Returns false if the platform or the
+   * socket does not support it.
+   */
+  static bool enableZeroCopy(folly::AsyncUDPSocket& sock);
+
+  // the socket whose sends are tracked
+  folly::NetworkSocket socket() const {
+    return fd_;
+  }
+
+  /**
+   * Sends buf, segmented by gso bytes when gso > 0, with MSG_ZEROCOPY, the
+   * SO_TXTIME departure time when txTime is set and the ECN codepoint ecn. On
+   * success the tracker takes the buffer over.
+   */
+  ssize_t writeGSO(
+      const folly::SocketAddress& address,
+      std::unique_ptr<folly::IOBuf>& buf,
+      int gso,
+      const uint64_t* txTime = nullptr,
+      uint8_t ecn = kEcnNotEct);
+
+  /**
+   * Same as writeGSO for count messages in one sendmmsg. Returns the number
+   * of messages sent, the tracker takes over the buffers of all of them.
+   */
+  int writemGSO(
+      const folly::SocketAddress& address,
+      std::unique_ptr<folly::IOBuf>* bufs,
+      size_t count,
+      const int* gso,
+      const uint64_t* txTimes = nullptr,
+      uint8_t ecn = kEcnNotEct);
+
+  // takes over the buffers of the zerocopy send which just succeeded
+  void onSend(std::unique_ptr<folly::IOBuf> buf);
+
+  // releases the buffers of the sends numbered lo to hi, inclusive
+  void onCompletion(uint32_t lo, uint32_t hi);
+
+  /**
+   * Handles a message from the socket error queue. Returns true if it was a
+   * zerocopy notification.
+   */
+  bool handleErrMessage(const cmsghdr& cmsg);
+
+  // number of sends whose buffers are still held
+  size_t numPending() const {
+    return pending_.size();
+  }
+
+  // released buffers are handed back to the pool when set
+  void setBufferPool(PacketBufferPool* pool) {
+    bufPool_ = pool;
+  }
+
+  /**
+   * Gives up the buffers of the sends still in flight without freeing them,
+   * for when their completions can no longer arrive. The kernel may still
+   * read from them.
+   */
+  void leakPending();
+
+ private:
+  folly::NetworkSocket fd_;
+  uint32_t nextId_{0};
+  // ordered by id
+  std::deque<std::pair<uint32_t, std::unique_ptr<folly::IOBuf>>> pending_;
+  PacketBufferPool* bufPool_{nullptr};
+};
+
+/**
+ * Closes a socket the transport is done with. When the socket has zerocopy
+ * sends in flight, as tracker knows, it stays open with reads paused until
+ * the kernel reported all of them complete on its error queue, so that their
+ * buffers are not reused while the kernel may still read them. Buffers still
+ * in flight when the socket's event base goes away are leaked.
+ */
+void closeAfterZeroCopySends(
+    std::unique_ptr<folly::AsyncUDPSocket> sock,
+    std::shared_ptr<ZeroCopyBufferTracker> tracker);
+
 class BatchWriter {
  public:
   BatchWriter() = default;
@@ -24,6 +127,14 @@ class BatchWriter {
   // returns the size in bytes of the batched buffers
   virtual size_t size() const = 0;
 
+  /**
+   * The number of messages the batch is sent as in one syscall, 0 for
+   * writers that hand the batch to another writer instead of writing it.
+   */
+  virtual size_t numMessages() const {
+    return empty() ? 0 : 1;
+  }
+
   // reset the internal state after a flush
   virtual void reset() = 0;
 
@@ -37,6 +148,99 @@ class BatchWriter {
   virtual ssize_t write(
       folly::AsyncUDPSocket& sock,
       const folly::SocketAddress& address) = 0;
+
+  // buffers dropped by reset() are handed back to the pool when set
+  void setBufferPool(PacketBufferPool* pool) {
+    bufPool_ = pool;
+  }
+
+  // large GSO sends on the tracker's socket use MSG_ZEROCOPY when set
+  void setZeroCopyTracker(ZeroCopyBufferTracker* tracker) {
+    zeroCopyTracker_ = tracker;
+  }
+
+  /**
+   * Stamps the packets of the next write with SO_TXTIME departure times, in
+   * CLOCK_MONOTONIC nanoseconds: the first packet leaves at txTime and every
+   * following one interval later. The socket needs SO_TXTIME enabled.
+   */
+  void setTxTime(uint64_t txTime, uint64_t interval) {
+    txTime_ = txTime;
+    txTimeInterval_ = interval;
+  }
+
+  void clearTxTime() {
+    txTime_.clear();
+  }
+
+  /**
+   * Sets the ECN codepoint of the packets of the writes from now on, with an
+   * IP_TOS or IPV6_TCLASS control message. Ignored where the control
+   * messages can't be written.
+   */
+  void setEcn(uint8_t ecn);
+
+  /**
+   * Whether the writer can send plaintext packets for a CryptoOffload to
+   * seal, which takes one message per write.
+   */
+  virtual bool supportsCryptoOffload() const {
+    return false;
+  }
+
+  // the device the metadata of the offloaded packets is written for
+  void setCryptoOffload(const CryptoOffload* offload) {
+    cryptoOffload_ = offload;
+  }
+
+  // adds the metadata of the offloaded packet appended next
+  void addOffloadMetadata(const CryptoOffloadMetadata& metadata) {
+    DCHECK(cryptoOffload_);
+    offloadMetadata_.push_back(metadata);
+  }
+
+  void clearOffloadMetadata() {
+    offloadMetadata_.clear();
+  }
+
+ protected:
+  void releaseBuf(std::unique_ptr<folly::IOBuf>&& buf);
+
+  /**
+   * Departure times of the count messages of the next write, each message
+   * holding one packet or gso sized segments. Empty when the write is not
+   * stamped.
+   */
+  std::vector<uint64_t> getTxTimes(
+      const std::unique_ptr<folly::IOBuf>* bufs,
+      size_t count,
+      const int* gso) const;
+
+  // whether the writes carry control messages the socket doesn't add itself
+  bool needsControl() const {
+    return txTime_.has_value() || ecn_ != kEcnNotEct ||
+        !offloadMetadata_.empty();
+  }
+
+  // writes the messages with their departure times and ECN codepoint, gso may
+  // be null. Returns the number of messages sent.
+  int writeWithControl(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address,
+      std::unique_ptr<folly::IOBuf>* bufs,
+      size_t count,
+      const int* gso);
+
+  // returns whether a batch of the given size should be sent with zerocopy
+  bool useZeroCopy(folly::AsyncUDPSocket& sock, size_t size) const;
+
+  PacketBufferPool* bufPool_{nullptr};
+  ZeroCopyBufferTracker* zeroCopyTracker_{nullptr};
+  folly::Optional<uint64_t> txTime_;
+  uint64_t txTimeInterval_{0};
+  uint8_t ecn_{kEcnNotEct};
+  const CryptoOffload* cryptoOffload_{nullptr};
+  std::vector<CryptoOffloadMetadata> offloadMetadata_;
 };
 
 class IOBufBatchWriter : public BatchWriter {
@@ -52,6 +256,10 @@ class IOBufBatchWriter : public BatchWriter {
     return buf_ ? buf_->computeChainDataLength() : 0;
   }
 
+  bool supportsCryptoOffload() const override {
+    return true;
+  }
+
  protected:
   std::unique_ptr<folly::IOBuf> buf_;
 };
@@ -98,6 +306,8 @@ class SendmmsgPacketBatchWriter : public BatchWriter {
 
   size_t size() const override;
 
+  size_t numMessages() const override;
+
   void reset() override;
   bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
   ssize_t write(
@@ -122,6 +332,8 @@ class SendmmsgGSOPacketBatchWriter : public BatchWriter {
 
   size_t size() const override;
 
+  size_t numMessages() const override;
+
   void reset() override;
   bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
   ssize_t write(
@@ -142,12 +354,223 @@ class SendmmsgGSOPacketBatchWriter : public BatchWriter {
   std::vector<int> gso_;
 };
 
+#if MVFST_HAVE_LIBURING
+struct IOUringSends;
+
+/**
+ * Submits every packet of the batch as a sendmsg operation on an io_uring
+ * without waiting for the sends to complete. The ring is set up once per
+ * thread and shared by all the writers of that thread, it reaps the
+ * completions on the event base of the socket.
+ */
+class IOUringPacketBatchWriter : public BatchWriter {
+ public:
+  explicit IOUringPacketBatchWriter(size_t maxBufs);
+  ~IOUringPacketBatchWriter() override;
+
+  // returns true if an io_uring can be used on the calling thread
+  static bool isAvailable();
+
+  bool empty() const override;
+
+  size_t size() const override;
+
+  size_t numMessages() const override;
+
+  void reset() override;
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+ private:
+  // max number of buffer chains we can accumulate before we need to flush
+  size_t maxBufs_{1};
+  // size of data in all the buffers
+  size_t currSize_{0};
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs_;
+  // the messages of the next write, handed to the ring by the write
+  std::unique_ptr<IOUringSends> sends_;
+};
+#endif
+
+/**
+ * Accumulates packets for many destinations which share one UDP socket, and
+ * writes all of them with a single sendmmsg() at the end of the event loop
+ * iteration, or earlier once maxEntries messages are pending. Consecutive
+ * packets of the same size to the same address are coalesced into one
+ * message carrying its own UDP_SEGMENT when the socket supports GSO.
+ *
+ * This is meant to be owned by a server worker and shared by all of its
+ * transports, so that many small flows do not each pay for their own syscall.
+ */
+class MultiDestBatchWriter : public folly::EventBase::LoopCallback {
+ public:
+  MultiDestBatchWriter(folly::EventBase* evb, size_t maxEntries);
+  ~MultiDestBatchWriter() override = default;
+
+  bool empty() const;
+
+  // returns the size in bytes of the pending packets
+  size_t size() const;
+
+  // number of sendmmsg() messages pending
+  size_t numEntries() const;
+
+  /**
+   * Queues a packet of bufSize bytes for address, sent with the ECN codepoint
+   * ecn. The packet is written through the file descriptor of sock, which
+   * must be the same for all the packets of one flush; queuing a packet for
+   * another descriptor flushes the pending ones first.
+   */
+  void add(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address,
+      std::unique_ptr<folly::IOBuf>&& buf,
+      size_t bufSize,
+      uint8_t ecn = kEcnNotEct);
+
+  /**
+   * Writes all the pending packets. Returns the number of messages written,
+   * or -1 if the socket returned an error before anything could be written.
+   * Packets that could not be written are dropped.
+   */
+  int flush(
+      QuicTransportStatsCallback::WriteFlushReason reason =
+          QuicTransportStatsCallback::WriteFlushReason::END_OF_WRITE);
+
+  // written packets are handed back to the pool when set
+  void setBufferPool(PacketBufferPool* pool) {
+    bufPool_ = pool;
+  }
+
+  // the syscalls, errors and flushes are reported to the callback when set
+  void setTransportInfoCallback(QuicTransportStatsCallback* infoCallback) {
+    infoCallback_ = infoCallback;
+  }
+
+  void runLoopCallback() noexcept override;
+
+ private:
+  struct Entry {
+    folly::SocketAddress address;
+    // the packets of this message, chained one after the other
+    std::unique_ptr<folly::IOBuf> buf;
+    // size of every segment but the last one
+    size_t segmentSize{0};
+    size_t numSegments{0};
+    size_t size{0};
+    // a segment smaller than segmentSize was appended, it has to be the last
+    bool closed{false};
+    uint8_t ecn{kEcnNotEct};
+  };
+
+  bool canCoalesce(const Entry& entry, size_t bufSize, uint8_t ecn) const;
+
+  void reset();
+
+  folly::EventBase* evb_;
+  size_t maxEntries_;
+  folly::NetworkSocket fd_;
+  bool gsoSupported_{false};
+  std::vector<Entry> entries_;
+  // index into entries_ of the last message to each address
+  folly::F14FastMap<folly::SocketAddress, size_t> lastEntry_;
+  size_t currSize_{0};
+  PacketBufferPool* bufPool_{nullptr};
+  QuicTransportStatsCallback* infoCallback_{nullptr};
+};
+
+/**
+ * Hands the packets of one write loop over to a MultiDestBatchWriter when
+ * the batch is written, instead of writing them to the socket. The shared
+ * writer sends them later together with the packets of other connections.
+ */
+class MultiDestPacketBatchWriter : public BatchWriter {
+ public:
+  MultiDestPacketBatchWriter(MultiDestBatchWriter& writer, size_t maxBufs);
+  ~MultiDestPacketBatchWriter() override = default;
+
+  bool empty() const override;
+
+  size_t size() const override;
+
+  // the shared writer accounts for the syscalls
+  size_t numMessages() const override {
+    return 0;
+  }
+
+  void reset() override;
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+ private:
+  MultiDestBatchWriter& writer_;
+  // max number of buffer chains we can accumulate before we need to flush
+  size_t maxBufs_{1};
+  // size of data in all the buffers
+  size_t currSize_{0};
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs_;
+  std::vector<size_t> sizes_;
+};
+
+class XdpSocket;
+
+/**
+ * Posts the packets of one write loop to the AF_XDP socket of the server
+ * worker. The packets to a peer the socket hasn't received from yet, and the
+ * ones it has no free frames for, are sent through the kernel socket. The
+ * frames leave as soon as the kernel picks them up, without SO_TXTIME
+ * departure times.
+ */
+class XdpPacketBatchWriter : public BatchWriter {
+ public:
+  XdpPacketBatchWriter(XdpSocket& xdpSocket, size_t maxBufs);
+  ~XdpPacketBatchWriter() override = default;
+
+  bool empty() const override;
+
+  size_t size() const override;
+
+  void reset() override;
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+ private:
+  XdpSocket& xdpSocket_;
+  // max number of buffer chains we can accumulate before we need to flush
+  size_t maxBufs_{1};
+  // size of data in all the buffers
+  size_t currSize_{0};
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs_;
+};
+
+/**
+ * Returns the batching mode BATCHING_MODE_AUTO stands for on the socket, the
+ * other modes as they are.
+ */
+QuicBatchingMode resolveBatchingMode(
+    folly::AsyncUDPSocket& sock,
+    QuicBatchingMode batchingMode);
+
 class BatchWriterFactory {
  public:
+  /**
+   * When multiDestWriter is set, the returned writer defers the actual
+   * socket writes to it regardless of the batching mode. When xdpSocket is
+   * set, the returned writer posts the packets to it instead, see
+   * XdpPacketBatchWriter.
+   */
   static std::unique_ptr<BatchWriter> makeBatchWriter(
       folly::AsyncUDPSocket& sock,
       const quic::QuicBatchingMode& batchingMode,
-      uint32_t batchSize);
+      uint32_t batchSize,
+      MultiDestBatchWriter* multiDestWriter = nullptr,
+      XdpSocket* xdpSocket = nullptr);
 };
 
 } // namespace quic
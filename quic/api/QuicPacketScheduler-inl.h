@@ -59,6 +59,9 @@ folly::Optional<PacketNum> AckScheduler::writeAcksImpl(
                  ackingTime - receivedTime)
            : 0us);
   AckFrameMetaData meta(ackState_.acks, ackDelay, ackDelayExponentToUse);
+  if (!ackState_.ecnCounts.empty()) {
+    meta.ecnCounts = ackState_.ecnCounts;
+  }
   auto ackWriteResult = writeAckFrame(meta, builder);
   if (!ackWriteResult) {
     return folly::none;
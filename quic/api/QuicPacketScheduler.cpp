@@ -8,6 +8,11 @@
 
 #include <quic/api/QuicPacketScheduler.h>
 
+#include <quic/state/QuicStateFunctions.h>
+
+#include <algorithm>
+#include <tuple>
+
 namespace quic {
 
 bool hasAcksToSchedule(const AckState& ackState) {
@@ -81,6 +86,11 @@ FrameScheduler::Builder& FrameScheduler::Builder::simpleFrames() {
   return *this;
 }
 
+FrameScheduler::Builder& FrameScheduler::Builder::datagramFrames() {
+  datagramFrameScheduler_ = true;
+  return *this;
+}
+
 FrameScheduler FrameScheduler::Builder::build() && {
   FrameScheduler scheduler(std::move(name_));
   if (retransmissionScheduler_) {
@@ -109,6 +119,9 @@ FrameScheduler FrameScheduler::Builder::build() && {
   if (simpleFrameScheduler_) {
     scheduler.simpleFrameScheduler_.emplace(SimpleFrameScheduler(conn_));
   }
+  if (datagramFrameScheduler_) {
+    scheduler.datagramFrameScheduler_.emplace(DatagramFrameScheduler(conn_));
+  }
   return scheduler;
 }
 
@@ -127,16 +140,18 @@ FrameScheduler::scheduleFramesForPacket(
   // We cannot return early if the writablyBytes dropps to 0 here, since pure
   // acks can skip writableBytes entirely.
   PacketBuilderWrapper wrapper(builder, writableBytes);
-  auto ackMode = hasImmediateData() ? AckMode::Immediate : AckMode::Pending;
+  // The schedulers are asked once, the packet is written following the plan.
+  auto plan = pendingFrames();
+  auto ackMode = (plan & ~kAckFrames) ? AckMode::Immediate : AckMode::Pending;
   bool cryptoDataWritten = false;
   bool rstWritten = false;
-  if (cryptoStreamScheduler_ && cryptoStreamScheduler_->hasData()) {
+  if (plan & kCryptoFrames) {
     cryptoDataWritten = cryptoStreamScheduler_->writeCryptoData(wrapper);
   }
-  if (rstScheduler_ && rstScheduler_->hasPendingRsts()) {
+  if (plan & kRstFrames) {
     rstWritten = rstScheduler_->writeRsts(wrapper);
   }
-  if (ackScheduler_ && ackScheduler_->hasPendingAcks()) {
+  if (plan & kAckFrames) {
     if (cryptoDataWritten || rstWritten) {
       // If packet has non ack data, it is subject to congestion control. We
       // need to use the wrapper/
@@ -150,11 +165,10 @@ FrameScheduler::scheduleFramesForPacket(
       ackScheduler_->writeNextAcks(builder, ackMode);
     }
   }
-  if (windowUpdateScheduler_ &&
-      windowUpdateScheduler_->hasPendingWindowUpdates()) {
+  if (plan & kWindowUpdateFrames) {
     windowUpdateScheduler_->writeWindowUpdates(wrapper);
   }
-  if (blockedScheduler_ && blockedScheduler_->hasPendingBlockedFrames()) {
+  if (plan & kBlockedFrames) {
     blockedScheduler_->writeBlockedFrames(wrapper);
   }
   // Simple frames should be scheduled before stream frames and retx frames
@@ -162,36 +176,72 @@ FrameScheduler::scheduleFramesForPacket(
   // If we are trying to send a PathChallenge frame it may be blocked by those,
   // causing a connection to proceed slowly because of path validation rate
   // limiting.
-  if (simpleFrameScheduler_ &&
-      simpleFrameScheduler_->hasPendingSimpleFrames()) {
+  if (plan & kSimpleFrames) {
     simpleFrameScheduler_->writeSimpleFrames(wrapper);
   }
-  if (retransmissionScheduler_ && retransmissionScheduler_->hasPendingData()) {
+  // Datagrams go before the stream data, they are the latency sensitive
+  // traffic and their queue is bounded.
+  if (plan & kDatagramFrames) {
+    datagramFrameScheduler_->writeDatagramFrames(wrapper);
+  }
+  if (plan & kRetransmissionFrames) {
     retransmissionScheduler_->writeRetransmissionStreams(wrapper);
   }
-  if (streamFrameScheduler_ && streamFrameScheduler_->hasPendingData()) {
+  if (plan & kStreamFrames) {
     streamFrameScheduler_->writeStreams(wrapper);
   }
 
   return std::make_pair(folly::none, std::move(builder).buildPacket());
 }
 
+uint16_t FrameScheduler::pendingFrames() const {
+  uint16_t plan = kNoFrames;
+  auto check = [&](PendingFrames category, bool maybePending, auto&& pending) {
+    if (!maybePending || (drained_ & category)) {
+      return;
+    }
+    if (pending()) {
+      plan |= category;
+    } else {
+      drained_ |= (category & kDrainableFrames);
+    }
+  };
+  check(kCryptoFrames, cryptoStreamScheduler_.hasValue(), [&] {
+    return cryptoStreamScheduler_->hasData();
+  });
+  check(kRstFrames, rstScheduler_.hasValue(), [&] {
+    return rstScheduler_->hasPendingRsts();
+  });
+  check(kAckFrames, ackScheduler_.hasValue(), [&] {
+    return ackScheduler_->hasPendingAcks();
+  });
+  check(kWindowUpdateFrames, windowUpdateScheduler_.hasValue(), [&] {
+    return windowUpdateScheduler_->hasPendingWindowUpdates();
+  });
+  check(kBlockedFrames, blockedScheduler_.hasValue(), [&] {
+    return blockedScheduler_->hasPendingBlockedFrames();
+  });
+  check(kSimpleFrames, simpleFrameScheduler_.hasValue(), [&] {
+    return simpleFrameScheduler_->hasPendingSimpleFrames();
+  });
+  check(kDatagramFrames, datagramFrameScheduler_.hasValue(), [&] {
+    return datagramFrameScheduler_->hasPendingDatagramFrames();
+  });
+  check(kRetransmissionFrames, retransmissionScheduler_.hasValue(), [&] {
+    return retransmissionScheduler_->hasPendingData();
+  });
+  check(kStreamFrames, streamFrameScheduler_.hasValue(), [&] {
+    return streamFrameScheduler_->hasPendingData();
+  });
+  return plan;
+}
+
 bool FrameScheduler::hasData() const {
-  return (ackScheduler_ && ackScheduler_->hasPendingAcks()) ||
-      hasImmediateData();
+  return pendingFrames() != kNoFrames;
 }
 
 bool FrameScheduler::hasImmediateData() const {
-  return (cryptoStreamScheduler_ && cryptoStreamScheduler_->hasData()) ||
-      (retransmissionScheduler_ &&
-       retransmissionScheduler_->hasPendingData()) ||
-      (streamFrameScheduler_ && streamFrameScheduler_->hasPendingData()) ||
-      (rstScheduler_ && rstScheduler_->hasPendingRsts()) ||
-      (windowUpdateScheduler_ &&
-       windowUpdateScheduler_->hasPendingWindowUpdates()) ||
-      (blockedScheduler_ && blockedScheduler_->hasPendingBlockedFrames()) ||
-      (simpleFrameScheduler_ &&
-       simpleFrameScheduler_->hasPendingSimpleFrames());
+  return (pendingFrames() & ~kAckFrames) != kNoFrames;
 }
 
 std::string FrameScheduler::name() const {
@@ -204,9 +254,28 @@ RetransmissionScheduler::RetransmissionScheduler(
 
 void RetransmissionScheduler::writeRetransmissionStreams(
     PacketBuilderInterface& builder) {
+  // The lost data of the control streams goes first, then the streams in the
+  // order their new data is sent in, so the critical streams recover first.
+  orderedStreams_.clear();
   for (auto streamId : conn_.streamManager->lossStreams()) {
     auto stream = conn_.streamManager->findStream(streamId);
     CHECK(stream);
+    orderedStreams_.push_back(stream);
+  }
+  std::sort(
+      orderedStreams_.begin(),
+      orderedStreams_.end(),
+      [](const QuicStreamState* lhs, const QuicStreamState* rhs) {
+        return std::make_tuple(
+                   !lhs->isControl,
+                   PriorityQueue::levelIndex(lhs->priority),
+                   lhs->id) <
+            std::make_tuple(
+                   !rhs->isControl,
+                   PriorityQueue::levelIndex(rhs->priority),
+                   rhs->id);
+      });
+  for (auto stream : orderedStreams_) {
     for (auto buffer = stream->lossBuffer.cbegin();
          buffer != stream->lossBuffer.cend();
          ++buffer) {
@@ -240,54 +309,56 @@ StreamFrameScheduler::StreamFrameScheduler(QuicConnectionStateBase& conn)
 
 StreamId StreamFrameScheduler::writeStreamsHelper(
     PacketBuilderInterface& builder,
-    const std::set<StreamId>& writableStreams,
-    StreamId nextScheduledStream,
+    const PriorityQueue& writableStreams,
+    size_t levelIndex,
     uint64_t& connWritableBytes) {
-  MiddleStartingIterationWrapper wrapper(writableStreams, nextScheduledStream);
-  auto writableStreamItr = wrapper.cbegin();
-  // This will write the stream frames in a round robin fashion ordered by
-  // stream id. The iterator will wrap around the collection at the end, and we
-  // keep track of the value at the next iteration. This allows us to start
-  // writing at the next stream when building the next packet.
-  // TODO experiment with writing streams with an actual prioritization scheme.
-  while (writableStreamItr != wrapper.cend() && connWritableBytes > 0) {
-    if (writeNextStreamFrame(builder, *writableStreamItr, connWritableBytes)) {
-      writableStreamItr++;
-    } else {
+  const auto& level = writableStreams.levels()[levelIndex];
+  DCHECK(level.head);
+  // This will write the stream frames in a round robin fashion, going at most
+  // once around the ring of the level. The stream we stop at is returned, which
+  // allows us to start writing at the next stream when building the next
+  // packet.
+  StreamId streamId = *level.head;
+  for (size_t i = 0; i < level.size && connWritableBytes > 0; ++i) {
+    if (!writeNextStreamFrame(builder, streamId, connWritableBytes)) {
       break;
     }
+    streamId = writableStreams.nextInLevel(streamId);
+  }
+  return streamId;
+}
+
+void StreamFrameScheduler::writeStreamLevels(
+    PacketBuilderInterface& builder,
+    PriorityQueue& writableStreams,
+    uint64_t& connWritableBytes) {
+  const auto& levels = writableStreams.levels();
+  for (size_t index = 0; index < levels.size() && connWritableBytes > 0;
+       ++index) {
+    if (!levels[index].head) {
+      continue;
+    }
+    auto nextStream =
+        writeStreamsHelper(builder, writableStreams, index, connWritableBytes);
+    // A non incremental level keeps its head, so that one stream is finished
+    // before the next gets anything.
+    if (PriorityQueue::isIncremental(index)) {
+      writableStreams.setHead(index, nextStream);
+    }
   }
-  return *writableStreamItr;
 }
 
 void StreamFrameScheduler::writeStreams(PacketBuilderInterface& builder) {
   DCHECK(conn_.streamManager->hasWritable());
   uint64_t connWritableBytes = getSendConnFlowControlBytesWire(conn_);
-  if (connWritableBytes == 0) {
-    return;
-  }
   // Write the control streams first as a naive binary priority mechanism.
-  const auto& writableControlStreams =
-      conn_.streamManager->writableControlStreams();
-  if (!writableControlStreams.empty()) {
-    conn_.schedulingState.nextScheduledControlStream = writeStreamsHelper(
-        builder,
-        writableControlStreams,
-        conn_.schedulingState.nextScheduledControlStream,
-        connWritableBytes);
-  }
-  if (connWritableBytes == 0) {
-    return;
-  }
-  const auto& writableStreams = conn_.streamManager->writableStreams();
-  if (!writableStreams.empty()) {
-    conn_.schedulingState.nextScheduledStream = writeStreamsHelper(
-        builder,
-        writableStreams,
-        conn_.schedulingState.nextScheduledStream,
-        connWritableBytes);
-  }
-} // namespace quic
+  writeStreamLevels(
+      builder,
+      conn_.streamManager->writableControlStreams(),
+      connWritableBytes);
+  writeStreamLevels(
+      builder, conn_.streamManager->writableStreams(), connWritableBytes);
+}
 
 bool StreamFrameScheduler::hasPendingData() const {
   return conn_.streamManager->hasWritable() &&
@@ -388,6 +459,50 @@ bool SimpleFrameScheduler::writeSimpleFrames(PacketBuilderInterface& builder) {
   return framesWritten;
 }
 
+DatagramFrameScheduler::DatagramFrameScheduler(QuicConnectionStateBase& conn)
+    : conn_(conn) {}
+
+bool DatagramFrameScheduler::hasPendingDatagramFrames() const {
+  return !conn_.datagramState.writeBuffer.empty();
+}
+
+bool DatagramFrameScheduler::writeDatagramFrames(
+    PacketBuilderInterface& builder) {
+  auto& datagramState = conn_.datagramState;
+  auto& writeBuffer = datagramState.writeBuffer;
+  // Only held to their share while they would take the room of stream data.
+  bool limited = conn_.transportSettings.datagramWriteSharePercent < 100 &&
+      conn_.streamManager->hasWritable();
+  if (limited) {
+    datagramState.writeCredit = std::min<uint64_t>(
+        datagramState.writeCredit +
+            builder.remainingSpaceInPkt() *
+                conn_.transportSettings.datagramWriteSharePercent / 100,
+        conn_.udpSendPacketLen);
+  }
+  bool framesWritten = false;
+  while (!writeBuffer.empty()) {
+    auto length = writeBuffer.front().data->computeChainDataLength();
+    QuicInteger intFrameType(static_cast<uint8_t>(FrameType::DATAGRAM_LEN));
+    QuicInteger lengthInt(length);
+    auto frameSize = intFrameType.getSize() + lengthInt.getSize() + length;
+    if (frameSize > builder.remainingSpaceInPkt() ||
+        (limited && frameSize > datagramState.writeCredit)) {
+      // Left for the next packet.
+      break;
+    }
+    auto bytesWritten = writeFrame(
+        DatagramFrame(length, std::move(writeBuffer.front().data)), builder);
+    CHECK_GT(bytesWritten, 0);
+    writeBuffer.pop_front();
+    if (limited) {
+      datagramState.writeCredit -= frameSize;
+    }
+    framesWritten = true;
+  }
+  return framesWritten;
+}
+
 WindowUpdateScheduler::WindowUpdateScheduler(
     const QuicConnectionStateBase& conn)
     : conn_(conn) {}
@@ -407,22 +522,46 @@ void WindowUpdateScheduler::writeWindowUpdates(
       VLOG(4) << "Wrote max_data=" << maximumData << " " << conn_;
     }
   }
+  const auto& urgentWindowUpdates = conn_.streamManager->urgentWindowUpdates();
+  for (const auto& windowUpdateStream : urgentWindowUpdates) {
+    if (!writeStreamWindowUpdate(builder, windowUpdateStream)) {
+      return;
+    }
+  }
+  if (urgentWindowUpdates.size() ==
+      conn_.streamManager->windowUpdates().size()) {
+    return;
+  }
+  PacketBuilderWrapper coalescedBuilder(
+      builder, conn_.transportSettings.maxCoalescedWindowUpdateBytes);
   for (const auto& windowUpdateStream : conn_.streamManager->windowUpdates()) {
-    auto stream = conn_.streamManager->findStream(windowUpdateStream);
-    if (!stream) {
+    if (urgentWindowUpdates.count(windowUpdateStream)) {
       continue;
     }
-    auto maxStreamDataFrame = generateMaxStreamDataFrame(*stream);
-    auto maximumData = maxStreamDataFrame.maximumData;
-    auto bytes = writeFrame(std::move(maxStreamDataFrame), builder);
-    if (!bytes) {
+    if (!writeStreamWindowUpdate(coalescedBuilder, windowUpdateStream)) {
       break;
     }
-    VLOG(4) << "Wrote max_stream_data stream=" << stream->id
-            << " maximumData=" << maximumData << " " << conn_;
   }
 }
 
+bool WindowUpdateScheduler::writeStreamWindowUpdate(
+    PacketBuilderInterface& builder,
+    StreamId streamId) {
+  auto stream = conn_.streamManager->findStream(streamId);
+  if (!stream) {
+    return true;
+  }
+  auto maxStreamDataFrame = generateMaxStreamDataFrame(*stream);
+  auto maximumData = maxStreamDataFrame.maximumData;
+  auto bytes = writeFrame(std::move(maxStreamDataFrame), builder);
+  if (!bytes) {
+    return false;
+  }
+  VLOG(4) << "Wrote max_stream_data stream=" << stream->id
+          << " maximumData=" << maximumData << " " << conn_;
+  return true;
+}
+
 BlockedScheduler::BlockedScheduler(const QuicConnectionStateBase& conn)
     : conn_(conn) {}
 
@@ -549,13 +688,9 @@ CloningScheduler::scheduleFramesForPacket(
         std::move(builder), writableBytes);
   }
   // Look for an outstanding packet that's no larger than the writableBytes
-  for (auto iter = conn_.outstandingPackets.rbegin();
-       iter != conn_.outstandingPackets.rend();
+  auto& appDataPackets = conn_.outstandingPackets[PacketNumberSpace::AppData];
+  for (auto iter = appDataPackets.rbegin(); iter != appDataPackets.rend();
        ++iter) {
-    auto opPnSpace = iter->packet.header.getPacketNumberSpace();
-    if (opPnSpace != PacketNumberSpace::AppData) {
-      continue;
-    }
     // Reusing the RegularQuicPacketBuilder throughout loop bodies will lead to
     // frames belong to different original packets being written into the same
     // clone packet. So re-create a RegularQuicPacketBuilder every time.
@@ -600,4 +735,34 @@ CloningScheduler::scheduleFramesForPacket(
 std::string CloningScheduler::name() const {
   return name_;
 }
+
+PmtuProbeScheduler::PmtuProbeScheduler(const QuicConnectionStateBase& conn)
+    : conn_(conn) {}
+
+bool PmtuProbeScheduler::hasData() const {
+  return hasPendingPmtuProbe(conn_);
+}
+
+std::pair<
+    folly::Optional<PacketEvent>,
+    folly::Optional<RegularQuicPacketBuilder::Packet>>
+PmtuProbeScheduler::scheduleFramesForPacket(
+    RegularQuicPacketBuilder&& builder,
+    uint32_t writableBytes) {
+  writableBytes = writableBytes > builder.getHeaderBytes()
+      ? writableBytes - builder.getHeaderBytes()
+      : 0;
+  PacketBuilderWrapper wrapper(builder, writableBytes);
+  if (!writeSimpleFrame(PingFrame(), wrapper)) {
+    return std::make_pair(folly::none, folly::none);
+  }
+  while (wrapper.remainingSpaceInPkt() > 0) {
+    writeFrame(PaddingFrame(), wrapper);
+  }
+  return std::make_pair(folly::none, std::move(builder).buildPacket());
+}
+
+std::string PmtuProbeScheduler::name() const {
+  return "PmtuProbeScheduler";
+}
 } // namespace quic
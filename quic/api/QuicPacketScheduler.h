@@ -8,7 +8,6 @@
 
 #pragma once
 
-#include <boost/iterator/iterator_facade.hpp>
 #include <folly/Overload.h>
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
@@ -16,6 +15,7 @@
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/state/QuicPriorityQueue.h>
 #include <quic/state/QuicStreamFunctions.h>
 
 namespace quic {
@@ -66,6 +66,9 @@ class RetransmissionScheduler {
 
  private:
   const QuicConnectionStateBase& conn_;
+  // the streams with lost data in retransmission order, reused by the packets
+  // of the burst
+  std::vector<QuicStreamState*> orderedStreams_;
 };
 
 class StreamFrameScheduler {
@@ -82,91 +85,20 @@ class StreamFrameScheduler {
 
  private:
   /**
-   * A helper iterator adaptor class that starts iteration of streams from a
-   * specific stream id.
+   * Writes the streams of one level of the queue, going around its ring from
+   * the head. Returns the stream the writing stopped at, which is where the
+   * next round should start.
    */
-  class MiddleStartingIterationWrapper {
-   public:
-    using MapType = std::set<StreamId>;
-
-    class MiddleStartingIterator
-        : public boost::iterator_facade<
-              MiddleStartingIterator,
-              const MiddleStartingIterationWrapper::MapType::value_type,
-              boost::forward_traversal_tag> {
-      friend class boost::iterator_core_access;
-
-     public:
-      using MapType = MiddleStartingIterationWrapper::MapType;
-
-      MiddleStartingIterator() = default;
-
-      MiddleStartingIterator(
-          const MapType* streams,
-          const MapType::key_type& start)
-          : streams_(streams) {
-        itr_ = streams_->lower_bound(start);
-        checkForWrapAround();
-        // We don't want to mark it as wrapped around initially, instead just
-        // act as if start was the first element.
-        wrappedAround_ = false;
-      }
-
-      const MapType::value_type& dereference() const {
-        return *itr_;
-      }
-
-      bool equal(const MiddleStartingIterator& other) const {
-        return wrappedAround_ == other.wrappedAround_ && itr_ == other.itr_;
-      }
-
-      void increment() {
-        ++itr_;
-        checkForWrapAround();
-      }
-
-      void checkForWrapAround() {
-        if (itr_ == streams_->cend()) {
-          wrappedAround_ = true;
-          itr_ = streams_->cbegin();
-        }
-      }
-
-     private:
-      friend class MiddleStartingIterationWrapper;
-      bool wrappedAround_{false};
-      const MapType* streams_{nullptr};
-      MapType::const_iterator itr_;
-    };
-
-    MiddleStartingIterationWrapper(
-        const MapType& streams,
-        const MapType::key_type& start)
-        : streams_(streams), start_(start) {}
-
-    MiddleStartingIterator cbegin() const {
-      return MiddleStartingIterator(&streams_, start_);
-    }
-
-    MiddleStartingIterator cend() const {
-      MiddleStartingIterator itr(&streams_, start_);
-      itr.wrappedAround_ = true;
-      return itr;
-    }
-
-   private:
-    const MapType& streams_;
-    const MapType::key_type& start_;
-  };
-
   StreamId writeStreamsHelper(
       PacketBuilderInterface& builder,
-      const std::set<StreamId>& writableStreams,
-      StreamId nextScheduledStream,
+      const PriorityQueue& writableStreams,
+      size_t levelIndex,
       uint64_t& connWritableBytes);
 
-  using WritableStreamItr =
-      MiddleStartingIterationWrapper::MiddleStartingIterator;
+  void writeStreamLevels(
+      PacketBuilderInterface& builder,
+      PriorityQueue& writableStreams,
+      uint64_t& connWritableBytes);
 
   /**
    * Helper function to write either stream data if stream is not flow
@@ -250,15 +182,45 @@ class SimpleFrameScheduler {
   const QuicConnectionStateBase& conn_;
 };
 
+/*
+ * Writes the datagrams the app queued, oldest first, as many as fit in the
+ * packet. They are not retransmitted, the payloads go to the packet builder
+ * as they were written. While there is stream data to write they only take
+ * datagramWriteSharePercent of the packets, as credit kept across packets
+ * so that a datagram larger than its share of one packet still goes.
+ */
+class DatagramFrameScheduler {
+ public:
+  explicit DatagramFrameScheduler(QuicConnectionStateBase& conn);
+
+  bool hasPendingDatagramFrames() const;
+
+  bool writeDatagramFrames(PacketBuilderInterface& builder);
+
+ private:
+  QuicConnectionStateBase& conn_;
+};
+
 class WindowUpdateScheduler {
  public:
   explicit WindowUpdateScheduler(const QuicConnectionStateBase& conn);
 
   bool hasPendingWindowUpdates() const;
 
+  /**
+   * Writes the connection window update and the urgent stream window updates,
+   * and then as many of the rest as the space coalesced updates can take.
+   */
   void writeWindowUpdates(PacketBuilderInterface& builder);
 
  private:
+  /**
+   * Returns false if the packet has no room for the update.
+   */
+  bool writeStreamWindowUpdate(
+      PacketBuilderInterface& builder,
+      StreamId streamId);
+
   const QuicConnectionStateBase& conn_;
 };
 
@@ -328,6 +290,7 @@ class FrameScheduler : public QuicPacketScheduler {
     Builder& blockedFrames();
     Builder& cryptoFrames();
     Builder& simpleFrames();
+    Builder& datagramFrames();
 
     FrameScheduler build() &&;
 
@@ -346,6 +309,7 @@ class FrameScheduler : public QuicPacketScheduler {
     bool blockedScheduler_{false};
     bool cryptoStreamScheduler_{false};
     bool simpleFrameScheduler_{false};
+    bool datagramFrameScheduler_{false};
   };
 
   explicit FrameScheduler(std::string name);
@@ -366,6 +330,30 @@ class FrameScheduler : public QuicPacketScheduler {
   virtual std::string name() const override;
 
  private:
+  // The frame categories of the schedulers, as bits of a plan.
+  enum PendingFrames : uint16_t {
+    kNoFrames = 0,
+    kCryptoFrames = 1 << 0,
+    kRstFrames = 1 << 1,
+    kAckFrames = 1 << 2,
+    kWindowUpdateFrames = 1 << 3,
+    kBlockedFrames = 1 << 4,
+    kSimpleFrames = 1 << 5,
+    kDatagramFrames = 1 << 6,
+    kRetransmissionFrames = 1 << 7,
+    kStreamFrames = 1 << 8,
+  };
+
+  // Nothing is added to these while the scheduler's packets are written, so
+  // once empty they stay empty for the rest of its burst. Blocked frames are
+  // queued by stream writes, and stream data shrinks but is cheap to check.
+  static constexpr uint16_t kDrainableFrames = kCryptoFrames | kRstFrames |
+      kAckFrames | kWindowUpdateFrames | kSimpleFrames | kDatagramFrames |
+      kRetransmissionFrames;
+
+  // The categories with something to write, each scheduler asked once.
+  uint16_t pendingFrames() const;
+
   folly::Optional<RetransmissionScheduler> retransmissionScheduler_;
   folly::Optional<StreamFrameScheduler> streamFrameScheduler_;
   folly::Optional<AckScheduler> ackScheduler_;
@@ -374,7 +362,10 @@ class FrameScheduler : public QuicPacketScheduler {
   folly::Optional<BlockedScheduler> blockedScheduler_;
   folly::Optional<CryptoStreamScheduler> cryptoStreamScheduler_;
   folly::Optional<SimpleFrameScheduler> simpleFrameScheduler_;
+  folly::Optional<DatagramFrameScheduler> datagramFrameScheduler_;
   std::string name_;
+  // the drainable categories found empty so far, skipped from then on
+  mutable uint16_t drained_{kNoFrames};
 };
 
 /**
@@ -419,5 +410,29 @@ class CloningScheduler : public QuicPacketScheduler {
   std::string name_;
   uint64_t cipherOverhead_;
 };
+
+/**
+ * Writes the path MTU probe, a PING padded to the writable bytes. The
+ * builder it is given has to be of the probe's size, larger than
+ * udpSendPacketLen, see writePmtuProbeToSocket.
+ */
+class PmtuProbeScheduler : public QuicPacketScheduler {
+ public:
+  explicit PmtuProbeScheduler(const QuicConnectionStateBase& conn);
+
+  bool hasData() const override;
+
+  std::pair<
+      folly::Optional<PacketEvent>,
+      folly::Optional<RegularQuicPacketBuilder::Packet>>
+  scheduleFramesForPacket(
+      RegularQuicPacketBuilder&& builder,
+      uint32_t writableBytes) override;
+
+  std::string name() const override;
+
+ private:
+  const QuicConnectionStateBase& conn_;
+};
 } // namespace quic
 #include <quic/api/QuicPacketScheduler-inl.h>
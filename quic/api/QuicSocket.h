@@ -10,12 +10,14 @@
 
 #include <folly/Expected.h>
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
 #include <quic/QuicConstants.h>
 #include <quic/codec/Types.h>
 #include <quic/state/StateData.h>
 
 #include <chrono>
+#include <vector>
 
 namespace folly {
 class EventBase;
@@ -23,6 +25,8 @@ class EventBase;
 
 namespace quic {
 
+class CrossThreadWriteQueue;
+
 class QuicSocket {
  public:
   /**
@@ -109,10 +113,31 @@ class QuicSocket {
     uint64_t bytesAcked{0};
     uint64_t bytesRecvd{0};
     uint64_t totalBytesRetransmitted{0};
+    // Stream data held by the transport, split into the bytes not yet written
+    // to the socket and the ones written but not yet acked.
+    uint64_t streamBytesBuffered{0};
+    uint64_t streamBytesUnacked{0};
+    // Delivery rate of the latest rate sample in bytes per second, and
+    // whether the sample was taken while app limited.
+    uint64_t deliveryRate{0};
+    bool deliveryRateAppLimited{false};
     uint32_t ptoCount{0};
     uint32_t totalPTOCount{0};
     PacketNum largestPacketAckedByPeer{0};
     PacketNum largestPacketSent{0};
+    // Histograms of the connection's latencies so far
+    ConnectionLatencyHistograms latencyHistograms;
+    // Addresses the happy eyeballs race attempted, and whether the second
+    // socket won it.
+    uint32_t happyEyeballsAttempts{0};
+    bool happyEyeballsSecondSocketWon{false};
+    // Whether the connection attempted 0-RTT, whether the peer accepted it
+    // once that is known, and the 0-RTT packets it wrote.
+    bool zeroRttAttempted{false};
+    folly::Optional<bool> zeroRttAccepted;
+    uint64_t zeroRttPacketsSent{0};
+    // Datagrams dropped for missing the maxDelay they were written with
+    uint64_t datagramsExpired{0};
   };
 
   /**
@@ -128,6 +153,12 @@ class QuicSocket {
 
     // Is the stream head-of-line blocked?
     bool isHolb{false};
+
+    // Bytes the stream has not yet written to the socket.
+    uint64_t bytesBuffered{0};
+
+    // Bytes written to the socket that are kept until they are acked.
+    uint64_t bytesUnacked{0};
   };
 
   /**
@@ -407,6 +438,19 @@ class QuicSocket {
      */
     virtual void readAvailable(StreamId id) noexcept = 0;
 
+    /**
+     * Called instead of readAvailable with all the streams this callback is
+     * set on that are readable at once, when the batchReadCallbacks
+     * transport setting is on. They were all readable when the call was
+     * made, reading one can close the others or the connection.
+     */
+    virtual void readAvailableBatch(
+        folly::Range<const StreamId*> ids) noexcept {
+      for (auto id : ids) {
+        readAvailable(id);
+      }
+    }
+
     /**
      * Called from the transport layer when there is an error on the stream.
      */
@@ -483,6 +527,9 @@ class QuicSocket {
    * occured and it can be obtained with error().  If the value hasValue(), then
    * value() returns a pair of the data (if any) and the EOF marker.
    *
+   * Contiguous received data is kept as a single chain, reading all of it, as
+   * peek() presents it, moves that chain out without splitting or copying it.
+   *
    * Calling read() when there is no data/eof to deliver will return an
    * EAGAIN-like error code.
    */
@@ -513,7 +560,7 @@ class QuicSocket {
    * };
    */
 
-  using PeekIterator = std::deque<StreamBuffer>::const_iterator;
+  using PeekIterator = StreamReadBuffer::const_iterator;
   class PeekCallback {
    public:
     virtual ~PeekCallback() = default;
@@ -780,6 +827,21 @@ class QuicSocket {
         uint64_t offset,
         std::chrono::microseconds rtt) = 0;
 
+    /**
+     * Invoked instead of onDeliveryAck when an ack delivers several offsets
+     * of the stream this callback is registered for, in a row, in increasing
+     * order. Callbacks registered for many offsets can override it to handle
+     * them with one call.
+     */
+    virtual void onDeliveryAckBatch(
+        StreamId id,
+        folly::Range<const uint64_t*> offsets,
+        std::chrono::microseconds rtt) {
+      for (auto offset : offsets) {
+        onDeliveryAck(id, offset, rtt);
+      }
+    }
+
     /**
      * Invoked on registered delivery callbacks when the bytes will never be
      * delivered (due to a reset or other error).
@@ -811,6 +873,55 @@ class QuicSocket {
       bool cork,
       DeliveryCallback* cb = nullptr) = 0;
 
+  struct StreamWrite {
+    StreamId id;
+    Buf data;
+    bool eof{false};
+    DeliveryCallback* cb{nullptr};
+
+    StreamWrite(
+        StreamId idIn,
+        Buf dataIn,
+        bool eofIn = false,
+        DeliveryCallback* cbIn = nullptr)
+        : id(idIn), data(std::move(dataIn)), eof(eofIn), cb(cbIn) {}
+  };
+
+  /**
+   * Write data/eof to several streams at once. Each write behaves like
+   * writeChain and gets its result at the same position of the returned
+   * vector, but the transport is only scheduled to write once, after all of
+   * them. To send the same payload on many streams, pass a clone of it for
+   * each stream, which shares the buffer instead of copying it.
+   */
+  virtual std::vector<WriteResult> writeChains(
+      std::vector<StreamWrite> writes,
+      bool cork) = 0;
+
+  /**
+   * Opens a bidirectional stream for a single request and its response: the
+   * request is written with eof and cb is set as the stream's read callback,
+   * with the transport scheduled to write once. The stream is closed, and
+   * its state reused, as soon as the response is read up to eof. Passing a
+   * delivery callback registers it for the end of the request.
+   *
+   * Returns the id of the stream, or the error of whichever step failed.
+   */
+  virtual folly::Expected<StreamId, LocalErrorCode> sendRequest(
+      Buf request,
+      ReadCallback* cb,
+      DeliveryCallback* deliveryCb = nullptr,
+      bool replaySafe = true) = 0;
+
+  /**
+   * The queue other threads submit writes to the transport through, made on
+   * the first call, which must be on the transport's event base. nullptr
+   * without a crossThreadWriteQueueCapacity.
+   */
+  virtual std::shared_ptr<CrossThreadWriteQueue> getCrossThreadWriteQueue() {
+    return nullptr;
+  }
+
   /**
    * Register a callback to be invoked when the peer has acknowledged the
    * given offset on the given stream
@@ -910,9 +1021,87 @@ class QuicSocket {
    */
   virtual folly::Optional<LocalErrorCode> setControlStream(StreamId id) = 0;
 
+  /**
+   * Set the priority of a stream. Streams at a lower level are sent before
+   * the ones at higher levels, the levels go from 0 to kMaxPriorityLevel.
+   * Incremental streams of a level share it round robin, non incremental ones
+   * are sent one at a time in stream id order ahead of them. Streams start out
+   * with kDefaultPriority, control streams are sent ahead of all of them.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> setStreamPriority(
+      StreamId id,
+      PriorityLevel level,
+      bool incremental) = 0;
+
+  /**
+   * Experimental: protect the tail of a stream with STREAM_REPAIR frames,
+   * sent when the connection goes idle, so that the peer can rebuild a lost
+   * stream frame without waiting for it to be retransmitted. Takes effect if
+   * the peer advertised it takes them and streamRepairBudget allows it. Meant
+   * for latency sensitive streams that send small responses.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> setStreamRepair(
+      StreamId id) = 0;
+
   /**
    * Set congestion control type.
    */
   virtual void setCongestionControl(CongestionControlType type) = 0;
+
+  /**
+   * ===== Datagram API =====
+   *
+   * Unreliable DATAGRAM frames, sent if both ends enabled them with
+   * maxRecvDatagramFrameSize. They are not retransmitted, nor flow
+   * controlled, only congestion controlled. The send and receive queues are
+   * bounded by datagramWriteBufferSize and datagramReadBufferSize, the oldest
+   * datagram is dropped to make room for a new one.
+   */
+
+  /**
+   * Callback class for received datagrams
+   */
+  class DatagramCallback {
+   public:
+    virtual ~DatagramCallback() = default;
+
+    /**
+     * Invoked after reading from the network while there are datagrams to
+     * read.
+     */
+    virtual void onDatagramsAvailable() noexcept = 0;
+  };
+
+  /**
+   * Set the callback for received datagrams, nullptr to unset it.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> setDatagramCallback(
+      DatagramCallback* cb) = 0;
+
+  /**
+   * Returns the largest datagram payload that can be written, 0 while the
+   * peer takes no datagrams.
+   */
+  virtual uint16_t getDatagramSizeLimit() const = 0;
+
+  /**
+   * Queues a datagram to send. The buffer is handed to the packet builder as
+   * it is, it must not be changed afterwards. Fails with INVALID_WRITE_DATA
+   * if it is larger than getDatagramSizeLimit().
+   *
+   * With maxDelay, the datagram is dropped instead of sent if it could not
+   * be sent within that long, e.g. behind the congestion window.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf buf,
+      folly::Optional<std::chrono::microseconds> maxDelay = folly::none) = 0;
+
+  /**
+   * Returns the received datagrams, oldest first, at most atMost of them or
+   * all of them when atMost is 0. The buffers are the ones of the received
+   * packets.
+   */
+  virtual folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost = 0) = 0;
 };
 } // namespace quic
@@ -10,11 +10,16 @@
 
 #include <folly/ScopeGuard.h>
 #include <quic/api/LoopDetectorCallback.h>
+#include <quic/api/QuicBatchWriter.h>
 #include <quic/api/QuicTransportFunctions.h>
+#include <quic/common/PipelineTiming.h>
 #include <quic/common/TimeUtil.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
 #include <quic/congestion_control/Pacer.h>
+#include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/logging/QLoggerConstants.h>
 #include <quic/loss/QuicLossFunctions.h>
+#include <quic/state/AckHandlers.h>
 #include <quic/state/QuicPacingFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
@@ -33,6 +38,7 @@ QuicTransportBase::QuicTransportBase(
       ackTimeout_(this),
       pathValidationTimeout_(this),
       idleTimeout_(this),
+      idleMemoryReleaseTimeout_(this),
       drainTimeout_(this),
       pingTimeout_(this),
       readLooper_(new FunctionLooper(
@@ -48,7 +54,7 @@ QuicTransportBase::QuicTransportBase(
           [this](bool fromTimer) { pacedWriteDataToSocket(fromTimer); },
           LooperType::WriteLooper)) {
   writeLooper_->setPacingFunction([this]() -> auto {
-    if (isConnectionPaced(*conn_)) {
+    if (isConnectionPaced(*conn_) && !isConnectionPacedInKernel(*conn_)) {
       conn_->pacer->onPacedWriteScheduled(Clock::now());
       return conn_->pacer->getTimeUntilNextWrite();
     }
@@ -63,12 +69,116 @@ void QuicTransportBase::setPacingTimer(
   }
 }
 
+void QuicTransportBase::setPacingCalendar(
+    std::shared_ptr<PacingCalendar> calendar) noexcept {
+  writeLooper_->setPacingCalendar(std::move(calendar));
+}
+
+void QuicTransportBase::setLooperQueue(
+    std::shared_ptr<LooperQueue> queue) noexcept {
+  readLooper_->setLooperQueue(queue);
+  peekLooper_->setLooperQueue(queue);
+  writeLooper_->setLooperQueue(std::move(queue));
+}
+
+void QuicTransportBase::setCoarseClock(
+    std::shared_ptr<CoarseClock> clock) noexcept {
+  conn_->coarseClock = std::move(clock);
+}
+
+void QuicTransportBase::setFlowControlWindowBudget(
+    std::shared_ptr<FlowControlWindowBudget> budget) noexcept {
+  // What was taken out of the old budget goes back to it.
+  releaseFlowControlWindowBudget(*conn_);
+  conn_->flowControlWindowBudget = std::move(budget);
+}
+
+void QuicTransportBase::setPacketBufferPool(
+    std::shared_ptr<PacketBufferPool> pool) noexcept {
+  conn_->bufPool = std::move(pool);
+}
+
+void QuicTransportBase::setMultiDestBatchWriter(
+    std::shared_ptr<MultiDestBatchWriter> writer) noexcept {
+  conn_->multiDestBatchWriter = std::move(writer);
+}
+
+void QuicTransportBase::setXdpSocket(
+    std::shared_ptr<XdpSocket> xdpSocket) noexcept {
+  conn_->xdpSocket = std::move(xdpSocket);
+}
+
+void QuicTransportBase::setCryptoWorkerPool(
+    std::shared_ptr<CryptoWorkerPool> workers) noexcept {
+  conn_->cryptoWorkers = std::move(workers);
+}
+
+void QuicTransportBase::setSocketTxTimeEnabled(bool enabled) noexcept {
+  conn_->socketTxTimeEnabled = enabled;
+}
+
+void QuicTransportBase::setDeferredWriteScheduler(
+    std::shared_ptr<DeferredWriteScheduler> scheduler) noexcept {
+  if (deferredWriteScheduler_) {
+    deferredWriteScheduler_->cancelWrite(this);
+  }
+  deferredWriteScheduler_ = std::move(scheduler);
+}
+
+uint64_t QuicTransportBase::writeDeferredData(
+    folly::Optional<uint64_t> maxBytes) {
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  auto bytesBefore = conn_->lossState.totalBytesSent;
+  if (maxBytes) {
+    // Rounded up, the scheduler takes what goes over out of the next turn.
+    conn_->writePacketLimit = std::max<uint64_t>(
+        1,
+        (*maxBytes + conn_->udpSendPacketLen - 1) / conn_->udpSendPacketLen);
+  }
+  pacedWriteDataToSocket(false);
+  conn_->writePacketLimit = folly::none;
+  return conn_->lossState.totalBytesSent - bytesBefore;
+}
+
 void QuicTransportBase::setCongestionControllerFactory(
     std::shared_ptr<CongestionControllerFactory> ccFactory) {
   CHECK(ccFactory);
   ccFactory_ = ccFactory;
 }
 
+void QuicTransportBase::setCongestionStateCache(
+    std::shared_ptr<CongestionStateCache> cache,
+    std::string key) {
+  congestionStateCache_ = std::move(cache);
+  congestionStateCacheKey_ = std::move(key);
+}
+
+void QuicTransportBase::maybeWarmStartCongestionControl() {
+  if (!congestionStateCache_ || !conn_->congestionController ||
+      conn_->lossState.totalBytesSent > 0) {
+    return;
+  }
+  auto state =
+      congestionStateCache_->getCongestionState(congestionStateCacheKey_);
+  if (!state) {
+    return;
+  }
+  auto cwnd = warmStartCwnd(*conn_, *state, std::chrono::system_clock::now());
+  if (!cwnd || !ccFactory_) {
+    return;
+  }
+  VLOG(4) << "Warm starting with cwnd=" << *cwnd
+          << " cached cwnd=" << state->cwndBytes
+          << " bandwidth=" << state->bandwidthBytesPerSec
+          << " minRtt=" << state->minRtt.count() << " " << *this;
+  conn_->warmStartCwndBytes = cwnd;
+  conn_->congestionController = ccFactory_->makeCongestionController(
+      *conn_, conn_->congestionController->type());
+  if (conn_->pacer && state->minRtt > 0us) {
+    conn_->pacer->refreshPacingRate(*cwnd, state->minRtt);
+  }
+}
+
 folly::EventBase* QuicTransportBase::getEventBase() const {
   return evb_.load();
 }
@@ -117,6 +227,9 @@ QuicTransportBase::~QuicTransportBase() {
           QuicErrorCode(LocalErrorCode::SHUTTING_DOWN),
           std::string("Closing from base destructor")),
       false);
+  if (deferredWriteScheduler_) {
+    deferredWriteScheduler_->cancelWrite(this);
+  }
   // If a drainTimeout is already scheduled, then closeNow above
   // won't do anything. We have to manually clean up the socket. Timeout will be
   // canceled by timer's destructor.
@@ -124,7 +237,7 @@ QuicTransportBase::~QuicTransportBase() {
     auto sock = std::move(socket_);
     socket_ = nullptr;
     sock->pauseRead();
-    sock->close();
+    closeAfterZeroCopySends(std::move(sock), std::move(conn_->zeroCopyTracker));
   }
 }
 
@@ -256,6 +369,16 @@ void QuicTransportBase::closeImpl(
         totalCryptoDataRecvd);
   }
 
+  if (congestionStateCache_) {
+    auto state =
+        makeCachedCongestionState(*conn_, std::chrono::system_clock::now());
+    if (state) {
+      congestionStateCache_->putCongestionState(
+          congestionStateCacheKey_, std::move(*state));
+    }
+  }
+  releaseFlowControlWindowBudget(*conn_);
+
   // TODO: truncate the error code string to be 1MSS only.
   closeState_ = CloseState::CLOSED;
   updatePacingOnClose(*conn_);
@@ -272,7 +395,10 @@ void QuicTransportBase::closeImpl(
   LocalErrorCode* localError = cancelCode.first.asLocalErrorCode();
   if (localError) {
     isReset = *localError == LocalErrorCode::CONNECTION_RESET;
-    isAbandon = *localError == LocalErrorCode::CONNECTION_ABANDONED;
+    // A connection handed off to another process carries on there, the peer
+    // must not see it close.
+    isAbandon = *localError == LocalErrorCode::CONNECTION_ABANDONED ||
+        *localError == LocalErrorCode::CONNECTION_HANDED_OFF;
   }
   VLOG_IF(4, isReset) << "Closing transport due to stateless reset " << *this;
   VLOG_IF(4, isAbandon) << "Closing transport due to abandoned connection "
@@ -322,6 +448,9 @@ void QuicTransportBase::closeImpl(
   if (idleTimeout_.isScheduled()) {
     idleTimeout_.cancelTimeout();
   }
+  if (idleMemoryReleaseTimeout_.isScheduled()) {
+    idleMemoryReleaseTimeout_.cancelTimeout();
+  }
   if (pingTimeout_.isScheduled()) {
     pingTimeout_.cancelTimeout();
   }
@@ -330,6 +459,9 @@ void QuicTransportBase::closeImpl(
   readLooper_->stop();
   peekLooper_->stop();
   writeLooper_->stop();
+  if (deferredWriteScheduler_) {
+    deferredWriteScheduler_->cancelWrite(this);
+  }
 
   // TODO: invoke connection close callbacks.
   cancelAllAppCallbacks(cancelCode);
@@ -384,10 +516,15 @@ void QuicTransportBase::closeImpl(
 
   // can't invoke connection callbacks any more.
   connCallback_ = nullptr;
+  datagramCallback_ = nullptr;
+  conn_->datagramState.writeBuffer.clear();
+  conn_->datagramState.readBuffer.clear();
 
   // Don't need outstanding packets.
   conn_->outstandingPackets.clear();
+  conn_->outstandingPacketEvents.clear();
   conn_->outstandingHandshakePacketsCount = 0;
+  conn_->outstandingClonedPacketsCount = 0;
 
   // We don't need no congestion control.
   conn_->congestionController = nullptr;
@@ -407,10 +544,13 @@ void QuicTransportBase::closeImpl(
   if (drainConnection) {
     // We ever drain once, and the object ever gets created once.
     DCHECK(!drainTimeout_.isScheduled());
-    getEventBase()->timer().scheduleTimeout(
-        &drainTimeout_,
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            kDrainFactor * calculatePTO(*conn_)));
+    auto drainPeriod = std::chrono::duration_cast<std::chrono::milliseconds>(
+        kDrainFactor * calculatePTO(*conn_));
+    if (delegateDrain(drainPeriod)) {
+      drainTimeoutExpired();
+    } else {
+      getEventBase()->timer().scheduleTimeout(&drainTimeout_, drainPeriod);
+    }
   } else {
     drainTimeoutExpired();
   }
@@ -421,7 +561,7 @@ void QuicTransportBase::drainTimeoutExpired() noexcept {
     auto sock = std::move(socket_);
     socket_ = nullptr;
     sock->pauseRead();
-    sock->close();
+    closeAfterZeroCopySends(std::move(sock), std::move(conn_->zeroCopyTracker));
   }
   unbindConnection();
 }
@@ -519,6 +659,16 @@ QuicSocket::TransportInfo QuicTransportBase::getTransportInfo() const {
   transportInfo.timeoutBasedLoss = conn_->lossState.timeoutBasedRtxCount;
   transportInfo.totalBytesRetransmitted =
       conn_->lossState.totalBytesRetransmitted;
+  transportInfo.streamBytesBuffered =
+      conn_->flowControlState.sumCurStreamBufferLen;
+  transportInfo.streamBytesUnacked =
+      conn_->flowControlState.sumUnackedStreamBufferLen;
+  if (conn_->lossState.lastRateSample) {
+    transportInfo.deliveryRate =
+        conn_->lossState.lastRateSample->deliveryRate();
+    transportInfo.deliveryRateAppLimited =
+        conn_->lossState.lastRateSample->isAppLimited;
+  }
   transportInfo.pto = calculatePTO(*conn_);
   transportInfo.bytesSent = conn_->lossState.totalBytesSent;
   transportInfo.bytesAcked = conn_->lossState.totalBytesAcked;
@@ -528,6 +678,14 @@ QuicSocket::TransportInfo QuicTransportBase::getTransportInfo() const {
   transportInfo.largestPacketAckedByPeer =
       conn_->ackStates.appDataAckState.largestAckedByPeer;
   transportInfo.largestPacketSent = conn_->lossState.largestSent;
+  transportInfo.latencyHistograms = conn_->latencyHistograms;
+  transportInfo.happyEyeballsAttempts = conn_->happyEyeballsState.attempts;
+  transportInfo.happyEyeballsSecondSocketWon =
+      conn_->happyEyeballsState.secondSocketWon;
+  transportInfo.zeroRttAttempted = conn_->zeroRttState.attempted;
+  transportInfo.zeroRttAccepted = conn_->zeroRttState.accepted;
+  transportInfo.zeroRttPacketsSent = conn_->zeroRttState.packetsSent;
+  transportInfo.datagramsExpired = conn_->datagramState.numExpiredWrites;
   return transportInfo;
 }
 
@@ -550,6 +708,9 @@ uint64_t QuicTransportBase::getConnectionBufferAvailable() const {
 
 uint64_t QuicTransportBase::bufferSpaceAvailable() const {
   auto bytesBuffered = conn_->flowControlState.sumCurStreamBufferLen;
+  if (conn_->transportSettings.bufferSpaceIncludesUnackedData) {
+    bytesBuffered += conn_->flowControlState.sumUnackedStreamBufferLen;
+  }
   auto totalBufferSpaceAvailable =
       conn_->transportSettings.totalBufferSpaceAvailable;
   return bytesBuffered > totalBufferSpaceAvailable
@@ -589,7 +750,7 @@ QuicTransportBase::setConnectionFlowControlWindow(uint64_t windowSize) {
     return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
   }
   conn_->flowControlState.windowSize = windowSize;
-  maybeSendConnWindowUpdate(*conn_, Clock::now());
+  maybeSendConnWindowUpdate(*conn_, coarseNow(*conn_));
   updateWriteLooper(true);
   return folly::unit;
 }
@@ -609,7 +770,7 @@ QuicTransportBase::setStreamFlowControlWindow(
     return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
   }
   stream->flowControlState.windowSize = windowSize;
-  maybeSendStreamWindowUpdate(*stream, Clock::now());
+  maybeSendStreamWindowUpdate(*stream, coarseNow(*conn_));
   updateWriteLooper(true);
   return folly::unit;
 }
@@ -735,10 +896,11 @@ void QuicTransportBase::invokeReadDataAndCallbacks() {
     self->updateWriteLooper(true);
   };
   auto readableListCopy = self->conn_->streamManager->readableStreams();
+  std::vector<std::pair<ReadCallback*, StreamId>> batchedReads;
   for (const auto& streamId : readableListCopy) {
     auto callback = self->readCallbacks_.find(streamId);
     if (callback == self->readCallbacks_.end()) {
-      self->conn_->streamManager->readableStreams().erase(streamId);
+      self->conn_->streamManager->removeReadable(streamId);
       continue;
     }
     auto readCb = callback->second.readCb;
@@ -747,12 +909,12 @@ void QuicTransportBase::invokeReadDataAndCallbacks() {
       continue;
     }
     if (readCb && stream->streamReadError) {
-      self->conn_->streamManager->readableStreams().erase(streamId);
+      self->conn_->streamManager->removeReadable(streamId);
       readCallbacks_.erase(streamId);
       // if there is an error on the stream - it's not readable anymore, so
       // we cannot peek into it as well.
       VLOG(10) << "Erasing peek callback for stream=" << streamId;
-      self->conn_->streamManager->peekableStreams().erase(streamId);
+      self->conn_->streamManager->removePeekable(streamId);
       peekCallbacks_.erase(streamId);
       VLOG(10) << "invoking read error callbacks on stream=" << streamId << " "
                << *this;
@@ -760,11 +922,53 @@ void QuicTransportBase::invokeReadDataAndCallbacks() {
           streamId, std::make_pair(*stream->streamReadError, folly::none));
     } else if (
         readCb && callback->second.resumed && stream->hasReadableData()) {
+      if (conn_->transportSettings.batchReadCallbacks) {
+        batchedReads.emplace_back(readCb, streamId);
+        continue;
+      }
       VLOG(10) << "invoking read callbacks on stream=" << streamId << " "
                << *this;
       readCb->readAvailable(streamId);
     }
   }
+  if (batchedReads.empty()) {
+    return;
+  }
+  std::sort(
+      batchedReads.begin(),
+      batchedReads.end(),
+      [](const auto& lhs, const auto& rhs) {
+        return std::less<ReadCallback*>()(lhs.first, rhs.first);
+      });
+  std::vector<StreamId> readableIds;
+  size_t index = 0;
+  while (self->closeState_ == CloseState::OPEN &&
+         index < batchedReads.size()) {
+    auto readCb = batchedReads[index].first;
+    readableIds.clear();
+    for (; index < batchedReads.size() && batchedReads[index].first == readCb;
+         ++index) {
+      // The callbacks of the previous batches can have changed the stream.
+      auto streamId = batchedReads[index].second;
+      auto callback = self->readCallbacks_.find(streamId);
+      if (callback == self->readCallbacks_.end() ||
+          callback->second.readCb != readCb || !callback->second.resumed) {
+        continue;
+      }
+      auto stream = conn_->streamManager->getStream(streamId);
+      if (!stream || stream->streamReadError || !stream->hasReadableData()) {
+        continue;
+      }
+      readableIds.push_back(streamId);
+    }
+    if (readableIds.size() == 1) {
+      readCb->readAvailable(readableIds.front());
+    } else if (!readableIds.empty()) {
+      VLOG(10) << "invoking read callbacks on " << readableIds.size()
+               << " streams " << *this;
+      readCb->readAvailableBatch(folly::range(readableIds));
+    }
+  }
 }
 
 void QuicTransportBase::updateReadLooper() {
@@ -883,7 +1087,7 @@ void QuicTransportBase::invokePeekDataAndCallbacks() {
     // remove streamId from list of peekable - as opposed to "read",  "peek" is
     // only called once per streamId and not on every EVB loop until application
     // reads the data.
-    self->conn_->streamManager->peekableStreams().erase(streamId);
+    self->conn_->streamManager->removePeekable(streamId);
     if (callback == self->peekCallbacks_.end()) {
       VLOG(10) << " No peek callback for stream=" << streamId;
       continue;
@@ -1131,16 +1335,35 @@ void QuicTransportBase::updateWriteLooper(bool thisIteration) {
     VLOG(10) << nodeToString(conn_->nodeType)
              << " stopping write looper because conn closed " << *this;
     writeLooper_->stop();
+    if (deferredWriteScheduler_) {
+      deferredWriteScheduler_->cancelWrite(this);
+    }
     return;
   }
   // TODO: Also listens to write event from libevent. Only schedule write when
   // the socket itself is writable.
   auto writeDataReason = shouldWriteData(*conn_);
   if (writeDataReason != WriteDataReason::NO_WRITE) {
-    VLOG(10) << nodeToString(conn_->nodeType)
-             << " running write looper thisIteration=" << thisIteration << " "
-             << *this;
-    writeLooper_->run(thisIteration);
+    // A write of only acks waits for the read callbacks already scheduled
+    // for the next loop, so that the data they write goes out with the acks.
+    if (thisIteration && conn_->transportSettings.deferAckOnlyWrites &&
+        writeDataReason == WriteDataReason::ACK &&
+        readLooper_->isLoopScheduled() &&
+        hasNonAckDataToWrite(*conn_) == WriteDataReason::NO_WRITE) {
+      thisIteration = false;
+    }
+    if (deferredWriteScheduler_ &&
+        (!isConnectionPaced(*conn_) || isConnectionPacedInKernel(*conn_))) {
+      VLOG(10) << nodeToString(conn_->nodeType)
+               << " scheduling deferred write " << *this;
+      writeLooper_->stop();
+      deferredWriteScheduler_->scheduleWrite(this);
+    } else {
+      VLOG(10) << nodeToString(conn_->nodeType)
+               << " running write looper thisIteration=" << thisIteration
+               << " " << *this;
+      writeLooper_->run(thisIteration);
+    }
     if (conn_->loopDetectorCallback) {
       conn_->debugState.needsWriteLoopDetect =
           (conn_->loopDetectorCallback != nullptr);
@@ -1149,6 +1372,9 @@ void QuicTransportBase::updateWriteLooper(bool thisIteration) {
     VLOG(10) << nodeToString(conn_->nodeType) << " stopping write looper "
              << *this;
     writeLooper_->stop();
+    if (deferredWriteScheduler_) {
+      deferredWriteScheduler_->cancelWrite(this);
+    }
     if (conn_->loopDetectorCallback) {
       conn_->debugState.needsWriteLoopDetect = false;
       conn_->debugState.currentEmptyLoopCount = 0;
@@ -1456,6 +1682,7 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
        pendingResetIt++) {
     cancelDeliveryCallbacksForStream(pendingResetIt->first);
   }
+  std::vector<uint64_t> deliveredOffsets;
   auto deliverableStreamId = conn_->streamManager->popDeliverable();
   while (closeState_ == CloseState::OPEN && deliverableStreamId.has_value()) {
     auto streamId = *deliverableStreamId;
@@ -1470,17 +1697,29 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
         break;
       }
       auto minOffsetToDeliver = getStreamNextOffsetToDeliver(*stream);
-      if (deliveryCallbacksForAckedStream->second.front().first >
-          minOffsetToDeliver) {
+      auto& callbacks = deliveryCallbacksForAckedStream->second;
+      if (callbacks.front().first > minOffsetToDeliver) {
         break;
       }
-      auto deliveryCallbackAndOffset =
-          deliveryCallbacksForAckedStream->second.front();
-      deliveryCallbacksForAckedStream->second.pop_front();
-      auto currentDeliveryCallbackOffset = deliveryCallbackAndOffset.first;
-      auto deliveryCallback = deliveryCallbackAndOffset.second;
-      deliveryCallback->onDeliveryAck(
-          stream->id, currentDeliveryCallbackOffset, conn_->lossState.srtt);
+      // The delivered offsets in a row that are for the same callback are
+      // handed to it at once.
+      auto deliveryCallback = callbacks.front().second;
+      deliveredOffsets.clear();
+      while (!callbacks.empty() &&
+             callbacks.front().first <= minOffsetToDeliver &&
+             callbacks.front().second == deliveryCallback) {
+        deliveredOffsets.push_back(callbacks.front().first);
+        callbacks.pop_front();
+      }
+      if (deliveredOffsets.size() == 1) {
+        deliveryCallback->onDeliveryAck(
+            stream->id, deliveredOffsets.front(), conn_->lossState.srtt);
+      } else {
+        deliveryCallback->onDeliveryAckBatch(
+            stream->id,
+            folly::range(deliveredOffsets),
+            conn_->lossState.srtt);
+      }
     }
     if (closeState_ != CloseState::OPEN) {
       break;
@@ -1496,22 +1735,25 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
   invokeDataExpiredCallbacks();
   invokeDataRejectedCallbacks();
 
+  if (closeState_ == CloseState::OPEN && datagramCallback_ &&
+      !conn_->datagramState.readBuffer.empty()) {
+    datagramCallback_->onDatagramsAvailable();
+  }
+
   // Iterate over streams that changed their flow control window and give
   // their registered listeners their updates.
   // We don't really need flow control notifications when we are closed.
   for (auto streamId : conn_->streamManager->flowControlUpdated()) {
     auto stream = conn_->streamManager->getStream(streamId);
     if (!stream || !stream->writable()) {
-      pendingWriteCallbacks_.erase(streamId);
+      removePendingWriteCallback(streamId);
       continue;
     }
     CHECK_NOTNULL(connCallback_)->onFlowControlUpdate(streamId);
     auto maxStreamWritable = maxWritableOnStream(*stream);
     if (maxStreamWritable != 0 && !pendingWriteCallbacks_.empty()) {
-      auto pendingWriteIt = pendingWriteCallbacks_.find(stream->id);
-      if (pendingWriteIt != pendingWriteCallbacks_.end()) {
-        auto wcb = pendingWriteIt->second;
-        pendingWriteCallbacks_.erase(stream->id);
+      auto wcb = removePendingWriteCallback(stream->id);
+      if (wcb) {
         wcb->onStreamWriteReady(stream->id, maxStreamWritable);
       }
     }
@@ -1549,25 +1791,38 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
     // If the connection flow control is unblocked, we might be unblocked
     // on the streams now. TODO: maybe do this only when we know connection
     // flow control changed.
-    auto writeCallbackIt = pendingWriteCallbacks_.begin();
-
-    // If we were closed, we would have errored out the callbacks which would
-    // invalidate iterators, so just ignore all other calls.
+    // The waiting streams are woken up in priority order until what they
+    // write in their callbacks used up the connection's credit, the others
+    // keep waiting for the next credit.
+    std::vector<StreamId> waitingStreams;
+    waitingStreams.reserve(pendingWriteQueue_.size());
+    for (const auto& level : pendingWriteQueue_.levels()) {
+      if (!level.head) {
+        continue;
+      }
+      auto streamId = *level.head;
+      for (size_t i = 0; i < level.size; ++i) {
+        waitingStreams.push_back(streamId);
+        streamId = pendingWriteQueue_.nextInLevel(streamId);
+      }
+    }
     // We don't need writeReady notifications when we are closed.
-    while (closeState_ == CloseState::OPEN &&
-           writeCallbackIt != pendingWriteCallbacks_.end()) {
-      auto streamId = writeCallbackIt->first;
-      auto wcb = writeCallbackIt->second;
-      ++writeCallbackIt;
+    for (auto streamId : waitingStreams) {
+      if (closeState_ != CloseState::OPEN || maxWritableOnConn() == 0) {
+        break;
+      }
       auto stream = conn_->streamManager->getStream(streamId);
       if (!stream || !stream->writable()) {
-        pendingWriteCallbacks_.erase(streamId);
+        removePendingWriteCallback(streamId);
         continue;
       }
       auto maxStreamWritable = maxWritableOnStream(*stream);
       if (maxStreamWritable != 0) {
-        pendingWriteCallbacks_.erase(streamId);
-        wcb->onStreamWriteReady(streamId, maxStreamWritable);
+        // An earlier callback can have removed it
+        auto wcb = removePendingWriteCallback(streamId);
+        if (wcb) {
+          wcb->onStreamWriteReady(streamId, maxStreamWritable);
+        }
       }
     }
   }
@@ -1577,7 +1832,9 @@ void QuicTransportBase::onNetworkData(
     const folly::SocketAddress& peer,
     NetworkData&& networkData) noexcept {
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  processingNetworkData_ = true;
   SCOPE_EXIT {
+    processingNetworkData_ = false;
     checkForClosedStream();
     updateReadLooper();
     updatePeekLooper();
@@ -1586,11 +1843,18 @@ void QuicTransportBase::onNetworkData(
   try {
     conn_->lossState.totalBytesRecvd += networkData.totalData;
     auto originalAckVersion = currentAckStateVersion(*conn_);
-    for (auto& packet : networkData.packets) {
+    startAckEventBatch(*conn_);
+    for (size_t i = 0; i < networkData.packets.size(); ++i) {
+      QUIC_PIPELINE_TIMER(PacketProcessing);
       onReadData(
           peer,
-          NetworkDataSingle(std::move(packet), networkData.receiveTimePoint));
+          NetworkDataSingle(
+              std::move(networkData.packets[i]),
+              networkData.getReceiveTime(i),
+              networkData.getEcn(i)));
     }
+    finishAckEventBatch(*conn_);
+    updateOneRttKeys(*conn_);
     processCallbacksAfterNetworkData();
     if (closeState_ != CloseState::CLOSED) {
       if (currentAckStateVersion(*conn_) != originalAckVersion) {
@@ -1635,14 +1899,61 @@ void QuicTransportBase::setIdleTimer() {
   if (closeState_ == CloseState::CLOSED) {
     return;
   }
-  if (idleTimeout_.isScheduled()) {
-    idleTimeout_.cancelTimeout();
+  bool lazy = conn_->transportSettings.lazyIdleTimeoutRearm;
+  if (lazy) {
+    idleTimerResetTime_ = coarseNow(*conn_);
   }
-  if (conn_->transportSettings.idleTimeout >
-      std::chrono::milliseconds::zero()) {
+  if (!lazy || !idleTimeout_.isScheduled()) {
+    if (idleTimeout_.isScheduled()) {
+      idleTimeout_.cancelTimeout();
+    }
+    if (conn_->transportSettings.idleTimeout >
+        std::chrono::milliseconds::zero()) {
+      getEventBase()->timer().scheduleTimeout(
+          &idleTimeout_, conn_->transportSettings.idleTimeout);
+    }
+  }
+  if (conn_->transportSettings.idleMemoryReleaseTimeout >
+          std::chrono::milliseconds::zero() &&
+      (!lazy || !idleMemoryReleaseTimeout_.isScheduled())) {
+    // Scheduling again moves it out.
     getEventBase()->timer().scheduleTimeout(
-        &idleTimeout_, conn_->transportSettings.idleTimeout);
+        &idleMemoryReleaseTimeout_,
+        conn_->transportSettings.idleMemoryReleaseTimeout);
+  }
+}
+
+bool QuicTransportBase::rearmIdleTimer(
+    folly::HHWheelTimer::Callback& callback,
+    std::chrono::milliseconds timeout) {
+  if (!conn_->transportSettings.lazyIdleTimeoutRearm) {
+    return false;
   }
+  auto& wheelTimer = getEventBase()->timer();
+  auto remaining = idleTimerResetTime_ + timeout - Clock::now();
+  if (remaining < wheelTimer.getTickInterval()) {
+    return false;
+  }
+  wheelTimer.scheduleTimeout(
+      &callback,
+      std::chrono::duration_cast<std::chrono::milliseconds>(remaining));
+  return true;
+}
+
+folly::Optional<std::chrono::milliseconds>
+QuicTransportBase::getTimeUntilIdleTimeout() const {
+  if (!idleTimeout_.isScheduled()) {
+    return folly::none;
+  }
+  if (!conn_->transportSettings.lazyIdleTimeoutRearm) {
+    return idleTimeout_.getTimeRemaining();
+  }
+  // The timer is only rearmed for the rest when it fires.
+  auto remaining = idleTimerResetTime_ + conn_->transportSettings.idleTimeout -
+      Clock::now();
+  return std::max(
+      std::chrono::milliseconds::zero(),
+      std::chrono::duration_cast<std::chrono::milliseconds>(remaining));
 }
 
 uint64_t QuicTransportBase::getNumOpenableBidirectionalStreams() const {
@@ -1654,7 +1965,9 @@ uint64_t QuicTransportBase::getNumOpenableUnidirectionalStreams() const {
 }
 
 folly::Expected<StreamId, LocalErrorCode>
-QuicTransportBase::createStreamInternal(bool bidirectional) {
+QuicTransportBase::createStreamInternal(
+    bool bidirectional,
+    bool replaySafe) {
   if (closeState_ != CloseState::OPEN) {
     return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
   }
@@ -1665,6 +1978,7 @@ QuicTransportBase::createStreamInternal(bool bidirectional) {
     streamResult = conn_->streamManager->createNextUnidirectionalStream();
   }
   if (streamResult) {
+    streamResult.value()->replaySafeOnly = !replaySafe;
     return streamResult.value()->id;
   } else {
     return folly::makeUnexpected(streamResult.error());
@@ -1672,13 +1986,13 @@ QuicTransportBase::createStreamInternal(bool bidirectional) {
 }
 
 folly::Expected<StreamId, LocalErrorCode>
-QuicTransportBase::createBidirectionalStream(bool /*replaySafe*/) {
-  return createStreamInternal(true);
+QuicTransportBase::createBidirectionalStream(bool replaySafe) {
+  return createStreamInternal(true, replaySafe);
 }
 
 folly::Expected<StreamId, LocalErrorCode>
-QuicTransportBase::createUnidirectionalStream(bool /*replaySafe*/) {
-  return createStreamInternal(false);
+QuicTransportBase::createUnidirectionalStream(bool replaySafe) {
+  return createStreamInternal(false, replaySafe);
 }
 
 bool QuicTransportBase::isUnidirectionalStream(StreamId stream) noexcept {
@@ -1753,6 +2067,7 @@ QuicTransportBase::notifyPendingWriteOnStream(StreamId id, WriteCallback* wcb) {
       return folly::makeUnexpected(LocalErrorCode::CALLBACK_ALREADY_INSTALLED);
     }
   }
+  pendingWriteQueue_.insertOrUpdate(id, qStream->priority);
   runOnEvbAsync([id](auto self) {
     auto wcbIt = self->pendingWriteCallbacks_.find(id);
     if (wcbIt == self->pendingWriteCallbacks_.end()) {
@@ -1761,21 +2076,21 @@ QuicTransportBase::notifyPendingWriteOnStream(StreamId id, WriteCallback* wcb) {
     }
     auto writeCallback = wcbIt->second;
     if (!self->conn_->streamManager->streamExists(id)) {
-      self->pendingWriteCallbacks_.erase(wcbIt);
+      self->removePendingWriteCallback(id);
       writeCallback->onStreamWriteError(
           id, std::make_pair(LocalErrorCode::STREAM_NOT_EXISTS, folly::none));
       return;
     }
     auto stream = CHECK_NOTNULL(self->conn_->streamManager->getStream(id));
     if (!stream->writable()) {
-      self->pendingWriteCallbacks_.erase(wcbIt);
+      self->removePendingWriteCallback(id);
       writeCallback->onStreamWriteError(
           id, std::make_pair(LocalErrorCode::STREAM_NOT_EXISTS, folly::none));
       return;
     }
     auto maxCanWrite = self->maxWritableOnStream(*stream);
     if (maxCanWrite != 0) {
-      self->pendingWriteCallbacks_.erase(wcbIt);
+      self->removePendingWriteCallback(id);
       writeCallback->onStreamWriteReady(id, maxCanWrite);
     }
   });
@@ -1796,19 +2111,106 @@ uint64_t QuicTransportBase::maxWritableOnConn() {
   return std::min(connWritableBytes, availableBufferSpace);
 }
 
+QuicSocket::WriteCallback* QuicTransportBase::removePendingWriteCallback(
+    StreamId id) {
+  auto wcbIt = pendingWriteCallbacks_.find(id);
+  if (wcbIt == pendingWriteCallbacks_.end()) {
+    return nullptr;
+  }
+  auto wcb = wcbIt->second;
+  pendingWriteCallbacks_.erase(wcbIt);
+  pendingWriteQueue_.erase(id);
+  return wcb;
+}
+
 QuicSocket::WriteResult QuicTransportBase::writeChain(
     StreamId id,
     Buf data,
     bool eof,
     bool /*cork*/,
     DeliveryCallback* cb) {
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  auto dataLength = data ? data->computeChainDataLength() : 0;
+  auto result = writeChainInternal(id, std::move(data), eof, cb);
+  if (result.hasValue()) {
+    auto stream = conn_->streamManager->findStream(id);
+    if (stream && canWriteThrough(*stream, dataLength)) {
+      writeSocketDataAndCatch();
+    } else {
+      updateWriteLooper(true);
+    }
+  }
+  return result;
+}
+
+std::vector<QuicSocket::WriteResult> QuicTransportBase::writeChains(
+    std::vector<StreamWrite> writes,
+    bool /*cork*/) {
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  std::vector<WriteResult> results;
+  results.reserve(writes.size());
+  bool written = false;
+  for (auto& write : writes) {
+    results.push_back(writeChainInternal(
+        write.id, std::move(write.data), write.eof, write.cb));
+    written |= results.back().hasValue();
+  }
+  if (written) {
+    updateWriteLooper(true);
+  }
+  return results;
+}
+
+std::shared_ptr<CrossThreadWriteQueue>
+QuicTransportBase::getCrossThreadWriteQueue() {
+  if (!crossThreadWriteQueue_ &&
+      conn_->transportSettings.crossThreadWriteQueueCapacity > 0) {
+    DCHECK(evb_ && evb_->isInEventBaseThread());
+    crossThreadWriteQueue_ = std::make_shared<CrossThreadWriteQueue>(
+        conn_->transportSettings.crossThreadWriteQueueCapacity,
+        evb_,
+        sharedGuard());
+  }
+  return crossThreadWriteQueue_;
+}
+
+folly::Expected<StreamId, LocalErrorCode> QuicTransportBase::sendRequest(
+    Buf request,
+    ReadCallback* cb,
+    DeliveryCallback* deliveryCb,
+    bool replaySafe) {
+  if (!cb) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  auto streamId = createStreamInternal(true, replaySafe);
+  if (streamId.hasError()) {
+    return streamId;
+  }
+  auto readResult = setReadCallbackInternal(*streamId, cb);
+  if (readResult.hasError()) {
+    return folly::makeUnexpected(readResult.error());
+  }
+  auto writeResult =
+      writeChainInternal(*streamId, std::move(request), true, deliveryCb);
+  if (writeResult.hasError()) {
+    return folly::makeUnexpected(writeResult.error());
+  }
+  updateWriteLooper(true);
+  return streamId;
+}
+
+QuicSocket::WriteResult QuicTransportBase::writeChainInternal(
+    StreamId id,
+    Buf data,
+    bool eof,
+    DeliveryCallback* cb) {
   if (isReceivingStream(conn_->nodeType, id)) {
     return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
   }
   if (closeState_ != CloseState::OPEN) {
     return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
   }
-  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
   try {
     // Check whether stream exists before calling getStream to avoid
     // creating a peer stream if it does not exist yet.
@@ -1830,7 +2232,6 @@ QuicSocket::WriteResult QuicTransportBase::writeChain(
       }
     }
     writeDataToQuicStream(*stream, std::move(data), eof);
-    updateWriteLooper(true);
   } catch (const QuicTransportException& ex) {
     VLOG(4) << __func__ << " streamId=" << id << " " << ex.what() << " "
             << *this;
@@ -2055,6 +2456,22 @@ void QuicTransportBase::sendPing(
 }
 
 void QuicTransportBase::lossTimeoutExpired() noexcept {
+  if (conn_->transportSettings.lazyLossTimeoutRearm) {
+    if (!lossTimeoutDeadline_) {
+      // Cancelled after the timer was armed.
+      return;
+    }
+    auto& wheelTimer = getEventBase()->timer();
+    auto remaining = *lossTimeoutDeadline_ - Clock::now();
+    if (remaining >= wheelTimer.getTickInterval()) {
+      // Pushed out after the timer was armed.
+      wheelTimer.scheduleTimeout(
+          &lossTimeout_,
+          std::chrono::duration_cast<std::chrono::milliseconds>(remaining));
+      return;
+    }
+    lossTimeoutDeadline_.clear();
+  }
   CHECK_NE(closeState_, CloseState::CLOSED);
   // onLossDetectionAlarm will set packetToSend in pending events
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
@@ -2118,6 +2535,12 @@ void QuicTransportBase::pathValidationTimeoutExpired() noexcept {
 }
 
 void QuicTransportBase::idleTimeoutExpired(bool drain) noexcept {
+  // Only a timer that fired drains, a cancelled one closes right away.
+  if (drain &&
+      rearmIdleTimer(idleTimeout_, conn_->transportSettings.idleTimeout)) {
+    // Reset after the timer was armed.
+    return;
+  }
   VLOG(4) << __func__ << " " << *this;
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
   // idle timeout is expired, just close the connection and drain or
@@ -2131,12 +2554,51 @@ void QuicTransportBase::idleTimeoutExpired(bool drain) noexcept {
       !drain /* sendCloseImmediately */);
 }
 
+void QuicTransportBase::idleMemoryReleaseTimeoutExpired() noexcept {
+  if (rearmIdleTimer(
+          idleMemoryReleaseTimeout_,
+          conn_->transportSettings.idleMemoryReleaseTimeout)) {
+    return;
+  }
+  if (closeState_ != CloseState::OPEN ||
+      conn_->streamManager->streamCount() > 0 ||
+      !conn_->outstandingPackets.empty()) {
+    // The next read or write schedules it again.
+    return;
+  }
+  VLOG(10) << __func__ << " " << *this;
+  releaseIdleConnectionMemory(*conn_);
+  // The callbacks of the streams went with them.
+  if (readCallbacks_.empty()) {
+    decltype(readCallbacks_)().swap(readCallbacks_);
+  }
+  if (peekCallbacks_.empty()) {
+    decltype(peekCallbacks_)().swap(peekCallbacks_);
+  }
+  if (deliveryCallbacks_.empty()) {
+    decltype(deliveryCallbacks_)().swap(deliveryCallbacks_);
+  }
+  if (dataExpiredCallbacks_.empty()) {
+    decltype(dataExpiredCallbacks_)().swap(dataExpiredCallbacks_);
+  }
+  if (dataRejectedCallbacks_.empty()) {
+    decltype(dataRejectedCallbacks_)().swap(dataRejectedCallbacks_);
+  }
+}
+
 void QuicTransportBase::scheduleLossTimeout(std::chrono::milliseconds timeout) {
   if (closeState_ == CloseState::CLOSED) {
     return;
   }
   auto& wheelTimer = getEventBase()->timer();
   timeout = timeMax(timeout, wheelTimer.getTickInterval());
+  if (conn_->transportSettings.lazyLossTimeoutRearm) {
+    lossTimeoutDeadline_ = Clock::now() + timeout;
+    if (lossTimeout_.isScheduled() &&
+        lossTimeout_.getTimeRemaining() <= timeout) {
+      return;
+    }
+  }
   wheelTimer.scheduleTimeout(&lossTimeout_, timeout);
 }
 
@@ -2148,11 +2610,16 @@ void QuicTransportBase::scheduleAckTimeout() {
     if (!ackTimeout_.isScheduled()) {
       auto factoredRtt = std::chrono::duration_cast<std::chrono::microseconds>(
           kAckTimerFactor * conn_->lossState.srtt);
+      const auto& peerAckFrequency =
+          conn_->ackStates.appDataAckState.peerAckFrequency;
+      // The peer picks the ack delay once it sent an ACK_FREQUENCY.
+      auto ackDelay = peerAckFrequency ? peerAckFrequency->updateMaxAckDelay
+                                       : timeMin(kMaxAckTimeout, factoredRtt);
       auto& wheelTimer = getEventBase()->timer();
       auto timeout = timeMax(
           std::chrono::duration_cast<std::chrono::microseconds>(
               wheelTimer.getTickInterval()),
-          timeMin(kMaxAckTimeout, factoredRtt));
+          ackDelay);
       auto timeoutMs =
           std::chrono::duration_cast<std::chrono::milliseconds>(timeout);
       VLOG(10) << __func__ << " timeout=" << timeoutMs.count() << "ms"
@@ -2207,12 +2674,21 @@ void QuicTransportBase::schedulePathValidationTimeout() {
 }
 
 void QuicTransportBase::cancelLossTimeout() {
+  lossTimeoutDeadline_.clear();
+  if (conn_->transportSettings.lazyLossTimeoutRearm &&
+      closeState_ != CloseState::CLOSED) {
+    // The timer is likely to be rescheduled soon, leave it to fire idle.
+    return;
+  }
   if (lossTimeout_.isScheduled()) {
     lossTimeout_.cancelTimeout();
   }
 }
 
 bool QuicTransportBase::isLossTimeoutScheduled() const {
+  if (conn_->transportSettings.lazyLossTimeoutRearm) {
+    return lossTimeoutDeadline_.hasValue();
+  }
   return lossTimeout_.isScheduled();
 }
 
@@ -2270,17 +2746,24 @@ void QuicTransportBase::cancelAllAppCallbacks(
     connWriteCallback_ = nullptr;
     connWriteCallback->onConnectionWriteError(err);
   }
-  auto it = pendingWriteCallbacks_.begin();
-  while (it != pendingWriteCallbacks_.end()) {
-    auto wcb = it->second;
-    wcb->onStreamWriteError(it->first, err);
-    it = pendingWriteCallbacks_.erase(it);
+  // Errored out in stream id order.
+  std::vector<std::pair<StreamId, WriteCallback*>> pendingWriteCallbacks(
+      pendingWriteCallbacks_.begin(), pendingWriteCallbacks_.end());
+  std::sort(pendingWriteCallbacks.begin(), pendingWriteCallbacks.end());
+  pendingWriteCallbacks_.clear();
+  pendingWriteQueue_.clear();
+  for (const auto& pendingWriteCallback : pendingWriteCallbacks) {
+    pendingWriteCallback.second->onStreamWriteError(
+        pendingWriteCallback.first, err);
   }
 }
 
 void QuicTransportBase::writeSocketData() {
   if (socket_) {
     auto packetsBefore = conn_->outstandingPackets.size();
+    if (!conn_->datagramState.writeBuffer.empty()) {
+      removeExpiredDatagrams(*conn_, Clock::now());
+    }
     writeData();
     if (closeState_ != CloseState::CLOSED) {
       if (conn_->pendingEvents.closeTransport == true) {
@@ -2335,6 +2818,24 @@ void QuicTransportBase::writeSocketData() {
   updateWriteLooper(false);
 }
 
+bool QuicTransportBase::canWriteThrough(
+    const QuicStreamState& stream,
+    uint64_t dataLength) {
+  if (dataLength > conn_->transportSettings.writeThroughMaxBytes ||
+      closeState_ != CloseState::OPEN || processingNetworkData_ || !socket_ ||
+      !conn_->oneRttWriteCipher || !stream.hasWritableData()) {
+    return false;
+  }
+  if (isConnectionPaced(*conn_) && !isConnectionPacedInKernel(*conn_) &&
+      (writeLooper_->isScheduled() ||
+       conn_->pacer->getTimeUntilNextWrite() > 0us)) {
+    // Within a pacing interval, the pacer sends it.
+    return false;
+  }
+  // Checks the congestion and the connection flow control windows.
+  return shouldWriteData(*conn_) != WriteDataReason::NO_WRITE;
+}
+
 void QuicTransportBase::writeSocketDataAndCatch() {
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
   try {
@@ -2359,8 +2860,7 @@ void QuicTransportBase::writeSocketDataAndCatch() {
 
 void QuicTransportBase::cancelDeliveryCallbacks(
     StreamId id,
-    const std::deque<std::pair<uint64_t, QuicSocket::DeliveryCallback*>>&
-        deliveryCallbacks) {
+    const DeliveryCallbackQueue& deliveryCallbacks) {
   for (auto iter = deliveryCallbacks.begin(); iter != deliveryCallbacks.end();
        iter++) {
     auto currentDeliveryCallbackOffset = iter->first;
@@ -2370,9 +2870,7 @@ void QuicTransportBase::cancelDeliveryCallbacks(
 }
 
 void QuicTransportBase::cancelDeliveryCallbacks(
-    const folly::F14FastMap<
-        StreamId,
-        std::deque<std::pair<uint64_t, QuicSocket::DeliveryCallback*>>>&
+    const folly::F14FastMap<StreamId, DeliveryCallbackQueue>&
         deliveryCallbacks) {
   for (auto iter = deliveryCallbacks.begin(); iter != deliveryCallbacks.end();
        iter++) {
@@ -2390,12 +2888,20 @@ void QuicTransportBase::setTransportSettings(
   }
   conn_->transportSettings = std::move(transportSettings);
   conn_->streamManager->refreshTransportSettings(conn_->transportSettings);
+  if (!conn_->bufPool && conn_->transportSettings.packetBufferPoolSize) {
+    conn_->bufPool = std::make_shared<PacketBufferPool>(
+        packetBufferPoolBufSize(conn_->transportSettings),
+        conn_->transportSettings.packetBufferPoolSize,
+        conn_->transportSettings.packetBufferPoolHugePages);
+  }
   setCongestionControl(transportSettings.defaultCongestionController);
   if (conn_->transportSettings.pacingEnabled) {
-    conn_->pacer = std::make_unique<DefaultPacer>(
+    conn_->pacer = makePacer(
         *conn_,
-        transportSettings.defaultCongestionController ==
-                CongestionControlType::BBR
+        (transportSettings.defaultCongestionController ==
+             CongestionControlType::BBR ||
+         transportSettings.defaultCongestionController ==
+             CongestionControlType::BBR2)
             ? kMinCwndInMssForBbr
             : conn_->transportSettings.minCwndInMss);
   }
@@ -2411,15 +2917,17 @@ bool QuicTransportBase::isPartiallyReliableTransport() const {
 
 void QuicTransportBase::setCongestionControl(CongestionControlType type) {
   DCHECK(conn_);
+  // A registered controller can report any type, so it is always remade.
   if (!conn_->congestionController ||
-      type != conn_->congestionController->type()) {
+      type != conn_->congestionController->type() ||
+      conn_->transportSettings.congestionControllerName) {
     CHECK(ccFactory_);
 
     // We need to enable pacing if we're switching to BBR.
-    if (type == CongestionControlType::BBR) {
+    if (type == CongestionControlType::BBR ||
+        type == CongestionControlType::BBR2) {
       conn_->transportSettings.pacingEnabled = true;
-      conn_->pacer =
-          std::make_unique<DefaultPacer>(*conn_, kMinCwndInMssForBbr);
+      conn_->pacer = makePacer(*conn_, kMinCwndInMssForBbr);
     }
 
     conn_->congestionController =
@@ -2427,6 +2935,74 @@ void QuicTransportBase::setCongestionControl(CongestionControlType type) {
   }
 }
 
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setDatagramCallback(DatagramCallback* cb) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  datagramCallback_ = cb;
+  return folly::unit;
+}
+
+uint16_t QuicTransportBase::getDatagramSizeLimit() const {
+  CHECK(conn_);
+  // What fits in a short header packet of its own, after the frame type and
+  // length.
+  QuicInteger intFrameType(static_cast<uint8_t>(FrameType::DATAGRAM_LEN));
+  QuicInteger lengthInt(conn_->udpSendPacketLen);
+  uint64_t packetLimit = conn_->udpSendPacketLen - kMaxShortHeaderSize -
+      kCipherOverheadHeuristic - intFrameType.getSize() - lengthInt.getSize();
+  return std::min(conn_->datagramState.maxWriteFrameSize, packetLimit);
+}
+
+folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::writeDatagram(
+    Buf buf,
+    folly::Optional<std::chrono::microseconds> maxDelay) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (conn_->datagramState.maxWriteFrameSize == 0) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (!buf || buf->computeChainDataLength() > getDatagramSizeLimit()) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_WRITE_DATA);
+  }
+  auto& writeBuffer = conn_->datagramState.writeBuffer;
+  if (conn_->transportSettings.datagramWriteBufferSize == 0) {
+    return folly::unit;
+  }
+  // A late datagram is worth less than a new one.
+  if (writeBuffer.size() >=
+      conn_->transportSettings.datagramWriteBufferSize) {
+    writeBuffer.pop_front();
+  }
+  folly::Optional<TimePoint> deadline;
+  if (maxDelay) {
+    deadline = Clock::now() + *maxDelay;
+  }
+  writeBuffer.emplace_back(std::move(buf), deadline);
+  updateWriteLooper(true);
+  return folly::unit;
+}
+
+folly::Expected<std::vector<Buf>, LocalErrorCode>
+QuicTransportBase::readDatagrams(size_t atMost) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  auto& readBuffer = conn_->datagramState.readBuffer;
+  if (atMost == 0 || atMost > readBuffer.size()) {
+    atMost = readBuffer.size();
+  }
+  std::vector<Buf> datagrams;
+  datagrams.reserve(atMost);
+  for (size_t i = 0; i < atMost; ++i) {
+    datagrams.push_back(std::move(readBuffer.front()));
+    readBuffer.pop_front();
+  }
+  return datagrams;
+}
+
 bool QuicTransportBase::isDetachable() {
   // only the client is detachable.
   return conn_->nodeType == QuicNodeType::Client;
@@ -2451,6 +3027,9 @@ void QuicTransportBase::attachEventBase(folly::EventBase* evb) {
   updateReadLooper();
   updatePeekLooper();
   updateWriteLooper(false);
+  if (crossThreadWriteQueue_) {
+    crossThreadWriteQueue_->setEventBase(evb);
+  }
 }
 
 void QuicTransportBase::detachEventBase() {
@@ -2461,14 +3040,24 @@ void QuicTransportBase::detachEventBase() {
   }
   connWriteCallback_ = nullptr;
   pendingWriteCallbacks_.clear();
+  pendingWriteQueue_.clear();
   lossTimeout_.cancelTimeout();
   ackTimeout_.cancelTimeout();
   pathValidationTimeout_.cancelTimeout();
   idleTimeout_.cancelTimeout();
+  idleMemoryReleaseTimeout_.cancelTimeout();
   drainTimeout_.cancelTimeout();
   readLooper_->detachEventBase();
   peekLooper_->detachEventBase();
   writeLooper_->detachEventBase();
+  // The scheduler belongs to the event base being left behind.
+  if (deferredWriteScheduler_) {
+    deferredWriteScheduler_->cancelWrite(this);
+    deferredWriteScheduler_.reset();
+  }
+  if (crossThreadWriteQueue_) {
+    crossThreadWriteQueue_->setEventBase(nullptr);
+  }
   evb_ = nullptr;
 }
 
@@ -2482,6 +3071,42 @@ folly::Optional<LocalErrorCode> QuicTransportBase::setControlStream(
   return folly::none;
 }
 
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setStreamPriority(
+    StreamId id,
+    PriorityLevel level,
+    bool incremental) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (level > kMaxPriorityLevel) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  conn_->streamManager->setStreamPriority(
+      *stream, Priority(level, incremental));
+  pendingWriteQueue_.updateIfExist(id, Priority(level, incremental));
+  return folly::unit;
+}
+
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setStreamRepair(StreamId id) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  auto& streams = conn_->streamRepairState.streams;
+  if (std::find(streams.begin(), streams.end(), id) == streams.end()) {
+    streams.push_back(id);
+  }
+  return folly::unit;
+}
+
 void QuicTransportBase::runOnEvbAsync(
     folly::Function<void(std::shared_ptr<QuicTransportBase>)> func) {
   auto evb = getEventBase();
@@ -2500,11 +3125,11 @@ void QuicTransportBase::runOnEvbAsync(
 void QuicTransportBase::pacedWriteDataToSocket(bool /* fromTimer */) {
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
 
-  if (!isConnectionPaced(*conn_)) {
+  if (!isConnectionPaced(*conn_) || isConnectionPacedInKernel(*conn_)) {
     // Not paced and connection is still open, normal write. Even if pacing is
     // previously enabled and then gets disabled, and we are here due to a
     // timeout, we should do a normal write to flush out the residue from pacing
-    // write.
+    // write. With SO_TXTIME the kernel does the pacing.
     writeSocketDataAndCatch();
     return;
   }
@@ -2533,8 +3158,11 @@ QuicTransportBase::getStreamTransportInfo(StreamId id) const {
     // by the stream existence check, but might as well check this.
     return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
   }
-  return StreamTransportInfo{
-      stream->totalHolbTime, stream->holbCount, bool(stream->lastHolbTime)};
+  return StreamTransportInfo{stream->totalHolbTime,
+                             stream->holbCount,
+                             bool(stream->lastHolbTime),
+                             stream->writeBuffer.chainLength(),
+                             stream->unackedBufferLen};
 }
 
 void QuicTransportBase::describe(std::ostream& os) const {
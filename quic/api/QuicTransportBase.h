@@ -10,13 +10,18 @@
 
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
+#include <quic/api/CrossThreadWriteQueue.h>
+#include <quic/api/DeferredWriteScheduler.h>
 #include <quic/api/QuicSocket.h>
+#include <quic/common/CircularDeque.h>
+#include <quic/common/CoarseClock.h>
 #include <quic/common/FunctionLooper.h>
 #include <quic/common/Timers.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/congestion_control/Copa.h>
 #include <quic/congestion_control/NewReno.h>
 #include <quic/congestion_control/QuicCubic.h>
+#include <quic/state/CongestionStateCache.h>
 #include <quic/state/StateData.h>
 
 #include <folly/ExceptionWrapper.h>
@@ -45,6 +50,74 @@ class QuicTransportBase : public QuicSocket {
 
   void setPacingTimer(TimerHighRes::SharedPtr pacingTimer) noexcept;
 
+  /**
+   * Paced writes wait in the calendar, shared with other transports, instead
+   * of on their own timeout of the pacing timer.
+   */
+  void setPacingCalendar(std::shared_ptr<PacingCalendar> calendar) noexcept;
+
+  /**
+   * The read, peek and write loopers run from the queue, shared with other
+   * transports on the same evb, instead of as loop callbacks of their own.
+   */
+  void setLooperQueue(std::shared_ptr<LooperQueue> queue) noexcept;
+
+  /**
+   * The time for the bookkeeping of reads and streams comes from the clock,
+   * shared with other transports on the same evb, instead of Clock::now().
+   */
+  void setCoarseClock(std::shared_ptr<CoarseClock> clock) noexcept;
+
+  /**
+   * Budget the auto tuned connection window grows out of and that limits the
+   * bytes buffered for reads, shared with other transports. What the
+   * transport holds of it is returned when the transport closes.
+   */
+  void setFlowControlWindowBudget(
+      std::shared_ptr<FlowControlWindowBudget> budget) noexcept;
+
+  /**
+   * Use the given pool for the packet buffers of the write path instead of a
+   * pool owned by this transport. Needs to be set before the transport
+   * settings to take effect.
+   */
+  void setPacketBufferPool(std::shared_ptr<PacketBufferPool> pool) noexcept;
+
+  void setMultiDestBatchWriter(
+      std::shared_ptr<MultiDestBatchWriter> writer) noexcept;
+
+  /**
+   * Post the packets to the peers the AF_XDP socket has seen to it instead of
+   * writing them to the transport's socket.
+   */
+  void setXdpSocket(std::shared_ptr<XdpSocket> xdpSocket) noexcept;
+
+  /**
+   * Seal the 1-RTT packets of each write on these helper threads as well as
+   * the transport's, see ParallelAead.
+   */
+  void setCryptoWorkerPool(std::shared_ptr<CryptoWorkerPool> workers) noexcept;
+
+  /**
+   * Tells the transport whether its socket, owned by someone else, has
+   * SO_TXTIME enabled.
+   */
+  void setSocketTxTimeEnabled(bool enabled) noexcept;
+
+  /**
+   * Let the scheduler run the writes of this transport at the end of the loop
+   * iteration together with other transports, instead of the write looper.
+   * Paced connections keep using the write looper.
+   */
+  void setDeferredWriteScheduler(
+      std::shared_ptr<DeferredWriteScheduler> scheduler) noexcept;
+
+  /**
+   * Invoked by the DeferredWriteScheduler when it is this transport's turn to
+   * write, with at most about maxBytes if set. Returns the bytes written.
+   */
+  uint64_t writeDeferredData(folly::Optional<uint64_t> maxBytes);
+
   folly::EventBase* getEventBase() const override;
 
   folly::Optional<ConnectionId> getClientConnectionId() const override;
@@ -62,6 +135,12 @@ class QuicTransportBase : public QuicSocket {
 
   const std::shared_ptr<QLogger> getQLogger() const;
 
+  /**
+   * Time left until the connection closes for being idle, if nothing is
+   * received or sent before then. None if the idle timer is not running.
+   */
+  folly::Optional<std::chrono::milliseconds> getTimeUntilIdleTimeout() const;
+
   // QuicSocket interface
   bool good() const override;
 
@@ -190,6 +269,18 @@ class QuicTransportBase : public QuicSocket {
       bool cork,
       DeliveryCallback* cb = nullptr) override;
 
+  std::vector<WriteResult> writeChains(
+      std::vector<StreamWrite> writes,
+      bool cork) override;
+
+  std::shared_ptr<CrossThreadWriteQueue> getCrossThreadWriteQueue() override;
+
+  folly::Expected<StreamId, LocalErrorCode> sendRequest(
+      Buf request,
+      ReadCallback* cb,
+      DeliveryCallback* deliveryCb = nullptr,
+      bool replaySafe = true) override;
+
   folly::Expected<folly::Unit, LocalErrorCode> registerDeliveryCallback(
       StreamId id,
       uint64_t offset,
@@ -235,6 +326,18 @@ class QuicTransportBase : public QuicSocket {
 
   folly::Optional<LocalErrorCode> setControlStream(StreamId id) override;
 
+  folly::Expected<folly::Unit, LocalErrorCode> setStreamPriority(
+      StreamId id,
+      PriorityLevel level,
+      bool incremental) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> setStreamRepair(
+      StreamId id) override;
+
+  // The delivery callbacks of a stream, sorted by offset
+  using DeliveryCallbackQueue =
+      CircularDeque<std::pair<uint64_t, QuicSocket::DeliveryCallback*>>;
+
   /**
    * Invoke onCanceled for all the delivery callbacks in the deliveryCallbacks
    * passed in. This is supposed to be a copy of the real deque of the delivery
@@ -242,8 +345,7 @@ class QuicTransportBase : public QuicSocket {
    */
   static void cancelDeliveryCallbacks(
       StreamId id,
-      const std::deque<std::pair<uint64_t, QuicSocket::DeliveryCallback*>>&
-          deliveryCallbacks);
+      const DeliveryCallbackQueue& deliveryCallbacks);
 
   /**
    * Invoke onCanceled for all the delivery callbacks in the deliveryCallbacks
@@ -251,9 +353,7 @@ class QuicTransportBase : public QuicSocket {
    * callbacks of the transport, so there is no need to erase anything from it.
    */
   static void cancelDeliveryCallbacks(
-      const folly::F14FastMap<
-          StreamId,
-          std::deque<std::pair<uint64_t, QuicSocket::DeliveryCallback*>>>&
+      const folly::F14FastMap<StreamId, DeliveryCallbackQueue>&
           deliveryCallbacks);
 
   /**
@@ -268,6 +368,17 @@ class QuicTransportBase : public QuicSocket {
   virtual void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> factory);
 
+  /**
+   * Cache the connection warm starts from, when it has the congestion state
+   * an earlier connection to the same peer left under the key, and leaves its
+   * own congestion state in when it closes. Servers key it by client subnet,
+   * clients by the hostname they key their psk cache by. Has to be set before
+   * the connection starts.
+   */
+  void setCongestionStateCache(
+      std::shared_ptr<CongestionStateCache> cache,
+      std::string key);
+
   /**
    * Retrieve the transport settings
    */
@@ -306,6 +417,15 @@ class QuicTransportBase : public QuicSocket {
    */
   virtual void unbindConnection() = 0;
 
+  /**
+   * Invoked when the closed connection is about to drain for drainPeriod. The
+   * sub-class returns true if it had the draining done elsewhere, in which
+   * case the transport is unbound right away instead.
+   */
+  virtual bool delegateDrain(std::chrono::milliseconds /* drainPeriod */) {
+    return false;
+  }
+
   /**
    * Returns whether or not the connection has a write cipher. This will be used
    * to decide to return the onTransportReady() callbacks.
@@ -436,6 +556,26 @@ class QuicTransportBase : public QuicSocket {
     QuicTransportBase* transport_;
   };
 
+  class IdleMemoryReleaseTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    ~IdleMemoryReleaseTimeout() override = default;
+
+    explicit IdleMemoryReleaseTimeout(QuicTransportBase* transport)
+        : transport_(transport) {}
+
+    void timeoutExpired() noexcept override {
+      transport_->idleMemoryReleaseTimeoutExpired();
+    }
+
+    void callbackCanceled() noexcept override {
+      // ignore, as this happens only when event  base dies
+      return;
+    }
+
+   private:
+    QuicTransportBase* transport_;
+  };
+
   // DrainTimeout is a bit different from other timeouts. It needs to hold a
   // shared_ptr to the transport, since if a DrainTimeout is scheduled,
   // transport cannot die.
@@ -461,6 +601,19 @@ class QuicTransportBase : public QuicSocket {
   // If you don't set it, the default is Cubic
   void setCongestionControl(CongestionControlType type) override;
 
+  folly::Expected<folly::Unit, LocalErrorCode> setDatagramCallback(
+      DatagramCallback* cb) override;
+
+  uint16_t getDatagramSizeLimit() const override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf buf,
+      folly::Optional<std::chrono::microseconds> maxDelay =
+          folly::none) override;
+
+  folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost = 0) override;
+
   void describe(std::ostream& os) const;
 
   void setLogger(std::shared_ptr<Logger> logger) {
@@ -492,6 +645,14 @@ class QuicTransportBase : public QuicSocket {
   void runOnEvbAsync(
       folly::Function<void(std::shared_ptr<QuicTransportBase>)> func);
 
+  /**
+   * Remakes the congestion controller with the warm start cwnd, and seeds the
+   * pacer with it over the cached min rtt, if the congestion state cache has
+   * fresh enough state for the peer. Called once the transport settings are
+   * final and before anything is sent.
+   */
+  void maybeWarmStartCongestionControl();
+
   void closeImpl(
       folly::Optional<std::pair<QuicErrorCode, std::string>> error,
       bool drainConnection = true,
@@ -510,7 +671,14 @@ class QuicTransportBase : public QuicSocket {
       StreamId id,
       PeekCallback* cb) noexcept;
   folly::Expected<StreamId, LocalErrorCode> createStreamInternal(
-      bool bidirectional);
+      bool bidirectional,
+      bool replaySafe);
+  // Buffers the data on the stream, leaving the write looper to the caller.
+  WriteResult writeChainInternal(
+      StreamId id,
+      Buf data,
+      bool eof,
+      DeliveryCallback* cb);
 
   /**
    * write data to socket
@@ -530,6 +698,12 @@ class QuicTransportBase : public QuicSocket {
    */
   void writeSocketDataAndCatch();
 
+  /**
+   * Whether a write of dataLength bytes the app just made to the stream can
+   * be sent right away, see writeThroughMaxBytes.
+   */
+  bool canWriteThrough(const QuicStreamState& stream, uint64_t dataLength);
+
   /**
    * Paced write data to socket when connection is paced.
    *
@@ -544,14 +718,24 @@ class QuicTransportBase : public QuicSocket {
   uint64_t maxWritableOnStream(const QuicStreamState&);
   uint64_t maxWritableOnConn();
 
+  // Returns the write callback waiting on the stream and stops it waiting.
+  WriteCallback* removePendingWriteCallback(StreamId id);
+
   void lossTimeoutExpired() noexcept;
   void ackTimeoutExpired() noexcept;
   void pathValidationTimeoutExpired() noexcept;
   void idleTimeoutExpired(bool drain) noexcept;
+  void idleMemoryReleaseTimeoutExpired() noexcept;
   void drainTimeoutExpired() noexcept;
   void pingTimeoutExpired() noexcept;
 
   void setIdleTimer();
+  // With lazyIdleTimeoutRearm, schedules the idle timer again for what is
+  // left of the timeout since the last reset, if the reset came after it was
+  // armed. Returns whether it did.
+  bool rearmIdleTimer(
+      folly::HHWheelTimer::Callback& callback,
+      std::chrono::milliseconds timeout);
   void scheduleAckTimeout();
   void schedulePathValidationTimeout();
   void schedulePingTimeout(
@@ -597,33 +781,49 @@ class QuicTransportBase : public QuicSocket {
 
   folly::F14FastMap<StreamId, ReadCallbackData> readCallbacks_;
   folly::F14FastMap<StreamId, PeekCallbackData> peekCallbacks_;
-  folly::
-      F14FastMap<StreamId, std::deque<std::pair<uint64_t, DeliveryCallback*>>>
-          deliveryCallbacks_;
+  folly::F14FastMap<StreamId, DeliveryCallbackQueue> deliveryCallbacks_;
   folly::F14FastMap<StreamId, DataExpiredCallbackData> dataExpiredCallbacks_;
   folly::F14FastMap<StreamId, DataRejectedCallbackData> dataRejectedCallbacks_;
   PingCallback* pingCallback_;
+  DatagramCallback* datagramCallback_{nullptr};
 
   WriteCallback* connWriteCallback_{nullptr};
-  std::map<StreamId, WriteCallback*> pendingWriteCallbacks_;
+  folly::F14FastMap<StreamId, WriteCallback*> pendingWriteCallbacks_;
+  // The streams of the pending write callbacks, in the order they are woken
+  // up in when connection flow control opens: by priority, then first come
+  // first served.
+  PriorityQueue pendingWriteQueue_;
   CloseState closeState_{CloseState::OPEN};
   bool transportReadyNotified_{false};
+  // Set while the packets read are processed, the writes the app makes then
+  // go out with the acks once they are.
+  bool processingNetworkData_{false};
 
   LossTimeout lossTimeout_;
+  // When the loss timer may lag behind, the time it is actually due at.
+  folly::Optional<TimePoint> lossTimeoutDeadline_;
   AckTimeout ackTimeout_;
   PathValidationTimeout pathValidationTimeout_;
   IdleTimeout idleTimeout_;
+  IdleMemoryReleaseTimeout idleMemoryReleaseTimeout_;
+  // When the idle timers were last reset, with lazyIdleTimeoutRearm.
+  TimePoint idleTimerResetTime_;
   DrainTimeout drainTimeout_;
   PingTimeout pingTimeout_;
   FunctionLooper::Ptr readLooper_;
   FunctionLooper::Ptr peekLooper_;
   FunctionLooper::Ptr writeLooper_;
+  std::shared_ptr<DeferredWriteScheduler> deferredWriteScheduler_;
+  // only made once the application asks for it
+  std::shared_ptr<CrossThreadWriteQueue> crossThreadWriteQueue_;
 
   // TODO: This is silly. We need a better solution.
   // Uninitialied local address as a fallback answer when socket isn't bound.
   folly::SocketAddress localFallbackAddress;
   // CongestionController factory
   std::shared_ptr<CongestionControllerFactory> ccFactory_{nullptr};
+  std::shared_ptr<CongestionStateCache> congestionStateCache_;
+  std::string congestionStateCacheKey_;
 
   folly::Function<bool(const folly::Optional<std::string>&, const Buf&) const>
       earlyDataAppParamsValidator_;
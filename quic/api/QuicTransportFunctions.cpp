@@ -9,6 +9,7 @@
 #include <quic/api/QuicTransportFunctions.h>
 
 #include <folly/Overload.h>
+#include <folly/ScopeGuard.h>
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
 #include <quic/api/IoBufQuicBatch.h>
@@ -16,12 +17,14 @@
 #include <quic/codec/QuicPacketBuilder.h>
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
+#include <quic/common/PipelineTiming.h>
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/SimpleFrameFunctions.h>
+#include <quic/state/StreamRepairFunctions.h>
 
 namespace {
 
@@ -90,7 +93,8 @@ uint64_t writeQuicDataToSocketImpl(
     QuicVersion version,
     uint64_t packetLimit,
     bool exceptCryptoStream) {
-  auto builder = ShortHeaderBuilder();
+  auto builder = ShortHeaderBuilder(
+      keyPhaseOfGeneration(connection.oneRttWriteKeyGeneration));
   // TODO: In FrameScheduler, Retx is prioritized over new data. We should
   // add a flag to the Scheduler to control the priority between them and see
   // which way is better.
@@ -107,6 +111,9 @@ uint64_t writeQuicDataToSocketImpl(
     if (!exceptCryptoStream) {
       probeSchedulerBuilder.cryptoFrames();
     }
+    if (connection.pendingEvents.pingProbe) {
+      probeSchedulerBuilder.simpleFrames();
+    }
     auto probeScheduler = std::move(probeSchedulerBuilder).build();
     written = writeProbingDataToSocket(
         sock,
@@ -122,6 +129,18 @@ uint64_t writeQuicDataToSocketImpl(
         headerCipher,
         version);
     connection.pendingEvents.numProbePackets = 0;
+    connection.pendingEvents.pingProbe = false;
+  }
+  if (written < packetLimit && hasPendingPmtuProbe(connection)) {
+    written += writePmtuProbeToSocket(
+        sock,
+        connection,
+        srcConnId,
+        dstConnId,
+        builder,
+        aead,
+        headerCipher,
+        version);
   }
   auto schedulerBuilder =
       FrameScheduler::Builder(
@@ -135,7 +154,8 @@ uint64_t writeQuicDataToSocketImpl(
           .resetFrames()
           .windowUpdateFrames()
           .blockedFrames()
-          .simpleFrames();
+          .simpleFrames()
+          .datagramFrames();
   if (!exceptCryptoStream) {
     schedulerBuilder.cryptoFrames();
   }
@@ -153,6 +173,33 @@ uint64_t writeQuicDataToSocketImpl(
       aead,
       headerCipher,
       version);
+  // With nothing else left to send, the connection is about to go idle, the
+  // last thing it sends covers the tail of the protected streams.
+  if (written < packetLimit && !scheduler.hasData() &&
+      maybeScheduleStreamRepair(connection)) {
+    FrameScheduler repairScheduler =
+        std::move(FrameScheduler::Builder(
+                      connection,
+                      EncryptionLevel::AppData,
+                      PacketNumberSpace::AppData,
+                      "StreamRepairScheduler")
+                      .simpleFrames())
+            .build();
+    written += writeConnectionDataToSocket(
+        sock,
+        connection,
+        srcConnId,
+        dstConnId,
+        ShortHeaderBuilder(
+            keyPhaseOfGeneration(connection.oneRttWriteKeyGeneration)),
+        PacketNumberSpace::AppData,
+        repairScheduler,
+        congestionControlWritableBytes,
+        packetLimit - written,
+        aead,
+        headerCipher,
+        version);
+  }
   VLOG_IF(10, written > 0) << nodeToString(connection.nodeType)
                            << " written data "
                            << (exceptCryptoStream ? "without crypto data " : "")
@@ -162,6 +209,22 @@ uint64_t writeQuicDataToSocketImpl(
   return written;
 }
 
+quic::Sample getHeaderSample(
+    const uint8_t* header,
+    const uint8_t* encryptedBody,
+    size_t bodyLen) {
+  auto packetNumberLength = quic::parsePacketNumberLength(*header);
+  quic::Sample sample;
+  size_t sampleBytesToUse =
+      quic::kMaxPacketNumEncodingSize - packetNumberLength;
+  // If there were less than 4 bytes in the packet number, some of the payload
+  // bytes will also be skipped during sampling.
+  CHECK_GE(bodyLen, sampleBytesToUse + sample.size());
+  encryptedBody += sampleBytesToUse;
+  memcpy(sample.data(), encryptedBody, sample.size());
+  return sample;
+}
+
 } // namespace
 
 namespace quic {
@@ -183,13 +246,15 @@ void handleNewStreamDataWritten(
   auto bufWritten = stream.writeBuffer.splitAtMost(folly::to<size_t>(frameLen));
   DCHECK_EQ(bufWritten->computeChainDataLength(), frameLen);
   stream.currentWriteOffset += frameFin ? 1 : 0;
-  CHECK(stream.retransmissionBuffer
-            .emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(originalOffset),
-                std::forward_as_tuple(
-                    std::move(bufWritten), originalOffset, frameFin))
-            .second);
+  // New data starts past everything sent before, so hint it at the back.
+  auto& retxBuffer = stream.retransmissionBuffer;
+  auto numBuffers = retxBuffer.size();
+  retxBuffer.insert(
+      retxBuffer.end(),
+      std::make_pair(
+          originalOffset,
+          StreamBuffer(std::move(bufWritten), originalOffset, frameFin)));
+  CHECK_EQ(retxBuffer.size(), numBuffers + 1);
 }
 
 void handleRetransmissionWritten(
@@ -258,7 +323,12 @@ bool handleStreamWritten(
         frameFin,
         packetNum,
         lossBufferIter);
-    QUIC_STATS(conn.infoCallback, onPacketRetransmission);
+    QUIC_STATS_COUNTER(
+        conn.statsCounters,
+        PacketRetransmissions,
+        1,
+        conn.infoCallback,
+        onPacketRetransmission);
     return false;
   }
 
@@ -285,13 +355,20 @@ void updateConnection(
   if (conn.qLogger) {
     conn.qLogger->addPacket(packet, encodedSize);
   }
+  QUIC_PROBE(
+      packet_sent,
+      conn,
+      packetNum,
+      static_cast<uint8_t>(packetNumberSpace),
+      encodedSize);
   for (const auto& frame : packet.frames) {
     switch (frame.type()) {
       case QuicWriteFrame::Type::WriteStreamFrame_E: {
         const WriteStreamFrame& writeStreamFrame = *frame.asWriteStreamFrame();
         retransmittable = true;
+        // The stream was just written from, it exists already.
         auto stream = CHECK_NOTNULL(
-            conn.streamManager->getStream(writeStreamFrame.streamId));
+            conn.streamManager->findStream(writeStreamFrame.streamId));
         auto newStreamDataWritten = handleStreamWritten(
             conn,
             *stream,
@@ -301,11 +378,12 @@ void updateConnection(
             packetNum,
             packetNumberSpace);
         if (newStreamDataWritten) {
-          updateFlowControlOnWriteToSocket(*stream, writeStreamFrame.len);
-          maybeWriteBlockAfterSocketWrite(*stream);
-          conn.streamManager->updateWritableStreams(*stream);
+          updateFlowControlOnNewDataWritten(*stream, writeStreamFrame.len);
+          updateWriteLatencyOnNewDataWritten(*stream, sentTime);
+        } else {
+          // Only retransmissions take from the loss buffer.
+          conn.streamManager->updateLossStreams(*stream);
         }
-        conn.streamManager->updateLossStreams(*stream);
         break;
       }
       case QuicWriteFrame::Type::WriteCryptoFrame_E: {
@@ -437,17 +515,8 @@ void updateConnection(
     DCHECK(!packetEvent);
     return;
   }
-  auto packetIt =
-      std::find_if(
-          conn.outstandingPackets.rbegin(),
-          conn.outstandingPackets.rend(),
-          [packetNum](const auto& packetWithTime) {
-            return packetWithTime.packet.header.getPacketSequenceNum() <
-                packetNum;
-          })
-          .base();
-  auto& pkt = *conn.outstandingPackets.emplace(
-      packetIt,
+  // The packet goes in the slot of its packet number.
+  auto& pkt = conn.outstandingPackets[packetNumberSpace].emplace_back(
       std::move(packet),
       std::move(sentTime),
       encodedSize,
@@ -456,6 +525,7 @@ void updateConnection(
   pkt.isAppLimited = conn.congestionController
       ? conn.congestionController->isAppLimited()
       : false;
+  pkt.isEcnMarked = isEcnMarkingEnabled(conn);
   if (conn.lossState.lastAckedTime.has_value() &&
       conn.lossState.lastAckedPacketSentTime.has_value()) {
     pkt.lastAckedPacketInfo.emplace(
@@ -553,13 +623,14 @@ HeaderBuilder LongHeaderBuilder(LongHeader::Types packetType) {
   };
 }
 
-HeaderBuilder ShortHeaderBuilder() {
-  return [](const ConnectionId& /* srcConnId */,
-            const ConnectionId& dstConnId,
-            PacketNum packetNum,
-            QuicVersion,
-            const std::string&) {
-    return ShortHeader(ProtectionType::KeyPhaseZero, dstConnId, packetNum);
+HeaderBuilder ShortHeaderBuilder(ProtectionType keyPhase) {
+  return [keyPhase](
+             const ConnectionId& /* srcConnId */,
+             const ConnectionId& dstConnId,
+             PacketNum packetNum,
+             QuicVersion,
+             const std::string&) {
+    return ShortHeader(keyPhase, dstConnId, packetNum);
   };
 }
 
@@ -771,6 +842,9 @@ void writeCloseCommon(
   auto packetBuf = std::move(packet.header);
   packetBuf->prependChain(std::move(body));
   auto packetSize = packetBuf->computeChainDataLength();
+  if (connection.transportSettings.compactDrainingConnections) {
+    connection.lastClosePacket = packetBuf->cloneCoalesced();
+  }
   if (connection.qLogger) {
     connection.qLogger->addPacket(packet.packet, packetSize);
   }
@@ -788,14 +862,34 @@ void writeCloseCommon(
   // Increment the sequence number.
   // TODO: Do not increase pn if write fails
   increaseNextPacketNum(connection, pnSpace);
+  connection.lossState.totalBytesSent += packetSize;
+  if (connection.multiDestBatchWriter) {
+    // Queued with the packets of other connections, e.g. the close packets of
+    // a worker shutting down, and written with them in one go.
+    connection.multiDestBatchWriter->add(
+        sock, connection.peerAddress, std::move(packetBuf), packetSize);
+    QUIC_STATS_COUNTER(
+        connection.statsCounters,
+        BytesWritten,
+        packetSize,
+        connection.infoCallback,
+        onWrite,
+        packetSize);
+    return;
+  }
   // best effort writing to the socket, ignore any errors.
   auto ret = sock.write(connection.peerAddress, packetBuf);
-  connection.lossState.totalBytesSent += packetSize;
   if (ret < 0) {
     VLOG(4) << "Error writing connection close " << folly::errnoStr(errno)
             << " " << connection;
   } else {
-    QUIC_STATS(connection.infoCallback, onWrite, ret);
+    QUIC_STATS_COUNTER(
+        connection.statsCounters,
+        BytesWritten,
+        ret,
+        connection.infoCallback,
+        onWrite,
+        ret);
   }
 }
 
@@ -838,7 +932,7 @@ void writeShortClose(
     const Aead& aead,
     const PacketNumberCipher& headerCipher) {
   auto header = ShortHeader(
-      ProtectionType::KeyPhaseZero,
+      keyPhaseOfGeneration(connection.oneRttWriteKeyGeneration),
       connId,
       getNextPacketNum(connection, PacketNumberSpace::AppData));
   writeCloseCommon(
@@ -859,13 +953,7 @@ void encryptPacketHeader(
     const PacketNumberCipher& headerCipher) {
   // Header encryption.
   auto packetNumberLength = parsePacketNumberLength(*header);
-  Sample sample;
-  size_t sampleBytesToUse = kMaxPacketNumEncodingSize - packetNumberLength;
-  // If there were less than 4 bytes in the packet number, some of the payload
-  // bytes will also be skipped during sampling.
-  CHECK_GE(bodyLen, sampleBytesToUse + sample.size());
-  encryptedBody += sampleBytesToUse;
-  memcpy(sample.data(), encryptedBody, sample.size());
+  Sample sample = getHeaderSample(header, encryptedBody, bodyLen);
 
   folly::MutableByteRange initialByteRange(header, 1);
   folly::MutableByteRange packetNumByteRange(
@@ -879,6 +967,63 @@ void encryptPacketHeader(
   }
 }
 
+void encryptPacketHeaders(
+    const std::vector<HeaderForm>& headerForms,
+    const std::vector<size_t>& headerLens,
+    std::vector<Buf>& packets,
+    const PacketNumberCipher& headerCipher) {
+  CHECK_EQ(headerForms.size(), packets.size());
+  CHECK_EQ(headerLens.size(), packets.size());
+  std::vector<Sample> samples;
+  samples.reserve(packets.size());
+  for (size_t i = 0; i < packets.size(); ++i) {
+    auto& packet = packets[i];
+    DCHECK(!packet->isChained());
+    CHECK_GE(packet->length(), headerLens[i]);
+    samples.push_back(getHeaderSample(
+        packet->data(),
+        packet->data() + headerLens[i],
+        packet->length() - headerLens[i]));
+  }
+  std::vector<HeaderProtectionMask> masks;
+  headerCipher.batchMask(samples, masks);
+  CHECK_EQ(masks.size(), packets.size());
+  for (size_t i = 0; i < packets.size(); ++i) {
+    auto header = packets[i]->writableData();
+    auto packetNumberLength = parsePacketNumberLength(*header);
+    folly::MutableByteRange initialByteRange(header, 1);
+    folly::MutableByteRange packetNumByteRange(
+        header + headerLens[i] - packetNumberLength, packetNumberLength);
+    if (headerForms[i] == HeaderForm::Short) {
+      headerCipher.encryptShortHeaderWithMask(
+          masks[i], initialByteRange, packetNumByteRange);
+    } else {
+      headerCipher.encryptLongHeaderWithMask(
+          masks[i], initialByteRange, packetNumByteRange);
+    }
+  }
+}
+
+uint32_t getWriteBatchSize(
+    const QuicConnectionStateBase& conn,
+    uint64_t packetLimit) {
+  if (!conn.transportSettings.adaptiveWriteBatchSize) {
+    return conn.transportSettings.maxBatchSize;
+  }
+  uint64_t batchSize = kMaxAdaptiveWriteBatchSize;
+  if (isConnectionPaced(conn)) {
+    // One batch per pacing interval.
+    batchSize = conn.pacer->getCachedWriteBatchSize();
+  } else if (conn.congestionController && conn.udpSendPacketLen) {
+    auto writableBytes = conn.congestionController->getWritableBytes();
+    batchSize = std::min<uint64_t>(
+        batchSize,
+        (writableBytes + conn.udpSendPacketLen - 1) / conn.udpSendPacketLen);
+  }
+  return folly::to<uint32_t>(
+      std::max<uint64_t>(1, std::min(batchSize, packetLimit)));
+}
+
 uint64_t writeConnectionDataToSocket(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
@@ -897,10 +1042,25 @@ uint64_t writeConnectionDataToSocket(
            << " writing data using scheduler=" << scheduler.name() << " "
            << connection;
 
+  auto writeBatchSize = getWriteBatchSize(connection, packetLimit);
   auto batchWriter = BatchWriterFactory::makeBatchWriter(
       sock,
       connection.transportSettings.batchingMode,
-      connection.transportSettings.maxBatchSize);
+      writeBatchSize,
+      connection.transportSettings.batchWritesAcrossConnections
+          ? connection.multiDestBatchWriter.get()
+          : nullptr,
+      connection.xdpSocket.get());
+  batchWriter->setBufferPool(connection.bufPool.get());
+  batchWriter->setZeroCopyTracker(connection.zeroCopyTracker.get());
+  // The packets are left to the device to seal when the keys are on it and
+  // the writer can hand it the packets' metadata.
+  auto offloadKeyId = aead.getOffloadKeyId();
+  bool offloaded = offloadKeyId && headerCipher.isOffloaded() &&
+      connection.cryptoOffload && batchWriter->supportsCryptoOffload();
+  if (offloaded) {
+    batchWriter->setCryptoOffload(connection.cryptoOffload.get());
+  }
 
   IOBufQuicBatch ioBufBatch(
       std::move(batchWriter),
@@ -918,6 +1078,109 @@ uint64_t writeConnectionDataToSocket(
       connection.debugState.noWriteReason = NoWriteReason::EMPTY_SCHEDULER;
     }
   }
+  // Packets are built and accounted for one at a time, but sealed together
+  // right before they go to the batch writer so that the AEAD gets to work on
+  // a whole burst at once.
+  size_t sealBatchSize = connection.transportSettings.batchingMode ==
+          quic::QuicBatchingMode::BATCHING_MODE_NONE
+      ? 1
+      : std::max<size_t>(1, writeBatchSize);
+  std::vector<Buf> plaintexts;
+  std::vector<Buf> headers;
+  std::vector<const folly::IOBuf*> associatedData;
+  std::vector<uint64_t> packetNums;
+  std::vector<HeaderForm> headerForms;
+  std::vector<size_t> headerLens;
+  plaintexts.reserve(sealBatchSize);
+  headers.reserve(sealBatchSize);
+  associatedData.reserve(sealBatchSize);
+  packetNums.reserve(sealBatchSize);
+  headerForms.reserve(sealBatchSize);
+  headerLens.reserve(sealBatchSize);
+  // returns false if writing one of the packets failed.
+  auto sealAndWritePending = [&]() -> bool {
+    if (plaintexts.empty()) {
+      return true;
+    }
+    if (!offloaded) {
+      for (const auto& header : headers) {
+        associatedData.push_back(header.get());
+      }
+      QUIC_PIPELINE_TIMED(
+          PacketSeal,
+          aead.encryptBatch(plaintexts, associatedData, packetNums));
+    }
+    for (size_t i = 0; i < plaintexts.size(); ++i) {
+      auto& packetBuf = plaintexts[i];
+      auto headerLen = headers[i]->length();
+      if (!packetBuf->isChained() && packetBuf->headroom() >= headerLen) {
+        packetBuf->prepend(headerLen);
+        memcpy(packetBuf->writableData(), headers[i]->data(), headerLen);
+      } else {
+        headers[i]->prependChain(std::move(packetBuf));
+        headers[i]->coalesce();
+        packetBuf = std::move(headers[i]);
+      }
+      headerLens.push_back(headerLen);
+      if (offloaded) {
+        // The device writes the tag at the end of the plaintext.
+        auto tagLen = aead.getCipherOverhead();
+        if (packetBuf->tailroom() < tagLen) {
+          packetBuf->reserve(0, tagLen);
+        }
+        memset(packetBuf->writableTail(), 0, tagLen);
+        packetBuf->append(tagLen);
+      }
+    }
+    if (!offloaded) {
+      QUIC_PIPELINE_TIMED(
+          HeaderProtect,
+          encryptPacketHeaders(
+              headerForms, headerLens, plaintexts, headerCipher));
+    }
+    bool ret = true;
+    for (size_t i = 0; i < plaintexts.size() && ret; ++i) {
+      auto packetBuf = std::move(plaintexts[i]);
+      auto encodedSize = packetBuf->length();
+      CryptoOffloadMetadata offloadMetadata;
+      if (offloaded) {
+        offloadMetadata.packetNum = packetNums[i];
+        offloadMetadata.keyId = *offloadKeyId;
+        offloadMetadata.headerLen = folly::to<uint16_t>(headerLens[i]);
+        offloadMetadata.packetLen = folly::to<uint16_t>(encodedSize);
+      }
+      ret = ioBufBatch.write(
+          std::move(packetBuf),
+          encodedSize,
+          offloaded ? &offloadMetadata : nullptr);
+      if (ret) {
+        // update stats
+        QUIC_STATS_COUNTER(
+            connection.statsCounters,
+            BytesWritten,
+            encodedSize,
+            connection.infoCallback,
+            onWrite,
+            encodedSize);
+        QUIC_STATS_COUNTER(
+            connection.statsCounters,
+            PacketsSent,
+            1,
+            connection.infoCallback,
+            onPacketSent);
+      }
+    }
+    plaintexts.clear();
+    headers.clear();
+    associatedData.clear();
+    packetNums.clear();
+    headerForms.clear();
+    headerLens.clear();
+    return ret;
+  };
+  auto packetsWritten = [&]() -> uint64_t {
+    return ioBufBatch.getPktSent() + plaintexts.size();
+  };
   auto writeLoopBeginTime = Clock::now();
   // helper functor to check if we have been write in a loop for longer than the
   // RTT fraction that we are allowed to write. Only kicks in if we have write
@@ -927,15 +1190,15 @@ uint64_t writeConnectionDataToSocket(
             quic::QuicBatchingMode::BATCHING_MODE_NONE
         ? connection.transportSettings.writeConnectionDataPacketsLimit
         : connection.transportSettings.maxBatchSize;
-    return ioBufBatch.getPktSent() < batchSize ||
-        connection.lossState.srtt == 0us ||
+    return packetsWritten() < batchSize || connection.lossState.srtt == 0us ||
         Clock::now() - writeLoopBeginTime < connection.lossState.srtt /
             connection.transportSettings.writeLimitRttFraction;
   };
-  while (scheduler.hasData() && ioBufBatch.getPktSent() < packetLimit &&
+  while (scheduler.hasData() && packetsWritten() < packetLimit &&
          timeLimitHelper()) {
     auto packetNum = getNextPacketNum(connection, pnSpace);
     auto header = builder(srcConnId, dstConnId, packetNum, version, token);
+    bool shortHeader = header.getHeaderForm() == HeaderForm::Short;
     uint32_t writableBytes = folly::to<uint32_t>(std::min<uint64_t>(
         connection.udpSendPacketLen, writableBytesFunc(connection)));
     uint64_t cipherOverhead = aead.getCipherOverhead();
@@ -950,10 +1213,27 @@ uint64_t writeConnectionDataToSocket(
         getAckState(connection, pnSpace).largestAckedByPeer,
         connection.version.value_or(*connection.originalVersion));
     pktBuilder.setCipherOverhead(cipherOverhead);
-    auto result =
-        scheduler.scheduleFramesForPacket(std::move(pktBuilder), writableBytes);
+    if (shortHeader) {
+      // Let the builder write the body right behind room for the header so
+      // that the packet can be sealed in place.
+      auto bodyLen = kMaxShortHeaderSize + connection.udpSendPacketLen;
+      auto bodyBuf = connection.bufPool ? connection.bufPool->acquire(bodyLen)
+                                        : folly::IOBuf::create(bodyLen);
+      bodyBuf->advance(kMaxShortHeaderSize);
+      pktBuilder.setBodyBuffer(std::move(bodyBuf));
+    }
+    auto result = QUIC_PIPELINE_TIMED(
+        PacketBuild,
+        scheduler.scheduleFramesForPacket(
+            std::move(pktBuilder), writableBytes));
     auto& packet = result.second;
     if (!packet || packet->packet.frames.empty()) {
+      if (!sealAndWritePending()) {
+        if (connection.loopDetectorCallback) {
+          connection.debugState.noWriteReason = NoWriteReason::SOCKET_FAILURE;
+        }
+        return ioBufBatch.getPktSent();
+      }
       ioBufBatch.flush();
       if (connection.loopDetectorCallback) {
         connection.debugState.noWriteReason = NoWriteReason::NO_FRAME;
@@ -962,6 +1242,12 @@ uint64_t writeConnectionDataToSocket(
     }
     if (!packet->body) {
       // No more space remaining.
+      if (!sealAndWritePending()) {
+        if (connection.loopDetectorCallback) {
+          connection.debugState.noWriteReason = NoWriteReason::SOCKET_FAILURE;
+        }
+        return ioBufBatch.getPktSent();
+      }
       ioBufBatch.flush();
       if (connection.loopDetectorCallback) {
         connection.debugState.noWriteReason = NoWriteReason::NO_BODY;
@@ -971,47 +1257,48 @@ uint64_t writeConnectionDataToSocket(
     packet->header->coalesce();
     auto headerLen = packet->header->length();
     auto bodyLen = packet->body->computeChainDataLength();
-    auto unencrypted =
-        folly::IOBuf::create(headerLen + bodyLen + aead.getCipherOverhead());
-    auto bodyCursor = folly::io::Cursor(packet->body.get());
-    bodyCursor.pull(unencrypted->writableData() + headerLen, bodyLen);
-    unencrypted->advance(headerLen);
-    unencrypted->append(bodyLen);
-    auto packetBuf =
-        aead.encrypt(std::move(unencrypted), packet->header.get(), packetNum);
-    DCHECK(packetBuf->headroom() == headerLen);
-    packetBuf->clear();
-    auto headerCursor = folly::io::Cursor(packet->header.get());
-    headerCursor.pull(packetBuf->writableData(), headerLen);
-    packetBuf->append(headerLen + bodyLen + aead.getCipherOverhead());
-
-    HeaderForm headerForm = packet->packet.header.getHeaderForm();
-    encryptPacketHeader(
-        headerForm,
-        packetBuf->writableData(),
-        headerLen,
-        packetBuf->data() + headerLen,
-        packetBuf->length() - headerLen,
-        headerCipher);
-    auto encodedSize = packetBuf->computeChainDataLength();
-    bool ret = ioBufBatch.write(std::move(packetBuf), encodedSize);
-
-    if (ret) {
-      // update stats and connection
-      QUIC_STATS(connection.infoCallback, onWrite, encodedSize);
-      QUIC_STATS(connection.infoCallback, onPacketSent);
+    auto packetLen = headerLen + bodyLen + cipherOverhead;
+    Buf plaintext;
+    const auto& body = *packet->body;
+    if (!body.isChained() && !body.isSharedOne() &&
+        body.headroom() >= headerLen && body.tailroom() >= cipherOverhead) {
+      // The body is already laid out in one buffer, it can be sealed where it
+      // is with the header put in front of it afterwards.
+      plaintext = std::move(packet->body);
+    } else {
+      plaintext = connection.bufPool ? connection.bufPool->acquire(packetLen)
+                                     : folly::IOBuf::create(packetLen);
+      auto bodyCursor = folly::io::Cursor(packet->body.get());
+      bodyCursor.pull(plaintext->writableData() + headerLen, bodyLen);
+      plaintext->advance(headerLen);
+      plaintext->append(bodyLen);
     }
+    plaintexts.push_back(std::move(plaintext));
+    headers.push_back(std::move(packet->header));
+    packetNums.push_back(packetNum);
+    headerForms.push_back(packet->packet.header.getHeaderForm());
 
     updateConnection(
         connection,
         std::move(result.first),
         std::move(result.second->packet),
         Clock::now(),
-        folly::to<uint32_t>(encodedSize));
+        folly::to<uint32_t>(packetLen));
+    auto& appDataPackets =
+        connection.outstandingPackets[PacketNumberSpace::AppData];
+    if (connection.transportSettings.resendClonedPacketBody && shortHeader &&
+        !appDataPackets.empty() &&
+        appDataPackets.back().packet.header.getPacketSequenceNum() ==
+            packetNum) {
+      // The plaintext gets sealed in place, so the body has to be copied out
+      // before that.
+      appDataPackets.back().body =
+          folly::IOBuf::copyBuffer(plaintexts.back()->data(), bodyLen);
+    }
 
-    // if ioBufBatch.write returns false
+    // if sealAndWritePending returns false
     // it is because a flush() call failed
-    if (!ret) {
+    if (plaintexts.size() >= sealBatchSize && !sealAndWritePending()) {
       if (connection.loopDetectorCallback) {
         connection.debugState.noWriteReason = NoWriteReason::SOCKET_FAILURE;
       }
@@ -1019,6 +1306,12 @@ uint64_t writeConnectionDataToSocket(
     }
   }
 
+  if (!sealAndWritePending()) {
+    if (connection.loopDetectorCallback) {
+      connection.debugState.noWriteReason = NoWriteReason::SOCKET_FAILURE;
+    }
+    return ioBufBatch.getPktSent();
+  }
   ioBufBatch.flush();
   return ioBufBatch.getPktSent();
 }
@@ -1056,6 +1349,49 @@ uint64_t writeProbingDataToSocket(
   return written;
 }
 
+uint64_t writePmtuProbeToSocket(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const ConnectionId& srcConnId,
+    const ConnectionId& dstConnId,
+    const HeaderBuilder& builder,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher,
+    QuicVersion version) {
+  auto probeSize = *connection.pmtuDiscoveryState.probeSize;
+  if (congestionControlWritableBytes(connection) < probeSize) {
+    return 0;
+  }
+  // The packets are built as large as udpSendPacketLen, it is the probe's
+  // size only for the probe.
+  auto udpSendPacketLen = connection.udpSendPacketLen;
+  connection.udpSendPacketLen = probeSize;
+  SCOPE_EXIT {
+    connection.udpSendPacketLen = udpSendPacketLen;
+  };
+  auto packetNum = getNextPacketNum(connection, PacketNumberSpace::AppData);
+  PmtuProbeScheduler scheduler(connection);
+  auto written = writeConnectionDataToSocket(
+      sock,
+      connection,
+      srcConnId,
+      dstConnId,
+      builder,
+      PacketNumberSpace::AppData,
+      scheduler,
+      unlimitedWritableBytes,
+      1,
+      aead,
+      headerCipher,
+      version);
+  if (written) {
+    VLOG(10) << nodeToString(connection.nodeType)
+             << " wrote PMTU probe size=" << probeSize << " " << connection;
+    onPmtuProbeSent(connection, packetNum);
+  }
+  return written;
+}
+
 WriteDataReason shouldWriteData(const QuicConnectionStateBase& conn) {
   if (conn.pendingEvents.numProbePackets) {
     VLOG(10) << nodeToString(conn.nodeType) << " needs write because of PTO"
@@ -1112,7 +1448,7 @@ WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn) {
   if (!conn.pendingEvents.resets.empty()) {
     return WriteDataReason::RESET;
   }
-  if (conn.streamManager->hasWindowUpdates()) {
+  if (conn.streamManager->hasUrgentWindowUpdates()) {
     return WriteDataReason::STREAM_WINDOW_UPDATE;
   }
   if (conn.pendingEvents.connWindowUpdate) {
@@ -1134,6 +1470,13 @@ WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn) {
   if ((conn.pendingEvents.pathChallenge != folly::none)) {
     return WriteDataReason::PATHCHALLENGE;
   }
+  // Datagrams are only sent in 1-RTT packets.
+  if (conn.oneRttWriteCipher && !conn.datagramState.writeBuffer.empty()) {
+    return WriteDataReason::DATAGRAM;
+  }
+  if (conn.oneRttWriteCipher && hasPendingPmtuProbe(conn)) {
+    return WriteDataReason::PMTU_PROBE;
+  }
   return WriteDataReason::NO_WRITE;
 }
 
@@ -203,6 +203,29 @@ void encryptPacketHeader(
     size_t bodyLen,
     const PacketNumberCipher& headerCipher);
 
+/**
+ * Encrypts the headers of a batch of packets whose bodies are already
+ * encrypted. Each packet must be a single buffer starting with its header,
+ * whose length is given in headerLens. The header protection masks of the
+ * whole batch are generated with one call into the headerCipher.
+ */
+void encryptPacketHeaders(
+    const std::vector<HeaderForm>& headerForms,
+    const std::vector<size_t>& headerLens,
+    std::vector<Buf>& packets,
+    const PacketNumberCipher& headerCipher);
+
+/**
+ * Returns how many packets the batch writer accumulates before writing. This
+ * is maxBatchSize unless adaptiveWriteBatchSize is set, in which case a paced
+ * connection puts its whole pacing burst in one batch and an unpaced one as
+ * many packets as the congestion window allows, up to
+ * kMaxAdaptiveWriteBatchSize. The result never exceeds packetLimit.
+ */
+uint32_t getWriteBatchSize(
+    const QuicConnectionStateBase& conn,
+    uint64_t packetLimit);
+
 /**
  * Writes the connections data to the socket using the header
  * builder as well as the scheduler. This will write the amount of
@@ -237,8 +260,23 @@ uint64_t writeProbingDataToSocket(
     const PacketNumberCipher& headerCipher,
     QuicVersion version);
 
+/**
+ * Writes the pending path MTU probe, one packet of the probe size, once the
+ * congestion window has room for it. Returns the number of packets written.
+ */
+uint64_t writePmtuProbeToSocket(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const ConnectionId& srcConnId,
+    const ConnectionId& dstConnId,
+    const HeaderBuilder& builder,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher,
+    QuicVersion version);
+
 HeaderBuilder LongHeaderBuilder(LongHeader::Types packetType);
-HeaderBuilder ShortHeaderBuilder();
+HeaderBuilder ShortHeaderBuilder(
+    ProtectionType keyPhase = ProtectionType::KeyPhaseZero);
 
 void maybeSendStreamLimitUpdates(QuicConnectionStateBase& conn);
 
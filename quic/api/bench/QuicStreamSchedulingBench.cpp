@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// How the stream manager's stream sets and the stream frame scheduler scale
+// with the number of streams of a connection, from 10 to 100K. A quarter of
+// the streams are idle, a quarter have data to write, a quarter have data
+// to read and a quarter have both.
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/api/QuicPacketScheduler.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/QuicStreamFunctions.h>
+
+using namespace quic;
+
+namespace {
+
+constexpr uint64_t kBenchFlowControlWindow = 1ull << 40;
+
+bool benchWritable(size_t index) {
+  return index % 4 == 1 || index % 4 == 3;
+}
+
+bool benchReadable(size_t index) {
+  return index % 4 == 2 || index % 4 == 3;
+}
+
+Buf benchData(size_t len) {
+  auto data = folly::IOBuf::create(len);
+  data->append(len);
+  return data;
+}
+
+void makeReadable(QuicStreamState& stream) {
+  stream.readBuffer.emplace_back(
+      benchData(100), stream.currentReadOffset, false);
+  stream.conn.streamManager->updateReadableStreams(stream);
+}
+
+struct BenchConnection {
+  QuicServerConnectionState conn;
+  std::vector<StreamId> streamIds;
+
+  // With room for as many more streams to be opened.
+  explicit BenchConnection(size_t numStreams) {
+    conn.flowControlState.peerAdvertisedMaxOffset = kBenchFlowControlWindow;
+    conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        kBenchFlowControlWindow;
+    conn.streamManager->setMaxLocalBidirectionalStreams(
+        std::numeric_limits<uint32_t>::max());
+    for (size_t i = 0; i < numStreams; ++i) {
+      streamIds.push_back(openStream(benchWritable(i), benchReadable(i)));
+    }
+  }
+
+  StreamId openStream(bool writable, bool readable) {
+    auto stream = conn.streamManager->createNextBidirectionalStream().value();
+    if (writable) {
+      writeDataToQuicStream(*stream, benchData(100), false);
+    }
+    if (readable) {
+      makeReadable(*stream);
+    }
+    return stream->id;
+  }
+
+  RegularQuicPacketBuilder makeBuilder() {
+    return RegularQuicPacketBuilder(
+        conn.udpSendPacketLen,
+        ShortHeader(
+            ProtectionType::KeyPhaseZero,
+            ConnectionId(std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}),
+            1000),
+        900 /* largestAcked */);
+  }
+};
+
+void getStream(size_t iters, size_t numStreams) {
+  folly::Optional<BenchConnection> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numStreams);
+  }
+  // Strided, so that consecutive lookups are not for neighbours.
+  size_t index = 0;
+  while (iters--) {
+    index = (index + 7919) % numStreams;
+    folly::doNotOptimizeAway(
+        bench->conn.streamManager->getStream(bench->streamIds[index]));
+  }
+  BENCHMARK_SUSPEND {
+    bench.clear();
+  }
+}
+
+// A stream going in and out of the writable streams, alternately, among the
+// streams that stay writable.
+void updateWritableStreams(size_t iters, size_t numStreams) {
+  folly::Optional<BenchConnection> bench;
+  Buf data;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numStreams);
+    data = benchData(100);
+  }
+  size_t index = 0;
+  while (iters--) {
+    auto stream = bench->conn.streamManager->findStream(
+        bench->streamIds[index % numStreams]);
+    if (stream->writeBuffer.empty()) {
+      stream->writeBuffer.append(data->clone());
+    } else {
+      stream->writeBuffer.move();
+    }
+    bench->conn.streamManager->updateWritableStreams(*stream);
+    index++;
+  }
+  BENCHMARK_SUSPEND {
+    bench.clear();
+  }
+}
+
+void updateReadableStreams(size_t iters, size_t numStreams) {
+  folly::Optional<BenchConnection> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numStreams);
+  }
+  size_t index = 0;
+  while (iters--) {
+    auto stream = bench->conn.streamManager->findStream(
+        bench->streamIds[index % numStreams]);
+    if (stream->readBuffer.empty()) {
+      makeReadable(*stream);
+    } else {
+      stream->readBuffer.clear();
+      bench->conn.streamManager->updateReadableStreams(*stream);
+    }
+    index++;
+  }
+  BENCHMARK_SUSPEND {
+    bench.clear();
+  }
+}
+
+// Scheduling one packet of stream frames. The scheduler does not take the
+// data off the streams, so every packet is scheduled from the same streams,
+// starting where the previous one stopped.
+void writeStreams(size_t iters, size_t numStreams) {
+  folly::Optional<BenchConnection> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numStreams);
+  }
+  StreamFrameScheduler scheduler(bench->conn);
+  while (iters--) {
+    folly::Optional<RegularQuicPacketBuilder> builder;
+    BENCHMARK_SUSPEND {
+      builder.emplace(bench->makeBuilder());
+    }
+    scheduler.writeStreams(*builder);
+    BENCHMARK_SUSPEND {
+      builder.clear();
+    }
+  }
+  BENCHMARK_SUSPEND {
+    bench.clear();
+  }
+}
+
+// Closing and removing the oldest stream and opening one in its place, so
+// the number of streams stays the same.
+void closeAndOpenStream(size_t iters, size_t numStreams) {
+  folly::Optional<BenchConnection> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(numStreams);
+  }
+  size_t oldest = 0;
+  while (iters--) {
+    auto index = oldest % numStreams;
+    auto id = bench->streamIds[index];
+    auto stream = bench->conn.streamManager->findStream(id);
+    stream->sendState = StreamSendState::Closed_E;
+    stream->recvState = StreamRecvState::Closed_E;
+    bench->conn.streamManager->removeClosedStream(id);
+    bench->streamIds[index] =
+        bench->openStream(benchWritable(index), benchReadable(index));
+    oldest++;
+  }
+  BENCHMARK_SUSPEND {
+    bench.clear();
+  }
+}
+
+} // namespace
+
+BENCHMARK_PARAM(getStream, 10)
+BENCHMARK_PARAM(getStream, 100)
+BENCHMARK_PARAM(getStream, 1000)
+BENCHMARK_PARAM(getStream, 10000)
+BENCHMARK_PARAM(getStream, 100000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(updateWritableStreams, 10)
+BENCHMARK_PARAM(updateWritableStreams, 100)
+BENCHMARK_PARAM(updateWritableStreams, 1000)
+BENCHMARK_PARAM(updateWritableStreams, 10000)
+BENCHMARK_PARAM(updateWritableStreams, 100000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(updateReadableStreams, 10)
+BENCHMARK_PARAM(updateReadableStreams, 100)
+BENCHMARK_PARAM(updateReadableStreams, 1000)
+BENCHMARK_PARAM(updateReadableStreams, 10000)
+BENCHMARK_PARAM(updateReadableStreams, 100000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(writeStreams, 10)
+BENCHMARK_PARAM(writeStreams, 100)
+BENCHMARK_PARAM(writeStreams, 1000)
+BENCHMARK_PARAM(writeStreams, 10000)
+BENCHMARK_PARAM(writeStreams, 100000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(closeAndOpenStream, 10)
+BENCHMARK_PARAM(closeAndOpenStream, 100)
+BENCHMARK_PARAM(closeAndOpenStream, 1000)
+BENCHMARK_PARAM(closeAndOpenStream, 10000)
+BENCHMARK_PARAM(closeAndOpenStream, 100000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -12,6 +12,7 @@
 #include <quic/client/handshake/FizzClientQuicHandshakeContext.h>
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/state/StateData.h>
+#include <quic/state/test/MockQuicStats.h>
 
 constexpr const auto kNumLoops = 64;
 constexpr const auto kMaxBufs = 10;
@@ -49,6 +50,37 @@ class TestPacketBatchWriter : public IOBufBatchWriter {
   size_t bufSize_{0};
 };
 
+// Chains the buffers like the GSO writer does, so the batch is not empty
+class TestChainBatchWriter : public IOBufBatchWriter {
+ public:
+  explicit TestChainBatchWriter(size_t maxBufs) : maxBufs_(maxBufs) {}
+
+  void reset() override {
+    buf_.reset();
+    bufNum_ = 0;
+  }
+
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t /*unused*/)
+      override {
+    if (buf_) {
+      buf_->prependChain(std::move(buf));
+    } else {
+      buf_ = std::move(buf);
+    }
+    return ++bufNum_ >= maxBufs_;
+  }
+
+  ssize_t write(
+      folly::AsyncUDPSocket& /*unused*/,
+      const folly::SocketAddress& /*unused*/) override {
+    return size();
+  }
+
+ private:
+  size_t maxBufs_;
+  size_t bufNum_{0};
+};
+
 void RunTest(int numBatch) {
   folly::EventBase evb;
   folly::AsyncUDPSocket sock(&evb);
@@ -85,5 +117,50 @@ TEST(QuicBatch, TestBatchingNoFlush) {
 TEST(QuicBatch, TestBatching) {
   RunTest(kMaxBufs);
 }
+
+TEST(QuicBatch, TestWriteStats) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  folly::SocketAddress peerAddress{"127.0.0.1", 1234};
+  QuicClientConnectionState conn(
+      FizzClientQuicHandshakeContext::Builder().build());
+  ::testing::NiceMock<MockQuicStats> stats;
+  conn.infoCallback = &stats;
+  QuicConnectionStateBase::HappyEyeballsState happyEyeballsState;
+
+  IOBufQuicBatch ioBufBatch(
+      std::make_unique<TestChainBatchWriter>(kMaxBufs),
+      sock,
+      peerAddress,
+      conn,
+      happyEyeballsState);
+
+  std::string strTest("Test");
+  EXPECT_CALL(
+      stats,
+      onWriteFlush(QuicTransportStatsCallback::WriteFlushReason::WRITER_FULL));
+  EXPECT_CALL(
+      stats, onWriteSyscall(1, kMaxBufs, kMaxBufs * strTest.length()));
+  for (size_t i = 0; i < kMaxBufs; i++) {
+    auto buf = folly::IOBuf::copyBuffer(strTest);
+    EXPECT_TRUE(ioBufBatch.write(std::move(buf), strTest.length()));
+  }
+  ::testing::Mock::VerifyAndClearExpectations(&stats);
+
+  EXPECT_CALL(
+      stats,
+      onWriteFlush(QuicTransportStatsCallback::WriteFlushReason::END_OF_WRITE));
+  EXPECT_CALL(stats, onWriteSyscall(1, 1, strTest.length()));
+  EXPECT_TRUE(ioBufBatch.write(folly::IOBuf::copyBuffer(strTest), 4));
+  EXPECT_TRUE(ioBufBatch.flush());
+  ::testing::Mock::VerifyAndClearExpectations(&stats);
+
+  // Nothing left to flush
+  EXPECT_CALL(stats, onWriteFlush(::testing::_)).Times(0);
+  EXPECT_CALL(stats, onWriteSyscall(::testing::_, ::testing::_, ::testing::_))
+      .Times(0);
+  EXPECT_TRUE(ioBufBatch.flush());
+  EXPECT_EQ(kMaxBufs + 1, ioBufBatch.getPktSent());
+}
 } // namespace testing
 } // namespace quic
@@ -155,6 +155,31 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD5(
       writeChain,
       WriteResult(StreamId, SharedBuf, bool, bool, DeliveryCallback*));
+  std::vector<QuicSocket::WriteResult> writeChains(
+      std::vector<StreamWrite> writes,
+      bool cork) override {
+    std::vector<QuicSocket::WriteResult> results;
+    for (auto& write : writes) {
+      results.push_back(writeChain(
+          write.id, std::move(write.data), write.eof, cork, write.cb));
+    }
+    return results;
+  }
+  folly::Expected<StreamId, LocalErrorCode> sendRequest(
+      Buf request,
+      ReadCallback* cb,
+      DeliveryCallback* deliveryCb,
+      bool replaySafe) override {
+    SharedBuf sharedRequest(request.release());
+    return sendRequest(sharedRequest, cb, deliveryCb, replaySafe);
+  }
+  MOCK_METHOD4(
+      sendRequest,
+      folly::Expected<StreamId, LocalErrorCode>(
+          SharedBuf,
+          ReadCallback*,
+          DeliveryCallback*,
+          bool));
   MOCK_METHOD3(
       registerDeliveryCallback,
       folly::Expected<folly::Unit, LocalErrorCode>(
@@ -177,6 +202,15 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD1(attachEventBase, void(folly::EventBase*));
   MOCK_METHOD0(detachEventBase, void());
   MOCK_METHOD1(setControlStream, folly::Optional<LocalErrorCode>(StreamId));
+  MOCK_METHOD3(
+      setStreamPriority,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          StreamId,
+          PriorityLevel,
+          bool));
+  MOCK_METHOD1(
+      setStreamRepair,
+      folly::Expected<folly::Unit, LocalErrorCode>(StreamId));
 
   MOCK_METHOD2(
       setPeekCallback,
@@ -234,6 +268,37 @@ class MockQuicSocket : public QuicSocket {
 
   MOCK_METHOD1(setCongestionControl, void(CongestionControlType));
 
+  MOCK_METHOD1(
+      setDatagramCallback,
+      folly::Expected<folly::Unit, LocalErrorCode>(DatagramCallback*));
+  MOCK_CONST_METHOD0(getDatagramSizeLimit, uint16_t());
+  folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf buf,
+      folly::Optional<std::chrono::microseconds> maxDelay) override {
+    SharedBuf sharedBuf(buf.release());
+    return writeDatagram(sharedBuf, maxDelay);
+  }
+  MOCK_METHOD2(
+      writeDatagram,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          SharedBuf,
+          folly::Optional<std::chrono::microseconds>));
+  folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost) override {
+    auto res = readDatagramsNaked(atMost);
+    if (res.hasError()) {
+      return folly::makeUnexpected(res.error());
+    }
+    std::vector<Buf> datagrams;
+    for (auto datagram : res.value()) {
+      datagrams.emplace_back(datagram);
+    }
+    return datagrams;
+  }
+  MOCK_METHOD1(
+      readDatagramsNaked,
+      folly::Expected<std::vector<folly::IOBuf*>, LocalErrorCode>(size_t));
+
   ConnectionCallback* cb_;
 
   folly::Function<bool(const folly::Optional<std::string>&, const Buf&)>
@@ -63,6 +63,17 @@ class MockReadCallback : public QuicSocket::ReadCallback {
           std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>));
 };
 
+class MockBatchReadCallback : public MockReadCallback {
+ public:
+  ~MockBatchReadCallback() override = default;
+  GMOCK_METHOD1_(
+      ,
+      noexcept,
+      ,
+      readAvailableBatch,
+      void(folly::Range<const StreamId*>));
+};
+
 class MockPeekCallback : public QuicSocket::PeekCallback {
  public:
   ~MockPeekCallback() override = default;
@@ -130,6 +141,17 @@ class MockDeliveryCallback : public QuicSocket::DeliveryCallback {
   MOCK_METHOD2(onCanceled, void(StreamId, uint64_t));
 };
 
+class MockBatchDeliveryCallback : public MockDeliveryCallback {
+ public:
+  ~MockBatchDeliveryCallback() override = default;
+  MOCK_METHOD3(
+      onDeliveryAckBatch,
+      void(
+          StreamId,
+          folly::Range<const uint64_t*>,
+          std::chrono::microseconds));
+};
+
 class MockDataExpiredCallback : public QuicSocket::DataExpiredCallback {
  public:
   ~MockDataExpiredCallback() override = default;
@@ -142,6 +164,12 @@ class MockDataRejectedCallback : public QuicSocket::DataRejectedCallback {
   GMOCK_METHOD2_(, noexcept, , onDataRejected, void(StreamId, uint64_t));
 };
 
+class MockDatagramCallback : public QuicSocket::DatagramCallback {
+ public:
+  ~MockDatagramCallback() override = default;
+  GMOCK_METHOD0_(, noexcept, , onDatagramsAvailable, void());
+};
+
 class MockQuicTransport : public QuicServerTransport {
  public:
   using Ptr = std::shared_ptr<MockQuicTransport>;
@@ -269,7 +297,28 @@ class MockQuicTransport : public QuicServerTransport {
       setTransportInfoCallback,
       void(QuicTransportStatsCallback*));
 
+  GMOCK_METHOD1_(
+      ,
+      noexcept,
+      ,
+      setTransportStatsCounters,
+      void(QuicTransportStatsCounters*));
+
   GMOCK_METHOD1_(, noexcept, , setConnectionIdAlgo, void(ConnectionIdAlgo*));
+
+  MOCK_CONST_METHOD0(isMigratable, bool());
+
+  void moveToEventBase(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> sock) override {
+    moveToEventBase(evb, sock.get());
+  }
+
+  MOCK_METHOD2(
+      moveToEventBase,
+      void(folly::EventBase*, folly::AsyncUDPSocket*));
+
+  MOCK_METHOD0(issueNewConnectionId, bool());
 };
 
 class MockLoopDetectorCallback : public LoopDetectorCallback {
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <folly/Portability.h>
+
+#if FOLLY_HAS_COROUTINES
+
+#include <quic/api/QuicAsyncStream.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/GTest.h>
+#include <quic/api/test/MockQuicSocket.h>
+#include <quic/api/test/Mocks.h>
+#include <quic/common/test/AllocationCounter.h>
+
+using namespace testing;
+using folly::IOBuf;
+
+namespace quic {
+namespace test {
+
+constexpr StreamId kStreamId = 4;
+
+// Runs until its first suspension and frees itself once done, so that what
+// a test counts on a resumption is only what the stream does.
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() noexcept {
+      return {};
+    }
+
+    folly::coro::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    folly::coro::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    void return_void() noexcept {}
+
+    void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+DetachedTask readOnce(
+    QuicAsyncStream& stream,
+    folly::Optional<QuicAsyncStream::ReadResult>& result) {
+  result = co_await stream.read();
+}
+
+DetachedTask writeOnce(
+    QuicAsyncStream& stream,
+    Buf data,
+    bool eof,
+    folly::Optional<QuicAsyncStream::WriteResult>& result) {
+  result = co_await stream.write(std::move(data), eof);
+}
+
+DetachedTask deliveredOnce(
+    QuicAsyncStream& stream,
+    uint64_t offset,
+    folly::Optional<bool>& result) {
+  result = co_await stream.delivered(offset);
+}
+
+MockQuicSocket::ReadResult readResult(const std::string& str, bool eof) {
+  return std::pair<IOBuf*, bool>(
+      IOBuf::copyBuffer(str.c_str(), str.size()).release(), eof);
+}
+
+class QuicAsyncStreamTest : public Test {
+ public:
+  void SetUp() override {
+    socket_ = std::make_shared<NiceMock<MockQuicSocket>>(&evb_, connCb_);
+    EXPECT_CALL(*socket_, setReadCallback(kStreamId, NotNull()))
+        .WillOnce(DoAll(SaveArg<1>(&readCb_), Return(folly::unit)));
+    EXPECT_CALL(*socket_, pauseRead(kStreamId));
+    stream_ = std::make_unique<QuicAsyncStream>(socket_, kStreamId);
+    Mock::VerifyAndClearExpectations(socket_.get());
+  }
+
+  void TearDown() override {
+    stream_.reset();
+  }
+
+  // Leaves a read waiting for data.
+  void waitForRead(folly::Optional<QuicAsyncStream::ReadResult>& result) {
+    EXPECT_CALL(*socket_, readNaked(kStreamId, _))
+        .WillOnce(Return(std::pair<IOBuf*, bool>(nullptr, false)));
+    EXPECT_CALL(*socket_, resumeRead(kStreamId));
+    readOnce(*stream_, result);
+    EXPECT_FALSE(result.has_value());
+    Mock::VerifyAndClearExpectations(socket_.get());
+  }
+
+  // Leaves a write waiting for the peer's flow control.
+  void waitForWrite(
+      Buf data,
+      bool eof,
+      folly::Optional<QuicAsyncStream::WriteResult>& result) {
+    EXPECT_CALL(*socket_, getStreamFlowControl(kStreamId))
+        .WillOnce(Return(QuicSocket::FlowControlState(0, 100, 100, 100)));
+    EXPECT_CALL(*socket_, notifyPendingWriteOnStream(kStreamId, NotNull()))
+        .WillOnce(DoAll(SaveArg<1>(&writeCb_), Return(folly::unit)));
+    writeOnce(*stream_, std::move(data), eof, result);
+    EXPECT_FALSE(result.has_value());
+    Mock::VerifyAndClearExpectations(socket_.get());
+  }
+
+  // Leaves a wait for the delivery of offset.
+  void waitForDelivery(uint64_t offset, folly::Optional<bool>& result) {
+    EXPECT_CALL(
+        *socket_, registerDeliveryCallback(kStreamId, offset, NotNull()))
+        .WillOnce(DoAll(SaveArg<2>(&deliveryCb_), Return(folly::unit)));
+    deliveredOnce(*stream_, offset, result);
+    EXPECT_FALSE(result.has_value());
+    Mock::VerifyAndClearExpectations(socket_.get());
+  }
+
+ protected:
+  folly::EventBase evb_;
+  MockConnectionCallback connCb_;
+  std::shared_ptr<NiceMock<MockQuicSocket>> socket_;
+  std::unique_ptr<QuicAsyncStream> stream_;
+  QuicSocket::ReadCallback* readCb_{nullptr};
+  QuicSocket::WriteCallback* writeCb_{nullptr};
+  QuicSocket::DeliveryCallback* deliveryCb_{nullptr};
+};
+
+TEST_F(QuicAsyncStreamTest, ReadReady) {
+  EXPECT_CALL(*socket_, readNaked(kStreamId, 0))
+      .WillOnce(Return(readResult("hello", false)));
+  EXPECT_CALL(*socket_, resumeRead(_)).Times(0);
+  folly::Optional<QuicAsyncStream::ReadResult> result;
+  readOnce(*stream_, result);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->hasValue());
+  EXPECT_EQ((*result)->first->moveToFbString().toStdString(), "hello");
+  EXPECT_FALSE((*result)->second);
+}
+
+TEST_F(QuicAsyncStreamTest, ReadWaitsForData) {
+  folly::Optional<QuicAsyncStream::ReadResult> result;
+  waitForRead(result);
+
+  InSequence enforceOrder;
+  EXPECT_CALL(*socket_, pauseRead(kStreamId));
+  EXPECT_CALL(*socket_, readNaked(kStreamId, 0))
+      .WillOnce(Return(readResult("world", true)));
+  readCb_->readAvailable(kStreamId);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->hasValue());
+  EXPECT_EQ((*result)->first->moveToFbString().toStdString(), "world");
+  EXPECT_TRUE((*result)->second);
+
+  // The eof unset the read callback already.
+  EXPECT_CALL(*socket_, setReadCallback(_, _)).Times(0);
+}
+
+TEST_F(QuicAsyncStreamTest, ReadError) {
+  folly::Optional<QuicAsyncStream::ReadResult> result;
+  waitForRead(result);
+
+  std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>> error(
+      LocalErrorCode::CONNECTION_RESET, folly::none);
+  ScopedAllocationCounter counter;
+  readCb_->readError(kStreamId, error);
+  EXPECT_EQ(counter.count(), 0u);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->hasError());
+  EXPECT_EQ(result->error(), LocalErrorCode::CONNECTION_RESET);
+
+  // Later reads fail right away.
+  result.reset();
+  EXPECT_CALL(*socket_, readNaked(_, _)).Times(0);
+  readOnce(*stream_, result);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result->error(), LocalErrorCode::CONNECTION_RESET);
+}
+
+TEST_F(QuicAsyncStreamTest, WriteReady) {
+  EXPECT_CALL(*socket_, getStreamFlowControl(kStreamId))
+      .WillOnce(Return(QuicSocket::FlowControlState(100, 100, 100, 100)));
+  EXPECT_CALL(*socket_, notifyPendingWriteOnStream(_, _)).Times(0);
+  EXPECT_CALL(*socket_, writeChain(kStreamId, _, false, false, nullptr))
+      .WillOnce(Return(nullptr));
+  folly::Optional<QuicAsyncStream::WriteResult> result;
+  writeOnce(*stream_, IOBuf::copyBuffer("hello"), false, result);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_TRUE(result->hasValue());
+}
+
+TEST_F(QuicAsyncStreamTest, WriteWaitsForFlowControl) {
+  folly::Optional<QuicAsyncStream::WriteResult> result;
+  waitForWrite(IOBuf::copyBuffer("hello"), true, result);
+
+  EXPECT_CALL(*socket_, writeChain(kStreamId, _, true, false, nullptr))
+      .WillOnce(Invoke([](StreamId,
+                          MockQuicSocket::SharedBuf data,
+                          bool,
+                          bool,
+                          QuicSocket::DeliveryCallback*)
+                          -> MockQuicSocket::WriteResult {
+        EXPECT_EQ(data->moveToFbString().toStdString(), "hello");
+        return nullptr;
+      }));
+  writeCb_->onStreamWriteReady(kStreamId, 100);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_TRUE(result->hasValue());
+}
+
+TEST_F(QuicAsyncStreamTest, WriteError) {
+  folly::Optional<QuicAsyncStream::WriteResult> result;
+  waitForWrite(IOBuf::copyBuffer("hello"), false, result);
+
+  std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>> error(
+      LocalErrorCode::STREAM_CLOSED, folly::none);
+  EXPECT_CALL(*socket_, writeChain(_, _, _, _, _)).Times(0);
+  ScopedAllocationCounter counter;
+  writeCb_->onStreamWriteError(kStreamId, error);
+  EXPECT_EQ(counter.count(), 0u);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->hasError());
+  EXPECT_EQ(result->error(), LocalErrorCode::STREAM_CLOSED);
+}
+
+TEST_F(QuicAsyncStreamTest, Delivered) {
+  folly::Optional<bool> result;
+  waitForDelivery(10, result);
+
+  // Resuming the waiter is all the stream does on the ack.
+  ScopedAllocationCounter counter;
+  deliveryCb_->onDeliveryAck(kStreamId, 10, std::chrono::microseconds(0));
+  EXPECT_EQ(counter.count(), 0u);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_TRUE(*result);
+
+  // The stream can wait again once a wait is over.
+  result.reset();
+  waitForDelivery(20, result);
+  deliveryCb_->onDeliveryAck(kStreamId, 20, std::chrono::microseconds(0));
+  ASSERT_TRUE(result.has_value());
+  EXPECT_TRUE(*result);
+}
+
+TEST_F(QuicAsyncStreamTest, DeliveryCanceled) {
+  folly::Optional<bool> result;
+  waitForDelivery(10, result);
+
+  ScopedAllocationCounter counter;
+  deliveryCb_->onCanceled(kStreamId, 10);
+  EXPECT_EQ(counter.count(), 0u);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_FALSE(*result);
+}
+
+TEST_F(QuicAsyncStreamTest, DeliveryRegisterFails) {
+  EXPECT_CALL(*socket_, registerDeliveryCallback(kStreamId, 10, _))
+      .WillOnce(Return(folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED)));
+  folly::Optional<bool> result;
+  deliveredOnce(*stream_, 10, result);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_FALSE(*result);
+}
+
+TEST_F(QuicAsyncStreamTest, DestructionUnsetsCallbacks) {
+  EXPECT_CALL(*socket_, setReadCallback(kStreamId, nullptr));
+  EXPECT_CALL(*socket_, cancelDeliveryCallbacksForStream(kStreamId));
+  stream_.reset();
+}
+
+} // namespace test
+} // namespace quic
+
+#endif // FOLLY_HAS_COROUTINES
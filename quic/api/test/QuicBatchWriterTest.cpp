@@ -8,6 +8,7 @@
 
 #include <quic/api/QuicBatchWriter.h>
 
+#include <folly/portability/Fcntl.h>
 #include <gtest/gtest.h>
 
 namespace quic {
@@ -269,5 +270,291 @@ TEST(QuicBatchWriter, TestBatchingSendmmsgGSOBatcBigSmallPacket) {
   }
 }
 
+TEST(QuicBatchWriter, TestBatchingModeAuto) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  auto batchingMode = quic::resolveBatchingMode(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_AUTO);
+  EXPECT_EQ(
+      batchingMode,
+      sock.getGSO() >= 0 ? quic::QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO
+                         : quic::QuicBatchingMode::BATCHING_MODE_SENDMMSG);
+  EXPECT_EQ(
+      quic::resolveBatchingMode(
+          sock, quic::QuicBatchingMode::BATCHING_MODE_NONE),
+      quic::QuicBatchingMode::BATCHING_MODE_NONE);
+
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_AUTO, kBatchNum);
+  CHECK(batchWriter);
+  std::string strTest(kStrLen, 'A');
+  for (auto j = 0; j < kBatchNum - 1; j++) {
+    auto buf = folly::IOBuf::copyBuffer(strTest);
+    EXPECT_FALSE(batchWriter->append(std::move(buf), kStrLen));
+  }
+  auto buf = folly::IOBuf::copyBuffer(strTest);
+  EXPECT_TRUE(batchWriter->append(std::move(buf), kStrLen));
+}
+
+TEST(QuicBatchWriter, TestBatchingIOUring) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  // falls back to sendmmsg when io_uring isn't available
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_IO_URING, kBatchNum);
+  CHECK(batchWriter);
+  std::string strTest(kStrLen, 'A');
+
+  // run multiple loops
+  for (size_t i = 0; i < kNumLoops; i++) {
+    CHECK(batchWriter->empty());
+    CHECK_EQ(batchWriter->size(), 0);
+    size_t size = 0;
+    for (auto j = 0; j < kBatchNum - 1; j++) {
+      auto buf = folly::IOBuf::copyBuffer(strTest);
+      EXPECT_FALSE(batchWriter->append(std::move(buf), kStrLen));
+      size += kStrLen;
+      CHECK_EQ(batchWriter->size(), size);
+    }
+
+    auto buf = folly::IOBuf::copyBuffer(strTest.c_str(), kStrLen);
+    CHECK(batchWriter->append(std::move(buf), kStrLen));
+    size += kStrLen;
+    EXPECT_EQ(batchWriter->write(sock, peer.address()), size);
+    batchWriter->reset();
+  }
+}
+
+#if MVFST_HAVE_LIBURING
+TEST(QuicBatchWriter, TestIOUringSendsOutliveBatch) {
+  if (!IOUringPacketBatchWriter::isAvailable()) {
+    return;
+  }
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  auto batchWriter = std::make_unique<IOUringPacketBatchWriter>(kBatchNum);
+  for (auto i = 0; i < kBatchNum; i++) {
+    std::string strTest(kStrLen, 'A' + i);
+    batchWriter->append(folly::IOBuf::copyBuffer(strTest), kStrLen);
+  }
+  EXPECT_EQ(batchWriter->write(sock, peer.address()), kBatchNum * kStrLen);
+  // the sends may still be in flight
+  batchWriter->reset();
+  batchWriter.reset();
+
+  // reaps the completions
+  evb.loopOnce();
+  for (auto i = 0; i < kBatchNum; i++) {
+    char data[kStrLenGT];
+    auto ret = ::recv(
+        peer.getNetworkSocket().toFd(), data, sizeof(data), MSG_DONTWAIT);
+    ASSERT_EQ(ret, kStrLen);
+    EXPECT_EQ(std::string(data, kStrLen), std::string(kStrLen, 'A' + i));
+  }
+}
+#endif
+
+TEST(QuicBatchWriter, TestResetRecyclesIntoPool) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  PacketBufferPool pool(kStrLenGT, kBatchNum * 2);
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_SENDMMSG, kBatchNum);
+  CHECK(batchWriter);
+  batchWriter->setBufferPool(&pool);
+
+  for (size_t i = 0; i < kBatchNum; i++) {
+    auto buf = pool.acquire(kStrLen);
+    buf->append(kStrLen);
+    batchWriter->append(std::move(buf), kStrLen);
+  }
+  EXPECT_EQ(0, pool.available());
+  batchWriter->reset();
+  EXPECT_TRUE(batchWriter->empty());
+  EXPECT_EQ(kBatchNum, pool.available());
+}
+
+TEST(QuicBatchWriter, TestZeroCopyBufferTracker) {
+  PacketBufferPool pool(kStrLenGT, kNumLoops);
+  ZeroCopyBufferTracker tracker{folly::NetworkSocket()};
+  tracker.setBufferPool(&pool);
+  for (size_t i = 0; i < kNumLoops; i++) {
+    auto buf = pool.acquire(kStrLen);
+    buf->append(kStrLen);
+    tracker.onSend(std::move(buf));
+  }
+  EXPECT_EQ(tracker.numPending(), kNumLoops);
+  EXPECT_EQ(pool.available(), 0);
+
+  // completions may cover a range of sends, in any order
+  tracker.onCompletion(2, 4);
+  EXPECT_EQ(tracker.numPending(), kNumLoops - 3);
+  EXPECT_EQ(pool.available(), 3);
+  tracker.onCompletion(0, 0);
+  tracker.onCompletion(3, 3);
+  EXPECT_EQ(tracker.numPending(), kNumLoops - 4);
+  tracker.onCompletion(1, kNumLoops - 1);
+  EXPECT_EQ(tracker.numPending(), 0);
+  EXPECT_EQ(pool.available(), kNumLoops);
+
+  // other messages from the error queue are left to the transport
+  struct cmsghdr cmsg;
+  memset(&cmsg, 0, sizeof(cmsg));
+  cmsg.cmsg_level = SOL_SOCKET;
+  EXPECT_FALSE(tracker.handleErrMessage(cmsg));
+}
+
+TEST(QuicBatchWriter, TestCloseAfterZeroCopySends) {
+  PacketBufferPool pool(kStrLenGT, kNumLoops);
+  auto evb = std::make_unique<folly::EventBase>();
+  auto sock = std::make_unique<folly::AsyncUDPSocket>(evb.get());
+  sock->bind(folly::SocketAddress("127.0.0.1", 0));
+  auto fd = sock->getNetworkSocket().toFd();
+  auto tracker = std::make_shared<ZeroCopyBufferTracker>(
+      sock->getNetworkSocket());
+  tracker->setBufferPool(&pool);
+  auto buf = pool.acquire(kStrLen);
+  buf->append(kStrLen);
+  tracker->onSend(std::move(buf));
+
+  // the socket stays open while a send is in flight
+  closeAfterZeroCopySends(std::move(sock), tracker);
+  evb->loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_NE(fcntl(fd, F_GETFD), -1);
+  EXPECT_EQ(tracker->numPending(), 1);
+
+  // and is closed with the event base, leaking the buffer of the send
+  evb.reset();
+  EXPECT_EQ(fcntl(fd, F_GETFD), -1);
+  EXPECT_EQ(tracker->numPending(), 0);
+  EXPECT_EQ(pool.available(), 0);
+
+  // a socket without sends in flight is closed right away
+  folly::EventBase evb2;
+  auto sock2 = std::make_unique<folly::AsyncUDPSocket>(&evb2);
+  sock2->bind(folly::SocketAddress("127.0.0.1", 0));
+  auto fd2 = sock2->getNetworkSocket().toFd();
+  auto tracker2 = std::make_shared<ZeroCopyBufferTracker>(
+      sock2->getNetworkSocket());
+  closeAfterZeroCopySends(std::move(sock2), tracker2);
+  EXPECT_EQ(fcntl(fd2, F_GETFD), -1);
+}
+
+TEST(QuicBatchWriter, TestMultiDestBatchWriter) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer1(&evb);
+  peer1.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer2(&evb);
+  peer2.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  MultiDestBatchWriter writer(&evb, kNumLoops);
+  std::string strTest(kStrLen, 'A');
+  // two full size packets and a short one to peer1, interleaved with a packet
+  // to peer2
+  writer.add(
+      sock,
+      peer1.address(),
+      folly::IOBuf::copyBuffer(strTest.c_str(), kStrLen),
+      kStrLen);
+  writer.add(
+      sock,
+      peer2.address(),
+      folly::IOBuf::copyBuffer(strTest.c_str(), kStrLen),
+      kStrLen);
+  writer.add(
+      sock,
+      peer1.address(),
+      folly::IOBuf::copyBuffer(strTest.c_str(), kStrLen),
+      kStrLen);
+  writer.add(
+      sock,
+      peer1.address(),
+      folly::IOBuf::copyBuffer(strTest.c_str(), kStrLenLT),
+      kStrLenLT);
+  EXPECT_FALSE(writer.empty());
+  EXPECT_EQ(writer.size(), kStrLen * 3 + kStrLenLT);
+  // the packets to peer1 share one message when GSO is available
+  size_t expectedEntries = sock.getGSO() >= 0 ? 2 : 4;
+  EXPECT_EQ(writer.numEntries(), expectedEntries);
+  EXPECT_EQ(writer.flush(), expectedEntries);
+  EXPECT_TRUE(writer.empty());
+  EXPECT_EQ(writer.size(), 0);
+}
+
+TEST(QuicBatchWriter, TestMultiDestBatchWriterFlushesInLoop) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  MultiDestBatchWriter writer(&evb, kNumLoops);
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_NONE, kBatchNum, &writer);
+  CHECK(batchWriter);
+  std::string strTest(kStrLen, 'A');
+  for (size_t i = 0; i < kBatchNum - 1; i++) {
+    auto buf = folly::IOBuf::copyBuffer(strTest.c_str(), kStrLen);
+    EXPECT_FALSE(batchWriter->append(std::move(buf), kStrLen));
+  }
+  auto buf = folly::IOBuf::copyBuffer(strTest.c_str(), kStrLen);
+  EXPECT_TRUE(batchWriter->append(std::move(buf), kStrLen));
+  EXPECT_EQ(batchWriter->write(sock, peer.address()), kStrLen * kBatchNum);
+  batchWriter->reset();
+  EXPECT_TRUE(batchWriter->empty());
+
+  // the packets are only written at the end of the loop
+  EXPECT_EQ(writer.size(), kStrLen * kBatchNum);
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_TRUE(writer.empty());
+}
+
+TEST(QuicBatchWriter, TestMultiDestBatchWriterMaxEntries) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  MultiDestBatchWriter writer(&evb, kBatchNum);
+  std::string strTest(kStrLenGT, 'A');
+  // growing packets can never be coalesced
+  for (size_t i = 0; i < kBatchNum - 1; i++) {
+    writer.add(
+        sock,
+        peer.address(),
+        folly::IOBuf::copyBuffer(strTest.c_str(), kStrLen + i),
+        kStrLen + i);
+  }
+  EXPECT_EQ(writer.numEntries(), kBatchNum - 1);
+  writer.add(
+      sock,
+      peer.address(),
+      folly::IOBuf::copyBuffer(strTest.c_str(), kStrLenGT),
+      kStrLenGT);
+  EXPECT_TRUE(writer.empty());
+}
+
 } // namespace testing
 } // namespace quic
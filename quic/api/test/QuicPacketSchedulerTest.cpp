@@ -24,6 +24,16 @@ using namespace testing;
 
 namespace {
 
+StreamId nextScheduledStream(QuicConnectionStateBase& conn) {
+  return *conn.streamManager->writableStreams().level(kDefaultPriority).head;
+}
+
+StreamId nextScheduledControlStream(QuicConnectionStateBase& conn) {
+  return *conn.streamManager->writableControlStreams()
+              .level(kDefaultPriority)
+              .head;
+}
+
 PacketNum addInitialOutstandingPacket(QuicConnectionStateBase& conn) {
   PacketNum nextPacketNum =
       getNextPacketNum(conn, PacketNumberSpace::Handshake);
@@ -36,7 +46,8 @@ PacketNum addInitialOutstandingPacket(QuicConnectionStateBase& conn) {
       nextPacketNum,
       QuicVersion::QUIC_DRAFT);
   RegularQuicWritePacket packet(std::move(header));
-  conn.outstandingPackets.emplace_back(packet, Clock::now(), 0, true, 0);
+  conn.outstandingPackets[PacketNumberSpace::Initial].emplace_back(
+      packet, Clock::now(), 0, true, 0);
   conn.outstandingHandshakePacketsCount++;
   increaseNextPacketNum(conn, PacketNumberSpace::Handshake);
   return nextPacketNum;
@@ -54,7 +65,8 @@ PacketNum addHandshakeOutstandingPacket(QuicConnectionStateBase& conn) {
       nextPacketNum,
       QuicVersion::QUIC_DRAFT);
   RegularQuicWritePacket packet(std::move(header));
-  conn.outstandingPackets.emplace_back(packet, Clock::now(), 0, true, 0);
+  conn.outstandingPackets[PacketNumberSpace::Handshake].emplace_back(
+      packet, Clock::now(), 0, true, 0);
   conn.outstandingHandshakePacketsCount++;
   increaseNextPacketNum(conn, PacketNumberSpace::Handshake);
   return nextPacketNum;
@@ -67,7 +79,8 @@ PacketNum addOutstandingPacket(QuicConnectionStateBase& conn) {
       conn.clientConnectionId.value_or(quic::test::getTestConnectionId()),
       nextPacketNum);
   RegularQuicWritePacket packet(std::move(header));
-  conn.outstandingPackets.emplace_back(packet, Clock::now(), 0, false, 0);
+  conn.outstandingPackets[PacketNumberSpace::AppData].emplace_back(
+      packet, Clock::now(), 0, false, 0);
   increaseNextPacketNum(conn, PacketNumberSpace::AppData);
   return nextPacketNum;
 }
@@ -313,6 +326,173 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerStreamNotExists) {
   EXPECT_EQ(builder.remainingSpaceInPkt(), originalSpace);
 }
 
+TEST_F(QuicPacketSchedulerTest, CoalescedWindowUpdatesAfterUrgentOnes) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.coalesceStreamWindowUpdates = true;
+  // Room for one MAX_STREAM_DATA frame.
+  conn.transportSettings.maxCoalescedWindowUpdateBytes = 10;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  auto connId = getTestConnectionId();
+  auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream2 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream3 = conn.streamManager->createNextBidirectionalStream().value();
+  conn.streamManager->queueWindowUpdate(stream1->id, false);
+  conn.streamManager->queueWindowUpdate(stream2->id, false);
+  conn.streamManager->queueWindowUpdate(stream3->id);
+
+  WindowUpdateScheduler scheduler(conn);
+  ShortHeader shortHeader(
+      ProtectionType::KeyPhaseZero,
+      connId,
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(shortHeader),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  scheduler.writeWindowUpdates(builder);
+  auto packet = std::move(builder).buildPacket();
+  ASSERT_EQ(2, packet.packet.frames.size());
+  auto urgentFrame = packet.packet.frames[0].asMaxStreamDataFrame();
+  ASSERT_NE(nullptr, urgentFrame);
+  EXPECT_EQ(stream3->id, urgentFrame->streamId);
+  auto coalescedFrame = packet.packet.frames[1].asMaxStreamDataFrame();
+  ASSERT_NE(nullptr, coalescedFrame);
+  EXPECT_NE(stream3->id, coalescedFrame->streamId);
+}
+
+TEST_F(QuicPacketSchedulerTest, DatagramFrameSchedulerLeavesWhatDoesNotFit) {
+  QuicServerConnectionState conn;
+  auto connId = getTestConnectionId();
+  auto& writeBuffer = conn.datagramState.writeBuffer;
+  writeBuffer.emplace_back(folly::IOBuf::copyBuffer("datagram"), folly::none);
+  writeBuffer.emplace_back(folly::IOBuf::create(100), folly::none);
+  writeBuffer.back().data->append(100);
+
+  DatagramFrameScheduler scheduler(conn);
+  EXPECT_TRUE(scheduler.hasPendingDatagramFrames());
+  ShortHeader shortHeader(
+      ProtectionType::KeyPhaseZero,
+      connId,
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      conn.udpSendPacketLen,
+      std::move(shortHeader),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  PacketBuilderWrapper builderWrapper(builder, 50);
+  EXPECT_TRUE(scheduler.writeDatagramFrames(builderWrapper));
+  auto packet = std::move(builder).buildPacket();
+  ASSERT_EQ(1, packet.packet.frames.size());
+  auto datagramFrame = packet.packet.frames[0].asDatagramFrame();
+  ASSERT_NE(nullptr, datagramFrame);
+  EXPECT_EQ(8, datagramFrame->length);
+  // The larger one is left for the next packet.
+  ASSERT_EQ(1, writeBuffer.size());
+  EXPECT_EQ(100, writeBuffer.front().data->computeChainDataLength());
+  EXPECT_TRUE(scheduler.hasPendingDatagramFrames());
+}
+
+TEST_F(QuicPacketSchedulerTest, PmtuProbeSchedulerPadsPing) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.pmtuDiscoveryEnabled = true;
+  startPmtuDiscovery(conn, kDefaultMaxUDPPayload);
+  PmtuProbeScheduler scheduler(conn);
+  ASSERT_TRUE(scheduler.hasData());
+  auto probeSize = *conn.pmtuDiscoveryState.probeSize;
+
+  ShortHeader shortHeader(
+      ProtectionType::KeyPhaseZero,
+      getTestConnectionId(),
+      getNextPacketNum(conn, PacketNumberSpace::AppData));
+  RegularQuicPacketBuilder builder(
+      probeSize,
+      std::move(shortHeader),
+      conn.ackStates.appDataAckState.largestAckedByPeer);
+  auto result = scheduler.scheduleFramesForPacket(std::move(builder), 1000);
+  ASSERT_TRUE(result.second.hasValue());
+  auto& packet = *result.second;
+  ASSERT_GT(packet.packet.frames.size(), 1);
+  auto simpleFrame = packet.packet.frames[0].asQuicSimpleFrame();
+  ASSERT_NE(nullptr, simpleFrame);
+  EXPECT_NE(nullptr, simpleFrame->asPingFrame());
+  EXPECT_NE(nullptr, packet.packet.frames[1].asPaddingFrame());
+  EXPECT_EQ(
+      1000,
+      packet.header->computeChainDataLength() +
+          packet.body->computeChainDataLength());
+}
+
+TEST_F(QuicPacketSchedulerTest, DatagramFrameSchedulerShareWithStreams) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.datagramWriteSharePercent = 50;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  auto connId = getTestConnectionId();
+  auto& writeBuffer = conn.datagramState.writeBuffer;
+  for (int i = 0; i < 2; ++i) {
+    writeBuffer.emplace_back(folly::IOBuf::create(400), folly::none);
+    writeBuffer.back().data->append(400);
+  }
+
+  auto buildPacket = [&]() {
+    ShortHeader shortHeader(
+        ProtectionType::KeyPhaseZero,
+        connId,
+        getNextPacketNum(conn, PacketNumberSpace::AppData));
+    increaseNextPacketNum(conn, PacketNumberSpace::AppData);
+    RegularQuicPacketBuilder builder(
+        conn.udpSendPacketLen,
+        std::move(shortHeader),
+        conn.ackStates.appDataAckState.largestAckedByPeer);
+    DatagramFrameScheduler scheduler(conn);
+    scheduler.writeDatagramFrames(builder);
+    return std::move(builder).buildPacket();
+  };
+
+  // Without stream data to write both fit in the packet.
+  auto packet = buildPacket();
+  EXPECT_EQ(2, packet.packet.frames.size());
+  EXPECT_TRUE(writeBuffer.empty());
+
+  for (int i = 0; i < 2; ++i) {
+    writeBuffer.emplace_back(folly::IOBuf::create(400), folly::none);
+    writeBuffer.back().data->append(400);
+  }
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream, folly::IOBuf::copyBuffer("data"), false);
+  ASSERT_TRUE(conn.streamManager->hasWritable());
+  // Half the packet is left to the stream, the second datagram goes in the
+  // next one.
+  packet = buildPacket();
+  EXPECT_EQ(1, packet.packet.frames.size());
+  EXPECT_EQ(1, writeBuffer.size());
+  packet = buildPacket();
+  EXPECT_EQ(1, packet.packet.frames.size());
+  EXPECT_TRUE(writeBuffer.empty());
+}
+
+TEST_F(QuicPacketSchedulerTest, FrameSchedulerPlanSkipsDrainedFrames) {
+  QuicServerConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  FrameScheduler scheduler = std::move(FrameScheduler::Builder(
+                                           conn,
+                                           EncryptionLevel::AppData,
+                                           PacketNumberSpace::AppData,
+                                           "frame")
+                                           .windowUpdateFrames()
+                                           .blockedFrames())
+                                 .build();
+  EXPECT_FALSE(scheduler.hasData());
+
+  // Stream writes queue blocked frames during a burst, they are still found.
+  conn.streamManager->queueBlocked(stream->id, 0);
+  EXPECT_TRUE(scheduler.hasImmediateData());
+  // Nothing queues window updates during a burst, once the scheduler found
+  // none it doesn't look again.
+  conn.streamManager->removeBlocked(stream->id);
+  conn.streamManager->queueWindowUpdate(stream->id);
+  EXPECT_FALSE(scheduler.hasData());
+}
+
 TEST_F(QuicPacketSchedulerTest, CloningSchedulerTest) {
   QuicClientConnectionState conn(
       FizzClientQuicHandshakeContext::Builder().build());
@@ -322,8 +502,10 @@ TEST_F(QuicPacketSchedulerTest, CloningSchedulerTest) {
   EXPECT_FALSE(cloningScheduler.hasData());
   auto packetNum = addOutstandingPacket(conn);
   // There needs to have retransmittable frame for the rebuilder to work
-  conn.outstandingPackets.back().packet.frames.push_back(
-      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  conn.outstandingPackets[PacketNumberSpace::AppData]
+      .back()
+      .packet.frames.push_back(
+          MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
   EXPECT_TRUE(cloningScheduler.hasData());
 
   ASSERT_FALSE(noopScheduler.hasData());
@@ -350,8 +532,10 @@ TEST_F(QuicPacketSchedulerTest, WriteOnlyOutstandingPacketsTest) {
   EXPECT_FALSE(cloningScheduler.hasData());
   auto packetNum = addOutstandingPacket(conn);
   // There needs to have retransmittable frame for the rebuilder to work
-  conn.outstandingPackets.back().packet.frames.push_back(
-      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  conn.outstandingPackets[PacketNumberSpace::AppData]
+      .back()
+      .packet.frames.push_back(
+          MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
   EXPECT_TRUE(cloningScheduler.hasData());
 
   ASSERT_FALSE(noopScheduler.hasData());
@@ -419,13 +603,18 @@ TEST_F(QuicPacketSchedulerTest, DoNotCloneProcessedClonedPacket) {
   // adding a PacketEvent that's missing from the outstandingPacketEvents set
   PacketNum expected = addOutstandingPacket(conn);
   // There needs to have retransmittable frame for the rebuilder to work
-  conn.outstandingPackets.back().packet.frames.push_back(
-      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  conn.outstandingPackets[PacketNumberSpace::AppData]
+      .back()
+      .packet.frames.push_back(
+          MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
   addOutstandingPacket(conn);
-  conn.outstandingPackets.back().associatedEvent = 1;
+  conn.outstandingPackets[PacketNumberSpace::AppData].back().associatedEvent =
+      1;
   // There needs to have retransmittable frame for the rebuilder to work
-  conn.outstandingPackets.back().packet.frames.push_back(
-      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  conn.outstandingPackets[PacketNumberSpace::AppData]
+      .back()
+      .packet.frames.push_back(
+          MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
 
   ShortHeader header(
       ProtectionType::KeyPhaseOne,
@@ -466,11 +655,15 @@ TEST_F(QuicPacketSchedulerTest, DoNotCloneHandshake) {
   // Add two outstanding packets, with second one being handshake
   auto expected = addOutstandingPacket(conn);
   // There needs to have retransmittable frame for the rebuilder to work
-  conn.outstandingPackets.back().packet.frames.push_back(
-      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  conn.outstandingPackets[PacketNumberSpace::AppData]
+      .back()
+      .packet.frames.push_back(
+          MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
   addHandshakeOutstandingPacket(conn);
-  conn.outstandingPackets.back().packet.frames.push_back(
-      MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  conn.outstandingPackets[PacketNumberSpace::Handshake]
+      .back()
+      .packet.frames.push_back(
+          MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
 
   ShortHeader header(
       ProtectionType::KeyPhaseOne,
@@ -544,9 +737,9 @@ TEST_F(QuicPacketSchedulerTest, CloneWillGenerateNewWindowUpdate) {
   CloningScheduler cloningScheduler(noopScheduler, conn, "GiantsShoulder", 0);
   auto expectedPacketEvent = addOutstandingPacket(conn);
   ASSERT_EQ(1, conn.outstandingPackets.size());
-  conn.outstandingPackets.back().packet.frames.push_back(MaxDataFrame(1000));
-  conn.outstandingPackets.back().packet.frames.push_back(
-      MaxStreamDataFrame(stream->id, 1000));
+  auto& packet = conn.outstandingPackets[PacketNumberSpace::AppData].back();
+  packet.packet.frames.push_back(MaxDataFrame(1000));
+  packet.packet.frames.push_back(MaxStreamDataFrame(stream->id, 1000));
   conn.flowControlState.advertisedMaxOffset = 1000;
   stream->flowControlState.advertisedMaxOffset = 1000;
 
@@ -710,7 +903,7 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerAllFit) {
       folly::IOBuf::copyBuffer("some data"),
       false);
   scheduler.writeStreams(builder);
-  EXPECT_EQ(conn.schedulingState.nextScheduledStream, 0);
+  EXPECT_EQ(nextScheduledStream(conn), 0);
 }
 
 TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerRoundRobin) {
@@ -752,10 +945,8 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerRoundRobin) {
       *conn.streamManager->findStream(stream3),
       folly::IOBuf::copyBuffer("some data"),
       false);
-  // Force the wraparound initially.
-  conn.schedulingState.nextScheduledStream = stream3 + 8;
   scheduler.writeStreams(builder1);
-  EXPECT_EQ(conn.schedulingState.nextScheduledStream, 4);
+  EXPECT_EQ(nextScheduledStream(conn), 4);
 
   // Should write frames for stream2, stream3, followed by stream1 again.
   NiceMock<MockQuicPacketBuilder> builder2;
@@ -826,11 +1017,9 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerRoundRobinControl) {
       *conn.streamManager->findStream(stream4),
       folly::IOBuf::copyBuffer("some data"),
       false);
-  // Force the wraparound initially.
-  conn.schedulingState.nextScheduledStream = stream4 + 8;
   scheduler.writeStreams(builder1);
-  EXPECT_EQ(conn.schedulingState.nextScheduledStream, stream3);
-  EXPECT_EQ(conn.schedulingState.nextScheduledControlStream, stream2);
+  EXPECT_EQ(nextScheduledStream(conn), stream3);
+  EXPECT_EQ(nextScheduledControlStream(conn), stream2);
 
   // Should write frames for stream2, stream4, followed by stream 3 then 1.
   NiceMock<MockQuicPacketBuilder> builder2;
@@ -854,8 +1043,8 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerRoundRobinControl) {
   ASSERT_TRUE(frames[3].asWriteStreamFrame());
   EXPECT_EQ(*frames[3].asWriteStreamFrame(), f4);
 
-  EXPECT_EQ(conn.schedulingState.nextScheduledStream, stream3);
-  EXPECT_EQ(conn.schedulingState.nextScheduledControlStream, stream2);
+  EXPECT_EQ(nextScheduledStream(conn), stream3);
+  EXPECT_EQ(nextScheduledControlStream(conn), stream2);
 }
 
 TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerOneStream) {
@@ -877,7 +1066,7 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerOneStream) {
   auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
   writeDataToQuicStream(*stream1, folly::IOBuf::copyBuffer("some data"), false);
   scheduler.writeStreams(builder);
-  EXPECT_EQ(conn.schedulingState.nextScheduledStream, 0);
+  EXPECT_EQ(nextScheduledStream(conn), 0);
 }
 
 TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerRemoveOne) {
@@ -912,15 +1101,81 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerRemoveOne) {
   ASSERT_TRUE(builder.frames_[1].asWriteStreamFrame());
   EXPECT_EQ(*builder.frames_[1].asWriteStreamFrame(), f2);
 
-  // Manually remove a stream and set the next scheduled to that stream.
+  // Manually remove the stream the next round would start at.
   builder.frames_.clear();
   conn.streamManager->removeWritable(*conn.streamManager->findStream(stream2));
-  conn.schedulingState.nextScheduledStream = stream2;
   scheduler.writeStreams(builder);
   ASSERT_EQ(builder.frames_.size(), 1);
   ASSERT_TRUE(builder.frames_[0].asWriteStreamFrame());
   EXPECT_EQ(*builder.frames_[0].asWriteStreamFrame(), f1);
 }
 
+TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerPriorities) {
+  QuicClientConnectionState conn(
+      FizzClientQuicHandshakeContext::Builder().build());
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  conn.flowControlState.peerAdvertisedMaxOffset = 100000;
+  conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote = 100000;
+  StreamFrameScheduler scheduler(conn);
+  NiceMock<MockQuicPacketBuilder> builder;
+  auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream2 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream3 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream4 = conn.streamManager->createNextBidirectionalStream().value();
+  conn.streamManager->setStreamPriority(*stream3, Priority(0, false));
+  conn.streamManager->setStreamPriority(*stream4, Priority(0, false));
+  for (auto stream : {stream1, stream2, stream3, stream4}) {
+    writeDataToQuicStream(
+        *stream, folly::IOBuf::copyBuffer("some data"), false);
+  }
+  // Moves the writable stream to its new level.
+  conn.streamManager->setStreamPriority(*stream2, Priority(1, true));
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(4096));
+  EXPECT_CALL(builder, appendFrame(_)).WillRepeatedly(Invoke([&](auto f) {
+    builder.frames_.push_back(f);
+  }));
+  scheduler.writeStreams(builder);
+  ASSERT_EQ(builder.frames_.size(), 4);
+  std::vector<StreamId> expected = {
+      stream3->id, stream4->id, stream2->id, stream1->id};
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_TRUE(builder.frames_[i].asWriteStreamFrame());
+    EXPECT_EQ(builder.frames_[i].asWriteStreamFrame()->streamId, expected[i]);
+  }
+}
+
+TEST_F(QuicPacketSchedulerTest, RetransmissionSchedulerPriorities) {
+  QuicClientConnectionState conn(
+      FizzClientQuicHandshakeContext::Builder().build());
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  RetransmissionScheduler scheduler(conn);
+  NiceMock<MockQuicPacketBuilder> builder;
+  auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream2 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream3 = conn.streamManager->createNextBidirectionalStream().value();
+  conn.streamManager->setStreamPriority(*stream2, Priority(0, false));
+  for (auto stream : {stream1, stream2, stream3}) {
+    // Lost in two packets, retransmitted as one range.
+    stream->insertIntoLossBuffer(
+        StreamBuffer(folly::IOBuf::copyBuffer("some "), 0, false));
+    stream->insertIntoLossBuffer(
+        StreamBuffer(folly::IOBuf::copyBuffer("data"), 5, false));
+    conn.streamManager->addLoss(stream->id);
+  }
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(4096));
+  EXPECT_CALL(builder, appendFrame(_)).WillRepeatedly(Invoke([&](auto f) {
+    builder.frames_.push_back(f);
+  }));
+  scheduler.writeRetransmissionStreams(builder);
+  ASSERT_EQ(builder.frames_.size(), 3);
+  std::vector<StreamId> expected = {stream2->id, stream1->id, stream3->id};
+  for (size_t i = 0; i < expected.size(); ++i) {
+    auto frame = builder.frames_[i].asWriteStreamFrame();
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->streamId, expected[i]);
+    EXPECT_EQ(frame->len, 9);
+  }
+}
+
 } // namespace test
 } // namespace quic
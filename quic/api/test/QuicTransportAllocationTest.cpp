@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/api/QuicTransportFunctions.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/codec/QuicWriteCodec.h>
+#include <quic/common/test/AllocationCounter.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/AckHandlers.h>
+#include <quic/state/QuicStreamFunctions.h>
+#include <quic/state/stream/StreamSendHandlers.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+// Upper bounds on what the hot paths allocate in steady state, the sum of
+// the allocations each path is allowed per packet. Anything on top of them
+// is a regression. Taking one out of a path, e.g. with a buffer pool or
+// inline frame storage, is to drop it from the budget.
+
+// The sample and the mask of the header protection.
+constexpr uint64_t kHeaderProtectionAllocations = 2;
+// The deque node of the outstanding packet, which is larger than what a node
+// holds.
+constexpr uint64_t kOutstandingPacketAllocations = 1;
+// The batch writer and the seal vectors are allocated once per write, and
+// shared by the kPacketsPerRound packets of the write.
+constexpr uint64_t kWriteAllocationsPerPacket = 1;
+constexpr uint64_t kMaxAllocationsPerSentPacket =
+    kHeaderProtectionAllocations + kOutstandingPacketAllocations +
+    kWriteAllocationsPerPacket;
+// The frames are inline and the stream data stays in the packet's IOBufs.
+// Only the read buffer deque of the stream may get a new node, when the
+// buffer crosses into one.
+constexpr uint64_t kReadBufferAllocations = 1;
+constexpr uint64_t kMaxAllocationsPerReceivedPacket = kReadBufferAllocations;
+
+// Enough for the containers of the connection to have grown to what the
+// steady state needs before it is measured.
+constexpr size_t kWarmupRounds = 1000;
+constexpr size_t kMeasuredRounds = 1000;
+
+// Within the initial congestion window.
+constexpr uint64_t kPacketsPerRound = 8;
+constexpr size_t kStreamFrameLen = 1000;
+// Never exhausted by the rounds.
+constexpr uint64_t kLargeWindow = 1ULL << 40;
+
+// The mocks allocate on every call, these are the identity ciphers without
+// them.
+class IdentityAead : public Aead {
+ public:
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* /*associatedData*/,
+      uint64_t /*seqNum*/) const override {
+    return std::move(plaintext);
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* /*associatedData*/,
+      uint64_t /*seqNum*/) const override {
+    return std::move(ciphertext);
+  }
+
+  size_t getCipherOverhead() const override {
+    return 0;
+  }
+};
+
+class IdentityHeaderCipher : public PacketNumberCipher {
+ public:
+  void setKey(folly::ByteRange /*key*/) override {}
+
+  HeaderProtectionMask mask(folly::ByteRange /*sample*/) const override {
+    return HeaderProtectionMask{};
+  }
+
+  size_t keyLength() const override {
+    return 16;
+  }
+};
+
+// Drops what is written to it, there is no file descriptor behind it.
+class SinkUDPSocket : public folly::AsyncUDPSocket {
+ public:
+  explicit SinkUDPSocket(folly::EventBase* evb) : folly::AsyncUDPSocket(evb) {}
+
+  ssize_t write(
+      const folly::SocketAddress& /*address*/,
+      const std::unique_ptr<folly::IOBuf>& buf) override {
+    return buf->computeChainDataLength();
+  }
+
+  ssize_t writeGSO(
+      const folly::SocketAddress& /*address*/,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int /*gso*/) override {
+    return buf->computeChainDataLength();
+  }
+};
+} // namespace
+
+class QuicTransportAllocationTest : public Test {
+ public:
+  void SetUp() override {
+    conn_.serverConnectionId = getTestConnectionId(0);
+    conn_.clientConnectionId = getTestConnectionId(1);
+    conn_.version = QuicVersion::MVFST;
+    conn_.peerAddress = peerAddress_;
+    conn_.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        kLargeWindow;
+    conn_.flowControlState.peerAdvertisedMaxOffset = kLargeWindow;
+    conn_.flowControlState.advertisedMaxOffset = kLargeWindow;
+    conn_.transportSettings.advertisedInitialBidiRemoteStreamWindowSize =
+        kLargeWindow;
+    conn_.streamManager->setMaxLocalBidirectionalStreams(
+        kDefaultMaxStreamsBidirectional);
+  }
+
+ protected:
+  // Acks everything sent so far, releasing what the packets held on to.
+  void ackOutstandingPackets() {
+    auto& appDataPackets = conn_.outstandingPackets[PacketNumberSpace::AppData];
+    if (appDataPackets.empty()) {
+      return;
+    }
+    ReadAckFrame ackFrame;
+    ackFrame.largestAcked = appDataPackets.back().packetNum;
+    ackFrame.ackBlocks.emplace_back(0, ackFrame.largestAcked);
+    processAckFrame(
+        conn_,
+        PacketNumberSpace::AppData,
+        ackFrame,
+        [&](const OutstandingPacket&,
+            const QuicWriteFrame& packetFrame,
+            const ReadAckFrame&) {
+          auto streamFrame = packetFrame.asWriteStreamFrame();
+          if (!streamFrame) {
+            return;
+          }
+          auto stream = conn_.streamManager->getStream(streamFrame->streamId);
+          if (stream) {
+            sendAckSMHandler(*stream, *streamFrame);
+          }
+        },
+        [](auto&, auto&, bool, PacketNum) {},
+        Clock::now());
+  }
+
+  // A packet of the peer with the next kStreamFrameLen bytes of the stream.
+  Buf makePeerPacket(StreamId streamId) {
+    RegularQuicPacketBuilder builder(
+        kDefaultUDPSendPacketLen,
+        ShortHeader(
+            ProtectionType::KeyPhaseZero,
+            *conn_.serverConnectionId,
+            nextPeerPacketNum_++),
+        0 /* largestAcked */);
+    auto data = folly::IOBuf::create(kStreamFrameLen);
+    data->append(kStreamFrameLen);
+    auto dataLen = writeStreamFrameHeader(
+        builder,
+        streamId,
+        nextPeerOffset_,
+        kStreamFrameLen,
+        kStreamFrameLen,
+        false /* fin */);
+    CHECK(dataLen);
+    writeStreamFrameData(builder, std::move(data), *dataLen);
+    nextPeerOffset_ += *dataLen;
+    auto packet = packetToBuf(std::move(builder).buildPacket());
+    packet->coalesce();
+    return packet;
+  }
+
+  folly::EventBase evb_;
+  SinkUDPSocket socket_{&evb_};
+  folly::SocketAddress peerAddress_{"127.0.0.1", 1234};
+  QuicServerConnectionState conn_;
+  IdentityAead aead_;
+  IdentityHeaderCipher headerCipher_;
+  PacketNum nextPeerPacketNum_{0};
+  uint64_t nextPeerOffset_{0};
+};
+
+TEST_F(QuicTransportAllocationTest, AllocationsPerSentPacket) {
+  auto stream = conn_.streamManager->createNextBidirectionalStream().value();
+  auto data = folly::IOBuf::create(kPacketsPerRound * kStreamFrameLen);
+  data->append(kPacketsPerRound * kStreamFrameLen);
+  uint64_t allocations = 0;
+  uint64_t packets = 0;
+  for (size_t round = 0; round < kWarmupRounds + kMeasuredRounds; ++round) {
+    writeDataToQuicStream(*stream, data->clone(), false);
+    ScopedAllocationCounter counter;
+    auto written = writeQuicDataToSocket(
+        socket_,
+        conn_,
+        *conn_.serverConnectionId,
+        *conn_.clientConnectionId,
+        aead_,
+        headerCipher_,
+        QuicVersion::MVFST,
+        kPacketsPerRound);
+    auto writeAllocations = counter.count();
+    ASSERT_GT(written, 0);
+    if (round >= kWarmupRounds) {
+      allocations += writeAllocations;
+      packets += written;
+    }
+    ackOutstandingPackets();
+  }
+  EXPECT_LE(allocations, kMaxAllocationsPerSentPacket * packets);
+}
+
+TEST_F(QuicTransportAllocationTest, AllocationsPerReceivedPacket) {
+  conn_.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+  conn_.readCodec->setOneRttReadCipher(std::make_unique<IdentityAead>());
+  conn_.readCodec->setOneRttHeaderCipher(
+      std::make_unique<IdentityHeaderCipher>());
+  conn_.readCodec->setServerConnectionId(*conn_.serverConnectionId);
+  conn_.readCodec->setClientConnectionId(*conn_.clientConnectionId);
+  conn_.readCodec->setCodecParameters(
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  // The first bidirectional stream of the client.
+  StreamId streamId = 0x00;
+  uint64_t allocations = 0;
+  for (size_t round = 0; round < kWarmupRounds + kMeasuredRounds; ++round) {
+    ServerEvents::ReadData readData;
+    readData.peer = peerAddress_;
+    readData.networkData =
+        NetworkDataSingle(makePeerPacket(streamId), Clock::now());
+    ScopedAllocationCounter counter;
+    onServerReadData(conn_, readData);
+    auto readAllocations = counter.count();
+    if (round >= kWarmupRounds) {
+      allocations += readAllocations;
+    }
+    // What the app does with it, not counted.
+    auto stream = conn_.streamManager->getStream(streamId);
+    ASSERT_NE(stream, nullptr);
+    auto read = readDataFromQuicStream(*stream);
+    ASSERT_EQ(kStreamFrameLen, read.first->computeChainDataLength());
+  }
+  EXPECT_LE(allocations, kMaxAllocationsPerReceivedPacket * kMeasuredRounds);
+}
+
+} // namespace test
+} // namespace quic
@@ -156,6 +156,10 @@ class TestQuicTransport
     return lossTimeout_.getTimeRemaining();
   }
 
+  std::chrono::milliseconds getIdleTimeoutRemainingTime() const {
+    return idleTimeout_.getTimeRemaining();
+  }
+
   void onReadData(const folly::SocketAddress&, NetworkDataSingle&& data)
       override {
     if (!data.data) {
@@ -210,7 +214,10 @@ class TestQuicTransport
         *aead,
         *headerCipher,
         *conn_->version,
-        conn_->transportSettings.writeConnectionDataPacketsLimit);
+        std::min(
+            conn_->transportSettings.writeConnectionDataPacketsLimit,
+            conn_->writePacketLimit.value_or(
+                conn_->transportSettings.writeConnectionDataPacketsLimit)));
   }
 
   bool hasWriteCipher() const {
@@ -255,6 +262,10 @@ class TestQuicTransport
     pingTimeout_.cancelTimeout();
   }
 
+  void warmStartCongestionControl() {
+    maybeWarmStartCongestionControl();
+  }
+
   void invokeHandlePingCallback() {
     handlePingCallback();
   }
@@ -413,6 +424,51 @@ TEST_F(QuicTransportImplTest, AckTimeoutExpiredWillResetTimeoutFlag) {
   EXPECT_FALSE(transport->transportConn->pendingEvents.scheduleAckTimeout);
 }
 
+TEST_F(QuicTransportImplTest, WarmStartFromCongestionStateCache) {
+  auto& conn = *transport->transportConn;
+  auto mss = conn.udpSendPacketLen;
+  auto cache = std::make_shared<BasicCongestionStateCache>();
+  CachedCongestionState state;
+  state.cwndBytes = 100 * mss;
+  state.minRtt = 50ms;
+  state.recordTime = std::chrono::system_clock::now();
+  cache->putCongestionState("peer", state);
+  transport->setCongestionControllerFactory(
+      std::make_shared<DefaultCongestionControllerFactory>());
+  transport->setCongestionStateCache(cache, "peer");
+  transport->warmStartCongestionControl();
+  EXPECT_EQ(50 * mss, conn.congestionController->getCongestionWindow());
+  EXPECT_EQ(CongestionControlType::Cubic, conn.congestionController->type());
+
+  // and leaves its own state behind when it closes.
+  conn.lossState.srtt = 40ms;
+  conn.lossState.mrtt = 30ms;
+  transport->closeNow(folly::none);
+  auto cached = cache->getCongestionState("peer");
+  ASSERT_TRUE(cached.has_value());
+  EXPECT_EQ(30ms, cached->minRtt);
+  EXPECT_EQ(50 * mss, cached->cwndBytes);
+}
+
+TEST_F(QuicTransportImplTest, NoWarmStartFromStaleCongestionState) {
+  auto& conn = *transport->transportConn;
+  auto cache = std::make_shared<BasicCongestionStateCache>();
+  CachedCongestionState state;
+  state.cwndBytes = 100 * conn.udpSendPacketLen;
+  state.minRtt = 50ms;
+  state.recordTime = std::chrono::system_clock::now() -
+      conn.transportSettings.warmStartMaxAge - 1s;
+  cache->putCongestionState("peer", state);
+  transport->setCongestionControllerFactory(
+      std::make_shared<DefaultCongestionControllerFactory>());
+  transport->setCongestionStateCache(cache, "peer");
+  transport->warmStartCongestionControl();
+  EXPECT_FALSE(conn.warmStartCwndBytes.has_value());
+  EXPECT_EQ(
+      conn.transportSettings.initCwndInMss * conn.udpSendPacketLen,
+      conn.congestionController->getCongestionWindow());
+}
+
 TEST_F(QuicTransportImplTest, IdleTimeoutExpiredDestroysTransport) {
   EXPECT_CALL(connCallback, onConnectionEnd()).WillOnce(Invoke([&]() {
     transport = nullptr;
@@ -420,6 +476,27 @@ TEST_F(QuicTransportImplTest, IdleTimeoutExpiredDestroysTransport) {
   transport->invokeIdleTimeout();
 }
 
+TEST_F(QuicTransportImplTest, LazyIdleTimeoutRearmsWhenReset) {
+  auto& settings = transport->transportConn->transportSettings;
+  settings.lazyIdleTimeoutRearm = true;
+  settings.idleTimeout = 500ms;
+  transport->setIdleTimeout();
+  EXPECT_NEAR(500, transport->getIdleTimeoutRemainingTime().count(), 2);
+
+  // Fired with most of the timeout left since the last reset.
+  EXPECT_CALL(connCallback, onConnectionEnd()).Times(0);
+  transport->invokeIdleTimeout();
+  EXPECT_FALSE(transport->isClosed());
+  EXPECT_NEAR(500, transport->getIdleTimeoutRemainingTime().count(), 20);
+  Mock::VerifyAndClearExpectations(&connCallback);
+
+  settings.lazyIdleTimeoutRearm = false;
+  EXPECT_CALL(connCallback, onConnectionEnd()).WillOnce(Invoke([&]() {
+    transport = nullptr;
+  }));
+  transport->invokeIdleTimeout();
+}
+
 TEST_F(QuicTransportImplTest, WriteAckPacketUnsetsLooper) {
   // start looper in running state first
   transport->writeLooper()->run(true);
@@ -491,6 +568,42 @@ TEST_F(QuicTransportImplTest, ReadCallbackDataAvailable) {
   transport.reset();
 }
 
+TEST_F(QuicTransportImplTest, ReadCallbackBatched) {
+  transport->transportConn->transportSettings.batchReadCallbacks = true;
+  auto stream1 = transport->createBidirectionalStream().value();
+  auto stream2 = transport->createBidirectionalStream().value();
+  auto stream3 = transport->createBidirectionalStream().value();
+
+  NiceMock<MockBatchReadCallback> batchReadCb;
+  NiceMock<MockReadCallback> readCb;
+  transport->setReadCallback(stream1, &batchReadCb);
+  transport->setReadCallback(stream2, &batchReadCb);
+  transport->setReadCallback(stream3, &readCb);
+  for (auto stream : {stream1, stream2, stream3}) {
+    transport->addDataToStream(
+        stream, StreamBuffer(folly::IOBuf::copyBuffer("stream data"), 0));
+  }
+
+  std::vector<StreamId> batch;
+  EXPECT_CALL(batchReadCb, readAvailableBatch(_))
+      .WillOnce(Invoke([&](auto ids) {
+        batch.assign(ids.begin(), ids.end());
+      }));
+  EXPECT_CALL(batchReadCb, readAvailable(_)).Times(0);
+  EXPECT_CALL(readCb, readAvailable(stream3));
+  transport->driveReadCallbacks();
+  std::sort(batch.begin(), batch.end());
+  EXPECT_EQ(std::vector<StreamId>({stream1, stream2}), batch);
+
+  // A stream alone with its callback gets readAvailable.
+  transport->setReadCallback(stream2, nullptr);
+  EXPECT_CALL(batchReadCb, readAvailableBatch(_)).Times(0);
+  EXPECT_CALL(batchReadCb, readAvailable(stream1));
+  EXPECT_CALL(readCb, readAvailable(stream3));
+  transport->driveReadCallbacks();
+  transport.reset();
+}
+
 TEST_F(QuicTransportImplTest, ReadCallbackChangeReadCallback) {
   auto stream1 = transport->createBidirectionalStream().value();
 
@@ -1013,6 +1126,71 @@ TEST_F(QuicTransportImplTest, ReadDataAlsoChecksLossAlarm) {
   transport.reset();
 }
 
+TEST_F(QuicTransportImplTest, DeferredWriteScheduler) {
+  auto scheduler = std::make_shared<DeferredWriteScheduler>(evb.get());
+  transport->setDeferredWriteScheduler(scheduler);
+  transport->transportConn->oneRttWriteCipher = test::createNoOpAead();
+  auto stream = transport->createBidirectionalStream().value();
+  EXPECT_CALL(*socketPtr, write(_, _))
+      .WillRepeatedly(Invoke([](const auto&, const auto& buf) {
+        return buf->computeChainDataLength();
+      }));
+  transport->writeChain(stream, folly::IOBuf::copyBuffer("Hey"), true, false);
+  EXPECT_TRUE(scheduler->isWriteScheduled(transport.get()));
+  EXPECT_FALSE(transport->writeLooper()->isRunning());
+  evb->loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_FALSE(scheduler->isWriteScheduled(transport.get()));
+  EXPECT_EQ(scheduler->numScheduled(), 0);
+  EXPECT_FALSE(scheduler->isLoopCallbackScheduled());
+
+  // A closed transport leaves the scheduler
+  transport->writeChain(
+      transport->createBidirectionalStream().value(),
+      folly::IOBuf::copyBuffer("Hey"),
+      true,
+      false);
+  EXPECT_TRUE(scheduler->isWriteScheduled(transport.get()));
+  transport->closeNow(folly::none);
+  EXPECT_FALSE(scheduler->isWriteScheduled(transport.get()));
+  EXPECT_FALSE(scheduler->isLoopCallbackScheduled());
+}
+
+TEST_F(QuicTransportImplTest, DeferredWriteSchedulerQuantum) {
+  auto scheduler = std::make_shared<DeferredWriteScheduler>(evb.get());
+  scheduler->setBudgets(1000, 0, 0us);
+  transport->setDeferredWriteScheduler(scheduler);
+  transport->transportConn->oneRttWriteCipher = test::createNoOpAead();
+  EXPECT_CALL(*socketPtr, write(_, _))
+      .WillRepeatedly(Invoke([](const auto&, const auto& buf) {
+        return buf->computeChainDataLength();
+      }));
+  auto& conn = transport->getConnectionState();
+  auto stream = transport->createBidirectionalStream().value();
+  transport->writeChain(
+      stream, buildRandomInputData(conn.udpSendPacketLen * 10), true, false);
+
+  // One packet per turn while the quantum is below the packet size.
+  evb->loopOnce(EVLOOP_NONBLOCK);
+  auto sent = conn.lossState.totalBytesSent;
+  EXPECT_GT(sent, 0);
+  EXPECT_LE(sent, conn.udpSendPacketLen);
+  EXPECT_TRUE(scheduler->isWriteScheduled(transport.get()));
+  EXPECT_EQ(
+      1000 - static_cast<int64_t>(sent),
+      scheduler->getDeficit(transport.get()));
+
+  evb->loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_LE(conn.lossState.totalBytesSent, 2 * conn.udpSendPacketLen);
+  EXPECT_EQ(
+      2000 - static_cast<int64_t>(conn.lossState.totalBytesSent),
+      scheduler->getDeficit(transport.get()));
+
+  // The credit goes away with the data.
+  transport->closeNow(folly::none);
+  EXPECT_EQ(0, scheduler->getDeficit(transport.get()));
+  EXPECT_FALSE(scheduler->isWriteScheduled(transport.get()));
+}
+
 TEST_F(QuicTransportImplTest, ConnectionErrorOnWrite) {
   transport->transportConn->oneRttWriteCipher = test::createNoOpAead();
   auto stream = transport->createBidirectionalStream().value();
@@ -1039,6 +1217,20 @@ TEST_F(QuicTransportImplTest, LossTimeoutNoLessThanTickInterval) {
       2);
 }
 
+TEST_F(QuicTransportImplTest, LazyLossTimeoutOnlyMovesEarlier) {
+  transport->transportConn->transportSettings.lazyLossTimeoutRearm = true;
+  transport->scheduleLossTimeout(100ms);
+  transport->scheduleLossTimeout(500ms);
+  EXPECT_TRUE(transport->isLossTimeoutScheduled());
+  EXPECT_NEAR(100, transport->getLossTimeoutRemainingTime().count(), 2);
+
+  transport->scheduleLossTimeout(50ms);
+  EXPECT_NEAR(50, transport->getLossTimeoutRemainingTime().count(), 2);
+
+  transport->cancelLossTimeout();
+  EXPECT_FALSE(transport->isLossTimeoutScheduled());
+}
+
 TEST_F(QuicTransportImplTest, CloseStreamAfterReadError) {
   auto qLogger = std::make_shared<FileQLogger>(VantagePoint::Client);
   transport->transportConn->qLogger = qLogger;
@@ -1086,7 +1278,7 @@ TEST_F(QuicTransportImplTest, CloseStreamAfterReadFin) {
 TEST_F(QuicTransportImplTest, CancelAllDeliveryCallbacksDeque) {
   NiceMock<MockDeliveryCallback> mockedDeliveryCallback1,
       mockedDeliveryCallback2;
-  std::deque<std::pair<uint64_t, QuicSocket::DeliveryCallback*>> callbacks;
+  TestQuicTransport::DeliveryCallbackQueue callbacks;
   callbacks.emplace_back(0, &mockedDeliveryCallback1);
   callbacks.emplace_back(100, &mockedDeliveryCallback2);
   StreamId id = 0x123;
@@ -1098,9 +1290,7 @@ TEST_F(QuicTransportImplTest, CancelAllDeliveryCallbacksDeque) {
 TEST_F(QuicTransportImplTest, CancelAllDeliveryCallbacksMap) {
   NiceMock<MockDeliveryCallback> mockedDeliveryCallback1,
       mockedDeliveryCallback2;
-  folly::F14FastMap<
-      StreamId,
-      std::deque<std::pair<uint64_t, QuicSocket::DeliveryCallback*>>>
+  folly::F14FastMap<StreamId, TestQuicTransport::DeliveryCallbackQueue>
       callbacks;
   callbacks[0x123].emplace_back(0, &mockedDeliveryCallback1);
   callbacks[0x135].emplace_back(100, &mockedDeliveryCallback2);
@@ -1593,6 +1783,22 @@ TEST_P(QuicTransportImplTestUniBidi, AppIdleTestOnlyControlStreams) {
   transport->closeStream(ctrlStream2);
 }
 
+TEST_F(QuicTransportImplTest, SetStreamPriority) {
+  auto stream = transport->createBidirectionalStream().value();
+  EXPECT_TRUE(transport->setStreamPriority(stream, 0, false).hasValue());
+  auto streamState =
+      transport->getConnectionState().streamManager->findStream(stream);
+  EXPECT_EQ(streamState->priority, Priority(0, false));
+
+  EXPECT_EQ(
+      transport->setStreamPriority(stream, kMaxPriorityLevel + 1, false)
+          .error(),
+      LocalErrorCode::INVALID_OPERATION);
+  EXPECT_EQ(
+      transport->setStreamPriority(stream + 4, 0, false).error(),
+      LocalErrorCode::STREAM_NOT_EXISTS);
+}
+
 TEST_F(QuicTransportImplTest, UnidirectionalInvalidReadFuncs) {
   auto stream = transport->createUnidirectionalStream().value();
   EXPECT_THROW(
@@ -2010,10 +2216,15 @@ TEST_F(QuicTransportImplTest, UpdatePeekableListNoDataTest) {
   const auto& conn = transport->transportConn;
   auto stream = transport->getStream(streamId);
 
-  // Insert streamId into the list.
-  conn->streamManager->peekableStreams().insert(streamId);
+  // Add some data to the stream, which inserts streamId into the list.
+  transport->addDataToStream(
+      streamId,
+      StreamBuffer(folly::IOBuf::copyBuffer("actual stream data"), 0));
+  EXPECT_EQ(1, conn->streamManager->peekableStreams().count(streamId));
+
   // After the call the streamId should be removed
   // from the list since there is no peekable data in the stream.
+  stream->readBuffer.clear();
   conn->streamManager->updatePeekableStreams(*stream);
   EXPECT_EQ(0, conn->streamManager->peekableStreams().count(streamId));
 }
@@ -2048,7 +2259,7 @@ TEST_F(QuicTransportImplTest, UpdatePeekableListEmptyListTest) {
       StreamBuffer(folly::IOBuf::copyBuffer("actual stream data"), 0));
 
   // Erase streamId from the list.
-  conn->streamManager->peekableStreams().erase(streamId);
+  conn->streamManager->removePeekable(streamId);
   EXPECT_EQ(0, conn->streamManager->peekableStreams().count(streamId));
 
   // After the call the streamId should be added to the list
@@ -137,6 +137,44 @@ uint64_t getEncodedSize(const RegularQuicPacketBuilder::Packet& packet) {
   return encodedSize;
 }
 
+// Forwards to another Aead and records the sizes of the batches it is asked
+// to seal.
+class BatchRecordingAead : public Aead {
+ public:
+  explicit BatchRecordingAead(const Aead& aead) : aead_(aead) {}
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return aead_.encrypt(std::move(plaintext), associatedData, seqNum);
+  }
+
+  void encryptBatch(
+      std::vector<std::unique_ptr<folly::IOBuf>>& plaintexts,
+      const std::vector<const folly::IOBuf*>& associatedData,
+      const std::vector<uint64_t>& seqNums) const override {
+    batchSizes.push_back(plaintexts.size());
+    Aead::encryptBatch(plaintexts, associatedData, seqNums);
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return aead_.tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+  }
+
+  size_t getCipherOverhead() const override {
+    return aead_.getCipherOverhead();
+  }
+
+  mutable std::vector<size_t> batchSizes;
+
+ private:
+  const Aead& aead_;
+};
+
 class QuicTransportFunctionsTest : public Test {
  public:
   void SetUp() override {
@@ -226,7 +264,9 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnection) {
   EXPECT_EQ(
       conn->ackStates.appDataAckState.nextPacketNum,
       currentNextAppDataPacketNum);
-  EXPECT_TRUE(conn->outstandingPackets.back().isAppLimited);
+  EXPECT_TRUE(conn->outstandingPackets[PacketNumberSpace::Handshake]
+                  .back()
+                  .isAppLimited);
 
   EXPECT_EQ(stream1->retransmissionBuffer.size(), 1);
   auto& rt1 = stream1->retransmissionBuffer.at(0);
@@ -283,7 +323,9 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnection) {
   EXPECT_EQ(
       conn->ackStates.appDataAckState.nextPacketNum,
       currentNextAppDataPacketNum);
-  EXPECT_FALSE(conn->outstandingPackets.back().isAppLimited);
+  EXPECT_FALSE(conn->outstandingPackets[PacketNumberSpace::Handshake]
+                   .back()
+                   .isAppLimited);
 
   EXPECT_EQ(stream1->currentWriteOffset, 13);
   EXPECT_EQ(stream1->currentWriteOffset, 13);
@@ -399,14 +441,17 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionPacketSorting) {
   EXPECT_EQ(event3->packetType, toString(LongHeader::Types::ZeroRtt));
 
   EXPECT_EQ(3, conn->outstandingPackets.size());
-  auto& firstHeader = conn->outstandingPackets.front().packet.header;
+  auto& firstHeader = conn->outstandingPackets[PacketNumberSpace::Initial]
+                          .front()
+                          .packet.header;
   auto firstPacketNum = firstHeader.getPacketSequenceNum();
   EXPECT_EQ(0, firstPacketNum);
   EXPECT_EQ(1, event1->packetNum);
 
   EXPECT_EQ(PacketNumberSpace::Initial, firstHeader.getPacketNumberSpace());
 
-  auto& lastHeader = conn->outstandingPackets.back().packet.header;
+  auto& lastHeader =
+      conn->outstandingPackets[PacketNumberSpace::AppData].back().packet.header;
 
   auto lastPacketNum = lastHeader.getPacketSequenceNum();
 
@@ -789,6 +834,38 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithPureAck) {
   EXPECT_EQ(frame->ackBlocks.size(), 1);
 }
 
+TEST_F(QuicTransportFunctionsTest, AdaptiveWriteBatchSize) {
+  auto conn = createConn();
+  conn->transportSettings.maxBatchSize = 16;
+  EXPECT_EQ(16, getWriteBatchSize(*conn, 100));
+
+  conn->transportSettings.adaptiveWriteBatchSize = true;
+  auto mockCongestionController =
+      std::make_unique<NiceMock<MockCongestionController>>();
+  auto rawController = mockCongestionController.get();
+  conn->congestionController = std::move(mockCongestionController);
+  // unpaced, the congestion window decides
+  EXPECT_CALL(*rawController, getWritableBytes())
+      .WillRepeatedly(Return(conn->udpSendPacketLen * 5 + 1));
+  EXPECT_EQ(6, getWriteBatchSize(*conn, 100));
+  EXPECT_EQ(3, getWriteBatchSize(*conn, 3));
+  EXPECT_CALL(*rawController, getWritableBytes())
+      .WillRepeatedly(Return(conn->udpSendPacketLen * 1000));
+  EXPECT_EQ(kMaxAdaptiveWriteBatchSize, getWriteBatchSize(*conn, 1000));
+  EXPECT_CALL(*rawController, getWritableBytes()).WillRepeatedly(Return(0));
+  EXPECT_EQ(1, getWriteBatchSize(*conn, 100));
+
+  // paced, one burst per batch
+  auto mockPacer = std::make_unique<NiceMock<MockPacer>>();
+  auto rawPacer = mockPacer.get();
+  conn->pacer = std::move(mockPacer);
+  conn->transportSettings.pacingEnabled = true;
+  conn->canBePaced = true;
+  EXPECT_CALL(*rawPacer, getCachedWriteBatchSize()).WillRepeatedly(Return(10));
+  EXPECT_EQ(10, getWriteBatchSize(*conn, 100));
+  EXPECT_EQ(4, getWriteBatchSize(*conn, 4));
+}
+
 TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithBytesStats) {
   auto conn = createConn();
   conn->qLogger = std::make_shared<quic::FileQLogger>(VantagePoint::Client);
@@ -821,28 +898,14 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithBytesStats) {
   EXPECT_EQ(event->packetSize, 555);
   EXPECT_EQ(event->eventType, QLogEventType::PacketSent);
 
-  EXPECT_EQ(
-      13579 + 555,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->totalBytesSent);
-  EXPECT_TRUE(getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-                  ->lastAckedPacketInfo.has_value());
-  EXPECT_EQ(
-      currentTime - 123s,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->ackTime);
-  EXPECT_EQ(
-      currentTime -= 234s,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->sentTime);
-  EXPECT_EQ(
-      10000,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->totalBytesSent);
-  EXPECT_EQ(
-      5000,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake)
-          ->lastAckedPacketInfo->totalBytesAcked);
+  auto& outstanding =
+      conn->outstandingPackets[PacketNumberSpace::Handshake].front();
+  EXPECT_EQ(13579 + 555, outstanding.totalBytesSent);
+  EXPECT_TRUE(outstanding.lastAckedPacketInfo.has_value());
+  EXPECT_EQ(currentTime - 123s, outstanding.lastAckedPacketInfo->ackTime);
+  EXPECT_EQ(currentTime -= 234s, outstanding.lastAckedPacketInfo->sentTime);
+  EXPECT_EQ(10000, outstanding.lastAckedPacketInfo->totalBytesSent);
+  EXPECT_EQ(5000, outstanding.lastAckedPacketInfo->totalBytesAcked);
 }
 
 TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithCloneResult) {
@@ -890,14 +953,15 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionWithCloneResult) {
   EXPECT_EQ(frame->maximumData, maxDataAmt);
   EXPECT_EQ(
       futureMoment,
-      getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->time);
+      conn->outstandingPackets[PacketNumberSpace::AppData].back().time);
   EXPECT_EQ(
       1500,
-      getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->encodedSize);
+      conn->outstandingPackets[PacketNumberSpace::AppData].back().encodedSize);
   EXPECT_EQ(
       event,
-      *getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)
-           ->associatedEvent);
+      *conn->outstandingPackets[PacketNumberSpace::AppData]
+           .back()
+           .associatedEvent);
   EXPECT_TRUE(conn->pendingEvents.setLossDetectionAlarm);
 }
 
@@ -1282,7 +1346,7 @@ TEST_F(QuicTransportFunctionsTest, NothingWritten) {
 }
 
 const QuicWriteFrame& getFirstFrameInOutstandingPackets(
-    const std::deque<OutstandingPacket>& outstandingPackets,
+    const OutstandingPackets::Queue& outstandingPackets,
     QuicWriteFrame::Type frameType) {
   for (const auto& packet : outstandingPackets) {
     for (const auto& frame : packet.packet.frames) {
@@ -1331,7 +1395,7 @@ TEST_F(QuicTransportFunctionsTest, WriteBlockedFrameWhenBlocked) {
 
   EXPECT_GT(conn->ackStates.appDataAckState.nextPacketNum, originalNextSeq);
   auto blocked = *getFirstFrameInOutstandingPackets(
-                      conn->outstandingPackets,
+                      conn->outstandingPackets[PacketNumberSpace::AppData],
                       QuicWriteFrame::Type::StreamDataBlockedFrame_E)
                       .asStreamDataBlockedFrame();
   EXPECT_EQ(blocked.streamId, stream1->id);
@@ -1589,8 +1653,8 @@ TEST_F(QuicTransportFunctionsTest, TestCryptoWritingIsHandshakeInOutstanding) {
           getVersion(*conn),
           conn->transportSettings.writeConnectionDataPacketsLimit));
   ASSERT_EQ(1, conn->outstandingPackets.size());
-  EXPECT_TRUE(getFirstOutstandingPacket(*conn, PacketNumberSpace::Initial)
-                  ->isHandshake);
+  EXPECT_TRUE(
+      conn->outstandingPackets[PacketNumberSpace::Initial].front().isHandshake);
 }
 
 TEST_F(QuicTransportFunctionsTest, WritePureAckWhenNoWritableBytes) {
@@ -1872,6 +1936,16 @@ TEST_F(QuicTransportFunctionsTest, HasControlFramesToWrite) {
   EXPECT_EQ(WriteDataReason::BLOCKED, hasNonAckDataToWrite(*conn));
 }
 
+TEST_F(QuicTransportFunctionsTest, OnlyUrgentWindowUpdatesNeedWrite) {
+  auto conn = createConn();
+  conn->oneRttWriteCipher = test::createNoOpAead();
+  conn->streamManager->queueWindowUpdate(1, false);
+  EXPECT_EQ(WriteDataReason::NO_WRITE, hasNonAckDataToWrite(*conn));
+
+  conn->streamManager->queueWindowUpdate(5);
+  EXPECT_EQ(WriteDataReason::STREAM_WINDOW_UPDATE, hasNonAckDataToWrite(*conn));
+}
+
 TEST_F(QuicTransportFunctionsTest, FlowControlBlocked) {
   auto conn = createConn();
   conn->flowControlState.peerAdvertisedMaxOffset = 1000;
@@ -2051,5 +2125,37 @@ TEST_F(QuicTransportFunctionsTest, WriteLimitBytRttFraction) {
           500 /* packetLimit */));
 }
 
+TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketSealsInBatches) {
+  auto conn = createConn();
+  conn->transportSettings.batchingMode =
+      QuicBatchingMode::BATCHING_MODE_SENDMMSG;
+  conn->transportSettings.maxBatchSize = 4;
+
+  EventBase evb;
+  folly::AsyncUDPSocket peerSocket(&evb);
+  peerSocket.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket socket(&evb);
+  socket.bind(folly::SocketAddress("127.0.0.1", 0));
+  conn->peerAddress = peerSocket.address();
+
+  auto stream = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(
+      *stream, buildRandomInputData(conn->udpSendPacketLen * 10), false);
+  BatchRecordingAead batchAead(*aead);
+  EXPECT_EQ(
+      6,
+      writeQuicDataToSocket(
+          socket,
+          *conn,
+          *conn->clientConnectionId,
+          *conn->serverConnectionId,
+          batchAead,
+          *headerCipher,
+          getVersion(*conn),
+          6 /* packetLimit */));
+  EXPECT_EQ(std::vector<size_t>({4, 2}), batchAead.batchSizes);
+  EXPECT_EQ(6, conn->outstandingPackets.size());
+}
+
 } // namespace test
 } // namespace quic
@@ -25,6 +25,8 @@
 #include <quic/state/stream/StreamReceiveHandlers.h>
 #include <quic/state/test/Mocks.h>
 
+#include <thread>
+
 using namespace folly;
 using namespace folly::test;
 using namespace testing;
@@ -235,7 +237,8 @@ size_t bufLength(
 }
 
 void dropPackets(QuicServerConnectionState& conn) {
-  for (const auto& packet : conn.outstandingPackets) {
+  for (const auto& packet :
+       conn.outstandingPackets[PacketNumberSpace::AppData]) {
     for (const auto& frame : packet.packet.frames) {
       const WriteStreamFrame* streamFrame = frame.asWriteStreamFrame();
       if (!streamFrame) {
@@ -280,7 +283,8 @@ void verifyCorrectness(
   size_t totalLen = 0;
   bool finSet = false;
   std::vector<uint64_t> offsets;
-  for (const auto& packet : conn.outstandingPackets) {
+  for (const auto& packet :
+       conn.outstandingPackets[PacketNumberSpace::AppData]) {
     for (const auto& frame : packet.packet.frames) {
       auto streamFrame = frame.asWriteStreamFrame();
       if (!streamFrame) {
@@ -579,6 +583,135 @@ TEST_F(QuicTransportTest, WriteMultipleStreams) {
   verifyCorrectness(conn, 0, s2, *buf2);
 }
 
+TEST_F(QuicTransportTest, WriteChainsToMultipleStreams) {
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  // Opened by the client, so the server can't write to it.
+  StreamId receiveOnlyStream = 0x02;
+  auto buf = buildRandomInputData(20);
+  std::vector<QuicSocket::StreamWrite> writes;
+  writes.emplace_back(s1, buf->clone());
+  writes.emplace_back(s2, buf->clone(), true);
+  writes.emplace_back(receiveOnlyStream, buf->clone());
+
+  auto results = transport_->writeChains(std::move(writes), false);
+  ASSERT_EQ(results.size(), 3);
+  EXPECT_TRUE(results[0].hasValue());
+  EXPECT_TRUE(results[1].hasValue());
+  ASSERT_TRUE(results[2].hasError());
+  EXPECT_EQ(results[2].error(), LocalErrorCode::INVALID_OPERATION);
+
+  // Both streams go out in a single write.
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  loopForWrites();
+  auto& conn = transport_->getConnectionState();
+  verifyCorrectness(conn, 0, s1, *buf);
+  verifyCorrectness(conn, 0, s2, *buf, true);
+}
+
+TEST_F(QuicTransportTest, SendRequestWritesWithEof) {
+  NiceMock<MockReadCallback> readCb;
+  auto buf = buildRandomInputData(20);
+  EXPECT_EQ(
+      transport_->sendRequest(buf->clone(), nullptr).error(),
+      LocalErrorCode::INVALID_OPERATION);
+
+  auto streamId = transport_->sendRequest(buf->clone(), &readCb);
+  ASSERT_TRUE(streamId.hasValue());
+  EXPECT_TRUE(isBidirectionalStream(*streamId));
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  loopForWrites();
+  auto& conn = transport_->getConnectionState();
+  verifyCorrectness(conn, 0, *streamId, *buf, true);
+  // The response still comes in on the stream.
+  EXPECT_FALSE(conn.streamManager->findStream(*streamId)->inTerminalStates());
+}
+
+TEST_F(QuicTransportTest, WriteThroughSmallWrite) {
+  auto transportSettings = transport_->getTransportSettings();
+  transportSettings.writeThroughMaxBytes = 100;
+  transport_->setTransportSettings(transportSettings);
+  auto stream = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(20);
+
+  // Sent before writeChain returns, without waiting for the loop.
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  transport_->writeChain(stream, buf->clone(), false, false);
+  auto& conn = transport_->getConnectionState();
+  verifyCorrectness(conn, 0, stream, *buf);
+  EXPECT_EQ(WriteDataReason::NO_WRITE, shouldWriteData(conn));
+  loopForWrites();
+}
+
+TEST_F(QuicTransportTest, WriteThroughLeavesLargeWritesToLooper) {
+  auto transportSettings = transport_->getTransportSettings();
+  transportSettings.writeThroughMaxBytes = 100;
+  transport_->setTransportSettings(transportSettings);
+  auto stream = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(200);
+
+  EXPECT_CALL(*socket_, write(_, _)).Times(0);
+  transport_->writeChain(stream, buf->clone(), false, false);
+  auto& conn = transport_->getConnectionState();
+  EXPECT_TRUE(conn.outstandingPackets.empty());
+  Mock::VerifyAndClearExpectations(socket_);
+
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  loopForWrites();
+  verifyCorrectness(conn, 0, stream, *buf);
+}
+
+TEST_F(QuicTransportTest, CrossThreadWritesGoOutTogether) {
+  EXPECT_EQ(transport_->getCrossThreadWriteQueue(), nullptr);
+  auto transportSettings = transport_->getTransportSettings();
+  transportSettings.crossThreadWriteQueueCapacity = 2;
+  transport_->setTransportSettings(transportSettings);
+  auto queue = transport_->getCrossThreadWriteQueue();
+  ASSERT_NE(queue, nullptr);
+  EXPECT_EQ(queue, transport_->getCrossThreadWriteQueue());
+
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(20);
+  std::thread([&] {
+    auto data = buf->clone();
+    EXPECT_TRUE(queue->submit(s1, data, false));
+    data = buf->clone();
+    EXPECT_TRUE(queue->submit(s2, data, true));
+    // The queue is full, the data stays with the caller.
+    data = buf->clone();
+    EXPECT_FALSE(queue->submit(s1, data, false));
+    EXPECT_NE(data, nullptr);
+  }).join();
+
+  // Both streams go out in a single write.
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  loopForWrites();
+  loopForWrites();
+  auto& conn = transport_->getConnectionState();
+  verifyCorrectness(conn, 0, s1, *buf);
+  verifyCorrectness(conn, 0, s2, *buf, true);
+}
+
+TEST_F(QuicTransportTest, WritePayloadSharedAcrossStreams) {
+  auto s1 = transport_->createBidirectionalStream().value();
+  auto s2 = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(20);
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  transport_->writeChain(s1, buf->clone(), false, false);
+  transport_->writeChain(s2, buf->clone(), false, false);
+  loopForWrites();
+
+  // What is kept for retransmission refers to the payload, not to a copy.
+  auto& conn = transport_->getConnectionState();
+  for (auto id : {s1, s2}) {
+    auto stream = conn.streamManager->findStream(id);
+    ASSERT_EQ(stream->retransmissionBuffer.size(), 1);
+    EXPECT_EQ(
+        stream->retransmissionBuffer.at(0).data.front()->data(), buf->data());
+  }
+}
+
 TEST_F(QuicTransportTest, WriteFlowControl) {
   auto& conn = transport_->getConnectionState();
   auto mockQLogger = std::make_shared<MockQLogger>(VantagePoint::Server);
@@ -602,7 +735,7 @@ TEST_F(QuicTransportTest, WriteFlowControl) {
   loopForWrites();
   EXPECT_EQ(conn.outstandingPackets.size(), 1);
   auto& packet =
-      getFirstOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+      conn.outstandingPackets[PacketNumberSpace::AppData].front().packet;
   bool blockedFound = false;
   for (auto& frame : packet.frames) {
     auto blocked = frame.asStreamDataBlockedFrame();
@@ -790,6 +923,38 @@ TEST_F(QuicTransportTest, WriteImmediateAcks) {
   EXPECT_EQ(WriteDataReason::NO_WRITE, shouldWriteData(conn));
 }
 
+TEST_F(QuicTransportTest, AckOnlyWriteWaitsForReadCallbacks) {
+  auto transportSettings = transport_->getTransportSettings();
+  transportSettings.deferAckOnlyWrites = true;
+  transport_->setTransportSettings(transportSettings);
+  auto& conn = transport_->getConnectionState();
+  conn.ackStates.appDataAckState.needsToSendAckImmediately = true;
+  addAckStatesWithCurrentTimestamps(conn.ackStates.appDataAckState, 10, 15);
+  auto stream = transport_->createBidirectionalStream().value();
+  auto streamState = conn.streamManager->getStream(stream);
+  streamState->readBuffer.emplace_back(buildRandomInputData(10), 0, false);
+  conn.streamManager->updateReadableStreams(*streamState);
+
+  NiceMock<MockReadCallback> readCb;
+  auto buf = buildRandomInputData(20);
+  EXPECT_CALL(readCb, readAvailable(stream))
+      .WillOnce(Invoke([&](StreamId id) {
+        transport_->writeChain(id, buf->clone(), false, false);
+      }))
+      .WillRepeatedly(Return());
+  evb_.runInLoop([&] {
+    // as after reading packets: the read looper runs in the next loop
+    transport_->setReadCallback(stream, &readCb);
+    transport_->updateWriteLooper(true);
+  });
+  // The acks and the data the read callback wrote go out together.
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  loopForWrites();
+  loopForWrites();
+  EXPECT_EQ(conn.ackStates.appDataAckState.largestAckScheduled, PacketNum(15));
+  verifyCorrectness(conn, 0, stream, *buf);
+}
+
 TEST_F(QuicTransportTest, NotWriteAcksIfNoData) {
   auto& conn = transport_->getConnectionState();
 
@@ -825,7 +990,7 @@ TEST_F(QuicTransportTest, WritePendingAckIfHavingData) {
   loopForWrites();
   EXPECT_EQ(conn.outstandingPackets.size(), 1);
   auto& packet =
-      getFirstOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+      conn.outstandingPackets[PacketNumberSpace::AppData].front().packet;
   EXPECT_GE(packet.frames.size(), 2);
 
   bool ackFound = false;
@@ -857,9 +1022,10 @@ TEST_F(QuicTransportTest, RstStream) {
   loopForWrites();
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
   EXPECT_GE(packet.frames.size(), 1);
   bool rstFound = false;
   for (auto& frame : packet.frames) {
@@ -893,9 +1059,10 @@ TEST_F(QuicTransportTest, StopSending) {
   loopForWrites();
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
   EXPECT_EQ(1, packet.frames.size());
   bool foundStopSending = false;
   for (auto& frame : packet.frames) {
@@ -935,9 +1102,10 @@ TEST_F(QuicTransportTest, SendPathChallenge) {
 
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
   bool foundPathChallenge = false;
   for (auto& frame : packet.frames) {
     const QuicSimpleFrame* simpleFrame = frame.asQuicSimpleFrame();
@@ -1040,8 +1208,8 @@ TEST_F(QuicTransportTest, ClonePathChallenge) {
 
   EXPECT_EQ(conn.outstandingPackets.size(), 1);
   auto numPathChallengePackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::PathChallengeFrame_E>());
   EXPECT_EQ(numPathChallengePackets, 1);
 
@@ -1050,8 +1218,8 @@ TEST_F(QuicTransportTest, ClonePathChallenge) {
   // On PTO, endpoint sends 2 probing packets, thus 1+2=3
   EXPECT_EQ(conn.outstandingPackets.size(), 3);
   numPathChallengePackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::PathChallengeFrame_E>());
 
   EXPECT_EQ(numPathChallengePackets, 3);
@@ -1074,8 +1242,8 @@ TEST_F(QuicTransportTest, OnlyClonePathValidationIfOutstanding) {
   loopForWrites();
 
   auto numPathChallengePackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::PathChallengeFrame_E>());
   EXPECT_EQ(numPathChallengePackets, 1);
 
@@ -1087,8 +1255,8 @@ TEST_F(QuicTransportTest, OnlyClonePathValidationIfOutstanding) {
   // Force a timeout with no data so that it clones the packet
   transport_->lossTimeout().timeoutExpired();
   numPathChallengePackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::PathChallengeFrame_E>());
   EXPECT_EQ(numPathChallengePackets, 1);
 }
@@ -1105,9 +1273,10 @@ TEST_F(QuicTransportTest, ResendPathChallengeOnLoss) {
 
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
 
   EXPECT_FALSE(conn.pendingEvents.pathChallenge);
   markPacketLoss(conn, packet, false, 2);
@@ -1126,9 +1295,10 @@ TEST_F(QuicTransportTest, DoNotResendLostPathChallengeIfNotOutstanding) {
 
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
 
   // Fire path validation timer
   transport_->getPathValidationTimeout().cancelTimeout();
@@ -1152,7 +1322,7 @@ TEST_F(QuicTransportTest, SendPathResponse) {
 
   EXPECT_EQ(1, conn.outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+      conn.outstandingPackets[PacketNumberSpace::AppData].back().packet;
   bool foundPathResponse = false;
   for (auto& frame : packet.frames) {
     const QuicSimpleFrame* simpleFrame = frame.asQuicSimpleFrame();
@@ -1193,8 +1363,8 @@ TEST_F(QuicTransportTest, CloneAfterRecvReset) {
   transport_->lossTimeout().timeoutExpired();
   EXPECT_LT(1, conn.outstandingPackets.size());
   size_t cloneCounter = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       [](const auto& packet) { return packet.associatedEvent.hasValue(); });
   EXPECT_LE(1, cloneCounter);
 }
@@ -1217,16 +1387,16 @@ TEST_F(QuicTransportTest, ClonePathResponse) {
   EXPECT_EQ(conn.pendingEvents.frames.size(), 0);
 
   auto numPathResponsePackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::PathResponseFrame_E>());
   EXPECT_EQ(numPathResponsePackets, 1);
 
   // Force a timeout with no data so that it clones the packet
   transport_->lossTimeout().timeoutExpired();
   numPathResponsePackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::PathResponseFrame_E>());
   EXPECT_EQ(numPathResponsePackets, 1);
 }
@@ -1244,7 +1414,7 @@ TEST_F(QuicTransportTest, DoNotResendPathResponseOnLoss) {
 
   EXPECT_EQ(1, conn.outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+      conn.outstandingPackets[PacketNumberSpace::AppData].back().packet;
 
   markPacketLoss(conn, packet, false, 2);
   EXPECT_EQ(conn.pendingEvents.frames.size(), 0);
@@ -1262,9 +1432,10 @@ TEST_F(QuicTransportTest, SendNewConnectionIdFrame) {
   EXPECT_TRUE(conn.pendingEvents.frames.empty());
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
   bool foundNewConnectionId = false;
   for (auto& frame : packet.frames) {
     const QuicSimpleFrame* simpleFrame = frame.asQuicSimpleFrame();
@@ -1299,8 +1470,8 @@ TEST_F(QuicTransportTest, CloneNewConnectionIdFrame) {
 
   EXPECT_EQ(conn.outstandingPackets.size(), 1);
   auto numNewConnIdPackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::NewConnectionIdFrame_E>());
   EXPECT_EQ(numNewConnIdPackets, 1);
 
@@ -1309,8 +1480,8 @@ TEST_F(QuicTransportTest, CloneNewConnectionIdFrame) {
   // On PTO, endpoint sends 2 probing packets, thus 1+2=3
   EXPECT_EQ(conn.outstandingPackets.size(), 3);
   numNewConnIdPackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::NewConnectionIdFrame_E>());
   EXPECT_EQ(numNewConnIdPackets, 3);
 }
@@ -1377,9 +1548,10 @@ TEST_F(QuicTransportTest, ResendNewConnectionIdOnLoss) {
 
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
 
   EXPECT_TRUE(conn.pendingEvents.frames.empty());
   markPacketLoss(conn, packet, false, 2);
@@ -1401,9 +1573,10 @@ TEST_F(QuicTransportTest, SendRetireConnectionIdFrame) {
   EXPECT_TRUE(conn.pendingEvents.frames.empty());
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
   bool foundRetireConnectionId = false;
   for (auto& frame : packet.frames) {
     const QuicSimpleFrame* simpleFrame = frame.asQuicSimpleFrame();
@@ -1437,8 +1610,8 @@ TEST_F(QuicTransportTest, CloneRetireConnectionIdFrame) {
 
   EXPECT_EQ(conn.outstandingPackets.size(), 1);
   auto numRetireConnIdPackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<
           QuicSimpleFrame::Type::RetireConnectionIdFrame_E>());
   EXPECT_EQ(numRetireConnIdPackets, 1);
@@ -1448,8 +1621,8 @@ TEST_F(QuicTransportTest, CloneRetireConnectionIdFrame) {
   // On PTO, endpoint sends 2 probing packets, thus 1+2=3
   EXPECT_EQ(conn.outstandingPackets.size(), 3);
   numRetireConnIdPackets = std::count_if(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].begin(),
+      conn.outstandingPackets[PacketNumberSpace::AppData].end(),
       findFrameInPacketFunc<
           QuicSimpleFrame::Type::RetireConnectionIdFrame_E>());
   EXPECT_EQ(numRetireConnIdPackets, 3);
@@ -1465,9 +1638,10 @@ TEST_F(QuicTransportTest, ResendRetireConnectionIdOnLoss) {
 
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
 
   EXPECT_TRUE(conn.pendingEvents.frames.empty());
   markPacketLoss(conn, packet, false, 2);
@@ -1525,9 +1699,10 @@ TEST_F(QuicTransportTest, RstWrittenStream) {
   // 2 packets are outstanding: one for Stream frame one for RstStream frame:
   EXPECT_EQ(2, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
   EXPECT_GE(packet.frames.size(), 1);
 
   bool foundReset = false;
@@ -1559,9 +1734,10 @@ TEST_F(QuicTransportTest, RstStreamUDPWriteFailNonFatal) {
 
   EXPECT_EQ(1, transport_->getConnectionState().outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(
-          transport_->getConnectionState(), PacketNumberSpace::AppData)
-          ->packet;
+      transport_->getConnectionState()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet;
   EXPECT_GE(packet.frames.size(), 1);
 
   bool foundReset = false;
@@ -1631,7 +1807,7 @@ TEST_F(QuicTransportTest, WriteAfterSendRst) {
   // frame. The 2nd writeChain won't write anything.
   EXPECT_EQ(2, conn.outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+      conn.outstandingPackets[PacketNumberSpace::AppData].back().packet;
   EXPECT_GE(packet.frames.size(), 1);
 
   bool foundReset = false;
@@ -1711,7 +1887,7 @@ TEST_F(QuicTransportTest, WriteWindowUpdate) {
   EXPECT_EQ(1, res); // Write one packet out
   EXPECT_EQ(1, conn.outstandingPackets.size());
   auto packet =
-      getLastOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+      conn.outstandingPackets[PacketNumberSpace::AppData].back().packet;
   EXPECT_GE(packet.frames.size(), 1);
   bool connWindowFound = false;
   for (auto& frame : packet.frames) {
@@ -1747,7 +1923,7 @@ TEST_F(QuicTransportTest, WriteWindowUpdate) {
   EXPECT_EQ(1, res); // Write one packet out
   EXPECT_EQ(1, conn.outstandingPackets.size());
   auto packet1 =
-      getLastOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+      conn.outstandingPackets[PacketNumberSpace::AppData].back().packet;
   const MaxStreamDataFrame* streamWindowUpdate =
       packet1.frames.front().asMaxStreamDataFrame();
   EXPECT_TRUE(streamWindowUpdate);
@@ -1851,6 +2027,46 @@ TEST_F(QuicTransportTest, InvokeDeliveryCallbacksAllDelivered) {
   transport_->onNetworkData(addr, std::move(emptyData));
 }
 
+TEST_F(QuicTransportTest, InvokeDeliveryCallbacksBatched) {
+  NiceMock<MockBatchDeliveryCallback> batchDeliveryCallback;
+  NiceMock<MockDeliveryCallback> mockedDeliveryCallback;
+  auto stream = transport_->createBidirectionalStream().value();
+  auto buf = buildRandomInputData(100);
+  EXPECT_CALL(*socket_, write(_, _)).WillRepeatedly(Invoke(bufLength));
+  transport_->registerDeliveryCallback(stream, 30, &batchDeliveryCallback);
+  transport_->registerDeliveryCallback(stream, 10, &batchDeliveryCallback);
+  transport_->registerDeliveryCallback(stream, 20, &batchDeliveryCallback);
+  transport_->registerDeliveryCallback(stream, 25, &mockedDeliveryCallback);
+  transport_->registerDeliveryCallback(stream, 40, &batchDeliveryCallback);
+  transport_->writeChain(stream, buf->clone(), true, false);
+  loopForWrites();
+
+  auto& conn = transport_->getConnectionState();
+  // Faking a delivery:
+  conn.streamManager->addDeliverable(stream);
+  conn.lossState.srtt = 100us;
+  auto streamState = conn.streamManager->getStream(stream);
+  streamState->retransmissionBuffer.clear();
+
+  folly::SocketAddress addr;
+  NetworkData emptyData;
+  std::vector<std::vector<uint64_t>> delivered;
+  EXPECT_CALL(batchDeliveryCallback, onDeliveryAckBatch(stream, _, 100us))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](auto, auto offsets, auto) {
+        delivered.emplace_back(offsets.begin(), offsets.end());
+      }));
+  EXPECT_CALL(batchDeliveryCallback, onDeliveryAck(_, _, _)).Times(0);
+  EXPECT_CALL(mockedDeliveryCallback, onDeliveryAck(stream, 25, 100us))
+      .WillOnce(Invoke([&](auto, auto offset, auto) {
+        delivered.push_back({offset});
+      }));
+  transport_->onNetworkData(addr, std::move(emptyData));
+  // The offsets in a row for the same callback come in one batch.
+  std::vector<std::vector<uint64_t>> expected = {{10, 20}, {25}, {30, 40}};
+  EXPECT_EQ(expected, delivered);
+}
+
 TEST_F(QuicTransportTest, InvokeDeliveryCallbacksPartialDelivered) {
   NiceMock<MockDeliveryCallback> mockedDeliveryCallback1,
       mockedDeliveryCallback2;
@@ -2054,6 +2270,40 @@ TEST_F(QuicTransportTest, NotifyPendingWriteConnBufferFreeUpSpace) {
       NetworkData(IOBuf::copyBuffer("fake data"), Clock::now()));
 }
 
+TEST_F(QuicTransportTest, NotifyPendingWriteConnBufferCountsUnackedData) {
+  TransportSettings transportSettings;
+  transportSettings.totalBufferSpaceAvailable = 100;
+  transportSettings.bufferSpaceIncludesUnackedData = true;
+  transport_->setTransportSettings(transportSettings);
+
+  auto streamId = transport_->createBidirectionalStream().value();
+  auto& conn = transport_->getConnectionState();
+  auto stream = conn.streamManager->getStream(streamId);
+
+  // Everything is written to the socket, but none of it is acked yet.
+  updateFlowControlOnWriteToStream(*stream, 100);
+  updateFlowControlOnWriteToSocket(*stream, 100);
+  updateUnackedBufferOnWriteToSocket(*stream, 100);
+  EXPECT_EQ(transport_->getTransportInfo().streamBytesBuffered, 0);
+  EXPECT_EQ(transport_->getTransportInfo().streamBytesUnacked, 100);
+  EXPECT_EQ(
+      transport_->getStreamTransportInfo(streamId).value().bytesUnacked, 100);
+  EXPECT_EQ(transport_->getConnectionBufferAvailable(), 0);
+  transport_->notifyPendingWriteOnConnection(&writeCallback_);
+
+  EXPECT_CALL(writeCallback_, onConnectionWriteReady(_)).Times(0);
+
+  evb_.loop();
+
+  // Acks free up space
+  updateUnackedBufferOnRelease(*stream, 10);
+  EXPECT_CALL(writeCallback_, onConnectionWriteReady(_));
+
+  transport_->onNetworkData(
+      SocketAddress("::1", 10000),
+      NetworkData(IOBuf::copyBuffer("fake data"), Clock::now()));
+}
+
 TEST_F(QuicTransportTest, NotifyPendingWriteConnBufferUseTotalSpace) {
   TransportSettings transportSettings;
   transportSettings.totalBufferSpaceAvailable = 100;
@@ -2167,6 +2417,58 @@ TEST_F(QuicTransportTest, NotifyPendingWriteStreamAsyncConnBlocked) {
       NetworkData(IOBuf::copyBuffer("fake data"), Clock::now()));
 }
 
+TEST_F(QuicTransportTest, NotifyPendingWriteStreamsByPriorityUntilCreditUsed) {
+  auto& conn = transport_->getConnectionState();
+  auto stream1 = transport_->createBidirectionalStream().value();
+  auto stream2 = transport_->createBidirectionalStream().value();
+  auto stream3 = transport_->createBidirectionalStream().value();
+  // Artificially restrict the conn flow control to have no bytes remaining.
+  updateFlowControlOnWriteToStream(
+      *conn.streamManager->getStream(stream1),
+      conn.flowControlState.peerAdvertisedMaxOffset);
+
+  NiceMock<MockWriteCallback> writeCallback1, writeCallback2, writeCallback3;
+  transport_->notifyPendingWriteOnStream(stream1, &writeCallback1);
+  transport_->notifyPendingWriteOnStream(stream2, &writeCallback2);
+  transport_->notifyPendingWriteOnStream(stream3, &writeCallback3);
+  transport_->setStreamPriority(stream2, 0, false);
+  evb_.loop();
+
+  // The most urgent stream uses all the credit there is.
+  EXPECT_CALL(writeCallback2, onStreamWriteReady(stream2, 1000))
+      .WillOnce(Invoke([&](auto id, auto) {
+        transport_->writeChain(id, buildRandomInputData(1000), false, false);
+      }));
+  EXPECT_CALL(writeCallback1, onStreamWriteReady(_, _)).Times(0);
+  EXPECT_CALL(writeCallback3, onStreamWriteReady(_, _)).Times(0);
+  PacketNum num = 10;
+  handleConnWindowUpdate(
+      conn,
+      MaxDataFrame(conn.flowControlState.peerAdvertisedMaxOffset + 1000),
+      num);
+  EXPECT_CALL(*socket_, write(_, _)).WillRepeatedly(Invoke(bufLength));
+  transport_->onNetworkData(
+      SocketAddress("::1", 10000),
+      NetworkData(IOBuf::copyBuffer("fake data"), Clock::now()));
+  Mock::VerifyAndClearExpectations(&writeCallback1);
+  Mock::VerifyAndClearExpectations(&writeCallback3);
+
+  // The others in the order they started waiting, one that does not write
+  // leaves the credit to the next.
+  {
+    InSequence enforceOrder;
+    EXPECT_CALL(writeCallback1, onStreamWriteReady(stream1, _));
+    EXPECT_CALL(writeCallback3, onStreamWriteReady(stream3, _));
+  }
+  handleConnWindowUpdate(
+      conn,
+      MaxDataFrame(conn.flowControlState.peerAdvertisedMaxOffset + 1000),
+      num);
+  transport_->onNetworkData(
+      SocketAddress("::1", 10000),
+      NetworkData(IOBuf::copyBuffer("fake data"), Clock::now()));
+}
+
 TEST_F(QuicTransportTest, NotifyPendingWriteStreamAsyncStreamBlocked) {
   auto streamId = transport_->createBidirectionalStream().value();
   auto& conn = transport_->getConnectionState();
@@ -2331,7 +2633,7 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
       transport_->getVersion(),
       conn.transportSettings.writeConnectionDataPacketsLimit);
   EXPECT_EQ(1, conn.outstandingPackets.size());
-  auto& packet = *getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
+  auto& packet = conn.outstandingPackets[PacketNumberSpace::AppData].front();
   EXPECT_EQ(1, packet.packet.frames.size());
   auto& frame = packet.packet.frames.front();
   const WriteStreamFrame* streamFrame = frame.asWriteStreamFrame();
@@ -2339,8 +2641,7 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
   EXPECT_EQ(streamFrame->streamId, s1);
   conn.outstandingPackets.clear();
 
-  // Start from stream2 instead of stream1
-  conn.schedulingState.nextScheduledStream = s2;
+  // The round robin goes on with stream2
   writableBytes = kDefaultUDPSendPacketLen - 100;
 
   EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
@@ -2354,7 +2655,7 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
       transport_->getVersion(),
       conn.transportSettings.writeConnectionDataPacketsLimit);
   EXPECT_EQ(1, conn.outstandingPackets.size());
-  auto& packet2 = *getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
+  auto& packet2 = conn.outstandingPackets[PacketNumberSpace::AppData].front();
   EXPECT_EQ(1, packet2.packet.frames.size());
   auto& frame2 = packet2.packet.frames.front();
   const WriteStreamFrame* streamFrame2 = frame2.asWriteStreamFrame();
@@ -2363,7 +2664,6 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
   conn.outstandingPackets.clear();
 
   // Test wrap around
-  conn.schedulingState.nextScheduledStream = s2;
   writableBytes = kDefaultUDPSendPacketLen;
   EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
   writeQuicDataToSocket(
@@ -2376,16 +2676,16 @@ TEST_F(QuicTransportTest, WriteStreamFromMiddleOfMap) {
       transport_->getVersion(),
       conn.transportSettings.writeConnectionDataPacketsLimit);
   EXPECT_EQ(1, conn.outstandingPackets.size());
-  auto& packet3 = *getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
+  auto& packet3 = conn.outstandingPackets[PacketNumberSpace::AppData].front();
   EXPECT_EQ(2, packet3.packet.frames.size());
   auto& frame3 = packet3.packet.frames.front();
   auto& frame4 = packet3.packet.frames.back();
   const WriteStreamFrame* streamFrame3 = frame3.asWriteStreamFrame();
   EXPECT_TRUE(streamFrame3);
-  EXPECT_EQ(streamFrame3->streamId, s2);
+  EXPECT_EQ(streamFrame3->streamId, s1);
   const WriteStreamFrame* streamFrame4 = frame4.asWriteStreamFrame();
   EXPECT_TRUE(streamFrame4);
-  EXPECT_EQ(streamFrame4->streamId, s1);
+  EXPECT_EQ(streamFrame4->streamId, s2);
   transport_->close(folly::none);
 }
 
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/QuicClientConnectionPool.h>
+
+#include <folly/hash/Hash.h>
+
+#include <algorithm>
+
+namespace quic {
+
+bool QuicConnectionPoolKey::operator==(
+    const QuicConnectionPoolKey& other) const {
+  return host == other.host && port == other.port && alpn == other.alpn;
+}
+
+size_t QuicConnectionPoolKeyHash::operator()(
+    const QuicConnectionPoolKey& key) const {
+  return folly::hash::hash_combine(key.host, key.port, key.alpn);
+}
+
+QuicClientConnectionPool::PooledConnection::PooledConnection(
+    std::shared_ptr<QuicClientTransport> transportIn,
+    TimePoint lastUsedIn)
+    : transport(std::move(transportIn)), lastUsed(lastUsedIn) {}
+
+void QuicClientConnectionPool::PooledConnection::onConnectionEnd() noexcept {
+  closed = true;
+}
+
+void QuicClientConnectionPool::PooledConnection::onConnectionError(
+    std::pair<QuicErrorCode, std::string> error) noexcept {
+  VLOG(4) << "Pooled connection error=" << error.second << " " << *transport;
+  closed = true;
+}
+
+void QuicClientConnectionPool::PooledConnection::onTransportReady() noexcept {
+  ready = true;
+}
+
+QuicClientConnectionPool::QuicClientConnectionPool(
+    folly::EventBase* evb,
+    ClientFactory clientFactory,
+    std::shared_ptr<QuicPskCache> pskCache,
+    QuicClientConnectionPoolSettings settings)
+    : evb_(evb),
+      clientFactory_(std::move(clientFactory)),
+      pskCache_(std::move(pskCache)),
+      settings_(settings),
+      maintenanceTimeout_(this) {
+  CHECK(evb_);
+  CHECK_GT(settings_.maxConnectionsPerKey, 0);
+}
+
+QuicClientConnectionPool::~QuicClientConnectionPool() {
+  closeAll();
+}
+
+std::shared_ptr<QuicClientTransport> QuicClientConnectionPool::getConnection(
+    const QuicConnectionPoolKey& key) {
+  DCHECK(evb_->isInEventBaseThread());
+  auto& connections = connections_[key];
+  prune(connections);
+  PooledConnection* chosen = nullptr;
+  PooledConnection* fallback = nullptr;
+  size_t numOpen = 0;
+  for (auto& connection : connections) {
+    if (connection->retiring) {
+      continue;
+    }
+    numOpen++;
+    if (!fallback) {
+      fallback = connection.get();
+    }
+    if (connection->ready &&
+        connection->transport->getNumOpenableBidirectionalStreams() == 0) {
+      continue;
+    }
+    if (!chosen || (connection->ready && !chosen->ready)) {
+      chosen = connection.get();
+    }
+  }
+  auto now = Clock::now();
+  if (!chosen && numOpen < settings_.maxConnectionsPerKey) {
+    chosen = &startConnection(key, connections, now);
+  }
+  if (!chosen) {
+    chosen = fallback;
+  }
+  chosen->lastUsed = now;
+  scheduleMaintenance();
+  return chosen->transport;
+}
+
+bool QuicClientConnectionPool::prewarm(const QuicConnectionPoolKey& key) {
+  DCHECK(evb_->isInEventBaseThread());
+  auto& connections = connections_[key];
+  prune(connections);
+  if (!connections.empty() || !pskCache_ || !pskCache_->getPsk(key.host)) {
+    if (connections.empty()) {
+      connections_.erase(key);
+    }
+    return false;
+  }
+  // Started for the requests expected soon, it is kept warm as if one had
+  // used it.
+  startConnection(key, connections, Clock::now());
+  scheduleMaintenance();
+  return true;
+}
+
+void QuicClientConnectionPool::closeAll() {
+  maintenanceTimeout_.cancelTimeout();
+  // Closing a connection calls back into its PooledConnection, they are only
+  // destroyed after.
+  for (auto& keyAndConnections : connections_) {
+    for (auto& connection : keyAndConnections.second) {
+      if (!connection->closed) {
+        connection->transport->closeNow(folly::none);
+      }
+    }
+  }
+  connections_.clear();
+}
+
+size_t QuicClientConnectionPool::numConnections() const {
+  size_t numConnections = 0;
+  for (const auto& keyAndConnections : connections_) {
+    numConnections += std::count_if(
+        keyAndConnections.second.begin(),
+        keyAndConnections.second.end(),
+        [](const auto& connection) { return !connection->closed; });
+  }
+  return numConnections;
+}
+
+QuicClientConnectionPool::PooledConnection&
+QuicClientConnectionPool::startConnection(
+    const QuicConnectionPoolKey& key,
+    Connections& connections,
+    TimePoint lastUsed) {
+  auto transport = clientFactory_(evb_, key);
+  CHECK(transport);
+  transport->setHostname(key.host);
+  connections.push_back(
+      std::make_unique<PooledConnection>(std::move(transport), lastUsed));
+  auto& connection = *connections.back();
+  connection.transport->start(&connection);
+  return connection;
+}
+
+void QuicClientConnectionPool::prune(Connections& connections) {
+  bool replacementReady = std::any_of(
+      connections.begin(), connections.end(), [](const auto& connection) {
+        return connection->ready && !connection->retiring &&
+            !connection->closed;
+      });
+  auto it = connections.begin();
+  while (it != connections.end()) {
+    auto& connection = **it;
+    if (connection.closed) {
+      it = connections.erase(it);
+    } else if (connection.retiring && replacementReady) {
+      // Lets the streams of the requests still on it finish.
+      connection.transport->closeGracefully();
+      it = connections.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void QuicClientConnectionPool::maintain() {
+  auto now = Clock::now();
+  auto it = connections_.begin();
+  while (it != connections_.end()) {
+    auto& connections = it->second;
+    prune(connections);
+    // The replacements are appended, they are not looked at this time.
+    auto numConnections = connections.size();
+    for (size_t i = 0; i < numConnections; ++i) {
+      auto& connection = *connections[i];
+      if (connection.retiring || !connection.ready ||
+          now - connection.lastUsed > settings_.keepWarmDuration) {
+        continue;
+      }
+      auto timeUntilIdleTimeout =
+          connection.transport->getTimeUntilIdleTimeout();
+      if (!timeUntilIdleTimeout ||
+          *timeUntilIdleTimeout > settings_.replaceBeforeIdleTimeout) {
+        continue;
+      }
+      VLOG(4) << "Replacing pooled connection nearing idle timeout "
+              << *connection.transport;
+      connection.retiring = true;
+      startConnection(it->first, connections, connection.lastUsed);
+    }
+    if (connections.empty()) {
+      it = connections_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  scheduleMaintenance();
+}
+
+void QuicClientConnectionPool::scheduleMaintenance() {
+  if (connections_.empty() || maintenanceTimeout_.isScheduled()) {
+    return;
+  }
+  evb_->timer().scheduleTimeout(
+      &maintenanceTimeout_, settings_.maintenanceInterval);
+}
+
+} // namespace quic
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/client/QuicClientTransport.h>
+#include <quic/client/handshake/QuicPskCache.h>
+
+#include <folly/Function.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/HHWheelTimer.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace quic {
+
+/**
+ * What connections are pooled by, a connection is only reused for requests
+ * to the same host and port with the same application protocol.
+ */
+struct QuicConnectionPoolKey {
+  std::string host;
+  uint16_t port{0};
+  std::string alpn;
+
+  bool operator==(const QuicConnectionPoolKey& other) const;
+};
+
+struct QuicConnectionPoolKeyHash {
+  size_t operator()(const QuicConnectionPoolKey& key) const;
+};
+
+struct QuicClientConnectionPoolSettings {
+  // The connections to one key the pool opens at most. Requests share them
+  // once they have no streams left to open.
+  size_t maxConnectionsPerKey{1};
+  // A connection is replaced this long before it would close for being
+  // idle, so that the next request does not wait for a handshake.
+  std::chrono::milliseconds replaceBeforeIdleTimeout{5000};
+  // Only the connections a request was given within this long are replaced,
+  // the others are let to close.
+  std::chrono::milliseconds keepWarmDuration{60000};
+  // How often the connections are checked for nearing their idle timeout
+  std::chrono::milliseconds maintenanceInterval{1000};
+};
+
+/**
+ * Pool of client connections, reused across requests to the same host, port
+ * and application protocol. Requests get a connection to open their streams
+ * on, established ones before those still handshaking, so that most of them
+ * skip the handshake. Connections the psk cache has a ticket for can be
+ * started ahead of the requests, and do 0-RTT. A connection a request used
+ * recently is replaced before its idle timeout closes it.
+ *
+ * The pool and its connections belong to one EventBase and it must only be
+ * used from its thread. Clients with several event bases have a pool per
+ * event base.
+ *
+ * The pool is the connection callback of its connections. They are meant
+ * for the streams the requests open, the streams the peer opens on them are
+ * not read.
+ */
+class QuicClientConnectionPool {
+ public:
+  /**
+   * Creates a client to the key's peer, with its peer address, socket and
+   * handshake context for the key's application protocol set, and the psk
+   * cache the pool was given. The pool sets the hostname and starts it. The
+   * clients are to be self owning, see QuicClientTransport::newClient, so
+   * that they finish closing after the pool lets go of them.
+   */
+  using ClientFactory = folly::Function<std::shared_ptr<QuicClientTransport>(
+      folly::EventBase*,
+      const QuicConnectionPoolKey&)>;
+
+  QuicClientConnectionPool(
+      folly::EventBase* evb,
+      ClientFactory clientFactory,
+      std::shared_ptr<QuicPskCache> pskCache,
+      QuicClientConnectionPoolSettings settings =
+          QuicClientConnectionPoolSettings());
+
+  ~QuicClientConnectionPool();
+
+  /**
+   * Returns a connection to the key's peer for a request to open its streams
+   * on. One with a stream left to open if there is, else a new one while
+   * there are fewer than maxConnectionsPerKey, else one of the others. A
+   * connection still handshaking only has streams to open once the limits of
+   * the peer are known, early from the psk with 0-RTT.
+   */
+  std::shared_ptr<QuicClientTransport> getConnection(
+      const QuicConnectionPoolKey& key);
+
+  /**
+   * Starts a connection to the key's peer ahead of the requests, when there
+   * is none yet and the psk cache has a ticket to resume it with 0-RTT.
+   * Returns whether it started one.
+   */
+  bool prewarm(const QuicConnectionPoolKey& key);
+
+  /**
+   * Closes the connections without waiting for their streams.
+   */
+  void closeAll();
+
+  size_t numConnections() const;
+
+ private:
+  class PooledConnection : public QuicSocket::ConnectionCallback {
+   public:
+    PooledConnection(
+        std::shared_ptr<QuicClientTransport> transport,
+        TimePoint lastUsed);
+
+    void onNewBidirectionalStream(StreamId) noexcept override {}
+    void onNewUnidirectionalStream(StreamId) noexcept override {}
+    void onStopSending(StreamId, ApplicationErrorCode) noexcept override {}
+    void onConnectionEnd() noexcept override;
+    void onConnectionError(
+        std::pair<QuicErrorCode, std::string> error) noexcept override;
+    void onTransportReady() noexcept override;
+
+    std::shared_ptr<QuicClientTransport> transport;
+    // When a request was last given it, or the connection it replaces
+    TimePoint lastUsed;
+    bool ready{false};
+    bool closed{false};
+    // Not given to requests any more, it is closed once its replacement is
+    // ready.
+    bool retiring{false};
+  };
+
+  class MaintenanceTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    explicit MaintenanceTimeout(QuicClientConnectionPool* pool)
+        : pool_(pool) {}
+
+    void timeoutExpired() noexcept override {
+      pool_->maintain();
+    }
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    QuicClientConnectionPool* pool_;
+  };
+
+  using Connections = std::vector<std::unique_ptr<PooledConnection>>;
+
+  PooledConnection& startConnection(
+      const QuicConnectionPoolKey& key,
+      Connections& connections,
+      TimePoint lastUsed);
+
+  // Drops the closed connections and closes the retired ones whose
+  // replacement is ready
+  void prune(Connections& connections);
+
+  // Replaces the connections nearing their idle timeout
+  void maintain();
+
+  void scheduleMaintenance();
+
+  folly::EventBase* evb_;
+  ClientFactory clientFactory_;
+  std::shared_ptr<QuicPskCache> pskCache_;
+  QuicClientConnectionPoolSettings settings_;
+  std::unordered_map<
+      QuicConnectionPoolKey,
+      Connections,
+      QuicConnectionPoolKeyHash>
+      connections_;
+  MaintenanceTimeout maintenanceTimeout_;
+};
+
+} // namespace quic
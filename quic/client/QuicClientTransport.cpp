@@ -10,10 +10,13 @@
 
 #include <folly/portability/Sockets.h>
 
+#include <quic/api/QuicBatchWriter.h>
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/client/handshake/ClientHandshakeFactory.h>
 #include <quic/client/handshake/ClientTransportParametersExtension.h>
 #include <quic/client/state/ClientStateMachine.h>
+#include <quic/common/SocketUtil.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/handshake/CryptoFactory.h>
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
@@ -124,7 +127,8 @@ void QuicClientTransport::processUDPData(
   for (uint16_t processedPackets = 0;
        !udpData.empty() && processedPackets < kMaxNumCoalescedPackets;
        processedPackets++) {
-    processPacketData(peer, networkData.receiveTimePoint, udpData);
+    processPacketData(
+        peer, networkData.receiveTimePoint, networkData.ecn, udpData);
   }
   VLOG_IF(4, !udpData.empty())
       << "Leaving " << udpData.chainLength()
@@ -135,6 +139,7 @@ void QuicClientTransport::processUDPData(
 void QuicClientTransport::processPacketData(
     const folly::SocketAddress& peer,
     TimePoint receiveTimePoint,
+    uint8_t ecn,
     BufQueue& packetQueue) {
   auto packetSize = packetQueue.chainLength();
   if (packetSize == 0) {
@@ -145,7 +150,7 @@ void QuicClientTransport::processPacketData(
   StatelessReset* statelessReset = parsedPacket.statelessReset();
   if (statelessReset) {
     auto& token = clientConn_->statelessResetToken;
-    if (statelessReset->token == token) {
+    if (token && isStatelessResetTokenEqual(statelessReset->token, *token)) {
       VLOG(4) << "Received Stateless Reset " << *this;
       conn_->peerConnectionError = std::make_pair(
           QuicErrorCode(LocalErrorCode::CONNECTION_RESET),
@@ -163,9 +168,11 @@ void QuicClientTransport::processPacketData(
     QUIC_TRACE(packet_drop, *conn_, "parse");
     return;
   }
-  if (happyEyeballsEnabled_) {
+  if (happyEyeballsEnabled_ && !conn_->happyEyeballsState.finished) {
     happyEyeballsOnDataReceived(
         *conn_, happyEyeballsConnAttemptDelayTimeout_, socket_, peer);
+    cacheHappyEyeballsWinner();
+    maybeConnectSocket();
   }
 
   LongHeader* longHeader = regularOptional->header.asLong();
@@ -233,6 +240,12 @@ void QuicClientTransport::processPacketData(
   if (conn_->qLogger) {
     conn_->qLogger->addPacket(regularPacket, packetSize);
   }
+  QUIC_PROBE(
+      packet_received,
+      *conn_,
+      packetNum,
+      static_cast<uint8_t>(pnSpace),
+      packetSize);
   if (!isProtectedPacket) {
     for (auto& quicFrame : regularPacket.frames) {
       auto isPadding = quicFrame.asPaddingFrame();
@@ -283,6 +296,7 @@ void QuicClientTransport::processPacketData(
   auto& ackState = getAckState(*conn_, pnSpace);
   auto outOfOrder =
       updateLargestReceivedPacketNum(ackState, packetNum, receiveTimePoint);
+  updateEcnCounts(ackState, ecn);
 
   bool pktHasRetransmittableData = false;
   bool pktHasCryptoData = false;
@@ -302,7 +316,8 @@ void QuicClientTransport::processPacketData(
                 const ReadAckFrame&) {
               auto outstandingProtectionType =
                   outstandingPacket.packet.header.getProtectionType();
-              if (outstandingProtectionType == ProtectionType::KeyPhaseZero) {
+              if (outstandingProtectionType == ProtectionType::KeyPhaseZero ||
+                  outstandingProtectionType == ProtectionType::KeyPhaseOne) {
                 // If we received an ack for data that we sent in 1-rtt from
                 // the server, we can assume that the server had successfully
                 // derived the 1-rtt keys and hence received the client
@@ -503,6 +518,14 @@ void QuicClientTransport::processPacketData(
             *conn_, simpleFrame, packetNum, false);
         break;
       }
+      case QuicFrame::Type::DatagramFrame_E: {
+        DatagramFrame& frame = *quicFrame.asDatagramFrame();
+        VLOG(10) << "Client received datagram len=" << frame.length << " "
+                 << *this;
+        pktHasRetransmittableData = true;
+        handleDatagram(*conn_, std::move(frame));
+        break;
+      }
       default:
         break;
     }
@@ -551,6 +574,8 @@ void QuicClientTransport::processPacketData(
       conn_->oneRttWriteHeaderCipher = std::move(oneRttWriteHeaderCipher);
       oneRttKeyDerivationTriggered = true;
       updatePacingOnKeyEstablished(*conn_);
+      // The streams that were not to go out in 0-RTT can now be written.
+      conn_->streamManager->onReplaySafe();
     }
     if (oneRttReadCipher) {
       CHECK(oneRttReadHeaderCipher);
@@ -570,12 +595,17 @@ void QuicClientTransport::processPacketData(
         conn_->qLogger->addTransportStateUpdate(kZeroRttRejected);
       }
       QUIC_TRACE(zero_rtt, *conn_, "rejected");
+      conn_->zeroRttState.accepted = false;
       removePsk();
     } else if (conn_->zeroRttWriteCipher) {
       if (conn_->qLogger) {
         conn_->qLogger->addTransportStateUpdate(kZeroRttAccepted);
       }
       QUIC_TRACE(zero_rtt, *conn_, "accepted");
+      // The peer would have said so with the 1-RTT keys.
+      if (conn_->oneRttWriteCipher && !conn_->zeroRttState.accepted) {
+        conn_->zeroRttState.accepted = true;
+      }
     }
     bool shouldNegotiateParameters = false;
     if (clientConn_->zeroRttWriteCipher) {
@@ -747,7 +777,7 @@ void QuicClientTransport::writeData() {
   }
 
   uint64_t packetLimit =
-      (isConnectionPaced(*conn_)
+      (isConnectionPaced(*conn_) && !isConnectionPacedInKernel(*conn_)
            ? conn_->pacer->updateAndGetWriteBatchSize(Clock::now())
            : conn_->transportSettings.writeConnectionDataPacketsLimit);
   if (conn_->initialWriteCipher) {
@@ -800,7 +830,7 @@ void QuicClientTransport::writeData() {
   }
   if (clientConn_->zeroRttWriteCipher && !conn_->oneRttWriteCipher) {
     CHECK(clientConn_->zeroRttWriteHeaderCipher);
-    packetLimit -= writeZeroRttDataToSocket(
+    auto zeroRttPacketsWritten = writeZeroRttDataToSocket(
         *socket_,
         *conn_,
         srcConnId /* src */,
@@ -809,12 +839,16 @@ void QuicClientTransport::writeData() {
         *clientConn_->zeroRttWriteHeaderCipher,
         version,
         packetLimit);
+    conn_->zeroRttState.packetsSent += zeroRttPacketsWritten;
+    packetLimit -= zeroRttPacketsWritten;
   }
   if (!packetLimit) {
     return;
   }
   if (conn_->oneRttWriteCipher) {
     CHECK(clientConn_->oneRttWriteHeaderCipher);
+    maybeOffloadOneRttWriteCiphers(*conn_);
+    maybeParallelizeOneRttWriteCipher(*conn_);
     writeQuicDataExceptCryptoStreamToSocket(
         *socket_,
         *conn_,
@@ -893,6 +927,9 @@ void QuicClientTransport::startCryptoHandshake() {
 
   // Add partial reliability parameter to customTransportParameters_.
   setPartialReliabilityTransportParameter();
+  setAckFrequencyTransportParameter();
+  setDatagramTransportParameter();
+  setStreamRepairTransportParameter();
 
   auto paramsExtension = std::make_shared<ClientTransportParametersExtension>(
       folly::none,
@@ -918,6 +955,7 @@ void QuicClientTransport::startCryptoHandshake() {
       conn_->qLogger->addTransportStateUpdate(kZeroRttAttempted);
     }
     QUIC_TRACE(zero_rtt, *conn_, "attempted");
+    conn_->zeroRttState.attempted = true;
     clientConn_->zeroRttWriteCipher = std::move(zeroRttWriteCipher);
     clientConn_->zeroRttWriteHeaderCipher = std::move(zeroRttWriteHeaderCipher);
 
@@ -933,6 +971,7 @@ void QuicClientTransport::startCryptoHandshake() {
         transportParams.initialMaxStreamsBidi,
         transportParams.initialMaxStreamsUni);
     updateTransportParamsFromCachedEarlyParams(*clientConn_, transportParams);
+    maybeCarefulResume(*quicCachedPsk);
   }
   writeSocketData();
   if (!transportReadyNotified_ && clientConn_->zeroRttWriteCipher) {
@@ -973,6 +1012,50 @@ void QuicClientTransport::removePsk() {
   }
 }
 
+void QuicClientTransport::maybeCarefulResume(
+    const QuicCachedPsk& quicCachedPsk) {
+  // Only the first flight of a connection starts from the saved state, not
+  // the one after a version negotiation, and warm start takes precedence.
+  if (!conn_->transportSettings.carefulResume ||
+      !quicCachedPsk.congestionState || !ccFactory_ ||
+      !conn_->congestionController || conn_->warmStartCwndBytes ||
+      conn_->lossState.totalBytesSent > 0) {
+    return;
+  }
+  const auto& state = *quicCachedPsk.congestionState;
+  auto jumpCwnd =
+      warmStartCwnd(*conn_, state, std::chrono::system_clock::now());
+  if (!jumpCwnd) {
+    return;
+  }
+  VLOG(4) << "Careful resume to cwnd=" << *jumpCwnd
+          << " saved cwnd=" << state.cwndBytes
+          << " minRtt=" << state.minRtt.count() << " " << *this;
+  CarefulResumeParams params;
+  params.jumpCwndBytes = *jumpCwnd;
+  params.savedRtt = state.minRtt;
+  conn_->carefulResume = params;
+  conn_->congestionController = ccFactory_->makeCongestionController(
+      *conn_, conn_->congestionController->type());
+}
+
+void QuicClientTransport::cacheCongestionStateWithPsk() {
+  if (!conn_->transportSettings.carefulResume || !pskCache_ || !hostname_) {
+    return;
+  }
+  auto quicCachedPsk = pskCache_->getPsk(*hostname_);
+  if (!quicCachedPsk) {
+    return;
+  }
+  auto state =
+      makeCachedCongestionState(*conn_, std::chrono::system_clock::now());
+  if (!state) {
+    return;
+  }
+  quicCachedPsk->congestionState = std::move(state);
+  pskCache_->putPsk(*hostname_, std::move(*quicCachedPsk));
+}
+
 void QuicClientTransport::onNewCachedPsk(
     fizz::client::NewCachedPsk& newCachedPsk) noexcept {
   DCHECK(conn_->version.has_value());
@@ -1025,6 +1108,10 @@ bool QuicClientTransport::isTLSResumed() const {
 void QuicClientTransport::errMessage(
     FOLLY_MAYBE_UNUSED const cmsghdr& cmsg) noexcept {
 #ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  if (conn_->zeroCopyTracker &&
+      conn_->zeroCopyTracker->handleErrMessage(cmsg)) {
+    return;
+  }
   if ((cmsg.cmsg_level == SOL_IP && cmsg.cmsg_type == IP_RECVERR) ||
       (cmsg.cmsg_level == SOL_IPV6 && cmsg.cmsg_type == IPV6_RECVERR)) {
     const struct sock_extended_err* serr =
@@ -1046,6 +1133,101 @@ void QuicClientTransport::errMessage(
 #endif
 }
 
+void QuicClientTransport::maybeEnableZeroCopySend() {
+  // The tracker of a previous socket went with it, see onNetworkSwitch.
+  DCHECK(!conn_->zeroCopyTracker);
+  if (!conn_->transportSettings.enableZeroCopySend ||
+      !conn_->transportSettings.enableSocketErrMsgCallback) {
+    return;
+  }
+  if (!ZeroCopyBufferTracker::enableZeroCopy(*socket_)) {
+    VLOG(4) << "Unable to turn on zerocopy sends " << *this;
+    return;
+  }
+  conn_->zeroCopyTracker =
+      std::make_shared<ZeroCopyBufferTracker>(socket_->getNetworkSocket());
+  conn_->zeroCopyTracker->setBufferPool(conn_->bufPool.get());
+}
+
+void QuicClientTransport::maybeEnableTxTimePacing() {
+  conn_->socketTxTimeEnabled = false;
+  if (!conn_->transportSettings.txTimePacing) {
+    return;
+  }
+  // Both happy eyeballs sockets are written by the same batch, so the
+  // departure times are only used if every socket accepts them.
+  bool enabled = enableSocketTxTime(*socket_);
+  if (enabled && conn_->happyEyeballsState.secondSocket) {
+    enabled = enableSocketTxTime(*conn_->happyEyeballsState.secondSocket);
+  }
+  if (!enabled) {
+    VLOG(4) << "Unable to turn on SO_TXTIME " << *this;
+    return;
+  }
+  conn_->socketTxTimeEnabled = true;
+}
+
+void QuicClientTransport::maybeEnableCryptoOffload() {
+  conn_->cryptoOffload.reset();
+  if (!cryptoOffload_) {
+    return;
+  }
+  // Both happy eyeballs sockets are written by the same batch.
+  bool enabled = cryptoOffload_->probe(socket_->getNetworkSocket());
+  if (enabled && conn_->happyEyeballsState.secondSocket) {
+    enabled = cryptoOffload_->probe(
+        conn_->happyEyeballsState.secondSocket->getNetworkSocket());
+  }
+  if (!enabled) {
+    VLOG(4) << "No crypto offload for the sockets " << *this;
+    return;
+  }
+  conn_->cryptoOffload = cryptoOffload_;
+}
+
+void QuicClientTransport::maybeStartIOUringRecv() {
+  ioUringReceiver_.reset();
+  // The happy eyeballs sockets race with their own read callbacks.
+  if (!conn_->transportSettings.ioUringRecv || happyEyeballsEnabled_) {
+    return;
+  }
+  IOUringReceiverOptions options;
+  options.numBuffers = conn_->transportSettings.ioUringRecvBuffers;
+  options.payloadSize = conn_->transportSettings.enableUdpGRO
+      ? kGROReadBufferSize
+      : conn_->transportSettings.maxRecvPacketSize;
+  ioUringReceiver_ = IOUringReceiver::make(
+      evb_, socket_->getNetworkSocket().toFd(), options);
+  if (!ioUringReceiver_) {
+    VLOG(4) << "No io_uring reads for the socket " << *this;
+    return;
+  }
+  socket_->pauseRead();
+  ioUringReceiver_->resumeRead(this);
+}
+
+void QuicClientTransport::maybeResolveBatchingMode() {
+  // The sockets of a connection are all on the same host, the same mode
+  // goes for the one that wins the race.
+  auto batchingMode = resolveBatchingMode(
+      *socket_, conn_->transportSettings.batchingMode);
+  if (batchingMode != conn_->transportSettings.batchingMode) {
+    VLOG(4) << "Batching mode=" << static_cast<uint32_t>(batchingMode) << " "
+            << *this;
+    conn_->transportSettings.batchingMode = batchingMode;
+  }
+}
+
+void QuicClientTransport::maybeConnectSocket() {
+  // A connected socket can only be written to its peer, while the addresses
+  // are raced the sockets stay unconnected.
+  if (!conn_->transportSettings.connectUDP ||
+      (happyEyeballsEnabled_ && !conn_->happyEyeballsState.finished)) {
+    return;
+  }
+  socket_->connect(conn_->peerAddress);
+}
+
 void QuicClientTransport::getReadBuffer(void** buf, size_t* len) noexcept {
   DCHECK(conn_) << "trying to receive packets without a connection";
   auto readBufferSize = conn_->transportSettings.maxRecvPacketSize;
@@ -1110,6 +1292,13 @@ void QuicClientTransport::recvMsg(
     msg.msg_namelen = size_t(addrLen);
     msg.msg_iov = &vec;
     msg.msg_iovlen = 1;
+    RecvmmsgStorage::Control control;
+    if (conn_->transportSettings.enableUdpGRO ||
+        conn_->transportSettings.enableEcn ||
+        conn_->transportSettings.enableRxTimestamps) {
+      msg.msg_control = control.buf;
+      msg.msg_controllen = sizeof(control.buf);
+    }
 
     ssize_t ret = sock.recvmsg(&msg, 0);
     if (ret < 0) {
@@ -1135,7 +1324,13 @@ void QuicClientTransport::recvMsg(
     }
     VLOG(10) << "Got data from socket peer=" << *server << " len=" << bytesRead;
     readBuffer->append(bytesRead);
-    networkData.packets.emplace_back(std::move(readBuffer));
+    size_t firstPacket = networkData.packets.size();
+    splitSegments(
+        std::move(readBuffer), getGROSegmentSize(msg), networkData.packets);
+    networkData.setEcn(firstPacket, getEcnCodepoint(msg));
+    if (auto receiveTime = getReceiveTimestamp(msg, Clock::now())) {
+      networkData.setReceiveTime(firstPacket, *receiveTime);
+    }
     if (conn_->qLogger) {
       conn_->qLogger->addDatagramReceived(bytesRead);
     }
@@ -1150,23 +1345,20 @@ void QuicClientTransport::recvMmsg(
     folly::Optional<folly::SocketAddress>& server,
     size_t& totalData) {
   const size_t addrLen = sizeof(struct sockaddr_storage);
-  networkData.recvmmsgStorage.resize(numPackets);
-
-  auto& msgs = networkData.recvmmsgStorage.msgs;
-  auto& addrs = networkData.recvmmsgStorage.addrs;
-  auto& readBuffers = networkData.recvmmsgStorage.readBuffers;
-  auto& iovecs = networkData.recvmmsgStorage.iovecs;
+  recvmmsgStorage_.resize(numPackets);
+  recvmmsgStorage_.prepareReadBuffers(readBufferSize);
+
+  auto& msgs = recvmmsgStorage_.msgs;
+  auto& addrs = recvmmsgStorage_.addrs;
+  auto& readBuffers = recvmmsgStorage_.readBuffers;
+  auto& iovecs = recvmmsgStorage_.iovecs;
+  auto& controls = recvmmsgStorage_.controls;
+  bool useControl = conn_->transportSettings.enableUdpGRO ||
+      conn_->transportSettings.enableEcn ||
+      conn_->transportSettings.enableRxTimestamps;
 
   int i = 0;
   for (; i < numPackets; ++i) {
-    // We create 1 buffer per packet so that it is not shared, this enables
-    // us to decrypt in place. If the fizz decrypt api could decrypt in-place
-    // even if shared, then we could allocate one giant IOBuf here.
-    Buf readBuffer = folly::IOBuf::create(readBufferSize);
-    iovecs[i].iov_base = readBuffer->writableData();
-    iovecs[i].iov_len = readBufferSize;
-    readBuffers[i] = std::move(readBuffer);
-
     auto* rawAddr = reinterpret_cast<sockaddr*>(&addrs[i]);
     rawAddr->sa_family = socket_->address().getFamily();
 
@@ -1175,6 +1367,8 @@ void QuicClientTransport::recvMmsg(
     msg->msg_namelen = addrLen;
     msg->msg_iov = &iovecs[i];
     msg->msg_iovlen = 1;
+    msg->msg_control = useControl ? controls[i].buf : nullptr;
+    msg->msg_controllen = useControl ? sizeof(controls[i].buf) : 0;
   }
 
   int numMsgsRecvd =
@@ -1194,6 +1388,7 @@ void QuicClientTransport::recvMmsg(
   }
 
   CHECK_LE(numMsgsRecvd, numPackets);
+  auto readTime = Clock::now();
   for (i = 0; i < numMsgsRecvd; ++i) {
     size_t bytesRead = msgs[i].msg_len;
     totalData += bytesRead;
@@ -1206,7 +1401,16 @@ void QuicClientTransport::recvMmsg(
 
     VLOG(10) << "Got data from socket peer=" << *server << " len=" << bytesRead;
     readBuffers[i]->append(bytesRead);
-    networkData.packets.emplace_back(std::move(readBuffers[i]));
+    // a datagram coalesced by GRO is handed over as the packets it is made of
+    size_t firstPacket = networkData.packets.size();
+    splitSegments(
+        std::move(readBuffers[i]),
+        getGROSegmentSize(msgs[i].msg_hdr),
+        networkData.packets);
+    networkData.setEcn(firstPacket, getEcnCodepoint(msgs[i].msg_hdr));
+    if (auto receiveTime = getReceiveTimestamp(msgs[i].msg_hdr, readTime)) {
+      networkData.setReceiveTime(firstPacket, *receiveTime);
+    }
     QUIC_TRACE(udp_recvd, *conn_, bytesRead);
     if (conn_->qLogger) {
       conn_->qLogger->addDatagramReceived(bytesRead);
@@ -1217,7 +1421,9 @@ void QuicClientTransport::recvMmsg(
 void QuicClientTransport::onNotifyDataAvailable(
     folly::AsyncUDPSocket& sock) noexcept {
   DCHECK(conn_) << "trying to receive packets without a connection";
-  auto readBufferSize = conn_->transportSettings.maxRecvPacketSize;
+  auto readBufferSize = conn_->transportSettings.enableUdpGRO
+      ? kGROReadBufferSize
+      : conn_->transportSettings.maxRecvPacketSize;
   const int numPackets = conn_->transportSettings.maxRecvBatchSize;
 
   NetworkData networkData;
@@ -1235,25 +1441,117 @@ void QuicClientTransport::onNotifyDataAvailable(
     return;
   }
   DCHECK(server.has_value());
-  // TODO: we can get better receive time accuracy than this, with
-  // SO_TIMESTAMP or SIOCGSTAMP.
+  // The packets the kernel timestamped keep their own receive times.
   auto packetReceiveTime = Clock::now();
   networkData.receiveTimePoint = packetReceiveTime;
   networkData.totalData = totalData;
   onNetworkData(*server, std::move(networkData));
 }
 
+void QuicClientTransport::onIOUringPacket(
+    IOUringReceiver&,
+    const folly::SocketAddress& server,
+    Buf data,
+    struct msghdr& msg) noexcept {
+  DCHECK(conn_) << "trying to receive packets without a connection";
+  // Like a batch read, the packets of a wakeup go to onNetworkData together,
+  // see onIOUringReadDone.
+  if (!ioUringServer_) {
+    ioUringServer_ = server;
+  }
+  auto bytesRead = data->length();
+  ioUringNetworkData_.totalData += bytesRead;
+  VLOG(10) << "Got data from socket peer=" << server << " len=" << bytesRead;
+  // a datagram coalesced by GRO is handed over as the packets it is made of
+  size_t firstPacket = ioUringNetworkData_.packets.size();
+  splitSegments(
+      std::move(data), getGROSegmentSize(msg), ioUringNetworkData_.packets);
+  ioUringNetworkData_.setEcn(firstPacket, getEcnCodepoint(msg));
+  if (auto receiveTime = getReceiveTimestamp(msg, Clock::now())) {
+    ioUringNetworkData_.setReceiveTime(firstPacket, *receiveTime);
+  }
+  QUIC_TRACE(udp_recvd, *conn_, bytesRead);
+  if (conn_->qLogger) {
+    conn_->qLogger->addDatagramReceived(bytesRead);
+  }
+}
+
+void QuicClientTransport::onIOUringReadDone(IOUringReceiver&) noexcept {
+  flushIOUringNetworkData();
+}
+
+void QuicClientTransport::onIOUringReadError(
+    IOUringReceiver&,
+    int error) noexcept {
+  VLOG(4) << "Reading the socket itself after io_uring error=" << error << " "
+          << *this;
+  if (socket_) {
+    socket_->resumeRead(this);
+  }
+  // Destroys the receiver, it returns right after this.
+  ioUringReceiver_.reset();
+  // the packets read before the error
+  flushIOUringNetworkData();
+}
+
+void QuicClientTransport::flushIOUringNetworkData() {
+  auto networkData = std::move(ioUringNetworkData_);
+  ioUringNetworkData_ = NetworkData();
+  auto server = std::move(ioUringServer_);
+  ioUringServer_.reset();
+  if (networkData.packets.empty()) {
+    return;
+  }
+  // The packets the kernel timestamped keep their own receive times.
+  networkData.receiveTimePoint = Clock::now();
+  onNetworkData(*server, std::move(networkData));
+}
+
 void QuicClientTransport::
     happyEyeballsConnAttemptDelayTimeoutExpired() noexcept {
   QUIC_TRACE(happy_eyeballs, *conn_, "delay timer expired");
   // Declare 0-RTT data as lost so that they will be retransmitted over the
   // second socket.
   markZeroRttPacketsLost(*conn_, markPacketLoss);
-  happyEyeballsStartSecondSocket(conn_->happyEyeballsState);
+  happyEyeballsStartNextAttempt(*conn_);
+  if (!conn_->happyEyeballsState.pendingPeerAddresses.empty()) {
+    getEventBase()->timer().scheduleTimeout(
+        &happyEyeballsConnAttemptDelayTimeout_, kHappyEyeballsNextAttemptDelay);
+  }
+}
+
+void QuicClientTransport::maybeUseCachedHappyEyeballsWinner() {
+  if (!happyEyeballsCache_ || !hostname_) {
+    return;
+  }
+  auto winner = happyEyeballsCache_->getWinner(*hostname_);
+  if (!winner) {
+    return;
+  }
+  if (std::chrono::system_clock::now() - winner->recordTime >
+      kHappyEyeballsCacheMaxAge) {
+    happyEyeballsCache_->removeWinner(*hostname_);
+    return;
+  }
+  // Left to the race when the host no longer resolves to it
+  if (happyEyeballsPreferPeerAddress(*conn_, winner->peerAddress)) {
+    happyEyeballsCachedFamily_ = winner->peerAddress.getFamily();
+  }
+}
+
+void QuicClientTransport::cacheHappyEyeballsWinner() {
+  if (!happyEyeballsCache_ || !hostname_) {
+    return;
+  }
+  happyEyeballsCache_->putWinner(
+      *hostname_,
+      CachedHappyEyeballsWinner{
+          conn_->peerAddress, std::chrono::system_clock::now()});
 }
 
 void QuicClientTransport::start(ConnectionCallback* cb) {
   if (happyEyeballsEnabled_) {
+    maybeUseCachedHappyEyeballsWinner();
     // TODO Supply v4 delay amount from somewhere when we want to tune this
     startHappyEyeballs(
         *conn_,
@@ -1275,6 +1573,7 @@ void QuicClientTransport::start(ConnectionCallback* cb) {
   }
   QUIC_TRACE(fst_trace, *conn_, "start");
   setConnectionCallback(cb);
+  maybeWarmStartCongestionControl();
   try {
     happyEyeballsSetUpSocket(
         *socket_,
@@ -1284,6 +1583,12 @@ void QuicClientTransport::start(ConnectionCallback* cb) {
         this,
         this,
         socketOptions_);
+    maybeConnectSocket();
+    maybeResolveBatchingMode();
+    maybeEnableZeroCopySend();
+    maybeEnableTxTimePacing();
+    maybeEnableCryptoOffload();
+    maybeStartIOUringRecv();
     startCryptoHandshake();
   } catch (const QuicTransportException& ex) {
     runOnEvbAsync([ex](auto self) {
@@ -1341,6 +1646,11 @@ void QuicClientTransport::setHappyEyeballsCachedFamily(
   happyEyeballsCachedFamily_ = cachedFamily;
 }
 
+void QuicClientTransport::setHappyEyeballsCache(
+    std::shared_ptr<QuicHappyEyeballsCache> happyEyeballsCache) {
+  happyEyeballsCache_ = std::move(happyEyeballsCache);
+}
+
 void QuicClientTransport::addNewSocket(
     std::unique_ptr<folly::AsyncUDPSocket> socket) {
   happyEyeballsAddSocket(*conn_, std::move(socket));
@@ -1354,6 +1664,11 @@ void QuicClientTransport::setPskCache(std::shared_ptr<QuicPskCache> pskCache) {
   pskCache_ = std::move(pskCache);
 }
 
+void QuicClientTransport::setCryptoOffload(
+    std::shared_ptr<CryptoOffload> offload) {
+  cryptoOffload_ = std::move(offload);
+}
+
 void QuicClientTransport::setSelfOwning() {
   selfOwning_ = shared_from_this();
 }
@@ -1399,11 +1714,43 @@ void QuicClientTransport::setPartialReliabilityTransportParameter() {
   }
 }
 
+void QuicClientTransport::setAckFrequencyTransportParameter() {
+  if (!conn_->transportSettings.ackFrequencyEnabled) {
+    return;
+  }
+  // Not in the private range setCustomTransportParameter takes.
+  customTransportParameters_.push_back(encodeIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      kMinAckDelay.count()));
+}
+
+void QuicClientTransport::setDatagramTransportParameter() {
+  if (!conn_->transportSettings.maxRecvDatagramFrameSize) {
+    return;
+  }
+  // Not in the private range setCustomTransportParameter takes.
+  customTransportParameters_.push_back(encodeIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      conn_->transportSettings.maxRecvDatagramFrameSize));
+}
+
+void QuicClientTransport::setStreamRepairTransportParameter() {
+  if (!conn_->transportSettings.streamRepairReceiveWindow) {
+    return;
+  }
+  customTransportParameters_.push_back(encodeIntegerParameter(
+      static_cast<TransportParameterId>(kStreamRepairReceiveWindowParameterId),
+      conn_->transportSettings.streamRepairReceiveWindow));
+}
+
 void QuicClientTransport::closeTransport() {
   happyEyeballsConnAttemptDelayTimeout_.cancelTimeout();
+  cacheCongestionStateWithPsk();
 }
 
 void QuicClientTransport::unbindConnection() {
+  // The socket is closed by now, nothing is read from it anymore.
+  ioUringReceiver_.reset();
   selfOwning_ = nullptr;
 }
 
@@ -1431,11 +1778,14 @@ void QuicClientTransport::onNetworkSwitch(
     return;
   }
   if (socket_ && newSock) {
+    ioUringReceiver_.reset();
     auto sock = std::move(socket_);
     socket_ = nullptr;
     sock->setErrMessageCallback(nullptr);
     sock->pauseRead();
-    sock->close();
+    // The buffers of zerocopy sends still in flight stay with the old socket
+    // until the kernel is done with them.
+    closeAfterZeroCopySends(std::move(sock), std::move(conn_->zeroCopyTracker));
 
     socket_ = std::move(newSock);
     happyEyeballsSetUpSocket(
@@ -1446,6 +1796,30 @@ void QuicClientTransport::onNetworkSwitch(
         this,
         this,
         socketOptions_);
+    maybeConnectSocket();
+    maybeEnableZeroCopySend();
+    maybeEnableTxTimePacing();
+    maybeEnableCryptoOffload();
+    maybeStartIOUringRecv();
+    // The new network is a new path, neither the congestion state nor the
+    // rtt of the old one applies to it.
+    if (ccFactory_ && conn_->congestionController) {
+      conn_->warmStartCwndBytes = folly::none;
+      conn_->carefulResume = folly::none;
+      conn_->congestionController = ccFactory_->makeCongestionController(
+          *conn_, conn_->congestionController->type());
+    }
+    conn_->lossState.srtt = 0us;
+    conn_->lossState.lrtt = 0us;
+    conn_->lossState.rttvar = 0us;
+    conn_->lossState.mrtt = kDefaultMinRtt;
+    // Nor the packet size it was found to carry.
+    restartPmtuDiscovery(*conn_);
+    // Sends from the new address right away rather than on the next write of
+    // the application, so that the server starts validating the path while
+    // the data is still flowing.
+    sendSimpleFrame(*conn_, PingFrame());
+    updateWriteLooper(true);
     if (conn_->qLogger) {
       conn_->qLogger->addConnectionMigrationUpdate(true);
     }
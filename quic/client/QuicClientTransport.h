@@ -17,6 +17,8 @@
 #include <quic/client/handshake/QuicPskCache.h>
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/common/BufUtil.h>
+#include <quic/common/IOUringReceiver.h>
+#include <quic/happyeyeballs/QuicHappyEyeballsCache.h>
 
 namespace quic {
 
@@ -26,6 +28,7 @@ class QuicClientTransport
     : public QuicTransportBase,
       public folly::AsyncUDPSocket::ReadCallback,
       public folly::AsyncUDPSocket::ErrMessageCallback,
+      public IOUringReceiver::ReadCallback,
       public std::enable_shared_from_this<QuicClientTransport>,
       private ClientHandshake::HandshakeCallback {
  public:
@@ -67,7 +70,8 @@ class QuicClientTransport
 
   /**
    * Supplies a new peer address to use for the connection. This must be called
-   * at least once before start().
+   * at least once before start(). With happy eyeballs enabled, every address
+   * supplied is raced, in the order supplied within each family.
    */
   void addNewPeerAddress(folly::SocketAddress peerAddress);
   /**
@@ -79,12 +83,29 @@ class QuicClientTransport
   void setHappyEyeballsEnabled(bool happyEyeballsEnabled);
   virtual void setHappyEyeballsCachedFamily(sa_family_t cachedFamily);
 
+  /**
+   * Set the cache of the addresses that won the happy eyeballs races to the
+   * hosts. The winner cached for the hostname is attempted first, and the
+   * race is only on when it does not answer within
+   * kHappyEyeballsConnAttemptDelayWithCache. Must be set before start().
+   */
+  void setHappyEyeballsCache(
+      std::shared_ptr<QuicHappyEyeballsCache> happyEyeballsCache);
+
   /**
    * Set the cache that remembers psk and server transport parameters from
    * last connection. This is useful for session resumption and 0-rtt.
    */
   void setPskCache(std::shared_ptr<QuicPskCache> pskCache);
 
+  /**
+   * Set the device that seals the 1-RTT packets, e.g. a NIC with inline QUIC
+   * crypto, see CryptoOffload. The sockets are probed for it when they are
+   * set up, the packets are sealed in software if they don't support it.
+   * This must be set before start().
+   */
+  void setCryptoOffload(std::shared_ptr<CryptoOffload> offload);
+
   /**
    * Starts the connection.
    */
@@ -182,6 +203,16 @@ class QuicClientTransport
       folly::Optional<folly::SocketAddress>& server,
       size_t& totalData);
 
+  // From IOUringReceiver::ReadCallback
+  void onIOUringPacket(
+      IOUringReceiver& receiver,
+      const folly::SocketAddress& server,
+      Buf data,
+      struct msghdr& msg) noexcept override;
+  void onIOUringReadDone(IOUringReceiver& receiver) noexcept override;
+  void onIOUringReadError(IOUringReceiver& receiver, int error) noexcept
+      override;
+
   void processUDPData(
       const folly::SocketAddress& peer,
       NetworkDataSingle&& networkData);
@@ -189,10 +220,32 @@ class QuicClientTransport
   void processPacketData(
       const folly::SocketAddress& peer,
       TimePoint receiveTimePoint,
+      uint8_t ecn,
       BufQueue& packetQueue);
 
   void startCryptoHandshake();
 
+  // sets up the zerocopy state for socket_ when the settings ask for it
+  void maybeEnableZeroCopySend();
+
+  // turns on SO_TXTIME for the sockets when the settings ask for it
+  void maybeEnableTxTimePacing();
+
+  // uses cryptoOffload_ for the sockets when they support it
+  void maybeEnableCryptoOffload();
+
+  // reads socket_ through an io_uring when the settings ask for it
+  void maybeStartIOUringRecv();
+  // hands the packets the io_uring read in this wakeup to onNetworkData
+  void flushIOUringNetworkData();
+
+  // picks the batching mode BATCHING_MODE_AUTO stands for on the socket
+  void maybeResolveBatchingMode();
+
+  // connects the socket to the peer with connectUDP, once happy eyeballs has
+  // picked the address
+  void maybeConnectSocket();
+
   void happyEyeballsConnAttemptDelayTimeoutExpired() noexcept;
 
   void handleAckFrame(
@@ -205,6 +258,8 @@ class QuicClientTransport
       fizz::client::NewCachedPsk& newCachedPsk) noexcept override;
 
   Buf readBuffer_;
+  // kept across batch reads so that the read buffers can be reused
+  RecvmmsgStorage recvmmsgStorage_;
   folly::Optional<std::string> hostname_;
   HappyEyeballsConnAttemptDelayTimeout happyEyeballsConnAttemptDelayTimeout_;
   bool serverInitialParamsSet_{false};
@@ -223,7 +278,18 @@ class QuicClientTransport
       uint64_t peerAdvertisedInitialMaxStreamUni);
   folly::Optional<QuicCachedPsk> getPsk();
   void removePsk();
+  // Has the race attempt the cached winner for the hostname first
+  void maybeUseCachedHappyEyeballsWinner();
+  // Leaves the address that won the race in the cache
+  void cacheHappyEyeballsWinner();
+  // Sets up careful resume from the congestion state the psk carries
+  void maybeCarefulResume(const QuicCachedPsk& quicCachedPsk);
+  // Leaves the congestion state of the connection with the psk when it closes
+  void cacheCongestionStateWithPsk();
   void setPartialReliabilityTransportParameter();
+  void setAckFrequencyTransportParameter();
+  void setDatagramTransportParameter();
+  void setStreamRepairTransportParameter();
 
   bool replaySafeNotified_{false};
   // Set it QuicClientTransport is in a self owning mode. This will be cleaned
@@ -231,7 +297,14 @@ class QuicClientTransport
   std::shared_ptr<QuicClientTransport> selfOwning_;
   bool happyEyeballsEnabled_{false};
   sa_family_t happyEyeballsCachedFamily_{AF_UNSPEC};
+  std::shared_ptr<QuicHappyEyeballsCache> happyEyeballsCache_;
   std::shared_ptr<QuicPskCache> pskCache_;
+  std::shared_ptr<CryptoOffload> cryptoOffload_;
+  // With ioUringRecv, what reads socket_, and the packets it read in the
+  // current wakeup.
+  std::shared_ptr<IOUringReceiver> ioUringReceiver_;
+  NetworkData ioUringNetworkData_;
+  folly::Optional<folly::SocketAddress> ioUringServer_;
   QuicClientConnectionState* clientConn_;
   std::vector<TransportParameter> customTransportParameters_;
   folly::SocketOptionMap socketOptions_;
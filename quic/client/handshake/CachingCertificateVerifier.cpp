@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/handshake/CachingCertificateVerifier.h>
+
+#include <fizz/crypto/Sha256.h>
+#include <folly/ssl/OpenSSLCertUtils.h>
+
+namespace quic {
+
+CachingCertificateVerifier::CachingCertificateVerifier(
+    std::shared_ptr<const fizz::CertificateVerifier> verifier,
+    size_t maxSize,
+    std::chrono::seconds lifetime)
+    : verifier_(std::move(verifier)), lifetime_(lifetime), verified_(maxSize) {
+  CHECK(verifier_);
+  CHECK_GT(maxSize, 0);
+}
+
+void CachingCertificateVerifier::verify(
+    const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const {
+  auto hash = certChainHash(certs);
+  if (!hash) {
+    verifier_->verify(certs);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = verified_.find(*hash);
+    if (it != verified_.end()) {
+      if (Clock::now() - it->second < lifetime_) {
+        return;
+      }
+      verified_.erase(it);
+    }
+  }
+  // Verify without holding the lock, the wrapped verifier can take a while.
+  // Throws if the chain isn't valid.
+  verifier_->verify(certs);
+  std::lock_guard<std::mutex> guard(mutex_);
+  verified_.set(*hash, Clock::now());
+}
+
+std::vector<fizz::Extension>
+CachingCertificateVerifier::getCertificateRequestExtensions() const {
+  return verifier_->getCertificateRequestExtensions();
+}
+
+size_t CachingCertificateVerifier::size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return verified_.size();
+}
+
+folly::Optional<std::string> certChainHash(
+    const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) {
+  if (certs.empty()) {
+    return folly::none;
+  }
+  fizz::Sha256 sha;
+  sha.hash_init();
+  for (const auto& cert : certs) {
+    if (!cert) {
+      return folly::none;
+    }
+    auto x509 = cert->getX509();
+    if (!x509) {
+      return folly::none;
+    }
+    auto der = folly::ssl::OpenSSLCertUtils::derEncode(*x509);
+    sha.hash_update(*der);
+  }
+  std::string hash(fizz::Sha256::HashLen, '\0');
+  sha.hash_final(folly::MutableByteRange(
+      reinterpret_cast<uint8_t*>(&hash[0]), hash.size()));
+  return hash;
+}
+
+} // namespace quic
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <fizz/protocol/CertificateVerifier.h>
+#include <folly/Optional.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace quic {
+
+/**
+ * Verifier that remembers the cert chains the verifier it wraps accepted, so
+ * that the connections to the same servers don't verify the same chain over
+ * and over. Chains are keyed by a hash of their certs, and a chain is only
+ * trusted for the given lifetime before it is verified again. Failures are
+ * not cached.
+ *
+ * The verifier of a FizzClientQuicHandshakeContext is shared by all its
+ * connections, which may run on different threads, so this is thread safe.
+ */
+class CachingCertificateVerifier : public fizz::CertificateVerifier {
+ public:
+  CachingCertificateVerifier(
+      std::shared_ptr<const fizz::CertificateVerifier> verifier,
+      size_t maxSize,
+      std::chrono::seconds lifetime = kDefaultCertVerificationCacheLifetime);
+  ~CachingCertificateVerifier() override = default;
+
+  void verify(const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs)
+      const override;
+
+  std::vector<fizz::Extension> getCertificateRequestExtensions()
+      const override;
+
+  size_t size() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::shared_ptr<const fizz::CertificateVerifier> verifier_;
+  std::chrono::seconds lifetime_;
+  mutable std::mutex mutex_;
+  // When the chain with the hash was verified
+  mutable folly::EvictingCacheMap<std::string, Clock::time_point> verified_;
+};
+
+/**
+ * SHA-256 of the DER encoding of the certs of a chain, in order, or none if
+ * a cert has no X509 to hash.
+ */
+folly::Optional<std::string> certChainHash(
+    const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs);
+
+} // namespace quic
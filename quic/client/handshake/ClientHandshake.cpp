@@ -124,6 +124,41 @@ void ClientHandshake::handshakeConfirmed() {
   phase_ = Phase::Established;
 }
 
+std::unique_ptr<Aead> ClientHandshake::getNextOneRttReadCipher() {
+  return deriveNextOneRttCipher(CipherKind::OneRttRead, oneRttReadSecret_);
+}
+
+std::unique_ptr<Aead> ClientHandshake::getNextOneRttWriteCipher() {
+  return deriveNextOneRttCipher(CipherKind::OneRttWrite, oneRttWriteSecret_);
+}
+
+std::unique_ptr<Aead> ClientHandshake::makeOneRttWriteCipher(
+    uint64_t generation) {
+  auto secret = oneRttBaseWriteSecret_;
+  for (uint64_t i = 0; i < generation && !secret.empty(); ++i) {
+    secret = deriveNextKeyPhaseSecret(folly::range(secret));
+  }
+  if (secret.empty()) {
+    return nullptr;
+  }
+  return buildCiphers(CipherKind::OneRttWrite, folly::range(secret)).first;
+}
+
+std::unique_ptr<Aead> ClientHandshake::deriveNextOneRttCipher(
+    CipherKind kind,
+    std::vector<uint8_t>& secret) {
+  if (secret.empty()) {
+    return nullptr;
+  }
+  auto nextSecret = deriveNextKeyPhaseSecret(folly::range(secret));
+  if (nextSecret.empty()) {
+    return nullptr;
+  }
+  secret = std::move(nextSecret);
+  // The header protection keys stay those of the handshake.
+  return buildCiphers(kind, folly::range(secret)).first;
+}
+
 ClientHandshake::Phase ClientHandshake::getPhase() const {
   return phase_;
 }
@@ -153,10 +188,13 @@ void ClientHandshake::computeCiphers(CipherKind kind, folly::ByteRange secret) {
     case CipherKind::OneRttWrite:
       oneRttWriteCipher_ = std::move(aead);
       oneRttWriteHeaderCipher_ = std::move(packetNumberCipher);
+      oneRttWriteSecret_.assign(secret.begin(), secret.end());
+      oneRttBaseWriteSecret_.assign(secret.begin(), secret.end());
       break;
     case CipherKind::OneRttRead:
       oneRttReadCipher_ = std::move(aead);
       oneRttReadHeaderCipher_ = std::move(packetNumberCipher);
+      oneRttReadSecret_.assign(secret.begin(), secret.end());
       break;
     case CipherKind::ZeroRttWrite:
       zeroRttWriteCipher_ = std::move(aead);
@@ -126,6 +126,10 @@ class ClientHandshake : public Handshake {
    */
   void handshakeConfirmed() override;
 
+  std::unique_ptr<Aead> getNextOneRttReadCipher() override;
+  std::unique_ptr<Aead> getNextOneRttWriteCipher() override;
+  std::unique_ptr<Aead> makeOneRttWriteCipher(uint64_t generation) override;
+
   Phase getPhase() const;
 
   /**
@@ -172,6 +176,13 @@ class ClientHandshake : public Handshake {
   std::unique_ptr<PacketNumberCipher> handshakeWriteHeaderCipher_;
   std::unique_ptr<PacketNumberCipher> zeroRttWriteHeaderCipher_;
 
+  // The 1-RTT secrets of the last key phase handed out, key updates derive
+  // the next ones from them.
+  std::vector<uint8_t> oneRttReadSecret_;
+  std::vector<uint8_t> oneRttWriteSecret_;
+  // The 1-RTT write secret of the first key phase.
+  std::vector<uint8_t> oneRttBaseWriteSecret_;
+
   void computeCiphers(CipherKind kind, folly::ByteRange secret);
 
   folly::Optional<bool> zeroRttRejected_;
@@ -194,6 +205,17 @@ class ClientHandshake : public Handshake {
   virtual bool matchEarlyParameters() = 0;
   virtual std::pair<std::unique_ptr<Aead>, std::unique_ptr<PacketNumberCipher>>
   buildCiphers(CipherKind kind, folly::ByteRange secret) = 0;
+  /**
+   * The 1-RTT secret of the next key phase, empty if the implementation
+   * doesn't support key updates.
+   */
+  virtual std::vector<uint8_t> deriveNextKeyPhaseSecret(folly::ByteRange) {
+    return {};
+  }
+
+  std::unique_ptr<Aead> deriveNextOneRttCipher(
+      CipherKind kind,
+      std::vector<uint8_t>& secret);
 
   // Whether or not to wait for more data.
   bool waitForData_{false};
@@ -38,6 +38,10 @@ void FizzClientHandshake::connect(
   context->setCompatibilityMode(false);
   // Since Draft-17, EOED should not be sent
   context->setOmitEarlyRecordLayer(true);
+  if (fizzContext_->getCertDecompressionManager()) {
+    context->setCertDecompressionManager(
+        fizzContext_->getCertDecompressionManager());
+  }
   processActions(machine_.processConnect(
       state_,
       std::move(context),
@@ -103,6 +107,12 @@ FizzClientHandshake::buildCiphers(CipherKind kind, folly::ByteRange secret) {
   return {std::move(aead), std::move(packetNumberCipher)};
 }
 
+std::vector<uint8_t> FizzClientHandshake::deriveNextKeyPhaseSecret(
+    folly::ByteRange secret) {
+  return quic::deriveNextKeyPhaseSecret(
+      *state_.context()->getFactory(), *state_.cipher(), secret);
+}
+
 class FizzClientHandshake::ActionMoveVisitor {
  public:
   explicit ActionMoveVisitor(FizzClientHandshake& client) : client_(client) {}
@@ -40,6 +40,8 @@ class FizzClientHandshake : public ClientHandshake {
   bool matchEarlyParameters() override;
   std::pair<std::unique_ptr<Aead>, std::unique_ptr<PacketNumberCipher>>
   buildCiphers(CipherKind kind, folly::ByteRange secret) override;
+  std::vector<uint8_t> deriveNextKeyPhaseSecret(
+      folly::ByteRange secret) override;
 
   class ActionMoveVisitor;
   void processActions(fizz::client::Actions actions);
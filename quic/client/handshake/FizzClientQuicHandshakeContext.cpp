@@ -8,14 +8,18 @@
 
 #include <quic/client/handshake/FizzClientQuicHandshakeContext.h>
 
+#include <quic/client/handshake/CachingCertificateVerifier.h>
 #include <quic/client/handshake/FizzClientHandshake.h>
 
 namespace quic {
 
 FizzClientQuicHandshakeContext::FizzClientQuicHandshakeContext(
     std::shared_ptr<const fizz::client::FizzClientContext> context,
-    std::shared_ptr<const fizz::CertificateVerifier> verifier)
-    : context_(std::move(context)), verifier_(std::move(verifier)) {}
+    std::shared_ptr<const fizz::CertificateVerifier> verifier,
+    std::shared_ptr<fizz::CertDecompressionManager> certDecompressionManager)
+    : context_(std::move(context)),
+      verifier_(std::move(verifier)),
+      certDecompressionManager_(std::move(certDecompressionManager)) {}
 
 std::unique_ptr<ClientHandshake>
 FizzClientQuicHandshakeContext::makeClientHandshake(
@@ -32,10 +36,16 @@ FizzClientQuicHandshakeContext::Builder::build() {
     verifier_ = std::make_shared<const fizz::DefaultCertificateVerifier>(
         fizz::VerificationContext::Client);
   }
+  if (certVerificationCacheSize_ > 0) {
+    verifier_ = std::make_shared<const CachingCertificateVerifier>(
+        std::move(verifier_), certVerificationCacheSize_);
+  }
 
   return std::shared_ptr<FizzClientQuicHandshakeContext>(
       new FizzClientQuicHandshakeContext(
-          std::move(context_), std::move(verifier_)));
+          std::move(context_),
+          std::move(verifier_),
+          std::move(certDecompressionManager_)));
 }
 
 } // namespace quic
@@ -11,6 +11,7 @@
 #include <quic/client/handshake/ClientHandshakeFactory.h>
 
 #include <fizz/client/FizzClientContext.h>
+#include <fizz/compression/CertDecompressionManager.h>
 #include <fizz/protocol/DefaultCertificateVerifier.h>
 
 namespace quic {
@@ -34,6 +35,11 @@ class FizzClientQuicHandshakeContext
     return verifier_;
   }
 
+  const std::shared_ptr<fizz::CertDecompressionManager>&
+  getCertDecompressionManager() const {
+    return certDecompressionManager_;
+  }
+
  private:
   /**
    * We make the constructor private so that users have to use the Builder
@@ -45,10 +51,12 @@ class FizzClientQuicHandshakeContext
    */
   FizzClientQuicHandshakeContext(
       std::shared_ptr<const fizz::client::FizzClientContext> context,
-      std::shared_ptr<const fizz::CertificateVerifier> verifier);
+      std::shared_ptr<const fizz::CertificateVerifier> verifier,
+      std::shared_ptr<fizz::CertDecompressionManager> certDecompressionManager);
 
   std::shared_ptr<const fizz::client::FizzClientContext> context_;
   std::shared_ptr<const fizz::CertificateVerifier> verifier_;
+  std::shared_ptr<fizz::CertDecompressionManager> certDecompressionManager_;
 
  public:
   class Builder {
@@ -65,11 +73,36 @@ class FizzClientQuicHandshakeContext
       return *this;
     }
 
+    /**
+     * Has the connections of the context share the results of verifying
+     * the cert chains of the servers, so that a chain that was verified for
+     * one connection isn't verified again for the next, see
+     * CachingCertificateVerifier. 0, the default, verifies every chain.
+     */
+    Builder& setCertVerificationCacheSize(size_t size) {
+      certVerificationCacheSize_ = size;
+      return *this;
+    }
+
+    /**
+     * Offers the servers to send their cert chains compressed with the
+     * algorithms of the manager, which saves the Handshake packets of large
+     * chains. Servers only compress if they have compressed certs for one
+     * of them.
+     */
+    Builder& setCertDecompressionManager(
+        std::shared_ptr<fizz::CertDecompressionManager> manager) {
+      certDecompressionManager_ = std::move(manager);
+      return *this;
+    }
+
     std::shared_ptr<FizzClientQuicHandshakeContext> build();
 
    private:
     std::shared_ptr<const fizz::client::FizzClientContext> context_;
     std::shared_ptr<const fizz::CertificateVerifier> verifier_;
+    size_t certVerificationCacheSize_{0};
+    std::shared_ptr<fizz::CertDecompressionManager> certDecompressionManager_;
   };
 };
 
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <quic/client/handshake/CachedServerTransportParameters.h>
+#include <quic/state/CongestionStateCache.h>
 
 #include <fizz/client/PskCache.h>
 #include <folly/Optional.h>
@@ -21,6 +22,8 @@ struct QuicCachedPsk {
   fizz::client::CachedPsk cachedPsk;
   CachedServerTransportParameters transportParams;
   std::string appParams;
+  // What the last connection resumed with the psk left, for careful resume
+  folly::Optional<CachedCongestionState> congestionState;
 };
 
 class QuicPskCache {
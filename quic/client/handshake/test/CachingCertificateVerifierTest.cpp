@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <quic/client/handshake/CachingCertificateVerifier.h>
+
+#include <fizz/crypto/Sha256.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/Certificate.h>
+
+using namespace fizz;
+using namespace fizz::test;
+
+namespace quic {
+namespace test {
+
+class CountingCertificateVerifier : public CertificateVerifier {
+ public:
+  void verify(const std::vector<std::shared_ptr<const PeerCert>>&)
+      const override {
+    verifications++;
+    if (fail) {
+      throw std::runtime_error("bad chain");
+    }
+  }
+
+  std::vector<Extension> getCertificateRequestExtensions() const override {
+    return std::vector<Extension>();
+  }
+
+  mutable size_t verifications{0};
+  bool fail{false};
+};
+
+class CachingCertificateVerifierTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    verifier_ = std::make_shared<CountingCertificateVerifier>();
+    auto cert = std::make_shared<PeerCertImpl<KeyType::P256>>(
+        getCert(kP256Certificate));
+    chain_.push_back(cert);
+    longerChain_.push_back(cert);
+    longerChain_.push_back(cert);
+  }
+
+  std::shared_ptr<CountingCertificateVerifier> verifier_;
+  std::vector<std::shared_ptr<const PeerCert>> chain_;
+  std::vector<std::shared_ptr<const PeerCert>> longerChain_;
+};
+
+TEST_F(CachingCertificateVerifierTest, VerifiedChainIsCached) {
+  CachingCertificateVerifier caching(verifier_, 10);
+  caching.verify(chain_);
+  caching.verify(chain_);
+  EXPECT_EQ(1, verifier_->verifications);
+  EXPECT_EQ(1, caching.size());
+
+  caching.verify(longerChain_);
+  EXPECT_EQ(2, verifier_->verifications);
+  EXPECT_EQ(2, caching.size());
+}
+
+TEST_F(CachingCertificateVerifierTest, FailureIsNotCached) {
+  CachingCertificateVerifier caching(verifier_, 10);
+  verifier_->fail = true;
+  EXPECT_THROW(caching.verify(chain_), std::runtime_error);
+  EXPECT_THROW(caching.verify(chain_), std::runtime_error);
+  EXPECT_EQ(2, verifier_->verifications);
+  EXPECT_EQ(0, caching.size());
+}
+
+TEST_F(CachingCertificateVerifierTest, ExpiredChainIsVerifiedAgain) {
+  CachingCertificateVerifier caching(verifier_, 10, 0s);
+  caching.verify(chain_);
+  verifier_->fail = true;
+  EXPECT_THROW(caching.verify(chain_), std::runtime_error);
+  EXPECT_EQ(2, verifier_->verifications);
+}
+
+TEST_F(CachingCertificateVerifierTest, ChainHash) {
+  auto hash = certChainHash(chain_);
+  ASSERT_TRUE(hash.hasValue());
+  EXPECT_EQ(Sha256::HashLen, hash->size());
+  EXPECT_EQ(hash, certChainHash(chain_));
+  EXPECT_NE(hash, certChainHash(longerChain_));
+  EXPECT_FALSE(certChainHash({}).hasValue());
+}
+
+} // namespace test
+} // namespace quic
@@ -89,6 +89,15 @@ void processServerInitialParams(
   auto activeConnectionIdLimit = getIntegerParameter(
       TransportParameterId::active_connection_id_limit,
       serverParams.parameters);
+  auto minAckDelay = getIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      serverParams.parameters);
+  auto maxDatagramFrameSize = getIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      serverParams.parameters);
+  auto streamRepairReceiveWindow = getIntegerParameter(
+      static_cast<TransportParameterId>(kStreamRepairReceiveWindowParameterId),
+      serverParams.parameters);
 
   if (!packetSize || *packetSize == 0) {
     packetSize = kDefaultMaxUDPPayload;
@@ -131,10 +140,11 @@ void processServerInitialParams(
   }
   conn.peerAckDelayExponent =
       ackDelayExponent.value_or(kDefaultAckDelayExponent);
-  // TODO: udpSendPacketLen should also be limited by PMTU
   if (conn.transportSettings.canIgnorePathMTU) {
     conn.udpSendPacketLen =
         std::min<uint64_t>(*packetSize, kDefaultMaxUDPPayload);
+  } else {
+    startPmtuDiscovery(conn, *packetSize);
   }
 
   // Currently no-op for a client; it doesn't issue connection ids
@@ -149,6 +159,15 @@ void processServerInitialParams(
   VLOG(10) << "conn.partialReliabilityEnabled="
            << conn.partialReliabilityEnabled;
 
+  if (minAckDelay && conn.transportSettings.ackFrequencyEnabled) {
+    conn.ackFrequencyState.peerMinAckDelay =
+        std::chrono::microseconds(*minAckDelay);
+  }
+
+  conn.datagramState.maxWriteFrameSize = maxDatagramFrameSize.value_or(0);
+  conn.streamRepairState.peerReceiveWindow =
+      streamRepairReceiveWindow.value_or(0);
+
   conn.statelessResetToken = std::move(statelessResetToken);
   // Update the existing streams, because we allow streams to be created before
   // the connection is established.
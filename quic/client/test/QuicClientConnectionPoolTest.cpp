@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/QuicClientConnectionPool.h>
+
+#include <folly/io/async/test/MockAsyncUDPSocket.h>
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+#include <quic/client/handshake/FizzClientQuicHandshakeContext.h>
+#include <quic/client/handshake/test/MockQuicPskCache.h>
+#include <quic/common/test/TestUtils.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class QuicClientConnectionPoolTest : public Test {
+ public:
+  void SetUp() override {
+    pskCache_ = std::make_shared<NiceMock<MockQuicPskCache>>();
+    ON_CALL(*pskCache_, getPsk(_)).WillByDefault(Return(folly::none));
+    pool_ = std::make_unique<QuicClientConnectionPool>(
+        &evb_,
+        [this](folly::EventBase* evb, const QuicConnectionPoolKey&) {
+          return createClient(evb);
+        },
+        pskCache_);
+  }
+
+  void TearDown() override {
+    pool_.reset();
+  }
+
+ protected:
+  std::shared_ptr<QuicClientTransport> createClient(folly::EventBase* evb) {
+    numClientsCreated_++;
+    auto socket =
+        std::make_unique<NiceMock<folly::test::MockAsyncUDPSocket>>(evb);
+    ON_CALL(*socket, address()).WillByDefault(ReturnRef(serverAddr_));
+    auto fizzClientContext =
+        FizzClientQuicHandshakeContext::Builder()
+            .setCertificateVerifier(createTestCertificateVerifier())
+            .build();
+    auto client = QuicClientTransport::newClient(
+        evb, std::move(socket), std::move(fizzClientContext));
+    client->addNewPeerAddress(serverAddr_);
+    return client;
+  }
+
+  folly::EventBase evb_;
+  folly::SocketAddress serverAddr_{"127.0.0.1", 443};
+  std::shared_ptr<NiceMock<MockQuicPskCache>> pskCache_;
+  std::unique_ptr<QuicClientConnectionPool> pool_;
+  size_t numClientsCreated_{0};
+};
+
+TEST_F(QuicClientConnectionPoolTest, ReusesConnectionForSameKey) {
+  QuicConnectionPoolKey key{"example.com", 443, "h3"};
+  auto first = pool_->getConnection(key);
+  auto second = pool_->getConnection(key);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(numClientsCreated_, 1);
+  EXPECT_EQ(pool_->numConnections(), 1);
+}
+
+TEST_F(QuicClientConnectionPoolTest, ConnectionPerKey) {
+  auto first = pool_->getConnection({"example.com", 443, "h3"});
+  auto otherAlpn = pool_->getConnection({"example.com", 443, "hq"});
+  auto otherPort = pool_->getConnection({"example.com", 8443, "h3"});
+  EXPECT_NE(first, otherAlpn);
+  EXPECT_NE(first, otherPort);
+  EXPECT_NE(otherAlpn, otherPort);
+  EXPECT_EQ(numClientsCreated_, 3);
+  EXPECT_EQ(pool_->numConnections(), 3);
+}
+
+TEST_F(QuicClientConnectionPoolTest, PrewarmOnlyWithPsk) {
+  QuicConnectionPoolKey key{"example.com", 443, "h3"};
+  EXPECT_FALSE(pool_->prewarm(key));
+  EXPECT_EQ(pool_->numConnections(), 0);
+
+  EXPECT_CALL(*pskCache_, getPsk("example.com"))
+      .WillRepeatedly(Return(QuicCachedPsk()));
+  EXPECT_TRUE(pool_->prewarm(key));
+  EXPECT_EQ(pool_->numConnections(), 1);
+  // There is one already
+  EXPECT_FALSE(pool_->prewarm(key));
+
+  pool_->getConnection(key);
+  EXPECT_EQ(numClientsCreated_, 1);
+}
+
+TEST_F(QuicClientConnectionPoolTest, ClosedConnectionIsReplaced) {
+  QuicConnectionPoolKey key{"example.com", 443, "h3"};
+  auto first = pool_->getConnection(key);
+  first->closeNow(folly::none);
+  EXPECT_EQ(pool_->numConnections(), 0);
+
+  auto second = pool_->getConnection(key);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(numClientsCreated_, 2);
+  EXPECT_EQ(pool_->numConnections(), 1);
+}
+
+} // namespace test
+} // namespace quic
@@ -1126,9 +1126,10 @@ class FakeOneRttHandshakeLayer : public ClientHandshake {
   void connect(
       folly::Optional<std::string>,
       folly::Optional<fizz::client::CachedPsk>,
-      std::shared_ptr<ClientTransportParametersExtension>,
+      std::shared_ptr<ClientTransportParametersExtension> transportParams,
       HandshakeCallback* callback) override {
     connected_ = true;
+    clientParams = std::move(transportParams);
     writeDataToQuicStream(
         conn_->cryptoState->initialStream, IOBuf::copyBuffer("CHLO"));
     createServerTransportParameters();
@@ -1259,6 +1260,7 @@ class FakeOneRttHandshakeLayer : public ClientHandshake {
   }
 
   std::unique_ptr<folly::IOBuf> writeBuf;
+  std::shared_ptr<ClientTransportParametersExtension> clientParams;
 
   bool connected_{false};
   QuicVersion negotiatedVersion{QuicVersion::MVFST};
@@ -1770,6 +1772,23 @@ TEST_F(QuicClientTransportTest, CustomTransportParam) {
   client->closeNow(folly::none);
 }
 
+TEST_F(QuicClientTransportTest, AckFrequencyAdvertisesMinAckDelay) {
+  TransportSettings settings;
+  settings.ackFrequencyEnabled = true;
+  client->setTransportSettings(settings);
+  client->addNewPeerAddress(serverAddr);
+  setupCryptoLayer();
+  client->start(&clientConnCallback);
+
+  ASSERT_TRUE(mockClientHandshake->clientParams);
+  auto minAckDelay = getIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      mockClientHandshake->clientParams->customTransportParameters_);
+  ASSERT_TRUE(minAckDelay.has_value());
+  EXPECT_EQ(*minAckDelay, kMinAckDelay.count());
+  client->closeNow(folly::none);
+}
+
 TEST_F(QuicClientTransportTest, CloseSocketOnWriteError) {
   client->addNewPeerAddress(serverAddr);
   EXPECT_CALL(*sock, write(_, _)).WillOnce(SetErrnoAndReturn(EBADF, -1));
@@ -1822,10 +1841,26 @@ TEST_F(QuicClientTransportTest, onNetworkSwitchReplaceAfterHandshake) {
   EXPECT_CALL(*newSocketPtr, bind(_));
   EXPECT_CALL(*newSocketPtr, close());
 
+  client->setCongestionControllerFactory(
+      std::make_shared<DefaultCongestionControllerFactory>());
+  client->getNonConstConn().lossState.srtt = 100ms;
+  client->getNonConstConn().lossState.mrtt = 50ms;
+  auto congestionController = client->getConn().congestionController.get();
+
   client->setQLogger(mockQLogger);
   EXPECT_CALL(*mockQLogger, addConnectionMigrationUpdate(true));
   client->onNetworkSwitch(std::move(newSocket));
 
+  EXPECT_EQ(client->getConn().lossState.srtt, 0us);
+  EXPECT_EQ(client->getConn().lossState.mrtt, kDefaultMinRtt);
+  EXPECT_NE(client->getConn().congestionController.get(), nullptr);
+  EXPECT_NE(client->getConn().congestionController.get(), congestionController);
+  // A ping goes out on the new path without waiting for the application
+  EXPECT_TRUE(std::any_of(
+      client->getConn().pendingEvents.frames.begin(),
+      client->getConn().pendingEvents.frames.end(),
+      [](const auto& frame) { return frame.asPingFrame(); }));
+
   client->closeNow(folly::none);
 }
 
@@ -2725,6 +2760,153 @@ TEST_F(
   fatalWriteErrorOnBothAfterSecondStarts(serverAddrV4, serverAddrV6);
 }
 
+TEST_F(QuicClientTransportHappyEyeballsTest, ThirdAddressWinsOverSecondSocket) {
+  auto& conn = client->getConn();
+  SocketAddress secondServerAddrV4{"127.0.0.2", 443};
+  auto happyEyeballsCache = std::make_shared<BasicQuicHappyEyeballsCache>();
+  client->addNewPeerAddress(secondServerAddrV4);
+  client->setHostname("example.com");
+  client->setHappyEyeballsCache(happyEyeballsCache);
+
+  EXPECT_CALL(*sock, write(serverAddrV6, _))
+      .WillRepeatedly(Invoke(
+          [&](const SocketAddress&, const std::unique_ptr<folly::IOBuf>& buf) {
+            return buf->computeChainDataLength();
+          }));
+  EXPECT_CALL(*secondSock, write(_, _)).Times(0);
+  client->start(&clientConnCallback);
+  setConnectionIds();
+  EXPECT_EQ(conn.peerAddress, serverAddrV6);
+  EXPECT_EQ(conn.happyEyeballsState.secondPeerAddress, serverAddrV4);
+  EXPECT_EQ(conn.happyEyeballsState.pendingPeerAddresses.size(), 1);
+
+  // The second socket starts, the third address is due after it
+  client->happyEyeballsConnAttemptDelayTimeout().cancelTimeout();
+  client->happyEyeballsConnAttemptDelayTimeout().timeoutExpired();
+  EXPECT_TRUE(conn.happyEyeballsState.shouldWriteToSecondSocket);
+  EXPECT_TRUE(client->happyEyeballsConnAttemptDelayTimeout().isScheduled());
+
+  client->happyEyeballsConnAttemptDelayTimeout().cancelTimeout();
+  client->happyEyeballsConnAttemptDelayTimeout().timeoutExpired();
+  EXPECT_FALSE(client->happyEyeballsConnAttemptDelayTimeout().isScheduled());
+  EXPECT_TRUE(conn.happyEyeballsState.pendingPeerAddresses.empty());
+  ASSERT_EQ(conn.happyEyeballsState.secondSocketPeerAddresses.size(), 1);
+  EXPECT_EQ(
+      conn.happyEyeballsState.secondSocketPeerAddresses[0], secondServerAddrV4);
+  EXPECT_EQ(conn.happyEyeballsState.attempts, 3);
+
+  // Both addresses of the second family are written to over the second socket
+  EXPECT_CALL(*sock, write(serverAddrV6, _));
+  EXPECT_CALL(*secondSock, write(serverAddrV4, _));
+  EXPECT_CALL(*secondSock, write(secondServerAddrV4, _));
+  client->lossTimeout().cancelTimeout();
+  client->lossTimeout().timeoutExpired();
+
+  EXPECT_CALL(clientConnCallback, onTransportReady());
+  EXPECT_CALL(clientConnCallback, onReplaySafe());
+  EXPECT_CALL(*sock, write(_, _)).Times(0);
+  EXPECT_CALL(*sock, pauseRead());
+  EXPECT_CALL(*sock, close());
+  EXPECT_CALL(*secondSock, write(secondServerAddrV4, _))
+      .Times(AtLeast(1))
+      .WillRepeatedly(Invoke([&](const SocketAddress&,
+                                 const std::unique_ptr<folly::IOBuf>& buf) {
+        socketWrites.push_back(buf->clone());
+        return buf->computeChainDataLength();
+      }));
+  EXPECT_CALL(*secondSock, write(serverAddrV4, _)).Times(0);
+  performFakeHandshake(secondServerAddrV4);
+  EXPECT_TRUE(conn.happyEyeballsState.finished);
+  EXPECT_EQ(conn.peerAddress, secondServerAddrV4);
+  EXPECT_TRUE(conn.happyEyeballsState.firstSocketPeerAddresses.empty());
+  EXPECT_TRUE(conn.happyEyeballsState.secondSocketPeerAddresses.empty());
+  auto transportInfo = client->getTransportInfo();
+  EXPECT_EQ(transportInfo.happyEyeballsAttempts, 3);
+  EXPECT_TRUE(transportInfo.happyEyeballsSecondSocketWon);
+
+  auto winner = happyEyeballsCache->getWinner("example.com");
+  ASSERT_TRUE(winner.hasValue());
+  EXPECT_EQ(winner->peerAddress, secondServerAddrV4);
+}
+
+TEST_F(QuicClientTransportHappyEyeballsTest, ConnectedSocketAfterRace) {
+  auto& conn = client->getConn();
+  auto settings = client->getTransportSettings();
+  settings.connectUDP = true;
+  client->setTransportSettings(settings);
+  SocketAddress secondServerAddrV6{"::2", 443};
+  client->addNewPeerAddress(secondServerAddrV6);
+
+  EXPECT_CALL(*sock, connect(_)).Times(0);
+  EXPECT_CALL(*secondSock, connect(_)).Times(0);
+  EXPECT_CALL(*sock, write(serverAddrV6, _))
+      .WillRepeatedly(Invoke(
+          [&](const SocketAddress&, const std::unique_ptr<folly::IOBuf>& buf) {
+            return buf->computeChainDataLength();
+          }));
+  client->start(&clientConnCallback);
+  setConnectionIds();
+  // The addresses are still raced
+  EXPECT_EQ(conn.happyEyeballsState.pendingPeerAddresses.size(), 1);
+
+  EXPECT_CALL(clientConnCallback, onTransportReady());
+  EXPECT_CALL(clientConnCallback, onReplaySafe());
+  EXPECT_CALL(*sock, connect(serverAddrV6));
+  EXPECT_CALL(*secondSock, pauseRead());
+  EXPECT_CALL(*secondSock, close());
+  performFakeHandshake(serverAddrV6);
+  EXPECT_TRUE(conn.happyEyeballsState.finished);
+  EXPECT_EQ(conn.peerAddress, serverAddrV6);
+}
+
+TEST_F(QuicClientTransportHappyEyeballsTest, CachedWinnerAttemptedFirst) {
+  auto& conn = client->getConn();
+  auto happyEyeballsCache = std::make_shared<BasicQuicHappyEyeballsCache>();
+  happyEyeballsCache->putWinner(
+      "example.com",
+      CachedHappyEyeballsWinner{
+          serverAddrV4, std::chrono::system_clock::now()});
+  client->setHostname("example.com");
+  client->setHappyEyeballsCache(happyEyeballsCache);
+
+  EXPECT_CALL(*sock, write(serverAddrV4, _))
+      .WillRepeatedly(Invoke([&](const SocketAddress&,
+                                 const std::unique_ptr<folly::IOBuf>& buf) {
+        socketWrites.push_back(buf->clone());
+        return buf->computeChainDataLength();
+      }));
+  EXPECT_CALL(*secondSock, write(_, _)).Times(0);
+  client->start(&clientConnCallback);
+  setConnectionIds();
+  EXPECT_EQ(conn.peerAddress, serverAddrV4);
+  EXPECT_EQ(conn.happyEyeballsState.secondPeerAddress, serverAddrV6);
+  EXPECT_TRUE(client->happyEyeballsConnAttemptDelayTimeout().isScheduled());
+  EXPECT_GT(
+      client->happyEyeballsConnAttemptDelayTimeout().getTimeRemaining(),
+      kHappyEyeballsV4Delay);
+}
+
+TEST_F(QuicClientTransportHappyEyeballsTest, ExpiredCachedWinnerIsRaced) {
+  auto& conn = client->getConn();
+  auto happyEyeballsCache = std::make_shared<BasicQuicHappyEyeballsCache>();
+  happyEyeballsCache->putWinner(
+      "example.com",
+      CachedHappyEyeballsWinner{
+          serverAddrV4,
+          std::chrono::system_clock::now() - kHappyEyeballsCacheMaxAge - 1s});
+  client->setHostname("example.com");
+  client->setHappyEyeballsCache(happyEyeballsCache);
+
+  EXPECT_CALL(*sock, write(serverAddrV6, _))
+      .WillRepeatedly(Invoke(
+          [&](const SocketAddress&, const std::unique_ptr<folly::IOBuf>& buf) {
+            return buf->computeChainDataLength();
+          }));
+  client->start(&clientConnCallback);
+  EXPECT_EQ(conn.peerAddress, serverAddrV6);
+  EXPECT_FALSE(happyEyeballsCache->getWinner("example.com").hasValue());
+}
+
 class QuicClientTransportAfterStartTestBase : public QuicClientTransportTest {
  public:
   void SetUpChild() override {
@@ -3337,12 +3519,14 @@ TEST_F(QuicClientTransportAfterStartTest, CloseConnectionWithStreamPending) {
   ASSERT_FALSE(client->getConn().outstandingPackets.empty());
 
   AckBlocks acks;
-  auto start = getFirstOutstandingPacket(
-                   client->getNonConstConn(), PacketNumberSpace::AppData)
-                   ->packet.header.getPacketSequenceNum();
-  auto end = getLastOutstandingPacket(
-                 client->getNonConstConn(), PacketNumberSpace::AppData)
-                 ->packet.header.getPacketSequenceNum();
+  auto start = client->getNonConstConn()
+                   .outstandingPackets[PacketNumberSpace::AppData]
+                   .front()
+                   .packet.header.getPacketSequenceNum();
+  auto end = client->getNonConstConn()
+                 .outstandingPackets[PacketNumberSpace::AppData]
+                 .back()
+                 .packet.header.getPacketSequenceNum();
   acks.insert(start, end);
 
   auto ackPacket = packetToBuf(createAckPacket(
@@ -3412,12 +3596,14 @@ TEST_F(QuicClientTransportAfterStartTest, CloseConnectionWithNoStreamPending) {
   ASSERT_FALSE(client->getConn().outstandingPackets.empty());
 
   AckBlocks acks;
-  auto start = getFirstOutstandingPacket(
-                   client->getNonConstConn(), PacketNumberSpace::AppData)
-                   ->packet.header.getPacketSequenceNum();
-  auto end = getLastOutstandingPacket(
-                 client->getNonConstConn(), PacketNumberSpace::AppData)
-                 ->packet.header.getPacketSequenceNum();
+  auto start = client->getNonConstConn()
+                   .outstandingPackets[PacketNumberSpace::AppData]
+                   .front()
+                   .packet.header.getPacketSequenceNum();
+  auto end = client->getNonConstConn()
+                 .outstandingPackets[PacketNumberSpace::AppData]
+                 .back()
+                 .packet.header.getPacketSequenceNum();
   acks.insert(start, end);
 
   auto ackPacket = packetToBuf(createAckPacket(
@@ -3541,12 +3727,14 @@ TEST_F(QuicClientTransportAfterStartTest, RecvAckOfCryptoStream) {
   // handshake
   {
     AckBlocks acks;
-    auto start = getFirstOutstandingPacket(
-                     client->getNonConstConn(), PacketNumberSpace::Handshake)
-                     ->packet.header.getPacketSequenceNum();
-    auto end = getLastOutstandingPacket(
-                   client->getNonConstConn(), PacketNumberSpace::Handshake)
-                   ->packet.header.getPacketSequenceNum();
+    auto start = client->getNonConstConn()
+                     .outstandingPackets[PacketNumberSpace::Handshake]
+                     .front()
+                     .packet.header.getPacketSequenceNum();
+    auto end = client->getNonConstConn()
+                   .outstandingPackets[PacketNumberSpace::Handshake]
+                   .back()
+                   .packet.header.getPacketSequenceNum();
     acks.insert(start, end);
     auto pn = handshakePacketNum++;
     auto ackPkt = createAckPacket(
@@ -3754,7 +3942,8 @@ TEST_F(QuicClientTransportAfterStartTest, IdleTimerNotResetOnWritingOldData) {
 TEST_F(QuicClientTransportAfterStartTest, IdleTimerResetNoOutstandingPackets) {
   // This will clear out all the outstanding packets
   AckBlocks sentPackets;
-  for (auto& packet : client->getNonConstConn().outstandingPackets) {
+  for (auto& packet : client->getNonConstConn()
+                          .outstandingPackets[PacketNumberSpace::AppData]) {
     auto packetNum = packet.packet.header.getPacketSequenceNum();
     sentPackets.insert(packetNum);
   }
@@ -5071,7 +5260,8 @@ class QuicZeroRttClientTest : public QuicClientTransportAfterStartTestBase {
   }
 
   bool zeroRttPacketsOutstanding() {
-    for (auto& packet : client->getNonConstConn().outstandingPackets) {
+    for (auto& packet : client->getNonConstConn()
+                            .outstandingPackets[PacketNumberSpace::AppData]) {
       bool isZeroRtt =
           packet.packet.header.getProtectionType() == ProtectionType::ZeroRtt;
       if (isZeroRtt) {
@@ -5121,13 +5311,26 @@ TEST_F(QuicZeroRttClientTest, TestReplaySafeCallback) {
   socketWrites.clear();
   auto streamId = client->createBidirectionalStream().value();
   client->writeChain(streamId, IOBuf::copyBuffer("hello"), true, false);
+  auto heldStreamId =
+      client->createBidirectionalStream(false /* replaySafe */).value();
+  client->writeChain(heldStreamId, IOBuf::copyBuffer("world"), true, false);
   loopForWrites();
   EXPECT_TRUE(zeroRttPacketsOutstanding());
   assertWritten(false, LongHeader::Types::ZeroRtt);
+  auto heldStream = client->getConn().streamManager->findStream(heldStreamId);
+  EXPECT_EQ(heldStream->currentWriteOffset, 0);
+  auto transportInfo = client->getTransportInfo();
+  EXPECT_TRUE(transportInfo.zeroRttAttempted);
+  EXPECT_FALSE(transportInfo.zeroRttAccepted.has_value());
+  EXPECT_GT(transportInfo.zeroRttPacketsSent, 0);
   EXPECT_CALL(clientConnCallback, onReplaySafe());
   recvServerHello();
 
   EXPECT_NE(client->getConn().zeroRttWriteCipher, nullptr);
+  EXPECT_EQ(client->getTransportInfo().zeroRttAccepted, true);
+  // The stream that was not replay safe goes out in 1-RTT.
+  loopForWrites();
+  EXPECT_GT(heldStream->currentWriteOffset, 0);
 
   // All the data is still there.
   EXPECT_TRUE(zeroRttPacketsOutstanding());
@@ -5156,6 +5359,51 @@ TEST_F(QuicZeroRttClientTest, TestReplaySafeCallback) {
   mockClientHandshake->triggerOnNewCachedPsk();
 }
 
+TEST_F(QuicZeroRttClientTest, TestCarefulResumeFromPsk) {
+  auto settings = client->getTransportSettings();
+  settings.carefulResume = true;
+  client->setTransportSettings(settings);
+  EXPECT_CALL(*mockQuicPskCache_, getPsk(hostname_))
+      .WillRepeatedly(InvokeWithoutArgs([]() {
+        QuicCachedPsk quicCachedPsk;
+        quicCachedPsk.transportParams.negotiatedVersion = QuicVersion::MVFST;
+        quicCachedPsk.transportParams.initialMaxStreamDataBidiLocal =
+            kDefaultStreamWindowSize;
+        quicCachedPsk.transportParams.initialMaxStreamDataBidiRemote =
+            kDefaultStreamWindowSize;
+        quicCachedPsk.transportParams.initialMaxStreamDataUni =
+            kDefaultStreamWindowSize;
+        quicCachedPsk.transportParams.initialMaxData =
+            kDefaultConnectionWindowSize;
+        quicCachedPsk.transportParams.idleTimeout = kDefaultIdleTimeout.count();
+        quicCachedPsk.transportParams.maxRecvPacketSize =
+            kDefaultUDPReadBufferSize;
+        quicCachedPsk.transportParams.initialMaxStreamsBidi =
+            std::numeric_limits<uint32_t>::max();
+        quicCachedPsk.transportParams.initialMaxStreamsUni =
+            std::numeric_limits<uint32_t>::max();
+        CachedCongestionState state;
+        state.cwndBytes = 200000;
+        state.minRtt = 50ms;
+        state.recordTime = std::chrono::system_clock::now();
+        quicCachedPsk.congestionState = state;
+        return quicCachedPsk;
+      }));
+  client->setEarlyDataAppParamsFunctions(
+      [](const folly::Optional<std::string>&, const Buf&) { return true; },
+      []() -> Buf { return nullptr; });
+  startClient();
+
+  const auto& conn = client->getConn();
+  ASSERT_TRUE(conn.carefulResume.has_value());
+  EXPECT_EQ(100000, conn.carefulResume->jumpCwndBytes);
+  EXPECT_EQ(50ms, conn.carefulResume->savedRtt);
+  // The 0-RTT flight still goes at the initial cwnd.
+  EXPECT_EQ(
+      conn.transportSettings.initCwndInMss * conn.udpSendPacketLen,
+      conn.congestionController->getCongestionWindow());
+}
+
 TEST_F(QuicZeroRttClientTest, TestZeroRttRejection) {
   EXPECT_CALL(*mockQuicPskCache_, getPsk(hostname_))
       .WillOnce(InvokeWithoutArgs([]() {
@@ -5206,6 +5454,10 @@ TEST_F(QuicZeroRttClientTest, TestZeroRttRejection) {
   // Zero rtt data is declared lost.
   EXPECT_FALSE(zeroRttPacketsOutstanding());
   EXPECT_EQ(client->getConn().zeroRttWriteCipher, nullptr);
+  auto transportInfo = client->getTransportInfo();
+  EXPECT_TRUE(transportInfo.zeroRttAttempted);
+  EXPECT_EQ(transportInfo.zeroRttAccepted, false);
+  EXPECT_GT(transportInfo.zeroRttPacketsSent, 0);
 }
 
 TEST_F(QuicZeroRttClientTest, TestZeroRttRejectionWithSmallerFlowControl) {
@@ -75,11 +75,20 @@ PingFrame decodePingFrame(folly::io::Cursor&) {
   return PingFrame();
 }
 
-ReadAckFrame decodeAckFrame(
+namespace {
+
+struct AckFrameHeader {
+  PacketNum largestAcked;
+  std::chrono::microseconds ackDelay;
+  uint64_t additionalAckBlocks;
+  // Start of the first ack block, which ends at largestAcked.
+  PacketNum firstBlockStart;
+};
+
+AckFrameHeader decodeAckFrameHeader(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params) {
-  ReadAckFrame frame;
   auto largestAckedInt = decodeQuicInteger(cursor);
   if (!largestAckedInt) {
     throw QuicTransportException(
@@ -137,44 +146,119 @@ ReadAckFrame decodeAckFrame(
         quic::TransportErrorCode::FRAME_ENCODING_ERROR,
         quic::FrameType::ACK);
   }
-  PacketNum currentPacketNum =
+  AckFrameHeader frameHeader;
+  frameHeader.largestAcked = largestAcked;
+  frameHeader.ackDelay = std::chrono::microseconds(adjustedAckDelay);
+  frameHeader.additionalAckBlocks = additionalAckBlocks->first;
+  frameHeader.firstBlockStart =
       nextAckedPacketLen(largestAcked, firstAckBlockLen->first);
-  frame.largestAcked = largestAcked;
-  frame.ackDelay = std::chrono::microseconds(adjustedAckDelay);
-  frame.ackBlocks.emplace_back(currentPacketNum, largestAcked);
-  for (uint64_t numBlocks = 0; numBlocks < additionalAckBlocks->first;
+  return frameHeader;
+}
+
+/**
+ * Decodes the ack block that follows the block starting at currentPacketNum
+ * and moves currentPacketNum to the start of the decoded block.
+ */
+AckBlock decodeNextAckBlock(
+    folly::io::Cursor& cursor,
+    PacketNum& currentPacketNum) {
+  auto currentGap = decodeQuicInteger(cursor);
+  if (!currentGap) {
+    throw QuicTransportException(
+        "Bad gap",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK);
+  }
+  auto blockLen = decodeQuicInteger(cursor);
+  if (!blockLen) {
+    throw QuicTransportException(
+        "Bad block len",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK);
+  }
+  PacketNum nextEndPacket =
+      nextAckedPacketGap(currentPacketNum, currentGap->first);
+  currentPacketNum = nextAckedPacketLen(nextEndPacket, blockLen->first);
+  return AckBlock(currentPacketNum, nextEndPacket);
+}
+
+} // namespace
+
+ReadAckFrame decodeAckFrame(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params) {
+  ReadAckFrame frame;
+  auto frameHeader = decodeAckFrameHeader(cursor, header, params);
+  frame.largestAcked = frameHeader.largestAcked;
+  frame.ackDelay = frameHeader.ackDelay;
+  frame.ackBlocks.emplace_back(
+      frameHeader.firstBlockStart, frameHeader.largestAcked);
+  PacketNum currentPacketNum = frameHeader.firstBlockStart;
+  for (uint64_t numBlocks = 0; numBlocks < frameHeader.additionalAckBlocks;
        ++numBlocks) {
-    auto currentGap = decodeQuicInteger(cursor);
-    if (!currentGap) {
-      throw QuicTransportException(
-          "Bad gap",
-          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
-          quic::FrameType::ACK);
-    }
-    auto blockLen = decodeQuicInteger(cursor);
-    if (!blockLen) {
+    // We don't need to add the entry when the block length is zero since we
+    // already would have processed it in the previous iteration.
+    frame.ackBlocks.push_back(decodeNextAckBlock(cursor, currentPacketNum));
+  }
+  return frame;
+}
+
+AckFrameView::AckFrameView(
+    PacketNum largestAcked,
+    std::chrono::microseconds ackDelay,
+    PacketNum firstBlockStart,
+    uint64_t additionalAckBlocks,
+    folly::io::Cursor blocks)
+    : blocks_(std::move(blocks)),
+      largestAcked_(largestAcked),
+      ackDelay_(ackDelay),
+      currentPacketNum_(firstBlockStart),
+      blocksLeft_(additionalAckBlocks) {}
+
+folly::Optional<AckBlock> AckFrameView::nextBlock() {
+  if (!firstBlockReturned_) {
+    firstBlockReturned_ = true;
+    return AckBlock(currentPacketNum_, largestAcked_);
+  }
+  if (blocksLeft_ == 0) {
+    return folly::none;
+  }
+  --blocksLeft_;
+  return decodeNextAckBlock(blocks_, currentPacketNum_);
+}
+
+AckFrameView decodeAckFrameView(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params) {
+  auto frameHeader = decodeAckFrameHeader(cursor, header, params);
+  folly::io::Cursor blocks = cursor;
+  // Only the encoding of the blocks is checked here, to find the end of the
+  // frame. Their values are checked as the view decodes them.
+  for (uint64_t numBlocks = 0; numBlocks < frameHeader.additionalAckBlocks;
+       ++numBlocks) {
+    // Gap and block length.
+    if (!decodeQuicInteger(cursor) || !decodeQuicInteger(cursor)) {
       throw QuicTransportException(
-          "Bad block len",
+          "Bad ack block",
           quic::TransportErrorCode::FRAME_ENCODING_ERROR,
           quic::FrameType::ACK);
     }
-    PacketNum nextEndPacket =
-        nextAckedPacketGap(currentPacketNum, currentGap->first);
-    currentPacketNum = nextAckedPacketLen(nextEndPacket, blockLen->first);
-    // We don't need to add the entry when the block length is zero since we
-    // already would have processed it in the previous iteration.
-    frame.ackBlocks.emplace_back(currentPacketNum, nextEndPacket);
   }
-  return frame;
+  return AckFrameView(
+      frameHeader.largestAcked,
+      frameHeader.ackDelay,
+      frameHeader.firstBlockStart,
+      frameHeader.additionalAckBlocks,
+      std::move(blocks));
 }
 
 ReadAckFrame decodeAckFrameWithECN(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params) {
-  // TODO this is incomplete
   auto readAckFrame = decodeAckFrame(cursor, header, params);
-  // TODO we simply ignore ECN blocks in ACK-ECN frames for now.
   auto ect_0 = decodeQuicInteger(cursor);
   if (!ect_0) {
     throw QuicTransportException(
@@ -196,6 +280,10 @@ ReadAckFrame decodeAckFrameWithECN(
         quic::TransportErrorCode::FRAME_ENCODING_ERROR,
         quic::FrameType::ACK_ECN);
   }
+  readAckFrame.ecnCounts.emplace();
+  readAckFrame.ecnCounts->ect0 = ect_0->first;
+  readAckFrame.ecnCounts->ect1 = ect_1->first;
+  readAckFrame.ecnCounts->ce = ect_ce->first;
   return readAckFrame;
 }
 
@@ -312,10 +400,19 @@ ReadNewTokenFrame decodeNewTokenFrame(folly::io::Cursor& cursor) {
   return ReadNewTokenFrame(std::move(token));
 }
 
-ReadStreamFrame decodeStreamFrame(
-    BufQueue& queue,
+namespace {
+
+struct StreamFrameHeader {
+  StreamId streamId;
+  uint64_t offset{0};
+  bool fin{false};
+  folly::Optional<uint64_t> dataLength;
+};
+
+StreamFrameHeader decodeStreamFrameHeader(
+    folly::io::Cursor& cursor,
     StreamTypeField frameTypeField) {
-  folly::io::Cursor cursor(queue.front());
+  StreamFrameHeader frameHeader;
   auto streamId = decodeQuicInteger(cursor);
   if (!streamId) {
     throw QuicTransportException(
@@ -323,7 +420,7 @@ ReadStreamFrame decodeStreamFrame(
         quic::TransportErrorCode::FRAME_ENCODING_ERROR,
         quic::FrameType::STREAM);
   }
-  uint64_t offset = 0;
+  frameHeader.streamId = folly::to<StreamId>(streamId->first);
   if (frameTypeField.hasOffset()) {
     auto optionalOffset = decodeQuicInteger(cursor);
     if (!optionalOffset) {
@@ -332,38 +429,66 @@ ReadStreamFrame decodeStreamFrame(
           quic::TransportErrorCode::FRAME_ENCODING_ERROR,
           quic::FrameType::STREAM);
     }
-    offset = optionalOffset->first;
+    frameHeader.offset = optionalOffset->first;
   }
-  auto fin = frameTypeField.hasFin();
-  folly::Optional<std::pair<uint64_t, size_t>> dataLength;
+  frameHeader.fin = frameTypeField.hasFin();
   if (frameTypeField.hasDataLength()) {
-    dataLength = decodeQuicInteger(cursor);
+    auto dataLength = decodeQuicInteger(cursor);
     if (!dataLength) {
       throw QuicTransportException(
           "Invalid length",
           quic::TransportErrorCode::FRAME_ENCODING_ERROR,
           quic::FrameType::STREAM);
     }
-  }
-  Buf data;
-  if (dataLength.has_value()) {
     if (cursor.totalLength() < dataLength->first) {
       throw QuicTransportException(
           "Length mismatch",
           quic::TransportErrorCode::FRAME_ENCODING_ERROR,
           quic::FrameType::STREAM);
     }
-    // If dataLength > data's actual length then the cursor will throw.
-    queue.trimStart(cursor - queue.front());
-    data = queue.splitAtMost(dataLength->first);
+    frameHeader.dataLength = dataLength->first;
+  }
+  return frameHeader;
+}
+
+} // namespace
+
+ReadStreamFrame decodeStreamFrame(
+    BufQueue& queue,
+    StreamTypeField frameTypeField) {
+  folly::io::Cursor cursor(queue.front());
+  auto frameHeader = decodeStreamFrameHeader(cursor, frameTypeField);
+  queue.trimStart(cursor - queue.front());
+  Buf data;
+  if (frameHeader.dataLength.has_value()) {
+    data = queue.splitAtMost(*frameHeader.dataLength);
   } else {
     // Missing Data Length field doesn't mean no data. It means the rest of the
     // frame are all data.
-    queue.trimStart(cursor - queue.front());
     data = queue.move();
   }
   return ReadStreamFrame(
-      folly::to<StreamId>(streamId->first), offset, std::move(data), fin);
+      frameHeader.streamId,
+      frameHeader.offset,
+      std::move(data),
+      frameHeader.fin);
+}
+
+ReadStreamFrame decodeStreamFrame(
+    folly::io::Cursor& cursor,
+    StreamTypeField frameTypeField) {
+  auto frameHeader = decodeStreamFrameHeader(cursor, frameTypeField);
+  Buf data;
+  // The data is cloned out of the packet buffer rather than copied.
+  cursor.clone(
+      data,
+      frameHeader.dataLength ? *frameHeader.dataLength
+                             : cursor.totalLength());
+  return ReadStreamFrame(
+      frameHeader.streamId,
+      frameHeader.offset,
+      std::move(data),
+      frameHeader.fin);
 }
 
 MaxDataFrame decodeMaxDataFrame(folly::io::Cursor& cursor) {
@@ -682,11 +807,145 @@ HandshakeDoneFrame decodeHandshakeDoneFrame(folly::io::Cursor& /*cursor*/) {
   return HandshakeDoneFrame();
 }
 
-QuicFrame parseFrame(
-    BufQueue& queue,
-    const PacketHeader& header,
-    const CodecParameters& params) {
-  folly::io::Cursor cursor(queue.front());
+AckFrequencyFrame decodeAckFrequencyFrame(folly::io::Cursor& cursor) {
+  auto sequenceNumber = decodeQuicInteger(cursor);
+  if (!sequenceNumber) {
+    throw QuicTransportException(
+        "Invalid sequence number",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  auto packetTolerance = decodeQuicInteger(cursor);
+  if (!packetTolerance || packetTolerance->first == 0) {
+    throw QuicTransportException(
+        "Invalid packet tolerance",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  auto updateMaxAckDelay = decodeQuicInteger(cursor);
+  if (!updateMaxAckDelay) {
+    throw QuicTransportException(
+        "Invalid update max ack delay",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  if (!cursor.canAdvance(sizeof(uint8_t))) {
+    throw QuicTransportException(
+        "Not enough input bytes to read ignore order.",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  auto ignoreOrder = cursor.readBE<uint8_t>();
+  if (ignoreOrder > 1) {
+    throw QuicTransportException(
+        "Invalid ignore order",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  return AckFrequencyFrame(
+      sequenceNumber->first,
+      packetTolerance->first,
+      std::chrono::microseconds(updateMaxAckDelay->first),
+      ignoreOrder == 1);
+}
+
+ImmediateAckFrame decodeImmediateAckFrame(folly::io::Cursor& /*cursor*/) {
+  return ImmediateAckFrame();
+}
+
+StreamRepairFrame decodeStreamRepairFrame(folly::io::Cursor& cursor) {
+  auto streamId = decodeQuicInteger(cursor);
+  if (!streamId) {
+    throw QuicTransportException(
+        "Invalid stream id",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::STREAM_REPAIR);
+  }
+  if (!cursor.canAdvance(sizeof(uint8_t))) {
+    throw QuicTransportException(
+        "Not enough input bytes to read fin.",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::STREAM_REPAIR);
+  }
+  auto fin = cursor.readBE<uint8_t>();
+  if (fin > 1) {
+    throw QuicTransportException(
+        "Invalid fin",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::STREAM_REPAIR);
+  }
+  auto count = decodeQuicInteger(cursor);
+  if (!count || count->first == 0 || count->first > kMaxStreamRepairFrames) {
+    throw QuicTransportException(
+        "Invalid range count",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::STREAM_REPAIR);
+  }
+  std::vector<StreamRepairFrame::Range> ranges;
+  ranges.reserve(count->first);
+  uint64_t maxLength = 0;
+  for (uint64_t i = 0; i < count->first; ++i) {
+    auto offset = decodeQuicInteger(cursor);
+    auto length = decodeQuicInteger(cursor);
+    if (!offset || !length || length->first == 0 ||
+        (!ranges.empty() &&
+         offset->first < ranges.back().offset + ranges.back().length)) {
+      throw QuicTransportException(
+          "Invalid range",
+          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+          quic::FrameType::STREAM_REPAIR);
+    }
+    maxLength = std::max(maxLength, length->first);
+    ranges.push_back({offset->first, length->first});
+  }
+  auto repairLength = decodeQuicInteger(cursor);
+  if (!repairLength || repairLength->first != maxLength) {
+    throw QuicTransportException(
+        "Invalid repair length",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::STREAM_REPAIR);
+  }
+  if (cursor.totalLength() < repairLength->first) {
+    throw QuicTransportException(
+        "Repair length mismatch",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::STREAM_REPAIR);
+  }
+  Buf repair;
+  cursor.clone(repair, repairLength->first);
+  return StreamRepairFrame(
+      folly::to<StreamId>(streamId->first),
+      std::move(ranges),
+      fin == 1,
+      std::move(repair));
+}
+
+DatagramFrame decodeDatagramFrame(folly::io::Cursor& cursor, bool hasLength) {
+  size_t length = cursor.totalLength();
+  if (hasLength) {
+    auto dataLength = decodeQuicInteger(cursor);
+    if (!dataLength) {
+      throw QuicTransportException(
+          "Invalid datagram length",
+          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+          quic::FrameType::DATAGRAM_LEN);
+    }
+    if (cursor.totalLength() < dataLength->first) {
+      throw QuicTransportException(
+          "Datagram length mismatch",
+          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+          quic::FrameType::DATAGRAM_LEN);
+    }
+    length = dataLength->first;
+  }
+  Buf data;
+  cursor.clone(data, length);
+  return DatagramFrame(length, std::move(data));
+}
+
+namespace {
+
+uint64_t decodeFrameType(folly::io::Cursor& cursor) {
   if (!cursor.canAdvance(sizeof(FrameType))) {
     throw QuicTransportException(
         "Quic frame parsing: cursor cannot advance",
@@ -698,17 +957,25 @@ QuicFrame parseFrame(
     throw QuicTransportException(
         "Invalid frame-type field", TransportErrorCode::FRAME_ENCODING_ERROR);
   }
-  queue.trimStart(cursor - queue.front());
-  bool isStream = false;
-  bool error = false;
-  SCOPE_EXIT {
-    if (isStream || error) {
-      return;
-    }
-    queue.trimStart(cursor - queue.front());
-  };
-  cursor.reset(queue.front());
-  FrameType frameType = static_cast<FrameType>(initialByte->first);
+  return initialByte->first;
+}
+
+bool isStreamFrameType(uint64_t frameTypeValue) {
+  return frameTypeValue >= static_cast<uint64_t>(FrameType::STREAM) &&
+      frameTypeValue <= static_cast<uint64_t>(FrameType::STREAM_OFF_LEN_FIN);
+}
+
+/**
+ * Decodes the body of a frame whose type has already been read. Stream frames
+ * are decoded from the queue when one is given, from the cursor otherwise.
+ */
+QuicFrame decodeFrameBody(
+    folly::io::Cursor& cursor,
+    BufQueue* queue,
+    uint64_t frameTypeValue,
+    const PacketHeader& header,
+    const CodecParameters& params) {
+  FrameType frameType = static_cast<FrameType>(frameTypeValue);
   try {
     switch (frameType) {
       case FrameType::PADDING:
@@ -735,9 +1002,12 @@ QuicFrame parseFrame(
       case FrameType::STREAM_OFF_FIN:
       case FrameType::STREAM_OFF_LEN:
       case FrameType::STREAM_OFF_LEN_FIN:
-        isStream = true;
+        if (queue) {
+          return QuicFrame(
+              decodeStreamFrame(*queue, StreamTypeField(frameTypeValue)));
+        }
         return QuicFrame(
-            decodeStreamFrame(queue, StreamTypeField(initialByte->first)));
+            decodeStreamFrame(cursor, StreamTypeField(frameTypeValue)));
       case FrameType::MAX_DATA:
         return QuicFrame(decodeMaxDataFrame(cursor));
       case FrameType::MAX_STREAM_DATA:
@@ -772,22 +1042,65 @@ QuicFrame parseFrame(
         return QuicFrame(decodeExpiredStreamDataFrame(cursor));
       case FrameType::HANDSHAKE_DONE:
         return QuicFrame(decodeHandshakeDoneFrame(cursor));
+      case FrameType::IMMEDIATE_ACK:
+        return QuicFrame(decodeImmediateAckFrame(cursor));
+      case FrameType::ACK_FREQUENCY:
+        return QuicFrame(decodeAckFrequencyFrame(cursor));
+      case FrameType::STREAM_REPAIR:
+        return QuicFrame(decodeStreamRepairFrame(cursor));
+      case FrameType::DATAGRAM:
+        return QuicFrame(decodeDatagramFrame(cursor, false));
+      case FrameType::DATAGRAM_LEN:
+        return QuicFrame(decodeDatagramFrame(cursor, true));
     }
   } catch (const std::exception&) {
-    error = true;
     throw QuicTransportException(
         folly::to<std::string>(
-            "Frame format invalid, type=", initialByte->first),
+            "Frame format invalid, type=", frameTypeValue),
         TransportErrorCode::FRAME_ENCODING_ERROR,
         frameType);
   }
-  error = true;
   throw QuicTransportException(
-      folly::to<std::string>("Unknown frame, type=", initialByte->first),
+      folly::to<std::string>("Unknown frame, type=", frameTypeValue),
       TransportErrorCode::FRAME_ENCODING_ERROR,
       frameType);
 }
 
+
+} // namespace
+
+QuicFrame parseFrame(
+    BufQueue& queue,
+    const PacketHeader& header,
+    const CodecParameters& params) {
+  folly::io::Cursor cursor(queue.front());
+  auto frameTypeValue = decodeFrameType(cursor);
+  queue.trimStart(cursor - queue.front());
+  // Stream frames trim the queue themselves and errors leave it as is.
+  bool trimmed = isStreamFrameType(frameTypeValue);
+  SCOPE_EXIT {
+    if (trimmed) {
+      return;
+    }
+    queue.trimStart(cursor - queue.front());
+  };
+  cursor.reset(queue.front());
+  try {
+    return decodeFrameBody(cursor, &queue, frameTypeValue, header, params);
+  } catch (const std::exception&) {
+    trimmed = true;
+    throw;
+  }
+}
+
+QuicFrame parseFrame(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params) {
+  auto frameTypeValue = decodeFrameType(cursor);
+  return decodeFrameBody(cursor, nullptr, frameTypeValue, header, params);
+}
+
 // Parse packet
 
 RegularQuicPacket decodeRegularPacket(
@@ -795,6 +1108,15 @@ RegularQuicPacket decodeRegularPacket(
     const CodecParameters& params,
     std::unique_ptr<folly::IOBuf> packetData) {
   RegularQuicPacket packet(std::move(header));
+  if (!packetData->isChained()) {
+    // A decrypted packet is normally a single buffer, which a single cursor
+    // can walk frame by frame without trimming the buffer after each one.
+    folly::io::Cursor cursor(packetData.get());
+    while (!cursor.isAtEnd()) {
+      packet.frames.push_back(parseFrame(cursor, packet.header, params));
+    }
+    return packet;
+  }
   BufQueue queue;
   queue.append(std::move(packetData));
   while (queue.chainLength() > 0) {
@@ -1088,10 +1410,9 @@ parseShortHeaderInvariants(
   return ShortHeaderInvariant(std::move(connId));
 }
 
-folly::Expected<ShortHeader, TransportErrorCode> parseShortHeader(
-    uint8_t initialByte,
-    folly::io::Cursor& cursor,
-    size_t dstConnIdSize) {
+namespace {
+folly::Expected<ProtectionType, TransportErrorCode>
+parseShortHeaderInitialByte(uint8_t initialByte) {
   if (getHeaderForm(initialByte) != HeaderForm::Short) {
     VLOG(5) << "Bad header form bit";
     return folly::makeUnexpected(TransportErrorCode::FRAME_ENCODING_ERROR);
@@ -1106,16 +1427,37 @@ folly::Expected<ShortHeader, TransportErrorCode> parseShortHeader(
     // Specs asks this to be PROTOCOL_VIOLATION
     return folly::makeUnexpected(TransportErrorCode::PROTOCOL_VIOLATION);
   }
+  return initialByte & ShortHeader::kKeyPhaseMask
+      ? ProtectionType::KeyPhaseOne
+      : ProtectionType::KeyPhaseZero;
+}
+} // namespace
+
+folly::Expected<ShortHeader, TransportErrorCode> parseShortHeader(
+    uint8_t initialByte,
+    folly::io::Cursor& cursor,
+    size_t dstConnIdSize) {
+  auto protectionType = parseShortHeaderInitialByte(initialByte);
+  if (!protectionType) {
+    return folly::makeUnexpected(protectionType.error());
+  }
   auto invariant =
       parseShortHeaderInvariants(initialByte, cursor, dstConnIdSize);
   if (!invariant) {
     VLOG(5) << "Error parsing short header invariant";
     return folly::makeUnexpected(TransportErrorCode::FRAME_ENCODING_ERROR);
   }
-  auto protectionType = initialByte & ShortHeader::kKeyPhaseMask
-      ? ProtectionType::KeyPhaseOne
-      : ProtectionType::KeyPhaseZero;
-  return ShortHeader(protectionType, std::move(invariant->destinationConnId));
+  return ShortHeader(*protectionType, std::move(invariant->destinationConnId));
+}
+
+folly::Expected<ShortHeader, TransportErrorCode> parseShortHeader(
+    uint8_t initialByte,
+    const ConnectionId& dstConnId) {
+  auto protectionType = parseShortHeaderInitialByte(initialByte);
+  if (!protectionType) {
+    return folly::makeUnexpected(protectionType.error());
+  }
+  return ShortHeader(*protectionType, dstConnId);
 }
 
 } // namespace quic
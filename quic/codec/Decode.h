@@ -68,6 +68,16 @@ QuicFrame parseFrame(
     const PacketHeader& header,
     const CodecParameters& params);
 
+/**
+ * Parses a single frame at the cursor and advances it past the frame. Stream
+ * data is cloned from the underlying buffer. Throws a QuicException if the
+ * frame could not be parsed.
+ */
+QuicFrame parseFrame(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params);
+
 /**
  * The following functions decode frames. They throw an QuicException when error
  * occurs.
@@ -126,6 +136,53 @@ ReadAckFrame decodeAckFrame(
     const PacketHeader& header,
     const CodecParameters& params);
 
+/**
+ * Lazily decoded ACK frame. The fields ahead of the ack blocks are decoded
+ * up front, the ack blocks are decoded one at a time, in descending order,
+ * from the encoded bytes of the frame. The view does not own those bytes, the
+ * buffer it was decoded from has to outlive it.
+ */
+class AckFrameView {
+ public:
+  AckFrameView(
+      PacketNum largestAcked,
+      std::chrono::microseconds ackDelay,
+      PacketNum firstBlockStart,
+      uint64_t additionalAckBlocks,
+      folly::io::Cursor blocks);
+
+  PacketNum largestAcked() const {
+    return largestAcked_;
+  }
+
+  std::chrono::microseconds ackDelay() const {
+    return ackDelay_;
+  }
+
+  /**
+   * Returns the next ack block, or folly::none once every block was returned.
+   * Throws a QuicTransportException if the block is invalid.
+   */
+  folly::Optional<AckBlock> nextBlock();
+
+ private:
+  folly::io::Cursor blocks_;
+  PacketNum largestAcked_;
+  std::chrono::microseconds ackDelay_;
+  PacketNum currentPacketNum_;
+  uint64_t blocksLeft_;
+  bool firstBlockReturned_{false};
+};
+
+/**
+ * Decodes an ACK frame into an AckFrameView and advances the cursor past the
+ * frame. Only the encoding of the ack blocks is validated here.
+ */
+AckFrameView decodeAckFrameView(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params);
+
 ReadAckFrame decodeAckFrameWithECN(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
@@ -135,12 +192,31 @@ ReadStreamFrame decodeStreamFrame(
     BufQueue& queue,
     StreamTypeField frameTypeField);
 
+ReadStreamFrame decodeStreamFrame(
+    folly::io::Cursor& cursor,
+    StreamTypeField frameTypeField);
+
 ReadCryptoFrame decodeCryptoFrame(folly::io::Cursor& cursor);
 
 ReadNewTokenFrame decodeNewTokenFrame(folly::io::Cursor& cursor);
 
 HandshakeDoneFrame decodeHandshakeDoneFrame(folly::io::Cursor& cursor);
 
+AckFrequencyFrame decodeAckFrequencyFrame(folly::io::Cursor& cursor);
+
+ImmediateAckFrame decodeImmediateAckFrame(folly::io::Cursor& cursor);
+
+/**
+ * Decodes a STREAM_REPAIR frame. The repair symbol shares the packet buffer.
+ */
+StreamRepairFrame decodeStreamRepairFrame(folly::io::Cursor& cursor);
+
+/**
+ * Decodes a DATAGRAM frame, its payload being the rest of the packet when it
+ * has no length. The payload shares the packet buffer.
+ */
+DatagramFrame decodeDatagramFrame(folly::io::Cursor& cursor, bool hasLength);
+
 /**
  * Parse the Invariant fields in Long Header.
  *
@@ -214,4 +290,12 @@ folly::Expected<ShortHeader, TransportErrorCode> parseShortHeader(
     uint8_t initialByte,
     folly::io::Cursor& cursor,
     size_t dstConnIdSize = kDefaultConnectionIdSize);
+
+/**
+ * Parses a short header whose destination connection id the caller has
+ * already matched, so it doesn't have to be read out of the packet again.
+ */
+folly::Expected<ShortHeader, TransportErrorCode> parseShortHeader(
+    uint8_t initialByte,
+    const ConnectionId& dstConnId);
 } // namespace quic
@@ -36,7 +36,14 @@ void PacketNumberCipher::cipherHeader(
     folly::MutableByteRange packetNumberBytes,
     uint8_t initialByteMask,
     uint8_t /* packetNumLengthMask */) const {
-  HeaderProtectionMask headerMask = mask(sample);
+  applyCipherMask(mask(sample), initialByte, packetNumberBytes, initialByteMask);
+}
+
+void PacketNumberCipher::applyCipherMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes,
+    uint8_t initialByteMask) {
   // Mask size should be > packet number length + 1.
   DCHECK_GE(headerMask.size(), kMaxPacketNumEncodingSize + 1);
   size_t packetNumLength = parsePacketNumberLength(*initialByte.data());
@@ -46,6 +53,15 @@ void PacketNumberCipher::cipherHeader(
   }
 }
 
+void PacketNumberCipher::batchMask(
+    const std::vector<Sample>& samples,
+    std::vector<HeaderProtectionMask>& masks) const {
+  masks.resize(samples.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    masks[i] = mask(samples[i]);
+  }
+}
+
 void PacketNumberCipher::decryptLongHeader(
     folly::ByteRange sample,
     folly::MutableByteRange initialByte,
@@ -94,4 +110,20 @@ void PacketNumberCipher::encryptShortHeader(
       ShortHeader::kPacketNumLenMask);
 }
 
+void PacketNumberCipher::encryptLongHeaderWithMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes) const {
+  applyCipherMask(
+      headerMask, initialByte, packetNumberBytes, LongHeader::kTypeBitsMask);
+}
+
+void PacketNumberCipher::encryptShortHeaderWithMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes) const {
+  applyCipherMask(
+      headerMask, initialByte, packetNumberBytes, ShortHeader::kTypeBitsMask);
+}
+
 } // namespace quic
@@ -11,6 +11,8 @@
 #include <folly/Optional.h>
 #include <folly/io/Cursor.h>
 
+#include <vector>
+
 namespace quic {
 
 using HeaderProtectionMask = std::array<uint8_t, 16>;
@@ -24,6 +26,16 @@ class PacketNumberCipher {
 
   virtual HeaderProtectionMask mask(folly::ByteRange sample) const = 0;
 
+  /**
+   * Computes the header protection masks for a batch of samples. masks is
+   * resized to hold one mask per sample, in the same order. The default
+   * implementation calls mask() for each sample; ciphers which can generate
+   * several masks in one pass should override it.
+   */
+  virtual void batchMask(
+      const std::vector<Sample>& samples,
+      std::vector<HeaderProtectionMask>& masks) const;
+
   /**
    * Decrypts a long header from a sample.
    * sample should be 16 bytes long.
@@ -66,11 +78,37 @@ class PacketNumberCipher {
       folly::MutableByteRange initialByte,
       folly::MutableByteRange packetNumberBytes) const;
 
+  /**
+   * Encrypts a long header with a mask that was already computed for the
+   * packet's sample through mask() or batchMask().
+   */
+  void encryptLongHeaderWithMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes) const;
+
+  /**
+   * Encrypts a short header with a mask that was already computed for the
+   * packet's sample through mask() or batchMask().
+   */
+  void encryptShortHeaderWithMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes) const;
+
   /**
    * Returns the length of key needed for the pn cipher.
    */
   virtual size_t keyLength() const = 0;
 
+  /**
+   * Whether the device sealing the packets also protects their headers, see
+   * CryptoOffload.
+   */
+  virtual bool isOffloaded() const {
+    return false;
+  }
+
  protected:
   virtual void cipherHeader(
       folly::ByteRange sample,
@@ -85,6 +123,13 @@ class PacketNumberCipher {
       folly::MutableByteRange packetNumberBytes,
       uint8_t initialByteMask,
       uint8_t packetNumLengthMask) const;
+
+ private:
+  static void applyCipherMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes,
+      uint8_t initialByteMask);
 };
 
 } // namespace quic
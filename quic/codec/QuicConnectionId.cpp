@@ -10,6 +10,9 @@
 #include <glog/logging.h>
 #include <quic/QuicConstants.h>
 
+#include <folly/Random.h>
+#include <folly/hash/SpookyHashV2.h>
+
 namespace quic {
 
 uint8_t* ConnectionId::data() {
@@ -77,6 +80,28 @@ bool ConnectionId::operator!=(const ConnectionId& other) const {
   return !operator==(other);
 }
 
+namespace {
+uint64_t connectionIdHashSeed() {
+  static const uint64_t seed = folly::Random::secureRand64();
+  return seed;
+}
+} // namespace
+
+ConnectionIdHash::ConnectionIdHash() : seed_(connectionIdHashSeed()) {}
+
+size_t ConnectionIdHash::operator()(const ConnectionId& connId) const {
+  const uint8_t* data = connId.data();
+  size_t size = connId.size();
+  if (size < sizeof(uint64_t) || size > 2 * sizeof(uint64_t)) {
+    return folly::hash::SpookyHashV2::Hash64(data, size, seed_);
+  }
+  uint64_t head;
+  uint64_t tail;
+  memcpy(&head, data, sizeof(head));
+  memcpy(&tail, data + size - sizeof(tail), sizeof(tail));
+  return folly::hash::hash_128_to_64(head ^ seed_, tail ^ size);
+}
+
 void ServerConnectionIdParams::setVersion(uint8_t versionIn) {
   version = versionIn;
 }
@@ -112,4 +137,17 @@ uint8_t encodeConnectionIdLengths(
       sourceConnectionIdSize == 0 ? 0 : sourceConnectionIdSize - 3;
   return ((dstByte << 4)) | (srcByte);
 }
+
+bool isStatelessResetTokenEqual(
+    const StatelessResetToken& lhs,
+    const StatelessResetToken& rhs) noexcept {
+  // Both halves are always compared, without a branch on the first. The xors
+  // and the or make a single vector compare where there is SSE2.
+  static_assert(kStatelessResetTokenLength == 2 * sizeof(uint64_t), "");
+  uint64_t lhsWords[2];
+  uint64_t rhsWords[2];
+  memcpy(lhsWords, lhs.data(), sizeof(lhsWords));
+  memcpy(rhsWords, rhs.data(), sizeof(rhsWords));
+  return ((lhsWords[0] ^ rhsWords[0]) | (lhsWords[1] ^ rhsWords[1])) == 0;
+}
 } // namespace quic
@@ -64,10 +64,20 @@ struct ConnectionId {
   uint8_t connidLen;
 };
 
+/**
+ * Hash of a connection id, seeded with a random value per process so that
+ * the peer can't pick colliding connection ids. Connection ids of 8 to 16
+ * bytes, which includes every id generated by the DefaultConnectionIdAlgo,
+ * are covered by their leading and trailing 8 bytes and hashed with a single
+ * mix; other sizes get a seeded hash of every byte.
+ */
 struct ConnectionIdHash {
-  size_t operator()(const ConnectionId& connId) const {
-    return folly::hash::fnv32_buf(connId.data(), connId.size());
-  }
+  ConnectionIdHash();
+
+  size_t operator()(const ConnectionId& connId) const;
+
+ private:
+  uint64_t seed_;
 };
 
 inline std::ostream& operator<<(std::ostream& os, const ConnectionId& connId) {
@@ -162,4 +172,12 @@ std::pair<uint8_t, uint8_t> decodeConnectionIdLengths(uint8_t connIdSize);
 uint8_t encodeConnectionIdLengths(
     uint8_t destinationConnectionIdSize,
     uint8_t sourceConnectionIdSize);
+
+/**
+ * Compares the tokens in constant time, so that how long the check of a
+ * forged reset takes doesn't tell how much of its token is right.
+ */
+bool isStatelessResetTokenEqual(
+    const StatelessResetToken& lhs,
+    const StatelessResetToken& rhs) noexcept;
 } // namespace quic
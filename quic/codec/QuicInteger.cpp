@@ -93,9 +93,48 @@ folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
   return folly::makeUnexpected(TransportErrorCode::INTERNAL_ERROR);
 }
 
+folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
+    folly::ByteRange data,
+    uint64_t atMost) {
+  if (data.size() >= sizeof(uint64_t)) {
+    // The 2 bit prefix gives the length, the bytes past the integer are
+    // shifted out.
+    uint64_t loaded =
+        folly::Endian::big(folly::loadUnaligned<uint64_t>(data.data()));
+    size_t len = size_t(1) << (loaded >> 62);
+    if (len > atMost) {
+      return folly::none;
+    }
+    uint64_t value =
+        (loaded & kEightByteLimit) >> ((sizeof(uint64_t) - len) * 8);
+    return std::make_pair(value, len);
+  }
+  if (data.empty() || atMost < 1) {
+    return folly::none;
+  }
+  size_t len = decodeQuicIntegerLength(data[0]);
+  if (len > atMost || len > data.size()) {
+    return folly::none;
+  }
+  uint64_t value = data[0] & kOneByteLimit;
+  for (size_t i = 1; i < len; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return std::make_pair(value, len);
+}
+
 folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
     folly::io::Cursor& cursor,
     uint64_t atMost) {
+  auto contiguous = cursor.peekBytes();
+  if (contiguous.size() >= sizeof(uint64_t)) {
+    auto decoded = decodeQuicInteger(contiguous, atMost);
+    if (decoded) {
+      cursor.skip(decoded->second);
+    }
+    return decoded;
+  }
+  // Integers that may cross into the next buffer of the chain.
   size_t numBytes = 0;
   size_t advanceLen = 0;
   uint64_t result = 0;
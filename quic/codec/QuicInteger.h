@@ -43,6 +43,15 @@ folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
     folly::io::Cursor& cursor,
     uint64_t atMost = std::numeric_limits<uint64_t>::max());
 
+/**
+ * Same as decodeQuicInteger above for a contiguous range of bytes, the
+ * integer is read from the start of data. With at least 8 bytes in data this
+ * is a single load, no matter the length of the integer.
+ */
+folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
+    folly::ByteRange data,
+    uint64_t atMost = std::numeric_limits<uint64_t>::max());
+
 /**
  * Returns the length of a quic integer given the first byte
  */
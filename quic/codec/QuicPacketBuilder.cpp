@@ -19,6 +19,12 @@ PacketNumEncodingResult encodeLongHeaderHelper(
     uint32_t& spaceCounter,
     PacketNum largestAckedPacketNum);
 
+PacketNumEncodingResult encodeShortHeaderHelper(
+    const ShortHeader& shortHeader,
+    BufAppender& appender,
+    uint32_t& spaceCounter,
+    PacketNum largestAckedPacketNum);
+
 PacketNumEncodingResult encodeLongHeaderHelper(
     const LongHeader& longHeader,
     BufAppender& appender,
@@ -114,6 +120,41 @@ PacketNumEncodingResult encodeLongHeaderHelper(
   return encodedPacketNum;
 }
 
+PacketNumEncodingResult encodeShortHeaderHelper(
+    const ShortHeader& shortHeader,
+    BufAppender& appender,
+    uint32_t& spaceCounter,
+    PacketNum largestAckedPacketNum) {
+  auto encodedPacketNum = encodePacketNumber(
+      shortHeader.getPacketSequenceNum(), largestAckedPacketNum);
+  if (spaceCounter < 1U + encodedPacketNum.length +
+          shortHeader.getConnectionId().size()) {
+    spaceCounter = 0;
+    return encodedPacketNum;
+  }
+  uint8_t initialByte =
+      ShortHeader::kFixedBitMask | (encodedPacketNum.length - 1);
+  initialByte &= ~ShortHeader::kReservedBitsMask;
+  if (shortHeader.getProtectionType() == ProtectionType::KeyPhaseOne) {
+    initialByte |= ShortHeader::kKeyPhaseMask;
+  }
+  // The header is put together here and appended in one go, rather than
+  // with an append per field.
+  const auto& connId = shortHeader.getConnectionId();
+  std::array<uint8_t, 1 + kMaxConnectionIdSize + sizeof(uint32_t)> header;
+  header[0] = initialByte;
+  memcpy(header.data() + 1, connId.data(), connId.size());
+  auto bigValue = folly::Endian::big(encodedPacketNum.result);
+  memcpy(
+      header.data() + 1 + connId.size(),
+      (uint8_t*)&bigValue + sizeof(bigValue) - encodedPacketNum.length,
+      encodedPacketNum.length);
+  size_t headerLen = 1 + connId.size() + encodedPacketNum.length;
+  appender.push(header.data(), headerLen);
+  spaceCounter -= headerLen;
+  return encodedPacketNum;
+}
+
 RegularQuicPacketBuilder::RegularQuicPacketBuilder(
     uint32_t remainingBytes,
     PacketHeader header,
@@ -137,29 +178,6 @@ uint32_t RegularQuicPacketBuilder::getHeaderBytes() const {
       (isLongHeader ? packetNumberEncoding_->length + kMaxPacketLenSize : 0);
 }
 
-uint32_t RegularQuicPacketBuilder::remainingSpaceInPkt() const {
-  return remainingBytes_;
-}
-
-void RegularQuicPacketBuilder::writeBE(uint8_t data) {
-  bodyAppender_.writeBE<uint8_t>(data);
-  remainingBytes_ -= sizeof(data);
-}
-
-void RegularQuicPacketBuilder::writeBE(uint16_t data) {
-  bodyAppender_.writeBE<uint16_t>(data);
-  remainingBytes_ -= sizeof(data);
-}
-
-void RegularQuicPacketBuilder::writeBE(uint64_t data) {
-  bodyAppender_.writeBE<uint64_t>(data);
-  remainingBytes_ -= sizeof(data);
-}
-
-void RegularQuicPacketBuilder::write(const QuicInteger& quicInteger) {
-  remainingBytes_ -= quicInteger.encode(bodyAppender_);
-}
-
 void RegularQuicPacketBuilder::appendBytes(
     PacketNum value,
     uint8_t byteNumber) {
@@ -178,6 +196,14 @@ void RegularQuicPacketBuilder::appendBytes(
 
 void RegularQuicPacketBuilder::insert(std::unique_ptr<folly::IOBuf> buf) {
   remainingBytes_ -= buf->computeChainDataLength();
+  if (contiguousBody_) {
+    // The data gets copied at seal time anyway, copy it now so the body stays
+    // a single buffer.
+    for (auto range : *buf) {
+      bodyAppender_.push(range.data(), range.size());
+    }
+    return;
+  }
   bodyAppender_.insert(std::move(buf));
 }
 
@@ -233,35 +259,8 @@ void RegularQuicPacketBuilder::encodeLongHeader(
 void RegularQuicPacketBuilder::encodeShortHeader(
     const ShortHeader& shortHeader,
     PacketNum largestAckedPacketNum) {
-  packetNumberEncoding_ = encodePacketNumber(
-      shortHeader.getPacketSequenceNum(), largestAckedPacketNum);
-  if (remainingBytes_ < 1U + packetNumberEncoding_->length +
-          shortHeader.getConnectionId().size()) {
-    remainingBytes_ = 0;
-    return;
-  }
-  uint8_t initialByte =
-      ShortHeader::kFixedBitMask | (packetNumberEncoding_->length - 1);
-  initialByte &= ~ShortHeader::kReservedBitsMask;
-  if (shortHeader.getProtectionType() == ProtectionType::KeyPhaseOne) {
-    initialByte |= ShortHeader::kKeyPhaseMask;
-  }
-  headerAppender_.writeBE<uint8_t>(initialByte);
-  --remainingBytes_;
-
-  headerAppender_.push(
-      shortHeader.getConnectionId().data(),
-      shortHeader.getConnectionId().size());
-  remainingBytes_ -= shortHeader.getConnectionId().size();
-  appendBytes(
-      headerAppender_,
-      packetNumberEncoding_->result,
-      packetNumberEncoding_->length);
-}
-
-void RegularQuicPacketBuilder::push(const uint8_t* data, size_t len) {
-  bodyAppender_.push(data, len);
-  remainingBytes_ -= len;
+  packetNumberEncoding_ = encodeShortHeaderHelper(
+      shortHeader, headerAppender_, remainingBytes_, largestAckedPacketNum);
 }
 
 bool RegularQuicPacketBuilder::canBuildPacket() const noexcept {
@@ -276,10 +275,144 @@ void RegularQuicPacketBuilder::setCipherOverhead(uint8_t overhead) noexcept {
   cipherOverhead_ = overhead;
 }
 
+void RegularQuicPacketBuilder::setBodyBuffer(Buf buf) {
+  CHECK(packet_.frames.empty());
+  DCHECK(body_->empty() && !body_->isChained());
+  DCHECK(buf->empty());
+  body_ = std::move(buf);
+  bodyAppender_ = BufAppender(body_.get(), kAppenderGrowthSize);
+  contiguousBody_ = true;
+}
+
 QuicVersion RegularQuicPacketBuilder::getVersion() const {
   return version_;
 }
 
+InplaceQuicPacketBuilder::InplaceQuicPacketBuilder(
+    folly::IOBuf& buffer,
+    uint32_t remainingBytes,
+    PacketHeader header,
+    PacketNum largestAckedPacketNum,
+    QuicVersion version)
+    : buffer_(buffer),
+      remainingBytes_(remainingBytes),
+      packet_(std::move(header)),
+      appender_(&buffer, kAppenderGrowthSize),
+      headerOffset_(buffer.length()),
+      version_(version) {
+  DCHECK(!buffer_.isChained());
+  DCHECK_GE(buffer_.tailroom(), remainingBytes);
+  if (packet_.header.getHeaderForm() == HeaderForm::Long) {
+    const LongHeader& longHeader = *packet_.header.asLong();
+    packetNumberEncoding_ = encodeLongHeaderHelper(
+        longHeader, appender_, remainingBytes_, largestAckedPacketNum);
+    if (canBuildPacket() &&
+        longHeader.getHeaderType() != LongHeader::Types::Retry) {
+      // The room for these was already taken out of remainingBytes_, they are
+      // filled in once the body length is known.
+      lengthOffset_ = buffer_.length();
+      buffer_.append(kMaxPacketLenSize + packetNumberEncoding_->length);
+    }
+  } else {
+    packetNumberEncoding_ = encodeShortHeaderHelper(
+        *packet_.header.asShort(),
+        appender_,
+        remainingBytes_,
+        largestAckedPacketNum);
+  }
+  bodyOffset_ = buffer_.length();
+}
+
+uint32_t InplaceQuicPacketBuilder::getHeaderBytes() const {
+  return folly::to<uint32_t>(bodyOffset_ - headerOffset_);
+}
+
+void InplaceQuicPacketBuilder::appendBytes(
+    PacketNum value,
+    uint8_t byteNumber) {
+  appendBytes(appender_, value, byteNumber);
+}
+
+void InplaceQuicPacketBuilder::appendBytes(
+    BufAppender& appender,
+    PacketNum value,
+    uint8_t byteNumber) {
+  auto bigValue = folly::Endian::big(value);
+  appender.push(
+      (uint8_t*)&bigValue + sizeof(bigValue) - byteNumber, byteNumber);
+  remainingBytes_ -= byteNumber;
+}
+
+void InplaceQuicPacketBuilder::insert(std::unique_ptr<folly::IOBuf> buf) {
+  remainingBytes_ -= buf->computeChainDataLength();
+  for (auto range : *buf) {
+    appender_.push(range.data(), range.size());
+  }
+}
+
+void InplaceQuicPacketBuilder::appendFrame(QuicWriteFrame frame) {
+  packet_.frames.push_back(std::move(frame));
+}
+
+const PacketHeader& InplaceQuicPacketBuilder::getPacketHeader() const {
+  return packet_.header;
+}
+
+InplaceQuicPacketBuilder::Packet InplaceQuicPacketBuilder::buildPacket() && {
+  DCHECK(!buffer_.isChained());
+  size_t minBodySize = kMaxPacketNumEncodingSize -
+      packetNumberEncoding_->length + sizeof(Sample);
+  size_t extraDataWritten = 0;
+  size_t bodyLength = buffer_.length() - bodyOffset_;
+  while (bodyLength + extraDataWritten + cipherOverhead_ < minBodySize &&
+         !packet_.frames.empty() && remainingBytes_ > kMaxPacketLenSize) {
+    // We can add padding frames, but we don't need to store them.
+    QuicInteger paddingType(static_cast<uint8_t>(FrameType::PADDING));
+    write(paddingType);
+    extraDataWritten++;
+  }
+  bodyLength = buffer_.length() - bodyOffset_;
+  if (lengthOffset_) {
+    uint64_t pktLen =
+        packetNumberEncoding_->length + bodyLength + cipherOverhead_;
+    CHECK_LE(pktLen, kTwoByteLimit);
+    // Two byte QUIC integer encoding.
+    uint16_t encodedLen =
+        folly::Endian::big(static_cast<uint16_t>(pktLen | 0x4000));
+    uint8_t* lengthField = buffer_.writableData() + *lengthOffset_;
+    memcpy(lengthField, &encodedLen, sizeof(encodedLen));
+    auto bigValue = folly::Endian::big(packetNumberEncoding_->result);
+    memcpy(
+        lengthField + kMaxPacketLenSize,
+        (uint8_t*)&bigValue + sizeof(bigValue) - packetNumberEncoding_->length,
+        packetNumberEncoding_->length);
+  }
+  return Packet(
+      std::move(packet_),
+      viewOfBuffer(headerOffset_, bodyOffset_ - headerOffset_),
+      viewOfBuffer(bodyOffset_, bodyLength));
+}
+
+bool InplaceQuicPacketBuilder::canBuildPacket() const noexcept {
+  return remainingBytes_ != 0;
+}
+
+void InplaceQuicPacketBuilder::setCipherOverhead(uint8_t overhead) noexcept {
+  cipherOverhead_ = overhead;
+}
+
+QuicVersion InplaceQuicPacketBuilder::getVersion() const {
+  return version_;
+}
+
+Buf InplaceQuicPacketBuilder::viewOfBuffer(size_t offset, size_t len) const {
+  auto view =
+      folly::IOBuf::wrapBuffer(buffer_.writableBuffer(), buffer_.capacity());
+  view->trimStart(buffer_.headroom() + offset);
+  view->trimEnd(view->length() - len);
+  return view;
+}
+
 StatelessResetPacketBuilder::StatelessResetPacketBuilder(
     uint16_t maxPacketSize,
     const StatelessResetToken& resetToken)
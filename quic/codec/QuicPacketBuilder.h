@@ -34,6 +34,11 @@ constexpr auto kLongHeaderHeaderSize = sizeof(uint8_t) /* Type bytes */ +
     kReservedPacketLenSize /* minimal size of length */ +
     kReservedPacketNumSize /* packet number */;
 
+// Largest possible short header: initial byte, connection id and the
+// packet number.
+constexpr auto kMaxShortHeaderSize =
+    sizeof(uint8_t) + kMaxConnectionIdSize + kMaxPacketNumEncodingSize;
+
 // A possible cipher overhead. The real overhead depends on the AEAD we will
 // use. But we need a ball-park value when deciding if we should schedule a
 // write.
@@ -72,7 +77,7 @@ class PacketBuilderInterface {
   }
 };
 
-class RegularQuicPacketBuilder : public PacketBuilderInterface {
+class RegularQuicPacketBuilder final : public PacketBuilderInterface {
  public:
   ~RegularQuicPacketBuilder() override = default;
 
@@ -107,17 +112,40 @@ class RegularQuicPacketBuilder : public PacketBuilderInterface {
   uint32_t getHeaderBytes() const;
 
   // PacketBuilderInterface
-  uint32_t remainingSpaceInPkt() const override;
+  // The per field writes are defined here so they can be inlined into the
+  // frame writers.
+  uint32_t remainingSpaceInPkt() const override {
+    return remainingBytes_;
+  }
+
+  void writeBE(uint8_t data) override {
+    bodyAppender_.writeBE<uint8_t>(data);
+    remainingBytes_ -= sizeof(data);
+  }
+
+  void writeBE(uint16_t data) override {
+    bodyAppender_.writeBE<uint16_t>(data);
+    remainingBytes_ -= sizeof(data);
+  }
+
+  void writeBE(uint64_t data) override {
+    bodyAppender_.writeBE<uint64_t>(data);
+    remainingBytes_ -= sizeof(data);
+  }
+
+  void write(const QuicInteger& quicInteger) override {
+    remainingBytes_ -= quicInteger.encode(bodyAppender_);
+  }
 
-  void writeBE(uint8_t data) override;
-  void writeBE(uint16_t data) override;
-  void writeBE(uint64_t data) override;
-  void write(const QuicInteger& quicInteger) override;
   void appendBytes(PacketNum value, uint8_t byteNumber) override;
   void appendBytes(BufAppender& appender, PacketNum value, uint8_t byteNumber)
       override;
   void insert(std::unique_ptr<folly::IOBuf> buf) override;
-  void push(const uint8_t* data, size_t len) override;
+
+  void push(const uint8_t* data, size_t len) override {
+    bodyAppender_.push(data, len);
+    remainingBytes_ -= len;
+  }
 
   void appendFrame(QuicWriteFrame frame) override;
   const PacketHeader& getPacketHeader() const override;
@@ -131,6 +159,15 @@ class RegularQuicPacketBuilder : public PacketBuilderInterface {
 
   void setCipherOverhead(uint8_t overhead) noexcept;
 
+  /**
+   * Write the packet body into buf instead of an internally allocated chain.
+   * buf should have enough headroom for the packet header and enough tailroom
+   * for the body and the cipher overhead, so that the caller can seal the
+   * packet in place. Data passed to insert() is copied into buf rather than
+   * chained. Must be called before any frame is written.
+   */
+  void setBodyBuffer(Buf buf);
+
   QuicVersion getVersion() const override;
 
  private:
@@ -150,6 +187,102 @@ class RegularQuicPacketBuilder : public PacketBuilderInterface {
   BufAppender headerAppender_;
   BufAppender bodyAppender_;
 
+  uint32_t cipherOverhead_{0};
+  bool contiguousBody_{false};
+  folly::Optional<PacketNumEncodingResult> packetNumberEncoding_;
+  QuicVersion version_;
+};
+
+/**
+ * A PacketBuilder that writes the header and the body of the packet straight
+ * into a caller provided buffer, right after the data already in it, so that
+ * a caller can lay out a burst of packets in a single buffer. The buffer must
+ * have at least remainingBytes of tailroom, plus the cipher overhead when the
+ * packet is sealed in place, and has to outlive the built packet: the header
+ * and body of the built packet are views into it. Data passed to insert() is
+ * copied into the buffer.
+ *
+ * Unlike RegularQuicPacketBuilder the packet length of a long header packet
+ * is always encoded with kMaxPacketLenSize bytes, since its room is reserved
+ * before the body is written.
+ */
+class InplaceQuicPacketBuilder final : public PacketBuilderInterface {
+ public:
+  using Packet = RegularQuicPacketBuilder::Packet;
+
+  ~InplaceQuicPacketBuilder() override = default;
+
+  InplaceQuicPacketBuilder(
+      folly::IOBuf& buffer,
+      uint32_t remainingBytes,
+      PacketHeader header,
+      PacketNum largestAckedPacketNum,
+      QuicVersion version = QuicVersion::MVFST_OLD);
+
+  uint32_t getHeaderBytes() const;
+
+  // PacketBuilderInterface
+  uint32_t remainingSpaceInPkt() const override {
+    return remainingBytes_;
+  }
+
+  void writeBE(uint8_t data) override {
+    appender_.writeBE<uint8_t>(data);
+    remainingBytes_ -= sizeof(data);
+  }
+
+  void writeBE(uint16_t data) override {
+    appender_.writeBE<uint16_t>(data);
+    remainingBytes_ -= sizeof(data);
+  }
+
+  void writeBE(uint64_t data) override {
+    appender_.writeBE<uint64_t>(data);
+    remainingBytes_ -= sizeof(data);
+  }
+
+  void write(const QuicInteger& quicInteger) override {
+    remainingBytes_ -= quicInteger.encode(appender_);
+  }
+
+  void appendBytes(PacketNum value, uint8_t byteNumber) override;
+  void appendBytes(BufAppender& appender, PacketNum value, uint8_t byteNumber)
+      override;
+  void insert(std::unique_ptr<folly::IOBuf> buf) override;
+
+  void push(const uint8_t* data, size_t len) override {
+    appender_.push(data, len);
+    remainingBytes_ -= len;
+  }
+
+  void appendFrame(QuicWriteFrame frame) override;
+  const PacketHeader& getPacketHeader() const override;
+
+  Packet buildPacket() &&;
+
+  bool canBuildPacket() const noexcept;
+
+  void setCipherOverhead(uint8_t overhead) noexcept;
+
+  QuicVersion getVersion() const override;
+
+ private:
+  // Returns a view of [offset, offset + len) of the buffer which keeps the
+  // rest of the buffer as headroom and tailroom.
+  Buf viewOfBuffer(size_t offset, size_t len) const;
+
+ private:
+  folly::IOBuf& buffer_;
+  uint32_t remainingBytes_;
+  RegularQuicWritePacket packet_;
+  BufAppender appender_;
+  // Offsets from the start of the buffer's data.
+  size_t headerOffset_;
+  size_t bodyOffset_{0};
+  // Where the packet length of a long header goes, followed by the packet
+  // number.
+  folly::Optional<size_t> lengthOffset_;
+
   uint32_t cipherOverhead_{0};
   folly::Optional<PacketNumEncodingResult> packetNumberEncoding_;
   QuicVersion version_;
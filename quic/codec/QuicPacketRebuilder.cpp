@@ -9,6 +9,7 @@
 #include <quic/codec/QuicPacketRebuilder.h>
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/SimpleFrameFunctions.h>
 
@@ -45,6 +46,15 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
   // now, then we cannot clone everything in the packet.
 
   // TODO: make sure this cannot be called on handshake packets.
+  if (packet.body &&
+      packet.body->computeChainDataLength() <= builder_.remainingSpaceInPkt() &&
+      canResendBody(packet)) {
+    builder_.insert(packet.body->clone());
+    for (const auto& frame : packet.packet.frames) {
+      builder_.appendFrame(frame);
+    }
+    return cloneOutstandingPacket(packet);
+  }
   bool writeSuccess = false;
   bool windowUpdateWritten = false;
   bool shouldWriteWindowUpdate = false;
@@ -66,6 +76,11 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
           ackBlocks.insert(block.start, block.end);
         }
         AckFrameMetaData meta(ackBlocks, ackFrame.ackDelay, ackDelayExponent);
+        const auto& ecnCounts =
+            getAckState(conn_, packet.packetNumberSpace).ecnCounts;
+        if (!ecnCounts.empty()) {
+          meta.ecnCounts = ecnCounts;
+        }
         auto ackWriteResult = writeAckFrame(meta, builder_);
         writeSuccess = ackWriteResult.has_value();
         break;
@@ -106,10 +121,6 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
         // initialStream and handshakeStream can only be in handshake packet,
         // so they are not clonable
         CHECK(!packet.isHandshake);
-        // key update not supported
-        DCHECK(
-            packet.packet.header.getProtectionType() ==
-            ProtectionType::KeyPhaseZero);
         auto& stream = conn_.cryptoState->oneRttStream;
         auto buf = cloneCryptoRetransmissionBuffer(cryptoFrame, stream);
 
@@ -157,6 +168,11 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
         writeSuccess = writeFrame(paddingFrame, builder_) != 0;
         break;
       }
+      case QuicWriteFrame::Type::DatagramFrame_E: {
+        // Datagrams are unreliable, they are never sent again.
+        writeSuccess = true;
+        break;
+      }
       case QuicWriteFrame::Type::QuicSimpleFrame_E: {
         const QuicSimpleFrame& simpleFrame = *frame.asQuicSimpleFrame();
         auto updatedSimpleFrame =
@@ -192,6 +208,60 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
   return cloneOutstandingPacket(packet);
 }
 
+bool PacketRebuilder::canResendBody(const OutstandingPacket& packet) {
+  bool notPureAck = false;
+  for (const auto& frame : packet.packet.frames) {
+    switch (frame.type()) {
+      case QuicWriteFrame::Type::WriteAckFrame_E:
+      case QuicWriteFrame::Type::PaddingFrame_E:
+      case QuicWriteFrame::Type::DatagramFrame_E:
+        break;
+      case QuicWriteFrame::Type::WriteStreamFrame_E: {
+        const WriteStreamFrame& streamFrame = *frame.asWriteStreamFrame();
+        auto stream = conn_.streamManager->getStream(streamFrame.streamId);
+        if (!stream || !retransmittable(*stream)) {
+          return false;
+        }
+        auto iter = stream->retransmissionBuffer.find(streamFrame.offset);
+        if (iter == stream->retransmissionBuffer.end() ||
+            !streamFrameMatchesRetransmitBuffer(
+                *stream, streamFrame, iter->second)) {
+          return false;
+        }
+        notPureAck = true;
+        break;
+      }
+      case QuicWriteFrame::Type::WriteCryptoFrame_E: {
+        const WriteCryptoFrame& cryptoFrame = *frame.asWriteCryptoFrame();
+        const auto& stream = conn_.cryptoState->oneRttStream;
+        auto iter = stream.retransmissionBuffer.find(cryptoFrame.offset);
+        if (iter == stream.retransmissionBuffer.end() ||
+            iter->second.data.chainLength() != cryptoFrame.len) {
+          return false;
+        }
+        notPureAck = true;
+        break;
+      }
+      case QuicWriteFrame::Type::MaxDataFrame_E:
+      case QuicWriteFrame::Type::MaxStreamDataFrame_E:
+        // Window updates are regenerated with the current windows.
+        return false;
+      case QuicWriteFrame::Type::QuicSimpleFrame_E: {
+        const QuicSimpleFrame& simpleFrame = *frame.asQuicSimpleFrame();
+        if (!updateSimpleFrameOnPacketClone(conn_, simpleFrame)) {
+          return false;
+        }
+        notPureAck = true;
+        break;
+      }
+      default:
+        notPureAck = true;
+        break;
+    }
+  }
+  return notPureAck;
+}
+
 Buf PacketRebuilder::cloneCryptoRetransmissionBuffer(
     const WriteCryptoFrame& frame,
     const QuicCryptoStream& stream) {
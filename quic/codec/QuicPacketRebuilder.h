@@ -42,6 +42,12 @@ class PacketRebuilder {
    */
   PacketEvent cloneOutstandingPacket(OutstandingPacket& packet);
 
+  /**
+   * Whether the kept body of packet can be resent as is, which is the case if
+   * rebuilding it would write the very same frames.
+   */
+  bool canResendBody(const OutstandingPacket& packet);
+
   bool retransmittable(const QuicStreamState& stream) const {
     return stream.sendState == StreamSendState::Open_E;
   }
@@ -10,6 +10,7 @@
 #include <folly/io/Cursor.h>
 #include <quic/codec/Decode.h>
 #include <quic/codec/PacketNumber.h>
+#include <quic/common/PipelineTiming.h>
 
 namespace {
 quic::ConnectionId zeroConnId() {
@@ -72,8 +73,10 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
   }
   auto type = parseLongHeaderType(initialByte);
 
-  auto parsedLongHeader = parseLongHeaderVariants(
-      type, std::move(*longHeaderInvariant), cursor, nodeType_);
+  auto parsedLongHeader = QUIC_PIPELINE_TIMED(
+      HeaderParse,
+      parseLongHeaderVariants(
+          type, std::move(*longHeaderInvariant), cursor, nodeType_));
   if (!parsedLongHeader) {
     VLOG(4) << "Dropping due to failed to parse header " << connIdToHex();
     // We've failed to parse the long header, so we have no idea where this
@@ -99,7 +102,9 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
     queue.move();
     return CodecResult(Nothing());
   }
-  auto currentPacketData = queue.splitAtMost(currentPacketLen);
+  // Split without sharing, so the packet decrypts in place in the datagram
+  // even when more coalesced packets follow it.
+  auto currentPacketData = queue.splitUnsharedAtMost(currentPacketLen);
   cursor.reset(currentPacketData.get());
   cursor.skip(packetNumberOffset);
   // Sample starts after the max packet number size. This ensures that we
@@ -189,8 +194,10 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
   folly::MutableByteRange packetNumberByteRange(
       currentPacketData->writableData() + packetNumberOffset,
       kMaxPacketNumEncodingSize);
-  headerCipher->decryptLongHeader(
-      folly::range(sample), initialByteRange, packetNumberByteRange);
+  QUIC_PIPELINE_TIMED(
+      HeaderDecrypt,
+      headerCipher->decryptLongHeader(
+          folly::range(sample), initialByteRange, packetNumberByteRange));
   std::pair<PacketNum, size_t> packetNum = parsePacketNumber(
       initialByteRange.data()[0], packetNumberByteRange, expectedNextPacketNum);
 
@@ -210,8 +217,10 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
   }
 
   Buf decrypted;
-  auto decryptAttempt = cipher->tryDecrypt(
-      std::move(encryptedData), headerData.get(), packetNum.first);
+  auto decryptAttempt = QUIC_PIPELINE_TIMED(
+      PayloadDecrypt,
+      cipher->tryDecrypt(
+          std::move(encryptedData), headerData.get(), packetNum.first));
   if (!decryptAttempt) {
     VLOG(4) << "Unable to decrypt packet=" << packetNum.first
             << " packetNumLen=" << parsePacketNumberLength(initialByte)
@@ -226,8 +235,10 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
     decrypted = folly::IOBuf::create(0);
   }
 
-  return decodeRegularPacket(
-      std::move(longHeader), params_, std::move(decrypted));
+  return QUIC_PIPELINE_TIMED(
+      FrameDecode,
+      decodeRegularPacket(
+          std::move(longHeader), params_, std::move(decrypted)));
 }
 
 CodecResult QuicReadCodec::parsePacket(
@@ -248,7 +259,6 @@ CodecResult QuicReadCodec::parsePacket(
     return parseLongHeaderPacket(queue, ackStates);
   }
   // Short header:
-  // TODO: support key phase one.
   if (!oneRttReadCipher_ || !oneRttHeaderCipher_) {
     VLOG(4) << nodeToString(nodeType_) << " cannot read key phase zero packet";
     VLOG(20) << "cannot read data="
@@ -273,29 +283,55 @@ CodecResult QuicReadCodec::parsePacket(
     queue.move();
     return CodecResult(Nothing());
   }
-  // Take it out of the queue so we can do some writing.
-  auto data = queue.move();
+  // Take it out of the queue so we can do some writing. The data may still be
+  // shared with packets coalesced before it, so take an unshared view.
+  auto data = queue.splitUnsharedAtMost(queue.chainLength());
   folly::MutableByteRange initialByteRange(data->writableData(), 1);
   folly::MutableByteRange packetNumberByteRange(
       data->writableData() + packetNumberOffset, kMaxPacketNumEncodingSize);
   folly::ByteRange sampleByteRange(
       data->writableData() + sampleOffset, sample.size());
 
-  oneRttHeaderCipher_->decryptShortHeader(
-      sampleByteRange, initialByteRange, packetNumberByteRange);
+  QUIC_PIPELINE_TIMED(
+      HeaderDecrypt,
+      oneRttHeaderCipher_->decryptShortHeader(
+          sampleByteRange, initialByteRange, packetNumberByteRange));
   std::pair<PacketNum, size_t> packetNum = parsePacketNumber(
       initialByteRange.data()[0], packetNumberByteRange, expectedNextPacketNum);
-  auto shortHeader =
-      parseShortHeader(initialByteRange.data()[0], cursor, dstConnIdSize);
+  // Packets almost always carry the connection id this codec was given, which
+  // can be matched in place instead of being parsed out of the packet.
+  const auto& selfConnId = nodeType_ == QuicNodeType::Server
+      ? serverConnectionId_
+      : clientConnectionId_;
+  bool knownConnId = selfConnId && selfConnId->size() == dstConnIdSize &&
+      memcmp(data->data() + 1, selfConnId->data(), dstConnIdSize) == 0;
+  auto shortHeader = QUIC_PIPELINE_TIMED(
+      HeaderParse,
+      knownConnId ? parseShortHeader(initialByteRange.data()[0], *selfConnId)
+                  : parseShortHeader(
+                        initialByteRange.data()[0], cursor, dstConnIdSize));
   if (!shortHeader) {
     VLOG(10) << "Dropping packet, cannot parse " << connIdToHex();
     return CodecResult(Nothing());
   }
   shortHeader->setPacketNumber(packetNum.first);
-  if (shortHeader->getProtectionType() == ProtectionType::KeyPhaseOne) {
-    VLOG(4) << nodeToString(nodeType_) << " cannot read key phase one packet "
-            << connIdToHex();
-    return CodecResult(Nothing());
+  // The key phase bit picks the cipher, no packet is tried with two.
+  const Aead* cipher = oneRttReadCipher_.get();
+  bool nextGeneration = false;
+  if (shortHeader->getProtectionType() !=
+      keyPhaseOfGeneration(oneRttReadKeyGeneration_)) {
+    if (previousOneRttReadCipher_ && oneRttReadGenerationStart_ &&
+        packetNum.first < *oneRttReadGenerationStart_) {
+      cipher = previousOneRttReadCipher_.get();
+    } else if (nextOneRttReadCipher_) {
+      cipher = nextOneRttReadCipher_.get();
+      nextGeneration = true;
+    } else {
+      VLOG(4) << nodeToString(nodeType_) << " cannot read key phase "
+              << toString(shortHeader->getProtectionType())
+              << " packet " << connIdToHex();
+      return CodecResult(Nothing());
+    }
   }
 
   // We know that the iobuf is not chained. This means that we can safely have a
@@ -320,11 +356,12 @@ CodecResult QuicReadCodec::parsePacket(
         data->data() + (encryptedDataLength - sizeof(StatelessResetToken)),
         token->size());
   }
-  auto decryptAttempt = oneRttReadCipher_->tryDecrypt(
-      std::move(data), &headerData, packetNum.first);
+  auto decryptAttempt = QUIC_PIPELINE_TIMED(
+      PayloadDecrypt,
+      cipher->tryDecrypt(std::move(data), &headerData, packetNum.first));
   if (!decryptAttempt) {
     // Can't return the data now, already consumed it to try decrypting it.
-    if (token) {
+    if (token && isStatelessResetTokenEqual(*token, *statelessResetToken_)) {
       return StatelessReset(*token);
     }
     auto protectionType = shortHeader->getProtectionType();
@@ -338,9 +375,21 @@ CodecResult QuicReadCodec::parsePacket(
     // TODO better way of handling this (tests break without this)
     decrypted = folly::IOBuf::create(0);
   }
+  if (nextGeneration) {
+    // The peer updated its keys.
+    previousOneRttReadCipher_ = std::move(oneRttReadCipher_);
+    oneRttReadCipher_ = std::move(nextOneRttReadCipher_);
+    oneRttReadKeyGeneration_++;
+    oneRttReadGenerationStart_ = packetNum.first;
+    VLOG(10) << nodeToString(nodeType_) << " key update to generation "
+             << oneRttReadKeyGeneration_ << " at packet=" << packetNum.first
+             << " " << connIdToHex();
+  }
 
-  return decodeRegularPacket(
-      std::move(*shortHeader), params_, std::move(decrypted));
+  return QUIC_PIPELINE_TIMED(
+      FrameDecode,
+      decodeRegularPacket(
+          std::move(*shortHeader), params_, std::move(decrypted)));
 }
 
 const Aead* QuicReadCodec::getOneRttReadCipher() const {
@@ -374,6 +423,23 @@ void QuicReadCodec::setOneRttReadCipher(
   oneRttReadCipher_ = std::move(oneRttReadCipher);
 }
 
+void QuicReadCodec::setNextOneRttReadCipher(
+    std::unique_ptr<Aead> nextOneRttReadCipher) {
+  nextOneRttReadCipher_ = std::move(nextOneRttReadCipher);
+}
+
+const Aead* QuicReadCodec::getNextOneRttReadCipher() const {
+  return nextOneRttReadCipher_.get();
+}
+
+uint64_t QuicReadCodec::getOneRttReadKeyGeneration() const {
+  return oneRttReadKeyGeneration_;
+}
+
+void QuicReadCodec::setOneRttReadKeyGeneration(uint64_t generation) {
+  oneRttReadKeyGeneration_ = generation;
+}
+
 void QuicReadCodec::setZeroRttReadCipher(
     std::unique_ptr<Aead> zeroRttReadCipher) {
   if (nodeType_ == QuicNodeType::Client) {
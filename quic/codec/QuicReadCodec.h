@@ -128,6 +128,27 @@ class QuicReadCodec {
   void setZeroRttReadCipher(std::unique_ptr<Aead> zeroRttReadCipher);
   void setHandshakeReadCipher(std::unique_ptr<Aead> handshakeReadCipher);
 
+  /**
+   * The 1-RTT read cipher of the next key generation, derived ahead of the
+   * peer's key update. The codec moves on to it with the first packet of the
+   * other key phase that it decrypts, and keeps the cipher it replaces for
+   * the packets of the old phase that arrive late.
+   */
+  void setNextOneRttReadCipher(std::unique_ptr<Aead> nextOneRttReadCipher);
+  const Aead* getNextOneRttReadCipher() const;
+
+  /**
+   * The generation of the 1-RTT keys the peer protects its packets with, 0
+   * until its first key update.
+   */
+  uint64_t getOneRttReadKeyGeneration() const;
+
+  /**
+   * For a connection taken over part way, whose read cipher is already of a
+   * later generation.
+   */
+  void setOneRttReadKeyGeneration(uint64_t generation);
+
   void setInitialHeaderCipher(
       std::unique_ptr<PacketNumberCipher> initialHeaderCipher);
   void setOneRttHeaderCipher(
@@ -167,6 +188,12 @@ class QuicReadCodec {
   std::unique_ptr<Aead> initialReadCipher_;
 
   std::unique_ptr<Aead> oneRttReadCipher_;
+  std::unique_ptr<Aead> nextOneRttReadCipher_;
+  std::unique_ptr<Aead> previousOneRttReadCipher_;
+  uint64_t oneRttReadKeyGeneration_{0};
+  // The first packet of the current key generation, the packets of the
+  // other key phase below it are late packets of the previous one.
+  folly::Optional<PacketNum> oneRttReadGenerationStart_;
   std::unique_ptr<Aead> zeroRttReadCipher_;
   std::unique_ptr<Aead> handshakeReadCipher_;
 
@@ -9,6 +9,7 @@
 #include <quic/codec/QuicWriteCodec.h>
 
 #include <algorithm>
+#include <typeinfo>
 
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
@@ -29,8 +30,15 @@ bool packetSpaceCheck(uint64_t limit, size_t require) {
 
 namespace quic {
 
-folly::Optional<uint64_t> writeStreamFrameHeader(
-    PacketBuilderInterface& builder,
+namespace {
+
+/**
+ * The frame writers are templated over the builder so that writes into a
+ * RegularQuicPacketBuilder are not dispatched through PacketBuilderInterface.
+ */
+template <class Builder>
+folly::Optional<uint64_t> writeStreamFrameHeaderImpl(
+    Builder& builder,
     StreamId id,
     uint64_t offset,
     uint64_t writeBufferLen,
@@ -135,6 +143,8 @@ folly::Optional<uint64_t> writeStreamFrameHeader(
   return folly::make_optional(dataLen);
 }
 
+} // namespace
+
 void writeStreamFrameData(
     PacketBuilderInterface& builder,
     const BufQueue& writeBuffer,
@@ -196,13 +206,11 @@ writeCryptoFrame(uint64_t offsetIn, Buf data, PacketBuilderInterface& builder) {
 }
 
 /*
- * This function will fill the parameter ack frame with ack blocks from the
- * parameter ackBlocks until it runs out of space (bytesLimit). The largest
- * ack block should have been inserted by the caller.
+ * Returns how many of the ack blocks after the largest one fit in bytesLimit,
+ * walking them from the largest down like they are written.
  */
-static size_t fillFrameWithAckBlocks(
+static size_t numAdditionalAckBlocksThatFit(
     const AckBlocks& ackBlocks,
-    WriteAckFrame& ackFrame,
     uint64_t bytesLimit) {
   PacketNum currentSeqNum = ackBlocks.crbegin()->start;
 
@@ -211,7 +219,7 @@ static size_t fillFrameWithAckBlocks(
   size_t numAdditionalAckBlocks = 0;
   size_t previousNumAckBlocks = 0;
 
-  // Skip the largest, as it has already been emplaced.
+  // Skip the largest, it is part of the required fields.
   for (auto blockItr = ackBlocks.crbegin() + 1; blockItr != ackBlocks.crend();
        ++blockItr) {
     const auto& currBlock = *blockItr;
@@ -220,9 +228,6 @@ static size_t fillFrameWithAckBlocks(
     PacketNum gap = currentSeqNum - currBlock.end - 2;
     PacketNum currBlockLen = currBlock.end - currBlock.start;
 
-    // TODO this is still extra work, as we end up duplicating these
-    // calculations in the caller, we could store the results so they
-    // can be reused by the caller when writing the frame.
     size_t gapSize = getQuicIntegerSizeThrows(gap);
     size_t currBlockLenSize = getQuicIntegerSizeThrows(currBlockLen);
     size_t numAdditionalAckBlocksSize =
@@ -239,7 +244,6 @@ static size_t fillFrameWithAckBlocks(
     bytesLimit -= additionalSize;
     previousNumAckBlocks = numAdditionalAckBlocks;
     currentSeqNum = currBlock.start;
-    ackFrame.ackBlocks.emplace_back(currBlock.start, currBlock.end);
   }
   return numAdditionalAckBlocks;
 }
@@ -257,12 +261,8 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
   auto firstAckBlockLength =
       largestAckedPacket - ackFrameMetaData.ackBlocks.back().start;
 
-  WriteAckFrame ackFrame;
   uint64_t spaceLeft = builder.remainingSpaceInPkt();
   uint64_t beginningSpace = spaceLeft;
-  // Reserve enough space a full packet of ACKs with 2 byte varints.
-  // TODO is this a good heuristic?
-  ackFrame.ackBlocks.reserve(spaceLeft / 4);
 
   // We could technically split the range if the size of the representation of
   // the integer is too large, but that gets super tricky and is of dubious
@@ -277,19 +277,30 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
   QuicInteger minAdditionalAckBlockCount(0);
 
   // Required fields are Type, LargestAcked, AckDelay, AckBlockCount,
-  // firstAckBlockLength
-  QuicInteger encodedintFrameType(static_cast<uint8_t>(FrameType::ACK));
+  // firstAckBlockLength, and the ECN counts of an ACK_ECN.
+  const auto& ecnCounts = ackFrameMetaData.ecnCounts;
+  QuicInteger encodedintFrameType(static_cast<uint8_t>(
+      ecnCounts ? FrameType::ACK_ECN : FrameType::ACK));
   auto headerSize = encodedintFrameType.getSize() +
       largestAckedPacketInt.getSize() + ackDelayInt.getSize() +
       minAdditionalAckBlockCount.getSize() + firstAckBlockLengthInt.getSize();
+  if (ecnCounts) {
+    headerSize += getQuicIntegerSizeThrows(ecnCounts->ect0) +
+        getQuicIntegerSizeThrows(ecnCounts->ect1) +
+        getQuicIntegerSizeThrows(ecnCounts->ce);
+  }
   if (spaceLeft < headerSize) {
     return folly::none;
   }
   spaceLeft -= headerSize;
 
-  ackFrame.ackBlocks.push_back(ackFrameMetaData.ackBlocks.back());
+  // The blocks are encoded straight from the ack state, the frame only keeps
+  // the ones that were written so that their ack can purge them.
   auto numAdditionalAckBlocks =
-      fillFrameWithAckBlocks(ackFrameMetaData.ackBlocks, ackFrame, spaceLeft);
+      numAdditionalAckBlocksThatFit(ackFrameMetaData.ackBlocks, spaceLeft);
+  WriteAckFrame ackFrame;
+  ackFrame.ackBlocks.reserve(1 + numAdditionalAckBlocks);
+  ackFrame.ackBlocks.push_back(ackFrameMetaData.ackBlocks.back());
 
   QuicInteger numAdditionalAckBlocksInt(numAdditionalAckBlocks);
   builder.write(encodedintFrameType);
@@ -299,17 +310,22 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
   builder.write(firstAckBlockLengthInt);
 
   PacketNum currentSeqNum = ackFrameMetaData.ackBlocks.back().start;
-  for (auto it = ackFrame.ackBlocks.cbegin() + 1;
-       it != ackFrame.ackBlocks.cend();
-       ++it) {
-    CHECK_GE(currentSeqNum, it->end + 2);
-    PacketNum gap = currentSeqNum - it->end - 2;
-    PacketNum currBlockLen = it->end - it->start;
+  auto blockItr = ackFrameMetaData.ackBlocks.crbegin() + 1;
+  for (size_t i = 0; i < numAdditionalAckBlocks; ++i, ++blockItr) {
+    CHECK_GE(currentSeqNum, blockItr->end + 2);
+    PacketNum gap = currentSeqNum - blockItr->end - 2;
+    PacketNum currBlockLen = blockItr->end - blockItr->start;
     QuicInteger gapInt(gap);
     QuicInteger currentBlockLenInt(currBlockLen);
     builder.write(gapInt);
     builder.write(currentBlockLenInt);
-    currentSeqNum = it->start;
+    currentSeqNum = blockItr->start;
+    ackFrame.ackBlocks.push_back(*blockItr);
+  }
+  if (ecnCounts) {
+    builder.write(QuicInteger(ecnCounts->ect0));
+    builder.write(QuicInteger(ecnCounts->ect1));
+    builder.write(QuicInteger(ecnCounts->ce));
   }
   ackFrame.ackDelay = ackFrameMetaData.ackDelay;
   builder.appendFrame(std::move(ackFrame));
@@ -318,9 +334,10 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
       1 + numAdditionalAckBlocks);
 }
 
-size_t writeSimpleFrame(
-    QuicSimpleFrame&& frame,
-    PacketBuilderInterface& builder) {
+namespace {
+
+template <class Builder>
+size_t writeSimpleFrameImpl(QuicSimpleFrame&& frame, Builder& builder) {
   using FrameTypeType = std::underlying_type<FrameType>::type;
 
   uint64_t spaceLeft = builder.remainingSpaceInPkt();
@@ -506,11 +523,84 @@ size_t writeSimpleFrame(
       // no space left in packet
       return size_t(0);
     }
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const AckFrequencyFrame& ackFrequencyFrame = *frame.asAckFrequencyFrame();
+      QuicInteger intFrameType(static_cast<uint8_t>(FrameType::ACK_FREQUENCY));
+      QuicInteger sequence(ackFrequencyFrame.sequenceNumber);
+      QuicInteger packetTolerance(ackFrequencyFrame.packetTolerance);
+      QuicInteger updateMaxAckDelay(
+          ackFrequencyFrame.updateMaxAckDelay.count());
+      auto ackFrequencyFrameSize = intFrameType.getSize() +
+          sequence.getSize() + packetTolerance.getSize() +
+          updateMaxAckDelay.getSize() + sizeof(uint8_t);
+      if (packetSpaceCheck(spaceLeft, ackFrequencyFrameSize)) {
+        builder.write(intFrameType);
+        builder.write(sequence);
+        builder.write(packetTolerance);
+        builder.write(updateMaxAckDelay);
+        builder.writeBE(
+            static_cast<uint8_t>(ackFrequencyFrame.ignoreOrder ? 1 : 0));
+        builder.appendFrame(QuicSimpleFrame(ackFrequencyFrame));
+        return ackFrequencyFrameSize;
+      }
+      // no space left in packet
+      return size_t(0);
+    }
+    case QuicSimpleFrame::Type::ImmediateAckFrame_E: {
+      const ImmediateAckFrame& immediateAckFrame = *frame.asImmediateAckFrame();
+      QuicInteger intFrameType(static_cast<uint8_t>(FrameType::IMMEDIATE_ACK));
+      if (packetSpaceCheck(spaceLeft, intFrameType.getSize())) {
+        builder.write(intFrameType);
+        builder.appendFrame(QuicSimpleFrame(immediateAckFrame));
+        return intFrameType.getSize();
+      }
+      // no space left in packet
+      return size_t(0);
+    }
+    case QuicSimpleFrame::Type::StreamRepairFrame_E: {
+      StreamRepairFrame& streamRepairFrame = *frame.asStreamRepairFrame();
+      DCHECK(streamRepairFrame.repair);
+      QuicInteger intFrameType(static_cast<uint8_t>(FrameType::STREAM_REPAIR));
+      QuicInteger streamId(streamRepairFrame.streamId);
+      QuicInteger count(streamRepairFrame.ranges.size());
+      auto repairLength = streamRepairFrame.repair->computeChainDataLength();
+      QuicInteger repairLengthInt(repairLength);
+      auto streamRepairFrameSize = intFrameType.getSize() +
+          streamId.getSize() + sizeof(uint8_t) + count.getSize() +
+          repairLengthInt.getSize() + repairLength;
+      for (const auto& range : streamRepairFrame.ranges) {
+        streamRepairFrameSize += QuicInteger(range.offset).getSize() +
+            QuicInteger(range.length).getSize();
+      }
+      if (packetSpaceCheck(spaceLeft, streamRepairFrameSize)) {
+        builder.write(intFrameType);
+        builder.write(streamId);
+        builder.writeBE(static_cast<uint8_t>(streamRepairFrame.fin ? 1 : 0));
+        builder.write(count);
+        for (const auto& range : streamRepairFrame.ranges) {
+          builder.write(QuicInteger(range.offset));
+          builder.write(QuicInteger(range.length));
+        }
+        builder.write(repairLengthInt);
+        // Like DATAGRAM, the written packet doesn't keep the payload, a lost
+        // repair frame isn't sent again.
+        builder.insert(std::move(streamRepairFrame.repair));
+        builder.appendFrame(QuicSimpleFrame(StreamRepairFrame(
+            streamRepairFrame.streamId,
+            std::move(streamRepairFrame.ranges),
+            streamRepairFrame.fin,
+            nullptr)));
+        return streamRepairFrameSize;
+      }
+      // no space left in packet
+      return size_t(0);
+    }
   }
   folly::assume_unreachable();
 }
 
-size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
+template <class Builder>
+size_t writeFrameImpl(QuicWriteFrame&& frame, Builder& builder) {
   using FrameTypeType = std::underlying_type<FrameType>::type;
 
   uint64_t spaceLeft = builder.remainingSpaceInPkt();
@@ -693,7 +783,27 @@ size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
       return size_t(0);
     }
     case QuicWriteFrame::Type::QuicSimpleFrame_E: {
-      return writeSimpleFrame(std::move(*frame.asQuicSimpleFrame()), builder);
+      return writeSimpleFrameImpl(
+          std::move(*frame.asQuicSimpleFrame()), builder);
+    }
+    case QuicWriteFrame::Type::DatagramFrame_E: {
+      DatagramFrame& datagramFrame = *frame.asDatagramFrame();
+      DCHECK(datagramFrame.data);
+      QuicInteger intFrameType(static_cast<uint8_t>(FrameType::DATAGRAM_LEN));
+      QuicInteger length(datagramFrame.length);
+      auto datagramFrameSize =
+          intFrameType.getSize() + length.getSize() + datagramFrame.length;
+      if (packetSpaceCheck(spaceLeft, datagramFrameSize)) {
+        builder.write(intFrameType);
+        builder.write(length);
+        // The builder gets the payload buffer itself, the written packet only
+        // keeps its length.
+        builder.insert(std::move(datagramFrame.data));
+        builder.appendFrame(DatagramFrame(datagramFrame.length, nullptr));
+        return datagramFrameSize;
+      }
+      // no space left in packet
+      return size_t(0);
     }
     default: {
       // TODO add support for: RETIRE_CONNECTION_ID and NEW_TOKEN frames
@@ -705,4 +815,73 @@ size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
     }
   }
 }
+
+/**
+ * Runs func with the concrete builder when it is one of the final builders,
+ * which costs a type check per frame instead of a virtual call per field.
+ */
+template <class Func>
+decltype(auto) withConcreteBuilder(
+    PacketBuilderInterface& builder,
+    Func&& func) {
+  const auto& builderType = typeid(builder);
+  if (builderType == typeid(RegularQuicPacketBuilder)) {
+    return func(static_cast<RegularQuicPacketBuilder&>(builder));
+  }
+  if (builderType == typeid(InplaceQuicPacketBuilder)) {
+    return func(static_cast<InplaceQuicPacketBuilder&>(builder));
+  }
+  return func(builder);
+}
+
+} // namespace
+
+folly::Optional<uint64_t> writeStreamFrameHeader(
+    PacketBuilderInterface& builder,
+    StreamId id,
+    uint64_t offset,
+    uint64_t writeBufferLen,
+    uint64_t flowControlLen,
+    bool fin) {
+  return withConcreteBuilder(builder, [&](auto& concreteBuilder) {
+    return writeStreamFrameHeaderImpl(
+        concreteBuilder, id, offset, writeBufferLen, flowControlLen, fin);
+  });
+}
+
+folly::Optional<uint64_t> writeStreamFrameHeader(
+    RegularQuicPacketBuilder& builder,
+    StreamId id,
+    uint64_t offset,
+    uint64_t writeBufferLen,
+    uint64_t flowControlLen,
+    bool fin) {
+  return writeStreamFrameHeaderImpl(
+      builder, id, offset, writeBufferLen, flowControlLen, fin);
+}
+
+size_t writeSimpleFrame(
+    QuicSimpleFrame&& frame,
+    PacketBuilderInterface& builder) {
+  return withConcreteBuilder(builder, [&](auto& concreteBuilder) {
+    return writeSimpleFrameImpl(std::move(frame), concreteBuilder);
+  });
+}
+
+size_t writeSimpleFrame(
+    QuicSimpleFrame&& frame,
+    RegularQuicPacketBuilder& builder) {
+  return writeSimpleFrameImpl(std::move(frame), builder);
+}
+
+size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
+  return withConcreteBuilder(builder, [&](auto& concreteBuilder) {
+    return writeFrameImpl(std::move(frame), concreteBuilder);
+  });
+}
+
+size_t writeFrame(QuicWriteFrame&& frame, RegularQuicPacketBuilder& builder) {
+  return writeFrameImpl(std::move(frame), builder);
+}
+
 } // namespace quic
@@ -22,6 +22,8 @@ struct AckFrameMetaData {
   std::chrono::microseconds ackDelay;
   // The ack delay exponent to use.
   uint8_t ackDelayExponent;
+  // Written as an ACK_ECN frame when set.
+  folly::Optional<EcnCounts> ecnCounts;
 
   AckFrameMetaData(
       const AckBlocks& acksIn,
@@ -41,6 +43,12 @@ struct AckFrameWriteResult {
       : bytesWritten(bytesWrittenIn), ackBlocksWritten(ackBlocksWrittenIn) {}
 };
 
+/**
+ * The frame writers below have an overload for RegularQuicPacketBuilder whose
+ * writes into the builder are not virtual. The PacketBuilderInterface overloads
+ * take the same path when the builder is a RegularQuicPacketBuilder.
+ */
+
 /**
  * Write a simple QuicFrame into builder
  *
@@ -51,6 +59,10 @@ size_t writeSimpleFrame(
     QuicSimpleFrame&& frame,
     PacketBuilderInterface& builder);
 
+size_t writeSimpleFrame(
+    QuicSimpleFrame&& frame,
+    RegularQuicPacketBuilder& builder);
+
 /**
  * Write a (non-ACK, non-Stream) QuicFrame into builder
  *
@@ -59,6 +71,8 @@ size_t writeSimpleFrame(
  */
 size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder);
 
+size_t writeFrame(QuicWriteFrame&& frame, RegularQuicPacketBuilder& builder);
+
 /**
  * Write a complete stream frame header into builder
  * This writes the stream frame header into the parameter builder and returns
@@ -73,6 +87,13 @@ folly::Optional<uint64_t> writeStreamFrameHeader(
     uint64_t writeBufferLen,
     uint64_t flowControlLen,
     bool fin);
+folly::Optional<uint64_t> writeStreamFrameHeader(
+    RegularQuicPacketBuilder& builder,
+    StreamId id,
+    uint64_t offset,
+    uint64_t writeBufferLen,
+    uint64_t flowControlLen,
+    bool fin);
 
 /**
  * Write stream frama data into builder
@@ -398,6 +398,15 @@ std::string toString(FrameType frame) {
       return "EXPIRED_STREAM_DATA";
     case FrameType::HANDSHAKE_DONE:
       return "HANDSHAKE_DONE";
+    case FrameType::IMMEDIATE_ACK:
+      return "IMMEDIATE_ACK";
+    case FrameType::ACK_FREQUENCY:
+      return "ACK_FREQUENCY";
+    case FrameType::STREAM_REPAIR:
+      return "STREAM_REPAIR";
+    case FrameType::DATAGRAM:
+    case FrameType::DATAGRAM_LEN:
+      return "DATAGRAM";
   }
   LOG(WARNING) << "toString has unhandled frame type";
   return "UNKNOWN";
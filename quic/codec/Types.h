@@ -20,6 +20,9 @@
 #include <quic/common/IntervalSet.h>
 #include <quic/common/Variant.h>
 
+#include <numeric>
+#include <vector>
+
 /**
  * This details the types of objects that can be serialized or deserialized
  * over the wire.
@@ -49,6 +52,10 @@ enum class PacketNumberSpace : uint8_t {
 constexpr uint8_t kHeaderFormMask = 0x80;
 constexpr auto kMaxPacketNumEncodingSize = 4;
 constexpr auto kNumInitialAckBlocksPerFrame = 32;
+// Ack blocks a WriteAckFrame holds without allocating. Sent frames stay in
+// the outstanding packets, so this is kept small enough not to grow the
+// QuicWriteFrame variant.
+constexpr auto kNumInlineWriteAckBlocks = 2;
 
 template <class T>
 using IntervalSetVec = SmallVec<T, kNumInitialAckBlocksPerFrame, uint16_t>;
@@ -100,6 +107,20 @@ struct AckBlock {
  |                    Additional ACK Block (i)                 ...
  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
  */
+/**
+ * Number of packets received with each ECN codepoint, as carried by ACK_ECN
+ * frames.
+ */
+struct EcnCounts {
+  uint64_t ect0{0};
+  uint64_t ect1{0};
+  uint64_t ce{0};
+
+  bool empty() const {
+    return !ect0 && !ect1 && !ce;
+  }
+};
+
 struct ReadAckFrame {
   PacketNum largestAcked;
   std::chrono::microseconds ackDelay{0us};
@@ -107,6 +128,8 @@ struct ReadAckFrame {
   // These are ordered in descending order by start packet.
   using Vec = SmallVec<AckBlock, kNumInitialAckBlocksPerFrame, uint16_t>;
   Vec ackBlocks;
+  // Only set for ACK_ECN frames.
+  folly::Optional<EcnCounts> ecnCounts;
 
   bool operator==(const ReadAckFrame& /*rhs*/) const {
     // Can't compare ackBlocks, function is just here to appease compiler.
@@ -117,8 +140,8 @@ struct ReadAckFrame {
 struct WriteAckFrame {
   // Since we don't need this to be an IntervalSet, they are stored directly
   // in a vector, in reverse order.
-  // TODO should this be a small_vector?
-  using AckBlockVec = std::vector<Interval<PacketNum>>;
+  using AckBlockVec =
+      SmallVec<Interval<PacketNum>, kNumInlineWriteAckBlocks, uint16_t>;
   AckBlockVec ackBlocks;
   // Delay in sending ack from time that packet was received.
   std::chrono::microseconds ackDelay{0us};
@@ -555,6 +578,80 @@ struct HandshakeDoneFrame {
   }
 };
 
+/**
+ * ACK_FREQUENCY from the delayed ack extension: asks the peer to only ack
+ * after packetTolerance ack-eliciting packets or updateMaxAckDelay, and, with
+ * ignoreOrder, not to ack out of order packets right away. Frames with a
+ * sequence number lower than the largest one seen are ignored.
+ */
+struct AckFrequencyFrame {
+  uint64_t sequenceNumber;
+  uint64_t packetTolerance;
+  std::chrono::microseconds updateMaxAckDelay;
+  bool ignoreOrder;
+
+  AckFrequencyFrame(
+      uint64_t sequenceNumberIn,
+      uint64_t packetToleranceIn,
+      std::chrono::microseconds updateMaxAckDelayIn,
+      bool ignoreOrderIn)
+      : sequenceNumber(sequenceNumberIn),
+        packetTolerance(packetToleranceIn),
+        updateMaxAckDelay(updateMaxAckDelayIn),
+        ignoreOrder(ignoreOrderIn) {}
+
+  bool operator==(const AckFrequencyFrame& rhs) const {
+    return sequenceNumber == rhs.sequenceNumber &&
+        packetTolerance == rhs.packetTolerance &&
+        updateMaxAckDelay == rhs.updateMaxAckDelay &&
+        ignoreOrder == rhs.ignoreOrder;
+  }
+};
+
+// Asks the peer to ack the packet carrying it right away.
+struct ImmediateAckFrame {
+  bool operator==(const ImmediateAckFrame& /*rhs*/) const {
+    return true;
+  }
+};
+
+/**
+ * Unreliable DATAGRAM frame of RFC 9221. The payload is not retransmitted,
+ * written packets only keep its length.
+ */
+struct DatagramFrame {
+  size_t length;
+  Buf data;
+
+  DatagramFrame(size_t lengthIn, Buf dataIn)
+      : length(lengthIn), data(std::move(dataIn)) {}
+
+  // Stuff stored in a variant type needs to be copyable.
+  DatagramFrame(const DatagramFrame& other)
+      : length(other.length),
+        data(other.data ? other.data->clone() : nullptr) {}
+
+  DatagramFrame(DatagramFrame&& other) = default;
+
+  DatagramFrame& operator=(const DatagramFrame& other) {
+    length = other.length;
+    data = other.data ? other.data->clone() : nullptr;
+    return *this;
+  }
+
+  DatagramFrame& operator=(DatagramFrame&& other) = default;
+
+  bool operator==(const DatagramFrame& other) const {
+    if (length != other.length) {
+      return false;
+    }
+    if (!data || !other.data) {
+      return !data && !other.data;
+    }
+    return folly::IOBufEqualTo()(*data, *other.data);
+  }
+};
+
 // Frame to represent ones we skip
 struct NoopFrame {
   bool operator==(const NoopFrame&) const {
@@ -562,6 +659,80 @@ struct NoopFrame {
   }
 };
 
+/**
+ * STREAM_REPAIR from the experimental stream repair extension: the XOR of
+ * ranges of a stream, each zero padded to the longest, so that a receiver
+ * missing any one of them can rebuild it from the others instead of waiting
+ * for its retransmission.
+ */
+struct StreamRepairFrame {
+  struct Range {
+    uint64_t offset;
+    uint64_t length;
+
+    bool operator==(const Range& rhs) const {
+      return offset == rhs.offset && length == rhs.length;
+    }
+  };
+
+  StreamId streamId;
+  // In stream order, they don't overlap.
+  std::vector<Range> ranges;
+  // Whether the stream ends with the last range.
+  bool fin;
+  Buf repair;
+
+  StreamRepairFrame(
+      StreamId streamIdIn,
+      std::vector<Range> rangesIn,
+      bool finIn,
+      Buf repairIn)
+      : streamId(streamIdIn),
+        ranges(std::move(rangesIn)),
+        fin(finIn),
+        repair(std::move(repairIn)) {}
+
+  // Stuff stored in a variant type needs to be copyable.
+  StreamRepairFrame(const StreamRepairFrame& other)
+      : streamId(other.streamId),
+        ranges(other.ranges),
+        fin(other.fin),
+        repair(other.repair ? other.repair->clone() : nullptr) {}
+
+  StreamRepairFrame(StreamRepairFrame&& other) = default;
+
+  StreamRepairFrame& operator=(const StreamRepairFrame& other) {
+    streamId = other.streamId;
+    ranges = other.ranges;
+    fin = other.fin;
+    repair = other.repair ? other.repair->clone() : nullptr;
+    return *this;
+  }
+
+  StreamRepairFrame& operator=(StreamRepairFrame&& other) = default;
+
+  // The bytes the ranges cover.
+  uint64_t totalLength() const {
+    return std::accumulate(
+        ranges.begin(),
+        ranges.end(),
+        uint64_t(0),
+        [](uint64_t total, const Range& range) {
+          return total + range.length;
+        });
+  }
+
+  bool operator==(const StreamRepairFrame& rhs) const {
+    if (streamId != rhs.streamId || ranges != rhs.ranges || fin != rhs.fin) {
+      return false;
+    }
+    if (!repair || !rhs.repair) {
+      return !repair && !rhs.repair;
+    }
+    return folly::IOBufEqualTo()(*repair, *rhs.repair);
+  }
+};
+
 struct StatelessReset {
   StatelessResetToken token;
 
@@ -569,6 +740,17 @@ struct StatelessReset {
       : token(std::move(tokenIn)) {}
 };
 
+// Rarely sent and several times the size of the common frames, so kept out
+// of line to keep the ACK, stream and padding variants small.
+template <>
+struct VariantBoxed<ConnectionCloseFrame> : std::true_type {};
+
+template <>
+struct VariantBoxed<NewConnectionIdFrame> : std::true_type {};
+
+template <>
+struct VariantBoxed<StreamRepairFrame> : std::true_type {};
+
 #define QUIC_SIMPLE_FRAME(F, ...)         \
   F(StopSendingFrame, __VA_ARGS__)        \
   F(MinStreamDataFrame, __VA_ARGS__)      \
@@ -579,7 +761,10 @@ struct StatelessReset {
   F(MaxStreamsFrame, __VA_ARGS__)         \
   F(RetireConnectionIdFrame, __VA_ARGS__) \
   F(PingFrame, __VA_ARGS__)               \
-  F(HandshakeDoneFrame, __VA_ARGS__)
+  F(HandshakeDoneFrame, __VA_ARGS__)      \
+  F(AckFrequencyFrame, __VA_ARGS__)       \
+  F(ImmediateAckFrame, __VA_ARGS__)       \
+  F(StreamRepairFrame, __VA_ARGS__)
 
 DECLARE_VARIANT_TYPE(QuicSimpleFrame, QUIC_SIMPLE_FRAME)
 
@@ -597,6 +782,7 @@ DECLARE_VARIANT_TYPE(QuicSimpleFrame, QUIC_SIMPLE_FRAME)
   F(ReadCryptoFrame, __VA_ARGS__)        \
   F(ReadNewTokenFrame, __VA_ARGS__)      \
   F(QuicSimpleFrame, __VA_ARGS__)        \
+  F(DatagramFrame, __VA_ARGS__)          \
   F(NoopFrame, __VA_ARGS__)
 
 DECLARE_VARIANT_TYPE(QuicFrame, QUIC_FRAME)
@@ -614,6 +800,7 @@ DECLARE_VARIANT_TYPE(QuicFrame, QUIC_FRAME)
   F(WriteStreamFrame, __VA_ARGS__)       \
   F(WriteCryptoFrame, __VA_ARGS__)       \
   F(QuicSimpleFrame, __VA_ARGS__)        \
+  F(DatagramFrame, __VA_ARGS__)          \
   F(NoopFrame, __VA_ARGS__)
 
 // Types of frames which are written.
@@ -632,6 +819,15 @@ enum class ProtectionType {
   KeyPhaseOne,
 };
 
+/**
+ * The key phase of the 1-RTT packets protected by a generation of keys, the
+ * keys of the handshake being generation 0.
+ */
+inline ProtectionType keyPhaseOfGeneration(uint64_t generation) {
+  return generation % 2 == 0 ? ProtectionType::KeyPhaseZero
+                             : ProtectionType::KeyPhaseOne;
+}
+
 struct LongHeaderInvariant {
   QuicVersion version;
   ConnectionId srcConnId;
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// Microbenchmarks of the hot paths of the codec, run with
+// --bm_min_iters=100000 or so for stable numbers.
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/io/Cursor.h>
+
+#include <quic/codec/Decode.h>
+#include <quic/codec/QuicInteger.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/codec/QuicPacketRebuilder.h>
+#include <quic/codec/QuicWriteCodec.h>
+#include <quic/server/state/ServerStateMachine.h>
+
+#include <array>
+
+using namespace quic;
+
+namespace {
+
+// one of each encoded length
+constexpr std::array<uint64_t, 4> kIntegers = {
+    {37, 15293, 494878333, 151288809941952652}};
+
+// what acks look like with a bit of loss, the largest block first
+AckBlocks makeAckBlocks() {
+  AckBlocks ackBlocks;
+  for (PacketNum start = 1000; start > 10; start -= 50) {
+    ackBlocks.insert(start - 40, start);
+  }
+  return ackBlocks;
+}
+
+ConnectionId benchConnectionId() {
+  return ConnectionId(std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8});
+}
+
+RegularQuicPacketBuilder makeBuilder() {
+  return RegularQuicPacketBuilder(
+      kDefaultUDPSendPacketLen,
+      ShortHeader(ProtectionType::KeyPhaseZero, benchConnectionId(), 1000),
+      900 /* largestAcked */);
+}
+
+// A body with the frame mix of a bulk transfer: an ack, a crypto frame and
+// a full sized stream frame.
+Buf makeFrameMix() {
+  auto builder = makeBuilder();
+  auto ackBlocks = makeAckBlocks();
+  AckFrameMetaData ackMeta(ackBlocks, 25us, kDefaultAckDelayExponent);
+  writeAckFrame(ackMeta, builder);
+  writeCryptoFrame(0, folly::IOBuf::copyBuffer("NewSessionTicket"), builder);
+  auto data = folly::IOBuf::create(builder.remainingSpaceInPkt());
+  data->append(builder.remainingSpaceInPkt());
+  auto dataLen = writeStreamFrameHeader(
+      builder,
+      4 /* id */,
+      100000 /* offset */,
+      data->computeChainDataLength(),
+      data->computeChainDataLength(),
+      false /* fin */);
+  writeStreamFrameData(builder, std::move(data), *dataLen);
+  return std::move(builder).buildPacket().body;
+}
+
+// A body with the frame mix of request and response traffic: an ack and
+// small stream frames of several streams.
+Buf makeSmallStreamMix() {
+  auto builder = makeBuilder();
+  auto ackBlocks = makeAckBlocks();
+  AckFrameMetaData ackMeta(ackBlocks, 25us, kDefaultAckDelayExponent);
+  writeAckFrame(ackMeta, builder);
+  for (StreamId id = 0; id < 32 && builder.remainingSpaceInPkt() > 150;
+       id += 4) {
+    auto data = folly::IOBuf::create(100);
+    data->append(100);
+    auto dataLen = writeStreamFrameHeader(
+        builder, id, 2000 /* offset */, 100, 100, id == 28 /* fin */);
+    writeStreamFrameData(builder, std::move(data), *dataLen);
+  }
+  return std::move(builder).buildPacket().body;
+}
+
+// A body with only an ack, as the receiver of a bulk transfer sends.
+Buf makeAckOnly() {
+  auto builder = makeBuilder();
+  auto ackBlocks = makeAckBlocks();
+  AckFrameMetaData ackMeta(ackBlocks, 25us, kDefaultAckDelayExponent);
+  writeAckFrame(ackMeta, builder);
+  return std::move(builder).buildPacket().body;
+}
+
+// Decodes body with the decoder of chained packets, which trims a queue
+// around every frame.
+void decodeWithQueue(const Buf& body, size_t iters) {
+  PacketHeader header(
+      ShortHeader(ProtectionType::KeyPhaseZero, benchConnectionId(), 1000));
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  while (iters--) {
+    BufQueue queue;
+    queue.append(body->clone());
+    while (queue.chainLength() > 0) {
+      folly::doNotOptimizeAway(parseFrame(queue, header, params));
+    }
+  }
+}
+
+// Decodes body with the decoder of contiguous packets, a single cursor
+// walking the buffer.
+void decodeWithCursor(const Buf& body, size_t iters) {
+  PacketHeader header(
+      ShortHeader(ProtectionType::KeyPhaseZero, benchConnectionId(), 1000));
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  while (iters--) {
+    auto packet = body->clone();
+    folly::io::Cursor cursor(packet.get());
+    while (!cursor.isAtEnd()) {
+      folly::doNotOptimizeAway(parseFrame(cursor, header, params));
+    }
+  }
+}
+
+} // namespace
+
+BENCHMARK(EncodeQuicInteger, iters) {
+  auto buf = folly::IOBuf::create(kIntegers.size() * sizeof(uint64_t));
+  while (iters--) {
+    buf->clear();
+    BufAppender appender(buf.get(), 0);
+    for (auto value : kIntegers) {
+      folly::doNotOptimizeAway(encodeQuicInteger(value, appender));
+    }
+  }
+}
+
+BENCHMARK(DecodeQuicInteger, iters) {
+  auto buf = folly::IOBuf::create(kIntegers.size() * sizeof(uint64_t));
+  BufAppender appender(buf.get(), 0);
+  for (auto value : kIntegers) {
+    encodeQuicInteger(value, appender);
+  }
+  while (iters--) {
+    folly::io::Cursor cursor(buf.get());
+    for (size_t i = 0; i < kIntegers.size(); ++i) {
+      folly::doNotOptimizeAway(decodeQuicInteger(cursor));
+    }
+  }
+}
+
+BENCHMARK(ParseFrameMix, iters) {
+  Buf body;
+  BENCHMARK_SUSPEND {
+    body = makeFrameMix();
+  }
+  PacketHeader header(
+      ShortHeader(ProtectionType::KeyPhaseZero, benchConnectionId(), 1000));
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  while (iters--) {
+    folly::io::Cursor cursor(body.get());
+    while (!cursor.isAtEnd()) {
+      folly::doNotOptimizeAway(parseFrame(cursor, header, params));
+    }
+  }
+}
+
+// The two decoders on the same packets, the cursor relative to the queue.
+
+BENCHMARK(DecodeBulkMixQueue, iters) {
+  Buf body;
+  BENCHMARK_SUSPEND {
+    body = makeFrameMix();
+  }
+  decodeWithQueue(body, iters);
+}
+
+BENCHMARK_RELATIVE(DecodeBulkMixCursor, iters) {
+  Buf body;
+  BENCHMARK_SUSPEND {
+    body = makeFrameMix();
+  }
+  decodeWithCursor(body, iters);
+}
+
+BENCHMARK(DecodeSmallStreamMixQueue, iters) {
+  Buf body;
+  BENCHMARK_SUSPEND {
+    body = makeSmallStreamMix();
+  }
+  decodeWithQueue(body, iters);
+}
+
+BENCHMARK_RELATIVE(DecodeSmallStreamMixCursor, iters) {
+  Buf body;
+  BENCHMARK_SUSPEND {
+    body = makeSmallStreamMix();
+  }
+  decodeWithCursor(body, iters);
+}
+
+BENCHMARK(DecodeAckOnlyQueue, iters) {
+  Buf body;
+  BENCHMARK_SUSPEND {
+    body = makeAckOnly();
+  }
+  decodeWithQueue(body, iters);
+}
+
+BENCHMARK_RELATIVE(DecodeAckOnlyCursor, iters) {
+  Buf body;
+  BENCHMARK_SUSPEND {
+    body = makeAckOnly();
+  }
+  decodeWithCursor(body, iters);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(WriteStreamFrameHeader, iters) {
+  while (iters--) {
+    folly::Optional<RegularQuicPacketBuilder> builder;
+    BENCHMARK_SUSPEND {
+      builder.emplace(makeBuilder());
+    }
+    folly::doNotOptimizeAway(writeStreamFrameHeader(
+        *builder, 4 /* id */, 100000, 1200, 1200, false /* fin */));
+    BENCHMARK_SUSPEND {
+      builder.clear();
+    }
+  }
+}
+
+BENCHMARK(WriteAckFrame, iters) {
+  auto ackBlocks = makeAckBlocks();
+  AckFrameMetaData ackMeta(ackBlocks, 25us, kDefaultAckDelayExponent);
+  while (iters--) {
+    folly::Optional<RegularQuicPacketBuilder> builder;
+    BENCHMARK_SUSPEND {
+      builder.emplace(makeBuilder());
+    }
+    folly::doNotOptimizeAway(writeAckFrame(ackMeta, *builder));
+    BENCHMARK_SUSPEND {
+      builder.clear();
+    }
+  }
+}
+
+BENCHMARK(BuildPacket, iters) {
+  auto data = folly::IOBuf::create(1000);
+  data->append(1000);
+  while (iters--) {
+    auto builder = makeBuilder();
+    auto dataLen = writeStreamFrameHeader(
+        builder, 4 /* id */, 100000, 1000, 1000, false /* fin */);
+    writeStreamFrameData(builder, data->clone(), *dataLen);
+    folly::doNotOptimizeAway(std::move(builder).buildPacket());
+  }
+}
+
+BENCHMARK(RebuildPacket, iters) {
+  QuicServerConnectionState conn;
+  folly::Optional<OutstandingPacket> outstanding;
+  BENCHMARK_SUSPEND {
+    conn.streamManager->setMaxLocalBidirectionalStreams(10);
+    auto stream = conn.streamManager->createNextBidirectionalStream().value();
+    auto data = folly::IOBuf::create(1000);
+    data->append(1000);
+    auto builder = makeBuilder();
+    auto dataLen = writeStreamFrameHeader(
+        builder, stream->id, 0, 1000, 1000, false /* fin */);
+    writeStreamFrameData(builder, data->clone(), *dataLen);
+    auto packet = std::move(builder).buildPacket();
+    stream->retransmissionBuffer.emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(0),
+        std::forward_as_tuple(std::move(data), 0, false));
+    outstanding.emplace(packet.packet, Clock::now(), 1000, false, 1000);
+  }
+  while (iters--) {
+    auto builder = makeBuilder();
+    PacketRebuilder rebuilder(builder, conn);
+    folly::doNotOptimizeAway(rebuilder.rebuildFromPacket(*outstanding));
+    folly::doNotOptimizeAway(std::move(builder).buildPacket());
+  }
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -217,6 +217,79 @@ TEST_F(DecodeTest, ValidAckFrame) {
   EXPECT_EQ(ackFrame.ackDelay.count(), 100 << kDefaultAckDelayExponent);
 }
 
+TEST_F(DecodeTest, AckFrameViewMatchesAckFrame) {
+  std::vector<NormalizedAckBlock> ackBlocks;
+  ackBlocks.emplace_back(QuicInteger(10), QuicInteger(10));
+  ackBlocks.emplace_back(QuicInteger(0), QuicInteger(0));
+  ackBlocks.emplace_back(QuicInteger(3), QuicInteger(20));
+  auto result = createAckFrame(
+      QuicInteger(1000),
+      QuicInteger(100),
+      QuicInteger(ackBlocks.size()),
+      QuicInteger(10),
+      ackBlocks);
+  result->prependChain(folly::IOBuf::copyBuffer("x"));
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  folly::io::Cursor cursor(result.get());
+  auto ackFrame = decodeAckFrame(cursor, makeHeader(), params);
+  folly::io::Cursor viewCursor(result.get());
+  auto ackFrameView = decodeAckFrameView(viewCursor, makeHeader(), params);
+  // Both leave the cursor after the frame.
+  EXPECT_EQ(viewCursor.totalLength(), 1);
+  EXPECT_EQ(cursor.totalLength(), 1);
+
+  EXPECT_EQ(ackFrameView.largestAcked(), ackFrame.largestAcked);
+  EXPECT_EQ(ackFrameView.ackDelay(), ackFrame.ackDelay);
+  for (const auto& ackBlock : ackFrame.ackBlocks) {
+    auto viewBlock = ackFrameView.nextBlock();
+    ASSERT_TRUE(viewBlock.has_value());
+    EXPECT_EQ(viewBlock->startPacket, ackBlock.startPacket);
+    EXPECT_EQ(viewBlock->endPacket, ackBlock.endPacket);
+  }
+  EXPECT_FALSE(ackFrameView.nextBlock().has_value());
+}
+
+TEST_F(DecodeTest, AckFrameViewDecodesBlocksLazily) {
+  std::vector<NormalizedAckBlock> ackBlocks;
+  ackBlocks.emplace_back(QuicInteger(10), QuicInteger(10));
+  // Underflows the packet number space.
+  ackBlocks.emplace_back(QuicInteger(1000), QuicInteger(0));
+  auto result = createAckFrame(
+      QuicInteger(1000),
+      QuicInteger(100),
+      QuicInteger(ackBlocks.size()),
+      QuicInteger(10),
+      ackBlocks);
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  folly::io::Cursor cursor(result.get());
+  EXPECT_THROW(
+      decodeAckFrame(cursor, makeHeader(), params), QuicTransportException);
+  folly::io::Cursor viewCursor(result.get());
+  auto ackFrameView = decodeAckFrameView(viewCursor, makeHeader(), params);
+  EXPECT_TRUE(ackFrameView.nextBlock().has_value());
+  EXPECT_TRUE(ackFrameView.nextBlock().has_value());
+  EXPECT_THROW(ackFrameView.nextBlock(), QuicTransportException);
+}
+
+TEST_F(DecodeTest, AckFrameViewBlocksEncodingInvalid) {
+  std::vector<NormalizedAckBlock> ackBlocks;
+  ackBlocks.emplace_back(QuicInteger(10), QuicInteger(10));
+  // One more block than encoded.
+  auto result = createAckFrame(
+      QuicInteger(1000),
+      QuicInteger(100),
+      QuicInteger(ackBlocks.size() + 1),
+      QuicInteger(10),
+      ackBlocks);
+  folly::io::Cursor cursor(result.get());
+  EXPECT_THROW(
+      decodeAckFrameView(
+          cursor,
+          makeHeader(),
+          CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST)),
+      QuicTransportException);
+}
+
 TEST_F(DecodeTest, AckFrameLargestAckExceedsRange) {
   // An integer larger than the representable range of quic integer.
   QuicInteger largestAcked(std::numeric_limits<uint64_t>::max());
@@ -568,6 +641,79 @@ TEST_F(DecodeTest, StreamIncorrectDataLength) {
   EXPECT_THROW(decodeStreamFrame(queue, streamType), QuicTransportException);
 }
 
+TEST_F(DecodeTest, StreamDecodeFromCursor) {
+  QuicInteger streamId(10);
+  QuicInteger offset(10);
+  QuicInteger length(1);
+  auto streamType =
+      StreamTypeField::Builder().setOffset().setLength().build();
+  auto streamFrame = createStreamFrame(
+      streamId, offset, length, folly::IOBuf::copyBuffer("ab"));
+  streamFrame->coalesce();
+  folly::io::Cursor cursor(streamFrame.get());
+  auto decodedFrame = decodeStreamFrame(cursor, streamType);
+  EXPECT_EQ(decodedFrame.offset, 10);
+  EXPECT_EQ(decodedFrame.streamId, 10);
+  EXPECT_FALSE(decodedFrame.fin);
+  EXPECT_EQ(decodedFrame.data->moveToFbString().toStdString(), "a");
+  EXPECT_EQ(cursor.totalLength(), 1);
+}
+
+TEST_F(DecodeTest, DecodeRegularPacketContiguousAndChained) {
+  auto frames = folly::IOBuf::create(0);
+  BufAppender appender(frames.get(), 10);
+  appender.writeBE<uint8_t>(static_cast<uint8_t>(FrameType::PING));
+  appender.writeBE<uint8_t>(
+      StreamTypeField::Builder().setOffset().setLength().build().fieldValue());
+  appender.insert(createStreamFrame(
+      QuicInteger(4),
+      QuicInteger(10),
+      QuicInteger(5),
+      folly::IOBuf::copyBuffer("hello")));
+  appender.writeBE<uint8_t>(static_cast<uint8_t>(FrameType::MAX_DATA));
+  QuicInteger(1000).encode(appender);
+  appender.writeBE<uint8_t>(
+      StreamTypeField::Builder().setFin().build().fieldValue());
+  appender.insert(createStreamFrame(
+      QuicInteger(8),
+      folly::none,
+      folly::none,
+      folly::IOBuf::copyBuffer("world")));
+  auto contiguous = frames->cloneCoalesced();
+  auto chained = folly::IOBuf::copyBuffer(contiguous->data(), 3);
+  chained->prependChain(folly::IOBuf::copyBuffer(
+      contiguous->data() + 3, contiguous->length() - 3));
+
+  std::vector<Buf> packets;
+  packets.push_back(std::move(contiguous));
+  packets.push_back(std::move(chained));
+  for (auto& packetData : packets) {
+    auto packet = decodeRegularPacket(
+        makeHeader(),
+        CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST),
+        std::move(packetData));
+    ASSERT_EQ(packet.frames.size(), 4);
+    auto simpleFrame = packet.frames[0].asQuicSimpleFrame();
+    ASSERT_NE(simpleFrame, nullptr);
+    EXPECT_NE(simpleFrame->asPingFrame(), nullptr);
+    auto firstStream = packet.frames[1].asReadStreamFrame();
+    ASSERT_NE(firstStream, nullptr);
+    EXPECT_EQ(firstStream->streamId, 4);
+    EXPECT_EQ(firstStream->offset, 10);
+    EXPECT_FALSE(firstStream->fin);
+    EXPECT_EQ(firstStream->data->moveToFbString().toStdString(), "hello");
+    auto maxData = packet.frames[2].asMaxDataFrame();
+    ASSERT_NE(maxData, nullptr);
+    EXPECT_EQ(maxData->maximumData, 1000);
+    auto lastStream = packet.frames[3].asReadStreamFrame();
+    ASSERT_NE(lastStream, nullptr);
+    EXPECT_EQ(lastStream->streamId, 8);
+    EXPECT_EQ(lastStream->offset, 0);
+    EXPECT_TRUE(lastStream->fin);
+    EXPECT_EQ(lastStream->data->moveToFbString().toStdString(), "world");
+  }
+}
+
 TEST_F(DecodeTest, CryptoDecodeSuccess) {
   QuicInteger offset(10);
   QuicInteger length(1);
@@ -52,6 +52,25 @@ TEST(ConnectionIdTest, CompareConnId) {
   EXPECT_EQ(connid4, connid3);
 }
 
+TEST(ConnectionIdTest, ConnIdHash) {
+  ConnectionIdHash hash;
+  for (size_t size : {4, 8, 12, 16, 20}) {
+    std::vector<uint8_t> data(size, 0x5a);
+    auto connId = ConnectionId::createWithoutChecks(data);
+    EXPECT_EQ(hash(connId), ConnectionIdHash()(connId));
+    for (size_t i = 0; i < size; ++i) {
+      auto changed = data;
+      changed[i] ^= 1;
+      EXPECT_NE(hash(connId), hash(ConnectionId::createWithoutChecks(changed)))
+          << "size=" << size << " byte=" << i;
+    }
+  }
+  // Same trailing bytes, different length.
+  EXPECT_NE(
+      hash(ConnectionId::createWithoutChecks(std::vector<uint8_t>(8, 0))),
+      hash(ConnectionId::createWithoutChecks(std::vector<uint8_t>(9, 0))));
+}
+
 TEST(ConnectionIdTest, ConnIdSize) {
   std::vector<uint8_t> testconnid;
   for (size_t i = 0; i < kMaxConnectionIdSize + 2; ++i) {
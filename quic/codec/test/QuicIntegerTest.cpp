@@ -72,6 +72,35 @@ TEST_P(QuicIntegerDecodeTest, DecodeAtMost) {
   }
 }
 
+TEST_P(QuicIntegerDecodeTest, DecodeWithTrailingBytes) {
+  if (GetParam().error) {
+    return;
+  }
+  // Enough bytes after the integer for decoding it with a single load.
+  std::string encodedBytes =
+      folly::unhexlify(GetParam().hexEncoded) + std::string(8, '\xff');
+  auto wrappedEncoded = IOBuf::copyBuffer(encodedBytes);
+  folly::io::Cursor cursor(wrappedEncoded.get());
+  auto originalLength = cursor.length();
+  auto decodedValue = decodeQuicInteger(cursor);
+  ASSERT_TRUE(decodedValue.has_value());
+  EXPECT_EQ(decodedValue->first, GetParam().decoded);
+  EXPECT_EQ(decodedValue->second, GetParam().encodedLength);
+  EXPECT_EQ(cursor.length(), originalLength - GetParam().encodedLength);
+
+  folly::io::Cursor atMostCursor(wrappedEncoded.get());
+  auto tooLong = decodeQuicInteger(atMostCursor, GetParam().encodedLength - 1);
+  EXPECT_FALSE(tooLong.has_value());
+  EXPECT_EQ(atMostCursor.length(), originalLength);
+
+  auto rangeValue = decodeQuicInteger(folly::ByteRange(
+      wrappedEncoded->data(),
+      wrappedEncoded->data() + GetParam().encodedLength));
+  ASSERT_TRUE(rangeValue.has_value());
+  EXPECT_EQ(rangeValue->first, GetParam().decoded);
+  EXPECT_EQ(rangeValue->second, GetParam().encodedLength);
+}
+
 TEST_P(QuicIntegerEncodeTest, Encode) {
   auto queue = folly::IOBuf::create(0);
   BufAppender appender(queue.get(), 10);
@@ -11,6 +11,7 @@
 #include <folly/Random.h>
 #include <quic/codec/QuicPacketBuilder.h>
 #include <quic/codec/QuicReadCodec.h>
+#include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
 #include <quic/codec/test/Mocks.h>
 #include <quic/common/test/TestUtils.h>
@@ -389,3 +390,140 @@ TEST_F(QuicPacketBuilderTest, ShortHeaderBytesCounting) {
       std::move(builder).buildPacket().header->computeChainDataLength(),
       headerBytes);
 }
+
+TEST_F(QuicPacketBuilderTest, ShortHeaderContiguousBody) {
+  auto connId = getTestConnectionId();
+  PacketNum pktNum = 222;
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen,
+      ShortHeader(ProtectionType::KeyPhaseZero, connId, pktNum),
+      0 /* largestAcked */);
+  builder.setCipherOverhead(kCipherOverheadHeuristic);
+  auto bodyBuf =
+      folly::IOBuf::create(kMaxShortHeaderSize + kDefaultUDPSendPacketLen);
+  bodyBuf->advance(kMaxShortHeaderSize);
+  auto bodyPtr = bodyBuf.get();
+  builder.setBodyBuffer(std::move(bodyBuf));
+
+  auto streamData = folly::IOBuf::copyBuffer("hello");
+  streamData->prependChain(folly::IOBuf::copyBuffer(" world"));
+  auto dataLen = *writeStreamFrameHeader(
+      builder, 4, 0, streamData->computeChainDataLength(), 100, false);
+  BufQueue writeBuffer(std::move(streamData));
+  writeStreamFrameData(builder, writeBuffer, dataLen);
+  auto builtOut = std::move(builder).buildPacket();
+
+  // Inserted stream data is copied into the one body buffer we handed in, with
+  // the headroom for the header still in front of it.
+  EXPECT_EQ(bodyPtr, builtOut.body.get());
+  EXPECT_FALSE(builtOut.body->isChained());
+  EXPECT_EQ(kMaxShortHeaderSize, builtOut.body->headroom());
+  EXPECT_GE(builtOut.body->tailroom(), kCipherOverheadHeuristic);
+
+  auto resultBuf = packetToBuf(builtOut);
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(std::move(resultBuf));
+  auto parsedPacket =
+      makeCodec(
+          connId, QuicNodeType::Client, nullptr, quic::test::createNoOpAead())
+          ->parsePacket(packetQueue, ackStates);
+  auto& decodedPacket = *parsedPacket.regularPacket();
+  ASSERT_EQ(1, decodedPacket.frames.size());
+  auto& decodedStreamFrame = *decodedPacket.frames[0].asReadStreamFrame();
+  EXPECT_EQ(4, decodedStreamFrame.streamId);
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      folly::IOBuf::copyBuffer("hello world"), decodedStreamFrame.data));
+}
+
+TEST_F(QuicPacketBuilderTest, InplaceShortHeaderPackets) {
+  auto connId = getTestConnectionId();
+  auto buffer = folly::IOBuf::create(2 * kDefaultUDPSendPacketLen);
+  std::vector<RegularQuicPacketBuilder::Packet> builtPackets;
+  for (PacketNum pktNum = 222; pktNum < 224; pktNum++) {
+    InplaceQuicPacketBuilder builder(
+        *buffer,
+        kDefaultUDPSendPacketLen,
+        ShortHeader(ProtectionType::KeyPhaseZero, connId, pktNum),
+        0 /* largestAcked */);
+    RegularQuicPacketBuilder regularBuilder(
+        kDefaultUDPSendPacketLen,
+        ShortHeader(ProtectionType::KeyPhaseZero, connId, pktNum),
+        0 /* largestAcked */);
+    EXPECT_TRUE(builder.canBuildPacket());
+    EXPECT_EQ(builder.getHeaderBytes(), regularBuilder.getHeaderBytes());
+    EXPECT_EQ(
+        builder.remainingSpaceInPkt(), regularBuilder.remainingSpaceInPkt());
+
+    auto streamData = folly::IOBuf::copyBuffer("hello");
+    streamData->prependChain(folly::IOBuf::copyBuffer(" world"));
+    auto dataLen = *writeStreamFrameHeader(
+        builder, 4, 0, streamData->computeChainDataLength(), 100, false);
+    writeStreamFrameData(builder, std::move(streamData), dataLen);
+    builtPackets.push_back(std::move(builder).buildPacket());
+  }
+
+  // Both packets were laid out back to back in the one buffer.
+  EXPECT_FALSE(buffer->isChained());
+  EXPECT_EQ(buffer->data(), builtPackets[0].header->data());
+  EXPECT_EQ(builtPackets[0].body->tail(), builtPackets[1].header->data());
+  EXPECT_EQ(builtPackets[1].body->tail(), buffer->tail());
+
+  for (size_t i = 0; i < builtPackets.size(); i++) {
+    auto& builtOut = builtPackets[i];
+    EXPECT_FALSE(builtOut.body->isChained());
+    EXPECT_EQ(builtOut.header->tail(), builtOut.body->data());
+    auto resultBuf = packetToBuf(builtOut);
+    AckStates ackStates;
+    auto packetQueue = bufToQueue(std::move(resultBuf));
+    auto parsedPacket =
+        makeCodec(
+            connId, QuicNodeType::Client, nullptr, quic::test::createNoOpAead())
+            ->parsePacket(packetQueue, ackStates);
+    auto& decodedPacket = *parsedPacket.regularPacket();
+    EXPECT_EQ(222 + i, decodedPacket.header.getPacketSequenceNum());
+    ASSERT_EQ(1, decodedPacket.frames.size());
+    auto& decodedStreamFrame = *decodedPacket.frames[0].asReadStreamFrame();
+    EXPECT_EQ(4, decodedStreamFrame.streamId);
+    EXPECT_TRUE(folly::IOBufEqualTo()(
+        folly::IOBuf::copyBuffer("hello world"), decodedStreamFrame.data));
+  }
+}
+
+TEST_F(QuicPacketBuilderTest, InplaceLongHeaderPacketLength) {
+  PacketNum pktNum = 444;
+  auto buffer = folly::IOBuf::create(kDefaultUDPSendPacketLen);
+  InplaceQuicPacketBuilder builder(
+      *buffer,
+      kDefaultUDPSendPacketLen,
+      LongHeader(
+          LongHeader::Types::Handshake,
+          getTestConnectionId(0),
+          getTestConnectionId(1),
+          pktNum,
+          QuicVersion::MVFST),
+      0 /* largestAcked */,
+      QuicVersion::MVFST);
+  builder.setCipherOverhead(kCipherOverheadHeuristic);
+  ASSERT_TRUE(builder.canBuildPacket());
+  ASSERT_TRUE(writeCryptoFrame(0, folly::IOBuf::copyBuffer("CHLO"), builder));
+  auto builtOut = std::move(builder).buildPacket();
+  auto encodedPacketNum = encodePacketNumber(pktNum, 0);
+
+  // The packet length and the packet number end the header.
+  folly::io::Cursor cursor(builtOut.header.get());
+  cursor.skip(
+      builtOut.header->length() - kMaxPacketLenSize - encodedPacketNum.length);
+  auto packetLength = decodeQuicInteger(cursor);
+  ASSERT_TRUE(packetLength);
+  EXPECT_EQ(kMaxPacketLenSize, packetLength->second);
+  EXPECT_EQ(
+      encodedPacketNum.length + builtOut.body->length() +
+          kCipherOverheadHeuristic,
+      packetLength->first);
+  PacketNum writtenPacketNum = 0;
+  for (size_t i = 0; i < encodedPacketNum.length; i++) {
+    writtenPacketNum = (writtenPacketNum << 8) | cursor.read<uint8_t>();
+  }
+  EXPECT_EQ(encodedPacketNum.result, writtenPacketNum);
+  EXPECT_EQ(1, builtOut.packet.frames.size());
+}
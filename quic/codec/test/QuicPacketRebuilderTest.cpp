@@ -264,6 +264,83 @@ TEST_F(QuicPacketRebuilderTest, FinOnlyStreamRebuild) {
   EXPECT_TRUE(folly::IOBufEqualTo()(*packet1.body, *packet2.body));
 }
 
+TEST_F(QuicPacketRebuilderTest, ResendKeptBody) {
+  ShortHeader shortHeader1(
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), 0);
+  RegularQuicPacketBuilder regularBuilder1(
+      kDefaultUDPSendPacketLen, std::move(shortHeader1), 0 /* largestAcked */);
+  QuicServerConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  auto streamId = stream->id;
+  auto buf = folly::IOBuf::copyBuffer("Hold on to the body.");
+  writeStreamFrameHeader(
+      regularBuilder1,
+      streamId,
+      0,
+      buf->computeChainDataLength(),
+      buf->computeChainDataLength(),
+      true);
+  writeStreamFrameData(
+      regularBuilder1, buf->clone(), buf->computeChainDataLength());
+  auto packet1 = std::move(regularBuilder1).buildPacket();
+  stream->retransmissionBuffer.emplace(
+      std::piecewise_construct,
+      std::forward_as_tuple(0),
+      std::forward_as_tuple(buf->clone(), 0, true));
+
+  ShortHeader shortHeader2(
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), 0);
+  RegularQuicPacketBuilder regularBuilder2(
+      kDefaultUDPSendPacketLen, std::move(shortHeader2), 0 /* largestAcked */);
+  PacketRebuilder rebuilder(regularBuilder2, conn);
+  auto outstanding = makeDummyOutstandingPacket(packet1.packet, 1000);
+  outstanding.body = packet1.body->cloneCoalesced();
+  EXPECT_TRUE(rebuilder.rebuildFromPacket(outstanding).has_value());
+  auto packet2 = std::move(regularBuilder2).buildPacket();
+  // The kept body is shared with the clone rather than rebuilt.
+  EXPECT_TRUE(outstanding.body->isShared());
+  ASSERT_EQ(1, packet2.packet.frames.size());
+  const WriteStreamFrame* streamFrame =
+      packet2.packet.frames.front().asWriteStreamFrame();
+  ASSERT_NE(streamFrame, nullptr);
+  EXPECT_EQ(streamId, streamFrame->streamId);
+  EXPECT_EQ(buf->computeChainDataLength(), streamFrame->len);
+  EXPECT_TRUE(folly::IOBufEqualTo()(*packet1.body, *packet2.body));
+}
+
+TEST_F(QuicPacketRebuilderTest, KeptBodyNotResentAfterStreamDataChanged) {
+  ShortHeader shortHeader1(
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), 0);
+  RegularQuicPacketBuilder regularBuilder1(
+      kDefaultUDPSendPacketLen, std::move(shortHeader1), 0 /* largestAcked */);
+  QuicServerConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  auto buf = folly::IOBuf::copyBuffer("Gone by now.");
+  writeStreamFrameHeader(
+      regularBuilder1,
+      stream->id,
+      0,
+      buf->computeChainDataLength(),
+      buf->computeChainDataLength(),
+      false);
+  writeStreamFrameData(
+      regularBuilder1, buf->clone(), buf->computeChainDataLength());
+  auto packet1 = std::move(regularBuilder1).buildPacket();
+  // The data is no longer in the retransmission buffer, as if it got acked.
+
+  ShortHeader shortHeader2(
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), 0);
+  RegularQuicPacketBuilder regularBuilder2(
+      kDefaultUDPSendPacketLen, std::move(shortHeader2), 0 /* largestAcked */);
+  PacketRebuilder rebuilder(regularBuilder2, conn);
+  auto outstanding = makeDummyOutstandingPacket(packet1.packet, 1000);
+  outstanding.body = packet1.body->cloneCoalesced();
+  EXPECT_FALSE(rebuilder.rebuildFromPacket(outstanding).has_value());
+  EXPECT_FALSE(outstanding.body->isShared());
+}
+
 TEST_F(QuicPacketRebuilderTest, RebuildDataStreamAndEmptyCryptoStream) {
   ShortHeader shortHeader1(
       ProtectionType::KeyPhaseZero, getTestConnectionId(), 0);
@@ -25,6 +25,15 @@ bool isReset(CodecResult&& result) {
   return result.statelessReset() != nullptr;
 }
 
+// the token of a stateless reset with the bytes of packet, its last ones
+StatelessResetToken getTailToken(const folly::IOBuf& packet) {
+  auto data = packet.cloneCoalescedAsValue();
+  StatelessResetToken token;
+  CHECK_GE(data.length(), token.size());
+  memcpy(token.data(), data.tail() - token.size(), token.size());
+  return token;
+}
+
 class QuicReadCodecTest : public Test {};
 
 std::unique_ptr<QuicReadCodec> makeUnencryptedCodec() {
@@ -208,6 +217,34 @@ TEST_F(QuicReadCodecTest, StreamWithShortHeader) {
   EXPECT_TRUE(parseSuccess(std::move(packet)));
 }
 
+TEST_F(QuicReadCodecTest, StreamWithShortHeaderKnownConnId) {
+  auto connId = getTestConnectionId();
+  PacketNum packetNum = 12321;
+  StreamId streamId = 2;
+
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto codec = makeEncryptedCodec(connId, createNoOpAead());
+  codec->setServerConnectionId(connId);
+  for (const auto& dstConnId : {connId, getTestConnectionId(1)}) {
+    auto streamPacket = createStreamPacket(
+        connId,
+        dstConnId,
+        packetNum++,
+        streamId,
+        *data,
+        0 /* cipherOverhead */,
+        0 /* largestAcked */);
+    AckStates ackStates;
+    auto packetQueue = bufToQueue(packetToBuf(streamPacket));
+    auto result = codec->parsePacket(packetQueue, ackStates);
+    auto regularPacket = result.regularPacket();
+    ASSERT_NE(regularPacket, nullptr);
+    auto shortHeader = regularPacket->header.asShort();
+    ASSERT_NE(shortHeader, nullptr);
+    EXPECT_EQ(shortHeader->getConnectionId(), dstConnId);
+  }
+}
+
 TEST_F(QuicReadCodecTest, StreamWithShortHeaderOnlyHeader) {
   auto connId = getTestConnectionId();
   PacketNum packetNum = 12321;
@@ -344,19 +381,67 @@ TEST_F(QuicReadCodecTest, KeyPhaseOnePacket) {
   EXPECT_FALSE(parseSuccess(std::move(packet)));
 }
 
+TEST_F(QuicReadCodecTest, KeyUpdate) {
+  auto connId = getTestConnectionId();
+  StreamId streamId = 2;
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto makePacket = [&](PacketNum packetNum, ProtectionType keyPhase) {
+    auto streamPacket = createStreamPacket(
+        connId,
+        connId,
+        packetNum,
+        streamId,
+        *data,
+        0 /* cipherOverhead */,
+        0 /* largestAcked */,
+        folly::none,
+        true,
+        keyPhase);
+    return bufToQueue(packetToBuf(streamPacket));
+  };
+  auto decryptWith = [](MockAead& aead, PacketNum packetNum) {
+    EXPECT_CALL(aead, _tryDecrypt(_, _, packetNum))
+        .WillOnce(Invoke([](auto& buf, const auto, auto) {
+          return folly::Optional<std::unique_ptr<folly::IOBuf>>(
+              std::move(buf));
+        }));
+  };
+  auto currentAead = std::make_unique<MockAead>();
+  auto nextAead = std::make_unique<MockAead>();
+  auto currentAeadPtr = currentAead.get();
+  auto nextAeadPtr = nextAead.get();
+  auto codec = makeEncryptedCodec(connId, std::move(currentAead));
+  codec->setNextOneRttReadCipher(std::move(nextAead));
+  AckStates ackStates;
+
+  decryptWith(*currentAeadPtr, 10);
+  auto packetQueue = makePacket(10, ProtectionType::KeyPhaseZero);
+  EXPECT_TRUE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+
+  // The peer's first packet with the next keys moves the codec on to them.
+  decryptWith(*nextAeadPtr, 12);
+  packetQueue = makePacket(12, ProtectionType::KeyPhaseOne);
+  EXPECT_TRUE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+  EXPECT_EQ(1, codec->getOneRttReadKeyGeneration());
+  EXPECT_EQ(nextAeadPtr, codec->getOneRttReadCipher());
+  EXPECT_EQ(nullptr, codec->getNextOneRttReadCipher());
+
+  // A late packet of the old phase still reads with the old keys.
+  decryptWith(*currentAeadPtr, 11);
+  packetQueue = makePacket(11, ProtectionType::KeyPhaseZero);
+  EXPECT_TRUE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+
+  // Another update needs the next keys first.
+  packetQueue = makePacket(13, ProtectionType::KeyPhaseZero);
+  EXPECT_FALSE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+  EXPECT_EQ(1, codec->getOneRttReadKeyGeneration());
+}
+
 TEST_F(QuicReadCodecTest, FailToDecryptLeadsToReset) {
   auto connId = getTestConnectionId();
   auto aead = std::make_unique<MockAead>();
   auto rawAead = aead.get();
 
-  StatelessResetToken tok(
-      {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16});
-  auto fakeToken = std::make_unique<StatelessResetToken>(tok);
-  auto codec = makeEncryptedCodec(
-      connId, std::move(aead), nullptr, std::move(fakeToken));
-  EXPECT_CALL(*rawAead, _tryDecrypt(_, _, _))
-      .Times(1)
-      .WillOnce(Invoke([](auto&, const auto&, auto) { return folly::none; }));
   PacketNum packetNum = 1;
   StreamId streamId = 2;
   auto data = folly::IOBuf::create(30);
@@ -372,25 +457,59 @@ TEST_F(QuicReadCodecTest, FailToDecryptLeadsToReset) {
       folly::none,
       true,
       ProtectionType::KeyPhaseZero);
+  auto packetBuf = packetToBuf(streamPacket);
+  auto fakeToken =
+      std::make_unique<StatelessResetToken>(getTailToken(*packetBuf));
+  auto codec = makeEncryptedCodec(
+      connId, std::move(aead), nullptr, std::move(fakeToken));
+  EXPECT_CALL(*rawAead, _tryDecrypt(_, _, _))
+      .Times(1)
+      .WillOnce(Invoke([](auto&, const auto&, auto) { return folly::none; }));
   AckStates ackStates;
-  auto packetQueue = bufToQueue(packetToBuf(streamPacket));
+  auto packetQueue = bufToQueue(std::move(packetBuf));
   auto packet = codec->parsePacket(packetQueue, ackStates);
   EXPECT_TRUE(isReset(std::move(packet)));
 }
 
-TEST_F(QuicReadCodecTest, ShortPacketAutoPaddedIsReset) {
+TEST_F(QuicReadCodecTest, FailToDecryptWrongTokenNoReset) {
   auto connId = getTestConnectionId();
   auto aead = std::make_unique<MockAead>();
   auto rawAead = aead.get();
-  StatelessResetToken tok(
-      {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16});
+
+  PacketNum packetNum = 1;
+  StreamId streamId = 2;
+  auto data = folly::IOBuf::create(30);
+  data->append(30);
+  auto streamPacket = createStreamPacket(
+      connId,
+      connId,
+      packetNum,
+      streamId,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true,
+      ProtectionType::KeyPhaseZero);
+  auto packetBuf = packetToBuf(streamPacket);
+  auto tok = getTailToken(*packetBuf);
+  tok.back() = ~tok.back();
   auto fakeToken = std::make_unique<StatelessResetToken>(tok);
   auto codec = makeEncryptedCodec(
       connId, std::move(aead), nullptr, std::move(fakeToken));
-
   EXPECT_CALL(*rawAead, _tryDecrypt(_, _, _))
       .Times(1)
       .WillOnce(Invoke([](auto&, const auto&, auto) { return folly::none; }));
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(std::move(packetBuf));
+  auto packet = codec->parsePacket(packetQueue, ackStates);
+  EXPECT_FALSE(isReset(std::move(packet)));
+}
+
+TEST_F(QuicReadCodecTest, ShortPacketAutoPaddedIsReset) {
+  auto connId = getTestConnectionId();
+  auto aead = std::make_unique<MockAead>();
+  auto rawAead = aead.get();
   PacketNum packetNum = 1;
   StreamId streamId = 2;
   auto data = folly::IOBuf::create(3);
@@ -406,8 +525,17 @@ TEST_F(QuicReadCodecTest, ShortPacketAutoPaddedIsReset) {
       folly::none,
       true,
       ProtectionType::KeyPhaseZero);
+  auto packetBuf = packetToBuf(streamPacket);
+  auto fakeToken =
+      std::make_unique<StatelessResetToken>(getTailToken(*packetBuf));
+  auto codec = makeEncryptedCodec(
+      connId, std::move(aead), nullptr, std::move(fakeToken));
+
+  EXPECT_CALL(*rawAead, _tryDecrypt(_, _, _))
+      .Times(1)
+      .WillOnce(Invoke([](auto&, const auto&, auto) { return folly::none; }));
   AckStates ackStates;
-  auto packetQueue = bufToQueue(packetToBuf(streamPacket));
+  auto packetQueue = bufToQueue(std::move(packetBuf));
   auto packet = codec->parsePacket(packetQueue, ackStates);
   EXPECT_TRUE(isReset(std::move(packet)));
 }
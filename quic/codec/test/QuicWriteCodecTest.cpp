@@ -144,6 +144,33 @@ TEST_F(QuicWriteCodecTest, WriteStreamFrameToEmptyPacket) {
   EXPECT_TRUE(folly::IOBufEqualTo()(inputBuf, decodedStreamFrame.data));
 }
 
+TEST_F(QuicWriteCodecTest, RegularBuilderThroughInterface) {
+  auto inputBuf = buildRandomInputData(10);
+  auto writeFrames = [&](auto& builder) {
+    auto dataLen = writeStreamFrameHeader(builder, 1, 100, 10, 10, true);
+    ASSERT_TRUE(dataLen);
+    ASSERT_EQ(*dataLen, 10);
+    writeStreamFrameData(builder, inputBuf->clone(), *dataLen);
+    EXPECT_GT(writeFrame(MaxDataFrame(1000), builder), 0);
+    EXPECT_GT(writeSimpleFrame(PingFrame(), builder), 0);
+  };
+  RegularQuicPacketBuilder directBuilder(
+      kDefaultUDPSendPacketLen, buildTestShortHeader(), 0 /* largestAcked */);
+  writeFrames(directBuilder);
+  RegularQuicPacketBuilder erasedBuilder(
+      kDefaultUDPSendPacketLen, buildTestShortHeader(), 0 /* largestAcked */);
+  PacketBuilderInterface& builderInterface = erasedBuilder;
+  writeFrames(builderInterface);
+  EXPECT_EQ(
+      directBuilder.remainingSpaceInPkt(), erasedBuilder.remainingSpaceInPkt());
+
+  auto directPacket = std::move(directBuilder).buildPacket();
+  auto erasedPacket = std::move(erasedBuilder).buildPacket();
+  EXPECT_EQ(directPacket.packet.frames.size(), 3);
+  EXPECT_EQ(erasedPacket.packet.frames.size(), 3);
+  EXPECT_TRUE(folly::IOBufEqualTo()(directPacket.body, erasedPacket.body));
+}
+
 TEST_F(QuicWriteCodecTest, WriteStreamFrameToPartialPacket) {
   MockQuicPacketBuilder pktBuilder;
   // 1000 bytes already gone in this packet
@@ -648,6 +675,8 @@ TEST_F(QuicWriteCodecTest, WriteSimpleAckFrame) {
   auto regularPacket = builtOut.first;
   WriteAckFrame& ackFrame = *regularPacket.frames.back().asWriteAckFrame();
   EXPECT_EQ(ackFrame.ackBlocks.size(), 2);
+  // Kept within the inline storage of the frame.
+  EXPECT_EQ(ackFrame.ackBlocks.capacity(), kNumInlineWriteAckBlocks);
   auto iter = ackFrame.ackBlocks.crbegin();
   EXPECT_EQ(iter->start, 101);
   EXPECT_EQ(iter->end, 400);
@@ -671,6 +700,37 @@ TEST_F(QuicWriteCodecTest, WriteSimpleAckFrame) {
   EXPECT_EQ(decodedAckFrame.ackBlocks[1].endPacket, 400);
 }
 
+TEST_F(QuicWriteCodecTest, WriteEcnAckFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  auto ackDelay = 111us;
+  AckBlocks ackBlocks = {{501, 1000}, {101, 400}};
+  AckFrameMetaData meta(ackBlocks, ackDelay, kDefaultAckDelayExponent);
+  EcnCounts ecnCounts;
+  ecnCounts.ect0 = 200;
+  ecnCounts.ce = 3;
+  meta.ecnCounts = ecnCounts;
+
+  // The 11 bytes of the same ACK frame, then 2 bytes for the ECT(0) count, 1
+  // byte for the ECT(1) count and 1 byte for the CE count => 15 bytes
+  auto result = *writeAckFrame(meta, pktBuilder);
+
+  EXPECT_EQ(15, result.bytesWritten);
+  EXPECT_EQ(kDefaultUDPSendPacketLen - 15, pktBuilder.remainingSpaceInPkt());
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto wireBuf = std::move(builtOut.second);
+  BufQueue queue;
+  queue.append(wireBuf->clone());
+  QuicFrame decodedFrame = parseQuicFrame(queue);
+  auto& decodedAckFrame = *decodedFrame.asReadAckFrame();
+  EXPECT_EQ(decodedAckFrame.largestAcked, 1000);
+  EXPECT_EQ(decodedAckFrame.ackBlocks.size(), 2);
+  ASSERT_TRUE(decodedAckFrame.ecnCounts.has_value());
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ect0, 200);
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ect1, 0);
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ce, 3);
+}
+
 TEST_F(QuicWriteCodecTest, WriteAckFrameWillSaveAckDelay) {
   MockQuicPacketBuilder pktBuilder;
   setupCommonExpects(pktBuilder);
@@ -1388,6 +1448,74 @@ TEST_F(QuicWriteCodecTest, WriteRetireConnId) {
   EXPECT_EQ(queue.chainLength(), 0);
 }
 
+TEST_F(QuicWriteCodecTest, WriteAckFrequency) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  AckFrequencyFrame ackFrequency(1, 20, 5000us, true);
+  auto bytesWritten = writeFrame(QuicSimpleFrame(ackFrequency), pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // 2 bytes for the type, 1 for the sequence, 1 for the tolerance, 2 for the
+  // delay and 1 for ignore order.
+  EXPECT_EQ(bytesWritten, 7);
+  EXPECT_EQ(
+      ackFrequency,
+      *regularPacket.frames[0].asQuicSimpleFrame()->asAckFrequencyFrame());
+
+  auto wireBuf = std::move(builtOut.second);
+  BufQueue queue;
+  queue.append(wireBuf->clone());
+  QuicFrame decodedFrame = parseQuicFrame(queue);
+  QuicSimpleFrame& simpleFrame = *decodedFrame.asQuicSimpleFrame();
+  EXPECT_EQ(ackFrequency, *simpleFrame.asAckFrequencyFrame());
+  EXPECT_EQ(queue.chainLength(), 0);
+}
+
+TEST_F(QuicWriteCodecTest, WriteImmediateAck) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  auto bytesWritten =
+      writeFrame(QuicSimpleFrame(ImmediateAckFrame()), pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  EXPECT_EQ(bytesWritten, 2);
+
+  auto wireBuf = std::move(builtOut.second);
+  BufQueue queue;
+  queue.append(wireBuf->clone());
+  QuicFrame decodedFrame = parseQuicFrame(queue);
+  EXPECT_NE(nullptr, decodedFrame.asQuicSimpleFrame()->asImmediateAckFrame());
+  EXPECT_EQ(queue.chainLength(), 0);
+}
+
+TEST_F(QuicWriteCodecTest, WriteStreamRepair) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  StreamRepairFrame streamRepair(
+      4, {{0, 6}, {6, 4}}, true, folly::IOBuf::copyBuffer("repair"));
+  auto bytesWritten = writeFrame(QuicSimpleFrame(streamRepair), pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // 2 bytes for the type, 1 for the stream id, 1 for fin, 1 for the count, 4
+  // for the ranges, 1 for the repair length and 6 for the repair.
+  EXPECT_EQ(bytesWritten, 16);
+  // The written frame does not keep the repair, it is never resent.
+  auto& writtenFrame =
+      *regularPacket.frames[0].asQuicSimpleFrame()->asStreamRepairFrame();
+  EXPECT_EQ(writtenFrame.ranges, streamRepair.ranges);
+  EXPECT_FALSE(writtenFrame.repair);
+
+  auto wireBuf = std::move(builtOut.second);
+  BufQueue queue;
+  queue.append(wireBuf->clone());
+  QuicFrame decodedFrame = parseQuicFrame(queue);
+  QuicSimpleFrame& simpleFrame = *decodedFrame.asQuicSimpleFrame();
+  EXPECT_EQ(streamRepair, *simpleFrame.asStreamRepairFrame());
+  EXPECT_EQ(queue.chainLength(), 0);
+}
+
 TEST_F(QuicWriteCodecTest, WriteStopSending) {
   MockQuicPacketBuilder pktBuilder;
   setupCommonExpects(pktBuilder);
@@ -1538,5 +1666,30 @@ TEST_F(QuicWriteCodecTest, WritePathResponse) {
   EXPECT_EQ(wirePathResponseFrame.pathData, pathData);
   EXPECT_EQ(queue.chainLength(), 0);
 }
+
+TEST_F(QuicWriteCodecTest, WriteDatagram) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  auto data = folly::IOBuf::copyBuffer("datagram");
+  auto length = data->computeChainDataLength();
+  auto bytesWritten =
+      writeFrame(DatagramFrame(length, data->clone()), pktBuilder);
+  // 1 byte for the type, 1 for the length
+  EXPECT_EQ(bytesWritten, length + 2);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // The written frame does not keep the data, it is never resent.
+  EXPECT_EQ(regularPacket.frames[0].asDatagramFrame()->length, length);
+
+  auto wireBuf = std::move(builtOut.second);
+  BufQueue queue;
+  queue.append(wireBuf->clone());
+  QuicFrame decodedFrame = parseQuicFrame(queue);
+  auto& datagramFrame = *decodedFrame.asDatagramFrame();
+  EXPECT_EQ(datagramFrame.length, length);
+  EXPECT_TRUE(folly::IOBufEqualTo()(datagramFrame.data, data));
+  EXPECT_EQ(queue.chainLength(), 0);
+}
 } // namespace test
 } // namespace quic
@@ -221,6 +221,18 @@ TEST_F(TypesTest, ShortHeaderPacketNumberSpace) {
   EXPECT_EQ(PacketNumberSpace::AppData, shortHeaderOne.getPacketNumberSpace());
 }
 
+TEST_F(TypesTest, FrameVariantsFitCacheLine) {
+  EXPECT_LE(sizeof(QuicSimpleFrame), 64);
+  EXPECT_LE(sizeof(QuicWriteFrame), 64);
+
+  QuicWriteFrame close(ConnectionCloseFrame(
+      QuicErrorCode(TransportErrorCode::INTERNAL_ERROR), "reason"));
+  QuicWriteFrame copy(close);
+  ASSERT_NE(copy.asConnectionCloseFrame(), nullptr);
+  EXPECT_EQ(copy.asConnectionCloseFrame()->reasonPhrase, "reason");
+  EXPECT_NE(copy.asConnectionCloseFrame(), close.asConnectionCloseFrame());
+}
+
 TEST_F(TypesTest, LongHeaderPacketNumberSpace) {
   LongHeader initialLongHeader(
       LongHeader::Types::Initial,
@@ -2,6 +2,20 @@
 
 #include "quic/common/BufUtil.h"
 
+#include <folly/MPMCQueue.h>
+#include <folly/io/Cursor.h>
+#include <folly/portability/SysMman.h>
+#include <glog/logging.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+void releaseBufOwner(void* /* buf */, void* userData) {
+  delete static_cast<folly::IOBuf*>(userData);
+}
+} // namespace
+
 namespace quic {
 
 Buf BufQueue::splitAtMost(size_t len) {
@@ -20,6 +34,10 @@ Buf BufQueue::splitAtMost(size_t len) {
       if (remaining < current->length()) {
         clone = current->cloneOne();
         clone->trimStart(remaining);
+        if (current == packTail_) {
+          // The rest of the page stays in the queue, it keeps packing.
+          packTail_ = clone.get();
+        }
       }
       current->trimEnd(current->length() - remaining);
       remaining = 0;
@@ -49,6 +67,7 @@ Buf BufQueue::splitAtMost(size_t len) {
     result = std::move(chain_);
   }
   chainLength_ -= (len - remaining);
+  checkPackTail();
   DCHECK_EQ(chainLength_, chain_ ? chain_->computeChainDataLength() : 0);
   if (result == nullptr) {
     return folly::IOBuf::create(0);
@@ -56,6 +75,26 @@ Buf BufQueue::splitAtMost(size_t len) {
   return result;
 }
 
+Buf BufQueue::splitUnsharedAtMost(size_t len) {
+  if (!chain_ || chain_->isChained()) {
+    return splitAtMost(len);
+  }
+  len = std::min(len, chain_->length());
+  if (len == chain_->length() && !chain_->isSharedOne()) {
+    return move();
+  }
+  auto owner = chain_->cloneOne();
+  auto result = folly::IOBuf::takeOwnership(
+      chain_->writableData(), len, releaseBufOwner, owner.release());
+  chain_->trimStart(len);
+  chainLength_ -= len;
+  if (chainLength_ == 0) {
+    chain_.reset();
+  }
+  checkPackTail();
+  return result;
+}
+
 size_t BufQueue::trimStartAtMost(size_t amount) {
   auto original = amount;
   folly::IOBuf* current = chain_.get();
@@ -94,6 +133,7 @@ size_t BufQueue::trimStartAtMost(size_t amount) {
   size_t trimmed = original - amount;
   DCHECK_GE(chainLength_, trimmed);
   chainLength_ -= trimmed;
+  checkPackTail();
   DCHECK(chainLength_ == 0 || !chain_->empty());
   return trimmed;
 }
@@ -113,6 +153,38 @@ void BufQueue::append(Buf&& buf) {
   }
   chainLength_ += buf->computeChainDataLength();
   appendToChain(chain_, std::move(buf));
+  packTail_ = nullptr;
+}
+
+void BufQueue::appendPacked(
+    Buf&& buf,
+    size_t maxCopyLength,
+    size_t pageSize) {
+  if (!buf || buf->empty()) {
+    return;
+  }
+  auto len = buf->computeChainDataLength();
+  if (len > maxCopyLength) {
+    append(std::move(buf));
+    return;
+  }
+  // The page may be shared with what was split off it, that ends before the
+  // room written to here.
+  if (!packTail_ || packTail_->tailroom() < len) {
+    auto page = folly::IOBuf::create(std::max(pageSize, len));
+    packTail_ = page.get();
+    appendToChain(chain_, std::move(page));
+  }
+  folly::io::Cursor cursor(buf.get());
+  cursor.pull(packTail_->writableTail(), len);
+  packTail_->append(len);
+  chainLength_ += len;
+}
+
+void BufQueue::checkPackTail() {
+  if (!chain_ || chain_->prev() != packTail_) {
+    packTail_ = nullptr;
+  }
 }
 
 void BufQueue::appendToChain(Buf& dst, Buf&& src) {
@@ -140,13 +212,215 @@ void BufAppender::push(const uint8_t* data, size_t len) {
 
 void BufAppender::insert(std::unique_ptr<folly::IOBuf> data) {
   // just skip the current buffer and append it to the end of the current
-  // buffer.
-  folly::IOBuf* dataPtr = data.get();
-  // If the buffer is shared we do not want to overrwrite the tail of the
-  // buffer.
-  lastBufShared_ = data->isShared();
+  // buffer. Later pushes go after the last buffer of the inserted chain.
+  folly::IOBuf* tail = data->prev();
+  // If the buffer is shared, e.g. application data that is also kept for
+  // retransmission or written to other connections, we do not want to
+  // overwrite its tail.
+  lastBufShared_ = tail->isSharedOne();
   head_->prependChain(std::move(data));
-  crtBuf_ = dataPtr;
+  crtBuf_ = tail;
+}
+
+std::unique_ptr<HugePageRegion> HugePageRegion::make(size_t len) {
+  size_t size = std::max<size_t>(
+      (len + kHugePageSize - 1) / kHugePageSize * kHugePageSize,
+      kHugePageSize);
+#ifdef MAP_HUGETLB
+  void* data = mmap(
+      nullptr,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+      -1,
+      0);
+  if (data != MAP_FAILED) {
+    return std::unique_ptr<HugePageRegion>(
+        new HugePageRegion(static_cast<uint8_t*>(data), size, true));
+  }
+  VLOG(2) << "No free huge pages for " << size << " bytes, errno=" << errno;
+#endif
+  // Transparent huge pages need the region aligned to them, so one more page
+  // is mapped and the unaligned ends are given back.
+  size_t mapLen = size + kHugePageSize;
+  void* area = mmap(
+      nullptr,
+      mapLen,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (area == MAP_FAILED) {
+    LOG(ERROR) << "Unable to map " << size << " bytes, errno=" << errno;
+    return nullptr;
+  }
+  auto begin = reinterpret_cast<uintptr_t>(area);
+  auto aligned = (begin + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  if (aligned > begin) {
+    munmap(area, aligned - begin);
+  }
+  if (begin + mapLen > aligned + size) {
+    munmap(
+        reinterpret_cast<void*>(aligned + size),
+        begin + mapLen - aligned - size);
+  }
+  auto regionData = reinterpret_cast<uint8_t*>(aligned);
+#ifdef MADV_HUGEPAGE
+  madvise(regionData, size, MADV_HUGEPAGE);
+#endif
+  // Faulted in now rather than on the data path.
+  memset(regionData, 0, size);
+  return std::unique_ptr<HugePageRegion>(
+      new HugePageRegion(regionData, size, false));
+}
+
+HugePageRegion::~HugePageRegion() {
+  munmap(data_, size_);
+}
+
+/**
+ * The buffers of a huge page backed pool, shared with the IOBufs wrapping
+ * them. The last of the pool and the IOBufs deletes it.
+ */
+struct PacketBufferPool::Arena {
+  Arena(
+      std::unique_ptr<HugePageRegion> regionIn,
+      size_t sliceSizeIn,
+      size_t numSlices)
+      : region(std::move(regionIn)),
+        sliceSize(sliceSizeIn),
+        returnedSlices(std::max<size_t>(numSlices, 1)) {}
+
+  static void freeSlice(void* buf, void* userData) {
+    auto arena = static_cast<Arena*>(userData);
+    // Never full, it has room for all the slices.
+    CHECK(arena->returnedSlices.write(
+        static_cast<uint8_t*>(buf) - arena->region->data()));
+    arena->release();
+  }
+
+  Buf wrap(size_t offset) {
+    refs.fetch_add(1, std::memory_order_relaxed);
+    return folly::IOBuf::takeOwnership(
+        region->data() + offset, sliceSize, 0, freeSlice, this);
+  }
+
+  bool owns(const folly::IOBuf& buf) const {
+    return buf.buffer() >= region->data() &&
+        buf.buffer() < region->data() + region->size();
+  }
+
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  std::unique_ptr<HugePageRegion> region;
+  size_t sliceSize;
+  // slices whose IOBufs were freed, on any thread
+  folly::MPMCQueue<size_t> returnedSlices;
+  // one for the pool and one for each IOBuf wrapping a slice
+  std::atomic<size_t> refs{1};
+};
+
+PacketBufferPool::PacketBufferPool(
+    size_t bufSize,
+    size_t maxBufs,
+    bool hugePages)
+    : bufSize_(bufSize), maxBufs_(maxBufs) {
+  freeBufs_.reserve(maxBufs_);
+  if (!hugePages || !maxBufs_) {
+    return;
+  }
+  // cache line aligned buffers
+  size_t sliceSize = (bufSize_ + 63) & ~size_t(63);
+  auto region = HugePageRegion::make(sliceSize * maxBufs_);
+  if (!region) {
+    return;
+  }
+  arena_ = new Arena(std::move(region), sliceSize, maxBufs_);
+  for (size_t i = 0; i < maxBufs_; ++i) {
+    freeBufs_.push_back(arena_->wrap(i * sliceSize));
+  }
+}
+
+PacketBufferPool::~PacketBufferPool() {
+  freeBufs_.clear();
+  if (arena_) {
+    arena_->release();
+  }
+}
+
+Buf PacketBufferPool::acquire(size_t len) {
+  if (len <= bufSize_ && freeBufs_.empty() && arena_) {
+    size_t offset;
+    if (arena_->returnedSlices.read(offset)) {
+      return arena_->wrap(offset);
+    }
+  }
+  if (len > bufSize_ || freeBufs_.empty()) {
+    ++allocations_;
+    return folly::IOBuf::create(std::max(len, bufSize_));
+  }
+  auto buf = std::move(freeBufs_.back());
+  freeBufs_.pop_back();
+  return buf;
+}
+
+void PacketBufferPool::release(Buf&& buf) {
+  if (!buf) {
+    return;
+  }
+  DCHECK(!buf->isChained());
+  // A huge page backed pool only keeps its own buffers.
+  if (freeBufs_.size() >= maxBufs_ || buf->isSharedOne() ||
+      buf->capacity() < bufSize_ || (arena_ && !arena_->owns(*buf))) {
+    buf.reset();
+    return;
+  }
+  buf->clear();
+  freeBufs_.push_back(std::move(buf));
+}
+
+PacketBufferPool::Stats PacketBufferPool::stats() const {
+  Stats stats;
+  stats.bufSize = bufSize_;
+  stats.maxBufs = maxBufs_;
+  stats.available = freeBufs_.size();
+  if (arena_) {
+    stats.regionBytes = arena_->region->size();
+    stats.hugeTlb = arena_->region->hugeTlb();
+  }
+  stats.allocations = allocations_;
+  return stats;
+}
+
+void PacketBufferPool::releaseChain(Buf&& buf) {
+  while (buf) {
+    auto rest = buf->pop();
+    release(std::move(buf));
+    buf = std::move(rest);
+  }
+}
+
+void splitSegments(Buf data, size_t segmentSize, std::vector<Buf>& segments) {
+  DCHECK(!data->isChained());
+  size_t len = data->length();
+  if (!segmentSize || len <= segmentSize) {
+    segments.emplace_back(std::move(data));
+    return;
+  }
+  size_t offset = 0;
+  while (len - offset > segmentSize) {
+    auto segment = data->cloneOne();
+    segment->trimStart(offset);
+    segment->trimEnd(len - offset - segmentSize);
+    segments.emplace_back(std::move(segment));
+    offset += segmentSize;
+  }
+  data->trimStart(offset);
+  segments.emplace_back(std::move(data));
 }
 
 } // namespace quic
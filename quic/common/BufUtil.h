@@ -3,6 +3,9 @@
 #pragma once
 #include <folly/io/IOBuf.h>
 
+#include <memory>
+#include <vector>
+
 namespace quic {
 using Buf = std::unique_ptr<folly::IOBuf>;
 
@@ -17,15 +20,20 @@ class BufQueue {
   }
 
   BufQueue(BufQueue&& other) noexcept
-      : chain_(std::move(other.chain_)), chainLength_(other.chainLength_) {
+      : chain_(std::move(other.chain_)),
+        chainLength_(other.chainLength_),
+        packTail_(other.packTail_) {
     other.chainLength_ = 0;
+    other.packTail_ = nullptr;
   }
 
   BufQueue& operator=(BufQueue&& other) {
     if (&other != this) {
       chain_ = std::move(other.chain_);
       chainLength_ = other.chainLength_;
+      packTail_ = other.packTail_;
       other.chainLength_ = 0;
+      other.packTail_ = nullptr;
     }
     return *this;
   }
@@ -43,6 +51,7 @@ class BufQueue {
 
   Buf move() {
     chainLength_ = 0;
+    packTail_ = nullptr;
     return std::move(chain_);
   }
 
@@ -52,16 +61,48 @@ class BufQueue {
 
   Buf splitAtMost(size_t n);
 
+  /**
+   * Like splitAtMost, but when the queue holds a single unchained buffer the
+   * returned buffer is a view of its first n bytes that is not shared, so it
+   * can be written to in place (e.g. decrypted) without a copy. The view keeps
+   * the memory alive with a reference of its own on the original buffer.
+   * Nothing else may write to the returned range. Chained data falls back to
+   * splitAtMost.
+   */
+  Buf splitUnsharedAtMost(size_t n);
+
   size_t trimStartAtMost(size_t amount);
 
   void trimStart(size_t amount);
 
   void append(Buf&& buf);
 
+  /**
+   * Like append, but a buf of at most maxCopyLength bytes is copied to the
+   * end of the last page the queue allocated for it, when that one is still
+   * the tail of the queue and has the room, instead of being chained. A
+   * queue many small writes are appended to then holds a few buffers instead
+   * of one per write, which is what splitting and cloning it walks, and what
+   * is split off it shares the pages instead of copying them. The pages are
+   * allocated with pageSize bytes.
+   *
+   * The data split or cloned off a page is still written after, so the
+   * queue must be the only one writing to the room past it. Consumers that
+   * extend a shared buffer, like BufAppender, don't.
+   */
+  void appendPacked(Buf&& buf, size_t maxCopyLength, size_t pageSize);
+
  private:
   void appendToChain(Buf& dst, Buf&& src);
+  // Forgets packTail_ once it is no longer the tail of the chain.
+  void checkPackTail();
+
   Buf chain_;
   size_t chainLength_{0};
+  // The tail of the chain when it is a page appendPacked allocated, or a
+  // view of one the data before it was split off. It is never dereferenced
+  // after leaving the chain.
+  folly::IOBuf* packTail_{nullptr};
 };
 
 class BufAppender {
@@ -85,4 +126,123 @@ class BufAppender {
   bool lastBufShared_{false};
 };
 
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+/**
+ * Anonymous memory for the data path, rounded up to whole 2MB huge pages.
+ * It comes from the kernel's huge page pool when that has enough free pages,
+ * and from regular pages the kernel is asked to back with transparent huge
+ * pages otherwise.
+ */
+class HugePageRegion {
+ public:
+  // null if the memory can't be mapped at all
+  static std::unique_ptr<HugePageRegion> make(size_t len);
+
+  ~HugePageRegion();
+
+  HugePageRegion(const HugePageRegion&) = delete;
+  HugePageRegion& operator=(const HugePageRegion&) = delete;
+
+  uint8_t* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  // whether the memory came from the huge page pool
+  bool hugeTlb() const {
+    return hugeTlb_;
+  }
+
+ private:
+  HugePageRegion(uint8_t* data, size_t size, bool hugeTlb)
+      : data_(data), size_(size), hugeTlb_(hugeTlb) {}
+
+  uint8_t* data_;
+  size_t size_;
+  bool hugeTlb_;
+};
+
+/**
+ * A fixed-size free list of packet sized IOBufs. The write path grabs a buffer
+ * to encode and seal a packet in, and the batch writers hand the buffers back
+ * once the socket write has returned, so a steady-state sender doesn't hit
+ * malloc for every packet. Not thread-safe: a pool is meant to be used from a
+ * single EventBase thread.
+ *
+ * With hugePages, the maxBufs buffers are carved out of one HugePageRegion
+ * up front, so the data path touches few TLB entries, and only those are
+ * pooled. A pool buffer that gets freed rather than released gives its
+ * memory back to the pool, from any thread.
+ */
+class PacketBufferPool {
+ public:
+  struct Stats {
+    size_t bufSize{0};
+    size_t maxBufs{0};
+    // buffers sitting in the free list
+    size_t available{0};
+    // bytes of the huge page region, 0 without one
+    size_t regionBytes{0};
+    bool hugeTlb{false};
+    // acquires the pool had no buffer for
+    uint64_t allocations{0};
+  };
+
+  PacketBufferPool(size_t bufSize, size_t maxBufs, bool hugePages = false);
+
+  ~PacketBufferPool();
+
+  PacketBufferPool(const PacketBufferPool&) = delete;
+  PacketBufferPool& operator=(const PacketBufferPool&) = delete;
+
+  /**
+   * Returns an empty buffer of at least len bytes of capacity. Requests that
+   * are larger than the pool buffer size are served by a fresh allocation.
+   */
+  Buf acquire(size_t len);
+
+  /**
+   * Returns a single (unchained) buffer to the pool. Buffers that are shared,
+   * too small, or don't fit into the pool anymore are freed.
+   */
+  void release(Buf&& buf);
+
+  /**
+   * Unchains buf and releases every element of the chain.
+   */
+  void releaseChain(Buf&& buf);
+
+  size_t bufSize() const {
+    return bufSize_;
+  }
+
+  // Number of buffers currently sitting in the free list.
+  size_t available() const {
+    return freeBufs_.size();
+  }
+
+  Stats stats() const;
+
+ private:
+  struct Arena;
+
+  size_t bufSize_;
+  size_t maxBufs_;
+  std::vector<Buf> freeBufs_;
+  Arena* arena_{nullptr};
+  uint64_t allocations_{0};
+};
+
+/**
+ * Splits data, a single buffer holding back to back segments of segmentSize
+ * bytes with a possibly shorter last one, into one buffer per segment and
+ * appends them to segments. The segments share the memory of data, nothing
+ * is copied. A segmentSize of 0 appends data as is.
+ */
+void splitSegments(Buf data, size_t segmentSize, std::vector<Buf>& segments);
+
 } // namespace quic
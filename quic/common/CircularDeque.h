@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+/**
+ * Double ended queue kept in one ring buffer that doubles when it is full.
+ * Unlike a std::deque, an empty one allocates nothing and a small one one
+ * small block, which matters when a connection keeps one per stream.
+ * Inserting or erasing in the middle moves the elements after the position,
+ * it is meant for queues that are mostly pushed at the back and popped at
+ * the front. T has to be default constructible.
+ */
+template <typename T>
+class CircularDeque {
+  template <typename Deque, typename Value>
+  class Iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename std::remove_const<Value>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    Iterator() = default;
+    Iterator(Deque* deque, size_t index) : deque_(deque), index_(index) {}
+
+    reference operator*() const {
+      return (*deque_)[index_];
+    }
+    pointer operator->() const {
+      return &(*deque_)[index_];
+    }
+    reference operator[](difference_type n) const {
+      return (*deque_)[index_ + n];
+    }
+
+    Iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto it = *this;
+      ++index_;
+      return it;
+    }
+    Iterator& operator--() {
+      --index_;
+      return *this;
+    }
+    Iterator operator--(int) {
+      auto it = *this;
+      --index_;
+      return it;
+    }
+    Iterator& operator+=(difference_type n) {
+      index_ += n;
+      return *this;
+    }
+    Iterator& operator-=(difference_type n) {
+      index_ -= n;
+      return *this;
+    }
+    Iterator operator+(difference_type n) const {
+      return Iterator(deque_, index_ + n);
+    }
+    Iterator operator-(difference_type n) const {
+      return Iterator(deque_, index_ - n);
+    }
+    difference_type operator-(const Iterator& other) const {
+      return static_cast<difference_type>(index_) -
+          static_cast<difference_type>(other.index_);
+    }
+
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+    bool operator<(const Iterator& other) const {
+      return index_ < other.index_;
+    }
+    bool operator>(const Iterator& other) const {
+      return index_ > other.index_;
+    }
+    bool operator<=(const Iterator& other) const {
+      return index_ <= other.index_;
+    }
+    bool operator>=(const Iterator& other) const {
+      return index_ >= other.index_;
+    }
+
+   private:
+    friend class CircularDeque;
+
+    Deque* deque_{nullptr};
+    // Position from the front of the deque
+    size_t index_{0};
+  };
+
+ public:
+  using value_type = T;
+  using iterator = Iterator<CircularDeque, T>;
+  using const_iterator = Iterator<const CircularDeque, const T>;
+
+  CircularDeque() = default;
+
+  CircularDeque(const CircularDeque& other) {
+    *this = other;
+  }
+
+  CircularDeque(CircularDeque&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  CircularDeque& operator=(const CircularDeque& other) {
+    if (this == &other) {
+      return *this;
+    }
+    clear();
+    for (const auto& value : other) {
+      emplace_back(value);
+    }
+    return *this;
+  }
+
+  CircularDeque& operator=(CircularDeque&& other) noexcept {
+    buf_ = std::move(other.buf_);
+    capacity_ = other.capacity_;
+    head_ = other.head_;
+    size_ = other.size_;
+    other.capacity_ = 0;
+    other.head_ = 0;
+    other.size_ = 0;
+    return *this;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  T& operator[](size_t index) {
+    DCHECK_LT(index, size_);
+    return buf_[(head_ + index) & (capacity_ - 1)];
+  }
+
+  const T& operator[](size_t index) const {
+    DCHECK_LT(index, size_);
+    return buf_[(head_ + index) & (capacity_ - 1)];
+  }
+
+  T& front() {
+    return (*this)[0];
+  }
+
+  const T& front() const {
+    return (*this)[0];
+  }
+
+  T& back() {
+    return (*this)[size_ - 1];
+  }
+
+  const T& back() const {
+    return (*this)[size_ - 1];
+  }
+
+  iterator begin() {
+    return iterator(this, 0);
+  }
+
+  iterator end() {
+    return iterator(this, size_);
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, size_);
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+      grow();
+    }
+    ++size_;
+    back() = T(std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  void emplace_front(Args&&... args) {
+    if (size_ == capacity_) {
+      grow();
+    }
+    head_ = (head_ + capacity_ - 1) & (capacity_ - 1);
+    ++size_;
+    front() = T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Inserts before pos, moving the elements from pos on back by one.
+   */
+  template <typename... Args>
+  iterator emplace(iterator pos, Args&&... args) {
+    auto index = pos.index_;
+    DCHECK_LE(index, size_);
+    T value(std::forward<Args>(args)...);
+    emplace_back();
+    for (auto i = size_ - 1; i > index; --i) {
+      (*this)[i] = std::move((*this)[i - 1]);
+    }
+    (*this)[index] = std::move(value);
+    return iterator(this, index);
+  }
+
+  /**
+   * Erases pos, moving the elements after it forward by one.
+   */
+  iterator erase(iterator pos) {
+    auto index = pos.index_;
+    DCHECK_LT(index, size_);
+    for (auto i = index; i + 1 < size_; ++i) {
+      (*this)[i] = std::move((*this)[i + 1]);
+    }
+    pop_back();
+    return iterator(this, index);
+  }
+
+  void pop_front() {
+    // Reset so that what the element owns is released now.
+    front() = T();
+    head_ = (head_ + 1) & (capacity_ - 1);
+    --size_;
+  }
+
+  void pop_back() {
+    back() = T();
+    --size_;
+  }
+
+  /**
+   * Empties the deque, it keeps its buffer.
+   */
+  void clear() {
+    while (!empty()) {
+      pop_back();
+    }
+    head_ = 0;
+  }
+
+ private:
+  static constexpr size_t kInitialCapacity = 4;
+
+  void grow() {
+    // Stays a power of two, so index wraps with a mask.
+    size_t capacity = kInitialCapacity;
+    if (capacity_) {
+      capacity = capacity_ * 2;
+    }
+    auto buf = std::make_unique<T[]>(capacity);
+    for (size_t i = 0; i < size_; ++i) {
+      buf[i] = std::move((*this)[i]);
+    }
+    buf_ = std::move(buf);
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+  std::unique_ptr<T[]> buf_;
+  size_t capacity_{0};
+  size_t head_{0};
+  size_t size_{0};
+};
+
+} // namespace quic
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/CoarseClock.h>
+
+namespace quic {
+
+CoarseClock::CoarseClock(folly::EventBase* evb, ClockFunc clock)
+    : evb_(evb), clock_(std::move(clock)) {}
+
+TimePoint CoarseClock::refresh() noexcept {
+  now_ = clock_ ? clock_() : Clock::now();
+  if (!isLoopCallbackScheduled()) {
+    evb_->runBeforeLoop(this);
+  }
+  return *now_;
+}
+
+void CoarseClock::runLoopCallback() noexcept {
+  now_ = folly::none;
+}
+
+} // namespace quic
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+
+#include <functional>
+
+namespace quic {
+
+/**
+ * The time of an evb, read at most once per loop iteration, on the first
+ * now() in it, and again wherever refresh() is called, e.g. after a batch of
+ * socket reads. For the bookkeeping that doesn't need more precision than
+ * that, so that it doesn't have to read the clock every time. Rtt samples,
+ * pacing and timers keep reading Clock::now().
+ *
+ * What is read is dropped before the next iteration waits for events, rather
+ * than refreshed, so that the time after the wait is never stale by it.
+ *
+ * Must be made and used on the evb's thread.
+ */
+class CoarseClock : public folly::EventBase::LoopCallback {
+ public:
+  using ClockFunc = std::function<TimePoint()>;
+
+  /**
+   * Reads the time from clock if set, from Clock::now() otherwise.
+   */
+  explicit CoarseClock(folly::EventBase* evb, ClockFunc clock = nullptr);
+  ~CoarseClock() override = default;
+
+  TimePoint now() noexcept {
+    if (!now_) {
+      refresh();
+    }
+    return *now_;
+  }
+
+  /**
+   * Reads the clock again, and returns what it read.
+   */
+  TimePoint refresh() noexcept;
+
+  void runLoopCallback() noexcept override;
+
+ private:
+  folly::EventBase* evb_;
+  ClockFunc clock_;
+  folly::Optional<TimePoint> now_;
+};
+
+} // namespace quic
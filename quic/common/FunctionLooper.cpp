@@ -18,11 +18,39 @@ FunctionLooper::FunctionLooper(
     LooperType type)
     : evb_(evb), func_(std::move(func)), type_(type) {}
 
+FunctionLooper::~FunctionLooper() {
+  if (pacingCalendar_) {
+    pacingCalendar_->cancelWrite(this);
+  }
+  if (looperQueue_) {
+    looperQueue_->cancel(this);
+  }
+}
+
 void FunctionLooper::setPacingTimer(
     TimerHighRes::SharedPtr pacingTimer) noexcept {
   pacingTimer_ = std::move(pacingTimer);
 }
 
+void FunctionLooper::setPacingCalendar(
+    std::shared_ptr<PacingCalendar> calendar) noexcept {
+  if (pacingCalendar_) {
+    pacingCalendar_->cancelWrite(this);
+  }
+  pacingCalendar_ = std::move(calendar);
+}
+
+void FunctionLooper::setLooperQueue(
+    std::shared_ptr<LooperQueue> queue) noexcept {
+  DCHECK(!queue || !evb_ || queue->getEventBase() == evb_);
+  bool scheduled = isLoopScheduled();
+  cancelRunInLoop();
+  looperQueue_ = std::move(queue);
+  if (scheduled) {
+    runInLoop(false);
+  }
+}
+
 void FunctionLooper::setPacingFunction(
     folly::Function<std::chrono::microseconds()>&& pacingFunc) {
   pacingFunc_ = std::move(pacingFunc);
@@ -43,21 +71,51 @@ void FunctionLooper::commonLoopBody(bool fromTimer) noexcept {
     return;
   }
   if (!schedulePacingTimeout(fromTimer)) {
-    evb_->runInLoop(this);
+    runInLoop(false);
+  }
+}
+
+void FunctionLooper::runInLoop(bool thisIteration) noexcept {
+  if (looperQueue_) {
+    looperQueue_->post(this, thisIteration);
+  } else {
+    evb_->runInLoop(this, thisIteration);
+  }
+}
+
+void FunctionLooper::cancelRunInLoop() noexcept {
+  cancelLoopCallback();
+  if (looperQueue_) {
+    looperQueue_->cancel(this);
   }
 }
 
+bool FunctionLooper::isLoopScheduled() const {
+  return isLoopCallbackScheduled() ||
+      (looperQueue_ && looperQueue_->isPosted(this));
+}
+
 bool FunctionLooper::schedulePacingTimeout(bool /* fromTimer */) noexcept {
-  if (pacingFunc_ && pacingTimer_ && !isScheduled()) {
+  if (pacingFunc_ && (pacingTimer_ || pacingCalendar_) &&
+      !isPacingScheduled()) {
     auto nextPacingTime = (*pacingFunc_)();
     if (nextPacingTime != 0us) {
-      pacingTimer_->scheduleTimeout(this, nextPacingTime);
+      if (pacingCalendar_) {
+        pacingCalendar_->scheduleWrite(this, nextPacingTime);
+      } else {
+        pacingTimer_->scheduleTimeout(this, nextPacingTime);
+      }
       return true;
     }
   }
   return false;
 }
 
+bool FunctionLooper::isPacingScheduled() const {
+  return isScheduled() ||
+      (pacingCalendar_ && pacingCalendar_->isWriteScheduled(this));
+}
+
 void FunctionLooper::runLoopCallback() noexcept {
   folly::DelayedDestruction::DestructorGuard dg(this);
   commonLoopBody(false);
@@ -68,23 +126,26 @@ void FunctionLooper::run(bool thisIteration) noexcept {
   running_ = true;
   // Caller can call run() in func_. But if we are in pacing mode, we should
   // prevent such loop.
-  if (pacingTimer_ && inLoopBody_) {
+  if ((pacingTimer_ || pacingCalendar_) && inLoopBody_) {
     VLOG(4) << __func__ << ": " << type_
             << " in loop body and using pacing - not rescheduling";
     return;
   }
-  if (isLoopCallbackScheduled() || isScheduled()) {
+  if (isLoopScheduled() || isPacingScheduled()) {
     VLOG(10) << __func__ << ": " << type_ << " already scheduled";
     return;
   }
-  evb_->runInLoop(this, thisIteration);
+  runInLoop(thisIteration);
 }
 
 void FunctionLooper::stop() noexcept {
   VLOG(10) << __func__ << ": " << type_;
   running_ = false;
-  cancelLoopCallback();
+  cancelRunInLoop();
   cancelTimeout();
+  if (pacingCalendar_) {
+    pacingCalendar_->cancelWrite(this);
+  }
 }
 
 bool FunctionLooper::isRunning() const {
@@ -103,6 +164,8 @@ void FunctionLooper::detachEventBase() {
   DCHECK(evb_ && evb_->isInEventBaseThread());
   stop();
   cancelTimeout();
+  // The queue belongs to the evb.
+  looperQueue_.reset();
   evb_ = nullptr;
 }
 
@@ -117,6 +180,9 @@ void FunctionLooper::callbackCanceled() noexcept {
 
 folly::Optional<std::chrono::microseconds>
 FunctionLooper::getTimerTickInterval() noexcept {
+  if (pacingCalendar_) {
+    return pacingCalendar_->getTickInterval();
+  }
   if (pacingTimer_) {
     return pacingTimer_->getTickInterval();
   }
@@ -11,6 +11,8 @@
 
 #include <folly/Function.h>
 #include <folly/io/async/EventBase.h>
+#include <quic/common/LooperQueue.h>
+#include <quic/common/PacingCalendar.h>
 #include <quic/common/Timers.h>
 
 namespace quic {
@@ -41,6 +43,18 @@ class FunctionLooper : public folly::EventBase::LoopCallback,
 
   void setPacingTimer(TimerHighRes::SharedPtr pacingTimer) noexcept;
 
+  /**
+   * Paced runs wait in the calendar instead of on their own timeout on the
+   * pacing timer.
+   */
+  void setPacingCalendar(std::shared_ptr<PacingCalendar> calendar) noexcept;
+
+  /**
+   * Runs from the queue, shared with other loopers on the same evb, instead
+   * of as a loop callback of its own.
+   */
+  void setLooperQueue(std::shared_ptr<LooperQueue> queue) noexcept;
+
   void runLoopCallback() noexcept override;
 
   /**
@@ -81,15 +95,25 @@ class FunctionLooper : public folly::EventBase::LoopCallback,
 
   folly::Optional<std::chrono::microseconds> getTimerTickInterval() noexcept;
 
+  // Whether a paced run waits on the timer or in the calendar
+  bool isPacingScheduled() const;
+
+  // Whether the looper runs in a loop iteration, on its own or from the queue
+  bool isLoopScheduled() const;
+
  private:
-  ~FunctionLooper() override = default;
+  ~FunctionLooper() override;
   void commonLoopBody(bool fromTimer) noexcept;
   bool schedulePacingTimeout(bool fromTimer) noexcept;
+  void runInLoop(bool thisIteration) noexcept;
+  void cancelRunInLoop() noexcept;
 
   folly::EventBase* evb_;
   folly::Function<void(bool)> func_;
   folly::Optional<folly::Function<std::chrono::microseconds()>> pacingFunc_;
   TimerHighRes::SharedPtr pacingTimer_;
+  std::shared_ptr<PacingCalendar> pacingCalendar_;
+  std::shared_ptr<LooperQueue> looperQueue_;
   bool running_{false};
   bool inLoopBody_{false};
   const LooperType type_;
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/IOUringReceiver.h>
+
+#include <folly/MPMCQueue.h>
+#include <folly/String.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#if MVFST_HAVE_LIBURING
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace quic {
+
+struct IOUringReceiver::Buffers {
+  Buffers(uint8_t* areaIn, size_t lenIn, size_t bufferSizeIn, size_t numIn)
+      : area(areaIn),
+        len(lenIn),
+        bufferSize(bufferSizeIn),
+        returnedBuffers(std::max<size_t>(numIn, 1)) {}
+
+  ~Buffers();
+
+  uint8_t* buffer(uint16_t bid) const {
+    return area + bid * bufferSize;
+  }
+
+  static void freeBuffer(void* buf, void* userData) {
+    auto buffers = static_cast<Buffers*>(userData);
+    auto bid = static_cast<uint16_t>(
+        (static_cast<uint8_t*>(buf) - buffers->area) / buffers->bufferSize);
+    // Never full, it has room for all the buffers.
+    CHECK(buffers->returnedBuffers.write(bid));
+    buffers->release();
+  }
+
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // buffers handed out and not freed yet
+  size_t numHeld() const {
+    return refs.load(std::memory_order_acquire) - 1;
+  }
+
+  uint8_t* area;
+  size_t len;
+  size_t bufferSize;
+  // the ids of the buffers freed, on any thread
+  folly::MPMCQueue<uint16_t> returnedBuffers;
+  // one for the receiver and one for each buffer handed out
+  std::atomic<size_t> refs{1};
+};
+
+#if MVFST_HAVE_LIBURING
+
+namespace {
+
+constexpr unsigned kSubmissionEntries = 16;
+constexpr uint16_t kBufferGroup = 0;
+// the largest buffer ring the kernel takes
+constexpr uint32_t kMaxBuffers = 32768;
+constexpr uint64_t kRecvTag = 1;
+constexpr uint64_t kCancelTag = 2;
+
+} // namespace
+
+struct IOUringReceiver::Ring {
+  struct io_uring ring {};
+  struct io_uring_buf_ring* bufRing{nullptr};
+};
+
+IOUringReceiver::Buffers::~Buffers() {
+  munmap(area, len);
+}
+
+std::shared_ptr<IOUringReceiver> IOUringReceiver::make(
+    folly::EventBase* evb,
+    int fd,
+    const IOUringReceiverOptions& options) {
+  std::shared_ptr<IOUringReceiver> receiver(
+      new IOUringReceiver(evb, fd, options));
+  if (!receiver->setup()) {
+    return nullptr;
+  }
+  return receiver;
+}
+
+IOUringReceiver::IOUringReceiver(
+    folly::EventBase* evb,
+    int fd,
+    const IOUringReceiverOptions& options)
+    : folly::EventHandler(evb), fd_(fd), options_(options) {}
+
+bool IOUringReceiver::setup() {
+  if (options_.numBuffers == 0 || options_.numBuffers > kMaxBuffers ||
+      (options_.numBuffers & (options_.numBuffers - 1)) ||
+      options_.payloadSize == 0) {
+    LOG(ERROR) << "Invalid io_uring receive buffer count or size";
+    return false;
+  }
+  auto ring = std::make_unique<Ring>();
+  io_uring_params params{};
+  // One completion for each buffer the kernel fills between two wakeups, and
+  // the cancellation.
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = options_.numBuffers * 2;
+  int ret =
+      io_uring_queue_init_params(kSubmissionEntries, &ring->ring, &params);
+  if (ret != 0) {
+    VLOG(2) << "Unable to set up an io_uring " << folly::errnoStr(-ret);
+    return false;
+  }
+  ring_ = std::move(ring);
+  eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (eventFd_ < 0 || io_uring_register_eventfd(&ring_->ring, eventFd_) != 0) {
+    LOG(ERROR) << "Unable to register an eventfd with the io_uring";
+    return false;
+  }
+  ring_->bufRing = io_uring_setup_buf_ring(
+      &ring_->ring, options_.numBuffers, kBufferGroup, 0, &ret);
+  if (!ring_->bufRing) {
+    VLOG(2) << "Unable to register the io_uring receive buffers "
+            << folly::errnoStr(-ret);
+    return false;
+  }
+
+  // Each buffer holds what the kernel writes for one datagram, see recvMsg_.
+  recvMsg_.msg_namelen = sizeof(struct sockaddr_storage);
+  recvMsg_.msg_controllen = options_.controlSize;
+  size_t bufferSize = sizeof(struct io_uring_recvmsg_out) +
+      recvMsg_.msg_namelen + recvMsg_.msg_controllen + options_.payloadSize;
+  bufferSize = (bufferSize + alignof(std::max_align_t) - 1) &
+      ~(alignof(std::max_align_t) - 1);
+  size_t len = bufferSize * options_.numBuffers;
+  void* area = mmap(
+      nullptr,
+      len,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+      -1,
+      0);
+  if (area == MAP_FAILED) {
+    LOG(ERROR) << "Unable to allocate the io_uring receive buffers, errno="
+               << errno;
+    return false;
+  }
+  buffers_ = new Buffers(
+      static_cast<uint8_t*>(area), len, bufferSize, options_.numBuffers);
+  for (uint32_t bid = 0; bid < options_.numBuffers; ++bid) {
+    returnBuffer(static_cast<uint16_t>(bid));
+  }
+  refill();
+  changeHandlerFD(folly::NetworkSocket::fromFd(eventFd_));
+  return true;
+}
+
+IOUringReceiver::~IOUringReceiver() {
+  unregisterHandler();
+  if (ring_) {
+    cancelRecv();
+    if (ring_->bufRing) {
+      io_uring_free_buf_ring(
+          &ring_->ring, ring_->bufRing, options_.numBuffers, kBufferGroup);
+    }
+    io_uring_queue_exit(&ring_->ring);
+  }
+  if (eventFd_ >= 0) {
+    ::close(eventFd_);
+  }
+  // The buffers handed out stay valid until they are freed.
+  if (buffers_) {
+    buffers_->release();
+  }
+}
+
+void IOUringReceiver::resumeRead(ReadCallback* cb) {
+  readCallback_ = cb;
+  registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+  if (!recvArmed_) {
+    armRecv();
+  }
+}
+
+void IOUringReceiver::pauseRead() {
+  readCallback_ = nullptr;
+  unregisterHandler();
+  cancelRecv();
+}
+
+void IOUringReceiver::armRecv() {
+  auto sqe = io_uring_get_sqe(&ring_->ring);
+  if (!sqe) {
+    io_uring_submit(&ring_->ring);
+    sqe = io_uring_get_sqe(&ring_->ring);
+  }
+  if (!sqe) {
+    LOG(ERROR) << "No io_uring submission entry for the recvmsg";
+    return;
+  }
+  io_uring_prep_recvmsg_multishot(sqe, fd_, &recvMsg_, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroup;
+  io_uring_sqe_set_data64(sqe, kRecvTag);
+  recvArmed_ = true;
+  int ret = io_uring_submit(&ring_->ring);
+  if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+    LOG(ERROR) << "io_uring submit error " << folly::errnoStr(-ret);
+  }
+}
+
+void IOUringReceiver::cancelRecv() {
+  if (!recvArmed_) {
+    return;
+  }
+  auto sqe = io_uring_get_sqe(&ring_->ring);
+  if (!sqe) {
+    io_uring_submit(&ring_->ring);
+    sqe = io_uring_get_sqe(&ring_->ring);
+  }
+  if (sqe) {
+    io_uring_prep_cancel64(sqe, kRecvTag, 0);
+    io_uring_sqe_set_data64(sqe, kCancelTag);
+  }
+  while (recvArmed_) {
+    struct io_uring_cqe* cqe = nullptr;
+    int ret = io_uring_submit_and_wait(&ring_->ring, 1);
+    if (ret >= 0 || ret == -EINTR) {
+      ret = io_uring_peek_cqe(&ring_->ring, &cqe);
+    }
+    if (ret == -EINTR || ret == -EAGAIN) {
+      continue;
+    }
+    if (ret < 0) {
+      LOG(ERROR) << "io_uring wait error " << folly::errnoStr(-ret);
+      return;
+    }
+    if (io_uring_cqe_get_data64(cqe) == kRecvTag) {
+      if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        recvArmed_ = false;
+      }
+      if (cqe->flags & IORING_CQE_F_BUFFER) {
+        returnBuffer(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+      }
+    }
+    io_uring_cqe_seen(&ring_->ring, cqe);
+  }
+  refill();
+}
+
+void IOUringReceiver::returnBuffer(uint16_t bid) {
+  io_uring_buf_ring_add(
+      ring_->bufRing,
+      buffers_->buffer(bid),
+      buffers_->bufferSize,
+      bid,
+      io_uring_buf_ring_mask(options_.numBuffers),
+      unadvanced_++);
+}
+
+void IOUringReceiver::refill() {
+  uint16_t bid;
+  while (buffers_->returnedBuffers.read(bid)) {
+    returnBuffer(bid);
+  }
+  if (unadvanced_ > 0) {
+    io_uring_buf_ring_advance(ring_->bufRing, unadvanced_);
+    unadvanced_ = 0;
+  }
+}
+
+void IOUringReceiver::handlerReady(uint16_t /* events */) noexcept {
+  uint64_t count;
+  while (::read(eventFd_, &count, sizeof(count)) == sizeof(count)) {
+  }
+  size_t numPackets = 0;
+  int error = 0;
+  struct io_uring_cqe* cqe = nullptr;
+  // One at a time, a callback pausing the reads reaps the rest.
+  while (io_uring_peek_cqe(&ring_->ring, &cqe) == 0 && cqe) {
+    auto tag = io_uring_cqe_get_data64(cqe);
+    int res = cqe->res;
+    uint32_t flags = cqe->flags;
+    io_uring_cqe_seen(&ring_->ring, cqe);
+    if (tag != kRecvTag) {
+      continue;
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+      recvArmed_ = false;
+    }
+    if (res < 0) {
+      // The kernel ends the recvmsg when it runs out of buffers, it is armed
+      // again below once they are back.
+      if (res != -ENOBUFS && res != -ECANCELED && res != -EINTR) {
+        error = -res;
+      }
+      continue;
+    }
+    if (!(flags & IORING_CQE_F_BUFFER)) {
+      continue;
+    }
+    auto bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    uint8_t* buf = buffers_->buffer(bid);
+    auto out = io_uring_recvmsg_validate(buf, res, &recvMsg_);
+    if (!out || !readCallback_ || (out->flags & MSG_TRUNC) ||
+        out->namelen > recvMsg_.msg_namelen) {
+      // Too large for a buffer, like a recvmsg into one would cut it.
+      returnBuffer(bid);
+      continue;
+    }
+    auto name = static_cast<uint8_t*>(io_uring_recvmsg_name(out));
+    auto family = reinterpret_cast<struct sockaddr*>(name)->sa_family;
+    if (family != AF_INET && family != AF_INET6) {
+      returnBuffer(bid);
+      continue;
+    }
+    folly::SocketAddress peer;
+    peer.setFromSockaddr(
+        reinterpret_cast<struct sockaddr*>(name), out->namelen);
+    struct msghdr msg {};
+    msg.msg_control = name + recvMsg_.msg_namelen;
+    msg.msg_controllen = out->controllen;
+    msg.msg_flags = static_cast<int>(out->flags);
+    auto payload =
+        static_cast<uint8_t*>(io_uring_recvmsg_payload(out, &recvMsg_));
+    auto payloadLen = io_uring_recvmsg_payload_length(out, res, &recvMsg_);
+    size_t payloadOffset = payload - buf;
+    std::unique_ptr<folly::IOBuf> data;
+    if (buffers_->numHeld() < options_.numBuffers / 2) {
+      buffers_->refs.fetch_add(1, std::memory_order_relaxed);
+      data = folly::IOBuf::takeOwnership(
+          buf,
+          buffers_->bufferSize,
+          payloadOffset + payloadLen,
+          Buffers::freeBuffer,
+          buffers_);
+      data->trimStart(payloadOffset);
+    } else {
+      data = folly::IOBuf::copyBuffer(payload, payloadLen);
+      returnBuffer(bid);
+    }
+    ++numPackets;
+    readCallback_->onIOUringPacket(*this, peer, std::move(data), msg);
+  }
+  refill();
+  if (error != 0 && readCallback_) {
+    VLOG(2) << "io_uring recvmsg error " << folly::errnoStr(error);
+    auto cb = readCallback_;
+    pauseRead();
+    // last, the callback may destroy the receiver
+    cb->onIOUringReadError(*this, error);
+    return;
+  }
+  if (!recvArmed_ && readCallback_) {
+    armRecv();
+  }
+  if (numPackets > 0 && readCallback_) {
+    // last, the callback may destroy the receiver
+    readCallback_->onIOUringReadDone(*this);
+  }
+}
+
+#else
+
+struct IOUringReceiver::Ring {};
+
+IOUringReceiver::Buffers::~Buffers() = default;
+
+std::shared_ptr<IOUringReceiver> IOUringReceiver::make(
+    folly::EventBase*,
+    int,
+    const IOUringReceiverOptions&) {
+  VLOG(2) << "Built without io_uring support";
+  return nullptr;
+}
+
+IOUringReceiver::IOUringReceiver(
+    folly::EventBase* evb,
+    int fd,
+    const IOUringReceiverOptions& options)
+    : folly::EventHandler(evb), fd_(fd), options_(options) {}
+
+IOUringReceiver::~IOUringReceiver() = default;
+
+bool IOUringReceiver::setup() {
+  return false;
+}
+
+void IOUringReceiver::resumeRead(ReadCallback*) {}
+
+void IOUringReceiver::pauseRead() {}
+
+void IOUringReceiver::armRecv() {}
+
+void IOUringReceiver::cancelRecv() {}
+
+void IOUringReceiver::refill() {}
+
+void IOUringReceiver::returnBuffer(uint16_t) {}
+
+void IOUringReceiver::handlerReady(uint16_t) noexcept {}
+
+#endif
+
+} // namespace quic
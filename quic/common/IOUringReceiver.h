@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventHandler.h>
+
+#include <sys/socket.h>
+
+#include <memory>
+
+namespace quic {
+
+struct IOUringReceiverOptions {
+  // The buffers registered with the ring as its provided buffers, a power of
+  // two. Each holds one datagram, or the GRO coalesced datagrams of one read.
+  uint32_t numBuffers{1024};
+  uint32_t payloadSize{1500};
+  // room for the control messages of a datagram, see RecvmmsgStorage
+  uint32_t controlSize{128};
+};
+
+/**
+ * Reads the datagrams of a UDP socket through an io_uring, with one
+ * multishot recvmsg which the kernel completes once for each datagram, into
+ * buffers registered with the ring. A wakeup takes every datagram received
+ * since the last one without a syscall each. Received payloads are handed
+ * out in place, as long as at most half of the buffers are held by them, and
+ * copied past that so the kernel keeps getting buffers.
+ *
+ * The socket is still the caller's, and so are its writes. Its read callback
+ * has to be paused while the receiver reads.
+ *
+ * Everything but freeing the received buffers happens on the event base's
+ * thread. Only built with MVFST_HAVE_LIBURING, make returns null otherwise.
+ * A kernel without multishot recvmsg, which came with 6.0, fails the first
+ * read, see ReadCallback::onIOUringReadError.
+ */
+class IOUringReceiver : public folly::EventHandler {
+ public:
+  class ReadCallback {
+   public:
+    virtual ~ReadCallback() = default;
+
+    /**
+     * A datagram from peer. msg holds its control messages, for
+     * getGROSegmentSize, getEcnCodepoint and getReceiveTimestamp. Must not
+     * destroy the receiver.
+     */
+    virtual void onIOUringPacket(
+        IOUringReceiver& receiver,
+        const folly::SocketAddress& peer,
+        std::unique_ptr<folly::IOBuf> data,
+        struct msghdr& msg) noexcept = 0;
+
+    // after the packets of one wakeup, may destroy the receiver
+    virtual void onIOUringReadDone(IOUringReceiver& /* receiver */) noexcept {
+    }
+
+    /**
+     * The ring stopped reading the socket, e.g. because the kernel has no
+     * multishot recvmsg. The socket has to be read some other way from now
+     * on. May destroy the receiver.
+     */
+    virtual void onIOUringReadError(
+        IOUringReceiver& receiver,
+        int error) noexcept = 0;
+  };
+
+  /**
+   * Sets up the ring for the socket fd, which stays open and the caller's.
+   * Null if the ring can't be set up.
+   */
+  static std::shared_ptr<IOUringReceiver> make(
+      folly::EventBase* evb,
+      int fd,
+      const IOUringReceiverOptions& options);
+
+  ~IOUringReceiver() override;
+
+  IOUringReceiver(const IOUringReceiver&) = delete;
+  IOUringReceiver& operator=(const IOUringReceiver&) = delete;
+
+  void resumeRead(ReadCallback* cb);
+  // Cancels the recvmsg. Datagrams it read and not handed out yet are lost.
+  void pauseRead();
+
+  int fd() const {
+    return fd_;
+  }
+
+ private:
+  struct Buffers;
+  // the io_uring and its buffer ring
+  struct Ring;
+
+  IOUringReceiver(
+      folly::EventBase* evb,
+      int fd,
+      const IOUringReceiverOptions& options);
+
+  bool setup();
+
+  void handlerReady(uint16_t events) noexcept override;
+
+  // queues the multishot recvmsg
+  void armRecv();
+  // cancels it and waits for its last completion
+  void cancelRecv();
+  // hands the buffers freed since the last call back to the kernel
+  void refill();
+  void returnBuffer(uint16_t bid);
+
+  int fd_;
+  IOUringReceiverOptions options_;
+  int eventFd_{-1};
+  std::unique_ptr<Ring> ring_;
+  // whether the recvmsg is queued, it is from its submission until its last
+  // completion
+  bool recvArmed_{false};
+  Buffers* buffers_{nullptr};
+  // buffers given back since the last advance of the buffer ring
+  uint16_t unadvanced_{0};
+  // The layout the kernel writes each datagram with: the name, the control
+  // messages and the payload after an io_uring_recvmsg_out.
+  struct msghdr recvMsg_ {};
+  ReadCallback* readCallback_{nullptr};
+};
+
+} // namespace quic
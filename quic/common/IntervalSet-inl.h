@@ -21,6 +21,23 @@ IntervalSet<T, Unit, Container>::IntervalSet(
 template <typename T, T Unit, template <typename... I> class Container>
 void IntervalSet<T, Unit, Container>::insert(
     const Interval<T, Unit>& interval) {
+  // Packet numbers and stream offsets mostly arrive in order, those land at or
+  // merge into the back without a search.
+  if (container_type::empty() ||
+      container_type::back().end + interval_type::unitValue() <
+          interval.start) {
+    insertVersion_++;
+    container_type::push_back(interval);
+    return;
+  }
+  auto& last = container_type::back();
+  if (last.start <= interval.start) {
+    if (last.end < interval.end) {
+      last.end = interval.end;
+      insertVersion_++;
+    }
+    return;
+  }
   auto intersectionRange = intersectingRange(interval);
   auto firstIt = intersectionRange.first;
   auto endIt = intersectionRange.second;
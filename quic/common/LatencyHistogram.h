@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/lang/Bits.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * Fixed bucket histogram of latencies in microseconds, HDR style: exact up to
+ * kLinearBuckets us, then kSubBuckets buckets to each power of two, so that
+ * a bucket is at most 1/kSubBuckets of its values wide. Latencies past the
+ * last bucket, about a minute, are counted in it.
+ *
+ * Adding a sample is a couple of increments, there is no lock since the
+ * histogram of a connection is only updated on its evb. Histograms add up
+ * with merge(), e.g. those of the connections of a worker.
+ *
+ * The buckets work the same for values of other units, e.g. cycles, added
+ * with addValue() and read with getPercentileValue(), sum().count() and
+ * max().count().
+ */
+class LatencyHistogram {
+ public:
+  static constexpr size_t kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr size_t kLinearBuckets = kSubBuckets;
+  // Powers of two past the linear buckets.
+  static constexpr size_t kExponents = 23;
+  static constexpr size_t kNumBuckets =
+      kLinearBuckets + kExponents * kSubBuckets;
+
+  void addSample(std::chrono::microseconds latency) noexcept {
+    addValue(
+        latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0);
+  }
+
+  void addValue(uint64_t value) noexcept {
+    buckets_[bucketIndex(value)]++;
+    count_++;
+    sum_ += value;
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const LatencyHistogram& other) noexcept {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t count() const noexcept {
+    return count_;
+  }
+
+  std::chrono::microseconds sum() const noexcept {
+    return std::chrono::microseconds(sum_);
+  }
+
+  std::chrono::microseconds max() const noexcept {
+    return std::chrono::microseconds(max_);
+  }
+
+  /**
+   * Upper bound of the latencies of the given fraction of the samples, e.g.
+   * 0.99 for the p99, from the bucket it falls in. 0 without samples.
+   */
+  std::chrono::microseconds getPercentile(double fraction) const noexcept {
+    return std::chrono::microseconds(getPercentileValue(fraction));
+  }
+
+  uint64_t getPercentileValue(double fraction) const noexcept {
+    if (count_ == 0) {
+      return 0;
+    }
+    fraction = std::min(std::max(fraction, 0.0), 1.0);
+    auto rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(fraction * static_cast<double>(count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(bucketUpperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  uint64_t getBucketCount(size_t index) const noexcept {
+    return buckets_[index];
+  }
+
+  static size_t bucketIndex(uint64_t value) noexcept {
+    if (value < kLinearBuckets) {
+      return static_cast<size_t>(value);
+    }
+    size_t msb = folly::findLastSet(value) - 1;
+    size_t exponent = msb - kSubBucketBits;
+    if (exponent >= kExponents) {
+      return kNumBuckets - 1;
+    }
+    auto subBucket = (value >> exponent) & (kSubBuckets - 1);
+    return kLinearBuckets + exponent * kSubBuckets + subBucket;
+  }
+
+  // The largest value counted in the bucket.
+  static uint64_t bucketUpperBound(size_t index) noexcept {
+    if (index < kLinearBuckets) {
+      return index;
+    }
+    size_t exponent = (index - kLinearBuckets) / kSubBuckets;
+    uint64_t subBucket = (index - kLinearBuckets) % kSubBuckets;
+    return (((kSubBuckets + subBucket + 1) << exponent)) - 1;
+  }
+
+ private:
+  std::array<uint64_t, kNumBuckets> buckets_{};
+  uint64_t count_{0};
+  uint64_t sum_{0};
+  uint64_t max_{0};
+};
+
+/**
+ * The latencies a connection keeps histograms of.
+ */
+struct ConnectionLatencyHistograms {
+  // Rtt samples, less the ack delay where it was taken off
+  LatencyHistogram rtt;
+  // Ack delays reported by the peer
+  LatencyHistogram ackDelay;
+  // Stream data from the app's write to when it is first sent
+  LatencyHistogram sendBuffer;
+  // Stream data from the app's write to when all of it up to there is acked
+  LatencyHistogram delivery;
+
+  void merge(const ConnectionLatencyHistograms& other) noexcept {
+    rtt.merge(other.rtt);
+    ackDelay.merge(other.ackDelay);
+    sendBuffer.merge(other.sendBuffer);
+    delivery.merge(other.delivery);
+  }
+};
+
+} // namespace quic
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/LooperQueue.h>
+
+#include <folly/ScopeGuard.h>
+#include <quic/common/FunctionLooper.h>
+
+#include <algorithm>
+
+namespace quic {
+
+LooperQueue::LooperQueue(folly::EventBase* evb, size_t maxRunsPerLoop)
+    : evb_(evb), maxRunsPerLoop_(std::max<size_t>(1, maxRunsPerLoop)) {}
+
+void LooperQueue::post(FunctionLooper* looper, bool thisIteration) {
+  CHECK(looper);
+  if (posted_.count(looper)) {
+    return;
+  }
+  auto sequence = nextSequence_++;
+  posted_.emplace(looper, sequence);
+  ready_.emplace_back(looper, sequence);
+  if (inPass_ && thisIteration) {
+    // Runs in the pass that is running, after everyone before it.
+    passRemaining_ = ready_.size();
+    return;
+  }
+  schedule(thisIteration);
+}
+
+void LooperQueue::cancel(const FunctionLooper* looper) {
+  posted_.erase(looper);
+  if (posted_.empty()) {
+    ready_.clear();
+    passRemaining_ = 0;
+    cancelLoopCallback();
+  }
+}
+
+bool LooperQueue::isPosted(const FunctionLooper* looper) const {
+  return posted_.count(looper) > 0;
+}
+
+size_t LooperQueue::numPosted() const {
+  return posted_.size();
+}
+
+folly::EventBase* LooperQueue::getEventBase() const {
+  return evb_;
+}
+
+void LooperQueue::runLoopCallback() noexcept {
+  DCHECK(!inPass_);
+  inPass_ = true;
+  SCOPE_EXIT {
+    inPass_ = false;
+    passRemaining_ = 0;
+    if (!ready_.empty()) {
+      schedule(false);
+    }
+  };
+  passRemaining_ = ready_.size();
+  size_t runs = 0;
+  while (passRemaining_ > 0 && runs < maxRunsPerLoop_) {
+    DCHECK(!ready_.empty());
+    auto entry = ready_.front();
+    ready_.pop_front();
+    passRemaining_--;
+    auto it = posted_.find(entry.first);
+    if (it == posted_.end() || it->second != entry.second) {
+      // Cancelled, maybe posted again since.
+      continue;
+    }
+    posted_.erase(it);
+    runs++;
+    // The looper may post itself again, or stop or destroy any of the others.
+    entry.first->runLoopCallback();
+  }
+}
+
+void LooperQueue::schedule(bool thisIteration) {
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this, thisIteration);
+  }
+}
+
+} // namespace quic
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/container/F14Map.h>
+#include <folly/io/async/EventBase.h>
+
+#include <deque>
+
+namespace quic {
+
+class FunctionLooper;
+
+/**
+ * Ready queue of the read, peek and write loopers of all the connections of
+ * a worker. Instead of each looper registering as a loop callback of its own,
+ * loopers post themselves here and a single loop callback runs them in the
+ * order they were posted. At most maxRunsPerLoop run per loop iteration, the
+ * rest wait for the next one, so that a burst of busy connections can't keep
+ * the evb from reading the socket. A looper that posts itself again while it
+ * runs goes to the back of the queue.
+ *
+ * Loopers are tracked by raw pointer; a looper must cancel before it goes
+ * away.
+ */
+class LooperQueue : public folly::EventBase::LoopCallback {
+ public:
+  LooperQueue(folly::EventBase* evb, size_t maxRunsPerLoop);
+  ~LooperQueue() override = default;
+
+  /**
+   * Makes the looper run in the next loop iteration, or in the current one
+   * with thisIteration. Posting a looper that is posted already is a no-op.
+   */
+  void post(FunctionLooper* looper, bool thisIteration = false);
+
+  void cancel(const FunctionLooper* looper);
+
+  bool isPosted(const FunctionLooper* looper) const;
+
+  // number of loopers waiting to run
+  size_t numPosted() const;
+
+  folly::EventBase* getEventBase() const;
+
+  void runLoopCallback() noexcept override;
+
+ private:
+  void schedule(bool thisIteration);
+
+  folly::EventBase* evb_;
+  const size_t maxRunsPerLoop_;
+  // every posted looper, with the sequence number of its entry in ready_
+  folly::F14FastMap<const FunctionLooper*, uint64_t> posted_;
+  // loopers in post order, entries of cancelled ones are skipped
+  std::deque<std::pair<FunctionLooper*, uint64_t>> ready_;
+  uint64_t nextSequence_{0};
+  // entries at the front of ready_ that run in the current pass
+  size_t passRemaining_{0};
+  bool inPass_{false};
+};
+
+} // namespace quic
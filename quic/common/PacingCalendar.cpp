@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/PacingCalendar.h>
+
+#include <quic/common/FunctionLooper.h>
+
+#include <algorithm>
+
+namespace quic {
+using namespace std::chrono_literals;
+
+PacingCalendar::PacingCalendar(TimerHighRes::SharedPtr pacingTimer)
+    : pacingTimer_(std::move(pacingTimer)),
+      tick_(std::max(1us, pacingTimer_->getTickInterval())) {}
+
+void PacingCalendar::setAfterPassCallback(folly::Function<void()> callback) {
+  afterPassCallback_ = std::move(callback);
+}
+
+std::chrono::microseconds PacingCalendar::getTickInterval() const {
+  return tick_;
+}
+
+void PacingCalendar::scheduleWrite(
+    FunctionLooper* looper,
+    std::chrono::microseconds delay,
+    Clock::time_point now) {
+  CHECK(looper);
+  cancelWrite(looper);
+  auto tick = tickOf(now + delay);
+  buckets_[tick].push_back(looper);
+  scheduled_.emplace(looper, tick);
+  if (!timeoutTick_ || tick < *timeoutTick_) {
+    scheduleTimeout(now);
+  }
+}
+
+void PacingCalendar::cancelWrite(FunctionLooper* looper) {
+  std::replace(running_.begin(), running_.end(), looper, nullptr);
+  auto it = scheduled_.find(looper);
+  if (it == scheduled_.end()) {
+    return;
+  }
+  auto bucket = buckets_.find(it->second);
+  DCHECK(bucket != buckets_.end());
+  auto& loopers = bucket->second;
+  loopers.erase(
+      std::remove(loopers.begin(), loopers.end(), looper), loopers.end());
+  if (loopers.empty()) {
+    buckets_.erase(bucket);
+  }
+  scheduled_.erase(it);
+  if (buckets_.empty() && isScheduled()) {
+    cancelTimeout();
+    timeoutTick_.reset();
+  }
+}
+
+bool PacingCalendar::isWriteScheduled(const FunctionLooper* looper) const {
+  return scheduled_.count(looper) > 0;
+}
+
+size_t PacingCalendar::numScheduled() const {
+  return scheduled_.size();
+}
+
+void PacingCalendar::runDueWrites(Clock::time_point now) noexcept {
+  DCHECK(running_.empty());
+  auto nowTick = tickOf(now);
+  auto end = buckets_.upper_bound(nowTick);
+  for (auto it = buckets_.begin(); it != end; ++it) {
+    running_.insert(running_.end(), it->second.begin(), it->second.end());
+  }
+  buckets_.erase(buckets_.begin(), end);
+  for (auto looper : running_) {
+    scheduled_.erase(looper);
+  }
+  // A write may stop, and cancel, any of the other loopers, or schedule the
+  // next one of its own.
+  for (size_t i = 0; i < running_.size(); ++i) {
+    auto looper = running_[i];
+    if (looper) {
+      looper->timeoutExpired();
+    }
+  }
+  running_.clear();
+  if (afterPassCallback_) {
+    afterPassCallback_();
+  }
+  if (!buckets_.empty() &&
+      (!isScheduled() || buckets_.begin()->first < *timeoutTick_)) {
+    scheduleTimeout(now);
+  }
+}
+
+void PacingCalendar::timeoutExpired() noexcept {
+  timeoutTick_.reset();
+  runDueWrites();
+}
+
+void PacingCalendar::callbackCanceled() noexcept {
+  timeoutTick_.reset();
+}
+
+uint64_t PacingCalendar::tickOf(Clock::time_point time) const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             time.time_since_epoch())
+             .count() /
+      tick_.count();
+}
+
+void PacingCalendar::scheduleTimeout(Clock::time_point now) {
+  DCHECK(!buckets_.empty());
+  auto tick = buckets_.begin()->first;
+  auto due = Clock::time_point(std::chrono::duration_cast<Clock::duration>(
+      std::chrono::microseconds(tick * tick_.count())));
+  auto delay = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::max(due, now) - now);
+  if (isScheduled()) {
+    cancelTimeout();
+  }
+  pacingTimer_->scheduleTimeout(this, delay);
+  timeoutTick_ = tick;
+}
+
+} // namespace quic
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/container/F14Map.h>
+#include <quic/common/Timers.h>
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+namespace quic {
+
+class FunctionLooper;
+
+/**
+ * Calendar queue of the paced writes of all the connections of a worker.
+ * Writes are put in the bucket of the pacing timer tick they are due in, and
+ * a single timeout on the worker's pacing timer runs every write due by the
+ * end of the current tick in one pass. The after pass callback, e.g. a flush
+ * of the worker's MultiDestBatchWriter, then sends all of their packets
+ * together.
+ *
+ * Loopers are tracked by raw pointer; a looper must cancel its write before
+ * it goes away.
+ */
+class PacingCalendar : public TimerHighRes::Callback {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit PacingCalendar(TimerHighRes::SharedPtr pacingTimer);
+  ~PacingCalendar() override = default;
+
+  void setAfterPassCallback(folly::Function<void()> callback);
+
+  std::chrono::microseconds getTickInterval() const;
+
+  /**
+   * Makes the looper run, from the timer, once the delay passed. A looper
+   * that already has a write scheduled is moved.
+   */
+  void scheduleWrite(
+      FunctionLooper* looper,
+      std::chrono::microseconds delay,
+      Clock::time_point now = Clock::now());
+
+  void cancelWrite(FunctionLooper* looper);
+
+  bool isWriteScheduled(const FunctionLooper* looper) const;
+
+  // number of loopers waiting to write
+  size_t numScheduled() const;
+
+  /**
+   * Runs every write due by the end of the tick now is in.
+   */
+  void runDueWrites(Clock::time_point now = Clock::now()) noexcept;
+
+  void timeoutExpired() noexcept override;
+
+  void callbackCanceled() noexcept override;
+
+ private:
+  uint64_t tickOf(Clock::time_point time) const;
+  void scheduleTimeout(Clock::time_point now);
+
+  TimerHighRes::SharedPtr pacingTimer_;
+  std::chrono::microseconds tick_;
+  // the loopers due in every tick, by tick since the clock's epoch
+  std::map<uint64_t, std::vector<FunctionLooper*>> buckets_;
+  folly::F14FastMap<const FunctionLooper*, uint64_t> scheduled_;
+  folly::Optional<uint64_t> timeoutTick_;
+  // loopers being run in runDueWrites, cancelled ones set to null
+  std::vector<FunctionLooper*> running_;
+  folly::Function<void()> afterPassCallback_;
+};
+
+} // namespace quic
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/common/EnumArray.h>
+#include <quic/common/LatencyHistogram.h>
+
+#if MVFST_PIPELINE_TIMING
+#include <folly/chrono/Hardware.h>
+#endif
+
+namespace quic {
+
+/**
+ * The stages of the receive and send pipelines. A stage's time includes
+ * the stages it runs, e.g. PacketProcessing includes the codec's stages and
+ * AckProcessing.
+ */
+enum class PipelineStage : uint8_t {
+  // A recvmmsg of a server worker
+  SocketRead,
+  // A server worker's handling of a packet, up to its transport's processing
+  // of it when the transport is on the same worker
+  PacketRouting,
+  // A transport's processing of a packet, once it is split from the
+  // packets coalesced with it
+  PacketProcessing,
+  HeaderParse,
+  HeaderDecrypt,
+  PayloadDecrypt,
+  FrameDecode,
+  AckProcessing,
+  // Scheduling the frames of a packet and building it
+  PacketBuild,
+  // Sealing a batch of packets
+  PacketSeal,
+  // Protecting the headers of a sealed batch
+  HeaderProtect,
+  // A batch writer's write of its batch to the socket
+  SocketWrite,
+  // NOTE: MAX should always be at the end
+  MAX
+};
+
+using PipelineStageHistograms = EnumArray<PipelineStage, LatencyHistogram>;
+
+inline const char* toString(PipelineStage stage) {
+  switch (stage) {
+    case PipelineStage::SocketRead:
+      return "SocketRead";
+    case PipelineStage::PacketRouting:
+      return "PacketRouting";
+    case PipelineStage::PacketProcessing:
+      return "PacketProcessing";
+    case PipelineStage::HeaderParse:
+      return "HeaderParse";
+    case PipelineStage::HeaderDecrypt:
+      return "HeaderDecrypt";
+    case PipelineStage::PayloadDecrypt:
+      return "PayloadDecrypt";
+    case PipelineStage::FrameDecode:
+      return "FrameDecode";
+    case PipelineStage::AckProcessing:
+      return "AckProcessing";
+    case PipelineStage::PacketBuild:
+      return "PacketBuild";
+    case PipelineStage::PacketSeal:
+      return "PacketSeal";
+    case PipelineStage::HeaderProtect:
+      return "HeaderProtect";
+    case PipelineStage::SocketWrite:
+      return "SocketWrite";
+    case PipelineStage::MAX:
+      return "MAX";
+  }
+  return "Unknown";
+}
+
+#if MVFST_PIPELINE_TIMING
+constexpr bool kPipelineTimingEnabled = true;
+#else
+constexpr bool kPipelineTimingEnabled = false;
+#endif
+
+/**
+ * Histograms of the cycles the pipeline stages that ran on this thread
+ * took, e.g. on a server worker's evb. Only filled in builds with
+ * MVFST_PIPELINE_TIMING, see QUIC_PIPELINE_TIMER. They are of cycles rather
+ * than microseconds, read them with LatencyHistogram's raw values.
+ */
+inline PipelineStageHistograms& getPipelineStageHistograms() noexcept {
+  static thread_local PipelineStageHistograms histograms;
+  return histograms;
+}
+
+#if MVFST_PIPELINE_TIMING
+/**
+ * Adds the cycles from its making to its destruction to the stage's
+ * histogram.
+ */
+class PipelineStageTimer {
+ public:
+  explicit PipelineStageTimer(PipelineStage stage) noexcept
+      : stage_(stage), start_(folly::hardware_timestamp()) {}
+
+  ~PipelineStageTimer() {
+    getPipelineStageHistograms()[stage_].addValue(
+        folly::hardware_timestamp() - start_);
+  }
+
+  PipelineStageTimer(const PipelineStageTimer&) = delete;
+  PipelineStageTimer& operator=(const PipelineStageTimer&) = delete;
+
+ private:
+  PipelineStage stage_;
+  uint64_t start_;
+};
+
+template <typename Func>
+auto timePipelineStage(PipelineStage stage, Func&& func) -> decltype(func()) {
+  PipelineStageTimer timer(stage);
+  return func();
+}
+
+// Times the rest of the scope as the stage.
+#define QUIC_PIPELINE_TIMER(stage) \
+  quic::PipelineStageTimer pipelineStageTimer##stage(quic::PipelineStage::stage)
+
+// Times the expression as the stage, and evaluates to it.
+#define QUIC_PIPELINE_TIMED(stage, ...) \
+  quic::timePipelineStage(              \
+      quic::PipelineStage::stage, [&] { return __VA_ARGS__; })
+#else
+#define QUIC_PIPELINE_TIMER(stage)
+#define QUIC_PIPELINE_TIMED(stage, ...) (__VA_ARGS__)
+#endif
+
+} // namespace quic
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace quic {
+
+// The most blocks of one size a thread keeps for reuse.
+constexpr size_t kMaxRecycledBlocksPerSize = 256;
+
+namespace detail {
+
+struct RecycledBlockCache {
+  struct Bucket {
+    size_t size;
+    std::vector<void*> blocks;
+  };
+
+  ~RecycledBlockCache() {
+    for (auto& bucket : buckets) {
+      for (auto block : bucket.blocks) {
+        ::operator delete(block);
+      }
+    }
+  }
+
+  Bucket& getBucket(size_t size) {
+    // There are only a few sizes, those of the objects made through it.
+    for (auto& bucket : buckets) {
+      if (bucket.size == size) {
+        return bucket;
+      }
+    }
+    buckets.push_back(Bucket{size, {}});
+    buckets.back().blocks.reserve(kMaxRecycledBlocksPerSize);
+    return buckets.back();
+  }
+
+  std::vector<Bucket> buckets;
+};
+
+// The cache of this thread, null once the thread is tearing it down.
+inline RecycledBlockCache* getRecycledBlockCache() noexcept {
+  // trivially destructible, so still readable by the thread locals that are
+  // destroyed after the cache
+  static thread_local bool destroyed = false;
+  struct Holder {
+    ~Holder() {
+      destroyed = true;
+    }
+    RecycledBlockCache cache;
+  };
+  static thread_local Holder holder;
+  return destroyed ? nullptr : &holder.cache;
+}
+
+} // namespace detail
+
+/**
+ * Allocates a block of size bytes, reusing one of that size freed on this
+ * thread if there is any. It is for the objects a server worker makes and
+ * destroys at the rate of new connections, the transports and their
+ * connection states, whose storage is reused rather than going through the
+ * allocator each time. The objects themselves are made anew in it.
+ */
+inline void* allocateRecycledBlock(size_t size) {
+  auto cache = detail::getRecycledBlockCache();
+  if (cache) {
+    auto& blocks = cache->getBucket(size).blocks;
+    if (!blocks.empty()) {
+      void* block = blocks.back();
+      blocks.pop_back();
+      return block;
+    }
+  }
+  return ::operator new(size);
+}
+
+/**
+ * Hands a block from allocateRecycledBlock back, to this thread's cache
+ * unless it already holds kMaxRecycledBlocksPerSize blocks of that size.
+ */
+inline void releaseRecycledBlock(void* block, size_t size) noexcept {
+  auto cache = detail::getRecycledBlockCache();
+  if (cache) {
+    auto& blocks = cache->getBucket(size).blocks;
+    if (blocks.size() < kMaxRecycledBlocksPerSize) {
+      blocks.push_back(block);
+      return;
+    }
+  }
+  ::operator delete(block);
+}
+
+/**
+ * Allocator drawing from allocateRecycledBlock, e.g. for std::allocate_shared
+ * to keep both the object and its control block in one recycled block.
+ */
+template <class T>
+class RecyclingAllocator {
+ public:
+  using value_type = T;
+
+  RecyclingAllocator() noexcept = default;
+
+  template <class U>
+  /* implicit */ RecyclingAllocator(const RecyclingAllocator<U>&) noexcept {}
+
+  T* allocate(size_t n) {
+    static_assert(
+        alignof(T) <= alignof(std::max_align_t),
+        "Recycled blocks are only aligned like operator new's");
+    return static_cast<T*>(allocateRecycledBlock(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) noexcept {
+    releaseRecycledBlock(p, n * sizeof(T));
+  }
+
+  template <class U>
+  bool operator==(const RecyclingAllocator<U>&) const noexcept {
+    return true;
+  }
+
+  template <class U>
+  bool operator!=(const RecyclingAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+} // namespace quic
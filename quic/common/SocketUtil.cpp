@@ -8,10 +8,27 @@
 
 #include "quic/common/SocketUtil.h"
 
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#if defined(SO_TXTIME) && defined(SCM_TXTIME)
+#include <linux/net_tstamp.h>
+#include <time.h>
+#define QUIC_HAVE_TXTIME 1
+#endif
+#endif
+
 using folly::AsyncUDPSocket;
 
 namespace quic {
 
+namespace {
+// Datagrams don't wait in the socket for longer than this, a receive time
+// further back is off because of a wall clock step.
+constexpr std::chrono::seconds kMaxRxTimestampAge{1};
+} // namespace
+
 void applySocketOptions(
     AsyncUDPSocket& sock,
     const folly::SocketOptionMap& options,
@@ -33,4 +50,164 @@ void applySocketOptions(
   sock.applyOptions(validOptions, pos);
 }
 
+bool enableSocketTxTime(FOLLY_MAYBE_UNUSED AsyncUDPSocket& sock) noexcept {
+#ifdef QUIC_HAVE_TXTIME
+  struct sock_txtime txTime;
+  memset(&txTime, 0, sizeof(txTime));
+  // quic::Clock is steady_clock, which is CLOCK_MONOTONIC
+  txTime.clockid = CLOCK_MONOTONIC;
+  return folly::netops::setsockopt(
+             sock.getNetworkSocket(),
+             SOL_SOCKET,
+             SO_TXTIME,
+             &txTime,
+             sizeof(txTime)) == 0;
+#else
+  return false;
+#endif
+}
+
+bool enableSocketGRO(FOLLY_MAYBE_UNUSED AsyncUDPSocket& sock) noexcept {
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  int val = 1;
+  return folly::netops::setsockopt(
+             sock.getNetworkSocket(), SOL_UDP, UDP_GRO, &val, sizeof(val)) ==
+      0;
+#else
+  return false;
+#endif
+}
+
+bool setSocketIncomingCpu(
+    FOLLY_MAYBE_UNUSED AsyncUDPSocket& sock,
+    FOLLY_MAYBE_UNUSED int cpu) noexcept {
+#ifdef SO_INCOMING_CPU
+  return folly::netops::setsockopt(
+             sock.getNetworkSocket(),
+             SOL_SOCKET,
+             SO_INCOMING_CPU,
+             &cpu,
+             sizeof(cpu)) == 0;
+#else
+  return false;
+#endif
+}
+
+bool enableSocketEcnReceive(
+    FOLLY_MAYBE_UNUSED AsyncUDPSocket& sock,
+    FOLLY_MAYBE_UNUSED sa_family_t family) noexcept {
+#if defined(IP_RECVTOS) && defined(IPV6_RECVTCLASS)
+  int val = 1;
+  // IPv4 datagrams received on a dual stack socket are reported with IP_TOS.
+  bool enabled = folly::netops::setsockopt(
+                     sock.getNetworkSocket(),
+                     IPPROTO_IP,
+                     IP_RECVTOS,
+                     &val,
+                     sizeof(val)) == 0;
+  if (family == AF_INET6) {
+    enabled = folly::netops::setsockopt(
+                  sock.getNetworkSocket(),
+                  IPPROTO_IPV6,
+                  IPV6_RECVTCLASS,
+                  &val,
+                  sizeof(val)) == 0;
+  }
+  return enabled;
+#else
+  return false;
+#endif
+}
+
+uint8_t getEcnCodepoint(FOLLY_MAYBE_UNUSED struct msghdr& msg) noexcept {
+#if defined(IP_RECVTOS) && defined(IPV6_RECVTCLASS)
+  if (!msg.msg_control) {
+    return kEcnNotEct;
+  }
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == IPPROTO_IP &&
+        (cmsg->cmsg_type == IP_TOS || cmsg->cmsg_type == IP_RECVTOS)) {
+      // A single byte on Linux, other platforms may use an int.
+      uint8_t tos = 0;
+      if (cmsg->cmsg_len >= CMSG_LEN(sizeof(int))) {
+        int val = 0;
+        memcpy(&val, CMSG_DATA(cmsg), sizeof(val));
+        tos = static_cast<uint8_t>(val);
+      } else {
+        memcpy(&tos, CMSG_DATA(cmsg), sizeof(tos));
+      }
+      return tos & kEcnMask;
+    }
+    if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_TCLASS) {
+      int tclass = 0;
+      memcpy(&tclass, CMSG_DATA(cmsg), sizeof(tclass));
+      return static_cast<uint8_t>(tclass) & kEcnMask;
+    }
+  }
+#endif
+  return kEcnNotEct;
+}
+
+bool enableSocketRxTimestamps(
+    FOLLY_MAYBE_UNUSED AsyncUDPSocket& sock) noexcept {
+#ifdef SO_TIMESTAMPNS
+  int val = 1;
+  return folly::netops::setsockopt(
+             sock.getNetworkSocket(),
+             SOL_SOCKET,
+             SO_TIMESTAMPNS,
+             &val,
+             sizeof(val)) == 0;
+#else
+  return false;
+#endif
+}
+
+folly::Optional<TimePoint> getReceiveTimestamp(
+    FOLLY_MAYBE_UNUSED struct msghdr& msg,
+    FOLLY_MAYBE_UNUSED TimePoint now) noexcept {
+#ifdef SO_TIMESTAMPNS
+  if (!msg.msg_control) {
+    return folly::none;
+  }
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPNS) {
+      struct timespec ts;
+      memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+      auto received = std::chrono::system_clock::time_point(
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              std::chrono::seconds(ts.tv_sec) +
+              std::chrono::nanoseconds(ts.tv_nsec)));
+      auto age = std::chrono::system_clock::now() - received;
+      // The wall clock was stepped between the receive and the read.
+      if (age < std::chrono::system_clock::duration::zero() ||
+          age > kMaxRxTimestampAge) {
+        return folly::none;
+      }
+      return now - std::chrono::duration_cast<Clock::duration>(age);
+    }
+  }
+#endif
+  return folly::none;
+}
+
+size_t getGROSegmentSize(FOLLY_MAYBE_UNUSED struct msghdr& msg) noexcept {
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  if (!msg.msg_control) {
+    return 0;
+  }
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+      int segmentSize = 0;
+      memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+      return segmentSize > 0 ? static_cast<size_t>(segmentSize) : 0;
+    }
+  }
+#endif
+  return 0;
+}
+
 } // namespace quic
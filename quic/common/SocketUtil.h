@@ -8,9 +8,11 @@
 
 #pragma once
 
+#include <folly/Optional.h>
 #include <folly/io/SocketOptionMap.h>
 #include <folly/io/async/AsyncUDPSocket.h>
 #include <folly/net/NetOps.h>
+#include <quic/QuicConstants.h>
 
 namespace quic {
 
@@ -20,4 +22,65 @@ void applySocketOptions(
     sa_family_t family,
     folly::SocketOptionKey::ApplyPos pos) noexcept;
 
+/**
+ * Lets the sends on the socket carry SCM_TXTIME departure times, in
+ * CLOCK_MONOTONIC nanoseconds. The times are enforced by the fq qdisc. Returns
+ * false if the platform or the socket does not support it.
+ */
+bool enableSocketTxTime(folly::AsyncUDPSocket& sock) noexcept;
+
+/**
+ * Lets the kernel coalesce the datagrams received on the socket with UDP_GRO.
+ * The segment size of a coalesced datagram is found with getGROSegmentSize.
+ * Returns false if the platform or the socket does not support it.
+ */
+bool enableSocketGRO(folly::AsyncUDPSocket& sock) noexcept;
+
+/**
+ * Sets SO_INCOMING_CPU on the socket, which makes the kernel prefer it within
+ * its SO_REUSEPORT group for packets received on that CPU. Returns false if
+ * the platform or the socket does not support it.
+ */
+bool setSocketIncomingCpu(folly::AsyncUDPSocket& sock, int cpu) noexcept;
+
+/**
+ * Asks the kernel to report the ECN bits of the received datagrams, through
+ * IP_RECVTOS and, on IPv6 sockets, IPV6_RECVTCLASS. They are read with
+ * getEcnCodepoint. Returns false if the platform or the socket does not
+ * support it.
+ */
+bool enableSocketEcnReceive(
+    folly::AsyncUDPSocket& sock,
+    sa_family_t family) noexcept;
+
+/**
+ * Returns the ECN codepoint of a datagram received with msg, or kEcnNotEct if
+ * the kernel didn't report one.
+ */
+uint8_t getEcnCodepoint(struct msghdr& msg) noexcept;
+
+/**
+ * Asks the kernel to report when it received each datagram, through
+ * SO_TIMESTAMPNS. The time is read with getReceiveTimestamp. Returns false if
+ * the platform or the socket does not support it.
+ */
+bool enableSocketRxTimestamps(folly::AsyncUDPSocket& sock) noexcept;
+
+/**
+ * Returns when the kernel received a datagram received with msg, on Clock.
+ * The kernel reports its wall clock time, which is mapped onto now, the time
+ * the read returned, by how long before the read it was. None if the kernel
+ * didn't report a time, or one that can't be trusted across a jump of the
+ * wall clock.
+ */
+folly::Optional<TimePoint> getReceiveTimestamp(
+    struct msghdr& msg,
+    TimePoint now) noexcept;
+
+/**
+ * Returns the UDP_GRO segment size of a datagram received with msg, or 0 if
+ * the datagram was not coalesced.
+ */
+size_t getGROSegmentSize(struct msghdr& msg) noexcept;
+
 } // namespace quic
@@ -8,51 +8,120 @@
 
 #pragma once
 
+#include <memory>
+#include <type_traits>
+
 namespace quic {
 
-#define UNION_TYPE(X, ...) X X##_;
+/**
+ * Members of a variant that are rare and much larger than the others can be
+ * stored out of line, so that they don't set the size of every instance. A
+ * type opts in by specializing VariantBoxed to std::true_type before the
+ * variant is declared.
+ */
+template <typename T>
+struct VariantBoxed : std::false_type {};
+
+template <typename T>
+class VariantBox {
+ public:
+  explicit VariantBox(T&& t) : ptr_(std::make_unique<T>(std::move(t))) {}
+
+  explicit VariantBox(const T& t) : ptr_(std::make_unique<T>(t)) {}
+
+  VariantBox(VariantBox&& other) = default;
+
+  VariantBox(const VariantBox& other)
+      : ptr_(other.ptr_ ? std::make_unique<T>(*other.ptr_) : nullptr) {}
+
+  T* get() {
+    return ptr_.get();
+  }
+
+  const T* get() const {
+    return ptr_.get();
+  }
+
+  bool operator==(const T& other) const {
+    return ptr_ && *ptr_ == other;
+  }
+
+ private:
+  std::unique_ptr<T> ptr_;
+};
+
+template <typename T>
+using VariantStorage =
+    std::conditional_t<VariantBoxed<T>::value, VariantBox<T>, T>;
+
+template <typename T>
+T* variantMember(T& t) {
+  return &t;
+}
+
+template <typename T>
+const T* variantMember(const T& t) {
+  return &t;
+}
+
+template <typename T>
+T* variantMember(VariantBox<T>& box) {
+  return box.get();
+}
+
+template <typename T>
+const T* variantMember(const VariantBox<T>& box) {
+  return box.get();
+}
+
+template <typename T>
+void destroyVariantMember(T& t) {
+  t.~T();
+}
+
+#define UNION_TYPE(X, ...) ::quic::VariantStorage<X> X##_;
 
 #define ENUM_TYPES(X, ...) X##_E,
 
-#define UNION_ACCESSOR(X, ...)  \
-  X* as##X() {                  \
-    if (type_ == Type::X##_E) { \
-      return &X##_;             \
-    }                           \
-    return nullptr;             \
+#define UNION_ACCESSOR(X, ...)            \
+  X* as##X() {                            \
+    if (type_ == Type::X##_E) {           \
+      return ::quic::variantMember(X##_); \
+    }                                     \
+    return nullptr;                       \
   }
 
-#define CONST_UNION_ACCESSOR(X, ...) \
-  const X* as##X() const {           \
-    if (type_ == Type::X##_E) {      \
-      return &X##_;                  \
-    }                                \
-    return nullptr;                  \
+#define CONST_UNION_ACCESSOR(X, ...)      \
+  const X* as##X() const {                \
+    if (type_ == Type::X##_E) {           \
+      return ::quic::variantMember(X##_); \
+    }                                     \
+    return nullptr;                       \
   }
 
-#define UNION_CTORS(X, NAME)         \
-  NAME(X&& x) : type_(Type::X##_E) { \
-    new (&X##_) X(std::move(x));     \
+#define UNION_CTORS(X, NAME)                             \
+  NAME(X&& x) : type_(Type::X##_E) {                     \
+    new (&X##_) ::quic::VariantStorage<X>(std::move(x)); \
   }
 
-#define UNION_COPY_CTORS(X, NAME)         \
-  NAME(const X& x) : type_(Type::X##_E) { \
-    new (&X##_) X(x);                     \
+#define UNION_COPY_CTORS(X, NAME)             \
+  NAME(const X& x) : type_(Type::X##_E) {     \
+    new (&X##_) ::quic::VariantStorage<X>(x); \
   }
 
-#define UNION_MOVE_CASES(X, other)        \
-  case Type::X##_E:                       \
-    new (&X##_) X(std::move(other.X##_)); \
+#define UNION_MOVE_CASES(X, other)                                \
+  case Type::X##_E:                                               \
+    new (&X##_) ::quic::VariantStorage<X>(std::move(other.X##_)); \
     break;
 
-#define UNION_COPY_CASES(X, other) \
-  case Type::X##_E:                \
-    new (&X##_) X(other.X##_);     \
+#define UNION_COPY_CASES(X, other)                     \
+  case Type::X##_E:                                    \
+    new (&X##_) ::quic::VariantStorage<X>(other.X##_); \
     break;
 
-#define DESTRUCTOR_CASES(X, ...) \
-  case Type::X##_E:              \
-    X##_.~X();                   \
+#define DESTRUCTOR_CASES(X, ...)        \
+  case Type::X##_E:                     \
+    ::quic::destroyVariantMember(X##_); \
     break;
 
 #define UNION_EQUALITY_CASES(X, other) \
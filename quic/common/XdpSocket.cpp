@@ -0,0 +1,710 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/XdpSocket.h>
+
+#include <folly/MPMCQueue.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if MVFST_HAVE_AF_XDP
+#include <linux/bpf.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef XDP_USE_NEED_WAKEUP
+#define XDP_USE_NEED_WAKEUP (1 << 3)
+#endif
+#ifndef XDP_RING_NEED_WAKEUP
+#define XDP_RING_NEED_WAKEUP (1 << 0)
+#endif
+#endif
+
+namespace quic {
+
+namespace {
+
+constexpr uint16_t kEthTypeIPv4 = 0x0800;
+constexpr uint16_t kEthTypeIPv6 = 0x86DD;
+constexpr uint16_t kEthTypeVlan = 0x8100;
+constexpr size_t kEthHeaderLen = 14;
+constexpr size_t kVlanTagLen = 4;
+constexpr size_t kIPv4HeaderLen = 20;
+constexpr size_t kIPv6HeaderLen = 40;
+constexpr size_t kUdpHeaderLen = 8;
+constexpr uint8_t kIpProtoUdp = 17;
+constexpr uint8_t kTtl = 64;
+
+uint16_t loadBE16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+void storeBE16(uint8_t* p, uint16_t value) {
+  p[0] = static_cast<uint8_t>(value >> 8);
+  p[1] = static_cast<uint8_t>(value & 0xff);
+}
+
+// adds len bytes to a ones' complement sum, folded by checksumFinish
+uint64_t checksumAdd(uint64_t sum, const uint8_t* data, size_t len) {
+  for (; len > 1; data += 2, len -= 2) {
+    sum += loadBE16(data);
+  }
+  if (len) {
+    sum += static_cast<uint16_t>(data[0] << 8);
+  }
+  return sum;
+}
+
+uint16_t checksumFinish(uint64_t sum) {
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return static_cast<uint16_t>(~sum & 0xffff);
+}
+
+// the key of the routes, IPv4 for IPv4-mapped addresses
+folly::IPAddress routeKey(const folly::IPAddress& ip) {
+  if (ip.isV6() && ip.asV6().isIPv4Mapped()) {
+    return folly::IPAddress(ip.asV6().createIPv4());
+  }
+  return ip;
+}
+
+} // namespace
+
+folly::Optional<XdpFrameInfo>
+parseXdpFrame(const uint8_t* frame, size_t len, uint16_t port) {
+  if (len < kEthHeaderLen) {
+    return folly::none;
+  }
+  XdpFrameInfo info;
+  memcpy(info.route.localMac.data(), frame, 6);
+  memcpy(info.route.peerMac.data(), frame + 6, 6);
+  size_t offset = 12;
+  uint16_t ethType = loadBE16(frame + offset);
+  offset += 2;
+  if (ethType == kEthTypeVlan) {
+    if (len < offset + kVlanTagLen) {
+      return folly::none;
+    }
+    info.route.vlan = loadBE16(frame + offset);
+    ethType = loadBE16(frame + offset + 2);
+    offset += kVlanTagLen;
+  }
+  folly::IPAddress peerIp;
+  size_t udpLen = 0;
+  if (ethType == kEthTypeIPv4) {
+    if (len < offset + kIPv4HeaderLen) {
+      return folly::none;
+    }
+    const uint8_t* ip = frame + offset;
+    size_t headerLen = (ip[0] & 0x0f) * 4;
+    size_t totalLen = loadBE16(ip + 2);
+    // the more fragments flag or a fragment offset
+    bool fragment = loadBE16(ip + 6) & 0x3fff;
+    if ((ip[0] >> 4) != 4 || headerLen < kIPv4HeaderLen ||
+        totalLen < headerLen || len < offset + totalLen ||
+        ip[9] != kIpProtoUdp || fragment) {
+      return folly::none;
+    }
+    info.ecn = ip[1] & kEcnMask;
+    peerIp = folly::IPAddress(
+        folly::IPAddressV4::fromBinary(folly::ByteRange(ip + 12, 4)));
+    info.route.localIp = folly::IPAddress(
+        folly::IPAddressV4::fromBinary(folly::ByteRange(ip + 16, 4)));
+    offset += headerLen;
+    udpLen = totalLen - headerLen;
+  } else if (ethType == kEthTypeIPv6) {
+    if (len < offset + kIPv6HeaderLen) {
+      return folly::none;
+    }
+    const uint8_t* ip = frame + offset;
+    size_t payloadLen = loadBE16(ip + 4);
+    if ((ip[0] >> 4) != 6 || ip[6] != kIpProtoUdp ||
+        len < offset + kIPv6HeaderLen + payloadLen) {
+      return folly::none;
+    }
+    // the traffic class follows the version
+    info.ecn = (loadBE16(ip) >> 4) & kEcnMask;
+    peerIp = folly::IPAddress(
+        folly::IPAddressV6::fromBinary(folly::ByteRange(ip + 8, 16)));
+    info.route.localIp = folly::IPAddress(
+        folly::IPAddressV6::fromBinary(folly::ByteRange(ip + 24, 16)));
+    offset += kIPv6HeaderLen;
+    udpLen = payloadLen;
+  } else {
+    return folly::none;
+  }
+  if (udpLen < kUdpHeaderLen) {
+    return folly::none;
+  }
+  const uint8_t* udp = frame + offset;
+  size_t datagramLen = loadBE16(udp + 4);
+  if (loadBE16(udp + 2) != port || datagramLen < kUdpHeaderLen ||
+      datagramLen > udpLen) {
+    return folly::none;
+  }
+  info.peer = folly::SocketAddress(peerIp, loadBE16(udp));
+  info.payloadOffset = offset + kUdpHeaderLen;
+  info.payloadLen = datagramLen - kUdpHeaderLen;
+  return info;
+}
+
+size_t xdpFrameHeaderLength(const XdpRoute& route) {
+  return kEthHeaderLen + (route.vlan ? kVlanTagLen : 0) +
+      (route.localIp.isV4() ? kIPv4HeaderLen : kIPv6HeaderLen) + kUdpHeaderLen;
+}
+
+size_t writeXdpFrame(
+    uint8_t* frame,
+    size_t capacity,
+    const XdpRoute& route,
+    uint16_t port,
+    const folly::SocketAddress& peer,
+    folly::io::Cursor& payload,
+    size_t payloadLen,
+    uint8_t ecn) {
+  auto peerIp = routeKey(peer.getIPAddress());
+  size_t headerLen = xdpFrameHeaderLength(route);
+  if (headerLen + payloadLen > capacity ||
+      peerIp.isV4() != route.localIp.isV4()) {
+    return 0;
+  }
+  memcpy(frame, route.peerMac.data(), 6);
+  memcpy(frame + 6, route.localMac.data(), 6);
+  size_t offset = 12;
+  if (route.vlan) {
+    storeBE16(frame + offset, kEthTypeVlan);
+    storeBE16(frame + offset + 2, *route.vlan);
+    offset += kVlanTagLen;
+  }
+  uint8_t* ip = frame + offset + 2;
+  size_t udpLen = kUdpHeaderLen + payloadLen;
+  uint8_t* udp;
+  uint64_t sum;
+  if (peerIp.isV4()) {
+    storeBE16(frame + offset, kEthTypeIPv4);
+    ip[0] = 0x45;
+    ip[1] = ecn & kEcnMask;
+    storeBE16(ip + 2, static_cast<uint16_t>(kIPv4HeaderLen + udpLen));
+    storeBE16(ip + 4, 0);
+    // don't fragment
+    storeBE16(ip + 6, 0x4000);
+    ip[8] = kTtl;
+    ip[9] = kIpProtoUdp;
+    storeBE16(ip + 10, 0);
+    memcpy(ip + 12, route.localIp.asV4().bytes(), 4);
+    memcpy(ip + 16, peerIp.asV4().bytes(), 4);
+    storeBE16(ip + 10, checksumFinish(checksumAdd(0, ip, kIPv4HeaderLen)));
+    // the pseudo header's addresses
+    sum = checksumAdd(0, ip + 12, 8);
+    udp = ip + kIPv4HeaderLen;
+  } else {
+    storeBE16(frame + offset, kEthTypeIPv6);
+    storeBE16(ip, static_cast<uint16_t>(0x6000 | ((ecn & kEcnMask) << 4)));
+    storeBE16(ip + 2, 0);
+    storeBE16(ip + 4, static_cast<uint16_t>(udpLen));
+    ip[6] = kIpProtoUdp;
+    ip[7] = kTtl;
+    memcpy(ip + 8, route.localIp.asV6().bytes(), 16);
+    memcpy(ip + 24, peerIp.asV6().bytes(), 16);
+    sum = checksumAdd(0, ip + 8, 32);
+    udp = ip + kIPv6HeaderLen;
+  }
+  sum += kIpProtoUdp + udpLen;
+  storeBE16(udp, port);
+  storeBE16(udp + 2, peer.getPort());
+  storeBE16(udp + 4, static_cast<uint16_t>(udpLen));
+  storeBE16(udp + 6, 0);
+  payload.pull(udp + kUdpHeaderLen, payloadLen);
+  auto checksum = checksumFinish(checksumAdd(sum, udp, udpLen));
+  // 0 stands for no checksum
+  storeBE16(udp + 6, checksum ? checksum : 0xffff);
+  return headerLen + payloadLen;
+}
+
+/**
+ * The memory of the frames, shared with the received buffers handed out in
+ * place. The last of the socket and the buffers deletes it.
+ */
+struct XdpSocket::Umem {
+  Umem(uint8_t* areaIn, size_t lenIn, uint32_t frameSizeIn, size_t numRxFrames)
+      : area(areaIn),
+        len(lenIn),
+        frameSize(frameSizeIn),
+        returnedFrames(std::max<size_t>(numRxFrames, 1)) {}
+
+  ~Umem();
+
+  // set when the frames are in huge pages, which unmap themselves
+  std::unique_ptr<HugePageRegion> hugePages;
+
+  static void freeBuffer(void* buf, void* userData) {
+    auto umem = static_cast<Umem*>(userData);
+    uint64_t addr = static_cast<uint8_t*>(buf) - umem->area;
+    // Never full, it has room for all the receive frames.
+    CHECK(umem->returnedFrames.write(addr - addr % umem->frameSize));
+    umem->release();
+  }
+
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // buffers handed out and not freed yet
+  size_t numHeld() const {
+    return refs.load(std::memory_order_acquire) - 1;
+  }
+
+  uint8_t* area;
+  size_t len;
+  uint32_t frameSize;
+  // receive frames whose buffers were freed, on any thread
+  folly::MPMCQueue<uint64_t> returnedFrames;
+  // one for the socket and one for each buffer handed out
+  std::atomic<size_t> refs{1};
+};
+
+#if MVFST_HAVE_AF_XDP
+
+XdpSocket::Umem::~Umem() {
+  if (!hugePages) {
+    munmap(area, len);
+  }
+}
+
+namespace {
+
+template <class T>
+T* ringEntries(void* entries) {
+  return static_cast<T*>(entries);
+}
+
+// the entries a producer ring has room for
+uint32_t
+ringFree(const uint32_t* producer, const uint32_t* consumer, size_t size) {
+  return static_cast<uint32_t>(
+      size - (*producer - __atomic_load_n(consumer, __ATOMIC_ACQUIRE)));
+}
+
+// the entries a consumer ring has for us
+uint32_t ringAvailable(const uint32_t* producer, const uint32_t* consumer) {
+  return __atomic_load_n(producer, __ATOMIC_ACQUIRE) - *consumer;
+}
+
+} // namespace
+
+std::shared_ptr<XdpSocket> XdpSocket::make(
+    folly::EventBase* evb,
+    const XdpSocketOptions& options,
+    const folly::SocketAddress& address) {
+  int fd = ::socket(AF_XDP, SOCK_RAW, 0);
+  if (fd < 0) {
+    VLOG(2) << "Unable to create an AF_XDP socket, errno=" << errno;
+    return nullptr;
+  }
+  std::shared_ptr<XdpSocket> sock(new XdpSocket(evb, fd, options, address));
+  if (!sock->setup()) {
+    return nullptr;
+  }
+  return sock;
+}
+
+XdpSocket::XdpSocket(
+    folly::EventBase* evb,
+    int fd,
+    const XdpSocketOptions& options,
+    const folly::SocketAddress& address)
+    : folly::EventHandler(evb, folly::NetworkSocket::fromFd(fd)),
+      fd_(fd),
+      options_(options),
+      port_(address.getPort()),
+      mapIPv4_(address.getFamily() == AF_INET6) {}
+
+bool XdpSocket::setup() {
+  if (options_.frameSize == 0 ||
+      (options_.frameSize & (options_.frameSize - 1)) ||
+      options_.ringSize == 0 || (options_.ringSize & (options_.ringSize - 1)) ||
+      options_.numFrames < 2) {
+    LOG(ERROR) << "Invalid AF_XDP frame or ring size";
+    return false;
+  }
+  auto ifindex = if_nametoindex(options_.interface.c_str());
+  if (ifindex == 0) {
+    LOG(ERROR) << "Unknown interface " << options_.interface;
+    return false;
+  }
+  size_t umemLen = size_t(options_.numFrames) * options_.frameSize;
+  std::unique_ptr<HugePageRegion> hugePages;
+  void* area;
+  if (options_.hugePages && (hugePages = HugePageRegion::make(umemLen))) {
+    area = hugePages->data();
+  } else {
+    area = mmap(
+        nullptr,
+        umemLen,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+        -1,
+        0);
+  }
+  if (area == MAP_FAILED) {
+    LOG(ERROR) << "Unable to allocate the UMEM, errno=" << errno;
+    return false;
+  }
+  numRxFrames_ = options_.numFrames / 2;
+  umem_ = new Umem(
+      static_cast<uint8_t*>(area), umemLen, options_.frameSize, numRxFrames_);
+  umem_->hugePages = std::move(hugePages);
+
+  xdp_umem_reg reg{};
+  reg.addr = reinterpret_cast<uint64_t>(area);
+  reg.len = umemLen;
+  reg.chunk_size = options_.frameSize;
+  reg.headroom = 0;
+  uint32_t ringSize = options_.ringSize;
+  if (setsockopt(fd_, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) ||
+      setsockopt(
+          fd_, SOL_XDP, XDP_UMEM_FILL_RING, &ringSize, sizeof(ringSize)) ||
+      setsockopt(
+          fd_,
+          SOL_XDP,
+          XDP_UMEM_COMPLETION_RING,
+          &ringSize,
+          sizeof(ringSize)) ||
+      setsockopt(fd_, SOL_XDP, XDP_RX_RING, &ringSize, sizeof(ringSize)) ||
+      setsockopt(fd_, SOL_XDP, XDP_TX_RING, &ringSize, sizeof(ringSize))) {
+    LOG(ERROR) << "Unable to set up the AF_XDP rings, errno=" << errno;
+    return false;
+  }
+  xdp_mmap_offsets offsets{};
+  socklen_t optlen = sizeof(offsets);
+  if (getsockopt(fd_, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &optlen)) {
+    LOG(ERROR) << "Unable to get the AF_XDP ring offsets, errno=" << errno;
+    return false;
+  }
+  auto mapRing = [&](Ring& ring,
+                     const xdp_ring_offset& offset,
+                     size_t entrySize,
+                     off_t pgoff) {
+    ring.mapLen = offset.desc + ringSize * entrySize;
+    ring.map = mmap(
+        nullptr,
+        ring.mapLen,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        fd_,
+        pgoff);
+    if (ring.map == MAP_FAILED) {
+      ring.map = nullptr;
+      return false;
+    }
+    auto base = static_cast<uint8_t*>(ring.map);
+    ring.producer = reinterpret_cast<uint32_t*>(base + offset.producer);
+    ring.consumer = reinterpret_cast<uint32_t*>(base + offset.consumer);
+    ring.flags = reinterpret_cast<uint32_t*>(base + offset.flags);
+    ring.entries = base + offset.desc;
+    ring.mask = ringSize - 1;
+    return true;
+  };
+  if (!mapRing(fill_, offsets.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) ||
+      !mapRing(
+          completion_,
+          offsets.cr,
+          sizeof(uint64_t),
+          XDP_UMEM_PGOFF_COMPLETION_RING) ||
+      !mapRing(rx_, offsets.rx, sizeof(xdp_desc), XDP_PGOFF_RX_RING) ||
+      !mapRing(tx_, offsets.tx, sizeof(xdp_desc), XDP_PGOFF_TX_RING)) {
+    LOG(ERROR) << "Unable to map the AF_XDP rings, errno=" << errno;
+    return false;
+  }
+
+  sockaddr_xdp sxdp{};
+  sxdp.sxdp_family = AF_XDP;
+  sxdp.sxdp_ifindex = ifindex;
+  sxdp.sxdp_queue_id = options_.queueId;
+  sxdp.sxdp_flags =
+      (options_.zeroCopy ? XDP_ZEROCOPY : XDP_COPY) | XDP_USE_NEED_WAKEUP;
+  if (bind(fd_, reinterpret_cast<sockaddr*>(&sxdp), sizeof(sxdp))) {
+    LOG(ERROR) << "Unable to bind the AF_XDP socket to " << options_.interface
+               << " queue " << options_.queueId << ", errno=" << errno;
+    return false;
+  }
+  if (options_.xskMapFd >= 0) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    uint32_t key = options_.queueId;
+    uint32_t value = fd_;
+    attr.map_fd = options_.xskMapFd;
+    attr.key = reinterpret_cast<uint64_t>(&key);
+    attr.value = reinterpret_cast<uint64_t>(&value);
+    attr.flags = BPF_ANY;
+    if (syscall(__NR_bpf, BPF_MAP_UPDATE_ELEM, &attr, sizeof(attr))) {
+      LOG(ERROR) << "Unable to add the AF_XDP socket to the XSKMAP, errno="
+                 << errno;
+      return false;
+    }
+  }
+
+  for (uint64_t i = 0; i < options_.numFrames; ++i) {
+    auto& frames = i < numRxFrames_ ? freeRxFrames_ : freeTxFrames_;
+    frames.push_back(i * options_.frameSize);
+  }
+  refillRx();
+  return true;
+}
+
+XdpSocket::~XdpSocket() {
+  unregisterHandler();
+  for (auto ring : {&fill_, &completion_, &rx_, &tx_}) {
+    if (ring->map) {
+      munmap(ring->map, ring->mapLen);
+    }
+  }
+  // Closing the socket takes it out of the XSKMAP.
+  ::close(fd_);
+  if (umem_) {
+    umem_->release();
+  }
+}
+
+void XdpSocket::resumeRead(ReadCallback* cb) {
+  readCallback_ = cb;
+  registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+}
+
+void XdpSocket::pauseRead() {
+  readCallback_ = nullptr;
+  unregisterHandler();
+}
+
+void XdpSocket::refillRx() {
+  uint64_t addr;
+  while (umem_->returnedFrames.read(addr)) {
+    freeRxFrames_.push_back(addr);
+  }
+  uint32_t count = std::min<size_t>(
+      freeRxFrames_.size(),
+      ringFree(fill_.producer, fill_.consumer, options_.ringSize));
+  if (count == 0) {
+    return;
+  }
+  uint32_t producer = *fill_.producer;
+  auto entries = ringEntries<uint64_t>(fill_.entries);
+  for (uint32_t i = 0; i < count; ++i) {
+    entries[(producer + i) & fill_.mask] = freeRxFrames_.back();
+    freeRxFrames_.pop_back();
+  }
+  __atomic_store_n(fill_.producer, producer + count, __ATOMIC_RELEASE);
+}
+
+void XdpSocket::reapTx() {
+  uint32_t count = ringAvailable(completion_.producer, completion_.consumer);
+  if (count == 0) {
+    return;
+  }
+  uint32_t consumer = *completion_.consumer;
+  auto entries = ringEntries<uint64_t>(completion_.entries);
+  for (uint32_t i = 0; i < count; ++i) {
+    freeTxFrames_.push_back(entries[(consumer + i) & completion_.mask]);
+  }
+  __atomic_store_n(completion_.consumer, consumer + count, __ATOMIC_RELEASE);
+}
+
+void XdpSocket::learnRoute(const XdpFrameInfo& info) {
+  auto key = routeKey(info.peer.getIPAddress());
+  auto it = routes_.find(key);
+  if (it != routes_.end()) {
+    it->second = info.route;
+    return;
+  }
+  if (routes_.size() >= options_.maxRoutes) {
+    // The peers still sending are learnt again with their next packet.
+    routes_.clear();
+  }
+  routes_.emplace(std::move(key), info.route);
+}
+
+bool XdpSocket::hasRoute(const folly::SocketAddress& peer) const {
+  return routes_.count(routeKey(peer.getIPAddress())) > 0;
+}
+
+void XdpSocket::handlerReady(uint16_t /* events */) noexcept {
+  reapTx();
+  refillRx();
+  uint32_t count = ringAvailable(rx_.producer, rx_.consumer);
+  uint32_t consumer = *rx_.consumer;
+  auto entries = ringEntries<xdp_desc>(rx_.entries);
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto& desc = entries[(consumer + i) & rx_.mask];
+    uint8_t* frame = umem_->area + desc.addr;
+    auto info = parseXdpFrame(frame, desc.len, port_);
+    if (!info || !readCallback_) {
+      // Not for the server, which the XDP program should have passed on.
+      freeRxFrames_.push_back(desc.addr - desc.addr % options_.frameSize);
+      continue;
+    }
+    learnRoute(*info);
+    std::unique_ptr<folly::IOBuf> data;
+    if (umem_->numHeld() < numRxFrames_ / 2) {
+      umem_->refs.fetch_add(1, std::memory_order_relaxed);
+      data = folly::IOBuf::takeOwnership(
+          frame,
+          options_.frameSize - desc.addr % options_.frameSize,
+          info->payloadOffset + info->payloadLen,
+          Umem::freeBuffer,
+          umem_);
+      data->trimStart(info->payloadOffset);
+    } else {
+      data = folly::IOBuf::copyBuffer(
+          frame + info->payloadOffset, info->payloadLen);
+      freeRxFrames_.push_back(desc.addr - desc.addr % options_.frameSize);
+    }
+    auto peer = info->peer;
+    if (mapIPv4_ && peer.getIPAddress().isV4()) {
+      peer = folly::SocketAddress(
+          folly::IPAddress(peer.getIPAddress().asV4().createIPv6()),
+          peer.getPort());
+    }
+    readCallback_->onXdpPacket(peer, std::move(data), info->ecn);
+  }
+  __atomic_store_n(rx_.consumer, consumer + count, __ATOMIC_RELEASE);
+  refillRx();
+  if (count > 0 && readCallback_) {
+    readCallback_->onXdpReadDone();
+  }
+}
+
+bool XdpSocket::write(
+    const folly::SocketAddress& peer,
+    const folly::IOBuf& buf,
+    size_t segmentSize,
+    uint8_t ecn) {
+  auto route = routes_.find(routeKey(peer.getIPAddress()));
+  if (route == routes_.end()) {
+    return false;
+  }
+  size_t len = buf.computeChainDataLength();
+  size_t segment = segmentSize ? std::min(segmentSize, len) : len;
+  size_t numSegments = segment ? (len + segment - 1) / segment : 1;
+  if (xdpFrameHeaderLength(route->second) + segment > options_.frameSize) {
+    return false;
+  }
+  reapTx();
+  if (freeTxFrames_.size() < numSegments ||
+      ringFree(tx_.producer, tx_.consumer, options_.ringSize) < numSegments) {
+    return false;
+  }
+  folly::io::Cursor cursor(&buf);
+  uint32_t producer = *tx_.producer;
+  auto entries = ringEntries<xdp_desc>(tx_.entries);
+  size_t remaining = len;
+  for (size_t i = 0; i < numSegments; ++i) {
+    uint64_t addr = freeTxFrames_.back();
+    freeTxFrames_.pop_back();
+    size_t payloadLen = std::min(segment, remaining);
+    remaining -= payloadLen;
+    auto frameLen = writeXdpFrame(
+        umem_->area + addr,
+        options_.frameSize,
+        route->second,
+        port_,
+        peer,
+        cursor,
+        payloadLen,
+        ecn);
+    DCHECK_GT(frameLen, 0);
+    auto& desc = entries[(producer + i) & tx_.mask];
+    desc.addr = addr;
+    desc.len = static_cast<uint32_t>(frameLen);
+    desc.options = 0;
+  }
+  __atomic_store_n(tx_.producer, producer + numSegments, __ATOMIC_RELEASE);
+  unflushedTx_ += numSegments;
+  return true;
+}
+
+void XdpSocket::flush() {
+  if (unflushedTx_ == 0) {
+    return;
+  }
+  unflushedTx_ = 0;
+  if (__atomic_load_n(tx_.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP) {
+    // EAGAIN and EBUSY only mean the kernel is still busy with earlier frames
+    // and picks these up with them.
+    sendto(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+  }
+}
+
+#else
+
+XdpSocket::Umem::~Umem() = default;
+
+std::shared_ptr<XdpSocket> XdpSocket::make(
+    folly::EventBase*,
+    const XdpSocketOptions&,
+    const folly::SocketAddress&) {
+  VLOG(2) << "Built without AF_XDP support";
+  return nullptr;
+}
+
+XdpSocket::XdpSocket(
+    folly::EventBase* evb,
+    int fd,
+    const XdpSocketOptions& options,
+    const folly::SocketAddress& address)
+    : folly::EventHandler(evb, folly::NetworkSocket::fromFd(fd)),
+      fd_(fd),
+      options_(options),
+      port_(address.getPort()),
+      mapIPv4_(false) {}
+
+XdpSocket::~XdpSocket() = default;
+
+bool XdpSocket::setup() {
+  return false;
+}
+
+void XdpSocket::resumeRead(ReadCallback*) {}
+
+void XdpSocket::pauseRead() {}
+
+void XdpSocket::refillRx() {}
+
+void XdpSocket::reapTx() {}
+
+void XdpSocket::learnRoute(const XdpFrameInfo&) {}
+
+bool XdpSocket::hasRoute(const folly::SocketAddress&) const {
+  return false;
+}
+
+void XdpSocket::handlerReady(uint16_t) noexcept {}
+
+bool XdpSocket::write(
+    const folly::SocketAddress&,
+    const folly::IOBuf&,
+    size_t,
+    uint8_t) {
+  return false;
+}
+
+void XdpSocket::flush() {}
+
+#endif
+
+} // namespace quic
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/container/F14Map.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventHandler.h>
+#include <quic/QuicConstants.h>
+#include <quic/common/BufUtil.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+struct XdpSocketOptions {
+  // the NIC and the queue of it the socket is bound to
+  std::string interface;
+  uint32_t queueId{0};
+  // The XSKMAP of the XDP program attached to the interface. The program
+  // redirects the UDP packets to the server's port on the queue to the entry
+  // of the queue, and passes everything else on to the kernel.
+  int xskMapFd{-1};
+  // Half of the frames of the UMEM receive and half transmit. The frame size
+  // must be a power of two, 2048 or 4096, the ring size a power of two.
+  uint32_t numFrames{4096};
+  uint32_t frameSize{2048};
+  uint32_t ringSize{1024};
+  // needs driver support, the copy mode works on any NIC
+  bool zeroCopy{false};
+  // the UMEM is a HugePageRegion, like the pooled packet buffers can be
+  bool hugePages{false};
+  // the peers a route is kept for, the routes are forgotten past that
+  size_t maxRoutes{64 * 1024};
+};
+
+/**
+ * How the frames to a peer are addressed, learnt from the frames received
+ * from it: the replies go back to the MAC they came from, from the address
+ * they were sent to.
+ */
+struct XdpRoute {
+  std::array<uint8_t, 6> localMac{};
+  std::array<uint8_t, 6> peerMac{};
+  // the tag control information of the 802.1Q tag, if the frames have one
+  folly::Optional<uint16_t> vlan;
+  folly::IPAddress localIp;
+};
+
+struct XdpFrameInfo {
+  XdpRoute route;
+  folly::SocketAddress peer;
+  uint8_t ecn{kEcnNotEct};
+  // where the UDP payload is in the frame
+  size_t payloadOffset{0};
+  size_t payloadLen{0};
+};
+
+/**
+ * Parses an Ethernet frame carrying a UDP datagram to port, over IPv4 or
+ * IPv6 without extension headers. None for anything else, and for IPv4
+ * fragments. The checksums are not verified, the packet protection of QUIC
+ * covers the payload.
+ */
+folly::Optional<XdpFrameInfo>
+parseXdpFrame(const uint8_t* frame, size_t len, uint16_t port);
+
+// bytes the headers of a frame along route take
+size_t xdpFrameHeaderLength(const XdpRoute& route);
+
+/**
+ * Writes a frame along route, from port to peer, with the next payloadLen
+ * bytes of payload and the checksums. Returns its length, or 0 if it doesn't
+ * fit capacity or peer is not of the family of the route.
+ */
+size_t writeXdpFrame(
+    uint8_t* frame,
+    size_t capacity,
+    const XdpRoute& route,
+    uint16_t port,
+    const folly::SocketAddress& peer,
+    folly::io::Cursor& payload,
+    size_t payloadLen,
+    uint8_t ecn);
+
+/**
+ * An AF_XDP socket bound to one queue of a NIC, which a server worker reads
+ * the packets to its port from and writes the packets to the peers it has
+ * seen on it to, bypassing the kernel's UDP stack. The UMEM, the memory the
+ * frames are in, and the rings are the socket's own. Received payloads are
+ * handed out in place, as long as at most half of the receive frames are
+ * held by them, and copied past that so the NIC keeps getting frames.
+ *
+ * Everything but freeing the received buffers happens on the event base's
+ * thread. Only built with MVFST_HAVE_AF_XDP, make returns null otherwise.
+ */
+class XdpSocket : public folly::EventHandler {
+ public:
+  class ReadCallback {
+   public:
+    virtual ~ReadCallback() = default;
+
+    // a datagram from peer
+    virtual void onXdpPacket(
+        const folly::SocketAddress& peer,
+        std::unique_ptr<folly::IOBuf> data,
+        uint8_t ecn) noexcept = 0;
+
+    // after the packets of one wakeup
+    virtual void onXdpReadDone() noexcept {}
+  };
+
+  /**
+   * Sets up the socket for the datagrams to port, with the family of the
+   * server socket's address. Null if the socket can't be set up, the server
+   * then only uses the kernel's.
+   */
+  static std::shared_ptr<XdpSocket> make(
+      folly::EventBase* evb,
+      const XdpSocketOptions& options,
+      const folly::SocketAddress& address);
+
+  ~XdpSocket() override;
+
+  XdpSocket(const XdpSocket&) = delete;
+  XdpSocket& operator=(const XdpSocket&) = delete;
+
+  void resumeRead(ReadCallback* cb);
+  void pauseRead();
+
+  /**
+   * Posts buf to peer, one frame for each segmentSize bytes of it, or one for
+   * all of it if segmentSize is 0. Returns false, and posts nothing, if no
+   * packets came from peer yet or there are not enough free frames, the
+   * caller then sends buf through the kernel.
+   */
+  bool write(
+      const folly::SocketAddress& peer,
+      const folly::IOBuf& buf,
+      size_t segmentSize,
+      uint8_t ecn);
+
+  // wakes the kernel up for the frames posted since the last flush
+  void flush();
+
+  // whether packets to peer can be posted
+  bool hasRoute(const folly::SocketAddress& peer) const;
+
+ private:
+  struct Ring {
+    uint32_t* producer{nullptr};
+    uint32_t* consumer{nullptr};
+    uint32_t* flags{nullptr};
+    void* entries{nullptr};
+    uint32_t mask{0};
+    void* map{nullptr};
+    size_t mapLen{0};
+  };
+  struct Umem;
+
+  XdpSocket(
+      folly::EventBase* evb,
+      int fd,
+      const XdpSocketOptions& options,
+      const folly::SocketAddress& address);
+
+  bool setup();
+
+  void handlerReady(uint16_t events) noexcept override;
+
+  // hands the free receive frames to the NIC
+  void refillRx();
+  // takes the sent frames back
+  void reapTx();
+
+  void learnRoute(const XdpFrameInfo& info);
+
+  int fd_;
+  XdpSocketOptions options_;
+  uint16_t port_;
+  // peers are reported as IPv4-mapped addresses on an IPv6 server socket
+  bool mapIPv4_;
+  Umem* umem_{nullptr};
+  Ring fill_;
+  Ring completion_;
+  Ring rx_;
+  Ring tx_;
+  size_t numRxFrames_{0};
+  std::vector<uint64_t> freeRxFrames_;
+  std::vector<uint64_t> freeTxFrames_;
+  // frames posted since the last flush
+  size_t unflushedTx_{0};
+  folly::F14FastMap<folly::IPAddress, XdpRoute> routes_;
+  ReadCallback* readCallback_{nullptr};
+};
+
+} // namespace quic
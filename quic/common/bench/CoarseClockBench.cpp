@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// The clock reads of the per packet bookkeeping on a server worker's read
+// path, from Clock::now() and from a CoarseClock refreshed on every batch of
+// kBenchBatchPackets reads, the way QuicServerWorker does. Of the
+// kBenchReadsPerPacket reads of a packet, kBenchPreciseReadsPerPacket are rtt
+// samples and timers, which keep reading Clock::now() either way.
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/io/async/EventBase.h>
+
+#include <quic/common/CoarseClock.h>
+
+#include <cstdio>
+
+using namespace quic;
+
+namespace {
+
+constexpr size_t kBenchBatchPackets = 16;
+// The flow control update on the read, the head of line blocking time and
+// app idle, and the receive time of the packet.
+constexpr size_t kBenchReadsPerPacket = 4;
+constexpr size_t kBenchPreciseReadsPerPacket = 1;
+
+template <typename CoarseNow>
+void readBatch(CoarseNow&& coarseNow) {
+  for (size_t packet = 0; packet < kBenchBatchPackets; ++packet) {
+    folly::doNotOptimizeAway(Clock::now());
+    for (size_t read = kBenchPreciseReadsPerPacket;
+         read < kBenchReadsPerPacket;
+         ++read) {
+      folly::doNotOptimizeAway(coarseNow());
+    }
+  }
+}
+
+// Clock reads per packet, with a clock that counts them.
+double clockReadsPerPacket(bool coarse) {
+  constexpr size_t kBatches = 100;
+  folly::EventBase evb;
+  size_t reads = 0;
+  CoarseClock clock(&evb, [&reads] {
+    reads++;
+    return Clock::now();
+  });
+  for (size_t batch = 0; batch < kBatches; ++batch) {
+    if (coarse) {
+      clock.refresh();
+    }
+    readBatch([&] { return coarse ? clock.now() : (reads++, Clock::now()); });
+  }
+  // The precise reads aren't counted by the clock.
+  reads += kBatches * kBenchBatchPackets * kBenchPreciseReadsPerPacket;
+  return static_cast<double>(reads) / (kBatches * kBenchBatchPackets);
+}
+
+} // namespace
+
+BENCHMARK(ReadBatchClock, iters) {
+  while (iters--) {
+    readBatch([] { return Clock::now(); });
+  }
+}
+
+BENCHMARK_RELATIVE(ReadBatchCoarseClock, iters) {
+  folly::Optional<folly::EventBase> evb;
+  folly::Optional<CoarseClock> clock;
+  BENCHMARK_SUSPEND {
+    evb.emplace();
+    clock.emplace(evb.get_pointer());
+  }
+  while (iters--) {
+    clock->refresh();
+    readBatch([&] { return clock->now(); });
+  }
+  BENCHMARK_SUSPEND {
+    clock.clear();
+    evb.clear();
+  }
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  printf(
+      "Clock reads per packet: %.2f with Clock, %.2f with CoarseClock\n",
+      clockReadsPerPacket(false),
+      clockReadsPerPacket(true));
+  folly::runBenchmarks();
+  return 0;
+}
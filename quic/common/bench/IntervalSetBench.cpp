@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// Inserts of kBenchPackets packet numbers into an IntervalSet, with the
+// default deque and with the inline small vector of AckBlocks, in the orders
+// a receiver sees them: in order, reordered within small windows, and with
+// losses that are filled in by retransmissions later.
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/codec/Types.h>
+#include <quic/common/IntervalSet.h>
+
+#include <vector>
+
+using namespace quic;
+
+namespace {
+
+constexpr PacketNum kBenchPackets = 1000;
+// Every this many packets one is lost in the lossy order.
+constexpr PacketNum kBenchLossInterval = 20;
+// The retransmissions of the lost packets arrive this many packets later.
+constexpr PacketNum kBenchRetransmitDelay = 100;
+
+std::vector<PacketNum> inOrder() {
+  std::vector<PacketNum> order;
+  for (PacketNum num = 0; num < kBenchPackets; ++num) {
+    order.push_back(num);
+  }
+  return order;
+}
+
+// Each group of four packets arrives backwards.
+std::vector<PacketNum> reordered() {
+  std::vector<PacketNum> order;
+  for (PacketNum num = 0; num < kBenchPackets; ++num) {
+    order.push_back(num ^ 3);
+  }
+  return order;
+}
+
+// Each lost packet leaves a gap that its retransmission fills in later.
+std::vector<PacketNum> lossy() {
+  std::vector<PacketNum> order;
+  for (PacketNum num = 0; num < kBenchPackets + kBenchRetransmitDelay;
+       ++num) {
+    if (num < kBenchPackets && num % kBenchLossInterval != 0) {
+      order.push_back(num);
+    }
+    if (num >= kBenchRetransmitDelay &&
+        (num - kBenchRetransmitDelay) % kBenchLossInterval == 0) {
+      order.push_back(num - kBenchRetransmitDelay);
+    }
+  }
+  return order;
+}
+
+template <typename Set>
+void insertAll(size_t iters, std::vector<PacketNum> (*makeOrder)()) {
+  std::vector<PacketNum> order;
+  BENCHMARK_SUSPEND {
+    order = makeOrder();
+  }
+  while (iters--) {
+    Set set;
+    for (auto num : order) {
+      set.insert(num);
+    }
+    folly::doNotOptimizeAway(set.size());
+  }
+}
+
+using DequeSet = IntervalSet<PacketNum>;
+
+} // namespace
+
+BENCHMARK(InOrderDeque, iters) {
+  insertAll<DequeSet>(iters, inOrder);
+}
+
+BENCHMARK_RELATIVE(InOrderSmallVec, iters) {
+  insertAll<AckBlocks>(iters, inOrder);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(ReorderedDeque, iters) {
+  insertAll<DequeSet>(iters, reordered);
+}
+
+BENCHMARK_RELATIVE(ReorderedSmallVec, iters) {
+  insertAll<AckBlocks>(iters, reordered);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(LossyDeque, iters) {
+  insertAll<DequeSet>(iters, lossy);
+}
+
+BENCHMARK_RELATIVE(LossySmallVec, iters) {
+  insertAll<AckBlocks>(iters, lossy);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
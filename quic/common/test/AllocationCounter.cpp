@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/test/AllocationCounter.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace quic {
+namespace test {
+
+namespace {
+// Plain data, so that it needs no initialization when operator new first
+// touches it on a thread.
+thread_local uint64_t allocationCount = 0;
+
+inline void* countedAllocation(size_t size) noexcept {
+  allocationCount++;
+  return std::malloc(size ? size : 1);
+}
+} // namespace
+
+ScopedAllocationCounter::ScopedAllocationCounter() noexcept
+    : start_(allocationCount) {}
+
+uint64_t ScopedAllocationCounter::count() const noexcept {
+  return allocationCount - start_;
+}
+
+} // namespace test
+} // namespace quic
+
+void* operator new(size_t size) {
+  auto ptr = quic::test::countedAllocation(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return quic::test::countedAllocation(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return quic::test::countedAllocation(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t /*size*/) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
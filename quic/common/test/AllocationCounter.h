@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace quic {
+namespace test {
+
+/**
+ * Counts the allocations made through operator new by the thread that
+ * constructed it, for as long as it lives. It is for the tests that bound
+ * what the hot paths allocate, linking it in replaces the global operator new
+ * of the test binary. Memory that is malloc'ed directly, like the buffers of
+ * folly::IOBuf::create, is not counted.
+ */
+class ScopedAllocationCounter {
+ public:
+  ScopedAllocationCounter() noexcept;
+
+  ScopedAllocationCounter(const ScopedAllocationCounter&) = delete;
+  ScopedAllocationCounter& operator=(const ScopedAllocationCounter&) = delete;
+
+  uint64_t count() const noexcept;
+
+ private:
+  uint64_t start_;
+};
+
+} // namespace test
+} // namespace quic
@@ -133,6 +133,49 @@ TEST(BufQueue, SplitEmptt) {
   EXPECT_EQ(res->computeChainDataLength(), 0);
 }
 
+TEST(BufQueue, SplitUnshared) {
+  BufQueue queue;
+  queue.append(IOBuf::copyBuffer(SCL("Hello, World")));
+  const uint8_t* start = queue.front()->data();
+  auto prefix = queue.splitUnsharedAtMost(6);
+  checkConsistency(queue);
+  EXPECT_FALSE(prefix->isShared());
+  EXPECT_EQ(start, prefix->data());
+  EXPECT_EQ("Hello,", StringPiece(prefix->coalesce()));
+  EXPECT_EQ(6, queue.chainLength());
+
+  auto rest = queue.splitUnsharedAtMost(10);
+  checkConsistency(queue);
+  EXPECT_FALSE(rest->isShared());
+  EXPECT_EQ(start + 6, rest->data());
+  EXPECT_EQ(" World", StringPiece(rest->coalesce()));
+  EXPECT_EQ((IOBuf*)nullptr, queue.front());
+
+  // The views keep the memory alive on their own.
+  prefix.reset();
+  EXPECT_EQ(" World", StringPiece(rest->coalesce()));
+}
+
+TEST(BufQueue, SplitUnsharedWholeBuffer) {
+  BufQueue queue;
+  auto data = IOBuf::copyBuffer(SCL("Hello"));
+  const IOBuf* original = data.get();
+  queue.append(std::move(data));
+  auto buf = queue.splitUnsharedAtMost(5);
+  EXPECT_EQ(original, buf.get());
+  EXPECT_EQ(0, queue.chainLength());
+}
+
+TEST(BufQueue, SplitUnsharedChained) {
+  BufQueue queue;
+  queue.append(IOBuf::copyBuffer(SCL("Hello")));
+  queue.append(IOBuf::copyBuffer(SCL(" World")));
+  auto prefix = queue.splitUnsharedAtMost(7);
+  checkConsistency(queue);
+  EXPECT_EQ("Hello W", prefix->moveToFbString().toStdString());
+  EXPECT_EQ(4, queue.chainLength());
+}
+
 TEST(BufQueue, TrimStartAtMost) {
   BufQueue queue;
   queue.append(IOBuf::copyBuffer(SCL("Hello")));
@@ -176,6 +219,59 @@ TEST(BufQueue, TrimStartAtMost) {
   checkConsistency(queue);
 }
 
+TEST(BufQueue, AppendPacked) {
+  BufQueue queue;
+  queue.appendPacked(IOBuf::copyBuffer(SCL("Hello")), 8, 16);
+  queue.appendPacked(IOBuf::copyBuffer(SCL(" ")), 8, 16);
+  queue.appendPacked(IOBuf::copyBuffer(SCL("World")), 8, 16);
+  checkConsistency(queue);
+  EXPECT_EQ(1, queue.front()->countChainElements());
+
+  // Too large to copy
+  queue.appendPacked(IOBuf::copyBuffer(SCL("Hello World")), 8, 16);
+  checkConsistency(queue);
+  EXPECT_EQ(2, queue.front()->countChainElements());
+
+  // Not copied into a buffer the queue did not allocate
+  queue.appendPacked(IOBuf::copyBuffer(SCL("!")), 8, 16);
+  checkConsistency(queue);
+  EXPECT_EQ(3, queue.front()->countChainElements());
+
+  // Nor into one without the room
+  auto tailroom = queue.front()->prev()->tailroom();
+  queue.appendPacked(
+      IOBuf::copyBuffer(std::string(tailroom + 1, 'a')), tailroom + 1, 16);
+  checkConsistency(queue);
+  EXPECT_EQ(4, queue.front()->countChainElements());
+
+  EXPECT_EQ(
+      "Hello WorldHello World!" + std::string(tailroom + 1, 'a'),
+      queue.move()->moveToFbString().toStdString());
+}
+
+TEST(BufQueue, AppendPackedAfterSplit) {
+  BufQueue queue;
+  queue.appendPacked(IOBuf::copyBuffer(SCL("Hello")), 8, 16);
+  auto prefix = queue.splitAtMost(3);
+  checkConsistency(queue);
+  // The page is shared with prefix, it is still packed past its end.
+  queue.appendPacked(IOBuf::copyBuffer(SCL("World")), 8, 16);
+  checkConsistency(queue);
+  EXPECT_EQ(1, queue.front()->countChainElements());
+  EXPECT_EQ(prefix->data() + 3, queue.front()->data());
+  EXPECT_EQ(3, prefix->length());
+  auto clonedPrefix = prefix->clone();
+  EXPECT_EQ("Hel", clonedPrefix->moveToFbString().toStdString());
+
+  prefix = queue.splitAtMost(queue.chainLength());
+  EXPECT_EQ(nullptr, queue.front());
+  queue.appendPacked(IOBuf::copyBuffer(SCL("Hello")), 8, 16);
+  checkConsistency(queue);
+  EXPECT_EQ(1, queue.front()->countChainElements());
+  EXPECT_EQ("loWorld", prefix->moveToFbString().toStdString());
+  EXPECT_EQ("Hello", queue.move()->moveToFbString().toStdString());
+}
+
 TEST(BufAppender, TestPushAlreadyFits) {
   std::unique_ptr<folly::IOBuf> data = folly::IOBuf::create(10);
   BufAppender appender(data.get(), 10);
@@ -263,6 +359,30 @@ TEST(BufAppender, TestInsertIOBufMoved) {
   EXPECT_EQ(helloStr, "hello12456");
 }
 
+TEST(BufAppender, TestInsertChainThenPush) {
+  std::unique_ptr<folly::IOBuf> data = folly::IOBuf::create(0);
+  BufAppender appender(data.get(), 20);
+  auto chain = IOBuf::copyBuffer("hello");
+  auto world = IOBuf::copyBuffer(std::string("world"), 0, 10);
+  folly::IOBuf* worldPtr = world.get();
+  chain->prependChain(std::move(world));
+  auto sharedChain = IOBuf::copyBuffer("foo");
+  sharedChain->prependChain(IOBuf::copyBuffer(std::string("bar"), 0, 10));
+
+  appender.insert(std::move(chain));
+  std::string str = "12456";
+  appender.push((uint8_t*)str.data(), str.size());
+  appender.insert(sharedChain->clone());
+  appender.push((uint8_t*)str.data(), str.size());
+
+  // Pushes land after the whole chain, in the tailroom of its unshared last
+  // buffer, and never in the buffers of a shared chain.
+  EXPECT_EQ(
+      worldPtr->cloneOne()->moveToFbString().toStdString(), "world12456");
+  EXPECT_EQ(data->moveToFbString().toStdString(), "helloworld12456foobar12456");
+  EXPECT_EQ(sharedChain->moveToFbString().toStdString(), "foobar");
+}
+
 TEST(BufAppender, TestBigEndianOneByte) {
   uint8_t oneByte = 0x12;
 
@@ -302,3 +422,105 @@ TEST(BufAppender, TestBigEndianEightBytes) {
   std::string out = folly::hexlify(data->coalesce());
   EXPECT_EQ(out, "0000bc9a78563412");
 }
+
+TEST(PacketBufferPool, AcquireReleaseReuses) {
+  PacketBufferPool pool(1500, 2);
+  auto buf = pool.acquire(1200);
+  EXPECT_GE(buf->capacity(), 1500);
+  EXPECT_EQ(0, buf->length());
+  auto rawPtr = buf.get();
+  buf->append(1000);
+  pool.release(std::move(buf));
+  EXPECT_EQ(1, pool.available());
+
+  auto reused = pool.acquire(1200);
+  EXPECT_EQ(rawPtr, reused.get());
+  EXPECT_EQ(0, reused->length());
+  EXPECT_EQ(0, reused->headroom());
+  EXPECT_EQ(0, pool.available());
+}
+
+TEST(PacketBufferPool, OversizedAcquireAllocates) {
+  PacketBufferPool pool(1500, 2);
+  pool.release(pool.acquire(100));
+  EXPECT_EQ(1, pool.available());
+  auto big = pool.acquire(4000);
+  EXPECT_GE(big->capacity(), 4000);
+  EXPECT_EQ(1, pool.available());
+}
+
+TEST(PacketBufferPool, ReleaseDropsSharedAndSmallAndOverflow) {
+  PacketBufferPool pool(1500, 1);
+  auto shared = pool.acquire(1500);
+  auto clone = shared->cloneOne();
+  pool.release(std::move(shared));
+  EXPECT_EQ(0, pool.available());
+
+  pool.release(IOBuf::create(10));
+  EXPECT_EQ(0, pool.available());
+
+  pool.release(pool.acquire(1500));
+  pool.release(pool.acquire(1500));
+  pool.release(IOBuf::create(1500));
+  EXPECT_EQ(1, pool.available());
+}
+
+TEST(PacketBufferPool, ReleaseChain) {
+  PacketBufferPool pool(1500, 10);
+  auto chain = pool.acquire(1500);
+  chain->prependChain(pool.acquire(1500));
+  chain->prependChain(pool.acquire(1500));
+  pool.releaseChain(std::move(chain));
+  EXPECT_EQ(3, pool.available());
+}
+
+TEST(PacketBufferPool, HugePagesPreallocates) {
+  PacketBufferPool pool(1500, 4, true);
+  auto stats = pool.stats();
+  EXPECT_EQ(4, stats.available);
+  EXPECT_GE(stats.regionBytes, kHugePageSize);
+  EXPECT_EQ(0, stats.regionBytes % kHugePageSize);
+
+  std::vector<Buf> bufs;
+  for (int i = 0; i < 4; ++i) {
+    bufs.push_back(pool.acquire(1500));
+    EXPECT_GE(bufs.back()->capacity(), 1500);
+  }
+  EXPECT_EQ(0, pool.stats().allocations);
+  auto heap = pool.acquire(1500);
+  EXPECT_EQ(1, pool.stats().allocations);
+  // only the pool's own buffers are kept
+  pool.release(std::move(heap));
+  EXPECT_EQ(0, pool.available());
+
+  pool.release(std::move(bufs[0]));
+  EXPECT_EQ(1, pool.available());
+  // a freed buffer gives its memory back to the pool
+  const uint8_t* freed = bufs[1]->buffer();
+  bufs[1].reset();
+  auto pooled = pool.acquire(1500);
+  auto reused = pool.acquire(1500);
+  EXPECT_EQ(freed, reused->buffer());
+  EXPECT_EQ(1, pool.stats().allocations);
+}
+
+TEST(SplitSegments, Split) {
+  auto data = IOBuf::copyBuffer("aaaabbbbcc");
+  const uint8_t* start = data->data();
+  std::vector<Buf> segments;
+  splitSegments(std::move(data), 4, segments);
+  ASSERT_EQ(3, segments.size());
+  EXPECT_EQ("aaaa", StringPiece(segments[0]->coalesce()));
+  EXPECT_EQ(start + 4, segments[1]->data());
+  EXPECT_EQ("bbbb", StringPiece(segments[1]->coalesce()));
+  EXPECT_EQ("cc", StringPiece(segments[2]->coalesce()));
+}
+
+TEST(SplitSegments, NotCoalesced) {
+  std::vector<Buf> segments;
+  splitSegments(IOBuf::copyBuffer("aaaa"), 0, segments);
+  splitSegments(IOBuf::copyBuffer("bbbb"), 4, segments);
+  ASSERT_EQ(2, segments.size());
+  EXPECT_EQ("aaaa", StringPiece(segments[0]->coalesce()));
+  EXPECT_EQ("bbbb", StringPiece(segments[1]->coalesce()));
+}
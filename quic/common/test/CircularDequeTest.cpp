@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/CircularDeque.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+using namespace quic;
+
+TEST(CircularDequeTest, PushAndPopAcrossTheWrap) {
+  CircularDeque<int> deque;
+  EXPECT_TRUE(deque.empty());
+  std::deque<int> expected;
+  for (int i = 0; i < 100; ++i) {
+    deque.emplace_back(i);
+    expected.push_back(i);
+    if (i % 3 == 0) {
+      deque.pop_front();
+      expected.pop_front();
+    }
+  }
+  deque.emplace_front(-1);
+  expected.push_front(-1);
+  ASSERT_EQ(expected.size(), deque.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), deque.begin()));
+  EXPECT_EQ(expected.front(), deque.front());
+  EXPECT_EQ(expected.back(), deque.back());
+}
+
+TEST(CircularDequeTest, KeepsSortedWithInsertAndErase) {
+  CircularDeque<std::pair<uint64_t, int>> deque;
+  auto insert = [&](uint64_t offset, int value) {
+    auto pos = std::upper_bound(
+        deque.begin(),
+        deque.end(),
+        offset,
+        [](uint64_t o, const std::pair<uint64_t, int>& p) {
+          return o < p.first;
+        });
+    deque.emplace(pos, offset, value);
+  };
+  // Wrap around the ring before inserting in the middle.
+  for (int i = 0; i < 3; ++i) {
+    insert(i, i);
+    deque.pop_front();
+  }
+  insert(10, 0);
+  insert(30, 1);
+  insert(20, 2);
+  insert(20, 3);
+  insert(5, 4);
+  std::vector<std::pair<uint64_t, int>> expected = {
+      {5, 4}, {10, 0}, {20, 2}, {20, 3}, {30, 1}};
+  ASSERT_EQ(expected.size(), deque.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), deque.begin()));
+
+  auto next = deque.erase(deque.begin() + 2);
+  EXPECT_EQ(20, next->first);
+  EXPECT_EQ(3, next->second);
+  EXPECT_EQ(4, deque.size());
+  EXPECT_EQ(30, deque.back().first);
+}
+
+TEST(CircularDequeTest, CopyAndMove) {
+  CircularDeque<std::unique_ptr<int>> owners;
+  owners.emplace_back(std::make_unique<int>(1));
+  owners.emplace_back(std::make_unique<int>(2));
+  auto moved = std::move(owners);
+  EXPECT_TRUE(owners.empty());
+  ASSERT_EQ(2, moved.size());
+  EXPECT_EQ(2, *moved.back());
+
+  CircularDeque<int> deque;
+  deque.emplace_back(1);
+  deque.emplace_back(2);
+  auto copy = deque;
+  deque.pop_front();
+  ASSERT_EQ(2, copy.size());
+  EXPECT_EQ(1, copy.front());
+  EXPECT_EQ(1, deque.size());
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/CoarseClock.h>
+#include <quic/state/StateData.h>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace folly;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class CoarseClockTest : public Test {
+ public:
+  void SetUp() override {
+    time_ = Clock::now();
+    clock_ = std::make_shared<CoarseClock>(&evb_, [this] {
+      reads_++;
+      time_ += 1ms;
+      return time_;
+    });
+  }
+
+  EventBase evb_;
+  TimePoint time_;
+  size_t reads_{0};
+  std::shared_ptr<CoarseClock> clock_;
+};
+
+TEST_F(CoarseClockTest, ReadOncePerLoop) {
+  std::vector<TimePoint> times;
+  for (int i = 0; i < 100; i++) {
+    evb_.runInLoop([&] { times.push_back(clock_->now()); });
+  }
+  evb_.loopOnce();
+  EXPECT_EQ(1, reads_);
+  ASSERT_EQ(100, times.size());
+  for (auto& time : times) {
+    EXPECT_EQ(time_, time);
+  }
+
+  evb_.runInLoop([&] { times.push_back(clock_->now()); });
+  evb_.loopOnce();
+  EXPECT_EQ(2, reads_);
+  EXPECT_EQ(time_, times.back());
+  EXPECT_LT(times.front(), times.back());
+}
+
+TEST_F(CoarseClockTest, NoReadWhenUnused) {
+  evb_.loopOnce();
+  evb_.loopOnce();
+  EXPECT_EQ(0, reads_);
+}
+
+TEST_F(CoarseClockTest, Refresh) {
+  auto first = clock_->now();
+  EXPECT_EQ(first, clock_->now());
+  auto refreshed = clock_->refresh();
+  EXPECT_EQ(2, reads_);
+  EXPECT_LT(first, refreshed);
+  EXPECT_EQ(refreshed, clock_->now());
+  evb_.loopOnce();
+  EXPECT_LT(refreshed, clock_->now());
+  EXPECT_EQ(3, reads_);
+}
+
+TEST_F(CoarseClockTest, CoarseNow) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  auto before = Clock::now();
+  EXPECT_LE(before, coarseNow(conn));
+  conn.coarseClock = clock_;
+  auto now = coarseNow(conn);
+  EXPECT_EQ(now, coarseNow(conn));
+  EXPECT_EQ(1, reads_);
+}
+
+} // namespace test
+} // namespace quic
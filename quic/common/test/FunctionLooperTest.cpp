@@ -7,6 +7,8 @@
  */
 
 #include <quic/common/FunctionLooper.h>
+#include <quic/common/LooperQueue.h>
+#include <quic/common/PacingCalendar.h>
 #include <gtest/gtest.h>
 
 using namespace std;
@@ -317,5 +319,160 @@ TEST(FunctionLooperTest, RunConditions) {
 
   looper->stop();
 }
+
+TEST(FunctionLooperTest, PacingCalendar) {
+  EventBase evb;
+  TimerHighRes::SharedPtr pacingTimer(TimerHighRes::newTimer(&evb, 1ms));
+  auto calendar = std::make_shared<PacingCalendar>(pacingTimer);
+  std::vector<bool> fromTimerVec;
+  auto func = [&](bool fromTimer) { fromTimerVec.push_back(fromTimer); };
+  auto pacingFunc = [&]() -> auto {
+    return 3600000ms;
+  };
+  FunctionLooper::Ptr looper(
+      new FunctionLooper(&evb, std::move(func), LooperType::WriteLooper));
+  looper->setPacingTimer(pacingTimer);
+  looper->setPacingCalendar(calendar);
+  looper->setPacingFunction(std::move(pacingFunc));
+  EXPECT_EQ(1ms, *looper->getTimerTickInterval());
+  looper->run();
+  evb.loopOnce();
+  EXPECT_EQ(1, fromTimerVec.size());
+  // Waits in the calendar and not on a timeout of its own.
+  EXPECT_FALSE(looper->isScheduled());
+  EXPECT_TRUE(looper->isPacingScheduled());
+  EXPECT_TRUE(calendar->isWriteScheduled(looper.get()));
+  EXPECT_TRUE(calendar->isScheduled());
+
+  calendar->runDueWrites();
+  EXPECT_EQ(1, fromTimerVec.size());
+  calendar->runDueWrites(PacingCalendar::Clock::now() + 3600000ms);
+  EXPECT_EQ(2, fromTimerVec.size());
+  EXPECT_TRUE(fromTimerVec.back());
+  // And is back in the calendar for the next write.
+  EXPECT_TRUE(calendar->isWriteScheduled(looper.get()));
+
+  looper->stop();
+  EXPECT_FALSE(calendar->isWriteScheduled(looper.get()));
+  EXPECT_FALSE(calendar->isScheduled());
+}
+
+TEST(FunctionLooperTest, PacingCalendarRunsTickTogether) {
+  EventBase evb;
+  TimerHighRes::SharedPtr pacingTimer(TimerHighRes::newTimer(&evb, 1ms));
+  PacingCalendar calendar(pacingTimer);
+  uint32_t passes = 0;
+  calendar.setAfterPassCallback([&] { passes++; });
+  std::vector<int> runs;
+  auto makeLooper = [&](int id) {
+    return FunctionLooper::Ptr(new FunctionLooper(
+        &evb,
+        [&runs, id](bool) { runs.push_back(id); },
+        LooperType::WriteLooper));
+  };
+  auto first = makeLooper(1);
+  auto second = makeLooper(2);
+  auto third = makeLooper(3);
+  PacingCalendar::Clock::time_point now(10ms);
+  calendar.scheduleWrite(first.get(), 1200us, now);
+  calendar.scheduleWrite(second.get(), 1700us, now);
+  calendar.scheduleWrite(third.get(), 2200us, now);
+  EXPECT_EQ(3, calendar.numScheduled());
+
+  // Due within the tick that is about to start.
+  calendar.runDueWrites(now + 1ms);
+  EXPECT_EQ(2, runs.size());
+  EXPECT_EQ(1, passes);
+  EXPECT_EQ(1, calendar.numScheduled());
+  EXPECT_TRUE(calendar.isScheduled());
+
+  calendar.cancelWrite(third.get());
+  EXPECT_EQ(0, calendar.numScheduled());
+  EXPECT_FALSE(calendar.isScheduled());
+  calendar.runDueWrites(now + 10ms);
+  EXPECT_EQ(2, runs.size());
+}
+
+TEST(FunctionLooperTest, LooperQueueRunsInPostOrder) {
+  EventBase evb;
+  auto queue = std::make_shared<LooperQueue>(&evb, 2);
+  std::vector<int> runs;
+  auto makeLooper = [&](int id) {
+    FunctionLooper::Ptr looper(new FunctionLooper(
+        &evb,
+        [&runs, id](bool) { runs.push_back(id); },
+        LooperType::ReadLooper));
+    looper->setLooperQueue(queue);
+    return looper;
+  };
+  auto first = makeLooper(1);
+  auto second = makeLooper(2);
+  auto third = makeLooper(3);
+  first->run();
+  second->run();
+  third->run();
+  EXPECT_EQ(3, queue->numPosted());
+  // Posted to the queue rather than scheduled on their own.
+  EXPECT_FALSE(first->isLoopCallbackScheduled());
+  EXPECT_TRUE(first->isLoopScheduled());
+  EXPECT_TRUE(queue->isLoopCallbackScheduled());
+
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({1, 2}), runs);
+  // The loopers that ran go to the back of the queue.
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 1}), runs);
+
+  second->stop();
+  EXPECT_FALSE(queue->isPosted(second.get()));
+  EXPECT_FALSE(second->isLoopScheduled());
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 1, 3, 1}), runs);
+
+  first->stop();
+  third->stop();
+  EXPECT_EQ(0, queue->numPosted());
+  EXPECT_FALSE(queue->isLoopCallbackScheduled());
+}
+
+TEST(FunctionLooperTest, LooperQueueDestroyLooperDuringOtherFunc) {
+  EventBase evb;
+  auto queue = std::make_shared<LooperQueue>(&evb, 10);
+  bool secondCalled = false;
+  FunctionLooper::Ptr second(new FunctionLooper(
+      &evb, [&](bool) { secondCalled = true; }, LooperType::WriteLooper));
+  FunctionLooper::Ptr first(new FunctionLooper(
+      &evb,
+      [&](bool) {
+        second = nullptr;
+        first->stop();
+      },
+      LooperType::ReadLooper));
+  first->setLooperQueue(queue);
+  second->setLooperQueue(queue);
+  first->run();
+  second->run();
+  evb.loopOnce();
+  EXPECT_FALSE(secondCalled);
+  EXPECT_EQ(0, queue->numPosted());
+}
+
+TEST(FunctionLooperTest, LooperQueueSetWhileRunning) {
+  EventBase evb;
+  bool called = false;
+  FunctionLooper::Ptr looper(new FunctionLooper(
+      &evb, [&](bool) { called = true; }, LooperType::PeekLooper));
+  looper->run();
+  EXPECT_TRUE(looper->isLoopCallbackScheduled());
+  auto queue = std::make_shared<LooperQueue>(&evb, 10);
+  looper->setLooperQueue(queue);
+  EXPECT_FALSE(looper->isLoopCallbackScheduled());
+  EXPECT_TRUE(queue->isPosted(looper.get()));
+  evb.loopOnce();
+  EXPECT_TRUE(called);
+
+  looper->detachEventBase();
+  EXPECT_EQ(0, queue->numPosted());
+}
 } // namespace test
 } // namespace quic
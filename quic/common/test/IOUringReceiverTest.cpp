@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <quic/common/IOUringReceiver.h>
+
+#include <string>
+#include <vector>
+
+using namespace quic;
+
+namespace {
+
+class TestReadCallback : public IOUringReceiver::ReadCallback {
+ public:
+  void onIOUringPacket(
+      IOUringReceiver&,
+      const folly::SocketAddress& peer,
+      std::unique_ptr<folly::IOBuf> data,
+      struct msghdr&) noexcept override {
+    peers.push_back(peer);
+    packets.push_back(std::move(data));
+  }
+
+  void onIOUringReadDone(IOUringReceiver&) noexcept override {
+    ++readDones;
+  }
+
+  void onIOUringReadError(IOUringReceiver&, int err) noexcept override {
+    error = err;
+  }
+
+  std::vector<folly::SocketAddress> peers;
+  std::vector<std::unique_ptr<folly::IOBuf>> packets;
+  size_t readDones{0};
+  int error{0};
+};
+
+} // namespace
+
+TEST(IOUringReceiver, ReadsDatagrams) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  IOUringReceiverOptions options;
+  options.numBuffers = 8;
+  auto receiver =
+      IOUringReceiver::make(&evb, sock.getNetworkSocket().toFd(), options);
+  // without liburing
+  if (!receiver) {
+    return;
+  }
+  TestReadCallback cb;
+  receiver->resumeRead(&cb);
+  for (char c : {'A', 'B', 'C'}) {
+    peer.write(sock.address(), folly::IOBuf::copyBuffer(std::string(100, c)));
+  }
+  while (cb.packets.size() < 3 && cb.error == 0) {
+    evb.loopOnce();
+  }
+  if (cb.error != 0) {
+    // a kernel without multishot recvmsg
+    return;
+  }
+  EXPECT_GT(cb.readDones, 0);
+  // The buffers handed out stay valid after the receiver is gone.
+  receiver.reset();
+  for (size_t i = 0; i < cb.packets.size(); ++i) {
+    EXPECT_EQ(cb.peers[i], peer.address());
+    EXPECT_EQ(
+        cb.packets[i]->moveToFbString().toStdString(),
+        std::string(100, static_cast<char>('A' + i)));
+  }
+}
+
+TEST(IOUringReceiver, CopiesPastHalfTheBuffers) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  IOUringReceiverOptions options;
+  options.numBuffers = 4;
+  auto receiver =
+      IOUringReceiver::make(&evb, sock.getNetworkSocket().toFd(), options);
+  if (!receiver) {
+    return;
+  }
+  TestReadCallback cb;
+  receiver->resumeRead(&cb);
+  // More datagrams than buffers, all held by the callback.
+  for (size_t i = 0; i < 16; ++i) {
+    peer.write(sock.address(), folly::IOBuf::copyBuffer(std::string(10, 'A')));
+    while (cb.packets.size() < i + 1 && cb.error == 0) {
+      evb.loopOnce();
+    }
+    if (cb.error != 0) {
+      return;
+    }
+  }
+  ASSERT_EQ(cb.packets.size(), 16);
+  for (auto& packet : cb.packets) {
+    EXPECT_EQ(packet->computeChainDataLength(), 10);
+  }
+}
+
+TEST(IOUringReceiver, PauseLeavesTheSocketAlone) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  auto receiver = IOUringReceiver::make(
+      &evb, sock.getNetworkSocket().toFd(), IOUringReceiverOptions());
+  if (!receiver) {
+    return;
+  }
+  TestReadCallback cb;
+  receiver->resumeRead(&cb);
+  receiver->pauseRead();
+  peer.write(sock.address(), folly::IOBuf::copyBuffer("data"));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_TRUE(cb.packets.empty());
+  // still queued on the socket
+  char data[16];
+  auto ret = ::recv(
+      sock.getNetworkSocket().toFd(), data, sizeof(data), MSG_DONTWAIT);
+  EXPECT_EQ(ret, 4);
+}
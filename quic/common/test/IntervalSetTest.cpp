@@ -52,6 +52,25 @@ TEST(IntervalSet, insertAtBack) {
   EXPECT_TRUE(set.empty());
 }
 
+TEST(IntervalSet, insertInOrder) {
+  IntervalSet<int> set;
+  set.insert(1, 2);
+  set.insert(4, 5);
+  auto version1 = set.insertVersion();
+  set.insert(6, 7);
+  auto version2 = set.insertVersion();
+  set.insert(6, 6);
+  auto version3 = set.insertVersion();
+  set.insert(7, 9);
+  auto version4 = set.insertVersion();
+  EXPECT_GT(version2, version1);
+  EXPECT_EQ(version3, version2);
+  EXPECT_GT(version4, version3);
+  ASSERT_EQ(set.size(), 2);
+  EXPECT_EQ(set.front(), Interval<int>(1, 2));
+  EXPECT_EQ(set.back(), Interval<int>(4, 9));
+}
+
 TEST(IntervalSet, insertInTheMiddle) {
   IntervalSet<int> set;
   set.insert(1, 2);
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/LatencyHistogram.h>
+#include <quic/common/PipelineTiming.h>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+TEST(LatencyHistogramTest, Buckets) {
+  for (uint64_t value = 0; value < 16; ++value) {
+    // Exact up to twice the sub buckets.
+    EXPECT_EQ(value, LatencyHistogram::bucketUpperBound(
+                         LatencyHistogram::bucketIndex(value)));
+  }
+  size_t lastIndex = 0;
+  for (uint64_t value = 1; value < (1ull << 26); value += value / 7 + 1) {
+    auto index = LatencyHistogram::bucketIndex(value);
+    EXPECT_GE(index, lastIndex);
+    lastIndex = index;
+    auto upperBound = LatencyHistogram::bucketUpperBound(index);
+    EXPECT_GE(upperBound, value);
+    EXPECT_LE(upperBound - value, value / LatencyHistogram::kSubBuckets);
+  }
+  EXPECT_EQ(
+      LatencyHistogram::kNumBuckets - 1,
+      LatencyHistogram::bucketIndex(1ull << 40));
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0us, histogram.getPercentile(0.5));
+  for (int i = 1; i <= 100; ++i) {
+    histogram.addSample(std::chrono::milliseconds(i));
+  }
+  EXPECT_EQ(100, histogram.count());
+  EXPECT_EQ(100ms, histogram.max());
+  EXPECT_EQ(5050ms, histogram.sum());
+  auto p50 = histogram.getPercentile(0.5);
+  EXPECT_GE(p50, 50ms);
+  EXPECT_LE(p50, 50ms + 50ms / LatencyHistogram::kSubBuckets);
+  EXPECT_EQ(100ms, histogram.getPercentile(1.0));
+  auto p1 = histogram.getPercentile(0.01);
+  EXPECT_GE(p1, 1ms);
+  EXPECT_LT(p1, 2ms);
+}
+
+TEST(LatencyHistogramTest, RawValues) {
+  LatencyHistogram histogram;
+  histogram.addValue(2000);
+  histogram.addValue(3000000);
+  EXPECT_EQ(2, histogram.count());
+  EXPECT_EQ(3002000, histogram.sum().count());
+  EXPECT_EQ(3000000, histogram.max().count());
+  auto p50 = histogram.getPercentileValue(0.5);
+  EXPECT_GE(p50, 2000);
+  EXPECT_LE(p50, 2000 + 2000 / LatencyHistogram::kSubBuckets);
+  EXPECT_EQ(3000000, histogram.getPercentileValue(1.0));
+}
+
+TEST(LatencyHistogramTest, PipelineStageTimer) {
+  auto& histograms = getPipelineStageHistograms();
+  auto before = histograms[PipelineStage::HeaderParse].count();
+  {
+    QUIC_PIPELINE_TIMER(HeaderParse);
+  }
+  EXPECT_EQ(7, QUIC_PIPELINE_TIMED(HeaderParse, 3 + 4));
+  EXPECT_EQ(
+      before + (kPipelineTimingEnabled ? 2 : 0),
+      histograms[PipelineStage::HeaderParse].count());
+  EXPECT_EQ(0, histograms[PipelineStage::SocketWrite].count());
+}
+
+TEST(LatencyHistogramTest, Merge) {
+  ConnectionLatencyHistograms first;
+  ConnectionLatencyHistograms second;
+  first.rtt.addSample(10ms);
+  second.rtt.addSample(30ms);
+  second.delivery.addSample(-1us);
+  first.merge(second);
+  EXPECT_EQ(2, first.rtt.count());
+  EXPECT_EQ(30ms, first.rtt.max());
+  EXPECT_EQ(40ms, first.rtt.sum());
+  EXPECT_EQ(1, first.delivery.count());
+  EXPECT_EQ(1, first.delivery.getBucketCount(0));
+  EXPECT_EQ(0, first.ackDelay.count());
+}
+
+} // namespace test
+} // namespace quic
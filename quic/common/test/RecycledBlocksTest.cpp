@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <quic/common/RecycledBlocks.h>
+
+#include <memory>
+#include <thread>
+
+using namespace quic;
+
+namespace {
+
+struct Payload {
+  explicit Payload(int valueIn) : value(valueIn) {}
+
+  int value;
+  char padding[1000];
+};
+
+} // namespace
+
+TEST(RecycledBlocks, ReusesBlocksOfTheSameSize) {
+  void* block = allocateRecycledBlock(1234);
+  releaseRecycledBlock(block, 1234);
+  // another size doesn't get it
+  void* other = allocateRecycledBlock(4321);
+  EXPECT_NE(other, block);
+  EXPECT_EQ(allocateRecycledBlock(1234), block);
+  releaseRecycledBlock(other, 4321);
+  releaseRecycledBlock(block, 1234);
+}
+
+TEST(RecycledBlocks, BlocksAreKeptPerThread) {
+  void* block = allocateRecycledBlock(2345);
+  releaseRecycledBlock(block, 2345);
+  void* fromOtherThread = nullptr;
+  std::thread([&] {
+    fromOtherThread = allocateRecycledBlock(2345);
+    releaseRecycledBlock(fromOtherThread, 2345);
+  }).join();
+  EXPECT_NE(fromOtherThread, block);
+  releaseRecycledBlock(allocateRecycledBlock(2345), 2345);
+}
+
+TEST(RecycledBlocks, AllocateShared) {
+  auto first = std::allocate_shared<Payload>(RecyclingAllocator<Payload>(), 1);
+  auto firstAddr = first.get();
+  first.reset();
+  // the object is made anew in the same block
+  auto second =
+      std::allocate_shared<Payload>(RecyclingAllocator<Payload>(), 2);
+  EXPECT_EQ(second.get(), firstAddr);
+  EXPECT_EQ(second->value, 2);
+}
@@ -44,10 +44,8 @@ const RegularQuicWritePacket& writeQuicPacket(
       *headerCipher,
       version,
       conn.transportSettings.writeConnectionDataPacketsLimit);
-  CHECK(
-      conn.outstandingPackets.rend() !=
-      getLastOutstandingPacket(conn, PacketNumberSpace::AppData));
-  return getLastOutstandingPacket(conn, PacketNumberSpace::AppData)->packet;
+  CHECK(!conn.outstandingPackets[PacketNumberSpace::AppData].empty());
+  return conn.outstandingPackets[PacketNumberSpace::AppData].back().packet;
 }
 
 PacketNum rstStreamAndSendPacket(
@@ -69,7 +67,8 @@ PacketNum rstStreamAndSendPacket(
       version,
       conn.transportSettings.writeConnectionDataPacketsLimit);
 
-  for (const auto& packet : conn.outstandingPackets) {
+  for (const auto& packet :
+       conn.outstandingPackets[PacketNumberSpace::AppData]) {
     for (const auto& frame : packet.packet.frames) {
       auto rstFrame = frame.asRstStreamFrame();
       if (!rstFrame) {
@@ -121,6 +121,8 @@ bool isState(const S& s) {
       [](const auto&) { return false; });
 }
 
+std::shared_ptr<fizz::SelfCert> readCert();
+
 std::shared_ptr<fizz::server::FizzServerContext> createServerCtx();
 
 void setupCtxWithTestCert(fizz::server::FizzServerContext& ctx);
@@ -190,16 +192,14 @@ template <typename Match>
 OutstandingPacket* findOutstandingPacket(
     QuicConnectionStateBase& conn,
     Match match) {
-  auto helper =
-      [&](std::deque<OutstandingPacket>& packets) -> OutstandingPacket* {
-    for (auto& packet : packets) {
+  for (auto pnSpace : conn.outstandingPackets.spaces()) {
+    for (auto& packet : conn.outstandingPackets[pnSpace]) {
       if (match(packet)) {
         return &packet;
       }
     }
-    return nullptr;
-  };
-  return helper(conn.outstandingPackets);
+  }
+  return nullptr;
 }
 
 // Helper function to generate a buffer containing random data of given length
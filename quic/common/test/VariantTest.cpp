@@ -74,10 +74,25 @@ struct C {
   }
 };
 
+struct D {
+  bool operator==(const D& other) const {
+    return value == other.value;
+  }
+
+  int value{0};
+  char padding[256];
+};
+
+namespace quic {
+template <>
+struct VariantBoxed<D> : std::true_type {};
+} // namespace quic
+
 #define TEST_VARIANT(F, ...) \
   F(A, __VA_ARGS__)          \
   F(B, __VA_ARGS__)          \
-  F(C, __VA_ARGS__)
+  F(C, __VA_ARGS__)          \
+  F(D, __VA_ARGS__)
 
 DECLARE_VARIANT_TYPE(TestVariant, TEST_VARIANT)
 
@@ -147,3 +162,26 @@ TEST(Variant, TestCopyVariantDifferentType) {
   ASSERT_NE(variantA.asB(), nullptr);
   EXPECT_TRUE(variantA.asB()->copied);
 }
+
+TEST(Variant, TestBoxedVariant) {
+  EXPECT_LT(sizeof(TestVariant), sizeof(D));
+  D d;
+  d.value = 5;
+  TestVariant variantD{d};
+  ASSERT_NE(variantD.asD(), nullptr);
+  EXPECT_EQ(variantD.asD()->value, 5);
+  EXPECT_EQ(variantD.asA(), nullptr);
+
+  TestVariant copy{variantD};
+  ASSERT_NE(copy.asD(), nullptr);
+  EXPECT_NE(copy.asD(), variantD.asD());
+  EXPECT_TRUE(copy == variantD);
+
+  const D* boxed = copy.asD();
+  TestVariant moved{std::move(copy)};
+  EXPECT_EQ(moved.asD(), boxed);
+
+  moved = TestVariant(C());
+  EXPECT_EQ(moved.asD(), nullptr);
+  EXPECT_NE(moved.asC(), nullptr);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <quic/common/XdpSocket.h>
+
+#include <vector>
+
+using namespace quic;
+
+namespace {
+
+XdpRoute makeRoute(const std::string& localIp) {
+  XdpRoute route;
+  route.localMac = {0x02, 0, 0, 0, 0, 0x01};
+  route.peerMac = {0x02, 0, 0, 0, 0, 0x02};
+  route.localIp = folly::IPAddress(localIp);
+  return route;
+}
+
+// what the peer sends along route to port, i.e. a reply to it mirrored
+std::vector<uint8_t> frameFromPeer(
+    const XdpRoute& route,
+    const folly::SocketAddress& peer,
+    uint16_t port,
+    const std::string& payload,
+    uint8_t ecn) {
+  // The frame from the server to peer, with the ends swapped.
+  XdpRoute reverse = route;
+  reverse.localMac = route.peerMac;
+  reverse.peerMac = route.localMac;
+  reverse.localIp = peer.getIPAddress();
+  std::vector<uint8_t> frame(2048);
+  auto buf = folly::IOBuf::copyBuffer(payload);
+  folly::io::Cursor cursor(buf.get());
+  auto len = writeXdpFrame(
+      frame.data(),
+      frame.size(),
+      reverse,
+      peer.getPort(),
+      folly::SocketAddress(route.localIp, port),
+      cursor,
+      payload.size(),
+      ecn);
+  frame.resize(len);
+  return frame;
+}
+
+} // namespace
+
+TEST(XdpSocket, ParsesTheFramesItWrites) {
+  for (auto ips : {std::make_pair("10.0.0.1", "10.0.0.2"),
+                   std::make_pair("2001:db8::1", "2001:db8::2")}) {
+    auto route = makeRoute(ips.first);
+    folly::SocketAddress peer(ips.second, 5000);
+    auto frame = frameFromPeer(route, peer, 443, "quic payload", kEcnEct0);
+    ASSERT_FALSE(frame.empty());
+
+    auto info = parseXdpFrame(frame.data(), frame.size(), 443);
+    ASSERT_TRUE(info.has_value());
+    EXPECT_EQ(info->peer, peer);
+    EXPECT_EQ(info->route.localIp, route.localIp);
+    EXPECT_EQ(info->route.localMac, route.localMac);
+    EXPECT_EQ(info->route.peerMac, route.peerMac);
+    EXPECT_FALSE(info->route.vlan.has_value());
+    EXPECT_EQ(info->ecn, kEcnEct0);
+    EXPECT_EQ(
+        std::string(
+            reinterpret_cast<const char*>(frame.data() + info->payloadOffset),
+            info->payloadLen),
+        "quic payload");
+    // not for the server's port
+    EXPECT_FALSE(parseXdpFrame(frame.data(), frame.size(), 444).has_value());
+    // truncated
+    EXPECT_FALSE(
+        parseXdpFrame(frame.data(), frame.size() - 1, 443).has_value());
+  }
+}
+
+TEST(XdpSocket, KeepsTheVlanTag) {
+  auto route = makeRoute("10.0.0.1");
+  route.vlan = 42;
+  folly::SocketAddress peer("10.0.0.2", 5000);
+  auto frame = frameFromPeer(route, peer, 443, "data", kEcnNotEct);
+  EXPECT_EQ(frame.size(), xdpFrameHeaderLength(route) + 4);
+  auto info = parseXdpFrame(frame.data(), frame.size(), 443);
+  ASSERT_TRUE(info.has_value());
+  ASSERT_TRUE(info->route.vlan.has_value());
+  EXPECT_EQ(*info->route.vlan, 42);
+  EXPECT_EQ(info->payloadLen, 4);
+}
+
+TEST(XdpSocket, WritesValidChecksums) {
+  auto route = makeRoute("10.0.0.1");
+  folly::SocketAddress peer("10.0.0.2", 5000);
+  auto frame = frameFromPeer(route, peer, 443, "odd length", kEcnNotEct);
+  auto info = parseXdpFrame(frame.data(), frame.size(), 443);
+  ASSERT_TRUE(info.has_value());
+  auto sum = [](const uint8_t* data, size_t len, uint64_t initial) {
+    for (size_t i = 0; i + 1 < len; i += 2) {
+      initial += (data[i] << 8) | data[i + 1];
+    }
+    if (len % 2) {
+      initial += data[len - 1] << 8;
+    }
+    while (initial >> 16) {
+      initial = (initial & 0xffff) + (initial >> 16);
+    }
+    return initial;
+  };
+  const uint8_t* ip = frame.data() + 14;
+  EXPECT_EQ(sum(ip, 20, 0), 0xffff);
+  // the UDP checksum covers a pseudo header of the addresses, the protocol
+  // and the length
+  size_t udpLen = frame.size() - 34;
+  uint64_t pseudo = sum(ip + 12, 8, 0) + 17 + udpLen;
+  EXPECT_EQ(sum(ip + 20, udpLen, pseudo), 0xffff);
+}
+
+TEST(XdpSocket, DoesNotWriteAcrossFamilies) {
+  auto route = makeRoute("10.0.0.1");
+  std::vector<uint8_t> frame(2048);
+  auto buf = folly::IOBuf::copyBuffer("data");
+  folly::io::Cursor cursor(buf.get());
+  EXPECT_EQ(
+      writeXdpFrame(
+          frame.data(),
+          frame.size(),
+          route,
+          443,
+          folly::SocketAddress("2001:db8::2", 5000),
+          cursor,
+          4,
+          kEcnNotEct),
+      0);
+  // IPv4-mapped peers of an IPv6 server socket are IPv4 on the wire
+  EXPECT_GT(
+      writeXdpFrame(
+          frame.data(),
+          frame.size(),
+          route,
+          443,
+          folly::SocketAddress("::ffff:10.0.0.2", 5000),
+          cursor,
+          4,
+          kEcnNotEct),
+      0);
+}
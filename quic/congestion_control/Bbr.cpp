@@ -30,13 +30,11 @@ namespace quic {
 
 BbrCongestionController::BbrCongestionController(QuicConnectionStateBase& conn)
     : conn_(conn),
-      cwnd_(conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
-      initialCwnd_(
-          conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
+      cwnd_(initialCwndBytes(conn)),
+      initialCwnd_(initialCwndBytes(conn)),
       recoveryWindow_(
           conn.udpSendPacketLen * conn.transportSettings.maxCwndInMss),
-      pacingWindow_(
-          conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
+      pacingWindow_(initialCwndBytes(conn)),
       // TODO: experiment with longer window len for ack aggregation filter
       maxAckHeightFilter_(kBandwidthWindowLength, 0, 0) {
   QUIC_TRACE(initcwnd, conn_, initialCwnd_);
@@ -50,7 +48,7 @@ bool BbrCongestionController::updateRoundTripCounter(
     TimePoint largestAckedSentTime) noexcept {
   if (largestAckedSentTime > endOfRoundTrip_) {
     roundTripCounter_++;
-    endOfRoundTrip_ = Clock::now();
+    endOfRoundTrip_ = congestionControlNow(conn_);
     return true;
   }
   return false;
@@ -69,7 +67,7 @@ void BbrCongestionController::setBandwidthSampler(
 void BbrCongestionController::onPacketLoss(
     const LossEvent& loss,
     uint64_t ackedBytes) {
-  endOfRecovery_ = Clock::now();
+  endOfRecovery_ = congestionControlNow(conn_);
 
   if (!inRecovery()) {
     recoveryState_ = BbrCongestionController::RecoveryState::CONSERVATIVE;
@@ -82,7 +80,7 @@ void BbrCongestionController::onPacketLoss(
 
     // We need to make sure CONSERVATIVE can last for a round trip, so update
     // endOfRoundTrip_ to the latest sent packet.
-    endOfRoundTrip_ = Clock::now();
+    endOfRoundTrip_ = congestionControlNow(conn_);
 
     // TODO: maybe set appLimited in recovery based on config
   }
@@ -105,13 +103,23 @@ void BbrCongestionController::onPacketLoss(
     QUIC_TRACE(
         bbr_persistent_congestion,
         conn_,
-        bbrStateToString(state_),
-        bbrRecoveryStateToString(recoveryState_),
+        bbrStateToString(state_).data(),
+        bbrRecoveryStateToString(recoveryState_).data(),
         recoveryWindow_,
         inflightBytes_);
   }
 }
 
+void BbrCongestionController::onSpuriousLoss() {
+  // The model doesn't use losses, only the recovery window does.
+  recoveryState_ = BbrCongestionController::RecoveryState::NOT_RECOVERY;
+  endOfRecovery_ = folly::none;
+}
+
+void BbrCongestionController::onEcnCongestionEvent(TimePoint) {
+  // Like losses, CE marks don't feed the model.
+}
+
 void BbrCongestionController::onPacketSent(const OutstandingPacket& packet) {
   if (!inflightBytes_ && isAppLimited()) {
     exitingQuiescene_ = true;
@@ -253,8 +261,8 @@ void BbrCongestionController::onPacketAcked(
   QUIC_TRACE(
       bbr_ack,
       conn_,
-      bbrStateToString(state_),
-      bbrRecoveryStateToString(recoveryState_),
+      bbrStateToString(state_).data(),
+      bbrRecoveryStateToString(recoveryState_).data(),
       getCongestionWindow(),
       cwnd_,
       sendQuantum_,
@@ -597,7 +605,7 @@ void BbrCongestionController::onRemoveBytesFromInflight(
   subtractAndCheckUnderflow(inflightBytes_, bytesToRemove);
 }
 
-std::string bbrStateToString(BbrCongestionController::BbrState state) {
+folly::StringPiece bbrStateToString(BbrCongestionController::BbrState state) {
   switch (state) {
     case BbrCongestionController::BbrState::Startup:
       return "Startup";
@@ -611,7 +619,7 @@ std::string bbrStateToString(BbrCongestionController::BbrState state) {
   return "BadBbrState";
 }
 
-std::string bbrRecoveryStateToString(
+folly::StringPiece bbrRecoveryStateToString(
     BbrCongestionController::RecoveryState recoveryState) {
   switch (recoveryState) {
     case BbrCongestionController::RecoveryState::NOT_RECOVERY:
@@ -117,6 +117,8 @@ class BbrCongestionController : public CongestionController {
   void onPacketAckOrLoss(
       folly::Optional<AckEvent> ackEvent,
       folly::Optional<LossEvent> lossEvent) override;
+  void onSpuriousLoss() override;
+  void onEcnCongestionEvent(TimePoint sentTime) override;
   uint64_t getWritableBytes() const noexcept override;
 
   uint64_t getCongestionWindow() const noexcept override;
@@ -263,8 +265,8 @@ class BbrCongestionController : public CongestionController {
 
 std::ostream& operator<<(std::ostream& os, const BbrCongestionController& bbr);
 
-std::string bbrStateToString(BbrCongestionController::BbrState state);
+folly::StringPiece bbrStateToString(BbrCongestionController::BbrState state);
 
-std::string bbrRecoveryStateToString(
+folly::StringPiece bbrRecoveryStateToString(
     BbrCongestionController::RecoveryState recoveryState);
 } // namespace quic
@@ -0,0 +1,633 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/Bbr2.h>
+#include <folly/Random.h>
+#include <quic/QuicConstants.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/logging/QLoggerConstants.h>
+#include <quic/logging/QuicLogger.h>
+
+namespace quic {
+
+namespace {
+// inflight_hi grows at most twice as fast every round in ProbeBw Up, up to
+// this many doublings.
+constexpr uint8_t kMaxProbeUpRounds = 30;
+} // namespace
+
+Bbr2CongestionController::Bbr2CongestionController(
+    QuicConnectionStateBase& conn)
+    : conn_(conn),
+      cwnd_(initialCwndBytes(conn)),
+      initialCwnd_(initialCwndBytes(conn)),
+      pacingWindow_(initialCwndBytes(conn)),
+      maxAckHeightFilter_(kBandwidthWindowLength, 0, 0) {}
+
+CongestionControlType Bbr2CongestionController::type() const noexcept {
+  return CongestionControlType::BBR2;
+}
+
+void Bbr2CongestionController::setRttSampler(
+    std::unique_ptr<BbrCongestionController::MinRttSampler> sampler) noexcept {
+  minRttSampler_ = std::move(sampler);
+}
+
+void Bbr2CongestionController::setBandwidthSampler(
+    std::unique_ptr<BbrCongestionController::BandwidthSampler>
+        sampler) noexcept {
+  bandwidthSampler_ = std::move(sampler);
+}
+
+bool Bbr2CongestionController::updateRoundTripCounter(
+    TimePoint largestAckedSentTime) noexcept {
+  if (largestAckedSentTime > endOfRoundTrip_) {
+    roundTripCounter_++;
+    endOfRoundTrip_ = congestionControlNow(conn_);
+    return true;
+  }
+  return false;
+}
+
+void Bbr2CongestionController::onPacketSent(const OutstandingPacket& packet) {
+  addAndCheckOverflow(inflightBytes_, packet.encodedSize);
+  if (!ackAggregationStartTime_) {
+    ackAggregationStartTime_ = packet.time;
+  }
+}
+
+void Bbr2CongestionController::onRemoveBytesFromInflight(
+    uint64_t bytesToRemove) {
+  subtractAndCheckUnderflow(inflightBytes_, bytesToRemove);
+}
+
+void Bbr2CongestionController::onPacketAckOrLoss(
+    folly::Optional<AckEvent> ackEvent,
+    folly::Optional<LossEvent> lossEvent) {
+  auto prevInflightBytes = inflightBytes_;
+  if (ackEvent) {
+    subtractAndCheckUnderflow(inflightBytes_, ackEvent->ackedBytes);
+  }
+  if (lossEvent) {
+    subtractAndCheckUnderflow(inflightBytes_, lossEvent->lostBytes);
+  }
+  bool hasAck = ackEvent && ackEvent->largestAckedPacket.has_value();
+  bool newRoundTrip =
+      hasAck && updateRoundTripCounter(ackEvent->largestAckedPacketSentTime);
+  if (newRoundTrip) {
+    congestionInLastRound_ = roundLostBytes_ > 0 || roundEcn_;
+    lastRoundTooHigh_ = inflightTooHigh();
+    lastRoundDeliveredBytes_ = roundDeliveredBytes_;
+    roundDeliveredBytes_ = 0;
+    roundLostBytes_ = 0;
+    roundEcn_ = false;
+  }
+  if (ackEvent) {
+    roundDeliveredBytes_ += ackEvent->ackedBytes;
+  }
+  bool congestionSignal = false;
+  if (lossEvent) {
+    onPacketLoss(*lossEvent);
+    if (conn_.pacer) {
+      conn_.pacer->onPacketsLoss();
+    }
+    congestionSignal = true;
+  }
+  if (pendingEcn_) {
+    roundEcn_ = true;
+    pendingEcn_ = false;
+    congestionSignal = true;
+  }
+  // Only a bandwidth probe learns the upper bound, Startup has its own exit.
+  if (congestionSignal &&
+      (state_ == State::ProbeBwRefill || state_ == State::ProbeBwUp) &&
+      inflightTooHigh()) {
+    handleInflightTooHigh(prevInflightBytes);
+  }
+  if (hasAck) {
+    CHECK(!ackEvent->ackedPackets.empty());
+    onPacketAcked(*ackEvent, newRoundTrip);
+  }
+}
+
+void Bbr2CongestionController::onPacketLoss(const LossEvent& loss) {
+  roundLostBytes_ += loss.lostBytes;
+  if (loss.persistentCongestion) {
+    cwnd_ = minCwnd();
+    if (conn_.qLogger) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          inflightBytes_,
+          getCongestionWindow(),
+          kPersistentCongestion,
+          bbr2StateToString(state_));
+    }
+  }
+}
+
+void Bbr2CongestionController::onSpuriousLoss() {
+  // The lower bounds are the only reaction to a single round of loss.
+  resetLowerBounds();
+}
+
+void Bbr2CongestionController::onEcnCongestionEvent(TimePoint) {
+  // The marks are reported ahead of the ack that carried them, which decides
+  // whether they start a new round.
+  pendingEcn_ = true;
+}
+
+void Bbr2CongestionController::onPacketAcked(
+    const AckEvent& ack,
+    bool newRoundTrip) {
+  if (ack.mrttSample && minRttSampler_) {
+    bool updated =
+        minRttSampler_->newRttSample(ack.mrttSample.value(), ack.ackTime);
+    if (updated) {
+      appLimitedSinceProbeRtt_ = false;
+    }
+  }
+  if (bandwidthSampler_) {
+    bool wasAppLimited = bandwidthSampler_->isAppLimited();
+    bandwidthSampler_->onPacketAcked(ack, roundTripCounter_);
+    if (wasAppLimited && !bandwidthSampler_->isAppLimited()) {
+      if (conn_.pacer) {
+        conn_.pacer->setAppLimited(false);
+      }
+    }
+  }
+  if (newRoundTrip) {
+    adaptLowerBounds();
+  }
+  auto excessiveBytes = updateAckAggregation(ack);
+
+  if (state_ == State::Startup) {
+    checkStartupDone(newRoundTrip, ack.largestAckedPacketAppLimited);
+  }
+  if (state_ == State::Drain && inflightBytes_ <= bdp(1.0)) {
+    transitToProbeBwDown(ack.ackTime);
+  }
+  if (state_ == State::ProbeBwUp) {
+    probeInflightHiUpward(ack.ackedBytes, newRoundTrip);
+  }
+  updateProbeBwPhase(ack.ackTime, newRoundTrip);
+  checkProbeRtt(ack.ackTime, newRoundTrip);
+
+  updateCwnd(ack.ackedBytes, excessiveBytes);
+  updatePacing();
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionPacketAck,
+        bbr2StateToString(state_));
+  }
+}
+
+uint64_t Bbr2CongestionController::updateAckAggregation(const AckEvent& ack) {
+  if (!ackAggregationStartTime_) {
+    // A controller created in the middle of a connection can get an ack
+    // before it ever saw a packet sent.
+    return 0;
+  }
+  uint64_t expectedAckBytes = maxBandwidth() *
+      std::chrono::duration_cast<std::chrono::microseconds>(
+                                  ack.ackTime - *ackAggregationStartTime_);
+  if (aggregatedAckBytes_ <= expectedAckBytes) {
+    aggregatedAckBytes_ = ack.ackedBytes;
+    ackAggregationStartTime_ = ack.ackTime;
+    return 0;
+  }
+  aggregatedAckBytes_ += ack.ackedBytes;
+  maxAckHeightFilter_.Update(
+      aggregatedAckBytes_ - expectedAckBytes, roundTripCounter_);
+  return aggregatedAckBytes_ - expectedAckBytes;
+}
+
+bool Bbr2CongestionController::inflightTooHigh() const noexcept {
+  if (roundEcn_) {
+    return true;
+  }
+  return roundLostBytes_ > 0 &&
+      roundLostBytes_ >
+      kBbr2LossThresh * (roundLostBytes_ + roundDeliveredBytes_);
+}
+
+void Bbr2CongestionController::handleInflightTooHigh(
+    uint64_t inflightAtCongestion) {
+  // An app limited probe didn't find out what the path holds.
+  if (!isAppLimited()) {
+    inflightHi_ = std::max(
+        inflightAtCongestion, static_cast<uint64_t>(bdp(1.0) * kBbr2Beta));
+  }
+  if (state_ == State::ProbeBwUp) {
+    transitToProbeBwDown(congestionControlNow(conn_));
+  }
+}
+
+void Bbr2CongestionController::adaptLowerBounds() {
+  if (!congestionInLastRound_ || state_ == State::Startup ||
+      state_ == State::ProbeBwRefill || state_ == State::ProbeBwUp) {
+    return;
+  }
+  // Back off, but not below what the round actually delivered.
+  auto mrtt = minRtt();
+  Bandwidth latestBw = mrtt == 0us
+      ? Bandwidth()
+      : Bandwidth(lastRoundDeliveredBytes_, mrtt);
+  bwLo_ = std::max(latestBw, (bwLo_ ? *bwLo_ : maxBandwidth()) * kBbr2Beta);
+  inflightLo_ = std::max(
+      lastRoundDeliveredBytes_,
+      static_cast<uint64_t>((inflightLo_ ? *inflightLo_ : cwnd_) * kBbr2Beta));
+}
+
+void Bbr2CongestionController::resetLowerBounds() noexcept {
+  bwLo_ = folly::none;
+  inflightLo_ = folly::none;
+}
+
+void Bbr2CongestionController::probeInflightHiUpward(
+    uint64_t ackedBytes,
+    bool newRoundTrip) {
+  if (newRoundTrip) {
+    bwProbeUpRounds_ =
+        std::min<uint8_t>(bwProbeUpRounds_ + 1, kMaxProbeUpRounds);
+    bwProbeUpCnt_ = std::max<uint64_t>(
+        cwnd_ >> bwProbeUpRounds_, conn_.udpSendPacketLen);
+  }
+  // Only grow the bound while it is what holds the cwnd back.
+  if (!inflightHi_ || cwnd_ < *inflightHi_) {
+    return;
+  }
+  bwProbeUpAcks_ += ackedBytes;
+  if (bwProbeUpAcks_ >= bwProbeUpCnt_) {
+    uint64_t delta = bwProbeUpAcks_ / bwProbeUpCnt_;
+    bwProbeUpAcks_ -= delta * bwProbeUpCnt_;
+    *inflightHi_ += delta * conn_.udpSendPacketLen;
+  }
+}
+
+void Bbr2CongestionController::checkStartupDone(
+    bool newRoundTrip,
+    bool appLimitedSample) noexcept {
+  if (!newRoundTrip) {
+    return;
+  }
+  if (lastRoundTooHigh_ &&
+      ++lossRoundsInStartup_ >= kBbr2StartupFullLossRounds) {
+    fullBwReached_ = true;
+    inflightHi_ = std::max(bdp(1.0), lastRoundDeliveredBytes_);
+  } else if (!appLimitedSample) {
+    auto bw = maxBandwidth();
+    if (bw >= fullBw_ * kBbr2StartupFullBwThresh) {
+      fullBw_ = bw;
+      fullBwCount_ = 0;
+    } else if (++fullBwCount_ >= kBbr2StartupFullBwRounds) {
+      fullBwReached_ = true;
+    }
+  }
+  if (fullBwReached_) {
+    transitToDrain();
+  }
+}
+
+void Bbr2CongestionController::updateProbeBwPhase(
+    TimePoint ackTime,
+    bool newRoundTrip) {
+  if (newRoundTrip) {
+    ++roundsSinceProbe_;
+  }
+  switch (state_) {
+    case State::ProbeBwDown:
+      if (isTimeToProbeBw(ackTime)) {
+        transitToProbeBwRefill();
+      } else if (
+          inflightBytes_ <= inflightWithHeadroom() &&
+          inflightBytes_ <= bdp(1.0)) {
+        transitToProbeBwCruise();
+      }
+      break;
+    case State::ProbeBwCruise:
+      if (isTimeToProbeBw(ackTime)) {
+        transitToProbeBwRefill();
+      }
+      break;
+    case State::ProbeBwRefill:
+      // Refill lasts one round, so the probe starts with the pipe full.
+      if (newRoundTrip) {
+        transitToProbeBwUp(ackTime);
+      }
+      break;
+    case State::ProbeBwUp:
+      if (ackTime - cycleStart_ > minRtt() &&
+          inflightBytes_ > bdp(kBbr2ProbeBwUpPacingGain)) {
+        transitToProbeBwDown(ackTime);
+      }
+      break;
+    case State::Startup:
+    case State::Drain:
+    case State::ProbeRtt:
+      break;
+  }
+}
+
+bool Bbr2CongestionController::isTimeToProbeBw(TimePoint ackTime) const
+    noexcept {
+  if (ackTime - cycleStart_ >= bwProbeWait_) {
+    return true;
+  }
+  // Probe at least as often as a Reno flow sharing the bottleneck would fill
+  // the pipe, so BBR doesn't give its share up to it.
+  auto renoRounds = std::min<uint64_t>(
+      bdp(1.0) / conn_.udpSendPacketLen, kBbr2ProbeBwMaxRounds);
+  return roundsSinceProbe_ >= renoRounds;
+}
+
+void Bbr2CongestionController::checkProbeRtt(
+    TimePoint ackTime,
+    bool newRoundTrip) {
+  if (state_ != State::ProbeRtt && minRttSampler_ &&
+      minRttSampler_->minRttExpired()) {
+    if (conn_.transportSettings.bbrConfig.probeRttDisabledIfAppLimited &&
+        appLimitedSinceProbeRtt_) {
+      minRttSampler_->timestampMinRtt(ackTime);
+    } else {
+      transitToProbeRtt();
+    }
+  }
+  if (state_ != State::ProbeRtt) {
+    return;
+  }
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onAppLimited();
+  }
+  if (!probeRttDoneTime_ && inflightBytes_ <= probeRttCwnd()) {
+    probeRttDoneTime_ = ackTime + kProbeRttDuration;
+    probeRttRoundDone_ = false;
+    endOfRoundTrip_ = congestionControlNow(conn_);
+    return;
+  }
+  if (probeRttDoneTime_) {
+    if (newRoundTrip) {
+      probeRttRoundDone_ = true;
+    }
+    if (probeRttRoundDone_ && *probeRttDoneTime_ <= ackTime) {
+      exitProbeRtt(ackTime);
+    }
+  }
+}
+
+void Bbr2CongestionController::transitToDrain() noexcept {
+  state_ = State::Drain;
+  pacingGain_ = kBbr2DrainPacingGain;
+  cwndGain_ = kBbr2StartupCwndGain;
+}
+
+void Bbr2CongestionController::transitToProbeBwDown(TimePoint ackTime) {
+  state_ = State::ProbeBwDown;
+  pacingGain_ = kBbr2ProbeBwDownPacingGain;
+  cwndGain_ = kBbr2ProbeBwCwndGain;
+  cycleStart_ = ackTime;
+  roundsSinceProbe_ = 0;
+  bwProbeWait_ = kBbr2ProbeBwMinWait +
+      std::chrono::milliseconds(
+                     folly::Random::rand32(kBbr2ProbeBwWaitRange.count() + 1));
+}
+
+void Bbr2CongestionController::transitToProbeBwCruise() noexcept {
+  state_ = State::ProbeBwCruise;
+  pacingGain_ = 1.0f;
+  cwndGain_ = kBbr2ProbeBwCwndGain;
+}
+
+void Bbr2CongestionController::transitToProbeBwRefill() noexcept {
+  state_ = State::ProbeBwRefill;
+  pacingGain_ = 1.0f;
+  cwndGain_ = kBbr2ProbeBwCwndGain;
+  resetLowerBounds();
+  bwProbeUpRounds_ = 0;
+  bwProbeUpAcks_ = 0;
+  // The round ends once the packets sent from now on are acked.
+  endOfRoundTrip_ = congestionControlNow(conn_);
+}
+
+void Bbr2CongestionController::transitToProbeBwUp(TimePoint ackTime) noexcept {
+  state_ = State::ProbeBwUp;
+  pacingGain_ = kBbr2ProbeBwUpPacingGain;
+  cwndGain_ = kBbr2ProbeBwUpCwndGain;
+  cycleStart_ = ackTime;
+  bwProbeUpRounds_ = 0;
+  bwProbeUpAcks_ = 0;
+  bwProbeUpCnt_ = std::max<uint64_t>(cwnd_, conn_.udpSendPacketLen);
+  endOfRoundTrip_ = congestionControlNow(conn_);
+}
+
+void Bbr2CongestionController::transitToProbeRtt() noexcept {
+  state_ = State::ProbeRtt;
+  pacingGain_ = 1.0f;
+  probeRttDoneTime_ = folly::none;
+  probeRttRoundDone_ = false;
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onAppLimited();
+  }
+  appLimitedSinceProbeRtt_ = false;
+}
+
+void Bbr2CongestionController::exitProbeRtt(TimePoint ackTime) {
+  minRttSampler_->timestampMinRtt(ackTime);
+  resetLowerBounds();
+  if (fullBwReached_) {
+    transitToProbeBwDown(ackTime);
+    transitToProbeBwCruise();
+  } else {
+    state_ = State::Startup;
+    pacingGain_ = kBbr2StartupPacingGain;
+    cwndGain_ = kBbr2StartupCwndGain;
+  }
+}
+
+void Bbr2CongestionController::updateCwnd(
+    uint64_t ackedBytes,
+    uint64_t excessiveBytes) noexcept {
+  auto targetCwnd = bdp(cwndGain_);
+  if (fullBwReached_) {
+    targetCwnd += maxAckHeightFilter_.GetBest();
+  } else if (conn_.transportSettings.bbrConfig.enableAckAggregationInStartup) {
+    targetCwnd += excessiveBytes;
+  }
+  if (fullBwReached_) {
+    cwnd_ = std::min(targetCwnd, cwnd_ + ackedBytes);
+  } else if (
+      cwnd_ < targetCwnd || conn_.lossState.totalBytesAcked < initialCwnd_) {
+    cwnd_ += ackedBytes;
+  }
+
+  // Bound the cwnd by the inflight the model says the path holds.
+  auto cap = std::numeric_limits<uint64_t>::max();
+  if (state_ == State::ProbeBwDown || state_ == State::ProbeBwRefill ||
+      state_ == State::ProbeBwUp) {
+    cap = inflightHi_.value_or(cap);
+  } else if (state_ == State::ProbeBwCruise || state_ == State::ProbeRtt) {
+    cap = inflightWithHeadroom();
+  }
+  if (inflightLo_) {
+    cap = std::min(cap, *inflightLo_);
+  }
+  cwnd_ = std::min(cwnd_, std::max(cap, minCwnd()));
+  cwnd_ = boundedCwnd(
+      cwnd_,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      kMinCwndInMssForBbr);
+}
+
+void Bbr2CongestionController::updatePacing() noexcept {
+  if (!conn_.pacer) {
+    return;
+  }
+  if (conn_.lossState.totalBytesSent < initialCwnd_) {
+    return;
+  }
+  auto bandwidthEstimate = bandwidth();
+  if (!bandwidthEstimate) {
+    return;
+  }
+  auto mrtt = minRtt();
+  uint64_t targetPacingWindow = bandwidthEstimate *
+      (pacingGain_ * (100 - kBbr2PacingMarginPercent) / 100) * mrtt;
+  if (fullBwReached_) {
+    pacingWindow_ = targetPacingWindow;
+  } else {
+    pacingWindow_ = std::max(pacingWindow_, targetPacingWindow);
+  }
+  conn_.pacer->refreshPacingRate(pacingWindow_, mrtt);
+}
+
+uint64_t Bbr2CongestionController::bdp(float gain) const noexcept {
+  auto bandwidthEst = maxBandwidth();
+  auto minRttEst = minRtt();
+  if (!bandwidthEst || minRttEst == 0us) {
+    return gain * initialCwnd_;
+  }
+  return (bandwidthEst * minRttEst) * gain;
+}
+
+uint64_t Bbr2CongestionController::inflightWithHeadroom() const noexcept {
+  if (!inflightHi_) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  uint64_t headroom = std::max<uint64_t>(
+      conn_.udpSendPacketLen, *inflightHi_ * kBbr2Headroom);
+  return *inflightHi_ > headroom + minCwnd() ? *inflightHi_ - headroom
+                                             : minCwnd();
+}
+
+uint64_t Bbr2CongestionController::probeRttCwnd() const noexcept {
+  return std::max(bdp(kBbr2ProbeRttCwndGain), minCwnd());
+}
+
+uint64_t Bbr2CongestionController::minCwnd() const noexcept {
+  return conn_.udpSendPacketLen * kMinCwndInMssForBbr;
+}
+
+std::chrono::microseconds Bbr2CongestionController::minRtt() const noexcept {
+  return minRttSampler_ ? minRttSampler_->minRtt() : 0us;
+}
+
+Bandwidth Bbr2CongestionController::maxBandwidth() const noexcept {
+  return bandwidthSampler_ ? bandwidthSampler_->getBandwidth() : Bandwidth();
+}
+
+Bandwidth Bbr2CongestionController::bandwidth() const noexcept {
+  auto bw = maxBandwidth();
+  return bwLo_ ? std::min(bw, *bwLo_) : bw;
+}
+
+uint64_t Bbr2CongestionController::getWritableBytes() const noexcept {
+  return getCongestionWindow() > inflightBytes_
+      ? getCongestionWindow() - inflightBytes_
+      : 0;
+}
+
+uint64_t Bbr2CongestionController::getCongestionWindow() const noexcept {
+  if (state_ == State::ProbeRtt) {
+    return std::min(cwnd_, probeRttCwnd());
+  }
+  return cwnd_;
+}
+
+void Bbr2CongestionController::setAppIdle(
+    bool idle,
+    TimePoint /* eventTime */) noexcept {
+  if (conn_.qLogger) {
+    conn_.qLogger->addAppIdleUpdate(kAppIdle, idle);
+  }
+}
+
+void Bbr2CongestionController::setAppLimited() {
+  if (inflightBytes_ > getCongestionWindow()) {
+    return;
+  }
+  appLimitedSinceProbeRtt_ = true;
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onAppLimited();
+  }
+  if (conn_.pacer) {
+    conn_.pacer->setAppLimited(true);
+  }
+}
+
+bool Bbr2CongestionController::isAppLimited() const noexcept {
+  return bandwidthSampler_ ? bandwidthSampler_->isAppLimited() : false;
+}
+
+Bbr2CongestionController::State Bbr2CongestionController::state() const
+    noexcept {
+  return state_;
+}
+
+folly::Optional<uint64_t> Bbr2CongestionController::inflightHi() const
+    noexcept {
+  return inflightHi_;
+}
+
+folly::Optional<uint64_t> Bbr2CongestionController::inflightLo() const
+    noexcept {
+  return inflightLo_;
+}
+
+folly::StringPiece bbr2StateToString(Bbr2CongestionController::State state) {
+  switch (state) {
+    case Bbr2CongestionController::State::Startup:
+      return "Startup";
+    case Bbr2CongestionController::State::Drain:
+      return "Drain";
+    case Bbr2CongestionController::State::ProbeBwDown:
+      return "ProbeBwDown";
+    case Bbr2CongestionController::State::ProbeBwCruise:
+      return "ProbeBwCruise";
+    case Bbr2CongestionController::State::ProbeBwRefill:
+      return "ProbeBwRefill";
+    case Bbr2CongestionController::State::ProbeBwUp:
+      return "ProbeBwUp";
+    case Bbr2CongestionController::State::ProbeRtt:
+      return "ProbeRtt";
+  }
+  return "BadBbr2State";
+}
+
+std::ostream& operator<<(
+    std::ostream& os,
+    const Bbr2CongestionController& bbr) {
+  os << "Bbr2: state=" << bbr2StateToString(bbr.state_)
+     << ", cwnd=" << bbr.cwnd_ << ", pacingGain_=" << bbr.pacingGain_
+     << ", inflightHi=" << bbr.inflightHi_.value_or(0)
+     << ", inflightLo=" << bbr.inflightLo_.value_or(0)
+     << ", minRtt=" << bbr.minRtt().count()
+     << "us, bandwidth=" << bbr.bandwidth();
+  return os;
+}
+} // namespace quic
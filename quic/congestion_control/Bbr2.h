@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/congestion_control/Bandwidth.h>
+#include <quic/congestion_control/Bbr.h>
+#include <quic/congestion_control/third_party/windowed_filter.h>
+#include <quic/state/StateData.h>
+
+#include <limits>
+
+namespace quic {
+
+// Pacing gain during Startup, 4ln(2)
+constexpr float kBbr2StartupPacingGain = 2.77f;
+// Cwnd gain during Startup and Drain
+constexpr float kBbr2StartupCwndGain = 2.0f;
+// Pacing gain during Drain, the inverse of the gain Startup is based on
+constexpr float kBbr2DrainPacingGain = 1.0f / 2.885f;
+// Pacing gains of the ProbeBw phases
+constexpr float kBbr2ProbeBwDownPacingGain = 0.9f;
+constexpr float kBbr2ProbeBwUpPacingGain = 1.25f;
+// Cwnd gain during ProbeBw, and during ProbeBw Up
+constexpr float kBbr2ProbeBwCwndGain = 2.0f;
+constexpr float kBbr2ProbeBwUpCwndGain = 2.25f;
+// Pacing slightly below the estimate keeps the bottleneck queue from growing
+constexpr float kBbr2PacingMarginPercent = 1.0f;
+// The bandwidth has to grow by this much per round for Startup to go on
+constexpr float kBbr2StartupFullBwThresh = 1.25f;
+// Rounds without that growth after which Startup is over
+constexpr uint8_t kBbr2StartupFullBwRounds = 3;
+// Rounds with high loss after which Startup is over
+constexpr uint8_t kBbr2StartupFullLossRounds = 2;
+// The inflight is too high once more than this fraction of it is lost
+constexpr float kBbr2LossThresh = 0.02f;
+// Multiplicative decrease the lower bounds and inflight_hi get on congestion
+constexpr float kBbr2Beta = 0.7f;
+// Share of inflight_hi left free for other flows while cruising
+constexpr float kBbr2Headroom = 0.15f;
+// The wall clock time between two bandwidth probes is picked at random in
+// [kBbr2ProbeBwMinWait, kBbr2ProbeBwMinWait + kBbr2ProbeBwWaitRange]
+constexpr std::chrono::milliseconds kBbr2ProbeBwMinWait{2000};
+constexpr std::chrono::milliseconds kBbr2ProbeBwWaitRange{1000};
+// Cap on the number of rounds between two bandwidth probes, which would
+// otherwise be the number of rounds a Reno flow takes to fill the pipe.
+constexpr uint64_t kBbr2ProbeBwMaxRounds = 63;
+// How often the min rtt is refreshed with a ProbeRtt
+constexpr std::chrono::seconds kBbr2ProbeRttInterval{5};
+// Cwnd during ProbeRtt as a fraction of the BDP
+constexpr float kBbr2ProbeRttCwndGain = 0.5f;
+
+/**
+ * BBRv2, after draft-cardwell-iccrg-bbr-congestion-control-02. On top of the
+ * bandwidth and min rtt model of BBRv1 it keeps bounds on the inflight: an
+ * upper one, inflight_hi, that is learnt from the inflight at which a
+ * bandwidth probe ran into loss or ECN marks, and short term lower ones,
+ * bw_lo and inflight_lo, that back off multiplicatively in every round with
+ * congestion signals while not probing. That keeps the loss rate around
+ * kBbr2LossThresh instead of growing with the amount of buffering missing on
+ * the path.
+ *
+ * It shares the min rtt and bandwidth samplers with BbrCongestionController.
+ */
+class Bbr2CongestionController : public CongestionController {
+ public:
+  enum class State : uint8_t {
+    Startup,
+    Drain,
+    ProbeBwDown,
+    ProbeBwCruise,
+    ProbeBwRefill,
+    ProbeBwUp,
+    ProbeRtt,
+  };
+
+  explicit Bbr2CongestionController(QuicConnectionStateBase& conn);
+
+  void setRttSampler(
+      std::unique_ptr<BbrCongestionController::MinRttSampler> sampler) noexcept;
+  void setBandwidthSampler(
+      std::unique_ptr<BbrCongestionController::BandwidthSampler>
+          sampler) noexcept;
+
+  void onRemoveBytesFromInflight(uint64_t bytesToRemove) override;
+  void onPacketSent(const OutstandingPacket&) override;
+  void onPacketAckOrLoss(
+      folly::Optional<AckEvent> ackEvent,
+      folly::Optional<LossEvent> lossEvent) override;
+  void onSpuriousLoss() override;
+  void onEcnCongestionEvent(TimePoint sentTime) override;
+  uint64_t getWritableBytes() const noexcept override;
+
+  uint64_t getCongestionWindow() const noexcept override;
+  CongestionControlType type() const noexcept override;
+  void setAppIdle(bool idle, TimePoint eventTime) noexcept override;
+  void setAppLimited() override;
+
+  bool isAppLimited() const noexcept override;
+
+  State state() const noexcept;
+
+  folly::Optional<uint64_t> inflightHi() const noexcept;
+  folly::Optional<uint64_t> inflightLo() const noexcept;
+
+ private:
+  void onPacketAcked(const AckEvent& ack, bool newRoundTrip);
+  void onPacketLoss(const LossEvent& loss);
+
+  /*
+   * Return if we are at the start of a new round trip.
+   */
+  bool updateRoundTripCounter(TimePoint largestAckedSentTime) noexcept;
+  uint64_t updateAckAggregation(const AckEvent& ack);
+
+  /**
+   * Whether the loss or the ECN marks of the current round say the inflight
+   * is past what the path holds.
+   */
+  bool inflightTooHigh() const noexcept;
+  void handleInflightTooHigh(uint64_t inflightAtCongestion);
+  void adaptLowerBounds();
+  void resetLowerBounds() noexcept;
+  void probeInflightHiUpward(uint64_t ackedBytes, bool newRoundTrip);
+
+  void checkStartupDone(bool newRoundTrip, bool appLimitedSample) noexcept;
+  void updateProbeBwPhase(TimePoint ackTime, bool newRoundTrip);
+  bool isTimeToProbeBw(TimePoint ackTime) const noexcept;
+  void checkProbeRtt(TimePoint ackTime, bool newRoundTrip);
+
+  void transitToDrain() noexcept;
+  void transitToProbeBwDown(TimePoint ackTime);
+  void transitToProbeBwCruise() noexcept;
+  void transitToProbeBwRefill() noexcept;
+  void transitToProbeBwUp(TimePoint ackTime) noexcept;
+  void transitToProbeRtt() noexcept;
+  void exitProbeRtt(TimePoint ackTime);
+
+  void updateCwnd(uint64_t ackedBytes, uint64_t excessiveBytes) noexcept;
+  void updatePacing() noexcept;
+
+  uint64_t bdp(float gain) const noexcept;
+  uint64_t inflightWithHeadroom() const noexcept;
+  uint64_t probeRttCwnd() const noexcept;
+  uint64_t minCwnd() const noexcept;
+  std::chrono::microseconds minRtt() const noexcept;
+  // The max bandwidth estimate, capped by bw_lo
+  Bandwidth bandwidth() const noexcept;
+  Bandwidth maxBandwidth() const noexcept;
+
+  QuicConnectionStateBase& conn_;
+  State state_{State::Startup};
+
+  std::unique_ptr<BbrCongestionController::MinRttSampler> minRttSampler_;
+  std::unique_ptr<BbrCongestionController::BandwidthSampler>
+      bandwidthSampler_;
+
+  uint64_t roundTripCounter_{0};
+  // When a packet with send time later than endOfRoundTrip_ is acked, the
+  // current round strip is ended.
+  TimePoint endOfRoundTrip_;
+
+  uint64_t cwnd_;
+  uint64_t initialCwnd_;
+  uint64_t inflightBytes_{0};
+  uint64_t pacingWindow_;
+  float pacingGain_{kBbr2StartupPacingGain};
+  float cwndGain_{kBbr2StartupCwndGain};
+
+  // Startup is over once the bandwidth stops growing or the loss is too high
+  bool fullBwReached_{false};
+  Bandwidth fullBw_;
+  uint8_t fullBwCount_{0};
+  uint8_t lossRoundsInStartup_{0};
+
+  // The bytes delivered and lost, and whether there were CE marks, in the
+  // current round.
+  uint64_t roundDeliveredBytes_{0};
+  uint64_t roundLostBytes_{0};
+  bool roundEcn_{false};
+  // Whether the round that just ended had loss or CE marks, whether that was
+  // enough for its inflight to be too high, and what it delivered.
+  bool congestionInLastRound_{false};
+  bool lastRoundTooHigh_{false};
+  uint64_t lastRoundDeliveredBytes_{0};
+  // A CE mark arrived ahead of the ack that carried it
+  bool pendingEcn_{false};
+
+  folly::Optional<uint64_t> inflightHi_;
+  folly::Optional<uint64_t> inflightLo_;
+  folly::Optional<Bandwidth> bwLo_;
+
+  // Start of the current ProbeBw phase
+  TimePoint cycleStart_;
+  std::chrono::milliseconds bwProbeWait_{0};
+  uint64_t roundsSinceProbe_{0};
+  // inflight_hi grows by one MSS per bwProbeUpCnt_ acked bytes, which halves
+  // every round spent in ProbeBw Up.
+  uint64_t bwProbeUpCnt_{0};
+  uint64_t bwProbeUpAcks_{0};
+  uint8_t bwProbeUpRounds_{0};
+
+  folly::Optional<TimePoint> probeRttDoneTime_;
+  bool probeRttRoundDone_{false};
+  bool appLimitedSinceProbeRtt_{false};
+
+  WindowedFilter<
+      uint64_t /* ack bytes count */,
+      MaxFilter<uint64_t>,
+      uint64_t /* roundtrip count */,
+      uint64_t /* roundtrip count */>
+      maxAckHeightFilter_;
+  folly::Optional<TimePoint> ackAggregationStartTime_;
+  uint64_t aggregatedAckBytes_{0};
+
+  friend std::ostream& operator<<(
+      std::ostream& os,
+      const Bbr2CongestionController& bbr);
+};
+
+std::ostream& operator<<(
+    std::ostream& os,
+    const Bbr2CongestionController& bbr);
+
+folly::StringPiece bbr2StateToString(Bbr2CongestionController::State state);
+} // namespace quic
@@ -9,6 +9,7 @@
 // Copyright 2004-present Facebook.  All rights reserved.
 
 #include <quic/congestion_control/BbrBandwidthSampler.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
 #include <quic/logging/QLoggerConstants.h>
 #include <quic/logging/QuicLogger.h>
 
@@ -37,59 +38,25 @@ void BbrBandwidthSampler::onPacketAcked(
       }
     }
   }
-  // TODO: If i'm smart enough, maybe we don't have to loop through the acked
-  // packets. Can we calculate the bandwidth based on aggregated stats?
+  // The rate state is kept per packet, and the ack's sample comes from the
+  // most recently sent of the packets it acked.
+  if (!ackEvent.rateSample) {
+    return;
+  }
+  const auto& sample = *ackEvent.rateSample;
+  // Without the state of an earlier ack the sample only covers the acked
+  // packet itself. Given there can be multiple packets inflight during the
+  // time, this is clearly under estimating bandwidth. But it's better than
+  // nothing.
+  Bandwidth sendRate(sample.sentBytes, sample.sendElapsed);
+  Bandwidth ackRate(sample.deliveredBytes, sample.ackElapsed);
+  Bandwidth measuredBandwidth = sendRate > ackRate ? sendRate : ackRate;
+  // If a sample is from a packet sent during app-limited period, we should
+  // still use this sample if it's >= current best value.
   bool bandwidthUpdated = false;
-  for (auto const& ackedPacket : ackEvent.ackedPackets) {
-    if (ackedPacket.encodedSize == 0) {
-      continue;
-    }
-    Bandwidth sendRate, ackRate;
-    if (ackedPacket.lastAckedPacketInfo) {
-      DCHECK(ackedPacket.sentTime > ackedPacket.lastAckedPacketInfo->sentTime);
-      DCHECK_GE(
-          ackedPacket.totalBytesSentThen,
-          ackedPacket.lastAckedPacketInfo->totalBytesSent);
-      sendRate = Bandwidth(
-          ackedPacket.totalBytesSentThen -
-              ackedPacket.lastAckedPacketInfo->totalBytesSent,
-          std::chrono::duration_cast<std::chrono::microseconds>(
-              ackedPacket.sentTime -
-              ackedPacket.lastAckedPacketInfo->sentTime));
-
-      DCHECK(ackEvent.ackTime > ackedPacket.lastAckedPacketInfo->ackTime);
-      DCHECK_GE(
-          conn_.lossState.totalBytesAcked,
-          ackedPacket.lastAckedPacketInfo->totalBytesAcked);
-      ackRate = Bandwidth(
-          conn_.lossState.totalBytesAcked -
-              ackedPacket.lastAckedPacketInfo->totalBytesAcked,
-          std::chrono::duration_cast<std::chrono::microseconds>(
-              ackEvent.ackTime - ackedPacket.lastAckedPacketInfo->ackTime));
-    } else if (ackEvent.ackTime > ackedPacket.sentTime) {
-      // No previous ack info from outstanding packet, fallback to units/lrtt.
-      // This is a per packet delivery rate. Given there can be multiple packets
-      // inflight during the time, this is clearly under estimating bandwidth.
-      // But it's better than nothing.
-      //
-      // Note that this if condition:
-      //   ack.Event.ackTime > ackedPacket.sentTime
-      // will almost always be true unless your network is very very fast, or
-      // your clock is broken, or isn't steady. Anyway, in the rare cases that
-      // it isn't true, divide by zero will crash.
-      sendRate = Bandwidth(
-          ackedPacket.encodedSize,
-          std::chrono::duration_cast<std::chrono::microseconds>(
-              ackEvent.ackTime - ackedPacket.sentTime));
-    }
-    Bandwidth measuredBandwidth = sendRate > ackRate ? sendRate : ackRate;
-    // If a sample is from a packet sent during app-limited period, we should
-    // still use this sample if it's >= current best value.
-    if (measuredBandwidth >= windowedFilter_.GetBest() ||
-        !ackedPacket.isAppLimited) {
-      windowedFilter_.Update(measuredBandwidth, rttCounter);
-      bandwidthUpdated = true;
-    }
+  if (measuredBandwidth >= windowedFilter_.GetBest() || !sample.isAppLimited) {
+    windowedFilter_.Update(measuredBandwidth, rttCounter);
+    bandwidthUpdated = true;
   }
   if (bandwidthUpdated && conn_.qLogger) {
     auto newBandwidth = getBandwidth();
@@ -100,7 +67,7 @@ void BbrBandwidthSampler::onPacketAcked(
 
 void BbrBandwidthSampler::onAppLimited() {
   appLimited_ = true;
-  appLimitedExitTarget_ = Clock::now();
+  appLimitedExitTarget_ = congestionControlNow(conn_);
   QUIC_TRACE(
       bbr_applimited, conn_, appLimitedExitTarget_.time_since_epoch().count());
   if (conn_.qLogger) {
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CarefulResume.h>
+
+namespace quic {
+
+CarefulResume::CarefulResume(
+    const QuicConnectionStateBase& conn,
+    const CarefulResumeParams& params)
+    : conn_(conn), params_(params) {}
+
+CarefulResume::Phase CarefulResume::phase() const noexcept {
+  return phase_;
+}
+
+bool CarefulResume::holdsCwnd() const noexcept {
+  return phase_ == Phase::Unvalidated || phase_ == Phase::SafeRetreat;
+}
+
+folly::Optional<uint64_t> CarefulResume::onPacketAcked(
+    const CongestionController::AckEvent& ack,
+    uint64_t bytesInFlight) {
+  switch (phase_) {
+    case Phase::Reconnaissance: {
+      if (!ack.mrttSample) {
+        return folly::none;
+      }
+      auto rtt = *ack.mrttSample;
+      if (rtt < params_.savedRtt / kCarefulResumeMinRttDivisor ||
+          rtt > params_.savedRtt * kCarefulResumeMaxRttFactor) {
+        VLOG(10) << __func__ << " rtt=" << rtt.count()
+                 << "us does not confirm savedRtt="
+                 << params_.savedRtt.count() << "us " << conn_;
+        phase_ = Phase::Normal;
+        return folly::none;
+      }
+      VLOG(10) << __func__ << " jump to cwnd=" << params_.jumpCwndBytes << " "
+               << conn_;
+      phase_ = Phase::Unvalidated;
+      phaseStart_ = ack.ackTime;
+      return params_.jumpCwndBytes;
+    }
+    case Phase::Unvalidated:
+      pipeSize_ += ack.ackedBytes;
+      if (ack.largestAckedPacketSentTime < phaseStart_) {
+        return folly::none;
+      }
+      VLOG(10) << __func__ << " validating, pipeSize=" << pipeSize_
+               << " inflight=" << bytesInFlight << " " << conn_;
+      phase_ = Phase::Validating;
+      phaseStart_ = ack.ackTime;
+      // What the jump put in flight and what the path has delivered since.
+      return std::max(pipeSize_, bytesInFlight + ack.ackedBytes);
+    case Phase::Validating:
+    case Phase::SafeRetreat:
+      pipeSize_ += ack.ackedBytes;
+      if (ack.largestAckedPacketSentTime >= phaseStart_) {
+        VLOG(10) << __func__ << " done in phase "
+                 << carefulResumePhaseToString(phase_) << " " << conn_;
+        phase_ = Phase::Normal;
+      }
+      return folly::none;
+    case Phase::Normal:
+      return folly::none;
+  }
+  folly::assume_unreachable();
+}
+
+folly::Optional<uint64_t> CarefulResume::onCongestionEvent(
+    TimePoint eventTime) {
+  switch (phase_) {
+    case Phase::Reconnaissance:
+      // Lost before even the jump, the saved state is of little use.
+      phase_ = Phase::Normal;
+      return folly::none;
+    case Phase::Unvalidated:
+    case Phase::Validating:
+      VLOG(10) << __func__ << " retreat from phase "
+               << carefulResumePhaseToString(phase_)
+               << " pipeSize=" << pipeSize_ << " " << conn_;
+      phase_ = Phase::SafeRetreat;
+      phaseStart_ = eventTime;
+      return pipeSize_ / 2;
+    case Phase::SafeRetreat:
+    case Phase::Normal:
+      return folly::none;
+  }
+  folly::assume_unreachable();
+}
+
+folly::StringPiece carefulResumePhaseToString(CarefulResume::Phase phase) {
+  switch (phase) {
+    case CarefulResume::Phase::Reconnaissance:
+      return "Reconnaissance";
+    case CarefulResume::Phase::Unvalidated:
+      return "Unvalidated";
+    case CarefulResume::Phase::Validating:
+      return "Validating";
+    case CarefulResume::Phase::SafeRetreat:
+      return "SafeRetreat";
+    case CarefulResume::Phase::Normal:
+      return "Normal";
+  }
+  folly::assume_unreachable();
+}
+
+} // namespace quic
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+// The rtt of the path confirms the saved one if it is within these factors
+constexpr uint8_t kCarefulResumeMinRttDivisor = 2;
+constexpr uint8_t kCarefulResumeMaxRttFactor = 10;
+
+/**
+ * Careful resume, after draft-ietf-tsvwg-careful-resume, for the window based
+ * controllers of resumed connections. The connection starts at its initial
+ * cwnd, and once an rtt sample confirms the saved rtt (reconnaissance) it
+ * jumps to the saved cwnd without growing it further (unvalidated). The ack
+ * of the first packet sent after the jump sets the cwnd to what the path
+ * has shown it carries, and the controller grows it as usual again
+ * (validating). Once a packet sent after that is acked the saved state is
+ * validated.
+ *
+ * A congestion event in unvalidated or validating means the saved state was
+ * wrong. The cwnd then retreats to half of what was acked since the jump,
+ * and doesn't grow until the packets sent before the retreat are acked.
+ */
+class CarefulResume {
+ public:
+  enum class Phase : uint8_t {
+    Reconnaissance,
+    Unvalidated,
+    Validating,
+    SafeRetreat,
+    Normal,
+  };
+
+  CarefulResume(
+      const QuicConnectionStateBase& conn,
+      const CarefulResumeParams& params);
+
+  /**
+   * Returns the cwnd to switch to for the ack, if any. bytesInFlight is what
+   * stays in flight after the ack.
+   */
+  folly::Optional<uint64_t> onPacketAcked(
+      const CongestionController::AckEvent& ack,
+      uint64_t bytesInFlight);
+
+  /**
+   * Returns the cwnd to retreat to on a loss or a CE mark, if any. The
+   * controller's own reduction still applies if it ends up lower.
+   */
+  folly::Optional<uint64_t> onCongestionEvent(TimePoint eventTime);
+
+  /**
+   * Whether the controller must not grow the cwnd on acks.
+   */
+  bool holdsCwnd() const noexcept;
+
+  Phase phase() const noexcept;
+
+ private:
+  const QuicConnectionStateBase& conn_;
+  CarefulResumeParams params_;
+  Phase phase_{Phase::Reconnaissance};
+  // Bytes acked since the jump, what the path has shown it carries
+  uint64_t pipeSize_{0};
+  // The current phase ends once a packet sent after this time is acked
+  TimePoint phaseStart_;
+};
+
+folly::StringPiece carefulResumePhaseToString(CarefulResume::Phase phase);
+
+} // namespace quic
@@ -24,6 +24,56 @@ uint64_t boundedCwnd(
       minCwndInMss * packetLength);
 }
 
+TimePoint congestionControlNow(const QuicConnectionStateBase& conn) {
+  return conn.congestionControlClock ? conn.congestionControlClock()
+                                     : Clock::now();
+}
+
+uint64_t initialCwndBytes(const QuicConnectionStateBase& conn) noexcept {
+  return conn.warmStartCwndBytes.value_or(
+      conn.transportSettings.initCwndInMss * conn.udpSendPacketLen);
+}
+
+folly::Optional<CachedCongestionState> makeCachedCongestionState(
+    const QuicConnectionStateBase& conn,
+    std::chrono::system_clock::time_point now) {
+  if (!conn.congestionController || conn.lossState.srtt == 0us) {
+    return folly::none;
+  }
+  CachedCongestionState state;
+  if (conn.lossState.lastRateSample) {
+    state.bandwidthBytesPerSec = conn.lossState.lastRateSample->deliveryRate();
+  }
+  state.minRtt = conn.lossState.mrtt;
+  state.cwndBytes = conn.congestionController->getCongestionWindow();
+  state.recordTime = now;
+  return state;
+}
+
+folly::Optional<uint64_t> warmStartCwnd(
+    const QuicConnectionStateBase& conn,
+    const CachedCongestionState& state,
+    std::chrono::system_clock::time_point now) {
+  const auto& settings = conn.transportSettings;
+  if (now < state.recordTime ||
+      now - state.recordTime > settings.warmStartMaxAge) {
+    return folly::none;
+  }
+  uint64_t cwnd = state.cwndBytes;
+  if (state.bandwidthBytesPerSec > 0 && state.minRtt > 0us) {
+    cwnd = std::min<uint64_t>(
+        cwnd, state.bandwidthBytesPerSec * state.minRtt.count() / 1000000);
+  }
+  cwnd = std::min(
+      cwnd / 2,
+      std::min(settings.warmStartMaxCwndInMss, settings.maxCwndInMss) *
+          conn.udpSendPacketLen);
+  if (cwnd <= settings.initCwndInMss * conn.udpSendPacketLen) {
+    return folly::none;
+  }
+  return cwnd;
+}
+
 PacingRate calculatePacingRate(
     const QuicConnectionStateBase& conn,
     uint64_t cwnd,
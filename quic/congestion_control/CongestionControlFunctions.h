@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <quic/state/CongestionStateCache.h>
 #include <quic/state/StateData.h>
 
 #include <chrono>
@@ -21,6 +22,37 @@ uint64_t boundedCwnd(
     uint64_t maxCwndInMss,
     uint64_t minCwndInMss) noexcept;
 
+/**
+ * The current time, from the connection's congestionControlClock if it has
+ * one.
+ */
+TimePoint congestionControlNow(const QuicConnectionStateBase& conn);
+
+/**
+ * The cwnd a new congestion controller starts with, the warm start cwnd if
+ * the connection has one.
+ */
+uint64_t initialCwndBytes(const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * The connection's congestion state for the next connection to the peer to
+ * warm start from, none before it has an rtt sample.
+ */
+folly::Optional<CachedCongestionState> makeCachedCongestionState(
+    const QuicConnectionStateBase& conn,
+    std::chrono::system_clock::time_point now);
+
+/**
+ * The cwnd a connection warm starts with from cached state: half the smaller
+ * of the cached cwnd and bandwidth delay product, since the path may have
+ * changed since, and at most warmStartMaxCwndInMss. none if the state is
+ * older than warmStartMaxAge or would not start above initCwndInMss.
+ */
+folly::Optional<uint64_t> warmStartCwnd(
+    const QuicConnectionStateBase& conn,
+    const CachedCongestionState& state,
+    std::chrono::system_clock::time_point now);
+
 PacingRate calculatePacingRate(
     const QuicConnectionStateBase& conn,
     uint64_t cwnd,
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CongestionControlGroup.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
+
+#include <algorithm>
+
+namespace quic {
+
+CongestionControlGroup::CongestionControlGroup()
+    : groupConn_(QuicNodeType::Server) {}
+
+void CongestionControlGroup::addMember(
+    const QuicConnectionStateBase& conn,
+    CongestionControllerFactory& factory,
+    CongestionControlType type) {
+  if (!groupConn_.congestionController) {
+    groupConn_.transportSettings = conn.transportSettings;
+    groupConn_.udpSendPacketLen = conn.udpSendPacketLen;
+    groupConn_.congestionControlClock = conn.congestionControlClock;
+    groupConn_.congestionController =
+        factory.makeCongestionController(groupConn_, type);
+  }
+  members_++;
+}
+
+void CongestionControlGroup::removeMember(
+    uint64_t inflightBytes,
+    bool appIdle) {
+  DCHECK_GT(members_, 0);
+  members_--;
+  updateMemberInflight(inflightBytes, 0);
+  if (inflightBytes > 0) {
+    groupConn_.congestionController->onRemoveBytesFromInflight(inflightBytes);
+  }
+  if (appIdle) {
+    DCHECK_GT(idleMembers_, 0);
+    idleMembers_--;
+  } else if (members_ > 0 && idleMembers_ == members_) {
+    // The last active member left.
+    controller().setAppIdle(true, congestionControlNow(groupConn_));
+  }
+}
+
+size_t CongestionControlGroup::size() const noexcept {
+  return members_;
+}
+
+CongestionController& CongestionControlGroup::controller() const {
+  DCHECK(groupConn_.congestionController);
+  return *groupConn_.congestionController;
+}
+
+void CongestionControlGroup::syncRtt(const QuicConnectionStateBase& conn) {
+  groupConn_.lossState.srtt = conn.lossState.srtt;
+  groupConn_.lossState.lrtt = conn.lossState.lrtt;
+  groupConn_.lossState.rttvar = conn.lossState.rttvar;
+  groupConn_.lossState.mrtt = conn.lossState.mrtt;
+  groupConn_.lossState.maxAckDelay = conn.lossState.maxAckDelay;
+}
+
+void CongestionControlGroup::updateMemberInflight(
+    uint64_t previous,
+    uint64_t current) {
+  if (previous == 0 && current > 0) {
+    sendingMembers_++;
+  } else if (previous > 0 && current == 0) {
+    DCHECK_GT(sendingMembers_, 0);
+    sendingMembers_--;
+  }
+}
+
+uint64_t CongestionControlGroup::getMemberShare(
+    uint64_t memberInflight) const {
+  // A member that is about to start sending counts as one more.
+  auto sending = sendingMembers_ + (memberInflight == 0 ? 1 : 0);
+  return controller().getCongestionWindow() / sending;
+}
+
+void CongestionControlGroup::setMemberAppIdle(bool idle, TimePoint eventTime) {
+  if (idle) {
+    idleMembers_++;
+    if (idleMembers_ == members_) {
+      controller().setAppIdle(true, eventTime);
+    }
+  } else {
+    DCHECK_GT(idleMembers_, 0);
+    if (idleMembers_ == members_) {
+      controller().setAppIdle(false, eventTime);
+    }
+    idleMembers_--;
+  }
+}
+
+GroupMemberCongestionController::GroupMemberCongestionController(
+    QuicConnectionStateBase& conn,
+    std::shared_ptr<CongestionControlGroup> group,
+    CongestionControllerFactory& factory,
+    CongestionControlType type)
+    : conn_(conn), group_(std::move(group)) {
+  group_->addMember(conn_, factory, type);
+}
+
+GroupMemberCongestionController::~GroupMemberCongestionController() {
+  group_->removeMember(inflightBytes_, appIdle_);
+}
+
+void GroupMemberCongestionController::updateInflight(uint64_t inflightBytes) {
+  group_->updateMemberInflight(inflightBytes_, inflightBytes);
+  inflightBytes_ = inflightBytes;
+}
+
+void GroupMemberCongestionController::refreshPacingRate() {
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(
+        getCongestionWindow(), conn_.lossState.srtt);
+  }
+}
+
+void GroupMemberCongestionController::onRemoveBytesFromInflight(
+    uint64_t bytes) {
+  DCHECK_LE(bytes, inflightBytes_);
+  updateInflight(inflightBytes_ - bytes);
+  group_->controller().onRemoveBytesFromInflight(bytes);
+}
+
+void GroupMemberCongestionController::onPacketSent(
+    const OutstandingPacket& packet) {
+  updateInflight(inflightBytes_ + packet.encodedSize);
+  group_->controller().onPacketSent(packet);
+}
+
+void GroupMemberCongestionController::onPacketAckOrLoss(
+    folly::Optional<AckEvent> ack,
+    folly::Optional<LossEvent> loss) {
+  uint64_t bytes = (ack ? ack->ackedBytes : 0) + (loss ? loss->lostBytes : 0);
+  DCHECK_LE(bytes, inflightBytes_);
+  updateInflight(inflightBytes_ - bytes);
+  group_->syncRtt(conn_);
+  group_->controller().onPacketAckOrLoss(std::move(ack), std::move(loss));
+  refreshPacingRate();
+}
+
+void GroupMemberCongestionController::onSpuriousLoss() {
+  group_->controller().onSpuriousLoss();
+}
+
+void GroupMemberCongestionController::onEcnCongestionEvent(
+    TimePoint sentTime) {
+  group_->syncRtt(conn_);
+  group_->controller().onEcnCongestionEvent(sentTime);
+  refreshPacingRate();
+}
+
+uint64_t GroupMemberCongestionController::getWritableBytes() const noexcept {
+  auto share = getCongestionWindow();
+  auto shareWritable = share > inflightBytes_ ? share - inflightBytes_ : 0;
+  return std::min(group_->controller().getWritableBytes(), shareWritable);
+}
+
+uint64_t GroupMemberCongestionController::getCongestionWindow() const
+    noexcept {
+  return group_->getMemberShare(inflightBytes_);
+}
+
+void GroupMemberCongestionController::setAppIdle(
+    bool idle,
+    TimePoint eventTime) noexcept {
+  if (idle == appIdle_) {
+    return;
+  }
+  appIdle_ = idle;
+  group_->setMemberAppIdle(idle, eventTime);
+}
+
+void GroupMemberCongestionController::setAppLimited() {
+  // The group is only app limited if it doesn't fill its cwnd either.
+  if (group_->controller().getWritableBytes() > 0) {
+    group_->controller().setAppLimited();
+  }
+}
+
+CongestionControlType GroupMemberCongestionController::type() const noexcept {
+  return group_->controller().type();
+}
+
+bool GroupMemberCongestionController::isAppLimited() const noexcept {
+  return group_->controller().isAppLimited();
+}
+
+bool isGroupCongestionControlType(CongestionControlType type) noexcept {
+  // BBR's samplers and Copa's rate work off the counters and the pacer of
+  // their own connection.
+  return type == CongestionControlType::Cubic ||
+      type == CongestionControlType::NewReno;
+}
+
+GroupCongestionControllerFactory::GroupCongestionControllerFactory(
+    std::shared_ptr<CongestionControllerFactory> factory,
+    std::shared_ptr<CongestionControlGroup> group)
+    : factory_(std::move(factory)), group_(std::move(group)) {
+  CHECK(factory_);
+  CHECK(group_);
+}
+
+std::unique_ptr<CongestionController>
+GroupCongestionControllerFactory::makeCongestionController(
+    QuicConnectionStateBase& conn,
+    CongestionControlType type) {
+  if (!isGroupCongestionControlType(type) ||
+      conn.transportSettings.congestionControllerName) {
+    return factory_->makeCongestionController(conn, type);
+  }
+  return std::make_unique<GroupMemberCongestionController>(
+      conn, group_, *factory_, type);
+}
+
+std::shared_ptr<CongestionControlGroup>
+CongestionControlGroupRegistry::getGroup(const std::string& key) {
+  auto& entry = groups_[key];
+  auto group = entry.lock();
+  if (!group) {
+    group = std::make_shared<CongestionControlGroup>();
+    entry = group;
+  }
+  if (groups_.size() >= sweepThreshold_) {
+    for (auto it = groups_.begin(); it != groups_.end();) {
+      if (it->second.expired()) {
+        it = groups_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    sweepThreshold_ = std::max(
+        kMinCongestionControlGroupSweepThreshold, groups_.size() * 2);
+  }
+  return group;
+}
+
+size_t CongestionControlGroupRegistry::size() const noexcept {
+  return groups_.size();
+}
+
+} // namespace quic
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/state/StateData.h>
+
+#include <folly/container/F14Map.h>
+
+#include <memory>
+#include <string>
+
+namespace quic {
+
+/**
+ * Connections to the same peer that share one congestion controller, so that
+ * together they probe for and back off from the bottleneck like a single
+ * flow instead of competing with each other. Each member gets an equal share
+ * of the group's cwnd among the members with data in flight, and paces at
+ * that share.
+ *
+ * The group's controller runs on a connection state of its own, which takes
+ * the settings of the first member and the rtt of the member whose event it
+ * is handling, and has no pacer. So only controllers that don't depend on
+ * per connection counters can be shared, see isGroupCongestionControlType.
+ *
+ * Not thread safe, the members have to run on the same evb, e.g. the
+ * connections of a server worker.
+ */
+class CongestionControlGroup {
+ public:
+  CongestionControlGroup();
+
+  /**
+   * Makes the group's controller of the given type if this is the first
+   * member. Later members share it, whatever type they ask for.
+   */
+  void addMember(
+      const QuicConnectionStateBase& conn,
+      CongestionControllerFactory& factory,
+      CongestionControlType type);
+
+  /**
+   * Takes what the member still has in flight out of the group's controller.
+   */
+  void removeMember(uint64_t inflightBytes, bool appIdle);
+
+  size_t size() const noexcept;
+
+  CongestionController& controller() const;
+
+  /**
+   * Has the group's controller see the rtt of the connection whose event it
+   * handles next.
+   */
+  void syncRtt(const QuicConnectionStateBase& conn);
+
+  /**
+   * Tracks how many members have data in flight, from a member's inflight
+   * before and after a change.
+   */
+  void updateMemberInflight(uint64_t previous, uint64_t current);
+
+  /**
+   * The cwnd of a member with the given inflight, an even share of the
+   * group's among the members sending.
+   */
+  uint64_t getMemberShare(uint64_t memberInflight) const;
+
+  /**
+   * The group's controller only goes app idle once all the members are, and
+   * active again with the first that is.
+   */
+  void setMemberAppIdle(bool idle, TimePoint eventTime);
+
+ private:
+  QuicConnectionStateBase groupConn_;
+  size_t members_{0};
+  size_t sendingMembers_{0};
+  size_t idleMembers_{0};
+};
+
+/**
+ * The controller of a connection in a CongestionControlGroup. It hands the
+ * connection's events to the group's controller and writes and paces at the
+ * connection's share of its cwnd.
+ */
+class GroupMemberCongestionController : public CongestionController {
+ public:
+  GroupMemberCongestionController(
+      QuicConnectionStateBase& conn,
+      std::shared_ptr<CongestionControlGroup> group,
+      CongestionControllerFactory& factory,
+      CongestionControlType type);
+  ~GroupMemberCongestionController() override;
+
+  void onRemoveBytesFromInflight(uint64_t bytes) override;
+  void onPacketSent(const OutstandingPacket& packet) override;
+  void onPacketAckOrLoss(
+      folly::Optional<AckEvent> ack,
+      folly::Optional<LossEvent> loss) override;
+  void onSpuriousLoss() override;
+  void onEcnCongestionEvent(TimePoint sentTime) override;
+
+  uint64_t getWritableBytes() const noexcept override;
+  uint64_t getCongestionWindow() const noexcept override;
+  void setAppIdle(bool idle, TimePoint eventTime) noexcept override;
+  void setAppLimited() override;
+
+  CongestionControlType type() const noexcept override;
+
+  bool isAppLimited() const noexcept override;
+
+ private:
+  void updateInflight(uint64_t inflightBytes);
+  void refreshPacingRate();
+
+  QuicConnectionStateBase& conn_;
+  std::shared_ptr<CongestionControlGroup> group_;
+  uint64_t inflightBytes_{0};
+  bool appIdle_{false};
+};
+
+/**
+ * Whether connections with controllers of the type can share one.
+ */
+bool isGroupCongestionControlType(CongestionControlType type) noexcept;
+
+/**
+ * Makes controllers that join the group, for the types that can be shared,
+ * and the controllers of the wrapped factory otherwise.
+ */
+class GroupCongestionControllerFactory : public CongestionControllerFactory {
+ public:
+  GroupCongestionControllerFactory(
+      std::shared_ptr<CongestionControllerFactory> factory,
+      std::shared_ptr<CongestionControlGroup> group);
+  ~GroupCongestionControllerFactory() override = default;
+
+  std::unique_ptr<CongestionController> makeCongestionController(
+      QuicConnectionStateBase& conn,
+      CongestionControlType type) override;
+
+ private:
+  std::shared_ptr<CongestionControllerFactory> factory_;
+  std::shared_ptr<CongestionControlGroup> group_;
+};
+
+/**
+ * The groups of one evb by key, e.g. by client subnet on a server worker, or
+ * by a key of the app's own on clients. A group lives as long as it has
+ * members.
+ */
+class CongestionControlGroupRegistry {
+ public:
+  std::shared_ptr<CongestionControlGroup> getGroup(const std::string& key);
+
+  size_t size() const noexcept;
+
+ private:
+  folly::F14FastMap<std::string, std::weak_ptr<CongestionControlGroup>>
+      groups_;
+  // Groups without members are swept once there are this many
+  size_t sweepThreshold_{kMinCongestionControlGroupSweepThreshold};
+};
+
+} // namespace quic
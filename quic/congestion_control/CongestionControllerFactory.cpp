@@ -9,8 +9,10 @@
 #include <quic/congestion_control/CongestionControllerFactory.h>
 
 #include <quic/congestion_control/Bbr.h>
+#include <quic/congestion_control/Bbr2.h>
 #include <quic/congestion_control/BbrBandwidthSampler.h>
 #include <quic/congestion_control/BbrRttSampler.h>
+#include <quic/congestion_control/CongestionControllerRegistry.h>
 #include <quic/congestion_control/Copa.h>
 #include <quic/congestion_control/NewReno.h>
 #include <quic/congestion_control/QuicCubic.h>
@@ -22,6 +24,20 @@ std::unique_ptr<CongestionController>
 DefaultCongestionControllerFactory::makeCongestionController(
     QuicConnectionStateBase& conn,
     CongestionControlType type) {
+  const auto& settings = conn.transportSettings;
+  if (settings.congestionControllerName) {
+    auto registered =
+        CongestionControllerRegistry::get().makeCongestionController(
+            *settings.congestionControllerName,
+            conn,
+            settings.congestionControllerParams);
+    if (registered) {
+      return registered;
+    }
+    VLOG(2) << "No congestion controller registered as "
+            << *settings.congestionControllerName << ", using "
+            << congestionControlTypeToString(type);
+  }
   std::unique_ptr<CongestionController> congestionController;
   switch (type) {
     case CongestionControlType::NewReno:
@@ -41,6 +57,14 @@ DefaultCongestionControllerFactory::makeCongestionController(
       congestionController = std::move(bbr);
       break;
     }
+    case CongestionControlType::BBR2: {
+      auto bbr2 = std::make_unique<Bbr2CongestionController>(conn);
+      bbr2->setRttSampler(
+          std::make_unique<BbrRttSampler>(kBbr2ProbeRttInterval));
+      bbr2->setBandwidthSampler(std::make_unique<BbrBandwidthSampler>(conn));
+      congestionController = std::move(bbr2);
+      break;
+    }
     case CongestionControlType::None:
       break;
   }
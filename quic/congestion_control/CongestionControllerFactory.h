@@ -30,6 +30,11 @@ class CongestionControllerFactory {
       CongestionControlType type) = 0;
 };
 
+/**
+ * Makes the registered controller named by the congestionControllerName
+ * transport setting if there is one, and the built in controller of the type
+ * otherwise.
+ */
 class DefaultCongestionControllerFactory : public CongestionControllerFactory {
  public:
   ~DefaultCongestionControllerFactory() override = default;
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CongestionControllerRegistry.h>
+
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+CongestionControllerRegistry& CongestionControllerRegistry::get() {
+  // Leaked so that connections torn down during static destruction can still
+  // look it up.
+  static auto* registry = new CongestionControllerRegistry();
+  return *registry;
+}
+
+bool CongestionControllerRegistry::registerController(
+    std::string name,
+    Maker maker) {
+  CHECK(maker) << "No maker for congestion controller " << name;
+  std::lock_guard<std::mutex> guard(mutex_);
+  return makers_.emplace(std::move(name), std::move(maker)).second;
+}
+
+bool CongestionControllerRegistry::unregisterController(
+    folly::StringPiece name) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return makers_.erase(name.str()) > 0;
+}
+
+bool CongestionControllerRegistry::isRegistered(
+    folly::StringPiece name) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return makers_.count(name.str()) > 0;
+}
+
+std::vector<std::string> CongestionControllerRegistry::names() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::vector<std::string> names;
+  names.reserve(makers_.size());
+  for (const auto& entry : makers_) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+
+std::unique_ptr<CongestionController>
+CongestionControllerRegistry::makeCongestionController(
+    folly::StringPiece name,
+    QuicConnectionStateBase& conn,
+    const std::string& params) const {
+  Maker maker;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = makers_.find(name.str());
+    if (it == makers_.end()) {
+      return nullptr;
+    }
+    maker = it->second;
+  }
+  // The maker runs unlocked, it may well look at the registry itself.
+  return maker(conn, params);
+}
+
+} // namespace quic
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace quic {
+struct CongestionController;
+struct QuicConnectionStateBase;
+
+/**
+ * Process wide registry of congestion controllers that are picked by name,
+ * so out of tree controllers can be tried on connections without a custom
+ * CongestionControllerFactory. A connection gets the registered controller
+ * whose name is in its transportSettings.congestionControllerName, e.g. from
+ * a server's TransportSettingsOverrideFn. The maker is handed the
+ * connection's congestionControllerParams blob, which only the controller
+ * parses.
+ *
+ * Controllers are registered once at startup and looked up for every new
+ * connection, from any thread.
+ */
+class CongestionControllerRegistry {
+ public:
+  using Maker = std::function<std::unique_ptr<CongestionController>(
+      QuicConnectionStateBase& conn,
+      const std::string& params)>;
+
+  static CongestionControllerRegistry& get();
+
+  /**
+   * Returns false, and keeps the existing maker, if the name is taken.
+   */
+  bool registerController(std::string name, Maker maker);
+  bool unregisterController(folly::StringPiece name);
+
+  bool isRegistered(folly::StringPiece name) const;
+  std::vector<std::string> names() const;
+
+  /**
+   * nullptr if there is no controller with the name.
+   */
+  std::unique_ptr<CongestionController> makeCongestionController(
+      folly::StringPiece name,
+      QuicConnectionStateBase& conn,
+      const std::string& params) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Maker> makers_;
+};
+
+} // namespace quic
@@ -18,19 +18,25 @@ using namespace std::chrono;
 
 Copa::Copa(QuicConnectionStateBase& conn)
     : conn_(conn),
-      cwndBytes_(conn.transportSettings.initCwndInMss * conn.udpSendPacketLen),
+      cwndBytes_(initialCwndBytes(conn)),
       isSlowStart_(true),
       minRTTFilter_(kMinRTTWindowLength.count(), 0us, 0),
       standingRTTFilter_(
           100000, /*100ms*/
           0us,
-          0) {
+          0),
+      maxRTTFilter_(
+          400000, /*400ms*/
+          0us,
+          0),
+      competitiveModeEnabled_(conn.transportSettings.copaCompetitiveMode) {
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
            << conn_;
   if (conn_.transportSettings.latencyFactor.has_value()) {
     latencyFactor_ = conn_.transportSettings.latencyFactor.value();
   }
+  competitiveState_.inverseDelta = 1 / latencyFactor_;
   QUIC_TRACE(initcwnd, conn_, cwndBytes_);
 }
 
@@ -123,6 +129,59 @@ void Copa::changeDirection(
   velocityState_.lastRecordedCwndBytes = cwndBytes_;
 }
 
+/**
+ * Copa competes with buffer filling flows by watching whether the queue it
+ * sees ever drains. If the standing rtt did not come within 10% of the
+ * rtt range above the min rtt for 5 rtts, something else keeps the queue
+ * full, and Copa switches to competitive mode. There it runs AIMD on
+ * 1 / delta, which makes it emulate that many Reno flows, instead of using
+ * the fixed latency factor, until the queue drains again.
+ */
+void Copa::updateCompetitiveMode(
+    const AckEvent& ack,
+    std::chrono::microseconds rttMin,
+    std::chrono::microseconds rttStanding) {
+  maxRTTFilter_.SetWindowLength(4 * conn_.lossState.srtt.count());
+  maxRTTFilter_.Update(
+      conn_.lossState.lrtt,
+      std::chrono::duration_cast<microseconds>(ack.ackTime.time_since_epoch())
+          .count());
+  auto rttMax = maxRTTFilter_.GetBest();
+  if (rttStanding - rttMin <= (rttMax - rttMin) / 10) {
+    competitiveState_.queueNearlyEmpty = true;
+  }
+  if (!competitiveState_.periodStart.has_value()) {
+    competitiveState_.periodStart = ack.ackTime;
+  } else if (
+      ack.ackTime - competitiveState_.periodStart.value() >=
+      5 * conn_.lossState.srtt) {
+    bool competitive = !competitiveState_.queueNearlyEmpty;
+    if (competitive != competitiveState_.competitive) {
+      VLOG(10) << __func__ << " switching to "
+               << (competitive ? "competitive" : "default")
+               << " mode rttMin=" << rttMin.count()
+               << " rttStanding=" << rttStanding.count()
+               << " rttMax=" << rttMax.count() << " " << conn_;
+      competitiveState_.competitive = competitive;
+      competitiveState_.inverseDelta = 1 / latencyFactor_;
+      competitiveState_.lastReductionTime = folly::none;
+      if (conn_.qLogger) {
+        conn_.qLogger->addCongestionMetricUpdate(
+            bytesInFlight_,
+            getCongestionWindow(),
+            competitive ? kCopaCompetitiveMode : kCopaDefaultMode);
+      }
+    }
+    competitiveState_.periodStart = ack.ackTime;
+    competitiveState_.queueNearlyEmpty = false;
+  }
+  if (competitiveState_.competitive) {
+    // A cwnd worth of acks, i.e. one rtt, adds one to 1 / delta.
+    competitiveState_.inverseDelta +=
+        (1.0 * ack.ackedPackets.size() * conn_.udpSendPacketLen) / cwndBytes_;
+  }
+}
+
 void Copa::onPacketAckOrLoss(
     folly::Optional<AckEvent> ack,
     folly::Optional<LossEvent> loss) {
@@ -191,6 +250,11 @@ void Copa::onPacketAcked(const AckEvent& ack) {
            << " estimated queuing delay microsec =" << delayInMicroSec << " "
            << conn_;
 
+  if (competitiveModeEnabled_) {
+    updateCompetitiveMode(ack, rttMin, standingRTTFilter_.GetBest());
+  }
+  auto delta = getDelta();
+
   bool increaseCwnd = false;
   if (delayInMicroSec == 0) {
     // taking care of inf targetRate case here, this happens in beginning where
@@ -198,7 +262,7 @@ void Copa::onPacketAcked(const AckEvent& ack) {
     increaseCwnd = true;
   } else {
     auto targetRate = (1.0 * conn_.udpSendPacketLen * 1000000) /
-        (latencyFactor_ * delayInMicroSec);
+        (delta * delayInMicroSec);
     auto currentRate = (1.0 * cwndBytes_ * 1000000) / rttStandingMicroSec;
 
     VLOG(10) << __func__ << " estimated target rate=" << targetRate
@@ -236,7 +300,7 @@ void Copa::onPacketAcked(const AckEvent& ack) {
       }
       uint64_t addition = (ack.ackedPackets.size() * conn_.udpSendPacketLen *
                            conn_.udpSendPacketLen * velocityState_.velocity) /
-          (latencyFactor_ * cwndBytes_);
+          (delta * cwndBytes_);
       VLOG(10) << __func__ << " increasing cwnd from=" << cwndBytes_ << " by "
                << addition << " " << conn_;
       addAndCheckOverflow(cwndBytes_, addition);
@@ -252,7 +316,7 @@ void Copa::onPacketAcked(const AckEvent& ack) {
     }
     uint64_t reduction = (ack.ackedPackets.size() * conn_.udpSendPacketLen *
                           conn_.udpSendPacketLen * velocityState_.velocity) /
-        (latencyFactor_ * cwndBytes_);
+        (delta * cwndBytes_);
     VLOG(10) << __func__ << " decreasing cwnd from=" << cwndBytes_ << " by "
              << reduction << " " << conn_;
     isSlowStart_ = false;
@@ -268,6 +332,14 @@ void Copa::onPacketAcked(const AckEvent& ack) {
   }
 }
 
+void Copa::onSpuriousLoss() {
+  // Copa only reacts to persistent congestion, there is nothing to undo.
+}
+
+void Copa::onEcnCongestionEvent(TimePoint) {
+  // Copa reacts to the queueing delay a CE mark stands for, not to the mark.
+}
+
 void Copa::onPacketLoss(const LossEvent& loss) {
   VLOG(10) << __func__ << " lostBytes=" << loss.lostBytes
            << " lostPackets=" << loss.lostPackets << " cwnd=" << cwndBytes_
@@ -278,6 +350,18 @@ void Copa::onPacketLoss(const LossEvent& loss) {
   }
   DCHECK(loss.largestLostPacketNum.has_value());
   subtractAndCheckUnderflow(bytesInFlight_, loss.lostBytes);
+  if (competitiveState_.competitive && loss.largestLostSentTime &&
+      (!competitiveState_.lastReductionTime ||
+       *loss.largestLostSentTime > *competitiveState_.lastReductionTime)) {
+    // Halve 1 / delta once per congestion event, but never below where it
+    // would be less aggressive than the default mode.
+    competitiveState_.inverseDelta = std::max(
+        1 / latencyFactor_, competitiveState_.inverseDelta / 2);
+    competitiveState_.lastReductionTime = loss.lossTime;
+    VLOG(10) << __func__
+             << " halved inverse delta to " << competitiveState_.inverseDelta
+             << " " << conn_;
+  }
   if (loss.persistentCongestion) {
     // TODO See if we should go to slowStart here
     VLOG(10) << __func__ << " writable=" << getWritableBytes()
@@ -306,6 +390,15 @@ uint64_t Copa::getCongestionWindow() const noexcept {
   return cwndBytes_;
 }
 
+bool Copa::inCompetitiveMode() const noexcept {
+  return competitiveState_.competitive;
+}
+
+double Copa::getDelta() const noexcept {
+  return competitiveState_.competitive ? 1 / competitiveState_.inverseDelta
+                                       : latencyFactor_;
+}
+
 bool Copa::inSlowStart() {
   return isSlowStart_;
 }
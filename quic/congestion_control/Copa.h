@@ -33,6 +33,8 @@ class Copa : public CongestionController {
   void onPacketSent(const OutstandingPacket& packet) override;
   void onPacketAckOrLoss(folly::Optional<AckEvent>, folly::Optional<LossEvent>)
       override;
+  void onSpuriousLoss() override;
+  void onEcnCongestionEvent(TimePoint sentTime) override;
 
   uint64_t getWritableBytes() const noexcept override;
   uint64_t getCongestionWindow() const noexcept override;
@@ -46,10 +48,39 @@ class Copa : public CongestionController {
   void setAppLimited() override;
   bool isAppLimited() const noexcept override;
 
+  /**
+   * Whether the queueing delay has not drained for the last 5 rtts, so Copa
+   * competes with buffer filling flows using its adaptive delta instead of
+   * the latency factor. Only with transportSettings.copaCompetitiveMode.
+   */
+  bool inCompetitiveMode() const noexcept;
+
+  /**
+   * The delta the target rate and the cwnd updates are computed with.
+   */
+  double getDelta() const noexcept;
+
  private:
   void onPacketAcked(const AckEvent&);
   void onPacketLoss(const LossEvent&);
 
+  struct CompetitiveState {
+    // start of the current 5 rtt period the queue is checked over
+    folly::Optional<TimePoint> periodStart{folly::none};
+    // whether the standing rtt came close to the min rtt during the period
+    bool queueNearlyEmpty{false};
+    bool competitive{false};
+    // 1 / delta, increased by one per rtt and halved on loss, like a cwnd
+    double inverseDelta{0};
+    // when 1 / delta was last halved, losses of packets sent before it belong
+    // to the same congestion event
+    folly::Optional<TimePoint> lastReductionTime{folly::none};
+  };
+  void updateCompetitiveMode(
+      const AckEvent& ack,
+      std::chrono::microseconds rttMin,
+      std::chrono::microseconds rttStanding);
+
   struct VelocityState {
     uint64_t velocity{1};
     enum Direction {
@@ -90,7 +121,16 @@ class Copa : public CongestionController {
       uint64_t>
       standingRTTFilter_; // To get min RTT over srtt/2
 
+  WindowedFilter<
+      std::chrono::microseconds,
+      MaxFilter<std::chrono::microseconds>,
+      uint64_t,
+      uint64_t>
+      maxRTTFilter_; // To get max RTT over 4 * srtt
+
   VelocityState velocityState_;
+  bool competitiveModeEnabled_{false};
+  CompetitiveState competitiveState_;
   /**
    * latencyFactor_ determines how latency sensitive the algorithm is. Lower
    * means it will maximime throughput at expense of delay. Higher value means
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CubicFixedPoint.h>
+
+#include <folly/lang/Bits.h>
+#include <quic/QuicConstants.h>
+
+#include <array>
+#include <limits>
+
+namespace quic {
+
+namespace {
+// ceil(16 * cbrt(i + 1)), an upper bound of the cube root of any number with
+// i as its top bits.
+constexpr std::array<uint8_t, 64> kCubeRootTable = {
+    16, 21, 24, 26, 28, 30, 31, 32, 34, 35, 36, 37, 38, 39, 40, 41,
+    42, 42, 43, 44, 45, 45, 46, 47, 47, 48, 48, 49, 50, 50, 51, 51,
+    52, 52, 53, 53, 54, 54, 55, 55, 56, 56, 57, 57, 57, 58, 58, 59,
+    59, 59, 60, 60, 61, 61, 61, 62, 62, 62, 63, 63, 63, 64, 64, 64};
+
+// The cubic function is mss * 4 * t ^ 3 / 10 ^ 10 with t in ms.
+static_assert(kTimeScalingFactor == 0.4, "Fixed point Cubic scaling");
+constexpr uint64_t kCubicScaleNumerator = 4;
+constexpr uint64_t kCubicScaleDenominator = 10000000000;
+// Largest t whose cube fits in an int64_t.
+constexpr uint64_t kMaxCubicOffset = 2097151;
+} // namespace
+
+uint64_t cubeRoot(uint64_t value) noexcept {
+  if (value == 0) {
+    return 0;
+  }
+  // Take the top 4 to 6 bits, shifting by a multiple of 3 so that the shift
+  // divides evenly through the cube root.
+  auto bits = folly::findLastSet(value);
+  auto shift = bits > 6 ? (bits - 4) / 3 * 3 : 0;
+  auto top = value >> shift;
+  uint64_t root = ((uint64_t(kCubeRootTable[top]) << (shift / 3)) + 15) >> 4;
+  // Newton's method from above comes down to the floor of the root.
+  while (true) {
+    auto next = (2 * root + value / (root * root)) / 3;
+    if (next >= root) {
+      return root;
+    }
+    root = next;
+  }
+}
+
+uint64_t cubicTimeToOrigin(uint64_t bytesToOrigin, uint64_t mss) noexcept {
+  // 2500 = 1000 / kTimeScalingFactor, the cube of the ms is 1000 ^ 3.
+  constexpr uint64_t kMax = std::numeric_limits<uint64_t>::max();
+  if (bytesToOrigin > kMax / (1000 * 1000) ||
+      bytesToOrigin * 1000 * 1000 / mss > kMax / 2500) {
+    return cubeRoot(kMax);
+  }
+  return cubeRoot(bytesToOrigin * 1000 * 1000 / mss * 2500);
+}
+
+int64_t cubicCwndDelta(
+    uint64_t timeElapsed,
+    uint64_t timeToOrigin,
+    uint64_t mss) noexcept {
+  bool grow = timeElapsed >= timeToOrigin;
+  auto offset = grow ? timeElapsed - timeToOrigin : timeToOrigin - timeElapsed;
+  if (offset > kMaxCubicOffset) {
+    return grow ? std::numeric_limits<int64_t>::max()
+                : std::numeric_limits<int64_t>::min();
+  }
+  // Split the cube by the denominator, so that the product with the mss
+  // doesn't overflow.
+  auto cube = offset * offset * offset;
+  auto factor = mss * kCubicScaleNumerator;
+  auto remainder = (cube % kCubicScaleDenominator) * factor;
+  auto delta = (cube / kCubicScaleDenominator) * factor +
+      remainder / kCubicScaleDenominator;
+  if (grow) {
+    return static_cast<int64_t>(delta);
+  }
+  // The floor of a negative delta.
+  return -static_cast<int64_t>(
+      delta + (remainder % kCubicScaleDenominator ? 1 : 0));
+}
+
+} // namespace quic
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * Integer versions of the cubic function of Cubic's steady state, for the
+ * ack path. Times are in ms, like in the floating point math.
+ */
+
+// floor(cbrt(value)), from a table of cube roots and Newton's method.
+uint64_t cubeRoot(uint64_t value) noexcept;
+
+/**
+ * The time it takes the cubic function to grow from lastMaxCwnd -
+ * bytesToOrigin back to lastMaxCwnd, rounded down to the ms.
+ */
+uint64_t cubicTimeToOrigin(uint64_t bytesToOrigin, uint64_t mss) noexcept;
+
+/**
+ * floor(mss * kTimeScalingFactor * (timeElapsed - timeToOrigin) ^ 3) in
+ * bytes, saturated to the int64_t limits.
+ */
+int64_t cubicCwndDelta(
+    uint64_t timeElapsed,
+    uint64_t timeToOrigin,
+    uint64_t mss) noexcept;
+
+} // namespace quic
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/HystartPlusPlus.h>
+#include <quic/state/QuicStateFunctions.h>
+
+namespace quic {
+
+HystartPlusPlus::HystartPlusPlus(const QuicConnectionStateBase& conn)
+    : conn_(conn) {}
+
+HystartPlusPlus::Phase HystartPlusPlus::phase() const noexcept {
+  return phase_;
+}
+
+void HystartPlusPlus::startRound(TimePoint roundStart) noexcept {
+  windowEnd_ = roundStart;
+  lastRoundMinRtt_ = currentRoundMinRtt_;
+  currentRoundMinRtt_ = folly::none;
+  rttSampleCount_ = 0;
+}
+
+uint64_t HystartPlusPlus::onPacketAcked(
+    const CongestionController::AckEvent& ack) {
+  if (phase_ == Phase::Done) {
+    return 0;
+  }
+  if (!windowEnd_ || ack.largestAckedPacketSentTime > *windowEnd_) {
+    if (phase_ == Phase::ConservativeSlowStart &&
+        ++cssRounds_ >= kHystartCssRounds) {
+      VLOG(10) << __func__ << " exit slow start after conservative slow start "
+               << conn_;
+      phase_ = Phase::Done;
+      return 0;
+    }
+    startRound(ack.ackTime);
+  }
+  if (ack.mrttSample) {
+    auto rtt = *ack.mrttSample;
+    currentRoundMinRtt_ = std::min(currentRoundMinRtt_.value_or(rtt), rtt);
+    if (rttSampleCount_ < kHystartRttSamples) {
+      ++rttSampleCount_;
+    }
+  }
+  bool enoughSamples = rttSampleCount_ >= kHystartRttSamples &&
+      currentRoundMinRtt_.has_value();
+  if (phase_ == Phase::SlowStart && enoughSamples && lastRoundMinRtt_) {
+    auto rttThresh = std::max(
+        kHystartMinRttThresh,
+        std::min(
+            kHystartMaxRttThresh, *lastRoundMinRtt_ / kHystartMinRttDivisor));
+    if (*currentRoundMinRtt_ >= *lastRoundMinRtt_ + rttThresh) {
+      VLOG(10) << __func__ << " enter conservative slow start, minRtt="
+               << currentRoundMinRtt_->count()
+               << "us lastMinRtt=" << lastRoundMinRtt_->count() << "us "
+               << conn_;
+      cssBaselineMinRtt_ = currentRoundMinRtt_;
+      cssRounds_ = 0;
+      phase_ = Phase::ConservativeSlowStart;
+    }
+  } else if (
+      phase_ == Phase::ConservativeSlowStart && enoughSamples &&
+      *currentRoundMinRtt_ < *cssBaselineMinRtt_) {
+    VLOG(10) << __func__ << " rtt went back down, resume slow start " << conn_;
+    cssBaselineMinRtt_ = folly::none;
+    phase_ = Phase::SlowStart;
+  }
+  // Paced connections don't send the growth of an ack in a single burst.
+  uint64_t increase = ack.ackedBytes;
+  if (!isConnectionPaced(conn_)) {
+    increase = std::min(
+        increase, kHystartAckBurstLimitInMss * conn_.udpSendPacketLen);
+  }
+  return phase_ == Phase::ConservativeSlowStart
+      ? increase / kHystartCssGrowthDivisor
+      : increase;
+}
+
+folly::StringPiece hystartPhaseToString(HystartPlusPlus::Phase phase) {
+  switch (phase) {
+    case HystartPlusPlus::Phase::SlowStart:
+      return "SlowStart";
+    case HystartPlusPlus::Phase::ConservativeSlowStart:
+      return "ConservativeSlowStart";
+    case HystartPlusPlus::Phase::Done:
+      return "Done";
+  }
+  folly::assume_unreachable();
+}
+
+} // namespace quic
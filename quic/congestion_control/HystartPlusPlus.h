@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+// Bounds of the rtt increase that ends slow start
+constexpr std::chrono::microseconds kHystartMinRttThresh{4000};
+constexpr std::chrono::microseconds kHystartMaxRttThresh{16000};
+// The rtt increase that ends slow start is the last round's min rtt divided
+// by this, within the bounds above
+constexpr uint8_t kHystartMinRttDivisor = 8;
+// Rtt samples a round needs before its min rtt is compared
+constexpr uint8_t kHystartRttSamples = 8;
+// During conservative slow start the cwnd grows this many times slower
+constexpr uint8_t kHystartCssGrowthDivisor = 4;
+// Rounds of conservative slow start before slow start is over
+constexpr uint8_t kHystartCssRounds = 5;
+// Cap on the cwnd growth of a single ack of a connection that isn't paced
+constexpr uint64_t kHystartAckBurstLimitInMss = 8;
+
+/**
+ * HyStart++, after RFC 9406, for the window based controllers. It looks for
+ * the rtt increase of a filling queue, and then grows the cwnd a quarter as
+ * fast for a few rounds in conservative slow start before it ends slow start.
+ * If the rtt drops back during those rounds the increase was a false alarm,
+ * and it goes back to slow start.
+ *
+ * Rounds end with the ack of a packet sent after the ack that started the
+ * round. It only covers the first slow start of a connection, as the RFC
+ * recommends; once it is done the controller falls back to its own slow
+ * start logic.
+ */
+class HystartPlusPlus {
+ public:
+  enum class Phase : uint8_t {
+    SlowStart,
+    ConservativeSlowStart,
+    Done,
+  };
+
+  explicit HystartPlusPlus(const QuicConnectionStateBase& conn);
+
+  /**
+   * Returns the bytes the cwnd grows by for the ack. Slow start is over once
+   * phase() is Done after it returns, the caller then sets its ssthresh to
+   * the cwnd.
+   */
+  uint64_t onPacketAcked(const CongestionController::AckEvent& ack);
+
+  Phase phase() const noexcept;
+
+ private:
+  void startRound(TimePoint roundStart) noexcept;
+
+  const QuicConnectionStateBase& conn_;
+  Phase phase_{Phase::SlowStart};
+  // The round ends once a packet sent after this time is acked
+  folly::Optional<TimePoint> windowEnd_;
+  folly::Optional<std::chrono::microseconds> lastRoundMinRtt_;
+  folly::Optional<std::chrono::microseconds> currentRoundMinRtt_;
+  uint8_t rttSampleCount_{0};
+  // Min rtt of the round that started conservative slow start
+  folly::Optional<std::chrono::microseconds> cssBaselineMinRtt_;
+  uint8_t cssRounds_{0};
+};
+
+folly::StringPiece hystartPhaseToString(HystartPlusPlus::Phase phase);
+
+} // namespace quic
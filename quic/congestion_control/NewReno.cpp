@@ -17,12 +17,18 @@ constexpr int kRenoLossReductionFactorShift = 1;
 NewReno::NewReno(QuicConnectionStateBase& conn)
     : conn_(conn),
       ssthresh_(std::numeric_limits<uint32_t>::max()),
-      cwndBytes_(conn.transportSettings.initCwndInMss * conn.udpSendPacketLen) {
+      cwndBytes_(initialCwndBytes(conn)) {
   cwndBytes_ = boundedCwnd(
       cwndBytes_,
       conn_.udpSendPacketLen,
       conn_.transportSettings.maxCwndInMss,
       conn_.transportSettings.minCwndInMss);
+  if (conn_.transportSettings.hystartPlusPlus) {
+    hystart_.emplace(conn_);
+  }
+  if (conn_.carefulResume) {
+    carefulResume_.emplace(conn_, *conn_.carefulResume);
+  }
 }
 
 void NewReno::onRemoveBytesFromInflight(uint64_t bytes) {
@@ -58,8 +64,42 @@ void NewReno::onAckEvent(const AckEvent& ack) {
     conn_.qLogger->addCongestionMetricUpdate(
         bytesInFlight_, getCongestionWindow(), kCongestionPacketAck);
   }
-  for (const auto& packet : ack.ackedPackets) {
-    onPacketAcked(packet);
+  if (carefulResume_) {
+    auto cwnd = carefulResume_->onPacketAcked(ack, bytesInFlight_);
+    auto phase = carefulResume_->phase();
+    if (cwnd) {
+      cwndBytes_ = *cwnd;
+      VLOG(10) << __func__ << " careful resume phase="
+               << carefulResumePhaseToString(phase) << " cwnd=" << cwndBytes_
+               << " " << conn_;
+      if (conn_.qLogger) {
+        conn_.qLogger->addCongestionMetricUpdate(
+            bytesInFlight_,
+            getCongestionWindow(),
+            phase == CarefulResume::Phase::Unvalidated
+                ? kCarefulResumeJump
+                : kCarefulResumeValidate);
+      }
+    }
+    if (phase == CarefulResume::Phase::Normal) {
+      carefulResume_ = folly::none;
+    }
+  }
+  // The cwnd stays where careful resume put it until it is validated.
+  if (!carefulResume_ || !carefulResume_->holdsCwnd()) {
+    if (hystart_ && inSlowStart()) {
+      addAndCheckOverflow(cwndBytes_, hystart_->onPacketAcked(ack));
+      if (hystart_->phase() == HystartPlusPlus::Phase::Done) {
+        hystart_ = folly::none;
+        ssthresh_ = cwndBytes_;
+        VLOG(10) << __func__ << " exit slow start, ssthresh=" << ssthresh_
+                 << " " << conn_;
+      }
+    } else {
+      for (const auto& packet : ack.ackedPackets) {
+        onPacketAcked(packet);
+      }
+    }
   }
   cwndBytes_ = boundedCwnd(
       cwndBytes_,
@@ -105,13 +145,18 @@ void NewReno::onPacketLoss(const LossEvent& loss) {
       loss.largestLostSentTime.has_value());
   subtractAndCheckUnderflow(bytesInFlight_, loss.lostBytes);
   if (!endOfRecovery_ || *endOfRecovery_ < *loss.largestLostSentTime) {
-    endOfRecovery_ = Clock::now();
+    endOfRecovery_ = congestionControlNow(conn_);
+    lossCwndBytes_ = cwndBytes_;
+    lossSsthresh_ = ssthresh_;
+    // HyStart++ only runs the first slow start.
+    hystart_ = folly::none;
     cwndBytes_ = (cwndBytes_ >> kRenoLossReductionFactorShift);
     cwndBytes_ = boundedCwnd(
         cwndBytes_,
         conn_.udpSendPacketLen,
         conn_.transportSettings.maxCwndInMss,
         conn_.transportSettings.minCwndInMss);
+    carefulResumeRetreat(loss.lossTime);
     // This causes us to exit slow start.
     ssthresh_ = cwndBytes_;
     VLOG(10) << __func__ << " exit slow start, ssthresh=" << ssthresh_
@@ -137,6 +182,72 @@ void NewReno::onPacketLoss(const LossEvent& loss) {
           bytesInFlight_, getCongestionWindow(), kPersistentCongestion);
     }
     cwndBytes_ = conn_.transportSettings.minCwndInMss * conn_.udpSendPacketLen;
+    // Some of the losses being spurious doesn't make up for a whole window
+    // of them.
+    lossCwndBytes_ = folly::none;
+    lossSsthresh_ = folly::none;
+  }
+}
+
+void NewReno::carefulResumeRetreat(TimePoint eventTime) {
+  if (!carefulResume_) {
+    return;
+  }
+  auto cwnd = carefulResume_->onCongestionEvent(eventTime);
+  if (cwnd) {
+    cwndBytes_ = boundedCwnd(
+        std::min(cwndBytes_, *cwnd),
+        conn_.udpSendPacketLen,
+        conn_.transportSettings.maxCwndInMss,
+        conn_.transportSettings.minCwndInMss);
+    // The jump was wrong, there is nothing to undo if the loss was spurious.
+    lossCwndBytes_ = folly::none;
+    lossSsthresh_ = folly::none;
+    if (conn_.qLogger) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          bytesInFlight_, getCongestionWindow(), kCarefulResumeRetreat);
+    }
+  }
+  if (carefulResume_->phase() == CarefulResume::Phase::Normal) {
+    carefulResume_ = folly::none;
+  }
+}
+
+void NewReno::onSpuriousLoss() {
+  if (!lossCwndBytes_ || !lossSsthresh_) {
+    return;
+  }
+  cwndBytes_ = std::max(cwndBytes_, *lossCwndBytes_);
+  ssthresh_ = *lossSsthresh_;
+  lossCwndBytes_ = folly::none;
+  lossSsthresh_ = folly::none;
+  endOfRecovery_ = folly::none;
+  VLOG(10) << __func__ << " undo loss reduction, cwnd=" << cwndBytes_
+           << " ssthresh=" << ssthresh_ << " inflight=" << bytesInFlight_
+           << " " << conn_;
+}
+
+void NewReno::onEcnCongestionEvent(TimePoint sentTime) {
+  if (endOfRecovery_ && sentTime < *endOfRecovery_) {
+    return;
+  }
+  endOfRecovery_ = congestionControlNow(conn_);
+  // Unlike a loss, a CE mark can't turn out to be spurious.
+  lossCwndBytes_ = folly::none;
+  lossSsthresh_ = folly::none;
+  hystart_ = folly::none;
+  cwndBytes_ = boundedCwnd(
+      cwndBytes_ >> kRenoLossReductionFactorShift,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  carefulResumeRetreat(*endOfRecovery_);
+  ssthresh_ = cwndBytes_;
+  VLOG(10) << __func__ << " ssthresh=" << ssthresh_ << " cwnd=" << cwndBytes_
+           << " inflight=" << bytesInFlight_ << " " << conn_;
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        bytesInFlight_, getCongestionWindow(), kCongestionEcn);
   }
 }
 
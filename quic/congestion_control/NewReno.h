@@ -9,6 +9,8 @@
 #pragma once
 
 #include <quic/QuicException.h>
+#include <quic/congestion_control/CarefulResume.h>
+#include <quic/congestion_control/HystartPlusPlus.h>
 #include <quic/state/StateData.h>
 
 #include <limits>
@@ -22,6 +24,8 @@ class NewReno : public CongestionController {
   void onPacketSent(const OutstandingPacket& packet) override;
   void onPacketAckOrLoss(folly::Optional<AckEvent>, folly::Optional<LossEvent>)
       override;
+  void onSpuriousLoss() override;
+  void onEcnCongestionEvent(TimePoint sentTime) override;
 
   uint64_t getWritableBytes() const noexcept override;
   uint64_t getCongestionWindow() const noexcept override;
@@ -40,6 +44,7 @@ class NewReno : public CongestionController {
   void onPacketLoss(const LossEvent&);
   void onAckEvent(const AckEvent&);
   void onPacketAcked(const CongestionController::AckEvent::AckPacket&);
+  void carefulResumeRetreat(TimePoint eventTime);
 
  private:
   QuicConnectionStateBase& conn_;
@@ -47,5 +52,14 @@ class NewReno : public CongestionController {
   uint64_t ssthresh_;
   uint64_t cwndBytes_;
   folly::Optional<TimePoint> endOfRecovery_;
+  // cwndBytes_ and ssthresh_ before the last loss reduction, to undo it if
+  // the loss turns out to be spurious.
+  folly::Optional<uint64_t> lossCwndBytes_;
+  folly::Optional<uint64_t> lossSsthresh_;
+  // Only set when transportSettings.hystartPlusPlus is
+  folly::Optional<HystartPlusPlus> hystart_;
+  // Only set on resumed connections with conn.carefulResume, until the cwnd
+  // it jumped to is validated or retreated from.
+  folly::Optional<CarefulResume> carefulResume_;
 };
 } // namespace quic
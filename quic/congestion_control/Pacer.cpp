@@ -9,6 +9,8 @@
 #include <quic/congestion_control/Pacer.h>
 
 #include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/congestion_control/PacingAccuracyObserver.h>
+#include <quic/congestion_control/TokenBucketPacer.h>
 #include <quic/logging/QuicLogger.h>
 
 namespace quic {
@@ -92,6 +94,14 @@ uint64_t DefaultPacer::updateAndGetWriteBatchSize(TimePoint currentTime) {
   return tokens_;
 }
 
+std::chrono::nanoseconds DefaultPacer::getPacketInterval() const {
+  if (appLimited_ || writeInterval_ == 0us || batchSize_ == 0) {
+    return 0ns;
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(writeInterval_) /
+      batchSize_;
+}
+
 uint64_t DefaultPacer::getCachedWriteBatchSize() const {
   return cachedBatchSize_;
 }
@@ -105,4 +115,16 @@ void DefaultPacer::setAppLimited(bool limited) {
   appLimited_ = limited;
 }
 
+std::unique_ptr<Pacer> makePacer(
+    const QuicConnectionStateBase& conn,
+    uint64_t minCwndInMss) {
+  std::unique_ptr<Pacer> pacer;
+  if (conn.transportSettings.tokenBucketPacing) {
+    pacer = std::make_unique<TokenBucketPacer>(conn);
+  } else {
+    pacer = std::make_unique<DefaultPacer>(conn, minCwndInMss);
+  }
+  return maybeObservePacer(conn, std::move(pacer));
+}
+
 } // namespace quic
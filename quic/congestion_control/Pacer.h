@@ -37,6 +37,8 @@ class DefaultPacer : public Pacer {
 
   uint64_t updateAndGetWriteBatchSize(TimePoint currentTime) override;
 
+  std::chrono::nanoseconds getPacketInterval() const override;
+
   void setPacingRateCalculator(PacingRateCalculator pacingRateCalculator);
 
   uint64_t getCachedWriteBatchSize() const override;
@@ -57,4 +59,11 @@ class DefaultPacer : public Pacer {
   bool appLimited_{false};
   uint64_t tokens_;
 };
+
+/**
+ * The pacer the connection's transport settings ask for.
+ */
+std::unique_ptr<Pacer> makePacer(
+    const QuicConnectionStateBase& conn,
+    uint64_t minCwndInMss);
 } // namespace quic
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/PacingAccuracyObserver.h>
+
+#include <folly/Random.h>
+
+#include <algorithm>
+
+namespace quic {
+
+PacingAccuracyObserver::PacingAccuracyObserver(
+    const QuicConnectionStateBase& conn,
+    std::unique_ptr<Pacer> pacer,
+    NowFn now)
+    : conn_(conn),
+      pacer_(std::move(pacer)),
+      now_(now),
+      intervalStart_(now_()),
+      lastUpdate_(intervalStart_) {
+  CHECK(pacer_);
+}
+
+void PacingAccuracyObserver::refreshPacingRate(
+    uint64_t cwndBytes,
+    std::chrono::microseconds rtt) {
+  advance(now_());
+  pacer_->refreshPacingRate(cwndBytes, rtt);
+  packetInterval_ = pacer_->getPacketInterval();
+}
+
+void PacingAccuracyObserver::onPacedWriteScheduled(TimePoint currentTime) {
+  pacer_->onPacedWriteScheduled(currentTime);
+}
+
+std::chrono::microseconds PacingAccuracyObserver::getTimeUntilNextWrite()
+    const {
+  return pacer_->getTimeUntilNextWrite();
+}
+
+uint64_t PacingAccuracyObserver::updateAndGetWriteBatchSize(
+    TimePoint currentTime) {
+  return pacer_->updateAndGetWriteBatchSize(currentTime);
+}
+
+std::chrono::nanoseconds PacingAccuracyObserver::getPacketInterval() const {
+  return pacer_->getPacketInterval();
+}
+
+uint64_t PacingAccuracyObserver::getCachedWriteBatchSize() const {
+  return pacer_->getCachedWriteBatchSize();
+}
+
+void PacingAccuracyObserver::setAppLimited(bool limited) {
+  advance(now_());
+  pacer_->setAppLimited(limited);
+  packetInterval_ = pacer_->getPacketInterval();
+}
+
+void PacingAccuracyObserver::onPacketSent() {
+  auto now = now_();
+  advance(now);
+  pacer_->onPacketSent();
+  ++packetsSent_;
+  if (lastSentTime_ &&
+      now - *lastSentTime_ < conn_.transportSettings.pacingTimerTickInterval) {
+    ++burst_;
+  } else {
+    burst_ = 1;
+  }
+  largestBurst_ = std::max(largestBurst_, burst_);
+  lastSentTime_ = now;
+}
+
+void PacingAccuracyObserver::onPacketsLoss() {
+  pacer_->onPacketsLoss();
+}
+
+QuicTransportStatsCallback::PacingRateError PacingAccuracyObserver::rateError(
+    uint64_t packetsSent,
+    double expectedPackets) {
+  using PacingRateError = QuicTransportStatsCallback::PacingRateError;
+  double ratio = packetsSent / expectedPackets;
+  if (ratio < 0.5) {
+    return PacingRateError::FAR_BELOW;
+  } else if (ratio < 0.9) {
+    return PacingRateError::BELOW;
+  } else if (ratio <= 1.1) {
+    return PacingRateError::ON_RATE;
+  } else if (ratio <= 1.5) {
+    return PacingRateError::ABOVE;
+  }
+  return PacingRateError::FAR_ABOVE;
+}
+
+void PacingAccuracyObserver::advance(TimePoint now) {
+  if (now > lastUpdate_) {
+    if (packetInterval_ > 0ns) {
+      expectedPackets_ += (now - lastUpdate_) * 1.0 / packetInterval_;
+    } else {
+      unpaced_ = true;
+    }
+    lastUpdate_ = now;
+  }
+  if (now - intervalStart_ < conn_.transportSettings.pacingObserverInterval) {
+    return;
+  }
+  // Less than a packet's worth of pacing says nothing about its accuracy.
+  if (!unpaced_ && expectedPackets_ >= 1) {
+    QUIC_STATS(
+        conn_.infoCallback,
+        onPacingInterval,
+        rateError(packetsSent_, expectedPackets_),
+        largestBurst_);
+  }
+  intervalStart_ = now;
+  expectedPackets_ = 0;
+  packetsSent_ = 0;
+  unpaced_ = false;
+  largestBurst_ = 0;
+}
+
+std::unique_ptr<Pacer> maybeObservePacer(
+    const QuicConnectionStateBase& conn,
+    std::unique_ptr<Pacer> pacer) {
+  auto sampleRate = conn.transportSettings.pacingObserverSampleRate;
+  if (sampleRate == 0 || !folly::Random::oneIn(sampleRate)) {
+    return pacer;
+  }
+  return std::make_unique<PacingAccuracyObserver>(conn, std::move(pacer));
+}
+
+} // namespace quic
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/QuicTransportStatsCallback.h>
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+/**
+ * A Pacer that passes everything on to the pacer it wraps and watches how the
+ * connection's send rate holds up against the pacing rate. Over every
+ * pacingObserverInterval it compares the packets sent to the ones the pacing
+ * rates of the interval allowed, and reports how far off they were, along
+ * with the largest burst of the interval, to the stats callback. A burst is
+ * the packets sent less than a pacing timer tick apart. Intervals during
+ * which the connection was app limited, or not paced, aren't reported.
+ *
+ * It costs a clock read per packet sent, so it is meant for a sample of the
+ * connections, see TransportSettings::pacingObserverSampleRate. With
+ * txTimePacing the packets leave when the kernel sends them, what is measured
+ * is when they are handed to it.
+ */
+class PacingAccuracyObserver : public Pacer {
+ public:
+  using NowFn = TimePoint (*)();
+
+  PacingAccuracyObserver(
+      const QuicConnectionStateBase& conn,
+      std::unique_ptr<Pacer> pacer,
+      NowFn now = Clock::now);
+
+  void refreshPacingRate(uint64_t cwndBytes, std::chrono::microseconds rtt)
+      override;
+
+  void onPacedWriteScheduled(TimePoint currentTime) override;
+
+  std::chrono::microseconds getTimeUntilNextWrite() const override;
+
+  uint64_t updateAndGetWriteBatchSize(TimePoint currentTime) override;
+
+  std::chrono::nanoseconds getPacketInterval() const override;
+
+  uint64_t getCachedWriteBatchSize() const override;
+
+  void setAppLimited(bool limited) override;
+
+  void onPacketSent() override;
+  void onPacketsLoss() override;
+
+  static QuicTransportStatsCallback::PacingRateError rateError(
+      uint64_t packetsSent,
+      double expectedPackets);
+
+ private:
+  // Accounts for the time since the last event at the current pacing rate,
+  // and reports the interval if it is over.
+  void advance(TimePoint now);
+
+  const QuicConnectionStateBase& conn_;
+  std::unique_ptr<Pacer> pacer_;
+  NowFn now_;
+  TimePoint intervalStart_;
+  TimePoint lastUpdate_;
+  // The pacer's packet interval, 0 while not paced
+  std::chrono::nanoseconds packetInterval_{0};
+  double expectedPackets_{0};
+  uint64_t packetsSent_{0};
+  // Whether the interval had a time without pacing
+  bool unpaced_{false};
+  folly::Optional<TimePoint> lastSentTime_;
+  uint64_t burst_{0};
+  uint64_t largestBurst_{0};
+};
+
+/**
+ * Wraps the pacer of one in pacingObserverSampleRate connections in a
+ * PacingAccuracyObserver.
+ */
+std::unique_ptr<Pacer> maybeObservePacer(
+    const QuicConnectionStateBase& conn,
+    std::unique_ptr<Pacer> pacer);
+
+} // namespace quic
@@ -8,6 +8,7 @@
 
 #include <quic/congestion_control/QuicCubic.h>
 #include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/congestion_control/CubicFixedPoint.h>
 #include <quic/logging/QLoggerConstants.h>
 #include <quic/state/QuicStateFunctions.h>
 
@@ -25,10 +26,17 @@ Cubic::Cubic(
       spreadAcrossRtt_(spreadAcrossRtt) {
   cwndBytes_ = std::min(
       conn.transportSettings.maxCwndInMss * conn.udpSendPacketLen,
-      conn.transportSettings.initCwndInMss * conn.udpSendPacketLen);
+      initialCwndBytes(conn));
   steadyState_.tcpFriendly = tcpFriendly;
   steadyState_.estRenoCwnd = cwndBytes_;
   hystartState_.ackTrain = ackTrain;
+  if (conn.transportSettings.hystartPlusPlus) {
+    hystartPlusPlus_.emplace(conn);
+  }
+  if (conn.carefulResume) {
+    carefulResume_.emplace(conn, *conn.carefulResume);
+  }
+  fixedPoint_ = conn.transportSettings.cubicFixedPoint;
   QUIC_TRACE(initcwnd, conn_, cwndBytes_);
 }
 
@@ -60,6 +68,8 @@ void Cubic::onPersistentCongestion() {
   }
   steadyState_.lastReductionTime = folly::none;
   steadyState_.lastMaxCwndBytes = folly::none;
+  lossCwndBytes_ = folly::none;
+  lossSsthresh_ = folly::none;
   quiescenceStart_ = folly::none;
   hystartState_.found = Cubic::HystartFound::No;
   hystartState_.inRttRound = false;
@@ -78,7 +88,7 @@ void Cubic::onPersistentCongestion() {
         inflightBytes_,
         getCongestionWindow(),
         kPersistentCongestion,
-        cubicStateToString(state_).str());
+        cubicStateToString(state_));
   }
 }
 
@@ -92,6 +102,62 @@ void Cubic::onPacketSent(const OutstandingPacket& packet) {
   inflightBytes_ += packet.encodedSize;
 }
 
+void Cubic::onSpuriousLoss() {
+  if (!lossCwndBytes_ || !lossSsthresh_) {
+    return;
+  }
+  cwndBytes_ = std::max(cwndBytes_, *lossCwndBytes_);
+  ssthresh_ = *lossSsthresh_;
+  if (steadyState_.tcpFriendly) {
+    steadyState_.estRenoCwnd = cwndBytes_;
+  }
+  lossCwndBytes_ = folly::none;
+  lossSsthresh_ = folly::none;
+  recoveryState_.endOfRecovery = folly::none;
+  if (state_ == CubicStates::FastRecovery) {
+    state_ = CubicStates::Steady;
+  }
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(
+        cwndBytes_ * pacingGain(), conn_.lossState.srtt);
+  }
+  VLOG(10) << __func__ << " undo loss reduction, cwnd=" << cwndBytes_
+           << " ssthresh=" << ssthresh_ << " inflight=" << inflightBytes_
+           << " " << conn_;
+}
+
+void Cubic::onEcnCongestionEvent(TimePoint sentTime) {
+  quiescenceStart_ = folly::none;
+  // Marks on packets sent before the current recovery period started were
+  // already reacted to.
+  if (sentTime < recoveryState_.endOfRecovery.value_or(sentTime)) {
+    return;
+  }
+  auto now = congestionControlNow(conn_);
+  recoveryState_.endOfRecovery = now;
+  cubicReduction(now);
+  // Unlike a loss, a CE mark can't turn out to be spurious.
+  lossCwndBytes_ = folly::none;
+  lossSsthresh_ = folly::none;
+  hystartPlusPlus_ = folly::none;
+  carefulResumeRetreat(now);
+  if (state_ == CubicStates::Hystart || state_ == CubicStates::Steady) {
+    state_ = CubicStates::FastRecovery;
+  }
+  ssthresh_ = cwndBytes_;
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(
+        cwndBytes_ * pacingGain(), conn_.lossState.srtt);
+  }
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionEcn,
+        cubicStateToString(state_));
+  }
+}
+
 void Cubic::onPacketLoss(const LossEvent& loss) {
   quiescenceStart_ = folly::none;
   DCHECK(
@@ -103,8 +169,10 @@ void Cubic::onPacketLoss(const LossEvent& loss) {
   // as it was already accounted for in a recovery period.
   if (*loss.largestLostSentTime >=
       recoveryState_.endOfRecovery.value_or(*loss.largestLostSentTime)) {
-    recoveryState_.endOfRecovery = Clock::now();
+    recoveryState_.endOfRecovery = congestionControlNow(conn_);
     cubicReduction(loss.lossTime);
+    hystartPlusPlus_ = folly::none;
+    carefulResumeRetreat(loss.lossTime);
     if (state_ == CubicStates::Hystart || state_ == CubicStates::Steady) {
       state_ = CubicStates::FastRecovery;
     }
@@ -125,7 +193,7 @@ void Cubic::onPacketLoss(const LossEvent& loss) {
           inflightBytes_,
           getCongestionWindow(),
           kCubicLoss,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
 
   } else {
@@ -135,7 +203,7 @@ void Cubic::onPacketLoss(const LossEvent& loss) {
           inflightBytes_,
           getCongestionWindow(),
           kCubicSkipLoss,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
   }
 
@@ -159,7 +227,7 @@ void Cubic::onRemoveBytesFromInflight(uint64_t bytes) {
         inflightBytes_,
         getCongestionWindow(),
         kRemoveInflight,
-        cubicStateToString(state_).str());
+        cubicStateToString(state_));
   }
 }
 
@@ -241,7 +309,11 @@ void Cubic::updateTimeToOrigin() noexcept {
    */
   // 2500 = kTimeScalingFactor * 1000
   auto bytesToOrigin = *steadyState_.lastMaxCwndBytes - cwndBytes_;
-  if (bytesToOrigin * 1000 * 1000 / conn_.udpSendPacketLen * 2500 >
+  if (fixedPoint_) {
+    steadyState_.timeToOrigin = static_cast<double>(
+        cubicTimeToOrigin(bytesToOrigin, conn_.udpSendPacketLen));
+  } else if (
+      bytesToOrigin * 1000 * 1000 / conn_.udpSendPacketLen * 2500 >
       std::numeric_limits<double>::max()) {
     LOG(WARNING) << "Quic Cubic: timeToOrigin calculation overflow";
     steadyState_.timeToOrigin = std::numeric_limits<double>::max();
@@ -262,7 +334,12 @@ int64_t Cubic::calculateCubicCwndDelta(TimePoint ackTime) noexcept {
       ackTime - *steadyState_.lastReductionTime);
   int64_t delta = 0;
   double timeElapsedCount = static_cast<double>(timeElapsed.count());
-  if (std::pow((timeElapsedCount - steadyState_.timeToOrigin), 3) >
+  if (fixedPoint_) {
+    delta = cubicCwndDelta(
+        timeElapsed.count(),
+        static_cast<uint64_t>(steadyState_.timeToOrigin),
+        conn_.udpSendPacketLen);
+  } else if (std::pow((timeElapsedCount - steadyState_.timeToOrigin), 3) >
       std::numeric_limits<double>::max()) {
     // (timeElapsed - timeToOrigin) ^ 3 will overflow/underflow, cut delta
     // to numeric_limit
@@ -293,7 +370,7 @@ int64_t Cubic::calculateCubicCwndDelta(TimePoint ackTime) noexcept {
         inflightBytes_,
         getCongestionWindow(),
         kCubicSteadyCwnd,
-        cubicStateToString(state_).str());
+        cubicStateToString(state_));
   }
   return delta;
 }
@@ -373,20 +450,25 @@ void Cubic::onPacketAcked(const AckEvent& ack) {
           inflightBytes_,
           getCongestionWindow(),
           kCubicSkipAck,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
     return;
   }
-  switch (state_) {
-    case CubicStates::Hystart:
-      onPacketAckedInHystart(ack);
-      break;
-    case CubicStates::Steady:
-      onPacketAckedInSteady(ack);
-      break;
-    case CubicStates::FastRecovery:
-      onPacketAckedInRecovery(ack);
-      break;
+  if (carefulResume_) {
+    onPacketAckedInCarefulResume(ack);
+  }
+  if (!carefulResume_ || !carefulResume_->holdsCwnd()) {
+    switch (state_) {
+      case CubicStates::Hystart:
+        onPacketAckedInHystart(ack);
+        break;
+      case CubicStates::Steady:
+        onPacketAckedInSteady(ack);
+        break;
+      case CubicStates::FastRecovery:
+        onPacketAckedInRecovery(ack);
+        break;
+    }
   }
   if (conn_.pacer) {
     conn_.pacer->refreshPacingRate(
@@ -400,7 +482,7 @@ void Cubic::onPacketAcked(const AckEvent& ack) {
           inflightBytes_,
           getCongestionWindow(),
           kCwndNoChange,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
   }
   QUIC_TRACE(
@@ -415,7 +497,7 @@ void Cubic::onPacketAcked(const AckEvent& ack) {
         inflightBytes_,
         getCongestionWindow(),
         kCongestionPacketAck,
-        cubicStateToString(state_).str());
+        cubicStateToString(state_));
   }
 }
 
@@ -425,7 +507,7 @@ void Cubic::startHystartRttRound(TimePoint time) noexcept {
   hystartState_.ackCount = 0;
   hystartState_.lastSampledRtt = hystartState_.currSampledRtt;
   hystartState_.currSampledRtt = folly::none;
-  hystartState_.rttRoundEndTarget = Clock::now();
+  hystartState_.rttRoundEndTarget = congestionControlNow(conn_);
   hystartState_.inRttRound = true;
   hystartState_.found = HystartFound::No;
 }
@@ -476,7 +558,99 @@ float Cubic::pacingGain() const noexcept {
   return pacingGain;
 }
 
+void Cubic::exitHystart() noexcept {
+  hystartState_.inRttRound = false;
+  hystartPlusPlus_ = folly::none;
+  ssthresh_ = cwndBytes_;
+  /* Now we exit slow start, reset currSampledRtt to be maximal value so
+   * that next time we go back to slow start, we won't be using a very old
+   * sampled RTT as the lastSampledRtt:
+   */
+  hystartState_.currSampledRtt = folly::none;
+  steadyState_.lastMaxCwndBytes = folly::none;
+  steadyState_.lastReductionTime = folly::none;
+  quiescenceStart_ = folly::none;
+  state_ = CubicStates::Steady;
+}
+
+void Cubic::onPacketAckedInHystartPlusPlus(const AckEvent& ack) {
+  auto increase = hystartPlusPlus_->onPacketAcked(ack);
+  if (std::numeric_limits<decltype(cwndBytes_)>::max() - cwndBytes_ <
+      increase) {
+    throw QuicInternalException(
+        "Cubic Hystart: cwnd overflow", LocalErrorCode::CWND_OVERFLOW);
+  }
+  cwndBytes_ = boundedCwnd(
+      cwndBytes_ + increase,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  if (hystartPlusPlus_->phase() == HystartPlusPlus::Phase::Done ||
+      cwndBytes_ >= ssthresh_) {
+    VLOG(15) << "Cubic exit slow start, HyStart++ phase="
+             << hystartPhaseToString(hystartPlusPlus_->phase());
+    exitHystart();
+  }
+}
+
+void Cubic::onPacketAckedInCarefulResume(const AckEvent& ack) {
+  auto cwnd = carefulResume_->onPacketAcked(ack, inflightBytes_);
+  auto phase = carefulResume_->phase();
+  if (cwnd) {
+    cwndBytes_ = boundedCwnd(
+        *cwnd,
+        conn_.udpSendPacketLen,
+        conn_.transportSettings.maxCwndInMss,
+        conn_.transportSettings.minCwndInMss);
+    if (steadyState_.tcpFriendly) {
+      steadyState_.estRenoCwnd = cwndBytes_;
+    }
+    if (conn_.qLogger) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          inflightBytes_,
+          getCongestionWindow(),
+          phase == CarefulResume::Phase::Unvalidated ? kCarefulResumeJump
+                                                     : kCarefulResumeValidate,
+          cubicStateToString(state_));
+    }
+  }
+  if (phase == CarefulResume::Phase::Normal) {
+    carefulResume_ = folly::none;
+  }
+}
+
+void Cubic::carefulResumeRetreat(TimePoint eventTime) {
+  if (!carefulResume_) {
+    return;
+  }
+  auto cwnd = carefulResume_->onCongestionEvent(eventTime);
+  if (cwnd) {
+    cwndBytes_ = boundedCwnd(
+        std::min(cwndBytes_, *cwnd),
+        conn_.udpSendPacketLen,
+        conn_.transportSettings.maxCwndInMss,
+        conn_.transportSettings.minCwndInMss);
+    // The jump was wrong, there is nothing to undo if the loss was spurious.
+    lossCwndBytes_ = folly::none;
+    lossSsthresh_ = folly::none;
+    if (conn_.qLogger) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          inflightBytes_,
+          getCongestionWindow(),
+          kCarefulResumeRetreat,
+          cubicStateToString(state_));
+    }
+  }
+  if (carefulResume_->phase() == CarefulResume::Phase::Normal) {
+    carefulResume_ = folly::none;
+  }
+}
+
 void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
+  if (hystartPlusPlus_) {
+    onPacketAckedInHystartPlusPlus(ack);
+    return;
+  }
   if (!hystartState_.inRttRound) {
     startHystartRttRound(ack.ackTime);
   }
@@ -508,17 +682,7 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
                << (*exitReason == Cubic::ExitReason::SSTHRESH
                        ? "cwnd > ssthresh"
                        : "found exit point");
-      hystartState_.inRttRound = false;
-      ssthresh_ = cwndBytes_;
-      /* Now we exit slow start, reset currSampledRtt to be maximal value so
-       * that next time we go back to slow start, we won't be using a very old
-       * sampled RTT as the lastSampledRtt:
-       */
-      hystartState_.currSampledRtt = folly::none;
-      steadyState_.lastMaxCwndBytes = folly::none;
-      steadyState_.lastReductionTime = folly::none;
-      quiescenceStart_ = folly::none;
-      state_ = CubicStates::Steady;
+      exitHystart();
     } else {
       // No exit yet, but we may still need to end this RTT round
       VLOG(20) << "Cubic Hystart, mayEndHystartRttRound, largestAckedPacketNum="
@@ -623,7 +787,7 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
           inflightBytes_,
           getCongestionWindow(),
           kAckInQuiescence,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
     return;
   }
@@ -644,7 +808,7 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
           inflightBytes_,
           getCongestionWindow(),
           kResetTimeToOrigin,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
     steadyState_.timeToOrigin = 0.0;
     steadyState_.lastMaxCwndBytes = cwndBytes_;
@@ -665,7 +829,7 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
           inflightBytes_,
           getCongestionWindow(),
           kResetLastReductionTime,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
   }
   uint64_t newCwnd = calculateCubicCwnd(calculateCubicCwndDelta(ack.ackTime));
@@ -695,7 +859,7 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
           inflightBytes_,
           getCongestionWindow(),
           kRenoCwndEstimation,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
   }
 }
@@ -721,7 +885,7 @@ void Cubic::onPacketAckedInRecovery(const AckEvent& ack) {
           inflightBytes_,
           getCongestionWindow(),
           kPacketAckedInRecovery,
-          cubicStateToString(state_).str());
+          cubicStateToString(state_));
     }
   }
 }
@@ -9,7 +9,9 @@
 #pragma once
 
 #include <quic/QuicException.h>
+#include <quic/congestion_control/CarefulResume.h>
 #include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/congestion_control/HystartPlusPlus.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/state/StateData.h>
 
@@ -92,6 +94,8 @@ class Cubic : public CongestionController {
       override;
   void onRemoveBytesFromInflight(uint64_t) override;
   void onPacketSent(const OutstandingPacket& packet) override;
+  void onSpuriousLoss() override;
+  void onEcnCongestionEvent(TimePoint sentTime) override;
 
   uint64_t getWritableBytes() const noexcept override;
   uint64_t getCongestionWindow() const noexcept override;
@@ -109,6 +113,10 @@ class Cubic : public CongestionController {
   bool isAppIdle() const noexcept;
   void onPacketAcked(const AckEvent& ack);
   void onPacketAckedInHystart(const AckEvent& ack);
+  void onPacketAckedInHystartPlusPlus(const AckEvent& ack);
+  void onPacketAckedInCarefulResume(const AckEvent& ack);
+  void carefulResumeRetreat(TimePoint eventTime);
+  void exitHystart() noexcept;
   void onPacketAckedInSteady(const AckEvent& ack);
   void onPacketAckedInRecovery(const AckEvent& ack);
 
@@ -187,6 +195,12 @@ class Cubic : public CongestionController {
   folly::Optional<TimePoint> quiescenceStart_;
 
   HystartState hystartState_;
+  // Replaces the hystart above in the first slow start when
+  // transportSettings.hystartPlusPlus is set.
+  folly::Optional<HystartPlusPlus> hystartPlusPlus_;
+  // Only set on resumed connections with conn.carefulResume, until the cwnd
+  // it jumped to is validated or retreated from.
+  folly::Optional<CarefulResume> carefulResume_;
   SteadyState steadyState_;
   RecoveryState recoveryState_;
 
@@ -194,6 +208,8 @@ class Cubic : public CongestionController {
   // evenly across an RTT. Otherwise, we will use the first N number of pacing
   // intervals to send all N bursts.
   bool spreadAcrossRtt_{false};
+  // Use the integer cubic function of CubicFixedPoint.h in the steady state.
+  bool fixedPoint_{false};
 };
 
 folly::StringPiece cubicStateToString(CubicStates state);
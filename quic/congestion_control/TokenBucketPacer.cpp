@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/TokenBucketPacer.h>
+
+#include <quic/logging/QuicLogger.h>
+
+#include <cmath>
+
+namespace quic {
+
+TokenBucketPacer::TokenBucketPacer(const QuicConnectionStateBase& conn)
+    : conn_(conn),
+      cachedBatchSize_(conn.transportSettings.writeConnectionDataPacketsLimit) {
+}
+
+void TokenBucketPacer::refreshPacingRate(
+    uint64_t cwndBytes,
+    std::chrono::microseconds rtt) {
+  if (rtt == 0us || cwndBytes == 0) {
+    bytesPerSecond_ = 0;
+    cachedBatchSize_ = conn_.transportSettings.writeConnectionDataPacketsLimit;
+    return;
+  }
+  bytesPerSecond_ = cwndBytes * 1000000.0 / rtt.count();
+  credit_ = std::min(credit_, bucketBytes());
+  cachedBatchSize_ = burstBytes() / conn_.udpSendPacketLen;
+  auto burstInterval = std::chrono::microseconds(
+      static_cast<uint64_t>(burstBytes() * 1000000 / bytesPerSecond_));
+  if (conn_.qLogger) {
+    conn_.qLogger->addPacingMetricUpdate(cachedBatchSize_, burstInterval);
+  }
+  QUIC_TRACE(
+      pacing_update, conn_, burstInterval.count(), (uint64_t)cachedBatchSize_);
+}
+
+void TokenBucketPacer::onPacedWriteScheduled(TimePoint /* currentTime */) {
+  // The refill looks at the time of the write itself, so a late timer only
+  // makes for a bigger one.
+}
+
+std::chrono::microseconds TokenBucketPacer::getTimeUntilNextWrite() const {
+  if (appLimited_ || bytesPerSecond_ == 0 || credit_ >= burstBytes()) {
+    return 0us;
+  }
+  // Rounded up, and never 0 so that the write loop doesn't spin on a bucket
+  // that isn't full yet.
+  auto wait = std::ceil((burstBytes() - credit_) * 1000000 / bytesPerSecond_);
+  return std::chrono::microseconds(
+      std::max<uint64_t>(1, static_cast<uint64_t>(wait)));
+}
+
+uint64_t TokenBucketPacer::updateAndGetWriteBatchSize(TimePoint currentTime) {
+  if (appLimited_ || bytesPerSecond_ == 0) {
+    lastRefillTime_.reset();
+    return conn_.transportSettings.writeConnectionDataPacketsLimit;
+  }
+  if (!lastRefillTime_) {
+    // A full bucket to start with, or after being app limited.
+    credit_ = std::max(credit_, bucketBytes());
+  } else if (currentTime > *lastRefillTime_) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        currentTime - *lastRefillTime_);
+    credit_ = std::min(
+        credit_ + bytesPerSecond_ * elapsed.count() / 1000000000,
+        bucketBytes());
+  }
+  if (!lastRefillTime_ || currentTime > *lastRefillTime_) {
+    lastRefillTime_ = currentTime;
+  }
+  if (credit_ < conn_.udpSendPacketLen) {
+    return 0;
+  }
+  return static_cast<uint64_t>(credit_ / conn_.udpSendPacketLen);
+}
+
+std::chrono::nanoseconds TokenBucketPacer::getPacketInterval() const {
+  if (appLimited_ || bytesPerSecond_ == 0) {
+    return 0ns;
+  }
+  return std::chrono::nanoseconds(static_cast<uint64_t>(
+      conn_.udpSendPacketLen * 1000000000.0 / bytesPerSecond_));
+}
+
+uint64_t TokenBucketPacer::getCachedWriteBatchSize() const {
+  return cachedBatchSize_;
+}
+
+void TokenBucketPacer::setAppLimited(bool limited) {
+  appLimited_ = limited;
+}
+
+void TokenBucketPacer::onPacketSent() {
+  credit_ -= conn_.udpSendPacketLen;
+}
+
+void TokenBucketPacer::onPacketsLoss() {
+  credit_ = std::min(credit_, 0.0);
+}
+
+double TokenBucketPacer::getPacingRate() const noexcept {
+  return bytesPerSecond_;
+}
+
+uint64_t TokenBucketPacer::burstBytes() const noexcept {
+  return std::max<uint64_t>(1, conn_.transportSettings.minBurstPackets) *
+      conn_.udpSendPacketLen;
+}
+
+double TokenBucketPacer::bucketBytes() const noexcept {
+  auto tick = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      conn_.transportSettings.pacingTimerTickInterval);
+  return std::max<double>(
+      burstBytes(), bytesPerSecond_ * tick.count() / 1000000000);
+}
+
+} // namespace quic
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+/**
+ * Paces at cwnd / rtt with a token bucket of bytes. The credit is refilled
+ * from the time that actually passed between writes, fractions of a byte
+ * included, so late pacing timers don't lower the rate and rates far above
+ * what one packet per timer tick gives are still paced.
+ *
+ * Writes go out in bursts of minBurstPackets, which is also the write batch
+ * size, so with GSO every burst is one send. The bucket holds one burst, or
+ * what accrues in a pacing timer tick if that is more.
+ */
+class TokenBucketPacer : public Pacer {
+ public:
+  explicit TokenBucketPacer(const QuicConnectionStateBase& conn);
+
+  void refreshPacingRate(uint64_t cwndBytes, std::chrono::microseconds rtt)
+      override;
+
+  void onPacedWriteScheduled(TimePoint currentTime) override;
+
+  std::chrono::microseconds getTimeUntilNextWrite() const override;
+
+  uint64_t updateAndGetWriteBatchSize(TimePoint currentTime) override;
+
+  std::chrono::nanoseconds getPacketInterval() const override;
+
+  uint64_t getCachedWriteBatchSize() const override;
+
+  void setAppLimited(bool limited) override;
+
+  void onPacketSent() override;
+  void onPacketsLoss() override;
+
+  // Bytes per second, 0 when not paced
+  double getPacingRate() const noexcept;
+
+ private:
+  uint64_t burstBytes() const noexcept;
+  double bucketBytes() const noexcept;
+
+  const QuicConnectionStateBase& conn_;
+  double bytesPerSecond_{0};
+  // Goes negative when more than the credit was written
+  double credit_{0};
+  folly::Optional<TimePoint> lastRefillTime_;
+  uint64_t cachedBatchSize_;
+  bool appLimited_{false};
+};
+
+} // namespace quic
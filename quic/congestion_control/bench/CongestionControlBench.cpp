@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// The cost of the calls the ack path makes into the congestion controllers,
+// on a simulated bulk flow: a 20ms rtt, an ack every two packets and a loss
+// every kBenchLossInterval packets. Everything but the measured call runs
+// suspended.
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/congestion_control/Pacer.h>
+#include <quic/server/state/ServerStateMachine.h>
+
+#include <deque>
+
+using namespace quic;
+
+namespace {
+
+constexpr std::chrono::microseconds kBenchRtt = 20ms;
+// Between the sends, about 1Gbps.
+constexpr std::chrono::microseconds kBenchSendInterval = 10us;
+constexpr uint32_t kBenchPacketSize = 1252;
+constexpr PacketNum kBenchLossInterval = 500;
+// Steps before measuring, to get the controllers out of their startup.
+constexpr size_t kBenchWarmupSteps = 20000;
+
+class FlowSimulator {
+ public:
+  explicit FlowSimulator(
+      CongestionControlType type,
+      bool cubicFixedPoint = false)
+      : now_(Clock::now()), lastAckTime_(now_) {
+    conn_.transportSettings.cubicFixedPoint = cubicFixedPoint;
+    conn_.lossState.srtt = kBenchRtt;
+    conn_.lossState.lrtt = kBenchRtt;
+    conn_.lossState.mrtt = kBenchRtt;
+    conn_.transportSettings.pacingEnabled = true;
+    conn_.pacer = std::make_unique<DefaultPacer>(conn_, kMinCwndInMss);
+    conn_.congestionController =
+        DefaultCongestionControllerFactory().makeCongestionController(
+            conn_, type);
+    CHECK(conn_.congestionController);
+    for (size_t i = 0; i < kBenchWarmupSteps; ++i) {
+      step();
+    }
+  }
+
+  CongestionController& controller() {
+    return *conn_.congestionController;
+  }
+
+  QuicConnectionStateBase& conn() {
+    return conn_;
+  }
+
+  bool canSend() {
+    return controller().getWritableBytes() >= kBenchPacketSize ||
+        inflight_.size() < 2;
+  }
+
+  // Sends if the controller lets it, acks otherwise.
+  void step() {
+    if (canSend()) {
+      controller().onPacketSent(makePacket());
+    } else {
+      auto events = makeAck();
+      controller().onPacketAckOrLoss(
+          std::move(events.first), std::move(events.second));
+    }
+  }
+
+  OutstandingPacket makePacket() {
+    now_ += kBenchSendInterval;
+    RegularQuicWritePacket packet(ShortHeader(
+        ProtectionType::KeyPhaseZero,
+        ConnectionId(std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}),
+        nextPacketNum_));
+    packet.frames.emplace_back(
+        WriteStreamFrame(4, nextPacketNum_ * 1200, 1200, false));
+    conn_.lossState.totalBytesSent += kBenchPacketSize;
+    OutstandingPacket outstanding(
+        std::move(packet),
+        now_,
+        kBenchPacketSize,
+        false,
+        conn_.lossState.totalBytesSent);
+    outstanding.lastAckedPacketInfo.emplace(
+        lastAckedSentTime_,
+        lastAckTime_,
+        totalBytesSentAtLastAck_,
+        conn_.lossState.totalBytesAcked);
+    inflight_.push_back(outstanding);
+    nextPacketNum_++;
+    return outstanding;
+  }
+
+  // An ack of the two oldest packets in flight, with a loss of one more
+  // every kBenchLossInterval packets. Call when there are packets in flight.
+  std::pair<
+      folly::Optional<CongestionController::AckEvent>,
+      folly::Optional<CongestionController::LossEvent>>
+  makeAck() {
+    CHECK_GE(inflight_.size(), 2);
+    folly::Optional<CongestionController::LossEvent> loss;
+    CongestionController::AckEvent ack;
+    ack.ackTime = std::max(now_, inflight_[1].time + kBenchRtt);
+    now_ = ack.ackTime;
+    ack.mrttSample = kBenchRtt;
+    for (int i = 0; i < 2; ++i) {
+      auto& packet = inflight_.front();
+      if (packet.packetNum % kBenchLossInterval == 0 && inflight_.size() > 2) {
+        loss.emplace(ack.ackTime);
+        loss->addLostPacket(packet);
+        inflight_.pop_front();
+      }
+      auto& acked = inflight_.front();
+      ack.largestAckedPacket = acked.packetNum;
+      ack.largestAckedPacketSentTime = acked.time;
+      ack.ackedBytes += acked.encodedSize;
+      ack.ackedPackets.push_back(
+          CongestionController::AckEvent::AckPacket::Builder()
+              .setSentTime(acked.time)
+              .setEncodedSize(acked.encodedSize)
+              .setLastAckedPacketInfo(acked.lastAckedPacketInfo)
+              .setTotalBytesSentThen(acked.totalBytesSent)
+              .build());
+      conn_.lossState.totalBytesAcked += acked.encodedSize;
+      lastAckedSentTime_ = acked.time;
+      inflight_.pop_front();
+    }
+    // What the path delivers, a window an rtt.
+    RateSample rateSample;
+    rateSample.sentBytes = controller().getCongestionWindow();
+    rateSample.sendElapsed = kBenchRtt;
+    rateSample.deliveredBytes = rateSample.sentBytes;
+    rateSample.ackElapsed = kBenchRtt;
+    ack.rateSample = rateSample;
+    lastAckTime_ = ack.ackTime;
+    totalBytesSentAtLastAck_ = conn_.lossState.totalBytesSent;
+    return std::make_pair(std::move(ack), std::move(loss));
+  }
+
+ private:
+  QuicServerConnectionState conn_;
+  std::deque<OutstandingPacket> inflight_;
+  PacketNum nextPacketNum_{1};
+  TimePoint now_;
+  TimePoint lastAckedSentTime_;
+  TimePoint lastAckTime_;
+  uint64_t totalBytesSentAtLastAck_{0};
+};
+
+void onPacketSent(size_t iters, CongestionControlType type) {
+  folly::Optional<FlowSimulator> flow;
+  BENCHMARK_SUSPEND {
+    flow.emplace(type);
+  }
+  while (iters--) {
+    folly::Optional<OutstandingPacket> packet;
+    BENCHMARK_SUSPEND {
+      while (!flow->canSend()) {
+        flow->step();
+      }
+      packet.emplace(flow->makePacket());
+    }
+    flow->controller().onPacketSent(*packet);
+  }
+  BENCHMARK_SUSPEND {
+    flow.clear();
+  }
+}
+
+void onPacketAckOrLoss(
+    size_t iters,
+    CongestionControlType type,
+    bool cubicFixedPoint = false) {
+  folly::Optional<FlowSimulator> flow;
+  BENCHMARK_SUSPEND {
+    flow.emplace(type, cubicFixedPoint);
+  }
+  while (iters--) {
+    // Emplaced, a LossEvent can not be assigned.
+    folly::Optional<std::pair<
+        folly::Optional<CongestionController::AckEvent>,
+        folly::Optional<CongestionController::LossEvent>>>
+        events;
+    BENCHMARK_SUSPEND {
+      while (flow->canSend()) {
+        flow->step();
+      }
+      events.emplace(flow->makeAck());
+    }
+    flow->controller().onPacketAckOrLoss(
+        std::move(events->first), std::move(events->second));
+  }
+  BENCHMARK_SUSPEND {
+    flow.clear();
+  }
+}
+
+void getWritableBytes(size_t iters, CongestionControlType type) {
+  folly::Optional<FlowSimulator> flow;
+  BENCHMARK_SUSPEND {
+    flow.emplace(type);
+  }
+  const auto& controller = flow->controller();
+  while (iters--) {
+    folly::doNotOptimizeAway(controller.getWritableBytes());
+  }
+  BENCHMARK_SUSPEND {
+    flow.clear();
+  }
+}
+
+// With the windows a controller would refresh it with, on every ack.
+void refreshDefaultPacer(size_t iters) {
+  folly::Optional<FlowSimulator> flow;
+  BENCHMARK_SUSPEND {
+    flow.emplace(CongestionControlType::Cubic);
+  }
+  DefaultPacer pacer(flow->conn(), kMinCwndInMss);
+  uint64_t cwnd = 100 * kBenchPacketSize;
+  while (iters--) {
+    cwnd = cwnd >= 2000 * kBenchPacketSize ? 100 * kBenchPacketSize
+                                           : cwnd + kBenchPacketSize;
+    pacer.refreshPacingRate(cwnd, kBenchRtt);
+    folly::doNotOptimizeAway(pacer.getCachedWriteBatchSize());
+  }
+  BENCHMARK_SUSPEND {
+    flow.clear();
+  }
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(onPacketSent, NewReno, CongestionControlType::NewReno)
+BENCHMARK_NAMED_PARAM(onPacketSent, Cubic, CongestionControlType::Cubic)
+BENCHMARK_NAMED_PARAM(onPacketSent, Copa, CongestionControlType::Copa)
+BENCHMARK_NAMED_PARAM(onPacketSent, BBR, CongestionControlType::BBR)
+BENCHMARK_NAMED_PARAM(onPacketSent, BBR2, CongestionControlType::BBR2)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(
+    onPacketAckOrLoss,
+    NewReno,
+    CongestionControlType::NewReno)
+BENCHMARK_NAMED_PARAM(onPacketAckOrLoss, Cubic, CongestionControlType::Cubic)
+BENCHMARK_NAMED_PARAM(onPacketAckOrLoss, Copa, CongestionControlType::Copa)
+BENCHMARK_NAMED_PARAM(onPacketAckOrLoss, BBR, CongestionControlType::BBR)
+BENCHMARK_NAMED_PARAM(onPacketAckOrLoss, BBR2, CongestionControlType::BBR2)
+BENCHMARK_DRAW_LINE();
+// Cubic's steady state, with the cubic function in floating point and in
+// fixed point.
+BENCHMARK_NAMED_PARAM(
+    onPacketAckOrLoss,
+    CubicFloatingPoint,
+    CongestionControlType::Cubic,
+    false)
+BENCHMARK_RELATIVE_NAMED_PARAM(
+    onPacketAckOrLoss,
+    CubicFixedPoint,
+    CongestionControlType::Cubic,
+    true)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(getWritableBytes, NewReno, CongestionControlType::NewReno)
+BENCHMARK_NAMED_PARAM(getWritableBytes, Cubic, CongestionControlType::Cubic)
+BENCHMARK_NAMED_PARAM(getWritableBytes, Copa, CongestionControlType::Copa)
+BENCHMARK_NAMED_PARAM(getWritableBytes, BBR, CongestionControlType::BBR)
+BENCHMARK_NAMED_PARAM(getWritableBytes, BBR2, CongestionControlType::BBR2)
+BENCHMARK_DRAW_LINE();
+BENCHMARK(refreshPacingRate, iters) {
+  refreshDefaultPacer(iters);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
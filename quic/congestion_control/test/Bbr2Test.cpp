@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/Bbr2.h>
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/congestion_control/test/Mocks.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class Bbr2Test : public Test {
+ public:
+  void SetUp() override {
+    conn_.udpSendPacketLen = 1000;
+    bbr_ = std::make_unique<Bbr2CongestionController>(conn_);
+    auto rttSampler = std::make_unique<NiceMock<MockMinRttSampler>>();
+    auto bandwidthSampler =
+        std::make_unique<NiceMock<MockBandwidthSampler>>();
+    ON_CALL(*rttSampler, minRtt()).WillByDefault(Return(10ms));
+    ON_CALL(*rttSampler, minRttExpired()).WillByDefault(Return(false));
+    // A BDP of 10000 bytes.
+    ON_CALL(*bandwidthSampler, getBandwidth())
+        .WillByDefault(Return(Bandwidth(1000, 1ms)));
+    ON_CALL(*bandwidthSampler, isAppLimited()).WillByDefault(Return(false));
+    bbr_->setRttSampler(std::move(rttSampler));
+    bbr_->setBandwidthSampler(std::move(bandwidthSampler));
+  }
+
+  // Acks ackedBytes with a packet sent after the current round started, so
+  // that the ack starts a new round.
+  void ackNewRound(
+      uint64_t ackedBytes,
+      folly::Optional<CongestionController::LossEvent> loss = folly::none) {
+    auto sentTime = Clock::now() + 1us;
+    bbr_->onPacketAckOrLoss(
+        makeAck(packetNum_++, ackedBytes, sentTime + 5ms, sentTime),
+        std::move(loss));
+  }
+
+  QuicConnectionStateBase conn_{QuicNodeType::Client};
+  std::unique_ptr<Bbr2CongestionController> bbr_;
+  PacketNum packetNum_{0};
+};
+
+TEST_F(Bbr2Test, InitStates) {
+  EXPECT_EQ(CongestionControlType::BBR2, bbr_->type());
+  EXPECT_EQ(Bbr2CongestionController::State::Startup, bbr_->state());
+  EXPECT_EQ(
+      1000 * conn_.transportSettings.initCwndInMss,
+      bbr_->getCongestionWindow());
+  EXPECT_EQ(bbr_->getWritableBytes(), bbr_->getCongestionWindow());
+  EXPECT_FALSE(bbr_->inflightHi().has_value());
+  EXPECT_FALSE(bbr_->inflightLo().has_value());
+}
+
+TEST_F(Bbr2Test, FactoryMakesBbr2) {
+  DefaultCongestionControllerFactory factory;
+  auto congestionController =
+      factory.makeCongestionController(conn_, CongestionControlType::BBR2);
+  ASSERT_NE(nullptr, congestionController);
+  EXPECT_EQ(CongestionControlType::BBR2, congestionController->type());
+  EXPECT_EQ(
+      kCongestionControlBbr2Str,
+      congestionControlTypeToString(CongestionControlType::BBR2));
+  EXPECT_EQ(
+      CongestionControlType::BBR2,
+      *congestionControlStrToType(kCongestionControlBbr2Str));
+}
+
+TEST_F(Bbr2Test, StartupExitsWhenBandwidthStopsGrowing) {
+  // Keep the inflight above the BDP so Drain doesn't end right away.
+  bbr_->onPacketSent(makeTestingWritePacket(0, 100000, 100000));
+  // The first round sets the full bandwidth, the next three don't grow it.
+  for (int i = 0; i < 3; i++) {
+    ackNewRound(1000);
+    EXPECT_EQ(Bbr2CongestionController::State::Startup, bbr_->state());
+  }
+  ackNewRound(1000);
+  EXPECT_EQ(Bbr2CongestionController::State::Drain, bbr_->state());
+  EXPECT_FALSE(bbr_->inflightHi().has_value());
+}
+
+TEST_F(Bbr2Test, StartupExitsOnHighLoss) {
+  bbr_->onPacketSent(makeTestingWritePacket(0, 100000, 100000));
+  CongestionController::LossEvent loss;
+  loss.lostBytes = 1000;
+  // Half of each round is lost, the second round ending with high loss ends
+  // Startup.
+  ackNewRound(1000, loss);
+  ackNewRound(1000, loss);
+  EXPECT_EQ(Bbr2CongestionController::State::Startup, bbr_->state());
+  ackNewRound(1000, loss);
+  EXPECT_EQ(Bbr2CongestionController::State::Drain, bbr_->state());
+  ASSERT_TRUE(bbr_->inflightHi().has_value());
+  EXPECT_EQ(10000, *bbr_->inflightHi());
+}
+
+TEST_F(Bbr2Test, CongestedRoundSetsLowerBounds) {
+  bbr_->onPacketSent(makeTestingWritePacket(0, 5000, 5000));
+  // Startup ends after four rounds, the inflight is already below the BDP so
+  // Drain ends right away too.
+  for (int i = 0; i < 4; i++) {
+    ackNewRound(500);
+  }
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwCruise, bbr_->state());
+  EXPECT_FALSE(bbr_->inflightLo().has_value());
+
+  // CE marks in this round back the lower bounds off once the round ends.
+  bbr_->onEcnCongestionEvent(Clock::now());
+  auto oldSentTime = Clock::now() - 1s;
+  bbr_->onPacketAckOrLoss(
+      makeAck(packetNum_++, 500, Clock::now(), oldSentTime), folly::none);
+  EXPECT_FALSE(bbr_->inflightLo().has_value());
+  ackNewRound(500);
+  ASSERT_TRUE(bbr_->inflightLo().has_value());
+  EXPECT_LE(bbr_->getCongestionWindow(), *bbr_->inflightLo());
+}
+
+} // namespace test
+} // namespace quic
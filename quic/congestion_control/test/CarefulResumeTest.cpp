@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CarefulResume.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/NewReno.h>
+#include <quic/congestion_control/QuicCubic.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class CarefulResumeTest : public Test {
+ public:
+  void SetUp() override {
+    conn_.udpSendPacketLen = 1000;
+    params_.jumpCwndBytes = 100000;
+    params_.savedRtt = 50ms;
+    now_ = Clock::now();
+  }
+
+  // An ack of the given bytes one ms after the last, with the given mrtt.
+  CongestionController::AckEvent ack(
+      uint64_t bytes,
+      TimePoint sentTime,
+      folly::Optional<std::chrono::microseconds> rtt = folly::none) {
+    now_ += 1ms;
+    auto ackEvent = makeAck(packetNum_++, bytes, now_, sentTime);
+    ackEvent.mrttSample = rtt;
+    return ackEvent;
+  }
+
+  QuicConnectionStateBase conn_{QuicNodeType::Client};
+  CarefulResumeParams params_;
+  TimePoint now_;
+  PacketNum packetNum_{0};
+};
+
+TEST_F(CarefulResumeTest, JumpValidateAndFinish) {
+  CarefulResume carefulResume(conn_, params_);
+  EXPECT_EQ(CarefulResume::Phase::Reconnaissance, carefulResume.phase());
+  EXPECT_FALSE(carefulResume.holdsCwnd());
+  EXPECT_FALSE(carefulResume.onPacketAcked(ack(1000, now_), 0).has_value());
+
+  auto cwnd = carefulResume.onPacketAcked(ack(1000, now_, 60ms), 0);
+  ASSERT_TRUE(cwnd.has_value());
+  EXPECT_EQ(params_.jumpCwndBytes, *cwnd);
+  EXPECT_EQ(CarefulResume::Phase::Unvalidated, carefulResume.phase());
+  EXPECT_TRUE(carefulResume.holdsCwnd());
+
+  // Packets sent before the jump don't validate it.
+  auto jumpTime = now_;
+  EXPECT_FALSE(
+      carefulResume.onPacketAcked(ack(10000, jumpTime - 1ms), 80000)
+          .has_value());
+  EXPECT_EQ(CarefulResume::Phase::Unvalidated, carefulResume.phase());
+
+  cwnd = carefulResume.onPacketAcked(ack(20000, jumpTime), 60000);
+  ASSERT_TRUE(cwnd.has_value());
+  EXPECT_EQ(80000, *cwnd);
+  EXPECT_EQ(CarefulResume::Phase::Validating, carefulResume.phase());
+  EXPECT_FALSE(carefulResume.holdsCwnd());
+
+  auto validatingStart = now_;
+  carefulResume.onPacketAcked(ack(1000, validatingStart - 1us), 0);
+  EXPECT_EQ(CarefulResume::Phase::Validating, carefulResume.phase());
+  carefulResume.onPacketAcked(ack(1000, validatingStart), 0);
+  EXPECT_EQ(CarefulResume::Phase::Normal, carefulResume.phase());
+}
+
+TEST_F(CarefulResumeTest, RttDoesNotConfirmSavedRtt) {
+  CarefulResume shorter(conn_, params_);
+  EXPECT_FALSE(shorter.onPacketAcked(ack(1000, now_, 20ms), 0).has_value());
+  EXPECT_EQ(CarefulResume::Phase::Normal, shorter.phase());
+
+  CarefulResume longer(conn_, params_);
+  EXPECT_FALSE(longer.onPacketAcked(ack(1000, now_, 600ms), 0).has_value());
+  EXPECT_EQ(CarefulResume::Phase::Normal, longer.phase());
+}
+
+TEST_F(CarefulResumeTest, SafeRetreat) {
+  CarefulResume carefulResume(conn_, params_);
+  carefulResume.onPacketAcked(ack(1000, now_, 50ms), 0);
+  carefulResume.onPacketAcked(ack(30000, now_ - 10ms), 90000);
+
+  auto lossTime = now_;
+  auto cwnd = carefulResume.onCongestionEvent(lossTime);
+  ASSERT_TRUE(cwnd.has_value());
+  EXPECT_EQ(15000, *cwnd);
+  EXPECT_EQ(CarefulResume::Phase::SafeRetreat, carefulResume.phase());
+  EXPECT_TRUE(carefulResume.holdsCwnd());
+  EXPECT_FALSE(carefulResume.onCongestionEvent(now_).has_value());
+
+  carefulResume.onPacketAcked(ack(1000, lossTime - 1us), 0);
+  EXPECT_EQ(CarefulResume::Phase::SafeRetreat, carefulResume.phase());
+  carefulResume.onPacketAcked(ack(1000, lossTime), 0);
+  EXPECT_EQ(CarefulResume::Phase::Normal, carefulResume.phase());
+}
+
+TEST_F(CarefulResumeTest, LossBeforeJump) {
+  CarefulResume carefulResume(conn_, params_);
+  EXPECT_FALSE(carefulResume.onCongestionEvent(now_).has_value());
+  EXPECT_EQ(CarefulResume::Phase::Normal, carefulResume.phase());
+}
+
+TEST_F(CarefulResumeTest, CubicJumpsAndHolds) {
+  conn_.carefulResume = params_;
+  Cubic cubic(conn_);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto packet = makeTestingWritePacket(packetNum_, 1000, 1000, now_);
+  cubic.onPacketSent(packet);
+  cubic.onPacketAckOrLoss(ack(1000, now_, 50ms), folly::none);
+  EXPECT_EQ(params_.jumpCwndBytes, cubic.getCongestionWindow());
+  EXPECT_LT(initCwnd, cubic.getCongestionWindow());
+
+  // Acks of packets sent before the jump don't grow the cwnd.
+  auto sentTime = now_ - 1ms;
+  cubic.onPacketSent(makeTestingWritePacket(packetNum_, 1000, 2000, sentTime));
+  cubic.onPacketAckOrLoss(ack(1000, sentTime), folly::none);
+  EXPECT_EQ(params_.jumpCwndBytes, cubic.getCongestionWindow());
+}
+
+TEST_F(CarefulResumeTest, NewRenoRetreats) {
+  conn_.carefulResume = params_;
+  NewReno reno(conn_);
+  reno.onPacketSent(makeTestingWritePacket(packetNum_, 1000, 1000, now_));
+  reno.onPacketAckOrLoss(ack(1000, now_, 50ms), folly::none);
+  EXPECT_EQ(params_.jumpCwndBytes, reno.getCongestionWindow());
+
+  auto sentTime = now_;
+  for (int i = 0; i < 10; i++) {
+    reno.onPacketSent(
+        makeTestingWritePacket(packetNum_ + i, 1000, 1000 * (i + 2), sentTime));
+  }
+  reno.onPacketAckOrLoss(ack(2000, sentTime - 1us), folly::none);
+
+  CongestionController::LossEvent loss(now_);
+  loss.addLostPacket(
+      makeTestingWritePacket(packetNum_++, 1000, 12000, sentTime));
+  reno.onPacketAckOrLoss(folly::none, loss);
+  // Half of the 2000 bytes acked since the jump, bounded by the min cwnd.
+  EXPECT_EQ(
+      conn_.transportSettings.minCwndInMss * conn_.udpSendPacketLen,
+      reno.getCongestionWindow());
+}
+
+} // namespace test
+} // namespace quic
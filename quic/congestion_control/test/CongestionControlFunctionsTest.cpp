@@ -10,6 +10,7 @@
 
 #include <folly/portability/GTest.h>
 #include <quic/QuicConstants.h>
+#include <quic/congestion_control/NewReno.h>
 #include <quic/state/StateData.h>
 
 using namespace testing;
@@ -72,6 +73,82 @@ TEST_F(CongestionControlFunctionsTest, RttSmallerThanInterval) {
       conn.transportSettings.writeConnectionDataPacketsLimit, result.burstSize);
 }
 
+TEST_F(CongestionControlFunctionsTest, VirtualClock) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto before = Clock::now();
+  EXPECT_GE(congestionControlNow(conn), before);
+  TimePoint virtualNow(10s);
+  conn.congestionControlClock = [&] { return virtualNow; };
+  EXPECT_EQ(virtualNow, congestionControlNow(conn));
+  virtualNow += 5ms;
+  EXPECT_EQ(virtualNow, congestionControlNow(conn));
+}
+
+TEST_F(CongestionControlFunctionsTest, WarmStartCwnd) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  conn.udpSendPacketLen = 1000;
+  auto now = std::chrono::system_clock::now();
+  CachedCongestionState state;
+  state.cwndBytes = 100000;
+  state.minRtt = 50ms;
+  state.recordTime = now - 10min;
+  // Half of the cached cwnd without a bandwidth
+  EXPECT_EQ(50000, warmStartCwnd(conn, state, now).value());
+
+  // and half the bdp if it is smaller
+  state.bandwidthBytesPerSec = 1000000;
+  EXPECT_EQ(25000, warmStartCwnd(conn, state, now).value());
+  state.bandwidthBytesPerSec = 10000000;
+  EXPECT_EQ(50000, warmStartCwnd(conn, state, now).value());
+
+  // At most warmStartMaxCwndInMss
+  conn.transportSettings.warmStartMaxCwndInMss = 30;
+  EXPECT_EQ(30000, warmStartCwnd(conn, state, now).value());
+  conn.transportSettings.maxCwndInMss = 20;
+  EXPECT_EQ(20000, warmStartCwnd(conn, state, now).value());
+
+  // Nothing to gain below the initial cwnd
+  conn.transportSettings.initCwndInMss = 20;
+  EXPECT_FALSE(warmStartCwnd(conn, state, now).has_value());
+  conn.transportSettings.initCwndInMss = kInitCwndInMss;
+
+  // Stale state
+  state.recordTime = now - conn.transportSettings.warmStartMaxAge - 1s;
+  EXPECT_FALSE(warmStartCwnd(conn, state, now).has_value());
+  state.recordTime = now + 1s;
+  EXPECT_FALSE(warmStartCwnd(conn, state, now).has_value());
+}
+
+TEST_F(CongestionControlFunctionsTest, InitialCwndBytes) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  conn.udpSendPacketLen = 1000;
+  EXPECT_EQ(kInitCwndInMss * 1000, initialCwndBytes(conn));
+  conn.warmStartCwndBytes = 50000;
+  EXPECT_EQ(50000, initialCwndBytes(conn));
+}
+
+TEST_F(CongestionControlFunctionsTest, MakeCachedCongestionState) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  auto now = std::chrono::system_clock::now();
+  EXPECT_FALSE(makeCachedCongestionState(conn, now).has_value());
+  conn.congestionController = std::make_unique<NewReno>(conn);
+  // No rtt sample yet
+  EXPECT_FALSE(makeCachedCongestionState(conn, now).has_value());
+
+  conn.lossState.srtt = 60ms;
+  conn.lossState.mrtt = 50ms;
+  RateSample rateSample;
+  rateSample.deliveredBytes = 100000;
+  rateSample.ackElapsed = 100ms;
+  conn.lossState.lastRateSample = rateSample;
+  auto state = makeCachedCongestionState(conn, now);
+  ASSERT_TRUE(state.has_value());
+  EXPECT_EQ(1000000, state->bandwidthBytesPerSec);
+  EXPECT_EQ(50ms, state->minRtt);
+  EXPECT_EQ(conn.congestionController->getCongestionWindow(), state->cwndBytes);
+  EXPECT_EQ(now, state->recordTime);
+}
+
 
 } // namespace test
 } // namespace quic
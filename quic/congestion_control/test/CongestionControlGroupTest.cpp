@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CongestionControlGroup.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/state/test/Mocks.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class MockControllerFactory : public CongestionControllerFactory {
+ public:
+  std::unique_ptr<CongestionController> makeCongestionController(
+      QuicConnectionStateBase&,
+      CongestionControlType) override {
+    auto cc = std::make_unique<NiceMock<MockCongestionController>>();
+    ON_CALL(*cc, type()).WillByDefault(Return(CongestionControlType::Cubic));
+    lastController = cc.get();
+    return cc;
+  }
+
+  MockCongestionController* lastController{nullptr};
+};
+
+class CongestionControlGroupTest : public Test {
+ public:
+  void SetUp() override {
+    conn1_.udpSendPacketLen = 1000;
+    conn2_.udpSendPacketLen = 1000;
+    group_ = std::make_shared<CongestionControlGroup>();
+    factory_ = std::make_shared<GroupCongestionControllerFactory>(
+        std::make_shared<DefaultCongestionControllerFactory>(), group_);
+    now_ = Clock::now();
+  }
+
+  void send(CongestionController& cc, uint64_t bytes) {
+    cc.onPacketSent(makeTestingWritePacket(packetNum_++, bytes, bytes, now_));
+  }
+
+  QuicConnectionStateBase conn1_{QuicNodeType::Server};
+  QuicConnectionStateBase conn2_{QuicNodeType::Server};
+  std::shared_ptr<CongestionControlGroup> group_;
+  std::shared_ptr<GroupCongestionControllerFactory> factory_;
+  TimePoint now_;
+  PacketNum packetNum_{0};
+};
+
+TEST_F(CongestionControlGroupTest, MembersShareCwnd) {
+  auto cc1 =
+      factory_->makeCongestionController(conn1_, CongestionControlType::Cubic);
+  auto cc2 = factory_->makeCongestionController(
+      conn2_, CongestionControlType::NewReno);
+  EXPECT_EQ(2, group_->size());
+  // The second member joins the group's controller.
+  EXPECT_EQ(CongestionControlType::Cubic, cc2->type());
+  auto cwnd = group_->controller().getCongestionWindow();
+  EXPECT_EQ(cwnd, cc1->getCongestionWindow());
+
+  send(*cc1, 1000);
+  EXPECT_EQ(cwnd, cc1->getCongestionWindow());
+  EXPECT_EQ(cwnd / 2, cc2->getCongestionWindow());
+  EXPECT_EQ(cwnd / 2, cc2->getWritableBytes());
+
+  send(*cc2, 1000);
+  EXPECT_EQ(cwnd / 2, cc1->getCongestionWindow());
+  EXPECT_EQ(cwnd / 2 - 1000, cc1->getWritableBytes());
+  EXPECT_EQ(cwnd - 2000, group_->controller().getWritableBytes());
+}
+
+TEST_F(CongestionControlGroupTest, AckAndLossMoveTheGroup) {
+  auto cc1 =
+      factory_->makeCongestionController(conn1_, CongestionControlType::Cubic);
+  auto cc2 =
+      factory_->makeCongestionController(conn2_, CongestionControlType::Cubic);
+  auto cwnd = group_->controller().getCongestionWindow();
+  send(*cc1, 1000);
+  send(*cc2, 1000);
+
+  cc1->onPacketAckOrLoss(makeAck(0, 1000, now_ + 10ms, now_), folly::none);
+  EXPECT_LT(cwnd, group_->controller().getCongestionWindow());
+  // Only cc2 has data in flight now.
+  EXPECT_EQ(
+      group_->controller().getCongestionWindow(), cc2->getCongestionWindow());
+
+  cwnd = group_->controller().getCongestionWindow();
+  CongestionController::LossEvent loss(now_ + 20ms);
+  loss.addLostPacket(makeTestingWritePacket(1, 1000, 1000, now_ + 1ms));
+  cc2->onPacketAckOrLoss(folly::none, loss);
+  EXPECT_GT(cwnd, group_->controller().getCongestionWindow());
+  EXPECT_EQ(
+      group_->controller().getCongestionWindow(), cc1->getCongestionWindow());
+}
+
+TEST_F(CongestionControlGroupTest, LeavingMemberTakesItsInflight) {
+  auto cc1 =
+      factory_->makeCongestionController(conn1_, CongestionControlType::Cubic);
+  auto cc2 =
+      factory_->makeCongestionController(conn2_, CongestionControlType::Cubic);
+  auto cwnd = group_->controller().getCongestionWindow();
+  send(*cc1, 1000);
+  send(*cc2, 3000);
+  cc2.reset();
+  EXPECT_EQ(1, group_->size());
+  EXPECT_EQ(cwnd - 1000, group_->controller().getWritableBytes());
+  EXPECT_EQ(cwnd, cc1->getCongestionWindow());
+}
+
+TEST_F(CongestionControlGroupTest, GroupIdleOnceAllMembersAre) {
+  auto mockFactory = std::make_shared<MockControllerFactory>();
+  GroupCongestionControllerFactory factory(mockFactory, group_);
+  auto cc1 =
+      factory.makeCongestionController(conn1_, CongestionControlType::Cubic);
+  auto cc2 =
+      factory.makeCongestionController(conn2_, CongestionControlType::Cubic);
+  auto mock = mockFactory->lastController;
+  ASSERT_NE(nullptr, mock);
+
+  EXPECT_CALL(*mock, setAppIdle(_, _)).Times(0);
+  cc1->setAppIdle(true, now_);
+  Mock::VerifyAndClearExpectations(mock);
+
+  EXPECT_CALL(*mock, setAppIdle(true, now_));
+  cc2->setAppIdle(true, now_);
+  Mock::VerifyAndClearExpectations(mock);
+
+  EXPECT_CALL(*mock, setAppIdle(false, now_ + 1ms));
+  cc1->setAppIdle(false, now_ + 1ms);
+  Mock::VerifyAndClearExpectations(mock);
+
+  // cc2 stays idle, so the group goes idle once cc1 leaves.
+  EXPECT_CALL(*mock, setAppIdle(true, _));
+  cc1.reset();
+}
+
+TEST_F(CongestionControlGroupTest, UnsupportedTypesAreNotGrouped) {
+  auto cc =
+      factory_->makeCongestionController(conn1_, CongestionControlType::Copa);
+  EXPECT_EQ(CongestionControlType::Copa, cc->type());
+  EXPECT_EQ(nullptr, dynamic_cast<GroupMemberCongestionController*>(cc.get()));
+  EXPECT_EQ(0, group_->size());
+}
+
+TEST_F(CongestionControlGroupTest, Registry) {
+  CongestionControlGroupRegistry registry;
+  auto group = registry.getGroup("10.0.0.0");
+  EXPECT_EQ(group, registry.getGroup("10.0.0.0"));
+  EXPECT_NE(group, registry.getGroup("10.0.1.0"));
+  group.reset();
+  EXPECT_NE(nullptr, registry.getGroup("10.0.0.0"));
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CongestionControllerRegistry.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/congestion_control/NewReno.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class CongestionControllerRegistryTest : public Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(CongestionControllerRegistry::get().registerController(
+        kName.str(), [this](auto& conn, const auto& params) {
+          params_ = params;
+          return std::make_unique<NewReno>(conn);
+        }));
+  }
+
+  void TearDown() override {
+    CongestionControllerRegistry::get().unregisterController(kName);
+  }
+
+  static constexpr folly::StringPiece kName{"test_controller"};
+  QuicConnectionStateBase conn_{QuicNodeType::Client};
+  std::string params_;
+};
+
+constexpr folly::StringPiece CongestionControllerRegistryTest::kName;
+
+TEST_F(CongestionControllerRegistryTest, NameIsTaken) {
+  auto& registry = CongestionControllerRegistry::get();
+  EXPECT_TRUE(registry.isRegistered(kName));
+  EXPECT_FALSE(registry.registerController(
+      kName.str(), [](auto& conn, const auto&) {
+        return std::make_unique<NewReno>(conn);
+      }));
+  auto names = registry.names();
+  EXPECT_EQ(1, std::count(names.begin(), names.end(), kName.str()));
+}
+
+TEST_F(CongestionControllerRegistryTest, FactoryMakesRegistered) {
+  conn_.transportSettings.congestionControllerName = kName.str();
+  conn_.transportSettings.congestionControllerParams = "beta=0.7";
+  DefaultCongestionControllerFactory factory;
+  auto congestionController =
+      factory.makeCongestionController(conn_, CongestionControlType::Cubic);
+  ASSERT_NE(nullptr, congestionController);
+  EXPECT_EQ(CongestionControlType::NewReno, congestionController->type());
+  EXPECT_EQ("beta=0.7", params_);
+}
+
+TEST_F(CongestionControllerRegistryTest, UnknownNameFallsBack) {
+  conn_.transportSettings.congestionControllerName = "no_such_controller";
+  DefaultCongestionControllerFactory factory;
+  auto congestionController =
+      factory.makeCongestionController(conn_, CongestionControlType::Cubic);
+  ASSERT_NE(nullptr, congestionController);
+  EXPECT_EQ(CongestionControlType::Cubic, congestionController->type());
+}
+
+TEST_F(CongestionControllerRegistryTest, Unregister) {
+  auto& registry = CongestionControllerRegistry::get();
+  EXPECT_TRUE(registry.unregisterController(kName));
+  EXPECT_FALSE(registry.isRegistered(kName));
+  EXPECT_EQ(
+      nullptr, registry.makeCongestionController(kName, conn_, params_));
+  EXPECT_FALSE(registry.unregisterController(kName));
+}
+
+} // namespace test
+} // namespace quic
@@ -125,6 +125,27 @@ class CopaTest : public Test {
     EXPECT_EQ(copa.getCongestionWindow(), lastCwnd - cwndChange);
     return copa.getCongestionWindow();
   }
+
+  // Sends a packet and acks it right away with the given rtt sample, every
+  // 10ms from now.
+  void sendAndAck(
+      Copa& copa,
+      QuicServerConnectionState& conn,
+      TimePoint& now,
+      PacketNum& packetNum,
+      std::chrono::microseconds lrtt,
+      std::chrono::milliseconds duration) {
+    auto packetSize = conn.udpSendPacketLen;
+    auto end = now + duration;
+    while (now < end) {
+      now += 10ms;
+      copa.onPacketSent(createPacket(packetNum, packetSize, packetSize));
+      conn.lossState.lrtt = lrtt;
+      copa.onPacketAckOrLoss(
+          createAckEvent(packetNum, packetSize, now), folly::none);
+      packetNum++;
+    }
+  }
 };
 
 TEST_F(CopaTest, TestWritableBytes) {
@@ -470,5 +491,91 @@ TEST_F(CopaTest, PacketLossInvokesPacer) {
   copa.onPacketAckOrLoss(folly::none, lossEvent);
 }
 
+TEST_F(CopaTest, NoCompetitiveModeByDefault) {
+  QuicServerConnectionState conn;
+  Copa copa(conn);
+  auto now = Clock::now();
+  PacketNum packetNum = 0;
+  conn.lossState.srtt = 50ms;
+  sendAndAck(copa, conn, now, packetNum, 50ms, 10ms);
+  // The queue never drains
+  sendAndAck(copa, conn, now, packetNum, 100ms, 1000ms);
+  EXPECT_FALSE(copa.inCompetitiveMode());
+  EXPECT_DOUBLE_EQ(copa.getDelta(), 0.5);
+}
+
+TEST_F(CopaTest, CompetitiveMode) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.copaCompetitiveMode = true;
+  auto qLogger = std::make_shared<FileQLogger>(VantagePoint::Client);
+  conn.qLogger = qLogger;
+  Copa copa(conn);
+  auto now = Clock::now();
+  PacketNum packetNum = 0;
+  conn.lossState.srtt = 50ms;
+  // Rttmin = 50ms, the queue is empty in the first 5 rtt period
+  sendAndAck(copa, conn, now, packetNum, 50ms, 10ms);
+  sendAndAck(copa, conn, now, packetNum, 100ms, 250ms);
+  EXPECT_FALSE(copa.inCompetitiveMode());
+  EXPECT_DOUBLE_EQ(copa.getDelta(), 0.5);
+
+  // and it never drains in the second one
+  sendAndAck(copa, conn, now, packetNum, 100ms, 250ms);
+  EXPECT_TRUE(copa.inCompetitiveMode());
+  auto delta = copa.getDelta();
+  EXPECT_LE(delta, 0.5);
+  std::vector<int> indices =
+      getQLogEventIndices(QLogEventType::CongestionMetricUpdate, qLogger);
+  auto competitiveEvents = std::count_if(
+      indices.begin(), indices.end(), [&](int index) {
+        auto event = dynamic_cast<QLogCongestionMetricUpdateEvent*>(
+            qLogger->logs[index].get());
+        return event->congestionEvent == kCopaCompetitiveMode;
+      });
+  EXPECT_EQ(competitiveEvents, 1);
+
+  // 1 / delta grows while there are no losses
+  sendAndAck(copa, conn, now, packetNum, 100ms, 200ms);
+  EXPECT_LT(copa.getDelta(), delta);
+
+  // and halves on loss
+  delta = copa.getDelta();
+  auto packet = createPacket(packetNum++, conn.udpSendPacketLen, 0);
+  copa.onPacketSent(packet);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  copa.onPacketAckOrLoss(folly::none, loss);
+  EXPECT_TRUE(copa.inCompetitiveMode());
+  EXPECT_DOUBLE_EQ(copa.getDelta(), std::min(0.5, 2 * delta));
+
+  // Back to the latency factor once the queue drains
+  sendAndAck(copa, conn, now, packetNum, 50ms, 500ms);
+  EXPECT_FALSE(copa.inCompetitiveMode());
+  EXPECT_DOUBLE_EQ(copa.getDelta(), 0.5);
+}
+
+TEST_F(CopaTest, CompetitiveModeCustomLatencyFactor) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.copaCompetitiveMode = true;
+  conn.transportSettings.latencyFactor = 0.25;
+  Copa copa(conn);
+  auto now = Clock::now();
+  PacketNum packetNum = 0;
+  conn.lossState.srtt = 50ms;
+  EXPECT_DOUBLE_EQ(copa.getDelta(), 0.25);
+  sendAndAck(copa, conn, now, packetNum, 50ms, 10ms);
+  sendAndAck(copa, conn, now, packetNum, 100ms, 500ms);
+  EXPECT_TRUE(copa.inCompetitiveMode());
+  // Never less aggressive than the latency factor, even after losses
+  for (int i = 0; i < 10; i++) {
+    auto packet = createPacket(packetNum++, conn.udpSendPacketLen, 0);
+    copa.onPacketSent(packet);
+    CongestionController::LossEvent loss;
+    loss.addLostPacket(packet);
+    copa.onPacketAckOrLoss(folly::none, loss);
+  }
+  EXPECT_LE(copa.getDelta(), 0.25);
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CubicFixedPoint.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/test/TestingCubic.h>
+
+#include <cmath>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+// What the floating point math of Cubic gives
+double floatingPointDelta(double timeElapsed, double timeToOrigin, double mss) {
+  return std::floor(
+      mss * kTimeScalingFactor * std::pow(timeElapsed - timeToOrigin, 3.0) /
+      1000 / 1000 / 1000);
+}
+
+void expectCubeRoot(uint64_t value) {
+  auto root = cubeRoot(value);
+  EXPECT_LE(root * root * root, value) << value;
+  if (root < 2642245) {
+    EXPECT_GT((root + 1) * (root + 1) * (root + 1), value) << value;
+  }
+}
+} // namespace
+
+class CubicFixedPointTest : public Test {};
+
+TEST_F(CubicFixedPointTest, CubeRoot) {
+  for (uint64_t value = 0; value < 100000; value++) {
+    expectCubeRoot(value);
+  }
+  for (uint64_t root = 1; root < 2642245; root += 997) {
+    auto cube = root * root * root;
+    EXPECT_EQ(root, cubeRoot(cube));
+    EXPECT_EQ(root - 1, cubeRoot(cube - 1));
+    expectCubeRoot(cube + 1);
+  }
+  for (int bit = 0; bit < 64; bit++) {
+    expectCubeRoot(uint64_t(1) << bit);
+    expectCubeRoot((uint64_t(1) << bit) - 1);
+  }
+  EXPECT_EQ(2642245, cubeRoot(std::numeric_limits<uint64_t>::max()));
+}
+
+TEST_F(CubicFixedPointTest, TimeToOrigin) {
+  for (uint64_t mss : {1200, 1252, 1500, 9000}) {
+    for (uint64_t bytes = 0; bytes < 100000000; bytes = bytes * 3 + 1000) {
+      auto expected = ::cbrt(bytes * 1000 * 1000 / mss * 2500);
+      EXPECT_NEAR(expected, cubicTimeToOrigin(bytes, mss), 1.0)
+          << "bytes=" << bytes << " mss=" << mss;
+    }
+  }
+  // Saturates instead of overflowing.
+  EXPECT_EQ(
+      2642245,
+      cubicTimeToOrigin(std::numeric_limits<uint64_t>::max() / 1000, 1500));
+}
+
+TEST_F(CubicFixedPointTest, CwndDelta) {
+  for (uint64_t mss : {1200, 1500, 9000}) {
+    for (uint64_t timeToOrigin : {0, 1, 700, 1710, 25000}) {
+      for (uint64_t timeElapsed = 0; timeElapsed < 60000; timeElapsed += 13) {
+        auto expected = floatingPointDelta(timeElapsed, timeToOrigin, mss);
+        // Doubles are exact to about 15 digits.
+        EXPECT_NEAR(
+            expected,
+            cubicCwndDelta(timeElapsed, timeToOrigin, mss),
+            std::max(1.0, std::abs(expected) * 1e-14))
+            << "t=" << timeElapsed << " K=" << timeToOrigin << " mss=" << mss;
+      }
+    }
+  }
+}
+
+TEST_F(CubicFixedPointTest, CwndDeltaSaturates) {
+  EXPECT_EQ(
+      std::numeric_limits<int64_t>::max(), cubicCwndDelta(3000000, 0, 1500));
+  EXPECT_EQ(
+      std::numeric_limits<int64_t>::min(), cubicCwndDelta(0, 3000000, 1500));
+  EXPECT_GT(cubicCwndDelta(2097151, 0, 1500), 0);
+  EXPECT_LT(cubicCwndDelta(0, 2097151, 1500), 0);
+}
+
+// Runs the same losses and acks through Cubic with both maths.
+TEST_F(CubicFixedPointTest, SameAsFloatingPointCubic) {
+  QuicConnectionStateBase floatConn(QuicNodeType::Client);
+  QuicConnectionStateBase fixedConn(QuicNodeType::Client);
+  floatConn.udpSendPacketLen = fixedConn.udpSendPacketLen = 1500;
+  fixedConn.transportSettings.cubicFixedPoint = true;
+  TestingCubic floatCubic(
+      floatConn, std::numeric_limits<uint64_t>::max(), false);
+  TestingCubic fixedCubic(
+      fixedConn, std::numeric_limits<uint64_t>::max(), false);
+
+  auto start = Clock::now();
+  PacketNum packetNum = 0;
+  uint64_t totalSent = 0;
+  auto lose = [&](TimePoint time) {
+    auto packet =
+        makeTestingWritePacket(packetNum++, 1000, totalSent += 1000, time);
+    for (auto cubic : {&floatCubic, &fixedCubic}) {
+      cubic->onPacketSent(packet);
+      CongestionController::LossEvent loss(time);
+      loss.addLostPacket(packet);
+      cubic->onPacketAckOrLoss(folly::none, std::move(loss));
+    }
+  };
+  floatCubic.setStateForTest(CubicStates::Steady);
+  fixedCubic.setStateForTest(CubicStates::Steady);
+  lose(start);
+  for (int i = 1; i <= 6000; i++) {
+    auto ackTime = start + std::chrono::milliseconds(i);
+    // A few more reductions along the way.
+    if (i % 2000 == 0) {
+      lose(ackTime);
+      continue;
+    }
+    auto packet = makeTestingWritePacket(
+        packetNum, 1000, totalSent += 1000, ackTime - 500us);
+    for (auto cubic : {&floatCubic, &fixedCubic}) {
+      cubic->onPacketSent(packet);
+      cubic->onPacketAckOrLoss(
+          makeAck(packetNum, 1000, ackTime, packet.time), folly::none);
+    }
+    packetNum++;
+    EXPECT_EQ(floatCubic.state(), fixedCubic.state());
+    // The fixed point time to origin is rounded down to the ms, which can
+    // make for up to 1ms worth of cwnd growth. Neither the time since the
+    // reduction nor the time to origin get past 2s here.
+    auto growth = 3 * kTimeScalingFactor * 1500 * 2001 * 2001 / 1000 / 1000 /
+        1000;
+    EXPECT_NEAR(
+        floatCubic.getCongestionWindow(),
+        fixedCubic.getCongestionWindow(),
+        growth)
+        << i;
+  }
+}
+
+} // namespace test
+} // namespace quic
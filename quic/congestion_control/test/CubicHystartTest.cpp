@@ -303,5 +303,36 @@ TEST_F(CubicHystartTest, ReduceByCubicReductionFactor) {
   EXPECT_EQ(initCwnd * kDefaultCubicReductionFactor, cubic.getWritableBytes());
   EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
 }
+
+TEST_F(CubicHystartTest, HystartPlusPlusExit) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.udpSendPacketLen = 1000;
+  conn.transportSettings.hystartPlusPlus = true;
+  Cubic cubic(conn);
+  cubic.onPacketSent(makeTestingWritePacket(0, 1000000, 1000000));
+
+  PacketNum packetNum = 1;
+  auto now = Clock::now();
+  auto ackRound = [&](std::chrono::microseconds rtt, uint8_t acks) {
+    now += 1ms;
+    auto roundStart = now;
+    for (uint8_t i = 0; i < acks; i++) {
+      now += 1us;
+      auto ack = makeAck(packetNum++, 1000, now, roundStart);
+      ack.mrttSample = rtt;
+      cubic.onPacketAckOrLoss(std::move(ack), folly::none);
+    }
+  };
+  ackRound(100ms, kHystartRttSamples);
+  ackRound(120ms, kHystartRttSamples);
+  for (uint8_t round = 1; round < kHystartCssRounds; round++) {
+    ackRound(120ms, kHystartRttSamples);
+  }
+  EXPECT_EQ(CubicStates::Hystart, cubic.state());
+  auto cwnd = cubic.getCongestionWindow();
+  ackRound(120ms, 1);
+  EXPECT_EQ(CubicStates::Steady, cubic.state());
+  EXPECT_EQ(cwnd, cubic.getCongestionWindow());
+}
 } // namespace test
 } // namespace quic
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/HystartPlusPlus.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class HystartPlusPlusTest : public Test {
+ public:
+  void SetUp() override {
+    conn_.udpSendPacketLen = 1000;
+    now_ = Clock::now();
+  }
+
+  // Acks packets all sent at the start of a new round, with the given rtt.
+  // Returns the cwnd growth of the acks.
+  uint64_t ackRound(
+      HystartPlusPlus& hystart,
+      std::chrono::microseconds rtt,
+      uint8_t acks = kHystartRttSamples) {
+    now_ += 1ms;
+    auto roundStart = now_;
+    uint64_t increase = 0;
+    for (uint8_t i = 0; i < acks; i++) {
+      now_ += 1us;
+      auto ack = makeAck(packetNum_++, 1000, now_, roundStart);
+      ack.mrttSample = rtt;
+      increase += hystart.onPacketAcked(ack);
+    }
+    return increase;
+  }
+
+  QuicConnectionStateBase conn_{QuicNodeType::Client};
+  TimePoint now_;
+  PacketNum packetNum_{0};
+};
+
+TEST_F(HystartPlusPlusTest, SlowStartGrowth) {
+  HystartPlusPlus hystart(conn_);
+  EXPECT_EQ(HystartPlusPlus::Phase::SlowStart, hystart.phase());
+  EXPECT_EQ(kHystartRttSamples * 1000, ackRound(hystart, 100ms));
+
+  // Without pacing a single ack doesn't grow the cwnd by more than the burst
+  // limit.
+  now_ += 1us;
+  auto ack = makeAck(packetNum_++, 20000, now_, now_ - 1ms);
+  EXPECT_EQ(
+      kHystartAckBurstLimitInMss * conn_.udpSendPacketLen,
+      hystart.onPacketAcked(ack));
+  EXPECT_EQ(HystartPlusPlus::Phase::SlowStart, hystart.phase());
+}
+
+TEST_F(HystartPlusPlusTest, RttIncreaseBelowThreshold) {
+  HystartPlusPlus hystart(conn_);
+  ackRound(hystart, 100ms);
+  // The threshold is 100ms / 8 = 12.5ms.
+  ackRound(hystart, 112ms);
+  EXPECT_EQ(HystartPlusPlus::Phase::SlowStart, hystart.phase());
+}
+
+TEST_F(HystartPlusPlusTest, ConservativeSlowStartThenExit) {
+  HystartPlusPlus hystart(conn_);
+  ackRound(hystart, 100ms);
+  ackRound(hystart, 120ms);
+  EXPECT_EQ(HystartPlusPlus::Phase::ConservativeSlowStart, hystart.phase());
+
+  // The round that entered conservative slow start is its first round.
+  for (uint8_t round = 1; round < kHystartCssRounds; round++) {
+    EXPECT_EQ(
+        kHystartRttSamples * 1000 / kHystartCssGrowthDivisor,
+        ackRound(hystart, 120ms));
+    EXPECT_EQ(HystartPlusPlus::Phase::ConservativeSlowStart, hystart.phase());
+  }
+  EXPECT_EQ(0, ackRound(hystart, 120ms, 1));
+  EXPECT_EQ(HystartPlusPlus::Phase::Done, hystart.phase());
+  EXPECT_EQ(0, ackRound(hystart, 120ms));
+}
+
+TEST_F(HystartPlusPlusTest, FalseSlowStartExit) {
+  HystartPlusPlus hystart(conn_);
+  ackRound(hystart, 100ms);
+  ackRound(hystart, 120ms);
+  EXPECT_EQ(HystartPlusPlus::Phase::ConservativeSlowStart, hystart.phase());
+  // The rtt goes back below the one conservative slow start started at.
+  ackRound(hystart, 110ms);
+  EXPECT_EQ(HystartPlusPlus::Phase::SlowStart, hystart.phase());
+  EXPECT_EQ(kHystartRttSamples * 1000, ackRound(hystart, 110ms));
+}
+
+} // namespace test
+} // namespace quic
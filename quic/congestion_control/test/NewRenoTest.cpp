@@ -209,6 +209,27 @@ TEST_F(NewRenoTest, PersistentCongestion) {
   EXPECT_TRUE(reno.inSlowStart());
 }
 
+TEST_F(NewRenoTest, SpuriousLossUndo) {
+  QuicServerConnectionState conn;
+  NewReno reno(conn);
+  EXPECT_TRUE(reno.inSlowStart());
+  auto originalCwnd = reno.getCongestionWindow();
+
+  conn.lossState.largestSent = 5;
+  reno.onPacketSent(createPacket(5, 10, Clock::now()));
+  reno.onPacketAckOrLoss(folly::none, createLossEvent({std::make_pair(5, 10)}));
+  EXPECT_FALSE(reno.inSlowStart());
+  EXPECT_LT(reno.getCongestionWindow(), originalCwnd);
+
+  reno.onSpuriousLoss();
+  EXPECT_TRUE(reno.inSlowStart());
+  EXPECT_EQ(originalCwnd, reno.getCongestionWindow());
+
+  // There is only one reduction to undo.
+  reno.onSpuriousLoss();
+  EXPECT_EQ(originalCwnd, reno.getCongestionWindow());
+}
+
 TEST_F(NewRenoTest, RemoveBytesWithoutLossOrAck) {
   QuicServerConnectionState conn;
   NewReno reno(conn);
@@ -222,5 +243,41 @@ TEST_F(NewRenoTest, RemoveBytesWithoutLossOrAck) {
   reno.onRemoveBytesFromInflight(2);
   EXPECT_EQ(reno.getWritableBytes(), originalWritableBytes - ackedSize + 2);
 }
+
+TEST_F(NewRenoTest, HystartPlusPlusExit) {
+  QuicServerConnectionState conn;
+  conn.udpSendPacketLen = 1000;
+  conn.transportSettings.hystartPlusPlus = true;
+  NewReno reno(conn);
+  reno.onPacketSent(createPacket(0, 1000000, Clock::now()));
+
+  PacketNum packetNum = 1;
+  auto now = Clock::now();
+  auto ackRound = [&](std::chrono::microseconds rtt, uint8_t acks) {
+    now += 1ms;
+    auto roundStart = now;
+    for (uint8_t i = 0; i < acks; i++) {
+      now += 1us;
+      auto ack = makeAck(packetNum++, 1000, now, roundStart);
+      ack.mrttSample = rtt;
+      reno.onPacketAckOrLoss(std::move(ack), folly::none);
+    }
+  };
+  ackRound(100ms, kHystartRttSamples);
+  auto cwnd = reno.getCongestionWindow();
+  // The rtt increase starts conservative slow start, which grows the cwnd by a
+  // quarter of the acked bytes.
+  ackRound(120ms, kHystartRttSamples);
+  EXPECT_TRUE(reno.inSlowStart());
+  EXPECT_EQ(
+      cwnd + (kHystartRttSamples - 1) * 1000 + 1000 / kHystartCssGrowthDivisor,
+      reno.getCongestionWindow());
+  for (uint8_t round = 1; round < kHystartCssRounds; round++) {
+    ackRound(120ms, kHystartRttSamples);
+  }
+  EXPECT_TRUE(reno.inSlowStart());
+  ackRound(120ms, 1);
+  EXPECT_FALSE(reno.inSlowStart());
+}
 } // namespace test
 } // namespace quic
@@ -158,6 +158,23 @@ TEST_F(PacerTest, AppLimited) {
   EXPECT_EQ(12, pacer.updateAndGetWriteBatchSize(Clock::now()));
 }
 
+TEST_F(PacerTest, PacketInterval) {
+  // Not paced before the first rate update
+  EXPECT_EQ(0ns, pacer.getPacketInterval());
+
+  pacer.setPacingRateCalculator([](const QuicConnectionStateBase&,
+                                   uint64_t,
+                                   uint64_t,
+                                   std::chrono::microseconds) {
+    return PacingRate::Builder().setInterval(1ms).setBurstSize(4).build();
+  });
+  pacer.refreshPacingRate(100, 100ms);
+  EXPECT_EQ(250us, pacer.getPacketInterval());
+
+  pacer.setAppLimited(true);
+  EXPECT_EQ(0ns, pacer.getPacketInterval());
+}
+
 TEST_F(PacerTest, Tokens) {
   // Pacer has tokens right after init:
   EXPECT_EQ(0us, pacer.getTimeUntilNextWrite());
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/PacingAccuracyObserver.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/state/test/MockQuicStats.h>
+#include <quic/state/test/Mocks.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+TimePoint mockNow;
+} // namespace
+
+using PacingRateError = QuicTransportStatsCallback::PacingRateError;
+
+class PacingAccuracyObserverTest : public Test {
+ public:
+  void SetUp() override {
+    mockNow = Clock::now();
+    conn.transportSettings.pacingObserverInterval = 100ms;
+    conn.transportSettings.pacingTimerTickInterval = 1ms;
+    conn.infoCallback = &stats;
+    auto pacer = std::make_unique<NiceMock<MockPacer>>();
+    rawPacer = pacer.get();
+    ON_CALL(*rawPacer, getPacketInterval()).WillByDefault(Return(1ms));
+    observer = std::make_unique<PacingAccuracyObserver>(
+        conn, std::move(pacer), [] { return mockNow; });
+  }
+
+  // Sends packets back to back, every gap, for as long as the interval.
+  void sendBursts(uint64_t packets, std::chrono::milliseconds gap) {
+    auto intervalEnd = mockNow + conn.transportSettings.pacingObserverInterval;
+    while (mockNow < intervalEnd) {
+      for (uint64_t i = 0; i < packets; i++) {
+        observer->onPacketSent();
+      }
+      mockNow += gap;
+    }
+  }
+
+ protected:
+  QuicConnectionStateBase conn{QuicNodeType::Server};
+  MockQuicStats stats;
+  MockPacer* rawPacer;
+  std::unique_ptr<PacingAccuracyObserver> observer;
+};
+
+TEST_F(PacingAccuracyObserverTest, ReportsEachInterval) {
+  observer->refreshPacingRate(100000, 10ms);
+  // One packet per ms, sent in bursts of 10.
+  EXPECT_CALL(stats, onPacingInterval(_, _)).Times(0);
+  sendBursts(10, 10ms);
+  Mock::VerifyAndClearExpectations(&stats);
+
+  EXPECT_CALL(stats, onPacingInterval(PacingRateError::ON_RATE, 10));
+  observer->refreshPacingRate(100000, 10ms);
+  Mock::VerifyAndClearExpectations(&stats);
+
+  // Fewer packets, in bursts of 25.
+  EXPECT_CALL(stats, onPacingInterval(PacingRateError::BELOW, 25));
+  sendBursts(25, 40ms);
+  observer->refreshPacingRate(100000, 10ms);
+}
+
+TEST_F(PacingAccuracyObserverTest, AppLimitedNotReported) {
+  observer->refreshPacingRate(100000, 10ms);
+  EXPECT_CALL(stats, onPacingInterval(_, _)).Times(0);
+  observer->onPacketSent();
+  mockNow += 50ms;
+  // The pacer doesn't pace while app limited.
+  EXPECT_CALL(*rawPacer, getPacketInterval()).WillRepeatedly(Return(0ns));
+  observer->setAppLimited(true);
+  mockNow += 50ms;
+  observer->refreshPacingRate(100000, 10ms);
+  Mock::VerifyAndClearExpectations(&stats);
+
+  // The next interval is paced throughout.
+  EXPECT_CALL(*rawPacer, getPacketInterval()).WillRepeatedly(Return(1ms));
+  observer->setAppLimited(false);
+  EXPECT_CALL(stats, onPacingInterval(PacingRateError::FAR_ABOVE, 20));
+  sendBursts(20, 10ms);
+  observer->refreshPacingRate(100000, 10ms);
+}
+
+TEST_F(PacingAccuracyObserverTest, RateErrors) {
+  EXPECT_EQ(
+      PacingRateError::FAR_BELOW, PacingAccuracyObserver::rateError(40, 100));
+  EXPECT_EQ(PacingRateError::BELOW, PacingAccuracyObserver::rateError(80, 100));
+  EXPECT_EQ(
+      PacingRateError::ON_RATE, PacingAccuracyObserver::rateError(105, 100));
+  EXPECT_EQ(
+      PacingRateError::ABOVE, PacingAccuracyObserver::rateError(120, 100));
+  EXPECT_EQ(
+      PacingRateError::FAR_ABOVE, PacingAccuracyObserver::rateError(200, 100));
+}
+
+TEST_F(PacingAccuracyObserverTest, Sampling) {
+  auto pacer = std::make_unique<MockPacer>();
+  auto rawPacer = pacer.get();
+  EXPECT_EQ(rawPacer, maybeObservePacer(conn, std::move(pacer)).get());
+  conn.transportSettings.pacingObserverSampleRate = 1;
+  auto observed = maybeObservePacer(conn, std::make_unique<MockPacer>());
+  EXPECT_NE(nullptr, dynamic_cast<PacingAccuracyObserver*>(observed.get()));
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/TokenBucketPacer.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/congestion_control/Pacer.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class TokenBucketPacerTest : public Test {
+ public:
+  void SetUp() override {
+    conn.udpSendPacketLen = 1000;
+    conn.transportSettings.minBurstPackets = 4;
+    conn.transportSettings.pacingTimerTickInterval = 1ms;
+  }
+
+  void send(uint64_t packets) {
+    for (uint64_t i = 0; i < packets; i++) {
+      pacer.onPacketSent();
+    }
+  }
+
+ protected:
+  QuicConnectionStateBase conn{QuicNodeType::Client};
+  TokenBucketPacer pacer{conn};
+};
+
+TEST_F(TokenBucketPacerTest, NotPacedWithoutRate) {
+  EXPECT_EQ(
+      conn.transportSettings.writeConnectionDataPacketsLimit,
+      pacer.updateAndGetWriteBatchSize(Clock::now()));
+  EXPECT_EQ(0us, pacer.getTimeUntilNextWrite());
+  EXPECT_EQ(0ns, pacer.getPacketInterval());
+}
+
+TEST_F(TokenBucketPacerTest, BurstThenWait) {
+  // 1000 bytes per ms.
+  pacer.refreshPacingRate(100000, 100ms);
+  EXPECT_DOUBLE_EQ(1000000, pacer.getPacingRate());
+  EXPECT_EQ(1ms, pacer.getPacketInterval());
+  EXPECT_EQ(4, pacer.getCachedWriteBatchSize());
+  auto now = Clock::now();
+  EXPECT_EQ(4, pacer.updateAndGetWriteBatchSize(now));
+  send(4);
+  EXPECT_EQ(4ms, pacer.getTimeUntilNextWrite());
+  EXPECT_EQ(0, pacer.updateAndGetWriteBatchSize(now + 500us));
+  EXPECT_EQ(3, pacer.updateAndGetWriteBatchSize(now + 3500us));
+  send(3);
+  // Half a packet of credit is left.
+  EXPECT_EQ(3500us, pacer.getTimeUntilNextWrite());
+  EXPECT_EQ(1, pacer.updateAndGetWriteBatchSize(now + 4us + 4ms));
+}
+
+TEST_F(TokenBucketPacerTest, FractionalCredit) {
+  // 1 byte per us, refilled in steps far smaller than a packet.
+  pacer.refreshPacingRate(100000, 100ms);
+  auto now = Clock::now();
+  pacer.updateAndGetWriteBatchSize(now);
+  send(4);
+  for (int i = 1; i < 1000; i++) {
+    EXPECT_EQ(0, pacer.updateAndGetWriteBatchSize(now + i * 1us));
+  }
+  EXPECT_EQ(1, pacer.updateAndGetWriteBatchSize(now + 1000us));
+}
+
+TEST_F(TokenBucketPacerTest, IdleDoesNotBuildUpCredit) {
+  pacer.refreshPacingRate(100000, 100ms);
+  auto now = Clock::now();
+  pacer.updateAndGetWriteBatchSize(now);
+  send(4);
+  EXPECT_EQ(4, pacer.updateAndGetWriteBatchSize(now + 1s));
+}
+
+TEST_F(TokenBucketPacerTest, HighRate) {
+  // 100 Gbps, a packet every 80ns.
+  pacer.refreshPacingRate(12500000000, 1s);
+  EXPECT_EQ(80ns, pacer.getPacketInterval());
+  auto now = Clock::now();
+  uint64_t sent = 0;
+  for (int tick = 0; tick <= 100; tick++) {
+    auto packets = pacer.updateAndGetWriteBatchSize(now + tick * 1ms);
+    send(packets);
+    sent += packets;
+  }
+  // What accrued in 100 ticks, plus the initial bucket of one tick.
+  EXPECT_EQ(101 * 12500, sent);
+}
+
+TEST_F(TokenBucketPacerTest, LossDropsCredit) {
+  pacer.refreshPacingRate(100000, 100ms);
+  auto now = Clock::now();
+  EXPECT_EQ(4, pacer.updateAndGetWriteBatchSize(now));
+  pacer.onPacketsLoss();
+  send(1);
+  pacer.onPacketsLoss();
+  EXPECT_EQ(0, pacer.updateAndGetWriteBatchSize(now + 1ms));
+  EXPECT_EQ(1, pacer.updateAndGetWriteBatchSize(now + 2ms));
+}
+
+TEST_F(TokenBucketPacerTest, AppLimited) {
+  pacer.refreshPacingRate(100000, 100ms);
+  auto now = Clock::now();
+  pacer.updateAndGetWriteBatchSize(now);
+  send(4);
+  pacer.setAppLimited(true);
+  EXPECT_EQ(0us, pacer.getTimeUntilNextWrite());
+  EXPECT_EQ(
+      conn.transportSettings.writeConnectionDataPacketsLimit,
+      pacer.updateAndGetWriteBatchSize(now));
+  // Back to a full bucket after being app limited.
+  pacer.setAppLimited(false);
+  EXPECT_EQ(4, pacer.updateAndGetWriteBatchSize(now));
+}
+
+TEST_F(TokenBucketPacerTest, MakePacer) {
+  EXPECT_NE(
+      nullptr,
+      dynamic_cast<DefaultPacer*>(
+          makePacer(conn, conn.transportSettings.minCwndInMss).get()));
+  conn.transportSettings.tokenBucketPacing = true;
+  EXPECT_NE(
+      nullptr,
+      dynamic_cast<TokenBucketPacer*>(
+          makePacer(conn, conn.transportSettings.minCwndInMss).get()));
+}
+
+} // namespace test
+} // namespace quic
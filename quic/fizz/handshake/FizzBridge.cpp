@@ -8,6 +8,8 @@
 
 #include <quic/fizz/handshake/FizzBridge.h>
 
+#include <quic/handshake/HandshakeLayer.h>
+
 namespace quic {
 
 EncryptionLevel getEncryptionLevelFromFizz(
@@ -26,4 +28,18 @@ EncryptionLevel getEncryptionLevelFromFizz(
   folly::assume_unreachable();
 }
 
+std::vector<uint8_t> deriveNextKeyPhaseSecret(
+    const fizz::Factory& factory,
+    fizz::CipherSuite cipher,
+    folly::ByteRange secret) {
+  auto deriver = factory.makeKeyDeriver(cipher);
+  auto nextSecret = deriver->expandLabel(
+      secret,
+      kQuicKeyUpdateLabel,
+      folly::IOBuf::create(0),
+      deriver->hashLength());
+  auto range = nextSecret->coalesce();
+  return std::vector<uint8_t>(range.begin(), range.end());
+}
+
 } // namespace quic
@@ -9,12 +9,14 @@
 #pragma once
 
 #include <fizz/crypto/aead/Aead.h>
+#include <fizz/protocol/Factory.h>
 #include <fizz/protocol/Types.h>
 #include <quic/QuicConstants.h>
 #include <quic/handshake/Aead.h>
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 namespace quic {
 
@@ -68,4 +70,12 @@ class FizzAead final : public Aead {
 EncryptionLevel getEncryptionLevelFromFizz(
     const fizz::EncryptionLevel encryptionLevel);
 
+/**
+ * The 1-RTT traffic secret of the next key phase, from the current one.
+ */
+std::vector<uint8_t> deriveNextKeyPhaseSecret(
+    const fizz::Factory& factory,
+    fizz::CipherSuite cipher,
+    folly::ByteRange secret);
+
 } // namespace quic
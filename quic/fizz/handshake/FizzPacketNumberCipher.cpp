@@ -8,6 +8,8 @@
 
 #include <quic/fizz/handshake/FizzPacketNumberCipher.h>
 
+#include <folly/Conv.h>
+
 namespace quic {
 
 static void setKeyImpl(
@@ -43,6 +45,34 @@ static HeaderProtectionMask maskImpl(
   return outMask;
 }
 
+static void batchMaskImpl(
+    const folly::ssl::EvpCipherCtxUniquePtr& context,
+    const std::vector<Sample>& samples,
+    std::vector<HeaderProtectionMask>& masks) {
+  static_assert(
+      sizeof(Sample) == sizeof(HeaderProtectionMask) &&
+          sizeof(Sample) == std::tuple_size<Sample>::value,
+      "Samples and masks must be laid out as contiguous AES blocks");
+  masks.resize(samples.size());
+  if (samples.empty()) {
+    return;
+  }
+  // The cipher is in ECB mode, so the samples can be handed to it as one
+  // run of blocks. This lets the AES implementation pipeline the blocks
+  // rather than doing one round trip through EVP per packet.
+  int inLen = folly::to<int>(samples.size() * sizeof(Sample));
+  int outLen = 0;
+  if (EVP_EncryptUpdate(
+          context.get(),
+          masks.front().data(),
+          &outLen,
+          samples.front().data(),
+          inLen) != 1 ||
+      outLen != inLen) {
+    throw std::runtime_error("Encryption error");
+  }
+}
+
 void Aes128PacketNumberCipher::setKey(folly::ByteRange key) {
   return setKeyImpl(encryptCtx_, EVP_aes_128_ecb(), key);
 }
@@ -61,6 +91,18 @@ HeaderProtectionMask Aes256PacketNumberCipher::mask(
   return maskImpl(encryptCtx_, sample);
 }
 
+void Aes128PacketNumberCipher::batchMask(
+    const std::vector<Sample>& samples,
+    std::vector<HeaderProtectionMask>& masks) const {
+  batchMaskImpl(encryptCtx_, samples, masks);
+}
+
+void Aes256PacketNumberCipher::batchMask(
+    const std::vector<Sample>& samples,
+    std::vector<HeaderProtectionMask>& masks) const {
+  batchMaskImpl(encryptCtx_, samples, masks);
+}
+
 constexpr size_t kAES128KeyLength = 16;
 
 size_t Aes128PacketNumberCipher::keyLength() const {
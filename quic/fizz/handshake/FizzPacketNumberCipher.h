@@ -22,6 +22,10 @@ class Aes128PacketNumberCipher : public PacketNumberCipher {
 
   HeaderProtectionMask mask(folly::ByteRange sample) const override;
 
+  void batchMask(
+      const std::vector<Sample>& samples,
+      std::vector<HeaderProtectionMask>& masks) const override;
+
   size_t keyLength() const override;
 
  private:
@@ -36,6 +40,10 @@ class Aes256PacketNumberCipher : public PacketNumberCipher {
 
   HeaderProtectionMask mask(folly::ByteRange sample) const override;
 
+  void batchMask(
+      const std::vector<Sample>& samples,
+      std::vector<HeaderProtectionMask>& masks) const override;
+
   size_t keyLength() const override;
 
  private:
@@ -89,6 +89,42 @@ TEST_P(LongPacketNumberCipherTest, TestEncryptDecrypt) {
       GetParam().decryptedPacketNumberBytes);
 }
 
+TEST_P(LongPacketNumberCipherTest, TestBatchMaskMatchesMask) {
+  FizzCryptoFactory cryptoFactory;
+  auto cipher = cryptoFactory.makePacketNumberCipher(GetParam().cipher);
+  auto key = folly::unhexlify(GetParam().key);
+  cipher->setKey(folly::range(key));
+  std::vector<Sample> samples;
+  for (uint8_t i = 0; i < 10; ++i) {
+    auto sample = hexToBytes<SampleBytes>(GetParam().sample);
+    sample[0] ^= i;
+    samples.push_back(sample);
+  }
+  std::vector<HeaderProtectionMask> masks;
+  cipher->batchMask(samples, masks);
+  ASSERT_EQ(masks.size(), samples.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    EXPECT_EQ(masks[i], cipher->mask(folly::range(samples[i])));
+  }
+
+  CipherBytes cipherBytes(
+      GetParam().sample,
+      GetParam().decryptedInitialByte,
+      GetParam().decryptedPacketNumberBytes);
+  cipher->batchMask({cipherBytes.sample}, masks);
+  ASSERT_EQ(masks.size(), 1);
+  cipher->encryptLongHeaderWithMask(
+      masks[0],
+      folly::range(cipherBytes.initial),
+      folly::range(cipherBytes.packetNumber));
+  EXPECT_EQ(folly::hexlify(cipherBytes.initial), GetParam().initialByte);
+  EXPECT_EQ(
+      folly::hexlify(cipherBytes.packetNumber), GetParam().packetNumberBytes);
+
+  cipher->batchMask({}, masks);
+  EXPECT_TRUE(masks.empty());
+}
+
 INSTANTIATE_TEST_CASE_P(
     LongPacketNumberCipherTests,
     LongPacketNumberCipherTest,
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/InitialCipherCache.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/fizz/handshake/FizzCryptoFactory.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class InitialCipherCacheTest : public Test {
+ public:
+  FizzCryptoFactory cryptoFactory_;
+  InitialCipherCache cache_{2};
+};
+
+TEST_F(InitialCipherCacheTest, SameConnectionIdShares) {
+  auto connId = getTestConnectionId(1);
+  const auto& ciphers =
+      cache_.getCiphers(cryptoFactory_, connId, QuicVersion::MVFST);
+  auto clientCipher = ciphers.clientCipher;
+  EXPECT_EQ(
+      clientCipher,
+      cache_.getCiphers(cryptoFactory_, connId, QuicVersion::MVFST)
+          .clientCipher);
+  EXPECT_EQ(1, cache_.size());
+  EXPECT_NE(
+      clientCipher,
+      cache_.getCiphers(cryptoFactory_, connId, QuicVersion::QUIC_DRAFT)
+          .clientCipher);
+  EXPECT_EQ(2, cache_.size());
+}
+
+TEST_F(InitialCipherCacheTest, EvictsLeastRecentlyUsed) {
+  auto connId1 = getTestConnectionId(1);
+  auto connId2 = getTestConnectionId(2);
+  auto clientCipher1 =
+      cache_.getCiphers(cryptoFactory_, connId1, QuicVersion::MVFST)
+          .clientCipher;
+  cache_.getCiphers(cryptoFactory_, connId2, QuicVersion::MVFST);
+  cache_.getCiphers(cryptoFactory_, connId1, QuicVersion::MVFST);
+  cache_.getCiphers(cryptoFactory_, getTestConnectionId(3), QuicVersion::MVFST);
+  EXPECT_EQ(2, cache_.size());
+  EXPECT_EQ(
+      clientCipher1,
+      cache_.getCiphers(cryptoFactory_, connId1, QuicVersion::MVFST)
+          .clientCipher);
+}
+
+TEST_F(InitialCipherCacheTest, SharedCiphersMatchDerived) {
+  auto connId = getTestConnectionId(1);
+  const auto& ciphers =
+      cache_.getCiphers(cryptoFactory_, connId, QuicVersion::MVFST);
+  auto sharedCipher = makeSharedAead(ciphers.clientCipher);
+  auto derivedCipher =
+      cryptoFactory_.getClientInitialCipher(connId, QuicVersion::MVFST);
+  auto plaintext = folly::IOBuf::copyBuffer("initial");
+  auto ciphertext = sharedCipher->encrypt(plaintext->clone(), nullptr, 0);
+  auto decrypted = derivedCipher->tryDecrypt(std::move(ciphertext), nullptr, 0);
+  ASSERT_TRUE(decrypted.has_value());
+  EXPECT_TRUE(folly::IOBufEqualTo()(*plaintext, **decrypted));
+
+  auto sharedHeaderCipher =
+      makeSharedPacketNumberCipher(ciphers.serverHeaderCipher);
+  auto derivedHeaderCipher =
+      cryptoFactory_.makeServerInitialHeaderCipher(connId, QuicVersion::MVFST);
+  Sample sample{};
+  EXPECT_EQ(
+      derivedHeaderCipher->mask(folly::range(sample)),
+      sharedHeaderCipher->mask(folly::range(sample)));
+}
+
+} // namespace test
+} // namespace quic
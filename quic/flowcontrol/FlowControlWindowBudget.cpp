@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/flowcontrol/FlowControlWindowBudget.h>
+#include <quic/QuicConstants.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace quic {
+
+FlowControlWindowBudget::FlowControlWindowBudget(
+    uint64_t budgetBytes,
+    uint64_t bufferLimitBytes)
+    : budgetBytes_(budgetBytes), bufferLimitBytes_(bufferLimitBytes) {}
+
+uint64_t FlowControlWindowBudget::acquire(uint64_t bytes) noexcept {
+  auto acquired = std::min(bytes, available());
+  usedBytes_ += acquired;
+  return acquired;
+}
+
+void FlowControlWindowBudget::release(uint64_t bytes) noexcept {
+  DCHECK_LE(bytes, usedBytes_);
+  usedBytes_ -= std::min(bytes, usedBytes_);
+}
+
+uint64_t FlowControlWindowBudget::available() const noexcept {
+  return budgetBytes_ - usedBytes_;
+}
+
+void FlowControlWindowBudget::updateBufferedBytes(
+    uint64_t previous,
+    uint64_t current) noexcept {
+  DCHECK_LE(previous, bufferedBytes_);
+  bufferedBytes_ -= std::min(previous, bufferedBytes_);
+  bufferedBytes_ += current;
+  if (previous == 0 && current > 0) {
+    bufferingConnections_++;
+  } else if (previous > 0 && current == 0) {
+    DCHECK_GT(bufferingConnections_, 0);
+    bufferingConnections_--;
+  }
+}
+
+uint64_t FlowControlWindowBudget::bufferedBytes() const noexcept {
+  return bufferedBytes_;
+}
+
+bool FlowControlWindowBudget::bufferLimitTight() const noexcept {
+  return bufferLimitBytes_ > 0 && bufferedBytes_ > bufferLimitBytes_ / 2;
+}
+
+uint64_t FlowControlWindowBudget::limitWindowSize(
+    uint64_t windowSize,
+    uint64_t connBufferedBytes) const noexcept {
+  if (!bufferLimitTight()) {
+    return windowSize;
+  }
+  auto minWindowSize = std::min(windowSize, kMinBufferLimitedWindowSize);
+  if (bufferingConnections_ > 0 &&
+      connBufferedBytes > bufferLimitBytes_ / bufferingConnections_) {
+    return minWindowSize;
+  }
+  auto tightBytes = bufferLimitBytes_ - bufferLimitBytes_ / 2;
+  auto leftBytes = bufferedBytes_ < bufferLimitBytes_
+      ? bufferLimitBytes_ - bufferedBytes_
+      : 0;
+  auto windowLeft = static_cast<uint64_t>(
+      windowSize * (static_cast<double>(leftBytes) / tightBytes));
+  return std::max(windowLeft, minWindowSize);
+}
+
+} // namespace quic
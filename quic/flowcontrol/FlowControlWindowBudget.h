@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace quic {
+
+/**
+ * Bytes the auto tuned connection receive windows of a server worker can
+ * grow by in total, beyond their initial size. A connection holds what its
+ * window grew by until it closes.
+ *
+ * Optionally also a limit on the bytes the connections hold received and not
+ * read by the application yet in total. Once they buffer more than half of
+ * it, windows stop growing and shrink with what is left of the limit, so that
+ * a few slow readers can't pin the memory of the whole worker. Not thread
+ * safe, shared by the connections of one evb.
+ */
+class FlowControlWindowBudget {
+ public:
+  explicit FlowControlWindowBudget(
+      uint64_t budgetBytes = std::numeric_limits<uint64_t>::max(),
+      uint64_t bufferLimitBytes = 0);
+
+  /**
+   * Takes up to bytes out of the budget, returns how many it took.
+   */
+  uint64_t acquire(uint64_t bytes) noexcept;
+
+  void release(uint64_t bytes) noexcept;
+
+  uint64_t available() const noexcept;
+
+  /**
+   * Tracks the bytes buffered for reads, from what a connection had buffered
+   * before and after a change.
+   */
+  void updateBufferedBytes(uint64_t previous, uint64_t current) noexcept;
+
+  uint64_t bufferedBytes() const noexcept;
+
+  /**
+   * Whether the connections buffer more than half of the limit.
+   */
+  bool bufferLimitTight() const noexcept;
+
+  /**
+   * The receive window a connection that buffers connBufferedBytes gets to
+   * advertise instead of windowSize. While the limit is tight the windows
+   * shrink with what is left of it, and those of the connections buffering
+   * more than an even share of it drop to kMinBufferLimitedWindowSize.
+   */
+  uint64_t limitWindowSize(uint64_t windowSize, uint64_t connBufferedBytes)
+      const noexcept;
+
+ private:
+  uint64_t budgetBytes_;
+  uint64_t usedBytes_{0};
+  uint64_t bufferLimitBytes_;
+  uint64_t bufferedBytes_{0};
+  // Connections with bytes buffered
+  uint64_t bufferingConnections_{0};
+};
+
+} // namespace quic
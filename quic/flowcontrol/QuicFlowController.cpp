@@ -9,6 +9,7 @@
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
+#include <quic/flowcontrol/FlowControlWindowBudget.h>
 #include <quic/logging/QLogger.h>
 #include <quic/logging/QuicLogger.h>
 #include <limits>
@@ -25,8 +26,9 @@ folly::Optional<uint64_t> calculateNewWindowUpdate(
     const TimePoint& updateTime) {
   DCHECK_LE(curReadOffset, curAdvertisedOffset);
   auto nextAdvertisedOffset = curReadOffset + windowSize;
-  if (nextAdvertisedOffset == curAdvertisedOffset) {
-    // No change in flow control
+  if (nextAdvertisedOffset <= curAdvertisedOffset) {
+    // No change in flow control, or a limited window that doesn't reach past
+    // what was advertised already.
     return folly::none;
   }
   bool enoughTimeElapsed = lastSendTime && updateTime > *lastSendTime &&
@@ -44,6 +46,86 @@ folly::Optional<uint64_t> calculateNewWindowUpdate(
   return folly::none;
 }
 
+/**
+ * The window doubled, up to maxWindowSize, if the application read enough of
+ * it for an update before flowControlRttFrequency * srtt passed since the
+ * last one, i.e. faster than the window lets the peer send.
+ */
+uint64_t autoTunedWindowSize(
+    uint64_t curReadOffset,
+    uint64_t curAdvertisedOffset,
+    uint64_t windowSize,
+    uint64_t maxWindowSize,
+    const std::chrono::microseconds& srtt,
+    const TransportSettings& transportSettings,
+    const folly::Optional<TimePoint>& lastSendTime,
+    const TimePoint& updateTime) {
+  if (!transportSettings.autoTuneFlowControlWindows ||
+      windowSize >= maxWindowSize || srtt == 0us || !lastSendTime ||
+      updateTime <= *lastSendTime) {
+    return windowSize;
+  }
+  DCHECK_LE(curReadOffset, curAdvertisedOffset);
+  bool enoughWindowElapsed = (curAdvertisedOffset - curReadOffset) *
+          transportSettings.flowControlWindowFrequency <
+      windowSize;
+  if (!enoughWindowElapsed ||
+      updateTime - *lastSendTime >=
+          transportSettings.flowControlRttFrequency * srtt) {
+    return windowSize;
+  }
+  return std::min(windowSize * 2, maxWindowSize);
+}
+
+bool canGrowWindows(const QuicConnectionStateBase& conn) {
+  return !conn.flowControlWindowBudget ||
+      !conn.flowControlWindowBudget->bufferLimitTight();
+}
+
+/**
+ * The window to advertise instead of windowSize, given the receive buffer
+ * limit of the worker.
+ */
+uint64_t limitWindowSize(
+    const QuicConnectionStateBase& conn,
+    uint64_t windowSize) {
+  if (!conn.flowControlWindowBudget) {
+    return windowSize;
+  }
+  return conn.flowControlWindowBudget->limitWindowSize(
+      windowSize, conn.flowControlState.budgetedBufferedBytes);
+}
+
+void updateBufferedBytes(QuicConnectionStateBase& conn) {
+  if (!conn.flowControlWindowBudget) {
+    return;
+  }
+  auto& flowControlState = conn.flowControlState;
+  // The read offset of a stream goes one past its FIN.
+  auto bufferedBytes =
+      flowControlState.sumMaxObservedOffset > flowControlState.sumCurReadOffset
+      ? flowControlState.sumMaxObservedOffset -
+          flowControlState.sumCurReadOffset
+      : 0;
+  conn.flowControlWindowBudget->updateBufferedBytes(
+      flowControlState.budgetedBufferedBytes, bufferedBytes);
+  flowControlState.budgetedBufferedBytes = bufferedBytes;
+}
+
+void growConnWindow(QuicConnectionStateBase& conn, uint64_t windowSize) {
+  auto& flowControlState = conn.flowControlState;
+  if (windowSize <= flowControlState.windowSize || !canGrowWindows(conn)) {
+    return;
+  }
+  auto growth = windowSize - flowControlState.windowSize;
+  if (conn.flowControlWindowBudget) {
+    growth = conn.flowControlWindowBudget->acquire(growth);
+    flowControlState.budgetedWindowBytes += growth;
+  }
+  flowControlState.windowSize += growth;
+  VLOG(4) << "Auto tuned conn window=" << flowControlState.windowSize;
+}
+
 template <typename T>
 inline void incrementWithOverFlowCheck(T& num, T diff) {
   if (num > std::numeric_limits<T>::max() - diff) {
@@ -53,9 +135,26 @@ inline void incrementWithOverFlowCheck(T& num, T diff) {
   num += diff;
 }
 
+/**
+ * Whether the window update of the stream needs to go out right away, rather
+ * than with the next packet written for anything else.
+ */
+bool isUrgentWindowUpdate(const QuicStreamState& stream) {
+  if (!stream.conn.transportSettings.coalesceStreamWindowUpdates) {
+    return true;
+  }
+  const auto& flowControlState = stream.flowControlState;
+  auto peerWindow =
+      flowControlState.advertisedMaxOffset > stream.maxOffsetObserved
+      ? flowControlState.advertisedMaxOffset - stream.maxOffsetObserved
+      : 0;
+  return peerWindow * kUrgentWindowUpdateDivisor < flowControlState.windowSize;
+}
+
 inline uint64_t calculateMaximumData(const QuicStreamState& stream) {
   return std::max(
-      stream.currentReadOffset + stream.flowControlState.windowSize,
+      stream.currentReadOffset +
+          limitWindowSize(stream.conn, stream.flowControlState.windowSize),
       stream.flowControlState.advertisedMaxOffset);
 }
 } // namespace
@@ -69,10 +168,21 @@ bool maybeSendConnWindowUpdate(
     return false;
   }
   auto& flowControlState = conn.flowControlState;
+  growConnWindow(
+      conn,
+      autoTunedWindowSize(
+          flowControlState.sumCurReadOffset,
+          flowControlState.advertisedMaxOffset,
+          flowControlState.windowSize,
+          conn.transportSettings.maxAutoTunedConnectionWindowSize,
+          conn.lossState.srtt,
+          conn.transportSettings,
+          flowControlState.timeOfLastFlowControlUpdate,
+          updateTime));
   auto newAdvertisedOffset = calculateNewWindowUpdate(
       flowControlState.sumCurReadOffset,
       flowControlState.advertisedMaxOffset,
-      flowControlState.windowSize,
+      limitWindowSize(conn, flowControlState.windowSize),
       conn.lossState.srtt,
       conn.transportSettings,
       flowControlState.timeOfLastFlowControlUpdate,
@@ -100,10 +210,29 @@ bool maybeSendStreamWindowUpdate(
   if (stream.conn.streamManager->pendingWindowUpdate(stream.id)) {
     return false;
   }
-  auto newAdvertisedOffset = calculateNewWindowUpdate(
+  auto windowSize = autoTunedWindowSize(
       stream.currentReadOffset,
       flowControlState.advertisedMaxOffset,
       flowControlState.windowSize,
+      stream.conn.transportSettings.maxAutoTunedStreamWindowSize,
+      stream.conn.lossState.srtt,
+      stream.conn.transportSettings,
+      flowControlState.timeOfLastFlowControlUpdate,
+      updateTime);
+  if (windowSize > flowControlState.windowSize &&
+      canGrowWindows(stream.conn)) {
+    flowControlState.windowSize = windowSize;
+    VLOG(4) << "Auto tuned window=" << windowSize << " stream=" << stream.id;
+    growConnWindow(
+        stream.conn,
+        std::min<uint64_t>(
+            windowSize * kAutoTunedConnectionToStreamWindowRatio,
+            stream.conn.transportSettings.maxAutoTunedConnectionWindowSize));
+  }
+  auto newAdvertisedOffset = calculateNewWindowUpdate(
+      stream.currentReadOffset,
+      flowControlState.advertisedMaxOffset,
+      limitWindowSize(stream.conn, flowControlState.windowSize),
       stream.conn.lossState.srtt,
       stream.conn.transportSettings,
       flowControlState.timeOfLastFlowControlUpdate,
@@ -111,7 +240,8 @@ bool maybeSendStreamWindowUpdate(
   if (newAdvertisedOffset) {
     VLOG(10) << "Queued flow control update for stream=" << stream.id
              << " offset=" << *newAdvertisedOffset;
-    stream.conn.streamManager->queueWindowUpdate(stream.id);
+    stream.conn.streamManager->queueWindowUpdate(
+        stream.id, isUrgentWindowUpdate(stream));
     QUIC_STATS(stream.conn.infoCallback, onStreamFlowControlUpdate);
     return true;
   }
@@ -142,6 +272,7 @@ void updateFlowControlOnStreamData(
   incrementWithOverFlowCheck(
       connFlowControlState.sumMaxObservedOffset,
       curMaxOffsetObserved - previousMaxOffsetObserved);
+  updateBufferedBytes(stream.conn);
 }
 
 void updateFlowControlOnRead(
@@ -152,6 +283,7 @@ void updateFlowControlOnRead(
   auto diff = stream.currentReadOffset - lastReadOffset;
   incrementWithOverFlowCheck(
       stream.conn.flowControlState.sumCurReadOffset, diff);
+  updateBufferedBytes(stream.conn);
   if (maybeSendConnWindowUpdate(stream.conn, readTime)) {
     VLOG(4) << "Read trigger conn window update "
             << " readOffset=" << stream.conn.flowControlState.sumCurReadOffset
@@ -189,6 +321,20 @@ void updateFlowControlOnWriteToSocket(
   }
 }
 
+void updateFlowControlOnNewDataWritten(
+    QuicStreamState& stream,
+    uint64_t length) {
+  updateFlowControlOnWriteToSocket(stream, length);
+  updateUnackedBufferOnWriteToSocket(stream, length);
+  // A stream with writable data left still has flow control to write it.
+  if (stream.hasWritableData() && !stream.streamWriteError.has_value()) {
+    stream.conn.streamManager->addWritable(stream);
+  } else {
+    maybeWriteBlockAfterSocketWrite(stream);
+    stream.conn.streamManager->removeWritable(stream);
+  }
+}
+
 void updateFlowControlOnWriteToStream(
     QuicStreamState& stream,
     uint64_t length) {
@@ -196,6 +342,23 @@ void updateFlowControlOnWriteToStream(
       stream.conn.flowControlState.sumCurStreamBufferLen, length);
 }
 
+void updateUnackedBufferOnWriteToSocket(
+    QuicStreamState& stream,
+    uint64_t length) {
+  incrementWithOverFlowCheck(stream.unackedBufferLen, length);
+  incrementWithOverFlowCheck(
+      stream.conn.flowControlState.sumUnackedStreamBufferLen, length);
+}
+
+void updateUnackedBufferOnRelease(QuicStreamState& stream, uint64_t length) {
+  // Only release what was accounted for on the way out, the buffers of a
+  // stream may also have been filled directly.
+  auto released = std::min(stream.unackedBufferLen, length);
+  DCHECK_GE(stream.conn.flowControlState.sumUnackedStreamBufferLen, released);
+  stream.unackedBufferLen -= released;
+  stream.conn.flowControlState.sumUnackedStreamBufferLen -= released;
+}
+
 void maybeWriteBlockAfterAPIWrite(QuicStreamState& stream) {
   // Only write blocked when stream becomes blocked
   if (getSendStreamFlowControlBytesWire(stream) == 0 &&
@@ -388,6 +551,17 @@ void onStreamWindowUpdateSent(
   VLOG(4) << "sent window for stream=" << stream.id;
 }
 
+void releaseFlowControlWindowBudget(QuicConnectionStateBase& conn) {
+  auto& flowControlState = conn.flowControlState;
+  if (conn.flowControlWindowBudget) {
+    conn.flowControlWindowBudget->release(flowControlState.budgetedWindowBytes);
+    conn.flowControlWindowBudget->updateBufferedBytes(
+        flowControlState.budgetedBufferedBytes, 0);
+  }
+  flowControlState.budgetedWindowBytes = 0;
+  flowControlState.budgetedBufferedBytes = 0;
+}
+
 void onConnWindowUpdateLost(QuicConnectionStateBase& conn) {
   conn.pendingEvents.connWindowUpdate = true;
   VLOG(4) << "Loss triggered conn window update";
@@ -397,7 +571,8 @@ void onStreamWindowUpdateLost(QuicStreamState& stream) {
   if (!stream.shouldSendFlowControl()) {
     return;
   }
-  stream.conn.streamManager->queueWindowUpdate(stream.id);
+  stream.conn.streamManager->queueWindowUpdate(
+      stream.id, isUrgentWindowUpdate(stream));
   VLOG(4) << "Loss triggered stream window update stream=" << stream.id;
 }
 
@@ -420,7 +595,8 @@ void updateFlowControlStateWithSettings(
 
 MaxDataFrame generateMaxDataFrame(const QuicConnectionStateBase& conn) {
   return MaxDataFrame(std::max(
-      conn.flowControlState.sumCurReadOffset + conn.flowControlState.windowSize,
+      conn.flowControlState.sumCurReadOffset +
+          limitWindowSize(conn, conn.flowControlState.windowSize),
       conn.flowControlState.advertisedMaxOffset));
 }
 
@@ -38,6 +38,25 @@ void updateFlowControlOnWriteToSocket(QuicStreamState& stream, uint64_t length);
 
 void updateFlowControlOnWriteToStream(QuicStreamState& stream, uint64_t length);
 
+/**
+ * The bookkeeping for new stream data written to the socket in one step: the
+ * connection flow control, the unacked buffers, the blocked state and whether
+ * the stream stays writable.
+ */
+void updateFlowControlOnNewDataWritten(
+    QuicStreamState& stream,
+    uint64_t length);
+
+/**
+ * Accounts for stream data that moved from the write buffer into the buffers
+ * kept for retransmission, and for data those buffers released.
+ */
+void updateUnackedBufferOnWriteToSocket(
+    QuicStreamState& stream,
+    uint64_t length);
+
+void updateUnackedBufferOnRelease(QuicStreamState& stream, uint64_t length);
+
 void maybeWriteBlockAfterAPIWrite(QuicStreamState& stream);
 
 void maybeWriteBlockAfterSocketWrite(QuicStreamState& stream);
@@ -70,6 +89,12 @@ void onConnWindowUpdateSent(
 
 void onStreamWindowUpdateLost(QuicStreamState& stream);
 
+/**
+ * Returns what the auto tuned connection window holds of the worker's window
+ * budget and what the connection had buffered, once the connection closes.
+ */
+void releaseFlowControlWindowBudget(QuicConnectionStateBase& conn);
+
 void onConnWindowUpdateLost(QuicConnectionStateBase& conn);
 
 void onBlockedLost(QuicStreamState& stream);
@@ -8,6 +8,7 @@
 
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/common/test/TestUtils.h>
+#include <quic/flowcontrol/FlowControlWindowBudget.h>
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/state/test/MockQuicStats.h>
 
@@ -178,6 +179,169 @@ TEST_F(QuicFlowControlTest, GenerateMaxDataFrameChangeWindowLarger) {
           conn_.flowControlState.windowSize);
 }
 
+TEST_F(QuicFlowControlTest, AutoTuneConnWindow) {
+  conn_.transportSettings.autoTuneFlowControlWindows = true;
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+
+  // Half the window was read within 2 rtts of the last update.
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(1);
+  maybeSendConnWindowUpdate(conn_, lastUpdate + 100us);
+  EXPECT_TRUE(conn_.pendingEvents.connWindowUpdate);
+  EXPECT_EQ(1000, conn_.flowControlState.windowSize);
+}
+
+TEST_F(QuicFlowControlTest, NoAutoTuneOnSlowReads) {
+  conn_.transportSettings.autoTuneFlowControlWindows = true;
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+
+  maybeSendConnWindowUpdate(conn_, lastUpdate + 300us);
+  EXPECT_TRUE(conn_.pendingEvents.connWindowUpdate);
+  EXPECT_EQ(500, conn_.flowControlState.windowSize);
+}
+
+TEST_F(QuicFlowControlTest, AutoTuneConnWindowCapAndBudget) {
+  conn_.transportSettings.autoTuneFlowControlWindows = true;
+  conn_.transportSettings.maxAutoTunedConnectionWindowSize = 800;
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+  auto budget = std::make_shared<FlowControlWindowBudget>(200);
+  conn_.flowControlWindowBudget = budget;
+
+  maybeSendConnWindowUpdate(conn_, lastUpdate + 100us);
+  EXPECT_EQ(700, conn_.flowControlState.windowSize);
+  EXPECT_EQ(200, conn_.flowControlState.budgetedWindowBytes);
+  EXPECT_EQ(0, budget->available());
+
+  releaseFlowControlWindowBudget(conn_);
+  EXPECT_EQ(0, conn_.flowControlState.budgetedWindowBytes);
+  EXPECT_EQ(200, budget->available());
+}
+
+TEST_F(QuicFlowControlTest, AutoTuneStreamWindow) {
+  conn_.transportSettings.autoTuneFlowControlWindows = true;
+  conn_.flowControlState.windowSize = 500;
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  stream.currentReadOffset = 300;
+  stream.flowControlState.windowSize = 500;
+  stream.flowControlState.advertisedMaxOffset = 400;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  stream.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+
+  EXPECT_CALL(*transportInfoCb_, onStreamFlowControlUpdate()).Times(1);
+  maybeSendStreamWindowUpdate(stream, lastUpdate + 100us);
+  EXPECT_TRUE(conn_.streamManager->pendingWindowUpdate(stream.id));
+  EXPECT_EQ(1000, stream.flowControlState.windowSize);
+  // The connection window keeps room for more than the stream's.
+  EXPECT_EQ(1500, conn_.flowControlState.windowSize);
+}
+
+TEST_F(QuicFlowControlTest, ReceiveBufferLimitWindowSize) {
+  FlowControlWindowBudget budget(
+      std::numeric_limits<uint64_t>::max(), 1000000);
+  budget.updateBufferedBytes(0, 500000);
+  EXPECT_FALSE(budget.bufferLimitTight());
+  EXPECT_EQ(100000, budget.limitWindowSize(100000, 0));
+
+  budget.updateBufferedBytes(500000, 750000);
+  EXPECT_TRUE(budget.bufferLimitTight());
+  // Half of what the tight half of the limit had is left.
+  EXPECT_EQ(50000, budget.limitWindowSize(100000, 0));
+
+  budget.updateBufferedBytes(0, 50000);
+  EXPECT_EQ(800000, budget.bufferedBytes());
+  // The connection buffering more than its share is throttled the most.
+  EXPECT_EQ(
+      kMinBufferLimitedWindowSize, budget.limitWindowSize(100000, 750000));
+  EXPECT_EQ(40000, budget.limitWindowSize(100000, 50000));
+  EXPECT_EQ(1000, budget.limitWindowSize(1000, 750000));
+
+  budget.updateBufferedBytes(50000, 300000);
+  EXPECT_EQ(
+      kMinBufferLimitedWindowSize, budget.limitWindowSize(100000, 300000));
+
+  budget.updateBufferedBytes(300000, 0);
+  budget.updateBufferedBytes(750000, 0);
+  EXPECT_EQ(0, budget.bufferedBytes());
+  EXPECT_EQ(100000, budget.limitWindowSize(100000, 0));
+}
+
+TEST_F(QuicFlowControlTest, ReceiveBufferLimitShrinksWindows) {
+  auto budget = std::make_shared<FlowControlWindowBudget>(
+      std::numeric_limits<uint64_t>::max(), 1000000);
+  conn_.flowControlWindowBudget = budget;
+  // What the other connections of the worker buffer.
+  budget->updateBufferedBytes(0, 740000);
+  conn_.flowControlState.windowSize = 100000;
+  conn_.flowControlState.advertisedMaxOffset = 100000;
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  stream.flowControlState.windowSize = 100000;
+  stream.flowControlState.advertisedMaxOffset = 100000;
+
+  updateFlowControlOnStreamData(stream, 0, 100000);
+  EXPECT_EQ(100000, conn_.flowControlState.budgetedBufferedBytes);
+  EXPECT_EQ(840000, budget->bufferedBytes());
+
+  stream.currentReadOffset = 90000;
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(1);
+  updateFlowControlOnRead(stream, 0, Clock::now());
+  EXPECT_EQ(10000, conn_.flowControlState.budgetedBufferedBytes);
+  EXPECT_EQ(750000, budget->bufferedBytes());
+  EXPECT_TRUE(conn_.pendingEvents.connWindowUpdate);
+  EXPECT_EQ(140000, generateMaxDataFrame(conn_).maximumData);
+  EXPECT_EQ(140000, generateMaxStreamDataFrame(stream).maximumData);
+  EXPECT_EQ(100000, conn_.flowControlState.windowSize);
+  EXPECT_EQ(100000, stream.flowControlState.windowSize);
+
+  // Limited windows never take back what was advertised.
+  onConnWindowUpdateSent(
+      conn_,
+      conn_.ackStates.appDataAckState.nextPacketNum,
+      generateMaxDataFrame(conn_).maximumData,
+      Clock::now());
+  budget->updateBufferedBytes(740000, 1000000);
+  EXPECT_EQ(140000, generateMaxDataFrame(conn_).maximumData);
+
+  releaseFlowControlWindowBudget(conn_);
+  EXPECT_EQ(0, conn_.flowControlState.budgetedBufferedBytes);
+  EXPECT_EQ(1000000, budget->bufferedBytes());
+}
+
+TEST_F(QuicFlowControlTest, NoAutoTuneWhenReceiveBufferLimitTight) {
+  conn_.transportSettings.autoTuneFlowControlWindows = true;
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdate = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdate;
+  auto budget = std::make_shared<FlowControlWindowBudget>(
+      std::numeric_limits<uint64_t>::max(), 1000);
+  budget->updateBufferedBytes(0, 600);
+  conn_.flowControlWindowBudget = budget;
+
+  maybeSendConnWindowUpdate(conn_, lastUpdate + 100us);
+  EXPECT_TRUE(conn_.pendingEvents.connWindowUpdate);
+  EXPECT_EQ(500, conn_.flowControlState.windowSize);
+  EXPECT_EQ(700, generateMaxDataFrame(conn_).maximumData);
+}
+
 TEST_F(QuicFlowControlTest, MaybeSendStreamWindowUpdate) {
   StreamId id = 3;
   QuicStreamState stream(id, conn_);
@@ -199,6 +363,30 @@ TEST_F(QuicFlowControlTest, MaybeSendStreamWindowUpdate) {
   EXPECT_TRUE(conn_.streamManager->pendingWindowUpdate(stream.id));
 }
 
+TEST_F(QuicFlowControlTest, CoalesceStreamWindowUpdate) {
+  conn_.transportSettings.coalesceStreamWindowUpdates = true;
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  stream.currentReadOffset = 200;
+  stream.maxOffsetObserved = 250;
+  stream.flowControlState.windowSize = 500;
+  stream.flowControlState.advertisedMaxOffset = 400;
+
+  // The peer can still send more than a quarter of the window.
+  EXPECT_CALL(*transportInfoCb_, onStreamFlowControlUpdate()).Times(1);
+  maybeSendStreamWindowUpdate(stream, Clock::now());
+  EXPECT_TRUE(conn_.streamManager->pendingWindowUpdate(stream.id));
+  EXPECT_FALSE(conn_.streamManager->hasUrgentWindowUpdates());
+
+  stream.maxOffsetObserved = 350;
+  onStreamWindowUpdateLost(stream);
+  EXPECT_TRUE(conn_.streamManager->hasUrgentWindowUpdates());
+
+  conn_.streamManager->removeWindowUpdate(stream.id);
+  EXPECT_FALSE(conn_.streamManager->hasWindowUpdates());
+  EXPECT_FALSE(conn_.streamManager->hasUrgentWindowUpdates());
+}
+
 TEST_F(QuicFlowControlTest, MaybeSendStreamWindowUpdateTimeElapsed) {
   StreamId id = 3;
   QuicStreamState stream(id, conn_);
@@ -334,6 +522,31 @@ TEST_F(QuicFlowControlTest, MaybeWriteBlockedAfterSocketWrite) {
   EXPECT_TRUE(conn_.streamManager->hasBlocked());
 }
 
+TEST_F(QuicFlowControlTest, UpdateFlowControlOnNewDataWritten) {
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  conn_.flowControlState.peerAdvertisedMaxOffset = 1000;
+  conn_.flowControlState.sumCurStreamBufferLen = 100;
+  stream.currentWriteOffset = 200;
+  stream.flowControlState.peerAdvertisedMaxOffset = 400;
+  stream.writeBuffer.append(IOBuf::copyBuffer("1234"));
+
+  updateFlowControlOnNewDataWritten(stream, 50);
+  EXPECT_EQ(50, conn_.flowControlState.sumCurWriteOffset);
+  EXPECT_EQ(50, conn_.flowControlState.sumCurStreamBufferLen);
+  EXPECT_EQ(50, stream.unackedBufferLen);
+  EXPECT_EQ(50, conn_.flowControlState.sumUnackedStreamBufferLen);
+  EXPECT_TRUE(conn_.streamManager->hasWritable());
+  EXPECT_FALSE(conn_.streamManager->hasBlocked());
+
+  // The write used up the stream's flow control.
+  stream.currentWriteOffset = 400;
+  EXPECT_CALL(*transportInfoCb_, onStreamFlowControlBlocked()).Times(1);
+  updateFlowControlOnNewDataWritten(stream, 50);
+  EXPECT_FALSE(conn_.streamManager->hasWritable());
+  EXPECT_TRUE(conn_.streamManager->hasBlocked());
+}
+
 TEST_F(QuicFlowControlTest, MaybeSendStreamWindowUpdateChangeWindowLarger) {
   StreamId id = 3;
   QuicStreamState stream(id, conn_);
@@ -673,6 +886,26 @@ TEST_F(QuicFlowControlTest, UpdateFlowControlOnWriteToStream) {
   EXPECT_EQ(conn_.flowControlState.sumCurStreamBufferLen, 150);
 }
 
+TEST_F(QuicFlowControlTest, UpdateUnackedBuffer) {
+  QuicStreamState stream1(3, conn_);
+  QuicStreamState stream2(7, conn_);
+
+  updateUnackedBufferOnWriteToSocket(stream1, 100);
+  updateUnackedBufferOnWriteToSocket(stream2, 50);
+  EXPECT_EQ(stream1.unackedBufferLen, 100);
+  EXPECT_EQ(stream2.unackedBufferLen, 50);
+  EXPECT_EQ(conn_.flowControlState.sumUnackedStreamBufferLen, 150);
+
+  updateUnackedBufferOnRelease(stream1, 40);
+  EXPECT_EQ(stream1.unackedBufferLen, 60);
+  EXPECT_EQ(conn_.flowControlState.sumUnackedStreamBufferLen, 110);
+
+  // Never releases more than the stream accounted for.
+  updateUnackedBufferOnRelease(stream2, 80);
+  EXPECT_EQ(stream2.unackedBufferLen, 0);
+  EXPECT_EQ(conn_.flowControlState.sumUnackedStreamBufferLen, 60);
+}
+
 TEST_F(QuicFlowControlTest, HandleStreamWindowUpdate) {
   StreamId id = 3;
   QuicStreamState stream(id, conn_);
@@ -11,6 +11,8 @@
 #include <folly/Optional.h>
 #include <folly/io/IOBuf.h>
 
+#include <vector>
+
 namespace quic {
 
 struct TrafficKey {
@@ -33,6 +35,22 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Encrypts a batch of plaintexts, each with its own associated data and
+   * sequence number. Every entry of plaintexts is replaced by its ciphertext.
+   * Backends that can pipeline several packets through the cipher should
+   * override this, by default the packets are sealed one by one.
+   */
+  virtual void encryptBatch(
+      std::vector<std::unique_ptr<folly::IOBuf>>& plaintexts,
+      const std::vector<const folly::IOBuf*>& associatedData,
+      const std::vector<uint64_t>& seqNums) const {
+    for (size_t i = 0; i < plaintexts.size(); ++i) {
+      plaintexts[i] =
+          encrypt(std::move(plaintexts[i]), associatedData[i], seqNums[i]);
+    }
+  }
+
   /**
    * Decrypt ciphertext. Will throw if the ciphertext does not decrypt
    * successfully.
@@ -62,5 +80,13 @@ class Aead {
    * ciphertext - size of plaintext).
    */
   virtual size_t getCipherOverhead() const = 0;
+
+  /**
+   * The id of the key on the device that seals the packets of this aead on
+   * transmit, see CryptoOffload. None when they are sealed in software.
+   */
+  virtual folly::Optional<uint32_t> getOffloadKeyId() const {
+    return folly::none;
+  }
 };
 } // namespace quic
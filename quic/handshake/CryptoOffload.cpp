@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/CryptoOffload.h>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+OffloadedAead::OffloadedAead(
+    std::shared_ptr<CryptoOffload> offload,
+    uint32_t keyId,
+    std::unique_ptr<Aead> aead)
+    : offload_(std::move(offload)), keyId_(keyId), aead_(std::move(aead)) {
+  CHECK(offload_);
+  CHECK(aead_);
+}
+
+OffloadedAead::~OffloadedAead() {
+  offload_->removeKey(keyId_);
+}
+
+std::unique_ptr<folly::IOBuf> OffloadedAead::encrypt(
+    std::unique_ptr<folly::IOBuf>&& plaintext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return aead_->encrypt(std::move(plaintext), associatedData, seqNum);
+}
+
+void OffloadedAead::encryptBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>>& plaintexts,
+    const std::vector<const folly::IOBuf*>& associatedData,
+    const std::vector<uint64_t>& seqNums) const {
+  aead_->encryptBatch(plaintexts, associatedData, seqNums);
+}
+
+folly::Optional<std::unique_ptr<folly::IOBuf>> OffloadedAead::tryDecrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return aead_->tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+}
+
+size_t OffloadedAead::getCipherOverhead() const {
+  return aead_->getCipherOverhead();
+}
+
+folly::Optional<uint32_t> OffloadedAead::getOffloadKeyId() const {
+  return keyId_;
+}
+
+const Aead& OffloadedAead::getSoftwareAead() const {
+  return *aead_;
+}
+
+OffloadedPacketNumberCipher::OffloadedPacketNumberCipher(
+    std::unique_ptr<PacketNumberCipher> cipher)
+    : cipher_(std::move(cipher)) {
+  CHECK(cipher_);
+}
+
+void OffloadedPacketNumberCipher::setKey(folly::ByteRange key) {
+  cipher_->setKey(key);
+}
+
+HeaderProtectionMask OffloadedPacketNumberCipher::mask(
+    folly::ByteRange sample) const {
+  return cipher_->mask(sample);
+}
+
+void OffloadedPacketNumberCipher::batchMask(
+    const std::vector<Sample>& samples,
+    std::vector<HeaderProtectionMask>& masks) const {
+  cipher_->batchMask(samples, masks);
+}
+
+size_t OffloadedPacketNumberCipher::keyLength() const {
+  return cipher_->keyLength();
+}
+
+bool OffloadedPacketNumberCipher::isOffloaded() const {
+  return true;
+}
+
+const PacketNumberCipher& OffloadedPacketNumberCipher::getSoftwareCipher()
+    const {
+  return *cipher_;
+}
+
+bool offloadCiphers(
+    const std::shared_ptr<CryptoOffload>& offload,
+    std::unique_ptr<Aead>& aead,
+    std::unique_ptr<PacketNumberCipher>& headerCipher) {
+  CHECK(offload);
+  CHECK(aead);
+  CHECK(headerCipher);
+  if (aead->getOffloadKeyId()) {
+    return true;
+  }
+  // The header key stays the same across key updates, so the header cipher
+  // may already be offloaded along with the keys of an earlier generation.
+  auto offloadedHeaderCipher =
+      dynamic_cast<OffloadedPacketNumberCipher*>(headerCipher.get());
+  auto keyId = offload->installKey(
+      *aead,
+      offloadedHeaderCipher ? offloadedHeaderCipher->getSoftwareCipher()
+                            : *headerCipher);
+  if (!keyId) {
+    return false;
+  }
+  aead = std::make_unique<OffloadedAead>(offload, *keyId, std::move(aead));
+  if (!offloadedHeaderCipher) {
+    headerCipher =
+        std::make_unique<OffloadedPacketNumberCipher>(std::move(headerCipher));
+  }
+  return true;
+}
+
+} // namespace quic
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/net/NetworkSocket.h>
+#include <quic/codec/PacketNumberCipher.h>
+#include <quic/handshake/Aead.h>
+
+#include <memory>
+
+namespace quic {
+
+/**
+ * What the device needs to seal one packet. The packets of a send are
+ * described by an array of these, in order, in one control message.
+ */
+struct CryptoOffloadMetadata {
+  // the full packet number, the nonce is made from it
+  uint64_t packetNum;
+  uint32_t keyId;
+  // the payload that is sealed starts right after the header
+  uint16_t headerLen;
+  // including the room for the tag at the end of the packet
+  uint16_t packetLen;
+};
+
+/**
+ * A device, e.g. a NIC with inline QUIC crypto, that seals short header
+ * packets on transmit. Once the 1-RTT write keys are installed on it, the
+ * packets are handed to the socket in plaintext, with room for the tag, and
+ * a control message with their CryptoOffloadMetadata. The device encrypts
+ * the payload and then applies the header protection.
+ */
+class CryptoOffload {
+ public:
+  virtual ~CryptoOffload() = default;
+
+  /**
+   * Whether the device behind the socket can seal its packets. Called once
+   * the socket is created, the packets of sockets it returns false for are
+   * always sealed in software.
+   */
+  virtual bool probe(folly::NetworkSocket fd) noexcept = 0;
+
+  /**
+   * Installs the keys of the ciphers on the device. Returns the id the
+   * packets sealed with them are sent with, or none if the device can't take
+   * them, e.g. it is out of key slots or doesn't support the cipher suite.
+   */
+  virtual folly::Optional<uint32_t> installKey(
+      const Aead& aead,
+      const PacketNumberCipher& headerCipher) = 0;
+
+  // removes a key once no more packets are sealed with it
+  virtual void removeKey(uint32_t keyId) noexcept = 0;
+
+  // level and type of the control message carrying the metadata of a send
+  virtual int getControlLevel() const = 0;
+  virtual int getControlType() const = 0;
+};
+
+/**
+ * An aead whose key is installed on a CryptoOffload. The software aead it
+ * wraps still seals the packets that are written outside the offloaded
+ * path, e.g. connection closes, and opens nothing since only write keys are
+ * offloaded. The key is removed from the device with the aead.
+ */
+class OffloadedAead : public Aead {
+ public:
+  OffloadedAead(
+      std::shared_ptr<CryptoOffload> offload,
+      uint32_t keyId,
+      std::unique_ptr<Aead> aead);
+  ~OffloadedAead() override;
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  void encryptBatch(
+      std::vector<std::unique_ptr<folly::IOBuf>>& plaintexts,
+      const std::vector<const folly::IOBuf*>& associatedData,
+      const std::vector<uint64_t>& seqNums) const override;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  size_t getCipherOverhead() const override;
+
+  folly::Optional<uint32_t> getOffloadKeyId() const override;
+
+  const Aead& getSoftwareAead() const;
+
+ private:
+  std::shared_ptr<CryptoOffload> offload_;
+  uint32_t keyId_;
+  std::unique_ptr<Aead> aead_;
+};
+
+/**
+ * The header cipher of the packets sealed by an OffloadedAead. The device
+ * protects the headers itself, the wrapped cipher does it for the packets
+ * sealed in software.
+ */
+class OffloadedPacketNumberCipher : public PacketNumberCipher {
+ public:
+  explicit OffloadedPacketNumberCipher(
+      std::unique_ptr<PacketNumberCipher> cipher);
+
+  void setKey(folly::ByteRange key) override;
+
+  HeaderProtectionMask mask(folly::ByteRange sample) const override;
+
+  void batchMask(
+      const std::vector<Sample>& samples,
+      std::vector<HeaderProtectionMask>& masks) const override;
+
+  size_t keyLength() const override;
+
+  bool isOffloaded() const override;
+
+  const PacketNumberCipher& getSoftwareCipher() const;
+
+ private:
+  std::unique_ptr<PacketNumberCipher> cipher_;
+};
+
+/**
+ * Installs the keys of the ciphers on the device and replaces them with
+ * their offloaded wrappers. Leaves them as they are and returns false if the
+ * device can't take the keys, the packets are then sealed in software.
+ */
+bool offloadCiphers(
+    const std::shared_ptr<CryptoOffload>& offload,
+    std::unique_ptr<Aead>& aead,
+    std::unique_ptr<PacketNumberCipher>& headerCipher);
+
+} // namespace quic
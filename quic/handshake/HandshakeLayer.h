@@ -11,12 +11,14 @@
 #include <quic/QuicConstants.h>
 #include <quic/codec/PacketNumberCipher.h>
 #include <quic/codec/Types.h>
+#include <quic/handshake/Aead.h>
 
 namespace quic {
 
 constexpr folly::StringPiece kQuicKeyLabel = "quic key";
 constexpr folly::StringPiece kQuicIVLabel = "quic iv";
 constexpr folly::StringPiece kQuicPNLabel = "quic hp";
+constexpr folly::StringPiece kQuicKeyUpdateLabel = "quic ku";
 
 class Handshake {
  public:
@@ -28,6 +30,30 @@ class Handshake {
   virtual void handshakeConfirmed() {
     LOG(FATAL) << "Not implemented";
   }
+
+  /**
+   * The 1-RTT ciphers of the next key phase. Every call derives the
+   * generation after the one it returned last, starting from the keys of
+   * the handshake. Returns null if the 1-RTT secrets aren't known yet, or if
+   * the handshake doesn't support key updates.
+   */
+  virtual std::unique_ptr<Aead> getNextOneRttReadCipher() {
+    return nullptr;
+  }
+
+  virtual std::unique_ptr<Aead> getNextOneRttWriteCipher() {
+    return nullptr;
+  }
+
+  /**
+   * Another instance of the 1-RTT write cipher of key generation, e.g. to
+   * seal on another thread with. Returns null if the 1-RTT secrets aren't
+   * known yet, or if the handshake can't derive them again.
+   */
+  virtual std::unique_ptr<Aead> makeOneRttWriteCipher(
+      uint64_t /* generation */) {
+    return nullptr;
+  }
 };
 
 constexpr folly::StringPiece kQuicDraft17Salt =
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/InitialCipherCache.h>
+
+#include <folly/Conv.h>
+#include <glog/logging.h>
+
+namespace quic {
+
+namespace {
+
+class SharedAead : public Aead {
+ public:
+  explicit SharedAead(std::shared_ptr<const Aead> aead)
+      : aead_(std::move(aead)) {}
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return aead_->encrypt(std::move(plaintext), associatedData, seqNum);
+  }
+
+  void encryptBatch(
+      std::vector<std::unique_ptr<folly::IOBuf>>& plaintexts,
+      const std::vector<const folly::IOBuf*>& associatedData,
+      const std::vector<uint64_t>& seqNums) const override {
+    aead_->encryptBatch(plaintexts, associatedData, seqNums);
+  }
+
+  std::unique_ptr<folly::IOBuf> decrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return aead_->decrypt(std::move(ciphertext), associatedData, seqNum);
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return aead_->tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+  }
+
+  size_t getCipherOverhead() const override {
+    return aead_->getCipherOverhead();
+  }
+
+ private:
+  std::shared_ptr<const Aead> aead_;
+};
+
+class SharedPacketNumberCipher : public PacketNumberCipher {
+ public:
+  explicit SharedPacketNumberCipher(
+      std::shared_ptr<const PacketNumberCipher> cipher)
+      : cipher_(std::move(cipher)) {}
+
+  void setKey(folly::ByteRange) override {
+    // The key is shared with every other connection using the cipher.
+    LOG(FATAL) << "Can't rekey a shared packet number cipher";
+  }
+
+  HeaderProtectionMask mask(folly::ByteRange sample) const override {
+    return cipher_->mask(sample);
+  }
+
+  void batchMask(
+      const std::vector<Sample>& samples,
+      std::vector<HeaderProtectionMask>& masks) const override {
+    cipher_->batchMask(samples, masks);
+  }
+
+  size_t keyLength() const override {
+    return cipher_->keyLength();
+  }
+
+ private:
+  std::shared_ptr<const PacketNumberCipher> cipher_;
+};
+
+} // namespace
+
+InitialCipherCache::InitialCipherCache(size_t maxSize) : cache_(maxSize) {}
+
+const InitialCiphers& InitialCipherCache::getCiphers(
+    const CryptoFactory& cryptoFactory,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  auto key = folly::to<std::string>(
+      static_cast<uint32_t>(version), ":", clientDestinationConnId.hex());
+  auto it = cache_.find(key);
+  if (it != cache_.end()) {
+    return it->second;
+  }
+  InitialCiphers ciphers;
+  ciphers.clientCipher = cryptoFactory.getClientInitialCipher(
+      clientDestinationConnId, version);
+  ciphers.serverCipher = cryptoFactory.getServerInitialCipher(
+      clientDestinationConnId, version);
+  ciphers.clientHeaderCipher = cryptoFactory.makeClientInitialHeaderCipher(
+      clientDestinationConnId, version);
+  ciphers.serverHeaderCipher = cryptoFactory.makeServerInitialHeaderCipher(
+      clientDestinationConnId, version);
+  cache_.set(key, std::move(ciphers));
+  return cache_.find(key)->second;
+}
+
+size_t InitialCipherCache::size() const {
+  return cache_.size();
+}
+
+std::unique_ptr<Aead> makeSharedAead(std::shared_ptr<const Aead> aead) {
+  return std::make_unique<SharedAead>(std::move(aead));
+}
+
+std::unique_ptr<PacketNumberCipher> makeSharedPacketNumberCipher(
+    std::shared_ptr<const PacketNumberCipher> cipher) {
+  return std::make_unique<SharedPacketNumberCipher>(std::move(cipher));
+}
+
+} // namespace quic
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/handshake/CryptoFactory.h>
+
+#include <folly/container/EvictingCacheMap.h>
+
+#include <memory>
+#include <string>
+
+namespace quic {
+
+/**
+ * The Initial packet protection of a connection, which only depends on the
+ * version and the client's original destination connection id.
+ */
+struct InitialCiphers {
+  std::shared_ptr<const Aead> clientCipher;
+  std::shared_ptr<const Aead> serverCipher;
+  std::shared_ptr<const PacketNumberCipher> clientHeaderCipher;
+  std::shared_ptr<const PacketNumberCipher> serverHeaderCipher;
+};
+
+/**
+ * Keeps the Initial ciphers of the most recently seen (version, connection
+ * id) pairs, so that a client retrying its handshake, or coming back after a
+ * Retry or a dropped connection, doesn't cost another round of HKDF and key
+ * setup. The ciphers handed out share the cached ones, which are only used
+ * through their const methods.
+ *
+ * Not thread safe, the connections using the cache have to run on the same
+ * evb, e.g. the connections of a server worker.
+ */
+class InitialCipherCache {
+ public:
+  explicit InitialCipherCache(size_t maxSize);
+
+  /**
+   * The ciphers for the connection id and version, derived with the factory
+   * if they aren't cached.
+   */
+  const InitialCiphers& getCiphers(
+      const CryptoFactory& cryptoFactory,
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  size_t size() const;
+
+ private:
+  folly::EvictingCacheMap<std::string, InitialCiphers> cache_;
+};
+
+/**
+ * Wrap the shared ciphers into the unique ones a connection owns.
+ */
+std::unique_ptr<Aead> makeSharedAead(std::shared_ptr<const Aead> aead);
+std::unique_ptr<PacketNumberCipher> makeSharedPacketNumberCipher(
+    std::shared_ptr<const PacketNumberCipher> cipher);
+
+} // namespace quic
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/ParallelAead.h>
+
+#include <folly/system/ThreadName.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+
+namespace quic {
+
+namespace {
+
+constexpr size_t kCryptoWorkerQueueSize = 1024;
+
+// Fewer packets than this aren't worth handing to another thread.
+constexpr size_t kMinPacketsPerLane = 4;
+
+} // namespace
+
+CryptoWorkerPool::CryptoWorkerPool(size_t numThreads)
+    : tasks_(kCryptoWorkerQueueSize) {
+  threads_.reserve(numThreads);
+  for (size_t i = 0; i < numThreads; ++i) {
+    threads_.emplace_back([this] {
+      folly::setThreadName("QuicCrypto");
+      loop();
+    });
+  }
+}
+
+CryptoWorkerPool::~CryptoWorkerPool() {
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    tasks_.blockingWrite(Task());
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void CryptoWorkerPool::loop() {
+  while (true) {
+    Task task;
+    tasks_.blockingRead(task);
+    if (!task.fn) {
+      return;
+    }
+    (*task.fn)(task.index);
+    if (task.pending->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      task.done->post();
+    }
+  }
+}
+
+void CryptoWorkerPool::run(
+    size_t numTasks,
+    folly::FunctionRef<void(size_t)> fn) {
+  if (numTasks == 0) {
+    return;
+  }
+  if (numTasks == 1 || threads_.empty()) {
+    for (size_t i = 0; i < numTasks; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  std::atomic<size_t> pending{numTasks - 1};
+  folly::Baton<> done;
+  for (size_t i = 1; i < numTasks; ++i) {
+    Task task;
+    task.fn = &fn;
+    task.index = i;
+    task.pending = &pending;
+    task.done = &done;
+    tasks_.blockingWrite(std::move(task));
+  }
+  fn(0);
+  // Waited for even when the others are done already, the last of them may
+  // still be about to post.
+  done.wait();
+}
+
+ParallelAead::ParallelAead(
+    std::vector<std::unique_ptr<Aead>> lanes,
+    std::shared_ptr<CryptoWorkerPool> workers)
+    : lanes_(std::move(lanes)), workers_(std::move(workers)) {
+  CHECK(!lanes_.empty());
+  CHECK(workers_);
+}
+
+std::unique_ptr<folly::IOBuf> ParallelAead::encrypt(
+    std::unique_ptr<folly::IOBuf>&& plaintext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return lanes_[0]->encrypt(std::move(plaintext), associatedData, seqNum);
+}
+
+void ParallelAead::encryptBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>>& plaintexts,
+    const std::vector<const folly::IOBuf*>& associatedData,
+    const std::vector<uint64_t>& seqNums) const {
+  size_t numRuns =
+      std::min(lanes_.size(), plaintexts.size() / kMinPacketsPerLane);
+  if (numRuns < 2) {
+    lanes_[0]->encryptBatch(plaintexts, associatedData, seqNums);
+    return;
+  }
+  size_t runLen = (plaintexts.size() + numRuns - 1) / numRuns;
+  std::vector<std::exception_ptr> errors(numRuns);
+  workers_->run(numRuns, [&](size_t run) {
+    size_t begin = run * runLen;
+    size_t end = std::min(begin + runLen, plaintexts.size());
+    if (begin >= end) {
+      return;
+    }
+    try {
+      std::vector<std::unique_ptr<folly::IOBuf>> runPlaintexts(
+          std::make_move_iterator(plaintexts.begin() + begin),
+          std::make_move_iterator(plaintexts.begin() + end));
+      std::vector<const folly::IOBuf*> runAssociatedData(
+          associatedData.begin() + begin, associatedData.begin() + end);
+      std::vector<uint64_t> runSeqNums(
+          seqNums.begin() + begin, seqNums.begin() + end);
+      lanes_[run]->encryptBatch(runPlaintexts, runAssociatedData, runSeqNums);
+      std::move(
+          runPlaintexts.begin(), runPlaintexts.end(), plaintexts.begin() + begin);
+    } catch (...) {
+      errors[run] = std::current_exception();
+    }
+  });
+  for (auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+folly::Optional<std::unique_ptr<folly::IOBuf>> ParallelAead::tryDecrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return lanes_[0]->tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+}
+
+size_t ParallelAead::getCipherOverhead() const {
+  return lanes_[0]->getCipherOverhead();
+}
+
+} // namespace quic
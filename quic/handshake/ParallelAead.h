@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/MPMCQueue.h>
+#include <folly/synchronization/Baton.h>
+#include <quic/handshake/Aead.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace quic {
+
+/**
+ * A few helper threads the packets of a burst are sealed on, next to the
+ * transport's EventBase thread, so that one connection isn't limited to one
+ * core. Shared by all the connections that use it.
+ */
+class CryptoWorkerPool {
+ public:
+  explicit CryptoWorkerPool(size_t numThreads);
+  ~CryptoWorkerPool();
+
+  CryptoWorkerPool(const CryptoWorkerPool&) = delete;
+  CryptoWorkerPool& operator=(const CryptoWorkerPool&) = delete;
+
+  size_t numThreads() const {
+    return threads_.size();
+  }
+
+  /**
+   * Runs fn(0) on the calling thread and fn(1) to fn(numTasks - 1) on the
+   * helper threads, and returns once all of them are done. fn must not throw.
+   */
+  void run(size_t numTasks, folly::FunctionRef<void(size_t)> fn);
+
+ private:
+  struct Task {
+    // null tells the thread to exit
+    folly::FunctionRef<void(size_t)>* fn{nullptr};
+    size_t index{0};
+    std::atomic<size_t>* pending{nullptr};
+    folly::Baton<>* done{nullptr};
+  };
+
+  void loop();
+
+  folly::MPMCQueue<Task> tasks_;
+  std::vector<std::thread> threads_;
+};
+
+/**
+ * An aead whose batches are split into runs of consecutive packets, each
+ * sealed by its own instance of the key on the CryptoWorkerPool, the first
+ * one on the calling thread. The packets come back in order once all of the
+ * runs are sealed. Single packets, small batches and opening only use the
+ * first instance.
+ */
+class ParallelAead : public Aead {
+ public:
+  // lanes are instances of the same key, one more than the pool has threads
+  ParallelAead(
+      std::vector<std::unique_ptr<Aead>> lanes,
+      std::shared_ptr<CryptoWorkerPool> workers);
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  void encryptBatch(
+      std::vector<std::unique_ptr<folly::IOBuf>>& plaintexts,
+      const std::vector<const folly::IOBuf*>& associatedData,
+      const std::vector<uint64_t>& seqNums) const override;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  size_t getCipherOverhead() const override;
+
+ private:
+  std::vector<std::unique_ptr<Aead>> lanes_;
+  std::shared_ptr<CryptoWorkerPool> workers_;
+};
+
+} // namespace quic
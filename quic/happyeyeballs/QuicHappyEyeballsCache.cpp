@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/happyeyeballs/QuicHappyEyeballsCache.h>
+
+namespace quic {
+
+BasicQuicHappyEyeballsCache::BasicQuicHappyEyeballsCache(size_t maxSize)
+    : cache_(maxSize) {}
+
+folly::Optional<CachedHappyEyeballsWinner>
+BasicQuicHappyEyeballsCache::getWinner(const std::string& hostname) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = cache_.find(hostname);
+  if (it == cache_.end()) {
+    return folly::none;
+  }
+  return it->second;
+}
+
+void BasicQuicHappyEyeballsCache::putWinner(
+    const std::string& hostname,
+    CachedHappyEyeballsWinner winner) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  cache_.set(hostname, std::move(winner));
+}
+
+void BasicQuicHappyEyeballsCache::removeWinner(const std::string& hostname) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  cache_.erase(hostname);
+}
+
+} // namespace quic
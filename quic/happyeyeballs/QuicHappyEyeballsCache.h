@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace quic {
+
+/**
+ * The address that won the last race to a host, which the next connection
+ * to it attempts first, long before the other family.
+ */
+struct CachedHappyEyeballsWinner {
+  folly::SocketAddress peerAddress;
+  // On the system clock, since caches can be persisted across restarts.
+  std::chrono::system_clock::time_point recordTime;
+};
+
+/**
+ * Cache of the winners of past races, keyed by hostname like the
+ * QuicPskCache. Shared by the connections of a client, possibly across
+ * threads.
+ */
+class QuicHappyEyeballsCache {
+ public:
+  virtual ~QuicHappyEyeballsCache() = default;
+
+  virtual folly::Optional<CachedHappyEyeballsWinner> getWinner(
+      const std::string& hostname) = 0;
+  virtual void putWinner(
+      const std::string& hostname,
+      CachedHappyEyeballsWinner winner) = 0;
+  virtual void removeWinner(const std::string& hostname) = 0;
+};
+
+/**
+ * Thread safe cache that keeps the winners of the most recently connected to
+ * hosts.
+ */
+class BasicQuicHappyEyeballsCache : public QuicHappyEyeballsCache {
+ public:
+  explicit BasicQuicHappyEyeballsCache(
+      size_t maxSize = kDefaultHappyEyeballsCacheSize);
+  ~BasicQuicHappyEyeballsCache() override = default;
+
+  folly::Optional<CachedHappyEyeballsWinner> getWinner(
+      const std::string& hostname) override;
+  void putWinner(const std::string& hostname, CachedHappyEyeballsWinner winner)
+      override;
+  void removeWinner(const std::string& hostname) override;
+
+ private:
+  std::mutex mutex_;
+  folly::EvictingCacheMap<std::string, CachedHappyEyeballsWinner> cache_;
+};
+
+} // namespace quic
@@ -20,6 +20,7 @@
 #include <folly/net/NetOps.h>
 #include <folly/portability/Sockets.h>
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 
@@ -27,6 +28,35 @@ namespace fsp = folly::portability::sockets;
 
 namespace quic {
 
+namespace {
+// Orders the pending addresses to alternate between the families, starting
+// with the family of the first attempt, as RFC 8305 section 4 does.
+void interleavePendingPeerAddresses(
+    std::deque<folly::SocketAddress>& pendingPeerAddresses,
+    sa_family_t firstFamily) {
+  std::vector<folly::SocketAddress> firstFamilyAddresses;
+  std::vector<folly::SocketAddress> otherFamilyAddresses;
+  for (auto& peerAddress : pendingPeerAddresses) {
+    if (peerAddress.getFamily() == firstFamily) {
+      firstFamilyAddresses.push_back(std::move(peerAddress));
+    } else {
+      otherFamilyAddresses.push_back(std::move(peerAddress));
+    }
+  }
+  pendingPeerAddresses.clear();
+  for (size_t i = 0;
+       i < std::max(firstFamilyAddresses.size(), otherFamilyAddresses.size());
+       ++i) {
+    if (i < firstFamilyAddresses.size()) {
+      pendingPeerAddresses.push_back(std::move(firstFamilyAddresses[i]));
+    }
+    if (i < otherFamilyAddresses.size()) {
+      pendingPeerAddresses.push_back(std::move(otherFamilyAddresses[i]));
+    }
+  }
+}
+} // namespace
+
 void happyEyeballsAddPeerAddress(
     QuicConnectionStateBase& connection,
     const folly::SocketAddress& peerAddress) {
@@ -40,17 +70,38 @@ void happyEyeballsAddPeerAddress(
   // before start(), that is, addNewPeerAddress cannot be called after start()
   // is called.
 
-  // TODO: Support multiple addresses
-
   QUIC_TRACE(
       happy_eyeballs, connection, "add addr", peerAddress.getAddressStr());
-  if (peerAddress.getFamily() == AF_INET) {
-    DCHECK(!connection.happyEyeballsState.v4PeerAddress.isInitialized());
-    connection.happyEyeballsState.v4PeerAddress = peerAddress;
+  auto& happyEyeballsState = connection.happyEyeballsState;
+  auto& firstOfFamily = peerAddress.getFamily() == AF_INET
+      ? happyEyeballsState.v4PeerAddress
+      : happyEyeballsState.v6PeerAddress;
+  if (!firstOfFamily.isInitialized()) {
+    firstOfFamily = peerAddress;
   } else {
-    DCHECK(!connection.happyEyeballsState.v6PeerAddress.isInitialized());
-    connection.happyEyeballsState.v6PeerAddress = peerAddress;
+    happyEyeballsState.pendingPeerAddresses.push_back(peerAddress);
+  }
+}
+
+bool happyEyeballsPreferPeerAddress(
+    QuicConnectionStateBase& connection,
+    const folly::SocketAddress& peerAddress) {
+  auto& happyEyeballsState = connection.happyEyeballsState;
+  auto& firstOfFamily = peerAddress.getFamily() == AF_INET
+      ? happyEyeballsState.v4PeerAddress
+      : happyEyeballsState.v6PeerAddress;
+  if (firstOfFamily == peerAddress) {
+    return true;
+  }
+  auto it = std::find(
+      happyEyeballsState.pendingPeerAddresses.begin(),
+      happyEyeballsState.pendingPeerAddresses.end(),
+      peerAddress);
+  if (it == happyEyeballsState.pendingPeerAddresses.end()) {
+    return false;
   }
+  std::swap(*it, firstOfFamily);
+  return true;
 }
 
 void happyEyeballsAddSocket(
@@ -68,6 +119,7 @@ void startHappyEyeballs(
     folly::AsyncUDPSocket::ErrMessageCallback* errMsgCallback,
     folly::AsyncUDPSocket::ReadCallback* readCallback,
     const folly::SocketOptionMap& options) {
+  auto& happyEyeballsState = connection.happyEyeballsState;
   if (connection.happyEyeballsState.v6PeerAddress.isInitialized() &&
       connection.happyEyeballsState.v4PeerAddress.isInitialized()) {
     // A second socket has to be added before happy eyeballs starts
@@ -91,6 +143,10 @@ void startHappyEyeballs(
 
     connection.happyEyeballsState.connAttemptDelayTimeout =
         &connAttemptDelayTimeout;
+    happyEyeballsState.attempts = 1;
+    interleavePendingPeerAddresses(
+        happyEyeballsState.pendingPeerAddresses,
+        connection.peerAddress.getFamily());
 
     evb->timer().scheduleTimeout(&connAttemptDelayTimeout, connAttempDelay);
 
@@ -107,18 +163,29 @@ void startHappyEyeballs(
       // If second socket bind throws exception, give it up
       connAttemptDelayTimeout.cancelTimeout();
       connection.happyEyeballsState.finished = true;
+      happyEyeballsState.pendingPeerAddresses.clear();
     }
-  } else if (connection.happyEyeballsState.v6PeerAddress.isInitialized()) {
-    connection.originalPeerAddress =
-        connection.happyEyeballsState.v6PeerAddress;
-    connection.peerAddress = connection.happyEyeballsState.v6PeerAddress;
-    connection.happyEyeballsState.finished = true;
-  } else if (connection.happyEyeballsState.v4PeerAddress.isInitialized()) {
-    connection.originalPeerAddress =
-        connection.happyEyeballsState.v4PeerAddress;
-    connection.peerAddress = connection.happyEyeballsState.v4PeerAddress;
-    connection.happyEyeballsState.finished = true;
+    return;
+  }
+
+  if (happyEyeballsState.v6PeerAddress.isInitialized()) {
+    connection.originalPeerAddress = happyEyeballsState.v6PeerAddress;
+    connection.peerAddress = happyEyeballsState.v6PeerAddress;
+  } else if (happyEyeballsState.v4PeerAddress.isInitialized()) {
+    connection.originalPeerAddress = happyEyeballsState.v4PeerAddress;
+    connection.peerAddress = happyEyeballsState.v4PeerAddress;
+  } else {
+    return;
   }
+  happyEyeballsState.attempts = 1;
+  if (happyEyeballsState.pendingPeerAddresses.empty()) {
+    happyEyeballsState.finished = true;
+    return;
+  }
+  // The addresses of a single family are raced over the first socket.
+  QUIC_TRACE(happy_eyeballs, connection, "start", "single family");
+  happyEyeballsState.connAttemptDelayTimeout = &connAttemptDelayTimeout;
+  evb->timer().scheduleTimeout(&connAttemptDelayTimeout, connAttempDelay);
 }
 
 void happyEyeballsSetUpSocket(
@@ -149,12 +216,20 @@ void happyEyeballsSetUpSocket(
   } else {
     socket.dontFragment(true);
   }
-  if (transportSettings.connectUDP) {
-    socket.connect(peerAddress);
-  }
   if (transportSettings.enableSocketErrMsgCallback) {
     socket.setErrMessageCallback(errMsgCallback);
   }
+  if (transportSettings.enableUdpGRO && !enableSocketGRO(socket)) {
+    VLOG(4) << "Unable to turn on UDP_GRO";
+  }
+  if (transportSettings.enableEcn &&
+      !enableSocketEcnReceive(socket, sockFamily)) {
+    VLOG(4) << "Unable to turn on ECN reads";
+  }
+  if (transportSettings.enableRxTimestamps &&
+      !enableSocketRxTimestamps(socket)) {
+    VLOG(4) << "Unable to turn on receive timestamps";
+  }
   socket.resumeRead(readCallback);
 }
 
@@ -163,6 +238,33 @@ void happyEyeballsStartSecondSocket(
   CHECK(!happyEyeballsState.finished);
 
   happyEyeballsState.shouldWriteToSecondSocket = true;
+  happyEyeballsState.secondSocketStarted = true;
+  happyEyeballsState.attempts++;
+}
+
+void happyEyeballsStartNextAttempt(QuicConnectionStateBase& connection) {
+  auto& happyEyeballsState = connection.happyEyeballsState;
+  CHECK(!happyEyeballsState.finished);
+  if (happyEyeballsState.secondPeerAddress.isInitialized() &&
+      !happyEyeballsState.secondSocketStarted) {
+    happyEyeballsStartSecondSocket(happyEyeballsState);
+    return;
+  }
+  if (happyEyeballsState.pendingPeerAddresses.empty()) {
+    return;
+  }
+  auto peerAddress = std::move(happyEyeballsState.pendingPeerAddresses.front());
+  happyEyeballsState.pendingPeerAddresses.pop_front();
+  QUIC_TRACE(
+      happy_eyeballs, connection, "attempt", peerAddress.getAddressStr());
+  happyEyeballsState.attempts++;
+  if (peerAddress.getFamily() == connection.peerAddress.getFamily()) {
+    happyEyeballsState.firstSocketPeerAddresses.push_back(
+        std::move(peerAddress));
+  } else {
+    happyEyeballsState.secondSocketPeerAddresses.push_back(
+        std::move(peerAddress));
+  }
 }
 
 void happyEyeballsOnDataReceived(
@@ -174,19 +276,37 @@ void happyEyeballsOnDataReceived(
     return;
   }
   QUIC_TRACE(happy_eyeballs, connection, "finish", peerAddress.getAddressStr());
+  auto& happyEyeballsState = connection.happyEyeballsState;
   connAttemptDelayTimeout.cancelTimeout();
-  connection.happyEyeballsState.finished = true;
-  connection.happyEyeballsState.shouldWriteToFirstSocket = true;
-  connection.happyEyeballsState.shouldWriteToSecondSocket = false;
+  happyEyeballsState.finished = true;
+  happyEyeballsState.shouldWriteToFirstSocket = true;
+  happyEyeballsState.shouldWriteToSecondSocket = false;
   // If second socket won, update main socket and peerAddress
-  if (connection.peerAddress.getFamily() != peerAddress.getFamily()) {
-    socket.swap(connection.happyEyeballsState.secondSocket);
+  if (connection.peerAddress.getFamily() != peerAddress.getFamily() &&
+      happyEyeballsState.secondPeerAddress.isInitialized()) {
+    QUIC_TRACE(happy_eyeballs, connection, "second socket won");
+    socket.swap(happyEyeballsState.secondSocket);
+    happyEyeballsState.secondSocketWon = true;
+    connection.originalPeerAddress = peerAddress;
+    connection.peerAddress = peerAddress;
+  } else if (
+      connection.peerAddress != peerAddress &&
+      std::find(
+          happyEyeballsState.firstSocketPeerAddresses.begin(),
+          happyEyeballsState.firstSocketPeerAddresses.end(),
+          peerAddress) != happyEyeballsState.firstSocketPeerAddresses.end()) {
+    // A later attempt over the first socket won
     connection.originalPeerAddress = peerAddress;
     connection.peerAddress = peerAddress;
   }
-  connection.happyEyeballsState.secondSocket->pauseRead();
-  connection.happyEyeballsState.secondSocket->close();
-  connection.happyEyeballsState.secondSocket.reset();
+  happyEyeballsState.pendingPeerAddresses.clear();
+  happyEyeballsState.firstSocketPeerAddresses.clear();
+  happyEyeballsState.secondSocketPeerAddresses.clear();
+  if (happyEyeballsState.secondSocket) {
+    happyEyeballsState.secondSocket->pauseRead();
+    happyEyeballsState.secondSocket->close();
+    happyEyeballsState.secondSocket.reset();
+  }
 }
 
 } // namespace quic
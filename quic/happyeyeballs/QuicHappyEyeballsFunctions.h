@@ -29,6 +29,14 @@ void happyEyeballsAddPeerAddress(
     QuicConnectionStateBase& connection,
     const folly::SocketAddress& peerAddress);
 
+/**
+ * Makes peerAddress, if it was added, the first attempted of its family.
+ * Returns whether it was added.
+ */
+bool happyEyeballsPreferPeerAddress(
+    QuicConnectionStateBase& connection,
+    const folly::SocketAddress& peerAddress);
+
 void happyEyeballsAddSocket(
     QuicConnectionStateBase& connection,
     std::unique_ptr<folly::AsyncUDPSocket> socket);
@@ -57,6 +65,13 @@ void happyEyeballsSetUpSocket(
 void happyEyeballsStartSecondSocket(
     QuicConnectionStateBase::HappyEyeballsState& happyEyeballsState);
 
+/**
+ * Starts the second socket if it was not started yet, else attempts the next
+ * of the pending addresses. The next attempt is due after
+ * kHappyEyeballsNextAttemptDelay while there are pending addresses left.
+ */
+void happyEyeballsStartNextAttempt(QuicConnectionStateBase& connection);
+
 void happyEyeballsOnDataReceived(
     QuicConnectionStateBase& connection,
     folly::HHWheelTimer::Callback& connAttemptDelayTimeout,
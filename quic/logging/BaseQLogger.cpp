@@ -69,6 +69,29 @@ void addQuicSimpleFrameToEvent(
       event->frames.push_back(std::make_unique<quic::HandshakeDoneFrameLog>());
       break;
     }
+    case quic::QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const quic::AckFrequencyFrame& frame = *simpleFrame.asAckFrequencyFrame();
+      event->frames.push_back(std::make_unique<quic::AckFrequencyFrameLog>(
+          frame.sequenceNumber,
+          frame.packetTolerance,
+          frame.updateMaxAckDelay,
+          frame.ignoreOrder));
+      break;
+    }
+    case quic::QuicSimpleFrame::Type::ImmediateAckFrame_E: {
+      event->frames.push_back(std::make_unique<quic::ImmediateAckFrameLog>());
+      break;
+    }
+    case quic::QuicSimpleFrame::Type::StreamRepairFrame_E: {
+      const quic::StreamRepairFrame& frame = *simpleFrame.asStreamRepairFrame();
+      event->frames.push_back(std::make_unique<quic::StreamRepairFrameLog>(
+          frame.streamId,
+          frame.ranges.front().offset,
+          frame.totalLength(),
+          frame.ranges.size(),
+          frame.fin));
+      break;
+    }
   }
 }
 } // namespace
@@ -172,6 +195,12 @@ std::unique_ptr<QLogPacketEvent> BaseQLogger::createPacketEvent(
         addQuicSimpleFrameToEvent(event.get(), simpleFrame);
         break;
       }
+      case QuicFrame::Type::DatagramFrame_E: {
+        const auto& frame = *quicFrame.asDatagramFrame();
+        event->frames.push_back(
+            std::make_unique<DatagramFrameLog>(frame.length));
+        break;
+      }
       case QuicFrame::Type::NoopFrame_E: {
         break;
       }
@@ -273,6 +302,12 @@ std::unique_ptr<QLogPacketEvent> BaseQLogger::createPacketEvent(
         addQuicSimpleFrameToEvent(event.get(), simpleFrame);
         break;
       }
+      case QuicWriteFrame::Type::DatagramFrame_E: {
+        const DatagramFrame& frame = *quicFrame.asDatagramFrame();
+        event->frames.push_back(
+            std::make_unique<DatagramFrameLog>(frame.length));
+        break;
+      }
       default:
         break;
     }
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/BinaryQLogger.h>
+
+#include <folly/FileUtil.h>
+#include <folly/io/Cursor.h>
+
+#include <fcntl.h>
+
+#include <unordered_set>
+
+namespace quic {
+
+namespace {
+
+template <class T>
+folly::ByteRange asBytes(const T& value) {
+  return folly::ByteRange(
+      reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+uint8_t headerType(const PacketHeader& header) {
+  auto longHeader = header.asLong();
+  return longHeader ? static_cast<uint8_t>(longHeader->getHeaderType()) + 1
+                    : 0;
+}
+
+std::string packetTypeString(uint8_t headerType) {
+  if (headerType == 0) {
+    return kShortHeaderPacketType.toString();
+  }
+  return toString(static_cast<LongHeader::Types>(headerType - 1));
+}
+
+// The string as a length byte and up to 255 bytes of it
+struct ShortString {
+  explicit ShortString(folly::StringPiece str)
+      : length(static_cast<uint8_t>(std::min<size_t>(str.size(), 255))),
+        data(reinterpret_cast<const uint8_t*>(str.data()), length) {}
+
+  uint8_t length;
+  folly::ByteRange data;
+};
+
+template <class T>
+T readPod(folly::ByteRange& payload) {
+  T value;
+  if (payload.size() < sizeof(value)) {
+    throw std::runtime_error("Truncated binary qlog record");
+  }
+  memcpy(&value, payload.data(), sizeof(value));
+  payload.advance(sizeof(value));
+  return value;
+}
+
+// A converted connection, which keeps the strings its events point to.
+class BinaryQLogConnection : public FileQLogger {
+ public:
+  using FileQLogger::FileQLogger;
+
+  folly::StringPiece readShortString(folly::ByteRange& payload) {
+    auto length = readPod<uint8_t>(payload);
+    if (payload.size() < length) {
+      throw std::runtime_error("Truncated binary qlog string");
+    }
+    // The elements of a node based set stay where they are.
+    auto& str = *strings_
+                     .emplace(
+                         reinterpret_cast<const char*>(payload.data()),
+                         length)
+                     .first;
+    payload.advance(length);
+    return str;
+  }
+
+ private:
+  std::unordered_set<std::string> strings_;
+};
+
+} // namespace
+
+BinaryQLogWriter::BinaryQLogWriter(const std::string& path, size_t bufferSize)
+    : file_(path, O_WRONLY | O_CREAT | O_APPEND), buffer_(bufferSize) {
+  CHECK_GE(bufferSize, 4096);
+}
+
+BinaryQLogWriter::~BinaryQLogWriter() {
+  flush();
+}
+
+uint32_t BinaryQLogWriter::addConnection() noexcept {
+  return connections_++;
+}
+
+void BinaryQLogWriter::write(
+    BinaryQLogRecordType type,
+    uint32_t connection,
+    std::chrono::microseconds refTime,
+    std::initializer_list<folly::ByteRange> payloads) {
+  size_t length = 0;
+  for (const auto& payload : payloads) {
+    length += payload.size();
+  }
+  BinaryQLogRecordHeader header;
+  header.type = type;
+  header.length = static_cast<uint16_t>(length);
+  header.connection = connection;
+  header.refTimeUs = refTime.count();
+  size_t total = sizeof(header) + length;
+  CHECK_LE(total, buffer_.size());
+  if (used_ + total > buffer_.size()) {
+    flush();
+  }
+  memcpy(buffer_.data() + used_, &header, sizeof(header));
+  used_ += sizeof(header);
+  for (const auto& payload : payloads) {
+    memcpy(buffer_.data() + used_, payload.data(), payload.size());
+    used_ += payload.size();
+  }
+}
+
+void BinaryQLogWriter::flush() {
+  if (used_ == 0) {
+    return;
+  }
+  if (folly::writeFull(file_.fd(), buffer_.data(), used_) < 0) {
+    LOG(ERROR) << "Error writing binary qlog, errno=" << errno;
+  }
+  used_ = 0;
+}
+
+BinaryQLogger::BinaryQLogger(
+    VantagePoint vantagePointIn,
+    std::shared_ptr<BinaryQLogWriter> writer,
+    std::string protocolTypeIn)
+    : QLogger(vantagePointIn, std::move(protocolTypeIn)),
+      writer_(std::move(writer)) {
+  CHECK(writer_);
+  connection_ = writer_->addConnection();
+  BinaryQLogConnection record{static_cast<uint8_t>(vantagePoint), 0};
+  writer_->write(
+      BinaryQLogRecordType::Connection, connection_, 0us, {asBytes(record)});
+}
+
+std::chrono::microseconds BinaryQLogger::now() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+}
+
+void BinaryQLogger::maybeWriteConnection() {
+  if (connectionWritten_ || !dcid) {
+    return;
+  }
+  connectionWritten_ = true;
+  BinaryQLogConnection record{static_cast<uint8_t>(vantagePoint),
+                              static_cast<uint8_t>(dcid->size())};
+  writer_->write(
+      BinaryQLogRecordType::Connection,
+      connection_,
+      now(),
+      {asBytes(record), folly::ByteRange(dcid->data(), dcid->size())});
+}
+
+void BinaryQLogger::writeAck(
+    std::chrono::microseconds refTime,
+    const BinaryQLogAckBlock* blocks,
+    uint32_t numBlocks,
+    std::chrono::microseconds ackDelay) {
+  BinaryQLogAck ack{};
+  ack.ackDelayUs = ackDelay.count();
+  ack.numBlocks = numBlocks;
+  writer_->write(
+      BinaryQLogRecordType::Ack,
+      connection_,
+      refTime,
+      {asBytes(ack),
+       folly::ByteRange(
+           reinterpret_cast<const uint8_t*>(blocks),
+           numBlocks * sizeof(BinaryQLogAckBlock))});
+}
+
+void BinaryQLogger::addPacket(
+    const RegularQuicPacket& regularPacket,
+    uint64_t packetSize) {
+  maybeWriteConnection();
+  auto refTime = now();
+  BinaryQLogPacket packet{};
+  packet.headerType = headerType(regularPacket.header);
+  if (packet.headerType !=
+      static_cast<uint8_t>(LongHeader::Types::Retry) + 1) {
+    packet.packetNum = regularPacket.header.getPacketSequenceNum();
+  }
+  packet.packetSize = packetSize;
+  writer_->write(
+      BinaryQLogRecordType::PacketReceived,
+      connection_,
+      refTime,
+      {asBytes(packet)});
+  for (const auto& quicFrame : regularPacket.frames) {
+    auto ackFrame = quicFrame.asReadAckFrame();
+    if (ackFrame) {
+      BinaryQLogAckBlock blocks[kBinaryQLogMaxAckBlocks];
+      uint32_t numBlocks = 0;
+      for (const auto& block : ackFrame->ackBlocks) {
+        if (numBlocks == kBinaryQLogMaxAckBlocks) {
+          break;
+        }
+        blocks[numBlocks++] = {block.startPacket, block.endPacket};
+      }
+      writeAck(refTime, blocks, numBlocks, ackFrame->ackDelay);
+    }
+  }
+}
+
+void BinaryQLogger::addPacket(
+    const RegularQuicWritePacket& writePacket,
+    uint64_t packetSize) {
+  maybeWriteConnection();
+  auto refTime = now();
+  BinaryQLogPacket packet{};
+  packet.headerType = headerType(writePacket.header);
+  packet.packetNum = writePacket.header.getPacketSequenceNum();
+  packet.packetSize = packetSize;
+  writer_->write(
+      BinaryQLogRecordType::PacketSent,
+      connection_,
+      refTime,
+      {asBytes(packet)});
+  for (const auto& quicFrame : writePacket.frames) {
+    auto ackFrame = quicFrame.asWriteAckFrame();
+    if (ackFrame) {
+      BinaryQLogAckBlock blocks[kBinaryQLogMaxAckBlocks];
+      uint32_t numBlocks = 0;
+      for (const auto& block : ackFrame->ackBlocks) {
+        if (numBlocks == kBinaryQLogMaxAckBlocks) {
+          break;
+        }
+        blocks[numBlocks++] = {block.start, block.end};
+      }
+      writeAck(refTime, blocks, numBlocks, ackFrame->ackDelay);
+    }
+  }
+}
+
+void BinaryQLogger::addPacket(
+    const VersionNegotiationPacket&,
+    uint64_t,
+    bool) {}
+
+void BinaryQLogger::addConnectionClose(
+    std::string,
+    std::string,
+    bool,
+    bool) {}
+
+void BinaryQLogger::addTransportSummary(
+    uint64_t,
+    uint64_t,
+    uint64_t,
+    uint64_t,
+    uint64_t,
+    uint64_t,
+    uint64_t,
+    uint64_t,
+    uint64_t,
+    uint64_t) {}
+
+void BinaryQLogger::addCongestionMetricUpdate(
+    uint64_t bytesInFlight,
+    uint64_t currentCwnd,
+    folly::StringPiece congestionEvent,
+    folly::StringPiece state,
+    folly::StringPiece recoveryState) {
+  maybeWriteConnection();
+  BinaryQLogCongestionMetric metric{bytesInFlight, currentCwnd};
+  ShortString event(congestionEvent);
+  ShortString stateString(state);
+  ShortString recovery(recoveryState);
+  writer_->write(
+      BinaryQLogRecordType::CongestionMetric,
+      connection_,
+      now(),
+      {asBytes(metric),
+       asBytes(event.length),
+       event.data,
+       asBytes(stateString.length),
+       stateString.data,
+       asBytes(recovery.length),
+       recovery.data});
+}
+
+void BinaryQLogger::addBandwidthEstUpdate(
+    uint64_t,
+    std::chrono::microseconds) {}
+
+void BinaryQLogger::addAppLimitedUpdate() {}
+
+void BinaryQLogger::addAppUnlimitedUpdate() {}
+
+void BinaryQLogger::addPacingMetricUpdate(
+    uint64_t pacingBurstSizeIn,
+    std::chrono::microseconds pacingIntervalIn) {
+  maybeWriteConnection();
+  BinaryQLogPacingMetric metric{
+      pacingBurstSizeIn, static_cast<uint64_t>(pacingIntervalIn.count())};
+  writer_->write(
+      BinaryQLogRecordType::PacingMetric,
+      connection_,
+      now(),
+      {asBytes(metric)});
+}
+
+void BinaryQLogger::addPacingObservation(
+    std::string,
+    std::string,
+    std::string) {}
+
+void BinaryQLogger::addAppIdleUpdate(folly::StringPiece, bool) {}
+
+void BinaryQLogger::addPacketDrop(size_t, folly::StringPiece) {}
+
+void BinaryQLogger::addDatagramReceived(uint64_t) {}
+
+void BinaryQLogger::addLossAlarm(
+    PacketNum,
+    uint64_t,
+    uint64_t,
+    folly::StringPiece) {}
+
+void BinaryQLogger::addPacketsLost(
+    PacketNum largestLostPacketNum,
+    uint64_t lostBytes,
+    uint64_t lostPackets) {
+  maybeWriteConnection();
+  BinaryQLogPacketsLost lost{largestLostPacketNum, lostBytes, lostPackets};
+  writer_->write(
+      BinaryQLogRecordType::PacketsLost, connection_, now(), {asBytes(lost)});
+}
+
+void BinaryQLogger::addTransportStateUpdate(std::string) {}
+
+void BinaryQLogger::addPacketBuffered(PacketNum, ProtectionType, uint64_t) {}
+
+void BinaryQLogger::addMetricUpdate(
+    std::chrono::microseconds latestRtt,
+    std::chrono::microseconds mrtt,
+    std::chrono::microseconds srtt,
+    std::chrono::microseconds ackDelay) {
+  maybeWriteConnection();
+  BinaryQLogRttMetric metric{static_cast<uint64_t>(latestRtt.count()),
+                             static_cast<uint64_t>(mrtt.count()),
+                             static_cast<uint64_t>(srtt.count()),
+                             static_cast<uint64_t>(ackDelay.count())};
+  writer_->write(
+      BinaryQLogRecordType::RttMetric, connection_, now(), {asBytes(metric)});
+}
+
+void BinaryQLogger::addStreamStateUpdate(
+    StreamId,
+    std::string,
+    folly::Optional<std::chrono::milliseconds>) {}
+
+void BinaryQLogger::addConnectionMigrationUpdate(bool) {}
+
+void BinaryQLogger::addPathValidationEvent(bool) {}
+
+std::vector<std::unique_ptr<FileQLogger>> readBinaryQLog(
+    folly::ByteRange data) {
+  std::vector<std::unique_ptr<BinaryQLogConnection>> connections;
+  // The packet events the acks that follow belong to.
+  std::vector<QLogPacketEvent*> lastPackets;
+  while (!data.empty()) {
+    auto header = readPod<BinaryQLogRecordHeader>(data);
+    if (data.size() < header.length) {
+      throw std::runtime_error("Truncated binary qlog record");
+    }
+    auto payload = data.subpiece(0, header.length);
+    data.advance(header.length);
+    while (connections.size() <= header.connection) {
+      connections.push_back(
+          std::make_unique<BinaryQLogConnection>(VantagePoint::Server));
+      lastPackets.push_back(nullptr);
+    }
+    auto& logger = *connections[header.connection];
+    std::chrono::microseconds refTime(header.refTimeUs);
+    switch (header.type) {
+      case BinaryQLogRecordType::Connection: {
+        auto record = readPod<BinaryQLogConnection>(payload);
+        logger.vantagePoint = static_cast<VantagePoint>(record.vantagePoint);
+        if (record.dcidLength > 0) {
+          if (payload.size() < record.dcidLength) {
+            throw std::runtime_error("Truncated binary qlog dcid");
+          }
+          logger.dcid = ConnectionId(std::vector<uint8_t>(
+              payload.begin(), payload.begin() + record.dcidLength));
+        }
+        break;
+      }
+      case BinaryQLogRecordType::PacketSent:
+      case BinaryQLogRecordType::PacketReceived: {
+        auto record = readPod<BinaryQLogPacket>(payload);
+        auto event = std::make_unique<QLogPacketEvent>();
+        event->refTime = refTime;
+        event->eventType = header.type == BinaryQLogRecordType::PacketSent
+            ? QLogEventType::PacketSent
+            : QLogEventType::PacketReceived;
+        event->packetType = packetTypeString(record.headerType);
+        event->packetNum = record.packetNum;
+        event->packetSize = record.packetSize;
+        lastPackets[header.connection] = event.get();
+        logger.logs.push_back(std::move(event));
+        break;
+      }
+      case BinaryQLogRecordType::Ack: {
+        auto record = readPod<BinaryQLogAck>(payload);
+        auto packet = lastPackets[header.connection];
+        std::chrono::microseconds ackDelay(record.ackDelayUs);
+        if (packet && packet->eventType == QLogEventType::PacketSent) {
+          WriteAckFrame::AckBlockVec blocks;
+          for (uint32_t i = 0; i < record.numBlocks; i++) {
+            auto block = readPod<BinaryQLogAckBlock>(payload);
+            blocks.emplace_back(block.start, block.end);
+          }
+          packet->frames.push_back(
+              std::make_unique<WriteAckFrameLog>(blocks, ackDelay));
+        } else if (packet) {
+          ReadAckFrame::Vec blocks;
+          for (uint32_t i = 0; i < record.numBlocks; i++) {
+            auto block = readPod<BinaryQLogAckBlock>(payload);
+            blocks.emplace_back(block.start, block.end);
+          }
+          packet->frames.push_back(
+              std::make_unique<ReadAckFrameLog>(blocks, ackDelay));
+        }
+        break;
+      }
+      case BinaryQLogRecordType::PacketsLost: {
+        auto record = readPod<BinaryQLogPacketsLost>(payload);
+        logger.logs.push_back(std::make_unique<QLogPacketsLostEvent>(
+            record.largestLostPacketNum,
+            record.lostBytes,
+            record.lostPackets,
+            refTime));
+        break;
+      }
+      case BinaryQLogRecordType::CongestionMetric: {
+        auto record = readPod<BinaryQLogCongestionMetric>(payload);
+        auto event = logger.readShortString(payload);
+        auto state = logger.readShortString(payload);
+        auto recoveryState = logger.readShortString(payload);
+        logger.logs.push_back(std::make_unique<QLogCongestionMetricUpdateEvent>(
+            record.bytesInFlight,
+            record.currentCwnd,
+            event,
+            state,
+            recoveryState,
+            refTime));
+        break;
+      }
+      case BinaryQLogRecordType::PacingMetric: {
+        auto record = readPod<BinaryQLogPacingMetric>(payload);
+        logger.logs.push_back(std::make_unique<QLogPacingMetricUpdateEvent>(
+            record.pacingBurstSize,
+            std::chrono::microseconds(record.pacingIntervalUs),
+            refTime));
+        break;
+      }
+      case BinaryQLogRecordType::RttMetric: {
+        auto record = readPod<BinaryQLogRttMetric>(payload);
+        logger.logs.push_back(std::make_unique<QLogMetricUpdateEvent>(
+            std::chrono::microseconds(record.latestRttUs),
+            std::chrono::microseconds(record.mrttUs),
+            std::chrono::microseconds(record.srttUs),
+            std::chrono::microseconds(record.ackDelayUs),
+            refTime));
+        break;
+      }
+      default:
+        // Records of later versions of the format.
+        break;
+    }
+  }
+  std::vector<std::unique_ptr<FileQLogger>> loggers;
+  loggers.reserve(connections.size());
+  for (auto& connection : connections) {
+    loggers.push_back(std::move(connection));
+  }
+  return loggers;
+}
+
+} // namespace quic
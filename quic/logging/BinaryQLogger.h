@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/logging/FileQLogger.h>
+#include <quic/logging/QLogger.h>
+
+#include <folly/File.h>
+#include <folly/Range.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Binary qlog format. A file is a sequence of records, each a
+ * BinaryQLogRecordHeader followed by length bytes of payload, all in host
+ * byte order. Packet, ack, loss, congestion, pacing and rtt events have
+ * fixed layout payloads, so they are logged with a few stores instead of
+ * allocating an event and going through folly::dynamic. The other events
+ * are not recorded. readBinaryQLog turns a file back into the events of the
+ * FileQLogger, to output as standard qlog JSON.
+ */
+enum class BinaryQLogRecordType : uint8_t {
+  // BinaryQLogConnection, followed by the dcid
+  Connection = 0,
+  // BinaryQLogPacket
+  PacketSent = 1,
+  PacketReceived = 2,
+  // BinaryQLogAck, followed by numBlocks BinaryQLogAckBlocks, for the last
+  // packet of the connection
+  Ack = 3,
+  // BinaryQLogPacketsLost
+  PacketsLost = 4,
+  // BinaryQLogCongestionMetric, followed by the three strings
+  CongestionMetric = 5,
+  // BinaryQLogPacingMetric
+  PacingMetric = 6,
+  // BinaryQLogRttMetric
+  RttMetric = 7,
+};
+
+struct BinaryQLogRecordHeader {
+  BinaryQLogRecordType type;
+  uint8_t reserved{0};
+  uint16_t length;
+  // index of the connection in the file
+  uint32_t connection;
+  // since the start of the connection
+  uint64_t refTimeUs;
+};
+
+struct BinaryQLogConnection {
+  uint8_t vantagePoint;
+  uint8_t dcidLength;
+};
+
+struct BinaryQLogPacket {
+  uint64_t packetNum;
+  uint64_t packetSize;
+  // 0 for short headers, 1 + the LongHeader::Types otherwise
+  uint8_t headerType;
+};
+
+struct BinaryQLogAck {
+  uint64_t ackDelayUs;
+  uint32_t numBlocks;
+};
+
+struct BinaryQLogAckBlock {
+  uint64_t start;
+  uint64_t end;
+};
+
+struct BinaryQLogPacketsLost {
+  uint64_t largestLostPacketNum;
+  uint64_t lostBytes;
+  uint64_t lostPackets;
+};
+
+// Each string is a length byte followed by up to 255 bytes.
+struct BinaryQLogCongestionMetric {
+  uint64_t bytesInFlight;
+  uint64_t currentCwnd;
+};
+
+struct BinaryQLogPacingMetric {
+  uint64_t pacingBurstSize;
+  uint64_t pacingIntervalUs;
+};
+
+struct BinaryQLogRttMetric {
+  uint64_t latestRttUs;
+  uint64_t mrttUs;
+  uint64_t srttUs;
+  uint64_t ackDelayUs;
+};
+
+/**
+ * Buffers the records of the connections of one thread, e.g. a server
+ * worker, and appends them to a file once the buffer is full. Memory stays
+ * at the buffer size however many connections log. Not thread safe, each
+ * thread needs a writer of its own.
+ */
+class BinaryQLogWriter {
+ public:
+  explicit BinaryQLogWriter(
+      const std::string& path,
+      size_t bufferSize = kDefaultBinaryQLogBufferSize);
+
+  // Writes out what is buffered.
+  ~BinaryQLogWriter();
+
+  // A new index for the records of a connection
+  uint32_t addConnection() noexcept;
+
+  /**
+   * Appends a record of the type with the payloads, one after the other.
+   */
+  void write(
+      BinaryQLogRecordType type,
+      uint32_t connection,
+      std::chrono::microseconds refTime,
+      std::initializer_list<folly::ByteRange> payloads);
+
+  void flush();
+
+ private:
+  folly::File file_;
+  std::vector<uint8_t> buffer_;
+  size_t used_{0};
+  uint32_t connections_{0};
+};
+
+/**
+ * QLogger that encodes its events into a BinaryQLogWriter.
+ */
+class BinaryQLogger : public QLogger {
+ public:
+  BinaryQLogger(
+      VantagePoint vantagePointIn,
+      std::shared_ptr<BinaryQLogWriter> writer,
+      std::string protocolTypeIn = kHTTP3ProtocolType);
+
+  ~BinaryQLogger() override = default;
+
+  void addPacket(const RegularQuicPacket& regularPacket, uint64_t packetSize)
+      override;
+  void addPacket(
+      const VersionNegotiationPacket& versionPacket,
+      uint64_t packetSize,
+      bool isPacketRecvd) override;
+  void addPacket(const RegularQuicWritePacket& writePacket, uint64_t packetSize)
+      override;
+  void addConnectionClose(
+      std::string error,
+      std::string reason,
+      bool drainConnection,
+      bool sendCloseImmediately) override;
+  void addTransportSummary(
+      uint64_t totalBytesSent,
+      uint64_t totalBytesRecvd,
+      uint64_t sumCurWriteOffset,
+      uint64_t sumMaxObservedOffset,
+      uint64_t sumCurStreamBufferLen,
+      uint64_t totalBytesRetransmitted,
+      uint64_t totalStreamBytesCloned,
+      uint64_t totalBytesCloned,
+      uint64_t totalCryptoDataWritten,
+      uint64_t totalCryptoDataRecvd) override;
+  void addCongestionMetricUpdate(
+      uint64_t bytesInFlight,
+      uint64_t currentCwnd,
+      folly::StringPiece congestionEvent,
+      folly::StringPiece state = "",
+      folly::StringPiece recoveryState = "") override;
+  void addBandwidthEstUpdate(uint64_t bytes, std::chrono::microseconds interval)
+      override;
+  void addAppLimitedUpdate() override;
+  void addAppUnlimitedUpdate() override;
+  void addPacingMetricUpdate(
+      uint64_t pacingBurstSizeIn,
+      std::chrono::microseconds pacingIntervalIn) override;
+  void addPacingObservation(
+      std::string actual,
+      std::string expected,
+      std::string conclusion) override;
+  void addAppIdleUpdate(folly::StringPiece idleEvent, bool idle) override;
+  void addPacketDrop(size_t packetSize, folly::StringPiece dropReasonIn)
+      override;
+  void addDatagramReceived(uint64_t dataLen) override;
+  void addLossAlarm(
+      PacketNum largestSent,
+      uint64_t alarmCount,
+      uint64_t outstandingPackets,
+      folly::StringPiece type) override;
+  void addPacketsLost(
+      PacketNum largestLostPacketNum,
+      uint64_t lostBytes,
+      uint64_t lostPackets) override;
+  void addTransportStateUpdate(std::string update) override;
+  void addPacketBuffered(
+      PacketNum packetNum,
+      ProtectionType protectionType,
+      uint64_t packetSize) override;
+  void addMetricUpdate(
+      std::chrono::microseconds latestRtt,
+      std::chrono::microseconds mrtt,
+      std::chrono::microseconds srtt,
+      std::chrono::microseconds ackDelay) override;
+  void addStreamStateUpdate(
+      StreamId id,
+      std::string update,
+      folly::Optional<std::chrono::milliseconds> timeSinceStreamCreation)
+      override;
+  void addConnectionMigrationUpdate(bool intentionalMigration) override;
+  void addPathValidationEvent(bool success) override;
+
+ private:
+  std::chrono::microseconds now() const;
+  // Records the dcid the first time the connection has one.
+  void maybeWriteConnection();
+  void writeAck(
+      std::chrono::microseconds refTime,
+      const BinaryQLogAckBlock* blocks,
+      uint32_t numBlocks,
+      std::chrono::microseconds ackDelay);
+
+  std::shared_ptr<BinaryQLogWriter> writer_;
+  uint32_t connection_;
+  bool connectionWritten_{false};
+};
+
+/**
+ * The connections of a binary qlog, in the order they were added to the
+ * writer, with the events it has for them. Throws on a truncated record.
+ */
+std::vector<std::unique_ptr<FileQLogger>> readBinaryQLog(folly::ByteRange data);
+
+} // namespace quic
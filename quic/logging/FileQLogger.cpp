@@ -16,20 +16,20 @@ namespace quic {
 void FileQLogger::addPacket(
     const RegularQuicPacket& regularPacket,
     uint64_t packetSize) {
-  logs.push_back(createPacketEvent(regularPacket, packetSize));
+  handleEvent(createPacketEvent(regularPacket, packetSize));
 }
 
 void FileQLogger::addPacket(
     const RegularQuicWritePacket& writePacket,
     uint64_t packetSize) {
-  logs.push_back(createPacketEvent(writePacket, packetSize));
+  handleEvent(createPacketEvent(writePacket, packetSize));
 }
 
 void FileQLogger::addPacket(
     const VersionNegotiationPacket& versionPacket,
     uint64_t packetSize,
     bool isPacketRecvd) {
-  logs.push_back(createPacketEvent(versionPacket, packetSize, isPacketRecvd));
+  handleEvent(createPacketEvent(versionPacket, packetSize, isPacketRecvd));
 }
 
 void FileQLogger::addConnectionClose(
@@ -39,7 +39,7 @@ void FileQLogger::addConnectionClose(
     bool sendCloseImmediately) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
-  logs.push_back(std::make_unique<quic::QLogConnectionCloseEvent>(
+  handleEvent(std::make_unique<quic::QLogConnectionCloseEvent>(
       std::move(error),
       std::move(reason),
       drainConnection,
@@ -61,7 +61,7 @@ void FileQLogger::addTransportSummary(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogTransportSummaryEvent>(
+  handleEvent(std::make_unique<quic::QLogTransportSummaryEvent>(
       totalBytesSent,
       totalBytesRecvd,
       sumCurWriteOffset,
@@ -78,25 +78,25 @@ void FileQLogger::addTransportSummary(
 void FileQLogger::addCongestionMetricUpdate(
     uint64_t bytesInFlight,
     uint64_t currentCwnd,
-    std::string congestionEvent,
-    std::string state,
-    std::string recoveryState) {
+    folly::StringPiece congestionEvent,
+    folly::StringPiece state,
+    folly::StringPiece recoveryState) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogCongestionMetricUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogCongestionMetricUpdateEvent>(
       bytesInFlight,
       currentCwnd,
-      std::move(congestionEvent),
-      std::move(state),
-      std::move(recoveryState),
+      congestionEvent,
+      state,
+      recoveryState,
       refTime));
 }
 
 void FileQLogger::addBandwidthEstUpdate(
     uint64_t bytes,
     std::chrono::microseconds interval) {
-  logs.push_back(std::make_unique<quic::QLogBandwidthEstUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogBandwidthEstUpdateEvent>(
       bytes,
       interval,
       std::chrono::duration_cast<std::chrono::microseconds>(
@@ -104,14 +104,14 @@ void FileQLogger::addBandwidthEstUpdate(
 }
 
 void FileQLogger::addAppLimitedUpdate() {
-  logs.push_back(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
       true,
       std::chrono::duration_cast<std::chrono::microseconds>(
           std::chrono::steady_clock::now() - refTimePoint)));
 }
 
 void FileQLogger::addAppUnlimitedUpdate() {
-  logs.push_back(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
       false,
       std::chrono::duration_cast<std::chrono::microseconds>(
           std::chrono::steady_clock::now() - refTimePoint)));
@@ -122,7 +122,7 @@ void FileQLogger::addPacingMetricUpdate(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogPacingMetricUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogPacingMetricUpdateEvent>(
       pacingBurstSizeIn, pacingIntervalIn, refTime));
 }
 
@@ -132,31 +132,33 @@ void FileQLogger::addPacingObservation(
     std::string conclusion) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
-  logs.push_back(std::make_unique<quic::QLogPacingObservationEvent>(
+  handleEvent(std::make_unique<quic::QLogPacingObservationEvent>(
       std::move(actual), std::move(expect), std::move(conclusion), refTime));
 }
 
-void FileQLogger::addAppIdleUpdate(std::string idleEvent, bool idle) {
+void FileQLogger::addAppIdleUpdate(folly::StringPiece idleEvent, bool idle) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogAppIdleUpdateEvent>(
-      std::move(idleEvent), idle, refTime));
+  handleEvent(std::make_unique<quic::QLogAppIdleUpdateEvent>(
+      idleEvent, idle, refTime));
 }
 
-void FileQLogger::addPacketDrop(size_t packetSize, std::string dropReason) {
+void FileQLogger::addPacketDrop(
+    size_t packetSize,
+    folly::StringPiece dropReason) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogPacketDropEvent>(
-      packetSize, std::move(dropReason), refTime));
+  handleEvent(std::make_unique<quic::QLogPacketDropEvent>(
+      packetSize, dropReason, refTime));
 }
 
 void FileQLogger::addDatagramReceived(uint64_t dataLen) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(
+  handleEvent(
       std::make_unique<quic::QLogDatagramReceivedEvent>(dataLen, refTime));
 }
 
@@ -164,12 +166,12 @@ void FileQLogger::addLossAlarm(
     PacketNum largestSent,
     uint64_t alarmCount,
     uint64_t outstandingPackets,
-    std::string type) {
+    folly::StringPiece type) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogLossAlarmEvent>(
-      largestSent, alarmCount, outstandingPackets, std::move(type), refTime));
+  handleEvent(std::make_unique<quic::QLogLossAlarmEvent>(
+      largestSent, alarmCount, outstandingPackets, type, refTime));
 }
 
 void FileQLogger::addPacketsLost(
@@ -179,7 +181,7 @@ void FileQLogger::addPacketsLost(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogPacketsLostEvent>(
+  handleEvent(std::make_unique<quic::QLogPacketsLostEvent>(
       largestLostPacketNum, lostBytes, lostPackets, refTime));
 }
 
@@ -187,7 +189,7 @@ void FileQLogger::addTransportStateUpdate(std::string update) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogTransportStateUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogTransportStateUpdateEvent>(
       std::move(update), refTime));
 }
 
@@ -198,7 +200,7 @@ void FileQLogger::addPacketBuffered(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogPacketBufferedEvent>(
+  handleEvent(std::make_unique<quic::QLogPacketBufferedEvent>(
       packetNum, protectionType, packetSize, refTime));
 }
 
@@ -210,7 +212,7 @@ void FileQLogger::addMetricUpdate(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogMetricUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogMetricUpdateEvent>(
       latestRtt, mrtt, srtt, ackDelay, refTime));
 }
 
@@ -274,7 +276,7 @@ void FileQLogger::addStreamStateUpdate(
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
 
-  logs.push_back(std::make_unique<quic::QLogStreamStateUpdateEvent>(
+  handleEvent(std::make_unique<quic::QLogStreamStateUpdateEvent>(
       id,
       std::move(update),
       std::move(timeSinceStreamCreation),
@@ -285,17 +287,21 @@ void FileQLogger::addStreamStateUpdate(
 void FileQLogger::addConnectionMigrationUpdate(bool intentionalMigration) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
-  logs.push_back(std::make_unique<quic::QLogConnectionMigrationEvent>(
+  handleEvent(std::make_unique<quic::QLogConnectionMigrationEvent>(
       intentionalMigration, vantagePoint, refTime));
 }
 
 void FileQLogger::addPathValidationEvent(bool success) {
   auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
       std::chrono::steady_clock::now() - refTimePoint);
-  logs.push_back(std::make_unique<quic::QLogPathValidationEvent>(
+  handleEvent(std::make_unique<quic::QLogPathValidationEvent>(
       success, vantagePoint, refTime));
 }
 
+void FileQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  logs.push_back(std::move(event));
+}
+
 void FileQLogger::outputLogsToFile(const std::string& path, bool prettyJson) {
   if (!dcid.has_value()) {
     LOG(ERROR) << "Error: No dcid found";
@@ -52,9 +52,9 @@ class FileQLogger : public BaseQLogger {
   void addCongestionMetricUpdate(
       uint64_t bytesInFlight,
       uint64_t currentCwnd,
-      std::string congestionEvent,
-      std::string state = "",
-      std::string recoveryState = "") override;
+      folly::StringPiece congestionEvent,
+      folly::StringPiece state = "",
+      folly::StringPiece recoveryState = "") override;
   void addPacingMetricUpdate(
       uint64_t pacingBurstSizeIn,
       std::chrono::microseconds pacingIntervalIn) override;
@@ -66,14 +66,15 @@ class FileQLogger : public BaseQLogger {
       override;
   void addAppLimitedUpdate() override;
   void addAppUnlimitedUpdate() override;
-  void addAppIdleUpdate(std::string idleEvent, bool idle) override;
-  void addPacketDrop(size_t packetSize, std::string dropReasonIn) override;
+  void addAppIdleUpdate(folly::StringPiece idleEvent, bool idle) override;
+  void addPacketDrop(size_t packetSize, folly::StringPiece dropReasonIn)
+      override;
   void addDatagramReceived(uint64_t dataLen) override;
   void addLossAlarm(
       PacketNum largestSent,
       uint64_t alarmCount,
       uint64_t outstandingPackets,
-      std::string type) override;
+      folly::StringPiece type) override;
   void addPacketsLost(
       PacketNum largestLostPacketNum,
       uint64_t lostBytes,
@@ -98,5 +99,9 @@ class FileQLogger : public BaseQLogger {
 
   void outputLogsToFile(const std::string& path, bool prettyJson);
   folly::dynamic toDynamic() const;
+
+ protected:
+  // Where the events go once they are made, logs by default.
+  virtual void handleEvent(std::unique_ptr<QLogEvent> event);
 };
 } // namespace quic
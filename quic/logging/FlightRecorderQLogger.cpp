@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/FlightRecorderQLogger.h>
+
+#include <folly/Conv.h>
+#include <folly/json.h>
+
+#include <fstream>
+
+namespace quic {
+
+FlightRecorderQLogger::FlightRecorderQLogger(
+    VantagePoint vantagePointIn,
+    FlightRecorderQLogConfig config,
+    std::string protocolTypeIn)
+    : FileQLogger(vantagePointIn, std::move(protocolTypeIn)),
+      config_(std::move(config)) {
+  CHECK_GT(config_.maxEvents, 0);
+  ring_.reserve(config_.maxEvents);
+}
+
+void FlightRecorderQLogger::addConnectionClose(
+    std::string error,
+    std::string reason,
+    bool drainConnection,
+    bool sendCloseImmediately) {
+  bool isError = error != kNoError;
+  auto triggerReason = folly::to<std::string>("connection error: ", error);
+  FileQLogger::addConnectionClose(
+      std::move(error),
+      std::move(reason),
+      drainConnection,
+      sendCloseImmediately);
+  if (config_.persistOnError && isError) {
+    trigger(triggerReason);
+  }
+}
+
+void FlightRecorderQLogger::addLossAlarm(
+    PacketNum largestSent,
+    uint64_t alarmCount,
+    uint64_t outstandingPackets,
+    folly::StringPiece type) {
+  FileQLogger::addLossAlarm(largestSent, alarmCount, outstandingPackets, type);
+  // Only once per run of PTOs, the count goes up by one with each.
+  if (type == kPtoAlarm && config_.ptoThreshold > 0 &&
+      alarmCount == config_.ptoThreshold) {
+    trigger(folly::to<std::string>("pto count: ", alarmCount));
+  }
+}
+
+void FlightRecorderQLogger::addMetricUpdate(
+    std::chrono::microseconds latestRtt,
+    std::chrono::microseconds mrtt,
+    std::chrono::microseconds srtt,
+    std::chrono::microseconds ackDelay) {
+  FileQLogger::addMetricUpdate(latestRtt, mrtt, srtt, ackDelay);
+  if (config_.rttSpikeFactor > 0 && srtt.count() > 0 &&
+      static_cast<uint64_t>(latestRtt.count()) >
+          static_cast<uint64_t>(srtt.count()) * config_.rttSpikeFactor) {
+    trigger(folly::to<std::string>(
+        "rtt spike: ", latestRtt.count(), "us, srtt: ", srtt.count(), "us"));
+  }
+}
+
+bool FlightRecorderQLogger::trigger(const std::string& reason) {
+  if (numPersisted_ >= config_.maxPersists) {
+    return false;
+  }
+  if (!dcid.has_value()) {
+    LOG(ERROR) << "Error: No dcid found";
+    return false;
+  }
+  addTransportStateUpdate(
+      folly::to<std::string>(kFlightRecorderTrigger, reason));
+
+  // Hand the ring, oldest event first, to toDynamic().
+  logs.reserve(ring_.size());
+  for (size_t i = 0; i < ring_.size(); ++i) {
+    logs.push_back(std::move(ring_[(next_ + i) % ring_.size()]));
+  }
+  std::string outputPath = folly::to<std::string>(
+      config_.path, "/", dcid->hex(), "_", numPersisted_, ".qlog");
+  bool written = false;
+  std::ofstream fileObj(outputPath);
+  if (fileObj) {
+    fileObj << (config_.prettyJson ? folly::toPrettyJson(toDynamic())
+                                   : folly::toJson(toDynamic()));
+    written = fileObj.good();
+  } else {
+    LOG(ERROR) << "Error: Can't write to provided path: " << config_.path;
+  }
+  fileObj.close();
+  for (size_t i = 0; i < logs.size(); ++i) {
+    ring_[(next_ + i) % ring_.size()] = std::move(logs[i]);
+  }
+  logs.clear();
+
+  if (written) {
+    numPersisted_++;
+  }
+  return written;
+}
+
+size_t FlightRecorderQLogger::getNumPersisted() const {
+  return numPersisted_;
+}
+
+void FlightRecorderQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  if (ring_.size() < config_.maxEvents) {
+    ring_.push_back(std::move(event));
+    return;
+  }
+  ring_[next_] = std::move(event);
+  next_ = (next_ + 1) % ring_.size();
+}
+
+} // namespace quic
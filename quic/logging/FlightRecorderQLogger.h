@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/logging/FileQLogger.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+struct FlightRecorderQLogConfig {
+  // Directory the recordings are written to
+  std::string path;
+  bool prettyJson{false};
+  // Size of the ring, the older events are overwritten
+  size_t maxEvents{kDefaultFlightRecorderMaxEvents};
+  // Persist when a PTO fires with this many PTOs before it, 0 to disable
+  uint64_t ptoThreshold{kDefaultFlightRecorderPtoThreshold};
+  // Persist when an rtt sample is this many times the srtt, 0 to disable
+  uint64_t rttSpikeFactor{kDefaultFlightRecorderRttSpikeFactor};
+  // Persist when the connection closes with an error
+  bool persistOnError{true};
+  // Recordings made at most per connection
+  size_t maxPersists{kDefaultFlightRecorderMaxPersists};
+};
+
+/**
+ * QLogger that only keeps the last maxEvents events of its connection, in a
+ * ring, and writes them out when something worth debugging happens: too
+ * many PTOs in a row, an rtt spike, a close with an error, or a call to
+ * trigger() by the app. The connections then only pay for making the events
+ * and hardly ever for writing them.
+ *
+ * Each recording is a qlog file of its own, <dcid>_<n>.qlog in the path of
+ * the config, with an event saying what triggered it last. The events stay
+ * in the ring so later recordings overlap with the earlier ones.
+ */
+class FlightRecorderQLogger : public FileQLogger {
+ public:
+  FlightRecorderQLogger(
+      VantagePoint vantagePointIn,
+      FlightRecorderQLogConfig config,
+      std::string protocolTypeIn = kHTTP3ProtocolType);
+
+  ~FlightRecorderQLogger() override = default;
+
+  void addConnectionClose(
+      std::string error,
+      std::string reason,
+      bool drainConnection,
+      bool sendCloseImmediately) override;
+  void addLossAlarm(
+      PacketNum largestSent,
+      uint64_t alarmCount,
+      uint64_t outstandingPackets,
+      folly::StringPiece type) override;
+  void addMetricUpdate(
+      std::chrono::microseconds latestRtt,
+      std::chrono::microseconds mrtt,
+      std::chrono::microseconds srtt,
+      std::chrono::microseconds ackDelay) override;
+
+  /**
+   * Writes out the events in the ring. Returns false if nothing was written,
+   * since the connection is out of recordings, has no dcid yet or the file
+   * couldn't be written.
+   */
+  bool trigger(const std::string& reason);
+
+  size_t getNumPersisted() const;
+
+ protected:
+  void handleEvent(std::unique_ptr<QLogEvent> event) override;
+
+ private:
+  FlightRecorderQLogConfig config_;
+  std::vector<std::unique_ptr<QLogEvent>> ring_;
+  // Where the next event goes once the ring is full
+  size_t next_{0};
+  size_t numPersisted_{0};
+};
+
+} // namespace quic
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <folly/Range.h>
 #include <quic/codec/QuicConnectionId.h>
 #include <quic/codec/Types.h>
 #include <quic/logging/QLoggerConstants.h>
@@ -23,6 +24,13 @@ struct PacingObserver {
   virtual void onPacketSent() = 0;
 };
 
+/**
+ * The StringPiece arguments of the events that are logged on the hot path,
+ * e.g. for each ack, are kept as they are rather than copied, and only made
+ * into strings when the events are serialized. They have to outlive the
+ * logger, e.g. be the constants of QLoggerConstants.h or the names of enum
+ * values.
+ */
 class QLogger {
  public:
   explicit QLogger(VantagePoint vantagePointIn, std::string protocolTypeIn)
@@ -65,9 +73,9 @@ class QLogger {
   virtual void addCongestionMetricUpdate(
       uint64_t bytesInFlight,
       uint64_t currentCwnd,
-      std::string congestionEvent,
-      std::string state = "",
-      std::string recoveryState = "") = 0;
+      folly::StringPiece congestionEvent,
+      folly::StringPiece state = "",
+      folly::StringPiece recoveryState = "") = 0;
   virtual void addBandwidthEstUpdate(
       uint64_t bytes,
       std::chrono::microseconds interval) = 0;
@@ -80,14 +88,16 @@ class QLogger {
       std::string actual,
       std::string expected,
       std::string conclusion) = 0;
-  virtual void addAppIdleUpdate(std::string idleEvent, bool idle) = 0;
-  virtual void addPacketDrop(size_t packetSize, std::string dropReasonIn) = 0;
+  virtual void addAppIdleUpdate(folly::StringPiece idleEvent, bool idle) = 0;
+  virtual void addPacketDrop(
+      size_t packetSize,
+      folly::StringPiece dropReasonIn) = 0;
   virtual void addDatagramReceived(uint64_t dataLen) = 0;
   virtual void addLossAlarm(
       PacketNum largestSent,
       uint64_t alarmCount,
       uint64_t outstandingPackets,
-      std::string type) = 0;
+      folly::StringPiece type) = 0;
   virtual void addPacketsLost(
       PacketNum largestLostPacketNum,
       uint64_t lostBytes,
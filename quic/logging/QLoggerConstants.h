@@ -33,7 +33,13 @@ constexpr auto kPacketAckedInRecovery = "packet acked in recovery";
 constexpr auto kCopaInit = "copa init";
 constexpr auto kCongestionPacketSent = "congestion on packet sent";
 constexpr auto kCopaCheckAndUpdateDirection = "copa check and update direction";
+constexpr auto kCopaCompetitiveMode = "copa competitive mode";
+constexpr auto kCopaDefaultMode = "copa default mode";
 constexpr auto kCongestionPacketLoss = "congestion packet loss";
+constexpr auto kCongestionEcn = "congestion ecn";
+constexpr auto kCarefulResumeJump = "careful resume jump";
+constexpr auto kCarefulResumeValidate = "careful resume validate";
+constexpr auto kCarefulResumeRetreat = "careful resume retreat";
 constexpr auto kAppLimited = "app limited";
 constexpr auto kAppUnlimited = "app unlimited";
 constexpr uint64_t kDefaultCwnd = 12320;
@@ -72,6 +78,21 @@ constexpr auto kQLogVersionField = "qlog_version";
 constexpr auto kQLogTitleField = "title";
 constexpr auto kQLogDescriptionField = "description";
 constexpr auto kQLogTraceCountField = "trace_count";
+// Events a QLogStreamSink holds for its writer before it drops new ones
+constexpr size_t kDefaultQLogStreamMaxPendingEvents = 100000;
+// Bytes a BinaryQLogWriter buffers before writing them out
+constexpr size_t kDefaultBinaryQLogBufferSize = 64 * 1024;
+// Ack blocks a binary qlog keeps of each ack frame, the largest ones
+constexpr size_t kBinaryQLogMaxAckBlocks = 32;
+// Events a FlightRecorderQLogger keeps in its ring
+constexpr size_t kDefaultFlightRecorderMaxEvents = 1000;
+// PTOs in a row after which a FlightRecorderQLogger writes out its events
+constexpr uint64_t kDefaultFlightRecorderPtoThreshold = 3;
+// Times the srtt an rtt sample takes to be a spike for a flight recorder
+constexpr uint64_t kDefaultFlightRecorderRttSpikeFactor = 4;
+// Recordings a FlightRecorderQLogger makes at most
+constexpr size_t kDefaultFlightRecorderMaxPersists = 4;
+constexpr auto kFlightRecorderTrigger = "flight recorder trigger: ";
 constexpr auto kEOM = "eom";
 constexpr auto kOnEOM = "on eom";
 constexpr auto kStreamBlocked = "stream blocked";
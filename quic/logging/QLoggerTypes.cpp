@@ -225,6 +225,40 @@ folly::dynamic HandshakeDoneFrameLog::toDynamic() const {
   return d;
 }
 
+folly::dynamic AckFrequencyFrameLog::toDynamic() const {
+  folly::dynamic d = folly::dynamic::object();
+  d["frame_type"] = toString(FrameType::ACK_FREQUENCY);
+  d["sequence"] = sequenceNumber;
+  d["packet_tolerance"] = packetTolerance;
+  d["update_max_ack_delay"] = updateMaxAckDelay.count();
+  d["ignore_order"] = ignoreOrder;
+  return d;
+}
+
+folly::dynamic ImmediateAckFrameLog::toDynamic() const {
+  folly::dynamic d = folly::dynamic::object();
+  d["frame_type"] = toString(FrameType::IMMEDIATE_ACK);
+  return d;
+}
+
+folly::dynamic StreamRepairFrameLog::toDynamic() const {
+  folly::dynamic d = folly::dynamic::object();
+  d["frame_type"] = toString(FrameType::STREAM_REPAIR);
+  d["id"] = streamId;
+  d["offset"] = offset;
+  d["length"] = length;
+  d["num_ranges"] = numRanges;
+  d["fin"] = fin;
+  return d;
+}
+
+folly::dynamic DatagramFrameLog::toDynamic() const {
+  folly::dynamic d = folly::dynamic::object();
+  d["frame_type"] = toString(FrameType::DATAGRAM);
+  d["length"] = length;
+  return d;
+}
+
 folly::dynamic VersionNegotiationLog::toDynamic() const {
   folly::dynamic d = folly::dynamic::object();
   d = folly::dynamic::array();
@@ -367,15 +401,15 @@ folly::dynamic QLogTransportSummaryEvent::toDynamic() const {
 QLogCongestionMetricUpdateEvent::QLogCongestionMetricUpdateEvent(
     uint64_t bytesInFlightIn,
     uint64_t currentCwndIn,
-    std::string congestionEventIn,
-    std::string stateIn,
-    std::string recoveryStateIn,
+    folly::StringPiece congestionEventIn,
+    folly::StringPiece stateIn,
+    folly::StringPiece recoveryStateIn,
     std::chrono::microseconds refTimeIn)
     : bytesInFlight{bytesInFlightIn},
       currentCwnd{currentCwndIn},
-      congestionEvent{std::move(congestionEventIn)},
-      state{std::move(stateIn)},
-      recoveryState{std::move(recoveryStateIn)} {
+      congestionEvent{congestionEventIn},
+      state{stateIn},
+      recoveryState{recoveryStateIn} {
   eventType = QLogEventType::CongestionMetricUpdate;
   refTime = refTimeIn;
 }
@@ -500,10 +534,10 @@ folly::dynamic QLogPacingObservationEvent::toDynamic() const {
 }
 
 QLogAppIdleUpdateEvent::QLogAppIdleUpdateEvent(
-    std::string idleEventIn,
+    folly::StringPiece idleEventIn,
     bool idleIn,
     std::chrono::microseconds refTimeIn)
-    : idleEvent{std::move(idleEventIn)}, idle{idleIn} {
+    : idleEvent{idleEventIn}, idle{idleIn} {
   eventType = QLogEventType::AppIdleUpdate;
   refTime = refTimeIn;
 }
@@ -527,9 +561,9 @@ folly::dynamic QLogAppIdleUpdateEvent::toDynamic() const {
 
 QLogPacketDropEvent::QLogPacketDropEvent(
     size_t packetSizeIn,
-    std::string dropReasonIn,
+    folly::StringPiece dropReasonIn,
     std::chrono::microseconds refTimeIn)
-    : packetSize{packetSizeIn}, dropReason{std::move(dropReasonIn)} {
+    : packetSize{packetSizeIn}, dropReason{dropReasonIn} {
   eventType = QLogEventType::PacketDrop;
   refTime = refTimeIn;
 }
@@ -579,12 +613,12 @@ QLogLossAlarmEvent::QLogLossAlarmEvent(
     PacketNum largestSentIn,
     uint64_t alarmCountIn,
     uint64_t outstandingPacketsIn,
-    std::string typeIn,
+    folly::StringPiece typeIn,
     std::chrono::microseconds refTimeIn)
     : largestSent{largestSentIn},
       alarmCount{alarmCountIn},
       outstandingPackets{outstandingPacketsIn},
-      type{std::move(typeIn)} {
+      type{typeIn} {
   eventType = QLogEventType::LossAlarm;
   refTime = refTimeIn;
 }
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <folly/Range.h>
 #include <folly/dynamic.h>
 #include <quic/codec/Types.h>
 #include <quic/logging/QLoggerConstants.h>
@@ -287,6 +288,65 @@ class HandshakeDoneFrameLog : public QLogFrame {
   folly::dynamic toDynamic() const override;
 };
 
+class AckFrequencyFrameLog : public QLogFrame {
+ public:
+  uint64_t sequenceNumber;
+  uint64_t packetTolerance;
+  std::chrono::microseconds updateMaxAckDelay;
+  bool ignoreOrder;
+
+  AckFrequencyFrameLog(
+      uint64_t sequenceNumberIn,
+      uint64_t packetToleranceIn,
+      std::chrono::microseconds updateMaxAckDelayIn,
+      bool ignoreOrderIn)
+      : sequenceNumber(sequenceNumberIn),
+        packetTolerance(packetToleranceIn),
+        updateMaxAckDelay(updateMaxAckDelayIn),
+        ignoreOrder(ignoreOrderIn) {}
+  ~AckFrequencyFrameLog() override = default;
+  folly::dynamic toDynamic() const override;
+};
+
+class ImmediateAckFrameLog : public QLogFrame {
+ public:
+  ImmediateAckFrameLog() = default;
+  ~ImmediateAckFrameLog() override = default;
+  folly::dynamic toDynamic() const override;
+};
+
+class StreamRepairFrameLog : public QLogFrame {
+ public:
+  StreamId streamId;
+  uint64_t offset;
+  uint64_t length;
+  uint64_t numRanges;
+  bool fin;
+
+  StreamRepairFrameLog(
+      StreamId streamIdIn,
+      uint64_t offsetIn,
+      uint64_t lengthIn,
+      uint64_t numRangesIn,
+      bool finIn)
+      : streamId(streamIdIn),
+        offset(offsetIn),
+        length(lengthIn),
+        numRanges(numRangesIn),
+        fin(finIn) {}
+  ~StreamRepairFrameLog() override = default;
+  folly::dynamic toDynamic() const override;
+};
+
+class DatagramFrameLog : public QLogFrame {
+ public:
+  uint64_t length;
+
+  explicit DatagramFrameLog(uint64_t lengthIn) : length{lengthIn} {}
+  ~DatagramFrameLog() override = default;
+  folly::dynamic toDynamic() const override;
+};
+
 class VersionNegotiationLog {
  public:
   std::vector<QuicVersion> versions;
@@ -406,16 +466,17 @@ class QLogCongestionMetricUpdateEvent : public QLogEvent {
   QLogCongestionMetricUpdateEvent(
       uint64_t bytesInFlight,
       uint64_t currentCwnd,
-      std::string congestionEvent,
-      std::string state,
-      std::string recoveryState,
+      folly::StringPiece congestionEvent,
+      folly::StringPiece state,
+      folly::StringPiece recoveryState,
       std::chrono::microseconds refTimeIn);
   ~QLogCongestionMetricUpdateEvent() override = default;
   uint64_t bytesInFlight;
   uint64_t currentCwnd;
-  std::string congestionEvent;
-  std::string state;
-  std::string recoveryState;
+  // Not owned, see QLogger
+  folly::StringPiece congestionEvent;
+  folly::StringPiece state;
+  folly::StringPiece recoveryState;
 
   folly::dynamic toDynamic() const override;
 };
@@ -477,11 +538,12 @@ class QLogPacingObservationEvent : public QLogEvent {
 class QLogAppIdleUpdateEvent : public QLogEvent {
  public:
   QLogAppIdleUpdateEvent(
-      std::string idleEvent,
+      folly::StringPiece idleEvent,
       bool idle,
       std::chrono::microseconds refTime);
   ~QLogAppIdleUpdateEvent() override = default;
-  std::string idleEvent;
+  // Not owned, see QLogger
+  folly::StringPiece idleEvent;
   bool idle;
 
   folly::dynamic toDynamic() const override;
@@ -491,11 +553,12 @@ class QLogPacketDropEvent : public QLogEvent {
  public:
   QLogPacketDropEvent(
       size_t packetSize,
-      std::string dropReason,
+      folly::StringPiece dropReason,
       std::chrono::microseconds refTime);
   ~QLogPacketDropEvent() override = default;
   size_t packetSize;
-  std::string dropReason;
+  // Not owned, see QLogger
+  folly::StringPiece dropReason;
 
   folly::dynamic toDynamic() const override;
 };
@@ -517,13 +580,14 @@ class QLogLossAlarmEvent : public QLogEvent {
       PacketNum largestSent,
       uint64_t alarmCount,
       uint64_t outstandingPackets,
-      std::string type,
+      folly::StringPiece type,
       std::chrono::microseconds refTime);
   ~QLogLossAlarmEvent() override = default;
   PacketNum largestSent;
   uint64_t alarmCount;
   uint64_t outstandingPackets;
-  std::string type;
+  // Not owned, see QLogger
+  folly::StringPiece type;
   folly::dynamic toDynamic() const override;
 };
 
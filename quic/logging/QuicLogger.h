@@ -71,4 +71,31 @@ void quicTraceLogger(std::string name, const T& conn, Args&&... args) {
     QUIC_TRACE(name, *(sock)->getState(), __VA_ARGS__); \
   }
 
+inline const uint8_t* probeConnIdData(
+    const QuicConnectionStateBase& conn) noexcept {
+  return conn.serverConnectionId ? conn.serverConnectionId->data() : nullptr;
+}
+
+inline uint8_t probeConnIdSize(const QuicConnectionStateBase& conn) noexcept {
+  return conn.serverConnectionId ? conn.serverConnectionId->size() : 0;
+}
+
+/**
+ * Static tracepoints of the mvfst provider at the key transport events, for
+ * a tracer like bpftrace to attach to on demand, e.g.
+ *   usdt:<binary>:mvfst:packet_lost { printf("%d\n", arg2); }
+ * A probe nobody is attached to is a nop. Its arguments are still
+ * evaluated, so they are kept to fields and cheap getters. Every probe
+ * starts with the bytes and the size of the server chosen connection id,
+ * arg0 and arg1, the rest are the fields given at the call site. Unlike
+ * QUIC_TRACE, the probes stay in with QUIC_TPERF.
+ */
+#define QUIC_PROBE(name, conn, ...) \
+  FOLLY_SDT(                        \
+      mvfst,                        \
+      name,                         \
+      quic::probeConnIdData(conn),  \
+      quic::probeConnIdSize(conn),  \
+      __VA_ARGS__)
+
 } // namespace quic
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/StreamingQLogger.h>
+
+#include <folly/json.h>
+
+#include <vector>
+
+namespace quic {
+
+QLogStreamSink::QLogStreamSink(
+    const std::string& path,
+    size_t maxPendingEvents)
+    : file_(path, std::ios::out | std::ios::app),
+      maxPendingEvents_(maxPendingEvents) {
+  if (!file_) {
+    LOG(ERROR) << "Error: Can't write to provided path: " << path;
+    good_ = false;
+  }
+  writer_ = std::thread([this] { run(); });
+}
+
+QLogStreamSink::~QLogStreamSink() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopping_ = true;
+  }
+  pendingCv_.notify_one();
+  writer_.join();
+}
+
+bool QLogStreamSink::write(
+    std::string dcid,
+    VantagePoint vantagePoint,
+    std::unique_ptr<QLogEvent> event) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (pending_.size() >= maxPendingEvents_) {
+      droppedEvents_++;
+      return false;
+    }
+    pending_.push_back(
+        PendingEvent{std::move(dcid), vantagePoint, std::move(event)});
+  }
+  pendingCv_.notify_one();
+  return true;
+}
+
+void QLogStreamSink::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  writtenCv_.wait(lock, [this] { return pending_.empty() && writing_ == 0; });
+}
+
+bool QLogStreamSink::good() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return good_;
+}
+
+uint64_t QLogStreamSink::getDroppedEvents() const {
+  return droppedEvents_;
+}
+
+void QLogStreamSink::run() {
+  std::vector<PendingEvent> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    pendingCv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      // Only stopping once everything is written.
+      return;
+    }
+    batch.clear();
+    while (!pending_.empty()) {
+      batch.push_back(std::move(pending_.front()));
+      pending_.pop_front();
+    }
+    writing_ = batch.size();
+    lock.unlock();
+
+    bool good = true;
+    if (file_) {
+      for (auto& pending : batch) {
+        folly::dynamic line = folly::dynamic::object("dcid", pending.dcid)(
+            "vantage_point", vantagePointString(pending.vantagePoint))(
+            "event", pending.event->toDynamic());
+        file_ << folly::toJson(line) << '\n';
+      }
+      file_.flush();
+      good = file_.good();
+    }
+    // Free the events off the lock too.
+    batch.clear();
+
+    lock.lock();
+    good_ = good_ && good;
+    writing_ = 0;
+    writtenCv_.notify_all();
+  }
+}
+
+StreamingQLogger::StreamingQLogger(
+    VantagePoint vantagePointIn,
+    std::shared_ptr<QLogStreamSink> sink,
+    std::string protocolTypeIn)
+    : FileQLogger(vantagePointIn, std::move(protocolTypeIn)),
+      sink_(std::move(sink)) {
+  CHECK(sink_);
+}
+
+void StreamingQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  sink_->write(dcid ? dcid->hex() : "", vantagePoint, std::move(event));
+}
+
+} // namespace quic
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/logging/FileQLogger.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace quic {
+
+/**
+ * Writes the qlog events of many connections, e.g. the connections of a
+ * server worker, to one file or pipe as they happen, one JSON object per
+ * line with the dcid and the vantage point of the connection and the event.
+ *
+ * The events are serialized and written on a thread of the sink, so the
+ * connections neither hold their events until they close nor pay for the
+ * serialization. At most maxPendingEvents wait for the writer, once it falls
+ * that far behind new events are dropped and counted instead of blocking
+ * the connections.
+ */
+class QLogStreamSink {
+ public:
+  explicit QLogStreamSink(
+      const std::string& path,
+      size_t maxPendingEvents = kDefaultQLogStreamMaxPendingEvents);
+
+  // Writes the pending events before it returns.
+  ~QLogStreamSink();
+
+  /**
+   * Hands the event to the writer. Returns false if it was dropped since too
+   * many events are pending.
+   */
+  bool write(
+      std::string dcid,
+      VantagePoint vantagePoint,
+      std::unique_ptr<QLogEvent> event);
+
+  // Blocks until the events handed to the sink so far are written.
+  void flush();
+
+  // Whether the file could be opened and all writes so far went through
+  bool good() const;
+
+  uint64_t getDroppedEvents() const;
+
+ private:
+  struct PendingEvent {
+    std::string dcid;
+    VantagePoint vantagePoint;
+    std::unique_ptr<QLogEvent> event;
+  };
+
+  void run();
+
+  std::ofstream file_;
+  size_t maxPendingEvents_;
+  mutable std::mutex mutex_;
+  std::condition_variable pendingCv_;
+  std::condition_variable writtenCv_;
+  std::deque<PendingEvent> pending_;
+  // Events taken by the writer but not written yet
+  size_t writing_{0};
+  bool stopping_{false};
+  bool good_{true};
+  std::atomic<uint64_t> droppedEvents_{0};
+  std::thread writer_;
+};
+
+/**
+ * QLogger that streams its events to a QLogStreamSink instead of keeping
+ * them, so its logs stay empty and toDynamic() has no events.
+ */
+class StreamingQLogger : public FileQLogger {
+ public:
+  StreamingQLogger(
+      VantagePoint vantagePointIn,
+      std::shared_ptr<QLogStreamSink> sink,
+      std::string protocolTypeIn = kHTTP3ProtocolType);
+
+  ~StreamingQLogger() override = default;
+
+ protected:
+  void handleEvent(std::unique_ptr<QLogEvent> event) override;
+
+ private:
+  std::shared_ptr<QLogStreamSink> sink_;
+};
+
+} // namespace quic
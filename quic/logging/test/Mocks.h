@@ -38,17 +38,24 @@ class MockQLogger : public QLogger {
           uint64_t));
   MOCK_METHOD5(
       addCongestionMetricUpdate,
-      void(uint64_t, uint64_t, std::string, std::string, std::string));
+      void(
+          uint64_t,
+          uint64_t,
+          folly::StringPiece,
+          folly::StringPiece,
+          folly::StringPiece));
   MOCK_METHOD2(
       addPacingMetricUpdate,
       void(uint64_t, std::chrono::microseconds));
   MOCK_METHOD3(
       addPacingObservation,
       void(std::string, std::string, std::string));
-  MOCK_METHOD2(addAppIdleUpdate, void(std::string, bool));
-  MOCK_METHOD2(addPacketDrop, void(size_t, std::string));
+  MOCK_METHOD2(addAppIdleUpdate, void(folly::StringPiece, bool));
+  MOCK_METHOD2(addPacketDrop, void(size_t, folly::StringPiece));
   MOCK_METHOD1(addDatagramReceived, void(uint64_t));
-  MOCK_METHOD4(addLossAlarm, void(PacketNum, uint64_t, uint64_t, std::string));
+  MOCK_METHOD4(
+      addLossAlarm,
+      void(PacketNum, uint64_t, uint64_t, folly::StringPiece));
   MOCK_METHOD3(addPacketsLost, void(PacketNum, uint64_t, uint64_t));
   MOCK_METHOD1(addTransportStateUpdate, void(std::string));
   MOCK_METHOD3(addPacketBuffered, void(PacketNum, ProtectionType, uint64_t));
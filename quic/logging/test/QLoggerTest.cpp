@@ -8,11 +8,18 @@
 
 #include <quic/logging/QLogger.h>
 
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
 #include <folly/json.h>
 #include <gtest/gtest.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/congestion_control/Bbr.h>
+#include <quic/logging/BinaryQLogger.h>
 #include <quic/logging/FileQLogger.h>
+#include <quic/logging/FlightRecorderQLogger.h>
+#include <quic/logging/StreamingQLogger.h>
+
+#include <fstream>
 
 using namespace testing;
 
@@ -118,7 +125,7 @@ TEST_F(QLoggerTest, CongestionMetricUpdateEvent) {
       20,
       30,
       kPersistentCongestion,
-      cubicStateToString(CubicStates::Steady).str(),
+      cubicStateToString(CubicStates::Steady),
       bbrRecoveryStateToString(
           BbrCongestionController::RecoveryState::NOT_RECOVERY));
 
@@ -128,7 +135,7 @@ TEST_F(QLoggerTest, CongestionMetricUpdateEvent) {
   EXPECT_EQ(gotEvent->bytesInFlight, 20);
   EXPECT_EQ(gotEvent->currentCwnd, 30);
   EXPECT_EQ(gotEvent->congestionEvent, kPersistentCongestion);
-  EXPECT_EQ(gotEvent->state, cubicStateToString(CubicStates::Steady).str());
+  EXPECT_EQ(gotEvent->state, cubicStateToString(CubicStates::Steady));
   EXPECT_EQ(
       gotEvent->recoveryState,
       bbrRecoveryStateToString(
@@ -785,7 +792,7 @@ TEST_F(QLoggerTest, CongestionMetricUpdateFollyDynamic) {
       20,
       30,
       kPersistentCongestion,
-      cubicStateToString(CubicStates::Steady).str());
+      cubicStateToString(CubicStates::Steady));
   folly::dynamic gotDynamic = q.toDynamic();
   gotDynamic["traces"][0]["events"][0][0] = "0"; // hardcode reference time
   folly::dynamic gotEvents = gotDynamic["traces"][0]["events"];
@@ -1179,4 +1186,228 @@ TEST_F(QLoggerTest, PathValidation) {
   EXPECT_EQ(expected, gotEvents);
 }
 
+std::vector<folly::dynamic> readQLogLines(const std::string& path) {
+  std::vector<folly::dynamic> lines;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    lines.push_back(folly::parseJson(line));
+  }
+  return lines;
+}
+
+TEST_F(QLoggerTest, StreamingQLoggerWritesAsItGoes) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "qlog").string();
+  auto sink = std::make_shared<QLogStreamSink>(path);
+  StreamingQLogger q1(VantagePoint::Server, sink);
+  StreamingQLogger q2(VantagePoint::Client, sink);
+  q1.dcid = getTestConnectionId(1);
+  q1.addPathValidationEvent(false);
+  q2.addTransportStateUpdate(kStart);
+  sink->flush();
+  EXPECT_TRUE(q1.logs.empty());
+  EXPECT_TRUE(q2.logs.empty());
+
+  auto lines = readQLogLines(path);
+  ASSERT_EQ(2, lines.size());
+  EXPECT_EQ(getTestConnectionId(1).hex(), lines[0]["dcid"].asString());
+  EXPECT_EQ("server", lines[0]["vantage_point"].asString());
+  EXPECT_EQ("PATH_VALIDATION", lines[0]["event"][2].asString());
+  EXPECT_EQ("", lines[1]["dcid"].asString());
+  EXPECT_EQ("client", lines[1]["vantage_point"].asString());
+  EXPECT_TRUE(sink->good());
+  EXPECT_EQ(0, sink->getDroppedEvents());
+}
+
+TEST_F(QLoggerTest, StreamingQLoggerDropsOverTheLimit) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "qlog").string();
+  auto sink = std::make_shared<QLogStreamSink>(path, 1);
+  StreamingQLogger q(VantagePoint::Server, sink);
+  size_t events = 1000;
+  for (size_t i = 0; i < events; i++) {
+    q.addTransportStateUpdate(kStart);
+  }
+  sink->flush();
+  auto lines = readQLogLines(path);
+  EXPECT_GE(lines.size(), 1);
+  EXPECT_EQ(events, lines.size() + sink->getDroppedEvents());
+}
+
+TEST_F(QLoggerTest, BinaryQLogRoundTrip) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "qlog.bin").string();
+  auto writer = std::make_shared<BinaryQLogWriter>(path);
+  BinaryQLogger q1(VantagePoint::Client, writer);
+  BinaryQLogger q2(VantagePoint::Server, writer);
+  q1.dcid = getTestConnectionId(1);
+
+  RegularQuicWritePacket packet =
+      createRegularQuicWritePacket(streamId, offset, len, fin);
+  WriteAckFrame ackFrame;
+  ackFrame.ackBlocks.emplace_back(1, 5);
+  ackFrame.ackDelay = 10us;
+  packet.frames.emplace_back(std::move(ackFrame));
+  q1.addPacket(packet, 100);
+  q1.addCongestionMetricUpdate(20, 30, kCubicLoss, "steady");
+  q2.addPacketsLost(10, 1200, 1);
+  q2.addMetricUpdate(10us, 5us, 8us, 1us);
+  q2.addPacingMetricUpdate(4, 2ms);
+  // Not recorded.
+  q2.addTransportStateUpdate(kStart);
+  writer->flush();
+
+  std::string data;
+  ASSERT_TRUE(folly::readFile(path.c_str(), data));
+  auto connections =
+      readBinaryQLog(folly::ByteRange(folly::StringPiece(data)));
+  ASSERT_EQ(2, connections.size());
+  auto& c1 = *connections[0];
+  auto& c2 = *connections[1];
+  EXPECT_EQ(VantagePoint::Client, c1.vantagePoint);
+  EXPECT_EQ(getTestConnectionId(1), c1.dcid);
+  EXPECT_EQ(VantagePoint::Server, c2.vantagePoint);
+  EXPECT_FALSE(c2.dcid.hasValue());
+
+  ASSERT_EQ(2, c1.logs.size());
+  auto sent = dynamic_cast<QLogPacketEvent*>(c1.logs[0].get());
+  ASSERT_NE(nullptr, sent);
+  EXPECT_EQ(QLogEventType::PacketSent, sent->eventType);
+  EXPECT_EQ(100, sent->packetSize);
+  EXPECT_EQ(toString(LongHeader::Types::Initial), sent->packetType);
+  ASSERT_EQ(1, sent->frames.size());
+  auto ack = dynamic_cast<WriteAckFrameLog*>(sent->frames[0].get());
+  ASSERT_NE(nullptr, ack);
+  ASSERT_EQ(1, ack->ackBlocks.size());
+  EXPECT_EQ(1, ack->ackBlocks[0].start);
+  EXPECT_EQ(5, ack->ackBlocks[0].end);
+  EXPECT_EQ(10us, ack->ackDelay);
+  auto cc = dynamic_cast<QLogCongestionMetricUpdateEvent*>(c1.logs[1].get());
+  ASSERT_NE(nullptr, cc);
+  EXPECT_EQ(30, cc->currentCwnd);
+  EXPECT_EQ(kCubicLoss, cc->congestionEvent);
+  EXPECT_EQ("steady", cc->state);
+  EXPECT_EQ("", cc->recoveryState);
+
+  ASSERT_EQ(3, c2.logs.size());
+  auto lost = dynamic_cast<QLogPacketsLostEvent*>(c2.logs[0].get());
+  ASSERT_NE(nullptr, lost);
+  EXPECT_EQ(1200, lost->lostBytes);
+  auto rtt = dynamic_cast<QLogMetricUpdateEvent*>(c2.logs[1].get());
+  ASSERT_NE(nullptr, rtt);
+  EXPECT_EQ(8us, rtt->srtt);
+  auto pacing = dynamic_cast<QLogPacingMetricUpdateEvent*>(c2.logs[2].get());
+  ASSERT_NE(nullptr, pacing);
+  EXPECT_EQ(2ms, pacing->pacingInterval);
+
+  // The events convert to qlog JSON like those of a FileQLogger.
+  auto converted = c1.toDynamic();
+  EXPECT_EQ(2, converted["traces"][0]["events"].size());
+}
+
+TEST_F(QLoggerTest, BinaryQLogTruncated) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "qlog.bin").string();
+  {
+    auto writer = std::make_shared<BinaryQLogWriter>(path);
+    BinaryQLogger q(VantagePoint::Client, writer);
+    q.addPacketsLost(10, 1200, 1);
+  }
+  std::string data;
+  ASSERT_TRUE(folly::readFile(path.c_str(), data));
+  data.resize(data.size() - 1);
+  EXPECT_THROW(
+      readBinaryQLog(folly::ByteRange(folly::StringPiece(data))),
+      std::runtime_error);
+}
+
+folly::dynamic readFlightRecording(
+    const folly::test::TemporaryDirectory& dir,
+    const ConnectionId& dcid,
+    size_t n) {
+  std::string data;
+  auto path = folly::to<std::string>(
+      dir.path().string(), "/", dcid.hex(), "_", n, ".qlog");
+  if (!folly::readFile(path.c_str(), data)) {
+    return nullptr;
+  }
+  return folly::parseJson(data)["traces"][0]["events"];
+}
+
+TEST_F(QLoggerTest, FlightRecorderKeepsTheLastEvents) {
+  folly::test::TemporaryDirectory dir;
+  FlightRecorderQLogConfig config;
+  config.path = dir.path().string();
+  config.maxEvents = 3;
+  FlightRecorderQLogger q(VantagePoint::Server, config);
+  q.dcid = getTestConnectionId(1);
+  for (size_t i = 0; i < 10; i++) {
+    q.addPacketsLost(i, 1200, 1);
+  }
+  EXPECT_TRUE(q.logs.empty());
+  EXPECT_TRUE(q.trigger("app"));
+  EXPECT_EQ(1, q.getNumPersisted());
+
+  auto events = readFlightRecording(dir, getTestConnectionId(1), 0);
+  ASSERT_EQ(3, events.size());
+  EXPECT_EQ(8, events[0][4]["largest_lost_packet_num"].asInt());
+  EXPECT_EQ(9, events[1][4]["largest_lost_packet_num"].asInt());
+  EXPECT_EQ(
+      folly::to<std::string>(kFlightRecorderTrigger, "app"),
+      events[2][4]["update"].asString());
+  EXPECT_TRUE(q.logs.empty());
+}
+
+TEST_F(QLoggerTest, FlightRecorderTriggers) {
+  folly::test::TemporaryDirectory dir;
+  FlightRecorderQLogConfig config;
+  config.path = dir.path().string();
+  config.ptoThreshold = 2;
+  config.rttSpikeFactor = 4;
+  FlightRecorderQLogger q(VantagePoint::Server, config);
+  q.dcid = getTestConnectionId(1);
+
+  q.addLossAlarm(10, 1, 1, kPtoAlarm);
+  q.addLossAlarm(10, 2, 1, kHandshakeAlarm);
+  EXPECT_EQ(0, q.getNumPersisted());
+  q.addLossAlarm(10, 2, 1, kPtoAlarm);
+  EXPECT_EQ(1, q.getNumPersisted());
+  q.addLossAlarm(10, 3, 1, kPtoAlarm);
+  EXPECT_EQ(1, q.getNumPersisted());
+
+  q.addMetricUpdate(40ms, 10ms, 10ms, 0ms);
+  EXPECT_EQ(1, q.getNumPersisted());
+  q.addMetricUpdate(41ms, 10ms, 10ms, 0ms);
+  EXPECT_EQ(2, q.getNumPersisted());
+
+  q.addConnectionClose(kNoError, "", true, false);
+  EXPECT_EQ(2, q.getNumPersisted());
+  q.addConnectionClose("INTERNAL_ERROR", "", true, false);
+  EXPECT_EQ(3, q.getNumPersisted());
+
+  // Each recording ends with its trigger.
+  auto events = readFlightRecording(dir, getTestConnectionId(1), 2);
+  ASSERT_FALSE(events.isNull());
+  EXPECT_EQ(
+      folly::to<std::string>(
+          kFlightRecorderTrigger, "connection error: INTERNAL_ERROR"),
+      events[events.size() - 1][4]["update"].asString());
+}
+
+TEST_F(QLoggerTest, FlightRecorderMaxPersists) {
+  folly::test::TemporaryDirectory dir;
+  FlightRecorderQLogConfig config;
+  config.path = dir.path().string();
+  config.maxPersists = 1;
+  FlightRecorderQLogger q(VantagePoint::Client, config);
+  // Nothing to name the file after yet.
+  EXPECT_FALSE(q.trigger("app"));
+  q.dcid = getTestConnectionId(1);
+  EXPECT_TRUE(q.trigger("app"));
+  EXPECT_FALSE(q.trigger("app"));
+  EXPECT_EQ(1, q.getNumPersisted());
+  EXPECT_TRUE(readFlightRecording(dir, getTestConnectionId(1), 1).isNull());
+}
+
 } // namespace quic::test
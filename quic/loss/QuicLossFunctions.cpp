@@ -16,6 +16,15 @@ std::chrono::microseconds calculatePTO(const QuicConnectionStateBase& conn) {
       conn.lossState.maxAckDelay;
 }
 
+std::chrono::microseconds rackReorderWindow(
+    const QuicConnectionStateBase& conn) {
+  // mrtt is infinite before the first sample.
+  auto minRtt = timeMin(conn.lossState.mrtt, conn.lossState.srtt);
+  auto window = minRtt / kRackReorderWindowDivisor *
+      conn.lossState.rackReorderWindowMultiplier;
+  return timeMin(window, conn.lossState.srtt);
+}
+
 bool isPersistentCongestion(
     const QuicConnectionStateBase& conn,
     TimePoint lostPeriodStart,
@@ -36,7 +45,13 @@ void onPTOAlarm(QuicConnectionStateBase& conn) {
       conn.lossState.largestSent,
       conn.lossState.ptoCount,
       (uint64_t)conn.outstandingPackets.size());
-  QUIC_STATS(conn.infoCallback, onPTO);
+  QUIC_PROBE(
+      pto_alarm,
+      conn,
+      conn.lossState.largestSent,
+      conn.lossState.ptoCount,
+      conn.outstandingPackets.size());
+  QUIC_STATS_COUNTER(conn.statsCounters, PTOs, 1, conn.infoCallback, onPTO);
   conn.lossState.ptoCount++;
   conn.lossState.totalPTOCount++;
   if (conn.qLogger) {
@@ -49,7 +64,32 @@ void onPTOAlarm(QuicConnectionStateBase& conn) {
   if (conn.lossState.ptoCount == conn.transportSettings.maxNumPTOs) {
     throw QuicInternalException("Exceeded max PTO", LocalErrorCode::NO_ERROR);
   }
+  bool handshakeDone = conn.outstandingHandshakePacketsCount == 0;
+  if (!conn.lossState.largestSentAtPTO && handshakeDone) {
+    conn.lossState.largestSentAtPTO = conn.lossState.largestSent;
+  }
   conn.pendingEvents.numProbePackets = kPacketToSendForPTO;
+  // New data probes as well as a clone and wastes nothing if the tail wasn't
+  // lost. With nothing new to send, a PING is enough to probe the tail on the
+  // first PTO: its ack tells what was lost, and the loss detection
+  // retransmits that. On high-jitter paths, where the first PTO is often
+  // spurious, that saves retransmitting the whole tail.
+  auto probeType = QuicTransportStatsCallback::PTOProbeType::CLONE;
+  if (conn.streamManager->hasWritable()) {
+    probeType = QuicTransportStatsCallback::PTOProbeType::NEW_DATA;
+  } else if (
+      conn.transportSettings.adaptivePTOProbes &&
+      conn.lossState.ptoCount == 1 && handshakeDone) {
+    probeType = QuicTransportStatsCallback::PTOProbeType::PING;
+    conn.pendingEvents.numProbePackets = 1;
+    conn.pendingEvents.pingProbe = true;
+    sendSimpleFrame(conn, PingFrame());
+  }
+  QUIC_STATS(conn.infoCallback, onPTOProbe, probeType);
+  if (conn.ackFrequencyState.peerMinAckDelay) {
+    // Don't let the peer sit on the ack of the probes.
+    sendSimpleFrame(conn, ImmediateAckFrame());
+  }
 }
 
 void markPacketLoss(
@@ -109,7 +149,10 @@ void markPacketLoss(
                 *stream, frame, bufferItr->second)) {
           break;
         }
-        stream->insertIntoLossBuffer(std::move(bufferItr->second));
+        // What the loss buffer has already is no longer kept twice.
+        auto dropped =
+            stream->insertIntoLossBuffer(std::move(bufferItr->second));
+        updateUnackedBufferOnRelease(*stream, dropped);
         stream->retransmissionBuffer.erase(bufferItr);
         conn.streamManager->updateLossStreams(*stream);
         break;
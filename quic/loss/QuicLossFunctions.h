@@ -29,6 +29,13 @@ WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn);
 
 std::chrono::microseconds calculatePTO(const QuicConnectionStateBase& conn);
 
+/**
+ * The time RACK gives a packet that was sent before an acked one to be acked
+ * as well, on top of the latest rtt, before declaring it lost.
+ */
+std::chrono::microseconds rackReorderWindow(
+    const QuicConnectionStateBase& conn);
+
 /**
  * Whether conn is having persistent congestion.
  *
@@ -105,10 +112,8 @@ calculateAlarmDuration(const QuicConnectionStateBase& conn) {
         std::chrono::duration_cast<std::chrono::milliseconds>(
             lastSentPacketTime + alarmDuration - now);
   } else {
-    auto lastSentPacketNum =
-        conn.outstandingPackets.back().packet.header.getPacketSequenceNum();
     VLOG(10) << __func__ << " alarm already due method=" << *alarmMethod
-             << " lastSentPacketNum=" << lastSentPacketNum
+             << " largestSent=" << conn.lossState.largestSent
              << " lastSentPacketTime="
              << lastSentPacketTime.time_since_epoch().count()
              << " now=" << now.time_since_epoch().count()
@@ -194,39 +199,76 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
     TimePoint lossTime,
     PacketNumberSpace pnSpace) {
   getLossTime(conn, pnSpace).reset();
-  std::chrono::microseconds delayUntilLost =
-      std::max(conn.lossState.srtt, conn.lossState.lrtt) *
-      conn.transportSettings.timeReorderingThreshDividend /
-      conn.transportSettings.timeReorderingThreshDivisor;
+  bool useRack = conn.transportSettings.useRackLossDetection;
+  std::chrono::microseconds delayUntilLost = useRack
+      ? conn.lossState.lrtt + rackReorderWindow(conn)
+      : std::max(conn.lossState.srtt, conn.lossState.lrtt) *
+          conn.transportSettings.timeReorderingThreshDividend /
+          conn.transportSettings.timeReorderingThreshDivisor;
+  // Trust the packet threshold until the peer is seen to reorder.
+  bool usePacketThreshold = !useRack || !conn.lossState.rackReorderingSeen;
   VLOG(10) << __func__ << " outstanding=" << conn.outstandingPackets.size()
            << " largestAcked=" << largestAcked
            << " delayUntilLost=" << delayUntilLost.count() << "us"
            << " " << conn;
   CongestionController::LossEvent lossEvent(lossTime);
+  uint64_t pmtuProbeLostBytes = 0;
   // Note that time based loss detection is also within the same PNSpace.
-  auto iter = getFirstOutstandingPacket(conn, pnSpace);
+  auto& outstandingPackets = conn.outstandingPackets[pnSpace];
+  auto iter = outstandingPackets.begin();
   bool shouldSetTimer = false;
-  while (iter != conn.outstandingPackets.end()) {
+  while (iter != outstandingPackets.end()) {
     auto& pkt = *iter;
-    auto currentPacketNum = pkt.packet.header.getPacketSequenceNum();
+    auto currentPacketNum = pkt.packetNum;
     if (currentPacketNum >= largestAcked) {
       break;
     }
-    auto currentPacketNumberSpace = pkt.packet.header.getPacketNumberSpace();
-    if (currentPacketNumberSpace != pnSpace) {
-      iter++;
-      continue;
-    }
+    DCHECK_EQ(pkt.packetNumberSpace, pnSpace);
     bool lost = (lossTime - pkt.time) > delayUntilLost;
+    if (useRack) {
+      // Only packets sent before one that got acked can be lost.
+      lost = lost && conn.lossState.rackLatestDeliveredSentTime &&
+          pkt.time <= *conn.lossState.rackLatestDeliveredSentTime;
+    }
     lost = lost ||
-        (largestAcked - currentPacketNum) > conn.lossState.reorderingThreshold;
+        (usePacketThreshold &&
+         (largestAcked - currentPacketNum) >
+             conn.lossState.reorderingThreshold);
     if (!lost) {
       // We can exit early here because if packet N doesn't meet the
       // threshold, then packet N + 1 will not either.
       shouldSetTimer = true;
       break;
     }
+    QUIC_PROBE(
+        packet_lost,
+        conn,
+        currentPacketNum,
+        static_cast<uint8_t>(pnSpace),
+        pkt.encodedSize);
+    if (isPmtuProbe(conn, pnSpace, currentPacketNum)) {
+      // A probe lost for being too large for the path says nothing about
+      // congestion, and there is nothing in it to retransmit.
+      VLOG(10) << __func__ << " lost PMTU probe packetNum=" << currentPacketNum
+               << " " << conn;
+      onPmtuProbeLost(conn);
+      pmtuProbeLostBytes += pkt.encodedSize;
+      if (pkt.associatedEvent) {
+        conn.outstandingPacketEvents.erase(*pkt.associatedEvent);
+        DCHECK_GT(conn.outstandingClonedPacketsCount, 0);
+        --conn.outstandingClonedPacketsCount;
+      }
+      iter = outstandingPackets.erase(iter);
+      continue;
+    }
     lossEvent.addLostPacket(pkt);
+    if (conn.transportSettings.detectSpuriousLoss) {
+      auto& recentlyLost = conn.lossState.recentlyLostPackets[pnSpace];
+      recentlyLost.push_back(currentPacketNum);
+      if (recentlyLost.size() > kMaxRecentlyLostPackets) {
+        recentlyLost.pop_front();
+      }
+    }
     if (pkt.associatedEvent) {
       DCHECK_GT(conn.outstandingClonedPacketsCount, 0);
       --conn.outstandingClonedPacketsCount;
@@ -246,18 +288,18 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
     }
     VLOG(10) << __func__ << " lost packetNum=" << currentPacketNum
              << " handshake=" << pkt.isHandshake << " " << conn;
-    iter = conn.outstandingPackets.erase(iter);
+    iter = outstandingPackets.erase(iter);
   }
 
-  auto earliest = getFirstOutstandingPacket(conn, pnSpace);
-  for (; earliest != conn.outstandingPackets.end();
-       earliest = getNextOutstandingPacket(conn, pnSpace, earliest + 1)) {
+  // Every packet of the space ahead of iter has just been declared lost.
+  auto earliest = iter;
+  for (; earliest != outstandingPackets.end(); ++earliest) {
     if (!earliest->associatedEvent ||
         conn.outstandingPacketEvents.count(*earliest->associatedEvent)) {
       break;
     }
   }
-  if (shouldSetTimer && earliest != conn.outstandingPackets.end()) {
+  if (shouldSetTimer && earliest != outstandingPackets.end()) {
     // We are eligible to set a loss timer and there are a few packets which
     // are unacked, so we can set the early retransmit timer for them.
     VLOG(10) << __func__ << " early retransmit timer outstanding="
@@ -266,6 +308,9 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
              << " " << conn;
     getLossTime(conn, pnSpace) = delayUntilLost + earliest->time;
   }
+  if (pmtuProbeLostBytes && conn.congestionController) {
+    conn.congestionController->onRemoveBytesFromInflight(pmtuProbeLostBytes);
+  }
   if (lossEvent.largestLostPacketNum.hasValue()) {
     DCHECK(lossEvent.largestLostSentTime && lossEvent.smallestLostSentTime);
     if (conn.qLogger) {
@@ -315,24 +360,35 @@ void onHandshakeAlarm(
       (uint64_t)conn.outstandingPackets.size());
   ++conn.lossState.handshakeAlarmCount;
   CongestionController::LossEvent lossEvent(ClockType::now());
-  auto iter = conn.outstandingPackets.begin();
-  while (iter != conn.outstandingPackets.end()) {
-    // the word "handshake" in our code base is unfortunately overloaded.
-    if (iter->isHandshake) {
-      auto& packet = *iter;
-      auto currentPacketNum = packet.packet.header.getPacketSequenceNum();
-      auto currentPacketNumSpace = packet.packet.header.getPacketNumberSpace();
-      VLOG(10) << "HandshakeAlarm, removing packetNum=" << currentPacketNum
-               << " packetNumSpace=" << currentPacketNumSpace << " " << conn;
-      lossEvent.addLostPacket(std::move(packet));
-      lossVisitor(conn, packet.packet, false, currentPacketNum);
-      DCHECK(conn.outstandingHandshakePacketsCount);
-      --conn.outstandingHandshakePacketsCount;
-      ++conn.lossState.timeoutBasedRtxCount;
-      ++conn.lossState.rtxCount;
-      iter = conn.outstandingPackets.erase(iter);
-    } else {
-      iter++;
+  // Handshake packets only ever live in the Initial and Handshake spaces.
+  for (auto pnSpace :
+       {PacketNumberSpace::Initial, PacketNumberSpace::Handshake}) {
+    auto& outstandingPackets = conn.outstandingPackets[pnSpace];
+    auto iter = outstandingPackets.begin();
+    while (iter != outstandingPackets.end()) {
+      // the word "handshake" in our code base is unfortunately overloaded.
+      if (iter->isHandshake) {
+        auto& packet = *iter;
+        auto currentPacketNum = packet.packet.header.getPacketSequenceNum();
+        VLOG(10) << "HandshakeAlarm, removing packetNum=" << currentPacketNum
+                 << " packetNumSpace=" << pnSpace << " " << conn;
+        lossEvent.addLostPacket(std::move(packet));
+        bool processed = packet.associatedEvent &&
+            !conn.outstandingPacketEvents.count(*packet.associatedEvent);
+        lossVisitor(conn, packet.packet, processed, currentPacketNum);
+        if (packet.associatedEvent) {
+          conn.outstandingPacketEvents.erase(*packet.associatedEvent);
+          DCHECK_GT(conn.outstandingClonedPacketsCount, 0);
+          --conn.outstandingClonedPacketsCount;
+        }
+        DCHECK(conn.outstandingHandshakePacketsCount);
+        --conn.outstandingHandshakePacketsCount;
+        ++conn.lossState.timeoutBasedRtxCount;
+        ++conn.lossState.rtxCount;
+        iter = outstandingPackets.erase(iter);
+      } else {
+        iter++;
+      }
     }
   }
   if (conn.congestionController && lossEvent.largestLostPacketNum.hasValue()) {
@@ -440,8 +496,10 @@ void markZeroRttPacketsLost(
     QuicConnectionStateBase& conn,
     const LossVisitor& lossVisitor) {
   CongestionController::LossEvent lossEvent(ClockType::now());
-  auto iter = getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
-  while (iter != conn.outstandingPackets.end()) {
+  auto& outstandingPackets =
+      conn.outstandingPackets[PacketNumberSpace::AppData];
+  auto iter = outstandingPackets.begin();
+  while (iter != outstandingPackets.end()) {
     DCHECK_EQ(
         iter->packet.header.getPacketNumberSpace(), PacketNumberSpace::AppData);
     auto isZeroRttPacket =
@@ -460,11 +518,9 @@ void markZeroRttPacketsLost(
         --conn.outstandingClonedPacketsCount;
       }
       lossEvent.addLostPacket(pkt);
-      iter = conn.outstandingPackets.erase(iter);
-      iter = getNextOutstandingPacket(conn, PacketNumberSpace::AppData, iter);
+      iter = outstandingPackets.erase(iter);
     } else {
-      iter =
-          getNextOutstandingPacket(conn, PacketNumberSpace::AppData, iter + 1);
+      iter++;
     }
   }
   conn.lossState.rtxCount += lossEvent.lostPackets;
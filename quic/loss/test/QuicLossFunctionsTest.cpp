@@ -193,17 +193,18 @@ PacketNum QuicLossFunctionsTest::sendPacket(
   if (conn.congestionController) {
     conn.congestionController->onPacketSent(outstandingPacket);
   }
+  auto& outstandingPackets = conn.outstandingPackets[packetNumberSpace];
   if (associatedEvent) {
     conn.outstandingClonedPacketsCount++;
     // Simulates what the real writer does.
     auto it = std::find_if(
-        conn.outstandingPackets.begin(),
-        conn.outstandingPackets.end(),
+        outstandingPackets.begin(),
+        outstandingPackets.end(),
         [&associatedEvent](const auto& packet) {
           auto packetNum = packet.packet.header.getPacketSequenceNum();
           return packetNum == *associatedEvent;
         });
-    if (it != conn.outstandingPackets.end()) {
+    if (it != outstandingPackets.end()) {
       if (!it->associatedEvent) {
         conn.outstandingPacketEvents.emplace(*associatedEvent);
         conn.outstandingClonedPacketsCount++;
@@ -211,7 +212,7 @@ PacketNum QuicLossFunctionsTest::sendPacket(
       }
     }
   }
-  conn.outstandingPackets.emplace_back(std::move(outstandingPacket));
+  outstandingPackets.emplace_back(std::move(outstandingPacket));
   conn.lossState.largestSent = getNextPacketNum(conn, packetNumberSpace);
   increaseNextPacketNum(conn, packetNumberSpace);
   conn.pendingEvents.setLossDetectionAlarm = true;
@@ -336,7 +337,7 @@ TEST_F(QuicLossFunctionsTest, TestMarkPacketLoss) {
 
   EXPECT_EQ(1, conn->outstandingPackets.size());
   auto& packet =
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].front().packet;
   auto packetNum = packet.header.getPacketSequenceNum();
   markPacketLoss(*conn, packet, false, packetNum);
   EXPECT_EQ(stream1->retransmissionBuffer.size(), 0);
@@ -386,13 +387,13 @@ TEST_F(QuicLossFunctionsTest, TestMarkPacketLossMerge) {
   EXPECT_EQ(2, conn->outstandingPackets.size());
 
   auto& packet1 =
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].front().packet;
   auto packetNum = packet1.header.getPacketSequenceNum();
   markPacketLoss(*conn, packet1, false, packetNum);
   EXPECT_EQ(stream1->retransmissionBuffer.size(), 1);
   EXPECT_EQ(stream1->lossBuffer.size(), 1);
   auto& packet2 =
-      getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].back().packet;
   packetNum = packet2.header.getPacketSequenceNum();
   markPacketLoss(*conn, packet2, false, packetNum);
   EXPECT_EQ(stream1->retransmissionBuffer.size(), 0);
@@ -455,13 +456,13 @@ TEST_F(QuicLossFunctionsTest, TestMarkPacketLossNoMerge) {
   EXPECT_EQ(3, conn->outstandingPackets.size());
 
   auto& packet1 =
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].front().packet;
   auto packetNum = packet1.header.getPacketSequenceNum();
   markPacketLoss(*conn, packet1, false, packetNum);
   EXPECT_EQ(stream1->retransmissionBuffer.size(), 2);
   EXPECT_EQ(stream1->lossBuffer.size(), 1);
   auto& packet3 =
-      getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].back().packet;
   packetNum = packet3.header.getPacketSequenceNum();
   markPacketLoss(*conn, packet3, false, packetNum);
   EXPECT_EQ(stream1->retransmissionBuffer.size(), 1);
@@ -508,7 +509,9 @@ TEST_F(QuicLossFunctionsTest, RetxBufferSortedAfterLoss) {
       *buf3);
   EXPECT_EQ(3, stream->retransmissionBuffer.size());
   EXPECT_EQ(3, conn->outstandingPackets.size());
-  auto packet = conn->outstandingPackets[folly::Random::rand32() % 3];
+  auto packet = *std::next(
+      conn->outstandingPackets[PacketNumberSpace::AppData].begin(),
+      folly::Random::rand32() % 3);
   markPacketLoss(
       *conn, packet.packet, false, packet.packet.header.getPacketSequenceNum());
   EXPECT_EQ(2, stream->retransmissionBuffer.size());
@@ -540,7 +543,8 @@ TEST_F(QuicLossFunctionsTest, TestMarkCryptoLostAfterCancelRetransmission) {
       conn->transportSettings.writeConnectionDataPacketsLimit);
   ASSERT_EQ(conn->outstandingPackets.size(), 1);
   EXPECT_GT(conn->cryptoState->handshakeStream.retransmissionBuffer.size(), 0);
-  auto& packet = conn->outstandingPackets.front().packet;
+  auto& packet =
+      conn->outstandingPackets[PacketNumberSpace::Handshake].front().packet;
   auto packetNum = packet.header.getPacketSequenceNum();
   cancelCryptoStream(conn->cryptoState->handshakeStream);
   markPacketLoss(*conn, packet, false, packetNum);
@@ -574,7 +578,8 @@ TEST_F(QuicLossFunctionsTest, TestMarkCryptoLostCancel) {
       conn->transportSettings.writeConnectionDataPacketsLimit);
   ASSERT_EQ(conn->outstandingPackets.size(), 1);
   EXPECT_GT(conn->cryptoState->handshakeStream.retransmissionBuffer.size(), 0);
-  auto& packet = conn->outstandingPackets.front().packet;
+  auto& packet =
+      conn->outstandingPackets[PacketNumberSpace::Handshake].front().packet;
   auto packetNum = packet.header.getPacketSequenceNum();
   markPacketLoss(*conn, packet, false, packetNum);
   EXPECT_EQ(conn->cryptoState->handshakeStream.retransmissionBuffer.size(), 0);
@@ -628,19 +633,18 @@ TEST_F(QuicLossFunctionsTest, TestReorderingThreshold) {
   }
   EXPECT_EQ(6, conn->outstandingHandshakePacketsCount);
   // Assume some packets are already acked
-  for (auto iter =
-           getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake) + 2;
-       iter <
-       getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake) + 5;
+  auto& handshakePackets =
+      conn->outstandingPackets[PacketNumberSpace::Handshake];
+  for (auto iter = std::next(handshakePackets.begin(), 2);
+       iter != std::next(handshakePackets.begin(), 5);
        iter++) {
     if (iter->isHandshake) {
       conn->outstandingHandshakePacketsCount--;
     }
   }
-  auto firstHandshakeOpIter =
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::Handshake);
-  conn->outstandingPackets.erase(
-      firstHandshakeOpIter + 2, firstHandshakeOpIter + 5);
+  handshakePackets.erase(
+      std::next(handshakePackets.begin(), 2),
+      std::next(handshakePackets.begin(), 5));
   // Ack for packet 9 arrives
   auto lossEvent = detectLossPackets<decltype(testingLossMarkFunc)>(
       *conn,
@@ -661,10 +665,61 @@ TEST_F(QuicLossFunctionsTest, TestReorderingThreshold) {
   // Packet 6 should remain in packet as the delta is less than threshold
   EXPECT_EQ(conn->outstandingPackets.size(), 1);
   auto packetNum =
-      conn->outstandingPackets.front().packet.header.getPacketSequenceNum();
+      handshakePackets.front().packet.header.getPacketSequenceNum();
   EXPECT_EQ(packetNum, 6);
 }
 
+TEST_F(QuicLossFunctionsTest, PmtuProbeLossIsNotCongestion) {
+  std::vector<PacketNum> lostPacket;
+  auto conn = createConn();
+  conn->transportSettings.pmtuDiscoveryEnabled = true;
+  startPmtuDiscovery(*conn, kDefaultMaxUDPPayload);
+  ASSERT_TRUE(hasPendingPmtuProbe(*conn));
+  // Only the packet threshold declares losses.
+  conn->lossState.srtt = 100ms;
+  conn->lossState.lrtt = 100ms;
+
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn->congestionController = std::move(mockCongestionController);
+  EXPECT_CALL(*rawCongestionController, onPacketSent(_))
+      .WillRepeatedly(Return());
+
+  auto testingLossMarkFunc =
+      [&lostPacket](auto& /*conn*/, auto& packet, bool, PacketNum) {
+        lostPacket.push_back(packet.header.getPacketSequenceNum());
+      };
+  auto probePacketNum =
+      sendPacket(*conn, TimePoint(10ms), folly::none, PacketType::OneRtt);
+  onPmtuProbeSent(*conn, probePacketNum);
+  auto probeSize =
+      conn->outstandingPackets[PacketNumberSpace::AppData].back().encodedSize;
+  auto lostPacketNum =
+      sendPacket(*conn, TimePoint(10ms), folly::none, PacketType::OneRtt);
+  PacketNum largestSent = 0;
+  for (int i = 0; i < 4; ++i) {
+    largestSent =
+        sendPacket(*conn, TimePoint(10ms), folly::none, PacketType::OneRtt);
+  }
+
+  // Only the bytes of the probe leave the inflight outside of the loss event.
+  EXPECT_CALL(*rawCongestionController, onRemoveBytesFromInflight(probeSize));
+  auto lossEvent = detectLossPackets<decltype(testingLossMarkFunc)>(
+      *conn,
+      largestSent,
+      testingLossMarkFunc,
+      TimePoint(90ms),
+      PacketNumberSpace::AppData);
+  ASSERT_TRUE(lossEvent.hasValue());
+  EXPECT_EQ(1, lossEvent->lostPackets);
+  EXPECT_EQ(lostPacketNum, lossEvent->largestLostPacketNum.value());
+  ASSERT_EQ(1, lostPacket.size());
+  EXPECT_EQ(lostPacketNum, lostPacket.front());
+  // The same size is probed again.
+  EXPECT_TRUE(hasPendingPmtuProbe(*conn));
+  EXPECT_EQ(1, conn->pmtuDiscoveryState.probeLosses);
+}
+
 TEST_F(QuicLossFunctionsTest, TestHandleAckForLoss) {
   auto conn = createConn();
   auto mockQLogger = std::make_shared<MockQLogger>(VantagePoint::Server);
@@ -680,7 +735,7 @@ TEST_F(QuicLossFunctionsTest, TestHandleAckForLoss) {
       conn->version.value());
   RegularQuicWritePacket outstandingRegularPacket(std::move(longHeader));
   auto now = Clock::now();
-  conn->outstandingPackets.emplace_back(
+  conn->outstandingPackets[PacketNumberSpace::Handshake].emplace_back(
       OutstandingPacket(outstandingRegularPacket, now, 0, false, 0));
 
   bool testLossMarkFuncCalled = false;
@@ -766,7 +821,7 @@ TEST_F(QuicLossFunctionsTest, TestMarkRstLoss) {
   EXPECT_EQ(conn->outstandingPackets.size(), 1);
   EXPECT_TRUE(conn->pendingEvents.resets.empty());
   auto& packet =
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].front().packet;
   markPacketLoss(*conn, packet, false, packet.header.getPacketSequenceNum());
 
   EXPECT_EQ(1, conn->pendingEvents.resets.size());
@@ -788,7 +843,7 @@ TEST_F(QuicLossFunctionsTest, TestMarkRstLoss) {
       conn->transportSettings.writeConnectionDataPacketsLimit);
   EXPECT_TRUE(conn->pendingEvents.resets.empty());
   auto& packet2 =
-      getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].back().packet;
   bool rstFound = false;
   for (auto& frame : packet2.frames) {
     auto resetFrame = frame.asRstStreamFrame();
@@ -837,6 +892,56 @@ TEST_F(QuicLossFunctionsTest, ReorderingThresholdChecksSamePacketNumberSpace) {
   EXPECT_GT(lossVisitorCount, 0);
 }
 
+TEST_F(QuicLossFunctionsTest, RackWaitsOutReorderWindowOnceReorderingSeen) {
+  auto conn = createConn();
+  conn->transportSettings.useRackLossDetection = true;
+  conn->lossState.srtt = 100ms;
+  conn->lossState.lrtt = 100ms;
+  conn->lossState.mrtt = 100ms;
+  EXPECT_EQ(25ms, rackReorderWindow(*conn));
+
+  std::vector<PacketNum> lostPackets;
+  auto lossVisitor = [&](auto&, auto&, bool, PacketNum packetNum) {
+    lostPackets.push_back(packetNum);
+  };
+  PacketNum latestSent = 0;
+  for (int i = 0; i < 6; ++i) {
+    latestSent = sendPacket(
+        *conn,
+        TimePoint(std::chrono::milliseconds(i)),
+        folly::none,
+        PacketType::OneRtt);
+  }
+  // The last packet got acked, after the peer had reordered packets before.
+  conn->lossState.rackLatestDeliveredSentTime = TimePoint(5ms);
+  conn->lossState.rackReorderingSeen = true;
+
+  // Well past the packet threshold, but within the rtt and reorder window.
+  auto lossEvent = detectLossPackets(
+      *conn,
+      latestSent,
+      lossVisitor,
+      TimePoint(50ms),
+      PacketNumberSpace::AppData);
+  EXPECT_FALSE(lossEvent.hasValue());
+  EXPECT_TRUE(lostPackets.empty());
+  EXPECT_EQ(
+      TimePoint(125ms), *getLossTime(*conn, PacketNumberSpace::AppData));
+
+  lossEvent = detectLossPackets(
+      *conn,
+      latestSent,
+      lossVisitor,
+      TimePoint(200ms),
+      PacketNumberSpace::AppData);
+  ASSERT_TRUE(lossEvent.hasValue());
+  EXPECT_EQ(5, lostPackets.size());
+
+  // The window grows with more reordering, but never past the srtt.
+  conn->lossState.rackReorderWindowMultiplier = 8;
+  EXPECT_EQ(100ms, rackReorderWindow(*conn));
+}
+
 TEST_F(QuicLossFunctionsTest, TestMarkWindowUpdateLoss) {
   auto conn = createConn();
   folly::EventBase evb;
@@ -857,7 +962,7 @@ TEST_F(QuicLossFunctionsTest, TestMarkWindowUpdateLoss) {
 
   EXPECT_EQ(1, conn->outstandingPackets.size());
   auto& packet =
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)->packet;
+      conn->outstandingPackets[PacketNumberSpace::AppData].front().packet;
 
   auto packetNum = packet.header.getPacketSequenceNum();
   markPacketLoss(*conn, packet, false, packetNum);
@@ -881,9 +986,10 @@ TEST_F(QuicLossFunctionsTest, TestTimeReordering) {
   // Some packets are already acked
   conn->lossState.srtt = 400ms;
   conn->lossState.lrtt = 350ms;
-  conn->outstandingPackets.erase(
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData) + 2,
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData) + 5);
+  auto& appDataPackets = conn->outstandingPackets[PacketNumberSpace::AppData];
+  appDataPackets.erase(
+      std::next(appDataPackets.begin(), 2),
+      std::next(appDataPackets.begin(), 5));
   auto lossEvent = detectLossPackets<decltype(testingLossMarkFunc(lostPacket))>(
       *conn,
       largestSent,
@@ -899,8 +1005,7 @@ TEST_F(QuicLossFunctionsTest, TestTimeReordering) {
 
   // Packet 6, 7 should remain in outstanding packet list
   EXPECT_EQ(2, conn->outstandingPackets.size());
-  auto packetNum = getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)
-                       ->packet.header.getPacketSequenceNum();
+  auto packetNum = appDataPackets.front().packet.header.getPacketSequenceNum();
   EXPECT_EQ(packetNum, 6);
   EXPECT_TRUE(conn->lossState.lossTimes[PacketNumberSpace::AppData]);
 }
@@ -943,7 +1048,7 @@ TEST_F(QuicLossFunctionsTest, LossTimePreemptsCryptoTimer) {
 
   // Second packet gets acked:
   getAckState(*conn, PacketNumberSpace::Handshake).largestAckedByPeer = second;
-  conn->outstandingPackets.pop_back();
+  conn->outstandingPackets[PacketNumberSpace::Handshake].pop_back();
   MockClock::mockNow = [=]() { return sendTime + expectedDelayUntilLost + 5s; };
   onLossDetectionAlarm<decltype(testingLossMarkFunc(lostPackets)), MockClock>(
       *conn, testingLossMarkFunc(lostPackets));
@@ -989,7 +1094,9 @@ TEST_F(
   conn->congestionController = std::move(mockCongestionController);
   EXPECT_CALL(*rawCongestionController, onPacketSent(_))
       .WillRepeatedly(Return());
-  EXPECT_CALL(*mockQLogger, addLossAlarm(5, 0, 10, kHandshakeAlarm));
+  EXPECT_CALL(
+      *mockQLogger,
+      addLossAlarm(5, 0, 10, folly::StringPiece(kHandshakeAlarm)));
   std::vector<PacketNum> lostPackets;
   PacketNum expectedLargestLostNum = 0;
   conn->lossState.currentAlarmMethod = LossState::AlarmMethod::Handshake;
@@ -1003,9 +1110,11 @@ TEST_F(
     expectedLargestLostNum = std::max(
         expectedLargestLostNum, i % 2 ? sentPacketNum : expectedLargestLostNum);
   }
+  auto& handshakePackets =
+      conn->outstandingPackets[PacketNumberSpace::Handshake];
   uint64_t expectedLostBytes = std::accumulate(
-      conn->outstandingPackets.begin(),
-      conn->outstandingPackets.end(),
+      handshakePackets.begin(),
+      handshakePackets.end(),
       0,
       [](uint64_t num, const OutstandingPacket& packet) {
         return packet.isHandshake ? num + packet.encodedSize : num;
@@ -1024,6 +1133,36 @@ TEST_F(
   EXPECT_EQ(5, conn->lossState.rtxCount);
 }
 
+TEST_F(QuicLossFunctionsTest, HandshakeAlarmErasesPacketEvents) {
+  auto conn = createConn();
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn->congestionController = std::move(mockCongestionController);
+  EXPECT_CALL(*rawCongestionController, onPacketSent(_))
+      .WillRepeatedly(Return());
+  EXPECT_CALL(*rawCongestionController, onRemoveBytesFromInflight(_));
+  conn->lossState.currentAlarmMethod = LossState::AlarmMethod::Handshake;
+  auto original =
+      sendPacket(*conn, TimePoint(100ms), folly::none, PacketType::Handshake);
+  sendPacket(*conn, TimePoint(100ms), original, PacketType::Handshake);
+  ASSERT_EQ(1, conn->outstandingPacketEvents.size());
+  ASSERT_EQ(2, conn->outstandingClonedPacketsCount);
+
+  std::vector<std::pair<PacketNum, bool>> lostPackets;
+  onHandshakeAlarm(
+      *conn, [&lostPackets](auto&, auto&, bool processed, PacketNum packetNum) {
+        lostPackets.emplace_back(packetNum, processed);
+      });
+  // Only the first loss of the clone group has its frames processed, and
+  // the group is gone with it, not left in the set.
+  ASSERT_EQ(2, lostPackets.size());
+  EXPECT_FALSE(lostPackets[0].second);
+  EXPECT_TRUE(lostPackets[1].second);
+  EXPECT_TRUE(conn->outstandingPackets.empty());
+  EXPECT_TRUE(conn->outstandingPacketEvents.empty());
+  EXPECT_EQ(0, conn->outstandingClonedPacketsCount);
+}
+
 TEST_F(QuicLossFunctionsTest, HandshakeAlarmWithOneRttCipher) {
   auto conn = createClientConn();
   auto mockQLogger = std::make_shared<MockQLogger>(VantagePoint::Client);
@@ -1031,7 +1170,9 @@ TEST_F(QuicLossFunctionsTest, HandshakeAlarmWithOneRttCipher) {
   conn->oneRttWriteCipher = createNoOpAead();
   conn->lossState.currentAlarmMethod = LossState::AlarmMethod::Handshake;
   std::vector<PacketNum> lostPackets;
-  EXPECT_CALL(*mockQLogger, addLossAlarm(1, 0, 1, kHandshakeAlarm));
+  EXPECT_CALL(
+      *mockQLogger,
+      addLossAlarm(1, 0, 1, folly::StringPiece(kHandshakeAlarm)));
   sendPacket(*conn, TimePoint(100ms), folly::none, PacketType::Handshake);
   onLossDetectionAlarm<decltype(testingLossMarkFunc(lostPackets)), Clock>(
       *conn, testingLossMarkFunc(lostPackets));
@@ -1278,9 +1419,9 @@ TEST_F(QuicLossFunctionsTest, TestMarkPacketLossProcessedPacket) {
   ASSERT_TRUE(conn->outstandingPacketEvents.empty());
   uint32_t streamDataCounter = 0, streamWindowUpdateCounter = 0,
            connWindowUpdateCounter = 0;
-  for (const auto& frame :
-       getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)
-           ->packet.frames) {
+  for (const auto& frame : conn->outstandingPackets[PacketNumberSpace::AppData]
+                                .back()
+                                .packet.frames) {
     switch (frame.type()) {
       case QuicWriteFrame::Type::WriteStreamFrame_E:
         streamDataCounter++;
@@ -1313,7 +1454,9 @@ TEST_F(QuicLossFunctionsTest, TestTotalPTOCount) {
   auto mockQLogger = std::make_shared<MockQLogger>(VantagePoint::Server);
   conn->qLogger = mockQLogger;
   conn->lossState.totalPTOCount = 100;
-  EXPECT_CALL(*mockQLogger, addLossAlarm(0, 1, 0, kPtoAlarm));
+  EXPECT_CALL(
+      *mockQLogger,
+      addLossAlarm(0, 1, 0, folly::StringPiece(kPtoAlarm)));
   EXPECT_CALL(*transportInfoCb_, onPTO());
   onPTOAlarm(*conn);
   EXPECT_EQ(101, conn->lossState.totalPTOCount);
@@ -1325,7 +1468,9 @@ TEST_F(QuicLossFunctionsTest, TestExceedsMaxPTOThrows) {
   conn->qLogger = mockQLogger;
   conn->transportSettings.maxNumPTOs = 3;
   for (int i = 1; i <= 3; i++) {
-    EXPECT_CALL(*mockQLogger, addLossAlarm(0, i, 0, kPtoAlarm));
+    EXPECT_CALL(
+        *mockQLogger,
+        addLossAlarm(0, i, 0, folly::StringPiece(kPtoAlarm)));
   }
   EXPECT_CALL(*transportInfoCb_, onPTO()).Times(3);
   onPTOAlarm(*conn);
@@ -1333,6 +1478,48 @@ TEST_F(QuicLossFunctionsTest, TestExceedsMaxPTOThrows) {
   EXPECT_THROW(onPTOAlarm(*conn), QuicInternalException);
 }
 
+TEST_F(QuicLossFunctionsTest, AdaptivePTOProbes) {
+  auto conn = createConn();
+  conn->transportSettings.adaptivePTOProbes = true;
+  sendPacket(*conn, Clock::now(), folly::none, PacketType::OneRtt);
+  EXPECT_CALL(*transportInfoCb_, onPTO()).Times(3);
+
+  // An idle tail is probed with a PING first.
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPTOProbe(QuicTransportStatsCallback::PTOProbeType::PING));
+  onPTOAlarm(*conn);
+  EXPECT_EQ(1, conn->pendingEvents.numProbePackets);
+  EXPECT_TRUE(conn->pendingEvents.pingProbe);
+  ASSERT_EQ(1, conn->pendingEvents.frames.size());
+  EXPECT_NE(nullptr, conn->pendingEvents.frames.front().asPingFrame());
+  EXPECT_EQ(
+      conn->lossState.largestSent, conn->lossState.largestSentAtPTO.value());
+  conn->pendingEvents.numProbePackets = 0;
+  conn->pendingEvents.pingProbe = false;
+  conn->pendingEvents.frames.clear();
+
+  // Then the outstanding packets are cloned.
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPTOProbe(QuicTransportStatsCallback::PTOProbeType::CLONE));
+  onPTOAlarm(*conn);
+  EXPECT_EQ(kPacketToSendForPTO, conn->pendingEvents.numProbePackets);
+  EXPECT_FALSE(conn->pendingEvents.pingProbe);
+  EXPECT_TRUE(conn->pendingEvents.frames.empty());
+
+  // New data to send is sent instead.
+  conn->lossState.ptoCount = 0;
+  auto stream = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream, folly::IOBuf::copyBuffer("data"), false);
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPTOProbe(QuicTransportStatsCallback::PTOProbeType::NEW_DATA));
+  onPTOAlarm(*conn);
+  EXPECT_EQ(kPacketToSendForPTO, conn->pendingEvents.numProbePackets);
+  EXPECT_FALSE(conn->pendingEvents.pingProbe);
+}
+
 TEST_F(QuicLossFunctionsTest, TotalLossCount) {
   auto conn = createConn();
   conn->congestionController = nullptr;
@@ -1389,8 +1576,9 @@ TEST_F(QuicLossFunctionsTest, TestZeroRttRejected) {
   for (auto lostPacket : lostPackets) {
     EXPECT_FALSE(lostPacket.second);
   }
-  for (size_t i = 0; i < conn->outstandingPackets.size(); ++i) {
-    auto longHeader = conn->outstandingPackets[i].packet.header.asLong();
+  for (const auto& packet :
+       conn->outstandingPackets[PacketNumberSpace::AppData]) {
+    auto longHeader = packet.packet.header.asLong();
     EXPECT_FALSE(
         longHeader &&
         longHeader->getProtectionType() == ProtectionType::ZeroRtt);
@@ -1441,8 +1629,9 @@ TEST_F(QuicLossFunctionsTest, TestZeroRttRejectedWithClones) {
     numProcessed += lostPacket.second;
   }
   EXPECT_EQ(numProcessed, 1);
-  for (size_t i = 0; i < conn->outstandingPackets.size(); ++i) {
-    auto longHeader = conn->outstandingPackets[i].packet.header.asLong();
+  for (const auto& packet :
+       conn->outstandingPackets[PacketNumberSpace::AppData]) {
+    auto longHeader = packet.packet.header.asLong();
     EXPECT_FALSE(
         longHeader &&
         longHeader->getProtectionType() == ProtectionType::ZeroRtt);
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Bits.h>
+#include <folly/Optional.h>
+#include <quic/codec/QuicConnectionId.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Direct-indexed routing table for server chosen connection ids. The slot of
+ * a connection id is taken from its trailing bytes, which the connection id
+ * algorithm fills at random past the routing bits, so no hashing is needed.
+ * Every slot keeps the full connection id it was filled with and a lookup
+ * only hits when it matches, which stops a stale or colliding id from being
+ * routed to the wrong transport.
+ *
+ * A slot holds a single connection id, an id whose slot is taken is not
+ * inserted, so the table is meant to sit in front of an authoritative map.
+ */
+template <class T>
+class ConnectionIdRoutingTable {
+ public:
+  explicit ConnectionIdRoutingTable(size_t numSlots)
+      : slots_(folly::nextPowTwo(std::max<size_t>(numSlots, 1))),
+        mask_(slots_.size() - 1) {}
+
+  const T* find(const ConnectionId& connId) const {
+    const Slot& slot = slots_[slotIndex(connId)];
+    if (slot.connId && *slot.connId == connId) {
+      return &slot.value;
+    }
+    return nullptr;
+  }
+
+  /**
+   * Returns false without changing the table if the slot of connId is already
+   * taken.
+   */
+  bool insert(const ConnectionId& connId, T value) {
+    Slot& slot = slots_[slotIndex(connId)];
+    if (slot.connId) {
+      return false;
+    }
+    slot.connId = connId;
+    slot.value = std::move(value);
+    ++size_;
+    return true;
+  }
+
+  void erase(const ConnectionId& connId) {
+    Slot& slot = slots_[slotIndex(connId)];
+    if (slot.connId && *slot.connId == connId) {
+      slot.connId.clear();
+      slot.value = T();
+      --size_;
+    }
+  }
+
+  void clear() {
+    for (auto& slot : slots_) {
+      slot.connId.clear();
+      slot.value = T();
+    }
+    size_ = 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  size_t numSlots() const {
+    return slots_.size();
+  }
+
+ private:
+  size_t slotIndex(const ConnectionId& connId) const {
+    // The leading bytes carry the routing bits, which are the same for every
+    // connection of a worker.
+    size_t index = 0;
+    size_t tailLen = std::min<size_t>(connId.size(), sizeof(uint32_t));
+    const uint8_t* tail = connId.data() + connId.size() - tailLen;
+    for (size_t i = 0; i < tailLen; ++i) {
+      index = (index << 8) | tail[i];
+    }
+    return index & mask_;
+  }
+
+  struct Slot {
+    folly::Optional<ConnectionId> connId;
+    T value;
+  };
+
+  std::vector<Slot> slots_;
+  size_t mask_;
+  size_t size_{0};
+};
+
+} // namespace quic
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/SocketAddress.h>
+#include <folly/container/F14Map.h>
+#include <quic/QuicConstants.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/common/BufUtil.h>
+
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace quic {
+
+/**
+ * The connections of a worker that closed and are waiting out their drain
+ * period, cut down to what it takes to answer their peer: the last close
+ * packet sent, already sealed, and the address it went to. The transport of
+ * such a connection is freed as soon as it closes.
+ *
+ * The close packet is sent again as is, which RFC 9000 section 10.2.1 allows
+ * for a closing connection. It answers the received packets that double the
+ * count since the last one, so a peer that keeps sending is answered less
+ * and less often.
+ */
+class DrainingConnectionTable {
+ public:
+  struct Entry {
+    folly::SocketAddress peerAddress;
+    // null when nothing is sent back, e.g. the peer closed the connection
+    Buf closePacket;
+    std::vector<ConnectionId> connectionIds;
+    TimePoint deadline;
+    uint64_t packetsReceived{0};
+    uint64_t nextCloseAt{1};
+  };
+
+  /**
+   * Adds the entry under each of its connection ids, in place of any entry
+   * they had.
+   */
+  void insert(Entry entry) {
+    auto shared = std::make_shared<Entry>(std::move(entry));
+    for (const auto& connId : shared->connectionIds) {
+      entries_[connId] = shared;
+    }
+    expiry_.push(std::move(shared));
+  }
+
+  /**
+   * The entry of connId, nullptr if there is none or its drain period is
+   * over by now.
+   */
+  Entry* find(const ConnectionId& connId, TimePoint now) {
+    auto it = entries_.find(connId);
+    if (it == entries_.end() || it->second->deadline <= now) {
+      return nullptr;
+    }
+    return it->second.get();
+  }
+
+  /**
+   * Counts a packet received for the entry, returns whether to answer it with
+   * the close packet.
+   */
+  static bool onPacketReceived(Entry& entry) {
+    if (!entry.closePacket) {
+      return false;
+    }
+    if (++entry.packetsReceived < entry.nextCloseAt) {
+      return false;
+    }
+    entry.nextCloseAt = entry.packetsReceived * 2;
+    return true;
+  }
+
+  /**
+   * Drops the entries whose drain period is over by now.
+   */
+  void expire(TimePoint now) {
+    while (!expiry_.empty() && expiry_.top()->deadline <= now) {
+      const auto& entry = expiry_.top();
+      for (const auto& connId : entry->connectionIds) {
+        auto it = entries_.find(connId);
+        // the id may have been taken over by a later entry
+        if (it != entries_.end() && it->second == entry) {
+          entries_.erase(it);
+        }
+      }
+      expiry_.pop();
+    }
+  }
+
+  void clear() {
+    entries_.clear();
+    expiry_ = ExpiryQueue();
+  }
+
+  // the number of connections draining
+  size_t size() const {
+    return expiry_.size();
+  }
+
+  bool empty() const {
+    return expiry_.empty();
+  }
+
+ private:
+  struct LaterDeadline {
+    bool operator()(
+        const std::shared_ptr<Entry>& lhs,
+        const std::shared_ptr<Entry>& rhs) const {
+      return lhs->deadline > rhs->deadline;
+    }
+  };
+
+  using ExpiryQueue = std::priority_queue<
+      std::shared_ptr<Entry>,
+      std::vector<std::shared_ptr<Entry>>,
+      LaterDeadline>;
+
+  folly::F14FastMap<ConnectionId, std::shared_ptr<Entry>, ConnectionIdHash>
+      entries_;
+  ExpiryQueue expiry_;
+};
+
+} // namespace quic
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/OverloadController.h>
+
+#include <quic/QuicConstants.h>
+
+#include <algorithm>
+#include <array>
+
+namespace quic {
+
+namespace {
+// The load each level from RETRY on is entered at
+constexpr std::array<
+    double,
+    static_cast<size_t>(OverloadController::Level::MAX) - 1>
+    kOverloadThresholds = {0.7, 0.8, 0.9, 1.0};
+} // namespace
+
+folly::StringPiece OverloadController::toString(Level level) {
+  switch (level) {
+    case Level::NONE:
+      return "NONE";
+    case Level::RETRY:
+      return "RETRY";
+    case Level::NO_ZERO_RTT:
+      return "NO_ZERO_RTT";
+    case Level::SMALL_WINDOWS:
+      return "SMALL_WINDOWS";
+    case Level::REJECT:
+      return "REJECT";
+    case Level::MAX:
+      return "MAX";
+  }
+  folly::assume_unreachable();
+}
+
+OverloadController::OverloadController(
+    std::chrono::microseconds maxLoopLag,
+    uint64_t memoryBudget,
+    MemoryUsageFn memoryUsage)
+    : maxLoopLag_(maxLoopLag),
+      memoryBudget_(memoryBudget),
+      memoryUsage_(std::move(memoryUsage)) {}
+
+uint32_t OverloadController::getSampleRate() const {
+  // Every loop
+  return 0;
+}
+
+void OverloadController::loopSample(int64_t busyTime, int64_t idleTime) {
+  if (observer_ && observerSampleCount_++ == observer_->getSampleRate()) {
+    observerSampleCount_ = 0;
+    observer_->loopSample(busyTime, idleTime);
+  }
+  std::chrono::microseconds busy(std::max<int64_t>(busyTime, 0));
+  busyTime_ += busy;
+  idleTime_ += std::chrono::microseconds(std::max<int64_t>(idleTime, 0));
+  maxBusyTime_ = std::max(maxBusyTime_, busy);
+  if (busyTime_ + idleTime_ >= kOverloadSampleWindow) {
+    evaluate();
+  }
+}
+
+OverloadController::Level OverloadController::getLevel() const noexcept {
+  return level_;
+}
+
+double OverloadController::getLoad() const noexcept {
+  return load_;
+}
+
+void OverloadController::setObserver(
+    std::shared_ptr<folly::EventBaseObserver> observer) {
+  observer_ = std::move(observer);
+  observerSampleCount_ = 0;
+}
+
+void OverloadController::evaluate() {
+  load_ = busyTime_.count() * 1.0 / (busyTime_ + idleTime_).count();
+  if (maxLoopLag_.count() > 0) {
+    load_ = std::max(load_, maxBusyTime_.count() * 1.0 / maxLoopLag_.count());
+  }
+  if (memoryBudget_ > 0 && memoryUsage_) {
+    load_ = std::max(load_, memoryUsage_() * 1.0 / memoryBudget_);
+  }
+  busyTime_ = idleTime_ = maxBusyTime_ = std::chrono::microseconds::zero();
+
+  auto level = static_cast<size_t>(level_);
+  while (level < kOverloadThresholds.size() &&
+         load_ >= kOverloadThresholds[level]) {
+    ++level;
+  }
+  while (level > 0 &&
+         load_ < kOverloadThresholds[level - 1] - kOverloadHysteresis) {
+    --level;
+  }
+  if (level != static_cast<size_t>(level_)) {
+    VLOG(2) << "Overload level " << toString(level_) << " -> "
+            << toString(static_cast<Level>(level)) << " load=" << load_;
+    level_ = static_cast<Level>(level);
+  }
+}
+
+} // namespace quic
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/io/async/EventBase.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace quic {
+
+/**
+ * Tells how much of what a server worker offers new connections it holds
+ * back under load. As the observer of the worker's evb it adds up the busy
+ * and idle time of the loops over kOverloadSampleWindow. The load of the
+ * worker is the largest of:
+ *  - the share of that time the loop was busy,
+ *  - the longest loop over maxLoopLag, the lag it adds to everything else
+ *    waiting on the loop,
+ *  - the bytes the connections of the worker hold over memoryBudget.
+ * Each level is entered as the load crosses its threshold and left once it
+ * drops kOverloadHysteresis below it. Only new connections are degraded, so
+ * that the existing ones stay healthy through a spike. Not thread safe, used
+ * on the evb of the worker only.
+ */
+class OverloadController : public folly::EventBaseObserver {
+ public:
+  enum class Level : uint8_t {
+    NONE,
+    // New clients are sent a Retry first.
+    RETRY,
+    // Handshakes don't accept 0-RTT data either.
+    NO_ZERO_RTT,
+    // New connections advertise smaller initial windows too.
+    SMALL_WINDOWS,
+    // New connections are rejected.
+    REJECT,
+    MAX,
+  };
+
+  static folly::StringPiece toString(Level level);
+
+  // The bytes the connections of the worker hold, from the memory budget
+  using MemoryUsageFn = std::function<uint64_t()>;
+
+  /**
+   * maxLoopLag and memoryBudget of 0 leave the loop lag and the memory out of
+   * the load.
+   */
+  OverloadController(
+      std::chrono::microseconds maxLoopLag,
+      uint64_t memoryBudget,
+      MemoryUsageFn memoryUsage = nullptr);
+
+  uint32_t getSampleRate() const override;
+
+  void loopSample(int64_t busyTime, int64_t idleTime) override;
+
+  Level getLevel() const noexcept;
+
+  /**
+   * The load of the worker over the last sample window, 1 being all it can
+   * take.
+   */
+  double getLoad() const noexcept;
+
+  /**
+   * The observer the app set on the evb, which the controller took the place
+   * of. It gets the loop samples at its own sample rate.
+   */
+  void setObserver(std::shared_ptr<folly::EventBaseObserver> observer);
+
+ private:
+  void evaluate();
+
+  std::chrono::microseconds maxLoopLag_;
+  uint64_t memoryBudget_;
+  MemoryUsageFn memoryUsage_;
+  std::shared_ptr<folly::EventBaseObserver> observer_;
+  uint32_t observerSampleCount_{0};
+
+  // The loops of the current sample window
+  std::chrono::microseconds busyTime_{0};
+  std::chrono::microseconds idleTime_{0};
+  std::chrono::microseconds maxBusyTime_{0};
+
+  double load_{0};
+  Level level_{Level::NONE};
+};
+
+} // namespace quic
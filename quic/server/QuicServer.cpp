@@ -8,7 +8,9 @@
 
 #include <quic/server/QuicServer.h>
 
+#include <folly/FileUtil.h>
 #include <folly/Random.h>
+#include <folly/lang/Bits.h>
 #include <folly/io/async/EventBaseManager.h>
 #include <quic/codec/DefaultConnectionIdAlgo.h>
 #include <quic/codec/QuicHeaderCodec.h>
@@ -16,18 +18,86 @@
 #include <quic/server/QuicServerTransport.h>
 #include <quic/server/QuicSharedUDPSocketFactory.h>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace quic {
 
 namespace {
 // Determine which worker to route to
 // This **MUST** be kept in sync with the BPF program (if supplied)
+size_t getWorkerToRouteTo(
+    const ConnectionId& connId,
+    size_t numWorkers,
+    ConnectionIdAlgo* connIdAlgo) {
+  return connIdAlgo->parseConnectionId(connId)->workerId % numWorkers;
+}
+
 size_t getWorkerToRouteTo(
     const RoutingData& routingData,
     size_t numWorkers,
     ConnectionIdAlgo* connIdAlgo) {
-  return connIdAlgo->parseConnectionId(routingData.destinationConnId)
-             ->workerId %
-      numWorkers;
+  return getWorkerToRouteTo(
+      routingData.destinationConnId, numWorkers, connIdAlgo);
+}
+
+// Connection handoff states go over the socket one by one, each after its
+// length, and a zero length after the last one.
+constexpr uint32_t kMaxConnectionHandoffStateSize = 64 * 1024;
+
+bool writeConnectionHandoffRecord(int fd, const folly::IOBuf* state) {
+  uint32_t len = state ? state->computeChainDataLength() : 0;
+  uint32_t lenBE = folly::Endian::big(len);
+  if (folly::writeFull(fd, &lenBE, sizeof(lenBE)) < 0) {
+    return false;
+  }
+  if (state) {
+    for (auto range : *state) {
+      if (folly::writeFull(fd, range.data(), range.size()) < 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Leaves state null after the last one.
+bool readConnectionHandoffRecord(int fd, Buf& state) {
+  uint32_t lenBE = 0;
+  if (folly::readFull(fd, &lenBE, sizeof(lenBE)) !=
+      static_cast<ssize_t>(sizeof(lenBE))) {
+    return false;
+  }
+  uint32_t len = folly::Endian::big(lenBE);
+  if (len == 0) {
+    state = nullptr;
+    return true;
+  }
+  if (len > kMaxConnectionHandoffStateSize) {
+    return false;
+  }
+  state = folly::IOBuf::create(len);
+  if (folly::readFull(fd, state->writableData(), len) !=
+      static_cast<ssize_t>(len)) {
+    return false;
+  }
+  state->append(len);
+  return true;
+}
+
+void pinCurrentThreadToCpu(FOLLY_MAYBE_UNUSED int cpu) {
+#ifdef __linux__
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu, &cpuSet);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+  LOG_IF(ERROR, ret != 0) << "Failed to pin worker thread to cpu=" << cpu
+                          << " error=" << ret;
+#else
+  LOG(ERROR) << "Pinning worker threads is not supported on this platform";
+#endif
 }
 } // namespace
 
@@ -60,6 +130,33 @@ void QuicServer::setCongestionControllerFactory(
   ccFactory_ = std::move(ccFactory);
 }
 
+void QuicServer::setCongestionStateCache(
+    std::shared_ptr<CongestionStateCache> cache) {
+  CHECK(!initialized_)
+      << " Congestion state cache must be set before the server is "
+      << "initialized.";
+  congestionStateCache_ = std::move(cache);
+}
+
+void QuicServer::setCryptoOffload(std::shared_ptr<CryptoOffload> offload) {
+  CHECK(!initialized_)
+      << " Crypto offload must be set before the server is initialized.";
+  cryptoOffload_ = std::move(offload);
+}
+
+void QuicServer::setCryptoWorkerPool(
+    std::shared_ptr<CryptoWorkerPool> workers) {
+  CHECK(!initialized_)
+      << " Crypto workers must be set before the server is initialized.";
+  cryptoWorkers_ = std::move(workers);
+}
+
+void QuicServer::setXdpSocketOptions(std::vector<XdpSocketOptions> options) {
+  CHECK(!initialized_)
+      << " AF_XDP sockets must be set before the server is initialized.";
+  xdpSocketOptions_ = std::move(options);
+}
+
 void QuicServer::setSupportedVersion(const std::vector<QuicVersion>& versions) {
   supportedVersions_ = versions;
 }
@@ -88,6 +185,13 @@ void QuicServer::start(const folly::SocketAddress& address, size_t maxWorkers) {
   for (size_t i = 0; i < numWorkers; ++i) {
     auto scopedEvb = std::make_unique<folly::ScopedEventBaseThread>();
     workerEvbs_.push_back(std::move(scopedEvb));
+    if (!workerCpus_.empty()) {
+      // Before anything else runs on the thread, so its allocations are local
+      workerEvbs_.back()->getEventBase()->runInEventBaseThreadAndWait(
+          [cpu = workerCpus_[i % workerCpus_.size()]] {
+            pinCurrentThreadToCpu(cpu);
+          });
+    }
     if (evbObserver_) {
       workerEvbs_.back()->getEventBase()->runInEventBaseThreadAndWait([&] {
         workerEvbs_.back()->getEventBase()->setObserver(evbObserver_);
@@ -162,11 +266,26 @@ void QuicServer::initializeWorkers(
     }
     worker->setConnectionIdAlgo(connIdAlgoFactory_->make());
     worker->setCongestionControllerFactory(ccFactory_);
+    worker->setCongestionStateCache(congestionStateCache_);
+    worker->setCryptoOffload(cryptoOffload_);
+    worker->setCryptoWorkerPool(cryptoWorkers_);
+    if (workers_.size() < xdpSocketOptions_.size()) {
+      worker->setXdpSocketOptions(xdpSocketOptions_[workers_.size()]);
+    }
     worker->setWorkerId(workers_.size());
     worker->setTransportSettingsOverrideFn(transportSettingsOverrideFn_);
+    worker->setTransportSettingsProfileFn(transportSettingsProfileFn_);
     workers_.push_back(std::move(worker));
     evbToWorkers_.emplace(workerEvb, workers_.back().get());
   }
+  if (transportSettings_.workerForwardingQueueSize) {
+    size_t numQueues = workers_.size() * workers_.size();
+    for (size_t i = 0; i < numQueues; ++i) {
+      // One slot of a ProducerConsumerQueue always stays empty.
+      forwardingQueues_.push_back(std::make_unique<ForwardingQueue>(
+          std::max<uint32_t>(transportSettings_.workerForwardingQueueSize, 2)));
+    }
+  }
 }
 
 std::unique_ptr<QuicServerWorker> QuicServer::newWorkerWithoutSocket() {
@@ -186,11 +305,16 @@ void QuicServer::bindWorkersToSocket(
   auto numWorkers = evbs.size();
   CHECK(!initialized_);
   boundAddress_ = address;
-  for (size_t i = 0; i < numWorkers; ++i) {
-    auto workerEvb = evbs[i];
+  // The first socket of every worker joins the reuseport group first, in
+  // worker id order, then the sockets of the other RX queues, so that the
+  // socket at index i of the group is the one of queue i.
+  auto numSockets = std::max(numWorkers, rxQueueCpus_.size());
+  for (size_t i = 0; i < numSockets; ++i) {
+    auto workerEvb = evbs[i % numWorkers];
     workerEvb->runInEventBaseThreadAndWait([self = this->shared_from_this(),
                                             workerEvb,
                                             numWorkers,
+                                            numSockets,
                                             processId = processId_,
                                             idx = i] {
       std::lock_guard<std::mutex> guard(self->startMutex_);
@@ -201,6 +325,19 @@ void QuicServer::bindWorkersToSocket(
       auto it = self->evbToWorkers_.find(workerEvb);
       CHECK(it != self->evbToWorkers_.end());
       auto worker = it->second;
+      if (idx >= numWorkers) {
+        worker->addSocket(std::move(workerSocket), self->boundAddress_);
+        int cpu = self->rxQueueCpus_[idx];
+        LOG_IF(ERROR, !worker->setIncomingCpu(cpu, worker->getNumSockets() - 1))
+            << "Failed to set SO_INCOMING_CPU=" << cpu
+            << " on workerId=" << (int)worker->getWorkerId();
+        if (idx == numSockets - 1) {
+          VLOG(4) << "Initialized all workers in the eventbase";
+          self->initialized_ = true;
+          self->startCv_.notify_all();
+        }
+        return;
+      }
       int takeoverOverFd = -1;
       if (self->listeningFDs_.size() > idx) {
         takeoverOverFd = self->listeningFDs_[idx];
@@ -231,7 +368,24 @@ void QuicServer::bindWorkersToSocket(
           self->boundAddress_ = worker->getAddress();
         }
       }
+      auto& cpus =
+          self->rxQueueCpus_.empty() ? self->workerCpus_ : self->rxQueueCpus_;
+      if (!cpus.empty()) {
+        int cpu = cpus[idx % cpus.size()];
+        LOG_IF(ERROR, !worker->setIncomingCpu(cpu))
+            << "Failed to set SO_INCOMING_CPU=" << cpu
+            << " on workerId=" << (int)worker->getWorkerId();
+      }
       if (idx == (numWorkers - 1)) {
+        // The program applies to the whole reuseport group, attach it once
+        // every worker has joined.
+        if (self->connectionIdSteering_ &&
+            !worker->attachConnectionIdSteering()) {
+          LOG(ERROR) << "Connection id steering unavailable, packets are "
+                     << "routed between workers in userspace";
+        }
+      }
+      if (idx == numSockets - 1) {
         VLOG(4) << "Initialized all workers in the eventbase";
         self->initialized_ = true;
         self->startCv_.notify_all();
@@ -378,6 +532,10 @@ void QuicServer::routeDataToWorker(
         isForwardedData);
     return;
   }
+  if (forwardToWorker(
+          workerToRunOn, client, routingData, networkData, isForwardedData)) {
+    return;
+  }
   worker->getEventBase()->runInEventBaseThread(
       [server = this->shared_from_this(),
        cl = client,
@@ -393,6 +551,57 @@ void QuicServer::routeDataToWorker(
       });
 }
 
+bool QuicServer::forwardToWorker(
+    size_t dest,
+    const folly::SocketAddress& client,
+    RoutingData& routingData,
+    NetworkData& networkData,
+    bool isForwardedData) {
+  if (forwardingQueues_.empty() || !workerPtr_) {
+    return false;
+  }
+  auto& queue =
+      *forwardingQueues_[workerPtr_->getWorkerId() * workers_.size() + dest];
+  if (!queue.packets.write(
+          client,
+          std::move(routingData),
+          std::move(networkData),
+          isForwardedData)) {
+    // write() leaves the arguments alone when the queue is full.
+    return false;
+  }
+  // Pairs with the fence in drainForwardingQueue: either the drain that is
+  // scheduled sees this packet, or we schedule a new one.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!queue.drainScheduled.exchange(true)) {
+    auto worker = workers_[dest].get();
+    worker->getEventBase()->runInEventBaseThread(
+        [server = this->shared_from_this(), q = &queue, worker] {
+          server->drainForwardingQueue(*q, worker);
+        });
+  }
+  return true;
+}
+
+void QuicServer::drainForwardingQueue(
+    ForwardingQueue& queue,
+    QuicServerWorker* worker) {
+  // Clear the flag before reading, so that a packet written after the last
+  // read schedules another drain.
+  queue.drainScheduled = false;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (auto packet = queue.packets.frontPtr()) {
+    if (!shutdown_) {
+      worker->dispatchPacketData(
+          packet->client,
+          std::move(packet->routingData),
+          std::move(packet->networkData),
+          packet->isForwardedData);
+    }
+    queue.packets.popFront();
+  }
+}
+
 void QuicServer::handleWorkerError(LocalErrorCode error) {
   shutdown(error);
 }
@@ -479,6 +688,23 @@ void QuicServer::setHostId(uint16_t hostId) noexcept {
   hostId_ = hostId;
 }
 
+void QuicServer::setWorkerCpus(std::vector<int> cpus) {
+  CHECK(!initialized_) << "Worker cpus must be set before starting Quic server";
+  workerCpus_ = std::move(cpus);
+}
+
+void QuicServer::setRxQueueCpus(std::vector<int> cpus) {
+  CHECK(!initialized_)
+      << "RX queue cpus must be set before starting Quic server";
+  rxQueueCpus_ = std::move(cpus);
+}
+
+void QuicServer::setConnectionIdSteering(bool enabled) noexcept {
+  CHECK(!initialized_)
+      << "Connection id steering must be set before initializing Quic server";
+  connectionIdSteering_ = enabled;
+}
+
 void QuicServer::setTransportSettingsOverrideFn(
     TransportSettingsOverrideFn fn) {
   CHECK(!initialized_) << "Transport settings override function must be"
@@ -486,6 +712,12 @@ void QuicServer::setTransportSettingsOverrideFn(
   transportSettingsOverrideFn_ = std::move(fn);
 }
 
+void QuicServer::setTransportSettingsProfileFn(TransportSettingsProfileFn fn) {
+  CHECK(!initialized_) << "Transport settings profile function must be "
+                       << "set before initializing Quic server";
+  transportSettingsProfileFn_ = std::move(fn);
+}
+
 void QuicServer::setHealthCheckToken(const std::string& healthCheckToken) {
   // Make sure the token satisfies the required properties, i.e. it is not a
   // valid quic header.
@@ -551,9 +783,8 @@ void QuicServer::setEventBaseObserver(
   }
   workerEvbs_.front()->getEventBase()->runInEventBaseThreadAndWait(
       [&] { evbObserver_ = observer; });
-  runOnAllWorkers([observer](auto worker) {
-    worker->getEventBase()->setObserver(observer);
-  });
+  runOnAllWorkers(
+      [observer](auto worker) { worker->setEventBaseObserver(observer); });
 };
 
 void QuicServer::startPacketForwarding(const folly::SocketAddress& destAddr) {
@@ -586,6 +817,87 @@ void QuicServer::stopPacketForwarding(std::chrono::milliseconds delay) {
   }
 }
 
+size_t QuicServer::handOffConnections(int fd) {
+  std::vector<Buf> states;
+  runOnAllWorkersSync([&states](auto worker) mutable {
+    for (auto& state : worker->handOffConnections()) {
+      states.push_back(std::move(state));
+    }
+  });
+  size_t handedOff = 0;
+  for (auto& state : states) {
+    if (!writeConnectionHandoffRecord(fd, state.get())) {
+      LOG(ERROR) << "Failed to hand off connections, handedOff=" << handedOff
+                 << " of " << states.size() << " errno=" << errno;
+      return handedOff;
+    }
+    handedOff++;
+  }
+  if (!writeConnectionHandoffRecord(fd, nullptr)) {
+    LOG(ERROR) << "Failed to finish handing off connections, errno=" << errno;
+  }
+  VLOG(4) << "Handed off connections=" << handedOff;
+  return handedOff;
+}
+
+size_t QuicServer::acceptHandedOffConnections(int fd) {
+  CHECK(initialized_);
+  size_t accepted = 0;
+  Buf buf;
+  while (true) {
+    if (!readConnectionHandoffRecord(fd, buf)) {
+      LOG(ERROR) << "Failed to read handed off connections, accepted="
+                 << accepted << " errno=" << errno;
+      break;
+    }
+    if (!buf) {
+      break;
+    }
+    auto state = decodeConnectionHandoffState(*buf);
+    if (!state || !state->serverConnectionId ||
+        !connIdAlgo_->canParse(*state->serverConnectionId)) {
+      LOG(ERROR) << "Dropping handed off connection with a bad state";
+      continue;
+    }
+    std::lock_guard<std::mutex> guard(startMutex_);
+    if (shutdown_) {
+      break;
+    }
+    auto worker = workers_[getWorkerToRouteTo(
+                               *state->serverConnectionId,
+                               workers_.size(),
+                               connIdAlgo_.get())]
+                      .get();
+    // Packets using the other connection ids of the connection are routed
+    // to the workers their ids name, which hand them on.
+    QuicServerWorker::MigratedConnectionIds forwardedConnectionIds;
+    for (auto& connIdData : state->selfConnectionIds) {
+      if (!connIdAlgo_->canParse(connIdData.connId)) {
+        continue;
+      }
+      auto routedTo = workers_[getWorkerToRouteTo(
+                                   connIdData.connId,
+                                   workers_.size(),
+                                   connIdAlgo_.get())]
+                          .get();
+      if (routedTo != worker) {
+        forwardedConnectionIds.emplace_back(
+            connIdData.connId, std::vector<QuicServerWorker*>{routedTo});
+      }
+    }
+    bool acceptedConnection = false;
+    worker->getEventBase()->runInEventBaseThreadAndWait([&] {
+      acceptedConnection = worker->acceptHandedOffConnection(
+          *state, std::move(forwardedConnectionIds));
+    });
+    if (acceptedConnection) {
+      accepted++;
+    }
+  }
+  VLOG(4) << "Accepted handed off connections=" << accepted;
+  return accepted;
+}
+
 void QuicServer::setTransportStatsCallbackFactory(
     std::unique_ptr<QuicTransportStatsCallbackFactory> statsFactory) {
   CHECK(statsFactory);
@@ -667,4 +979,54 @@ std::vector<folly::EventBase*> QuicServer::getWorkerEvbs() const noexcept {
   return ebvs;
 }
 
+QuicTransportStatsCounters::Snapshot QuicServer::getStatsCountersSnapshot()
+    const {
+  CHECK(initialized_) << "Quic server is not initialized. ";
+  QuicTransportStatsCounters::Snapshot total{};
+  for (const auto& worker : workers_) {
+    auto snapshot = worker->getStatsCountersSnapshot();
+    for (auto counter : total.keys()) {
+      total[counter] += snapshot[counter];
+    }
+  }
+  return total;
+}
+
+QuicServer::ConnectionSnapshotPage QuicServer::getConnectionSnapshots(
+    const ConnectionSnapshotFilter& filter,
+    size_t offset,
+    size_t limit) {
+  ConnectionSnapshotPage page;
+  std::lock_guard<std::mutex> guard(startMutex_);
+  if (shutdown_) {
+    return page;
+  }
+  size_t skipped = 0;
+  std::vector<ConnectionSnapshot> snapshots;
+  for (auto& worker : workers_) {
+    std::vector<const QuicServerTransport*> transports;
+    worker->getEventBase()->runInEventBaseThreadAndWait(
+        [&] { transports = worker->getServerTransports(); });
+    for (size_t i = 0; i < transports.size();
+         i += kConnectionSnapshotBatchSize) {
+      folly::Range<const QuicServerTransport* const*> batch =
+          folly::range(transports).subpiece(i, kConnectionSnapshotBatchSize);
+      snapshots.clear();
+      worker->getEventBase()->runInEventBaseThreadAndWait(
+          [&] { worker->snapshotConnections(batch, filter, snapshots); });
+      for (auto& snapshot : snapshots) {
+        if (skipped < offset) {
+          skipped++;
+        } else if (page.snapshots.size() < limit) {
+          page.snapshots.push_back(std::move(snapshot));
+        } else {
+          page.more = true;
+          return page;
+        }
+      }
+    }
+  }
+  return page;
+}
+
 } // namespace quic
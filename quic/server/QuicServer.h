@@ -8,10 +8,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <limits>
 #include <memory>
 #include <vector>
 
+#include <folly/ProducerConsumerQueue.h>
 #include <folly/ThreadLocal.h>
 #include <folly/container/F14Map.h>
 #include <folly/io/SocketOptionMap.h>
@@ -34,6 +37,8 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
       std::function<folly::Optional<quic::TransportSettings>(
           const quic::TransportSettings&,
           const folly::IPAddress&)>;
+  using TransportSettingsProfileFn =
+      QuicServerWorker::TransportSettingsProfileFn;
 
   static std::shared_ptr<QuicServer> createQuicServer() {
     return std::shared_ptr<QuicServer>(new QuicServer());
@@ -68,6 +73,13 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
    */
   void setTransportSettingsOverrideFn(TransportSettingsOverrideFn fn);
 
+  /*
+   * Take in a function to pick, given the client address, one of a few
+   * shared settings profiles for a new connection. See
+   * QuicServerWorker::TransportSettingsProfileFn.
+   */
+  void setTransportSettingsProfileFn(TransportSettingsProfileFn fn);
+
   /*
    * Transport factory to create server-transport.
    * QuicServer calls 'make()' on the supplied transport factory for *each* new
@@ -99,6 +111,37 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> ccFactory);
 
+  /**
+   * Set the cache connections warm start from, of the congestion state
+   * earlier connections from the same client subnet left. Shared by all the
+   * workers. This must be set before the server is started.
+   */
+  void setCongestionStateCache(std::shared_ptr<CongestionStateCache> cache);
+
+  /**
+   * Set the device that seals the 1-RTT packets, e.g. a NIC with inline QUIC
+   * crypto, see CryptoOffload. Each worker probes its socket for it and seals
+   * in software if it's not supported. This must be set before the server is
+   * started.
+   */
+  void setCryptoOffload(std::shared_ptr<CryptoOffload> offload);
+
+  /**
+   * Set the helper threads the connections of all the workers seal their
+   * 1-RTT packets on besides the worker's, so that a single busy connection
+   * can use more than one core. This must be set before the server is
+   * started.
+   */
+  void setCryptoWorkerPool(std::shared_ptr<CryptoWorkerPool> workers);
+
+  /**
+   * Set the NIC queues the workers read from and write to through AF_XDP
+   * sockets, see XdpSocket, one for each worker in the order of their event
+   * bases. The workers without one, or whose socket can't be set up, only use
+   * their UDP socket. This must be set before the server is started.
+   */
+  void setXdpSocketOptions(std::vector<XdpSocketOptions> options);
+
   /**
    * Set list of supported QUICVersion for this server. These versions will be
    * used during the 'Version-Negotiation' phase with the client.
@@ -148,6 +191,36 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
    */
   void setHostId(uint16_t hostId) noexcept;
 
+  /**
+   * CPUs to pin the worker threads created by start(address, maxWorkers) to:
+   * worker i runs on cpus[i % cpus.size()]. Worker state is allocated from
+   * the worker thread, so it also ends up on the NUMA node of that CPU. Every
+   * worker socket also gets SO_INCOMING_CPU set to its CPU, so that with
+   * SO_REUSEPORT the packets of an RX queue handled on that CPU go to its
+   * worker. Must be called before start(..)
+   */
+  void setWorkerCpus(std::vector<int> cpus);
+
+  /**
+   * CPUs the RX queues of the NIC are handled on, one per queue, for NICs
+   * with more queues than workers. Worker i serves the queues i, i +
+   * numWorkers, ... with one SO_REUSEPORT listening socket each, which gets
+   * SO_INCOMING_CPU set to the CPU of its queue in place of the worker's CPU,
+   * so that the packets of a queue go to its socket instead of contending on
+   * the receive queue of one socket per worker, see
+   * QuicServerWorker::addSocket. The first socket of worker i is the one of
+   * queue i. Must be called before start(..)
+   */
+  void setRxQueueCpus(std::vector<int> cpus);
+
+  /**
+   * Steer short header packets in the kernel to the worker whose id is in
+   * their connection id, see QuicServerWorker::attachConnectionIdSteering.
+   * Only useful with a SO_REUSEPORT listener socket factory and the
+   * DefaultConnectionIdAlgo. Must be called before initialize(..)
+   */
+  void setConnectionIdSteering(bool enabled) noexcept;
+
   /**
    * Get transport settings.
    */
@@ -285,6 +358,26 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
 
   TakeoverProtocolVersion getTakeoverProtocolVersion() const noexcept;
 
+  /**
+   * Hands the connections that can carry on in the process taking over this
+   * server to it, on the given connected unix stream socket, in place of
+   * forwarding their packets to this server until they close. See
+   * QuicServerTransport::exportHandoffState for the connections that can,
+   * the others are still served here through packet forwarding.
+   * Blocks until the states are written, returns the number of connections
+   * handed off. This method cannot be called on a worker's thread.
+   */
+  size_t handOffConnections(int fd);
+
+  /**
+   * Picks up the connections the server being taken over hands off on the
+   * given connected unix stream socket, see handOffConnections. Must be
+   * called after start(), with packet forwarding to the old server started.
+   * Blocks until the other server is done, returns the number of connections
+   * accepted. This method cannot be called on a worker's thread.
+   */
+  size_t acceptHandedOffConnections(int fd);
+
   /**
    * Factory to create per worker callback for various transport stats (such as
    * packet received, dropped etc). QuicServer calls 'make' during the
@@ -314,6 +407,36 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
    */
   std::vector<folly::EventBase*> getWorkerEvbs() const noexcept;
 
+  /**
+   * What the stats counters of all the workers counted so far, see
+   * TransportSettings::useStatsCounters. The workers keep counting while it
+   * is taken, so the sum is not a consistent cut across them.
+   */
+  QuicTransportStatsCounters::Snapshot getStatsCountersSnapshot() const;
+
+  struct ConnectionSnapshotPage {
+    std::vector<ConnectionSnapshot> snapshots;
+    // whether there are more connections that pass the filter after the page
+    bool more{false};
+  };
+
+  /**
+   * Snapshots of the live connections of all the workers that pass the
+   * filter, skipping the first offset of them and up to limit after. For
+   * finding the connections that hold the most memory or cwnd during an
+   * incident.
+   *
+   * The workers are visited in order and snapshot kConnectionSnapshotBatchSize
+   * connections at a time, going back to their loop in between, so none of
+   * them is held up for long however many connections it has. Connections
+   * come and go meanwhile, so pages of different calls can overlap or miss
+   * some. Must not be called from a worker's thread.
+   */
+  ConnectionSnapshotPage getConnectionSnapshots(
+      const ConnectionSnapshotFilter& filter = ConnectionSnapshotFilter(),
+      size_t offset = 0,
+      size_t limit = std::numeric_limits<size_t>::max());
+
  private:
   QuicServer();
 
@@ -334,6 +457,44 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
       const folly::SocketAddress& address,
       const std::vector<folly::EventBase*>& evbs);
 
+  // A packet handed from the worker that read it to the one that owns it.
+  struct ForwardedPacket {
+    ForwardedPacket(
+        const folly::SocketAddress& clientIn,
+        RoutingData&& routingDataIn,
+        NetworkData&& networkDataIn,
+        bool isForwardedDataIn)
+        : client(clientIn),
+          routingData(std::move(routingDataIn)),
+          networkData(std::move(networkDataIn)),
+          isForwardedData(isForwardedDataIn) {}
+
+    folly::SocketAddress client;
+    RoutingData routingData;
+    NetworkData networkData;
+    bool isForwardedData;
+  };
+
+  struct ForwardingQueue {
+    explicit ForwardingQueue(uint32_t size) : packets(size) {}
+
+    folly::ProducerConsumerQueue<ForwardedPacket> packets;
+    // Set while a drain of the queue is scheduled on the destination worker,
+    // so a burst of packets costs a single callback.
+    std::atomic<bool> drainScheduled{false};
+  };
+
+  // Returns false if the queue from the current worker to dest is missing or
+  // full, the caller then hands the packet over in a callback of its own.
+  bool forwardToWorker(
+      size_t dest,
+      const folly::SocketAddress& client,
+      RoutingData& routingData,
+      NetworkData& networkData,
+      bool isForwardedData);
+
+  void drainForwardingQueue(ForwardingQueue& queue, QuicServerWorker* worker);
+
   std::vector<QuicVersion> supportedVersions_{
       {QuicVersion::MVFST, QuicVersion::MVFST_OLD, QuicVersion::QUIC_DRAFT}};
   std::atomic<bool> shutdown_{true};
@@ -352,6 +513,9 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   // their destruction
   folly::ThreadLocalPtr<QuicServerWorker> workerPtr_;
   folly::F14FastMap<folly::EventBase*, QuicServerWorker*> evbToWorkers_;
+  // The queue packets take from worker i to worker j is at
+  // i * workers_.size() + j. Empty unless workerForwardingQueueSize is set.
+  std::vector<std::unique_ptr<ForwardingQueue>> forwardingQueues_;
   std::unique_ptr<QuicServerTransportFactory> transportFactory_;
   folly::F14FastMap<folly::EventBase*, QuicServerTransportFactory*>
       evbToAcceptors_;
@@ -361,6 +525,10 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   std::unique_ptr<QuicUDPSocketFactory> socketFactory_;
   // factory used to create specific instance of Congestion control algorithm
   std::shared_ptr<CongestionControllerFactory> ccFactory_;
+  std::shared_ptr<CongestionStateCache> congestionStateCache_;
+  std::shared_ptr<CryptoOffload> cryptoOffload_;
+  std::shared_ptr<CryptoWorkerPool> cryptoWorkers_;
+  std::vector<XdpSocketOptions> xdpSocketOptions_;
 
   std::shared_ptr<folly::EventBaseObserver> evbObserver_;
   folly::Optional<std::string> healthCheckToken_;
@@ -369,6 +537,9 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   ProcessId processId_{ProcessId::ZERO};
   uint16_t hostId_{0};
   bool rejectNewConnections_{false};
+  bool connectionIdSteering_{false};
+  std::vector<int> workerCpus_;
+  std::vector<int> rxQueueCpus_;
   // factory to create per worker QuicTransportStatsCallback
   std::unique_ptr<QuicTransportStatsCallbackFactory> transportStatsFactory_;
   // factory to create per worker ConnectionIdAlgo
@@ -377,6 +548,7 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   std::unique_ptr<ConnectionIdAlgo> connIdAlgo_;
   // Used to override certain transport parameters, given the client address
   TransportSettingsOverrideFn transportSettingsOverrideFn_;
+  TransportSettingsProfileFn transportSettingsProfileFn_;
   // address that the server is bound to
   folly::SocketAddress boundAddress_;
   folly::SocketOptionMap socketOptions_;
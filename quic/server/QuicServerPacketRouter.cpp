@@ -13,6 +13,12 @@
 #include <quic/server/QuicServerPacketRouter.h>
 #include <quic/server/QuicServerWorker.h>
 
+#ifndef MSG_WAITFORONE
+#define RECVMMSG_FLAGS 0
+#else
+#define RECVMMSG_FLAGS MSG_WAITFORONE
+#endif
+
 namespace quic {
 
 /* Set max for the allocation of buffer to extract TakeoverProtocol related
@@ -103,6 +109,74 @@ void TakeoverHandlerCallback::onDataAvailable(
   takeoverPktHandler_.processForwardedPacket(client, std::move(data));
 }
 
+bool TakeoverHandlerCallback::shouldOnlyNotify() {
+  return transportSettings_.shouldRecvBatch &&
+      transportSettings_.shouldUseRecvmmsgForBatchRecv;
+}
+
+void TakeoverHandlerCallback::onNotifyDataAvailable(
+    folly::AsyncUDPSocket& sock) noexcept {
+  const size_t readBufferSize = transportSettings_.maxRecvPacketSize +
+      kMaxBufSizeForTakeoverEncapsulation;
+  const size_t numPackets = transportSettings_.maxRecvBatchSize;
+  recvmmsgStorage_.resize(numPackets);
+  recvmmsgStorage_.prepareReadBuffers(readBufferSize);
+
+  auto& msgs = recvmmsgStorage_.msgs;
+  auto& addrs = recvmmsgStorage_.addrs;
+  auto& readBuffers = recvmmsgStorage_.readBuffers;
+  auto& iovecs = recvmmsgStorage_.iovecs;
+
+  for (size_t i = 0; i < numPackets; ++i) {
+    auto* rawAddr = reinterpret_cast<sockaddr*>(&addrs[i]);
+    rawAddr->sa_family = sock.address().getFamily();
+
+    struct msghdr* msg = &msgs[i].msg_hdr;
+    msg->msg_name = rawAddr;
+    msg->msg_namelen = sizeof(struct sockaddr_storage);
+    msg->msg_iov = &iovecs[i];
+    msg->msg_iovlen = 1;
+    msg->msg_control = nullptr;
+    msg->msg_controllen = 0;
+  }
+
+  int numMsgsRecvd =
+      sock.recvmmsg(msgs.data(), numPackets, RECVMMSG_FLAGS, nullptr);
+  if (numMsgsRecvd < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      // Exit, socket will notify us again when socket is readable.
+      return;
+    }
+    return onReadError(folly::AsyncSocketException(
+        folly::AsyncSocketException::INTERNAL_ERROR,
+        "::recvmmsg() failed",
+        errno));
+  }
+  VLOG(10) << "Worker=" << this << " Received " << numMsgsRecvd
+           << " (takeover) packets on thread=" << folly::getCurrentThreadID()
+           << ", workerId=" << static_cast<uint32_t>(worker_->getWorkerId())
+           << ", processId=" << static_cast<uint32_t>(worker_->getProcessId());
+  for (int i = 0; i < numMsgsRecvd; ++i) {
+    QUIC_STATS(worker_->getInfoCallback(), onForwardedPacketReceived);
+    if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      // This is an error, drop the packet.
+      continue;
+    }
+    folly::SocketAddress client;
+    try {
+      client.setFromSockaddr(
+          reinterpret_cast<sockaddr*>(&addrs[i]), msgs[i].msg_hdr.msg_namelen);
+    } catch (const std::exception& ex) {
+      VLOG(4) << "Dropping forwarded packet with invalid source address "
+              << ex.what();
+      continue;
+    }
+    Buf data = std::move(readBuffers[i]);
+    data->append(msgs[i].msg_len);
+    takeoverPktHandler_.processForwardedPacket(client, std::move(data));
+  }
+}
+
 void TakeoverHandlerCallback::onReadError(
     const folly::AsyncSocketException& ex) noexcept {
   folly::DelayedDestruction::DestructorGuard dg(this);
@@ -127,6 +201,14 @@ void TakeoverPacketHandler::setDestination(
   packetForwardingEnabled_ = true;
 }
 
+void TakeoverPacketHandler::setBatchSize(size_t maxBatchSize) {
+  if (maxBatchSize_ != maxBatchSize && batchWriter_) {
+    batchWriter_->flush();
+    batchWriter_.reset();
+  }
+  maxBatchSize_ = maxBatchSize;
+}
+
 void TakeoverPacketHandler::forwardPacketToAnotherServer(
     const folly::SocketAddress& peerAddress,
     Buf data,
@@ -167,7 +249,19 @@ void TakeoverPacketHandler::forwardPacket(Buf writeBuffer) {
     localAddress.setFromHostPort("::1", 0);
     pktForwardingSocket_->bind(localAddress);
   }
-  pktForwardingSocket_->write(pktForwardDestAddr_, std::move(writeBuffer));
+  if (maxBatchSize_ <= 1) {
+    pktForwardingSocket_->write(pktForwardDestAddr_, std::move(writeBuffer));
+    return;
+  }
+  if (!batchWriter_) {
+    batchWriter_ = std::make_unique<MultiDestBatchWriter>(
+        worker_->getEventBase(), maxBatchSize_);
+  }
+  // the writer flushes at the end of the loop, or once maxBatchSize_ packets
+  // are queued
+  auto len = writeBuffer->computeChainDataLength();
+  batchWriter_->add(
+      *pktForwardingSocket_, pktForwardDestAddr_, std::move(writeBuffer), len);
 }
 
 std::unique_ptr<folly::AsyncUDPSocket> TakeoverPacketHandler::makeSocket(
@@ -250,6 +344,11 @@ void TakeoverPacketHandler::processForwardedPacket(
 
 void TakeoverPacketHandler::stop() {
   packetForwardingEnabled_ = false;
+  if (batchWriter_) {
+    // the pending packets are written through the socket, before it goes
+    batchWriter_->flush();
+    batchWriter_.reset();
+  }
   pktForwardingSocket_.reset();
 }
 } // namespace quic
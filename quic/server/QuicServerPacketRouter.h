@@ -11,6 +11,7 @@
 #include <folly/io/async/AsyncUDPSocket.h>
 
 #include <quic/QuicConstants.h>
+#include <quic/api/QuicBatchWriter.h>
 #include <quic/codec/ConnectionIdAlgo.h>
 #include <quic/server/QuicServerTransportFactory.h>
 #include <quic/server/QuicUDPSocketFactory.h>
@@ -45,6 +46,10 @@ struct RoutingData {
   // Source connection may not be present for short header packets.
   folly::Optional<ConnectionId> sourceConnId;
 
+  // Index of the listening socket of the worker that read the packet, see
+  // QuicServerWorker::addSocket.
+  size_t socketIndex{0};
+
   RoutingData(
       HeaderForm headerFormIn,
       bool isInitialIn,
@@ -74,6 +79,12 @@ class TakeoverPacketHandler {
 
   void setDestination(const folly::SocketAddress& destAddr);
 
+  /**
+   * Forwarded packets are written together, up to maxBatchSize per
+   * sendmmsg, at the end of the loop. 0 writes each one right away.
+   */
+  void setBatchSize(size_t maxBatchSize);
+
   void forwardPacketToAnotherServer(
       const folly::SocketAddress& peerAddress,
       Buf data,
@@ -99,6 +110,9 @@ class TakeoverPacketHandler {
   QuicServerWorker* worker_;
   folly::SocketAddress pktForwardDestAddr_;
   std::unique_ptr<folly::AsyncUDPSocket> pktForwardingSocket_;
+  size_t maxBatchSize_{0};
+  // only made once a packet is forwarded with a batch size
+  std::unique_ptr<MultiDestBatchWriter> batchWriter_;
   bool packetForwardingEnabled_{false};
   QuicUDPSocketFactory* socketFactory_{nullptr};
 };
@@ -140,6 +154,12 @@ class TakeoverHandlerCallback : public folly::AsyncUDPSocket::ReadCallback,
   // AsyncUDPSocket ReadCallback methods
   void getReadBuffer(void** buf, size_t* len) noexcept override;
 
+  // The forwarded packets are read with recvmmsg when the worker reads its
+  // own that way.
+  bool shouldOnlyNotify() override;
+
+  void onNotifyDataAvailable(folly::AsyncUDPSocket& sock) noexcept override;
+
   void onDataAvailable(
       const folly::SocketAddress& client,
       size_t len,
@@ -158,5 +178,6 @@ class TakeoverHandlerCallback : public folly::AsyncUDPSocket::ReadCallback,
   folly::SocketAddress address_;
   std::unique_ptr<folly::AsyncUDPSocket> socket_;
   Buf readBuffer_;
+  RecvmmsgStorage recvmmsgStorage_;
 };
 } // namespace quic
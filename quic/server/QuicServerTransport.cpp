@@ -8,6 +8,7 @@
 
 #include <quic/server/QuicServerTransport.h>
 
+#include <quic/common/RecycledBlocks.h>
 #include <quic/server/handshake/AppToken.h>
 #include <quic/server/handshake/DefaultAppTokenValidator.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
@@ -50,7 +51,10 @@ QuicServerTransport::Ptr QuicServerTransport::make(
     std::unique_ptr<folly::AsyncUDPSocket> sock,
     ConnectionCallback& cb,
     std::shared_ptr<const fizz::server::FizzServerContext> ctx) {
-  return std::make_shared<QuicServerTransport>(evb, std::move(sock), cb, ctx);
+  // The transport and its control block share one block, recycled from the
+  // transports destroyed on this thread.
+  return std::allocate_shared<QuicServerTransport>(
+      RecyclingAllocator<QuicServerTransport>(), evb, std::move(sock), cb, ctx);
 }
 
 void QuicServerTransport::setRoutingCallback(
@@ -78,6 +82,13 @@ void QuicServerTransport::setTransportInfoCallback(
   }
 }
 
+void QuicServerTransport::setTransportStatsCounters(
+    QuicTransportStatsCounters* statsCounters) noexcept {
+  if (conn_) {
+    conn_->statsCounters = statsCounters;
+  }
+}
+
 void QuicServerTransport::setConnectionIdAlgo(
     ConnectionIdAlgo* connIdAlgo) noexcept {
   CHECK(connIdAlgo);
@@ -86,6 +97,13 @@ void QuicServerTransport::setConnectionIdAlgo(
   }
 }
 
+void QuicServerTransport::setConnectionIdPool(
+    std::shared_ptr<ConnectionIdPool> connIdPool) noexcept {
+  if (serverConn_) {
+    serverConn_->connIdPool = std::move(connIdPool);
+  }
+}
+
 void QuicServerTransport::setCongestionControllerFactory(
     std::shared_ptr<CongestionControllerFactory> ccFactory) {
   CHECK(ccFactory);
@@ -128,6 +146,7 @@ void QuicServerTransport::accept() {
   setIdleTimer();
   updateFlowControlStateWithSettings(
       conn_->flowControlState, conn_->transportSettings);
+  maybeWarmStartCongestionControl();
   serverConn_->serverHandshakeLayer->initialize(
       evb_,
       ctx_,
@@ -194,9 +213,12 @@ void QuicServerTransport::writeData() {
     return;
   }
   uint64_t packetLimit =
-      (isConnectionPaced(*conn_)
+      (isConnectionPaced(*conn_) && !isConnectionPacedInKernel(*conn_)
            ? conn_->pacer->updateAndGetWriteBatchSize(Clock::now())
            : conn_->transportSettings.writeConnectionDataPacketsLimit);
+  if (conn_->writePacketLimit) {
+    packetLimit = std::min(packetLimit, *conn_->writePacketLimit);
+  }
   if (conn_->initialWriteCipher) {
     CryptoStreamScheduler initialScheduler(
         *conn_,
@@ -247,6 +269,8 @@ void QuicServerTransport::writeData() {
   }
   if (conn_->oneRttWriteCipher) {
     CHECK(conn_->oneRttWriteHeaderCipher);
+    maybeOffloadOneRttWriteCiphers(*conn_);
+    maybeParallelizeOneRttWriteCipher(*conn_);
     writeQuicDataToSocket(
         *socket_,
         *conn_,
@@ -282,6 +306,24 @@ void QuicServerTransport::unbindConnection() {
   }
 }
 
+bool QuicServerTransport::delegateDrain(
+    std::chrono::milliseconds drainPeriod) {
+  if (!conn_->transportSettings.compactDrainingConnections || !routingCb_ ||
+      !conn_->serverConnectionId) {
+    return false;
+  }
+  // A connection the peer closed only drains, nothing is sent back.
+  Buf closePacket = conn_->peerConnectionError
+      ? nullptr
+      : std::move(conn_->lastClosePacket);
+  return routingCb_->onConnectionDraining(
+      this,
+      conn_->peerAddress,
+      conn_->selfConnectionIds,
+      std::move(closePacket),
+      drainPeriod);
+}
+
 bool QuicServerTransport::hasWriteCipher() const {
   return conn_->oneRttWriteCipher != nullptr;
 }
@@ -302,6 +344,31 @@ void QuicServerTransport::setClientChosenDestConnectionId(
   conn_->clientChosenDestConnectionId.assign(clientChosenDestConnectionId);
 }
 
+void QuicServerTransport::setRetryOriginalDstConnId(
+    const ConnectionId& originalDstConnId) {
+  serverConn_->retryOriginalDstConnId = originalDstConnId;
+}
+
+void QuicServerTransport::setInitialCipherCache(
+    std::shared_ptr<InitialCipherCache> cache) {
+  serverConn_->initialCipherCache = std::move(cache);
+}
+
+void QuicServerTransport::setAppTokenCache(
+    std::shared_ptr<AppTokenCache> cache) {
+  serverConn_->appTokenCache = std::move(cache);
+}
+
+void QuicServerTransport::setTransportParametersCache(
+    std::shared_ptr<ServerTransportParametersCache> cache) {
+  serverConn_->transportParametersCache = std::move(cache);
+}
+
+void QuicServerTransport::setCryptoOffload(
+    std::shared_ptr<CryptoOffload> offload) {
+  conn_->cryptoOffload = std::move(offload);
+}
+
 void QuicServerTransport::onCryptoEventAvailable() noexcept {
   try {
     VLOG(10) << "onCryptoEventAvailable " << *this;
@@ -438,26 +505,102 @@ void QuicServerTransport::maybeIssueConnectionIds() {
     // needs to be able to search through all issued ids for routing.
     const uint64_t maximumIdsToIssue = std::min(
         conn_->peerActiveConnectionIdLimit, kDefaultActiveConnectionIdLimit);
+    // The ids are routed to the transport all at once, before the frames
+    // issuing them go out together.
+    std::vector<ConnectionIdData> newConnIds;
+    newConnIds.reserve(maximumIdsToIssue);
     for (size_t i = 0; i < maximumIdsToIssue; i++) {
       auto newConnIdData = serverConn_->createAndAddNewSelfConnId();
       if (!newConnIdData.has_value()) {
-        return;
+        break;
       }
-
-      CHECK(routingCb_);
-      routingCb_->onConnectionIdAvailable(
-          shared_from_this(), newConnIdData->connId);
-
-      NewConnectionIdFrame frame(
-          newConnIdData->sequenceNumber,
-          0,
-          newConnIdData->connId,
-          *newConnIdData->token);
-      sendSimpleFrame(*conn_, std::move(frame));
+      newConnIds.push_back(std::move(*newConnIdData));
+    }
+    if (newConnIds.empty()) {
+      return;
+    }
+    std::vector<ConnectionId> ids;
+    ids.reserve(newConnIds.size());
+    for (const auto& newConnIdData : newConnIds) {
+      ids.push_back(newConnIdData.connId);
+    }
+    CHECK(routingCb_);
+    routingCb_->onConnectionIdsAvailable(shared_from_this(), ids);
+    for (auto& newConnIdData : newConnIds) {
+      sendSimpleFrame(
+          *conn_,
+          NewConnectionIdFrame(
+              newConnIdData.sequenceNumber,
+              0,
+              newConnIdData.connId,
+              *newConnIdData.token));
     }
   }
 }
 
+bool QuicServerTransport::issueNewConnectionId() {
+  if (conn_->transportSettings.disableMigration) {
+    return false;
+  }
+  auto newConnIdData = serverConn_->createAndAddNewSelfConnId();
+  if (!newConnIdData.has_value()) {
+    return false;
+  }
+
+  CHECK(routingCb_);
+  routingCb_->onConnectionIdAvailable(
+      shared_from_this(), newConnIdData->connId);
+
+  NewConnectionIdFrame frame(
+      newConnIdData->sequenceNumber,
+      0,
+      newConnIdData->connId,
+      *newConnIdData->token);
+  sendSimpleFrame(*conn_, std::move(frame));
+  return true;
+}
+
+bool QuicServerTransport::isMigratable() const {
+  return closeState_ == CloseState::OPEN && notifiedConnIdBound_;
+}
+
+void QuicServerTransport::moveToEventBase(
+    folly::EventBase* evb,
+    std::unique_ptr<folly::AsyncUDPSocket> sock) {
+  attachEventBase(evb);
+  // Nothing is written before the loop runs the write looper.
+  socket_ = std::move(sock);
+}
+
+folly::Optional<ConnectionHandoffState>
+QuicServerTransport::exportHandoffState() {
+  if (!isMigratable() || conn_->streamManager->streamCount() > 0 ||
+      !conn_->outstandingPackets.empty() ||
+      conn_->pendingEvents.closeTransport) {
+    return folly::none;
+  }
+  return makeConnectionHandoffState(*serverConn_);
+}
+
+void QuicServerTransport::acceptHandedOff(const ConnectionHandoffState& state) {
+  updateFlowControlStateWithSettings(
+      conn_->flowControlState, conn_->transportSettings);
+  serverConn_->serverHandshakeLayer->initialize(
+      evb_,
+      ctx_,
+      this,
+      std::make_unique<DefaultAppTokenValidator>(
+          serverConn_, std::move(earlyDataAppParamsValidator_)));
+  applyConnectionHandoffState(*serverConn_, state);
+  // The peer got its ticket and connection ids from the other process.
+  notifiedRouting_ = true;
+  notifiedConnIdBound_ = true;
+  newSessionTicketWritten_ = true;
+  connectionIdsIssued_ = true;
+  setIdleTimer();
+  maybeNotifyTransportReady();
+}
+
 void QuicServerTransport::maybeNotifyTransportReady() {
   if (!transportReadyNotified_ && connCallback_ && hasWriteCipher()) {
     if (conn_->qLogger) {
@@ -13,6 +13,7 @@
 #include <quic/codec/ConnectionIdAlgo.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/server/handshake/ServerTransportParametersExtension.h>
+#include <quic/server/state/ConnectionHandoff.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 
@@ -35,6 +36,16 @@ class QuicServerTransport
         Ptr transport,
         ConnectionId id) noexcept = 0;
 
+    // Called with the connection ids issued together, by default one at a
+    // time through onConnectionIdAvailable.
+    virtual void onConnectionIdsAvailable(
+        Ptr transport,
+        const std::vector<ConnectionId>& ids) noexcept {
+      for (const auto& id : ids) {
+        onConnectionIdAvailable(transport, id);
+      }
+    }
+
     // Called when a connecton id is bound and ip address should not
     // be used any more for routing.
     virtual void onConnectionIdBound(Ptr transport) noexcept = 0;
@@ -44,6 +55,17 @@ class QuicServerTransport
         QuicServerTransport* transport,
         const SourceIdentity& address,
         const std::vector<ConnectionIdData>& connectionIdData) noexcept = 0;
+
+    // Called when the connection closed and is about to drain for
+    // drainPeriod. Returns true if the callback takes over answering the
+    // peer with closePacket, null if nothing is to be sent back, so that the
+    // transport can be unbound right away.
+    virtual bool onConnectionDraining(
+        QuicServerTransport* transport,
+        const folly::SocketAddress& peerAddress,
+        const std::vector<ConnectionIdData>& connectionIdData,
+        Buf closePacket,
+        std::chrono::milliseconds drainPeriod) noexcept = 0;
   };
 
   static QuicServerTransport::Ptr make(
@@ -74,12 +96,26 @@ class QuicServerTransport
   virtual void setTransportInfoCallback(
       QuicTransportStatsCallback* infoCallback) noexcept;
 
+  /**
+   * Set the counters the per packet stats events are counted in instead of
+   * being reported to the info callback one by one.
+   */
+  virtual void setTransportStatsCounters(
+      QuicTransportStatsCounters* statsCounters) noexcept;
+
   /**
    * Set ConnectionIdAlgo implementation to encode and decode ConnectionId with
    * various info, such as routing related info.
    */
   virtual void setConnectionIdAlgo(ConnectionIdAlgo* connIdAlgo) noexcept;
 
+  /**
+   * Set the pool, owned by the worker, to take the server chosen connection
+   * ids and their stateless reset tokens from. nullptr makes each anew.
+   */
+  void setConnectionIdPool(
+      std::shared_ptr<ConnectionIdPool> connIdPool) noexcept;
+
   /**
    * Set factory to create specific congestion controller instances
    * for a given connection
@@ -92,6 +128,35 @@ class QuicServerTransport
 
   void setClientChosenDestConnectionId(const ConnectionId& serverCid);
 
+  /**
+   * The destination connection id of the client's first Initial, for a
+   * client that came back with a valid Retry token.
+   */
+  void setRetryOriginalDstConnId(const ConnectionId& originalDstConnId);
+
+  /**
+   * Set the cache of Initial ciphers shared by the connections of a worker.
+   */
+  void setInitialCipherCache(std::shared_ptr<InitialCipherCache> cache);
+
+  /**
+   * Set the cache of decoded app tokens shared by the connections of a worker.
+   */
+  void setAppTokenCache(std::shared_ptr<AppTokenCache> cache);
+
+  /**
+   * Set the cache of encoded transport parameters shared by the connections
+   * of a worker.
+   */
+  void setTransportParametersCache(
+      std::shared_ptr<ServerTransportParametersCache> cache);
+
+  /**
+   * Set the device that seals the 1-RTT packets, once the worker probed its
+   * socket for it.
+   */
+  void setCryptoOffload(std::shared_ptr<CryptoOffload> offload);
+
   // From QuicTransportBase
   void onReadData(
       const folly::SocketAddress& peer,
@@ -99,6 +164,7 @@ class QuicServerTransport
   void writeData() override;
   void closeTransport() override;
   void unbindConnection() override;
+  bool delegateDrain(std::chrono::milliseconds drainPeriod) override;
   bool hasWriteCipher() const override;
   std::shared_ptr<QuicTransportBase> sharedGuard() override;
 
@@ -108,6 +174,44 @@ class QuicServerTransport
 
   virtual void accept();
 
+  /**
+   * Whether the connection can move to another worker, i.e. it is bound to
+   * its connection ids and not closing.
+   */
+  virtual bool isMigratable() const;
+
+  /**
+   * Moves the transport, detached from its evb, onto the given evb and the
+   * socket made for it there, e.g. when the connection moves to another
+   * worker.
+   */
+  virtual void moveToEventBase(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> sock);
+
+  /**
+   * Issues the peer a connection id made from the current server connection
+   * id params, e.g. to have its packets routed to the worker the connection
+   * moved to. Returns false if the peer's active connection id limit leaves
+   * no room for one, or if migration is disabled.
+   */
+  virtual bool issueNewConnectionId();
+
+  /**
+   * The state another process needs to carry on the connection, see
+   * acceptHandedOff. None unless the connection is established, not closing,
+   * and has no open streams nor packets in flight.
+   */
+  virtual folly::Optional<ConnectionHandoffState> exportHandoffState();
+
+  /**
+   * Accepts a connection handed off by another process, from the state it
+   * exported, in place of accept(). The connection is established right
+   * away, with the connection ids it had. Throws if the state can't be taken
+   * up, e.g. since its cipher is not supported.
+   */
+  virtual void acceptHandedOff(const ConnectionHandoffState& state);
+
  protected:
   // From ServerHandshake::HandshakeCallback
   virtual void onCryptoEventAvailable() noexcept override;
@@ -10,12 +10,27 @@
 #include <folly/io/SocketOptionMap.h>
 #include <folly/system/ThreadId.h>
 #include <quic/QuicConstants.h>
+#include <quic/common/BufUtil.h>
+#include <quic/common/PipelineTiming.h>
 #include <quic/common/SocketUtil.h>
+#include <quic/codec/Decode.h>
+#include <quic/codec/QuicPacketBuilder.h>
 #include <quic/common/Timers.h>
 
 #include <quic/server/QuicServerWorker.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
 
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+#include <linux/filter.h>
+#define QUIC_HAVE_REUSEPORT_CBPF 1
+#endif
+
+#ifndef MSG_WAITFORONE
+#define RECVMMSG_FLAGS 0
+#else
+#define RECVMMSG_FLAGS MSG_WAITFORONE
+#endif
+
 namespace quic {
 
 QuicServerWorker::QuicServerWorker(
@@ -35,22 +50,50 @@ void QuicServerWorker::setSocket(
 void QuicServerWorker::bind(const folly::SocketAddress& address) {
   DCHECK(!supportedVersions_.empty());
   CHECK(socket_);
+  bindSocket(*socket_, address);
+}
+
+void QuicServerWorker::addSocket(
+    std::unique_ptr<folly::AsyncUDPSocket> socket,
+    const folly::SocketAddress& address) {
+  CHECK(socket_);
+  CHECK_EQ(socket->getEventBase(), evb_);
+  bindSocket(*socket, address);
+  additionalSockets_.push_back(std::move(socket));
+}
+
+size_t QuicServerWorker::getNumSockets() const {
+  return socket_ ? 1 + additionalSockets_.size() : 0;
+}
+
+void QuicServerWorker::bindSocket(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
   if (socketOptions_) {
     applySocketOptions(
-        *socket_.get(),
+        sock,
         *socketOptions_,
         address.getFamily(),
         folly::SocketOptionKey::ApplyPos::PRE_BIND);
   }
-  socket_->bind(address);
+  sock.bind(address);
   if (socketOptions_) {
     applySocketOptions(
-        *socket_.get(),
+        sock,
         *socketOptions_,
         address.getFamily(),
         folly::SocketOptionKey::ApplyPos::POST_BIND);
   }
-  socket_->setDFAndTurnOffPMTU();
+  sock.setDFAndTurnOffPMTU();
+}
+
+folly::AsyncUDPSocket& QuicServerWorker::getSocket(size_t index) const {
+  CHECK(socket_);
+  return index == 0 ? *socket_ : *additionalSockets_.at(index - 1);
+}
+
+folly::AsyncUDPSocket& QuicServerWorker::getReplySocket() const {
+  return getSocket(replySocketIndex_);
 }
 
 void QuicServerWorker::applyAllSocketOptions() {
@@ -69,11 +112,65 @@ void QuicServerWorker::applyAllSocketOptions() {
   }
 }
 
+bool QuicServerWorker::setIncomingCpu(int cpu, size_t socketIndex) {
+  return setSocketIncomingCpu(getSocket(socketIndex), cpu);
+}
+
+bool QuicServerWorker::attachConnectionIdSteering() {
+  CHECK(socket_);
+#ifdef QUIC_HAVE_REUSEPORT_CBPF
+  // The program runs with the UDP payload at offset 0. Returning an index
+  // past the end of the group makes the kernel fall back to its hash.
+  constexpr uint32_t kFallback = 0xffffffff;
+  constexpr uint32_t kConnIdOffset = 1;
+  struct sock_filter code[] = {
+      // long header packets carry client chosen connection ids
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0),
+      BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x80, 11, 0),
+      // version bits (0 - 1) of the connection id
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kConnIdOffset),
+      BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xc0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, kShortVersionId << 6, 0, 8),
+      // worker id bits (18 - 25) of the connection id
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kConnIdOffset + 2),
+      BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x3f),
+      BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 2),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, kConnIdOffset + 3),
+      BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 6),
+      BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+      BPF_STMT(BPF_RET | BPF_A, 0),
+      BPF_STMT(BPF_RET | BPF_K, kFallback),
+  };
+  struct sock_fprog prog;
+  prog.len = sizeof(code) / sizeof(code[0]);
+  prog.filter = code;
+  if (folly::netops::setsockopt(
+          socket_->getNetworkSocket(),
+          SOL_SOCKET,
+          SO_ATTACH_REUSEPORT_CBPF,
+          &prog,
+          sizeof(prog)) != 0) {
+    LOG(ERROR) << "Failed to attach connection id steering, workerId="
+               << (uint32_t)workerId_ << " errno=" << errno;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 void QuicServerWorker::setTransportSettingsOverrideFn(
     TransportSettingsOverrideFn fn) {
   transportSettingsOverrideFn_ = std::move(fn);
 }
 
+void QuicServerWorker::setTransportSettingsProfileFn(
+    TransportSettingsProfileFn fn) {
+  transportSettingsProfileFn_ = std::move(fn);
+}
+
 void QuicServerWorker::setTransportInfoCallback(
     std::unique_ptr<QuicTransportStatsCallback> infoCallback) noexcept {
   CHECK(infoCallback);
@@ -85,6 +182,78 @@ QuicTransportStatsCallback* QuicServerWorker::getTransportInfoCallback() const
   return infoCallback_.get();
 }
 
+QuicTransportStatsCounters::Snapshot
+QuicServerWorker::getStatsCountersSnapshot() const noexcept {
+  return statsCountersStorage_->get()->snapshot();
+}
+
+std::vector<const QuicServerTransport*>
+QuicServerWorker::getServerTransports() const {
+  return std::vector<const QuicServerTransport*>(
+      boundServerTransports_.begin(), boundServerTransports_.end());
+}
+
+void QuicServerWorker::snapshotConnections(
+    folly::Range<const QuicServerTransport* const*> transports,
+    const ConnectionSnapshotFilter& filter,
+    std::vector<ConnectionSnapshot>& snapshots) const {
+  for (auto transport : transports) {
+    if (!boundServerTransports_.count(
+            const_cast<QuicServerTransport*>(transport))) {
+      continue;
+    }
+    auto conn = transport->getState();
+    if (!conn) {
+      continue;
+    }
+    ConnectionSnapshot snapshot;
+    snapshot.serverConnectionId = conn->serverConnectionId;
+    snapshot.clientConnectionId = conn->clientConnectionId;
+    snapshot.peerAddress = conn->peerAddress;
+    snapshot.srtt = conn->lossState.srtt;
+    if (conn->congestionController) {
+      snapshot.congestionWindow =
+          conn->congestionController->getCongestionWindow();
+      snapshot.congestionControlType = conn->congestionController->type();
+    }
+    for (auto pnSpace : conn->outstandingPackets.spaces()) {
+      for (const auto& packet : conn->outstandingPackets[pnSpace]) {
+        snapshot.bytesInFlight += packet.encodedSize;
+      }
+    }
+    snapshot.packetsInFlight = conn->outstandingPackets.size();
+    if (conn->streamManager) {
+      snapshot.streamCount = conn->streamManager->streamCount();
+    }
+    snapshot.streamBytesBuffered =
+        conn->flowControlState.sumCurStreamBufferLen;
+    snapshot.streamBytesUnacked =
+        conn->flowControlState.sumUnackedStreamBufferLen;
+    snapshot.workerId = workerId_;
+    if (filter.matches(snapshot)) {
+      snapshots.push_back(std::move(snapshot));
+    }
+  }
+}
+
+void QuicServerWorker::reportStatsCounters() {
+  auto snapshot = statsCountersStorage_->get()->snapshot();
+  if (infoCallback_) {
+    infoCallback_->onStatsCounters(
+        QuicTransportStatsCounters::difference(snapshot, lastStatsCounters_));
+    if (bufPool_) {
+      infoCallback_->onPacketBufferPool(bufPool_->stats());
+    }
+  }
+  lastStatsCounters_ = snapshot;
+}
+
+void QuicServerWorker::StatsCountersTimeout::timeoutExpired() noexcept {
+  worker_.reportStatsCounters();
+  worker_.evb_->timer().scheduleTimeout(
+      this, worker_.transportSettings_.statsCountersInterval);
+}
+
 void QuicServerWorker::setConnectionIdAlgo(
     std::unique_ptr<ConnectionIdAlgo> connIdAlgo) noexcept {
   CHECK(connIdAlgo);
@@ -97,13 +266,173 @@ void QuicServerWorker::setCongestionControllerFactory(
   ccFactory_ = ccFactory;
 }
 
+void QuicServerWorker::setCongestionStateCache(
+    std::shared_ptr<CongestionStateCache> cache) {
+  congestionStateCache_ = std::move(cache);
+}
+
+void QuicServerWorker::setCryptoOffload(
+    std::shared_ptr<CryptoOffload> offload) {
+  cryptoOffload_ = std::move(offload);
+}
+
+void QuicServerWorker::setCryptoWorkerPool(
+    std::shared_ptr<CryptoWorkerPool> workers) {
+  cryptoWorkers_ = std::move(workers);
+}
+
+void QuicServerWorker::setXdpSocketOptions(XdpSocketOptions options) {
+  xdpSocketOptions_ = std::move(options);
+}
+
 void QuicServerWorker::start() {
   CHECK(socket_);
   if (!pacingTimer_) {
     pacingTimer_ = TimerHighRes::newTimer(
         evb_, transportSettings_.pacingTimerTickInterval);
   }
-  socket_->resumeRead(this);
+  if (!multiDestWriter_ && transportSettings_.batchWritesAcrossConnections) {
+    multiDestWriter_ = std::make_shared<MultiDestBatchWriter>(
+        evb_, transportSettings_.maxBatchSize);
+    multiDestWriter_->setBufferPool(bufPool_.get());
+    multiDestWriter_->setTransportInfoCallback(infoCallback_.get());
+  }
+  if (!deferredWriteScheduler_ && transportSettings_.deferWritesToEndOfLoop) {
+    deferredWriteScheduler_ = std::make_shared<DeferredWriteScheduler>(evb_);
+    deferredWriteScheduler_->setMultiDestBatchWriter(multiDestWriter_);
+    deferredWriteScheduler_->setBudgets(
+        transportSettings_.deferredWriteQuantum,
+        transportSettings_.deferredWriteLoopBytesBudget,
+        transportSettings_.deferredWriteLoopTimeBudget);
+  }
+  if (!pacingCalendar_ && transportSettings_.sharedPacingCalendar) {
+    pacingCalendar_ = std::make_shared<PacingCalendar>(pacingTimer_);
+    if (multiDestWriter_) {
+      // The paced bursts of a tick leave together.
+      pacingCalendar_->setAfterPassCallback(
+          [writer = multiDestWriter_] { writer->flush(); });
+    }
+  }
+  if (!looperQueue_ && transportSettings_.sharedLooperQueue) {
+    looperQueue_ = std::make_shared<LooperQueue>(
+        evb_, transportSettings_.maxLooperRunsPerLoop);
+  }
+  if (!initialCipherCache_ && transportSettings_.initialCipherCacheSize > 0) {
+    initialCipherCache_ = std::make_shared<InitialCipherCache>(
+        transportSettings_.initialCipherCacheSize);
+  }
+  if (!appTokenCache_ && transportSettings_.appTokenCacheSize > 0) {
+    appTokenCache_ =
+        std::make_shared<AppTokenCache>(transportSettings_.appTokenCacheSize);
+  }
+  if (!transportParametersCache_ &&
+      transportSettings_.transportParametersCacheSize > 0) {
+    transportParametersCache_ =
+        std::make_shared<ServerTransportParametersCache>(
+            transportSettings_.transportParametersCacheSize);
+  }
+  if (!coarseClock_ && transportSettings_.coarseClock) {
+    coarseClock_ = std::make_shared<CoarseClock>(evb_);
+  }
+  bool windowBudget = transportSettings_.autoTuneFlowControlWindows &&
+      transportSettings_.autoTunedWindowWorkerBudget > 0;
+  bool memoryBudget = transportSettings_.overloadControl &&
+      transportSettings_.overloadMemoryBudget > 0;
+  if (!flowControlWindowBudget_ &&
+      (windowBudget || transportSettings_.workerReceiveBufferLimit > 0 ||
+       memoryBudget)) {
+    flowControlWindowBudget_ = std::make_shared<FlowControlWindowBudget>(
+        windowBudget ? transportSettings_.autoTunedWindowWorkerBudget
+                     : std::numeric_limits<uint64_t>::max(),
+        transportSettings_.workerReceiveBufferLimit);
+  }
+  if (!overloadController_ && transportSettings_.overloadControl) {
+    overloadController_ = std::make_shared<OverloadController>(
+        transportSettings_.overloadMaxLoopLag,
+        transportSettings_.overloadMemoryBudget,
+        [budget = flowControlWindowBudget_] {
+          return budget ? budget->bufferedBytes() : 0;
+        });
+    // in front of any observer the server set already
+    overloadController_->setObserver(evb_->getObserver());
+    evb_->setObserver(overloadController_);
+  }
+  if (!statsCounters_ && transportSettings_.useStatsCounters) {
+    statsCounters_ = statsCountersStorage_->get();
+    evb_->timer().scheduleTimeout(
+        &statsCountersTimeout_, transportSettings_.statsCountersInterval);
+  }
+  // The connections write out of any of the sockets, what they rely on has
+  // to work on all of them.
+  if (!socketTxTimeEnabled_ && transportSettings_.txTimePacing) {
+    socketTxTimeEnabled_ = true;
+    for (size_t i = 0; i < getNumSockets(); ++i) {
+      socketTxTimeEnabled_ =
+          enableSocketTxTime(getSocket(i)) && socketTxTimeEnabled_;
+    }
+  }
+  if (cryptoOffload_ && !cryptoOffloadEnabled_) {
+    cryptoOffloadEnabled_ = true;
+    for (size_t i = 0; i < getNumSockets() && cryptoOffloadEnabled_; ++i) {
+      cryptoOffloadEnabled_ =
+          cryptoOffload_->probe(getSocket(i).getNetworkSocket());
+    }
+    if (!cryptoOffloadEnabled_) {
+      VLOG(4) << "No crypto offload for the sockets of worker=" << this;
+    }
+  }
+  for (size_t i = 0; i < getNumSockets(); ++i) {
+    auto& sock = getSocket(i);
+    if (transportSettings_.enableUdpGRO && !enableSocketGRO(sock)) {
+      VLOG(4) << "Unable to turn on UDP_GRO for worker=" << this
+              << " socket=" << i;
+    }
+    if (transportSettings_.enableEcn &&
+        !enableSocketEcnReceive(sock, sock.address().getFamily())) {
+      VLOG(4) << "Unable to turn on ECN reads for worker=" << this
+              << " socket=" << i;
+    }
+    if (transportSettings_.enableRxTimestamps &&
+        !enableSocketRxTimestamps(sock)) {
+      VLOG(4) << "Unable to turn on receive timestamps for worker=" << this
+              << " socket=" << i;
+    }
+  }
+  if (xdpSocketOptions_ && !xdpSocket_) {
+    xdpSocket_ = XdpSocket::make(evb_, *xdpSocketOptions_, socket_->address());
+    if (!xdpSocket_) {
+      VLOG(2) << "No AF_XDP socket for worker=" << this << " on "
+              << xdpSocketOptions_->interface << " queue "
+              << xdpSocketOptions_->queueId;
+    }
+  }
+  if (transportSettings_.ioUringRecv && ioUringReceivers_.empty()) {
+    IOUringReceiverOptions options;
+    options.numBuffers = transportSettings_.ioUringRecvBuffers;
+    options.payloadSize = transportSettings_.enableUdpGRO
+        ? kGROReadBufferSize
+        : transportSettings_.maxRecvPacketSize;
+    for (size_t i = 0; i < getNumSockets(); ++i) {
+      auto receiver = IOUringReceiver::make(
+          evb_, getSocket(i).getNetworkSocket().toFd(), options);
+      if (!receiver) {
+        VLOG(2) << "No io_uring reads for worker=" << this << " socket=" << i;
+        ioUringReceivers_.clear();
+        break;
+      }
+      ioUringReceivers_.push_back(std::move(receiver));
+    }
+  }
+  // The sockets with a receiver are read through it.
+  for (size_t i = ioUringReceivers_.size(); i < getNumSockets(); ++i) {
+    getSocket(i).resumeRead(this);
+  }
+  for (auto& receiver : ioUringReceivers_) {
+    receiver->resumeRead(this);
+  }
+  if (xdpSocket_) {
+    xdpSocket_->resumeRead(this);
+  }
   VLOG(10) << "Registered read on worker=" << this
            << " thread=" << folly::getCurrentThreadID()
            << " processId=" << (int)processId_;
@@ -111,7 +440,15 @@ void QuicServerWorker::start() {
 
 void QuicServerWorker::pauseRead() {
   CHECK(socket_);
-  socket_->pauseRead();
+  for (size_t i = 0; i < getNumSockets(); ++i) {
+    getSocket(i).pauseRead();
+  }
+  for (auto& receiver : ioUringReceivers_) {
+    receiver->pauseRead();
+  }
+  if (xdpSocket_) {
+    xdpSocket_->pauseRead();
+  }
 }
 
 int QuicServerWorker::getFD() {
@@ -125,7 +462,11 @@ const folly::SocketAddress& QuicServerWorker::getAddress() const {
 }
 
 void QuicServerWorker::getReadBuffer(void** buf, size_t* len) noexcept {
-  readBuffer_ = folly::IOBuf::create(transportSettings_.maxRecvPacketSize);
+  // A buffer is left behind by a packet that the prefilter dropped.
+  if (!readBuffer_ ||
+      readBuffer_->capacity() < transportSettings_.maxRecvPacketSize) {
+    readBuffer_ = folly::IOBuf::create(transportSettings_.maxRecvPacketSize);
+  }
   *buf = readBuffer_->writableData();
   *len = transportSettings_.maxRecvPacketSize;
 }
@@ -133,48 +474,174 @@ void QuicServerWorker::getReadBuffer(void** buf, size_t* len) noexcept {
 // Returns true if we either drop the packet or send a version
 // negotiation packet to the client. Returns false if there's
 // no need for version negotiation.
+namespace {
+
+// The versions as they are listed in a version negotiation packet, as many as
+// fit in one alongside the longest connection ids.
+Buf encodeVersionNegotiationVersions(const std::vector<QuicVersion>& versions) {
+  constexpr size_t kMaxHeaderSize = sizeof(uint8_t) + sizeof(QuicVersionType) +
+      2 * (sizeof(uint8_t) + kMaxConnectionIdSize);
+  constexpr size_t kMaxVersions =
+      (kDefaultUDPSendPacketLen - kMaxHeaderSize) / sizeof(QuicVersionType);
+  size_t numVersions = std::min(versions.size(), kMaxVersions);
+  auto buf = folly::IOBuf::create(numVersions * sizeof(QuicVersionType));
+  folly::io::Appender appender(buf.get(), 0);
+  for (size_t i = 0; i < numVersions; ++i) {
+    appender.writeBE<QuicVersionType>(
+        static_cast<QuicVersionType>(versions[i]));
+  }
+  return buf;
+}
+
+} // namespace
+
+Buf QuicServerWorker::makeVersionNegotiationPacket(
+    const LongHeaderInvariant& invariant,
+    const folly::IOBuf& versions) {
+  // Laid out as VersionNegotiationPacketBuilder does it, the connection ids
+  // of the peer's packet swap around.
+  size_t size = sizeof(uint8_t) + sizeof(QuicVersionType) + sizeof(uint8_t) +
+      invariant.srcConnId.size() + sizeof(uint8_t) +
+      invariant.dstConnId.size() + versions.length();
+  auto packet = folly::IOBuf::create(size);
+  folly::io::Appender appender(packet.get(), 0);
+  appender.writeBE<uint8_t>(kHeaderFormMask);
+  appender.writeBE<QuicVersionType>(
+      static_cast<QuicVersionType>(QuicVersion::VERSION_NEGOTIATION));
+  appender.writeBE<uint8_t>(invariant.srcConnId.size());
+  appender.push(invariant.srcConnId.data(), invariant.srcConnId.size());
+  appender.writeBE<uint8_t>(invariant.dstConnId.size());
+  appender.push(invariant.dstConnId.data(), invariant.dstConnId.size());
+  appender.push(versions.data(), versions.length());
+  return packet;
+}
+
+bool QuicServerWorker::versionNegotiationRateLimited(TimePoint now) {
+  if (!transportSettings_.versionNegotiationRateLimit) {
+    return false;
+  }
+  if (now - versionNegotiationWindowStart_ >=
+      kVersionNegotiationRateLimitWindow) {
+    versionNegotiationWindowStart_ = now;
+    versionNegotiationsInWindow_ = 0;
+  }
+  return versionNegotiationsInWindow_ >=
+      transportSettings_.versionNegotiationRateLimit;
+}
+
 bool QuicServerWorker::maybeSendVersionNegotiationPacketOrDrop(
     const folly::SocketAddress& client,
     bool isInitial,
-    LongHeaderInvariant& invariant) {
-  folly::Optional<std::pair<VersionNegotiationPacket, Buf>>
-      versionNegotiationPacket;
-  if (rejectNewConnections_ && isInitial) {
-    VersionNegotiationPacketBuilder builder(
-        invariant.dstConnId,
-        invariant.srcConnId,
-        std::vector<QuicVersion>{QuicVersion::MVFST_INVALID});
-    versionNegotiationPacket =
-        folly::make_optional(std::move(builder).buildPacket());
-  }
-  if (!versionNegotiationPacket) {
-    bool negotiationNeeded = std::find(
-                                 supportedVersions_.begin(),
-                                 supportedVersions_.end(),
-                                 invariant.version) == supportedVersions_.end();
-    if (negotiationNeeded && !isInitial) {
+    LongHeaderInvariant& invariant,
+    TimePoint receiveTime) {
+  const folly::IOBuf* versions = nullptr;
+  if (isInitial &&
+      (rejectNewConnections_ ||
+       overloaded(OverloadController::Level::REJECT))) {
+    if (!rejectionVersions_) {
+      rejectionVersions_ = encodeVersionNegotiationVersions(
+          std::vector<QuicVersion>{QuicVersion::MVFST_INVALID});
+    }
+    versions = rejectionVersions_.get();
+  } else if (!isSupportedVersion(invariant.version)) {
+    if (!isInitial) {
       VLOG(3) << "Dropping non-initial packet due to invalid version";
       QUIC_STATS(
           infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
       return true;
     }
-    if (negotiationNeeded) {
-      VersionNegotiationPacketBuilder builder(
-          invariant.dstConnId, invariant.srcConnId, supportedVersions_);
-      versionNegotiationPacket =
-          folly::make_optional(std::move(builder).buildPacket());
+    if (!versionNegotiationVersions_) {
+      versionNegotiationVersions_ =
+          encodeVersionNegotiationVersions(supportedVersions_);
     }
+    versions = versionNegotiationVersions_.get();
   }
-  if (versionNegotiationPacket) {
-    VLOG(4) << "Version negotiation sent to client=" << client;
-    auto len = versionNegotiationPacket->second->computeChainDataLength();
-    QUIC_STATS(infoCallback_, onWrite, len);
-    QUIC_STATS(infoCallback_, onPacketProcessed);
-    QUIC_STATS(infoCallback_, onPacketSent);
-    socket_->write(client, versionNegotiationPacket->second);
+  if (!versions) {
+    return false;
+  }
+  if (versionNegotiationRateLimited(receiveTime)) {
+    VLOG(4) << "Not sending version negotiation to client=" << client
+            << " over the rate limit, workerId=" << (uint32_t)workerId_;
+    QUIC_STATS(
+        infoCallback_,
+        onPacketDropped,
+        PacketDropReason::VERSION_NEGOTIATION_RATE_LIMITED);
     return true;
   }
-  return false;
+  versionNegotiationsInWindow_++;
+  VLOG(4) << "Version negotiation sent to client=" << client;
+  auto versionNegotiationPacket =
+      makeVersionNegotiationPacket(invariant, *versions);
+  auto len = versionNegotiationPacket->computeChainDataLength();
+  QUIC_STATS_COUNTER(
+      statsCounters_, BytesWritten, len, infoCallback_, onWrite, len);
+  QUIC_STATS_COUNTER(
+      statsCounters_, PacketsProcessed, 1, infoCallback_, onPacketProcessed);
+  QUIC_STATS_COUNTER(
+      statsCounters_, PacketsSent, 1, infoCallback_, onPacketSent);
+  getReplySocket().write(client, versionNegotiationPacket);
+  return true;
+}
+
+QuicTransportStatsCallback::PacketDropReason
+QuicServerWorker::prefilterPacket(const uint8_t* data, size_t len) const {
+  if (len == 0) {
+    return PacketDropReason::INVALID_PACKET;
+  }
+  uint8_t initialByte = data[0];
+  if (getHeaderForm(initialByte) == HeaderForm::Short) {
+    if (!(initialByte & ShortHeader::kFixedBitMask) ||
+        len < 1 + kDefaultConnectionIdSize) {
+      return PacketDropReason::INVALID_PACKET;
+    }
+    // Short header packets can only be for connection ids we chose.
+    folly::IOBuf wrapped = folly::IOBuf::wrapBufferAsValue(
+        data + 1, kDefaultConnectionIdSize);
+    folly::io::Cursor cursor(&wrapped);
+    if (!connIdAlgo_->canParse(
+            ConnectionId(cursor, kDefaultConnectionIdSize))) {
+      return PacketDropReason::PARSE_ERROR;
+    }
+    return PacketDropReason::NONE;
+  }
+  // initial byte, version and the destination connection id length
+  if (len < 1 + sizeof(QuicVersionType) + 1) {
+    return PacketDropReason::INVALID_PACKET;
+  }
+  QuicVersionType version;
+  memcpy(&version, data + 1, sizeof(version));
+  version = folly::Endian::big(version);
+  bool isSupported = isSupportedVersion(static_cast<QuicVersion>(version));
+  LongHeader::Types type = parseLongHeaderType(initialByte);
+  bool isInitial = type == LongHeader::Types::Initial;
+  if (!isSupported) {
+    // Initials of other versions get a version negotiation
+    return isInitial ? PacketDropReason::NONE
+                     : PacketDropReason::INVALID_PACKET;
+  }
+  if (!(initialByte & LongHeader::kFixedBitMask)) {
+    return PacketDropReason::INVALID_PACKET;
+  }
+  uint8_t dstConnIdLen = data[1 + sizeof(QuicVersionType)];
+  if (!isInitial && type != LongHeader::Types::ZeroRtt &&
+      dstConnIdLen < kMinSelfConnectionIdSize) {
+    return PacketDropReason::INVALID_PACKET;
+  }
+  return PacketDropReason::NONE;
+}
+
+bool QuicServerWorker::maybePrefilterDrop(const uint8_t* data, size_t len) {
+  if (!transportSettings_.prefilterReceivedPackets || healthCheckToken_) {
+    return false;
+  }
+  auto reason = prefilterPacket(data, len);
+  if (reason == PacketDropReason::NONE) {
+    return false;
+  }
+  VLOG(6) << "Prefilter dropping packet reason="
+          << QuicTransportStatsCallback::toString(reason);
+  QUIC_STATS(infoCallback_, onPacketDropped, reason);
+  return true;
 }
 
 void QuicServerWorker::onDataAvailable(
@@ -183,10 +650,23 @@ void QuicServerWorker::onDataAvailable(
     bool truncated) noexcept {
   // TODO: we can get better receive time accuracy than this, with
   // SO_TIMESTAMP or SIOCGSTAMP.
-  auto packetReceiveTime = Clock::now();
+  auto packetReceiveTime =
+      coarseClock_ ? coarseClock_->refresh() : Clock::now();
+  // Only the first socket is read this way, see shouldOnlyNotify.
+  replySocketIndex_ = 0;
   VLOG(10) << "Worker=" << this
            << " Received data on thread=" << folly::getCurrentThreadID()
            << " processId=" << (int)processId_;
+  if (!truncated && readBuffer_) {
+    QUIC_STATS_COUNTER(
+        statsCounters_, PacketsReceived, 1, infoCallback_, onPacketReceived);
+    QUIC_STATS_COUNTER(
+        statsCounters_, BytesRead, len, infoCallback_, onRead, len);
+    if (maybePrefilterDrop(readBuffer_->data(), len)) {
+      // readBuffer_ is kept for the next read.
+      return;
+    }
+  }
   // Move readBuffer_ first so that we can get rid
   // of it immediately so that if we return early,
   // we've flushed it.
@@ -196,16 +676,276 @@ void QuicServerWorker::onDataAvailable(
     return;
   }
   data->append(len);
-  QUIC_STATS(infoCallback_, onPacketReceived);
-  QUIC_STATS(infoCallback_, onRead, len);
   handleNetworkData(client, std::move(data), packetReceiveTime);
 }
 
+bool QuicServerWorker::shouldOnlyNotify() {
+  // The sockets of a worker with more than one are all read in batches.
+  return (transportSettings_.shouldRecvBatch &&
+          transportSettings_.shouldUseRecvmmsgForBatchRecv) ||
+      !additionalSockets_.empty();
+}
+
+void QuicServerWorker::onNotifyDataAvailable(
+    folly::AsyncUDPSocket& sock) noexcept {
+  bool useGRO = transportSettings_.enableUdpGRO;
+  bool useControl = useGRO || transportSettings_.enableEcn ||
+      transportSettings_.enableRxTimestamps;
+  auto readBufferSize =
+      useGRO ? kGROReadBufferSize : transportSettings_.maxRecvPacketSize;
+  const size_t numPackets = transportSettings_.maxRecvBatchSize;
+  const size_t addrLen = sizeof(struct sockaddr_storage);
+  recvmmsgStorage_.resize(numPackets);
+  recvmmsgStorage_.prepareReadBuffers(readBufferSize);
+
+  auto& msgs = recvmmsgStorage_.msgs;
+  auto& addrs = recvmmsgStorage_.addrs;
+  auto& readBuffers = recvmmsgStorage_.readBuffers;
+  auto& iovecs = recvmmsgStorage_.iovecs;
+  auto& controls = recvmmsgStorage_.controls;
+
+  for (size_t i = 0; i < numPackets; ++i) {
+    auto* rawAddr = reinterpret_cast<sockaddr*>(&addrs[i]);
+    rawAddr->sa_family = sock.address().getFamily();
+
+    struct msghdr* msg = &msgs[i].msg_hdr;
+    msg->msg_name = rawAddr;
+    msg->msg_namelen = addrLen;
+    msg->msg_iov = &iovecs[i];
+    msg->msg_iovlen = 1;
+    msg->msg_control = useControl ? controls[i].buf : nullptr;
+    msg->msg_controllen = useControl ? sizeof(controls[i].buf) : 0;
+  }
+
+  int numMsgsRecvd = QUIC_PIPELINE_TIMED(
+      SocketRead,
+      sock.recvmmsg(msgs.data(), numPackets, RECVMMSG_FLAGS, nullptr));
+  if (numMsgsRecvd < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      // Exit, socket will notify us again when socket is readable.
+      return;
+    }
+    sock.pauseRead();
+    return onReadError(folly::AsyncSocketException(
+        folly::AsyncSocketException::INTERNAL_ERROR,
+        "::recvmmsg() failed",
+        errno));
+  }
+
+  // The packets the kernel timestamped keep their own receive times, mapped
+  // from the kernel's wall clock with a precise read of the clock.
+  auto packetReceiveTime =
+      coarseClock_ ? coarseClock_->refresh() : Clock::now();
+  auto readTime = coarseClock_ && transportSettings_.enableRxTimestamps
+      ? Clock::now()
+      : packetReceiveTime;
+  VLOG(10) << "Worker=" << this << " Received " << numMsgsRecvd
+           << " packets on thread=" << folly::getCurrentThreadID()
+           << " processId=" << (int)processId_;
+  replySocketIndex_ = 0;
+  for (size_t i = 1; i < getNumSockets(); ++i) {
+    if (&getSocket(i) == &sock) {
+      replySocketIndex_ = i;
+      break;
+    }
+  }
+  std::vector<Buf> packets;
+  startRoutingBatch();
+  for (int i = 0; i < numMsgsRecvd; ++i) {
+    if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      // This is an error, drop the packet.
+      continue;
+    }
+    folly::SocketAddress client;
+    try {
+      client.setFromSockaddr(
+          reinterpret_cast<sockaddr*>(&addrs[i]), msgs[i].msg_hdr.msg_namelen);
+    } catch (const std::exception& ex) {
+      VLOG(4) << "Dropping packet with invalid source address " << ex.what();
+      continue;
+    }
+    size_t segmentSize = getGROSegmentSize(msgs[i].msg_hdr);
+    uint8_t ecn = getEcnCodepoint(msgs[i].msg_hdr);
+    auto receiveTime = getReceiveTimestamp(msgs[i].msg_hdr, readTime)
+                           .value_or(packetReceiveTime);
+    if (!segmentSize) {
+      QUIC_STATS_COUNTER(
+          statsCounters_, PacketsReceived, 1, infoCallback_, onPacketReceived);
+      QUIC_STATS_COUNTER(
+          statsCounters_,
+          BytesRead,
+          msgs[i].msg_len,
+          infoCallback_,
+          onRead,
+          msgs[i].msg_len);
+      // A dropped packet leaves its buffer in place for the next read.
+      if (maybePrefilterDrop(readBuffers[i]->data(), msgs[i].msg_len)) {
+        continue;
+      }
+    }
+    Buf data = std::move(readBuffers[i]);
+    data->append(msgs[i].msg_len);
+    // A datagram coalesced by GRO is handled as the packets it is made of.
+    packets.clear();
+    splitSegments(std::move(data), segmentSize, packets);
+    for (auto& packet : packets) {
+      if (segmentSize) {
+        QUIC_STATS_COUNTER(
+            statsCounters_,
+            PacketsReceived,
+            1,
+            infoCallback_,
+            onPacketReceived);
+        QUIC_STATS_COUNTER(
+            statsCounters_,
+            BytesRead,
+            packet->length(),
+            infoCallback_,
+            onRead,
+            packet->length());
+      }
+      handleNetworkData(client, std::move(packet), receiveTime, false, ecn);
+    }
+  }
+  finishRoutingBatch();
+}
+
+void QuicServerWorker::onXdpPacket(
+    const folly::SocketAddress& client,
+    Buf data,
+    uint8_t ecn) noexcept {
+  auto packetReceiveTime =
+      coarseClock_ ? coarseClock_->refresh() : Clock::now();
+  auto len = data->computeChainDataLength();
+  replySocketIndex_ = 0;
+  QUIC_STATS_COUNTER(
+      statsCounters_, PacketsReceived, 1, infoCallback_, onPacketReceived);
+  QUIC_STATS_COUNTER(
+      statsCounters_, BytesRead, len, infoCallback_, onRead, len);
+  if (maybePrefilterDrop(data->data(), data->length())) {
+    return;
+  }
+  // The packets of one wakeup are routed together, see onXdpReadDone.
+  if (!routingBatch_) {
+    startRoutingBatch();
+  }
+  handleNetworkData(client, std::move(data), packetReceiveTime, false, ecn);
+}
+
+void QuicServerWorker::onXdpReadDone() noexcept {
+  if (routingBatch_) {
+    finishRoutingBatch();
+  }
+}
+
+void QuicServerWorker::onIOUringPacket(
+    IOUringReceiver& receiver,
+    const folly::SocketAddress& client,
+    Buf data,
+    struct msghdr& msg) noexcept {
+  auto packetReceiveTime =
+      coarseClock_ ? coarseClock_->refresh() : Clock::now();
+  auto readTime = coarseClock_ && transportSettings_.enableRxTimestamps
+      ? Clock::now()
+      : packetReceiveTime;
+  replySocketIndex_ = 0;
+  for (size_t i = 1; i < ioUringReceivers_.size(); ++i) {
+    if (ioUringReceivers_[i].get() == &receiver) {
+      replySocketIndex_ = i;
+      break;
+    }
+  }
+  size_t segmentSize = getGROSegmentSize(msg);
+  uint8_t ecn = getEcnCodepoint(msg);
+  auto receiveTime =
+      getReceiveTimestamp(msg, readTime).value_or(packetReceiveTime);
+  // The packets of one wakeup are routed together, see onIOUringReadDone.
+  if (!routingBatch_) {
+    startRoutingBatch();
+  }
+  if (!segmentSize) {
+    auto len = data->length();
+    QUIC_STATS_COUNTER(
+        statsCounters_, PacketsReceived, 1, infoCallback_, onPacketReceived);
+    QUIC_STATS_COUNTER(
+        statsCounters_, BytesRead, len, infoCallback_, onRead, len);
+    if (maybePrefilterDrop(data->data(), len)) {
+      return;
+    }
+    handleNetworkData(client, std::move(data), receiveTime, false, ecn);
+    return;
+  }
+  // A datagram coalesced by GRO is handled as the packets it is made of.
+  std::vector<Buf> packets;
+  splitSegments(std::move(data), segmentSize, packets);
+  for (auto& packet : packets) {
+    auto len = packet->length();
+    QUIC_STATS_COUNTER(
+        statsCounters_, PacketsReceived, 1, infoCallback_, onPacketReceived);
+    QUIC_STATS_COUNTER(
+        statsCounters_, BytesRead, len, infoCallback_, onRead, len);
+    handleNetworkData(client, std::move(packet), receiveTime, false, ecn);
+  }
+}
+
+void QuicServerWorker::onIOUringReadDone(IOUringReceiver&) noexcept {
+  if (routingBatch_) {
+    finishRoutingBatch();
+  }
+}
+
+void QuicServerWorker::onIOUringReadError(
+    IOUringReceiver&,
+    int error) noexcept {
+  VLOG(2) << "Worker=" << this
+          << " reads its sockets itself after io_uring error=" << error;
+  if (routingBatch_) {
+    finishRoutingBatch();
+  }
+  // Destroyed on return, the receiver calling this one included.
+  auto receivers = std::move(ioUringReceivers_);
+  ioUringReceivers_.clear();
+  for (auto& receiver : receivers) {
+    receiver->pauseRead();
+  }
+  if (shutdown_) {
+    return;
+  }
+  for (size_t i = 0; i < receivers.size(); ++i) {
+    getSocket(i).resumeRead(this);
+  }
+}
+
+void QuicServerWorker::startRoutingBatch() {
+  routingBatch_ = true;
+}
+
+void QuicServerWorker::finishRoutingBatch() {
+  routingBatch_ = false;
+  // Routing may end up back in this worker, take the pending routes first.
+  auto routes = std::move(pendingRoutes_);
+  pendingRoutes_.clear();
+  for (auto& route : routes) {
+    if (shutdown_) {
+      QUIC_STATS(
+          infoCallback_, onPacketDropped, PacketDropReason::SERVER_SHUTDOWN);
+      continue;
+    }
+    callback_->routeDataToWorker(
+        route.client,
+        std::move(route.routingData),
+        std::move(route.networkData),
+        false /* isForwardedData */);
+  }
+}
+
 void QuicServerWorker::handleNetworkData(
     const folly::SocketAddress& client,
     Buf data,
     const TimePoint& packetReceiveTime,
-    bool isForwardedData) noexcept {
+    bool isForwardedData,
+    uint8_t ecn) noexcept {
+  QUIC_PIPELINE_TIMER(PacketRouting);
   try {
     if (shutdown_) {
       VLOG(4) << "Packet received after shutdown, dropping";
@@ -244,10 +984,11 @@ void QuicServerWorker::handleNetworkData(
           false,
           std::move(parsedShortHeader->destinationConnId),
           folly::none);
+      routingData.socketIndex = replySocketIndex_;
       return forwardNetworkData(
           client,
           std::move(routingData),
-          NetworkData(std::move(data), packetReceiveTime),
+          NetworkData(std::move(data), packetReceiveTime, ecn),
           isForwardedData);
     }
 
@@ -269,7 +1010,10 @@ void QuicServerWorker::handleNetworkData(
     }
 
     if (maybeSendVersionNegotiationPacketOrDrop(
-            client, isInitial, parsedLongHeader->invariant)) {
+            client,
+            isInitial,
+            parsedLongHeader->invariant,
+            packetReceiveTime)) {
       return;
     }
 
@@ -288,10 +1032,11 @@ void QuicServerWorker::handleNetworkData(
         isUsingClientConnId,
         std::move(parsedLongHeader->invariant.dstConnId),
         std::move(parsedLongHeader->invariant.srcConnId));
+    routingData.socketIndex = replySocketIndex_;
     return forwardNetworkData(
         client,
         std::move(routingData),
-        NetworkData(std::move(data), packetReceiveTime),
+        NetworkData(std::move(data), packetReceiveTime, ecn),
         isForwardedData);
   } catch (const std::exception& ex) {
     // Drop the packet.
@@ -321,7 +1066,7 @@ void QuicServerWorker::tryHandlingAsHealthCheck(
     // request, so we are not creating an amplification vector. Also
     // ignore the error code.
     VLOG(4) << "Health check request, response=OK";
-    socket_->write(client, folly::IOBuf::copyBuffer("OK"));
+    getReplySocket().write(client, folly::IOBuf::copyBuffer("OK"));
   }
 }
 
@@ -352,10 +1097,85 @@ void QuicServerWorker::forwardNetworkData(
     }
     return;
   }
+  if (routingBatch_ && !isForwardedData &&
+      routingData.headerForm == HeaderForm::Short) {
+    for (auto& route : pendingRoutes_) {
+      if (route.client == client &&
+          route.routingData.destinationConnId ==
+              routingData.destinationConnId) {
+        auto& routeData = route.networkData;
+        routeData.totalData += networkData.totalData;
+        for (size_t i = 0; i < networkData.packets.size(); ++i) {
+          routeData.packets.emplace_back(std::move(networkData.packets[i]));
+          routeData.setEcn(
+              routeData.packets.size() - 1, networkData.getEcn(i));
+          routeData.setReceiveTime(
+              routeData.packets.size() - 1, networkData.getReceiveTime(i));
+        }
+        return;
+      }
+    }
+    pendingRoutes_.push_back(PendingRoute{
+        client, std::move(routingData), std::move(networkData)});
+    return;
+  }
   callback_->routeDataToWorker(
       client, std::move(routingData), std::move(networkData), isForwardedData);
 }
 
+void QuicServerWorker::queueAccept(
+    const folly::SocketAddress& client,
+    RoutingData&& routingData,
+    NetworkData&& networkData,
+    bool isForwardedData) {
+  if (acceptQueue_.size() >= transportSettings_.maxAcceptQueueSize) {
+    VLOG(3) << "Accept queue full, dropping packet from client=" << client
+            << ", workerId=" << (uint32_t)workerId_;
+    QUIC_STATS(
+        infoCallback_, onPacketDropped, PacketDropReason::ACCEPT_QUEUE_FULL);
+    return;
+  }
+  ++pendingAcceptSources_[std::make_pair(
+      client, routingData.destinationConnId)];
+  acceptQueue_.push_back(PendingAccept{client,
+                                       std::move(routingData),
+                                       std::move(networkData),
+                                       isForwardedData});
+  if (!acceptLoopCallback_.isLoopCallbackScheduled()) {
+    evb_->runInLoop(&acceptLoopCallback_);
+  }
+}
+
+void QuicServerWorker::processAcceptQueue() {
+  processingAccepts_ = true;
+  size_t accepted = 0;
+  while (!acceptQueue_.empty() &&
+         accepted < transportSettings_.maxAcceptsPerLoop) {
+    auto pending = std::move(acceptQueue_.front());
+    acceptQueue_.pop_front();
+    auto source =
+        std::make_pair(pending.client, pending.routingData.destinationConnId);
+    auto it = pendingAcceptSources_.find(source);
+    DCHECK(it != pendingAcceptSources_.end());
+    if (--it->second == 0) {
+      pendingAcceptSources_.erase(it);
+    }
+    if (!sourceAddressMap_.count(source)) {
+      ++accepted;
+    }
+    dispatchPacketData(
+        pending.client,
+        std::move(pending.routingData),
+        std::move(pending.networkData),
+        pending.isForwardedData);
+  }
+  processingAccepts_ = false;
+  if (!acceptQueue_.empty()) {
+    // The rest waits for the next loop, after the reads of this one.
+    evb_->runInLoop(&acceptLoopCallback_);
+  }
+}
+
 void QuicServerWorker::setPacingTimer(
     TimerHighRes::SharedPtr pacingTimer) noexcept {
   pacingTimer_ = std::move(pacingTimer);
@@ -367,11 +1187,69 @@ void QuicServerWorker::dispatchPacketData(
     NetworkData&& networkData,
     bool isForwardedData) noexcept {
   DCHECK(socket_);
+  // A packet forwarded from another worker carries the index of a socket of
+  // that worker, which means nothing here. Any socket of the reuseport group
+  // can answer it.
+  replySocketIndex_ = !isForwardedData &&
+          routingData.socketIndex < getNumSockets()
+      ? routingData.socketIndex
+      : 0;
   QuicServerTransport::Ptr transport;
   bool dropPacket = false;
-  auto cit = connectionIdMap_.find(routingData.destinationConnId);
-  if (cit != connectionIdMap_.end()) {
-    transport = cit->second;
+  bool newTransport = false;
+  const QuicServerTransport::Ptr* routed = nullptr;
+  if (routingTable_ && routingData.headerForm == HeaderForm::Short) {
+    routed = routingTable_->find(routingData.destinationConnId);
+  }
+  if (routed) {
+    transport = *routed;
+  } else {
+    auto cit = connectionIdMap_.find(routingData.destinationConnId);
+    if (cit != connectionIdMap_.end()) {
+      transport = cit->second;
+    }
+  }
+  if (!transport && !migratedConnectionIds_.empty()) {
+    auto mit = migratedConnectionIds_.find(routingData.destinationConnId);
+    if (mit != migratedConnectionIds_.end()) {
+      return forwardToMigratedConnection(
+          mit->second,
+          client,
+          std::move(routingData),
+          std::move(networkData),
+          isForwardedData);
+    }
+  }
+  if (!transport && !handedOffConnectionIds_.empty() &&
+      handedOffConnectionIds_.count(routingData.destinationConnId)) {
+    // The process taking over carries on the connection, a reset would
+    // close it there too.
+    VLOG(10) << "Dropping packet of handed off connection CID="
+             << routingData.destinationConnId.hex()
+             << ", workerId=" << (uint32_t)workerId_;
+    QUIC_STATS(
+        infoCallback_, onPacketDropped, PacketDropReason::CONNECTION_NOT_FOUND);
+    return;
+  }
+  if (!transport && !drainingConnections_.empty()) {
+    auto draining =
+        drainingConnections_.find(routingData.destinationConnId, Clock::now());
+    if (draining) {
+      VLOG(10) << "Packet for draining connection CID="
+               << routingData.destinationConnId.hex()
+               << ", workerId=" << (uint32_t)workerId_;
+      if (DrainingConnectionTable::onPacketReceived(*draining)) {
+        // best effort, like the close sent by the transport
+        getReplySocket().write(draining->peerAddress, draining->closePacket);
+      }
+      QUIC_STATS(
+          infoCallback_,
+          onPacketDropped,
+          PacketDropReason::SERVER_STATE_CLOSED);
+      return;
+    }
+  }
+  if (transport) {
     VLOG(10) << "Found existing connection for CID="
              << routingData.destinationConnId.hex() << " " << *transport;
   } else if (routingData.headerForm != HeaderForm::Long) {
@@ -393,6 +1271,18 @@ void QuicServerWorker::dispatchPacketData(
     CHECK(transportFactory_);
     auto source = std::make_pair(client, routingData.destinationConnId);
     auto sit = sourceAddressMap_.find(source);
+    if (sit == sourceAddressMap_.end() &&
+        transportSettings_.maxAcceptsPerLoop && !processingAccepts_ &&
+        ((routingData.isInitial &&
+          networkData.totalData >= kMinInitialPacketSize) ||
+         pendingAcceptSources_.count(source))) {
+      queueAccept(
+          client,
+          std::move(routingData),
+          std::move(networkData),
+          isForwardedData);
+      return;
+    }
     if (sit == sourceAddressMap_.end()) {
       // TODO for O-RTT types we need to create new connections to handle
       // the case, where the new server gets packets sent to the old one due
@@ -417,8 +1307,13 @@ void QuicServerWorker::dispatchPacketData(
               infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
           return;
         }
+        folly::Optional<ConnectionId> retryOriginalDstConnId;
+        if (maybeSendRetry(client, networkData, retryOriginalDstConnId)) {
+          return;
+        }
         // create 'accepting' transport
-        auto sock = makeSocket(getEventBase());
+        auto sock = makeSocket(
+            getEventBase(), getReplySocket().getNetworkSocket().toFd());
         auto trans = transportFactory_->make(
             getEventBase(), std::move(sock), client, ctx_);
         if (!trans) {
@@ -427,34 +1322,59 @@ void QuicServerWorker::dispatchPacketData(
         } else {
           CHECK(trans);
           trans->setPacingTimer(pacingTimer_);
+          trans->setPacingCalendar(pacingCalendar_);
+          trans->setLooperQueue(looperQueue_);
+          trans->setCoarseClock(coarseClock_);
+          trans->setFlowControlWindowBudget(flowControlWindowBudget_);
           trans->setRoutingCallback(this);
           trans->setSupportedVersions(supportedVersions_);
           trans->setOriginalPeerAddress(client);
-          trans->setCongestionControllerFactory(ccFactory_);
-          if (transportSettingsOverrideFn_) {
-            folly::Optional<TransportSettings> overridenTransportSettings =
-                transportSettingsOverrideFn_(
-                    transportSettings_, client.getIPAddress());
-            if (overridenTransportSettings) {
-              trans->setTransportSettings(*overridenTransportSettings);
-            } else {
-              trans->setTransportSettings(transportSettings_);
-            }
+          if (transportSettings_.congestionControlGroups) {
+            trans->setCongestionControllerFactory(
+                std::make_shared<GroupCongestionControllerFactory>(
+                    ccFactory_,
+                    congestionControlGroups_.getGroup(
+                        congestionStateCacheKey(client.getIPAddress()))));
           } else {
-            trans->setTransportSettings(transportSettings_);
+            trans->setCongestionControllerFactory(ccFactory_);
+          }
+          if (congestionStateCache_) {
+            trans->setCongestionStateCache(
+                congestionStateCache_,
+                congestionStateCacheKey(client.getIPAddress()));
           }
+          trans->setPacketBufferPool(bufPool_);
+          trans->setMultiDestBatchWriter(multiDestWriter_);
+          trans->setDeferredWriteScheduler(deferredWriteScheduler_);
+          trans->setSocketTxTimeEnabled(socketTxTimeEnabled_);
+          trans->setXdpSocket(xdpSocket_);
+          trans->setCryptoWorkerPool(cryptoWorkers_);
+          if (cryptoOffloadEnabled_) {
+            trans->setCryptoOffload(cryptoOffload_);
+          }
+          setTransportSettingsFor(*trans, client.getIPAddress());
           trans->setConnectionIdAlgo(connIdAlgo_.get());
           if (routingData.sourceConnId) {
             trans->setClientConnectionId(*routingData.sourceConnId);
           }
           trans->setClientChosenDestConnectionId(routingData.destinationConnId);
+          if (retryOriginalDstConnId) {
+            trans->setRetryOriginalDstConnId(*retryOriginalDstConnId);
+          }
+          trans->setInitialCipherCache(initialCipherCache_);
+          trans->setAppTokenCache(appTokenCache_);
+          trans->setTransportParametersCache(transportParametersCache_);
           // parameters to create server chosen connection id
           ServerConnectionIdParams serverConnIdParams(
               hostId_, static_cast<uint8_t>(processId_), workerId_);
           trans->setServerConnectionIdParams(std::move(serverConnIdParams));
+          trans->setConnectionIdPool(getConnectionIdPool());
           if (infoCallback_) {
             trans->setTransportInfoCallback(infoCallback_.get());
           }
+          if (statsCounters_) {
+            trans->setTransportStatsCounters(statsCounters_);
+          }
           trans->accept();
           auto result = sourceAddressMap_.emplace(std::make_pair(
               std::make_pair(client, routingData.destinationConnId), trans));
@@ -464,6 +1384,7 @@ void QuicServerWorker::dispatchPacketData(
             dropPacket = true;
           }
           transport = trans;
+          newTransport = true;
         }
       }
     } else {
@@ -474,7 +1395,19 @@ void QuicServerWorker::dispatchPacketData(
   }
   if (!dropPacket) {
     DCHECK(transport->getEventBase()->isInEventBaseThread());
+    if (!newTransport ||
+        (!transportSettings_.retryHandshakeRateLimit &&
+         transportSettings_.retryHandshakeTimeBudget.count() == 0)) {
+      transport->onNetworkData(client, std::move(networkData));
+      return;
+    }
+    // The client's first flight is where the handshake costs the most.
+    auto start = Clock::now();
     transport->onNetworkData(client, std::move(networkData));
+    handshakesInWindow_++;
+    handshakeTimeInWindow_ +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start);
     return;
   }
   if (!connIdAlgo_->canParse(routingData.destinationConnId)) {
@@ -559,23 +1492,253 @@ void QuicServerWorker::sendResetPacket(
     // Only send resets in response to short header packets.
     return;
   }
+  if (statelessResetRateLimited(networkData.receiveTimePoint)) {
+    VLOG(4) << "Not resetting CID=" << connId.hex()
+            << " over the rate limit, workerId=" << (uint32_t)workerId_;
+    return;
+  }
+  statelessResetsInWindow_++;
   uint16_t packetSize = networkData.totalData;
   uint16_t maxResetPacketSize = std::min<uint16_t>(
       std::max<uint16_t>(kMinStatelessPacketSize, packetSize),
       kDefaultUDPSendPacketLen);
-  CHECK(transportSettings_.statelessResetTokenSecret.has_value());
-  StatelessResetGenerator generator(
-      *transportSettings_.statelessResetTokenSecret,
-      getAddress().getFullyQualified());
-  StatelessResetToken token = generator.generateToken(connId);
+  StatelessResetToken token = getStatelessResetToken(connId);
   StatelessResetPacketBuilder builder(maxResetPacketSize, token);
   auto resetData = std::move(builder).buildPacket();
-  socket_->write(client, std::move(resetData));
-  QUIC_STATS(infoCallback_, onWrite, resetData->computeChainDataLength());
-  QUIC_STATS(infoCallback_, onPacketSent);
+  getReplySocket().write(client, std::move(resetData));
+  auto resetSize = resetData->computeChainDataLength();
+  QUIC_STATS_COUNTER(
+      statsCounters_,
+      BytesWritten,
+      resetSize,
+      infoCallback_,
+      onWrite,
+      resetSize);
+  QUIC_STATS_COUNTER(
+      statsCounters_, PacketsSent, 1, infoCallback_, onPacketSent);
   QUIC_STATS(infoCallback_, onStatelessReset);
 }
 
+bool QuicServerWorker::statelessResetRateLimited(TimePoint now) {
+  if (!transportSettings_.statelessResetRateLimit) {
+    return false;
+  }
+  if (now - statelessResetWindowStart_ >= kStatelessResetRateLimitWindow) {
+    statelessResetWindowStart_ = now;
+    statelessResetsInWindow_ = 0;
+  }
+  return statelessResetsInWindow_ >= transportSettings_.statelessResetRateLimit;
+}
+
+StatelessResetToken QuicServerWorker::getStatelessResetToken(
+    const ConnectionId& connId) {
+  if (!statelessResetGenerator_) {
+    CHECK(transportSettings_.statelessResetTokenSecret.has_value());
+    statelessResetGenerator_ = std::make_unique<StatelessResetGenerator>(
+        *transportSettings_.statelessResetTokenSecret,
+        getAddress().getFullyQualified());
+    if (transportSettings_.statelessResetTokenCacheSize > 0) {
+      statelessResetTokens_ = std::make_unique<folly::EvictingCacheMap<
+          ConnectionId,
+          StatelessResetToken,
+          ConnectionIdHash>>(transportSettings_.statelessResetTokenCacheSize);
+    }
+  }
+  if (statelessResetTokens_) {
+    auto it = statelessResetTokens_->find(connId);
+    if (it != statelessResetTokens_->end()) {
+      return it->second;
+    }
+  }
+  auto token = statelessResetGenerator_->generateToken(connId);
+  if (statelessResetTokens_) {
+    statelessResetTokens_->set(connId, token);
+  }
+  return token;
+}
+
+std::shared_ptr<ConnectionIdPool> QuicServerWorker::getConnectionIdPool() {
+  if (!transportSettings_.connectionIdPoolSize ||
+      !transportSettings_.statelessResetTokenSecret.has_value() || !socket_) {
+    return nullptr;
+  }
+  ServerConnectionIdParams params(
+      hostId_, static_cast<uint8_t>(processId_), workerId_);
+  if (!connIdPool_ ||
+      !connIdPool_->matches(
+          params,
+          *transportSettings_.statelessResetTokenSecret,
+          getAddress())) {
+    connIdPool_ = std::make_shared<ConnectionIdPool>(
+        *connIdAlgo_,
+        params,
+        *transportSettings_.statelessResetTokenSecret,
+        getAddress(),
+        transportSettings_.connectionIdPoolSize);
+  }
+  return connIdPool_;
+}
+
+void QuicServerWorker::setTransportSettingsFor(
+    QuicServerTransport& trans,
+    const folly::IPAddress& clientIp) {
+  if (transportSettingsProfileFn_) {
+    auto profile = transportSettingsProfileFn_(clientIp);
+    if (profile) {
+      auto settings = *profile;
+      if (!settings.statelessResetTokenSecret) {
+        // a profile made before the server generated its secret
+        settings.statelessResetTokenSecret =
+            transportSettings_.statelessResetTokenSecret;
+      }
+      setLoadedTransportSettings(trans, std::move(settings));
+      return;
+    }
+  }
+  if (transportSettingsOverrideFn_) {
+    auto overriddenTransportSettings =
+        transportSettingsOverrideFn_(transportSettings_, clientIp);
+    if (overriddenTransportSettings) {
+      setLoadedTransportSettings(
+          trans, std::move(*overriddenTransportSettings));
+      return;
+    }
+  }
+  setLoadedTransportSettings(trans, transportSettings_);
+}
+
+void QuicServerWorker::setLoadedTransportSettings(
+    QuicServerTransport& trans,
+    TransportSettings settings) {
+  if (overloaded(OverloadController::Level::NO_ZERO_RTT)) {
+    settings.acceptZeroRtt = false;
+  }
+  if (overloaded(OverloadController::Level::SMALL_WINDOWS)) {
+    settings.advertisedInitialConnectionWindowSize /= kOverloadWindowDivisor;
+    settings.advertisedInitialBidiLocalStreamWindowSize /=
+        kOverloadWindowDivisor;
+    settings.advertisedInitialBidiRemoteStreamWindowSize /=
+        kOverloadWindowDivisor;
+    settings.advertisedInitialUniStreamWindowSize /= kOverloadWindowDivisor;
+  }
+  trans.setTransportSettings(std::move(settings));
+}
+
+bool QuicServerWorker::overloaded(OverloadController::Level level) const {
+  return overloadController_ && overloadController_->getLevel() >= level;
+}
+
+bool QuicServerWorker::handshakeBudgetExceeded(TimePoint now) {
+  if (now - handshakeWindowStart_ >= kHandshakeAdmissionWindow) {
+    handshakeWindowStart_ = now;
+    handshakesInWindow_ = 0;
+    handshakeTimeInWindow_ = std::chrono::microseconds::zero();
+  }
+  return (transportSettings_.retryHandshakeRateLimit &&
+          handshakesInWindow_ >= transportSettings_.retryHandshakeRateLimit) ||
+      (transportSettings_.retryHandshakeTimeBudget.count() > 0 &&
+       handshakeTimeInWindow_ >= transportSettings_.retryHandshakeTimeBudget);
+}
+
+bool QuicServerWorker::maybeSendRetry(
+    const folly::SocketAddress& client,
+    const NetworkData& networkData,
+    folly::Optional<ConnectionId>& retryOriginalDstConnId) {
+  bool overloadRetry = overloaded(OverloadController::Level::RETRY);
+  if (!overloadRetry && !transportSettings_.retryHandshakeRateLimit &&
+      transportSettings_.retryHandshakeTimeBudget.count() == 0) {
+    return false;
+  }
+  bool overBudget =
+      handshakeBudgetExceeded(networkData.receiveTimePoint) || overloadRetry;
+  folly::io::Cursor cursor(networkData.packets.front().get());
+  auto initialByte = cursor.readBE<uint8_t>();
+  auto parsedHeader = parseLongHeader(initialByte, cursor);
+  if (!parsedHeader || !parsedHeader->parsedLongHeader) {
+    if (overBudget) {
+      QUIC_STATS(
+          infoCallback_, onPacketDropped, PacketDropReason::PARSE_ERROR);
+    }
+    return overBudget;
+  }
+  auto& initialHeader = parsedHeader->parsedLongHeader->header;
+  if (!retryTokenGenerator_) {
+    CHECK(transportSettings_.statelessResetTokenSecret.has_value());
+    retryTokenGenerator_ = std::make_unique<RetryTokenGenerator>(
+        *transportSettings_.statelessResetTokenSecret);
+  }
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  const auto& token = initialHeader.getToken();
+  if (!token.empty()) {
+    retryOriginalDstConnId = retryTokenGenerator_->validateToken(
+        token, client.getIPAddress(), now);
+    if (retryOriginalDstConnId || !overBudget) {
+      return false;
+    }
+    // A client that got a Retry comes back with a valid token.
+    VLOG(4) << "Dropping Initial with invalid retry token from client="
+            << client;
+    QUIC_STATS(
+        infoCallback_,
+        onPacketDropped,
+        PacketDropReason::INVALID_RETRY_TOKEN);
+    return true;
+  }
+  if (!overBudget) {
+    return false;
+  }
+  sendRetryPacket(client, initialHeader, now);
+  return true;
+}
+
+void QuicServerWorker::sendRetryPacket(
+    const folly::SocketAddress& client,
+    const LongHeader& initialHeader,
+    std::chrono::seconds now) {
+  auto srcConnId =
+      connIdAlgo_->encodeConnectionId(ServerConnectionIdParams(
+          hostId_, static_cast<uint8_t>(processId_), workerId_));
+  if (srcConnId.hasError()) {
+    LOG(ERROR) << "Failed to encode the retry connection id, "
+               << srcConnId.error().what();
+    return;
+  }
+  VLOG(4) << "Sending retry to client=" << client
+          << ", workerId=" << (uint32_t)workerId_;
+  LongHeader retryHeader(
+      LongHeader::Types::Retry,
+      *srcConnId,
+      initialHeader.getSourceConnId(),
+      0 /* packetNum */,
+      initialHeader.getVersion(),
+      retryTokenGenerator_->generateToken(
+          initialHeader.getDestinationConnId(), client.getIPAddress(), now),
+      initialHeader.getDestinationConnId());
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen,
+      std::move(retryHeader),
+      0 /* largestAcked */,
+      initialHeader.getVersion());
+  auto packet = std::move(builder).buildPacket();
+  auto retryData = std::move(packet.header);
+  if (packet.body) {
+    retryData->prependChain(std::move(packet.body));
+  }
+  auto retrySize = retryData->computeChainDataLength();
+  getReplySocket().write(client, retryData);
+  QUIC_STATS_COUNTER(
+      statsCounters_,
+      BytesWritten,
+      retrySize,
+      infoCallback_,
+      onWrite,
+      retrySize);
+  QUIC_STATS_COUNTER(
+      statsCounters_, PacketsSent, 1, infoCallback_, onPacketSent);
+  QUIC_STATS(infoCallback_, onRetrySent);
+}
+
 void QuicServerWorker::allowBeingTakenOver(
     std::unique_ptr<folly::AsyncUDPSocket> socket,
     const folly::SocketAddress& address) {
@@ -664,6 +1827,7 @@ void QuicServerWorker::setTransportFactory(
 void QuicServerWorker::setSupportedVersions(
     const std::vector<QuicVersion>& supportedVersions) {
   supportedVersions_ = supportedVersions;
+  versionNegotiationVersions_.reset();
 }
 
 void QuicServerWorker::setFizzContext(
@@ -674,12 +1838,48 @@ void QuicServerWorker::setFizzContext(
 void QuicServerWorker::setTransportSettings(
     TransportSettings transportSettings) {
   transportSettings_ = transportSettings;
+  if (transportSettings_.packetBufferPoolSize) {
+    bufPool_ = std::make_shared<PacketBufferPool>(
+        packetBufferPoolBufSize(transportSettings_),
+        transportSettings_.packetBufferPoolSize,
+        transportSettings_.packetBufferPoolHugePages);
+  } else {
+    bufPool_.reset();
+  }
+  if (multiDestWriter_) {
+    multiDestWriter_->setBufferPool(bufPool_.get());
+  }
+  takeoverPktHandler_.setBatchSize(
+      transportSettings_.batchForwardedPackets
+          ? transportSettings_.maxBatchSize
+          : 0);
+  if (!transportSettings_.connectionIdRoutingTableSize) {
+    routingTable_.reset();
+  } else if (
+      !routingTable_ ||
+      routingTable_->numSlots() !=
+          folly::nextPowTwo(transportSettings_.connectionIdRoutingTableSize)) {
+    // Only connections bound from now on are added, the rest are still found
+    // in connectionIdMap_.
+    routingTable_ =
+        std::make_unique<ConnectionIdRoutingTable<QuicServerTransport::Ptr>>(
+            transportSettings_.connectionIdRoutingTableSize);
+  }
 }
 
 void QuicServerWorker::rejectNewConnections(bool rejectNewConnections) {
   rejectNewConnections_ = rejectNewConnections;
 }
 
+void QuicServerWorker::setEventBaseObserver(
+    std::shared_ptr<folly::EventBaseObserver> observer) {
+  if (overloadController_) {
+    overloadController_->setObserver(std::move(observer));
+  } else {
+    evb_->setObserver(std::move(observer));
+  }
+}
+
 void QuicServerWorker::enablePartialReliability(bool enabled) {
   transportSettings_.partialReliabilityEnabled = enabled;
 }
@@ -716,8 +1916,10 @@ void QuicServerWorker::onConnectionIdAvailable(
     ConnectionId id) noexcept {
   VLOG(4) << "Adding into connectionIdMap_ for CID=" << id << " " << *transport;
   QuicServerTransport* transportPtr = transport.get();
-  auto result =
-      connectionIdMap_.emplace(std::make_pair(id, std::move(transport)));
+  auto result = connectionIdMap_.emplace(std::make_pair(id, transport));
+  if (result.second && routingTable_) {
+    routingTable_->insert(id, std::move(transport));
+  }
   if (!result.second) {
     // In the case of duplicates, log if they represent the same transport,
     // or different ones.
@@ -732,6 +1934,15 @@ void QuicServerWorker::onConnectionIdAvailable(
   }
 }
 
+void QuicServerWorker::onConnectionIdsAvailable(
+    QuicServerTransport::Ptr transport,
+    const std::vector<ConnectionId>& ids) noexcept {
+  connectionIdMap_.reserve(connectionIdMap_.size() + ids.size());
+  for (const auto& id : ids) {
+    onConnectionIdAvailable(transport, id);
+  }
+}
+
 void QuicServerWorker::onConnectionIdBound(
     QuicServerTransport::Ptr transport) noexcept {
   auto clientInitialDestCid = transport->getClientChosenDestConnectionId();
@@ -763,6 +1974,11 @@ void QuicServerWorker::onConnectionUnbound(
   for (auto& connId : connectionIdData) {
     VLOG(4) << "Removing from connectionIdMap_ for CID=" << connId.connId
             << ", workerId=" << (uint32_t)workerId_;
+    auto ait = adoptedConnectionIds_.find(connId.connId);
+    if (ait != adoptedConnectionIds_.end()) {
+      forgetMigratedConnectionId(connId.connId, ait->second);
+      adoptedConnectionIds_.erase(ait);
+    }
     auto it = connectionIdMap_.find(connId.connId);
     // This should be nullptr in most cases. In order to investigate if
     // an incorrect server transport is removed, this will be set to the value
@@ -779,6 +1995,9 @@ void QuicServerWorker::onConnectionUnbound(
         incorrectTransportPtr = existingPtr;
       }
     }
+    if (routingTable_) {
+      routingTable_->erase(connId.connId);
+    }
     connectionIdMap_.erase(connId.connId);
     if (incorrectTransportPtr != nullptr) {
       if (boundServerTransports_.find(incorrectTransportPtr) !=
@@ -794,6 +2013,284 @@ void QuicServerWorker::onConnectionUnbound(
   sourceAddressMap_.erase(source);
 }
 
+bool QuicServerWorker::onConnectionDraining(
+    QuicServerTransport* /* transport */,
+    const folly::SocketAddress& peerAddress,
+    const std::vector<ConnectionIdData>& connectionIdData,
+    Buf closePacket,
+    std::chrono::milliseconds drainPeriod) noexcept {
+  if (shutdown_ || !transportSettings_.compactDrainingConnections ||
+      connectionIdData.empty()) {
+    return false;
+  }
+  auto now = Clock::now();
+  drainingConnections_.expire(now);
+  DrainingConnectionTable::Entry entry;
+  entry.peerAddress = peerAddress;
+  entry.closePacket = std::move(closePacket);
+  entry.deadline = now + drainPeriod;
+  entry.connectionIds.reserve(connectionIdData.size());
+  for (const auto& connIdData : connectionIdData) {
+    entry.connectionIds.push_back(connIdData.connId);
+  }
+  drainingConnections_.insert(std::move(entry));
+  return true;
+}
+
+bool QuicServerWorker::migrateConnection(
+    const QuicServerTransport::Ptr& transport,
+    QuicServerWorker& target) {
+  DCHECK(evb_->isInEventBaseThread());
+  if (&target == this || shutdown_ ||
+      transportSettings_.congestionControlGroups ||
+      !transport->isMigratable() ||
+      !boundServerTransports_.count(transport.get())) {
+    return false;
+  }
+  VLOG(4) << "Migrating connection to workerId=" << (uint32_t)target.workerId_
+          << ", workerId=" << (uint32_t)workerId_ << " " << *transport;
+  MigratedConnectionIds connectionIds;
+  for (auto& connIdData : transport->getState()->selfConnectionIds) {
+    auto& id = connIdData.connId;
+    if (routingTable_) {
+      routingTable_->erase(id);
+    }
+    connectionIdMap_.erase(id);
+    std::vector<QuicServerWorker*> forwarders;
+    auto ait = adoptedConnectionIds_.find(id);
+    if (ait != adoptedConnectionIds_.end()) {
+      // Moved here from elsewhere before, those workers keep handing the
+      // packets on, through this one.
+      forwarders = std::move(ait->second);
+      adoptedConnectionIds_.erase(ait);
+    }
+    forwarders.push_back(this);
+    migratedConnectionIds_[id] = &target;
+    connectionIds.emplace_back(id, std::move(forwarders));
+  }
+  boundServerTransports_.erase(transport.get());
+  transport->setRoutingCallback(nullptr);
+  transport->setTransportInfoCallback(nullptr);
+  transport->setFlowControlWindowBudget(nullptr);
+  transport->setCoarseClock(nullptr);
+  transport->setLooperQueue(nullptr);
+  transport->setPacingCalendar(nullptr);
+  transport->detachEventBase();
+  target.getEventBase()->runInEventBaseThread(
+      [worker = &target,
+       transport,
+       connectionIds = std::move(connectionIds)]() mutable {
+        worker->adoptConnection(std::move(transport), std::move(connectionIds));
+      });
+  return true;
+}
+
+void QuicServerWorker::adoptConnection(
+    QuicServerTransport::Ptr transport,
+    MigratedConnectionIds connectionIds) {
+  DCHECK(evb_->isInEventBaseThread());
+  VLOG(4) << "Adopting migrated connection, workerId=" << (uint32_t)workerId_
+          << " " << *transport;
+  if (shutdown_) {
+    for (auto& connectionId : connectionIds) {
+      forgetMigratedConnectionId(connectionId.first, connectionId.second);
+    }
+    transport->attachEventBase(evb_);
+    transport->closeNow(std::make_pair(
+        QuicErrorCode(LocalErrorCode::SHUTTING_DOWN),
+        std::string("shutting down")));
+    return;
+  }
+  transport->setPacingTimer(pacingTimer_);
+  transport->setPacingCalendar(pacingCalendar_);
+  transport->setLooperQueue(looperQueue_);
+  transport->setCoarseClock(coarseClock_);
+  transport->setFlowControlWindowBudget(flowControlWindowBudget_);
+  if (congestionStateCache_) {
+    transport->setCongestionStateCache(
+        congestionStateCache_,
+        congestionStateCacheKey(
+            transport->getOriginalPeerAddress().getIPAddress()));
+  }
+  transport->setPacketBufferPool(bufPool_);
+  transport->setMultiDestBatchWriter(multiDestWriter_);
+  transport->setDeferredWriteScheduler(deferredWriteScheduler_);
+  transport->setConnectionIdAlgo(connIdAlgo_.get());
+  transport->setServerConnectionIdParams(ServerConnectionIdParams(
+      hostId_, static_cast<uint8_t>(processId_), workerId_));
+  transport->setConnectionIdPool(getConnectionIdPool());
+  transport->setTransportInfoCallback(infoCallback_.get());
+  transport->moveToEventBase(evb_, makeSocket(evb_));
+
+  for (auto& connectionId : connectionIds) {
+    connectionIdMap_.emplace(connectionId.first, transport);
+    if (routingTable_) {
+      routingTable_->insert(connectionId.first, transport);
+    }
+    adoptedConnectionIds_.emplace(
+        connectionId.first, std::move(connectionId.second));
+  }
+  boundServerTransports_.insert(transport.get());
+  transport->setRoutingCallback(this);
+  // Have the peer route to this worker. Otherwise its packets keep being
+  // handed on.
+  transport->issueNewConnectionId();
+}
+
+void QuicServerWorker::forgetMigratedConnectionId(
+    const ConnectionId& id,
+    const std::vector<QuicServerWorker*>& forwarders) {
+  // The workers the connection moved from can stop handing it on.
+  for (auto worker : forwarders) {
+    worker->getEventBase()->runInEventBaseThread(
+        [worker, id] { worker->migratedConnectionIds_.erase(id); });
+  }
+}
+
+void QuicServerWorker::forwardToMigratedConnection(
+    QuicServerWorker* worker,
+    const folly::SocketAddress& client,
+    RoutingData&& routingData,
+    NetworkData&& networkData,
+    bool isForwardedData) {
+  VLOG(10) << "Handing on packet of migrated connection CID="
+           << routingData.destinationConnId.hex()
+           << " to workerId=" << (uint32_t)worker->workerId_
+           << ", workerId=" << (uint32_t)workerId_;
+  worker->getEventBase()->runInEventBaseThread(
+      [worker,
+       cl = client,
+       routingData = std::move(routingData),
+       buf = std::move(networkData),
+       isForwarded = isForwardedData]() mutable {
+        worker->dispatchPacketData(
+            cl, std::move(routingData), std::move(buf), isForwarded);
+      });
+}
+
+std::vector<Buf> QuicServerWorker::handOffConnections() {
+  DCHECK(evb_->isInEventBaseThread());
+  std::vector<Buf> states;
+  if (shutdown_) {
+    return states;
+  }
+  // Closing a transport takes it out of boundServerTransports_.
+  std::vector<QuicServerTransport::Ptr> transports;
+  transports.reserve(boundServerTransports_.size());
+  for (auto transport : boundServerTransports_) {
+    transports.push_back(transport->shared_from_this());
+  }
+  for (auto& transport : transports) {
+    auto state = transport->exportHandoffState();
+    if (!state) {
+      continue;
+    }
+    VLOG(4) << "Handing off connection, workerId=" << (uint32_t)workerId_
+            << " " << *transport;
+    for (auto& connIdData : state->selfConnectionIds) {
+      handedOffConnectionIds_.insert(connIdData.connId);
+    }
+    states.push_back(encodeConnectionHandoffState(*state));
+    transport->closeNow(std::make_pair(
+        QuicErrorCode(LocalErrorCode::CONNECTION_HANDED_OFF),
+        std::string("handed off")));
+  }
+  return states;
+}
+
+bool QuicServerWorker::acceptHandedOffConnection(
+    const ConnectionHandoffState& state,
+    MigratedConnectionIds forwardedConnectionIds) {
+  DCHECK(evb_->isInEventBaseThread());
+  if (shutdown_ || !transportFactory_ || !state.serverConnectionId) {
+    return false;
+  }
+  for (auto& connIdData : state.selfConnectionIds) {
+    if (connectionIdMap_.count(connIdData.connId)) {
+      LOG(ERROR) << "connectionIdMap_ already has handed off CID="
+                 << connIdData.connId;
+      return false;
+    }
+  }
+  const auto& client = state.originalPeerAddress;
+  auto trans = transportFactory_->make(
+      getEventBase(), makeSocket(getEventBase()), client, ctx_);
+  if (!trans) {
+    LOG(ERROR) << "Transport factory failed to make handed off transport";
+    return false;
+  }
+  trans->setPacingTimer(pacingTimer_);
+  trans->setPacingCalendar(pacingCalendar_);
+  trans->setLooperQueue(looperQueue_);
+  trans->setCoarseClock(coarseClock_);
+  trans->setFlowControlWindowBudget(flowControlWindowBudget_);
+  trans->setSupportedVersions(supportedVersions_);
+  trans->setOriginalPeerAddress(client);
+  trans->setCongestionControllerFactory(ccFactory_);
+  if (congestionStateCache_) {
+    trans->setCongestionStateCache(
+        congestionStateCache_, congestionStateCacheKey(client.getIPAddress()));
+  }
+  trans->setPacketBufferPool(bufPool_);
+  trans->setMultiDestBatchWriter(multiDestWriter_);
+  trans->setDeferredWriteScheduler(deferredWriteScheduler_);
+  trans->setSocketTxTimeEnabled(socketTxTimeEnabled_);
+  trans->setXdpSocket(xdpSocket_);
+  trans->setCryptoWorkerPool(cryptoWorkers_);
+  if (cryptoOffloadEnabled_) {
+    trans->setCryptoOffload(cryptoOffload_);
+  }
+  setTransportSettingsFor(*trans, client.getIPAddress());
+  trans->setConnectionIdAlgo(connIdAlgo_.get());
+  trans->setServerConnectionIdParams(ServerConnectionIdParams(
+      hostId_, static_cast<uint8_t>(processId_), workerId_));
+  trans->setConnectionIdPool(getConnectionIdPool());
+  trans->setAppTokenCache(appTokenCache_);
+  if (infoCallback_) {
+    trans->setTransportInfoCallback(infoCallback_.get());
+  }
+  if (statsCounters_) {
+    trans->setTransportStatsCounters(statsCounters_);
+  }
+  try {
+    trans->acceptHandedOff(state);
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Failed to accept handed off connection " << ex.what();
+    trans->setTransportInfoCallback(nullptr);
+    trans->setTransportStatsCounters(nullptr);
+    trans->closeNow(std::make_pair(
+        QuicErrorCode(LocalErrorCode::CONNECTION_ABANDONED),
+        std::string("handoff failed")));
+    return false;
+  }
+  VLOG(4) << "Accepted handed off connection, workerId=" << (uint32_t)workerId_
+          << " " << *trans;
+
+  for (auto& connIdData : state.selfConnectionIds) {
+    connectionIdMap_.emplace(connIdData.connId, trans);
+    if (routingTable_) {
+      routingTable_->insert(connIdData.connId, trans);
+    }
+  }
+  for (auto& connectionId : forwardedConnectionIds) {
+    for (auto worker : connectionId.second) {
+      worker->getEventBase()->runInEventBaseThread(
+          [worker, target = this, id = connectionId.first] {
+            worker->migratedConnectionIds_[id] = target;
+          });
+    }
+    adoptedConnectionIds_.emplace(
+        connectionId.first, std::move(connectionId.second));
+  }
+  boundServerTransports_.insert(trans.get());
+  trans->setRoutingCallback(this);
+  QUIC_STATS(infoCallback_, onNewConnection);
+  // Have the peer use a connection id of this process, so that its packets
+  // are not taken for the other process's.
+  trans->issueNewConnectionId();
+  return true;
+}
+
 void QuicServerWorker::shutdownAllConnections(LocalErrorCode error) {
   VLOG(4) << "QuicServer shutdown all connections."
           << " addressMap=" << sourceAddressMap_.size()
@@ -802,42 +2299,106 @@ void QuicServerWorker::shutdownAllConnections(LocalErrorCode error) {
     return;
   }
   shutdown_ = true;
-  if (socket_) {
-    socket_->pauseRead();
+  for (size_t i = 0; i < getNumSockets(); ++i) {
+    getSocket(i).pauseRead();
+  }
+  for (auto& receiver : ioUringReceivers_) {
+    receiver->pauseRead();
+  }
+  if (xdpSocket_) {
+    xdpSocket_->pauseRead();
   }
   if (takeoverCB_) {
     takeoverCB_->pause();
   }
   callback_ = nullptr;
 
+  // The close packets of all the connections are queued together and leave
+  // maxBatchSize at a time in sendmmsg batches, instead of one write each.
+  auto closeWriter = multiDestWriter_;
+  if (!closeWriter && socket_) {
+    closeWriter = std::make_shared<MultiDestBatchWriter>(
+        evb_, transportSettings_.maxBatchSize);
+  }
+  const auto closeReason =
+      std::make_pair(QuicErrorCode(error), std::string("shutting down"));
+
   // Shut down all transports without bound connection ids.
   for (auto& it : sourceAddressMap_) {
     auto transport = it.second;
     transport->setRoutingCallback(nullptr);
     transport->setTransportInfoCallback(nullptr);
-    transport->closeNow(
-        std::make_pair(QuicErrorCode(error), std::string("shutting down")));
+    transport->setTransportStatsCounters(nullptr);
+    transport->setMultiDestBatchWriter(closeWriter);
+    transport->closeNow(closeReason);
   }
 
   // Shut down all transports with bound connection ids.
   for (auto transport : boundServerTransports_) {
     transport->setRoutingCallback(nullptr);
     transport->setTransportInfoCallback(nullptr);
-    transport->closeNow(
-        std::make_pair(QuicErrorCode(error), std::string("shutting down")));
+    transport->setTransportStatsCounters(nullptr);
+    transport->setMultiDestBatchWriter(closeWriter);
+    transport->closeNow(closeReason);
     QUIC_STATS(infoCallback_, onConnectionClose, folly::none);
   }
+  acceptLoopCallback_.cancelLoopCallback();
+  acceptQueue_.clear();
+  pendingAcceptSources_.clear();
   sourceAddressMap_.clear();
   connectionIdMap_.clear();
+  migratedConnectionIds_.clear();
+  handedOffConnectionIds_.clear();
+  drainingConnections_.clear();
+  if (routingTable_) {
+    routingTable_->clear();
+  }
   takeoverPktHandler_.stop();
+  if (statsCounters_) {
+    statsCountersTimeout_.cancelTimeout();
+    reportStatsCounters();
+    statsCounters_ = nullptr;
+  }
+  if (multiDestWriter_) {
+    multiDestWriter_->setTransportInfoCallback(nullptr);
+  }
   if (infoCallback_) {
     infoCallback_.reset();
   }
+  if (closeWriter) {
+    // Get the close frames of the connections out while the socket is alive.
+    closeWriter->flush();
+  }
+  // The receivers go first, they read the sockets.
+  ioUringReceivers_.clear();
   socket_.reset();
+  additionalSockets_.clear();
+  replySocketIndex_ = 0;
+  xdpSocket_.reset();
   takeoverCB_.reset();
 }
 
 QuicServerWorker::~QuicServerWorker() {
   shutdownAllConnections(LocalErrorCode::SHUTTING_DOWN);
 }
+bool ConnectionSnapshotFilter::matches(
+    const ConnectionSnapshot& snapshot) const {
+  if (peerAddress && *peerAddress != snapshot.peerAddress.getIPAddress()) {
+    return false;
+  }
+  if (congestionControlType &&
+      *congestionControlType != snapshot.congestionControlType) {
+    return false;
+  }
+  if (minStreamBytesBuffered &&
+      snapshot.streamBytesBuffered + snapshot.streamBytesUnacked <
+          *minStreamBytesBuffered) {
+    return false;
+  }
+  if (minBytesInFlight && snapshot.bytesInFlight < *minBytesInFlight) {
+    return false;
+  }
+  return true;
+}
+
 } // namespace quic
@@ -8,22 +8,89 @@
 
 #pragma once
 
+#include <algorithm>
+#include <deque>
+
+#include <folly/CachelinePadded.h>
+#include <folly/Range.h>
+#include <folly/container/EvictingCacheMap.h>
 #include <folly/container/F14Map.h>
 #include <folly/container/F14Set.h>
 #include <folly/io/SocketOptionMap.h>
 #include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/HHWheelTimer.h>
 
+#include <quic/api/DeferredWriteScheduler.h>
+#include <quic/api/QuicBatchWriter.h>
 #include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/common/CoarseClock.h>
+#include <quic/common/LooperQueue.h>
+#include <quic/common/PacingCalendar.h>
 #include <quic/common/Timers.h>
+#include <quic/common/IOUringReceiver.h>
+#include <quic/common/XdpSocket.h>
+#include <quic/congestion_control/CongestionControlGroup.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/flowcontrol/FlowControlWindowBudget.h>
+#include <quic/handshake/CryptoOffload.h>
+#include <quic/handshake/ParallelAead.h>
+#include <quic/handshake/InitialCipherCache.h>
+#include <quic/server/ConnectionIdRoutingTable.h>
+#include <quic/server/DrainingConnectionTable.h>
+#include <quic/server/OverloadController.h>
 #include <quic/server/QuicServerPacketRouter.h>
 #include <quic/server/QuicServerTransportFactory.h>
 #include <quic/server/QuicUDPSocketFactory.h>
+#include <quic/server/handshake/AppToken.h>
+#include <quic/server/handshake/RetryTokenGenerator.h>
+#include <quic/server/handshake/ServerTransportParametersExtension.h>
+#include <quic/server/handshake/StatelessResetGenerator.h>
+#include <quic/server/state/ConnectionHandoff.h>
+#include <quic/server/state/ConnectionIdPool.h>
+#include <quic/state/CongestionStateCache.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 
 namespace quic {
 
+/**
+ * What a live connection of a server looks like at one point, see
+ * QuicServer::getConnectionSnapshots.
+ */
+struct ConnectionSnapshot {
+  folly::Optional<ConnectionId> serverConnectionId;
+  folly::Optional<ConnectionId> clientConnectionId;
+  folly::SocketAddress peerAddress;
+  std::chrono::microseconds srtt{0us};
+  uint64_t congestionWindow{0};
+  CongestionControlType congestionControlType{CongestionControlType::None};
+  // bytes of the packets sent and not acked or lost yet
+  uint64_t bytesInFlight{0};
+  uint64_t packetsInFlight{0};
+  uint64_t streamCount{0};
+  // stream data the app wrote that wasn't sent, and sent and not acked
+  uint64_t streamBytesBuffered{0};
+  uint64_t streamBytesUnacked{0};
+  // the worker the connection lives on
+  size_t workerId{0};
+};
+
+/**
+ * The connections to take snapshots of, those that pass all the filters
+ * that are set.
+ */
+struct ConnectionSnapshotFilter {
+  folly::Optional<folly::IPAddress> peerAddress;
+  folly::Optional<CongestionControlType> congestionControlType;
+  // of the bytes buffered and unacked together
+  folly::Optional<uint64_t> minStreamBytesBuffered;
+  folly::Optional<uint64_t> minBytesInFlight;
+
+  bool matches(const ConnectionSnapshot& snapshot) const;
+};
+
 class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
+                         public XdpSocket::ReadCallback,
+                         public IOUringReceiver::ReadCallback,
                          public QuicServerTransport::RoutingCallback {
  public:
   using TransportSettingsOverrideFn =
@@ -31,6 +98,14 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
           const quic::TransportSettings&,
           const folly::IPAddress&)>;
 
+  // Picks the settings profile a new connection is created with, given the
+  // client address. Profiles are built once and shared by every connection
+  // created with them, instead of a new TransportSettings per accept. A null
+  // profile falls back to the override function and the worker's settings.
+  using TransportSettingsProfileFn =
+      std::function<std::shared_ptr<const quic::TransportSettings>(
+          const folly::IPAddress&)>;
+
   class WorkerCallback {
    public:
     virtual ~WorkerCallback() = default;
@@ -59,6 +134,13 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   void setTransportSettingsOverrideFn(TransportSettingsOverrideFn fn);
 
+  /*
+   * Take in a function to pick a shared settings profile per connection.
+   * Preferred over the override function for experiments with few arms, as
+   * it doesn't build a TransportSettings for every new connection.
+   */
+  void setTransportSettingsProfileFn(TransportSettingsProfileFn fn);
+
   /**
    * Sets the listening socket
    */
@@ -76,6 +158,24 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   void bind(const folly::SocketAddress& address);
 
+  /**
+   * Adds another listening socket, bound to the address with the socket
+   * options of the worker, e.g. one per RX queue of the NIC the worker
+   * serves, so that the queues don't all funnel through the receive queue of
+   * one socket. The worker reads each of its sockets with recvmmsg, answers
+   * a packet out of the socket it came in on, and the connections it starts
+   * write out of that socket too. Must be called before start().
+   */
+  void addSocket(
+      std::unique_ptr<folly::AsyncUDPSocket> socket,
+      const folly::SocketAddress& address);
+
+  /**
+   * Number of listening sockets, the one set with setSocket and the added
+   * ones.
+   */
+  size_t getNumSockets() const;
+
   /**
    * start reading data from the socket
    */
@@ -102,6 +202,22 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   void applyAllSocketOptions();
 
+  /**
+   * Attaches a classic BPF program to the SO_REUSEPORT group of the socket
+   * that steers short header packets to the socket whose index in the group
+   * is the worker id in their connection id, as encoded by
+   * DefaultConnectionIdAlgo. Other packets keep the kernel's 4-tuple hash.
+   * This relies on the sockets of the group being bound in worker id order.
+   * Returns false if the platform or the socket does not support it.
+   */
+  bool attachConnectionIdSteering();
+
+  /**
+   * Sets SO_INCOMING_CPU on the bound socket at socketIndex, 0 being the one
+   * set with setSocket, see setSocketIncomingCpu.
+   */
+  bool setIncomingCpu(int cpu, size_t socketIndex = 0);
+
   /**
    * Initialize and bind given listening socket to the given takeover address
    * so that this server can accept and process misrouted packets forwarded
@@ -184,6 +300,12 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   void rejectNewConnections(bool rejectNewConnections);
 
+  /**
+   * Sets the observer of the worker's evb. With overloadControl it observes
+   * the loops behind the worker's OverloadController.
+   */
+  void setEventBaseObserver(std::shared_ptr<folly::EventBaseObserver> observer);
+
   /**
    * Enable/disable partial reliability on connection settings.
    */
@@ -208,6 +330,30 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   QuicTransportStatsCallback* getTransportInfoCallback() const noexcept;
 
+  /**
+   * What the stats counters of this worker counted so far, see
+   * TransportSettings::useStatsCounters. Can be called from any thread.
+   */
+  QuicTransportStatsCounters::Snapshot getStatsCountersSnapshot() const
+      noexcept;
+
+  /**
+   * The transports of the live connections of this worker, so that they can
+   * be snapshotted a few at a time. Not to be dereferenced, they can go away
+   * any time the worker runs.
+   */
+  std::vector<const QuicServerTransport*> getServerTransports() const;
+
+  /**
+   * Appends the snapshots of the connections that are still live and pass
+   * the filter, skipping the transports that went away since
+   * getServerTransports.
+   */
+  void snapshotConnections(
+      folly::Range<const QuicServerTransport* const*> transports,
+      const ConnectionSnapshotFilter& filter,
+      std::vector<ConnectionSnapshot>& snapshots) const;
+
   /**
    * Set ConnectionIdAlgo implementation to encode and decode ConnectionId with
    * various info, such as routing related info.
@@ -223,6 +369,31 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> factory);
 
+  /**
+   * Set the cache of congestion state, keyed by client subnet, that the
+   * connections warm start from
+   */
+  void setCongestionStateCache(std::shared_ptr<CongestionStateCache> cache);
+
+  /**
+   * Set the device that seals the 1-RTT packets of the connections, if the
+   * worker's socket supports it
+   */
+  void setCryptoOffload(std::shared_ptr<CryptoOffload> offload);
+
+  /**
+   * Set the helper threads the connections seal their 1-RTT packets on
+   * besides the worker's
+   */
+  void setCryptoWorkerPool(std::shared_ptr<CryptoWorkerPool> workers);
+
+  /**
+   * Set the NIC queue the worker reads from and writes to through an AF_XDP
+   * socket, next to its UDP socket. The worker only uses the UDP socket if
+   * the AF_XDP one can't be set up.
+   */
+  void setXdpSocketOptions(XdpSocketOptions options);
+
   // Read callback
   void getReadBuffer(void** buf, size_t* len) noexcept override;
 
@@ -231,6 +402,30 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       size_t len,
       bool truncated) noexcept override;
 
+  bool shouldOnlyNotify() override;
+
+  void onNotifyDataAvailable(folly::AsyncUDPSocket& sock) noexcept override;
+
+  // AF_XDP read callback
+  void onXdpPacket(
+      const folly::SocketAddress& client,
+      Buf data,
+      uint8_t ecn) noexcept override;
+
+  void onXdpReadDone() noexcept override;
+
+  // io_uring read callback
+  void onIOUringPacket(
+      IOUringReceiver& receiver,
+      const folly::SocketAddress& client,
+      Buf data,
+      struct msghdr& msg) noexcept override;
+
+  void onIOUringReadDone(IOUringReceiver& receiver) noexcept override;
+
+  void onIOUringReadError(IOUringReceiver& receiver, int error) noexcept
+      override;
+
   // Routing callback
   /**
    * Called when a connecton id is available for a new connection (i.e flow)
@@ -240,6 +435,14 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       QuicServerTransport::Ptr transport,
       ConnectionId id) noexcept override;
 
+  /**
+   * Called with the connection ids a connection issued together, making room
+   * for all of them in the connection id map at once.
+   */
+  void onConnectionIdsAvailable(
+      QuicServerTransport::Ptr transport,
+      const std::vector<ConnectionId>& ids) noexcept override;
+
   /**
    * Called when a connecton id is bound and ip address should not
    * be used any more for routing.
@@ -256,6 +459,17 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       const QuicServerTransport::SourceIdentity& source,
       const std::vector<ConnectionIdData>& connectionIdData) noexcept override;
 
+  /**
+   * Keeps the closed connection as an entry of drainingConnections_ for the
+   * rest of its drain period, when compactDrainingConnections is set.
+   */
+  bool onConnectionDraining(
+      QuicServerTransport* transport,
+      const folly::SocketAddress& peerAddress,
+      const std::vector<ConnectionIdData>& connectionIdData,
+      Buf closePacket,
+      std::chrono::milliseconds drainPeriod) noexcept override;
+
   void onReadError(const folly::AsyncSocketException& ex) noexcept override;
 
   void onReadClosed() noexcept override;
@@ -287,6 +501,49 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   void shutdownAllConnections(LocalErrorCode error);
 
+  /**
+   * Moves the connection to the target worker, e.g. to take load off this
+   * one. The target issues the peer a connection id routed to it, if the
+   * peer's limit leaves room for one, and the packets still routed here by
+   * the older ids are handed on to it. The connection's callbacks run on the
+   * target's evb from then on, which the app has to be ready for.
+   *
+   * Must be called on this worker's evb. Returns false, leaving the
+   * connection be, if it isn't bound to its connection ids yet, is closing
+   * or shares its congestion controller with a group.
+   */
+  bool migrateConnection(
+      const QuicServerTransport::Ptr& transport,
+      QuicServerWorker& target);
+
+  // The connection ids of a connection that moves, each with the workers
+  // that hand its packets on.
+  using MigratedConnectionIds = std::vector<
+      std::pair<ConnectionId, std::vector<QuicServerWorker*>>>;
+
+  /**
+   * Hands the connections of this worker that can carry on in the process
+   * taking over to it, see QuicServerTransport::exportHandoffState. They are
+   * closed here without the peer being told, and their packets dropped
+   * rather than reset from then on, until the other process picks them up.
+   * Returns the encoded states, see encodeConnectionHandoffState.
+   *
+   * Must be called on this worker's evb.
+   */
+  std::vector<Buf> handOffConnections();
+
+  /**
+   * Carries on a connection handed off by the process taken over, from its
+   * state. The given connection ids, those of the state routed to other
+   * workers, are handed on here by these workers. Returns false if the
+   * connection could not be taken up.
+   *
+   * Must be called on this worker's evb.
+   */
+  bool acceptHandedOffConnection(
+      const ConnectionHandoffState& state,
+      MigratedConnectionIds forwardedConnectionIds);
+
   // for unit test
   folly::AsyncUDPSocket::ReadCallback* getTakeoverHandlerCallback() {
     return takeoverCB_.get();
@@ -297,7 +554,17 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       const folly::SocketAddress& client,
       Buf data,
       const TimePoint& receiveTime,
-      bool isForwardedData = false) noexcept;
+      bool isForwardedData = false,
+      uint8_t ecn = kEcnNotEct) noexcept;
+
+  /**
+   * Between these two calls, short header packets passed to
+   * handleNetworkData are held back and routed when the batch finishes, the
+   * packets of the same client and connection id together in one
+   * NetworkData. Used around the datagrams of one recvmmsg().
+   */
+  void startRoutingBatch();
+  void finishRoutingBatch();
 
   /**
    * Try handling the data as a health check.
@@ -326,6 +593,32 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   }
 
  private:
+  /**
+   * Takes over a connection that migrateConnection moved here, on this
+   * worker's evb.
+   */
+  void adoptConnection(
+      QuicServerTransport::Ptr transport,
+      MigratedConnectionIds connectionIds);
+
+  /**
+   * Tells the workers that hand on the packets for the connection id of a
+   * connection that moved here that it is gone.
+   */
+  void forgetMigratedConnectionId(
+      const ConnectionId& id,
+      const std::vector<QuicServerWorker*>& forwarders);
+
+  /**
+   * Hands on a packet of a connection that moved to the given worker.
+   */
+  void forwardToMigratedConnection(
+      QuicServerWorker* worker,
+      const folly::SocketAddress& client,
+      RoutingData&& routingData,
+      NetworkData&& networkData,
+      bool isForwardedData);
+
   /**
    * Creates accepting socket from this server's listening address.
    * This socket is powered by the same underlying eventbase
@@ -343,18 +636,163 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       folly::EventBase* evb,
       int fd) const;
 
+  /**
+   * Queues a packet of a connection that is yet to be created, see
+   * TransportSettings::maxAcceptsPerLoop.
+   */
+  void queueAccept(
+      const folly::SocketAddress& client,
+      RoutingData&& routingData,
+      NetworkData&& networkData,
+      bool isForwardedData);
+
+  void processAcceptQueue();
+
+  class AcceptLoopCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit AcceptLoopCallback(QuicServerWorker& worker) : worker_(worker) {}
+
+    void runLoopCallback() noexcept override {
+      worker_.processAcceptQueue();
+    }
+
+   private:
+    QuicServerWorker& worker_;
+  };
+
+  // Reports what the stats counters counted since the last report.
+  void reportStatsCounters();
+
+  class StatsCountersTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    explicit StatsCountersTimeout(QuicServerWorker& worker)
+        : worker_(worker) {}
+
+    void timeoutExpired() noexcept override;
+
+    void callbackCanceled() noexcept override {
+      // the evb is going away, there is no callback to report to anymore
+    }
+
+   private:
+    QuicServerWorker& worker_;
+  };
+
   void sendResetPacket(
       const HeaderForm& headerForm,
       const folly::SocketAddress& client,
       const NetworkData& networkData,
       const ConnectionId& connId);
 
+  /**
+   * Whether the worker already sent statelessResetRateLimit resets in the
+   * current kStatelessResetRateLimitWindow.
+   */
+  bool statelessResetRateLimited(TimePoint now);
+
+  // the token of the stateless resets for connId, from the cache if it's set
+  StatelessResetToken getStatelessResetToken(const ConnectionId& connId);
+
+  // the pool of connection ids for the transports of the worker, nullptr
+  // without a connectionIdPoolSize
+  std::shared_ptr<ConnectionIdPool> getConnectionIdPool();
+
+  // sets the settings of a new transport from the profile or override
+  // function for the client, or the worker's own settings
+  void setTransportSettingsFor(
+      QuicServerTransport& trans,
+      const folly::IPAddress& clientIp);
+
+  // sets the settings of a new transport, degraded for the load of the worker
+  void setLoadedTransportSettings(
+      QuicServerTransport& trans,
+      TransportSettings settings);
+
+  // whether the worker is overloaded to at least the level
+  bool overloaded(OverloadController::Level level) const;
+
+  /**
+   * Whether the worker already started retryHandshakeRateLimit handshakes,
+   * or spent retryHandshakeTimeBudget on them, in the current
+   * kHandshakeAdmissionWindow.
+   */
+  bool handshakeBudgetExceeded(TimePoint now);
+
+  /**
+   * Has a new client prove its address with a Retry first, when the
+   * handshake budget is used up or the worker is overloaded. Returns whether
+   * the Initial was handled, by a Retry or a drop; otherwise the handshake
+   * goes ahead, with the destination connection id of the client's first
+   * Initial set if it came back with a valid token.
+   */
+  bool maybeSendRetry(
+      const folly::SocketAddress& client,
+      const NetworkData& networkData,
+      folly::Optional<ConnectionId>& retryOriginalDstConnId);
+
+  void sendRetryPacket(
+      const folly::SocketAddress& client,
+      const LongHeader& initialHeader,
+      std::chrono::seconds now);
+
+  /**
+   * Cheap checks on the raw bytes of a received datagram. Returns the reason
+   * to drop it for, or PacketDropReason::NONE if it should be handled.
+   */
+  QuicTransportStatsCallback::PacketDropReason prefilterPacket(
+      const uint8_t* data,
+      size_t len) const;
+
+  /**
+   * Runs prefilterPacket if enabled and counts the drop, returns true if the
+   * datagram was dropped.
+   */
+  bool maybePrefilterDrop(const uint8_t* data, size_t len);
+
   bool maybeSendVersionNegotiationPacketOrDrop(
       const folly::SocketAddress& client,
       bool isInitial,
-      LongHeaderInvariant& invariant);
+      LongHeaderInvariant& invariant,
+      TimePoint receiveTime);
+
+  bool isSupportedVersion(QuicVersion version) const {
+    // A handful of versions, a scan of them beats hashing.
+    return std::find(
+               supportedVersions_.begin(), supportedVersions_.end(), version) !=
+        supportedVersions_.end();
+  }
+
+  /**
+   * The version negotiation packet answering invariant, its version list is
+   * the one encoded in versions.
+   */
+  static Buf makeVersionNegotiationPacket(
+      const LongHeaderInvariant& invariant,
+      const folly::IOBuf& versions);
+
+  /**
+   * Whether the worker already sent versionNegotiationRateLimit version
+   * negotiations in the current kVersionNegotiationRateLimitWindow.
+   */
+  bool versionNegotiationRateLimited(TimePoint now);
+
+  // binds sock to address with socketOptions_
+  void bindSocket(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address);
+
+  // the listening socket at index, 0 being socket_
+  folly::AsyncUDPSocket& getSocket(size_t index) const;
+
+  // the listening socket the packet being handled came in on, which answers
+  // and new connections go out of
+  folly::AsyncUDPSocket& getReplySocket() const;
 
   std::unique_ptr<folly::AsyncUDPSocket> socket_;
+  // the sockets added with addSocket, socket index 1 onwards
+  std::vector<std::unique_ptr<folly::AsyncUDPSocket>> additionalSockets_;
+  // index of the socket the packet being handled came in on
+  size_t replySocketIndex_{0};
   folly::SocketOptionMap* socketOptions_{nullptr};
   std::shared_ptr<WorkerCallback> callback_;
   folly::EventBase* evb_{nullptr};
@@ -363,26 +801,117 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   QuicUDPSocketFactory* socketFactory_;
   QuicServerTransportFactory* transportFactory_;
   std::shared_ptr<CongestionControllerFactory> ccFactory_{nullptr};
+  std::shared_ptr<CongestionStateCache> congestionStateCache_;
+  // Groups of the connections from the same client subnet, with
+  // transportSettings.congestionControlGroups
+  CongestionControlGroupRegistry congestionControlGroups_;
 
   // A server transport's membership is exclusive to only one of these maps.
   ConnIdToTransportMap connectionIdMap_;
   SrcToTransportMap sourceAddressMap_;
+  // Looked up before connectionIdMap_, holds a subset of it.
+  std::unique_ptr<ConnectionIdRoutingTable<QuicServerTransport::Ptr>>
+      routingTable_;
 
   // Contains every unique transport that is mapped in connectionIdMap_.
   folly::F14FastSet<QuicServerTransport*> boundServerTransports_;
 
+  // The connection ids of the connections that moved to other workers, by
+  // the worker each moved to. Their packets are handed on to it.
+  folly::F14FastMap<ConnectionId, QuicServerWorker*, ConnectionIdHash>
+      migratedConnectionIds_;
+  // The connection ids of the connections that moved here, with the workers
+  // that hand their packets on, to be told once the connection is gone.
+  folly::F14FastMap<
+      ConnectionId,
+      std::vector<QuicServerWorker*>,
+      ConnectionIdHash>
+      adoptedConnectionIds_;
+  // The connection ids of the connections handed off to another process,
+  // whose packets it picks up once it has the connections.
+  folly::F14FastSet<ConnectionId, ConnectionIdHash> handedOffConnectionIds_;
+  // The closed connections whose transports are gone, answered from here
+  // until their drain period is over. The entries past it are dropped as new
+  // ones come in.
+  DrainingConnectionTable drainingConnections_;
+
   Buf readBuffer_;
+  RecvmmsgStorage recvmmsgStorage_;
+
+  struct PendingRoute {
+    folly::SocketAddress client;
+    RoutingData routingData;
+    NetworkData networkData;
+  };
+  bool routingBatch_{false};
+  std::vector<PendingRoute> pendingRoutes_;
+
+  struct PendingAccept {
+    folly::SocketAddress client;
+    RoutingData routingData;
+    NetworkData networkData;
+    bool isForwardedData;
+  };
+  std::deque<PendingAccept> acceptQueue_;
+  // Number of queued packets of every source in acceptQueue_, packets of
+  // these sources are queued behind the Initial creating their connection.
+  folly::F14FastMap<
+      QuicServerTransport::SourceIdentity,
+      size_t,
+      SourceIdentityHash>
+      pendingAcceptSources_;
+  AcceptLoopCallback acceptLoopCallback_{*this};
+  bool processingAccepts_{false};
   bool shutdown_{false};
   std::vector<QuicVersion> supportedVersions_;
   std::shared_ptr<const fizz::server::FizzServerContext> ctx_;
   TransportSettings transportSettings_;
   folly::Optional<Buf> healthCheckToken_;
+  // only made once Retry is enabled
+  std::unique_ptr<RetryTokenGenerator> retryTokenGenerator_;
+  // what the handshakes started in the current kHandshakeAdmissionWindow
+  // took
+  TimePoint handshakeWindowStart_;
+  uint32_t handshakesInWindow_{0};
+  std::chrono::microseconds handshakeTimeInWindow_{0};
+  // only made once the first reset is sent
+  std::unique_ptr<StatelessResetGenerator> statelessResetGenerator_;
+  // only made with a statelessResetTokenCacheSize
+  std::unique_ptr<folly::EvictingCacheMap<
+      ConnectionId,
+      StatelessResetToken,
+      ConnectionIdHash>>
+      statelessResetTokens_;
+  // only made with a connectionIdPoolSize, anew when the worker's ids change
+  std::shared_ptr<ConnectionIdPool> connIdPool_;
+  // the resets sent in the current kStatelessResetRateLimitWindow
+  TimePoint statelessResetWindowStart_;
+  uint32_t statelessResetsInWindow_{0};
+  // The version lists of the version negotiation packets, encoded once: the
+  // supported versions, and the invalid one sent while rejecting new
+  // connections.
+  Buf versionNegotiationVersions_;
+  Buf rejectionVersions_;
+  // the version negotiations sent in the current
+  // kVersionNegotiationRateLimitWindow
+  TimePoint versionNegotiationWindowStart_;
+  uint32_t versionNegotiationsInWindow_{0};
   bool rejectNewConnections_{false};
   uint8_t workerId_{0};
   std::unique_ptr<ConnectionIdAlgo> connIdAlgo_;
   uint16_t hostId_{0};
   // QuicServerWorker maintains ownership of the info stats callback
   std::unique_ptr<QuicTransportStatsCallback> infoCallback_;
+  // Written on the evb only, padded so that snapshots from other threads
+  // don't share its cache lines with anything the evb writes.
+  std::unique_ptr<folly::CachelinePadded<QuicTransportStatsCounters>>
+      statsCountersStorage_{std::make_unique<
+          folly::CachelinePadded<QuicTransportStatsCounters>>()};
+  // The counters the stats events are counted in, set once the worker starts
+  // with useStatsCounters
+  QuicTransportStatsCounters* statsCounters_{nullptr};
+  QuicTransportStatsCounters::Snapshot lastStatsCounters_{};
+  StatsCountersTimeout statsCountersTimeout_{*this};
 
   // Handle takeover between processes
   std::unique_ptr<TakeoverHandlerCallback> takeoverCB_;
@@ -392,8 +921,69 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   using PacketDropReason = QuicTransportStatsCallback::PacketDropReason;
   TimerHighRes::SharedPtr pacingTimer_;
 
+  // Packet buffers shared by the write path of all transports of this worker
+  std::shared_ptr<PacketBufferPool> bufPool_;
+
+  // Writes the packets of all the transports of this worker together, only
+  // set when batchWritesAcrossConnections is enabled
+  std::shared_ptr<MultiDestBatchWriter> multiDestWriter_;
+
+  // Runs the writes of all the unpaced transports of this worker at the end
+  // of the loop, only set when deferWritesToEndOfLoop is enabled
+  std::shared_ptr<DeferredWriteScheduler> deferredWriteScheduler_;
+
+  // Runs the paced writes of all the transports of this worker by pacing
+  // timer tick, only set when sharedPacingCalendar is enabled
+  std::shared_ptr<PacingCalendar> pacingCalendar_;
+
+  // Runs the loopers of all the transports of this worker, only set when
+  // sharedLooperQueue is enabled
+  std::shared_ptr<LooperQueue> looperQueue_;
+
+  // The time of this worker's evb, refreshed on every batch of reads, only
+  // set when coarseClock is enabled
+  std::shared_ptr<CoarseClock> coarseClock_;
+
+  // The Initial ciphers of the recent connections of this worker, only set
+  // with an initialCipherCacheSize
+  std::shared_ptr<InitialCipherCache> initialCipherCache_;
+
+  // The decoded app tokens of the recent resumptions on this worker, only set
+  // with an appTokenCacheSize
+  std::shared_ptr<AppTokenCache> appTokenCache_;
+
+  // The encoded transport parameters of the settings of this worker's
+  // connections, only set with a transportParametersCacheSize
+  std::shared_ptr<ServerTransportParametersCache> transportParametersCache_;
+
+  // What the auto tuned connection windows of the transports of this worker
+  // grow out of, only set with an autoTunedWindowWorkerBudget
+  std::shared_ptr<FlowControlWindowBudget> flowControlWindowBudget_;
+
+  // The load of this worker, which degrades what new connections get, only
+  // set when overloadControl is enabled
+  std::shared_ptr<OverloadController> overloadController_;
+
+  // Whether SO_TXTIME could be turned on for the socket, only tried when
+  // txTimePacing is enabled
+  bool socketTxTimeEnabled_{false};
+
+  std::shared_ptr<CryptoOffload> cryptoOffload_;
+  // Whether cryptoOffload_ supports the socket, probed when the worker starts
+  bool cryptoOffloadEnabled_{false};
+
+  std::shared_ptr<CryptoWorkerPool> cryptoWorkers_;
+
+  folly::Optional<XdpSocketOptions> xdpSocketOptions_;
+  // set up when the worker starts, shared with the transports
+  std::shared_ptr<XdpSocket> xdpSocket_;
+  // With ioUringRecv, what reads the sockets, in their order. Empty when the
+  // sockets are read through their own read callbacks.
+  std::vector<std::shared_ptr<IOUringReceiver>> ioUringReceivers_;
+
   // Used to override certain transport parameters, given the client address
   TransportSettingsOverrideFn transportSettingsOverrideFn_;
+  TransportSettingsProfileFn transportSettingsProfileFn_;
 };
 
 } // namespace quic
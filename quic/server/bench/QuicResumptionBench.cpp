@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// The server side of a resumption: encrypting the ticket, decrypting it, and
+// decoding the app token in it, the way DefaultAppTokenValidator does. The
+// tickets are encrypted and decrypted with an AES128TicketCipher, directly
+// and through a RotatingTicketCipher. The app tokens are decoded every time,
+// and once per token through an AppTokenCache, for kBenchHotTickets clients
+// resuming from their tickets again and again.
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <folly/init/Init.h>
+
+#include <fizz/server/ResumptionState.h>
+#include <quic/server/handshake/AppToken.h>
+#include <quic/server/handshake/RotatingTicketCipher.h>
+
+#include <vector>
+
+using namespace quic;
+
+namespace {
+
+constexpr size_t kBenchHotTickets = 16;
+constexpr size_t kBenchAppTokenCacheSize = 64;
+const std::string kBenchTicketSecret = "ticketSecretThatIsLongEnoughForAES";
+
+std::unique_ptr<folly::IOBuf> makeAppToken(size_t client) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      kDefaultIdleTimeout.count(),
+      kDefaultUDPReadBufferSize,
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.sourceAddresses = {
+      folly::IPAddress(folly::to<std::string>("10.0.0.", client)),
+      folly::IPAddress("2401:db00::1")};
+  appToken.version = QuicVersion::MVFST;
+  appToken.appParams = folly::IOBuf::copyBuffer("app params");
+  return encodeAppToken(appToken);
+}
+
+fizz::server::ResumptionState makeResumptionState() {
+  fizz::server::ResumptionState resState;
+  resState.version = fizz::ProtocolVersion::tls_1_3;
+  resState.cipher = fizz::CipherSuite::TLS_AES_128_GCM_SHA256;
+  resState.resumptionSecret = folly::IOBuf::copyBuffer("resumptionSecret");
+  resState.alpn = "h3";
+  resState.ticketAgeAdd = 0x12345678;
+  resState.ticketIssueTime = std::chrono::system_clock::now();
+  resState.appToken = makeAppToken(0);
+  return resState;
+}
+
+void encryptTicket(size_t iters, const fizz::server::TicketCipher& cipher) {
+  while (iters--) {
+    folly::Optional<fizz::server::ResumptionState> resState;
+    BENCHMARK_SUSPEND {
+      resState.emplace(makeResumptionState());
+    }
+    folly::doNotOptimizeAway(cipher.encrypt(std::move(*resState)).get());
+  }
+}
+
+void decryptTicket(size_t iters, const fizz::server::TicketCipher& cipher) {
+  std::unique_ptr<folly::IOBuf> ticket;
+  BENCHMARK_SUSPEND {
+    ticket = std::move(cipher.encrypt(makeResumptionState()).get()->first);
+  }
+  while (iters--) {
+    folly::doNotOptimizeAway(cipher.decrypt(ticket->clone()).get());
+  }
+}
+
+std::vector<std::unique_ptr<folly::IOBuf>> makeHotAppTokens() {
+  std::vector<std::unique_ptr<folly::IOBuf>> appTokens;
+  for (size_t client = 0; client < kBenchHotTickets; ++client) {
+    appTokens.push_back(makeAppToken(client));
+  }
+  return appTokens;
+}
+
+} // namespace
+
+BENCHMARK(EncryptTicket, iters) {
+  auto cipher =
+      RotatingTicketCipher::makeAes128TicketCipher({kBenchTicketSecret});
+  encryptTicket(iters, *cipher);
+}
+
+BENCHMARK_RELATIVE(EncryptTicketRotating, iters) {
+  RotatingTicketCipher cipher(kBenchTicketSecret);
+  encryptTicket(iters, cipher);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(DecryptTicket, iters) {
+  auto cipher =
+      RotatingTicketCipher::makeAes128TicketCipher({kBenchTicketSecret});
+  decryptTicket(iters, *cipher);
+}
+
+BENCHMARK_RELATIVE(DecryptTicketRotating, iters) {
+  RotatingTicketCipher cipher(kBenchTicketSecret);
+  decryptTicket(iters, cipher);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(DecodeAppToken, iters) {
+  std::vector<std::unique_ptr<folly::IOBuf>> appTokens;
+  BENCHMARK_SUSPEND {
+    appTokens = makeHotAppTokens();
+  }
+  for (size_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(
+        decodeAppToken(*appTokens[i % appTokens.size()]));
+  }
+}
+
+BENCHMARK_RELATIVE(DecodeAppTokenCached, iters) {
+  std::vector<std::unique_ptr<folly::IOBuf>> appTokens;
+  AppTokenCache cache(kBenchAppTokenCacheSize);
+  BENCHMARK_SUSPEND {
+    appTokens = makeHotAppTokens();
+  }
+  for (size_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(
+        cache.getAppToken(*appTokens[i % appTokens.size()]));
+  }
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// How fast a server worker routes the datagrams it reads to their
+// connections, with 10K to 1M connection ids bound. The transports count the
+// packets they are handed instead of reading them, so this is the routing
+// alone: each iteration is one datagram through handleNetworkData and
+// dispatchPacketData on one core, iters/s is packets per second per core.
+// Changes to how connection ids are routed are to be measured with it.
+
+#include <folly/Benchmark.h>
+#include <folly/Optional.h>
+#include <folly/init/Init.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+
+#include <quic/codec/DefaultConnectionIdAlgo.h>
+#include <quic/server/QuicServerTransport.h>
+#include <quic/server/QuicServerWorker.h>
+
+#include <random>
+
+using namespace quic;
+
+namespace {
+
+// The connection ids are spread over these, the lookups don't depend on how
+// many connections they belong to.
+constexpr size_t kNumTransports = 1024;
+// Picked at random from the bound connection ids, so that the lookups miss
+// the cache as they would with that many connections.
+constexpr size_t kNumDatagrams = 1 << 14;
+constexpr uint16_t kHostId = 7;
+constexpr uint8_t kWorkerId = 3;
+
+enum class DatagramType {
+  ShortHeader,
+  // The Initials the client sends once it has the server chosen id.
+  Initial,
+};
+
+// Without a file descriptor, the transports only ask it for its address.
+class UnboundUDPSocket : public folly::AsyncUDPSocket {
+ public:
+  explicit UnboundUDPSocket(folly::EventBase* evb)
+      : folly::AsyncUDPSocket(evb) {}
+
+  const folly::SocketAddress& address() const override {
+    return address_;
+  }
+
+  void pauseRead() override {}
+
+  void close() override {}
+
+ private:
+  folly::SocketAddress address_{"127.0.0.1", 443};
+};
+
+class NoopConnectionCallback : public QuicSocket::ConnectionCallback {
+ public:
+  void onNewBidirectionalStream(StreamId) noexcept override {}
+  void onNewUnidirectionalStream(StreamId) noexcept override {}
+  void onStopSending(StreamId, ApplicationErrorCode) noexcept override {}
+  void onConnectionEnd() noexcept override {}
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string>) noexcept override {}
+};
+
+class CountingServerTransport : public QuicServerTransport {
+ public:
+  CountingServerTransport(folly::EventBase* evb, ConnectionCallback& cb)
+      : QuicServerTransport(
+            evb,
+            std::make_unique<UnboundUDPSocket>(evb),
+            cb,
+            nullptr) {}
+
+  void onNetworkData(
+      const folly::SocketAddress& /*peer*/,
+      NetworkData&& data) noexcept override {
+    packets += data.packets.size();
+  }
+
+  uint64_t packets{0};
+};
+
+// A server of a single worker, which routes to itself.
+class DirectWorkerCallback : public QuicServerWorker::WorkerCallback {
+ public:
+  void handleWorkerError(LocalErrorCode /*error*/) override {}
+
+  void routeDataToWorker(
+      const folly::SocketAddress& client,
+      RoutingData&& routingData,
+      NetworkData&& networkData,
+      bool isForwardedData) override {
+    worker->dispatchPacketData(
+        client,
+        std::move(routingData),
+        std::move(networkData),
+        isForwardedData);
+  }
+
+  QuicServerWorker* worker{nullptr};
+};
+
+Buf makeShortHeaderDatagram(const ConnectionId& connId) {
+  auto datagram = folly::IOBuf::create(kDefaultUDPSendPacketLen);
+  folly::io::Appender appender(datagram.get(), 0);
+  appender.writeBE<uint8_t>(ShortHeader::kFixedBitMask);
+  appender.push(connId.data(), connId.size());
+  datagram->append(kDefaultUDPSendPacketLen - datagram->length());
+  return datagram;
+}
+
+Buf makeInitialDatagram(const ConnectionId& connId, std::mt19937& random) {
+  std::vector<uint8_t> srcConnId(kDefaultConnectionIdSize);
+  for (auto& byte : srcConnId) {
+    byte = static_cast<uint8_t>(random());
+  }
+  auto datagram = folly::IOBuf::create(kMinInitialPacketSize);
+  folly::io::Appender appender(datagram.get(), 0);
+  appender.writeBE<uint8_t>(
+      kHeaderFormMask | LongHeader::kFixedBitMask |
+      (static_cast<uint8_t>(LongHeader::Types::Initial)
+       << LongHeader::kTypeShift));
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(QuicVersion::MVFST));
+  appender.writeBE<uint8_t>(connId.size());
+  appender.push(connId.data(), connId.size());
+  appender.writeBE<uint8_t>(srcConnId.size());
+  appender.push(srcConnId.data(), srcConnId.size());
+  datagram->append(kMinInitialPacketSize - datagram->length());
+  return datagram;
+}
+
+class DispatchBench {
+ public:
+  DispatchBench(size_t numConnIds, bool routingTable)
+      : numConnIds_(numConnIds),
+        routingTable_(routingTable),
+        client_("1.2.3.4", 1234),
+        callback_(std::make_shared<DirectWorkerCallback>()),
+        worker_(std::make_unique<QuicServerWorker>(callback_)) {
+    callback_->worker = worker_.get();
+    worker_->setSocket(std::make_unique<UnboundUDPSocket>(&evb_));
+    worker_->setHostId(kHostId);
+    worker_->setProcessId(ProcessId::ZERO);
+    worker_->setWorkerId(kWorkerId);
+    worker_->setConnectionIdAlgo(std::make_unique<DefaultConnectionIdAlgo>());
+    worker_->setSupportedVersions({QuicVersion::MVFST});
+    TransportSettings settings;
+    if (routingTable) {
+      settings.connectionIdRoutingTableSize = numConnIds;
+    }
+    worker_->setTransportSettings(settings);
+
+    for (size_t i = 0; i < kNumTransports; ++i) {
+      transports_.push_back(
+          std::make_shared<CountingServerTransport>(&evb_, connCallback_));
+    }
+    connIds_.resize(kNumTransports);
+    DefaultConnectionIdAlgo connIdAlgo;
+    ServerConnectionIdParams params(
+        kHostId, static_cast<uint8_t>(ProcessId::ZERO), kWorkerId);
+    for (size_t i = 0; i < numConnIds; ++i) {
+      auto connId = connIdAlgo.encodeConnectionId(params).value();
+      auto& transportConnIds = connIds_[i % kNumTransports];
+      transportConnIds.emplace_back(connId, transportConnIds.size());
+      worker_->onConnectionIdAvailable(transports_[i % kNumTransports], connId);
+    }
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<size_t> pick(0, numConnIds - 1);
+    for (size_t i = 0; i < kNumDatagrams; ++i) {
+      auto index = pick(random);
+      const auto& connId =
+          connIds_[index % kNumTransports][index / kNumTransports].connId;
+      shortHeaderDatagrams_.push_back(makeShortHeaderDatagram(connId));
+      initialDatagrams_.push_back(makeInitialDatagram(connId, random));
+    }
+  }
+
+  ~DispatchBench() {
+    // Unbound, the worker leaves the transports be when it shuts down.
+    for (size_t i = 0; i < kNumTransports; ++i) {
+      worker_->onConnectionUnbound(
+          transports_[i].get(),
+          std::make_pair(client_, connIds_[i].front().connId),
+          connIds_[i]);
+    }
+    worker_.reset();
+    transports_.clear();
+  }
+
+  bool matches(size_t numConnIds, bool routingTable) const {
+    return numConnIds_ == numConnIds && routingTable_ == routingTable;
+  }
+
+  void dispatch(DatagramType type, size_t i, const TimePoint& receiveTime) {
+    auto& datagrams = type == DatagramType::ShortHeader
+        ? shortHeaderDatagrams_
+        : initialDatagrams_;
+    worker_->handleNetworkData(
+        client_, datagrams[i % kNumDatagrams]->clone(), receiveTime);
+  }
+
+  // The packets the transports were handed since the last call.
+  uint64_t takeRoutedPackets() {
+    uint64_t routed = 0;
+    for (auto& transport : transports_) {
+      routed += transport->packets;
+      transport->packets = 0;
+    }
+    return routed;
+  }
+
+ private:
+  size_t numConnIds_;
+  bool routingTable_;
+  folly::SocketAddress client_;
+  folly::EventBase evb_;
+  NoopConnectionCallback connCallback_;
+  std::shared_ptr<DirectWorkerCallback> callback_;
+  std::unique_ptr<QuicServerWorker> worker_;
+  std::vector<std::shared_ptr<CountingServerTransport>> transports_;
+  // By transport
+  std::vector<std::vector<ConnectionIdData>> connIds_;
+  std::vector<Buf> shortHeaderDatagrams_;
+  std::vector<Buf> initialDatagrams_;
+};
+
+// Kept from one run of a benchmark to the next, binding a million connection
+// ids takes longer than the runs themselves.
+folly::Optional<DispatchBench> cachedBench;
+
+DispatchBench& getDispatchBench(size_t numConnIds, bool routingTable) {
+  if (!cachedBench || !cachedBench->matches(numConnIds, routingTable)) {
+    cachedBench.clear();
+    cachedBench.emplace(numConnIds, routingTable);
+  }
+  return *cachedBench;
+}
+
+void dispatch(
+    uint32_t iters,
+    DatagramType type,
+    size_t numConnIds,
+    bool routingTable) {
+  DispatchBench* bench = nullptr;
+  TimePoint receiveTime;
+  BENCHMARK_SUSPEND {
+    bench = &getDispatchBench(numConnIds, routingTable);
+    receiveTime = Clock::now();
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    bench->dispatch(type, i, receiveTime);
+  }
+  BENCHMARK_SUSPEND {
+    CHECK_EQ(bench->takeRoutedPackets(), iters);
+  }
+}
+
+void shortHeader(uint32_t iters, size_t numConnIds) {
+  dispatch(iters, DatagramType::ShortHeader, numConnIds, false);
+}
+
+void shortHeaderRoutingTable(uint32_t iters, size_t numConnIds) {
+  dispatch(iters, DatagramType::ShortHeader, numConnIds, true);
+}
+
+void initial(uint32_t iters, size_t numConnIds) {
+  dispatch(iters, DatagramType::Initial, numConnIds, false);
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(shortHeader, 10K, 10000)
+BENCHMARK_NAMED_PARAM(shortHeader, 100K, 100000)
+BENCHMARK_NAMED_PARAM(shortHeader, 1M, 1000000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(shortHeaderRoutingTable, 10K, 10000)
+BENCHMARK_NAMED_PARAM(shortHeaderRoutingTable, 100K, 100000)
+BENCHMARK_NAMED_PARAM(shortHeaderRoutingTable, 1M, 1000000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(initial, 10K, 10000)
+BENCHMARK_NAMED_PARAM(initial, 100K, 100000)
+BENCHMARK_NAMED_PARAM(initial, 1M, 1000000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  cachedBench.clear();
+  return 0;
+}
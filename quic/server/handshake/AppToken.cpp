@@ -94,4 +94,26 @@ folly::Optional<AppToken> decodeAppToken(const folly::IOBuf& buf) {
   return appToken;
 }
 
+AppTokenCache::AppTokenCache(size_t maxSize) : cache_(maxSize) {}
+
+std::shared_ptr<const AppToken> AppTokenCache::getAppToken(
+    const folly::IOBuf& buf) {
+  auto key = buf.cloneCoalescedAsValue().moveToFbString().toStdString();
+  auto it = cache_.find(key);
+  if (it != cache_.end()) {
+    return it->second;
+  }
+  auto appToken = decodeAppToken(buf);
+  if (!appToken) {
+    return nullptr;
+  }
+  auto decoded = std::make_shared<const AppToken>(std::move(*appToken));
+  cache_.set(std::move(key), decoded);
+  return decoded;
+}
+
+size_t AppTokenCache::size() const {
+  return cache_.size();
+}
+
 } // namespace quic
@@ -14,8 +14,11 @@
 #include <fizz/server/State.h>
 #include <folly/IPAddress.h>
 #include <folly/Optional.h>
+#include <folly/container/EvictingCacheMap.h>
 
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace fizz {
@@ -51,6 +54,29 @@ std::unique_ptr<folly::IOBuf> encodeAppToken(const AppToken& appToken);
 
 folly::Optional<AppToken> decodeAppToken(const folly::IOBuf& buf);
 
+/**
+ * The decoded app tokens of the most recent resumptions, keyed by the encoded
+ * token, so that clients resuming from the same ticket again and again don't
+ * have it decoded every time.
+ *
+ * Not thread safe, meant to be kept by a server worker.
+ */
+class AppTokenCache {
+ public:
+  explicit AppTokenCache(size_t maxSize);
+
+  /**
+   * The decoded token, or nullptr if it doesn't decode. Failures aren't
+   * cached.
+   */
+  std::shared_ptr<const AppToken> getAppToken(const folly::IOBuf& buf);
+
+  size_t size() const;
+
+ private:
+  folly::EvictingCacheMap<std::string, std::shared_ptr<const AppToken>> cache_;
+};
+
 class FailingAppTokenValidator : public fizz::server::AppTokenValidator {
   bool validate(const fizz::server::ResumptionState&) const override {
     return false;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/AsyncSigningSelfCert.h>
+
+namespace quic {
+
+AsyncSigningSelfCert::AsyncSigningSelfCert(
+    std::shared_ptr<const fizz::SelfCert> cert,
+    folly::Executor* executor)
+    : cert_(std::move(cert)) {
+  CHECK(cert_);
+  CHECK(executor);
+  signer_ = [cert = cert_, executor](
+                fizz::SignatureScheme scheme,
+                fizz::CertificateVerifyContext context,
+                std::unique_ptr<folly::IOBuf> data) {
+    return folly::via(
+        executor,
+        [cert, scheme, context, data = std::move(data)]()
+            -> folly::Optional<fizz::Buf> {
+          return cert->sign(scheme, context, data->coalesce());
+        });
+  };
+}
+
+AsyncSigningSelfCert::AsyncSigningSelfCert(
+    std::shared_ptr<const fizz::SelfCert> cert,
+    SignFunction signer)
+    : cert_(std::move(cert)), signer_(std::move(signer)) {
+  CHECK(cert_);
+  CHECK(signer_);
+}
+
+std::string AsyncSigningSelfCert::getIdentity() const {
+  return cert_->getIdentity();
+}
+
+std::vector<std::string> AsyncSigningSelfCert::getAltIdentities() const {
+  return cert_->getAltIdentities();
+}
+
+std::vector<fizz::SignatureScheme> AsyncSigningSelfCert::getSigSchemes()
+    const {
+  return cert_->getSigSchemes();
+}
+
+fizz::CertificateMsg AsyncSigningSelfCert::getCertMessage(
+    fizz::Buf certificateRequestContext) const {
+  return cert_->getCertMessage(std::move(certificateRequestContext));
+}
+
+fizz::CompressedCertificate AsyncSigningSelfCert::getCompressedCert(
+    fizz::CertificateCompressionAlgorithm algo) const {
+  return cert_->getCompressedCert(algo);
+}
+
+folly::ssl::X509UniquePtr AsyncSigningSelfCert::getX509() const {
+  return cert_->getX509();
+}
+
+fizz::Buf AsyncSigningSelfCert::sign(
+    fizz::SignatureScheme scheme,
+    fizz::CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  return cert_->sign(scheme, context, toBeSigned);
+}
+
+folly::Future<folly::Optional<fizz::Buf>> AsyncSigningSelfCert::signFuture(
+    fizz::SignatureScheme scheme,
+    fizz::CertificateVerifyContext context,
+    std::unique_ptr<folly::IOBuf> data) const {
+  return signer_(scheme, context, std::move(data));
+}
+
+} // namespace quic
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/server/AsyncSelfCert.h>
+
+#include <folly/Executor.h>
+#include <folly/futures/Future.h>
+
+#include <functional>
+#include <memory>
+
+namespace quic {
+
+/**
+ * A server certificate whose CertificateVerify signature is made off the
+ * event base, so that a full handshake doesn't stall the other connections
+ * of the worker while the signature is computed. fizz hands the signature
+ * back on the evb of the connection, and ServerHandshake resumes the
+ * handshake from there like after any other async action. Meanwhile the
+ * transport keeps the packets of the connection that it can't process yet.
+ *
+ * Install it in the cert manager of the server's FizzServerContext instead
+ * of the certificate it wraps.
+ */
+class AsyncSigningSelfCert : public fizz::server::AsyncSelfCert {
+ public:
+  using SignFunction =
+      std::function<folly::Future<folly::Optional<fizz::Buf>>(
+          fizz::SignatureScheme,
+          fizz::CertificateVerifyContext,
+          std::unique_ptr<folly::IOBuf>)>;
+
+  /**
+   * Signs with the key of the certificate on the executor, e.g. a pool of
+   * CPU threads.
+   */
+  AsyncSigningSelfCert(
+      std::shared_ptr<const fizz::SelfCert> cert,
+      folly::Executor* executor);
+
+  /**
+   * Has the signer make the signatures, e.g. a remote key server or a
+   * hardware accelerator. The future may complete on any thread.
+   */
+  AsyncSigningSelfCert(
+      std::shared_ptr<const fizz::SelfCert> cert,
+      SignFunction signer);
+
+  ~AsyncSigningSelfCert() override = default;
+
+  std::string getIdentity() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  std::vector<fizz::SignatureScheme> getSigSchemes() const override;
+
+  fizz::CertificateMsg getCertMessage(
+      fizz::Buf certificateRequestContext = nullptr) const override;
+
+  fizz::CompressedCertificate getCompressedCert(
+      fizz::CertificateCompressionAlgorithm algo) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  /**
+   * Signs synchronously with the wrapped certificate.
+   */
+  fizz::Buf sign(
+      fizz::SignatureScheme scheme,
+      fizz::CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  folly::Future<folly::Optional<fizz::Buf>> signFuture(
+      fizz::SignatureScheme scheme,
+      fizz::CertificateVerifyContext context,
+      std::unique_ptr<folly::IOBuf> data) const override;
+
+ private:
+  std::shared_ptr<const fizz::SelfCert> cert_;
+  SignFunction signer_;
+};
+
+} // namespace quic
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/CompressingSelfCert.h>
+
+#include <stdexcept>
+
+namespace quic {
+
+CompressingSelfCert::CompressingSelfCert(
+    std::shared_ptr<const fizz::SelfCert> cert,
+    const std::vector<std::shared_ptr<fizz::CertificateCompressor>>&
+        compressors)
+    : cert_(std::move(cert)) {
+  CHECK(cert_);
+  auto certMessage = cert_->getCertMessage();
+  for (const auto& compressor : compressors) {
+    CHECK(compressor);
+    auto algo = compressor->getAlgorithm();
+    if (compressedCerts_.count(algo)) {
+      continue;
+    }
+    compressedCerts_.emplace(algo, compressor->compress(certMessage));
+    algorithms_.push_back(algo);
+  }
+}
+
+std::string CompressingSelfCert::getIdentity() const {
+  return cert_->getIdentity();
+}
+
+std::vector<std::string> CompressingSelfCert::getAltIdentities() const {
+  return cert_->getAltIdentities();
+}
+
+std::vector<fizz::SignatureScheme> CompressingSelfCert::getSigSchemes() const {
+  return cert_->getSigSchemes();
+}
+
+fizz::CertificateMsg CompressingSelfCert::getCertMessage(
+    fizz::Buf certificateRequestContext) const {
+  return cert_->getCertMessage(std::move(certificateRequestContext));
+}
+
+fizz::CompressedCertificate CompressingSelfCert::getCompressedCert(
+    fizz::CertificateCompressionAlgorithm algo) const {
+  auto it = compressedCerts_.find(algo);
+  if (it == compressedCerts_.end()) {
+    throw std::runtime_error("Cert not compressed with the algorithm");
+  }
+  fizz::CompressedCertificate compressed;
+  compressed.algorithm = it->second.algorithm;
+  compressed.uncompressed_length = it->second.uncompressed_length;
+  compressed.compressed_certificate_message =
+      it->second.compressed_certificate_message->clone();
+  return compressed;
+}
+
+folly::ssl::X509UniquePtr CompressingSelfCert::getX509() const {
+  return cert_->getX509();
+}
+
+fizz::Buf CompressingSelfCert::sign(
+    fizz::SignatureScheme scheme,
+    fizz::CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  return cert_->sign(scheme, context, toBeSigned);
+}
+
+std::vector<fizz::CertificateCompressionAlgorithm>
+CompressingSelfCert::getCompressionAlgorithms() const {
+  return algorithms_;
+}
+
+} // namespace quic
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/compression/CertificateCompressor.h>
+#include <fizz/protocol/Certificate.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * A server certificate that can be sent compressed (RFC 8879) to the clients
+ * that support one of its algorithms. A large chain otherwise takes enough
+ * Handshake packets for the server to hit the anti-amplification limit
+ * before the client's address is validated, and to wait a round trip for
+ * the rest of its flight.
+ *
+ * The chain is compressed once with each compressor, e.g. fizz's
+ * ZlibCertificateCompressor, up front. Install it in the cert manager of the
+ * server's FizzServerContext instead of the certificate it wraps, and set
+ * getCompressionAlgorithms() as the supported compression algorithms of the
+ * context, clients then negotiate the compression with the handshake. It
+ * goes inside an AsyncSigningSelfCert, if there is one, since it signs
+ * synchronously.
+ */
+class CompressingSelfCert : public fizz::SelfCert {
+ public:
+  CompressingSelfCert(
+      std::shared_ptr<const fizz::SelfCert> cert,
+      const std::vector<std::shared_ptr<fizz::CertificateCompressor>>&
+          compressors);
+
+  ~CompressingSelfCert() override = default;
+
+  std::string getIdentity() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  std::vector<fizz::SignatureScheme> getSigSchemes() const override;
+
+  fizz::CertificateMsg getCertMessage(
+      fizz::Buf certificateRequestContext = nullptr) const override;
+
+  /**
+   * Throws if the chain wasn't compressed with the algorithm, which the
+   * server only negotiates if it is missing from its context.
+   */
+  fizz::CompressedCertificate getCompressedCert(
+      fizz::CertificateCompressionAlgorithm algo) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  fizz::Buf sign(
+      fizz::SignatureScheme scheme,
+      fizz::CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  // the algorithms the chain was compressed with, in the compressors' order
+  std::vector<fizz::CertificateCompressionAlgorithm> getCompressionAlgorithms()
+      const;
+
+ private:
+  std::shared_ptr<const fizz::SelfCert> cert_;
+  std::vector<fizz::CertificateCompressionAlgorithm> algorithms_;
+  std::map<fizz::CertificateCompressionAlgorithm, fizz::CompressedCertificate>
+      compressedCerts_;
+};
+
+} // namespace quic
@@ -12,6 +12,7 @@
 #include <quic/api/QuicSocket.h>
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/handshake/TransportParameters.h>
+#include <quic/server/handshake/AppToken.h>
 #include <quic/server/state/ServerStateMachine.h>
 
 #include <fizz/server/ResumptionState.h>
@@ -22,6 +23,7 @@
 #include <glog/logging.h>
 
 #include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -41,12 +43,25 @@ bool DefaultAppTokenValidator::validate(
   conn_->transportParamsMatching = false;
   conn_->sourceTokenMatching = false;
 
+  if (!conn_->transportSettings.acceptZeroRtt) {
+    VLOG(10) << "Not accepting 0-RTT";
+    return false;
+  }
+
   if (!resumptionState.appToken) {
     VLOG(10) << "App token does not exist";
     return false;
   }
 
-  auto appToken = decodeAppToken(*resumptionState.appToken);
+  std::shared_ptr<const AppToken> appToken;
+  if (conn_->appTokenCache) {
+    appToken = conn_->appTokenCache->getAppToken(*resumptionState.appToken);
+  } else {
+    auto decoded = decodeAppToken(*resumptionState.appToken);
+    if (decoded) {
+      appToken = std::make_shared<const AppToken>(std::move(*decoded));
+    }
+  }
   if (!appToken) {
     VLOG(10) << "Failed to decode app token";
     return false;
@@ -136,8 +151,7 @@ bool DefaultAppTokenValidator::validate(
 
   conn_->transportParamsMatching = true;
 
-  if (!validateAndUpdateSourceToken(
-          *conn_, std::move(appToken->sourceAddresses))) {
+  if (!validateAndUpdateSourceToken(*conn_, appToken->sourceAddresses)) {
     VLOG(10) << "No exact match from source address token";
     return false;
   }
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RetryTokenGenerator.h>
+
+#include <folly/Range.h>
+#include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
+#include <openssl/crypto.h>
+
+namespace {
+constexpr folly::StringPiece kSalt{"Retry token"};
+}
+
+namespace quic {
+
+RetryTokenGenerator::RetryTokenGenerator(StatelessResetSecret secret)
+    : hkdf_(fizz::HkdfImpl::create<fizz::Sha256>()) {
+  extractedSecret_ = hkdf_.extract(kSalt, folly::range(secret));
+}
+
+std::string RetryTokenGenerator::computeTag(
+    const ConnectionId& originalDstConnId,
+    const folly::IPAddress& clientIp,
+    std::chrono::seconds issueTime) const {
+  auto info = toData(originalDstConnId);
+  uint64_t time = folly::Endian::big<uint64_t>(issueTime.count());
+  info.prependChain(folly::IOBuf::copyBuffer(&time, sizeof(time)));
+  info.prependChain(
+      folly::IOBuf::copyBuffer(clientIp.bytes(), clientIp.byteCount()));
+  auto out = hkdf_.expand(
+      folly::range(extractedSecret_), info, kRetryTokenTagLength);
+  out->coalesce();
+  return std::string(reinterpret_cast<const char*>(out->data()), out->length());
+}
+
+std::string RetryTokenGenerator::generateToken(
+    const ConnectionId& originalDstConnId,
+    const folly::IPAddress& clientIp,
+    std::chrono::seconds issueTime) const {
+  std::string token;
+  token.push_back(static_cast<char>(originalDstConnId.size()));
+  token.append(
+      reinterpret_cast<const char*>(originalDstConnId.data()),
+      originalDstConnId.size());
+  uint64_t time = folly::Endian::big<uint64_t>(issueTime.count());
+  token.append(reinterpret_cast<const char*>(&time), sizeof(time));
+  token.append(computeTag(originalDstConnId, clientIp, issueTime));
+  return token;
+}
+
+folly::Optional<ConnectionId> RetryTokenGenerator::validateToken(
+    const std::string& token,
+    const folly::IPAddress& clientIp,
+    std::chrono::seconds now) const {
+  if (token.empty()) {
+    return folly::none;
+  }
+  size_t connIdLen = static_cast<uint8_t>(token[0]);
+  if (connIdLen > kMaxConnectionIdSize ||
+      token.size() !=
+          1 + connIdLen + sizeof(uint64_t) + kRetryTokenTagLength) {
+    VLOG(4) << "Retry token of invalid length=" << token.size();
+    return folly::none;
+  }
+  auto buf = folly::IOBuf::wrapBuffer(token.data(), token.size());
+  folly::io::Cursor cursor(buf.get());
+  cursor.skip(1);
+  ConnectionId originalDstConnId(cursor, connIdLen);
+  std::chrono::seconds issueTime(cursor.readBE<uint64_t>());
+  auto tag = cursor.readFixedString(kRetryTokenTagLength);
+  auto expected = computeTag(originalDstConnId, clientIp, issueTime);
+  if (CRYPTO_memcmp(tag.data(), expected.data(), kRetryTokenTagLength) != 0) {
+    VLOG(4) << "Retry token with bad tag";
+    return folly::none;
+  }
+  // Some slack for the clocks of the servers sharing the secret.
+  if (issueTime > now + kRetryTokenLifetime ||
+      issueTime + kRetryTokenLifetime < now) {
+    VLOG(4) << "Expired retry token";
+    return folly::none;
+  }
+  return originalDstConnId;
+}
+
+} // namespace quic
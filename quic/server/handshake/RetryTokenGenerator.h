@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/Sha256.h>
+#include <quic/codec/Types.h>
+#include <quic/server/handshake/StatelessResetGenerator.h>
+
+#include <folly/IPAddress.h>
+
+#include <chrono>
+#include <string>
+
+namespace quic {
+
+/**
+ * Makes and checks the tokens of Retry packets, so that a server can have a
+ * client prove its address before starting a handshake with it without
+ * keeping any state for it.
+ *
+ * The token carries the destination connection id of the client's first
+ * Initial and the time it was issued at, and a MAC over both and the client
+ * ip, keyed off the same secret as the stateless reset tokens:
+ *
+ * PRK = HKDF-Extract(Salt, secret)
+ * appInfo = Concat(clientIp, issueTime, originalDstConnId)
+ * Tag = HKDF-Expand(PRK, appInfo, kRetryTokenTagLength)
+ * Token = Concat(len(originalDstConnId), originalDstConnId, issueTime, Tag)
+ */
+class RetryTokenGenerator {
+ public:
+  explicit RetryTokenGenerator(StatelessResetSecret secret);
+
+  /**
+   * The time is in seconds since the epoch, so that the servers sharing the
+   * secret can check each other's tokens.
+   */
+  std::string generateToken(
+      const ConnectionId& originalDstConnId,
+      const folly::IPAddress& clientIp,
+      std::chrono::seconds issueTime) const;
+
+  /**
+   * The destination connection id of the client's first Initial if the token
+   * was issued to the client within kRetryTokenLifetime of now.
+   */
+  folly::Optional<ConnectionId> validateToken(
+      const std::string& token,
+      const folly::IPAddress& clientIp,
+      std::chrono::seconds now) const;
+
+ private:
+  std::string computeTag(
+      const ConnectionId& originalDstConnId,
+      const folly::IPAddress& clientIp,
+      std::chrono::seconds issueTime) const;
+
+  fizz::HkdfImpl hkdf_;
+  std::vector<uint8_t> extractedSecret_;
+};
+
+} // namespace quic
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RotatingTicketCipher.h>
+
+#include <fizz/server/AeadTicketCipher.h>
+#include <folly/Range.h>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+RotatingTicketCipher::RotatingTicketCipher(
+    std::string secret,
+    CipherFactory cipherFactory)
+    : cipherFactory_(std::move(cipherFactory)),
+      currentSecret_(std::move(secret)) {
+  cipher_ = cipherFactory_({currentSecret_});
+  CHECK(cipher_);
+}
+
+bool RotatingTicketCipher::rotate(std::string secret) {
+  std::lock_guard<std::mutex> guard(rotationMutex_);
+  auto cipher = cipherFactory_({secret, currentSecret_});
+  if (!cipher) {
+    return false;
+  }
+  currentSecret_ = std::move(secret);
+  std::atomic_store(&cipher_, std::move(cipher));
+  return true;
+}
+
+std::shared_ptr<fizz::server::TicketCipher> RotatingTicketCipher::getCipher()
+    const {
+  return std::atomic_load(&cipher_);
+}
+
+folly::Future<folly::Optional<
+    std::pair<std::unique_ptr<folly::IOBuf>, std::chrono::seconds>>>
+RotatingTicketCipher::encrypt(fizz::server::ResumptionState resState) const {
+  auto cipher = getCipher();
+  // The cipher may be rotated out before the ticket is done.
+  return cipher->encrypt(std::move(resState)).ensure([cipher] {});
+}
+
+folly::Future<
+    std::pair<fizz::PskType, folly::Optional<fizz::server::ResumptionState>>>
+RotatingTicketCipher::decrypt(
+    std::unique_ptr<folly::IOBuf> encryptedTicket) const {
+  auto cipher = getCipher();
+  return cipher->decrypt(std::move(encryptedTicket)).ensure([cipher] {});
+}
+
+std::shared_ptr<fizz::server::TicketCipher>
+RotatingTicketCipher::makeAes128TicketCipher(
+    const std::vector<std::string>& secrets) {
+  auto cipher = std::make_shared<fizz::server::AES128TicketCipher>();
+  std::vector<folly::ByteRange> secretRanges;
+  for (const auto& secret : secrets) {
+    secretRanges.emplace_back(folly::StringPiece(secret));
+  }
+  if (!cipher->setTicketSecrets(std::move(secretRanges))) {
+    LOG(ERROR) << "Invalid ticket secrets";
+    return nullptr;
+  }
+  return cipher;
+}
+
+} // namespace quic
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/server/TicketCipher.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+/**
+ * A ticket cipher that can be shared by every worker of a server, through
+ * their fizz context, and have its secret rotated while they use it.
+ *
+ * Tickets are encrypted with the current secret and decrypted with either
+ * the current or the previous one, so the tickets issued right before a
+ * rotation still resume. Each set of secrets gets a cipher of its own that
+ * never changes, and a rotation just swaps in the next one: encrypting or
+ * decrypting a ticket only takes a copy of the current cipher's pointer, it
+ * never waits for a rotation.
+ */
+class RotatingTicketCipher : public fizz::server::TicketCipher {
+ public:
+  /**
+   * Makes the cipher for a set of secrets, the first one encrypts.
+   */
+  using CipherFactory =
+      std::function<std::shared_ptr<fizz::server::TicketCipher>(
+          const std::vector<std::string>& secrets)>;
+
+  explicit RotatingTicketCipher(
+      std::string secret,
+      CipherFactory cipherFactory = makeAes128TicketCipher);
+  ~RotatingTicketCipher() override = default;
+
+  /**
+   * Encrypt new tickets with the secret, keep decrypting the ones of the
+   * current secret. Tickets of the secret before are no longer accepted.
+   * Returns false, and keeps the current secret, if the factory can't make a
+   * cipher from it.
+   */
+  bool rotate(std::string secret);
+
+  folly::Future<folly::Optional<
+      std::pair<std::unique_ptr<folly::IOBuf>, std::chrono::seconds>>>
+  encrypt(fizz::server::ResumptionState resState) const override;
+
+  folly::Future<
+      std::pair<fizz::PskType, folly::Optional<fizz::server::ResumptionState>>>
+  decrypt(std::unique_ptr<folly::IOBuf> encryptedTicket) const override;
+
+  static std::shared_ptr<fizz::server::TicketCipher> makeAes128TicketCipher(
+      const std::vector<std::string>& secrets);
+
+ private:
+  std::shared_ptr<fizz::server::TicketCipher> getCipher() const;
+
+  CipherFactory cipherFactory_;
+  // Serializes rotations, readers go through the atomic pointer only.
+  std::mutex rotationMutex_;
+  std::string currentSecret_;
+  // Accessed with std::atomic_load and std::atomic_store
+  std::shared_ptr<fizz::server::TicketCipher> cipher_;
+};
+
+} // namespace quic
@@ -203,9 +203,122 @@ ServerHandshake::getContext() const {
 
 const folly::Optional<std::string>& ServerHandshake::getApplicationProtocol()
     const {
+  if (importedCipher_) {
+    return importedApplicationProtocol_;
+  }
   return state_.alpn();
 }
 
+std::unique_ptr<Aead> ServerHandshake::getNextOneRttReadCipher() {
+  return deriveNextOneRttCipher(oneRttReadSecret_);
+}
+
+std::unique_ptr<Aead> ServerHandshake::getNextOneRttWriteCipher() {
+  return deriveNextOneRttCipher(oneRttWriteSecret_);
+}
+
+std::unique_ptr<Aead> ServerHandshake::makeOneRttWriteCipher(
+    uint64_t generation) {
+  auto cipher = getOneRttCipherSuite();
+  if (oneRttBaseWriteSecret_.empty() || !cipher) {
+    return nullptr;
+  }
+  const auto& factory = importedCipher_ ? *context_->getFactory()
+                                        : *state_.context()->getFactory();
+  auto secret = oneRttBaseWriteSecret_;
+  for (uint64_t i = 0; i < generation; ++i) {
+    secret = deriveNextKeyPhaseSecret(factory, *cipher, folly::range(secret));
+  }
+  return deriveOneRttCipher(folly::range(secret));
+}
+
+folly::Optional<ServerHandshake::OneRttSecrets>
+ServerHandshake::getOneRttSecrets() const {
+  auto cipher = getOneRttCipherSuite();
+  if (!cipher || oneRttBaseReadSecret_.empty() ||
+      oneRttBaseWriteSecret_.empty()) {
+    return folly::none;
+  }
+  OneRttSecrets secrets;
+  secrets.cipher = *cipher;
+  secrets.readSecret = oneRttBaseReadSecret_;
+  secrets.writeSecret = oneRttBaseWriteSecret_;
+  return secrets;
+}
+
+void ServerHandshake::importOneRttSecrets(
+    const OneRttSecrets& secrets,
+    uint64_t readKeyGeneration,
+    uint64_t writeKeyGeneration,
+    folly::Optional<std::string> applicationProtocol) {
+  CHECK(context_) << "importOneRttSecrets before initialize";
+  const auto& factory = *context_->getFactory();
+  importedKeyScheduler_ = factory.makeKeyScheduler(secrets.cipher);
+  importedCipher_ = secrets.cipher;
+  importedApplicationProtocol_ = std::move(applicationProtocol);
+  oneRttBaseReadSecret_ = secrets.readSecret;
+  oneRttBaseWriteSecret_ = secrets.writeSecret;
+  // The header protection keys don't change with the key phase.
+  oneRttReadHeaderCipher_ =
+      cryptoFactory_->makePacketNumberCipher(folly::range(secrets.readSecret));
+  oneRttWriteHeaderCipher_ =
+      cryptoFactory_->makePacketNumberCipher(folly::range(secrets.writeSecret));
+  oneRttReadSecret_ = secrets.readSecret;
+  for (uint64_t i = 0; i < readKeyGeneration; ++i) {
+    oneRttReadSecret_ = deriveNextKeyPhaseSecret(
+        factory, secrets.cipher, folly::range(oneRttReadSecret_));
+  }
+  oneRttWriteSecret_ = secrets.writeSecret;
+  for (uint64_t i = 0; i < writeKeyGeneration; ++i) {
+    oneRttWriteSecret_ = deriveNextKeyPhaseSecret(
+        factory, secrets.cipher, folly::range(oneRttWriteSecret_));
+  }
+  oneRttReadCipher_ = deriveOneRttCipher(folly::range(oneRttReadSecret_));
+  oneRttWriteCipher_ = deriveOneRttCipher(folly::range(oneRttWriteSecret_));
+  phase_ = Phase::Established;
+  handshakeDone_ = true;
+}
+
+folly::Optional<fizz::CipherSuite> ServerHandshake::getOneRttCipherSuite()
+    const {
+  if (importedCipher_) {
+    return importedCipher_;
+  }
+  return state_.cipher();
+}
+
+std::unique_ptr<Aead> ServerHandshake::deriveOneRttCipher(
+    folly::ByteRange secret) {
+  if (importedCipher_) {
+    return FizzAead::wrap(fizz::Protocol::deriveRecordAeadWithLabel(
+        *context_->getFactory(),
+        *importedKeyScheduler_,
+        *importedCipher_,
+        secret,
+        kQuicKeyLabel,
+        kQuicIVLabel));
+  }
+  return FizzAead::wrap(fizz::Protocol::deriveRecordAeadWithLabel(
+      *state_.context()->getFactory(),
+      *state_.keyScheduler(),
+      *state_.cipher(),
+      secret,
+      kQuicKeyLabel,
+      kQuicIVLabel));
+}
+
+std::unique_ptr<Aead> ServerHandshake::deriveNextOneRttCipher(
+    std::vector<uint8_t>& secret) {
+  auto cipher = getOneRttCipherSuite();
+  if (secret.empty() || !cipher) {
+    return nullptr;
+  }
+  const auto& factory = importedCipher_ ? *context_->getFactory()
+                                        : *state_.context()->getFactory();
+  secret = deriveNextKeyPhaseSecret(factory, *cipher, folly::range(secret));
+  return deriveOneRttCipher(folly::range(secret));
+}
+
 void ServerHandshake::onError(
     std::pair<std::string, TransportErrorCode> error) {
   VLOG(10) << "ServerHandshake error " << error.first;
@@ -250,7 +363,11 @@ void ServerHandshake::startActions(fizz::server::AsyncActions actions) {
   folly::variant_match(
       actions,
       [this](folly::Future<fizz::server::Actions>& futureActions) {
-        std::move(futureActions).then(&ServerHandshake::processActions, this);
+        // An async signer or ticket cipher may complete the actions on a
+        // thread of its own, they are processed on the connection's evb.
+        std::move(futureActions)
+            .via(executor_)
+            .then(&ServerHandshake::processActions, this);
       },
       [this](fizz::server::Actions& immediateActions) {
         this->processActions(std::move(immediateActions));
@@ -465,10 +582,14 @@ void ServerHandshake::ActionMoveVisitor::operator()(
         case fizz::AppTrafficSecrets::ClientAppTraffic:
           server_.oneRttReadCipher_ = FizzAead::wrap(std::move(aead));
           server_.oneRttReadHeaderCipher_ = std::move(headerCipher);
+          server_.oneRttReadSecret_ = secretAvailable.secret.secret;
+          server_.oneRttBaseReadSecret_ = secretAvailable.secret.secret;
           break;
         case fizz::AppTrafficSecrets::ServerAppTraffic:
           server_.oneRttWriteCipher_ = FizzAead::wrap(std::move(aead));
           server_.oneRttWriteHeaderCipher_ = std::move(headerCipher);
+          server_.oneRttWriteSecret_ = secretAvailable.secret.secret;
+          server_.oneRttBaseWriteSecret_ = secretAvailable.secret.secret;
           break;
       }
       break;
@@ -198,6 +198,37 @@ class ServerHandshake : public Handshake {
    */
   const folly::Optional<std::string>& getApplicationProtocol() const override;
 
+  std::unique_ptr<Aead> getNextOneRttReadCipher() override;
+  std::unique_ptr<Aead> getNextOneRttWriteCipher() override;
+  std::unique_ptr<Aead> makeOneRttWriteCipher(uint64_t generation) override;
+
+  struct OneRttSecrets {
+    fizz::CipherSuite cipher;
+    // The secrets of the first key phase, as the handshake derived them
+    std::vector<uint8_t> readSecret;
+    std::vector<uint8_t> writeSecret;
+  };
+
+  /**
+   * The 1-RTT secrets the handshake derived, for another process to pick up
+   * the connection with, see importOneRttSecrets. None until they are
+   * derived.
+   */
+  folly::Optional<OneRttSecrets> getOneRttSecrets() const;
+
+  /**
+   * Sets the handshake up as done with the 1-RTT secrets of a connection
+   * handed over from another process, in place of running it. The ciphers of
+   * the key generations the connection had got to are derived and handed out
+   * by the getters as if the handshake had derived them. Must be called after
+   * initialize, throws if the cipher is not supported.
+   */
+  virtual void importOneRttSecrets(
+      const OneRttSecrets& secrets,
+      uint64_t readKeyGeneration,
+      uint64_t writeKeyGeneration,
+      folly::Optional<std::string> applicationProtocol);
+
   class ActionMoveVisitor : public boost::static_visitor<> {
    public:
     explicit ActionMoveVisitor(ServerHandshake& server);
@@ -247,6 +278,16 @@ class ServerHandshake : public Handshake {
    */
   void processPendingEvents();
 
+  /**
+   * Moves the secret on to the next key phase and derives its cipher.
+   */
+  std::unique_ptr<Aead> deriveNextOneRttCipher(std::vector<uint8_t>& secret);
+
+  std::unique_ptr<Aead> deriveOneRttCipher(folly::ByteRange secret);
+
+  // The negotiated cipher, or the one of the imported secrets
+  folly::Optional<fizz::CipherSuite> getOneRttCipherSuite() const;
+
   fizz::server::State state_;
   fizz::server::ServerStateMachine machine_;
   QuicConnectionStateBase* conn_;
@@ -280,6 +321,19 @@ class ServerHandshake : public Handshake {
   std::unique_ptr<PacketNumberCipher> handshakeWriteHeaderCipher_;
   std::unique_ptr<PacketNumberCipher> zeroRttReadHeaderCipher_;
 
+  // The 1-RTT secrets of the last key phase handed out, key updates derive
+  // the next ones from them.
+  std::vector<uint8_t> oneRttReadSecret_;
+  std::vector<uint8_t> oneRttWriteSecret_;
+  // The 1-RTT secrets of the first key phase, see getOneRttSecrets.
+  std::vector<uint8_t> oneRttBaseReadSecret_;
+  std::vector<uint8_t> oneRttBaseWriteSecret_;
+
+  // Only set by importOneRttSecrets, there is no fizz state then.
+  folly::Optional<fizz::CipherSuite> importedCipher_;
+  std::unique_ptr<fizz::KeyScheduler> importedKeyScheduler_;
+  folly::Optional<std::string> importedApplicationProtocol_;
+
   bool inHandshakeStack_{false};
   bool handshakeDone_{false};
   bool handshakeEventAvailable_{false};
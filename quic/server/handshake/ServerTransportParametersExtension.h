@@ -12,8 +12,59 @@
 #include <quic/fizz/handshake/FizzTransportParameters.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
 
+#include <array>
+
 namespace quic {
 
+/**
+ * The transport parameters a server advertises that only depend on its
+ * transport settings, encoded once for each set of settings and shared by the
+ * handshakes of the connections that have them. The parameters of a
+ * connection, the stateless reset token and the original connection id, are
+ * written after them for each handshake.
+ *
+ * Not thread safe, meant to be kept by a server worker.
+ */
+class ServerTransportParametersCache {
+ public:
+  // The values the shared parameters are encoded from.
+  using Key = std::array<uint64_t, 13>;
+
+  explicit ServerTransportParametersCache(size_t maxSize) : maxSize_(maxSize) {
+    CHECK_GT(maxSize_, 0);
+  }
+
+  /**
+   * The encoded parameters for the key, as they go on the wire without the
+   * length of the list, encoded with encodeFn if they aren't cached.
+   */
+  template <typename EncodeFn>
+  std::shared_ptr<const folly::IOBuf> getEncoded(
+      const Key& key,
+      EncodeFn&& encodeFn) {
+    // Servers have a handful of settings at most, a linear search is cheaper
+    // than hashing the key.
+    for (const auto& entry : entries_) {
+      if (entry.first == key) {
+        return entry.second;
+      }
+    }
+    if (entries_.size() == maxSize_) {
+      entries_.erase(entries_.begin());
+    }
+    entries_.emplace_back(key, encodeFn());
+    return entries_.back().second;
+  }
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+ private:
+  size_t maxSize_;
+  std::vector<std::pair<Key, std::shared_ptr<const folly::IOBuf>>> entries_;
+};
+
 class ServerTransportParametersExtension : public fizz::ServerExtensions {
  public:
   ServerTransportParametersExtension(
@@ -29,7 +80,12 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
       uint64_t ackDelayExponent,
       uint64_t maxRecvPacketSize,
       TransportPartialReliabilitySetting partialReliability,
-      const StatelessResetToken& token)
+      const StatelessResetToken& token,
+      bool ackFrequency = false,
+      folly::Optional<ConnectionId> originalConnectionId = folly::none,
+      uint16_t maxDatagramFrameSize = 0,
+      uint64_t streamRepairReceiveWindow = 0,
+      std::shared_ptr<ServerTransportParametersCache> cache = nullptr)
       : negotiatedVersion_(negotiatedVersion),
         supportedVersions_(supportedVersions),
         initialMaxData_(initialMaxData),
@@ -42,7 +98,12 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
         ackDelayExponent_(ackDelayExponent),
         maxRecvPacketSize_(maxRecvPacketSize),
         partialReliability_(partialReliability),
-        token_(token) {}
+        token_(token),
+        ackFrequency_(ackFrequency),
+        originalConnectionId_(std::move(originalConnectionId)),
+        maxDatagramFrameSize_(maxDatagramFrameSize),
+        streamRepairReceiveWindow_(streamRepairReceiveWindow),
+        cache_(std::move(cache)) {}
 
   ~ServerTransportParametersExtension() override = default;
 
@@ -61,55 +122,149 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
       negotiatedVersion_ = folly::none;
     }
 
+    std::shared_ptr<const folly::IOBuf> shared;
+    if (cache_) {
+      shared = cache_->getEncoded(
+          sharedParametersKey(), [this] { return encodeSharedParameters(); });
+    } else {
+      shared = encodeSharedParameters();
+    }
+
+    // The extension as encodeExtension() writes it, with the shared
+    // parameters copied in as they are.
+    fizz::Extension ext;
+    ext.extension_type = fizz::ExtensionType::quic_transport_parameters;
+    size_t paramsLength = shared->length() + kParameterHeaderLength +
+        token_.size() +
+        (originalConnectionId_
+             ? kParameterHeaderLength + originalConnectionId_->size()
+             : 0);
+    ext.extension_data = folly::IOBuf::create(
+        sizeof(QuicVersion) + sizeof(uint8_t) +
+        supportedVersions_.size() * sizeof(QuicVersion) + sizeof(uint16_t) +
+        paramsLength);
+    folly::io::Appender appender(ext.extension_data.get(), 40);
+    if (negotiatedVersion_) {
+      fizz::detail::write(negotiatedVersion_.value(), appender);
+      fizz::detail::writeVector<uint8_t>(supportedVersions_, appender);
+    }
+    fizz::detail::write(static_cast<uint16_t>(paramsLength), appender);
+    appender.push(shared->data(), shared->length());
+    writeParameter(
+        TransportParameterId::stateless_reset_token,
+        token_.data(),
+        token_.size(),
+        appender);
+    if (originalConnectionId_) {
+      writeParameter(
+          TransportParameterId::original_connection_id,
+          originalConnectionId_->data(),
+          originalConnectionId_->size(),
+          appender);
+    }
+
     std::vector<fizz::Extension> exts;
+    exts.push_back(std::move(ext));
+    return exts;
+  }
+
+  folly::Optional<ClientTransportParameters> getClientTransportParams() {
+    return std::move(clientTransportParameters_);
+  }
+
+ private:
+  // The parameter id and the length of its value.
+  static constexpr size_t kParameterHeaderLength = 2 * sizeof(uint16_t);
+
+  static void writeParameter(
+      TransportParameterId id,
+      const uint8_t* data,
+      size_t length,
+      folly::io::Appender& appender) {
+    fizz::detail::write(id, appender);
+    fizz::detail::write(static_cast<uint16_t>(length), appender);
+    appender.push(data, length);
+  }
+
+  ServerTransportParametersCache::Key sharedParametersKey() const {
+    return {initialMaxData_,
+            initialMaxStreamDataBidiLocal_,
+            initialMaxStreamDataBidiRemote_,
+            initialMaxStreamDataUni_,
+            initialMaxStreamsBidi_,
+            initialMaxStreamsUni_,
+            static_cast<uint64_t>(idleTimeout_.count()),
+            ackDelayExponent_,
+            maxRecvPacketSize_,
+            partialReliability_,
+            ackFrequency_,
+            maxDatagramFrameSize_,
+            streamRepairReceiveWindow_};
+  }
 
-    ServerTransportParameters params;
-    params.negotiated_version = negotiatedVersion_;
-    params.supported_versions = supportedVersions_;
-    params.parameters.push_back(encodeIntegerParameter(
+  // The parameters that don't depend on the connection.
+  std::shared_ptr<const folly::IOBuf> encodeSharedParameters() const {
+    std::vector<TransportParameter> parameters;
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::initial_max_stream_data_bidi_local,
         initialMaxStreamDataBidiLocal_));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::initial_max_stream_data_bidi_remote,
         initialMaxStreamDataBidiRemote_));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::initial_max_stream_data_uni,
         initialMaxStreamDataUni_));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::initial_max_data, initialMaxData_));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::initial_max_streams_bidi,
         initialMaxStreamsBidi_));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::initial_max_streams_uni, initialMaxStreamsUni_));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::idle_timeout, idleTimeout_.count()));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::ack_delay_exponent, ackDelayExponent_));
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         TransportParameterId::max_packet_size, maxRecvPacketSize_));
-    TransportParameter statelessReset;
-    statelessReset.parameter = TransportParameterId::stateless_reset_token;
-    statelessReset.value = folly::IOBuf::copyBuffer(token_);
-    params.parameters.push_back(std::move(statelessReset));
 
     uint64_t partialReliabilitySetting = 0;
     if (partialReliability_) {
       partialReliabilitySetting = 1;
     }
-    params.parameters.push_back(encodeIntegerParameter(
+    parameters.push_back(encodeIntegerParameter(
         static_cast<TransportParameterId>(kPartialReliabilityParameterId),
         partialReliabilitySetting));
 
-    exts.push_back(encodeExtension(params));
-    return exts;
-  }
+    if (ackFrequency_) {
+      parameters.push_back(encodeIntegerParameter(
+          static_cast<TransportParameterId>(kMinAckDelayParameterId),
+          kMinAckDelay.count()));
+    }
 
-  folly::Optional<ClientTransportParameters> getClientTransportParams() {
-    return std::move(clientTransportParameters_);
+    if (maxDatagramFrameSize_) {
+      parameters.push_back(encodeIntegerParameter(
+          static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+          maxDatagramFrameSize_));
+    }
+
+    if (streamRepairReceiveWindow_) {
+      parameters.push_back(encodeIntegerParameter(
+          static_cast<TransportParameterId>(
+              kStreamRepairReceiveWindowParameterId),
+          streamRepairReceiveWindow_));
+    }
+
+    auto encoded = folly::IOBuf::create(0);
+    folly::io::Appender appender(encoded.get(), 64);
+    for (const auto& parameter : parameters) {
+      fizz::detail::write(parameter, appender);
+    }
+    // One buffer, so that a handshake copies it in one go.
+    encoded->coalesce();
+    return encoded;
   }
 
- private:
   folly::Optional<QuicVersion> negotiatedVersion_;
   std::vector<QuicVersion> supportedVersions_;
   uint64_t initialMaxData_;
@@ -124,5 +279,15 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
   TransportPartialReliabilitySetting partialReliability_;
   folly::Optional<ClientTransportParameters> clientTransportParameters_;
   StatelessResetToken token_;
+  // Whether to advertise min_ack_delay.
+  bool ackFrequency_;
+  // Set when the server made the client Retry.
+  folly::Optional<ConnectionId> originalConnectionId_;
+  // max_datagram_frame_size to advertise, 0 not to take DATAGRAM frames.
+  uint16_t maxDatagramFrameSize_;
+  // Bytes of read stream data kept for STREAM_REPAIR, 0 not to take them.
+  uint64_t streamRepairReceiveWindow_;
+  // The worker's encoded shared parameters, if it keeps them.
+  std::shared_ptr<ServerTransportParametersCache> cache_;
 };
 } // namespace quic
@@ -250,5 +250,37 @@ TEST(AppTokenTest, TestEncodeAndDecodeIPv6AndIPv4AddressesWithAppToken) {
   expectAppTokenEqual(decodeAppToken(*buf), appToken);
 }
 
+TEST(AppTokenTest, TestCacheSharesDecodedToken) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      kDefaultIdleTimeout.count(),
+      kDefaultUDPReadBufferSize,
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.sourceAddresses = {folly::IPAddress("1.2.3.4")};
+  appToken.version = QuicVersion::MVFST;
+  Buf buf = encodeAppToken(appToken);
+
+  AppTokenCache cache(1);
+  auto decoded = cache.getAppToken(*buf);
+  ASSERT_NE(nullptr, decoded);
+  EXPECT_EQ(appToken.sourceAddresses, decoded->sourceAddresses);
+  EXPECT_EQ(decoded, cache.getAppToken(*buf->clone()));
+  EXPECT_EQ(1, cache.size());
+
+  EXPECT_EQ(nullptr, cache.getAppToken(*folly::IOBuf::copyBuffer("junk")));
+  EXPECT_EQ(1, cache.size());
+
+  appToken.sourceAddresses = {folly::IPAddress("1.2.3.5")};
+  auto other = cache.getAppToken(*encodeAppToken(appToken));
+  ASSERT_NE(nullptr, other);
+  EXPECT_NE(decoded, other);
+  EXPECT_EQ(1, cache.size());
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/CompressingSelfCert.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class FakeCertificateCompressor : public fizz::CertificateCompressor {
+ public:
+  explicit FakeCertificateCompressor(fizz::CertificateCompressionAlgorithm algo)
+      : algo_(algo) {}
+
+  fizz::CertificateCompressionAlgorithm getAlgorithm() const override {
+    return algo_;
+  }
+
+  fizz::CompressedCertificate compress(
+      const fizz::CertificateMsg& cert) override {
+    compressions++;
+    fizz::CompressedCertificate compressed;
+    compressed.algorithm = algo_;
+    compressed.uncompressed_length = cert.certificate_list.size();
+    compressed.compressed_certificate_message =
+        folly::IOBuf::copyBuffer("compressed");
+    return compressed;
+  }
+
+  size_t compressions{0};
+
+ private:
+  fizz::CertificateCompressionAlgorithm algo_;
+};
+
+TEST(CompressingSelfCertTest, CompressesOnceUpFront) {
+  auto algo = fizz::CertificateCompressionAlgorithm::zlib;
+  auto cert = readCert();
+  auto zlib = std::make_shared<FakeCertificateCompressor>(algo);
+  CompressingSelfCert compressing(cert, {zlib, zlib});
+  EXPECT_EQ(1, zlib->compressions);
+  EXPECT_THAT(compressing.getCompressionAlgorithms(), ElementsAre(algo));
+
+  auto first = compressing.getCompressedCert(algo);
+  auto second = compressing.getCompressedCert(algo);
+  EXPECT_EQ(1, zlib->compressions);
+  EXPECT_EQ(algo, first.algorithm);
+  EXPECT_EQ(1, first.uncompressed_length);
+  EXPECT_EQ(first.uncompressed_length, second.uncompressed_length);
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      first.compressed_certificate_message,
+      second.compressed_certificate_message));
+  EXPECT_EQ(cert->getIdentity(), compressing.getIdentity());
+}
+
+TEST(CompressingSelfCertTest, MissingAlgorithmThrows) {
+  CompressingSelfCert compressing(readCert(), {});
+  EXPECT_TRUE(compressing.getCompressionAlgorithms().empty());
+  EXPECT_THROW(
+      compressing.getCompressedCert(
+          fizz::CertificateCompressionAlgorithm::zlib),
+      std::runtime_error);
+}
+
+} // namespace test
+} // namespace quic
@@ -50,6 +50,35 @@ TEST(DefaultAppTokenValidatorTest, TestValidParams) {
   EXPECT_TRUE(validator.validate(resState));
 }
 
+TEST(DefaultAppTokenValidatorTest, TestValidParamsFromAppTokenCache) {
+  QuicServerConnectionState conn;
+  conn.peerAddress = folly::SocketAddress("1.2.3.4", 443);
+  conn.version = QuicVersion::MVFST;
+  conn.appTokenCache = std::make_shared<AppTokenCache>(10);
+
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      conn.transportSettings.idleTimeout.count(),
+      conn.transportSettings.maxRecvPacketSize,
+      conn.transportSettings.advertisedInitialConnectionWindowSize,
+      conn.transportSettings.advertisedInitialBidiLocalStreamWindowSize,
+      conn.transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
+      conn.transportSettings.advertisedInitialUniStreamWindowSize,
+      conn.transportSettings.advertisedInitialMaxStreamsBidi,
+      conn.transportSettings.advertisedInitialMaxStreamsUni);
+  appToken.sourceAddresses = {conn.peerAddress.getIPAddress()};
+  appToken.version = conn.version;
+  ResumptionState resState;
+  resState.appToken = encodeAppToken(appToken);
+
+  DefaultAppTokenValidator validator(&conn, nullptr);
+  EXPECT_TRUE(validator.validate(resState));
+  EXPECT_EQ(1, conn.appTokenCache->size());
+  // The cached token still has its source addresses.
+  EXPECT_TRUE(validator.validate(resState));
+  EXPECT_TRUE(conn.sourceTokenMatching);
+}
+
 TEST(
     DefaultAppTokenValidatorTest,
     TestValidUnequalParamsUpdateTransportSettings) {
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RetryTokenGenerator.h>
+#include <folly/Random.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class RetryTokenGeneratorTest : public Test {
+ public:
+  void SetUp() override {
+    folly::Random::secureRandom(secret_.data(), secret_.size());
+  }
+
+  StatelessResetSecret secret_;
+  ConnectionId connId_{{0x14, 0x35, 0x22, 0x11, 0x01, 0x02, 0x03, 0x04}};
+  folly::IPAddress clientIp_{"1.2.3.4"};
+  std::chrono::seconds now_{1600000000};
+};
+
+TEST_F(RetryTokenGeneratorTest, ValidToken) {
+  RetryTokenGenerator generator1(secret_), generator2(secret_);
+  auto token = generator1.generateToken(connId_, clientIp_, now_);
+  auto originalDstConnId =
+      generator2.validateToken(token, clientIp_, now_ + 1s);
+  ASSERT_TRUE(originalDstConnId.has_value());
+  EXPECT_EQ(connId_, *originalDstConnId);
+}
+
+TEST_F(RetryTokenGeneratorTest, DifferentClient) {
+  RetryTokenGenerator generator(secret_);
+  auto token = generator.generateToken(connId_, clientIp_, now_);
+  EXPECT_FALSE(
+      generator.validateToken(token, folly::IPAddress("1.2.3.5"), now_)
+          .has_value());
+}
+
+TEST_F(RetryTokenGeneratorTest, DifferentSecret) {
+  StatelessResetSecret secret;
+  folly::Random::secureRandom(secret.data(), secret.size());
+  RetryTokenGenerator generator1(secret_), generator2(secret);
+  auto token = generator1.generateToken(connId_, clientIp_, now_);
+  EXPECT_FALSE(generator2.validateToken(token, clientIp_, now_).has_value());
+}
+
+TEST_F(RetryTokenGeneratorTest, Expired) {
+  RetryTokenGenerator generator(secret_);
+  auto token = generator.generateToken(connId_, clientIp_, now_);
+  EXPECT_TRUE(
+      generator.validateToken(token, clientIp_, now_ + 10s).has_value());
+  EXPECT_FALSE(
+      generator.validateToken(token, clientIp_, now_ + 11s).has_value());
+  EXPECT_FALSE(
+      generator.validateToken(token, clientIp_, now_ - 11s).has_value());
+}
+
+TEST_F(RetryTokenGeneratorTest, Tampered) {
+  RetryTokenGenerator generator(secret_);
+  auto token = generator.generateToken(connId_, clientIp_, now_);
+  auto tampered = token;
+  tampered[1] ^= 0x01;
+  EXPECT_FALSE(
+      generator.validateToken(tampered, clientIp_, now_).has_value());
+  EXPECT_FALSE(generator
+                   .validateToken(
+                       token.substr(0, token.size() - 1), clientIp_, now_)
+                   .has_value());
+  EXPECT_FALSE(generator.validateToken("", clientIp_, now_).has_value());
+  EXPECT_FALSE(
+      generator.validateToken(std::string(1, '\xff'), clientIp_, now_)
+          .has_value());
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RotatingTicketCipher.h>
+
+#include <fizz/server/ResumptionState.h>
+#include <folly/portability/GTest.h>
+
+#include <algorithm>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+
+// Tickets are the secret they were encrypted with, and decrypt if that is
+// one of the cipher's secrets.
+class FakeTicketCipher : public fizz::server::TicketCipher {
+ public:
+  explicit FakeTicketCipher(std::vector<std::string> secrets)
+      : secrets_(std::move(secrets)) {}
+
+  folly::Future<folly::Optional<
+      std::pair<std::unique_ptr<folly::IOBuf>, std::chrono::seconds>>>
+  encrypt(fizz::server::ResumptionState) const override {
+    return std::make_pair(
+        folly::IOBuf::copyBuffer(secrets_.front()), std::chrono::seconds(1));
+  }
+
+  folly::Future<
+      std::pair<fizz::PskType, folly::Optional<fizz::server::ResumptionState>>>
+  decrypt(std::unique_ptr<folly::IOBuf> ticket) const override {
+    auto secret = ticket->moveToFbString().toStdString();
+    if (std::find(secrets_.begin(), secrets_.end(), secret) == secrets_.end()) {
+      return std::make_pair(fizz::PskType::Rejected, folly::none);
+    }
+    return std::make_pair(
+        fizz::PskType::Resumption, fizz::server::ResumptionState());
+  }
+
+ private:
+  std::vector<std::string> secrets_;
+};
+
+std::shared_ptr<fizz::server::TicketCipher> makeFakeTicketCipher(
+    const std::vector<std::string>& secrets) {
+  if (secrets.front().empty()) {
+    return nullptr;
+  }
+  return std::make_shared<FakeTicketCipher>(secrets);
+}
+
+} // namespace
+
+class RotatingTicketCipherTest : public Test {
+ public:
+  std::unique_ptr<folly::IOBuf> encrypt() {
+    auto result = cipher_.encrypt(fizz::server::ResumptionState()).get();
+    return std::move(result->first);
+  }
+
+  fizz::PskType decrypt(const folly::IOBuf& ticket) {
+    return cipher_.decrypt(ticket.clone()).get().first;
+  }
+
+  RotatingTicketCipher cipher_{"first", makeFakeTicketCipher};
+};
+
+TEST_F(RotatingTicketCipherTest, PreviousSecretStillDecrypts) {
+  auto firstTicket = encrypt();
+  EXPECT_EQ(fizz::PskType::Resumption, decrypt(*firstTicket));
+
+  EXPECT_TRUE(cipher_.rotate("second"));
+  auto secondTicket = encrypt();
+  EXPECT_EQ("second", secondTicket->clone()->moveToFbString().toStdString());
+  EXPECT_EQ(fizz::PskType::Resumption, decrypt(*firstTicket));
+  EXPECT_EQ(fizz::PskType::Resumption, decrypt(*secondTicket));
+
+  EXPECT_TRUE(cipher_.rotate("third"));
+  EXPECT_EQ(fizz::PskType::Rejected, decrypt(*firstTicket));
+  EXPECT_EQ(fizz::PskType::Resumption, decrypt(*secondTicket));
+}
+
+TEST_F(RotatingTicketCipherTest, FailedRotationKeepsSecret) {
+  EXPECT_FALSE(cipher_.rotate(""));
+  auto ticket = encrypt();
+  EXPECT_EQ("first", ticket->clone()->moveToFbString().toStdString());
+}
+
+} // namespace test
+} // namespace quic
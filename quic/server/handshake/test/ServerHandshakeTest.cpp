@@ -18,6 +18,7 @@
 #include <fizz/protocol/test/Mocks.h>
 #include <fizz/server/test/Mocks.h>
 
+#include <folly/executors/ManualExecutor.h>
 #include <folly/io/async/SSLContext.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/io/async/test/MockAsyncTransport.h>
@@ -30,6 +31,7 @@
 #include <quic/fizz/handshake/QuicFizzFactory.h>
 #include <quic/handshake/HandshakeLayer.h>
 #include <quic/server/handshake/AppToken.h>
+#include <quic/server/handshake/AsyncSigningSelfCert.h>
 #include <quic/server/handshake/ServerHandshake.h>
 #include <quic/state/StateData.h>
 
@@ -405,6 +407,40 @@ TEST_F(ServerHandshakeTest, TestMalformedHandshakeMessage) {
   EXPECT_TRUE(ex);
 }
 
+class ServerHandshakeAsyncSigningTest : public ServerHandshakeTest {
+ public:
+  void setupClientAndServerContext() override {
+    auto certManager = std::make_unique<fizz::server::CertManager>();
+    certManager->addCert(
+        std::make_shared<AsyncSigningSelfCert>(readCert(), &signingExecutor),
+        true);
+    serverCtx->setCertManager(std::move(certManager));
+  }
+
+  folly::ManualExecutor signingExecutor;
+};
+
+TEST_F(ServerHandshakeAsyncSigningTest, TestHandshakeSuccess) {
+  clientServerRound();
+  // The server's flight waits for the signature.
+  EXPECT_TRUE(cryptoState->initialStream.writeBuffer.empty());
+  expectOneRttCipher(false);
+
+  EXPECT_EQ(1, signingExecutor.drain());
+  evb.loop();
+  EXPECT_EQ(handshake->getPhase(), ServerHandshake::Phase::Handshake);
+
+  handshakeCv.wait();
+  handshakeCv.reset();
+  clientServerRound();
+  EXPECT_EQ(handshake->getPhase(), ServerHandshake::Phase::Established);
+  if (ex) {
+    std::rethrow_exception(ex);
+  }
+  expectOneRttCipher(true);
+  EXPECT_TRUE(handshakeSuccess);
+}
+
 class AsyncRejectingTicketCipher : public fizz::server::TicketCipher {
  public:
   ~AsyncRejectingTicketCipher() override = default;
@@ -105,5 +105,88 @@ TEST(ServerTransportParametersTest, TestGetExtensionsMissingClientParams) {
       generateStatelessResetToken());
   EXPECT_THROW(ext.getExtensions(TestMessages::clientHello()), FizzException);
 }
+
+static std::shared_ptr<ServerTransportParametersExtension> makeExtension(
+    const StatelessResetToken& token,
+    folly::Optional<ConnectionId> originalConnectionId,
+    uint64_t initialMaxData,
+    std::shared_ptr<ServerTransportParametersCache> cache) {
+  return std::make_shared<ServerTransportParametersExtension>(
+      QuicVersion::MVFST,
+      std::vector<QuicVersion>{MVFST1, QuicVersion::MVFST},
+      initialMaxData,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max(),
+      kDefaultIdleTimeout,
+      kDefaultAckDelayExponent,
+      kDefaultUDPSendPacketLen,
+      kDefaultPartialReliability,
+      token,
+      true /* ackFrequency */,
+      std::move(originalConnectionId),
+      kMaxDatagramFrameSize,
+      0 /* streamRepairReceiveWindow */,
+      std::move(cache));
+}
+
+TEST(ServerTransportParametersTest, TestCachedParameters) {
+  auto cache = std::make_shared<ServerTransportParametersCache>(2);
+  auto token = generateStatelessResetToken();
+  ConnectionId originalConnectionId(std::vector<uint8_t>{1, 2, 3, 4});
+  auto chlo = getClientHello(QuicVersion::MVFST);
+  auto uncached = makeExtension(
+      token, originalConnectionId, kDefaultConnectionWindowSize, nullptr);
+  auto uncachedExts = uncached->getExtensions(chlo);
+  auto cached = makeExtension(
+      token, originalConnectionId, kDefaultConnectionWindowSize, cache);
+  auto cachedExts = cached->getExtensions(chlo);
+  EXPECT_EQ(1, cache->size());
+  ASSERT_EQ(cachedExts.size(), 1);
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      uncachedExts.front().extension_data,
+      cachedExts.front().extension_data));
+
+  auto serverParams = getExtension<ServerTransportParameters>(cachedExts);
+  ASSERT_TRUE(serverParams.has_value());
+  EXPECT_EQ(token, *getStatelessResetTokenParameter(serverParams->parameters));
+  EXPECT_EQ(
+      kDefaultConnectionWindowSize,
+      *getIntegerParameter(
+          TransportParameterId::initial_max_data, serverParams->parameters));
+
+  // Another connection with the same settings only differs in its token and
+  // original connection id.
+  auto otherToken = generateStatelessResetToken();
+  auto other = makeExtension(
+      otherToken, folly::none, kDefaultConnectionWindowSize, cache);
+  auto otherExts = other->getExtensions(chlo);
+  EXPECT_EQ(1, cache->size());
+  serverParams = getExtension<ServerTransportParameters>(otherExts);
+  ASSERT_TRUE(serverParams.has_value());
+  EXPECT_EQ(
+      otherToken, *getStatelessResetTokenParameter(serverParams->parameters));
+  EXPECT_TRUE(std::none_of(
+      serverParams->parameters.begin(),
+      serverParams->parameters.end(),
+      [](const auto& param) {
+        return param.parameter == TransportParameterId::original_connection_id;
+      }));
+
+  // Other settings are encoded on their own.
+  auto larger = makeExtension(
+      token, folly::none, kDefaultConnectionWindowSize * 2, cache);
+  auto largerExts = larger->getExtensions(chlo);
+  EXPECT_EQ(2, cache->size());
+  serverParams = getExtension<ServerTransportParameters>(largerExts);
+  ASSERT_TRUE(serverParams.has_value());
+  EXPECT_EQ(
+      kDefaultConnectionWindowSize * 2,
+      *getIntegerParameter(
+          TransportParameterId::initial_max_data, serverParams->parameters));
+}
+
 } // namespace test
 } // namespace quic
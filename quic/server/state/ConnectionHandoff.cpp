@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ConnectionHandoff.h>
+
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/QuicPacingFunctions.h>
+#include <quic/state/QuicStateFunctions.h>
+
+#include <folly/IPAddress.h>
+#include <folly/io/Cursor.h>
+
+namespace quic {
+
+namespace {
+
+constexpr size_t kHandoffStateGrowth = 512;
+
+void writeBool(bool value, folly::io::Appender& appender) {
+  appender.writeBE<uint8_t>(value ? 1 : 0);
+}
+
+bool readBool(folly::io::Cursor& cursor) {
+  return cursor.readBE<uint8_t>() != 0;
+}
+
+void writeBytes(folly::ByteRange bytes, folly::io::Appender& appender) {
+  appender.writeBE<uint16_t>(bytes.size());
+  appender.push(bytes.data(), bytes.size());
+}
+
+std::vector<uint8_t> readBytes(folly::io::Cursor& cursor) {
+  std::vector<uint8_t> bytes(cursor.readBE<uint16_t>());
+  cursor.pull(bytes.data(), bytes.size());
+  return bytes;
+}
+
+void writeAddress(
+    const folly::SocketAddress& address,
+    folly::io::Appender& appender) {
+  auto ip = address.getIPAddress();
+  writeBytes(folly::ByteRange(ip.bytes(), ip.byteCount()), appender);
+  appender.writeBE<uint16_t>(address.getPort());
+}
+
+folly::SocketAddress readAddress(folly::io::Cursor& cursor) {
+  auto bytes = readBytes(cursor);
+  auto ip = folly::IPAddress::fromBinary(folly::range(bytes));
+  return folly::SocketAddress(ip, cursor.readBE<uint16_t>());
+}
+
+void writeConnectionId(
+    const ConnectionId& connId,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint8_t>(connId.size());
+  appender.push(connId.data(), connId.size());
+}
+
+ConnectionId readConnectionId(folly::io::Cursor& cursor) {
+  auto len = cursor.readBE<uint8_t>();
+  return ConnectionId(cursor, len);
+}
+
+void writeOptionalConnectionId(
+    const folly::Optional<ConnectionId>& connId,
+    folly::io::Appender& appender) {
+  writeBool(connId.has_value(), appender);
+  if (connId) {
+    writeConnectionId(*connId, appender);
+  }
+}
+
+folly::Optional<ConnectionId> readOptionalConnectionId(
+    folly::io::Cursor& cursor) {
+  if (!readBool(cursor)) {
+    return folly::none;
+  }
+  return readConnectionId(cursor);
+}
+
+void writeConnectionIds(
+    const std::vector<ConnectionIdData>& connIds,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint16_t>(connIds.size());
+  for (const auto& connIdData : connIds) {
+    writeConnectionId(connIdData.connId, appender);
+    appender.writeBE<uint64_t>(connIdData.sequenceNumber);
+    writeBool(connIdData.token.has_value(), appender);
+    if (connIdData.token) {
+      appender.push(connIdData.token->data(), connIdData.token->size());
+    }
+  }
+}
+
+std::vector<ConnectionIdData> readConnectionIds(folly::io::Cursor& cursor) {
+  std::vector<ConnectionIdData> connIds;
+  auto numConnIds = cursor.readBE<uint16_t>();
+  for (uint16_t i = 0; i < numConnIds; ++i) {
+    auto connId = readConnectionId(cursor);
+    auto sequenceNumber = cursor.readBE<uint64_t>();
+    connIds.emplace_back(connId, sequenceNumber);
+    if (readBool(cursor)) {
+      StatelessResetToken token;
+      cursor.pull(token.data(), token.size());
+      connIds.back().token = token;
+    }
+  }
+  return connIds;
+}
+
+void writeOptionalInteger(
+    const folly::Optional<uint64_t>& value,
+    folly::io::Appender& appender) {
+  writeBool(value.has_value(), appender);
+  if (value) {
+    appender.writeBE<uint64_t>(*value);
+  }
+}
+
+folly::Optional<uint64_t> readOptionalInteger(folly::io::Cursor& cursor) {
+  if (!readBool(cursor)) {
+    return folly::none;
+  }
+  return cursor.readBE<uint64_t>();
+}
+
+void writeStreamIds(
+    const QuicStreamManager::StreamIdState& streamIds,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptablePeerBidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptablePeerUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptableLocalBidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptableLocalUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.nextBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.nextUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxLocalBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxLocalUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxRemoteBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxRemoteUnidirectionalStreamId);
+}
+
+QuicStreamManager::StreamIdState readStreamIds(folly::io::Cursor& cursor) {
+  QuicStreamManager::StreamIdState streamIds;
+  streamIds.nextAcceptablePeerBidirectionalStreamId =
+      cursor.readBE<uint64_t>();
+  streamIds.nextAcceptablePeerUnidirectionalStreamId =
+      cursor.readBE<uint64_t>();
+  streamIds.nextAcceptableLocalBidirectionalStreamId =
+      cursor.readBE<uint64_t>();
+  streamIds.nextAcceptableLocalUnidirectionalStreamId =
+      cursor.readBE<uint64_t>();
+  streamIds.nextBidirectionalStreamId = cursor.readBE<uint64_t>();
+  streamIds.nextUnidirectionalStreamId = cursor.readBE<uint64_t>();
+  streamIds.maxLocalBidirectionalStreamId = cursor.readBE<uint64_t>();
+  streamIds.maxLocalUnidirectionalStreamId = cursor.readBE<uint64_t>();
+  streamIds.maxRemoteBidirectionalStreamId = cursor.readBE<uint64_t>();
+  streamIds.maxRemoteUnidirectionalStreamId = cursor.readBE<uint64_t>();
+  return streamIds;
+}
+
+} // namespace
+
+std::unique_ptr<folly::IOBuf> encodeConnectionHandoffState(
+    const ConnectionHandoffState& state) {
+  auto buf = folly::IOBuf::create(kHandoffStateGrowth);
+  folly::io::Appender appender(buf.get(), kHandoffStateGrowth);
+  appender.writeBE<uint32_t>(
+      static_cast<uint32_t>(ConnectionHandoffVersion::V1));
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(state.version));
+  writeAddress(state.peerAddress, appender);
+  writeAddress(state.originalPeerAddress, appender);
+  writeBool(state.applicationProtocol.has_value(), appender);
+  if (state.applicationProtocol) {
+    writeBytes(
+        folly::ByteRange(folly::StringPiece(*state.applicationProtocol)),
+        appender);
+  }
+
+  appender.writeBE<uint16_t>(static_cast<uint16_t>(state.cipher));
+  writeBytes(folly::range(state.readSecret), appender);
+  writeBytes(folly::range(state.writeSecret), appender);
+  appender.writeBE<uint64_t>(state.readKeyGeneration);
+  appender.writeBE<uint64_t>(state.writeKeyGeneration);
+
+  writeOptionalConnectionId(state.clientChosenDestConnectionId, appender);
+  writeOptionalConnectionId(state.clientConnectionId, appender);
+  writeOptionalConnectionId(state.serverConnectionId, appender);
+  writeConnectionIds(state.selfConnectionIds, appender);
+  writeConnectionIds(state.peerConnectionIds, appender);
+  appender.writeBE<uint64_t>(state.nextSelfConnectionIdSequence);
+  appender.writeBE<uint64_t>(state.peerActiveConnectionIdLimit);
+
+  appender.writeBE<uint64_t>(state.nextPacketNum);
+  appender.writeBE<uint64_t>(state.largestAckedByPeer);
+  writeOptionalInteger(state.largestReceivedPacketNum, appender);
+  appender.writeBE<uint32_t>(state.acks.size());
+  for (auto it = state.acks.cbegin(); it != state.acks.cend(); ++it) {
+    appender.writeBE<uint64_t>(it->start);
+    appender.writeBE<uint64_t>(it->end);
+  }
+
+  appender.writeBE<uint64_t>(state.windowSize);
+  appender.writeBE<uint64_t>(state.advertisedMaxOffset);
+  appender.writeBE<uint64_t>(state.peerAdvertisedMaxOffset);
+  appender.writeBE<uint64_t>(state.sumCurReadOffset);
+  appender.writeBE<uint64_t>(state.sumMaxObservedOffset);
+  appender.writeBE<uint64_t>(state.sumCurWriteOffset);
+  appender.writeBE<uint64_t>(
+      state.peerAdvertisedInitialMaxStreamOffsetBidiLocal);
+  appender.writeBE<uint64_t>(
+      state.peerAdvertisedInitialMaxStreamOffsetBidiRemote);
+  appender.writeBE<uint64_t>(state.peerAdvertisedInitialMaxStreamOffsetUni);
+  writeStreamIds(state.streamIds, appender);
+
+  appender.writeBE<uint64_t>(state.peerIdleTimeout.count());
+  appender.writeBE<uint64_t>(state.peerAckDelayExponent);
+  appender.writeBE<uint64_t>(state.udpSendPacketLen);
+  writeBool(state.partialReliabilityEnabled, appender);
+  folly::Optional<uint64_t> peerMinAckDelay;
+  if (state.peerMinAckDelay) {
+    peerMinAckDelay = state.peerMinAckDelay->count();
+  }
+  writeOptionalInteger(peerMinAckDelay, appender);
+  appender.writeBE<uint64_t>(state.maxDatagramWriteFrameSize);
+
+  appender.writeBE<uint64_t>(state.maxAckDelay.count());
+  appender.writeBE<uint64_t>(state.srtt.count());
+  appender.writeBE<uint64_t>(state.lrtt.count());
+  appender.writeBE<uint64_t>(state.rttvar.count());
+  appender.writeBE<uint64_t>(state.mrtt.count());
+  appender.writeBE<uint64_t>(state.congestionWindow);
+  return buf;
+}
+
+folly::Optional<ConnectionHandoffState> decodeConnectionHandoffState(
+    const folly::IOBuf& buf) {
+  ConnectionHandoffState state;
+  folly::io::Cursor cursor(&buf);
+  try {
+    auto handoffVersion = cursor.readBE<uint32_t>();
+    if (handoffVersion !=
+        static_cast<uint32_t>(ConnectionHandoffVersion::V1)) {
+      return folly::none;
+    }
+    state.version = static_cast<QuicVersion>(cursor.readBE<uint32_t>());
+    state.peerAddress = readAddress(cursor);
+    state.originalPeerAddress = readAddress(cursor);
+    if (readBool(cursor)) {
+      auto alpn = readBytes(cursor);
+      state.applicationProtocol = std::string(alpn.begin(), alpn.end());
+    }
+
+    state.cipher = static_cast<fizz::CipherSuite>(cursor.readBE<uint16_t>());
+    state.readSecret = readBytes(cursor);
+    state.writeSecret = readBytes(cursor);
+    state.readKeyGeneration = cursor.readBE<uint64_t>();
+    state.writeKeyGeneration = cursor.readBE<uint64_t>();
+
+    state.clientChosenDestConnectionId = readOptionalConnectionId(cursor);
+    state.clientConnectionId = readOptionalConnectionId(cursor);
+    state.serverConnectionId = readOptionalConnectionId(cursor);
+    state.selfConnectionIds = readConnectionIds(cursor);
+    state.peerConnectionIds = readConnectionIds(cursor);
+    state.nextSelfConnectionIdSequence = cursor.readBE<uint64_t>();
+    state.peerActiveConnectionIdLimit = cursor.readBE<uint64_t>();
+
+    state.nextPacketNum = cursor.readBE<uint64_t>();
+    state.largestAckedByPeer = cursor.readBE<uint64_t>();
+    state.largestReceivedPacketNum = readOptionalInteger(cursor);
+    auto numAcks = cursor.readBE<uint32_t>();
+    for (uint32_t i = 0; i < numAcks; ++i) {
+      auto start = cursor.readBE<uint64_t>();
+      auto end = cursor.readBE<uint64_t>();
+      state.acks.insert(start, end);
+    }
+
+    state.windowSize = cursor.readBE<uint64_t>();
+    state.advertisedMaxOffset = cursor.readBE<uint64_t>();
+    state.peerAdvertisedMaxOffset = cursor.readBE<uint64_t>();
+    state.sumCurReadOffset = cursor.readBE<uint64_t>();
+    state.sumMaxObservedOffset = cursor.readBE<uint64_t>();
+    state.sumCurWriteOffset = cursor.readBE<uint64_t>();
+    state.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+        cursor.readBE<uint64_t>();
+    state.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        cursor.readBE<uint64_t>();
+    state.peerAdvertisedInitialMaxStreamOffsetUni = cursor.readBE<uint64_t>();
+    state.streamIds = readStreamIds(cursor);
+
+    state.peerIdleTimeout =
+        std::chrono::milliseconds(cursor.readBE<uint64_t>());
+    state.peerAckDelayExponent = cursor.readBE<uint64_t>();
+    state.udpSendPacketLen = cursor.readBE<uint64_t>();
+    state.partialReliabilityEnabled = readBool(cursor);
+    auto peerMinAckDelay = readOptionalInteger(cursor);
+    if (peerMinAckDelay) {
+      state.peerMinAckDelay = std::chrono::microseconds(*peerMinAckDelay);
+    }
+    state.maxDatagramWriteFrameSize = cursor.readBE<uint64_t>();
+
+    state.maxAckDelay = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    state.srtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    state.lrtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    state.rttvar = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    state.mrtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    state.congestionWindow = cursor.readBE<uint64_t>();
+  } catch (const std::exception&) {
+    return folly::none;
+  }
+  return state;
+}
+
+folly::Optional<ConnectionHandoffState> makeConnectionHandoffState(
+    const QuicServerConnectionState& conn) {
+  auto secrets = conn.serverHandshakeLayer->getOneRttSecrets();
+  if (!secrets || !conn.version || !conn.readCodec) {
+    return folly::none;
+  }
+  ConnectionHandoffState state;
+  state.version = *conn.version;
+  state.peerAddress = conn.peerAddress;
+  state.originalPeerAddress = conn.originalPeerAddress;
+  state.applicationProtocol =
+      conn.serverHandshakeLayer->getApplicationProtocol();
+
+  state.cipher = secrets->cipher;
+  state.readSecret = std::move(secrets->readSecret);
+  state.writeSecret = std::move(secrets->writeSecret);
+  state.readKeyGeneration = conn.readCodec->getOneRttReadKeyGeneration();
+  state.writeKeyGeneration = conn.oneRttWriteKeyGeneration;
+
+  state.clientChosenDestConnectionId = conn.clientChosenDestConnectionId;
+  state.clientConnectionId = conn.clientConnectionId;
+  state.serverConnectionId = conn.serverConnectionId;
+  state.selfConnectionIds = conn.selfConnectionIds;
+  state.peerConnectionIds = conn.peerConnectionIds;
+  state.nextSelfConnectionIdSequence = conn.nextSelfConnectionIdSequence;
+  state.peerActiveConnectionIdLimit = conn.peerActiveConnectionIdLimit;
+
+  const auto& ackState = conn.ackStates.appDataAckState;
+  state.nextPacketNum = ackState.nextPacketNum;
+  state.largestAckedByPeer = ackState.largestAckedByPeer;
+  state.largestReceivedPacketNum = ackState.largestReceivedPacketNum;
+  state.acks = ackState.acks;
+
+  const auto& flowControl = conn.flowControlState;
+  state.windowSize = flowControl.windowSize;
+  state.advertisedMaxOffset = flowControl.advertisedMaxOffset;
+  state.peerAdvertisedMaxOffset = flowControl.peerAdvertisedMaxOffset;
+  state.sumCurReadOffset = flowControl.sumCurReadOffset;
+  state.sumMaxObservedOffset = flowControl.sumMaxObservedOffset;
+  state.sumCurWriteOffset = flowControl.sumCurWriteOffset;
+  state.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+      flowControl.peerAdvertisedInitialMaxStreamOffsetBidiLocal;
+  state.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+      flowControl.peerAdvertisedInitialMaxStreamOffsetBidiRemote;
+  state.peerAdvertisedInitialMaxStreamOffsetUni =
+      flowControl.peerAdvertisedInitialMaxStreamOffsetUni;
+  state.streamIds = conn.streamManager->getStreamIdState();
+
+  state.peerIdleTimeout = conn.peerIdleTimeout;
+  state.peerAckDelayExponent = conn.peerAckDelayExponent;
+  state.udpSendPacketLen = conn.udpSendPacketLen;
+  state.partialReliabilityEnabled = conn.partialReliabilityEnabled;
+  state.peerMinAckDelay = conn.ackFrequencyState.peerMinAckDelay;
+  state.maxDatagramWriteFrameSize = conn.datagramState.maxWriteFrameSize;
+
+  state.maxAckDelay = conn.lossState.maxAckDelay;
+  state.srtt = conn.lossState.srtt;
+  state.lrtt = conn.lossState.lrtt;
+  state.rttvar = conn.lossState.rttvar;
+  state.mrtt = conn.lossState.mrtt;
+  if (conn.congestionController) {
+    state.congestionWindow = conn.congestionController->getCongestionWindow();
+  }
+  return state;
+}
+
+void applyConnectionHandoffState(
+    QuicServerConnectionState& conn,
+    const ConnectionHandoffState& state) {
+  CHECK(state.clientConnectionId && state.serverConnectionId);
+  conn.version = state.version;
+  conn.originalVersion = state.version;
+  conn.peerAddress = state.peerAddress;
+  conn.originalPeerAddress = state.originalPeerAddress;
+
+  conn.clientChosenDestConnectionId = state.clientChosenDestConnectionId;
+  conn.clientConnectionId = state.clientConnectionId;
+  conn.serverConnectionId = state.serverConnectionId;
+  conn.selfConnectionIds = state.selfConnectionIds;
+  conn.peerConnectionIds = state.peerConnectionIds;
+  conn.nextSelfConnectionIdSequence = state.nextSelfConnectionIdSequence;
+  conn.peerActiveConnectionIdLimit = state.peerActiveConnectionIdLimit;
+
+  conn.peerIdleTimeout = state.peerIdleTimeout;
+  conn.peerAckDelayExponent = state.peerAckDelayExponent;
+  conn.udpSendPacketLen = state.udpSendPacketLen;
+  conn.partialReliabilityEnabled = state.partialReliabilityEnabled;
+  conn.ackFrequencyState.peerMinAckDelay = state.peerMinAckDelay;
+  conn.datagramState.maxWriteFrameSize = state.maxDatagramWriteFrameSize;
+
+  ServerHandshake::OneRttSecrets secrets;
+  secrets.cipher = state.cipher;
+  secrets.readSecret = state.readSecret;
+  secrets.writeSecret = state.writeSecret;
+  auto handshakeLayer = conn.serverHandshakeLayer;
+  handshakeLayer->importOneRttSecrets(
+      secrets,
+      state.readKeyGeneration,
+      state.writeKeyGeneration,
+      state.applicationProtocol);
+  conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+  conn.readCodec->setClientConnectionId(*state.clientConnectionId);
+  conn.readCodec->setServerConnectionId(*state.serverConnectionId);
+  conn.readCodec->setCodecParameters(
+      CodecParameters(conn.peerAckDelayExponent, state.version));
+  conn.readCodec->setOneRttReadCipher(handshakeLayer->getOneRttReadCipher());
+  conn.readCodec->setOneRttHeaderCipher(
+      handshakeLayer->getOneRttReadHeaderCipher());
+  conn.readCodec->setOneRttReadKeyGeneration(state.readKeyGeneration);
+  conn.oneRttWriteCipher = handshakeLayer->getOneRttWriteCipher();
+  conn.oneRttWriteHeaderCipher = handshakeLayer->getOneRttWriteHeaderCipher();
+  conn.oneRttWriteKeyGeneration = state.writeKeyGeneration;
+  // The next key update waits for the peer to ack a packet of this process.
+  conn.oneRttWriteGenerationStart = state.nextPacketNum;
+  conn.writableBytesLimit = folly::none;
+  handshakeConfirmed(conn);
+
+  auto& ackState = conn.ackStates.appDataAckState;
+  ackState.nextPacketNum = state.nextPacketNum;
+  ackState.largestAckedByPeer = state.largestAckedByPeer;
+  ackState.largestReceivedPacketNum = state.largestReceivedPacketNum;
+  ackState.acks = state.acks;
+
+  auto& flowControl = conn.flowControlState;
+  flowControl.windowSize = state.windowSize;
+  flowControl.advertisedMaxOffset = state.advertisedMaxOffset;
+  flowControl.peerAdvertisedMaxOffset = state.peerAdvertisedMaxOffset;
+  flowControl.sumCurReadOffset = state.sumCurReadOffset;
+  flowControl.sumMaxObservedOffset = state.sumMaxObservedOffset;
+  flowControl.sumCurWriteOffset = state.sumCurWriteOffset;
+  flowControl.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+      state.peerAdvertisedInitialMaxStreamOffsetBidiLocal;
+  flowControl.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+      state.peerAdvertisedInitialMaxStreamOffsetBidiRemote;
+  flowControl.peerAdvertisedInitialMaxStreamOffsetUni =
+      state.peerAdvertisedInitialMaxStreamOffsetUni;
+  conn.streamManager->setStreamIdState(state.streamIds);
+
+  conn.lossState.maxAckDelay = state.maxAckDelay;
+  conn.lossState.srtt = state.srtt;
+  conn.lossState.lrtt = state.lrtt;
+  conn.lossState.rttvar = state.rttvar;
+  conn.lossState.mrtt = state.mrtt;
+  if (state.congestionWindow > 0 && conn.congestionControllerFactory) {
+    // Carry on with the window the connection had, like a warm start.
+    conn.warmStartCwndBytes = state.congestionWindow;
+    conn.congestionController =
+        conn.congestionControllerFactory->makeCongestionController(
+            conn, conn.congestionController->type());
+  }
+  updatePacingOnKeyEstablished(conn);
+  if (conn.pacer && state.congestionWindow > 0 && state.srtt > 0us) {
+    conn.pacer->refreshPacingRate(state.congestionWindow, state.srtt);
+  }
+}
+
+} // namespace quic
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/codec/Types.h>
+#include <quic/state/QuicStreamManager.h>
+
+#include <fizz/record/Types.h>
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+struct QuicServerConnectionState;
+
+enum class ConnectionHandoffVersion : uint32_t {
+  V1 = 0x00000001,
+};
+
+/**
+ * What a new process needs to carry on an established connection of the
+ * process it takes over from, without the peer noticing. Only connections
+ * with nothing in flight and no open streams are handed off, see
+ * QuicServerTransport::exportHandoffState, so this is the connection's keys,
+ * ids, packet number and flow control state, the peer's transport parameters
+ * and the state congestion control starts again from.
+ */
+struct ConnectionHandoffState {
+  QuicVersion version{QuicVersion::MVFST_INVALID};
+  folly::SocketAddress peerAddress;
+  folly::SocketAddress originalPeerAddress;
+  folly::Optional<std::string> applicationProtocol;
+
+  // 1-RTT secrets of the first key phase and the generations the keys got to
+  fizz::CipherSuite cipher{fizz::CipherSuite::TLS_AES_128_GCM_SHA256};
+  std::vector<uint8_t> readSecret;
+  std::vector<uint8_t> writeSecret;
+  uint64_t readKeyGeneration{0};
+  uint64_t writeKeyGeneration{0};
+
+  folly::Optional<ConnectionId> clientChosenDestConnectionId;
+  folly::Optional<ConnectionId> clientConnectionId;
+  folly::Optional<ConnectionId> serverConnectionId;
+  std::vector<ConnectionIdData> selfConnectionIds;
+  std::vector<ConnectionIdData> peerConnectionIds;
+  uint64_t nextSelfConnectionIdSequence{0};
+  uint64_t peerActiveConnectionIdLimit{0};
+
+  // AppData packet number space
+  PacketNum nextPacketNum{0};
+  PacketNum largestAckedByPeer{0};
+  folly::Optional<PacketNum> largestReceivedPacketNum;
+  AckBlocks acks;
+
+  // Connection flow control
+  uint64_t windowSize{0};
+  uint64_t advertisedMaxOffset{0};
+  uint64_t peerAdvertisedMaxOffset{0};
+  uint64_t sumCurReadOffset{0};
+  uint64_t sumMaxObservedOffset{0};
+  uint64_t sumCurWriteOffset{0};
+  uint64_t peerAdvertisedInitialMaxStreamOffsetBidiLocal{0};
+  uint64_t peerAdvertisedInitialMaxStreamOffsetBidiRemote{0};
+  uint64_t peerAdvertisedInitialMaxStreamOffsetUni{0};
+  QuicStreamManager::StreamIdState streamIds;
+
+  // What the peer's transport parameters set
+  std::chrono::milliseconds peerIdleTimeout{0};
+  uint64_t peerAckDelayExponent{kDefaultAckDelayExponent};
+  uint64_t udpSendPacketLen{kDefaultUDPSendPacketLen};
+  bool partialReliabilityEnabled{false};
+  folly::Optional<std::chrono::microseconds> peerMinAckDelay;
+  uint64_t maxDatagramWriteFrameSize{0};
+
+  // Rtt estimates and congestion window
+  std::chrono::microseconds maxAckDelay{0};
+  std::chrono::microseconds srtt{0};
+  std::chrono::microseconds lrtt{0};
+  std::chrono::microseconds rttvar{0};
+  std::chrono::microseconds mrtt{kDefaultMinRtt};
+  uint64_t congestionWindow{0};
+};
+
+std::unique_ptr<folly::IOBuf> encodeConnectionHandoffState(
+    const ConnectionHandoffState& state);
+
+/**
+ * None if the buffer doesn't hold a state of a version this process knows.
+ */
+folly::Optional<ConnectionHandoffState> decodeConnectionHandoffState(
+    const folly::IOBuf& buf);
+
+/**
+ * The handoff state of the connection, none until its 1-RTT secrets are
+ * derived.
+ */
+folly::Optional<ConnectionHandoffState> makeConnectionHandoffState(
+    const QuicServerConnectionState& conn);
+
+/**
+ * Sets a new connection up from the state of a connection handed off, in
+ * place of the handshake. The handshake layer must have been initialized and
+ * the connection id algo and congestion controller factory set.
+ */
+void applyConnectionHandoffState(
+    QuicServerConnectionState& conn,
+    const ConnectionHandoffState& state);
+
+} // namespace quic
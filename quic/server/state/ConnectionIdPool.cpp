@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ConnectionIdPool.h>
+
+#include <algorithm>
+
+namespace quic {
+
+ConnectionIdPool::ConnectionIdPool(
+    ConnectionIdAlgo& connIdAlgo,
+    const ServerConnectionIdParams& params,
+    const StatelessResetSecret& secret,
+    const folly::SocketAddress& serverAddr,
+    size_t batchSize)
+    : connIdAlgo_(connIdAlgo),
+      params_(params),
+      secret_(secret),
+      serverAddr_(serverAddr),
+      generator_(secret, serverAddr.getFullyQualified()),
+      batchSize_(std::max<size_t>(batchSize, 1)) {
+  entries_.reserve(batchSize_);
+}
+
+bool ConnectionIdPool::matches(
+    const ServerConnectionIdParams& params,
+    const StatelessResetSecret& secret,
+    const folly::SocketAddress& serverAddr) const {
+  return params.version == params_.version &&
+      params.hostId == params_.hostId &&
+      params.processId == params_.processId &&
+      params.workerId == params_.workerId && secret == secret_ &&
+      serverAddr == serverAddr_;
+}
+
+folly::Optional<ConnectionIdPool::Entry> ConnectionIdPool::take() {
+  if (entries_.empty()) {
+    refill();
+    if (entries_.empty()) {
+      return folly::none;
+    }
+  }
+  auto entry = std::move(entries_.back());
+  entries_.pop_back();
+  return entry;
+}
+
+void ConnectionIdPool::refill() {
+  for (size_t i = 0; i < batchSize_; i++) {
+    auto encodedCid = connIdAlgo_.encodeConnectionId(params_);
+    if (encodedCid.hasError()) {
+      return;
+    }
+    auto token = generator_.generateToken(*encodedCid);
+    entries_.push_back(Entry{std::move(*encodedCid), token});
+  }
+}
+
+} // namespace quic
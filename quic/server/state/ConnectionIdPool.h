@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/server/handshake/StatelessResetGenerator.h>
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * The connection ids of a worker not handed out yet, each with its stateless
+ * reset token. They are made batchSize at a time, when the pool runs out, so
+ * the connections of the worker take ready ones for their handshake and for
+ * the ids they issue rather than each deriving its own tokens.
+ */
+class ConnectionIdPool {
+ public:
+  struct Entry {
+    ConnectionId connId;
+    StatelessResetToken token;
+  };
+
+  ConnectionIdPool(
+      ConnectionIdAlgo& connIdAlgo,
+      const ServerConnectionIdParams& params,
+      const StatelessResetSecret& secret,
+      const folly::SocketAddress& serverAddr,
+      size_t batchSize);
+
+  /**
+   * Whether the ids of the pool are the ones a connection with these
+   * parameters would make itself.
+   */
+  bool matches(
+      const ServerConnectionIdParams& params,
+      const StatelessResetSecret& secret,
+      const folly::SocketAddress& serverAddr) const;
+
+  /**
+   * The next id of the pool, none if the connection id algo fails to make
+   * more.
+   */
+  folly::Optional<Entry> take();
+
+  // the ids made and not taken yet
+  size_t size() const {
+    return entries_.size();
+  }
+
+ private:
+  void refill();
+
+  ConnectionIdAlgo& connIdAlgo_;
+  ServerConnectionIdParams params_;
+  StatelessResetSecret secret_;
+  folly::SocketAddress serverAddr_;
+  StatelessResetGenerator generator_;
+  size_t batchSize_;
+  std::vector<Entry> entries_;
+};
+
+} // namespace quic
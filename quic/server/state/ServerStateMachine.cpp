@@ -56,16 +56,22 @@ CongestionAndRttState moveCurrentCongestionAndRttState(
   return state;
 }
 
+void resetRttState(QuicServerConnectionState& conn) {
+  conn.lossState.srtt = 0us;
+  conn.lossState.lrtt = 0us;
+  conn.lossState.rttvar = 0us;
+  conn.lossState.mrtt = kDefaultMinRtt;
+}
+
 void resetCongestionAndRttState(QuicServerConnectionState& conn) {
   CHECK(conn.congestionControllerFactory)
       << "CongestionControllerFactory is not set.";
+  // The cached congestion state was of the old path.
+  conn.warmStartCwndBytes = folly::none;
   conn.congestionController =
       conn.congestionControllerFactory->makeCongestionController(
           conn, conn.transportSettings.defaultCongestionController);
-  conn.lossState.srtt = 0us;
-  conn.lossState.lrtt = 0us;
-  conn.lossState.rttvar = 0us;
-  conn.lossState.mrtt = kDefaultMinRtt;
+  resetRttState(conn);
 }
 
 void recoverOrResetCongestionAndRttState(
@@ -120,6 +126,15 @@ void processClientInitialParams(
   auto activeConnectionIdLimit = getIntegerParameter(
       TransportParameterId::active_connection_id_limit,
       clientParams.parameters);
+  auto minAckDelay = getIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      clientParams.parameters);
+  auto maxDatagramFrameSize = getIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      clientParams.parameters);
+  auto streamRepairReceiveWindow = getIntegerParameter(
+      static_cast<TransportParameterId>(kStreamRepairReceiveWindowParameterId),
+      clientParams.parameters);
 
   if (!packetSize || *packetSize == 0) {
     packetSize = kDefaultMaxUDPPayload;
@@ -160,10 +175,11 @@ void processClientInitialParams(
   }
   conn.peerAckDelayExponent =
       ackDelayExponent.value_or(kDefaultAckDelayExponent);
-  // TODO: udpSendPacketLen should also be limited by PMTU
   if (conn.transportSettings.canIgnorePathMTU) {
     conn.udpSendPacketLen =
         std::min<uint64_t>(*packetSize, kDefaultMaxUDPPayload);
+  } else {
+    startPmtuDiscovery(conn, *packetSize);
   }
 
   conn.peerActiveConnectionIdLimit =
@@ -175,6 +191,15 @@ void processClientInitialParams(
   }
   VLOG(10) << "conn.partialReliabilityEnabled="
            << conn.partialReliabilityEnabled;
+
+  if (minAckDelay && conn.transportSettings.ackFrequencyEnabled) {
+    conn.ackFrequencyState.peerMinAckDelay =
+        std::chrono::microseconds(*minAckDelay);
+  }
+
+  conn.datagramState.maxWriteFrameSize = maxDatagramFrameSize.value_or(0);
+  conn.streamRepairState.peerReceiveWindow =
+      streamRepairReceiveWindow.value_or(0);
 }
 
 void updateHandshakeState(QuicServerConnectionState& conn) {
@@ -383,15 +408,21 @@ void onConnectionMigration(
     // If we are already in the middle of a migration reset
     // the available bytes in the rate-limited window, but keep the
     // window.
-    conn.pathValidationLimiter =
-        std::make_unique<PendingPathRateLimiter>(conn.udpSendPacketLen);
+    conn.pathValidationLimiter = std::make_unique<PendingPathRateLimiter>(
+        conn.udpSendPacketLen,
+        conn.transportSettings.pathValidationCreditInMss);
   } else {
     previousPeerAddresses.erase(it);
   }
 
   // At this point, path validation scheduled, writable bytes limit set
-  // However if this is NAT rebinding, keep congestion state unchanged
+  // However if this is NAT rebinding, keep congestion state unchanged. The
+  // route through the new binding can still be different, only the rtt is
+  // sampled again.
   bool isNATRebinding = maybeNATRebinding(newPeerAddress, conn.peerAddress);
+  if (isNATRebinding) {
+    resetRttState(conn);
+  }
 
   // Cancel current path validation if any
   if (hasPendingPathChallenge || conn.outstandingPathValidation) {
@@ -416,6 +447,11 @@ void onConnectionMigration(
     }
   }
 
+  if (!isNATRebinding) {
+    // The new path can carry smaller packets than the old one.
+    restartPmtuDiscovery(conn);
+  }
+
   if (conn.qLogger) {
     conn.qLogger->addConnectionMigrationUpdate(isIntentional);
   }
@@ -585,12 +621,36 @@ void onServerReadDataFromOpen(
             conn.transportSettings.ackDelayExponent,
             conn.transportSettings.maxRecvPacketSize,
             conn.transportSettings.partialReliabilityEnabled,
-            *newServerConnIdData->token));
+            *newServerConnIdData->token,
+            conn.transportSettings.ackFrequencyEnabled,
+            conn.retryOriginalDstConnId,
+            conn.transportSettings.maxRecvDatagramFrameSize,
+            conn.transportSettings.streamRepairReceiveWindow,
+            conn.transportParametersCache));
     conn.transportParametersEncoded = true;
     CryptoFactory& cryptoFactory = *conn.serverHandshakeLayer->cryptoFactory_;
     conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
-    conn.readCodec->setInitialReadCipher(cryptoFactory.getClientInitialCipher(
-        initialDestinationConnectionId, version));
+    if (conn.initialCipherCache) {
+      const auto& ciphers = conn.initialCipherCache->getCiphers(
+          cryptoFactory, initialDestinationConnectionId, version);
+      conn.readCodec->setInitialReadCipher(
+          makeSharedAead(ciphers.clientCipher));
+      conn.initialWriteCipher = makeSharedAead(ciphers.serverCipher);
+      conn.readCodec->setInitialHeaderCipher(
+          makeSharedPacketNumberCipher(ciphers.clientHeaderCipher));
+      conn.initialHeaderCipher =
+          makeSharedPacketNumberCipher(ciphers.serverHeaderCipher);
+    } else {
+      conn.readCodec->setInitialReadCipher(cryptoFactory.getClientInitialCipher(
+          initialDestinationConnectionId, version));
+      conn.initialWriteCipher = cryptoFactory.getServerInitialCipher(
+          initialDestinationConnectionId, version);
+      conn.readCodec->setInitialHeaderCipher(
+          cryptoFactory.makeClientInitialHeaderCipher(
+              initialDestinationConnectionId, version));
+      conn.initialHeaderCipher = cryptoFactory.makeServerInitialHeaderCipher(
+          initialDestinationConnectionId, version);
+    }
     conn.readCodec->setClientConnectionId(clientConnectionId);
     conn.readCodec->setServerConnectionId(*conn.serverConnectionId);
     if (conn.qLogger) {
@@ -599,14 +659,6 @@ void onServerReadDataFromOpen(
     }
     conn.readCodec->setCodecParameters(
         CodecParameters(conn.peerAckDelayExponent, version));
-    conn.initialWriteCipher = cryptoFactory.getServerInitialCipher(
-        initialDestinationConnectionId, version);
-
-    conn.readCodec->setInitialHeaderCipher(
-        cryptoFactory.makeClientInitialHeaderCipher(
-            initialDestinationConnectionId, version));
-    conn.initialHeaderCipher = cryptoFactory.makeServerInitialHeaderCipher(
-        initialDestinationConnectionId, version);
     conn.peerAddress = conn.originalPeerAddress;
   }
   BufQueue udpData;
@@ -704,6 +756,12 @@ void onServerReadDataFromOpen(
       conn.qLogger->dcid = conn.clientConnectionId;
       conn.qLogger->scid = conn.serverConnectionId;
     }
+    QUIC_PROBE(
+        packet_received,
+        conn,
+        packetNum,
+        static_cast<uint8_t>(packetNumberSpace),
+        packetSize);
     // We assume that the higher layer takes care of validating that the version
     // is supported.
     if (!conn.version) {
@@ -751,6 +809,7 @@ void onServerReadDataFromOpen(
     auto& ackState = getAckState(conn, packetNumberSpace);
     auto outOfOrder = updateLargestReceivedPacketNum(
         ackState, packetNum, readData.networkData.receiveTimePoint);
+    updateEcnCounts(ackState, readData.networkData.ecn);
     DCHECK(hasReceivedPackets(conn));
 
     bool pktHasRetransmittableData = false;
@@ -967,6 +1026,15 @@ void onServerReadDataFromOpen(
               conn, simpleFrame, packetNum, readData.peer != conn.peerAddress);
           break;
         }
+        case QuicFrame::Type::DatagramFrame_E: {
+          DatagramFrame& frame = *quicFrame.asDatagramFrame();
+          VLOG(10) << "Server received datagram len=" << frame.length << " "
+                   << conn;
+          pktHasRetransmittableData = true;
+          isNonProbingPacket = true;
+          handleDatagram(conn, std::move(frame));
+          break;
+        }
         default: {
           break;
         }
@@ -1045,7 +1113,12 @@ void onServerReadDataFromOpen(
         outOfOrder,
         pktHasRetransmittableData,
         pktHasCryptoData);
-    QUIC_STATS(conn.infoCallback, onPacketProcessed);
+    QUIC_STATS_COUNTER(
+        conn.statsCounters,
+        PacketsProcessed,
+        1,
+        conn.infoCallback,
+        onPacketProcessed);
   }
   VLOG_IF(4, !udpData.empty())
       << "Leaving " << udpData.chainLength()
@@ -1198,6 +1271,22 @@ QuicServerConnectionState::createAndAddNewSelfConnId() {
 
   CHECK(transportSettings.statelessResetTokenSecret);
 
+  if (connIdPool &&
+      connIdPool->matches(
+          *serverConnIdParams,
+          *transportSettings.statelessResetTokenSecret,
+          serverAddr)) {
+    auto entry = connIdPool->take();
+    if (!entry) {
+      return folly::none;
+    }
+    auto newConnIdData = ConnectionIdData{
+        std::move(entry->connId), nextSelfConnectionIdSequence++};
+    newConnIdData.token = entry->token;
+    selfConnectionIds.push_back(newConnIdData);
+    return newConnIdData;
+  }
+
   StatelessResetGenerator generator(
       transportSettings.statelessResetTokenSecret.value(),
       serverAddr.getFullyQualified());
@@ -14,12 +14,16 @@
 
 #include <quic/QuicException.h>
 #include <quic/codec/Types.h>
+#include <quic/common/RecycledBlocks.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/congestion_control/QuicCubic.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/handshake/InitialCipherCache.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/loss/QuicLossFunctions.h>
+#include <quic/server/handshake/AppToken.h>
 #include <quic/server/handshake/ServerHandshake.h>
+#include <quic/server/state/ConnectionIdPool.h>
 #include <quic/state/AckHandlers.h>
 #include <quic/state/QPRFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
@@ -96,10 +100,30 @@ struct QuicServerConnectionState : public QuicConnectionStateBase {
   // Parameters to generate server chosen connection id
   folly::Optional<ServerConnectionIdParams> serverConnIdParams;
 
+  // The destination connection id of the client's first Initial, when the
+  // client came back after a Retry. It goes into the original_connection_id
+  // transport parameter.
+  folly::Optional<ConnectionId> retryOriginalDstConnId;
+
+  // The Initial ciphers of the worker's recent connections, if it keeps them.
+  std::shared_ptr<InitialCipherCache> initialCipherCache;
+
+  // The decoded app tokens of the worker's recent resumptions, if it keeps
+  // them.
+  std::shared_ptr<AppTokenCache> appTokenCache;
+
+  // The encoded transport parameters of the worker's settings, if it keeps
+  // them.
+  std::shared_ptr<ServerTransportParametersCache> transportParametersCache;
+
   // ConnectionIdAlgo implementation to encode and decode ConnectionId with
   // various info, such as routing related info.
   ConnectionIdAlgo* connIdAlgo{nullptr};
 
+  // The worker's pool of connection ids to take new ones from, if it keeps
+  // one. Only used when it matches the connection's own parameters.
+  std::shared_ptr<ConnectionIdPool> connIdPool;
+
   // Source address token that can be saved to client via PSK.
   // Address with higher index is more recently used.
   std::vector<folly::IPAddress> tokenSourceAddresses;
@@ -120,6 +144,15 @@ struct QuicServerConnectionState : public QuicConnectionStateBase {
 
   folly::Optional<ConnectionIdData> createAndAddNewSelfConnId() override;
 
+  // The storage is reused from the connection states freed on the thread.
+  static void* operator new(size_t size) {
+    return allocateRecycledBlock(size);
+  }
+
+  static void operator delete(void* block, size_t size) noexcept {
+    releaseRecycledBlock(block, size);
+  }
+
   QuicServerConnectionState() : QuicConnectionStateBase(QuicNodeType::Server) {
     state = ServerState::Open;
     // Create the crypto stream.
@@ -112,5 +112,26 @@ class MockRoutingCallback : public QuicServerTransport::RoutingCallback {
           QuicServerTransport*,
           const QuicServerTransport::SourceIdentity&,
           const std::vector<ConnectionIdData>& connIdData));
+
+  bool onConnectionDraining(
+      QuicServerTransport* transport,
+      const folly::SocketAddress& peerAddress,
+      const std::vector<ConnectionIdData>& connIdData,
+      Buf closePacket,
+      std::chrono::milliseconds drainPeriod) noexcept override {
+    return _onConnectionDraining(
+        transport, peerAddress, connIdData, closePacket.get(), drainPeriod);
+  }
+  GMOCK_METHOD5_(
+      ,
+      noexcept,
+      ,
+      _onConnectionDraining,
+      bool(
+          QuicServerTransport*,
+          const folly::SocketAddress&,
+          const std::vector<ConnectionIdData>& connIdData,
+          folly::IOBuf*,
+          std::chrono::milliseconds));
 };
 } // namespace quic
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/OverloadController.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/QuicConstants.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+using Level = OverloadController::Level;
+
+class CountingEventBaseObserver : public folly::EventBaseObserver {
+ public:
+  uint32_t getSampleRate() const override {
+    return 1;
+  }
+
+  void loopSample(int64_t, int64_t) override {
+    ++samples;
+  }
+
+  uint32_t samples{0};
+};
+
+class OverloadControllerTest : public Test {
+ public:
+  // Runs loops busy for busyPercent of a whole sample window
+  void runWindow(
+      OverloadController& controller,
+      int64_t busyPercent,
+      int64_t loops = 10) {
+    int64_t loopTime = kOverloadSampleWindow.count() * 1000 / loops;
+    int64_t busy = loopTime * busyPercent / 100;
+    for (int64_t i = 0; i < loops; ++i) {
+      controller.loopSample(busy, loopTime - busy);
+    }
+  }
+};
+
+TEST_F(OverloadControllerTest, LevelsFollowBusyShare) {
+  OverloadController controller(std::chrono::microseconds::zero(), 0);
+  runWindow(controller, 50);
+  EXPECT_EQ(controller.getLevel(), Level::NONE);
+  EXPECT_DOUBLE_EQ(controller.getLoad(), 0.5);
+  runWindow(controller, 75);
+  EXPECT_EQ(controller.getLevel(), Level::RETRY);
+  runWindow(controller, 85);
+  EXPECT_EQ(controller.getLevel(), Level::NO_ZERO_RTT);
+  runWindow(controller, 95);
+  EXPECT_EQ(controller.getLevel(), Level::SMALL_WINDOWS);
+  runWindow(controller, 100);
+  EXPECT_EQ(controller.getLevel(), Level::REJECT);
+
+  // Within the hysteresis the level stays.
+  runWindow(controller, 92);
+  EXPECT_EQ(controller.getLevel(), Level::REJECT);
+  // Below it, the level drops to what the load is at.
+  runWindow(controller, 65);
+  EXPECT_EQ(controller.getLevel(), Level::RETRY);
+  runWindow(controller, 20);
+  EXPECT_EQ(controller.getLevel(), Level::NONE);
+}
+
+TEST_F(OverloadControllerTest, LoopLag) {
+  OverloadController controller(std::chrono::milliseconds(10), 0);
+  // A single long loop in an otherwise idle window.
+  controller.loopSample(10000, 0);
+  controller.loopSample(0, 90000);
+  EXPECT_EQ(controller.getLevel(), Level::REJECT);
+  runWindow(controller, 50, 100);
+  EXPECT_EQ(controller.getLevel(), Level::NONE);
+}
+
+TEST_F(OverloadControllerTest, MemoryBudget) {
+  uint64_t memoryUsage = 0;
+  OverloadController controller(
+      std::chrono::microseconds::zero(), 1000, [&] { return memoryUsage; });
+  runWindow(controller, 10);
+  EXPECT_EQ(controller.getLevel(), Level::NONE);
+  memoryUsage = 850;
+  runWindow(controller, 10);
+  EXPECT_EQ(controller.getLevel(), Level::NO_ZERO_RTT);
+  EXPECT_DOUBLE_EQ(controller.getLoad(), 0.85);
+  memoryUsage = 0;
+  runWindow(controller, 10);
+  EXPECT_EQ(controller.getLevel(), Level::NONE);
+}
+
+TEST_F(OverloadControllerTest, ForwardsSamples) {
+  OverloadController controller(std::chrono::microseconds::zero(), 0);
+  auto observer = std::make_shared<CountingEventBaseObserver>();
+  controller.setObserver(observer);
+  // Every other loop, like the evb would.
+  runWindow(controller, 50, 10);
+  EXPECT_EQ(observer->samples, 5);
+}
+
+} // namespace test
+} // namespace quic
@@ -91,6 +91,39 @@ TEST_F(SimpleQuicServerWorkerTest, TurnOffPMTU) {
   worker_->bind(addr);
 }
 
+TEST_F(SimpleQuicServerWorkerTest, AddSocket) {
+  auto sock =
+      std::make_unique<NiceMock<folly::test::MockAsyncUDPSocket>>(&eventbase_);
+  rawSocket_ = sock.get();
+  auto sock2 =
+      std::make_unique<NiceMock<folly::test::MockAsyncUDPSocket>>(&eventbase_);
+  auto rawSocket2 = sock2.get();
+  workerCb_ = std::make_shared<NiceMock<MockWorkerCallback>>();
+  worker_ = std::make_unique<QuicServerWorker>(workerCb_);
+  worker_->setSocket(std::move(sock));
+  worker_->setSupportedVersions({QuicVersion::MVFST});
+  folly::SocketAddress addr("::1", 0);
+  worker_->bind(addr);
+  EXPECT_EQ(worker_->getNumSockets(), 1);
+  EXPECT_FALSE(worker_->shouldOnlyNotify());
+
+  EXPECT_CALL(*rawSocket2, bind(addr));
+  EXPECT_CALL(*rawSocket2, setDFAndTurnOffPMTU());
+  worker_->addSocket(std::move(sock2), addr);
+  EXPECT_EQ(worker_->getNumSockets(), 2);
+  // The sockets of the worker are all read in batches.
+  EXPECT_TRUE(worker_->shouldOnlyNotify());
+
+  EXPECT_CALL(*rawSocket_, resumeRead(worker_.get()));
+  EXPECT_CALL(*rawSocket2, resumeRead(worker_.get()));
+  worker_->start();
+  EXPECT_CALL(*rawSocket_, pauseRead());
+  EXPECT_CALL(*rawSocket2, pauseRead());
+  worker_->pauseRead();
+  Mock::VerifyAndClearExpectations(rawSocket_);
+  Mock::VerifyAndClearExpectations(rawSocket2);
+}
+
 std::unique_ptr<folly::IOBuf> createData(size_t size) {
   std::string data;
   data.resize(size);
@@ -109,7 +142,8 @@ class QuicServerWorkerTest : public Test {
     worker_ = std::make_unique<QuicServerWorker>(workerCb_);
     auto transportInfoCb = std::make_unique<NiceMock<MockQuicStats>>();
     TransportSettings settings;
-    settings.statelessResetTokenSecret = getRandSecret();
+    resetSecret_ = getRandSecret();
+    settings.statelessResetTokenSecret = resetSecret_;
     worker_->setTransportSettings(settings);
     worker_->setSocket(std::move(sock));
     worker_->setWorkerId(42);
@@ -189,6 +223,7 @@ class QuicServerWorkerTest : public Test {
   folly::test::MockAsyncUDPSocket* socketPtr_{nullptr};
   uint16_t hostId_{49};
   bool hasShutdown_{false};
+  std::array<uint8_t, kStatelessResetTokenSecretLength> resetSecret_;
 };
 
 void QuicServerWorkerTest::expectConnectionCreation(
@@ -273,7 +308,7 @@ void QuicServerWorkerTest::createQuicConnection(
 
 void QuicServerWorkerTest::testSendReset(
     Buf packet,
-    ConnectionId,
+    ConnectionId connId,
     ShortHeader shortHeader,
     QuicTransportStatsCallback::PacketDropReason dropReason) {
   EXPECT_CALL(*transportInfoCb_, onPacketDropped(dropReason)).Times(1);
@@ -294,8 +329,9 @@ void QuicServerWorkerTest::testSendReset(
                 Invoke([&](auto&, auto, auto) { return folly::none; }));
         codec.setOneRttReadCipher(std::move(aead));
         codec.setOneRttHeaderCipher(test::createNoOpHeaderCipher());
-        StatelessResetToken token = generateStatelessResetToken();
-        codec.setStatelessResetToken(token);
+        StatelessResetGenerator generator(
+            resetSecret_, fakeAddress_.getFullyQualified());
+        codec.setStatelessResetToken(generator.generateToken(connId));
         AckStates ackStates;
         auto packetQueue = bufToQueue(buf->clone());
         auto res = codec.parsePacket(packetQueue, ackStates);
@@ -345,6 +381,70 @@ TEST_F(QuicServerWorkerTest, NoConnFoundTestReset) {
       QuicTransportStatsCallback::PacketDropReason::CONNECTION_NOT_FOUND);
 }
 
+TEST_F(QuicServerWorkerTest, ResetsOverRateLimitNotSent) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = resetSecret_;
+  settings.statelessResetRateLimit = 1;
+  settings.statelessResetTokenCacheSize = 10;
+  worker_->setTransportSettings(settings);
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  auto connId = getTestConnectionId(hostId_ + 1);
+  auto sendPacket = [&](TimePoint receiveTime) {
+    RoutingData routingData(
+        HeaderForm::Short, false, false, connId, folly::none);
+    worker_->dispatchPacketData(
+        kClientAddr,
+        std::move(routingData),
+        NetworkData(folly::IOBuf::copyBuffer("data"), receiveTime));
+  };
+  auto now = Clock::now();
+  EXPECT_CALL(*transportInfoCb_, onStatelessReset()).Times(1);
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(1);
+  sendPacket(now);
+  sendPacket(now + 1ms);
+  Mock::VerifyAndClearExpectations(transportInfoCb_);
+  Mock::VerifyAndClearExpectations(socketPtr_);
+
+  // The budget is back once the window is over.
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  EXPECT_CALL(*transportInfoCb_, onStatelessReset()).Times(1);
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(1);
+  sendPacket(now + kStatelessResetRateLimitWindow);
+}
+
+TEST_F(QuicServerWorkerTest, ResetSentOnArrivalSocket) {
+  auto sock2 =
+      std::make_unique<NiceMock<folly::test::MockAsyncUDPSocket>>(&eventbase_);
+  auto rawSocket2 = sock2.get();
+  worker_->addSocket(std::move(sock2), fakeAddress_);
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  worker_->stopPacketForwarding();
+  auto connId = getTestConnectionId(hostId_);
+  auto sendPacket = [&](bool isForwardedData) {
+    RoutingData routingData(
+        HeaderForm::Short, false, false, connId, folly::none);
+    routingData.socketIndex = 1;
+    worker_->dispatchPacketData(
+        kClientAddr,
+        std::move(routingData),
+        NetworkData(folly::IOBuf::copyBuffer("data"), Clock::now()),
+        isForwardedData);
+  };
+
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(0);
+  EXPECT_CALL(*rawSocket2, write(kClientAddr, _)).Times(1);
+  sendPacket(false);
+  Mock::VerifyAndClearExpectations(socketPtr_);
+  Mock::VerifyAndClearExpectations(rawSocket2);
+
+  // The index of a packet forwarded from another worker is of a socket of
+  // that worker, the first socket answers it.
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, _)).Times(1);
+  EXPECT_CALL(*rawSocket2, write(_, _)).Times(0);
+  sendPacket(true);
+}
+
 TEST_F(QuicServerWorkerTest, QuicServerWorkerUnbindBeforeCidAvailable) {
   NiceMock<MockConnectionCallback> connCb;
   auto mockSock =
@@ -596,6 +696,98 @@ TEST_F(QuicServerWorkerTest, QuicShedTest) {
   createQuicConnectionDuringShedding(kClientAddr, connId);
 }
 
+TEST_F(QuicServerWorkerTest, RetryOverHandshakeRate) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.retryHandshakeRateLimit = 1;
+  worker_->setTransportSettings(settings);
+  auto makeInitial = [](const ConnectionId& dstConnId, std::string token) {
+    LongHeader header(
+        LongHeader::Types::Initial,
+        getTestConnectionId(0),
+        dstConnId,
+        1,
+        QuicVersion::MVFST,
+        std::move(token));
+    RegularQuicPacketBuilder builder(
+        kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+    auto packet = packetToBuf(std::move(builder).buildPacket());
+    packet->prependChain(createData(kMinInitialPacketSize));
+    return packet;
+  };
+  auto dispatch = [&](const folly::SocketAddress& addr,
+                      const ConnectionId& dstConnId,
+                      Buf packet) {
+    RoutingData routingData(
+        HeaderForm::Long, true, true, dstConnId, getTestConnectionId(0));
+    worker_->dispatchPacketData(
+        addr,
+        std::move(routingData),
+        NetworkData(std::move(packet), Clock::now()));
+  };
+
+  auto connId = getTestConnectionId(hostId_);
+  expectConnectionCreation(kClientAddr, connId);
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, _));
+  dispatch(kClientAddr, connId, makeInitial(connId, ""));
+  Mock::VerifyAndClearExpectations(factory_.get());
+
+  // The next client has to prove its address first.
+  folly::SocketAddress clientAddr2("2.3.4.5", 2345);
+  auto connId2 = getTestConnectionId(hostId_ + 1);
+  folly::Optional<LongHeader> retryHeader;
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  EXPECT_CALL(*transportInfoCb_, onRetrySent());
+  EXPECT_CALL(*socketPtr_, write(clientAddr2, _))
+      .WillOnce(Invoke([&](const folly::SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& buf) {
+        folly::io::Cursor cursor(buf.get());
+        auto initialByte = cursor.readBE<uint8_t>();
+        auto parsed = parseLongHeader(initialByte, cursor);
+        if (parsed && parsed->parsedLongHeader) {
+          retryHeader = parsed->parsedLongHeader->header;
+        }
+        return buf->computeChainDataLength();
+      }));
+  dispatch(clientAddr2, connId2, makeInitial(connId2, ""));
+  ASSERT_TRUE(retryHeader.has_value());
+  EXPECT_EQ(LongHeader::Types::Retry, retryHeader->getHeaderType());
+  EXPECT_EQ(connId2, *retryHeader->getOriginalDstConnId());
+  EXPECT_EQ(getTestConnectionId(0), retryHeader->getDestinationConnId());
+  EXPECT_EQ(1, worker_->getSrcToTransportMap().size());
+
+  // A token from someone else is dropped.
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::INVALID_RETRY_TOKEN));
+  dispatch(
+      folly::SocketAddress("2.3.4.6", 2345),
+      retryHeader->getSourceConnId(),
+      makeInitial(retryHeader->getSourceConnId(), retryHeader->getToken()));
+  Mock::VerifyAndClearExpectations(factory_.get());
+
+  // Coming back with the token gets it a handshake.
+  NiceMock<MockConnectionCallback> connCb;
+  auto mockSock =
+      std::make_unique<NiceMock<folly::test::MockAsyncUDPSocket>>(&eventbase_);
+  EXPECT_CALL(*mockSock, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  MockQuicTransport::Ptr transport2 = std::make_shared<MockQuicTransport>(
+      worker_->getEventBase(), std::move(mockSock), connCb, nullptr);
+  EXPECT_CALL(*transport2, getEventBase()).WillRepeatedly(Return(&eventbase_));
+  EXPECT_CALL(*transport2, getOriginalPeerAddress())
+      .WillRepeatedly(ReturnRef(clientAddr2));
+  expectConnectionCreation(clientAddr2, connId2, transport2);
+  EXPECT_CALL(*transport2, onNetworkData(clientAddr2, _));
+  dispatch(
+      clientAddr2,
+      retryHeader->getSourceConnId(),
+      makeInitial(retryHeader->getSourceConnId(), retryHeader->getToken()));
+  auto serverConn =
+      static_cast<const QuicServerConnectionState*>(transport2->getState());
+  EXPECT_EQ(connId2, *serverConn->retryOriginalDstConnId);
+  eventbase_.loop();
+}
+
 TEST_F(QuicServerWorkerTest, ZeroLengthConnectionId) {
   auto data = createData(kDefaultUDPSendPacketLen);
   auto connId = ConnectionId(std::vector<uint8_t>());
@@ -668,6 +860,52 @@ TEST_F(QuicServerWorkerTest, ConnectionIdTooShort) {
   eventbase_.loop();
 }
 
+TEST_F(QuicServerWorkerTest, VersionNegotiationOverRateLimitDropped) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.versionNegotiationRateLimit = 1;
+  worker_->setTransportSettings(settings);
+  auto srcConnId = getTestConnectionId(0);
+  auto dstConnId = getTestConnectionId(1);
+  auto makeInitial = [&] {
+    LongHeader header(
+        LongHeader::Types::Initial, srcConnId, dstConnId, 1, MVFST1);
+    RegularQuicPacketBuilder builder(
+        kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+    return packetToBuf(std::move(builder).buildPacket());
+  };
+  auto now = Clock::now();
+  EXPECT_CALL(*socketPtr_, write(_, _))
+      .WillOnce(Invoke([&](const folly::SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& buf) {
+        QuicReadCodec codec(QuicNodeType::Server);
+        auto packetQueue = bufToQueue(buf->clone());
+        auto versionPacket = codec.tryParsingVersionNegotiation(packetQueue);
+        EXPECT_TRUE(versionPacket.has_value());
+        if (versionPacket) {
+          EXPECT_EQ(versionPacket->destinationConnectionId, srcConnId);
+          EXPECT_EQ(versionPacket->sourceConnectionId, dstConnId);
+          EXPECT_EQ(
+              versionPacket->versions,
+              std::vector<QuicVersion>{QuicVersion::MVFST});
+        }
+        return buf->computeChainDataLength();
+      }));
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(QuicTransportStatsCallback::PacketDropReason::
+                          VERSION_NEGOTIATION_RATE_LIMITED))
+      .Times(1);
+  worker_->handleNetworkData(kClientAddr, makeInitial(), now);
+  worker_->handleNetworkData(kClientAddr, makeInitial(), now + 1ms);
+  Mock::VerifyAndClearExpectations(socketPtr_);
+
+  // The budget is back once the window is over.
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(1);
+  worker_->handleNetworkData(
+      kClientAddr, makeInitial(), now + kVersionNegotiationRateLimitWindow);
+}
+
 TEST_F(QuicServerWorkerTest, FailToParseConnectionId) {
   auto data = createData(kDefaultUDPSendPacketLen);
   auto srcConnId = getTestConnectionId(0);
@@ -799,6 +1037,436 @@ TEST_F(QuicServerWorkerTest, PacketAfterShutdown) {
   t.join();
 }
 
+TEST_F(QuicServerWorkerTest, RoutingBatchGroupsByConnectionId) {
+  auto connId1 = getTestConnectionId(hostId_);
+  auto connId2 = connId1;
+  connId2.data()[7] ^= 0x1;
+  auto makePacket = [](const ConnectionId& connId, PacketNum packetNum) {
+    ShortHeader header(ProtectionType::KeyPhaseZero, connId, packetNum);
+    RegularQuicPacketBuilder builder(
+        kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+    writeFrame(PaddingFrame(), builder);
+    return packetToBuf(std::move(builder).buildPacket());
+  };
+
+  std::vector<std::pair<ConnectionId, size_t>> routes;
+  EXPECT_CALL(*workerCb_, routeDataToWorkerShort(kClientAddr, _, _, false))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](const folly::SocketAddress&,
+                                 std::unique_ptr<RoutingData>& routingData,
+                                 std::unique_ptr<NetworkData>& networkData,
+                                 bool) {
+        routes.emplace_back(
+            routingData->destinationConnId, networkData->packets.size());
+      }));
+
+  auto receiveTime = Clock::now();
+  worker_->startRoutingBatch();
+  worker_->handleNetworkData(kClientAddr, makePacket(connId1, 1), receiveTime);
+  worker_->handleNetworkData(kClientAddr, makePacket(connId2, 1), receiveTime);
+  worker_->handleNetworkData(kClientAddr, makePacket(connId1, 2), receiveTime);
+  // nothing is routed until the batch is done
+  EXPECT_TRUE(routes.empty());
+  worker_->finishRoutingBatch();
+
+  ASSERT_EQ(routes.size(), 2);
+  EXPECT_EQ(routes[0].first, connId1);
+  EXPECT_EQ(routes[0].second, 2);
+  EXPECT_EQ(routes[1].first, connId2);
+  EXPECT_EQ(routes[1].second, 1);
+}
+
+TEST(ConnectionIdRoutingTableTest, FindInsertErase) {
+  ConnectionIdRoutingTable<std::shared_ptr<int>> table(1000);
+  EXPECT_EQ(table.numSlots(), 1024);
+  auto connId1 = getTestConnectionId(0);
+  // Same trailing bytes, so the same slot.
+  auto connId2 = connId1;
+  connId2.data()[0] ^= 0x1;
+  auto connId3 = connId1;
+  connId3.data()[7] ^= 0x1;
+
+  EXPECT_EQ(table.find(connId1), nullptr);
+  EXPECT_TRUE(table.insert(connId1, std::make_shared<int>(1)));
+  EXPECT_FALSE(table.insert(connId2, std::make_shared<int>(2)));
+  EXPECT_TRUE(table.insert(connId3, std::make_shared<int>(3)));
+  EXPECT_EQ(table.size(), 2);
+  ASSERT_NE(table.find(connId1), nullptr);
+  EXPECT_EQ(**table.find(connId1), 1);
+  EXPECT_EQ(table.find(connId2), nullptr);
+  EXPECT_EQ(**table.find(connId3), 3);
+
+  // Erasing an id that doesn't own the slot leaves it alone.
+  table.erase(connId2);
+  EXPECT_NE(table.find(connId1), nullptr);
+  table.erase(connId1);
+  EXPECT_EQ(table.find(connId1), nullptr);
+  EXPECT_EQ(table.size(), 1);
+  EXPECT_TRUE(table.insert(connId2, std::make_shared<int>(2)));
+  EXPECT_EQ(**table.find(connId2), 2);
+
+  table.clear();
+  EXPECT_EQ(table.size(), 0);
+  EXPECT_EQ(table.find(connId3), nullptr);
+}
+
+TEST(DrainingConnectionTableTest, AnswersAndExpires) {
+  DrainingConnectionTable table;
+  auto now = Clock::now();
+  auto connId1 = getTestConnectionId(0);
+  auto connId2 = getTestConnectionId(1);
+  auto connId3 = getTestConnectionId(2);
+
+  DrainingConnectionTable::Entry entry;
+  entry.peerAddress = folly::SocketAddress("1.2.3.4", 1234);
+  entry.closePacket = folly::IOBuf::copyBuffer("close");
+  entry.connectionIds = {connId1, connId2};
+  auto entryDeadline = now + std::chrono::milliseconds(100);
+  entry.deadline = entryDeadline;
+  table.insert(std::move(entry));
+  DrainingConnectionTable::Entry peerClosed;
+  peerClosed.connectionIds = {connId3};
+  peerClosed.deadline = now + std::chrono::milliseconds(200);
+  table.insert(std::move(peerClosed));
+  EXPECT_EQ(table.size(), 2);
+
+  auto found = table.find(connId2, now);
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(found, table.find(connId1, now));
+  // The 1st, 2nd, 4th and 8th packets are answered.
+  std::vector<bool> answered;
+  for (int i = 0; i < 8; ++i) {
+    answered.push_back(DrainingConnectionTable::onPacketReceived(*found));
+  }
+  EXPECT_EQ(
+      answered,
+      std::vector<bool>({true, true, false, true, false, false, false, true}));
+  auto closedByPeer = table.find(connId3, now);
+  ASSERT_NE(closedByPeer, nullptr);
+  EXPECT_FALSE(DrainingConnectionTable::onPacketReceived(*closedByPeer));
+
+  // Past its deadline an entry is no longer found, and expire drops it.
+  EXPECT_EQ(table.find(connId1, entryDeadline), nullptr);
+  auto later = now + std::chrono::milliseconds(150);
+  table.expire(later);
+  EXPECT_EQ(table.size(), 1);
+  EXPECT_NE(table.find(connId3, later), nullptr);
+  table.clear();
+  EXPECT_TRUE(table.empty());
+}
+
+TEST(ConnectionIdPoolTest, TakesIdsWithTheirTokens) {
+  DefaultConnectionIdAlgo connIdAlgo;
+  ServerConnectionIdParams params(1, 0, 2);
+  auto secret = getRandSecret();
+  folly::SocketAddress serverAddr("1.2.3.4", 443);
+  ConnectionIdPool pool(connIdAlgo, params, secret, serverAddr, 4);
+  EXPECT_TRUE(pool.matches(params, secret, serverAddr));
+  EXPECT_FALSE(
+      pool.matches(ServerConnectionIdParams(1, 1, 2), secret, serverAddr));
+  EXPECT_FALSE(pool.matches(params, getRandSecret(), serverAddr));
+
+  StatelessResetGenerator generator(secret, serverAddr.getFullyQualified());
+  std::vector<ConnectionId> taken;
+  for (int i = 0; i < 5; ++i) {
+    auto entry = pool.take();
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->token, generator.generateToken(entry->connId));
+    auto decoded = connIdAlgo.parseConnectionId(entry->connId);
+    ASSERT_FALSE(decoded.hasError());
+    EXPECT_EQ(decoded->hostId, params.hostId);
+    EXPECT_EQ(decoded->workerId, params.workerId);
+    taken.push_back(entry->connId);
+  }
+  // The fifth id came from a second batch.
+  EXPECT_EQ(pool.size(), 3);
+  std::sort(taken.begin(), taken.end(), [](const auto& a, const auto& b) {
+    return a.hex() < b.hex();
+  });
+  EXPECT_EQ(std::unique(taken.begin(), taken.end()), taken.end());
+}
+
+TEST_F(QuicServerWorkerTest, RoutingTableFollowsConnectionIdMap) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.connectionIdRoutingTableSize = 16;
+  worker_->setTransportSettings(settings);
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+  worker_->onConnectionIdAvailable(transport_, connId);
+
+  auto data = folly::IOBuf::copyBuffer("data");
+  EXPECT_CALL(
+      *transport_, onNetworkData(kClientAddr, NetworkDataMatches(*data)))
+      .Times(1);
+  RoutingData routingData(HeaderForm::Short, false, false, connId, folly::none);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(data->clone(), Clock::now()));
+  eventbase_.loop();
+
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr));
+  worker_->onConnectionUnbound(
+      transport_.get(),
+      std::make_pair(kClientAddr, connId),
+      std::vector<ConnectionIdData>{ConnectionIdData{connId, 0}});
+  EXPECT_EQ(worker_->getConnectionIdMap().count(connId), 0);
+
+  // The connection is gone from the table as well.
+  EXPECT_CALL(*transport_, onNetworkData(_, _)).Times(0);
+  EXPECT_CALL(*transportInfoCb_, onPacketDropped(_)).Times(1);
+  RoutingData routingData2(
+      HeaderForm::Short, false, false, connId, folly::none);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData2),
+      NetworkData(data->clone(), Clock::now()));
+  eventbase_.loop();
+
+  transport_->QuicServerTransport::setRoutingCallback(nullptr);
+}
+
+TEST_F(QuicServerWorkerTest, SnapshotConnections) {
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+  worker_->onConnectionIdAvailable(transport_, connId);
+
+  auto transports = worker_->getServerTransports();
+  ASSERT_EQ(1, transports.size());
+  EXPECT_EQ(transport_.get(), transports[0]);
+
+  std::vector<ConnectionSnapshot> snapshots;
+  worker_->snapshotConnections(
+      folly::range(transports), ConnectionSnapshotFilter(), snapshots);
+  ASSERT_EQ(1, snapshots.size());
+  EXPECT_EQ(42, snapshots[0].workerId);
+  EXPECT_EQ(
+      transport_->getState()->serverConnectionId,
+      snapshots[0].serverConnectionId);
+
+  ConnectionSnapshotFilter filter;
+  filter.minBytesInFlight = 1;
+  snapshots.clear();
+  worker_->snapshotConnections(folly::range(transports), filter, snapshots);
+  EXPECT_TRUE(snapshots.empty());
+
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr));
+  worker_->onConnectionUnbound(
+      transport_.get(),
+      std::make_pair(kClientAddr, connId),
+      std::vector<ConnectionIdData>{ConnectionIdData{connId, 0}});
+  // The transport that went away is skipped.
+  worker_->snapshotConnections(
+      folly::range(transports), ConnectionSnapshotFilter(), snapshots);
+  EXPECT_TRUE(snapshots.empty());
+  EXPECT_TRUE(worker_->getServerTransports().empty());
+
+  transport_->QuicServerTransport::setRoutingCallback(nullptr);
+}
+
+TEST(ConnectionSnapshotFilterTest, Matches) {
+  ConnectionSnapshot snapshot;
+  snapshot.peerAddress = folly::SocketAddress("1.2.3.4", 1234);
+  snapshot.congestionControlType = CongestionControlType::Cubic;
+  snapshot.bytesInFlight = 1000;
+  snapshot.streamBytesBuffered = 300;
+  snapshot.streamBytesUnacked = 200;
+  EXPECT_TRUE(ConnectionSnapshotFilter().matches(snapshot));
+
+  ConnectionSnapshotFilter filter;
+  filter.peerAddress = folly::IPAddress("1.2.3.4");
+  filter.congestionControlType = CongestionControlType::Cubic;
+  filter.minStreamBytesBuffered = 500;
+  filter.minBytesInFlight = 1000;
+  EXPECT_TRUE(filter.matches(snapshot));
+
+  auto other = filter;
+  other.peerAddress = folly::IPAddress("1.2.3.5");
+  EXPECT_FALSE(other.matches(snapshot));
+  other = filter;
+  other.congestionControlType = CongestionControlType::BBR;
+  EXPECT_FALSE(other.matches(snapshot));
+  other = filter;
+  other.minStreamBytesBuffered = 501;
+  EXPECT_FALSE(other.matches(snapshot));
+  other = filter;
+  other.minBytesInFlight = 1001;
+  EXPECT_FALSE(other.matches(snapshot));
+}
+
+TEST_F(QuicServerWorkerTest, MigrateConnection) {
+  auto target = std::make_unique<QuicServerWorker>(workerCb_);
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  target->setTransportSettings(settings);
+  target->setSocket(std::make_unique<NiceMock<folly::test::MockAsyncUDPSocket>>(
+      &eventbase_));
+  target->setWorkerId(7);
+  target->setProcessId(ProcessId::ONE);
+  target->setHostId(hostId_);
+  target->setConnectionIdAlgo(std::make_unique<DefaultConnectionIdAlgo>());
+  target->setNewConnectionSocketFactory(socketFactory_.get());
+
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+  worker_->onConnectionIdAvailable(transport_, connId);
+  const_cast<QuicConnectionStateBase*>(transport_->getState())
+      ->selfConnectionIds.push_back(ConnectionIdData{connId, 0});
+
+  EXPECT_CALL(*transport_, isMigratable())
+      .WillOnce(Return(false))
+      .WillOnce(Return(true));
+  EXPECT_FALSE(worker_->migrateConnection(transport_, *target));
+  EXPECT_EQ(1, worker_->getConnectionIdMap().count(connId));
+
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr));
+  EXPECT_CALL(*transport_, moveToEventBase(&eventbase_, _));
+  EXPECT_CALL(*transport_, setRoutingCallback(target.get()));
+  EXPECT_CALL(*transport_, issueNewConnectionId()).WillOnce(Return(false));
+  EXPECT_TRUE(worker_->migrateConnection(transport_, *target));
+  EXPECT_EQ(0, worker_->getConnectionIdMap().count(connId));
+  eventbase_.loop();
+  EXPECT_EQ(1, target->getConnectionIdMap().count(connId));
+
+  // The packets still routed to the old worker are handed on.
+  auto data = folly::IOBuf::copyBuffer("data");
+  EXPECT_CALL(
+      *transport_, onNetworkData(kClientAddr, NetworkDataMatches(*data)));
+  RoutingData routingData(HeaderForm::Short, false, false, connId, folly::none);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(data->clone(), Clock::now()));
+  eventbase_.loop();
+
+  // Until the connection is gone.
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr));
+  target->onConnectionUnbound(
+      transport_.get(),
+      std::make_pair(kClientAddr, connId),
+      std::vector<ConnectionIdData>{ConnectionIdData{connId, 0}});
+  eventbase_.loop();
+  EXPECT_CALL(*transport_, onNetworkData(_, _)).Times(0);
+  EXPECT_CALL(*transportInfoCb_, onPacketDropped(_)).Times(1);
+  RoutingData routingData2(
+      HeaderForm::Short, false, false, connId, folly::none);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData2),
+      NetworkData(data->clone(), Clock::now()));
+  eventbase_.loop();
+
+  transport_->QuicServerTransport::setRoutingCallback(nullptr);
+}
+
+TEST_F(QuicServerWorkerTest, AcceptQueueDefersConnectionCreation) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.maxAcceptsPerLoop = 1;
+  settings.maxAcceptQueueSize = 2;
+  worker_->setTransportSettings(settings);
+  auto connId = getTestConnectionId(hostId_);
+  auto data = createData(kMinInitialPacketSize + 10);
+  const auto& addrMap = worker_->getSrcToTransportMap();
+
+  // Both Initials wait for the next loop.
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  for (int i = 0; i < 2; ++i) {
+    RoutingData routingData(HeaderForm::Long, true, true, connId, connId);
+    worker_->dispatchPacketData(
+        kClientAddr,
+        std::move(routingData),
+        NetworkData(data->clone(), Clock::now()));
+  }
+  EXPECT_EQ(addrMap.count(std::make_pair(kClientAddr, connId)), 0);
+
+  // The queue is full.
+  EXPECT_CALL(
+      *transportInfoCb_, onPacketDropped(PacketDropReason::ACCEPT_QUEUE_FULL));
+  folly::SocketAddress otherAddr("1.2.3.5", 1234);
+  RoutingData otherRoutingData(HeaderForm::Long, true, true, connId, connId);
+  worker_->dispatchPacketData(
+      otherAddr,
+      std::move(otherRoutingData),
+      NetworkData(data->clone(), Clock::now()));
+  Mock::VerifyAndClearExpectations(factory_.get());
+
+  // The second Initial goes to the connection the first one created.
+  expectConnectionCreation(kClientAddr, connId);
+  EXPECT_CALL(
+      *transport_, onNetworkData(kClientAddr, NetworkDataMatches(*data)))
+      .Times(2);
+  eventbase_.loopOnce();
+  EXPECT_EQ(addrMap.count(std::make_pair(kClientAddr, connId)), 1);
+}
+
+TEST_F(QuicServerWorkerTest, TransportSettingsProfile) {
+  auto profile = std::make_shared<TransportSettings>();
+  profile->idleTimeout = 1234ms;
+  std::shared_ptr<const TransportSettings> sharedProfile = profile;
+  std::vector<folly::IPAddress> clients;
+  worker_->setTransportSettingsProfileFn(
+      [&](const folly::IPAddress& clientIp) {
+        clients.push_back(clientIp);
+        return sharedProfile;
+      });
+  auto connId = getTestConnectionId(hostId_);
+  auto data = createData(kMinInitialPacketSize + 10);
+  RoutingData routingData(HeaderForm::Long, true, true, connId, connId);
+  expectConnectionCreation(kClientAddr, connId);
+  EXPECT_CALL(*transport_, setTransportSettings(_))
+      .WillOnce(Invoke([](TransportSettings settings) {
+        EXPECT_EQ(settings.idleTimeout, 1234ms);
+        // the worker's secret is filled in for the connection
+        EXPECT_TRUE(settings.statelessResetTokenSecret.has_value());
+      }));
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, _));
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(data->clone(), Clock::now()));
+  ASSERT_EQ(clients.size(), 1);
+  EXPECT_EQ(clients[0], kClientAddr.getIPAddress());
+  EXPECT_FALSE(profile->statelessResetTokenSecret.has_value());
+}
+
+TEST_F(QuicServerWorkerTest, PrefilterDropsBeforeRouting) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.prefilterReceivedPackets = true;
+  worker_->setTransportSettings(settings);
+  EXPECT_CALL(*workerCb_, routeDataToWorkerShort(_, _, _, _)).Times(0);
+  EXPECT_CALL(*workerCb_, routeDataToWorkerLong(_, _, _, _)).Times(0);
+
+  void* buf = nullptr;
+  size_t len = 0;
+  worker_->getReadBuffer(&buf, &len);
+  // short header without the fixed bit
+  auto connId = getTestConnectionId(hostId_);
+  uint8_t* data = static_cast<uint8_t*>(buf);
+  data[0] = 0x01;
+  memcpy(data + 1, connId.data(), connId.size());
+  EXPECT_CALL(
+      *transportInfoCb_, onPacketDropped(PacketDropReason::INVALID_PACKET));
+  worker_->onDataAvailable(kClientAddr, 1 + connId.size(), false);
+
+  // The buffer of the dropped packet is used for the next read.
+  void* nextBuf = nullptr;
+  worker_->getReadBuffer(&nextBuf, &len);
+  EXPECT_EQ(buf, nextBuf);
+
+  // long header of an unknown version that is not an Initial
+  data[0] = 0xc0 |
+      (static_cast<uint8_t>(LongHeader::Types::Handshake)
+       << LongHeader::kTypeShift);
+  memset(data + 1, 0xfa, sizeof(QuicVersionType));
+  data[1 + sizeof(QuicVersionType)] = 0;
+  EXPECT_CALL(
+      *transportInfoCb_, onPacketDropped(PacketDropReason::INVALID_PACKET));
+  worker_->onDataAvailable(kClientAddr, 2 + sizeof(QuicVersionType), false);
+}
+
 TEST_F(QuicServerWorkerTest, DestroyQuicServer) {
   auto connId = getTestConnectionId(hostId_);
   createQuicConnection(kClientAddr, connId);
@@ -1431,7 +2099,7 @@ class QuicServerTest : public Test {
         [&] { transport.reset(); });
   }
 
-  void testReset(Buf packet);
+  void testReset(Buf packet, ConnectionId connId);
 
  protected:
   folly::ScopedEventBaseThread evbThread_;
@@ -2003,7 +2671,7 @@ TEST_F(QuicServerTest, NetworkTestHealthCheck) {
   EXPECT_THROW(reader->readOne().get(20ms), folly::FutureTimeout);
 }
 
-void QuicServerTest::testReset(Buf packet) {
+void QuicServerTest::testReset(Buf packet, ConnectionId connId) {
   folly::SocketAddress addr("::1", 0);
   server_->start(addr, 2);
   server_->waitUntilInitialized();
@@ -2034,8 +2702,10 @@ void QuicServerTest::testReset(Buf packet) {
       .WillRepeatedly(Invoke([&](auto&, auto, auto) { return folly::none; }));
   codec.setOneRttReadCipher(std::move(aead));
   codec.setOneRttHeaderCipher(test::createNoOpHeaderCipher());
-  StatelessResetToken token = generateStatelessResetToken();
-  codec.setStatelessResetToken(token);
+  StatelessResetGenerator generator(
+      *transportSettings_.statelessResetTokenSecret,
+      serverAddr.getFullyQualified());
+  codec.setStatelessResetToken(generator.generateToken(connId));
   AckStates ackStates;
   auto packetQueue = bufToQueue(serverData->clone());
   auto res = codec.parsePacket(packetQueue, ackStates);
@@ -2057,7 +2727,7 @@ TEST_F(QuicServerTest, NetworkTestReset) {
       0 /* cipherOverhead */,
       0 /* largestAcked */));
   auto data = std::move(packet);
-  testReset(data->clone());
+  testReset(data->clone(), serverConnId);
 }
 
 TEST_F(QuicServerTest, NetworkTestResetLargePacket) {
@@ -2075,7 +2745,7 @@ TEST_F(QuicServerTest, NetworkTestResetLargePacket) {
       *buf,
       0 /* cipherOverhead */,
       0 /* largestAcked */));
-  testReset(std::move(packet));
+  testReset(std::move(packet), serverConnId);
 }
 
 TEST_F(QuicServerTest, NetworkTestResetLongHeader) {
@@ -2093,7 +2763,8 @@ TEST_F(QuicServerTest, NetworkTestResetLongHeader) {
       0 /* cipherOverhead */,
       0 /* largestAcked */,
       std::make_pair(LongHeader::Types::ZeroRtt, QuicVersion::MVFST)));
-  EXPECT_THROW(testReset(std::move(packet)), folly::FutureTimeout);
+  EXPECT_THROW(
+      testReset(std::move(packet), serverConnId), folly::FutureTimeout);
 }
 
 TEST_F(QuicServerTest, ZeroRttPacketRoute) {
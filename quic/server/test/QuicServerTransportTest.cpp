@@ -503,7 +503,8 @@ class QuicServerTransportTest : public Test {
     // Issue (kMinNumAvailableConnIds - 1) more connection ids on handshake
     // complete
     auto numNewConnIdFrames = 0;
-    for (const auto& packet : server->getConn().outstandingPackets) {
+    for (const auto& packet :
+         server->getConn().outstandingPackets[PacketNumberSpace::AppData]) {
       for (const auto& frame : packet.packet.frames) {
         switch (frame.type()) {
           case QuicWriteFrame::Type::QuicSimpleFrame_E: {
@@ -940,12 +941,14 @@ TEST_F(QuicServerTransportTest, TestCloseConnectionWithNoErrorPendingStreams) {
   loopForWrites();
 
   AckBlocks acks;
-  auto start = getFirstOutstandingPacket(
-                   server->getNonConstConn(), PacketNumberSpace::AppData)
-                   ->packet.header.getPacketSequenceNum();
-  auto end = getLastOutstandingPacket(
-                 server->getNonConstConn(), PacketNumberSpace::AppData)
-                 ->packet.header.getPacketSequenceNum();
+  auto start = server->getNonConstConn()
+                   .outstandingPackets[PacketNumberSpace::AppData]
+                   .front()
+                   .packet.header.getPacketSequenceNum();
+  auto end = server->getNonConstConn()
+                 .outstandingPackets[PacketNumberSpace::AppData]
+                 .back()
+                 .packet.header.getPacketSequenceNum();
   acks.insert(start, end);
   deliverData(packetToBuf(createAckPacket(
       server->getNonConstConn(),
@@ -1150,23 +1153,20 @@ TEST_F(QuicServerTransportTest, TestOpenAckStreamFrame) {
   ASSERT_FALSE(server->getConn().outstandingPackets.empty());
 
   PacketNum packetNum1 =
-      getFirstOutstandingPacket(
-          server->getNonConstConn(), PacketNumberSpace::AppData)
-          ->packet.header.getPacketSequenceNum();
+      server->getNonConstConn()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .front()
+          .packet.header.getPacketSequenceNum();
 
   PacketNum lastPacketNum =
-      getLastOutstandingPacket(
-          server->getNonConstConn(), PacketNumberSpace::AppData)
-          ->packet.header.getPacketSequenceNum();
+      server->getNonConstConn()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .back()
+          .packet.header.getPacketSequenceNum();
 
   uint32_t buffersInPacket1 = 0;
-  for (size_t i = 0; i < server->getNonConstConn().outstandingPackets.size();
-       ++i) {
-    auto& packet = server->getNonConstConn().outstandingPackets[i];
-    if (packet.packet.header.getPacketNumberSpace() !=
-        PacketNumberSpace::AppData) {
-      continue;
-    }
+  for (auto& packet : server->getNonConstConn()
+                          .outstandingPackets[PacketNumberSpace::AppData]) {
     PacketNum currentPacket = packet.packet.header.getPacketSequenceNum();
     ASSERT_FALSE(packet.packet.frames.empty());
     for (auto& quicFrame : packet.packet.frames) {
@@ -1228,9 +1228,10 @@ TEST_F(QuicServerTransportTest, TestOpenAckStreamFrame) {
   ASSERT_FALSE(server->getConn().outstandingPackets.empty());
 
   PacketNum finPacketNum =
-      getFirstOutstandingPacket(
-          server->getNonConstConn(), PacketNumberSpace::AppData)
-          ->packet.header.getPacketSequenceNum();
+      server->getNonConstConn()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .front()
+          .packet.header.getPacketSequenceNum();
 
   AckBlocks acks3 = {{lastPacketNum, finPacketNum}};
   auto packet4 = createAckPacket(
@@ -1728,18 +1729,20 @@ TEST_F(QuicServerTransportTest, TestCloneStopSending) {
   server->stopSending(streamId, GenericApplicationErrorCode::UNKNOWN);
   loopForWrites();
   // Find the outstanding StopSending.
+  auto& appDataPackets =
+      server->getNonConstConn().outstandingPackets[PacketNumberSpace::AppData];
   auto packetItr = std::find_if(
-      server->getNonConstConn().outstandingPackets.begin(),
-      server->getNonConstConn().outstandingPackets.end(),
+      appDataPackets.begin(),
+      appDataPackets.end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::StopSendingFrame_E>());
 
-  ASSERT_TRUE(packetItr != server->getNonConstConn().outstandingPackets.end());
+  ASSERT_TRUE(packetItr != appDataPackets.end());
   // Force a timeout with no data so that it clones the packet
   server->lossTimeout().timeoutExpired();
   loopForWrites();
   auto numStopSendingPackets = std::count_if(
-      server->getNonConstConn().outstandingPackets.begin(),
-      server->getNonConstConn().outstandingPackets.end(),
+      appDataPackets.begin(),
+      appDataPackets.end(),
       findFrameInPacketFunc<QuicSimpleFrame::Type::StopSendingFrame_E>());
 
   EXPECT_GT(numStopSendingPackets, 1);
@@ -2974,9 +2977,10 @@ TEST_F(QuicServerTransportTest, ClientPortChangeNATRebinding) {
   server->writeChain(streamId, data1->clone(), false, false);
   loopForWrites();
   PacketNum packetNum1 =
-      getFirstOutstandingPacket(
-          server->getNonConstConn(), PacketNumberSpace::AppData)
-          ->packet.header.getPacketSequenceNum();
+      server->getNonConstConn()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .front()
+          .packet.header.getPacketSequenceNum();
   AckBlocks acks = {{packetNum1, packetNum1}};
   auto packet1 = createAckPacket(
       server->getNonConstConn(),
@@ -3003,13 +3007,13 @@ TEST_F(QuicServerTransportTest, ClientPortChangeNATRebinding) {
   EXPECT_TRUE(server->getConn().outstandingPathValidation);
   EXPECT_EQ(server->getConn().peerAddress, newPeer);
   EXPECT_EQ(server->getConn().migrationState.previousPeerAddresses.size(), 1);
-  EXPECT_NE(
+  EXPECT_EQ(
       server->getConn().lossState.srtt, std::chrono::microseconds::zero());
-  EXPECT_NE(
+  EXPECT_EQ(
       server->getConn().lossState.lrtt, std::chrono::microseconds::zero());
-  EXPECT_NE(
+  EXPECT_EQ(
       server->getConn().lossState.rttvar, std::chrono::microseconds::zero());
-  EXPECT_NE(server->getConn().lossState.mrtt, kDefaultMinRtt);
+  EXPECT_EQ(server->getConn().lossState.mrtt, kDefaultMinRtt);
   EXPECT_EQ(server->getConn().congestionController.get(), congestionController);
   EXPECT_FALSE(server->getConn().migrationState.lastCongestionAndRtt);
 }
@@ -3021,9 +3025,10 @@ TEST_F(QuicServerTransportTest, ClientAddressChangeNATRebinding) {
   server->writeChain(streamId, data1->clone(), false, false);
   loopForWrites();
   PacketNum packetNum1 =
-      getFirstOutstandingPacket(
-          server->getNonConstConn(), PacketNumberSpace::AppData)
-          ->packet.header.getPacketSequenceNum();
+      server->getNonConstConn()
+          .outstandingPackets[PacketNumberSpace::AppData]
+          .front()
+          .packet.header.getPacketSequenceNum();
   AckBlocks acks = {{packetNum1, packetNum1}};
   auto packet1 = createAckPacket(
       server->getNonConstConn(),
@@ -3051,14 +3056,62 @@ TEST_F(QuicServerTransportTest, ClientAddressChangeNATRebinding) {
 
   EXPECT_EQ(server->getConn().peerAddress, newPeer);
   EXPECT_EQ(server->getConn().migrationState.previousPeerAddresses.size(), 1);
-  EXPECT_NE(server->getConn().lossState.srtt, 0us);
-  EXPECT_NE(server->getConn().lossState.lrtt, 0us);
-  EXPECT_NE(server->getConn().lossState.rttvar, 0us);
-  EXPECT_NE(server->getConn().lossState.mrtt, kDefaultMinRtt);
+  EXPECT_EQ(server->getConn().lossState.srtt, 0us);
+  EXPECT_EQ(server->getConn().lossState.lrtt, 0us);
+  EXPECT_EQ(server->getConn().lossState.rttvar, 0us);
+  EXPECT_EQ(server->getConn().lossState.mrtt, kDefaultMinRtt);
   EXPECT_EQ(server->getConn().congestionController.get(), congestionController);
   EXPECT_FALSE(server->getConn().migrationState.lastCongestionAndRtt);
 }
 
+TEST_F(QuicServerTransportTest, MigrationPathValidationDefaultCredit) {
+  server->getNonConstConn().transportSettings.disableMigration = false;
+
+  auto data = IOBuf::copyBuffer("bad data");
+  auto packetData = packetToBuf(createStreamPacket(
+      *clientConnectionId,
+      *server->getConn().serverConnectionId,
+      clientNextAppDataPacketNum++,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */));
+
+  folly::SocketAddress newPeer("100.101.102.103", 23456);
+  deliverData(std::move(packetData), false, &newPeer);
+
+  ASSERT_TRUE(server->getConn().pathValidationLimiter != nullptr);
+  EXPECT_EQ(
+      server->getNonConstConn().pathValidationLimiter->currentCredit(
+          Clock::now(), kDefaultInitialRtt),
+      kMinCwndInMss * server->getConn().udpSendPacketLen);
+}
+
+TEST_F(QuicServerTransportTest, MigrationPathValidationCredit) {
+  server->getNonConstConn().transportSettings.disableMigration = false;
+  server->getNonConstConn().transportSettings.pathValidationCreditInMss = 20;
+
+  auto data = IOBuf::copyBuffer("bad data");
+  auto packetData = packetToBuf(createStreamPacket(
+      *clientConnectionId,
+      *server->getConn().serverConnectionId,
+      clientNextAppDataPacketNum++,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */));
+
+  folly::SocketAddress newPeer("100.101.102.103", 23456);
+  deliverData(std::move(packetData), false, &newPeer);
+
+  EXPECT_TRUE(server->getConn().pendingEvents.pathChallenge);
+  ASSERT_TRUE(server->getConn().pathValidationLimiter != nullptr);
+  EXPECT_EQ(
+      server->getNonConstConn().pathValidationLimiter->currentCredit(
+          Clock::now(), kDefaultInitialRtt),
+      20 * server->getConn().udpSendPacketLen);
+}
+
 TEST_F(
     QuicServerTransportTest,
     ClientNATRebindingWhilePathValidationOutstanding) {
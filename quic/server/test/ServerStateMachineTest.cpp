@@ -2,8 +2,10 @@
 
 #include <quic/server/state/ServerStateMachine.h>
 #include <gtest/gtest.h>
+#include <quic/server/state/ConnectionHandoff.h>
 #include <quic/codec/DefaultConnectionIdAlgo.h>
 #include <quic/codec/QuicConnectionId.h>
+#include <quic/common/test/TestUtils.h>
 
 namespace quic {
 
@@ -66,5 +68,72 @@ TEST(ServerStateMachineTest, TestAddConnId) {
   EXPECT_EQ(serverState.selfConnectionIds.size(), 3);
   EXPECT_EQ(serverState.nextSelfConnectionIdSequence, 3);
 }
+
+TEST(ServerStateMachineTest, TestConnectionHandoffStateRoundTrip) {
+  ConnectionHandoffState state;
+  state.version = QuicVersion::MVFST;
+  state.peerAddress = folly::SocketAddress("1.2.3.4", 1234);
+  state.originalPeerAddress = folly::SocketAddress("::1", 4321);
+  state.applicationProtocol = std::string("h3");
+  state.readSecret = std::vector<uint8_t>(32, 0x01);
+  state.writeSecret = std::vector<uint8_t>(32, 0x02);
+  state.readKeyGeneration = 2;
+  state.writeKeyGeneration = 1;
+  state.clientConnectionId = getTestConnectionId(1);
+  state.serverConnectionId = getTestConnectionId(2);
+  state.selfConnectionIds.emplace_back(getTestConnectionId(2), 0);
+  state.selfConnectionIds.emplace_back(getTestConnectionId(3), 1);
+  StatelessResetToken token;
+  token.fill(0x03);
+  state.selfConnectionIds.back().token = token;
+  state.nextSelfConnectionIdSequence = 2;
+  state.nextPacketNum = 100;
+  state.largestAckedByPeer = 90;
+  state.largestReceivedPacketNum = 80;
+  state.acks.insert(10, 20);
+  state.acks.insert(30, 80);
+  state.peerAdvertisedMaxOffset = 1000;
+  state.streamIds.nextBidirectionalStreamId = 12;
+  state.peerMinAckDelay = 1000us;
+  state.srtt = 50ms;
+  state.congestionWindow = 100000;
+
+  auto buf = encodeConnectionHandoffState(state);
+  auto decoded = decodeConnectionHandoffState(*buf);
+  ASSERT_TRUE(decoded.has_value());
+  EXPECT_EQ(decoded->version, state.version);
+  EXPECT_EQ(decoded->peerAddress, state.peerAddress);
+  EXPECT_EQ(decoded->originalPeerAddress, state.originalPeerAddress);
+  EXPECT_EQ(decoded->applicationProtocol, state.applicationProtocol);
+  EXPECT_EQ(decoded->readSecret, state.readSecret);
+  EXPECT_EQ(decoded->writeSecret, state.writeSecret);
+  EXPECT_EQ(decoded->readKeyGeneration, 2);
+  EXPECT_EQ(decoded->writeKeyGeneration, 1);
+  EXPECT_EQ(decoded->clientConnectionId, state.clientConnectionId);
+  EXPECT_EQ(decoded->serverConnectionId, state.serverConnectionId);
+  EXPECT_FALSE(decoded->clientChosenDestConnectionId.has_value());
+  ASSERT_EQ(decoded->selfConnectionIds.size(), 2);
+  EXPECT_EQ(decoded->selfConnectionIds[1].connId, getTestConnectionId(3));
+  EXPECT_EQ(decoded->selfConnectionIds[1].sequenceNumber, 1);
+  EXPECT_EQ(decoded->selfConnectionIds[1].token, token);
+  EXPECT_FALSE(decoded->selfConnectionIds[0].token.has_value());
+  EXPECT_EQ(decoded->nextPacketNum, 100);
+  EXPECT_EQ(decoded->largestAckedByPeer, 90);
+  EXPECT_EQ(decoded->largestReceivedPacketNum, 80);
+  ASSERT_EQ(decoded->acks.size(), 2);
+  EXPECT_EQ(decoded->acks.front().start, 10);
+  EXPECT_EQ(decoded->acks.back().end, 80);
+  EXPECT_EQ(decoded->peerAdvertisedMaxOffset, 1000);
+  EXPECT_EQ(decoded->streamIds.nextBidirectionalStreamId, 12);
+  EXPECT_EQ(decoded->peerMinAckDelay, 1000us);
+  EXPECT_EQ(decoded->srtt, 50ms);
+  EXPECT_EQ(decoded->congestionWindow, 100000);
+
+  // Truncated or of an unknown version
+  buf->trimEnd(1);
+  EXPECT_FALSE(decodeConnectionHandoffState(*buf).has_value());
+  auto unknown = folly::IOBuf::copyBuffer("\x00\x00\x00\x02");
+  EXPECT_FALSE(decodeConnectionHandoffState(*unknown).has_value());
+}
 } // namespace test
 } // namespace quic
@@ -9,9 +9,11 @@
 #include <quic/state/AckHandlers.h>
 
 #include <folly/Overload.h>
+#include <quic/common/PipelineTiming.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/loss/QuicLossFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
+#include <algorithm>
 #include <iterator>
 
 namespace quic {
@@ -23,19 +25,141 @@ namespace quic {
  * order of packet number. For each ack block, we try to find a continuous range
  * of outstanding packets in the connection's outstanding packets list that is
  * acked by the current ack block. The search is in the reverse order of the
- * outstandingPackets given that the list is sorted in the ascending order of
- * packet number. For each outstanding packet that is acked by current ack
- * frame, ack and loss visitors are invoked on the sent frames. The outstanding
- * packets may contain packets from all three packet number spaces. But ack is
- * always restrained to a single space. So we also need to skip packets that are
- * not in the current packet number space.
+ * outstanding packets of the ack's packet number space, given that they are
+ * sorted in the ascending order of packet number. For each outstanding packet
+ * that is acked by current ack frame, ack and loss visitors are invoked on the
+ * sent frames.
  *
  */
 
-void processAckFrame(
+namespace {
+
+/**
+ * Drops the packets of pnSpace that were declared lost and that ackBlock acks
+ * after all, and lets the congestion controller undo the loss.
+ */
+void detectSpuriousLoss(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const AckBlock& ackBlock) {
+  auto& recentlyLost = conn.lossState.recentlyLostPackets[pnSpace];
+  auto first = std::lower_bound(
+      recentlyLost.begin(), recentlyLost.end(), ackBlock.startPacket);
+  auto last = std::upper_bound(first, recentlyLost.end(), ackBlock.endPacket);
+  if (first == last) {
+    return;
+  }
+  for (auto it = first; it != last; ++it) {
+    VLOG(10) << __func__ << " packetNum=" << *it << " space=" << pnSpace
+             << " " << conn;
+    QUIC_STATS_COUNTER(
+        conn.statsCounters,
+        SpuriousLosses,
+        1,
+        conn.infoCallback,
+        onSpuriousLoss);
+  }
+  recentlyLost.erase(first, last);
+  if (conn.ackEventBatch.active) {
+    conn.ackEventBatch.spuriousLoss = true;
+  } else if (conn.congestionController) {
+    conn.congestionController->onSpuriousLoss();
+  }
+}
+
+/**
+ * Checks the ECN counts of an ack frame that newly acked ecnMarkedAcked of
+ * the packets we sent marked ECT(0), and hands CE marks to the congestion
+ * controller. Counts that go backwards, report ECT(1) or don't cover the
+ * acked packets mean the markings are lost or mangled on the path, so ECN is
+ * turned off for the connection.
+ */
+void processEcnCounts(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const ReadAckFrame& frame,
+    uint64_t ecnMarkedAcked,
+    TimePoint largestAckedSentTime) {
+  auto& peerCounts = getAckState(conn, pnSpace).peerEcnCounts;
+  if (!frame.ecnCounts) {
+    VLOG(4) << "ECN validation failed, no ECN counts " << conn;
+    conn.ecnFailed = true;
+    return;
+  }
+  const auto& counts = *frame.ecnCounts;
+  if (counts.ect0 < peerCounts.ect0 || counts.ect1 != peerCounts.ect1 ||
+      counts.ce < peerCounts.ce ||
+      (counts.ect0 - peerCounts.ect0) + (counts.ce - peerCounts.ce) <
+          ecnMarkedAcked) {
+    VLOG(4) << "ECN validation failed, counts ect0=" << counts.ect0
+            << " ect1=" << counts.ect1 << " ce=" << counts.ce << " " << conn;
+    conn.ecnFailed = true;
+    return;
+  }
+  if (counts.ce > peerCounts.ce && conn.congestionController) {
+    conn.congestionController->onEcnCongestionEvent(largestAckedSentTime);
+  }
+  peerCounts = counts;
+}
+
+// The newly acked packet a rate sample is taken from.
+struct RateSamplePacket {
+  TimePoint sentTime;
+  uint64_t encodedSize;
+  uint64_t totalBytesSent;
+  bool isAppLimited;
+  folly::Optional<OutstandingPacket::LastAckedPacketInfo> lastAckedPacketInfo;
+};
+
+/**
+ * Rate sample of an ack that newly acked packet, after all of its acked bytes
+ * are added to the loss state. Without the state of an earlier ack the
+ * sample only covers the packet itself.
+ */
+folly::Optional<RateSample> makeRateSample(
+    const QuicConnectionStateBase& conn,
+    const RateSamplePacket& packet,
+    TimePoint ackReceiveTime) {
+  RateSample sample;
+  sample.isAppLimited = packet.isAppLimited;
+  if (packet.lastAckedPacketInfo) {
+    const auto& info = *packet.lastAckedPacketInfo;
+    if (packet.sentTime < info.sentTime || ackReceiveTime < info.ackTime) {
+      return folly::none;
+    }
+    sample.sentBytes = packet.totalBytesSent - info.totalBytesSent;
+    sample.sendElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        packet.sentTime - info.sentTime);
+    sample.deliveredBytes =
+        conn.lossState.totalBytesAcked - info.totalBytesAcked;
+    sample.ackElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        ackReceiveTime - info.ackTime);
+    return sample;
+  }
+  if (ackReceiveTime <= packet.sentTime) {
+    return folly::none;
+  }
+  sample.sentBytes = packet.encodedSize;
+  sample.deliveredBytes = packet.encodedSize;
+  sample.sendElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      ackReceiveTime - packet.sentTime);
+  return sample;
+}
+
+/**
+ * nextAckBlock returns the ack blocks of the frame one at a time, in
+ * descending order, and folly::none after the last one. Blocks past the
+ * oldest outstanding packet are never asked for. Each packet number of a block
+ * that lies within the outstanding packets is an index into them, so the cost
+ * is that of the acked packets and the holes between them, not of the packets
+ * still outstanding.
+ */
+template <class NextAckBlock>
+void processAckBlocks(
     QuicConnectionStateBase& conn,
     PacketNumberSpace pnSpace,
     const ReadAckFrame& frame,
+    NextAckBlock&& nextAckBlock,
     const AckVisitor& ackVisitor,
     const LossVisitor& lossVisitor,
     const TimePoint& ackReceiveTime) {
@@ -47,136 +171,178 @@ void processAckFrame(
   // different acking policy. It's also possibly that all acked packets are pure
   // acks which leads to different number of packets being acked usually.
   ack.ackedPackets.reserve(kDefaultRxPacketsBeforeAckAfterInit);
-  auto currentPacketIt = getLastOutstandingPacket(conn, pnSpace);
+  auto& outstandingPackets = conn.outstandingPackets[pnSpace];
   uint64_t handshakePacketAcked = 0;
   uint64_t clonedPacketsAcked = 0;
+  uint64_t ecnMarkedAcked = 0;
   folly::Optional<decltype(conn.lossState.lastAckedPacketSentTime)>
       lastAckedPacketSentTime;
-  auto ackBlockIt = frame.ackBlocks.cbegin();
-  while (ackBlockIt != frame.ackBlocks.cend() &&
-         currentPacketIt != conn.outstandingPackets.rend()) {
-    // In reverse order, find the first outstanding packet that has a packet
-    // number LE the endPacket of the current ack range.
-    auto rPacketIt = std::lower_bound(
-        currentPacketIt,
-        conn.outstandingPackets.rend(),
-        ackBlockIt->endPacket,
-        [&](const auto& packetWithTime, const auto& val) {
-          return packetWithTime.packet.header.getPacketSequenceNum() > val;
-        });
-    if (rPacketIt == conn.outstandingPackets.rend()) {
+  // Newly acking a packet below the largest one acked before means the peer
+  // received packets out of order.
+  auto largestAckedBefore = getAckState(conn, pnSpace).largestAckedByPeer;
+  folly::Optional<TimePoint> latestAckedSentTime;
+  // The most recently sent of the newly acked packets.
+  folly::Optional<RateSamplePacket> rateSamplePacket;
+  bool reorderingDetected = false;
+  // Whether a packet sent before the last run of PTOs is newly acked.
+  bool ackedSentBeforePTO = false;
+  const auto& recentlyLost = conn.lossState.recentlyLostPackets[pnSpace];
+  folly::Optional<AckBlock> ackBlock = nextAckBlock();
+  while (ackBlock && !outstandingPackets.empty()) {
+    if (!recentlyLost.empty()) {
+      detectSpuriousLoss(conn, pnSpace, *ackBlock);
+    }
+    if (ackBlock->endPacket < outstandingPackets.front().packetNum) {
       // This means that all the packets are greater than the end packet.
       // Since we iterate the ACK blocks in reverse order of end packets, our
       // work here is done.
       VLOG(10) << __func__ << " less than all outstanding packets outstanding="
-               << conn.outstandingPackets.size() << " range=["
-               << ackBlockIt->startPacket << ", " << ackBlockIt->endPacket
+               << outstandingPackets.size() << " range=["
+               << ackBlock->startPacket << ", " << ackBlock->endPacket
                << "]"
                << " " << conn;
-      ackBlockIt++;
       break;
     }
 
     // TODO: only process ACKs from packets which are sent from a greater than
     // or equal to crypto protection level.
-    auto eraseEnd = rPacketIt;
-    while (rPacketIt != conn.outstandingPackets.rend()) {
-      auto currentPacketNum = rPacketIt->packet.header.getPacketSequenceNum();
-      auto currentPacketNumberSpace =
-          rPacketIt->packet.header.getPacketNumberSpace();
-      if (pnSpace != currentPacketNumberSpace) {
-        // When the next packet is not in the same packet number space, we need
-        // to skip it in current ack processing. If the iterator has moved, that
-        // means we have found packets in the current space that are acked by
-        // this ack block. So the code erases the current iterator range and
-        // move the iterator to be the next search point.
-        if (rPacketIt != eraseEnd) {
-          auto nextElem =
-              conn.outstandingPackets.erase(rPacketIt.base(), eraseEnd.base());
-          rPacketIt = std::reverse_iterator<decltype(nextElem)>(nextElem) + 1;
-          eraseEnd = rPacketIt;
-        } else {
-          rPacketIt++;
-          eraseEnd = rPacketIt;
-        }
+    // Look the packet numbers of the block up from the largest down, as far
+    // as there are outstanding packets. Pure acks and the packets acked or
+    // lost before have nothing to find.
+    auto lowestPacketNum = std::max(
+        ackBlock->startPacket, outstandingPackets.front().packetNum);
+    auto currentPacketNum =
+        std::min(ackBlock->endPacket, outstandingPackets.back().packetNum) + 1;
+    while (currentPacketNum-- > lowestPacketNum &&
+           !outstandingPackets.empty()) {
+      auto packetIt = outstandingPackets.find(currentPacketNum);
+      if (packetIt == outstandingPackets.end()) {
         continue;
       }
-      if (currentPacketNum < ackBlockIt->startPacket) {
-        break;
-      }
+      auto& packet = *packetIt;
+      DCHECK_EQ(packet.packetNumberSpace, pnSpace);
       VLOG(10) << __func__ << " acked packetNum=" << currentPacketNum
-               << " space=" << currentPacketNumberSpace
-               << " handshake=" << (int)rPacketIt->isHandshake << " " << conn;
-      if (rPacketIt->isHandshake) {
+               << " space=" << pnSpace
+               << " handshake=" << (int)packet.isHandshake << " " << conn;
+      if (packet.isHandshake) {
         ++handshakePacketAcked;
       }
-      ack.ackedBytes += rPacketIt->encodedSize;
-      if (rPacketIt->associatedEvent) {
+      ack.ackedBytes += packet.encodedSize;
+      if (packet.associatedEvent) {
         ++clonedPacketsAcked;
       }
+      if (packet.isEcnMarked) {
+        ++ecnMarkedAcked;
+      }
       // Update RTT if current packet is the largestAcked in the frame:
       auto ackReceiveTimeOrNow =
-          ackReceiveTime > rPacketIt->time ? ackReceiveTime : Clock::now();
+          ackReceiveTime > packet.time ? ackReceiveTime : Clock::now();
       auto rttSample = std::chrono::duration_cast<std::chrono::microseconds>(
-          ackReceiveTimeOrNow - rPacketIt->time);
+          ackReceiveTimeOrNow - packet.time);
       if (currentPacketNum == frame.largestAcked) {
         updateRtt(conn, rttSample, frame.ackDelay);
       }
       // Only invoke AckVisitor if the packet doesn't have an associated
       // PacketEvent; or the PacketEvent is in conn.outstandingPacketEvents
-      if (!rPacketIt->associatedEvent ||
-          conn.outstandingPacketEvents.count(*rPacketIt->associatedEvent)) {
-        for (auto& packetFrame : rPacketIt->packet.frames) {
-          ackVisitor(*rPacketIt, packetFrame, frame);
+      if (isPmtuProbe(conn, pnSpace, currentPacketNum)) {
+        // Its PING is ours, not the app's.
+        onPmtuProbeAcked(conn);
+      } else if (
+          !packet.associatedEvent ||
+          conn.outstandingPacketEvents.count(*packet.associatedEvent)) {
+        for (auto& packetFrame : packet.packet.frames) {
+          ackVisitor(packet, packetFrame, frame);
         }
         // Remove this PacketEvent from the outstandingPacketEvents set
-        if (rPacketIt->associatedEvent) {
-          conn.outstandingPacketEvents.erase(*rPacketIt->associatedEvent);
+        if (packet.associatedEvent) {
+          conn.outstandingPacketEvents.erase(*packet.associatedEvent);
         }
       }
       if (!ack.largestAckedPacket ||
           *ack.largestAckedPacket < currentPacketNum) {
         ack.largestAckedPacket = currentPacketNum;
-        ack.largestAckedPacketSentTime = rPacketIt->time;
-        ack.largestAckedPacketAppLimited = rPacketIt->isAppLimited;
+        ack.largestAckedPacketSentTime = packet.time;
+        ack.largestAckedPacketAppLimited = packet.isAppLimited;
       }
-      if (ackReceiveTime > rPacketIt->time) {
+      if (ackReceiveTime > packet.time) {
         ack.mrttSample =
             std::min(ack.mrttSample.value_or(rttSample), rttSample);
       }
-      conn.lossState.totalBytesAcked += rPacketIt->encodedSize;
+      conn.lossState.totalBytesAcked += packet.encodedSize;
       conn.lossState.totalBytesSentAtLastAck = conn.lossState.totalBytesSent;
       conn.lossState.totalBytesAckedAtLastAck = conn.lossState.totalBytesAcked;
       if (!lastAckedPacketSentTime) {
-        lastAckedPacketSentTime = rPacketIt->time;
+        lastAckedPacketSentTime = packet.time;
+      }
+      if (!latestAckedSentTime || *latestAckedSentTime < packet.time) {
+        latestAckedSentTime = packet.time;
+      }
+      if (currentPacketNum < largestAckedBefore) {
+        reorderingDetected = true;
+      }
+      if (conn.lossState.largestSentAtPTO &&
+          currentPacketNum <= *conn.lossState.largestSentAtPTO) {
+        ackedSentBeforePTO = true;
       }
       conn.lossState.lastAckedTime = ackReceiveTime;
+      if (!rateSamplePacket ||
+          rateSamplePacket->totalBytesSent < packet.totalBytesSent) {
+        rateSamplePacket = RateSamplePacket{packet.time,
+                                            packet.encodedSize,
+                                            packet.totalBytesSent,
+                                            packet.isAppLimited,
+                                            packet.lastAckedPacketInfo};
+      }
       ack.ackedPackets.push_back(
           CongestionController::AckEvent::AckPacket::Builder()
-              .setSentTime(rPacketIt->time)
-              .setEncodedSize(rPacketIt->encodedSize)
-              .setLastAckedPacketInfo(std::move(rPacketIt->lastAckedPacketInfo))
-              .setTotalBytesSentThen(rPacketIt->totalBytesSent)
-              .setAppLimited(rPacketIt->isAppLimited)
+              .setSentTime(packet.time)
+              .setEncodedSize(packet.encodedSize)
+              .setLastAckedPacketInfo(std::move(packet.lastAckedPacketInfo))
+              .setTotalBytesSentThen(packet.totalBytesSent)
+              .setAppLimited(packet.isAppLimited)
               .build());
-      rPacketIt++;
-    }
-    // Done searching for acked outstanding packets in current ack block. Erase
-    // the current iterator range which is the last batch of continuous
-    // outstanding packets that are in this ack block. Move the iterator to be
-    // the next search point.
-    if (rPacketIt != eraseEnd) {
-      auto nextElem =
-          conn.outstandingPackets.erase(rPacketIt.base(), eraseEnd.base());
-      currentPacketIt = std::reverse_iterator<decltype(nextElem)>(nextElem);
-    } else {
-      currentPacketIt = rPacketIt;
+      outstandingPackets.erase(packetIt);
     }
-    ackBlockIt++;
+    ackBlock = nextAckBlock();
+  }
+  // Lost packets can be older than any packet still outstanding.
+  while (ackBlock && !recentlyLost.empty() &&
+         ackBlock->endPacket >= recentlyLost.front()) {
+    detectSpuriousLoss(conn, pnSpace, *ackBlock);
+    ackBlock = nextAckBlock();
   }
   if (lastAckedPacketSentTime) {
     conn.lossState.lastAckedPacketSentTime = *lastAckedPacketSentTime;
   }
+  if (rateSamplePacket) {
+    ack.rateSample = makeRateSample(conn, *rateSamplePacket, ackReceiveTime);
+    if (ack.rateSample) {
+      conn.lossState.lastRateSample = ack.rateSample;
+    }
+  }
+  if (conn.transportSettings.useRackLossDetection && latestAckedSentTime) {
+    auto& lossState = conn.lossState;
+    if (!lossState.rackLatestDeliveredSentTime ||
+        *lossState.rackLatestDeliveredSentTime < *latestAckedSentTime) {
+      lossState.rackLatestDeliveredSentTime = latestAckedSentTime;
+    }
+    if (reorderingDetected) {
+      // The first reordering only turns the packet threshold off.
+      if (lossState.rackReorderingSeen &&
+          lossState.rackReorderWindowMultiplier <
+              kRackMaxReorderWindowMultiplier) {
+        ++lossState.rackReorderWindowMultiplier;
+      }
+      lossState.rackReorderingSeen = true;
+    }
+  }
+  // Counts are only checked when the frame newly acks its largest packet, so
+  // reordered acks don't look like counts going backwards.
+  if (ecnMarkedAcked > 0 && !conn.ecnFailed && ack.largestAckedPacket &&
+      *ack.largestAckedPacket == frame.largestAcked) {
+    processEcnCounts(
+        conn, pnSpace, frame, ecnMarkedAcked, ack.largestAckedPacketSentTime);
+  }
   DCHECK_GE(conn.outstandingHandshakePacketsCount, handshakePacketAcked);
   conn.outstandingHandshakePacketsCount -= handshakePacketAcked;
   DCHECK_GE(conn.outstandingClonedPacketsCount, clonedPacketsAcked);
@@ -185,6 +351,22 @@ void processAckFrame(
   DCHECK_GE(
       updatedOustandingPacketsCount, conn.outstandingHandshakePacketsCount);
   DCHECK_GE(updatedOustandingPacketsCount, conn.outstandingClonedPacketsCount);
+  // The first ack after a PTO that acks what was sent before it means the
+  // probes were not needed, the acks were just late.
+  if (conn.lossState.largestSentAtPTO && ack.largestAckedPacket &&
+      pnSpace == PacketNumberSpace::AppData) {
+    if (ackedSentBeforePTO) {
+      VLOG(10) << __func__ << " spurious PTO largestSentAtPTO="
+               << *conn.lossState.largestSentAtPTO << " " << conn;
+      QUIC_STATS_COUNTER(
+          conn.statsCounters,
+          SpuriousPTOs,
+          1,
+          conn.infoCallback,
+          onSpuriousPTO);
+    }
+    conn.lossState.largestSentAtPTO.reset();
+  }
   auto lossEvent = handleAckForLoss(conn, lossVisitor, ack, pnSpace);
   if (conn.congestionController &&
       (ack.largestAckedPacket.has_value() || lossEvent)) {
@@ -195,9 +377,105 @@ void processAckFrame(
           *lossEvent->smallestLostSentTime,
           *lossEvent->largestLostSentTime);
     }
+    auto& batch = conn.ackEventBatch;
+    if (!batch.active) {
+      conn.congestionController->onPacketAckOrLoss(
+          std::move(ack), std::move(lossEvent));
+      QUIC_PROBE(
+          cwnd_update,
+          conn,
+          conn.congestionController->getCongestionWindow(),
+          conn.congestionController->getWritableBytes());
+    } else {
+      if (!batch.ack) {
+        batch.ack = std::move(ack);
+      } else {
+        batch.ack->merge(std::move(ack));
+      }
+      if (lossEvent && !batch.loss) {
+        batch.loss.emplace(std::move(*lossEvent));
+      } else if (lossEvent) {
+        batch.loss->merge(*lossEvent);
+      }
+    }
+  }
+  if (pnSpace == PacketNumberSpace::AppData) {
+    updateAckFrequency(conn, ackReceiveTime);
+  }
+}
+
+} // namespace
+
+void processAckFrame(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const ReadAckFrame& frame,
+    const AckVisitor& ackVisitor,
+    const LossVisitor& lossVisitor,
+    const TimePoint& ackReceiveTime) {
+  QUIC_PIPELINE_TIMER(AckProcessing);
+  auto ackBlockIt = frame.ackBlocks.cbegin();
+  processAckBlocks(
+      conn,
+      pnSpace,
+      frame,
+      [&]() -> folly::Optional<AckBlock> {
+        if (ackBlockIt == frame.ackBlocks.cend()) {
+          return folly::none;
+        }
+        return *ackBlockIt++;
+      },
+      ackVisitor,
+      lossVisitor,
+      ackReceiveTime);
+}
+
+void processAckFrame(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    AckFrameView& frameView,
+    const AckVisitor& ackVisitor,
+    const LossVisitor& lossVisitor,
+    const TimePoint& ackReceiveTime) {
+  QUIC_PIPELINE_TIMER(AckProcessing);
+  // The visitors only get the fields ahead of the ack blocks, which keeps
+  // the blocks from being materialized.
+  ReadAckFrame frame;
+  frame.largestAcked = frameView.largestAcked();
+  frame.ackDelay = frameView.ackDelay();
+  processAckBlocks(
+      conn,
+      pnSpace,
+      frame,
+      [&]() { return frameView.nextBlock(); },
+      ackVisitor,
+      lossVisitor,
+      ackReceiveTime);
+}
+
+void startAckEventBatch(QuicConnectionStateBase& conn) {
+  conn.ackEventBatch.active = conn.transportSettings.batchAckEvents;
+}
+
+void finishAckEventBatch(QuicConnectionStateBase& conn) {
+  auto& batch = conn.ackEventBatch;
+  batch.active = false;
+  if (conn.congestionController && (batch.ack || batch.loss)) {
     conn.congestionController->onPacketAckOrLoss(
-        std::move(ack), std::move(lossEvent));
+        std::move(batch.ack), std::move(batch.loss));
+    QUIC_PROBE(
+        cwnd_update,
+        conn,
+        conn.congestionController->getCongestionWindow(),
+        conn.congestionController->getWritableBytes());
+  }
+  // The losses of the batch are applied first, so an undo also covers them.
+  if (conn.congestionController && batch.spuriousLoss) {
+    conn.congestionController->onSpuriousLoss();
   }
+  batch.ack.clear();
+  batch.loss.clear();
+  batch.spuriousLoss = false;
 }
 
 void commonAckVisitorForAckFrame(
@@ -209,16 +487,23 @@ void commonAckVisitorForAckFrame(
   // time behind. But then right after this updateLargestReceivedPacketNum will
   // update that time stamp. Please note that this assume the peer isn't buggy
   // in the sense that packet numbers it issues are only increasing.
-  auto iter = frame.ackBlocks.crbegin();
-  while (iter != frame.ackBlocks.crend()) {
-    ackState.acks.withdraw(*iter);
-    iter++;
-  }
-  if (!frame.ackBlocks.empty()) {
-    auto largestAcked = frame.ackBlocks.front().end;
-    if (largestAcked > kAckPurgingThresh) {
-      ackState.acks.withdraw({0, largestAcked - kAckPurgingThresh});
+  if (frame.ackBlocks.empty()) {
+    return;
+  }
+  // Everything kAckPurgingThresh below the largest acked of the frame goes in
+  // one withdraw, so only the blocks above that point are withdrawn one by
+  // one. The blocks are stored largest first.
+  auto largestAcked = frame.ackBlocks.front().end;
+  PacketNum purgeEnd = 0;
+  if (largestAcked > kAckPurgingThresh) {
+    purgeEnd = largestAcked - kAckPurgingThresh;
+    ackState.acks.withdraw({0, purgeEnd});
+  }
+  for (const auto& block : frame.ackBlocks) {
+    if (purgeEnd && block.end <= purgeEnd) {
+      break;
     }
+    ackState.acks.withdraw(block);
   }
 }
 } // namespace quic
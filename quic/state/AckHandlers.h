@@ -9,6 +9,7 @@
 #pragma once
 
 #include <quic/QuicConstants.h>
+#include <quic/codec/Decode.h>
 #include <quic/codec/Types.h>
 #include <quic/state/StateData.h>
 #include <functional>
@@ -33,6 +34,28 @@ void processAckFrame(
     const LossVisitor& lossVisitor,
     const TimePoint& ackReceiveTime);
 
+/**
+ * Same as above for a lazily decoded ack frame. Ack blocks are decoded as
+ * they are processed, the ones past the oldest outstanding packet are not
+ * decoded at all. The frame the ackVisitor gets has no ack blocks.
+ */
+void processAckFrame(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    AckFrameView& frameView,
+    const AckVisitor& ackVisitor,
+    const LossVisitor& lossVisitor,
+    const TimePoint& ackReceiveTime);
+
+/**
+ * With the batchAckEvents transport setting, the congestion controller events
+ * of the ack frames processed between these two calls are merged and handed
+ * to the controller once, by finishAckEventBatch().
+ */
+void startAckEventBatch(QuicConnectionStateBase& conn);
+
+void finishAckEventBatch(QuicConnectionStateBase& conn);
+
 /**
  * Visitor function to be invoked when we receive an ACK of the WriteAckFrame
  * that we sent.
@@ -27,7 +27,17 @@ struct AckState {
   // Count of outstanding packets received with only non-retransmittable data.
   uint64_t numNonRxPacketsRecvd{0};
   // Count of oustanding packets received with retransmittable data.
-  uint8_t numRxPacketsRecvd{0};
+  uint16_t numRxPacketsRecvd{0};
+  // Latest ACK_FREQUENCY frame from the peer, it replaces the ack thresholds
+  // of the transport settings. Only used in the AppData space.
+  folly::Optional<AckFrequencyFrame> peerAckFrequency;
+  // The peer sent an IMMEDIATE_ACK frame in the packet being processed.
+  bool immediateAckRequested{false};
+  // ECN codepoints of the packets received, reported in our ACKs once any of
+  // them carried one.
+  EcnCounts ecnCounts;
+  // Latest ECN counts the peer reported for the packets we sent.
+  EcnCounts peerEcnCounts;
   // The receive time of the largest ack packet
   folly::Optional<TimePoint> largestRecvdPacketTime;
   // Latest packet number acked by peer
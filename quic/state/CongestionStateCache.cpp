@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/CongestionStateCache.h>
+
+namespace quic {
+
+namespace {
+constexpr uint8_t kCongestionStateV4PrefixLength = 24;
+constexpr uint8_t kCongestionStateV6PrefixLength = 56;
+} // namespace
+
+BasicCongestionStateCache::BasicCongestionStateCache(size_t maxSize)
+    : cache_(maxSize) {}
+
+folly::Optional<CachedCongestionState>
+BasicCongestionStateCache::getCongestionState(const std::string& key) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = cache_.find(key);
+  if (it == cache_.end()) {
+    return folly::none;
+  }
+  return it->second;
+}
+
+void BasicCongestionStateCache::putCongestionState(
+    const std::string& key,
+    CachedCongestionState state) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  cache_.set(key, std::move(state));
+}
+
+void BasicCongestionStateCache::removeCongestionState(const std::string& key) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  cache_.erase(key);
+}
+
+std::string congestionStateCacheKey(const folly::IPAddress& address) {
+  auto subnet = address.mask(
+      address.isV4() ? kCongestionStateV4PrefixLength
+                     : kCongestionStateV6PrefixLength);
+  return subnet.str();
+}
+
+} // namespace quic
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace quic {
+
+/**
+ * What a connection leaves behind for the next connection to the same peer
+ * to start from instead of initCwndInMss and another slow start.
+ */
+struct CachedCongestionState {
+  // Delivery rate of the connection's last rate sample, 0 if it had none
+  uint64_t bandwidthBytesPerSec{0};
+  std::chrono::microseconds minRtt{0us};
+  uint64_t cwndBytes{0};
+  // When the connection closed. On the system clock, since caches can be
+  // persisted across restarts.
+  std::chrono::system_clock::time_point recordTime;
+};
+
+/**
+ * Where careful resume takes a connection from the last connection's
+ * congestion state, once the rtt of the current path confirms it is likely
+ * the same path.
+ */
+struct CarefulResumeParams {
+  uint64_t jumpCwndBytes{0};
+  std::chrono::microseconds savedRtt{0us};
+};
+
+/**
+ * Cache of the congestion state of past connections, keyed by peer, e.g. by
+ * the client's subnet on servers and by hostname on clients, like the
+ * QuicPskCache. A server's cache is shared by its workers, so it has to be
+ * thread safe.
+ */
+class CongestionStateCache {
+ public:
+  virtual ~CongestionStateCache() = default;
+
+  virtual folly::Optional<CachedCongestionState> getCongestionState(
+      const std::string& key) = 0;
+  virtual void putCongestionState(
+      const std::string& key,
+      CachedCongestionState state) = 0;
+  virtual void removeCongestionState(const std::string& key) = 0;
+};
+
+/**
+ * Thread safe cache that keeps the state of the most recently seen peers.
+ */
+class BasicCongestionStateCache : public CongestionStateCache {
+ public:
+  explicit BasicCongestionStateCache(
+      size_t maxSize = kDefaultCongestionStateCacheSize);
+  ~BasicCongestionStateCache() override = default;
+
+  folly::Optional<CachedCongestionState> getCongestionState(
+      const std::string& key) override;
+  void putCongestionState(const std::string& key, CachedCongestionState state)
+      override;
+  void removeCongestionState(const std::string& key) override;
+
+ private:
+  std::mutex mutex_;
+  folly::EvictingCacheMap<std::string, CachedCongestionState> cache_;
+};
+
+/**
+ * Key of a client in a server's cache: its /24 for IPv4 and its /56 for IPv6
+ * addresses, which connections from the same access network share.
+ */
+std::string congestionStateCacheKey(const folly::IPAddress& address);
+
+} // namespace quic
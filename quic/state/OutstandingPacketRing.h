@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/Types.h>
+#include <quic/common/CircularDeque.h>
+
+#include <folly/Optional.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace quic {
+
+/**
+ * The outstanding packets of one packet number space, in a ring indexed by
+ * packet number: slot i holds the packet numbered base_ + i. Packet numbers
+ * only go up within a space, so a sent packet goes to the back, and the
+ * packet an ack names is found with an index instead of a search.
+ *
+ * An acked or lost packet leaves a tombstone, an empty slot, so nothing
+ * moves when one is erased from the middle. So do the packet numbers that
+ * are never stored, like those of pure acks. The tombstones at either end
+ * are dropped as soon as they get there, so that front() and back() are
+ * always live packets and the ring only spans what is outstanding.
+ *
+ * Iteration goes over the live packets in packet number order. An iterator
+ * is a packet number, so it stays valid when other packets are added or
+ * erased.
+ */
+template <class Packet>
+class OutstandingPacketRing {
+ public:
+  template <class Ring, class Value>
+  class Iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::remove_const_t<Value>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    Iterator() = default;
+
+    // iterator to const_iterator.
+    template <
+        class OtherRing,
+        class OtherValue,
+        std::enable_if_t<std::is_convertible<OtherValue*, Value*>::value, int> =
+            0>
+    /* implicit */ Iterator(const Iterator<OtherRing, OtherValue>& other)
+        : ring_(other.ring_), packetNum_(other.packetNum_) {}
+
+    reference operator*() const {
+      return *ring_->slots_[packetNum_ - ring_->base_];
+    }
+
+    pointer operator->() const {
+      return &**this;
+    }
+
+    Iterator& operator++() {
+      packetNum_ = ring_->nextLive(packetNum_ + 1);
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+
+    Iterator& operator--() {
+      packetNum_ = ring_->prevLive(ring_->clamp(packetNum_) - 1);
+      return *this;
+    }
+
+    Iterator operator--(int) {
+      auto it = *this;
+      --*this;
+      return it;
+    }
+
+    // An iterator past the back is end(), even if the back moved since.
+    bool operator==(const Iterator& other) const {
+      return ring_ == other.ring_ &&
+          ring_->clamp(packetNum_) == other.ring_->clamp(other.packetNum_);
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class OutstandingPacketRing;
+    template <class, class>
+    friend class Iterator;
+
+    Iterator(Ring* ring, PacketNum packetNum)
+        : ring_(ring), packetNum_(packetNum) {}
+
+    Ring* ring_{nullptr};
+    PacketNum packetNum_{0};
+  };
+
+  using iterator = Iterator<OutstandingPacketRing, Packet>;
+  using const_iterator = Iterator<const OutstandingPacketRing, const Packet>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  // The live packets, not counting the tombstones.
+  size_t size() const {
+    return size_;
+  }
+
+  Packet& front() {
+    DCHECK(!empty());
+    return *slots_.front();
+  }
+
+  const Packet& front() const {
+    DCHECK(!empty());
+    return *slots_.front();
+  }
+
+  Packet& back() {
+    DCHECK(!empty());
+    return *slots_.back();
+  }
+
+  const Packet& back() const {
+    DCHECK(!empty());
+    return *slots_.back();
+  }
+
+  iterator begin() {
+    return iterator(this, base_);
+  }
+
+  iterator end() {
+    return iterator(this, endPacketNum());
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, base_);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, endPacketNum());
+  }
+
+  reverse_iterator rbegin() {
+    return reverse_iterator(end());
+  }
+
+  reverse_iterator rend() {
+    return reverse_iterator(begin());
+  }
+
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  /**
+   * The packet numbered packetNum if it is outstanding, end() otherwise.
+   */
+  iterator find(PacketNum packetNum) {
+    return live(packetNum) ? iterator(this, packetNum) : end();
+  }
+
+  const_iterator find(PacketNum packetNum) const {
+    return live(packetNum) ? const_iterator(this, packetNum) : end();
+  }
+
+  /**
+   * Puts packet in the slot of its packet number. That is the back for a
+   * packet just sent, the slots in between become tombstones.
+   */
+  Packet& insert(Packet packet) {
+    auto packetNum = packet.packetNum;
+    if (slots_.empty()) {
+      base_ = packetNum;
+    }
+    while (packetNum < base_) {
+      slots_.emplace_front();
+      --base_;
+    }
+    while (packetNum - base_ >= slots_.size()) {
+      slots_.emplace_back();
+    }
+    auto& packetSlot = slots_[packetNum - base_];
+    DCHECK(!packetSlot) << "packetNum=" << packetNum << " is outstanding";
+    if (!packetSlot) {
+      ++size_;
+    }
+    packetSlot = std::move(packet);
+    return *packetSlot;
+  }
+
+  template <class... Args>
+  Packet& emplace_back(Args&&... args) {
+    return insert(Packet(std::forward<Args>(args)...));
+  }
+
+  void push_back(Packet packet) {
+    insert(std::move(packet));
+  }
+
+  /**
+   * Leaves a tombstone in the slot of pos, returns the next live packet.
+   */
+  iterator erase(const_iterator pos) {
+    auto packetNum = pos.packetNum_;
+    auto& packetSlot = slots_[packetNum - base_];
+    DCHECK(packetSlot);
+    // Reset so that what the packet owns is released now.
+    packetSlot.reset();
+    --size_;
+    while (!slots_.empty() && !slots_.front()) {
+      slots_.pop_front();
+      ++base_;
+    }
+    while (!slots_.empty() && !slots_.back()) {
+      slots_.pop_back();
+    }
+    return iterator(this, nextLive(packetNum + 1));
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    auto lastPacketNum = last.packetNum_;
+    auto it = iterator(this, first.packetNum_);
+    // The end moves down when the back is erased.
+    while (it.packetNum_ < clamp(lastPacketNum)) {
+      it = erase(it);
+    }
+    return it;
+  }
+
+  void pop_front() {
+    erase(begin());
+  }
+
+  void pop_back() {
+    erase(std::prev(end()));
+  }
+
+  /**
+   * Empties the ring, it keeps its buffer.
+   */
+  void clear() {
+    slots_.clear();
+    size_ = 0;
+  }
+
+ private:
+  PacketNum endPacketNum() const {
+    return base_ + slots_.size();
+  }
+
+  PacketNum clamp(PacketNum packetNum) const {
+    return std::min(packetNum, endPacketNum());
+  }
+
+  bool live(PacketNum packetNum) const {
+    return packetNum >= base_ && packetNum < endPacketNum() &&
+        slots_[packetNum - base_].hasValue();
+  }
+
+  // The first live packet numbered packetNum or above, or the end.
+  PacketNum nextLive(PacketNum packetNum) const {
+    packetNum = std::max(packetNum, base_);
+    while (packetNum < endPacketNum() && !slots_[packetNum - base_]) {
+      ++packetNum;
+    }
+    return clamp(packetNum);
+  }
+
+  // The last live packet numbered packetNum or below. The front is live.
+  PacketNum prevLive(PacketNum packetNum) const {
+    DCHECK_GE(packetNum, base_);
+    while (!slots_[packetNum - base_]) {
+      --packetNum;
+    }
+    return packetNum;
+  }
+
+  // Slot i is packet base_ + i, or its tombstone.
+  CircularDeque<folly::Optional<Packet>> slots_;
+  PacketNum base_{0};
+  size_t size_{0};
+};
+
+} // namespace quic
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/Types.h>
+#include <quic/common/CircularDeque.h>
+
+#include <folly/container/F14Set.h>
+#include <folly/lang/Bits.h>
+
+namespace quic {
+
+/**
+ * The PacketEvents of the clone groups that are still outstanding, i.e. none
+ * of whose packets has been acked or declared lost yet. A PacketEvent is the
+ * number of the first packet of its group, so the live ones lie within the
+ * outstanding packets and are kept as a bitmap over that window: checking a
+ * group is an index into it instead of a hash, and the groups coming and
+ * going under repeated PTOs don't churn a hash table.
+ *
+ * The window spans at most kMaxWindowWords words. The events that would
+ * stretch it further, far behind the rest, are kept in a hash set instead.
+ */
+class PacketEventSet {
+ public:
+  // 64K packets, 8KB of bitmap.
+  static constexpr size_t kMaxWindowWords = 1024;
+
+  size_t count(PacketNum event) const {
+    if (inWindow(event) && (wordOf(event) & maskOf(event))) {
+      return 1;
+    }
+    return sparse_.empty() ? 0 : sparse_.count(event);
+  }
+
+  bool insert(PacketNum event) {
+    if (!sparse_.empty() && sparse_.count(event)) {
+      return false;
+    }
+    if (words_.empty()) {
+      base_ = event - event % kBitsPerWord;
+    }
+    if (event < base_ &&
+        (base_ - event - 1) / kBitsPerWord + 1 + words_.size() >
+            kMaxWindowWords) {
+      sparse_.insert(event);
+      ++size_;
+      return true;
+    }
+    while (event < base_) {
+      words_.emplace_front(0);
+      base_ -= kBitsPerWord;
+    }
+    while ((event - base_) / kBitsPerWord >= words_.size()) {
+      if (words_.size() == kMaxWindowWords) {
+        evictFront();
+      }
+      words_.emplace_back(0);
+      if (words_.size() == 1) {
+        base_ = event - event % kBitsPerWord;
+      }
+    }
+    uint64_t& word = wordOf(event);
+    uint64_t mask = maskOf(event);
+    if (word & mask) {
+      return false;
+    }
+    word |= mask;
+    ++size_;
+    return true;
+  }
+
+  bool emplace(PacketNum event) {
+    return insert(event);
+  }
+
+  size_t erase(PacketNum event) {
+    if (!inWindow(event) || !(wordOf(event) & maskOf(event))) {
+      if (sparse_.empty() || !sparse_.erase(event)) {
+        return 0;
+      }
+      --size_;
+      return 1;
+    }
+    wordOf(event) &= ~maskOf(event);
+    --size_;
+    while (!words_.empty() && words_.front() == 0) {
+      words_.pop_front();
+      base_ += kBitsPerWord;
+    }
+    while (!words_.empty() && words_.back() == 0) {
+      words_.pop_back();
+    }
+    return 1;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  void clear() {
+    words_.clear();
+    sparse_.clear();
+    size_ = 0;
+  }
+
+ private:
+  static constexpr uint64_t kBitsPerWord = 64;
+
+  bool inWindow(PacketNum event) const {
+    return event >= base_ && (event - base_) / kBitsPerWord < words_.size();
+  }
+
+  uint64_t& wordOf(PacketNum event) {
+    return words_[(event - base_) / kBitsPerWord];
+  }
+
+  const uint64_t& wordOf(PacketNum event) const {
+    return words_[(event - base_) / kBitsPerWord];
+  }
+
+  static uint64_t maskOf(PacketNum event) {
+    return uint64_t(1) << (event % kBitsPerWord);
+  }
+
+  // Moves the events of the first word to the hash set, to make room at the
+  // back of the window.
+  void evictFront() {
+    for (uint64_t word = words_.front(); word; word &= word - 1) {
+      sparse_.insert(base_ + folly::findFirstSet(word) - 1);
+    }
+    words_.pop_front();
+    base_ += kBitsPerWord;
+    while (!words_.empty() && words_.front() == 0) {
+      words_.pop_front();
+      base_ += kBitsPerWord;
+    }
+  }
+
+  // bit i of the window is event base_ + i
+  CircularDeque<uint64_t> words_;
+  PacketNum base_{0};
+  // The events outside of the window.
+  folly::F14FastSet<PacketNum> sparse_;
+  size_t size_{0};
+};
+
+} // namespace quic
@@ -11,12 +11,16 @@ namespace quic {
  * https://tools.ietf.org/html/draft-ietf-quic-transport-23#section-9.3.1, an
  * endpoint must not send more than a minimum congestion window's worth of data
  * per esimtated rtt while handling a peer's migration before the path has been
- * validated.
+ * validated. The credit can be raised, to the initial congestion window a new
+ * path starts from, so that the data is not stalled while the challenge is
+ * outstanding.
  */
 class PendingPathRateLimiter {
  public:
-  explicit PendingPathRateLimiter(uint64_t udpSendPacketLen)
-      : maxCredit_(kMinCwndInMss * udpSendPacketLen), credit_(maxCredit_) {}
+  explicit PendingPathRateLimiter(
+      uint64_t udpSendPacketLen,
+      uint64_t maxCreditInMss = kMinCwndInMss)
+      : maxCredit_(maxCreditInMss * udpSendPacketLen), credit_(maxCredit_) {}
 
   virtual ~PendingPathRateLimiter() = default;
 
@@ -11,50 +11,74 @@
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/QuicStreamUtilities.h>
 
+#include <algorithm>
+#include <iterator>
+
 namespace quic {
 namespace {
 
-// shrink the buffers until offset, either by popping up or trimming from start
-void shrinkBuffers(std::deque<StreamBuffer>& buffers, uint64_t offset) {
-  while (!buffers.empty()) {
-    auto curr = buffers.begin();
-    if (curr->offset >= offset) {
-      // the buffers are supposed to be sorted, so we are done here
-      break;
-    }
-    size_t currSize = curr->data.chainLength();
-    if (curr->offset + currSize <= offset) {
-      buffers.pop_front();
-    } else {
-      uint64_t amount = offset - curr->offset;
-      curr->data.trimStartAtMost(amount);
-      curr->offset += amount;
-      break;
-    }
+// shrink the buffers until offset, erasing the ones below it in one go and
+// trimming the one it falls in, returns the number of bytes dropped. The
+// buffers are sorted and don't overlap, so they are found with a binary search
+// and a skip costs the number of buffers it frees rather than a walk and an
+// erase per buffer.
+template <class Buffers>
+uint64_t shrinkBuffers(Buffers& buffers, uint64_t offset) {
+  auto end = std::partition_point(
+      buffers.begin(), buffers.end(), [offset](const StreamBuffer& buffer) {
+        return buffer.offset < offset;
+      });
+  if (end == buffers.begin()) {
+    return 0;
+  }
+  // Only the last buffer starting below offset can reach past it.
+  auto last = std::prev(end);
+  if (last->offset + last->data.chainLength() > offset) {
+    end = last;
+  }
+  uint64_t dropped = 0;
+  for (auto itr = buffers.begin(); itr != end; ++itr) {
+    dropped += itr->data.chainLength();
+  }
+  buffers.erase(buffers.begin(), end);
+  auto first = buffers.begin();
+  if (first != buffers.end() && first->offset < offset) {
+    uint64_t amount = offset - first->offset;
+    dropped += first->data.trimStartAtMost(amount);
+    first->offset += amount;
   }
+  return dropped;
 }
 
-void shrinkBuffers(
-    folly::F14FastMap<uint64_t, StreamBuffer>& buffers,
-    uint64_t offset) {
-  // Do a linear search of the entire buffer, there can be exactly one trimmed
-  // buffer, since we are changing the offset for that single buffer we need to
-  // change the offset in the StreamBuffer, but keep it keyed on the same
-  // offset as before so we still remove it on ack.
-  for (auto itr = buffers.begin(); itr != buffers.end();) {
-    if (itr->second.offset >= offset) {
-      itr++;
-      continue;
-    }
-    if (itr->second.offset + itr->second.data.chainLength() <= offset) {
-      itr = buffers.erase(itr);
-    } else {
-      uint64_t amount = offset - itr->second.offset;
-      itr->second.data.trimStartAtMost(amount);
-      itr->second.offset += amount;
-      itr++;
-    }
+uint64_t shrinkBuffers(RetransmissionBuffer& buffers, uint64_t offset) {
+  // The buffers are ordered by the offset they are keyed on, so only the ones
+  // keyed below offset need looking at, and as they don't overlap all but the
+  // last of those end below offset. That one can be trimmed instead, since we
+  // are changing the offset for that single buffer we need to change the
+  // offset in the StreamBuffer, but keep it keyed on the same offset as before
+  // so we still remove it on ack.
+  auto end = buffers.lower_bound(offset);
+  if (end == buffers.begin()) {
+    return 0;
+  }
+  auto last = std::prev(end);
+  if (last->second.offset >= offset ||
+      last->second.offset + last->second.data.chainLength() > offset) {
+    end = last;
+  }
+  uint64_t dropped = 0;
+  for (auto itr = buffers.begin(); itr != end; ++itr) {
+    dropped += itr->second.data.chainLength();
+  }
+  buffers.erase(buffers.begin(), end);
+  auto first = buffers.begin();
+  if (first != buffers.end() && first->first < offset &&
+      first->second.offset < offset) {
+    uint64_t amount = offset - first->second.offset;
+    dropped += first->second.data.trimStartAtMost(amount);
+    first->second.offset += amount;
   }
+  return dropped;
 }
 
 void shrinkRetransmittableBuffers(
@@ -73,8 +97,10 @@ void shrinkRetransmittableBuffers(
   }
   VLOG(10) << __func__ << ": shrinking retransmissionBuffer to "
            << minimumRetransmittableOffset;
-  shrinkBuffers(stream->retransmissionBuffer, minimumRetransmittableOffset);
-  shrinkBuffers(stream->lossBuffer, minimumRetransmittableOffset);
+  auto dropped =
+      shrinkBuffers(stream->retransmissionBuffer, minimumRetransmittableOffset);
+  dropped += shrinkBuffers(stream->lossBuffer, minimumRetransmittableOffset);
+  updateUnackedBufferOnRelease(*stream, dropped);
 }
 
 void shrinkReadBuffer(QuicStreamState* stream) {
@@ -89,7 +115,7 @@ void shrinkReadBuffer(QuicStreamState* stream) {
   shrinkBuffers(stream->readBuffer, stream->currentReadOffset);
 
   // pretends we read stream.currentReadOffset - lastReadOffset bytes
-  updateFlowControlOnRead(*stream, lastReadOffset, Clock::now());
+  updateFlowControlOnRead(*stream, lastReadOffset, coarseNow(stream->conn));
   // may become readable after shrink
   stream->conn.streamManager->updateReadableStreams(*stream);
   stream->conn.streamManager->updatePeekableStreams(*stream);
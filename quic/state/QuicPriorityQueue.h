@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/container/F14Map.h>
+#include <quic/codec/Types.h>
+
+#include <glog/logging.h>
+
+#include <vector>
+
+namespace quic {
+
+using PriorityLevel = uint8_t;
+
+constexpr PriorityLevel kMaxPriorityLevel = 7;
+
+/**
+ * Priority of a stream, modeled after the urgency and incremental parameters
+ * of the HTTP extensible priorities. Lower levels are sent first. Within a
+ * level, incremental streams share the bandwidth round robin while the non
+ * incremental ones are sent one after the other in stream id order, ahead of
+ * the incremental ones.
+ */
+struct Priority {
+  PriorityLevel level;
+  bool incremental;
+
+  constexpr Priority(PriorityLevel levelIn, bool incrementalIn)
+      : level(levelIn), incremental(incrementalIn) {}
+
+  bool operator==(const Priority& other) const {
+    return level == other.level && incremental == other.incremental;
+  }
+
+  bool operator!=(const Priority& other) const {
+    return !operator==(other);
+  }
+};
+
+// Incremental, so that streams nobody prioritizes keep the round robin.
+constexpr Priority kDefaultPriority(3, true);
+
+/**
+ * Writable streams bucketed by priority. The streams of a level form a ring,
+ * linked through per stream nodes that are kept in a single map, so queueing
+ * and dequeueing a stream are constant time and, once the map has grown, don't
+ * allocate. Streams join the ring of their level at its back.
+ */
+class PriorityQueue {
+ public:
+  struct Level {
+    // Stream the next round starts at.
+    folly::Optional<StreamId> head;
+    size_t size{0};
+  };
+
+  PriorityQueue() : levels_(2 * (kMaxPriorityLevel + 1)) {}
+
+  static size_t levelIndex(Priority priority) {
+    DCHECK_LE(priority.level, kMaxPriorityLevel);
+    return 2 * priority.level + (priority.incremental ? 1 : 0);
+  }
+
+  static bool isIncremental(size_t index) {
+    return index % 2 == 1;
+  }
+
+  void insertOrUpdate(StreamId id, Priority priority) {
+    auto index = levelIndex(priority);
+    auto it = nodes_.find(id);
+    if (it == nodes_.end()) {
+      nodes_.emplace(id, Node{index, id, id});
+    } else if (it->second.level == index) {
+      return;
+    } else {
+      unlink(id, it->second);
+    }
+    link(id, index);
+  }
+
+  void updateIfExist(StreamId id, Priority priority) {
+    if (nodes_.count(id)) {
+      insertOrUpdate(id, priority);
+    }
+  }
+
+  void erase(StreamId id) {
+    auto it = nodes_.find(id);
+    if (it != nodes_.end()) {
+      unlink(id, it->second);
+      nodes_.erase(it);
+    }
+  }
+
+  void clear() {
+    for (auto& level : levels_) {
+      level = Level();
+    }
+    nodes_.clear();
+  }
+
+  /**
+   * Frees the memory of the node map if no stream is queued.
+   */
+  void shrinkToFit() {
+    if (nodes_.empty()) {
+      decltype(nodes_)().swap(nodes_);
+    }
+  }
+
+  size_t count(StreamId id) const {
+    return nodes_.count(id);
+  }
+
+  bool empty() const {
+    return nodes_.empty();
+  }
+
+  size_t size() const {
+    return nodes_.size();
+  }
+
+  /**
+   * Stream after id in the ring of its level.
+   */
+  StreamId nextInLevel(StreamId id) const {
+    return nodes_.at(id).next;
+  }
+
+  /**
+   * Makes id, which has to be queued at the level, the start of its next
+   * round.
+   */
+  void setHead(size_t index, StreamId id) {
+    DCHECK_EQ(nodes_.at(id).level, index);
+    levels_[index].head = id;
+  }
+
+  const Level& level(Priority priority) const {
+    return levels_[levelIndex(priority)];
+  }
+
+  /**
+   * Levels in the order they should be served in.
+   */
+  const std::vector<Level>& levels() const {
+    return levels_;
+  }
+
+ private:
+  struct Node {
+    size_t level;
+    StreamId prev;
+    StreamId next;
+  };
+
+  void link(StreamId id, size_t index) {
+    Level& level = levels_[index];
+    Node& node = nodes_.at(id);
+    node.level = index;
+    if (!level.head) {
+      node.prev = id;
+      node.next = id;
+      level.head = id;
+    } else {
+      Node& head = nodes_.at(*level.head);
+      Node& tail = nodes_.at(head.prev);
+      node.prev = head.prev;
+      node.next = *level.head;
+      tail.next = id;
+      head.prev = id;
+    }
+    ++level.size;
+  }
+
+  void unlink(StreamId id, const Node& node) {
+    Level& level = levels_[node.level];
+    if (level.size == 1) {
+      level.head = folly::none;
+    } else {
+      nodes_.at(node.prev).next = node.next;
+      nodes_.at(node.next).prev = node.prev;
+      if (*level.head == id) {
+        level.head = node.next;
+      }
+    }
+    --level.size;
+  }
+
+  std::vector<Level> levels_;
+  folly::F14FastMap<StreamId, Node> nodes_;
+};
+
+} // namespace quic
@@ -12,18 +12,7 @@
 #include <quic/common/TimeUtil.h>
 #include <quic/logging/QuicLogger.h>
 
-namespace {
-std::deque<quic::OutstandingPacket>::reverse_iterator
-getPreviousOutstandingPacket(
-    quic::QuicConnectionStateBase& conn,
-    quic::PacketNumberSpace packetNumberSpace,
-    std::deque<quic::OutstandingPacket>::reverse_iterator from) {
-  return std::find_if(
-      from, conn.outstandingPackets.rend(), [=](const auto& op) {
-        return packetNumberSpace == op.packet.header.getPacketNumberSpace();
-      });
-}
-} // namespace
+#include <algorithm>
 
 namespace quic {
 
@@ -45,6 +34,8 @@ void updateRtt(
   // explicitly. We might want to change this by including ackDelay
   // as well.
   conn.lossState.lrtt = rttSample;
+  conn.latencyHistograms.rtt.addSample(rttSample);
+  conn.latencyHistograms.ackDelay.addSample(ackDelay);
   if (conn.lossState.srtt == 0us) {
     conn.lossState.srtt = rttSample;
     conn.lossState.rttvar = rttSample / 2;
@@ -76,20 +67,31 @@ void updateAckSendStateOnRecvPacket(
     bool pktHasRetransmittableData,
     bool pktHasCryptoData) {
   DCHECK(!pktHasCryptoData || pktHasRetransmittableData);
-  auto thresh = kNonRtxRxPacketsPendingBeforeAck;
-  if (pktHasRetransmittableData || ackState.numRxPacketsRecvd) {
+  uint64_t thresh = kNonRtxRxPacketsPendingBeforeAck;
+  if (ackState.peerAckFrequency) {
+    if (ackState.peerAckFrequency->ignoreOrder) {
+      pktOutOfOrder = false;
+    }
+    if (pktHasRetransmittableData || ackState.numRxPacketsRecvd) {
+      thresh = ackState.peerAckFrequency->packetTolerance;
+    }
+  } else if (pktHasRetransmittableData || ackState.numRxPacketsRecvd) {
     thresh = ackState.largestReceivedPacketNum.value_or(0) >
             conn.transportSettings.rxPacketsBeforeAckInitThreshold
         ? conn.transportSettings.rxPacketsBeforeAckAfterInit
         : conn.transportSettings.rxPacketsBeforeAckBeforeInit;
   }
+  bool immediateAckRequested = ackState.immediateAckRequested;
+  ackState.immediateAckRequested = false;
   if (pktHasRetransmittableData) {
-    if (pktHasCryptoData || pktOutOfOrder ||
+    if (pktHasCryptoData || pktOutOfOrder || immediateAckRequested ||
         ++ackState.numRxPacketsRecvd + ackState.numNonRxPacketsRecvd >=
             thresh) {
       VLOG(10) << conn
                << " ack immediately because packet threshold pktHasCryptoData="
-               << pktHasCryptoData << " pktHasRetransmittableData="
+               << pktHasCryptoData
+               << " immediateAckRequested=" << immediateAckRequested
+               << " pktHasRetransmittableData="
                << static_cast<int>(pktHasRetransmittableData)
                << " numRxPacketsRecvd="
                << static_cast<int>(ackState.numRxPacketsRecvd)
@@ -126,6 +128,49 @@ void updateAckSendStateOnRecvPacket(
   }
 }
 
+void updateAckFrequency(QuicConnectionStateBase& conn, TimePoint now) {
+  auto& state = conn.ackFrequencyState;
+  if (!state.peerMinAckDelay || !conn.congestionController ||
+      conn.lossState.srtt == 0us) {
+    return;
+  }
+  if (state.lastSentTime && now - *state.lastSentTime < conn.lossState.srtt) {
+    return;
+  }
+  uint64_t cwndPackets = conn.congestionController->getCongestionWindow() /
+      conn.udpSendPacketLen;
+  uint64_t packetTolerance = std::max<uint64_t>(
+      kDefaultRxPacketsBeforeAckAfterInit,
+      std::min(
+          cwndPackets / kAckFrequencyAcksPerCwnd,
+          kMaxAckFrequencyPacketTolerance));
+  // Until the first frame the peer uses its own packet tolerance.
+  uint64_t currentPacketTolerance = state.lastSentTime
+      ? state.packetTolerance
+      : kDefaultRxPacketsBeforeAckAfterInit;
+  uint64_t change = packetTolerance > currentPacketTolerance
+      ? packetTolerance - currentPacketTolerance
+      : currentPacketTolerance - packetTolerance;
+  if (change == 0 || change * 4 < currentPacketTolerance) {
+    return;
+  }
+  auto factoredRtt = std::chrono::duration_cast<std::chrono::microseconds>(
+      kAckTimerFactor * conn.lossState.srtt);
+  auto maxAckDelay =
+      timeMax(*state.peerMinAckDelay, timeMin(kMaxAckTimeout, factoredRtt));
+  VLOG(10) << conn << " ack frequency packetTolerance=" << packetTolerance
+           << " maxAckDelay=" << maxAckDelay.count() << "us"
+           << " cwndPackets=" << cwndPackets;
+  conn.pendingEvents.frames.emplace_back(AckFrequencyFrame(
+      state.nextSequenceNumber++,
+      packetTolerance,
+      maxAckDelay,
+      false /* ignoreOrder */));
+  state.packetTolerance = packetTolerance;
+  state.maxAckDelay = maxAckDelay;
+  state.lastSentTime = now;
+}
+
 void updateAckStateOnAckTimeout(QuicConnectionStateBase& conn) {
   VLOG(10) << conn << " ack immediately due to ack timeout";
   conn.ackStates.appDataAckState.needsToSendAckImmediately = true;
@@ -157,6 +202,32 @@ bool isConnectionPaced(const QuicConnectionStateBase& conn) noexcept {
       conn.transportSettings.pacingEnabled && conn.canBePaced && conn.pacer);
 }
 
+bool isConnectionPacedInKernel(const QuicConnectionStateBase& conn) noexcept {
+  // the writer shared across connections does not carry departure times
+  return isConnectionPaced(conn) && conn.transportSettings.txTimePacing &&
+      conn.socketTxTimeEnabled && !conn.multiDestBatchWriter;
+}
+
+bool isEcnMarkingEnabled(const QuicConnectionStateBase& conn) noexcept {
+  return conn.transportSettings.enableEcn && !conn.ecnFailed;
+}
+
+void updateEcnCounts(AckState& ackState, uint8_t ecn) noexcept {
+  switch (ecn & kEcnMask) {
+    case kEcnEct0:
+      ackState.ecnCounts.ect0++;
+      break;
+    case kEcnEct1:
+      ackState.ecnCounts.ect1++;
+      break;
+    case kEcnCe:
+      ackState.ecnCounts.ce++;
+      break;
+    default:
+      break;
+  }
+}
+
 AckState& getAckState(
     QuicConnectionStateBase& conn,
     PacketNumberSpace pnSpace) noexcept {
@@ -208,29 +279,6 @@ void increaseNextPacketNum(
   }
 }
 
-std::deque<OutstandingPacket>::iterator getFirstOutstandingPacket(
-    QuicConnectionStateBase& conn,
-    PacketNumberSpace packetNumberSpace) {
-  return getNextOutstandingPacket(
-      conn, packetNumberSpace, conn.outstandingPackets.begin());
-}
-
-std::deque<OutstandingPacket>::reverse_iterator getLastOutstandingPacket(
-    QuicConnectionStateBase& conn,
-    PacketNumberSpace packetNumberSpace) {
-  return getPreviousOutstandingPacket(
-      conn, packetNumberSpace, conn.outstandingPackets.rbegin());
-}
-
-std::deque<OutstandingPacket>::iterator getNextOutstandingPacket(
-    QuicConnectionStateBase& conn,
-    PacketNumberSpace packetNumberSpace,
-    std::deque<OutstandingPacket>::iterator from) {
-  return std::find_if(from, conn.outstandingPackets.end(), [=](const auto& op) {
-    return packetNumberSpace == op.packet.header.getPacketNumberSpace();
-  });
-}
-
 bool hasReceivedPacketsAtLastCloseSent(
     const QuicConnectionStateBase& conn) noexcept {
   return conn.ackStates.initialAckState.largestReceivedAtLastCloseSent ||
@@ -313,6 +361,11 @@ std::pair<folly::Optional<TimePoint>, PacketNumberSpace> earliestTimeAndSpace(
 }
 
 void handshakeConfirmed(QuicConnectionStateBase& conn) {
+  QUIC_PROBE(
+      handshake_done,
+      conn,
+      static_cast<uint8_t>(conn.nodeType),
+      conn.lossState.srtt.count());
   if (conn.nodeType == QuicNodeType::Client) {
     conn.handshakeLayer->handshakeConfirmed();
   }
@@ -324,4 +377,223 @@ void handshakeConfirmed(QuicConnectionStateBase& conn) {
   cancelCryptoStream(conn.cryptoState->handshakeStream);
 }
 
+void updateOneRttKeys(QuicConnectionStateBase& conn) {
+  if (!conn.handshakeLayer || !conn.readCodec || !conn.oneRttWriteCipher ||
+      !conn.readCodec->getOneRttReadCipher()) {
+    return;
+  }
+  auto readGeneration = conn.readCodec->getOneRttReadKeyGeneration();
+  bool updateWriteKeys = readGeneration > conn.oneRttWriteKeyGeneration;
+  auto interval = conn.transportSettings.keyUpdatePacketInterval;
+  // The handshake write keys are dropped once the handshake is confirmed.
+  if (!updateWriteKeys && interval > 0 && !conn.handshakeWriteCipher &&
+      readGeneration == conn.oneRttWriteKeyGeneration) {
+    auto generationStart = conn.oneRttWriteGenerationStart.value_or(0);
+    auto nextPacketNum = getNextPacketNum(conn, PacketNumberSpace::AppData);
+    updateWriteKeys = nextPacketNum - generationStart >= interval &&
+        conn.ackStates.appDataAckState.largestAckedByPeer >= generationStart;
+  }
+  if (updateWriteKeys && conn.nextOneRttWriteCipher) {
+    conn.oneRttWriteCipher = std::move(conn.nextOneRttWriteCipher);
+    conn.oneRttWriteKeyGeneration++;
+    conn.oneRttWriteGenerationStart =
+        getNextPacketNum(conn, PacketNumberSpace::AppData);
+    VLOG(10) << "Key update to write generation "
+             << conn.oneRttWriteKeyGeneration << " at packet="
+             << *conn.oneRttWriteGenerationStart << " " << conn;
+  }
+  if (!conn.nextOneRttWriteCipher) {
+    conn.nextOneRttWriteCipher =
+        conn.handshakeLayer->getNextOneRttWriteCipher();
+  }
+  if (!conn.readCodec->getNextOneRttReadCipher()) {
+    conn.readCodec->setNextOneRttReadCipher(
+        conn.handshakeLayer->getNextOneRttReadCipher());
+  }
+}
+
+void maybeOffloadOneRttWriteCiphers(QuicConnectionStateBase& conn) {
+  if (!conn.cryptoOffload || !conn.oneRttWriteCipher ||
+      !conn.oneRttWriteHeaderCipher ||
+      conn.cryptoOffloadKeyGeneration == conn.oneRttWriteKeyGeneration) {
+    return;
+  }
+  conn.cryptoOffloadKeyGeneration = conn.oneRttWriteKeyGeneration;
+  if (!offloadCiphers(
+          conn.cryptoOffload,
+          conn.oneRttWriteCipher,
+          conn.oneRttWriteHeaderCipher)) {
+    VLOG(4) << "Sealing write generation " << conn.oneRttWriteKeyGeneration
+            << " in software " << conn;
+  }
+}
+
+void maybeParallelizeOneRttWriteCipher(QuicConnectionStateBase& conn) {
+  if (!conn.cryptoWorkers || !conn.oneRttWriteCipher || !conn.handshakeLayer ||
+      conn.oneRttWriteCipher->getOffloadKeyId() ||
+      conn.cryptoWorkersKeyGeneration == conn.oneRttWriteKeyGeneration) {
+    return;
+  }
+  conn.cryptoWorkersKeyGeneration = conn.oneRttWriteKeyGeneration;
+  std::vector<std::unique_ptr<Aead>> lanes;
+  lanes.push_back(std::move(conn.oneRttWriteCipher));
+  for (size_t i = 0; i < conn.cryptoWorkers->numThreads(); ++i) {
+    auto lane = conn.handshakeLayer->makeOneRttWriteCipher(
+        conn.oneRttWriteKeyGeneration);
+    if (!lane) {
+      VLOG(4) << "Sealing write generation " << conn.oneRttWriteKeyGeneration
+              << " on one thread " << conn;
+      conn.oneRttWriteCipher = std::move(lanes.front());
+      return;
+    }
+    lanes.push_back(std::move(lane));
+  }
+  conn.oneRttWriteCipher =
+      std::make_unique<ParallelAead>(std::move(lanes), conn.cryptoWorkers);
+}
+
+void handleDatagram(QuicConnectionStateBase& conn, DatagramFrame&& frame) {
+  if (frame.length > conn.transportSettings.maxRecvDatagramFrameSize) {
+    throw QuicTransportException(
+        "Datagram larger than max_datagram_frame_size",
+        TransportErrorCode::PROTOCOL_VIOLATION,
+        FrameType::DATAGRAM);
+  }
+  auto& readBuffer = conn.datagramState.readBuffer;
+  if (conn.transportSettings.datagramReadBufferSize == 0) {
+    return;
+  }
+  if (readBuffer.size() >= conn.transportSettings.datagramReadBufferSize) {
+    VLOG(10) << "Dropping the oldest received datagram " << conn;
+    readBuffer.pop_front();
+  }
+  readBuffer.push_back(std::move(frame.data));
+}
+
+void removeExpiredDatagrams(QuicConnectionStateBase& conn, TimePoint now) {
+  auto& writeBuffer = conn.datagramState.writeBuffer;
+  auto numBefore = writeBuffer.size();
+  writeBuffer.erase(
+      std::remove_if(
+          writeBuffer.begin(),
+          writeBuffer.end(),
+          [now](const auto& datagram) {
+            return datagram.deadline && *datagram.deadline <= now;
+          }),
+      writeBuffer.end());
+  if (writeBuffer.size() != numBefore) {
+    VLOG(10) << "Dropped " << numBefore - writeBuffer.size()
+             << " expired datagrams " << conn;
+    conn.datagramState.numExpiredWrites += numBefore - writeBuffer.size();
+  }
+}
+
+void startPmtuDiscovery(
+    QuicConnectionStateBase& conn,
+    uint64_t peerMaxUdpPayloadSize) {
+  if (!conn.transportSettings.pmtuDiscoveryEnabled) {
+    return;
+  }
+  conn.pmtuDiscoveryState.basePmtu = conn.udpSendPacketLen;
+  conn.pmtuDiscoveryState.peerMaxUdpPayloadSize = peerMaxUdpPayloadSize;
+  restartPmtuDiscovery(conn);
+}
+
+void restartPmtuDiscovery(QuicConnectionStateBase& conn) {
+  auto& state = conn.pmtuDiscoveryState;
+  if (state.basePmtu == 0) {
+    return;
+  }
+  conn.udpSendPacketLen = state.basePmtu;
+  state.searchHigh = std::min<uint64_t>(
+      state.peerMaxUdpPayloadSize, conn.transportSettings.maxPmtuProbeSize);
+  state.probePacketNum = folly::none;
+  state.probeLosses = 0;
+  state.probeSize = folly::none;
+  if (state.searchHigh >= conn.udpSendPacketLen + kPmtuSearchResolution) {
+    // The largest size first, most paths carry it.
+    state.probeSize = state.searchHigh;
+  }
+}
+
+namespace {
+void setNextPmtuProbeSize(QuicConnectionStateBase& conn) {
+  auto& state = conn.pmtuDiscoveryState;
+  state.probePacketNum = folly::none;
+  state.probeLosses = 0;
+  if (state.searchHigh < conn.udpSendPacketLen + kPmtuSearchResolution) {
+    VLOG(4) << "PMTU search done udpSendPacketLen=" << conn.udpSendPacketLen
+            << " " << conn;
+    state.probeSize = folly::none;
+    return;
+  }
+  state.probeSize = (conn.udpSendPacketLen + state.searchHigh + 1) / 2;
+}
+} // namespace
+
+bool hasPendingPmtuProbe(const QuicConnectionStateBase& conn) {
+  return conn.pmtuDiscoveryState.probeSize &&
+      !conn.pmtuDiscoveryState.probePacketNum;
+}
+
+bool isPmtuProbe(
+    const QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    PacketNum packetNum) {
+  return pnSpace == PacketNumberSpace::AppData &&
+      conn.pmtuDiscoveryState.probePacketNum == packetNum;
+}
+
+void onPmtuProbeSent(QuicConnectionStateBase& conn, PacketNum packetNum) {
+  DCHECK(conn.pmtuDiscoveryState.probeSize);
+  conn.pmtuDiscoveryState.probePacketNum = packetNum;
+}
+
+void onPmtuProbeAcked(QuicConnectionStateBase& conn) {
+  auto& state = conn.pmtuDiscoveryState;
+  CHECK(state.probeSize);
+  VLOG(4) << "PMTU probe of " << *state.probeSize << " bytes acked " << conn;
+  conn.udpSendPacketLen = *state.probeSize;
+  setNextPmtuProbeSize(conn);
+}
+
+void onPmtuProbeLost(QuicConnectionStateBase& conn) {
+  auto& state = conn.pmtuDiscoveryState;
+  CHECK(state.probeSize);
+  state.probePacketNum = folly::none;
+  if (++state.probeLosses < kMaxPmtuProbeLosses) {
+    return;
+  }
+  VLOG(4) << "PMTU probe of " << *state.probeSize << " bytes lost " << conn;
+  state.searchHigh = *state.probeSize - 1;
+  setNextPmtuProbeSize(conn);
+}
+
+void releaseIdleConnectionMemory(QuicConnectionStateBase& conn) {
+  if (conn.streamManager) {
+    conn.streamManager->releaseMemoryIfNoStreams();
+  }
+  for (auto pnSpace : conn.outstandingPackets.spaces()) {
+    if (conn.outstandingPackets[pnSpace].empty()) {
+      conn.outstandingPackets[pnSpace] = OutstandingPackets::Queue();
+    }
+  }
+  if (conn.outstandingPacketEvents.empty()) {
+    conn.outstandingPacketEvents = PacketEventSet();
+  }
+  if (conn.cryptoState) {
+    for (auto stream :
+         {&conn.cryptoState->initialStream,
+          &conn.cryptoState->handshakeStream,
+          &conn.cryptoState->oneRttStream}) {
+      if (stream->retransmissionBuffer.empty()) {
+        RetransmissionBuffer().swap(stream->retransmissionBuffer);
+      }
+      if (stream->lossBuffer.empty()) {
+        std::deque<StreamBuffer>().swap(stream->lossBuffer);
+      }
+    }
+  }
+}
+
 } // namespace quic
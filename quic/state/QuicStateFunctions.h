@@ -29,6 +29,13 @@ void updateAckSendStateOnSentPacketWithAcks(
     AckState& ackState,
     PacketNum largestAckScheduled);
 
+/**
+ * Asks a peer that takes ACK_FREQUENCY frames to ack about
+ * kAckFrequencyAcksPerCwnd times per congestion window. A new frame is sent at
+ * most once per srtt, and only when the packet tolerance moved by a quarter.
+ */
+void updateAckFrequency(QuicConnectionStateBase& conn, TimePoint now);
+
 void updateRtt(
     QuicConnectionStateBase& conn,
     std::chrono::microseconds rttSample,
@@ -36,6 +43,22 @@ void updateRtt(
 
 bool isConnectionPaced(const QuicConnectionStateBase& conn) noexcept;
 
+/**
+ * Whether a paced connection leaves the pacing to the kernel with SO_TXTIME
+ * departure times instead of writing one burst per pacing timer tick.
+ */
+bool isConnectionPacedInKernel(const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * Whether the packets of the connection are sent with ECT(0).
+ */
+bool isEcnMarkingEnabled(const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * Counts a packet received with the ECN codepoint ecn.
+ */
+void updateEcnCounts(AckState& ackState, uint8_t ecn) noexcept;
+
 AckState& getAckState(
     QuicConnectionStateBase& conn,
     PacketNumberSpace pnSpace) noexcept;
@@ -71,6 +94,11 @@ bool updateLargestReceivedPacketNum(
   ackState.largestReceivedPacketNum = std::max<PacketNum>(
       ackState.largestReceivedPacketNum.value_or(packetNum), packetNum);
   ackState.acks.insert(packetNum);
+  if (ackState.acks.size() > kMaxReceivedAckBlocks) {
+    // Forget the oldest range, it has most likely been acked many times.
+    const auto& oldest = ackState.acks.front();
+    ackState.acks.withdraw({oldest.start, oldest.end});
+  }
   if (ackState.largestReceivedPacketNum == packetNum) {
     ackState.largestRecvdPacketTime = receivedTime;
   }
@@ -78,18 +106,6 @@ bool updateLargestReceivedPacketNum(
   return expectedNextPacket != packetNum;
 }
 
-std::deque<OutstandingPacket>::iterator getNextOutstandingPacket(
-    QuicConnectionStateBase& conn,
-    PacketNumberSpace packetNumberSpace,
-    std::deque<OutstandingPacket>::iterator from);
-std::deque<OutstandingPacket>::iterator getFirstOutstandingPacket(
-    QuicConnectionStateBase& conn,
-    PacketNumberSpace packetNumberSpace);
-
-std::deque<OutstandingPacket>::reverse_iterator getLastOutstandingPacket(
-    QuicConnectionStateBase& conn,
-    PacketNumberSpace packetNumberSpace);
-
 bool hasReceivedPackets(const QuicConnectionStateBase& conn) noexcept;
 
 bool hasReceivedPacketsAtLastCloseSent(
@@ -116,4 +132,81 @@ std::pair<folly::Optional<TimePoint>, PacketNumberSpace> earliestTimeAndSpace(
 
 void handshakeConfirmed(QuicConnectionStateBase& conn);
 
+/**
+ * Frees the memory the connection keeps for streams and packets in flight
+ * once it has neither, e.g. after it has been idle for a while. What is freed
+ * is allocated again as the connection is used.
+ */
+void releaseIdleConnectionMemory(QuicConnectionStateBase& conn);
+
+/**
+ * Moves the 1-RTT write keys on to the next generation when the peer updated
+ * its keys, or when the current ones protected keyUpdatePacketInterval
+ * packets and we may start an update, i.e. the handshake is confirmed, the
+ * peer acked a packet of the current generation and followed the last
+ * update. Then derives the ciphers of the next generation that are missing,
+ * which only happens right after an update, so the next one doesn't wait
+ * for them.
+ */
+void updateOneRttKeys(QuicConnectionStateBase& conn);
+
+/**
+ * Installs the current 1-RTT write keys on the connection's CryptoOffload,
+ * once per key generation. The packets are sealed in software if the device
+ * can't take them.
+ */
+void maybeOffloadOneRttWriteCiphers(QuicConnectionStateBase& conn);
+
+/**
+ * Replaces the current 1-RTT write cipher with a ParallelAead sealing on the
+ * connection's CryptoWorkerPool, once per key generation. Ciphers on a
+ * CryptoOffload are left alone, as are the ones the handshake can't make
+ * more instances of.
+ */
+void maybeParallelizeOneRttWriteCipher(QuicConnectionStateBase& conn);
+
+/**
+ * Queues the payload of a received DATAGRAM frame for the app, dropping the
+ * oldest one when datagramReadBufferSize are queued already. Throws if we did
+ * not advertise taking a frame that large.
+ */
+void handleDatagram(QuicConnectionStateBase& conn, DatagramFrame&& frame);
+
+/**
+ * Drops the datagrams waiting to be sent whose deadline passed, a late one
+ * is worth nothing to the peer.
+ */
+void removeExpiredDatagrams(QuicConnectionStateBase& conn, TimePoint now);
+
+/**
+ * Path MTU discovery, see RFC 8899. It starts from udpSendPacketLen once the
+ * max_packet_size of the peer is known and searches for the largest packet
+ * size the path carries with padded PING probes, one in flight at a time.
+ * An acked probe raises udpSendPacketLen to its size, a size lost
+ * kMaxPmtuProbeLosses times bounds the search. The loss of a probe is not
+ * congestion, it is kept out of the congestion controller's loss events.
+ */
+void startPmtuDiscovery(
+    QuicConnectionStateBase& conn,
+    uint64_t peerMaxUdpPayloadSize);
+
+/**
+ * Goes back to the packet size discovery started with and searches again,
+ * for a new path.
+ */
+void restartPmtuDiscovery(QuicConnectionStateBase& conn);
+
+bool hasPendingPmtuProbe(const QuicConnectionStateBase& conn);
+
+bool isPmtuProbe(
+    const QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    PacketNum packetNum);
+
+void onPmtuProbeSent(QuicConnectionStateBase& conn, PacketNum packetNum);
+
+void onPmtuProbeAcked(QuicConnectionStateBase& conn);
+
+void onPmtuProbeLost(QuicConnectionStateBase& conn);
+
 } // namespace quic
@@ -37,7 +37,21 @@ void writeDataToQuicStream(QuicStreamState& stream, Buf data, bool eof) {
     // write a blocked frame first time the stream becomes blocked
     maybeWriteBlockAfterAPIWrite(stream);
   }
-  stream.writeBuffer.append(std::move(data));
+  const auto& transportSettings = stream.conn.transportSettings;
+  if (transportSettings.packSmallStreamWrites) {
+    stream.writeBuffer.appendPacked(
+        std::move(data),
+        transportSettings.packedStreamWriteMaxLength,
+        transportSettings.packedStreamWritePageSize);
+  } else {
+    stream.writeBuffer.append(std::move(data));
+  }
+  if (len > 0 &&
+      stream.unsentWriteTimes.size() < kMaxStreamWriteLatencySamples) {
+    stream.unsentWriteTimes.emplace_back(
+        stream.currentWriteOffset + stream.writeBuffer.chainLength(),
+        coarseNow(stream.conn));
+  }
   if (eof) {
     auto bufferSize =
         stream.writeBuffer.front() ? stream.writeBuffer.chainLength() : 0;
@@ -113,11 +127,24 @@ void appendDataToReadBufferCommon(
     return;
   }
 
+  // Data that continues or comes after the last segment, which is all of it
+  // when the stream is received in order, doesn't need a search.
+  auto& tail = readBuffer.back();
+  auto tailEnd = tail.offset + tail.data.chainLength();
+  if (buffer.offset == tailEnd) {
+    tail.data.append(buffer.data.move());
+    tail.eof = buffer.eof;
+    return;
+  } else if (buffer.offset > tailEnd) {
+    readBuffer.emplace_back(std::move(buffer));
+    return;
+  }
+
   // Start overlap will point to the first buffer that overlaps with the
   // current buffer and End overlap will point to the last buffer that overlaps.
   // They must always be set together.
-  folly::Optional<std::deque<StreamBuffer>::iterator> startOverlap;
-  folly::Optional<std::deque<StreamBuffer>::iterator> endOverlap;
+  folly::Optional<StreamReadBuffer::iterator> startOverlap;
+  folly::Optional<StreamReadBuffer::iterator> endOverlap;
 
   StreamBuffer* current = &buffer;
   bool currentAlreadyInserted = false;
@@ -245,7 +272,10 @@ std::pair<Buf, bool> readDataInOrderFromReadBuffer(
     uint64_t toRead =
         std::min<uint64_t>(currSize, amount == 0 ? currSize : remaining);
     std::unique_ptr<folly::IOBuf> splice;
-    if (sinkData) {
+    if (toRead != 0 && toRead == currSize) {
+      // Hand out the whole chain rather than walking it to split.
+      splice = curr->data.move();
+    } else if (sinkData) {
       curr->data.trimStart(toRead);
     } else {
       splice = curr->data.splitAtMost(toRead);
@@ -254,7 +284,7 @@ std::pair<Buf, bool> readDataInOrderFromReadBuffer(
     curr->offset += toRead;
     if (curr->data.chainLength() == 0) {
       eof = curr->eof;
-      stream.readBuffer.pop_front();
+      stream.readBuffer.erase(curr);
     }
     if (!sinkData) {
       prependToBuf(data, std::move(splice));
@@ -289,9 +319,17 @@ std::pair<Buf, bool> readDataFromQuicStream(
 
   Buf data;
   std::tie(data, eof) = readDataInOrderFromReadBuffer(stream, amount);
+  auto repairWindow = stream.conn.transportSettings.streamRepairReceiveWindow;
+  if (repairWindow && data) {
+    stream.recentlyRead.append(data->clone());
+    if (stream.recentlyRead.chainLength() > repairWindow) {
+      stream.recentlyRead.trimStart(
+          stream.recentlyRead.chainLength() - repairWindow);
+    }
+  }
   // Update flow control before handling eof as eof is not subject to flow
   // control
-  updateFlowControlOnRead(stream, lastReadOffset, Clock::now());
+  updateFlowControlOnRead(stream, lastReadOffset, coarseNow(stream.conn));
   eof = stream.finalReadOffset &&
       stream.currentReadOffset == *stream.finalReadOffset;
   if (eof) {
@@ -335,7 +373,7 @@ void consumeDataFromQuicStream(QuicStreamState& stream, uint64_t amount) {
   readDataInOrderFromReadBuffer(stream, amount, true /* sinkData */);
   // Update flow control before handling eof as eof is not subject to flow
   // control
-  updateFlowControlOnRead(stream, lastReadOffset, Clock::now());
+  updateFlowControlOnRead(stream, lastReadOffset, coarseNow(stream.conn));
   eof = stream.finalReadOffset &&
       stream.currentReadOffset == *stream.finalReadOffset;
   if (eof) {
@@ -398,6 +436,35 @@ uint64_t getStreamNextOffsetToDeliver(const QuicStreamState& stream) {
   return minOffsetToDeliver;
 }
 
+void updateWriteLatencyOnNewDataWritten(
+    QuicStreamState& stream,
+    TimePoint sentTime) {
+  auto& unsent = stream.unsentWriteTimes;
+  while (!unsent.empty() && unsent.front().first <= stream.currentWriteOffset) {
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        sentTime - unsent.front().second);
+    stream.conn.latencyHistograms.sendBuffer.addSample(latency);
+    if (stream.undeliveredWriteTimes.size() < kMaxStreamWriteLatencySamples) {
+      stream.undeliveredWriteTimes.push_back(unsent.front());
+    }
+    unsent.pop_front();
+  }
+}
+
+void updateWriteLatencyOnDelivery(QuicStreamState& stream, TimePoint ackTime) {
+  auto& undelivered = stream.undeliveredWriteTimes;
+  if (undelivered.empty()) {
+    return;
+  }
+  auto deliveredOffset = getStreamNextOffsetToDeliver(stream);
+  while (!undelivered.empty() && undelivered.front().first <= deliveredOffset) {
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        ackTime - undelivered.front().second);
+    stream.conn.latencyHistograms.delivery.addSample(latency);
+    undelivered.pop_front();
+  }
+}
+
 void cancelCryptoStream(QuicCryptoStream& cryptoStream) {
   cryptoStream.retransmissionBuffer.clear();
   cryptoStream.lossBuffer.clear();
@@ -63,7 +63,7 @@ Buf readDataFromCryptoStream(QuicCryptoStream& stream, uint64_t amount = 0);
  * Invokes provided callback on the existing data.
  * Does not affect stream state (as opposed to read).
  */
-using PeekIterator = std::deque<StreamBuffer>::const_iterator;
+using PeekIterator = StreamReadBuffer::const_iterator;
 void peekDataFromQuicStream(
     QuicStreamState& state,
     const folly::Function<void(StreamId id, const folly::Range<PeekIterator>&)
@@ -97,6 +97,19 @@ uint64_t getLargestWriteOffsetSeen(const QuicStreamState& stream);
  */
 uint64_t getStreamNextOffsetToDeliver(const QuicStreamState& stream);
 
+/**
+ * Samples how long the app's writes that are now sent in full were buffered.
+ */
+void updateWriteLatencyOnNewDataWritten(
+    QuicStreamState& stream,
+    TimePoint sentTime);
+
+/**
+ * Samples how long it took for the app's writes that are now acked up to
+ * their end to be delivered.
+ */
+void updateWriteLatencyOnDelivery(QuicStreamState& stream, TimePoint ackTime);
+
 /**
  * Common functions for merging data into the read buffer for a Quic stream like
  * object. Callers should provide a connFlowControlVisitor which will be invoked
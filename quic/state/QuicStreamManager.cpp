@@ -8,6 +8,7 @@
 
 #include "quic/state/QuicStreamManager.h"
 
+#include <quic/logging/QuicLogger.h>
 #include <quic/state/QuicStreamUtilities.h>
 
 namespace quic {
@@ -39,7 +40,7 @@ static void updateHolBlockedTime(QuicStreamState& stream) {
     if (stream.lastHolbTime) {
       stream.totalHolbTime +=
           std::chrono::duration_cast<std::chrono::microseconds>(
-              Clock::now() - *stream.lastHolbTime);
+              coarseNow(stream.conn) - *stream.lastHolbTime);
       stream.lastHolbTime = folly::none;
     }
     return;
@@ -51,10 +52,17 @@ static void updateHolBlockedTime(QuicStreamState& stream) {
     return;
   }
   // If we were previously not HOL blocked, we are now.
-  stream.lastHolbTime = Clock::now();
+  stream.lastHolbTime = coarseNow(stream.conn);
   stream.holbCount++;
 }
 
+template <typename Container>
+static void releaseIfEmpty(Container& container) {
+  if (container.empty()) {
+    Container().swap(container);
+  }
+}
+
 static bool isStreamUnopened(
     StreamId streamId,
     StreamId nextAcceptableStreamId) {
@@ -65,7 +73,7 @@ static bool isStreamUnopened(
 // Returns false if the stream is closed or already opened.
 static LocalErrorCode openPeerStreamIfNotClosed(
     StreamId streamId,
-    folly::F14FastSet<StreamId>& openStreams,
+    StreamIdSet& openStreams,
     StreamId& nextAcceptableStreamId,
     StreamId maxStreamId,
     std::vector<StreamId>& newStreams) {
@@ -78,10 +86,9 @@ static LocalErrorCode openPeerStreamIfNotClosed(
 
   StreamId start = nextAcceptableStreamId;
   auto numNewStreams = (streamId - start) / detail::kStreamIncrement;
-  openStreams.reserve(openStreams.size() + numNewStreams);
+  openStreams.add(start, streamId);
   newStreams.reserve(newStreams.size() + numNewStreams);
   while (start <= streamId) {
-    openStreams.insert(start);
     newStreams.push_back(start);
     start += detail::kStreamIncrement;
   }
@@ -94,7 +101,7 @@ static LocalErrorCode openPeerStreamIfNotClosed(
 
 static LocalErrorCode openLocalStreamIfNotClosed(
     StreamId streamId,
-    folly::F14FastSet<StreamId>& openStreams,
+    StreamIdSet& openStreams,
     StreamId& nextAcceptableStreamId,
     StreamId maxStreamId) {
   if (streamId < nextAcceptableStreamId) {
@@ -104,13 +111,7 @@ static LocalErrorCode openLocalStreamIfNotClosed(
     return LocalErrorCode::STREAM_LIMIT_EXCEEDED;
   }
 
-  StreamId start = nextAcceptableStreamId;
-  auto numNewStreams = (streamId - start) / detail::kStreamIncrement;
-  openStreams.reserve(openStreams.size() + numNewStreams);
-  while (start <= streamId) {
-    openStreams.insert(start);
-    start += detail::kStreamIncrement;
-  }
+  openStreams.add(nextAcceptableStreamId, streamId);
 
   if (streamId >= nextAcceptableStreamId) {
     nextAcceptableStreamId = streamId + detail::kStreamIncrement;
@@ -121,15 +122,15 @@ static LocalErrorCode openLocalStreamIfNotClosed(
 bool QuicStreamManager::streamExists(StreamId streamId) {
   if (isLocalStream(nodeType_, streamId)) {
     if (isUnidirectionalStream(streamId)) {
-      return openUnidirectionalLocalStreams_.count(streamId) > 0;
+      return openUnidirectionalLocalStreams_.contains(streamId);
     } else {
-      return openBidirectionalLocalStreams_.count(streamId) > 0;
+      return openBidirectionalLocalStreams_.contains(streamId);
     }
   } else {
     if (isUnidirectionalStream(streamId)) {
-      return openUnidirectionalPeerStreams_.count(streamId) > 0;
+      return openUnidirectionalPeerStreams_.contains(streamId);
     } else {
-      return openBidirectionalPeerStreams_.count(streamId) > 0;
+      return openBidirectionalPeerStreams_.contains(streamId);
     }
   }
 }
@@ -139,7 +140,7 @@ QuicStreamState* QuicStreamManager::findStream(StreamId streamId) {
   if (lookup == streams_.end()) {
     return nullptr;
   } else {
-    return &lookup->second;
+    return lookup->second.get();
   }
 }
 
@@ -214,12 +215,52 @@ void QuicStreamManager::setMaxRemoteUnidirectionalStreamsInternal(
 void QuicStreamManager::refreshTransportSettings(
     const TransportSettings& settings) {
   transportSettings_ = &settings;
+  remoteBidirectionalStreamLimitWindow_ =
+      transportSettings_->advertisedInitialMaxStreamsBidi;
+  remoteUnidirectionalStreamLimitWindow_ =
+      transportSettings_->advertisedInitialMaxStreamsUni;
   setMaxRemoteBidirectionalStreamsInternal(
       transportSettings_->advertisedInitialMaxStreamsBidi, true);
   setMaxRemoteUnidirectionalStreamsInternal(
       transportSettings_->advertisedInitialMaxStreamsUni, true);
 }
 
+QuicStreamManager::StreamIdState QuicStreamManager::getStreamIdState() const {
+  StreamIdState state;
+  state.nextAcceptablePeerBidirectionalStreamId =
+      nextAcceptablePeerBidirectionalStreamId_;
+  state.nextAcceptablePeerUnidirectionalStreamId =
+      nextAcceptablePeerUnidirectionalStreamId_;
+  state.nextAcceptableLocalBidirectionalStreamId =
+      nextAcceptableLocalBidirectionalStreamId_;
+  state.nextAcceptableLocalUnidirectionalStreamId =
+      nextAcceptableLocalUnidirectionalStreamId_;
+  state.nextBidirectionalStreamId = nextBidirectionalStreamId_;
+  state.nextUnidirectionalStreamId = nextUnidirectionalStreamId_;
+  state.maxLocalBidirectionalStreamId = maxLocalBidirectionalStreamId_;
+  state.maxLocalUnidirectionalStreamId = maxLocalUnidirectionalStreamId_;
+  state.maxRemoteBidirectionalStreamId = maxRemoteBidirectionalStreamId_;
+  state.maxRemoteUnidirectionalStreamId = maxRemoteUnidirectionalStreamId_;
+  return state;
+}
+
+void QuicStreamManager::setStreamIdState(const StreamIdState& state) {
+  nextAcceptablePeerBidirectionalStreamId_ =
+      state.nextAcceptablePeerBidirectionalStreamId;
+  nextAcceptablePeerUnidirectionalStreamId_ =
+      state.nextAcceptablePeerUnidirectionalStreamId;
+  nextAcceptableLocalBidirectionalStreamId_ =
+      state.nextAcceptableLocalBidirectionalStreamId;
+  nextAcceptableLocalUnidirectionalStreamId_ =
+      state.nextAcceptableLocalUnidirectionalStreamId;
+  nextBidirectionalStreamId_ = state.nextBidirectionalStreamId;
+  nextUnidirectionalStreamId_ = state.nextUnidirectionalStreamId;
+  maxLocalBidirectionalStreamId_ = state.maxLocalBidirectionalStreamId;
+  maxLocalUnidirectionalStreamId_ = state.maxLocalUnidirectionalStreamId;
+  maxRemoteBidirectionalStreamId_ = state.maxRemoteBidirectionalStreamId;
+  maxRemoteUnidirectionalStreamId_ = state.maxRemoteUnidirectionalStreamId;
+}
+
 // We create local streams lazily. If a local stream was created
 // but not allocated yet, this will allocate a stream.
 // This will return nullptr if a stream is closed or un-opened.
@@ -228,15 +269,12 @@ QuicStreamManager::getOrCreateOpenedLocalStream(StreamId streamId) {
   auto& openLocalStreams = isUnidirectionalStream(streamId)
       ? openUnidirectionalLocalStreams_
       : openBidirectionalLocalStreams_;
-  auto streamItr = openLocalStreams.find(streamId);
-  if (streamItr != openLocalStreams.end()) {
+  if (openLocalStreams.contains(streamId)) {
     // Open a lazily created stream.
-    auto it = streams_.emplace(
-        std::piecewise_construct,
-        std::forward_as_tuple(streamId),
-        std::forward_as_tuple(streamId, conn_));
+    auto it = streams_.emplace(streamId, streamPool_.allocate(streamId, conn_));
     QUIC_STATS(conn_.infoCallback, onNewQuicStream);
-    return &it.first->second;
+    QUIC_PROBE(stream_open, conn_, streamId);
+    return it.first->second.get();
   }
   return nullptr;
 }
@@ -249,7 +287,7 @@ QuicStreamState* QuicStreamManager::getStream(StreamId streamId) {
   }
   auto it = streams_.find(streamId);
   if (it != streams_.end()) {
-    return &it->second;
+    return it->second.get();
   }
   auto stream = getOrCreateOpenedLocalStream(streamId);
   auto nextAcceptableStreamId = isUnidirectionalStream(streamId)
@@ -309,20 +347,17 @@ QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
 
   auto peerStream = streams_.find(streamId);
   if (peerStream != streams_.end()) {
-    return &peerStream->second;
+    return peerStream->second.get();
   }
   auto& openPeerStreams = isUnidirectionalStream(streamId)
       ? openUnidirectionalPeerStreams_
       : openBidirectionalPeerStreams_;
-  auto streamItr = openPeerStreams.find(streamId);
-  if (streamItr != openPeerStreams.end()) {
+  if (openPeerStreams.contains(streamId)) {
     // Stream was already open, create the state for it lazily.
-    auto it = streams_.emplace(
-        std::piecewise_construct,
-        std::forward_as_tuple(streamId),
-        std::forward_as_tuple(streamId, conn_));
+    auto it = streams_.emplace(streamId, streamPool_.allocate(streamId, conn_));
     QUIC_STATS(conn_.infoCallback, onNewQuicStream);
-    return &it.first->second;
+    QUIC_PROBE(stream_open, conn_, streamId);
+    return it.first->second.get();
   }
 
   auto& nextAcceptableStreamId = isUnidirectionalStream(streamId)
@@ -345,12 +380,10 @@ QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
         "Exceeded stream limit.", TransportErrorCode::STREAM_LIMIT_ERROR);
   }
 
-  auto it = streams_.emplace(
-      std::piecewise_construct,
-      std::forward_as_tuple(streamId),
-      std::forward_as_tuple(streamId, conn_));
+  auto it = streams_.emplace(streamId, streamPool_.allocate(streamId, conn_));
   QUIC_STATS(conn_.infoCallback, onNewQuicStream);
-  return &it.first->second;
+  QUIC_PROBE(stream_open, conn_, streamId);
+  return it.first->second.get();
 }
 
 folly::Expected<QuicStreamState*, LocalErrorCode>
@@ -387,13 +420,11 @@ QuicStreamManager::createStream(StreamId streamId) {
   if (openedResult != LocalErrorCode::NO_ERROR) {
     return folly::makeUnexpected(openedResult);
   }
-  auto it = streams_.emplace(
-      std::piecewise_construct,
-      std::forward_as_tuple(streamId),
-      std::forward_as_tuple(streamId, conn_));
+  auto it = streams_.emplace(streamId, streamPool_.allocate(streamId, conn_));
   QUIC_STATS(conn_.infoCallback, onNewQuicStream);
+  QUIC_PROBE(stream_open, conn_, streamId);
   updateAppIdleState();
-  return &it.first->second;
+  return it.first->second.get();
 }
 
 void QuicStreamManager::removeClosedStream(StreamId streamId) {
@@ -403,42 +434,47 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
     return;
   }
   VLOG(10) << "Removing closed stream=" << streamId;
-  DCHECK(it->second.inTerminalStates());
+  DCHECK(it->second->inTerminalStates());
   readableStreams_.erase(streamId);
   peekableStreams_.erase(streamId);
   writableStreams_.erase(streamId);
   writableControlStreams_.erase(streamId);
+  replaySafeOnlyStreams_.erase(streamId);
   blockedStreams_.erase(streamId);
   deliverableStreams_.erase(streamId);
   windowUpdates_.erase(streamId);
+  urgentWindowUpdates_.erase(streamId);
   lossStreams_.erase(streamId);
   stopSendingStreams_.erase(streamId);
-  if (it->second.isControl) {
+  if (it->second->isControl) {
     DCHECK_GT(numControlStreams_, 0);
     numControlStreams_--;
   }
   streams_.erase(it);
   QUIC_STATS(conn_.infoCallback, onQuicStreamClosed);
+  QUIC_PROBE(stream_close, conn_, streamId);
   if (isRemoteStream(nodeType_, streamId)) {
     auto& openPeerStreams = isUnidirectionalStream(streamId)
         ? openUnidirectionalPeerStreams_
         : openBidirectionalPeerStreams_;
-    openPeerStreams.erase(streamId);
+    openPeerStreams.remove(streamId);
     // Check if we should send a stream limit update. We need to send an
     // update every time we've closed a number of streams >= the set windowing
     // fraction.
-    uint64_t initialStreamLimit = isUnidirectionalStream(streamId)
-        ? transportSettings_->advertisedInitialMaxStreamsUni
-        : transportSettings_->advertisedInitialMaxStreamsBidi;
-    uint64_t streamWindow = initialStreamLimit / streamLimitWindowingFraction_;
+    uint64_t streamLimitWindow = isUnidirectionalStream(streamId)
+        ? remoteUnidirectionalStreamLimitWindow_
+        : remoteBidirectionalStreamLimitWindow_;
+    uint64_t streamWindow = streamLimitWindow / streamLimitWindowingFraction_;
     uint64_t openableRemoteStreams = isUnidirectionalStream(streamId)
         ? openableRemoteUnidirectionalStreams()
         : openableRemoteBidirectionalStreams();
     // The "credit" here is how much available stream space we have based on
-    // what the initial stream limit was set to.
+    // what the stream limit window is.
     uint64_t streamCredit =
-        initialStreamLimit - openableRemoteStreams - openPeerStreams.size();
+        streamLimitWindow - openableRemoteStreams - openPeerStreams.size();
     if (streamCredit >= streamWindow) {
+      streamCredit +=
+          growRemoteStreamLimitWindow(isUnidirectionalStream(streamId));
       if (isUnidirectionalStream(streamId)) {
         uint64_t maxStreams = (maxRemoteUnidirectionalStreamId_ -
                                initialRemoteUnidirectionalStreamId_) /
@@ -457,11 +493,34 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
     auto& openLocalStreams = isUnidirectionalStream(streamId)
         ? openUnidirectionalLocalStreams_
         : openBidirectionalLocalStreams_;
-    openLocalStreams.erase(streamId);
+    openLocalStreams.remove(streamId);
   }
   updateAppIdleState();
 }
 
+uint64_t QuicStreamManager::growRemoteStreamLimitWindow(bool unidirectional) {
+  auto& window = unidirectional ? remoteUnidirectionalStreamLimitWindow_
+                                : remoteBidirectionalStreamLimitWindow_;
+  auto& lastUpdateTime = unidirectional
+      ? lastRemoteUnidirectionalStreamLimitUpdateTime_
+      : lastRemoteBidirectionalStreamLimitUpdateTime_;
+  auto now = Clock::now();
+  auto srtt = conn_.lossState.srtt;
+  uint64_t growth = 0;
+  if (transportSettings_->autoTuneStreamLimits && lastUpdateTime &&
+      srtt != std::chrono::microseconds::zero() &&
+      now - *lastUpdateTime <
+          transportSettings_->flowControlRttFrequency * srtt) {
+    auto newWindow = std::max(
+        window,
+        std::min(window * 2, transportSettings_->maxAutoTunedStreamLimit));
+    growth = newWindow - window;
+    window = newWindow;
+  }
+  lastUpdateTime = now;
+  return growth;
+}
+
 void QuicStreamManager::updateLossStreams(QuicStreamState& stream) {
   auto it = lossStreams_.find(stream.id);
   if (!stream.lossBuffer.empty()) {
@@ -475,49 +534,101 @@ void QuicStreamManager::updateLossStreams(QuicStreamState& stream) {
 
 void QuicStreamManager::updateReadableStreams(QuicStreamState& stream) {
   updateHolBlockedTime(stream);
-  auto itr = readableStreams_.find(stream.id);
-  if (!stream.hasReadableData() && !stream.streamReadError.has_value()) {
-    if (itr != readableStreams_.end()) {
-      VLOG(10) << __func__ << " remove stream=" << stream.id << " "
-               << stream.conn;
-      readableStreams_.erase(itr);
-    }
+  bool readable =
+      stream.hasReadableData() || stream.streamReadError.has_value();
+  if (readable == stream.inReadableStreams) {
     return;
   }
-  if (itr == readableStreams_.end()) {
+  if (readable) {
     VLOG(10) << __func__ << " add stream=" << stream.id << " " << stream.conn;
     readableStreams_.insert(stream.id);
   } else {
-    VLOG(10) << __func__ << " exists stream=" << stream.id << " "
+    VLOG(10) << __func__ << " remove stream=" << stream.id << " "
              << stream.conn;
+    readableStreams_.erase(stream.id);
   }
+  stream.inReadableStreams = readable;
 }
 
 void QuicStreamManager::updateWritableStreams(QuicStreamState& stream) {
   if (stream.hasWritableData() && !stream.streamWriteError.has_value()) {
+    if (stream.replaySafeOnly && !stream.conn.oneRttWriteCipher) {
+      VLOG(10) << __func__ << " hold stream=" << stream.id << " "
+               << stream.conn;
+      replaySafeOnlyStreams_.insert(stream.id);
+      stream.conn.streamManager->removeWritable(stream);
+      return;
+    }
     stream.conn.streamManager->addWritable(stream);
   } else {
     stream.conn.streamManager->removeWritable(stream);
   }
+  replaySafeOnlyStreams_.erase(stream.id);
 }
 
-void QuicStreamManager::updatePeekableStreams(QuicStreamState& stream) {
-  auto itr = peekableStreams_.find(stream.id);
-  if (!stream.hasPeekableData() || stream.streamReadError.has_value()) {
-    if (itr != peekableStreams_.end()) {
-      VLOG(10) << __func__ << " remove stream=" << stream.id << " "
-               << stream.conn;
-      peekableStreams_.erase(itr);
+void QuicStreamManager::onReplaySafe() {
+  folly::F14FastSet<StreamId> replaySafeOnlyStreams;
+  std::swap(replaySafeOnlyStreams, replaySafeOnlyStreams_);
+  for (auto streamId : replaySafeOnlyStreams) {
+    auto it = streams_.find(streamId);
+    if (it != streams_.end()) {
+      updateWritableStreams(*it->second);
     }
+  }
+}
+
+void QuicStreamManager::updatePeekableStreams(QuicStreamState& stream) {
+  bool peekable =
+      stream.hasPeekableData() && !stream.streamReadError.has_value();
+  if (peekable == stream.inPeekableStreams) {
     return;
   }
-  if (itr == peekableStreams_.end()) {
+  if (peekable) {
     VLOG(10) << __func__ << " add stream=" << stream.id << " " << stream.conn;
     peekableStreams_.insert(stream.id);
   } else {
-    VLOG(10) << __func__ << " exists stream=" << stream.id << " "
+    VLOG(10) << __func__ << " remove stream=" << stream.id << " "
              << stream.conn;
+    peekableStreams_.erase(stream.id);
   }
+  stream.inPeekableStreams = peekable;
+}
+
+void QuicStreamManager::removeReadable(StreamId streamId) {
+  readableStreams_.erase(streamId);
+  auto it = streams_.find(streamId);
+  if (it != streams_.end()) {
+    it->second->inReadableStreams = false;
+  }
+}
+
+void QuicStreamManager::removePeekable(StreamId streamId) {
+  peekableStreams_.erase(streamId);
+  auto it = streams_.find(streamId);
+  if (it != streams_.end()) {
+    it->second->inPeekableStreams = false;
+  }
+}
+
+void QuicStreamManager::clearActionable() {
+  // The streams may already be gone if they were cleared first.
+  for (auto streamId : readableStreams_) {
+    auto it = streams_.find(streamId);
+    if (it != streams_.end()) {
+      it->second->inReadableStreams = false;
+    }
+  }
+  for (auto streamId : peekableStreams_) {
+    auto it = streams_.find(streamId);
+    if (it != streams_.end()) {
+      it->second->inPeekableStreams = false;
+    }
+  }
+  deliverableStreams_.clear();
+  readableStreams_.clear();
+  peekableStreams_.clear();
+  dataExpiredStreams_.clear();
+  dataRejectedStreams_.clear();
 }
 
 void QuicStreamManager::updateAppIdleState() {
@@ -531,7 +642,7 @@ void QuicStreamManager::updateAppIdleState() {
   }
   isAppIdle_ = !currentNonCtrlStreams;
   if (conn_.congestionController) {
-    conn_.congestionController->setAppIdle(isAppIdle_, Clock::now());
+    conn_.congestionController->setAppIdle(isAppIdle_, coarseNow(conn_));
   }
 }
 
@@ -543,6 +654,36 @@ void QuicStreamManager::setStreamAsControl(QuicStreamState& stream) {
   updateAppIdleState();
 }
 
+void QuicStreamManager::setStreamPriority(
+    QuicStreamState& stream,
+    Priority priority) {
+  stream.priority = priority;
+  writableStreams_.updateIfExist(stream.id, priority);
+}
+
+void QuicStreamManager::releaseMemoryIfNoStreams() {
+  if (!streams_.empty()) {
+    return;
+  }
+  releaseIfEmpty(streams_);
+  releaseIfEmpty(newPeerStreams_);
+  releaseIfEmpty(blockedStreams_);
+  releaseIfEmpty(stopSendingStreams_);
+  releaseIfEmpty(dataExpiredStreams_);
+  releaseIfEmpty(dataRejectedStreams_);
+  releaseIfEmpty(windowUpdates_);
+  releaseIfEmpty(urgentWindowUpdates_);
+  releaseIfEmpty(flowControlUpdated_);
+  releaseIfEmpty(lossStreams_);
+  releaseIfEmpty(readableStreams_);
+  releaseIfEmpty(peekableStreams_);
+  releaseIfEmpty(deliverableStreams_);
+  releaseIfEmpty(closedStreams_);
+  writableStreams_.shrinkToFit();
+  writableControlStreams_.shrinkToFit();
+  streamPool_.releaseSlabs();
+}
+
 bool QuicStreamManager::isAppIdle() const {
   return isAppIdle_;
 }
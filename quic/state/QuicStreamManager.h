@@ -12,10 +12,13 @@
 #include <folly/container/F14Set.h>
 #include <quic/QuicConstants.h>
 #include <quic/codec/Types.h>
+#include <quic/common/IntervalSet.h>
+#include <quic/state/QuicPriorityQueue.h>
+#include <quic/state/QuicStreamPool.h>
 #include <quic/state/StreamData.h>
 #include <quic/state/TransportSettings.h>
+#include <algorithm>
 #include <numeric>
-#include <set>
 
 namespace quic {
 namespace detail {
@@ -23,6 +26,58 @@ namespace detail {
 constexpr uint8_t kStreamIncrement = 0x04;
 }
 
+/**
+ * Set of stream ids of a single stream type, kept as ranges of consecutive
+ * ids. Streams of a type are opened in id order and opening one implicitly
+ * opens all the lower ones, so the open streams stay a handful of ranges
+ * however many of them there are.
+ */
+class StreamIdSet {
+ public:
+  /**
+   * Adds the ids from first to last, none of which may be in the set.
+   */
+  void add(StreamId first, StreamId last) {
+    DCHECK(!contains(first) && !contains(last));
+    ids_.insert(first, last);
+    size_ += (last - first) / detail::kStreamIncrement + 1;
+  }
+
+  void remove(StreamId id) {
+    if (contains(id)) {
+      ids_.withdraw(Interval<StreamId, detail::kStreamIncrement>(id, id));
+      --size_;
+    }
+  }
+
+  bool contains(StreamId id) const {
+    // Intervals are sorted, the last one starting at or below id is the only
+    // one that can hold it.
+    auto it = std::upper_bound(
+        ids_.cbegin(), ids_.cend(), id, [](StreamId id, const auto& interval) {
+          return id < interval.start;
+        });
+    return it != ids_.cbegin() && id <= std::prev(it)->end;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  void clear() {
+    ids_.clear();
+    size_ = 0;
+  }
+
+ private:
+  IntervalSet<StreamId, detail::kStreamIncrement> ids_;
+  size_t size_{0};
+};
+
 class QuicStreamManager {
  public:
   explicit QuicStreamManager(
@@ -105,6 +160,20 @@ class QuicStreamManager {
    */
   void updateWritableStreams(QuicStreamState& stream);
 
+  /*
+   * Makes the streams held back for not being replay safe writable again, to
+   * be called once the 1-RTT write cipher is installed.
+   */
+  void onReplaySafe();
+
+  /*
+   * Returns the number of streams whose data is held back until the
+   * connection is replay safe.
+   */
+  size_t numReplaySafeOnlyStreams() const {
+    return replaySafeOnlyStreams_.size();
+  }
+
   /*
    * Update the current loss streams for the given stream state. This will
    * either add or remove it from the collection of streams with outstanding
@@ -179,7 +248,7 @@ class QuicStreamManager {
    */
   void streamStateForEach(const std::function<void(QuicStreamState&)>& f) {
     for (auto& s : streams_) {
-      f(s.second);
+      f(*s.second);
     }
   }
 
@@ -195,21 +264,19 @@ class QuicStreamManager {
     return !lossStreams_.empty();
   }
 
-  // TODO figure out a better interface here.
   /*
-   * Returns a mutable reference to the container holding the writable stream
-   * IDs.
+   * Returns a mutable reference to the priority queue holding the writable
+   * stream IDs.
    */
-  auto& writableStreams() {
+  PriorityQueue& writableStreams() {
     return writableStreams_;
   }
 
-  // TODO figure out a better interface here.
   /*
-   * Returns a mutable reference to the container holding the writable stream
-   * IDs.
+   * Returns a mutable reference to the queue holding the writable control
+   * stream IDs, which all share the default priority.
    */
-  auto& writableControlStreams() {
+  PriorityQueue& writableControlStreams() {
     return writableControlStreams_;
   }
 
@@ -233,9 +300,9 @@ class QuicStreamManager {
    */
   void addWritable(const QuicStreamState& stream) {
     if (stream.isControl) {
-      writableControlStreams_.insert(stream.id);
+      writableControlStreams_.insertOrUpdate(stream.id, kDefaultPriority);
     } else {
-      writableStreams_.insert(stream.id);
+      writableStreams_.insertOrUpdate(stream.id, stream.priority);
     }
   }
 
@@ -256,6 +323,7 @@ class QuicStreamManager {
   void clearWritable() {
     writableStreams_.clear();
     writableControlStreams_.clear();
+    replaySafeOnlyStreams_.clear();
   }
 
   /*
@@ -314,6 +382,29 @@ class QuicStreamManager {
 
   void refreshTransportSettings(const TransportSettings& settings);
 
+  /*
+   * The stream id counters of the connection, the next ids that can be
+   * opened and the limits on them. Copied over to pick up a connection with
+   * no open streams elsewhere, setting them replaces what the transport
+   * settings and the peer's transport parameters set.
+   */
+  struct StreamIdState {
+    StreamId nextAcceptablePeerBidirectionalStreamId{0};
+    StreamId nextAcceptablePeerUnidirectionalStreamId{0};
+    StreamId nextAcceptableLocalBidirectionalStreamId{0};
+    StreamId nextAcceptableLocalUnidirectionalStreamId{0};
+    StreamId nextBidirectionalStreamId{0};
+    StreamId nextUnidirectionalStreamId{0};
+    StreamId maxLocalBidirectionalStreamId{0};
+    StreamId maxLocalUnidirectionalStreamId{0};
+    StreamId maxRemoteBidirectionalStreamId{0};
+    StreamId maxRemoteUnidirectionalStreamId{0};
+  };
+
+  StreamIdState getStreamIdState() const;
+
+  void setStreamIdState(const StreamIdState& state);
+
   /*
    * Sets the "window-by" fraction for sending stream limit updates. E.g.
    * setting the fraction to two when the initial stream limit was 100 will
@@ -326,6 +417,15 @@ class QuicStreamManager {
     }
   }
 
+  /*
+   * The stream limit window of the peer's streams of the given direction,
+   * see remoteBidirectionalStreamLimitWindow_.
+   */
+  uint64_t remoteStreamLimitWindow(bool unidirectional) const {
+    return unidirectional ? remoteUnidirectionalStreamLimitWindow_
+                          : remoteBidirectionalStreamLimitWindow_;
+  }
+
   /*
    * The next value that should be sent in a bidirectional max streams frame,
    * if any. This is potentially updated every time a bidirectional stream is
@@ -364,10 +464,23 @@ class QuicStreamManager {
   }
 
   /*
-   * Queue a pending window update for the given stream id.
+   * Returns a const reference to the ids of the streams with a pending window
+   * update that needs to go out right away.
    */
-  void queueWindowUpdate(StreamId streamId) {
+  const auto& urgentWindowUpdates() const {
+    return urgentWindowUpdates_;
+  }
+
+  /*
+   * Queue a pending window update for the given stream id. An update that
+   * isn't urgent doesn't need a packet of its own, it goes out with the next
+   * packet written for anything else, e.g. acks.
+   */
+  void queueWindowUpdate(StreamId streamId, bool urgent = true) {
     windowUpdates_.emplace(streamId);
+    if (urgent) {
+      urgentWindowUpdates_.emplace(streamId);
+    }
   }
 
   /*
@@ -375,6 +488,7 @@ class QuicStreamManager {
    */
   void removeWindowUpdate(StreamId streamId) {
     windowUpdates_.erase(streamId);
+    urgentWindowUpdates_.erase(streamId);
   }
 
   /*
@@ -384,6 +498,14 @@ class QuicStreamManager {
     return !windowUpdates_.empty();
   }
 
+  /*
+   * Returns whether any stream has a pending window update that needs to go
+   * out right away.
+   */
+  bool hasUrgentWindowUpdates() const {
+    return !urgentWindowUpdates_.empty();
+  }
+
   // TODO figure out a better interface here.
   /*
    * Return a mutable reference to the underlying closed streams container.
@@ -491,22 +613,30 @@ class QuicStreamManager {
     dataExpiredStreams_.clear();
   }
 
-  // TODO figure out a better interface here.
   /*
-   * Returns a mutable reference to the underlying readable streams container.
+   * Returns the streams which have data to read or a read error.
    */
-  auto& readableStreams() {
+  const auto& readableStreams() const {
     return readableStreams_;
   }
 
-  // TODO figure out a better interface here.
   /*
-   * Returns a mutable reference to the underlying peekable streams container.
+   * Returns the streams which have data to peek at.
    */
-  auto& peekableStreams() {
+  const auto& peekableStreams() const {
     return peekableStreams_;
   }
 
+  /*
+   * Stops tracking the stream as readable until its next update.
+   */
+  void removeReadable(StreamId streamId);
+
+  /*
+   * Stops tracking the stream as peekable until its next update.
+   */
+  void removePeekable(StreamId streamId);
+
   /*
    * Returns a mutable reference to the underlying container of streams which
    * had their flow control updated.
@@ -643,16 +773,22 @@ class QuicStreamManager {
    */
   void setStreamAsControl(QuicStreamState& stream);
 
+  /*
+   * Sets the priority of a stream, moving it in the writable streams if it
+   * has data to write.
+   */
+  void setStreamPriority(QuicStreamState& stream, Priority priority);
+
   /*
    * Clear the tracking of streams which can trigger API callbacks.
    */
-  void clearActionable() {
-    deliverableStreams_.clear();
-    readableStreams_.clear();
-    peekableStreams_.clear();
-    dataExpiredStreams_.clear();
-    dataRejectedStreams_.clear();
-  }
+  void clearActionable();
+
+  /*
+   * Frees the memory of the stream states and of the containers tracking
+   * them, if there are no streams. It grows back with new streams.
+   */
+  void releaseMemoryIfNoStreams();
 
   bool isAppIdle() const;
 
@@ -677,6 +813,12 @@ class QuicStreamManager {
       uint64_t maxStreams,
       bool force);
 
+  // Doubles the stream limit window of the direction, up to
+  // maxAutoTunedStreamLimit, if the last update was made less than
+  // flowControlRttFrequency * srtt ago, i.e. the peer goes through the
+  // window faster than the updates can reach it. Returns by how much it grew.
+  uint64_t growRemoteStreamLimitWindow(bool unidirectional);
+
   QuicConnectionStateBase& conn_;
   QuicNodeType nodeType_;
 
@@ -722,6 +864,15 @@ class QuicStreamManager {
   // send stream limit updates
   uint64_t streamLimitWindowingFraction_{2};
 
+  // The number of streams of each direction the peer can open beyond those
+  // it closed: the initial limit, unless autoTuneStreamLimits grew it.
+  uint64_t remoteBidirectionalStreamLimitWindow_{0};
+  uint64_t remoteUnidirectionalStreamLimitWindow_{0};
+
+  // When the last stream limit update of each direction was made.
+  folly::Optional<TimePoint> lastRemoteBidirectionalStreamLimitUpdateTime_;
+  folly::Optional<TimePoint> lastRemoteUnidirectionalStreamLimitUpdateTime_;
+
   // Contains the value of a stream window update that should be sent for
   // remote bidirectional streams.
   folly::Optional<uint64_t> remoteBidirectionalStreamLimitUpdate_;
@@ -733,19 +884,22 @@ class QuicStreamManager {
   uint64_t numControlStreams_{0};
 
   // Bidirectional streams that are opened by the peer on the connection.
-  folly::F14FastSet<StreamId> openBidirectionalPeerStreams_;
+  StreamIdSet openBidirectionalPeerStreams_;
 
   // Unidirectional streams that are opened by the peer on the connection.
-  folly::F14FastSet<StreamId> openUnidirectionalPeerStreams_;
+  StreamIdSet openUnidirectionalPeerStreams_;
 
   // Bidirectional streams that are opened locally on the connection.
-  folly::F14FastSet<StreamId> openBidirectionalLocalStreams_;
+  StreamIdSet openBidirectionalLocalStreams_;
 
   // Unidirectional streams that are opened locally on the connection.
-  folly::F14FastSet<StreamId> openUnidirectionalLocalStreams_;
+  StreamIdSet openUnidirectionalLocalStreams_;
+
+  // Storage of the streams, it has to outlive streams_.
+  QuicStreamPool streamPool_;
 
   // A map of streams that are active.
-  folly::F14FastMap<StreamId, QuicStreamState> streams_;
+  folly::F14FastMap<StreamId, QuicStreamPool::StreamPtr> streams_;
 
   // Recently opened peer streams.
   std::vector<StreamId> newPeerStreams_;
@@ -766,6 +920,9 @@ class QuicStreamManager {
   // update sent
   folly::F14FastSet<StreamId> windowUpdates_;
 
+  // Set of streams in windowUpdates_ whose update needs to go out right away
+  folly::F14FastSet<StreamId> urgentWindowUpdates_;
+
   // Streams that had their flow control updated
   folly::F14FastSet<StreamId> flowControlUpdated_;
 
@@ -778,11 +935,15 @@ class QuicStreamManager {
   // Set of streams that have pending peeks
   folly::F14FastSet<StreamId> peekableStreams_;
 
-  // Set of !control streams that have writable data
-  std::set<StreamId> writableStreams_;
+  // Queue of !control streams that have writable data
+  PriorityQueue writableStreams_;
+
+  // Queue of control streams that have writable data
+  PriorityQueue writableControlStreams_;
 
-  // Set of control streams that have writable data
-  std::set<StreamId> writableControlStreams_;
+  // Streams with writable data that may not go out before the connection is
+  // replay safe
+  folly::F14FastSet<StreamId> replaySafeOnlyStreams_;
 
   // Streams that may be able to callback DeliveryCallback
   folly::F14FastSet<StreamId> deliverableStreams_;
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StreamData.h>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace quic {
+
+constexpr size_t kDefaultStreamsPerSlab = 16;
+
+/**
+ * Per connection storage for stream states. Streams are built in slots carved
+ * out of fixed size slabs and keep their address for as long as they live.
+ * The slots of closed streams go on a freelist and are reused before a new
+ * slab is allocated, so a connection that churns through short lived streams
+ * only allocates for its peak number of concurrent streams. Slabs are freed
+ * with the pool, or by releaseSlabs() once no stream lives in them.
+ */
+class QuicStreamPool {
+ public:
+  struct Deleter {
+    QuicStreamPool* pool{nullptr};
+
+    void operator()(QuicStreamState* stream) const {
+      pool->release(stream);
+    }
+  };
+
+  using StreamPtr = std::unique_ptr<QuicStreamState, Deleter>;
+
+  explicit QuicStreamPool(size_t streamsPerSlab = kDefaultStreamsPerSlab)
+      : streamsPerSlab_(std::max<size_t>(streamsPerSlab, 1)) {}
+
+  // The handed out streams point back at the pool.
+  QuicStreamPool(const QuicStreamPool&) = delete;
+  QuicStreamPool& operator=(const QuicStreamPool&) = delete;
+
+  StreamPtr allocate(StreamId id, QuicConnectionStateBase& conn) {
+    Slot* slot = takeSlot();
+    QuicStreamState* stream;
+    try {
+      stream = new (slot) QuicStreamState(id, conn);
+    } catch (...) {
+      freeSlots_.push_back(slot);
+      throw;
+    }
+    return StreamPtr(stream, Deleter{this});
+  }
+
+  /**
+   * Number of streams the pool can hold without allocating.
+   */
+  size_t capacity() const {
+    return slabs_.size() * streamsPerSlab_;
+  }
+
+  size_t numFreeSlots() const {
+    return freeSlots_.size() + (capacity() - usedInSlabs());
+  }
+
+  /**
+   * Frees the slabs if none of their streams is alive, e.g. while the
+   * connection is idle. Returns whether it did.
+   */
+  bool releaseSlabs() {
+    if (freeSlots_.size() != usedInSlabs()) {
+      return false;
+    }
+    std::vector<std::unique_ptr<Slot[]>>().swap(slabs_);
+    std::vector<Slot*>().swap(freeSlots_);
+    nextInSlab_ = 0;
+    return true;
+  }
+
+ private:
+  using Slot = std::aligned_storage<
+      sizeof(QuicStreamState),
+      alignof(QuicStreamState)>::type;
+
+  Slot* takeSlot() {
+    if (!freeSlots_.empty()) {
+      Slot* slot = freeSlots_.back();
+      freeSlots_.pop_back();
+      return slot;
+    }
+    if (slabs_.empty() || nextInSlab_ == streamsPerSlab_) {
+      slabs_.emplace_back(new Slot[streamsPerSlab_]);
+      nextInSlab_ = 0;
+    }
+    return &slabs_.back()[nextInSlab_++];
+  }
+
+  void release(QuicStreamState* stream) {
+    stream->~QuicStreamState();
+    freeSlots_.push_back(reinterpret_cast<Slot*>(stream));
+  }
+
+  size_t usedInSlabs() const {
+    return slabs_.empty() ? 0
+                          : (slabs_.size() - 1) * streamsPerSlab_ + nextInSlab_;
+  }
+
+  size_t streamsPerSlab_;
+  std::vector<std::unique_ptr<Slot[]>> slabs_;
+  // Slots of the last slab that were never handed out start here.
+  size_t nextInSlab_{0};
+  std::vector<Slot*> freeSlots_;
+};
+
+} // namespace quic
@@ -11,6 +11,8 @@
 #include <folly/Optional.h>
 #include <folly/functional/Invoke.h>
 #include <folly/io/async/EventBase.h>
+#include <quic/common/BufUtil.h>
+#include <quic/state/QuicTransportStatsCounters.h>
 #include <string>
 
 namespace quic {
@@ -39,6 +41,9 @@ class QuicTransportStatsCallback {
     WORKER_NOT_INITIALIZED,
     SERVER_SHUTDOWN,
     INITIAL_CONNID_SMALL,
+    ACCEPT_QUEUE_FULL,
+    INVALID_RETRY_TOKEN,
+    VERSION_NEGOTIATION_RATE_LIMITED,
     // NOTE: MAX should always be at the end
     MAX
   };
@@ -61,6 +66,47 @@ class QuicTransportStatsCallback {
     MAX
   };
 
+  enum class WriteFlushReason : uint8_t {
+    // the next packet is larger than the GSO segments of the batch
+    SIZE_CHANGE,
+    // the writer takes no more packets, or a GSO batch got its last segment
+    WRITER_FULL,
+    // the write loop of the connection ran out of packets
+    END_OF_WRITE,
+    // the shared writer of a worker flushed at the end of the loop
+    END_OF_LOOP,
+    // NOTE: MAX should always be at the end
+    MAX
+  };
+
+  // The packets a paced connection sent over an interval, against the ones
+  // its pacing rate allowed
+  enum class PacingRateError : uint8_t {
+    // less than half of them
+    FAR_BELOW,
+    // 10% to 50% fewer
+    BELOW,
+    // within 10% of them
+    ON_RATE,
+    // 10% to 50% more
+    ABOVE,
+    // more than 1.5 times as many
+    FAR_ABOVE,
+    // NOTE: MAX should always be at the end
+    MAX
+  };
+
+  enum class PTOProbeType : uint8_t {
+    // new stream data was waiting to be sent, the probes carry it
+    NEW_DATA,
+    // the probes clone the outstanding packets
+    CLONE,
+    // an idle tail, a single PING probes it
+    PING,
+    // NOTE: MAX should always be at the end
+    MAX
+  };
+
   virtual ~QuicTransportStatsCallback() = default;
 
   // packet level metrics
@@ -106,6 +152,8 @@ class QuicTransportStatsCallback {
 
   virtual void onStatelessReset() = 0;
 
+  virtual void onRetrySent() = 0;
+
   virtual void onStreamFlowControlUpdate() = 0;
 
   virtual void onStreamFlowControlBlocked() = 0;
@@ -115,6 +163,12 @@ class QuicTransportStatsCallback {
   // retransmission timeout counter
   virtual void onPTO() = 0;
 
+  // what the probes of a PTO were chosen to carry
+  virtual void onPTOProbe(PTOProbeType type) = 0;
+
+  // the first ack after a PTO acked a packet sent before it
+  virtual void onSpuriousPTO() = 0;
+
   // metrics to track bytes read from / written to wire
   virtual void onRead(size_t bufSize) = 0;
 
@@ -122,6 +176,45 @@ class QuicTransportStatsCallback {
 
   virtual void onUDPSocketWriteError(SocketErrorType errorType) = 0;
 
+  // number of packets handed to the socket in one write
+  virtual void onWriteBatch(size_t numPackets) = 0;
+
+  /**
+   * One syscall writing a batch: the messages it sent and the packets and
+   * bytes in them. The packets past one per message were GSO segments.
+   */
+  virtual void
+  onWriteSyscall(size_t numMessages, size_t numPackets, size_t bytes) = 0;
+
+  // why a batch was written
+  virtual void onWriteFlush(WriteFlushReason reason) = 0;
+
+  // a packet declared lost was acked later
+  virtual void onSpuriousLoss() = 0;
+
+  /**
+   * With the worker's stats counters on, the events they count are not
+   * reported one by one but as what was counted since the last call, every
+   * TransportSettings::statsCountersInterval.
+   */
+  virtual void onStatsCounters(
+      const QuicTransportStatsCounters::Snapshot& /* delta */) {}
+
+  /**
+   * The sizing and usage of the worker's packet buffer pool, reported along
+   * with the stats counters.
+   */
+  virtual void onPacketBufferPool(const PacketBufferPool::Stats& /* stats */) {}
+
+  /**
+   * How far the send rate of a sampled paced connection was off its pacing
+   * rate over an interval, and the largest burst of packets it sent in it,
+   * see PacingAccuracyObserver.
+   */
+  virtual void onPacingInterval(
+      PacingRateError /* error */,
+      uint64_t /* largestBurst */) {}
+
   static const char* toString(ConnectionCloseReason reason) {
     switch (reason) {
       case ConnectionCloseReason::NONE:
@@ -165,6 +258,12 @@ class QuicTransportStatsCallback {
         return "SERVER_SHUTDOWN";
       case PacketDropReason::INITIAL_CONNID_SMALL:
         return "INITIAL_CONNID_SMALL";
+      case PacketDropReason::ACCEPT_QUEUE_FULL:
+        return "ACCEPT_QUEUE_FULL";
+      case PacketDropReason::INVALID_RETRY_TOKEN:
+        return "INVALID_RETRY_TOKEN";
+      case PacketDropReason::VERSION_NEGOTIATION_RATE_LIMITED:
+        return "VERSION_NEGOTIATION_RATE_LIMITED";
       case PacketDropReason::MAX:
         return "MAX";
       default:
@@ -191,6 +290,57 @@ class QuicTransportStatsCallback {
     }
   }
 
+  static const char* toString(WriteFlushReason reason) {
+    switch (reason) {
+      case WriteFlushReason::SIZE_CHANGE:
+        return "SIZE_CHANGE";
+      case WriteFlushReason::WRITER_FULL:
+        return "WRITER_FULL";
+      case WriteFlushReason::END_OF_WRITE:
+        return "END_OF_WRITE";
+      case WriteFlushReason::END_OF_LOOP:
+        return "END_OF_LOOP";
+      case WriteFlushReason::MAX:
+        return "MAX";
+      default:
+        throw std::runtime_error("Undefined WriteFlushReason passed");
+    }
+  }
+
+  static const char* toString(PacingRateError error) {
+    switch (error) {
+      case PacingRateError::FAR_BELOW:
+        return "FAR_BELOW";
+      case PacingRateError::BELOW:
+        return "BELOW";
+      case PacingRateError::ON_RATE:
+        return "ON_RATE";
+      case PacingRateError::ABOVE:
+        return "ABOVE";
+      case PacingRateError::FAR_ABOVE:
+        return "FAR_ABOVE";
+      case PacingRateError::MAX:
+        return "MAX";
+      default:
+        throw std::runtime_error("Undefined PacingRateError passed");
+    }
+  }
+
+  static const char* toString(PTOProbeType type) {
+    switch (type) {
+      case PTOProbeType::NEW_DATA:
+        return "NEW_DATA";
+      case PTOProbeType::CLONE:
+        return "CLONE";
+      case PTOProbeType::PING:
+        return "PING";
+      case PTOProbeType::MAX:
+        return "MAX";
+      default:
+        throw std::runtime_error("Undefined PTOProbeType passed");
+    }
+  }
+
   static SocketErrorType errnoToSocketErrorType(int err) {
     switch (err) {
       case EAGAIN:
@@ -231,6 +381,17 @@ class QuicTransportStatsCallbackFactory {
         &QuicTransportStatsCallback::method, infoCallback, ##__VA_ARGS__); \
   }
 
+// Bumps the counter if there are stats counters, makes the callback's call
+// for the event otherwise.
+#define QUIC_STATS_COUNTER(                                          \
+    statsCounters, counter, amount, infoCallback, method, ...)       \
+  if (statsCounters) {                                               \
+    (statsCounters)                                                  \
+        ->add(QuicTransportStatsCounters::Counter::counter, amount); \
+  } else {                                                           \
+    QUIC_STATS(infoCallback, method, ##__VA_ARGS__)                  \
+  }
+
 #define QUIC_STATS_FOR_EACH(iterBegin, iterEnd, infoCallback, method, ...)   \
   if (infoCallback) {                                                        \
     std::for_each(iterBegin, iterEnd, [&](const auto&) {                     \
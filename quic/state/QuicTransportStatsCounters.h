@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/common/EnumArray.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * Counters of the per packet events of QuicTransportStatsCallback, which
+ * the transports of a server worker bump directly instead of making a
+ * virtual call for each event. The worker's evb is the only writer, so a
+ * bump is a relaxed load and store instead of an atomic increment, and any
+ * thread can take a snapshot. The worker keeps them cache line padded, off
+ * the cache lines of the other threads.
+ */
+class QuicTransportStatsCounters {
+ public:
+  enum class Counter : uint8_t {
+    PacketsReceived,
+    PacketsProcessed,
+    PacketsSent,
+    PacketRetransmissions,
+    BytesRead,
+    BytesWritten,
+    WriteBatches,
+    PacketsInWriteBatches,
+    PTOs,
+    SpuriousLosses,
+    SpuriousPTOs,
+    // NOTE: MAX should always be at the end
+    MAX
+  };
+
+  using Snapshot = EnumArray<Counter, uint64_t>;
+
+  void add(Counter counter, uint64_t amount = 1) noexcept {
+    auto& value = counters_[counter];
+    value.store(
+        value.load(std::memory_order_relaxed) + amount,
+        std::memory_order_relaxed);
+  }
+
+  Snapshot snapshot() const noexcept {
+    Snapshot snapshot{};
+    for (auto counter : counters_.keys()) {
+      snapshot[counter] = counters_[counter].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+  }
+
+  // What was counted between the two snapshots.
+  static Snapshot difference(
+      const Snapshot& current,
+      const Snapshot& previous) noexcept {
+    Snapshot delta{};
+    for (auto counter : current.keys()) {
+      delta[counter] = current[counter] - previous[counter];
+    }
+    return delta;
+  }
+
+ private:
+  EnumArray<Counter, std::atomic<uint64_t>> counters_{};
+};
+
+} // namespace quic
@@ -11,6 +11,7 @@
 #include <quic/QuicConstants.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
+#include <quic/state/StreamRepairFunctions.h>
 #include <quic/state/stream/StreamSendHandlers.h>
 
 namespace quic {
@@ -73,6 +74,19 @@ folly::Optional<QuicSimpleFrame> updateSimpleFrameOnPacketClone(
       return QuicSimpleFrame(frame);
     case QuicSimpleFrame::Type::HandshakeDoneFrame_E:
       return QuicSimpleFrame(frame);
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E:
+      // Only the latest ACK_FREQUENCY is worth sending again.
+      if (frame.asAckFrequencyFrame()->sequenceNumber + 1 !=
+          conn.ackFrequencyState.nextSequenceNumber) {
+        return folly::none;
+      }
+      return QuicSimpleFrame(frame);
+    case QuicSimpleFrame::Type::ImmediateAckFrame_E:
+      // Only meant for the packet it was sent in.
+      return folly::none;
+    case QuicSimpleFrame::Type::StreamRepairFrame_E:
+      // The written frame doesn't keep the repair symbol.
+      return folly::none;
   }
   folly::assume_unreachable();
 }
@@ -88,6 +102,21 @@ void updateSimpleFrameOnPacketSent(
       // Start the clock to measure Rtt
       conn.pathChallengeStartTime = Clock::now();
       break;
+    case QuicSimpleFrame::Type::StreamRepairFrame_E: {
+      // Unlike the pending one, the written frame has no repair symbol.
+      const StreamRepairFrame& streamRepair =
+          *simpleFrame.asStreamRepairFrame();
+      auto& frames = conn.pendingEvents.frames;
+      auto itr = std::find_if(
+          frames.begin(), frames.end(), [&](const QuicSimpleFrame& frame) {
+            auto pending = frame.asStreamRepairFrame();
+            return pending && pending->streamId == streamRepair.streamId &&
+                pending->ranges == streamRepair.ranges;
+          });
+      CHECK(itr != frames.end());
+      frames.erase(itr);
+      break;
+    }
     default: {
       auto& frames = conn.pendingEvents.frames;
       auto itr = std::find(frames.begin(), frames.end(), simpleFrame);
@@ -148,6 +177,17 @@ void updateSimpleFrameOnPacketLoss(
     case QuicSimpleFrame::Type::HandshakeDoneFrame_E:
       conn.pendingEvents.frames.push_back(frame);
       break;
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const AckFrequencyFrame& ackFrequency = *frame.asAckFrequencyFrame();
+      if (ackFrequency.sequenceNumber + 1 ==
+          conn.ackFrequencyState.nextSequenceNumber) {
+        conn.pendingEvents.frames.push_back(ackFrequency);
+      }
+      break;
+    }
+    case QuicSimpleFrame::Type::ImmediateAckFrame_E:
+    case QuicSimpleFrame::Type::StreamRepairFrame_E:
+      break;
   }
 }
 
@@ -301,6 +341,50 @@ bool updateSimpleFrameOnPacketReceived(
       handshakeConfirmed(conn);
       return true;
     }
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      if (!conn.transportSettings.ackFrequencyEnabled) {
+        throw QuicTransportException(
+            "Received ACK_FREQUENCY without advertising min_ack_delay.",
+            TransportErrorCode::PROTOCOL_VIOLATION,
+            FrameType::ACK_FREQUENCY);
+      }
+      const AckFrequencyFrame& ackFrequency = *frame.asAckFrequencyFrame();
+      if (ackFrequency.updateMaxAckDelay < kMinAckDelay) {
+        throw QuicTransportException(
+            "ACK_FREQUENCY max ack delay below min_ack_delay.",
+            TransportErrorCode::PROTOCOL_VIOLATION,
+            FrameType::ACK_FREQUENCY);
+      }
+      auto& peerAckFrequency = conn.ackStates.appDataAckState.peerAckFrequency;
+      if (peerAckFrequency &&
+          peerAckFrequency->sequenceNumber >= ackFrequency.sequenceNumber) {
+        return true;
+      }
+      peerAckFrequency = ackFrequency;
+      peerAckFrequency->packetTolerance = std::min(
+          peerAckFrequency->packetTolerance, kMaxAckFrequencyPacketTolerance);
+      return true;
+    }
+    case QuicSimpleFrame::Type::ImmediateAckFrame_E: {
+      if (!conn.transportSettings.ackFrequencyEnabled) {
+        throw QuicTransportException(
+            "Received IMMEDIATE_ACK without advertising min_ack_delay.",
+            TransportErrorCode::PROTOCOL_VIOLATION,
+            FrameType::IMMEDIATE_ACK);
+      }
+      conn.ackStates.appDataAckState.immediateAckRequested = true;
+      return true;
+    }
+    case QuicSimpleFrame::Type::StreamRepairFrame_E: {
+      if (conn.transportSettings.streamRepairReceiveWindow == 0) {
+        throw QuicTransportException(
+            "Received STREAM_REPAIR without advertising stream_repair.",
+            TransportErrorCode::PROTOCOL_VIOLATION,
+            FrameType::STREAM_REPAIR);
+      }
+      onRecvStreamRepairFrame(conn, *frame.asStreamRepairFrame());
+      return true;
+    }
   }
   folly::assume_unreachable();
 }
@@ -7,6 +7,7 @@
  */
 
 #include <quic/state/StateData.h>
+#include <quic/common/CoarseClock.h>
 #include <quic/state/QuicStreamUtilities.h>
 
 namespace quic {
@@ -55,6 +56,10 @@ std::ostream& operator<<(std::ostream& os, const QuicConnectionStateBase& st) {
   return os;
 }
 
+TimePoint coarseNow(const QuicConnectionStateBase& conn) {
+  return conn.coarseClock ? conn.coarseClock->now() : Clock::now();
+}
+
 AckStateVersion::AckStateVersion(
     uint64_t initialVersion,
     uint64_t handshakeVersion,
@@ -94,6 +99,51 @@ PacingRate PacingRate::Builder::build() && {
   return PacingRate(interval_, burstSize_);
 }
 
+void CongestionController::LossEvent::merge(const LossEvent& other) {
+  if (!other.largestLostPacketNum) {
+    return;
+  }
+  if (std::numeric_limits<uint64_t>::max() - lostBytes < other.lostBytes) {
+    throw QuicInternalException(
+        "LossEvent: lostBytes overflow", LocalErrorCode::LOST_BYTES_OVERFLOW);
+  }
+  largestLostPacketNum = std::max(
+      *other.largestLostPacketNum,
+      largestLostPacketNum.value_or(*other.largestLostPacketNum));
+  lostBytes += other.lostBytes;
+  lostPackets += other.lostPackets;
+  largestLostSentTime = std::max(
+      *other.largestLostSentTime,
+      largestLostSentTime.value_or(*other.largestLostSentTime));
+  smallestLostSentTime = std::min(
+      *other.smallestLostSentTime,
+      smallestLostSentTime.value_or(*other.smallestLostSentTime));
+  persistentCongestion |= other.persistentCongestion;
+}
+
+void CongestionController::AckEvent::merge(AckEvent&& other) {
+  if (other.largestAckedPacket &&
+      (!largestAckedPacket ||
+       *other.largestAckedPacket > *largestAckedPacket)) {
+    largestAckedPacket = other.largestAckedPacket;
+    largestAckedPacketSentTime = other.largestAckedPacketSentTime;
+    largestAckedPacketAppLimited = other.largestAckedPacketAppLimited;
+  }
+  ackedBytes += other.ackedBytes;
+  ackTime = std::max(ackTime, other.ackTime);
+  if (other.mrttSample) {
+    mrttSample =
+        std::min(*other.mrttSample, mrttSample.value_or(*other.mrttSample));
+  }
+  ackedPackets.insert(
+      ackedPackets.end(),
+      std::make_move_iterator(other.ackedPackets.begin()),
+      std::make_move_iterator(other.ackedPackets.end()));
+  if (other.rateSample) {
+    rateSample = other.rateSample;
+  }
+}
+
 CongestionController::AckEvent::AckPacket::AckPacket(
     TimePoint sentTimeIn,
     uint32_t encodedSizeIn,
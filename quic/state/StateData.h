@@ -13,10 +13,17 @@
 #include <quic/codec/QuicReadCodec.h>
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
+#include <quic/common/BufUtil.h>
 #include <quic/common/EnumArray.h>
+#include <quic/common/LatencyHistogram.h>
+#include <quic/handshake/CryptoOffload.h>
 #include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/ParallelAead.h>
 #include <quic/logging/QLogger.h>
 #include <quic/state/AckStates.h>
+#include <quic/state/CongestionStateCache.h>
+#include <quic/state/OutstandingPacketRing.h>
+#include <quic/state/PacketEventSet.h>
 #include <quic/state/PendingPathRateLimiter.h>
 #include <quic/state/QuicStreamManager.h>
 #include <quic/state/QuicTransportStatsCallback.h>
@@ -29,7 +36,11 @@
 #include <folly/io/async/DelayedDestruction.h>
 #include <folly/io/async/HHWheelTimer.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <list>
 #include <numeric>
 #include <queue>
@@ -37,32 +48,104 @@
 namespace quic {
 
 struct RecvmmsgStorage {
+  // room for the control messages of one packet, e.g. its UDP_GRO segment
+  // size, ECN bits and receive timestamp
+  struct Control {
+    alignas(struct cmsghdr) char buf[128];
+  };
+
   std::vector<struct mmsghdr> msgs;
   std::vector<struct sockaddr_storage> addrs;
   std::vector<Buf> readBuffers;
   std::vector<struct iovec> iovecs;
+  std::vector<Control> controls;
 
   void resize(size_t numPackets) {
     msgs.resize(numPackets);
     addrs.resize(numPackets);
     readBuffers.resize(numPackets);
     iovecs.resize(numPackets);
+    controls.resize(numPackets);
+  }
+
+  /**
+   * Makes sure every slot holds an empty read buffer of at least bufSize
+   * bytes and points its iovec at it. The buffers stay around across reads,
+   * only the slots whose buffer was taken by the previous read, or is too
+   * small, get a new one.
+   */
+  void prepareReadBuffers(size_t bufSize) {
+    for (size_t i = 0; i < readBuffers.size(); ++i) {
+      auto& readBuffer = readBuffers[i];
+      // One buffer per packet so that it is not shared, this enables us to
+      // decrypt in place.
+      if (!readBuffer || readBuffer->capacity() < bufSize ||
+          readBuffer->isShared()) {
+        readBuffer = folly::IOBuf::create(bufSize);
+      }
+      iovecs[i].iov_base = readBuffer->writableData();
+      iovecs[i].iov_len = bufSize;
+    }
   }
 };
 
 struct NetworkData {
   TimePoint receiveTimePoint;
   std::vector<std::unique_ptr<folly::IOBuf>> packets;
-  RecvmmsgStorage recvmmsgStorage;
   size_t totalData{0};
+  // ECN codepoints of the packets, packets past its end were not marked.
+  std::vector<uint8_t> packetEcn;
+  // The kernel's receive times of the packets, the ones past its end or
+  // without a time of their own were received at receiveTimePoint.
+  std::vector<TimePoint> packetReceiveTimes;
 
   NetworkData() = default;
-  NetworkData(Buf&& buf, const TimePoint& receiveTime)
+  NetworkData(
+      Buf&& buf,
+      const TimePoint& receiveTime,
+      uint8_t ecn = kEcnNotEct)
       : receiveTimePoint(receiveTime) {
     if (buf) {
       totalData = buf->computeChainDataLength();
       packets.emplace_back(std::move(buf));
+      setEcn(0, ecn);
+    }
+  }
+
+  /**
+   * Sets the ECN codepoint of the packets from firstPacket on, which all came
+   * in the same datagram.
+   */
+  void setEcn(size_t firstPacket, uint8_t ecn) {
+    if (ecn == kEcnNotEct) {
+      return;
+    }
+    packetEcn.resize(packets.size(), kEcnNotEct);
+    std::fill(packetEcn.begin() + firstPacket, packetEcn.end(), ecn);
+  }
+
+  uint8_t getEcn(size_t packet) const {
+    return packet < packetEcn.size() ? packetEcn[packet] : kEcnNotEct;
+  }
+
+  /**
+   * Sets the receive time of the packets from firstPacket on, which all came
+   * in the same datagram.
+   */
+  void setReceiveTime(size_t firstPacket, TimePoint receiveTime) {
+    packetReceiveTimes.resize(packets.size());
+    std::fill(
+        packetReceiveTimes.begin() + firstPacket,
+        packetReceiveTimes.end(),
+        receiveTime);
+  }
+
+  TimePoint getReceiveTime(size_t packet) const {
+    if (packet < packetReceiveTimes.size() &&
+        packetReceiveTimes[packet] != TimePoint()) {
+      return packetReceiveTimes[packet];
     }
+    return receiveTimePoint;
   }
 
   std::unique_ptr<folly::IOBuf> moveAllData() && {
@@ -82,13 +165,15 @@ struct NetworkDataSingle {
   std::unique_ptr<folly::IOBuf> data;
   TimePoint receiveTimePoint;
   size_t totalData{0};
+  uint8_t ecn{kEcnNotEct};
 
   NetworkDataSingle() = default;
 
   NetworkDataSingle(
       std::unique_ptr<folly::IOBuf> buf,
-      const TimePoint& receiveTime)
-      : data(std::move(buf)), receiveTimePoint(receiveTime) {
+      const TimePoint& receiveTime,
+      uint8_t ecnIn = kEcnNotEct)
+      : data(std::move(buf)), receiveTimePoint(receiveTime), ecn(ecnIn) {
     if (data) {
       totalData += data->computeChainDataLength();
     }
@@ -114,18 +199,34 @@ using PacketEvent = PacketNum;
 
 // Data structure to represent outstanding retransmittable packets
 struct OutstandingPacket {
-  // Structure representing the frames that are outstanding including the header
-  // that was sent.
-  RegularQuicWritePacket packet;
-  // Time that the packet was sent.
-  TimePoint time;
-  // Size of the packet sent on the wire.
-  uint32_t encodedSize;
+  // The fields that ack processing and loss detection look at for every
+  // packet they walk past come first, so they share the leading cache lines
+  // and the frames are only touched for the packets that are acked or lost.
+
+  // Packet number and space of the packet, copied out of its header.
+  PacketNum packetNum;
+  PacketNumberSpace packetNumberSpace;
   // Whether this packet has any data from stream 0
   bool isHandshake;
+  /**
+   * Whether the packet is sent when congestion controller is in app-limited
+   * state.
+   */
+  bool isAppLimited{false};
+  // Whether the packet was sent with ECT(0).
+  bool isEcnMarked{false};
+  // Size of the packet sent on the wire.
+  uint32_t encodedSize;
+  // Time that the packet was sent.
+  TimePoint time;
   // Total sent bytes on this connection including this packet itself when this
   // packet is sent.
   uint64_t totalBytesSent;
+
+  // PacketEvent associated with this OutstandingPacket. This will be a
+  // folly::none if the packet isn't a clone and hasn't been cloned.
+  folly::Optional<PacketEvent> associatedEvent;
+
   // Information regarding the last acked packet on this connection when this
   // packet is sent.
   struct LastAckedPacketInfo {
@@ -149,15 +250,15 @@ struct OutstandingPacket {
   };
   folly::Optional<LastAckedPacketInfo> lastAckedPacketInfo;
 
-  // PacketEvent associated with this OutstandingPacket. This will be a
-  // folly::none if the packet isn't a clone and hasn't been cloned.
-  folly::Optional<PacketEvent> associatedEvent;
-
   /**
-   * Whether the packet is sent when congestion controller is in app-limited
-   * state.
+   * Plaintext body of the packet, only kept when resendClonedPacketBody is
+   * set.
    */
-  bool isAppLimited{false};
+  std::shared_ptr<const folly::IOBuf> body;
+
+  // Structure representing the frames that are outstanding including the header
+  // that was sent.
+  RegularQuicWritePacket packet;
 
   OutstandingPacket(
       RegularQuicWritePacket packetIn,
@@ -165,11 +266,94 @@ struct OutstandingPacket {
       uint32_t encodedSizeIn,
       bool isHandshakeIn,
       uint64_t totalBytesSentIn)
-      : packet(std::move(packetIn)),
-        time(std::move(timeIn)),
-        encodedSize(encodedSizeIn),
+      : packetNum(packetIn.header.getPacketSequenceNum()),
+        packetNumberSpace(packetIn.header.getPacketNumberSpace()),
         isHandshake(isHandshakeIn),
-        totalBytesSent(totalBytesSentIn) {}
+        encodedSize(encodedSizeIn),
+        time(std::move(timeIn)),
+        totalBytesSent(totalBytesSentIn),
+        packet(std::move(packetIn)) {}
+};
+
+/**
+ * The sent packets of a connection that are not acked or declared lost yet,
+ * in a queue per packet number space, each indexed by packet number. Ack
+ * processing looks up the packets an ack names in the queue of its space,
+ * loss detection only walks the queue of the space it is for.
+ */
+class OutstandingPackets {
+ public:
+  using Queue = OutstandingPacketRing<OutstandingPacket>;
+
+  Queue& operator[](PacketNumberSpace pnSpace) {
+    return queues_[pnSpace];
+  }
+
+  const Queue& operator[](PacketNumberSpace pnSpace) const {
+    return queues_[pnSpace];
+  }
+
+  // The packets of all the spaces.
+  size_t size() const {
+    size_t count = 0;
+    for (const auto& queue : queues_) {
+      count += queue.size();
+    }
+    return count;
+  }
+
+  bool empty() const {
+    for (const auto& queue : queues_) {
+      if (!queue.empty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void clear() {
+    for (auto& queue : queues_) {
+      queue.clear();
+    }
+  }
+
+  // Initial, Handshake and AppData, in that order.
+  std::array<PacketNumberSpace, 3> spaces() const {
+    return queues_.keys();
+  }
+
+ private:
+  EnumArray<PacketNumberSpace, Queue> queues_;
+};
+
+/**
+ * Delivery rate sample of an ack, after
+ * draft-cheng-iccrg-delivery-rate-estimation. It is taken from the most
+ * recently sent of the packets the ack newly acked, against the connection
+ * state recorded in its LastAckedPacketInfo when it was sent.
+ */
+struct RateSample {
+  // Bytes sent between the packet the sample starts at and the acked one,
+  // and the time it took to send them.
+  uint64_t sentBytes{0};
+  std::chrono::microseconds sendElapsed{0us};
+  // Bytes delivered between the ack the sample starts at and this one, and
+  // the time between the two acks.
+  uint64_t deliveredBytes{0};
+  std::chrono::microseconds ackElapsed{0us};
+  // Whether the acked packet was sent while app limited, in which case the
+  // sample may under estimate the rate.
+  bool isAppLimited{false};
+
+  /**
+   * Delivered bytes per second, over the longer of the two elapsed times so
+   * that neither an ack compression nor a send burst inflates it.
+   */
+  uint64_t deliveryRate() const noexcept {
+    auto interval = std::max(sendElapsed, ackElapsed);
+    return interval.count() == 0 ? 0
+                                 : deliveredBytes * 1000000 / interval.count();
+  }
 };
 
 struct Pacer {
@@ -206,6 +390,12 @@ struct Pacer {
    */
   virtual uint64_t updateAndGetWriteBatchSize(TimePoint currentTime) = 0;
 
+  /**
+   * API for Transport to query the time between the departures of two packets
+   * at the current pacing rate. 0 means the packets are not paced.
+   */
+  virtual std::chrono::nanoseconds getPacketInterval() const = 0;
+
   /**
    * Getter API of the most recent write batch size.
    */
@@ -263,7 +453,7 @@ struct CongestionController {
             "LossEvent: lostBytes overflow",
             LocalErrorCode::LOST_BYTES_OVERFLOW);
       }
-      PacketNum packetNum = packet.packet.header.getPacketSequenceNum();
+      PacketNum packetNum = packet.packetNum;
       largestLostPacketNum =
           std::max(packetNum, largestLostPacketNum.value_or(packetNum));
       lostBytes += packet.encodedSize;
@@ -273,6 +463,11 @@ struct CongestionController {
       smallestLostSentTime =
           std::min(packet.time, smallestLostSentTime.value_or(packet.time));
     }
+
+    /**
+     * Adds the lost packets of a later event to this one.
+     */
+    void merge(const LossEvent& other);
   };
 
   struct AckEvent {
@@ -337,6 +532,14 @@ struct CongestionController {
     };
 
     std::vector<AckPacket> ackedPackets;
+
+    // Delivery rate sample of the ack, computed once for all controllers.
+    folly::Optional<RateSample> rateSample;
+
+    /**
+     * Adds the acked packets of a later event to this one.
+     */
+    void merge(AckEvent&& other);
   };
 
   virtual ~CongestionController() = default;
@@ -355,6 +558,20 @@ struct CongestionController {
       folly::Optional<AckEvent>,
       folly::Optional<LossEvent>) = 0;
 
+  /**
+   * Notify congestion controller that a packet it was told is lost got acked
+   * after all, so that it can undo the reaction to the loss.
+   */
+  virtual void onSpuriousLoss() = 0;
+
+  /**
+   * Notify congestion controller that the peer reported new CE marks. The
+   * marked packets were delivered, so nothing leaves the inflight, but they
+   * ask for the same backoff as a loss. sentTime is the send time of the
+   * largest packet acked by the ACK which carried the marks.
+   */
+  virtual void onEcnCongestionEvent(TimePoint sentTime) = 0;
+
   /**
    * Return the number of bytes that the congestion controller
    * will allow you to write.
@@ -456,6 +673,9 @@ struct LossState {
   uint32_t timeoutBasedRtxCount{0};
   // Total number of PTO count
   uint32_t totalPTOCount{0};
+  // The largest packet sent when the first of the current run of PTOs fired,
+  // to tell whether the first ack after it acks a packet sent before it
+  folly::Optional<PacketNum> largestSentAtPTO;
   // Total number of bytes sent on this connection. This is after encoding.
   uint64_t totalBytesSent{0};
   // Total number of bytes received on this connection. This is before decoding.
@@ -483,15 +703,32 @@ struct LossState {
   folly::Optional<TimePoint> lastAckedPacketSentTime;
   // The latest time a packet is acked
   folly::Optional<TimePoint> lastAckedTime;
+  // The latest delivery rate sample
+  folly::Optional<RateSample> lastRateSample;
   // The time when last retranmittable packet is sent for every packet number
   // space
   TimePoint lastRetransmittablePacketSentTime;
+  // The packet numbers most recently declared lost in each space, in
+  // ascending order, only kept with detectSpuriousLoss.
+  EnumArray<PacketNumberSpace, std::deque<PacketNum>> recentlyLostPackets;
+  // RACK state, only kept up with useRackLossDetection.
+  // The sent time of the most recently sent packet that has been acked.
+  folly::Optional<TimePoint> rackLatestDeliveredSentTime;
+  // Whether an ack has acked a packet below one that was acked before it.
+  bool rackReorderingSeen{false};
+  // The reordering window in steps of min rtt / kRackReorderWindowDivisor.
+  uint16_t rackReorderWindowMultiplier{1};
 };
 
 class Logger;
 class CongestionControllerFactory;
 class LoopDetectorCallback;
+class CoarseClock;
+class MultiDestBatchWriter;
+class ZeroCopyBufferTracker;
+class XdpSocket;
 class PendingPathRateLimiter;
+class FlowControlWindowBudget;
 
 struct QuicConnectionStateBase : public folly::DelayedDestruction {
   virtual ~QuicConnectionStateBase() = default;
@@ -509,9 +746,26 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
   // Connection Congestion controller
   std::unique_ptr<CongestionController> congestionController;
 
+  // The cwnd congestion controllers start with instead of initCwndInMss, when
+  // the connection warm starts from the congestion state an earlier
+  // connection to the same peer cached.
+  folly::Optional<uint64_t> warmStartCwndBytes;
+
+  // Where congestion controllers that support careful resume jump to once
+  // the rtt of the path confirms the saved one, on a resumed connection.
+  folly::Optional<CarefulResumeParams> carefulResume;
+
   // Pacer
   std::unique_ptr<Pacer> pacer;
 
+  // Where the congestion controllers read the current time from when it isn't
+  // handed to them. Only simulations set it, to run on a virtual clock.
+  std::function<TimePoint()> congestionControlClock;
+
+  // Where bookkeeping that doesn't need a precise time reads it from, shared
+  // with the other connections on the evb, if set. See coarseNow.
+  std::shared_ptr<CoarseClock> coarseClock;
+
   // Congestion Controller factory to create specific impl of cc algorithm
   std::shared_ptr<CongestionControllerFactory> congestionControllerFactory;
 
@@ -522,18 +776,27 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
   // This limit should be cleared and set back to max after CFIN is received.
   folly::Optional<uint32_t> writableBytesLimit;
 
+  // The packets the current write may send at most, set by the worker's
+  // DeferredWriteScheduler when it hands out the writes of its connections.
+  folly::Optional<uint64_t> writePacketLimit;
+
   std::unique_ptr<PendingPathRateLimiter> pathValidationLimiter;
 
+  // What the auto tuned connection window grows out of and what limits the
+  // bytes buffered for reads, shared with the other connections of the server
+  // worker, if set.
+  std::shared_ptr<FlowControlWindowBudget> flowControlWindowBudget;
+
+  // Sent packets which have not been acked, per packet number space.
   // TODO: We really really should wrap outstandingPackets, all its associated
   // counters and the outstandingPacketEvents into one class.
-  // Sent packets which have not been acked. These are sorted by PacketNum.
-  std::deque<OutstandingPacket> outstandingPackets;
+  OutstandingPackets outstandingPackets;
 
   // All PacketEvents of this connection. If a OutstandingPacket doesn't have an
   // associatedEvent or if it's not in this set, there is no need to process its
   // frames upon ack or loss.
   // TODO: Enforce only AppTraffic packets to be clonable
-  folly::F14FastSet<PacketEvent> outstandingPacketEvents;
+  PacketEventSet outstandingPacketEvents;
 
   // Number of handshake packets outstanding.
   uint64_t outstandingHandshakePacketsCount{0};
@@ -559,6 +822,27 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
   // Write cipher for 1-RTT data
   std::unique_ptr<Aead> oneRttWriteCipher;
 
+  // Write cipher of the next key generation, derived ahead of the key update
+  std::unique_ptr<Aead> nextOneRttWriteCipher;
+
+  // Generation of the 1-RTT write keys, 0 until the first key update
+  uint64_t oneRttWriteKeyGeneration{0};
+
+  // First packet number written with the current generation of write keys
+  folly::Optional<PacketNum> oneRttWriteGenerationStart;
+
+  // Device sealing the 1-RTT packets, set if the socket supports it
+  std::shared_ptr<CryptoOffload> cryptoOffload;
+
+  // Last generation of write keys we tried to install on cryptoOffload
+  folly::Optional<uint64_t> cryptoOffloadKeyGeneration;
+
+  // Helper threads the 1-RTT packets of a write are sealed on, when set
+  std::shared_ptr<CryptoWorkerPool> cryptoWorkers;
+
+  // Last generation of write keys we tried to spread over cryptoWorkers
+  folly::Optional<uint64_t> cryptoWorkersKeyGeneration;
+
   // Write cipher for packets with initial keys.
   std::unique_ptr<Aead> initialWriteCipher;
 
@@ -616,6 +900,11 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
   // Error sent on the connection by the peer.
   folly::Optional<std::pair<QuicErrorCode, std::string>> peerConnectionError;
 
+  // The last close packet sent, as it went out. Only kept with
+  // compactDrainingConnections, for the server worker to answer with once the
+  // transport is gone.
+  Buf lastClosePacket;
+
   // Before deadline, transport may treat ENETUNREACH as non-fatal error
   folly::Optional<TimePoint> continueOnNetworkUnreachableDeadline;
 
@@ -658,6 +947,10 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
     // Number of probing packets to send after PTO
     uint8_t numProbePackets{0};
 
+    // Whether the probes carry the pending simple frames, the PING of a PTO
+    // that probes an idle tail
+    bool pingProbe{false};
+
     bool cancelPingTimeout{false};
 
     // close transport when the next packet number reaches kMaxPacketNum
@@ -668,6 +961,9 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
 
   LossState lossState;
 
+  // Latencies of the connection's rtt samples and stream data.
+  ConnectionLatencyHistograms latencyHistograms;
+
   // This contains the ack and packet number related states for all three
   // packet number space.
   AckStates ackStates;
@@ -690,6 +986,8 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
     uint64_t sumCurWriteOffset{0};
     // The sum of length of data in all the stream buffers.
     uint64_t sumCurStreamBufferLen{0};
+    // The sum of the unackedBufferLen of all the streams.
+    uint64_t sumUnackedStreamBufferLen{0};
     // The packet number in which we got the last largest max data.
     folly::Optional<PacketNum> largestMaxOffsetReceived;
     // The following are advertised by the peer, and are set to zero initially
@@ -702,6 +1000,11 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
     uint64_t peerAdvertisedInitialMaxStreamOffsetUni{0};
     // Time at which the last flow control update was sent by the transport.
     folly::Optional<TimePoint> timeOfLastFlowControlUpdate;
+    // Bytes auto tuning grew windowSize by out of flowControlWindowBudget
+    uint64_t budgetedWindowBytes{0};
+    // Received and not yet read bytes last accounted for in
+    // flowControlWindowBudget
+    uint64_t budgetedBufferedBytes{0};
   };
 
   // Current state of flow control.
@@ -727,13 +1030,6 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
   // max_packet_size in Transport Parameters and PMTU
   uint64_t udpSendPacketLen{kDefaultUDPSendPacketLen};
 
-  struct PacketSchedulingState {
-    StreamId nextScheduledStream{0};
-    StreamId nextScheduledControlStream{0};
-  };
-
-  PacketSchedulingState schedulingState;
-
   // The packet number of the latest packet that contains a MaxDataFrame sent
   // out by us.
   folly::Optional<PacketNum> latestMaxDataPacket;
@@ -747,6 +1043,26 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
   // Track stats for various server events
   QuicTransportStatsCallback* infoCallback{nullptr};
 
+  // Counters for the per packet stats events, they replace the infoCallback
+  // calls for those events if set. Owned by the server worker.
+  QuicTransportStatsCounters* statsCounters{nullptr};
+
+  // Buffers that packets are sealed into on the write path. This may be shared
+  // by all the connections of a server worker.
+  std::shared_ptr<PacketBufferPool> bufPool;
+
+  // When set, packets are handed to this writer, shared with the other
+  // connections of a server worker, instead of being written directly.
+  std::shared_ptr<MultiDestBatchWriter> multiDestBatchWriter;
+
+  // Holds the buffers of MSG_ZEROCOPY sends until the kernel is done with
+  // them. Only set when zerocopy could be turned on for the socket.
+  std::shared_ptr<ZeroCopyBufferTracker> zeroCopyTracker;
+
+  // When set, the packets to the peers the AF_XDP socket of the server worker
+  // has seen are posted to it instead of sent through the kernel.
+  std::shared_ptr<XdpSocket> xdpSocket;
+
   struct HappyEyeballsState {
     // Delay timer
     folly::HHWheelTimer::Callback* connAttemptDelayTimeout{nullptr};
@@ -764,6 +1080,25 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
     // The UDP socket that will be used for the second connection attempt
     std::unique_ptr<folly::AsyncUDPSocket> secondSocket;
 
+    // Candidate addresses after the first of each family, attempted one every
+    // kHappyEyeballsNextAttemptDelay once both sockets are in the race,
+    // alternating between the families.
+    std::deque<folly::SocketAddress> pendingPeerAddresses;
+
+    // The addresses attempted after the first of their family, which the
+    // socket of their family is written to as well until one of them wins.
+    std::vector<folly::SocketAddress> firstSocketPeerAddresses;
+    std::vector<folly::SocketAddress> secondSocketPeerAddresses;
+
+    // Number of addresses attempted
+    uint32_t attempts{0};
+
+    // Whether the second socket was started, it is only started once
+    bool secondSocketStarted{false};
+
+    // Whether the second socket won the race
+    bool secondSocketWon{false};
+
     // Whether should write to the first UDP socket
     bool shouldWriteToFirstSocket{true};
 
@@ -777,13 +1112,118 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
 
   HappyEyeballsState happyEyeballsState;
 
+  struct ZeroRttState {
+    // Whether the client had a psk to resume with 0-RTT.
+    bool attempted{false};
+    // Whether the peer took the 0-RTT data, once the handshake tells.
+    folly::Optional<bool> accepted;
+    // 0-RTT packets written, the ones the peer rejected are sent again in
+    // 1-RTT.
+    uint64_t packetsSent{0};
+  };
+
+  ZeroRttState zeroRttState;
+
   // Whether a connection can be paced based on its handshake and close states.
   // For example, we may not want to pace a connection that's still handshaking.
   bool canBePaced{false};
 
+  // Whether the socket accepts SO_TXTIME departure times.
+  bool socketTxTimeEnabled{false};
+
+  // Departure time of the next packet when pacing with SO_TXTIME.
+  TimePoint nextTxTime;
+
   // Whether or not both ends agree to use partial reliability
   bool partialReliabilityEnabled{false};
 
+  struct AckFrequencyState {
+    // min_ack_delay of the peer, set when it takes ACK_FREQUENCY frames.
+    folly::Optional<std::chrono::microseconds> peerMinAckDelay;
+    // Sequence number of the next ACK_FREQUENCY frame we send.
+    uint64_t nextSequenceNumber{0};
+    // What the last ACK_FREQUENCY frame we sent asked for.
+    uint64_t packetTolerance{0};
+    std::chrono::microseconds maxAckDelay{0us};
+    folly::Optional<TimePoint> lastSentTime;
+  };
+
+  AckFrequencyState ackFrequencyState;
+
+  struct PmtuDiscoveryState {
+    // udpSendPacketLen before the search raised it, what a new path starts
+    // with again. 0 while discovery has not started.
+    uint64_t basePmtu{0};
+    // max_packet_size of the peer
+    uint64_t peerMaxUdpPayloadSize{0};
+    // The packet size is searched between udpSendPacketLen, the largest
+    // probe acked, and this, below the smallest probe lost.
+    uint64_t searchHigh{0};
+    // Size of the probe to send or in flight, none once the search is done.
+    folly::Optional<uint64_t> probeSize;
+    // The probe in flight
+    folly::Optional<PacketNum> probePacketNum;
+    // Times a probe of probeSize was lost
+    uint8_t probeLosses{0};
+  };
+
+  PmtuDiscoveryState pmtuDiscoveryState;
+
+  struct DatagramState {
+    struct PendingDatagram {
+      Buf data;
+      // Dropped instead of sent after this.
+      folly::Optional<TimePoint> deadline;
+
+      PendingDatagram(Buf dataIn, folly::Optional<TimePoint> deadlineIn)
+          : data(std::move(dataIn)), deadline(deadlineIn) {}
+    };
+
+    // max_datagram_frame_size of the peer, 0 when it takes no datagrams.
+    uint64_t maxWriteFrameSize{0};
+    // Datagrams the app wrote that are not sent yet, and the ones received
+    // that the app did not read yet.
+    std::deque<PendingDatagram> writeBuffer;
+    std::deque<Buf> readBuffer;
+    // Bytes datagrams can still take from the packets while stream data is
+    // waiting too, topped up by datagramWriteSharePercent of each packet.
+    uint64_t writeCredit{0};
+    // Datagrams dropped for missing their deadline
+    uint64_t numExpiredWrites{0};
+  };
+
+  DatagramState datagramState;
+
+  // Experimental STREAM_REPAIR frames sent for the tail of the streams the app
+  // protects, see StreamRepairFunctions.
+  struct StreamRepairState {
+    // stream repair receive window of the peer, 0 when it takes no repairs.
+    uint64_t peerReceiveWindow{0};
+    // Repair data sent so far, out of the streamRepairBudget.
+    uint64_t bytesSent{0};
+    // The streams the app asked to protect.
+    std::vector<StreamId> streams;
+  };
+
+  StreamRepairState streamRepairState;
+
+  // Congestion controller events of the acks of the read batch being
+  // processed, handed over together once the batch is done. Only active with
+  // the batchAckEvents transport setting.
+  struct AckEventBatch {
+    bool active{false};
+    folly::Optional<CongestionController::AckEvent> ack;
+    folly::Optional<CongestionController::LossEvent> loss;
+    bool spuriousLoss{false};
+  };
+
+  AckEventBatch ackEventBatch;
+
+  // Whether the feedback of the peer on the ECN marks of our packets was found
+  // wrong, the packets are sent without marks from then on. Only used with
+  // the enableEcn transport setting.
+  bool ecnFailed{false};
+
   // Debug information. Currently only used to debug busy loop of Transport
   // WriteLooper.
   struct DebugState {
@@ -812,6 +1252,12 @@ struct QuicConnectionStateBase : public folly::DelayedDestruction {
 
 std::ostream& operator<<(std::ostream& os, const QuicConnectionStateBase& st);
 
+/**
+ * The time from the connection's coarseClock if it has one, Clock::now()
+ * otherwise. Not for rtt samples, pacing or timers.
+ */
+TimePoint coarseNow(const QuicConnectionStateBase& conn);
+
 struct AckStateVersion {
   uint64_t initialAckStateVersion{kDefaultIntervalSetVersion};
   uint64_t handshakeAckStateVersion{kDefaultIntervalSetVersion};
@@ -9,8 +9,12 @@
 #pragma once
 
 #include <folly/container/F14Map.h>
+#include <folly/sorted_vector_types.h>
 #include <quic/QuicConstants.h>
 #include <quic/codec/Types.h>
+#include <quic/state/QuicPriorityQueue.h>
+
+#include <deque>
 
 namespace quic {
 
@@ -26,6 +30,22 @@ struct StreamBuffer {
   StreamBuffer& operator=(StreamBuffer&& other) = default;
 };
 
+// Sorted, non contiguous segments of received stream data. In order data is
+// kept as a single segment, which is held inline.
+using StreamReadBuffer = SmallVec<StreamBuffer, 1, std::size_t>;
+
+// Sent stream data that is not acked yet, ordered by offset. Data is sent and
+// mostly acked in offset order, so buffers are added at the back and removed
+// from the front of the deque, and the ones acked or lost out of order are
+// found with a binary search.
+using RetransmissionBuffer = folly::sorted_vector_map<
+    uint64_t,
+    StreamBuffer,
+    std::less<uint64_t>,
+    std::allocator<std::pair<uint64_t, StreamBuffer>>,
+    void,
+    std::deque<std::pair<uint64_t, StreamBuffer>>>;
+
 struct QuicStreamLike {
   QuicStreamLike() = default;
 
@@ -35,7 +55,7 @@ struct QuicStreamLike {
 
   // List of bytes that have been read and buffered. We need to buffer
   // bytes in case we get bytes out of order.
-  std::deque<StreamBuffer> readBuffer;
+  StreamReadBuffer readBuffer;
 
   // List of bytes that have been written to the QUIC layer.
   BufQueue writeBuffer{};
@@ -49,7 +69,7 @@ struct QuicStreamLike {
   // it is keyed due to partial reliability - when data is skipped the offset
   // in the StreamBuffer may be incremented, but the keyed offset must remain
   // the same so it can be removed from the buffer on ACK.
-  folly::F14FastMap<uint64_t, StreamBuffer> retransmissionBuffer;
+  RetransmissionBuffer retransmissionBuffer;
 
   // Tracks intervals which we have received ACKs for. E.g. in the case of all
   // data being acked this would contain one internval from 0 -> the largest
@@ -60,8 +80,8 @@ struct QuicStreamLike {
   using AckedIntervals = IntervalSet<uint64_t, 1, IntervalSetVec>;
   AckedIntervals ackedIntervals;
 
-  // Stores a list of buffers which have been marked as loss by loss detector.
-  // Each one represents one StreamFrame that was written.
+  // Stores a list of buffers which have been marked as loss by loss detector,
+  // ordered by offset. Contiguous lost data is merged into one buffer.
   std::deque<StreamBuffer> lossBuffer;
 
   // Current offset of the start bytes in the write buffer.
@@ -93,24 +113,54 @@ struct QuicStreamLike {
 
   /*
    * Either insert a new entry into the loss buffer, or merge the buffer with
-   * an existing entry.
+   * the entries it overlaps or touches, so that contiguous lost data is
+   * retransmitted as one range however many packets it was lost in. Returns
+   * the bytes that were already in the loss buffer and are dropped from buf,
+   * the data a stream no longer keeps for them is to be released.
    */
-  void insertIntoLossBuffer(StreamBuffer buf) {
-    // We assume here that we won't try to insert an overlapping buffer, as
-    // that should never happen in the loss buffer.
+  uint64_t insertIntoLossBuffer(StreamBuffer buf) {
     auto lossItr = std::upper_bound(
         lossBuffer.begin(),
         lossBuffer.end(),
         buf.offset,
         [](auto offset, const auto& buffer) { return offset < buffer.offset; });
-    if (!lossBuffer.empty() && lossItr != lossBuffer.begin() &&
-        std::prev(lossItr)->offset + std::prev(lossItr)->data.chainLength() ==
+    // Index of the entry the buffer ended up in, the deque's iterators don't
+    // survive the erases below.
+    size_t index = std::distance(lossBuffer.begin(), lossItr);
+    uint64_t dropped = 0;
+    if (lossItr != lossBuffer.begin() &&
+        std::prev(lossItr)->offset + std::prev(lossItr)->data.chainLength() >=
             buf.offset) {
-      std::prev(lossItr)->data.append(buf.data.move());
-      std::prev(lossItr)->eof = buf.eof;
+      index--;
+      dropped += appendToLossBuffer(lossBuffer[index], buf);
     } else {
       lossBuffer.insert(lossItr, std::move(buf));
     }
+    while (index + 1 < lossBuffer.size() &&
+           lossBuffer[index + 1].offset <=
+               lossBuffer[index].offset +
+                   lossBuffer[index].data.chainLength()) {
+      dropped += appendToLossBuffer(lossBuffer[index], lossBuffer[index + 1]);
+      lossBuffer.erase(lossBuffer.begin() + index + 1);
+    }
+    return dropped;
+  }
+
+ private:
+  // Appends the part of buf past the end of entry, which buf overlaps or
+  // touches. Returns the length of the rest, which is dropped.
+  static uint64_t appendToLossBuffer(StreamBuffer& entry, StreamBuffer& buf) {
+    auto entryEnd = entry.offset + entry.data.chainLength();
+    auto bufEnd = buf.offset + buf.data.chainLength();
+    DCHECK_LE(buf.offset, entryEnd);
+    if (bufEnd < entryEnd) {
+      return bufEnd - buf.offset;
+    }
+    uint64_t overlap = entryEnd - buf.offset;
+    buf.data.trimStart(overlap);
+    entry.data.append(buf.data.move());
+    entry.eof = entry.eof || buf.eof;
+    return overlap;
   }
 };
 
@@ -177,6 +227,11 @@ struct QuicStreamState : public QuicStreamLike {
 
   StreamFlowControlState flowControlState;
 
+  // Bytes written to the socket that are held in the retransmission and loss
+  // buffers until they are acked, skipped or the stream is reset. Together
+  // with the write buffer this is what the stream keeps in memory for sending.
+  uint64_t unackedBufferLen{0};
+
   // Stream level read error occured.
   folly::Optional<QuicErrorCode> streamReadError;
   // Stream level write error occured.
@@ -198,6 +253,21 @@ struct QuicStreamState : public QuicStreamLike {
   // congestion control with control streams still active.
   bool isControl{false};
 
+  // Set for streams the app did not open as replay safe. Their data is held
+  // back until the 1-RTT keys are there, so that none of it goes out in 0-RTT
+  // where the peer may replay it.
+  bool replaySafeOnly{false};
+
+  // Priority the stream is scheduled with, set by the app via
+  // setStreamPriority. Control streams are always sent first regardless.
+  Priority priority{kDefaultPriority};
+
+  // Whether the stream is in the readable and peekable streams of the stream
+  // manager. They are only changed by the stream manager, and let it skip the
+  // set lookups when a read or receive doesn't change what the stream offers.
+  bool inReadableStreams{false};
+  bool inPeekableStreams{false};
+
   // The last time we detected we were head of line blocked on the stream.
   folly::Optional<Clock::time_point> lastHolbTime;
 
@@ -208,6 +278,21 @@ struct QuicStreamState : public QuicStreamLike {
   // lastHolbTime indicates whether the stream is HOL blocked at the moment.
   uint32_t holbCount{0};
 
+  // The end offsets of the app's writes and when they were made, for the
+  // sendBuffer and delivery latency histograms of the connection. A write
+  // moves from the unsent to the undelivered ones once the data up to its
+  // end is first sent, and is dropped once all of it is acked. At most
+  // kMaxStreamWriteLatencySamples of each are kept.
+  std::deque<std::pair<uint64_t, TimePoint>> unsentWriteTimes;
+  std::deque<std::pair<uint64_t, TimePoint>> undeliveredWriteTimes;
+
+  // Experimental stream repair. The sent data below repairedOffset is covered
+  // by STREAM_REPAIR frames already, for streams the app protects with them.
+  uint64_t repairedOffset{0};
+  // The last streamRepairReceiveWindow bytes the app read, which the repair
+  // frames of the peer may still need. They end at the read offset.
+  BufQueue recentlyRead;
+
   // Returns true if both send and receive state machines are in a terminal
   // state
   bool inTerminalStates() const {
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/StreamRepairFunctions.h>
+
+#include <folly/io/Cursor.h>
+#include <quic/state/stream/StreamReceiveHandlers.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace quic {
+
+namespace {
+
+// XORs the bytes [offset, offset + length) of a chain that starts at
+// chainOffset into out, which starts at offset, and returns how many of them
+// the chain has. Only counts them when out is null.
+uint64_t xorChain(
+    const folly::IOBuf* chain,
+    uint64_t chainOffset,
+    uint64_t chainLength,
+    uint64_t offset,
+    uint64_t length,
+    uint8_t* out) {
+  auto begin = std::max(offset, chainOffset);
+  auto end = std::min(offset + length, chainOffset + chainLength);
+  if (!chain || begin >= end) {
+    return 0;
+  }
+  if (out) {
+    folly::io::Cursor cursor(chain);
+    cursor.skip(begin - chainOffset);
+    uint8_t* dst = out + (begin - offset);
+    uint64_t left = end - begin;
+    while (left > 0) {
+      auto bytes = cursor.peekBytes();
+      auto len = std::min<uint64_t>(left, bytes.size());
+      for (uint64_t i = 0; i < len; ++i) {
+        dst[i] ^= bytes[i];
+      }
+      cursor.skip(len);
+      dst += len;
+      left -= len;
+    }
+  }
+  return end - begin;
+}
+
+// Same for the data the stream received, the bytes the app read recently and
+// the ones still in the read buffer.
+uint64_t xorReceivedData(
+    const QuicStreamState& stream,
+    uint64_t offset,
+    uint64_t length,
+    uint8_t* out) {
+  // The read offset is one past the FIN once the app read it.
+  auto readOffset = std::min(
+      stream.currentReadOffset,
+      stream.finalReadOffset.value_or(stream.currentReadOffset));
+  uint64_t found = xorChain(
+      stream.recentlyRead.front(),
+      readOffset - stream.recentlyRead.chainLength(),
+      stream.recentlyRead.chainLength(),
+      offset,
+      length,
+      out);
+  for (const auto& buf : stream.readBuffer) {
+    if (buf.offset >= offset + length) {
+      break;
+    }
+    found += xorChain(
+        buf.data.front(),
+        buf.offset,
+        buf.data.chainLength(),
+        offset,
+        length,
+        out);
+  }
+  return found;
+}
+
+// Whether the app is done writing to the stream for now, so that the data it
+// sent last is the tail of what it sends.
+bool streamIsIdle(const QuicStreamState& stream) {
+  return !stream.hasWritableData() && stream.lossBuffer.empty();
+}
+
+} // namespace
+
+bool maybeScheduleStreamRepair(QuicConnectionStateBase& conn) {
+  auto& repairState = conn.streamRepairState;
+  auto budget = conn.transportSettings.streamRepairBudget;
+  if (!repairState.peerReceiveWindow || repairState.streams.empty() ||
+      repairState.bytesSent >= budget) {
+    return false;
+  }
+  if (conn.udpSendPacketLen <= kStreamRepairPacketOverhead) {
+    return false;
+  }
+  auto stripeLength = conn.udpSendPacketLen - kStreamRepairPacketOverhead;
+  auto maxFrames = std::min<uint64_t>(
+      conn.transportSettings.streamRepairMaxFrames, kMaxStreamRepairFrames);
+  bool scheduled = false;
+  auto& streams = repairState.streams;
+  for (auto itr = streams.begin(); itr != streams.end();) {
+    if (!conn.streamManager->streamExists(*itr)) {
+      itr = streams.erase(itr);
+      continue;
+    }
+    auto& stream = *conn.streamManager->getStream(*itr);
+    ++itr;
+    if (!streamIsIdle(stream)) {
+      continue;
+    }
+    // The last maxFrames stream frames sent past what is covered already,
+    // with data, that fit the receive window of the peer.
+    std::vector<const StreamBuffer*> tail;
+    uint64_t tailLength = 0;
+    auto& retxBuffer = stream.retransmissionBuffer;
+    auto first = retxBuffer.lower_bound(stream.repairedOffset);
+    for (auto bufItr = retxBuffer.end();
+         bufItr != first && tail.size() < maxFrames;) {
+      --bufItr;
+      const StreamBuffer& buf = bufItr->second;
+      auto length = buf.data.chainLength();
+      if (length == 0) {
+        continue;
+      }
+      if (tailLength + length > repairState.peerReceiveWindow) {
+        break;
+      }
+      tail.push_back(&buf);
+      tailLength += length;
+    }
+    // One frame alone is just as well retransmitted.
+    if (tail.size() < 2) {
+      continue;
+    }
+    std::reverse(tail.begin(), tail.end());
+    uint64_t longest = 0;
+    for (auto buf : tail) {
+      longest = std::max<uint64_t>(longest, buf->data.chainLength());
+    }
+    // Each stripe costs a repair as long as its longest piece.
+    if (repairState.bytesSent + longest > budget) {
+      return scheduled;
+    }
+    const StreamBuffer& last = *tail.back();
+    auto lastLength = last.data.chainLength();
+    auto numStripes = (longest + stripeLength - 1) / stripeLength;
+    for (uint64_t stripe = 0; stripe < numStripes; ++stripe) {
+      auto stripeOffset = stripe * stripeLength;
+      std::vector<StreamRepairFrame::Range> ranges;
+      uint64_t repairLength = 0;
+      for (auto buf : tail) {
+        auto length = buf->data.chainLength();
+        if (length > stripeOffset) {
+          ranges.push_back(
+              {buf->offset + stripeOffset,
+               std::min<uint64_t>(stripeLength, length - stripeOffset)});
+          repairLength = std::max(repairLength, ranges.back().length);
+        }
+      }
+      auto repair = folly::IOBuf::create(repairLength);
+      repair->append(repairLength);
+      memset(repair->writableData(), 0, repairLength);
+      for (size_t i = 0; i < tail.size(); ++i) {
+        xorChain(
+            tail[i]->data.front(),
+            tail[i]->offset,
+            tail[i]->data.chainLength(),
+            tail[i]->offset + stripeOffset,
+            repairLength,
+            repair->writableData());
+      }
+      // Only the stripe holding the end of the last frame can tell the FIN.
+      bool fin = last.eof && stripeOffset < lastLength &&
+          stripeOffset + stripeLength >= lastLength;
+      conn.pendingEvents.frames.emplace_back(StreamRepairFrame(
+          stream.id, std::move(ranges), fin, std::move(repair)));
+      repairState.bytesSent += repairLength;
+    }
+    stream.repairedOffset = last.offset + lastLength;
+    scheduled = true;
+  }
+  return scheduled;
+}
+
+void onRecvStreamRepairFrame(
+    QuicConnectionStateBase& conn,
+    const StreamRepairFrame& frame) {
+  if (!frame.repair || frame.ranges.empty() ||
+      !conn.streamManager->streamExists(frame.streamId)) {
+    return;
+  }
+  auto& stream = *conn.streamManager->getStream(frame.streamId);
+  folly::Optional<size_t> missing;
+  for (size_t i = 0; i < frame.ranges.size(); ++i) {
+    const auto& range = frame.ranges[i];
+    if (xorReceivedData(stream, range.offset, range.length, nullptr) <
+        range.length) {
+      if (missing) {
+        // More than one is lost, nothing to be done.
+        return;
+      }
+      missing = i;
+    }
+  }
+  if (!missing) {
+    return;
+  }
+  auto repairLength = frame.repair->computeChainDataLength();
+  auto data = folly::IOBuf::create(repairLength);
+  data->append(repairLength);
+  folly::io::Cursor(frame.repair.get())
+      .pull(data->writableData(), repairLength);
+  for (size_t i = 0; i < frame.ranges.size(); ++i) {
+    if (i != *missing) {
+      const auto& range = frame.ranges[i];
+      xorReceivedData(
+          stream, range.offset, range.length, data->writableData());
+    }
+  }
+  const auto& range = frame.ranges[*missing];
+  data->trimEnd(repairLength - range.length);
+  VLOG(10) << "Rebuilt stream data from STREAM_REPAIR stream=" << stream.id
+           << " offset=" << range.offset << " len=" << range.length << " "
+           << conn;
+  receiveReadStreamFrameSMHandler(
+      stream,
+      ReadStreamFrame(
+          stream.id,
+          range.offset,
+          std::move(data),
+          frame.fin && *missing + 1 == frame.ranges.size()));
+}
+
+} // namespace quic
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/Types.h>
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+/**
+ * Experimental stream repair. Once a connection has nothing else to send, the
+ * unacked tail of the streams the app protects, up to streamRepairMaxFrames
+ * stream frames of each, is covered with STREAM_REPAIR frames, so that the
+ * loss of any one of those frames doesn't cost the peer a PTO. The frames are
+ * cut into stripes that fit a packet, a repair frame covering the same stripe
+ * of each of them. Queues the repair frames as pending simple frames, within
+ * the streamRepairBudget and the receive window of the peer, and returns
+ * whether it queued any.
+ */
+bool maybeScheduleStreamRepair(QuicConnectionStateBase& conn);
+
+/**
+ * Rebuilds the range of the stream a STREAM_REPAIR frame covers when it is
+ * the only one missing, from the ones that were received, read or not, and
+ * hands it to the stream like a STREAM frame.
+ */
+void onRecvStreamRepairFrame(
+    QuicConnectionStateBase& conn,
+    const StreamRepairFrame& frame);
+
+} // namespace quic
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/TransportSettings.h>
+
+#include <algorithm>
+
+namespace quic {
+
+void applyJumboFrameProfile(TransportSettings& settings) {
+  settings.maxRecvPacketSize = kJumboFrameUDPPayload;
+  settings.pmtuDiscoveryEnabled = true;
+  settings.maxPmtuProbeSize = kJumboFrameUDPPayload;
+  settings.advertisedInitialConnectionWindowSize = std::max(
+      settings.advertisedInitialConnectionWindowSize,
+      kJumboFrameConnectionWindowSize);
+  settings.advertisedInitialBidiLocalStreamWindowSize = std::max(
+      settings.advertisedInitialBidiLocalStreamWindowSize,
+      kJumboFrameStreamWindowSize);
+  settings.advertisedInitialBidiRemoteStreamWindowSize = std::max(
+      settings.advertisedInitialBidiRemoteStreamWindowSize,
+      kJumboFrameStreamWindowSize);
+  settings.advertisedInitialUniStreamWindowSize = std::max(
+      settings.advertisedInitialUniStreamWindowSize,
+      kJumboFrameStreamWindowSize);
+}
+
+size_t packetBufferPoolBufSize(const TransportSettings& settings) {
+  uint64_t packetSize = settings.maxRecvPacketSize;
+  if (settings.pmtuDiscoveryEnabled) {
+    packetSize = std::max<uint64_t>(packetSize, settings.maxPmtuProbeSize);
+  }
+  return std::max<size_t>(
+      kDefaultUDPReadBufferSize, packetSize + kPacketBufferPoolHeadroom);
+}
+
+} // namespace quic
@@ -10,6 +10,7 @@
 
 #include <quic/QuicConstants.h>
 #include <chrono>
+#include <string>
 
 namespace quic {
 
@@ -48,18 +49,60 @@ struct TransportSettings {
   uint64_t advertisedInitialUniStreamWindowSize{kDefaultStreamWindowSize};
   uint64_t advertisedInitialMaxStreamsBidi{kDefaultMaxStreamsBidirectional};
   uint64_t advertisedInitialMaxStreamsUni{kDefaultMaxStreamsUnidirectional};
+  // Whether the stream limits double, up to maxAutoTunedStreamLimit, when the
+  // peer closes enough streams for a limit update before
+  // flowControlRttFrequency * RTT passed since the last update.
+  bool autoTuneStreamLimits{false};
+  uint64_t maxAutoTunedStreamLimit{kDefaultMaxAutoTunedStreamLimit};
+  // Writes the application can queue from other threads at a time through
+  // QuicSocket::getCrossThreadWriteQueue, 0 for no such queue.
+  size_t crossThreadWriteQueueCapacity{0};
+  // Whether a write of only acks, e.g. for the packets just read, waits for
+  // the read callbacks scheduled for the next loop rather than going out in
+  // this one, so that the data they write carries the acks.
+  bool deferAckOnlyWrites{false};
+  // Writes of at most this many bytes are sent from writeChain right away,
+  // rather than at the end of the loop, when the congestion and flow control
+  // and the pacer allow it. Larger writes are left to the write looper to
+  // batch. 0 to always leave them to it.
+  uint64_t writeThroughMaxBytes{0};
   // Maximum number of packets to buffer while cipher is unavailable.
   uint32_t maxPacketsToBuffer{kDefaultMaxBufferedPackets};
   // Idle timeout to advertise to the peer.
   std::chrono::milliseconds idleTimeout{kDefaultIdleTimeout};
+  // How long a connection without streams or packets in flight has to be
+  // idle before the memory it keeps for them is freed, zero to never free it.
+  std::chrono::milliseconds idleMemoryReleaseTimeout{0};
   // Ack delay exponent to use.
   uint64_t ackDelayExponent{kDefaultAckDelayExponent};
   // Default congestion controller type.
   CongestionControlType defaultCongestionController{
       CongestionControlType::Cubic};
+  // Name of a controller registered with CongestionControllerRegistry. When
+  // set, the default factory makes that controller instead of the
+  // defaultCongestionController, and hands it congestionControllerParams,
+  // which is opaque to the transport. Unknown names fall back to the default
+  // controller.
+  folly::Optional<std::string> congestionControllerName;
+  std::string congestionControllerParams;
   // Param to determine sensitivity of CongestionController to latency. Only
   // used by COPA.
   folly::Optional<double> latencyFactor;
+  // Whether Copa switches to its competitive mode, with a delta adapted to
+  // the loss based flows it shares the bottleneck with, when its queueing
+  // delay never drains. Copa otherwise always uses latencyFactor.
+  bool copaCompetitiveMode{false};
+  // Whether Cubic and NewReno end their first slow start with HyStart++
+  // (RFC 9406). Cubic otherwise uses its own hystart, NewReno only leaves slow
+  // start on loss.
+  bool hystartPlusPlus{false};
+  // Whether Cubic computes its steady state cwnd with integer math instead of
+  // floating point.
+  bool cubicFixedPoint{false};
+  // Whether a client resuming a connection to a host it has a psk for jumps
+  // its cwnd to the one of the last connection, after the rtt of the path
+  // confirms it, with careful resume. Only Cubic and NewReno support it.
+  bool carefulResume{false};
   // The max UDP packet size we are willing to receive.
   uint64_t maxRecvPacketSize{kDefaultUDPReadBufferSize};
   // Can we ignore the path mtu when sending a packet. This is useful for
@@ -67,10 +110,15 @@ struct TransportSettings {
   bool canIgnorePathMTU{false};
   // Whether or not to use a connected UDP socket on the client. This should
   // only be used in environments where you know your IP address does not
-  // change. See AsyncUDPSocket::connect for the caveats.
+  // change. See AsyncUDPSocket::connect for the caveats. With happy eyeballs
+  // the socket is connected to the address that wins the race.
   bool connectUDP{false};
   // Maximum number of consecutive PTOs before the connection is torn down.
   uint16_t maxNumPTOs{kDefaultMaxNumPTO};
+  // Whether the first PTO of an idle tail probes it with a single PING
+  // instead of cloning the outstanding packets. Later PTOs still clone, and
+  // probes with new stream data to send carry it either way.
+  bool adaptivePTOProbes{false};
   // Whether to turn off PMTUD on the socket
   bool turnoffPMTUD{false};
   // Whether to listen to socket error
@@ -82,6 +130,20 @@ struct TransportSettings {
   // Pacing timer tick interval
   std::chrono::microseconds pacingTimerTickInterval{
       kDefaultPacingTimerTickInterval};
+  // Paced connections write their whole window at once and stamp the packets
+  // with SO_TXTIME departure times from the pacer instead of waking up on the
+  // pacing timer. The times are only enforced with the fq qdisc.
+  bool txTimePacing{false};
+  // Pace with a TokenBucketPacer, which keeps the rate at high bandwidths
+  // and sends bursts of minBurstPackets, instead of the DefaultPacer.
+  bool tokenBucketPacing{false};
+  // One in this many paced connections report how their send rate holds up
+  // against the pacing rate to the stats callback, see
+  // PacingAccuracyObserver. 0 for none.
+  uint32_t pacingObserverSampleRate{0};
+  // The interval they report it over.
+  std::chrono::milliseconds pacingObserverInterval{
+      kDefaultPacingObserverInterval};
   ZeroRttSourceTokenMatchingPolicy zeroRttSourceTokenMatchingPolicy{
       ZeroRttSourceTokenMatchingPolicy::LIMIT_IF_NO_EXACT_MATCH};
   bool attemptEarlyData{true};
@@ -97,11 +159,83 @@ struct TransportSettings {
   // Frequency of sending flow control updates. We can send one update every
   // flowControlWindowFrequency * window if the flow control changes.
   uint16_t flowControlWindowFrequency{2};
+  // Whether the receive windows double, up to the max sizes below, when the
+  // application reads a window before flowControlRttFrequency * RTT passed
+  // since the last update.
+  bool autoTuneFlowControlWindows{false};
+  uint64_t maxAutoTunedStreamWindowSize{kDefaultMaxAutoTunedStreamWindowSize};
+  uint64_t maxAutoTunedConnectionWindowSize{
+      kDefaultMaxAutoTunedConnectionWindowSize};
+  // Server only: bytes the auto tuned connection windows of a worker can grow
+  // by in total, 0 for no limit.
+  uint64_t autoTunedWindowWorkerBudget{0};
+  // Server only: bytes the connections of a worker can hold received and not
+  // read yet in total before their receive windows stop growing and shrink,
+  // 0 for no limit.
+  uint64_t workerReceiveBufferLimit{0};
+  // Only stream window updates about to run out of window trigger a write,
+  // the others go out with packets written anyway, e.g. for acks, and take up
+  // to maxCoalescedWindowUpdateBytes of each.
+  bool coalesceStreamWindowUpdates{false};
+  uint32_t maxCoalescedWindowUpdateBytes{
+      kDefaultMaxCoalescedWindowUpdateBytes};
   // batching mode
   QuicBatchingMode batchingMode{QuicBatchingMode::BATCHING_MODE_NONE};
   // maximum number of packets we can batch. This does not apply to
   // BATCHING_MODE_NONE
   uint32_t maxBatchSize{kDefaultQuicMaxBatchSize};
+  // Pick the batch size for each write from the pacer and the congestion
+  // window instead of using maxBatchSize.
+  bool adaptiveWriteBatchSize{false};
+  // Number of packet buffers kept around for reuse by the write path. 0
+  // disables buffer pooling.
+  uint32_t packetBufferPoolSize{0};
+  // Carve the pooled buffers out of 2MB huge pages allocated with the pool,
+  // see HugePageRegion.
+  bool packetBufferPoolHugePages{false};
+  // Server only: accumulate the packets of all the connections of a worker
+  // and write them with one sendmmsg per event loop iteration.
+  bool batchWritesAcrossConnections{false};
+  // Server only: packets forwarded to the process being taken over are
+  // written maxBatchSize at a time with sendmmsg, and GSO where the socket
+  // supports it, instead of one write each.
+  bool batchForwardedPackets{false};
+  // Server only: unpaced connections of a worker write together from one
+  // callback at the end of the event loop iteration instead of from their own
+  // write loopers.
+  bool deferWritesToEndOfLoop{false};
+  // Server only: with deferWritesToEndOfLoop, the bytes a connection may write
+  // per round of the deficit round robin between the connections of the
+  // worker. 0 lets each connection write as much as its own limits allow.
+  uint64_t deferredWriteQuantum{0};
+  // Server only: how many bytes and how long the deferred writes of a worker
+  // may take per loop iteration before the connections left wait for the
+  // next one. 0 for no limit.
+  uint64_t deferredWriteLoopBytesBudget{0};
+  std::chrono::microseconds deferredWriteLoopTimeBudget{0};
+  // Server only: the priority class of the connection in the deferred writes
+  // of the worker, below kDeferredWritePriorityClasses. The connections of a
+  // class write before those of the classes above it, usually set from a
+  // TransportSettingsOverrideFn.
+  uint8_t deferredWritePriority{0};
+  // Server only: paced connections of a worker wait in one calendar of
+  // pacing timer ticks, and all the writes due in a tick run together.
+  bool sharedPacingCalendar{false};
+  // Server only: the loopers of the connections of a worker run from one
+  // ready queue, up to maxLooperRunsPerLoop of them per loop iteration,
+  // instead of as loop callbacks of their own.
+  bool sharedLooperQueue{false};
+  uint32_t maxLooperRunsPerLoop{kDefaultMaxLooperRunsPerLoop};
+  // Server only: the connections of a worker take the time for the
+  // bookkeeping of reads and streams from one clock read at the start of
+  // every loop iteration and on every batch of socket reads.
+  bool coarseClock{false};
+  // Server only: the Cubic and NewReno connections of a worker from the same
+  // client subnet share one congestion controller, and split its cwnd.
+  bool congestionControlGroups{false};
+  // Send large GSO batches with MSG_ZEROCOPY. The completions arrive on the
+  // socket error queue, so this needs enableSocketErrMsgCallback as well.
+  bool enableZeroCopySend{false};
   // Sets network unreachable to be a non fatal error. In some environments,
   // EHOSTUNREACH or ENETUNREACH could just be because the routing table is
   // being setup. This option makes those non fatal connection errors.
@@ -122,6 +256,11 @@ struct TransportSettings {
   uint64_t maxCwndInMss{kDefaultMaxCwndInMss};
   // Limited congestion window in MSS
   uint64_t limitedCwndInMss{kLimitedCwndInMss};
+  // Caps on the congestion state a connection with a congestion state cache
+  // starts from: the cwnd it starts with, and how old the cached state may
+  // be.
+  uint64_t warmStartMaxCwndInMss{kDefaultWarmStartMaxCwndInMss};
+  std::chrono::seconds warmStartMaxAge{kDefaultWarmStartMaxAge};
   // The following three parameters control ACK generation. ACKs are sent every
   // time so many retransmittable packets are received. There are two values,
   // one for earlier in the flow and one for after. These are "before" and
@@ -130,20 +269,126 @@ struct TransportSettings {
       kDefaultRxPacketsBeforeAckInitThreshold};
   uint16_t rxPacketsBeforeAckBeforeInit{kDefaultRxPacketsBeforeAckBeforeInit};
   uint16_t rxPacketsBeforeAckAfterInit{kDefaultRxPacketsBeforeAckAfterInit};
+  // Whether to advertise min_ack_delay and follow the ACK_FREQUENCY and
+  // IMMEDIATE_ACK frames of the peer, and, if the peer advertised it too, ask
+  // it to ack less often as the congestion window grows.
+  bool ackFrequencyEnabled{false};
+  // max_datagram_frame_size to advertise, 0 not to take DATAGRAM frames.
+  uint16_t maxRecvDatagramFrameSize{0};
+  // Datagrams the send and receive queues hold, the oldest ones are dropped
+  // once they are full.
+  uint32_t datagramWriteBufferSize{kDefaultMaxDatagramsBuffered};
+  // Experimental STREAM_REPAIR frames. Bytes of each stream's read data to
+  // keep around for undoing the repair frames of the peer, advertised to it,
+  // 0 not to take them.
+  uint64_t streamRepairReceiveWindow{0};
+  // Bytes of repair frames the connection may send for the streams the app
+  // asked to protect, once the peer advertised it takes them, 0 for none.
+  uint64_t streamRepairBudget{0};
+  // Stream frames the XOR of a repair frame covers, the fewer the more of
+  // them one repair frame can bring back, but the more repair data is sent.
+  uint32_t streamRepairMaxFrames{kDefaultStreamRepairMaxFrames};
+  uint32_t datagramReadBufferSize{kDefaultMaxDatagramsBuffered};
+  // The share of the packets, in percent, datagrams get while there is stream
+  // data to write too. They are written first within it.
+  uint8_t datagramWriteSharePercent{kDefaultDatagramWriteSharePercent};
+  // Whether to probe the path with padded PING packets for a larger packet
+  // size than udpSendPacketLen, up to maxPmtuProbeSize and the
+  // max_packet_size of the peer.
+  bool pmtuDiscoveryEnabled{false};
+  uint16_t maxPmtuProbeSize{kDefaultMaxPmtuProbeSize};
+  // Whether the streams readable at once that share a read callback are
+  // handed to its readAvailableBatch in one call, instead of to
+  // readAvailable one at a time.
+  bool batchReadCallbacks{false};
+  // Whether the acks of all the packets of a read batch are handed to the
+  // congestion controller as one AckEvent and LossEvent, instead of one per
+  // ack frame.
+  bool batchAckEvents{false};
+  // Whether stream writes of at most packedStreamWriteMaxLength bytes are
+  // copied into pages of the stream's write buffer instead of being chained
+  // one buffer per write. The stream frames and the retransmission buffer
+  // take slices of the pages, so writing a packet walks fewer buffers.
+  bool packSmallStreamWrites{false};
+  size_t packedStreamWriteMaxLength{kDefaultPackedStreamWriteMaxLength};
+  size_t packedStreamWritePageSize{kDefaultPackedStreamWritePageSize};
   // Limits the amount of data that should be buffered in a QuicSocket.
   // If the amount of data in the buffer equals or exceeds this amount, then
   // the callback registered through notifyPendingWriteOnConnection() will
   // not be called
   uint64_t totalBufferSpaceAvailable{kDefaultBufferSpaceAvailable};
+  // Whether the data written to the socket and not yet acked also counts
+  // towards totalBufferSpaceAvailable, so that writers are held back by all
+  // the bytes the transport keeps for them and not only the unsent ones.
+  bool bufferSpaceIncludesUnackedData{false};
   // Whether or not to advertise partial reliability capability
   bool partialReliabilityEnabled{false};
   // Whether the endpoint allows peer to migrate to new address
   bool disableMigration{true};
+  // The packets worth of data sent to a migrated peer per rtt until its new
+  // address is validated. The path challenge goes out with the data, this is
+  // what the data is limited to meanwhile. The minimum congestion window by
+  // default, as the draft says. Raising it, e.g. to kInitCwndInMss, keeps the
+  // data from stalling while the challenge is outstanding.
+  uint64_t pathValidationCreditInMss{kMinCwndInMss};
   // Whether or not the socket should gracefully drain on close
   bool shouldDrain{true};
+  // Server only: a closed connection drains as an entry of its worker that
+  // holds just its last close packet, and the transport is freed right away.
+  bool compactDrainingConnections{false};
   // default stateless reset secret for stateless reset token
   folly::Optional<std::array<uint8_t, kStatelessResetTokenSecretLength>>
       statelessResetTokenSecret;
+  // Server only: once a worker started this many handshakes within
+  // kHandshakeAdmissionWindow, or spent this long on the first flights of
+  // the new connections in it, new clients are sent a Retry and only get a
+  // handshake once they come back with its token. 0 for no limit.
+  uint32_t retryHandshakeRateLimit{0};
+  std::chrono::microseconds retryHandshakeTimeBudget{0};
+  // Server only: a worker degrades what it offers new connections as its
+  // load grows, see OverloadController: new clients Retry first, then 0-RTT
+  // is not accepted, then new connections get smaller initial windows, and
+  // then they are rejected. Its load is the largest of its busy share of the
+  // loop, its longest loop over overloadMaxLoopLag, and the bytes its
+  // connections hold received and not read over overloadMemoryBudget, 0 to
+  // leave the memory out.
+  bool overloadControl{false};
+  std::chrono::microseconds overloadMaxLoopLag{kDefaultOverloadMaxLoopLag};
+  uint64_t overloadMemoryBudget{0};
+  // Server only: whether resuming handshakes accept 0-RTT data.
+  bool acceptZeroRtt{true};
+  // Server only: number of (version, connection id) pairs a worker keeps the
+  // Initial ciphers of, for clients whose handshake starts more than once.
+  // 0 to derive them for every connection.
+  size_t initialCipherCacheSize{0};
+  // Server only: number of resumption app tokens a worker keeps decoded, for
+  // clients resuming from the same ticket more than once. 0 to decode them
+  // for every connection.
+  size_t appTokenCacheSize{0};
+  // Server only: number of sets of transport settings a worker keeps the
+  // encoded transport parameters of, so that a handshake only encodes the
+  // parameters of its connection. 0 to encode them all for every connection.
+  size_t transportParametersCacheSize{0};
+  // Server only: stateless resets a worker sends within
+  // kStatelessResetRateLimitWindow at most, so that a spray of packets for
+  // unknown connections doesn't make it write as many resets. 0 for no limit.
+  uint32_t statelessResetRateLimit{0};
+  // Server only: version negotiation packets a worker sends within
+  // kVersionNegotiationRateLimitWindow at most, the Initials of unsupported
+  // versions past it are dropped. 0 for no limit.
+  uint32_t versionNegotiationRateLimit{0};
+  // Server only: number of connection ids a worker keeps the stateless reset
+  // tokens of, for peers that keep sending to a connection that is gone. 0 to
+  // derive the token for every reset.
+  size_t statelessResetTokenCacheSize{0};
+  // Server only: number of connection ids, with their stateless reset tokens,
+  // a worker makes at once for its connections to take from. 0 makes each
+  // as it is needed.
+  size_t connectionIdPoolSize{0};
+  // Start a key update once the 1-RTT keys protected this many packets, to
+  // stay well within the AEAD's confidentiality limit on long connections.
+  // Key updates of the peer are followed either way. 0 to never start one.
+  uint64_t keyUpdatePacketInterval{0};
   // Default initial RTT
   std::chrono::microseconds initialRtt{kDefaultInitialRtt};
   // The active_connection_id_limit that is sent to the peer.
@@ -153,8 +398,61 @@ struct TransportSettings {
   size_t maxRecvBatchSize{5};
   // Whether or not we should recv data in a batch.
   bool shouldRecvBatch{false};
-  // Whether or not use recvmmsg when shouldRecvBatch is true.
+  // Whether or not use recvmmsg when shouldRecvBatch is true. A server worker
+  // only reads in batches with recvmmsg.
   bool shouldUseRecvmmsgForBatchRecv{false};
+  // Let the kernel coalesce received datagrams with UDP_GRO, they are split
+  // back into packets without copying. Only used by batch reads.
+  bool enableUdpGRO{false};
+  // Send our packets with ECT(0), read the ECN bits of the received ones and
+  // report them in ACK_ECN frames. CE marks reported by the peer are handed
+  // to the congestion controller. Marking stops if the peer's counts don't
+  // add up. The ECN bits are only read by batch reads.
+  bool enableEcn{false};
+  // Take the receive time of the packets from the kernel's SO_TIMESTAMPNS
+  // rather than from when the event loop got to them, so that the time they
+  // queued in the loop doesn't count into the RTT samples or the ack delay
+  // reported to the peer. Only used by batch reads.
+  bool enableRxTimestamps{false};
+  // Read the sockets through an io_uring, with a multishot recvmsg into
+  // ioUringRecvBuffers buffers registered with it, see IOUringReceiver. The
+  // packets are handled like batch reads: GRO, ECN and rx timestamps apply.
+  // Needs liburing and a 6.0 kernel, the sockets are read as usual without.
+  // A client only uses it without happy eyeballs.
+  bool ioUringRecv{false};
+  // A power of two. Each takes maxRecvPacketSize bytes, or 64KB with GRO.
+  uint32_t ioUringRecvBuffers{1024};
+  // Let a server worker drop packets that can't be QUIC packets for it by
+  // looking at their first bytes, before they are handed off for routing. Not
+  // used while a health check token is set, as health checks are not QUIC.
+  bool prefilterReceivedPackets{false};
+  // Number of slots, rounded up to a power of two, of the direct-indexed table
+  // a server worker looks up short header connection ids in before its
+  // connection id map. 0 disables the table.
+  size_t connectionIdRoutingTableSize{0};
+  // Capacity of the single producer single consumer queue that every pair of
+  // server workers hands misrouted packets through. 0 schedules a callback on
+  // the destination worker for every packet instead.
+  uint32_t workerForwardingQueueSize{0};
+  // Maximum number of connections a server worker creates per event loop
+  // iteration. Initials for further new connections wait in the worker's
+  // accept queue, so that a burst of handshakes doesn't hold up established
+  // connections. 0 creates connections as their Initials arrive.
+  size_t maxAcceptsPerLoop{0};
+  // Packets that find the accept queue this full are dropped.
+  size_t maxAcceptQueueSize{kDefaultMaxAcceptQueueSize};
+  // Keep a copy of the plaintext body of every sent short header packet, so
+  // that a probe cloning the packet can resend the body as is when its frames
+  // are still valid, instead of rebuilding it frame by frame.
+  bool resendClonedPacketBody{false};
+  // Only move the loss timer earlier when it is rescheduled. A later deadline
+  // is just recorded, and the timer re-arms itself for the rest of the wait
+  // when it fires early, so rescheduling on every ack and send is cheap.
+  bool lazyLossTimeoutRearm{false};
+  // Only record when the idle timer is reset, instead of rescheduling it on
+  // every packet. The idle timers re-arm themselves for the rest of the wait
+  // when they fire.
+  bool lazyIdleTimeoutRearm{false};
   // Config struct for BBR
   BbrConfig bbrConfig;
   // A packet is considered loss when a packet that's sent later by at least
@@ -162,6 +460,39 @@ struct TransportSettings {
   DurationRep timeReorderingThreshDividend{
       kDefaultTimeReorderingThreshDividend};
   DurationRep timeReorderingThreshDivisor{kDefaultTimeReorderingThreshDivisor};
+  // Detect loss the RACK way: a packet is lost once a packet sent after it is
+  // acked and an rtt plus a reordering window have passed since it was sent.
+  // The window adapts to the reordering seen on the connection and, once
+  // there was any, the packet reordering threshold is no longer used.
+  bool useRackLossDetection{false};
+  // Remember the latest lost packets, so that an ack for one of them is known
+  // to be for a spurious loss and the congestion controller can undo it.
+  bool detectSpuriousLoss{false};
+  // Have the transports of a server worker count the per packet stats events,
+  // e.g. packets sent and bytes read, in the worker's counters instead of
+  // calling the stats callback for each, see QuicTransportStatsCounters. The
+  // callback gets what was counted every statsCountersInterval.
+  bool useStatsCounters{false};
+  std::chrono::milliseconds statsCountersInterval{
+      kDefaultStatsCountersInterval};
 };
 
+/**
+ * Profile for connections inside a datacenter, whose paths have a 9000 byte
+ * MTU end to end. The max_packet_size advertised to the peer, and so the
+ * read buffers, are raised to a jumbo packet, and path MTU discovery raises
+ * udpSendPacketLen to one a round trip after the handshake. The flow control
+ * windows are raised to keep a number of packets in flight like the default
+ * ones do at 1.5K. The congestion control settings count MSS and scale with
+ * the packet size by themselves. Applied on top of the other settings.
+ */
+void applyJumboFrameProfile(TransportSettings& settings);
+
+/**
+ * Size of the buffers of the PacketBufferPool for connections with these
+ * settings, large enough for the largest packets they send, so that those
+ * do not bypass the pool.
+ */
+size_t packetBufferPoolBufSize(const TransportSettings& settings);
+
 } // namespace quic
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// Ack processing and loss detection with 1K to 100K packets in flight. The
+// window is kept full, every ack is followed by the sends it makes room for,
+// which are not timed. The *PerAck benchmarks count the acks, the
+// *PerAckedPacket ones the packets they acked, of the same runs.
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/lang/Assume.h>
+
+#include <quic/loss/QuicLossFunctions.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/AckHandlers.h>
+
+using namespace quic;
+
+namespace {
+
+enum class AckPattern {
+  // Everything arrives, an ack every other packet.
+  Contiguous,
+  // One packet in 10 lost, acks of many ranges.
+  Sparse,
+  // Each packet arrives after the next one.
+  Reordered,
+  // One packet in 3 lost.
+  HeavyLoss,
+};
+
+// As many ranges as a receiver would report in an ack.
+constexpr size_t kMaxBenchAckBlocks = 32;
+// Packets acked by each ack.
+constexpr PacketNum kPacketsPerAck = 2;
+constexpr std::chrono::microseconds kBenchRtt = 10ms;
+
+class AckBench {
+ public:
+  AckBench(AckPattern pattern, size_t window)
+      : pattern_(pattern), window_(window), start_(Clock::now()) {
+    sendUpTo(window_);
+  }
+
+  // Processes the next ack, returns the packets it acked.
+  uint64_t ackNext() {
+    largestAcked_ += kPacketsPerAck;
+    auto ackFrame = makeAck(largestAcked_);
+    auto outstandingBefore = conn_.outstandingPackets.size();
+    lostPackets_ = 0;
+    processAckFrame(
+        conn_,
+        PacketNumberSpace::AppData,
+        ackFrame,
+        [](const auto&, const auto&, const auto&) {},
+        [this](auto&, auto&, bool, PacketNum) { lostPackets_++; },
+        sentTime(largestAcked_) + kBenchRtt);
+    return outstandingBefore - conn_.outstandingPackets.size() - lostPackets_;
+  }
+
+  // Fills the window up again.
+  void sendMore() {
+    sendUpTo(largestAcked_ + window_);
+  }
+
+  QuicConnectionStateBase& getConn() {
+    return conn_;
+  }
+
+  TimePoint sentTime(PacketNum packetNum) const {
+    return start_ + std::chrono::microseconds(packetNum);
+  }
+
+ private:
+  bool received(PacketNum packetNum) const {
+    switch (pattern_) {
+      case AckPattern::Sparse:
+        return packetNum % 10 != 0;
+      case AckPattern::HeavyLoss:
+        return packetNum % 3 != 0;
+      case AckPattern::Reordered:
+        // Overtaken by the largest, it arrives with the next ack.
+        return packetNum != largestAcked_ - 1;
+      case AckPattern::Contiguous:
+        return true;
+    }
+    folly::assume_unreachable();
+  }
+
+  ReadAckFrame makeAck(PacketNum largest) const {
+    ReadAckFrame ackFrame;
+    ackFrame.largestAcked = largest;
+    // Nothing older is still outstanding.
+    PacketNum oldest = largest > 2 * window_ ? largest - 2 * window_ : 1;
+    PacketNum packetNum = largest;
+    while (packetNum >= oldest &&
+           ackFrame.ackBlocks.size() < kMaxBenchAckBlocks) {
+      while (packetNum >= oldest && !received(packetNum)) {
+        packetNum--;
+      }
+      if (packetNum < oldest) {
+        break;
+      }
+      PacketNum end = packetNum;
+      // The losses are periodic, so this stays short unless nothing is lost.
+      if (pattern_ == AckPattern::Contiguous) {
+        packetNum = oldest - 1;
+      } else {
+        while (packetNum >= oldest && received(packetNum)) {
+          packetNum--;
+        }
+      }
+      ackFrame.ackBlocks.emplace_back(packetNum + 1, end);
+    }
+    return ackFrame;
+  }
+
+  void sendUpTo(PacketNum last) {
+    for (; nextPacketNum_ <= last; ++nextPacketNum_) {
+      RegularQuicWritePacket packet(ShortHeader(
+          ProtectionType::KeyPhaseZero,
+          ConnectionId(std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}),
+          nextPacketNum_));
+      packet.frames.emplace_back(
+          WriteStreamFrame(4, nextPacketNum_ * 1200, 1200, false));
+      conn_.lossState.totalBytesSent += 1252;
+      auto& appDataPackets =
+          conn_.outstandingPackets[PacketNumberSpace::AppData];
+      appDataPackets.emplace_back(
+          std::move(packet),
+          sentTime(nextPacketNum_),
+          1252,
+          false,
+          conn_.lossState.totalBytesSent);
+      conn_.congestionController->onPacketSent(appDataPackets.back());
+    }
+  }
+
+  QuicServerConnectionState conn_;
+  AckPattern pattern_;
+  PacketNum window_;
+  TimePoint start_;
+  PacketNum nextPacketNum_{1};
+  PacketNum largestAcked_{0};
+  uint64_t lostPackets_{0};
+};
+
+unsigned runAcks(
+    unsigned iters,
+    AckPattern pattern,
+    size_t window,
+    bool perAckedPacket) {
+  folly::Optional<AckBench> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(pattern, window);
+  }
+  uint64_t ackedPackets = 0;
+  for (unsigned i = 0; i < iters; ++i) {
+    ackedPackets += bench->ackNext();
+    BENCHMARK_SUSPEND {
+      bench->sendMore();
+    }
+  }
+  BENCHMARK_SUSPEND {
+    bench.clear();
+  }
+  return perAckedPacket ? std::max<uint64_t>(ackedPackets, 1) : iters;
+}
+
+unsigned perAck(unsigned iters, AckPattern pattern, size_t window) {
+  return runAcks(iters, pattern, window, false);
+}
+
+unsigned perAckedPacket(unsigned iters, AckPattern pattern, size_t window) {
+  return runAcks(iters, pattern, window, true);
+}
+
+// Loss detection after an ack of the newest packet when nothing is lost,
+// with the window outstanding behind it. What it costs to find out that the
+// oldest packet is not lost.
+void detectNoLoss(size_t iters, size_t window) {
+  folly::Optional<AckBench> bench;
+  BENCHMARK_SUSPEND {
+    bench.emplace(AckPattern::Contiguous, window);
+  }
+  auto& conn = bench->getConn();
+  // Neither threshold declares anything lost.
+  conn.lossState.srtt = 10s;
+  conn.lossState.lrtt = 10s;
+  conn.lossState.reorderingThreshold = 2 * window;
+  auto largest =
+      conn.outstandingPackets[PacketNumberSpace::AppData].back().packetNum;
+  auto lossTime = bench->sentTime(largest) + kBenchRtt;
+  auto lossVisitor = [](auto&, auto&, bool, PacketNum) {};
+  while (iters--) {
+    folly::doNotOptimizeAway(detectLossPackets(
+        conn, largest, lossVisitor, lossTime, PacketNumberSpace::AppData));
+  }
+  BENCHMARK_SUSPEND {
+    bench.clear();
+  }
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM_MULTI(perAck, Contiguous_1K, AckPattern::Contiguous, 1000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAck,
+    Contiguous_10K,
+    AckPattern::Contiguous,
+    10000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAck,
+    Contiguous_100K,
+    AckPattern::Contiguous,
+    100000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Contiguous_1K,
+    AckPattern::Contiguous,
+    1000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Contiguous_10K,
+    AckPattern::Contiguous,
+    10000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Contiguous_100K,
+    AckPattern::Contiguous,
+    100000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM_MULTI(perAck, Sparse_1K, AckPattern::Sparse, 1000)
+BENCHMARK_NAMED_PARAM_MULTI(perAck, Sparse_10K, AckPattern::Sparse, 10000)
+BENCHMARK_NAMED_PARAM_MULTI(perAck, Sparse_100K, AckPattern::Sparse, 100000)
+BENCHMARK_NAMED_PARAM_MULTI(perAckedPacket, Sparse_1K, AckPattern::Sparse, 1000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Sparse_10K,
+    AckPattern::Sparse,
+    10000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Sparse_100K,
+    AckPattern::Sparse,
+    100000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM_MULTI(perAck, Reordered_1K, AckPattern::Reordered, 1000)
+BENCHMARK_NAMED_PARAM_MULTI(perAck, Reordered_10K, AckPattern::Reordered, 10000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAck,
+    Reordered_100K,
+    AckPattern::Reordered,
+    100000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Reordered_1K,
+    AckPattern::Reordered,
+    1000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Reordered_10K,
+    AckPattern::Reordered,
+    10000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    Reordered_100K,
+    AckPattern::Reordered,
+    100000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM_MULTI(perAck, HeavyLoss_1K, AckPattern::HeavyLoss, 1000)
+BENCHMARK_NAMED_PARAM_MULTI(perAck, HeavyLoss_10K, AckPattern::HeavyLoss, 10000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAck,
+    HeavyLoss_100K,
+    AckPattern::HeavyLoss,
+    100000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    HeavyLoss_1K,
+    AckPattern::HeavyLoss,
+    1000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    HeavyLoss_10K,
+    AckPattern::HeavyLoss,
+    10000)
+BENCHMARK_NAMED_PARAM_MULTI(
+    perAckedPacket,
+    HeavyLoss_100K,
+    AckPattern::HeavyLoss,
+    100000)
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_PARAM(detectNoLoss, 1000)
+BENCHMARK_PARAM(detectNoLoss, 10000)
+BENCHMARK_PARAM(detectNoLoss, 100000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
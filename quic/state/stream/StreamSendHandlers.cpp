@@ -1,6 +1,7 @@
 // Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved
 
 #include <quic/state/stream/StreamSendHandlers.h>
+#include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/state/QuicStreamFunctions.h>
 
 namespace quic {
@@ -103,6 +104,8 @@ void sendAckSMHandler(
               ackedBuffer->second.offset,
               ackedBuffer->second.offset +
                   ackedBuffer->second.data.chainLength());
+          updateUnackedBufferOnRelease(
+              stream, ackedBuffer->second.data.chainLength());
           stream.retransmissionBuffer.erase(ackedBuffer);
         } else {
           VLOG(10)
@@ -115,6 +118,7 @@ void sendAckSMHandler(
 
       // This stream may be able to invoke some deliveryCallbacks:
       stream.conn.streamManager->addDeliverable(stream.id);
+      updateWriteLatencyOnDelivery(stream, coarseNow(stream.conn));
 
       // Check for whether or not we have ACKed all bytes until our FIN.
       if (allBytesTillFinAcked(stream)) {
@@ -14,6 +14,7 @@ namespace quic {
 void resetQuicStream(QuicStreamState& stream, ApplicationErrorCode error) {
   auto writeBufferLen = stream.writeBuffer.chainLength();
   updateFlowControlOnWriteToSocket(stream, writeBufferLen);
+  updateUnackedBufferOnRelease(stream, stream.unackedBufferLen);
   stream.retransmissionBuffer.clear();
   stream.writeBuffer.move();
   stream.readBuffer.clear();
@@ -53,7 +54,7 @@ void onResetQuicStream(QuicStreamState& stream, RstStreamFrame&& frame) {
     auto lastReadOffset = stream.currentReadOffset;
     stream.currentReadOffset = frame.offset;
     stream.maxOffsetObserved = frame.offset;
-    updateFlowControlOnRead(stream, lastReadOffset, Clock::now());
+    updateFlowControlOnRead(stream, lastReadOffset, coarseNow(stream.conn));
   }
   stream.conn.streamManager->updateReadableStreams(stream);
   stream.conn.streamManager->updateWritableStreams(stream);
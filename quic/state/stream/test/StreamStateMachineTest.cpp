@@ -164,8 +164,9 @@ TEST_F(QuicOpenStateTest, AckStream) {
   EXPECT_EQ(1, conn->outstandingPackets.size());
 
   auto& streamFrame =
-      *getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)
-           ->packet.frames.front()
+      *conn->outstandingPackets[PacketNumberSpace::AppData]
+           .front()
+           .packet.frames.front()
            .asWriteStreamFrame();
 
   sendAckSMHandler(*stream, streamFrame);
@@ -212,17 +213,19 @@ TEST_F(QuicOpenStateTest, AckStreamMulti) {
 
   EXPECT_EQ(stream->retransmissionBuffer.size(), 3);
   EXPECT_EQ(3, conn->outstandingPackets.size());
+  auto& appDataPackets = conn->outstandingPackets[PacketNumberSpace::AppData];
 
   auto& streamFrame3 =
-      *conn->outstandingPackets[2].packet.frames[0].asWriteStreamFrame();
+      *appDataPackets.back().packet.frames[0].asWriteStreamFrame();
 
   sendAckSMHandler(*stream, streamFrame3);
   ASSERT_EQ(stream->sendState, StreamSendState::Open_E);
   ASSERT_EQ(stream->ackedIntervals.front().start, 10);
   ASSERT_EQ(stream->ackedIntervals.front().end, 21);
 
-  auto& streamFrame2 =
-      *conn->outstandingPackets[1].packet.frames[0].asWriteStreamFrame();
+  auto& streamFrame2 = *std::next(appDataPackets.begin())
+                             ->packet.frames[0]
+                             .asWriteStreamFrame();
 
   sendAckSMHandler(*stream, streamFrame2);
   ASSERT_EQ(stream->sendState, StreamSendState::Open_E);
@@ -230,7 +233,7 @@ TEST_F(QuicOpenStateTest, AckStreamMulti) {
   ASSERT_EQ(stream->ackedIntervals.front().end, 21);
 
   auto& streamFrame1 =
-      *conn->outstandingPackets[0].packet.frames[0].asWriteStreamFrame();
+      *appDataPackets.front().packet.frames[0].asWriteStreamFrame();
 
   sendAckSMHandler(*stream, streamFrame1);
   ASSERT_EQ(stream->sendState, StreamSendState::Open_E);
@@ -276,9 +279,11 @@ TEST_F(QuicOpenStateTest, RetxBufferSortedAfterAck) {
 
   EXPECT_EQ(3, stream->retransmissionBuffer.size());
   EXPECT_EQ(3, conn->outstandingPackets.size());
-  auto packet = conn->outstandingPackets[folly::Random::rand32() % 3];
-  auto streamFrame = *conn->outstandingPackets[std::rand() % 3]
-                          .packet.frames.front()
+  auto& appDataPackets = conn->outstandingPackets[PacketNumberSpace::AppData];
+  auto packet =
+      *std::next(appDataPackets.begin(), folly::Random::rand32() % 3);
+  auto streamFrame = *std::next(appDataPackets.begin(), std::rand() % 3)
+                          ->packet.frames.front()
                           .asWriteStreamFrame();
   sendAckSMHandler(*stream, streamFrame);
   EXPECT_EQ(2, stream->retransmissionBuffer.size());
@@ -308,8 +313,9 @@ TEST_F(QuicOpenStateTest, AckStreamAfterSkip) {
   EXPECT_EQ(1, conn->outstandingPackets.size());
 
   auto& streamFrame =
-      *getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)
-           ->packet.frames.front()
+      *conn->outstandingPackets[PacketNumberSpace::AppData]
+           .front()
+           .packet.frames.front()
            .asWriteStreamFrame();
 
   PacketNum packetNum(1);
@@ -352,8 +358,9 @@ TEST_F(QuicOpenStateTest, AckStreamAfterSkipHalfBuf) {
   EXPECT_EQ(1, conn->outstandingPackets.size());
 
   auto& streamFrame =
-      *getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)
-           ->packet.frames.front()
+      *conn->outstandingPackets[PacketNumberSpace::AppData]
+           .front()
+           .packet.frames.front()
            .asWriteStreamFrame();
 
   PacketNum packetNum(1);
@@ -402,14 +409,11 @@ TEST_F(QuicOpenStateTest, AckStreamAfterSkipOneAndAHalfBuf) {
   EXPECT_EQ(stream->retransmissionBuffer.size(), 2);
   EXPECT_EQ(2, conn->outstandingPackets.size());
 
-  auto streamFrameIt =
-      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData);
+  auto& appDataPackets = conn->outstandingPackets[PacketNumberSpace::AppData];
   auto& streamFrame1 =
-      *streamFrameIt->packet.frames.front().asWriteStreamFrame();
-  auto& streamFrame2 = *getNextOutstandingPacket(
-                            *conn, PacketNumberSpace::AppData, ++streamFrameIt)
-                            ->packet.frames.front()
-                            .asWriteStreamFrame();
+      *appDataPackets.front().packet.frames.front().asWriteStreamFrame();
+  auto& streamFrame2 =
+      *appDataPackets.back().packet.frames.front().asWriteStreamFrame();
 
   PacketNum packetNum(1);
   // Skip ~1.5 buffers.
@@ -548,8 +552,9 @@ TEST_F(QuicHalfClosedRemoteStateTest, AckStream) {
   EXPECT_EQ(1, conn->outstandingPackets.size());
 
   auto& streamFrame =
-      *getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)
-           ->packet.frames.front()
+      *conn->outstandingPackets[PacketNumberSpace::AppData]
+           .front()
+           .packet.frames.front()
            .asWriteStreamFrame();
 
   sendAckSMHandler(*stream, streamFrame);
@@ -586,8 +591,9 @@ TEST_F(QuicHalfClosedRemoteStateTest, AckStreamAfterSkip) {
   EXPECT_EQ(1, conn->outstandingPackets.size());
 
   auto& streamFrame =
-      *getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData)
-           ->packet.frames.front()
+      *conn->outstandingPackets[PacketNumberSpace::AppData]
+           .front()
+           .packet.frames.front()
            .asWriteStreamFrame();
 
   PacketNum packetNum(1);
@@ -14,7 +14,9 @@
 #include <quic/logging/test/Mocks.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/AckHandlers.h>
+#include <quic/state/QuicStateFunctions.h>
 #include <quic/state/StateData.h>
+#include <quic/state/test/MockQuicStats.h>
 #include <quic/state/test/Mocks.h>
 
 #include <numeric>
@@ -51,7 +53,7 @@ TEST_P(AckHandlersTest, TestAckMultipleSequentialBlocks) {
         createNewPacket(packetNum, GetParam());
     WriteStreamFrame frame(currentStreamId++, 0, 0, true);
     regularPacket.frames.emplace_back(std::move(frame));
-    conn.outstandingPackets.emplace_back(OutstandingPacket(
+    conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
         std::move(regularPacket), sentTime, 1, false, packetNum));
   }
   ReadAckFrame ackFrame;
@@ -101,7 +103,7 @@ TEST_P(AckHandlersTest, TestAckMultipleSequentialBlocks) {
     EXPECT_EQ(pkt, lostPackt++);
   }
   PacketNum packetNum = 16;
-  for (auto& packet : conn.outstandingPackets) {
+  for (auto& packet : conn.outstandingPackets[GetParam()]) {
     auto currentPacketNum = packet.packet.header.getPacketSequenceNum();
     EXPECT_EQ(currentPacketNum, packetNum);
     packetNum++;
@@ -122,7 +124,7 @@ TEST_P(AckHandlersTest, TestAckBlocksWithGaps) {
     auto regularPacket = createNewPacket(packetNum, GetParam());
     WriteStreamFrame frame(currentStreamId++, 0, 0, true);
     regularPacket.frames.emplace_back(std::move(frame));
-    conn.outstandingPackets.emplace_back(OutstandingPacket(
+    conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
         std::move(regularPacket), Clock::now(), 1, false, packetNum));
   }
 
@@ -186,8 +188,8 @@ TEST_P(AckHandlersTest, TestAckBlocksWithGaps) {
 
   std::vector<PacketNum> actualPacketNumbers;
   std::transform(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[GetParam()].begin(),
+      conn.outstandingPackets[GetParam()].end(),
       std::back_insert_iterator<decltype(actualPacketNumbers)>(
           actualPacketNumbers),
       [](const auto& packet) {
@@ -223,7 +225,7 @@ TEST_P(AckHandlersTest, TestNonSequentialPacketNumbers) {
     auto regularPacket = createNewPacket(packetNum, GetParam());
     WriteStreamFrame frame(current++, 0, 0, true);
     regularPacket.frames.emplace_back(std::move(frame));
-    conn.outstandingPackets.emplace_back(OutstandingPacket(
+    conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
         std::move(regularPacket), Clock::now(), 1, false, packetNum));
   }
 
@@ -232,7 +234,7 @@ TEST_P(AckHandlersTest, TestNonSequentialPacketNumbers) {
     WriteStreamFrame frame(current, 0, 0, true);
     current += 3;
     regularPacket.frames.emplace_back(std::move(frame));
-    conn.outstandingPackets.emplace_back(OutstandingPacket(
+    conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
         std::move(regularPacket), Clock::now(), 1, false, packetNum));
   }
 
@@ -287,8 +289,8 @@ TEST_P(AckHandlersTest, TestNonSequentialPacketNumbers) {
 
   std::vector<PacketNum> actualPacketNumbers;
   std::transform(
-      conn.outstandingPackets.begin(),
-      conn.outstandingPackets.end(),
+      conn.outstandingPackets[GetParam()].begin(),
+      conn.outstandingPackets[GetParam()].end(),
       std::back_insert_iterator<decltype(actualPacketNumbers)>(
           actualPacketNumbers),
       [](const auto& packet) {
@@ -312,7 +314,7 @@ TEST_P(AckHandlersTest, AckVisitorForAckTest) {
   conn.ackStates.appDataAckState.acks.insert(900, 1000);
   conn.ackStates.appDataAckState.acks.insert(500, 700);
   firstPacket.frames.emplace_back(std::move(firstAckFrame));
-  conn.outstandingPackets.emplace_back(
+  conn.outstandingPackets[GetParam()].emplace_back(
       OutstandingPacket(std::move(firstPacket), Clock::now(), 0, false, 0));
 
   auto secondPacket = createNewPacket(101 /* packetNum */, GetParam());
@@ -322,7 +324,7 @@ TEST_P(AckHandlersTest, AckVisitorForAckTest) {
   conn.ackStates.appDataAckState.acks.insert(1100, 2000);
   conn.ackStates.appDataAckState.acks.insert(1002, 1090);
   secondPacket.frames.emplace_back(std::move(secondAckFrame));
-  conn.outstandingPackets.emplace_back(
+  conn.outstandingPackets[GetParam()].emplace_back(
       OutstandingPacket(std::move(secondPacket), Clock::now(), 0, false, 0));
 
   ReadAckFrame firstReceivedAck;
@@ -386,7 +388,7 @@ TEST_P(AckHandlersTest, NoNewAckedPacket) {
   conn.lossState.ptoCount = 1;
   PacketNum packetAfterRtoNum = 10;
   auto packetAfterRto = createNewPacket(packetAfterRtoNum, GetParam());
-  conn.outstandingPackets.emplace_back(
+  conn.outstandingPackets[GetParam()].emplace_back(
       OutstandingPacket(std::move(packetAfterRto), Clock::now(), 0, false, 0));
 
   ReadAckFrame ackFrame;
@@ -430,12 +432,12 @@ TEST_P(AckHandlersTest, AckPacketNumDoesNotExist) {
 
   PacketNum packetNum1 = 9;
   auto regularPacket1 = createNewPacket(packetNum1, GetParam());
-  conn.outstandingPackets.emplace_back(
+  conn.outstandingPackets[GetParam()].emplace_back(
       std::move(regularPacket1), Clock::now(), 0, false, 0);
 
   PacketNum packetNum2 = 10;
   auto regularPacket2 = createNewPacket(packetNum2, GetParam());
-  conn.outstandingPackets.emplace_back(
+  conn.outstandingPackets[GetParam()].emplace_back(
       std::move(regularPacket2), Clock::now(), 0, false, 0);
 
   // Ack a packet one higher than the packet so that we don't trigger reordering
@@ -454,6 +456,49 @@ TEST_P(AckHandlersTest, AckPacketNumDoesNotExist) {
   EXPECT_EQ(1, conn.outstandingPackets.size());
 }
 
+TEST_P(AckHandlersTest, AckFrameViewStopsAtOldestOutstandingPacket) {
+  QuicServerConnectionState conn;
+  auto mockController = std::make_unique<MockCongestionController>();
+  conn.congestionController = std::move(mockController);
+  // Get the time based loss detection out of the way
+  conn.lossState.srtt = 10s;
+  for (PacketNum packetNum = 95; packetNum <= 101; packetNum++) {
+    auto regularPacket = createNewPacket(packetNum, GetParam());
+    regularPacket.frames.emplace_back(WriteStreamFrame(1, 0, 0, true));
+    conn.outstandingPackets[GetParam()].emplace_back(
+        std::move(regularPacket), Clock::now(), 0, false, 0);
+  }
+
+  // ACK of [95, 101] followed by a block which underflows the packet number
+  // space, the view stops before decoding it.
+  auto ackFrameData = folly::IOBuf::create(0);
+  BufAppender appender(ackFrameData.get(), 10);
+  QuicInteger(101).encode(appender);
+  QuicInteger(0).encode(appender);
+  QuicInteger(1).encode(appender);
+  QuicInteger(6).encode(appender);
+  QuicInteger(200).encode(appender);
+  QuicInteger(0).encode(appender);
+  folly::io::Cursor cursor(ackFrameData.get());
+  auto ackFrameView = decodeAckFrameView(
+      cursor,
+      ShortHeader(ProtectionType::KeyPhaseZero, getTestConnectionId(), 1),
+      CodecParameters());
+  size_t ackedPackets = 0;
+  EXPECT_NO_THROW(processAckFrame(
+      conn,
+      GetParam(),
+      ackFrameView,
+      [&](const auto&, const auto&, const ReadAckFrame& frame) {
+        EXPECT_EQ(frame.largestAcked, 101);
+        ackedPackets++;
+      },
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now()));
+  EXPECT_EQ(ackedPackets, 7);
+  EXPECT_TRUE(conn.outstandingPackets.empty());
+}
+
 TEST_P(AckHandlersTest, TestHandshakeCounterUpdate) {
   QuicServerConnectionState conn;
   StreamId stream = 1;
@@ -462,7 +507,7 @@ TEST_P(AckHandlersTest, TestHandshakeCounterUpdate) {
     WriteStreamFrame frame(
         stream, 100 * packetNum + 0, 100 * packetNum + 100, false);
     regularPacket.frames.emplace_back(std::move(frame));
-    conn.outstandingPackets.emplace_back(
+    conn.outstandingPackets[GetParam()].emplace_back(
         std::move(regularPacket),
         Clock::now(),
         0,
@@ -507,6 +552,25 @@ TEST_P(AckHandlersTest, PurgeAcks) {
       expectedTime, *conn.ackStates.initialAckState.largestRecvdPacketTime);
 }
 
+TEST_P(AckHandlersTest, PurgeAcksOfLargeFrame) {
+  QuicServerConnectionState conn;
+  auto& ackState = conn.ackStates.appDataAckState;
+  WriteAckFrame ackFrame;
+  for (PacketNum start = 990;; start -= 10) {
+    ackState.acks.insert(start, start + 5);
+    ackFrame.ackBlocks.emplace_back(start, start + 5);
+    if (start == 0) {
+      break;
+    }
+  }
+  // Received after the ACK was sent.
+  ackState.acks.insert(1000, 1010);
+  commonAckVisitorForAckFrame(ackState, ackFrame);
+  EXPECT_EQ(ackState.acks.size(), 1);
+  EXPECT_EQ(ackState.acks.front().start, 1000);
+  EXPECT_EQ(ackState.acks.front().end, 1010);
+}
+
 TEST_P(AckHandlersTest, NoSkipAckVisitor) {
   QuicServerConnectionState conn;
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -525,7 +589,7 @@ TEST_P(AckHandlersTest, NoSkipAckVisitor) {
   // We need to at least have one frame to trigger ackVisitor
   WriteStreamFrame frame(0, 0, 0, true);
   regularPacket.frames.emplace_back(std::move(frame));
-  conn.outstandingPackets.emplace_back(
+  conn.outstandingPackets[GetParam()].emplace_back(
       OutstandingPacket(std::move(regularPacket), Clock::now(), 1, false, 1));
   ReadAckFrame ackFrame;
   ackFrame.largestAcked = 0;
@@ -573,7 +637,7 @@ TEST_P(AckHandlersTest, SkipAckVisitor) {
   // Give this outstandingPacket an associatedEvent that's not in
   // outstandingPacketEvents
   outstandingPacket.associatedEvent = 0;
-  conn.outstandingPackets.push_back(std::move(outstandingPacket));
+  conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket));
   conn.outstandingClonedPacketsCount++;
 
   ReadAckFrame ackFrame;
@@ -619,8 +683,8 @@ TEST_P(AckHandlersTest, NoDoubleProcess) {
   // The seconds packet has the same PacketEvent
   outstandingPacket2.associatedEvent = packetNum1;
 
-  conn.outstandingPackets.push_back(std::move(outstandingPacket1));
-  conn.outstandingPackets.push_back(std::move(outstandingPacket2));
+  conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket1));
+  conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket2));
   conn.outstandingClonedPacketsCount += 2;
   conn.outstandingPacketEvents.insert(packetNum1);
 
@@ -683,8 +747,8 @@ TEST_P(AckHandlersTest, ClonedPacketsCounter) {
   OutstandingPacket outstandingPacket2(
       std::move(regularPacket2), Clock::now(), 1, false, 1);
 
-  conn.outstandingPackets.push_back(std::move(outstandingPacket1));
-  conn.outstandingPackets.push_back(std::move(outstandingPacket2));
+  conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket1));
+  conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket2));
   conn.outstandingClonedPacketsCount = 1;
   conn.outstandingPacketEvents.insert(packetNum1);
 
@@ -719,7 +783,7 @@ TEST_P(AckHandlersTest, UpdateMaxAckDelay) {
   PacketNum packetNum = 0;
   auto regularPacket = createNewPacket(packetNum, GetParam());
   auto sentTime = Clock::now();
-  conn.outstandingPackets.emplace_back(
+  conn.outstandingPackets[GetParam()].emplace_back(
       OutstandingPacket(std::move(regularPacket), sentTime, 1, false, 1));
 
   ReadAckFrame ackFrame;
@@ -776,7 +840,8 @@ TEST_P(AckHandlersTest, AckNotOutstandingButLoss) {
       1,
       false,
       1);
-  conn.outstandingPackets.push_back(std::move(outstandingPacket));
+  conn.outstandingPackets[PacketNumberSpace::AppData].push_back(
+      std::move(outstandingPacket));
   conn.outstandingClonedPacketsCount++;
 
   EXPECT_CALL(*mockQLogger, addPacketsLost(1, 1, 1));
@@ -814,7 +879,7 @@ TEST_P(AckHandlersTest, UpdatePendingAckStates) {
   PacketNum packetNum = 0;
   auto regularPacket = createNewPacket(packetNum, GetParam());
   auto sentTime = Clock::now() - 1500ms;
-  conn.outstandingPackets.emplace_back(OutstandingPacket(
+  conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
       std::move(regularPacket),
       sentTime,
       111,
@@ -863,7 +928,7 @@ TEST_P(AckHandlersTest, AckEventCreation) {
         false /* handshake */,
         packetNum);
     sentPacket.isAppLimited = (packetNum % 2);
-    conn.outstandingPackets.emplace_back(sentPacket);
+    conn.outstandingPackets[GetParam()].emplace_back(sentPacket);
     packetNum++;
   }
 
@@ -894,6 +959,256 @@ TEST_P(AckHandlersTest, AckEventCreation) {
       ackTime);
 }
 
+TEST_P(AckHandlersTest, SpuriousLossUndo) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.detectSpuriousLoss = true;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+
+  // Packets 1 and 3 were declared lost, only packet 5 is still outstanding.
+  conn.lossState.recentlyLostPackets[GetParam()] = {1, 3};
+  auto regularPacket = createNewPacket(5, GetParam());
+  conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
+      std::move(regularPacket), Clock::now() - 100ms, 1, false, 1));
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 5;
+  ackFrame.ackBlocks.emplace_back(5, 5);
+  ackFrame.ackBlocks.emplace_back(3, 3);
+  EXPECT_CALL(*rawCongestionController, onSpuriousLoss()).Times(1);
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _)).Times(1);
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+  ASSERT_EQ(1, conn.lossState.recentlyLostPackets[GetParam()].size());
+  EXPECT_EQ(1, conn.lossState.recentlyLostPackets[GetParam()].front());
+}
+
+TEST_P(AckHandlersTest, SpuriousPTO) {
+  QuicServerConnectionState conn;
+  conn.congestionController = nullptr;
+  MockQuicStats stats;
+  conn.infoCallback = &stats;
+  bool appData = GetParam() == PacketNumberSpace::AppData;
+
+  // Packets 1 and 2 were outstanding when the PTO fired, 3 probed them.
+  for (PacketNum packetNum = 1; packetNum <= 3; packetNum++) {
+    auto regularPacket = createNewPacket(packetNum, GetParam());
+    conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
+        std::move(regularPacket), Clock::now(), 1, false, packetNum));
+  }
+  conn.lossState.largestSentAtPTO = 2;
+
+  // Only the probe was acked, it was needed.
+  ReadAckFrame probeAck;
+  probeAck.largestAcked = 3;
+  probeAck.ackBlocks.emplace_back(3, 3);
+  EXPECT_CALL(stats, onSpuriousPTO()).Times(0);
+  processAckFrame(
+      conn,
+      GetParam(),
+      probeAck,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+  EXPECT_EQ(appData, !conn.lossState.largestSentAtPTO.has_value());
+  Mock::VerifyAndClearExpectations(&stats);
+
+  // The next PTO was followed by the acks of what was sent before it.
+  conn.lossState.largestSentAtPTO = 2;
+  ReadAckFrame lateAck;
+  lateAck.largestAcked = 2;
+  lateAck.ackBlocks.emplace_back(1, 2);
+  EXPECT_CALL(stats, onSpuriousPTO()).Times(appData ? 1 : 0);
+  processAckFrame(
+      conn,
+      GetParam(),
+      lateAck,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+  EXPECT_EQ(appData, !conn.lossState.largestSentAtPTO.has_value());
+}
+
+TEST_P(AckHandlersTest, BatchAckEvents) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.batchAckEvents = true;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  // Get the time based loss detection out of the way
+  conn.lossState.srtt = 10s;
+
+  for (PacketNum packetNum = 0; packetNum < 4; packetNum++) {
+    auto regularPacket = createNewPacket(packetNum, GetParam());
+    conn.outstandingPackets[GetParam()].emplace_back(OutstandingPacket(
+        std::move(regularPacket),
+        Clock::now() - 100ms + std::chrono::milliseconds(packetNum),
+        10,
+        false,
+        10 * (packetNum + 1)));
+  }
+
+  ReadAckFrame firstAck;
+  firstAck.largestAcked = 1;
+  firstAck.ackBlocks.emplace_back(0, 1);
+  ReadAckFrame secondAck;
+  secondAck.largestAcked = 3;
+  secondAck.ackBlocks.emplace_back(3, 3);
+
+  startAckEventBatch(conn);
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _)).Times(0);
+  for (const auto& ackFrame : {firstAck, secondAck}) {
+    processAckFrame(
+        conn,
+        GetParam(),
+        ackFrame,
+        [](const auto&, const auto&, const auto&) {},
+        [](auto&, auto&, bool, PacketNum) {},
+        Clock::now());
+  }
+  Mock::VerifyAndClearExpectations(rawCongestionController);
+
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ack, auto loss) {
+        ASSERT_TRUE(ack.hasValue());
+        EXPECT_EQ(3, *ack->largestAckedPacket);
+        EXPECT_EQ(30, ack->ackedBytes);
+        EXPECT_EQ(3, ack->ackedPackets.size());
+        EXPECT_FALSE(loss.hasValue());
+      }));
+  finishAckEventBatch(conn);
+  EXPECT_FALSE(conn.ackEventBatch.active);
+  EXPECT_FALSE(conn.ackEventBatch.ack.hasValue());
+}
+
+TEST_P(AckHandlersTest, EcnCongestionEvent) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.enableEcn = true;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+
+  auto sentTime = Clock::now() - 100ms;
+  for (PacketNum packetNum = 1; packetNum <= 2; packetNum++) {
+    auto regularPacket = createNewPacket(packetNum, GetParam());
+    OutstandingPacket outstandingPacket(
+        std::move(regularPacket), sentTime, 1, false, packetNum);
+    outstandingPacket.isEcnMarked = true;
+    conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket));
+  }
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 2;
+  ackFrame.ackBlocks.emplace_back(1, 2);
+  EcnCounts ecnCounts;
+  ecnCounts.ect0 = 1;
+  ecnCounts.ce = 1;
+  ackFrame.ecnCounts = ecnCounts;
+  EXPECT_CALL(*rawCongestionController, onEcnCongestionEvent(sentTime))
+      .Times(1);
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _)).Times(1);
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+  EXPECT_FALSE(conn.ecnFailed);
+  EXPECT_EQ(1, getAckState(conn, GetParam()).peerEcnCounts.ce);
+}
+
+TEST_P(AckHandlersTest, EcnValidationFailure) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.enableEcn = true;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+
+  for (PacketNum packetNum = 1; packetNum <= 2; packetNum++) {
+    auto regularPacket = createNewPacket(packetNum, GetParam());
+    OutstandingPacket outstandingPacket(
+        std::move(regularPacket), Clock::now() - 100ms, 1, false, packetNum);
+    outstandingPacket.isEcnMarked = true;
+    conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket));
+  }
+
+  // Only one of the two marked packets is counted, the markings got lost.
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 2;
+  ackFrame.ackBlocks.emplace_back(1, 2);
+  EcnCounts ecnCounts;
+  ecnCounts.ect0 = 1;
+  ackFrame.ecnCounts = ecnCounts;
+  EXPECT_CALL(*rawCongestionController, onEcnCongestionEvent(_)).Times(0);
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _)).Times(1);
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+  EXPECT_TRUE(conn.ecnFailed);
+  EXPECT_FALSE(isEcnMarkingEnabled(conn));
+}
+
+TEST_P(AckHandlersTest, RateSample) {
+  QuicServerConnectionState conn;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  conn.lossState.totalBytesAcked = 1000;
+
+  auto lastAckedSentTime = Clock::now() - 100ms;
+  auto lastAckTime = lastAckedSentTime + 5ms;
+  auto sentTime = lastAckedSentTime + 10ms;
+  for (PacketNum packetNum = 0; packetNum < 3; packetNum++) {
+    auto regularPacket = createNewPacket(packetNum, GetParam());
+    OutstandingPacket outstandingPacket(
+        std::move(regularPacket),
+        sentTime + std::chrono::milliseconds(packetNum),
+        100,
+        false,
+        1000 + 100 * (packetNum + 1));
+    outstandingPacket.isAppLimited = packetNum == 2;
+    outstandingPacket.lastAckedPacketInfo.emplace(
+        lastAckedSentTime, lastAckTime, 1000, 1000);
+    conn.outstandingPackets[GetParam()].push_back(std::move(outstandingPacket));
+  }
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 2;
+  ackFrame.ackBlocks.emplace_back(0, 2);
+  auto ackTime = sentTime + 20ms;
+  // The sample comes from the last sent packet, packet 2.
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ack, auto /* loss */) {
+        ASSERT_TRUE(ack->rateSample.hasValue());
+        EXPECT_EQ(300, ack->rateSample->sentBytes);
+        EXPECT_EQ(12ms, ack->rateSample->sendElapsed);
+        EXPECT_EQ(300, ack->rateSample->deliveredBytes);
+        EXPECT_EQ(25ms, ack->rateSample->ackElapsed);
+        EXPECT_TRUE(ack->rateSample->isAppLimited);
+      }));
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      ackTime);
+  ASSERT_TRUE(conn.lossState.lastRateSample.hasValue());
+  // 300 bytes over the longer 25ms.
+  EXPECT_EQ(12000, conn.lossState.lastRateSample->deliveryRate());
+}
+
 INSTANTIATE_TEST_CASE_P(
     AckHandlersTests,
     AckHandlersTest,
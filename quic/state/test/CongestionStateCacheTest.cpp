@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/CongestionStateCache.h>
+
+#include <gtest/gtest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class CongestionStateCacheTest : public Test {};
+
+TEST_F(CongestionStateCacheTest, PutGetRemove) {
+  BasicCongestionStateCache cache;
+  EXPECT_FALSE(cache.getCongestionState("a").has_value());
+  CachedCongestionState state;
+  state.cwndBytes = 100000;
+  state.minRtt = 20ms;
+  cache.putCongestionState("a", state);
+  auto cached = cache.getCongestionState("a");
+  ASSERT_TRUE(cached.has_value());
+  EXPECT_EQ(100000, cached->cwndBytes);
+  EXPECT_EQ(20ms, cached->minRtt);
+
+  state.cwndBytes = 50000;
+  cache.putCongestionState("a", state);
+  EXPECT_EQ(50000, cache.getCongestionState("a")->cwndBytes);
+
+  cache.removeCongestionState("a");
+  EXPECT_FALSE(cache.getCongestionState("a").has_value());
+}
+
+TEST_F(CongestionStateCacheTest, EvictsLeastRecentlyUsed) {
+  BasicCongestionStateCache cache(2);
+  CachedCongestionState state;
+  cache.putCongestionState("a", state);
+  cache.putCongestionState("b", state);
+  EXPECT_TRUE(cache.getCongestionState("a").has_value());
+  cache.putCongestionState("c", state);
+  EXPECT_TRUE(cache.getCongestionState("a").has_value());
+  EXPECT_FALSE(cache.getCongestionState("b").has_value());
+  EXPECT_TRUE(cache.getCongestionState("c").has_value());
+}
+
+TEST_F(CongestionStateCacheTest, SubnetKey) {
+  EXPECT_EQ(
+      congestionStateCacheKey(folly::IPAddress("10.1.2.3")),
+      congestionStateCacheKey(folly::IPAddress("10.1.2.200")));
+  EXPECT_NE(
+      congestionStateCacheKey(folly::IPAddress("10.1.2.3")),
+      congestionStateCacheKey(folly::IPAddress("10.1.3.3")));
+  EXPECT_EQ(
+      congestionStateCacheKey(folly::IPAddress("2001:db8:0:100::1")),
+      congestionStateCacheKey(folly::IPAddress("2001:db8:0:1ff::2")));
+  EXPECT_NE(
+      congestionStateCacheKey(folly::IPAddress("2001:db8:0:100::1")),
+      congestionStateCacheKey(folly::IPAddress("2001:db8:0:200::1")));
+}
+
+} // namespace test
+} // namespace quic
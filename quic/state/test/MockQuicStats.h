@@ -36,13 +36,21 @@ class MockQuicStats : public QuicTransportStatsCallback {
   MOCK_METHOD0(onConnFlowControlUpdate, void());
   MOCK_METHOD0(onConnFlowControlBlocked, void());
   MOCK_METHOD0(onStatelessReset, void());
+  MOCK_METHOD0(onRetrySent, void());
   MOCK_METHOD0(onStreamFlowControlUpdate, void());
   MOCK_METHOD0(onStreamFlowControlBlocked, void());
   MOCK_METHOD0(onCwndBlocked, void());
   MOCK_METHOD0(onPTO, void());
+  MOCK_METHOD1(onPTOProbe, void(PTOProbeType));
+  MOCK_METHOD0(onSpuriousPTO, void());
   MOCK_METHOD1(onRead, void(size_t));
   MOCK_METHOD1(onWrite, void(size_t));
   MOCK_METHOD1(onUDPSocketWriteError, void(SocketErrorType));
+  MOCK_METHOD1(onWriteBatch, void(size_t));
+  MOCK_METHOD3(onWriteSyscall, void(size_t, size_t, size_t));
+  MOCK_METHOD1(onWriteFlush, void(WriteFlushReason));
+  MOCK_METHOD0(onSpuriousLoss, void());
+  MOCK_METHOD2(onPacingInterval, void(PacingRateError, uint64_t));
 };
 
 class MockQuicStatsFactory : public QuicTransportStatsCallbackFactory {
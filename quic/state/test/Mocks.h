@@ -25,6 +25,7 @@ class MockCongestionController : public CongestionController {
   MOCK_CONST_METHOD0(getWritableBytes, uint64_t());
   MOCK_CONST_METHOD0(getCongestionWindow, uint64_t());
   MOCK_METHOD0(onSpuriousLoss, void());
+  MOCK_METHOD1(onEcnCongestionEvent, void(TimePoint));
   MOCK_CONST_METHOD0(type, CongestionControlType());
   GMOCK_METHOD2_(, , , setAppIdle, void(bool, TimePoint));
   MOCK_METHOD0(setAppLimited, void());
@@ -37,6 +38,7 @@ class MockPacer : public Pacer {
   MOCK_METHOD1(onPacedWriteScheduled, void(TimePoint));
   MOCK_CONST_METHOD0(getTimeUntilNextWrite, std::chrono::microseconds());
   MOCK_METHOD1(updateAndGetWriteBatchSize, uint64_t(TimePoint));
+  MOCK_CONST_METHOD0(getPacketInterval, std::chrono::nanoseconds());
   MOCK_CONST_METHOD0(getCachedWriteBatchSize, uint64_t());
   MOCK_METHOD1(setAppLimited, void(bool));
   MOCK_METHOD0(onPacketSent, void());
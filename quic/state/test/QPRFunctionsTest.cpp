@@ -9,6 +9,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QPRFunctions.h>
 
@@ -194,6 +195,59 @@ TEST_F(QPRFunctionsTest, RecvMinStreamDataFrameShrinkBuffer) {
   EXPECT_EQ(stream->conn.flowControlState.sumCurStreamBufferLen, 0);
 }
 
+TEST_F(QPRFunctionsTest, RecvMinStreamDataFrameShrinkRetransmissionBuffer) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  PacketNum packetNum(10);
+  stream->currentWriteOffset = 30;
+  for (uint64_t offset = 0; offset < 30; offset += 10) {
+    stream->retransmissionBuffer.emplace(
+        offset, StreamBuffer(folly::IOBuf::copyBuffer("aaaaaaaaaa"), offset));
+  }
+  updateUnackedBufferOnWriteToSocket(*stream, 30);
+  auto maxData = stream->flowControlState.peerAdvertisedMaxOffset;
+  onRecvMinStreamDataFrame(
+      stream, MinStreamDataFrame(stream->id, maxData, 15), packetNum);
+  ASSERT_EQ(stream->retransmissionBuffer.size(), 2);
+  EXPECT_EQ(stream->retransmissionBuffer.at(10).offset, 15);
+  EXPECT_EQ(stream->retransmissionBuffer.at(10).data.chainLength(), 5);
+  EXPECT_EQ(stream->retransmissionBuffer.at(20).offset, 20);
+  EXPECT_EQ(stream->unackedBufferLen, 15);
+
+  // The trimmed buffer stays keyed at its original offset.
+  onRecvMinStreamDataFrame(
+      stream, MinStreamDataFrame(stream->id, maxData, 25), packetNum);
+  ASSERT_EQ(stream->retransmissionBuffer.size(), 1);
+  EXPECT_EQ(stream->retransmissionBuffer.at(20).offset, 25);
+  EXPECT_EQ(stream->retransmissionBuffer.at(20).data.chainLength(), 5);
+  EXPECT_EQ(stream->unackedBufferLen, 5);
+  EXPECT_EQ(conn.flowControlState.sumUnackedStreamBufferLen, 5);
+}
+
+TEST_F(QPRFunctionsTest, AdvanceMinimumRetransmittableOffsetSkipsMany) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  stream->currentWriteOffset = 1000;
+  // Every other buffer was lost, the rest wait for their acks.
+  for (uint64_t offset = 0; offset < 1000; offset += 10) {
+    auto buffer = StreamBuffer(folly::IOBuf::copyBuffer("aaaaaaaaaa"), offset);
+    if (offset % 20) {
+      stream->lossBuffer.push_back(std::move(buffer));
+    } else {
+      stream->retransmissionBuffer.emplace(offset, std::move(buffer));
+    }
+  }
+  updateUnackedBufferOnWriteToSocket(*stream, 1000);
+  auto result = advanceMinimumRetransmittableOffset(stream, 905);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(*result, 905);
+  ASSERT_EQ(stream->retransmissionBuffer.size(), 5);
+  EXPECT_EQ(stream->retransmissionBuffer.begin()->first, 900);
+  EXPECT_EQ(stream->retransmissionBuffer.at(900).offset, 905);
+  EXPECT_EQ(stream->retransmissionBuffer.at(900).data.chainLength(), 5);
+  ASSERT_EQ(stream->lossBuffer.size(), 5);
+  EXPECT_EQ(stream->lossBuffer.front().offset, 910);
+  EXPECT_EQ(stream->unackedBufferLen, 95);
+}
+
 TEST_F(QPRFunctionsTest, RecvMinStreamDataFrameOnUnidirectionalStream) {
   auto stream = conn.streamManager->createNextUnidirectionalStream().value();
   stream->sendState = StreamSendState::Closed_E;
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <quic/common/test/AllocationCounter.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/AckHandlers.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+// Upper bounds on what the hot paths allocate in steady state, the sum of
+// the allocations each path is allowed. Anything on top of them is a
+// regression. Taking one out of a path is to drop it from the budget.
+
+// The acked packets vector of the AckEvent.
+constexpr uint64_t kMaxAllocationsPerAck = 1;
+// The map and the first node of each of the four deques of a stream state,
+// allocated when they are constructed.
+constexpr uint64_t kStreamDeques = 4;
+constexpr uint64_t kMaxAllocationsPerStreamOpenClose = 2 * kStreamDeques;
+
+// Enough for the containers of the connection to have grown to what the
+// steady state needs before it is measured.
+constexpr size_t kWarmupRounds = 1000;
+constexpr size_t kMeasuredRounds = 1000;
+
+constexpr PacketNum kWindow = 100;
+constexpr PacketNum kPacketsPerAck = 2;
+constexpr uint32_t kEncodedPacketSize = 1252;
+} // namespace
+
+class AckAllocationTest : public Test {
+ protected:
+  void sendUpTo(PacketNum last) {
+    for (; nextPacketNum_ <= last; ++nextPacketNum_) {
+      RegularQuicWritePacket packet(ShortHeader(
+          ProtectionType::KeyPhaseZero, getTestConnectionId(), nextPacketNum_));
+      packet.frames.emplace_back(
+          WriteStreamFrame(4, nextPacketNum_ * 1200, 1200, false));
+      conn_.lossState.totalBytesSent += kEncodedPacketSize;
+      auto& appDataPackets =
+          conn_.outstandingPackets[PacketNumberSpace::AppData];
+      appDataPackets.emplace_back(
+          std::move(packet),
+          Clock::now(),
+          kEncodedPacketSize,
+          false,
+          conn_.lossState.totalBytesSent);
+      conn_.congestionController->onPacketSent(appDataPackets.back());
+    }
+  }
+
+  // Acks everything up to largest, as the peer does when nothing is lost,
+  // returns what processing the ack allocated.
+  uint64_t ackUpTo(PacketNum largest) {
+    ackFrame_.largestAcked = largest;
+    ackFrame_.ackBlocks.clear();
+    ackFrame_.ackBlocks.emplace_back(1, largest);
+    ScopedAllocationCounter counter;
+    processAckFrame(
+        conn_,
+        PacketNumberSpace::AppData,
+        ackFrame_,
+        ackVisitor_,
+        lossVisitor_,
+        Clock::now());
+    return counter.count();
+  }
+
+  QuicServerConnectionState conn_;
+  PacketNum nextPacketNum_{1};
+  ReadAckFrame ackFrame_;
+  AckVisitor ackVisitor_ = [](const auto&, const auto&, const auto&) {};
+  LossVisitor lossVisitor_ = [](auto&, auto&, bool, PacketNum) {};
+};
+
+TEST_F(AckAllocationTest, AllocationsPerAck) {
+  sendUpTo(kWindow);
+  PacketNum largestAcked = 0;
+  uint64_t allocations = 0;
+  for (size_t round = 0; round < kWarmupRounds + kMeasuredRounds; ++round) {
+    largestAcked += kPacketsPerAck;
+    auto ackAllocations = ackUpTo(largestAcked);
+    if (round >= kWarmupRounds) {
+      allocations += ackAllocations;
+    }
+    sendUpTo(largestAcked + kWindow);
+    ASSERT_EQ(kWindow, conn_.outstandingPackets.size());
+  }
+  EXPECT_LE(allocations, kMaxAllocationsPerAck * kMeasuredRounds);
+}
+
+TEST(StreamAllocationTest, AllocationsPerStreamOpenClose) {
+  QuicServerConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(
+      kWarmupRounds + kMeasuredRounds);
+  uint64_t allocations = 0;
+  for (size_t round = 0; round < kWarmupRounds + kMeasuredRounds; ++round) {
+    ScopedAllocationCounter counter;
+    auto stream = conn.streamManager->createNextBidirectionalStream();
+    ASSERT_TRUE(stream.hasValue());
+    stream.value()->sendState = StreamSendState::Closed_E;
+    stream.value()->recvState = StreamRecvState::Closed_E;
+    conn.streamManager->removeClosedStream(stream.value()->id);
+    if (round >= kWarmupRounds) {
+      allocations += counter.count();
+    }
+  }
+  EXPECT_EQ(0, conn.streamManager->streamCount());
+  EXPECT_LE(allocations, kMaxAllocationsPerStreamOpenClose * kMeasuredRounds);
+}
+
+} // namespace test
+} // namespace quic
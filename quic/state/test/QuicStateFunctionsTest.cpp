@@ -12,10 +12,13 @@
 #include <quic/common/test/TestUtils.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QuicStateFunctions.h>
+#include <quic/state/SimpleFrameFunctions.h>
 #include <quic/state/stream/StreamReceiveHandlers.h>
 #include <quic/state/stream/StreamSendHandlers.h>
 #include <quic/state/test/Mocks.h>
 
+#include <set>
+
 using namespace testing;
 
 namespace quic {
@@ -33,19 +36,21 @@ bool verifyToScheduleAckTimeout(const QuicConnectionStateBase& conn) {
   return conn.pendingEvents.scheduleAckTimeout;
 }
 
-RegularQuicWritePacket makeTestShortPacket() {
+RegularQuicWritePacket makeTestShortPacket(PacketNum packetNum) {
   ShortHeader header(
-      ProtectionType::KeyPhaseZero, getTestConnectionId(), 2 /* packetNum */);
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), packetNum);
   RegularQuicWritePacket packet(std::move(header));
   return packet;
 }
 
-RegularQuicWritePacket makeTestLongPacket(LongHeader::Types type) {
+RegularQuicWritePacket makeTestLongPacket(
+    LongHeader::Types type,
+    PacketNum packetNum) {
   LongHeader header(
       type,
       getTestConnectionId(0),
       getTestConnectionId(1),
-      2 /* packetNum */,
+      packetNum,
       QuicVersion::QUIC_DRAFT);
   RegularQuicWritePacket packet(std::move(header));
   return packet;
@@ -80,6 +85,19 @@ TEST_P(UpdateLargestReceivedPacketNumTest, ReceiveOld) {
       currentLargestReceived);
 }
 
+TEST_P(UpdateLargestReceivedPacketNumTest, BoundedAckBlocks) {
+  QuicServerConnectionState conn;
+  auto& ackState = getAckState(conn, GetParam());
+  // Every other packet, so that each one is a range of its own.
+  for (PacketNum packetNum = 0; packetNum < 2 * (kMaxReceivedAckBlocks + 10);
+       packetNum += 2) {
+    updateLargestReceivedPacketNum(ackState, packetNum, Clock::now());
+  }
+  EXPECT_EQ(kMaxReceivedAckBlocks, ackState.acks.size());
+  EXPECT_EQ(20, ackState.acks.front().start);
+  EXPECT_EQ(2 * (kMaxReceivedAckBlocks + 9), ackState.acks.back().end);
+}
+
 INSTANTIATE_TEST_CASE_P(
     UpdateLargestReceivedPacketNumTests,
     UpdateLargestReceivedPacketNumTest,
@@ -356,6 +374,34 @@ TEST_P(UpdateAckStateTest, UpdateAckSendStateOnRecvPacketsNonRxOutOfOrder) {
   EXPECT_FALSE(verifyToScheduleAckTimeout(conn));
 }
 
+TEST_P(UpdateAckStateTest, UpdateAckSendStateOnRecvPacketsPeerAckFrequency) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto& ackState = getAckState(conn, GetParam());
+  ackState.peerAckFrequency = AckFrequencyFrame(0, 30, 10ms, true);
+  for (size_t i = 0; i < 29; i++) {
+    // Reordering doesn't matter with ignoreOrder.
+    updateAckSendStateOnRecvPacket(conn, ackState, i == 5, true, false);
+    EXPECT_FALSE(verifyToAckImmediately(conn, ackState));
+    EXPECT_TRUE(verifyToScheduleAckTimeout(conn));
+  }
+  updateAckSendStateOnRecvPacket(conn, ackState, false, true, false);
+  EXPECT_TRUE(verifyToAckImmediately(conn, ackState));
+  EXPECT_FALSE(verifyToScheduleAckTimeout(conn));
+}
+
+TEST_P(UpdateAckStateTest, UpdateAckSendStateOnRecvPacketsImmediateAck) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto& ackState = getAckState(conn, GetParam());
+  ackState.peerAckFrequency = AckFrequencyFrame(0, 30, 10ms, false);
+  ackState.immediateAckRequested = true;
+  updateAckSendStateOnRecvPacket(conn, ackState, false, true, false);
+  EXPECT_TRUE(verifyToAckImmediately(conn, ackState));
+  EXPECT_FALSE(ackState.immediateAckRequested);
+  updateAckSendStateOnRecvPacket(conn, ackState, false, true, false);
+  EXPECT_FALSE(verifyToAckImmediately(conn, ackState));
+  EXPECT_TRUE(verifyToScheduleAckTimeout(conn));
+}
+
 INSTANTIATE_TEST_CASE_P(
     UpdateAckStateTests,
     UpdateAckStateTest,
@@ -520,6 +566,69 @@ TEST_F(QuicStateFunctionsTest, UpdateMaxAckDelay) {
   EXPECT_EQ(30us, conn.lossState.maxAckDelay);
 }
 
+TEST_F(QuicStateFunctionsTest, UpdateAckFrequency) {
+  QuicServerConnectionState conn;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  conn.lossState.srtt = 40ms;
+  uint64_t cwnd = 400 * conn.udpSendPacketLen;
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Invoke([&]() { return cwnd; }));
+
+  // Nothing is sent to a peer without min_ack_delay.
+  auto now = Clock::now();
+  updateAckFrequency(conn, now);
+  EXPECT_TRUE(conn.pendingEvents.frames.empty());
+
+  conn.ackFrequencyState.peerMinAckDelay = 1ms;
+  updateAckFrequency(conn, now);
+  ASSERT_EQ(1, conn.pendingEvents.frames.size());
+  auto frame = *conn.pendingEvents.frames.front().asAckFrequencyFrame();
+  EXPECT_EQ(0, frame.sequenceNumber);
+  EXPECT_EQ(100, frame.packetTolerance);
+  EXPECT_EQ(10ms, frame.updateMaxAckDelay);
+  EXPECT_FALSE(frame.ignoreOrder);
+  conn.pendingEvents.frames.clear();
+
+  // At most once per srtt, and only for a large enough change.
+  cwnd = 200 * conn.udpSendPacketLen;
+  updateAckFrequency(conn, now + 10ms);
+  EXPECT_TRUE(conn.pendingEvents.frames.empty());
+  cwnd = 360 * conn.udpSendPacketLen;
+  updateAckFrequency(conn, now + 50ms);
+  EXPECT_TRUE(conn.pendingEvents.frames.empty());
+  cwnd = 200 * conn.udpSendPacketLen;
+  updateAckFrequency(conn, now + 50ms);
+  ASSERT_EQ(1, conn.pendingEvents.frames.size());
+  frame = *conn.pendingEvents.frames.front().asAckFrequencyFrame();
+  EXPECT_EQ(1, frame.sequenceNumber);
+  EXPECT_EQ(50, frame.packetTolerance);
+}
+
+TEST_F(QuicStateFunctionsTest, ReceiveAckFrequency) {
+  QuicServerConnectionState conn;
+  AckFrequencyFrame ackFrequency(1, 1000, 5ms, false);
+  EXPECT_THROW(
+      updateSimpleFrameOnPacketReceived(conn, ackFrequency, 0, false),
+      QuicTransportException);
+
+  conn.transportSettings.ackFrequencyEnabled = true;
+  updateSimpleFrameOnPacketReceived(conn, ackFrequency, 0, false);
+  auto& peerAckFrequency = conn.ackStates.appDataAckState.peerAckFrequency;
+  ASSERT_TRUE(peerAckFrequency.hasValue());
+  EXPECT_EQ(kMaxAckFrequencyPacketTolerance, peerAckFrequency->packetTolerance);
+  EXPECT_EQ(5ms, peerAckFrequency->updateMaxAckDelay);
+
+  // Reordered older frames are ignored.
+  updateSimpleFrameOnPacketReceived(
+      conn, AckFrequencyFrame(0, 20, 2ms, false), 1, false);
+  EXPECT_EQ(1, peerAckFrequency->sequenceNumber);
+
+  updateSimpleFrameOnPacketReceived(conn, ImmediateAckFrame(), 2, false);
+  EXPECT_TRUE(conn.ackStates.appDataAckState.immediateAckRequested);
+}
+
 TEST_F(QuicStateFunctionsTest, IsConnectionPaced) {
   QuicConnectionStateBase state(QuicNodeType::Client);
   EXPECT_FALSE(isConnectionPaced(state));
@@ -531,50 +640,64 @@ TEST_F(QuicStateFunctionsTest, IsConnectionPaced) {
   EXPECT_FALSE(isConnectionPaced(state));
 }
 
-TEST_F(QuicStateFunctionsTest, GetOutstandingPackets) {
+TEST_F(QuicStateFunctionsTest, IsConnectionPacedInKernel) {
+  QuicConnectionStateBase state(QuicNodeType::Client);
+  state.canBePaced = true;
+  state.transportSettings.pacingEnabled = true;
+  state.pacer = std::make_unique<MockPacer>();
+  state.transportSettings.txTimePacing = true;
+  EXPECT_TRUE(isConnectionPaced(state));
+  EXPECT_FALSE(isConnectionPacedInKernel(state));
+
+  state.socketTxTimeEnabled = true;
+  EXPECT_TRUE(isConnectionPacedInKernel(state));
+
+  state.transportSettings.txTimePacing = false;
+  EXPECT_FALSE(isConnectionPacedInKernel(state));
+}
+
+TEST_F(QuicStateFunctionsTest, OutstandingPacketsPerSpace) {
   QuicConnectionStateBase conn(QuicNodeType::Client);
-  conn.outstandingPackets.emplace_back(
-      makeTestLongPacket(LongHeader::Types::Initial),
+  auto& initialPackets = conn.outstandingPackets[PacketNumberSpace::Initial];
+  auto& handshakePackets =
+      conn.outstandingPackets[PacketNumberSpace::Handshake];
+  auto& appDataPackets = conn.outstandingPackets[PacketNumberSpace::AppData];
+  initialPackets.emplace_back(
+      makeTestLongPacket(LongHeader::Types::Initial, 1),
       Clock::now(),
       135,
       false,
       0);
-  conn.outstandingPackets.emplace_back(
-      makeTestLongPacket(LongHeader::Types::Handshake),
+  handshakePackets.emplace_back(
+      makeTestLongPacket(LongHeader::Types::Handshake, 1),
       Clock::now(),
       1217,
       false,
       0);
-  conn.outstandingPackets.emplace_back(
-      makeTestShortPacket(), Clock::now(), 5556, false, 0);
-  conn.outstandingPackets.emplace_back(
-      makeTestLongPacket(LongHeader::Types::Initial),
+  appDataPackets.emplace_back(
+      makeTestShortPacket(1), Clock::now(), 5556, false, 0);
+  initialPackets.emplace_back(
+      makeTestLongPacket(LongHeader::Types::Initial, 2),
       Clock::now(),
       56,
       false,
       0);
-  conn.outstandingPackets.emplace_back(
-      makeTestShortPacket(), Clock::now(), 6665, false, 0);
-  EXPECT_EQ(
-      135,
-      getFirstOutstandingPacket(conn, PacketNumberSpace::Initial)->encodedSize);
-  EXPECT_EQ(
-      56,
-      getLastOutstandingPacket(conn, PacketNumberSpace::Initial)->encodedSize);
-  EXPECT_EQ(
-      1217,
-      getFirstOutstandingPacket(conn, PacketNumberSpace::Handshake)
-          ->encodedSize);
-  EXPECT_EQ(
-      1217,
-      getFirstOutstandingPacket(conn, PacketNumberSpace::Handshake)
-          ->encodedSize);
-  EXPECT_EQ(
-      5556,
-      getFirstOutstandingPacket(conn, PacketNumberSpace::AppData)->encodedSize);
-  EXPECT_EQ(
-      6665,
-      getLastOutstandingPacket(conn, PacketNumberSpace::AppData)->encodedSize);
+  appDataPackets.emplace_back(
+      makeTestShortPacket(2), Clock::now(), 6665, false, 0);
+  EXPECT_EQ(5, conn.outstandingPackets.size());
+  EXPECT_EQ(135, initialPackets.front().encodedSize);
+  EXPECT_EQ(56, initialPackets.back().encodedSize);
+  EXPECT_EQ(1, handshakePackets.size());
+  EXPECT_EQ(1217, handshakePackets.front().encodedSize);
+  EXPECT_EQ(5556, appDataPackets.front().encodedSize);
+  EXPECT_EQ(6665, appDataPackets.back().encodedSize);
+
+  initialPackets.clear();
+  handshakePackets.clear();
+  EXPECT_FALSE(conn.outstandingPackets.empty());
+  conn.outstandingPackets.clear();
+  EXPECT_TRUE(conn.outstandingPackets.empty());
+  EXPECT_EQ(0, conn.outstandingPackets.size());
 }
 
 TEST_F(QuicStateFunctionsTest, UpdateLargestReceivePacketsAtLatCloseSent) {
@@ -643,6 +766,383 @@ TEST_F(QuicStateFunctionsTest, EarliestLossTimer) {
   EXPECT_EQ(currentTime - 1s, earliestLossTimer(conn).first.value());
 }
 
+class KeyUpdateHandshake : public Handshake {
+ public:
+  const folly::Optional<std::string>& getApplicationProtocol()
+      const override {
+    return alpn_;
+  }
+
+  std::unique_ptr<Aead> getNextOneRttReadCipher() override {
+    readGenerations++;
+    return createNoOpAead();
+  }
+
+  std::unique_ptr<Aead> getNextOneRttWriteCipher() override {
+    writeGenerations++;
+    return createNoOpAead();
+  }
+
+  size_t readGenerations{0};
+  size_t writeGenerations{0};
+
+ private:
+  folly::Optional<std::string> alpn_;
+};
+
+TEST_F(QuicStateFunctionsTest, UpdateOneRttKeys) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  auto handshake = std::make_unique<KeyUpdateHandshake>();
+  auto handshakePtr = handshake.get();
+  conn.handshakeLayer = std::move(handshake);
+  conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+  conn.readCodec->setOneRttReadCipher(createNoOpAead());
+  conn.oneRttWriteCipher = createNoOpAead();
+  conn.transportSettings.keyUpdatePacketInterval = 10;
+
+  // The next generation is derived as soon as the 1-RTT keys are there, and
+  // only once.
+  updateOneRttKeys(conn);
+  updateOneRttKeys(conn);
+  EXPECT_EQ(1, handshakePtr->readGenerations);
+  EXPECT_EQ(1, handshakePtr->writeGenerations);
+  EXPECT_NE(nullptr, conn.readCodec->getNextOneRttReadCipher());
+  EXPECT_NE(nullptr, conn.nextOneRttWriteCipher);
+
+  // Not before the interval is over, and the peer acked the current keys.
+  conn.ackStates.appDataAckState.nextPacketNum = 9;
+  updateOneRttKeys(conn);
+  EXPECT_EQ(0, conn.oneRttWriteKeyGeneration);
+
+  conn.ackStates.appDataAckState.nextPacketNum = 10;
+  auto nextWriteCipher = conn.nextOneRttWriteCipher.get();
+  updateOneRttKeys(conn);
+  EXPECT_EQ(1, conn.oneRttWriteKeyGeneration);
+  EXPECT_EQ(10, *conn.oneRttWriteGenerationStart);
+  EXPECT_EQ(nextWriteCipher, conn.oneRttWriteCipher.get());
+  EXPECT_EQ(2, handshakePtr->writeGenerations);
+
+  // No other update until the peer followed this one.
+  conn.ackStates.appDataAckState.nextPacketNum = 30;
+  conn.ackStates.appDataAckState.largestAckedByPeer = 20;
+  updateOneRttKeys(conn);
+  EXPECT_EQ(1, conn.oneRttWriteKeyGeneration);
+}
+
+TEST_F(QuicStateFunctionsTest, FollowPeerKeyUpdate) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  conn.handshakeLayer = std::make_unique<KeyUpdateHandshake>();
+  conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+  conn.readCodec->setCodecParameters(
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  conn.readCodec->setOneRttReadCipher(createNoOpAead());
+  conn.readCodec->setOneRttHeaderCipher(createNoOpHeaderCipher());
+  conn.oneRttWriteCipher = createNoOpAead();
+  updateOneRttKeys(conn);
+
+  auto connId = getTestConnectionId();
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto packet = createStreamPacket(
+      connId,
+      connId,
+      5 /* packetNum */,
+      2 /* streamId */,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true,
+      ProtectionType::KeyPhaseOne);
+  auto packetQueue = bufToQueue(packetToBuf(packet));
+  conn.readCodec->parsePacket(packetQueue, conn.ackStates);
+  EXPECT_EQ(1, conn.readCodec->getOneRttReadKeyGeneration());
+
+  // Key updates of the peer are followed without an interval.
+  updateOneRttKeys(conn);
+  EXPECT_EQ(1, conn.oneRttWriteKeyGeneration);
+  EXPECT_NE(nullptr, conn.readCodec->getNextOneRttReadCipher());
+  EXPECT_NE(nullptr, conn.nextOneRttWriteCipher);
+}
+
+class TestCryptoOffload : public CryptoOffload {
+ public:
+  bool probe(folly::NetworkSocket) noexcept override {
+    return true;
+  }
+
+  folly::Optional<uint32_t> installKey(
+      const Aead&,
+      const PacketNumberCipher&) override {
+    if (!hasRoom) {
+      return folly::none;
+    }
+    installed.insert(nextKeyId);
+    return nextKeyId++;
+  }
+
+  void removeKey(uint32_t keyId) noexcept override {
+    installed.erase(keyId);
+  }
+
+  int getControlLevel() const override {
+    return 0;
+  }
+
+  int getControlType() const override {
+    return 0;
+  }
+
+  bool hasRoom{true};
+  uint32_t nextKeyId{1};
+  std::set<uint32_t> installed;
+};
+
+TEST_F(QuicStateFunctionsTest, OffloadOneRttWriteCiphers) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  auto offload = std::make_shared<TestCryptoOffload>();
+  conn.oneRttWriteCipher = createNoOpAead();
+  conn.oneRttWriteHeaderCipher = createNoOpHeaderCipher();
+  maybeOffloadOneRttWriteCiphers(conn);
+  EXPECT_FALSE(conn.oneRttWriteCipher->getOffloadKeyId().has_value());
+
+  conn.cryptoOffload = offload;
+  maybeOffloadOneRttWriteCiphers(conn);
+  maybeOffloadOneRttWriteCiphers(conn);
+  EXPECT_EQ(1, *conn.oneRttWriteCipher->getOffloadKeyId());
+  EXPECT_TRUE(conn.oneRttWriteHeaderCipher->isOffloaded());
+  EXPECT_EQ(std::set<uint32_t>{1}, offload->installed);
+
+  // The device is full, the next generation is sealed in software and the
+  // key of the last one is gone with its aead.
+  auto headerCipher = conn.oneRttWriteHeaderCipher.get();
+  offload->hasRoom = false;
+  conn.oneRttWriteCipher = createNoOpAead();
+  conn.oneRttWriteKeyGeneration++;
+  maybeOffloadOneRttWriteCiphers(conn);
+  EXPECT_FALSE(conn.oneRttWriteCipher->getOffloadKeyId().has_value());
+  EXPECT_TRUE(offload->installed.empty());
+
+  // Not tried again before the next generation.
+  offload->hasRoom = true;
+  maybeOffloadOneRttWriteCiphers(conn);
+  EXPECT_FALSE(conn.oneRttWriteCipher->getOffloadKeyId().has_value());
+
+  conn.oneRttWriteCipher = createNoOpAead();
+  conn.oneRttWriteKeyGeneration++;
+  maybeOffloadOneRttWriteCiphers(conn);
+  EXPECT_EQ(2, *conn.oneRttWriteCipher->getOffloadKeyId());
+  EXPECT_EQ(headerCipher, conn.oneRttWriteHeaderCipher.get());
+}
+
+// Appends the sequence number and counts the packets each instance sealed.
+class CountingAead : public Aead {
+ public:
+  explicit CountingAead(std::shared_ptr<std::atomic<size_t>> sealed)
+      : sealed_(std::move(sealed)) {}
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf*,
+      uint64_t seqNum) const override {
+    sealed_->fetch_add(1);
+    plaintext->prependChain(
+        folly::IOBuf::copyBuffer(folly::to<std::string>(seqNum)));
+    return std::move(plaintext);
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf*,
+      uint64_t) const override {
+    return std::move(ciphertext);
+  }
+
+  size_t getCipherOverhead() const override {
+    return 0;
+  }
+
+ private:
+  std::shared_ptr<std::atomic<size_t>> sealed_;
+};
+
+class CountingHandshake : public Handshake {
+ public:
+  const folly::Optional<std::string>& getApplicationProtocol() const override {
+    return alpn;
+  }
+
+  std::unique_ptr<Aead> makeOneRttWriteCipher(uint64_t generation) override {
+    generations.push_back(generation);
+    auto sealed = std::make_shared<std::atomic<size_t>>(0);
+    lanes.push_back(sealed);
+    return std::make_unique<CountingAead>(std::move(sealed));
+  }
+
+  folly::Optional<std::string> alpn;
+  std::vector<uint64_t> generations;
+  std::vector<std::shared_ptr<std::atomic<size_t>>> lanes;
+};
+
+TEST_F(QuicStateFunctionsTest, ParallelAeadKeepsOrder) {
+  auto workers = std::make_shared<CryptoWorkerPool>(2);
+  std::vector<std::shared_ptr<std::atomic<size_t>>> sealed;
+  std::vector<std::unique_ptr<Aead>> lanes;
+  for (int i = 0; i < 3; ++i) {
+    sealed.push_back(std::make_shared<std::atomic<size_t>>(0));
+    lanes.push_back(std::make_unique<CountingAead>(sealed.back()));
+  }
+  ParallelAead aead(std::move(lanes), workers);
+
+  std::vector<Buf> plaintexts;
+  std::vector<const folly::IOBuf*> associatedData;
+  std::vector<uint64_t> seqNums;
+  for (uint64_t i = 0; i < 12; ++i) {
+    plaintexts.push_back(folly::IOBuf::copyBuffer("p"));
+    associatedData.push_back(nullptr);
+    seqNums.push_back(100 + i);
+  }
+  aead.encryptBatch(plaintexts, associatedData, seqNums);
+  for (uint64_t i = 0; i < 12; ++i) {
+    EXPECT_EQ(
+        folly::to<std::string>("p", 100 + i),
+        plaintexts[i]->moveToFbString().toStdString());
+  }
+  EXPECT_EQ(4, sealed[0]->load());
+  EXPECT_EQ(4, sealed[1]->load());
+  EXPECT_EQ(4, sealed[2]->load());
+
+  // Too small to be split.
+  plaintexts.resize(3);
+  associatedData.resize(3);
+  seqNums.resize(3);
+  for (auto& plaintext : plaintexts) {
+    plaintext = folly::IOBuf::copyBuffer("p");
+  }
+  aead.encryptBatch(plaintexts, associatedData, seqNums);
+  EXPECT_EQ(7, sealed[0]->load());
+}
+
+TEST_F(QuicStateFunctionsTest, ParallelizeOneRttWriteCipher) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  auto handshake = std::make_unique<CountingHandshake>();
+  auto rawHandshake = handshake.get();
+  conn.handshakeLayer = std::move(handshake);
+  conn.oneRttWriteCipher = createNoOpAead();
+  maybeParallelizeOneRttWriteCipher(conn);
+  EXPECT_TRUE(rawHandshake->generations.empty());
+
+  conn.cryptoWorkers = std::make_shared<CryptoWorkerPool>(2);
+  auto original = conn.oneRttWriteCipher.get();
+  maybeParallelizeOneRttWriteCipher(conn);
+  maybeParallelizeOneRttWriteCipher(conn);
+  EXPECT_NE(original, conn.oneRttWriteCipher.get());
+  EXPECT_NE(
+      nullptr, dynamic_cast<ParallelAead*>(conn.oneRttWriteCipher.get()));
+  EXPECT_EQ(std::vector<uint64_t>({0, 0}), rawHandshake->generations);
+
+  conn.oneRttWriteCipher = createNoOpAead();
+  conn.oneRttWriteKeyGeneration++;
+  maybeParallelizeOneRttWriteCipher(conn);
+  EXPECT_EQ(std::vector<uint64_t>({0, 0, 1, 1}), rawHandshake->generations);
+}
+
+TEST_F(QuicStateFunctionsTest, RemoveExpiredDatagrams) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  auto now = Clock::now();
+  auto& writeBuffer = conn.datagramState.writeBuffer;
+  writeBuffer.emplace_back(folly::IOBuf::copyBuffer("late"), now - 1ms);
+  writeBuffer.emplace_back(
+      folly::IOBuf::copyBuffer("no deadline"), folly::none);
+  writeBuffer.emplace_back(folly::IOBuf::copyBuffer("on time"), now + 10ms);
+  writeBuffer.emplace_back(folly::IOBuf::copyBuffer("due"), now);
+  removeExpiredDatagrams(conn, now);
+  ASSERT_EQ(2, writeBuffer.size());
+  EXPECT_EQ("no deadline", writeBuffer[0].data->moveToFbString());
+  EXPECT_EQ("on time", writeBuffer[1].data->moveToFbString());
+  EXPECT_EQ(2, conn.datagramState.numExpiredWrites);
+}
+
+TEST_F(QuicStateFunctionsTest, PmtuDiscoverySearch) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  conn.udpSendPacketLen = 1252;
+  startPmtuDiscovery(conn, 1500);
+  // Not enabled
+  EXPECT_FALSE(hasPendingPmtuProbe(conn));
+
+  conn.transportSettings.pmtuDiscoveryEnabled = true;
+  startPmtuDiscovery(conn, 1500);
+  ASSERT_TRUE(hasPendingPmtuProbe(conn));
+  EXPECT_EQ(kDefaultMaxPmtuProbeSize, *conn.pmtuDiscoveryState.probeSize);
+
+  // The largest size does not get through.
+  for (uint8_t i = 0; i < kMaxPmtuProbeLosses; ++i) {
+    ASSERT_TRUE(hasPendingPmtuProbe(conn));
+    onPmtuProbeSent(conn, 10 + i);
+    EXPECT_FALSE(hasPendingPmtuProbe(conn));
+    EXPECT_TRUE(isPmtuProbe(conn, PacketNumberSpace::AppData, 10 + i));
+    EXPECT_FALSE(isPmtuProbe(conn, PacketNumberSpace::Handshake, 10 + i));
+    onPmtuProbeLost(conn);
+  }
+  EXPECT_EQ(1252, conn.udpSendPacketLen);
+  auto probeSize = *conn.pmtuDiscoveryState.probeSize;
+  EXPECT_GT(probeSize, 1252);
+  EXPECT_LT(probeSize, kDefaultMaxPmtuProbeSize);
+
+  onPmtuProbeSent(conn, 20);
+  onPmtuProbeAcked(conn);
+  EXPECT_EQ(probeSize, conn.udpSendPacketLen);
+
+  // Halves what is left until it is known closely enough.
+  PacketNum packetNum = 21;
+  while (hasPendingPmtuProbe(conn)) {
+    onPmtuProbeSent(conn, packetNum++);
+    onPmtuProbeAcked(conn);
+    ASSERT_LT(packetNum, 40);
+  }
+  EXPECT_GE(
+      conn.udpSendPacketLen + kPmtuSearchResolution, kDefaultMaxPmtuProbeSize);
+  EXPECT_LT(conn.udpSendPacketLen, kDefaultMaxPmtuProbeSize);
+
+  // A new path starts over.
+  restartPmtuDiscovery(conn);
+  EXPECT_EQ(1252, conn.udpSendPacketLen);
+  EXPECT_EQ(kDefaultMaxPmtuProbeSize, *conn.pmtuDiscoveryState.probeSize);
+}
+
+TEST_F(QuicStateFunctionsTest, PmtuDiscoveryLimitedByPeer) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  conn.transportSettings.pmtuDiscoveryEnabled = true;
+  conn.udpSendPacketLen = 1252;
+  startPmtuDiscovery(conn, 1260);
+  EXPECT_FALSE(hasPendingPmtuProbe(conn));
+  startPmtuDiscovery(conn, 1400);
+  ASSERT_TRUE(hasPendingPmtuProbe(conn));
+  EXPECT_EQ(1400, *conn.pmtuDiscoveryState.probeSize);
+  onPmtuProbeSent(conn, 1);
+  onPmtuProbeAcked(conn);
+  EXPECT_EQ(1400, conn.udpSendPacketLen);
+  EXPECT_FALSE(hasPendingPmtuProbe(conn));
+}
+
+TEST_F(QuicStateFunctionsTest, JumboFrameProfile) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  applyJumboFrameProfile(conn.transportSettings);
+  EXPECT_EQ(kJumboFrameUDPPayload, conn.transportSettings.maxRecvPacketSize);
+  EXPECT_GE(
+      packetBufferPoolBufSize(conn.transportSettings),
+      kJumboFrameUDPPayload + kPacketBufferPoolHeadroom);
+
+  // The peer with the same profile advertises a jumbo packet, the first
+  // probe is for one.
+  startPmtuDiscovery(conn, conn.transportSettings.maxRecvPacketSize);
+  ASSERT_TRUE(hasPendingPmtuProbe(conn));
+  EXPECT_EQ(kJumboFrameUDPPayload, *conn.pmtuDiscoveryState.probeSize);
+  onPmtuProbeSent(conn, 1);
+  onPmtuProbeAcked(conn);
+  EXPECT_EQ(kJumboFrameUDPPayload, conn.udpSendPacketLen);
+  EXPECT_FALSE(hasPendingPmtuProbe(conn));
+}
+
 TEST_P(QuicStateFunctionsTest, CloseTranportStateChange) {
   QuicConnectionStateBase conn(QuicNodeType::Server);
   getAckState(conn, GetParam()).nextPacketNum = kMaxPacketNumber - 2;
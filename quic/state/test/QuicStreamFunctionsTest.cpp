@@ -14,6 +14,7 @@
 
 #include <quic/client/handshake/FizzClientQuicHandshakeContext.h>
 #include <quic/client/state/ClientStateMachine.h>
+#include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/server/state/ServerStateMachine.h>
 
@@ -25,7 +26,7 @@ namespace test {
 
 constexpr uint8_t kStreamIncrement = 0x04;
 
-using PeekIterator = std::deque<StreamBuffer>::const_iterator;
+using PeekIterator = StreamReadBuffer::const_iterator;
 
 class QuicStreamFunctionsTest : public Test {
  public:
@@ -111,6 +112,46 @@ TEST_F(QuicStreamFunctionsTest, TestWriteStream) {
   EXPECT_TRUE(eq(stream->writeBuffer.move(), buf1));
 }
 
+TEST_F(QuicStreamFunctionsTest, TestWriteStreamPacksSmallWrites) {
+  conn.transportSettings.packSmallStreamWrites = true;
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  for (int i = 0; i < 10; ++i) {
+    writeDataToQuicStream(*stream, IOBuf::copyBuffer("0123456789"), false);
+  }
+  EXPECT_EQ(100, stream->writeBuffer.chainLength());
+  EXPECT_EQ(1, stream->writeBuffer.front()->countChainElements());
+
+  // What is sent is a slice of the page, the writes after are still packed.
+  auto sent = stream->writeBuffer.splitAtMost(25);
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("0123456789"), false);
+  EXPECT_EQ(85, stream->writeBuffer.chainLength());
+  EXPECT_EQ(1, stream->writeBuffer.front()->countChainElements());
+  EXPECT_EQ(sent->data() + 25, stream->writeBuffer.front()->data());
+
+  std::string large(conn.transportSettings.packedStreamWriteMaxLength + 1, 'a');
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer(large), false);
+  EXPECT_EQ(2, stream->writeBuffer.front()->countChainElements());
+}
+
+TEST_F(QuicStreamFunctionsTest, TestWriteReplaySafeOnlyStream) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  auto replaySafeOnlyStream =
+      conn.streamManager->createNextBidirectionalStream().value();
+  replaySafeOnlyStream->replaySafeOnly = true;
+
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("idempotent"), false);
+  writeDataToQuicStream(
+      *replaySafeOnlyStream, IOBuf::copyBuffer("not idempotent"), false);
+  EXPECT_TRUE(conn.streamManager->writableContains(stream->id));
+  EXPECT_FALSE(conn.streamManager->writableContains(replaySafeOnlyStream->id));
+  EXPECT_EQ(1, conn.streamManager->numReplaySafeOnlyStreams());
+
+  conn.oneRttWriteCipher = test::createNoOpAead();
+  conn.streamManager->onReplaySafe();
+  EXPECT_TRUE(conn.streamManager->writableContains(replaySafeOnlyStream->id));
+  EXPECT_EQ(0, conn.streamManager->numReplaySafeOnlyStreams());
+}
+
 TEST_F(QuicStreamFunctionsTest, TestReadDataWrittenInOrder) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto streamLastMaxOffset = stream->maxOffsetObserved;
@@ -149,6 +190,52 @@ TEST_F(QuicStreamFunctionsTest, TestReadDataWrittenInOrder) {
   EXPECT_TRUE(readData4.second);
 }
 
+TEST_F(QuicStreamFunctionsTest, TestInOrderDataKeptInOneSegment) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("abc"), 0));
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("def"), 3));
+  ASSERT_EQ(stream->readBuffer.size(), 1);
+  EXPECT_EQ(stream->readBuffer.back().data.chainLength(), 6);
+
+  // Past the tail starts a new segment, filling the gap joins them.
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("jkl"), 9));
+  ASSERT_EQ(stream->readBuffer.size(), 2);
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("ghi"), 6));
+  ASSERT_EQ(stream->readBuffer.size(), 1);
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("mno"), 12, true));
+  ASSERT_EQ(stream->readBuffer.size(), 1);
+  EXPECT_TRUE(stream->readBuffer.back().eof);
+
+  auto readData = readDataFromQuicStream(*stream);
+  EXPECT_EQ("abcdefghijklmno", readData.first->moveToFbString().toStdString());
+  EXPECT_TRUE(readData.second);
+  EXPECT_TRUE(stream->readBuffer.empty());
+}
+
+TEST_F(QuicStreamFunctionsTest, TestReadWholeSegmentMovesChain) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("abc"), 0));
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("def"), 3));
+  appendDataToReadBuffer(*stream, StreamBuffer(IOBuf::copyBuffer("ghi"), 6));
+
+  const IOBuf* peeked = nullptr;
+  peekDataFromQuicStream(
+      *stream, [&](StreamId, const folly::Range<PeekIterator>& range) {
+        ASSERT_EQ(range.size(), 1);
+        peeked = range.begin()->data.front();
+      });
+  ASSERT_NE(peeked, nullptr);
+
+  // The segment is handed out as the chain that was peeked at.
+  auto readData = readDataFromQuicStream(*stream);
+  EXPECT_EQ(readData.first.get(), peeked);
+  EXPECT_EQ(readData.first->countChainElements(), 3);
+  EXPECT_FALSE(readData.first->isSharedOne());
+  EXPECT_EQ("abcdefghi", readData.first->moveToFbString().toStdString());
+  EXPECT_TRUE(stream->readBuffer.empty());
+}
+
 TEST_F(QuicStreamFunctionsTest, TestPeekAndConsumeContiguousData) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto streamLastMaxOffset = stream->maxOffsetObserved;
@@ -891,10 +978,7 @@ TEST_F(QuicServerStreamFunctionsTest, GetOrCreateClientOutOfOrderStream) {
       conn.streamManager->openBidirectionalPeerStreams().size(),
       ((outOfOrderStream) / kStreamIncrement) + 1);
 
-  conn.streamManager->openBidirectionalPeerStreams().erase(std::find(
-      conn.streamManager->openBidirectionalPeerStreams().begin(),
-      conn.streamManager->openBidirectionalPeerStreams().end(),
-      closedStream));
+  conn.streamManager->openBidirectionalPeerStreams().remove(closedStream);
   EXPECT_EQ(conn.streamManager->getStream(closedStream), nullptr);
 }
 
@@ -921,10 +1005,7 @@ TEST_F(QuicServerStreamFunctionsTest, GetOrCreateClosedClientStream) {
   StreamId outOfOrderStream1 = 100;
   StreamId closedStream = 48;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openBidirectionalPeerStreams().erase(std::find(
-      conn.streamManager->openBidirectionalPeerStreams().begin(),
-      conn.streamManager->openBidirectionalPeerStreams().end(),
-      closedStream));
+  conn.streamManager->openBidirectionalPeerStreams().remove(closedStream);
   EXPECT_EQ(conn.streamManager->getStream(closedStream), nullptr);
 }
 
@@ -934,10 +1015,7 @@ TEST_F(
   StreamId outOfOrderStream1 = 96;
   StreamId outOfOrderStream2 = 100;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openBidirectionalPeerStreams().erase(std::find(
-      conn.streamManager->openBidirectionalPeerStreams().begin(),
-      conn.streamManager->openBidirectionalPeerStreams().end(),
-      outOfOrderStream1));
+  conn.streamManager->openBidirectionalPeerStreams().remove(outOfOrderStream1);
   conn.streamManager->getStream(outOfOrderStream2);
   EXPECT_EQ(
       conn.streamManager->openBidirectionalPeerStreams().size(),
@@ -948,10 +1026,7 @@ TEST_F(QuicStreamFunctionsTest, GetOrCreateServerStreamAfterClosingLastStream) {
   StreamId outOfOrderStream1 = 97;
   StreamId outOfOrderStream2 = 101;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openBidirectionalPeerStreams().erase(std::find(
-      conn.streamManager->openBidirectionalPeerStreams().begin(),
-      conn.streamManager->openBidirectionalPeerStreams().end(),
-      outOfOrderStream1));
+  conn.streamManager->openBidirectionalPeerStreams().remove(outOfOrderStream1);
   conn.streamManager->getStream(outOfOrderStream2);
   EXPECT_EQ(
       conn.streamManager->openBidirectionalPeerStreams().size(),
@@ -962,10 +1037,7 @@ TEST_F(QuicStreamFunctionsTest, GetOrCreateClosedServerStream) {
   StreamId outOfOrderStream1 = 97;
   StreamId closedStream = 49;
   conn.streamManager->getStream(outOfOrderStream1);
-  conn.streamManager->openBidirectionalPeerStreams().erase(std::find(
-      conn.streamManager->openBidirectionalPeerStreams().begin(),
-      conn.streamManager->openBidirectionalPeerStreams().end(),
-      closedStream));
+  conn.streamManager->openBidirectionalPeerStreams().remove(closedStream);
   EXPECT_EQ(conn.streamManager->getStream(closedStream), nullptr);
 }
 
@@ -1025,10 +1097,7 @@ TEST_F(QuicServerStreamFunctionsTest, CreateClosedServerStream) {
   StreamId outOfOrderStream1 = 101;
   StreamId outOfOrderStream2 = 49;
   conn.streamManager->createStream(outOfOrderStream1);
-  conn.streamManager->openBidirectionalLocalStreams().erase(std::find(
-      conn.streamManager->openBidirectionalLocalStreams().begin(),
-      conn.streamManager->openBidirectionalLocalStreams().end(),
-      outOfOrderStream2));
+  conn.streamManager->openBidirectionalLocalStreams().remove(outOfOrderStream2);
   EXPECT_FALSE(conn.streamManager->createStream(outOfOrderStream2));
 }
 
@@ -1036,10 +1105,7 @@ TEST_F(QuicStreamFunctionsTest, CreateClosedClientStream) {
   StreamId outOfOrderStream1 = 96;
   StreamId outOfOrderStream2 = 48;
   conn.streamManager->createStream(outOfOrderStream1).value();
-  conn.streamManager->openBidirectionalLocalStreams().erase(std::find(
-      conn.streamManager->openBidirectionalLocalStreams().begin(),
-      conn.streamManager->openBidirectionalLocalStreams().end(),
-      outOfOrderStream2));
+  conn.streamManager->openBidirectionalLocalStreams().remove(outOfOrderStream2);
   EXPECT_FALSE(conn.streamManager->createStream(outOfOrderStream2));
 }
 
@@ -1528,8 +1594,10 @@ TEST_F(QuicStreamFunctionsTest, HolbTimingReadDataCallsUpdateRL) {
 TEST_F(QuicStreamFunctionsTest, RemovedClosedState) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto streamId = stream->id;
-  conn.streamManager->readableStreams().emplace(streamId);
-  conn.streamManager->peekableStreams().emplace(streamId);
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(folly::IOBuf::copyBuffer("data"), 0));
+  conn.streamManager->updateReadableStreams(*stream);
+  conn.streamManager->updatePeekableStreams(*stream);
   conn.streamManager->addWritable(*stream);
   conn.streamManager->queueBlocked(streamId, 0);
   conn.streamManager->addDeliverable(streamId);
@@ -1734,11 +1802,7 @@ TEST_F(QuicStreamFunctionsTest, StreamExists) {
   EXPECT_TRUE(conn.streamManager->streamExists(peerStream));
   EXPECT_TRUE(conn.streamManager->streamExists(peerAutoOpened));
 
-  auto it = std::find(
-      conn.streamManager->openBidirectionalPeerStreams().begin(),
-      conn.streamManager->openBidirectionalPeerStreams().end(),
-      peerAutoOpened);
-  conn.streamManager->openBidirectionalPeerStreams().erase(it);
+  conn.streamManager->openBidirectionalPeerStreams().remove(peerAutoOpened);
 
   conn.streamManager->removeClosedStream(peerStream);
 
@@ -1898,6 +1962,39 @@ TEST_F(QuicStreamFunctionsTest, StreamNextOffsetToDeliverRetxAndLossBuffer) {
   EXPECT_EQ(30, getStreamNextOffsetToDeliver(stream));
 }
 
+TEST_F(QuicStreamFunctionsTest, WriteLatencies) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream, buildRandomInputData(10), false);
+  writeDataToQuicStream(*stream, buildRandomInputData(20), false);
+  ASSERT_EQ(2, stream->unsentWriteTimes.size());
+  EXPECT_EQ(10, stream->unsentWriteTimes[0].first);
+  EXPECT_EQ(30, stream->unsentWriteTimes[1].first);
+  auto writeTime = stream->unsentWriteTimes[1].second;
+
+  // Only the first write is sent in full.
+  stream->currentWriteOffset = 20;
+  updateWriteLatencyOnNewDataWritten(*stream, writeTime + 5ms);
+  EXPECT_EQ(1, conn.latencyHistograms.sendBuffer.count());
+  EXPECT_GE(conn.latencyHistograms.sendBuffer.max(), 5ms);
+  EXPECT_EQ(1, stream->unsentWriteTimes.size());
+  EXPECT_EQ(1, stream->undeliveredWriteTimes.size());
+
+  stream->currentWriteOffset = 30;
+  updateWriteLatencyOnNewDataWritten(*stream, writeTime + 6ms);
+  EXPECT_EQ(2, conn.latencyHistograms.sendBuffer.count());
+  EXPECT_TRUE(stream->unsentWriteTimes.empty());
+
+  stream->ackedIntervals.insert(0, 15);
+  updateWriteLatencyOnDelivery(*stream, writeTime + 20ms);
+  EXPECT_EQ(1, conn.latencyHistograms.delivery.count());
+  EXPECT_GE(conn.latencyHistograms.delivery.max(), 20ms);
+  EXPECT_EQ(1, stream->undeliveredWriteTimes.size());
+  stream->ackedIntervals.insert(15, 30);
+  updateWriteLatencyOnDelivery(*stream, writeTime + 30ms);
+  EXPECT_EQ(2, conn.latencyHistograms.delivery.count());
+  EXPECT_TRUE(stream->undeliveredWriteTimes.empty());
+}
+
 TEST_F(QuicStreamFunctionsTest, LossBufferEmpty) {
   StreamId id = 4;
   QuicStreamState stream(id, conn);
@@ -1930,6 +2027,38 @@ TEST_F(QuicStreamFunctionsTest, LossBufferStillHasData) {
   EXPECT_TRUE(conn.streamManager->hasLoss());
 }
 
+TEST_F(QuicStreamFunctionsTest, LossBufferMergesOverlappingData) {
+  StreamId id = 4;
+  QuicStreamState stream(id, conn);
+  // Writes the data and loses it, releasing the bytes the loss buffer drops
+  // as markPacketLoss does. Returns those.
+  auto writeAndLose = [&](const std::string& data, uint64_t offset, bool eof) {
+    updateUnackedBufferOnWriteToSocket(stream, data.size());
+    auto dropped = stream.insertIntoLossBuffer(
+        StreamBuffer(IOBuf::copyBuffer(data), offset, eof));
+    updateUnackedBufferOnRelease(stream, dropped);
+    return dropped;
+  };
+  EXPECT_EQ(0, writeAndLose("hello", 0, false));
+  EXPECT_EQ(0, writeAndLose("world!", 7, true));
+  EXPECT_EQ(2, stream.lossBuffer.size());
+  EXPECT_EQ(11, conn.flowControlState.sumUnackedStreamBufferLen);
+  // Bridges both, overlapping the first and touching the second.
+  EXPECT_EQ(3, writeAndLose("llo, ", 2, false));
+  ASSERT_EQ(1, stream.lossBuffer.size());
+  EXPECT_EQ(0, stream.lossBuffer[0].offset);
+  EXPECT_TRUE(stream.lossBuffer[0].eof);
+  auto data = stream.lossBuffer[0].data.front()->clone();
+  EXPECT_EQ("hello, world!", data->moveToFbString().toStdString());
+  EXPECT_EQ(13, conn.flowControlState.sumUnackedStreamBufferLen);
+  // Contained in what is lost already.
+  EXPECT_EQ(3, writeAndLose("wor", 7, false));
+  ASSERT_EQ(1, stream.lossBuffer.size());
+  EXPECT_EQ(13, stream.lossBuffer[0].data.chainLength());
+  EXPECT_EQ(13, stream.unackedBufferLen);
+  EXPECT_EQ(13, conn.flowControlState.sumUnackedStreamBufferLen);
+}
+
 TEST_F(QuicStreamFunctionsTest, WritableList) {
   StreamId id = 3;
   QuicStreamState stream(id, conn);
@@ -1964,6 +2093,33 @@ TEST_F(QuicStreamFunctionsTest, WritableList) {
   EXPECT_FALSE(stream.conn.streamManager->writableContains(id));
 }
 
+TEST_F(QuicStreamFunctionsTest, ReadCryptoStreamWithoutCopies) {
+  auto& cryptoStream = conn.cryptoState->handshakeStream;
+  auto first = IOBuf::copyBuffer("certificate");
+  auto second = IOBuf::copyBuffer("verify");
+  auto third = IOBuf::copyBuffer("finished");
+  const uint8_t* firstData = first->data();
+  const uint8_t* secondData = second->data();
+  const uint8_t* thirdData = third->data();
+  auto thirdOffset = first->length() + second->length();
+  appendDataToReadBuffer(cryptoStream, StreamBuffer(std::move(first), 0));
+  appendDataToReadBuffer(
+      cryptoStream, StreamBuffer(std::move(third), thirdOffset));
+  appendDataToReadBuffer(
+      cryptoStream, StreamBuffer(std::move(second), thirdOffset - 6));
+
+  // The frames are handed to the handshake as they were received, chained
+  // rather than coalesced.
+  auto data = readDataFromCryptoStream(cryptoStream);
+  ASSERT_TRUE(data);
+  EXPECT_EQ(3, data->countChainElements());
+  EXPECT_EQ(firstData, data->data());
+  EXPECT_EQ(secondData, data->next()->data());
+  EXPECT_EQ(thirdData, data->next()->next()->data());
+  EXPECT_EQ("certificateverifyfinished", data->moveToFbString().toStdString());
+  EXPECT_TRUE(cryptoStream.readBuffer.empty());
+}
+
 TEST_F(QuicStreamFunctionsTest, AckCryptoStream) {
   auto chlo = IOBuf::copyBuffer("CHLO");
   conn.cryptoState->handshakeStream.retransmissionBuffer.emplace(
@@ -179,6 +179,151 @@ TEST_F(QuicStreamManagerTest, TestAppIdleCloseControlStream) {
   EXPECT_TRUE(manager.isAppIdle());
 }
 
+TEST_F(QuicStreamManagerTest, WritableStreamPriority) {
+  auto& manager = *conn.streamManager;
+  auto stream = manager.createNextBidirectionalStream().value();
+  auto& writableStreams = manager.writableStreams();
+  manager.addWritable(*stream);
+  EXPECT_EQ(writableStreams.level(kDefaultPriority).size, 1);
+
+  Priority priority(0, false);
+  manager.setStreamPriority(*stream, priority);
+  EXPECT_EQ(stream->priority, priority);
+  EXPECT_FALSE(writableStreams.level(kDefaultPriority).head.has_value());
+  EXPECT_EQ(writableStreams.level(priority).head, stream->id);
+  EXPECT_EQ(writableStreams.size(), 1);
+
+  manager.removeWritable(*stream);
+  EXPECT_TRUE(writableStreams.empty());
+  EXPECT_EQ(writableStreams.level(priority).size, 0);
+
+  // Not writable, only the stream remembers the priority.
+  manager.setStreamPriority(*stream, kDefaultPriority);
+  EXPECT_TRUE(writableStreams.empty());
+  manager.addWritable(*stream);
+  EXPECT_EQ(writableStreams.level(kDefaultPriority).head, stream->id);
+}
+
+TEST_F(QuicStreamManagerTest, WritableStreamsRing) {
+  auto& manager = *conn.streamManager;
+  auto& writableStreams = manager.writableStreams();
+  std::vector<StreamId> ids;
+  for (int i = 0; i < 4; ++i) {
+    auto stream = manager.createNextBidirectionalStream().value();
+    manager.addWritable(*stream);
+    ids.push_back(stream->id);
+  }
+  auto index = PriorityQueue::levelIndex(kDefaultPriority);
+  const auto& level = writableStreams.level(kDefaultPriority);
+  EXPECT_EQ(level.size, 4);
+  EXPECT_EQ(level.head, ids[0]);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(writableStreams.nextInLevel(ids[i]), ids[(i + 1) % ids.size()]);
+  }
+
+  // Removing the head hands the round over to the next stream.
+  manager.removeWritable(*manager.findStream(ids[0]));
+  EXPECT_EQ(level.head, ids[1]);
+  writableStreams.setHead(index, ids[3]);
+  manager.removeWritable(*manager.findStream(ids[2]));
+  EXPECT_EQ(writableStreams.nextInLevel(ids[1]), ids[3]);
+  EXPECT_EQ(writableStreams.nextInLevel(ids[3]), ids[1]);
+
+  // Streams that become writable again join at the back of the ring.
+  manager.addWritable(*manager.findStream(ids[0]));
+  EXPECT_EQ(level.size, 3);
+  EXPECT_EQ(writableStreams.nextInLevel(ids[1]), ids[0]);
+  EXPECT_EQ(writableStreams.nextInLevel(ids[0]), ids[3]);
+
+  manager.clearWritable();
+  EXPECT_TRUE(writableStreams.empty());
+  EXPECT_FALSE(level.head.has_value());
+}
+
+TEST_F(QuicStreamManagerTest, ReadableAndPeekableMembership) {
+  auto& manager = *conn.streamManager;
+  auto stream = manager.createNextBidirectionalStream().value();
+  stream->readBuffer.emplace_back(folly::IOBuf::copyBuffer("data"), 0);
+  manager.updateReadableStreams(*stream);
+  manager.updatePeekableStreams(*stream);
+  EXPECT_TRUE(stream->inReadableStreams);
+  EXPECT_TRUE(stream->inPeekableStreams);
+  EXPECT_EQ(manager.readableStreams().count(stream->id), 1);
+  EXPECT_EQ(manager.peekableStreams().count(stream->id), 1);
+
+  // Once removed, the next update tracks the stream again.
+  manager.removePeekable(stream->id);
+  EXPECT_FALSE(stream->inPeekableStreams);
+  EXPECT_TRUE(manager.peekableStreams().empty());
+  manager.updatePeekableStreams(*stream);
+  EXPECT_TRUE(stream->inPeekableStreams);
+  EXPECT_EQ(manager.peekableStreams().count(stream->id), 1);
+
+  stream->readBuffer.clear();
+  manager.updateReadableStreams(*stream);
+  manager.updatePeekableStreams(*stream);
+  EXPECT_FALSE(stream->inReadableStreams);
+  EXPECT_FALSE(stream->inPeekableStreams);
+  EXPECT_TRUE(manager.readableStreams().empty());
+  EXPECT_TRUE(manager.peekableStreams().empty());
+
+  stream->streamReadError = QuicErrorCode(LocalErrorCode::NO_ERROR);
+  manager.updateReadableStreams(*stream);
+  EXPECT_TRUE(stream->inReadableStreams);
+  manager.clearActionable();
+  EXPECT_FALSE(stream->inReadableStreams);
+  EXPECT_TRUE(manager.readableStreams().empty());
+}
+
+TEST_F(QuicStreamManagerTest, StreamsKeepAddressAndReuseSlots) {
+  auto& manager = *conn.streamManager;
+  auto first = manager.createNextBidirectionalStream().value();
+  auto firstId = first->id;
+  for (int i = 0; i < 100; ++i) {
+    manager.createNextBidirectionalStream();
+  }
+  EXPECT_EQ(manager.findStream(firstId), first);
+
+  first->sendState = StreamSendState::Closed_E;
+  first->recvState = StreamRecvState::Closed_E;
+  manager.removeClosedStream(firstId);
+  EXPECT_EQ(manager.findStream(firstId), nullptr);
+
+  // The next stream is built where the closed one was.
+  auto next = manager.createNextBidirectionalStream().value();
+  EXPECT_EQ(next, first);
+  EXPECT_NE(next->id, firstId);
+  EXPECT_EQ(next->currentWriteOffset, 0);
+}
+
+TEST_F(QuicStreamManagerTest, PeerStreamsOpenedAsRange) {
+  auto& manager = *conn.streamManager;
+  conn.transportSettings.advertisedInitialMaxStreamsBidi = 5000;
+  manager.refreshTransportSettings(conn.transportSettings);
+  StreamId lastStream = 4000 * detail::kStreamIncrement;
+  manager.getStream(lastStream);
+  EXPECT_EQ(manager.streamCount(), 1);
+  EXPECT_EQ(manager.newPeerStreams().size(), 4001);
+  auto& openStreams = manager.openBidirectionalPeerStreams();
+  EXPECT_EQ(openStreams.size(), 4001);
+
+  StreamId closedStream = 100 * detail::kStreamIncrement;
+  openStreams.remove(closedStream);
+  EXPECT_EQ(openStreams.size(), 4000);
+  EXPECT_FALSE(manager.streamExists(closedStream));
+  EXPECT_TRUE(manager.streamExists(closedStream - detail::kStreamIncrement));
+  EXPECT_TRUE(manager.streamExists(closedStream + detail::kStreamIncrement));
+  EXPECT_TRUE(manager.streamExists(0));
+  EXPECT_TRUE(manager.streamExists(lastStream));
+  EXPECT_FALSE(manager.streamExists(lastStream + detail::kStreamIncrement));
+  EXPECT_EQ(manager.getStream(closedStream), nullptr);
+
+  // Implicitly opened streams get their state on first use.
+  auto nextStream = closedStream + detail::kStreamIncrement;
+  EXPECT_NE(manager.getStream(nextStream), nullptr);
+  EXPECT_EQ(manager.streamCount(), 2);
+}
+
 TEST_F(QuicStreamManagerTest, StreamLimitWindowedUpdate) {
   auto& manager = *conn.streamManager;
   conn.transportSettings.advertisedInitialMaxStreamsBidi = 100;
@@ -249,6 +394,44 @@ TEST_F(QuicStreamManagerTest, StreamLimitManyWindowedUpdate) {
   EXPECT_FALSE(manager.remoteUnidirectionalStreamLimitUpdate());
 }
 
+TEST_F(QuicStreamManagerTest, StreamLimitWindowAutoTuned) {
+  auto& manager = *conn.streamManager;
+  conn.transportSettings.advertisedInitialMaxStreamsBidi = 100;
+  conn.transportSettings.autoTuneStreamLimits = true;
+  conn.transportSettings.maxAutoTunedStreamLimit = 150;
+  conn.lossState.srtt = std::chrono::milliseconds(100);
+  manager.refreshTransportSettings(conn.transportSettings);
+  manager.setStreamLimitWindowingFraction(4);
+  for (int i = 0; i < 100; i++) {
+    manager.getStream(i * detail::kStreamIncrement);
+  }
+  auto closeStreams = [&](int from, int to) {
+    for (int i = from; i < to; i++) {
+      auto stream = manager.getStream(i * detail::kStreamIncrement);
+      stream->sendState = StreamSendState::Closed_E;
+      stream->recvState = StreamRecvState::Closed_E;
+      manager.removeClosedStream(stream->id);
+    }
+  };
+  // The first update has no earlier one to compare with.
+  closeStreams(0, 25);
+  auto update = manager.remoteBidirectionalStreamLimitUpdate();
+  ASSERT_TRUE(update);
+  EXPECT_EQ(update.value(), 125);
+  EXPECT_EQ(manager.remoteStreamLimitWindow(false), 100);
+
+  // The next window's worth of streams closes right away, so the window
+  // grows, up to maxAutoTunedStreamLimit.
+  closeStreams(25, 50);
+  update = manager.remoteBidirectionalStreamLimitUpdate();
+  ASSERT_TRUE(update);
+  EXPECT_EQ(update.value(), 200);
+  EXPECT_EQ(manager.remoteStreamLimitWindow(false), 150);
+  EXPECT_EQ(
+      manager.remoteStreamLimitWindow(true),
+      conn.transportSettings.advertisedInitialMaxStreamsUni);
+}
+
 TEST_F(QuicStreamManagerTest, StreamLimitIncrementBidi) {
   auto& manager = *conn.streamManager;
   manager.setMaxLocalBidirectionalStreams(100, true);
@@ -279,5 +462,27 @@ TEST_F(QuicStreamManagerTest, StreamLimitIncrementUni) {
   EXPECT_EQ(s.value()->id, max + detail::kStreamIncrement);
 }
 
+TEST_F(QuicStreamManagerTest, ReleaseMemoryIfNoStreams) {
+  auto& manager = *conn.streamManager;
+  auto stream = manager.createNextBidirectionalStream().value();
+  auto id = stream->id;
+  manager.queueWindowUpdate(id);
+  manager.releaseMemoryIfNoStreams();
+  EXPECT_EQ(stream, manager.findStream(id));
+  EXPECT_TRUE(manager.pendingWindowUpdate(id));
+
+  manager.removeWindowUpdate(id);
+  stream->sendState = StreamSendState::Closed_E;
+  stream->recvState = StreamRecvState::Closed_E;
+  manager.removeClosedStream(id);
+  EXPECT_EQ(0, manager.streamCount());
+  manager.releaseMemoryIfNoStreams();
+
+  auto next = manager.createNextBidirectionalStream();
+  ASSERT_TRUE(next.hasValue());
+  EXPECT_EQ(id + detail::kStreamIncrement, next.value()->id);
+  EXPECT_EQ(1, manager.streamCount());
+}
+
 } // namespace test
 } // namespace quic
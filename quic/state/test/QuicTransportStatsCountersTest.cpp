@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/QuicTransportStatsCounters.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/state/test/MockQuicStats.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+using Counter = QuicTransportStatsCounters::Counter;
+
+TEST(QuicTransportStatsCountersTest, SnapshotAndDifference) {
+  QuicTransportStatsCounters counters;
+  auto empty = counters.snapshot();
+  for (auto counter : empty.keys()) {
+    EXPECT_EQ(0, empty[counter]);
+  }
+
+  counters.add(Counter::PacketsSent);
+  counters.add(Counter::BytesWritten, 1200);
+  auto first = counters.snapshot();
+  EXPECT_EQ(1, first[Counter::PacketsSent]);
+  EXPECT_EQ(1200, first[Counter::BytesWritten]);
+  EXPECT_EQ(0, first[Counter::PacketsReceived]);
+
+  counters.add(Counter::PacketsSent);
+  counters.add(Counter::BytesWritten, 800);
+  counters.add(Counter::PTOs);
+  auto delta =
+      QuicTransportStatsCounters::difference(counters.snapshot(), first);
+  EXPECT_EQ(1, delta[Counter::PacketsSent]);
+  EXPECT_EQ(800, delta[Counter::BytesWritten]);
+  EXPECT_EQ(1, delta[Counter::PTOs]);
+  EXPECT_EQ(0, delta[Counter::SpuriousLosses]);
+}
+
+TEST(QuicTransportStatsCountersTest, CountInsteadOfCallback) {
+  MockQuicStats stats;
+  QuicTransportStatsCounters counters;
+  QuicTransportStatsCounters* statsCounters = &counters;
+  EXPECT_CALL(stats, onWrite(_)).Times(0);
+  QUIC_STATS_COUNTER(statsCounters, BytesWritten, 100, &stats, onWrite, 100);
+  EXPECT_EQ(100, counters.snapshot()[Counter::BytesWritten]);
+  Mock::VerifyAndClearExpectations(&stats);
+
+  statsCounters = nullptr;
+  EXPECT_CALL(stats, onWrite(100));
+  QUIC_STATS_COUNTER(statsCounters, BytesWritten, 100, &stats, onWrite, 100);
+  EXPECT_EQ(100, counters.snapshot()[Counter::BytesWritten]);
+}
+
+} // namespace test
+} // namespace quic
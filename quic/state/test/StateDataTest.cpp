@@ -28,6 +28,21 @@ TEST_F(StateDataTest, EmptyLossEvent) {
   EXPECT_FALSE(loss.largestLostPacketNum);
 }
 
+TEST_F(StateDataTest, OutstandingPacketCopiesHeaderFields) {
+  RegularQuicWritePacket packet(LongHeader(
+      LongHeader::Types::Handshake,
+      getTestConnectionId(1),
+      getTestConnectionId(),
+      100,
+      kVersion));
+  OutstandingPacket outstandingPacket(packet, Clock::now(), 1234, true, 1234);
+  EXPECT_EQ(100, outstandingPacket.packetNum);
+  EXPECT_EQ(PacketNumberSpace::Handshake, outstandingPacket.packetNumberSpace);
+  EXPECT_EQ(
+      outstandingPacket.packetNum,
+      outstandingPacket.packet.header.getPacketSequenceNum());
+}
+
 TEST_F(StateDataTest, SingleLostPacketEvent) {
   RegularQuicWritePacket packet(LongHeader(
       LongHeader::Types::Initial,
@@ -94,6 +109,13 @@ TEST_F(PendingPathRateLimiterTest, TestSetInitialCredit) {
       kMinCwndInMss * 2000);
 }
 
+TEST_F(PendingPathRateLimiterTest, TestRaisedCredit) {
+  PendingPathRateLimiter limiter2{conn_.udpSendPacketLen, kInitCwndInMss};
+  EXPECT_EQ(
+      limiter2.currentCredit(now, std::chrono::microseconds{kRtt}),
+      kInitCwndInMss * conn_.udpSendPacketLen);
+}
+
 TEST_F(PendingPathRateLimiterTest, TestNoImmediateCreditRefresh) {
   EXPECT_EQ(
       limiter_.currentCredit(now, std::chrono::microseconds{kRtt}),
@@ -144,5 +166,171 @@ TEST_F(PendingPathRateLimiterTest, TestCreditRefreshOnInfrequentSends) {
       maxWindowBytes);
 }
 
+TEST_F(StateDataTest, RecvmmsgStorageReusesReadBuffers) {
+  RecvmmsgStorage storage;
+  storage.resize(3);
+  storage.prepareReadBuffers(1500);
+  std::vector<folly::IOBuf*> bufs;
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(storage.readBuffers[i]);
+    EXPECT_GE(storage.readBuffers[i]->capacity(), 1500);
+    EXPECT_EQ(
+        storage.readBuffers[i]->writableData(), storage.iovecs[i].iov_base);
+    bufs.push_back(storage.readBuffers[i].get());
+  }
+
+  // only the slot whose buffer was taken gets a new one
+  auto filled = std::move(storage.readBuffers[1]);
+  storage.prepareReadBuffers(1500);
+  EXPECT_EQ(bufs[0], storage.readBuffers[0].get());
+  ASSERT_TRUE(storage.readBuffers[1]);
+  EXPECT_NE(filled.get(), storage.readBuffers[1].get());
+  EXPECT_EQ(bufs[2], storage.readBuffers[2].get());
+
+  // larger reads need larger buffers
+  storage.prepareReadBuffers(kGROReadBufferSize);
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_GE(storage.readBuffers[i]->capacity(), kGROReadBufferSize);
+  }
+}
+
+TEST_F(StateDataTest, PacketEventSet) {
+  PacketEventSet events;
+  EXPECT_TRUE(events.empty());
+  EXPECT_EQ(events.count(100), 0);
+
+  EXPECT_TRUE(events.insert(100));
+  EXPECT_FALSE(events.insert(100));
+  EXPECT_TRUE(events.emplace(300));
+  // below the window
+  EXPECT_TRUE(events.insert(5));
+  EXPECT_EQ(events.size(), 3);
+  EXPECT_EQ(events.count(5), 1);
+  EXPECT_EQ(events.count(100), 1);
+  EXPECT_EQ(events.count(300), 1);
+  EXPECT_EQ(events.count(4), 0);
+  EXPECT_EQ(events.count(101), 0);
+  EXPECT_EQ(events.count(1000), 0);
+
+  EXPECT_EQ(events.erase(5), 1);
+  EXPECT_EQ(events.erase(5), 0);
+  EXPECT_EQ(events.count(100), 1);
+  EXPECT_EQ(events.erase(300), 1);
+  EXPECT_EQ(events.count(100), 1);
+  EXPECT_EQ(events.erase(100), 1);
+  EXPECT_TRUE(events.empty());
+
+  EXPECT_TRUE(events.insert(7));
+  EXPECT_EQ(events.count(7), 1);
+  events.clear();
+  EXPECT_EQ(events.count(7), 0);
+  EXPECT_TRUE(events.empty());
+}
+
+TEST_F(StateDataTest, PacketEventSetCapsWindow) {
+  PacketEventSet events;
+  constexpr PacketNum kWindow = PacketEventSet::kMaxWindowWords * 64;
+  // A stale event would pin the start of the window.
+  EXPECT_TRUE(events.insert(10));
+  for (PacketNum event = kWindow; event < 3 * kWindow; event += 100) {
+    EXPECT_TRUE(events.insert(event));
+  }
+  EXPECT_EQ(events.count(10), 1);
+  EXPECT_EQ(events.count(kWindow), 1);
+  EXPECT_EQ(events.count(3 * kWindow - 100), 1);
+  EXPECT_EQ(events.count(kWindow + 1), 0);
+  EXPECT_FALSE(events.insert(10));
+  EXPECT_FALSE(events.insert(kWindow));
+  // Far behind the window.
+  EXPECT_TRUE(events.insert(11));
+  EXPECT_EQ(events.count(11), 1);
+  auto size = events.size();
+  EXPECT_EQ(events.erase(10), 1);
+  EXPECT_EQ(events.erase(11), 1);
+  EXPECT_EQ(events.erase(kWindow), 1);
+  EXPECT_EQ(events.erase(kWindow), 0);
+  EXPECT_EQ(events.size(), size - 3);
+  for (PacketNum event = kWindow + 100; event < 3 * kWindow; event += 100) {
+    EXPECT_EQ(events.erase(event), 1);
+  }
+  EXPECT_TRUE(events.empty());
+  EXPECT_TRUE(events.insert(kWindow));
+  EXPECT_EQ(events.count(kWindow), 1);
+}
+
+namespace {
+OutstandingPacket makeOutstandingPacket(PacketNum packetNum) {
+  RegularQuicWritePacket packet(ShortHeader(
+      ProtectionType::KeyPhaseZero, getTestConnectionId(), packetNum));
+  return OutstandingPacket(std::move(packet), Clock::now(), 100, false, 100);
+}
+
+std::vector<PacketNum> packetNums(const OutstandingPackets::Queue& packets) {
+  std::vector<PacketNum> nums;
+  for (const auto& packet : packets) {
+    nums.push_back(packet.packetNum);
+  }
+  return nums;
+}
+} // namespace
+
+TEST_F(StateDataTest, OutstandingPacketRing) {
+  OutstandingPackets::Queue packets;
+  EXPECT_TRUE(packets.empty());
+  EXPECT_TRUE(packets.begin() == packets.end());
+  EXPECT_TRUE(packets.find(0) == packets.end());
+
+  for (PacketNum packetNum = 10; packetNum < 15; ++packetNum) {
+    packets.emplace_back(makeOutstandingPacket(packetNum));
+  }
+  // Pure acks leave holes.
+  packets.emplace_back(makeOutstandingPacket(20));
+  EXPECT_EQ(packets.size(), 6);
+  EXPECT_EQ(packets.front().packetNum, 10);
+  EXPECT_EQ(packets.back().packetNum, 20);
+  EXPECT_EQ(
+      packetNums(packets), std::vector<PacketNum>({10, 11, 12, 13, 14, 20}));
+  EXPECT_EQ(packets.find(12)->packetNum, 12);
+  EXPECT_TRUE(packets.find(9) == packets.end());
+  EXPECT_TRUE(packets.find(17) == packets.end());
+  EXPECT_TRUE(packets.find(21) == packets.end());
+
+  auto it = packets.erase(packets.find(12));
+  EXPECT_EQ(it->packetNum, 13);
+  EXPECT_TRUE(packets.find(12) == packets.end());
+  EXPECT_EQ(packets.size(), 5);
+  EXPECT_EQ(packetNums(packets), std::vector<PacketNum>({10, 11, 13, 14, 20}));
+
+  std::vector<PacketNum> reversed;
+  for (auto rit = packets.rbegin(); rit != packets.rend(); ++rit) {
+    reversed.push_back(rit->packetNum);
+  }
+  EXPECT_EQ(reversed, std::vector<PacketNum>({20, 14, 13, 11, 10}));
+
+  // The front moves past the tombstones.
+  packets.erase(packets.find(10));
+  packets.erase(packets.find(11));
+  EXPECT_EQ(packets.front().packetNum, 13);
+  // So does the back.
+  it = packets.erase(packets.find(20));
+  EXPECT_TRUE(it == packets.end());
+  EXPECT_EQ(packets.back().packetNum, 14);
+  EXPECT_EQ(packetNums(packets), std::vector<PacketNum>({13, 14}));
+
+  // Out of order, below the front.
+  packets.emplace_back(makeOutstandingPacket(8));
+  EXPECT_EQ(packets.front().packetNum, 8);
+  EXPECT_EQ(packetNums(packets), std::vector<PacketNum>({8, 13, 14}));
+
+  packets.erase(packets.begin(), packets.end());
+  EXPECT_TRUE(packets.empty());
+  EXPECT_TRUE(packets.begin() == packets.end());
+  packets.emplace_back(makeOutstandingPacket(30));
+  EXPECT_EQ(packets.front().packetNum, 30);
+  EXPECT_EQ(packets.back().packetNum, 30);
+  packets.pop_back();
+  EXPECT_TRUE(packets.empty());
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/StreamRepairFunctions.h>
+#include <quic/state/stream/StreamReceiveHandlers.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class StreamRepairFunctionsTest : public Test {
+ public:
+  void SetUp() override {
+    conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+        kDefaultStreamWindowSize;
+    conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        kDefaultStreamWindowSize;
+    conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetUni =
+        kDefaultStreamWindowSize;
+    conn.flowControlState.peerAdvertisedMaxOffset =
+        kDefaultConnectionWindowSize;
+    conn.streamManager->setMaxLocalBidirectionalStreams(
+        kDefaultMaxStreamsBidirectional);
+    conn.streamManager->setMaxLocalUnidirectionalStreams(
+        kDefaultMaxStreamsUnidirectional);
+    conn.transportSettings.streamRepairReceiveWindow = 1000;
+    conn.transportSettings.streamRepairBudget = 1000;
+    conn.streamRepairState.peerReceiveWindow = 1000;
+  }
+
+  // Has the stream sent the data in frames of the given lengths, all unacked.
+  void sendFrames(
+      QuicStreamState& stream,
+      const std::string& data,
+      const std::vector<uint64_t>& lengths) {
+    uint64_t offset = 0;
+    for (auto length : lengths) {
+      bool eof = offset + length == data.size();
+      stream.retransmissionBuffer.emplace(
+          std::piecewise_construct,
+          std::forward_as_tuple(offset),
+          std::forward_as_tuple(
+              IOBuf::copyBuffer(data.substr(offset, length)), offset, eof));
+      offset += length;
+    }
+    stream.currentWriteOffset = data.size() + 1;
+    stream.finalWriteOffset = data.size();
+  }
+
+  QuicServerConnectionState conn;
+};
+
+TEST_F(StreamRepairFunctionsTest, RebuildLostFrame) {
+  std::string data = "the quick brown fox jumps";
+  auto sender = conn.streamManager->createNextBidirectionalStream().value();
+  sendFrames(*sender, data, {10, 10, 5});
+  // Nothing is protected until the app asks for it.
+  EXPECT_FALSE(maybeScheduleStreamRepair(conn));
+  conn.streamRepairState.streams.push_back(sender->id);
+  EXPECT_TRUE(maybeScheduleStreamRepair(conn));
+  ASSERT_EQ(conn.pendingEvents.frames.size(), 1);
+  auto repairFrame = *conn.pendingEvents.frames.front().asStreamRepairFrame();
+  std::vector<StreamRepairFrame::Range> ranges = {{0, 10}, {10, 10}, {20, 5}};
+  EXPECT_EQ(repairFrame.ranges, ranges);
+  EXPECT_TRUE(repairFrame.fin);
+  EXPECT_EQ(repairFrame.repair->computeChainDataLength(), 10);
+  EXPECT_EQ(sender->repairedOffset, data.size());
+  EXPECT_EQ(conn.streamRepairState.bytesSent, 10);
+  // The tail is covered already.
+  EXPECT_FALSE(maybeScheduleStreamRepair(conn));
+
+  // The peer got the first frame and read it, and the last one, but lost the
+  // one in between.
+  auto receiver = conn.streamManager->createNextBidirectionalStream().value();
+  receiveReadStreamFrameSMHandler(
+      *receiver,
+      ReadStreamFrame(
+          receiver->id, 0, IOBuf::copyBuffer(data.substr(0, 10)), false));
+  auto readData = readDataFromQuicStream(*receiver, 10);
+  EXPECT_EQ(readData.first->computeChainDataLength(), 10);
+  EXPECT_EQ(receiver->recentlyRead.chainLength(), 10);
+  receiveReadStreamFrameSMHandler(
+      *receiver,
+      ReadStreamFrame(
+          receiver->id, 20, IOBuf::copyBuffer(data.substr(20)), true));
+  EXPECT_FALSE(receiver->hasReadableData());
+
+  repairFrame.streamId = receiver->id;
+  onRecvStreamRepairFrame(conn, repairFrame);
+  ASSERT_TRUE(receiver->hasReadableData());
+  auto rebuilt = readDataFromQuicStream(*receiver, 100);
+  EXPECT_TRUE(rebuilt.second);
+  EXPECT_EQ(rebuilt.first->moveToFbString().toStdString(), data.substr(10));
+}
+
+TEST_F(StreamRepairFunctionsTest, TwoLostFramesNotRebuilt) {
+  std::string data = "the quick brown fox jumps";
+  auto sender = conn.streamManager->createNextBidirectionalStream().value();
+  sendFrames(*sender, data, {10, 10, 5});
+  conn.streamRepairState.streams.push_back(sender->id);
+  EXPECT_TRUE(maybeScheduleStreamRepair(conn));
+  auto repairFrame = *conn.pendingEvents.frames.front().asStreamRepairFrame();
+
+  auto receiver = conn.streamManager->createNextBidirectionalStream().value();
+  receiveReadStreamFrameSMHandler(
+      *receiver,
+      ReadStreamFrame(
+          receiver->id, 20, IOBuf::copyBuffer(data.substr(20)), true));
+  repairFrame.streamId = receiver->id;
+  onRecvStreamRepairFrame(conn, repairFrame);
+  ASSERT_EQ(receiver->readBuffer.size(), 1);
+  EXPECT_EQ(receiver->readBuffer.front().offset, 20);
+}
+
+TEST_F(StreamRepairFunctionsTest, StripesLongFrames) {
+  conn.udpSendPacketLen = kStreamRepairPacketOverhead + 8;
+  std::string data(40, 'a');
+  auto sender = conn.streamManager->createNextBidirectionalStream().value();
+  sendFrames(*sender, data, {20, 20});
+  conn.streamRepairState.streams.push_back(sender->id);
+  EXPECT_TRUE(maybeScheduleStreamRepair(conn));
+  // 8 byte stripes of each frame, the last ones 4 bytes long.
+  ASSERT_EQ(conn.pendingEvents.frames.size(), 3);
+  auto& lastStripe = *conn.pendingEvents.frames.back().asStreamRepairFrame();
+  std::vector<StreamRepairFrame::Range> ranges = {{16, 4}, {36, 4}};
+  EXPECT_EQ(lastStripe.ranges, ranges);
+  EXPECT_TRUE(lastStripe.fin);
+  EXPECT_FALSE(conn.pendingEvents.frames.front().asStreamRepairFrame()->fin);
+  EXPECT_EQ(conn.streamRepairState.bytesSent, 20);
+}
+
+TEST_F(StreamRepairFunctionsTest, BudgetSpent) {
+  conn.transportSettings.streamRepairBudget = 5;
+  std::string data = "the quick brown fox jumps";
+  auto sender = conn.streamManager->createNextBidirectionalStream().value();
+  sendFrames(*sender, data, {10, 10, 5});
+  conn.streamRepairState.streams.push_back(sender->id);
+  EXPECT_FALSE(maybeScheduleStreamRepair(conn));
+  EXPECT_TRUE(conn.pendingEvents.frames.empty());
+}
+
+} // namespace test
+} // namespace quic
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/tools/ccreplay/LinkSimulator.h>
+
+namespace quic {
+namespace ccreplay {
+
+namespace {
+// Ranges the receiver keeps and puts in every ack
+constexpr size_t kSimAckRanges = 32;
+constexpr std::chrono::microseconds kSimMinRetransmissionTimeout = 200ms;
+
+std::chrono::nanoseconds transmissionTime(
+    uint64_t bytes,
+    uint64_t bandwidthBytesPerSec) {
+  return std::chrono::nanoseconds(bytes * 1000000000 / bandwidthBytesPerSec);
+}
+} // namespace
+
+uint64_t SimulationResult::throughput() const noexcept {
+  if (duration == 0us) {
+    return 0;
+  }
+  return deliveredBytes * 1000000 / duration.count();
+}
+
+double SimulationResult::lossRate() const noexcept {
+  if (sentPackets == 0) {
+    return 0;
+  }
+  return static_cast<double>(droppedPackets) / sentPackets;
+}
+
+LinkSimulator::LinkSimulator(SimSender& sender, const LinkModel& link)
+    : LinkSimulator(std::vector<SimSender*>{&sender}, link) {}
+
+LinkSimulator::LinkSimulator(
+    std::vector<SimSender*> senders,
+    const LinkModel& link)
+    : link_(link),
+      bufferBytes_(
+          link.bufferBytes
+              ? link.bufferBytes
+              : link.bandwidthBytesPerSec * link.rtt.count() / 1000000),
+      random_(link.seed),
+      loss_(link.lossRate) {
+  CHECK_GT(link_.bandwidthBytesPerSec, 0);
+  CHECK(!senders.empty());
+  flows_.reserve(senders.size());
+  for (auto sender : senders) {
+    CHECK(sender);
+    flows_.emplace_back(*sender);
+  }
+  // The senders may have been run before, they all continue from the latest.
+  auto start = now();
+  for (auto& flow : flows_) {
+    flow.sender.advanceTo(start);
+  }
+  linkFreeAt_ = start;
+}
+
+SimulationResult LinkSimulator::run(std::chrono::microseconds duration) {
+  CHECK_EQ(flows_.size(), 1);
+  return runFlows(duration).front();
+}
+
+std::vector<SimulationResult> LinkSimulator::runFlows(
+    std::chrono::microseconds duration) {
+  auto end = now() + duration;
+  for (size_t i = 0; i < flows_.size(); i++) {
+    trySend(i);
+  }
+  while (!events_.empty() && events_.top().time <= end) {
+    auto event = events_.top();
+    events_.pop();
+    for (auto& flow : flows_) {
+      flow.sender.advanceTo(event.time);
+    }
+    handle(event);
+    trySend(event.flow);
+  }
+  std::vector<SimulationResult> results;
+  results.reserve(flows_.size());
+  for (auto& flow : flows_) {
+    flow.sender.advanceTo(end);
+    flow.result.duration += duration;
+    flow.result.lostPackets = flow.sender.lostPackets();
+    if (flow.queuedPackets > 0) {
+      flow.result.avgQueueingDelay =
+          flow.totalQueueingDelay / flow.queuedPackets;
+    }
+    flow.result.finalCwnd = flow.sender.cwnd();
+    results.push_back(flow.result);
+  }
+  return results;
+}
+
+void LinkSimulator::schedule(
+    TimePoint time,
+    EventType type,
+    size_t flow,
+    PacketNum packetNum) {
+  events_.push(Event{time, nextSeq_++, type, flow, packetNum, folly::none});
+}
+
+void LinkSimulator::scheduleAck(
+    TimePoint time,
+    size_t flow,
+    ReadAckFrame ack) {
+  events_.push(Event{
+      time, nextSeq_++, EventType::AckArrival, flow, 0, std::move(ack)});
+}
+
+void LinkSimulator::handle(const Event& event) {
+  auto& flow = flows_[event.flow];
+  auto& sender = flow.sender;
+  switch (event.type) {
+    case EventType::PacketArrival:
+      onPacketArrival(event.flow, event.packetNum);
+      break;
+    case EventType::AckArrival:
+      sender.onAck(*event.ack);
+      flow.retransmissionDeadline =
+          sender.now() + retransmissionTimeout(flow);
+      break;
+    case EventType::SendTimer:
+      if (flow.sendTimer && *flow.sendTimer == event.time) {
+        flow.sendTimer.reset();
+      }
+      break;
+    case EventType::RetransmissionTimer:
+      flow.retransmissionTimerArmed = false;
+      if (!sender.hasOutstandingPackets()) {
+        break;
+      }
+      if (sender.now() < flow.retransmissionDeadline) {
+        schedule(
+            flow.retransmissionDeadline,
+            EventType::RetransmissionTimer,
+            event.flow);
+        flow.retransmissionTimerArmed = true;
+        break;
+      }
+      sender.onRetransmissionTimeout();
+      break;
+  }
+}
+
+void LinkSimulator::onPacketArrival(size_t flowIndex, PacketNum packetNum) {
+  auto& flow = flows_[flowIndex];
+  flow.result.deliveredPackets++;
+  flow.result.deliveredBytes += flow.sender.conn().udpSendPacketLen;
+  flow.received.insert(packetNum);
+  while (flow.received.size() > kSimAckRanges) {
+    flow.received.withdraw(flow.received.front());
+  }
+  ReadAckFrame ack;
+  for (auto it = flow.received.crbegin(); it != flow.received.crend(); ++it) {
+    ack.ackBlocks.emplace_back(it->start, it->end);
+  }
+  ack.largestAcked = ack.ackBlocks.front().endPacket;
+  ack.ackDelay = 0us;
+  scheduleAck(now() + link_.rtt / 2, flowIndex, std::move(ack));
+}
+
+void LinkSimulator::trySend(size_t flowIndex) {
+  auto& flow = flows_[flowIndex];
+  auto& sender = flow.sender;
+  while (sender.writableBytes() >= sender.conn().udpSendPacketLen) {
+    auto sendTime = sender.nextPacedSendTime();
+    if (sendTime > sender.now()) {
+      if (!flow.sendTimer || *flow.sendTimer > sendTime) {
+        schedule(sendTime, EventType::SendTimer, flowIndex);
+        flow.sendTimer = sendTime;
+      }
+      return;
+    }
+    sendPacket(flowIndex);
+  }
+}
+
+void LinkSimulator::sendPacket(size_t flowIndex) {
+  auto& flow = flows_[flowIndex];
+  auto now = flow.sender.now();
+  auto bytes = flow.sender.conn().udpSendPacketLen;
+  auto packetNum = flow.nextPacketNum++;
+  flow.sender.onPacketSent(packetNum, bytes);
+  flow.result.sentPackets++;
+  if (!flow.retransmissionTimerArmed) {
+    flow.retransmissionDeadline = now + retransmissionTimeout(flow);
+    schedule(
+        flow.retransmissionDeadline,
+        EventType::RetransmissionTimer,
+        flowIndex);
+    flow.retransmissionTimerArmed = true;
+  }
+
+  auto queueingDelay = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::max(linkFreeAt_, now) - now);
+  auto queuedBytes = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::max(linkFreeAt_, now) - now)
+          .count() *
+      link_.bandwidthBytesPerSec / 1000000000);
+  if (queuedBytes + bytes > bufferBytes_) {
+    flow.result.droppedPackets++;
+    return;
+  }
+  linkFreeAt_ = std::max(linkFreeAt_, now) +
+      transmissionTime(bytes, link_.bandwidthBytesPerSec);
+  flow.queuedPackets++;
+  flow.totalQueueingDelay += queueingDelay;
+  flow.result.maxQueueingDelay =
+      std::max(flow.result.maxQueueingDelay, queueingDelay);
+  if (loss_(random_)) {
+    flow.result.droppedPackets++;
+    return;
+  }
+  schedule(
+      linkFreeAt_ + link_.rtt / 2,
+      EventType::PacketArrival,
+      flowIndex,
+      packetNum);
+}
+
+std::chrono::microseconds LinkSimulator::retransmissionTimeout(
+    const Flow& flow) const {
+  auto srtt = flow.sender.conn().lossState.srtt;
+  return std::max(
+      3 * (srtt == 0us ? kDefaultInitialRtt : srtt),
+      kSimMinRetransmissionTimeout);
+}
+
+TimePoint LinkSimulator::now() const noexcept {
+  auto latest = flows_.front().sender.now();
+  for (const auto& flow : flows_) {
+    latest = std::max(latest, flow.sender.now());
+  }
+  return latest;
+}
+
+} // namespace ccreplay
+} // namespace quic
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/tools/ccreplay/SimSender.h>
+
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace quic {
+namespace ccreplay {
+
+/**
+ * A single bottleneck with a FIFO drop tail buffer. The rest of the path
+ * only adds propagation delay, split evenly between the two directions.
+ */
+struct LinkModel {
+  uint64_t bandwidthBytesPerSec{1250000};
+  std::chrono::microseconds rtt{40ms};
+  // 0 for one BDP
+  uint64_t bufferBytes{0};
+  // Of the packets the buffer let in
+  double lossRate{0};
+  uint32_t seed{1};
+};
+
+struct SimulationResult {
+  std::chrono::microseconds duration{0};
+  uint64_t sentPackets{0};
+  uint64_t deliveredPackets{0};
+  uint64_t deliveredBytes{0};
+  // Dropped by the buffer or lost on the link
+  uint64_t droppedPackets{0};
+  // What the sender declared lost, spurious losses included
+  uint64_t lostPackets{0};
+  std::chrono::microseconds avgQueueingDelay{0};
+  std::chrono::microseconds maxQueueingDelay{0};
+  uint64_t finalCwnd{0};
+
+  // Bytes/s of goodput over the duration
+  uint64_t throughput() const noexcept;
+  double lossRate() const noexcept;
+};
+
+/**
+ * Runs senders with unlimited data over a link model, on the senders' virtual
+ * clocks, which it keeps at the same time. Competing senders share the
+ * bottleneck's buffer and bandwidth, and each has its own receiver that acks
+ * every packet right away, with the most recent ranges it got. Runs with the
+ * same model and sender configs give the same results.
+ */
+class LinkSimulator {
+ public:
+  LinkSimulator(SimSender& sender, const LinkModel& link);
+  LinkSimulator(std::vector<SimSender*> senders, const LinkModel& link);
+
+  /**
+   * The result of the only sender.
+   */
+  SimulationResult run(std::chrono::microseconds duration);
+
+  /**
+   * One result per sender, in the order they were given in.
+   */
+  std::vector<SimulationResult> runFlows(std::chrono::microseconds duration);
+
+ private:
+  enum class EventType : uint8_t {
+    // A packet made it through the link to the receiver
+    PacketArrival,
+    // An ack made it back to the sender
+    AckArrival,
+    // The pacer lets the next packet out
+    SendTimer,
+    RetransmissionTimer,
+  };
+
+  struct Event {
+    TimePoint time;
+    // Breaks ties in the order the events were scheduled
+    uint64_t seq;
+    EventType type;
+    size_t flow;
+    PacketNum packetNum;
+    folly::Optional<ReadAckFrame> ack;
+
+    bool operator>(const Event& other) const {
+      return time != other.time ? time > other.time : seq > other.seq;
+    }
+  };
+
+  // A sender and its receiver
+  struct Flow {
+    explicit Flow(SimSender& sender) : sender(sender) {}
+
+    SimSender& sender;
+    PacketNum nextPacketNum{0};
+    folly::Optional<TimePoint> sendTimer;
+    bool retransmissionTimerArmed{false};
+    TimePoint retransmissionDeadline;
+    AckBlocks received;
+    uint64_t queuedPackets{0};
+    std::chrono::microseconds totalQueueingDelay{0};
+    SimulationResult result;
+  };
+
+  void schedule(
+      TimePoint time,
+      EventType type,
+      size_t flow,
+      PacketNum packetNum = 0);
+  void scheduleAck(TimePoint time, size_t flow, ReadAckFrame ack);
+  void handle(const Event& event);
+  void onPacketArrival(size_t flow, PacketNum packetNum);
+  void trySend(size_t flow);
+  void sendPacket(size_t flow);
+  std::chrono::microseconds retransmissionTimeout(const Flow& flow) const;
+  TimePoint now() const noexcept;
+
+  std::vector<Flow> flows_;
+  LinkModel link_;
+  uint64_t bufferBytes_;
+  std::mt19937 random_;
+  std::bernoulli_distribution loss_;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+  uint64_t nextSeq_{0};
+  // When the bottleneck is done with the packets queued so far
+  TimePoint linkFreeAt_;
+};
+
+} // namespace ccreplay
+} // namespace quic
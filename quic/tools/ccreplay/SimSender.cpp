@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/tools/ccreplay/SimSender.h>
+
+#include <folly/Conv.h>
+
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/congestion_control/CongestionControllerRegistry.h>
+#include <quic/congestion_control/Pacer.h>
+#include <quic/loss/QuicLossFunctions.h>
+#include <quic/state/AckHandlers.h>
+#include <quic/state/QuicStateFunctions.h>
+
+namespace quic {
+namespace ccreplay {
+
+SimSender::SimSender(const Config& config)
+    // Far enough from the epoch that no time is mistaken for an unset one.
+    : now_(std::chrono::seconds(1)), lastSendTime_(now_) {
+  conn_.transportSettings = config.transportSettings;
+  conn_.udpSendPacketLen = config.mss;
+  conn_.canBePaced = true;
+  conn_.congestionControlClock = [this] { return now_; };
+  auto type = congestionControlStrToType(config.congestion);
+  if (!type) {
+    if (!CongestionControllerRegistry::get().isRegistered(config.congestion)) {
+      throw std::invalid_argument(folly::to<std::string>(
+          "Unknown congestion controller ", config.congestion));
+    }
+    conn_.transportSettings.congestionControllerName = config.congestion;
+    conn_.transportSettings.congestionControllerParams =
+        config.congestionParams;
+  }
+  auto ccType = type.value_or(CongestionControlType::Cubic);
+  if (conn_.transportSettings.pacingEnabled) {
+    conn_.pacer = makePacer(
+        conn_,
+        (ccType == CongestionControlType::BBR ||
+         ccType == CongestionControlType::BBR2)
+            ? kMinCwndInMssForBbr
+            : conn_.transportSettings.minCwndInMss);
+  }
+  DefaultCongestionControllerFactory factory;
+  conn_.congestionController = factory.makeCongestionController(conn_, ccType);
+  CHECK(conn_.congestionController);
+}
+
+TimePoint SimSender::now() const noexcept {
+  return now_;
+}
+
+void SimSender::advanceTo(TimePoint time) noexcept {
+  DCHECK(time >= now_);
+  now_ = std::max(now_, time);
+}
+
+void SimSender::onPacketSent(PacketNum packetNum, uint64_t bytes) {
+  RegularQuicWritePacket packet(
+      ShortHeader(ProtectionType::KeyPhaseZero, connId_, packetNum));
+  conn_.lossState.totalBytesSent += bytes;
+  OutstandingPacket outstanding(
+      std::move(packet), now_, bytes, false, conn_.lossState.totalBytesSent);
+  // What updateConnection records for the delivery rate samples.
+  const auto& lossState = conn_.lossState;
+  if (lossState.lastAckedTime && lossState.lastAckedPacketSentTime) {
+    outstanding.lastAckedPacketInfo.emplace(
+        *lossState.lastAckedPacketSentTime,
+        *lossState.lastAckedTime,
+        lossState.totalBytesSentAtLastAck,
+        lossState.totalBytesAckedAtLastAck);
+  }
+  conn_.lossState.largestSent =
+      std::max(packetNum, conn_.lossState.largestSent);
+  conn_.congestionController->onPacketSent(outstanding);
+  if (conn_.pacer) {
+    conn_.pacer->onPacketSent();
+  }
+  conn_.outstandingPackets[PacketNumberSpace::AppData].push_back(
+      std::move(outstanding));
+  lastSendTime_ = now_;
+}
+
+void SimSender::onAck(const ReadAckFrame& ackFrame) {
+  processAckFrame(
+      conn_,
+      PacketNumberSpace::AppData,
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [this](auto&, auto&, bool, PacketNum) { ++lostPackets_; },
+      now_);
+}
+
+void SimSender::onPacketsLost(const std::vector<PacketNum>& packetNums) {
+  CongestionController::LossEvent loss(now_);
+  auto& outstandingPackets =
+      conn_.outstandingPackets[PacketNumberSpace::AppData];
+  for (auto packetNum : packetNums) {
+    auto it = outstandingPackets.find(packetNum);
+    if (it == outstandingPackets.end()) {
+      continue;
+    }
+    loss.addLostPacket(*it);
+    outstandingPackets.erase(it);
+  }
+  if (loss.lostPackets == 0) {
+    return;
+  }
+  lostPackets_ += loss.lostPackets;
+  if (conn_.pacer) {
+    conn_.pacer->onPacketsLoss();
+  }
+  conn_.congestionController->onPacketAckOrLoss(folly::none, std::move(loss));
+}
+
+void SimSender::onRetransmissionTimeout() {
+  if (conn_.outstandingPackets.empty()) {
+    return;
+  }
+  CongestionController::LossEvent loss(now_);
+  for (const auto& packet :
+       conn_.outstandingPackets[PacketNumberSpace::AppData]) {
+    loss.addLostPacket(packet);
+  }
+  loss.persistentCongestion = isPersistentCongestion(
+      conn_, *loss.smallestLostSentTime, *loss.largestLostSentTime);
+  conn_.outstandingPackets.clear();
+  lostPackets_ += loss.lostPackets;
+  if (conn_.pacer) {
+    conn_.pacer->onPacketsLoss();
+  }
+  conn_.congestionController->onPacketAckOrLoss(folly::none, std::move(loss));
+}
+
+uint64_t SimSender::writableBytes() const {
+  return conn_.congestionController->getWritableBytes();
+}
+
+TimePoint SimSender::nextPacedSendTime() const noexcept {
+  if (!isConnectionPaced(conn_)) {
+    return now_;
+  }
+  return std::max(
+      now_,
+      lastSendTime_ +
+          std::chrono::duration_cast<TimePoint::duration>(
+              conn_.pacer->getPacketInterval()));
+}
+
+const QuicConnectionStateBase& SimSender::conn() const noexcept {
+  return conn_;
+}
+
+uint64_t SimSender::cwnd() const {
+  return conn_.congestionController->getCongestionWindow();
+}
+
+uint64_t SimSender::lostPackets() const noexcept {
+  return lostPackets_;
+}
+
+bool SimSender::hasOutstandingPackets() const noexcept {
+  return !conn_.outstandingPackets.empty();
+}
+
+} // namespace ccreplay
+} // namespace quic
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/state/StateData.h>
+
+namespace quic {
+namespace ccreplay {
+
+/**
+ * Sending side of a connection for the replays and simulations: the
+ * congestion controller, the pacer and the transport's ack and loss
+ * processing, on a virtual clock that only moves when advanceTo is called.
+ */
+class SimSender {
+ public:
+  struct Config {
+    // A built in congestion controller name or a registered one
+    std::string congestion{"cubic"};
+    uint64_t mss{kDefaultUDPSendPacketLen};
+    // What the controllers are tuned with, e.g. bbrConfig, and pacingEnabled
+    // for a pacer. The congestion controller name and params of registered
+    // controllers are filled in from congestion.
+    TransportSettings transportSettings;
+    std::string congestionParams;
+  };
+
+  /**
+   * Throws std::invalid_argument for an unknown congestion controller.
+   */
+  explicit SimSender(const Config& config);
+
+  TimePoint now() const noexcept;
+  void advanceTo(TimePoint time) noexcept;
+
+  void onPacketSent(PacketNum packetNum, uint64_t bytes);
+  void onAck(const ReadAckFrame& ackFrame);
+  // Losses found by the sender itself, outside of the ack processing
+  void onPacketsLost(const std::vector<PacketNum>& packetNums);
+  void onRetransmissionTimeout();
+
+  /**
+   * Whether a full packet fits in the cwnd, and when the pacer lets it out.
+   */
+  uint64_t writableBytes() const;
+  TimePoint nextPacedSendTime() const noexcept;
+
+  const QuicConnectionStateBase& conn() const noexcept;
+  uint64_t cwnd() const;
+  uint64_t lostPackets() const noexcept;
+  bool hasOutstandingPackets() const noexcept;
+
+ private:
+  QuicConnectionStateBase conn_{QuicNodeType::Server};
+  ConnectionId connId_{std::vector<uint8_t>{1, 2, 3, 4, 5, 6, 7, 8}};
+  TimePoint now_;
+  TimePoint lastSendTime_;
+  uint64_t lostPackets_{0};
+};
+
+} // namespace ccreplay
+} // namespace quic
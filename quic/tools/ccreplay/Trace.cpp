@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/tools/ccreplay/Trace.h>
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/json.h>
+#include <quic/logging/QLoggerConstants.h>
+
+#include <fstream>
+
+namespace quic {
+namespace ccreplay {
+
+TraceEvent parseTextTraceEvent(folly::StringPiece line) {
+  std::vector<folly::StringPiece> fields;
+  folly::split(' ', line, fields, true);
+  if (fields.size() < 3) {
+    throw std::invalid_argument(
+        folly::to<std::string>("Truncated trace line: ", line));
+  }
+  TraceEvent event;
+  event.time = std::chrono::microseconds(folly::to<uint64_t>(fields[0]));
+  if (fields[1] == "sent") {
+    if (fields.size() != 4) {
+      throw std::invalid_argument(
+          folly::to<std::string>("Bad sent line: ", line));
+    }
+    event.type = TraceEvent::Type::Sent;
+    event.packets.push_back(folly::to<PacketNum>(fields[2]));
+    event.bytes = folly::to<uint64_t>(fields[3]);
+  } else if (fields[1] == "ack") {
+    if (fields.size() < 4) {
+      throw std::invalid_argument(
+          folly::to<std::string>("Ack without ranges: ", line));
+    }
+    event.type = TraceEvent::Type::Ack;
+    ReadAckFrame frame;
+    frame.ackDelay = std::chrono::microseconds(folly::to<uint64_t>(fields[2]));
+    for (size_t i = 3; i < fields.size(); i++) {
+      folly::StringPiece start, end;
+      if (!folly::split('-', fields[i], start, end)) {
+        throw std::invalid_argument(
+            folly::to<std::string>("Bad ack range: ", fields[i]));
+      }
+      frame.ackBlocks.emplace_back(
+          folly::to<PacketNum>(start), folly::to<PacketNum>(end));
+    }
+    frame.largestAcked = frame.ackBlocks.front().endPacket;
+    event.ack = std::move(frame);
+  } else if (fields[1] == "lost") {
+    event.type = TraceEvent::Type::Lost;
+    for (size_t i = 2; i < fields.size(); i++) {
+      event.packets.push_back(folly::to<PacketNum>(fields[i]));
+    }
+  } else {
+    throw std::invalid_argument(
+        folly::to<std::string>("Unknown trace event: ", fields[1]));
+  }
+  return event;
+}
+
+std::vector<TraceEvent> readTextTrace(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error(folly::to<std::string>("Can't open ", path));
+  }
+  std::vector<TraceEvent> events;
+  std::string line;
+  while (std::getline(file, line)) {
+    auto trimmed = folly::trimWhitespace(line);
+    if (trimmed.empty() || trimmed.startsWith('#')) {
+      continue;
+    }
+    events.push_back(parseTextTraceEvent(trimmed));
+  }
+  return events;
+}
+
+namespace {
+
+folly::Optional<ReadAckFrame> qlogAckFrame(const folly::dynamic& frame) {
+  if (frame.getDefault("frame_type", "") != "ACK") {
+    return folly::none;
+  }
+  const auto& ranges = frame["acked_ranges"];
+  if (ranges.empty()) {
+    return folly::none;
+  }
+  ReadAckFrame ack;
+  ack.ackDelay =
+      std::chrono::microseconds(frame.getDefault("ack_delay", 0).asInt());
+  for (const auto& range : ranges) {
+    ack.ackBlocks.emplace_back(range[0].asInt(), range[1].asInt());
+  }
+  ack.largestAcked = ack.ackBlocks.front().endPacket;
+  return ack;
+}
+
+} // namespace
+
+std::vector<TraceEvent> readQLogTrace(const std::string& path) {
+  std::string json;
+  if (!folly::readFile(path.c_str(), json)) {
+    throw std::runtime_error(folly::to<std::string>("Can't open ", path));
+  }
+  auto qlog = folly::parseJson(json);
+  std::vector<TraceEvent> events;
+  // The relative_time, category, event_type, trigger and data fields of
+  // FileQLogger's events.
+  for (const auto& logged : qlog["traces"][0]["events"]) {
+    if (logged.size() < 5) {
+      continue;
+    }
+    const auto& data = logged[4];
+    if (!data.isObject() ||
+        data.getDefault("packet_type", "") != kShortHeaderPacketType) {
+      continue;
+    }
+    auto time = std::chrono::microseconds(
+        folly::to<uint64_t>(logged[0].asString()));
+    if (logged[2] == "PACKET_SENT") {
+      TraceEvent event;
+      event.type = TraceEvent::Type::Sent;
+      event.time = time;
+      event.packets.push_back(data["header"]["packet_number"].asInt());
+      event.bytes = data["header"]["packet_size"].asInt();
+      events.push_back(std::move(event));
+    } else if (logged[2] == "PACKET_RECEIVED") {
+      auto frames = data.getDefault("frames", folly::dynamic::array());
+      for (const auto& frame : frames) {
+        auto ack = qlogAckFrame(frame);
+        if (!ack) {
+          continue;
+        }
+        TraceEvent event;
+        event.type = TraceEvent::Type::Ack;
+        event.time = time;
+        event.ack = std::move(ack);
+        events.push_back(std::move(event));
+      }
+    }
+  }
+  // Events are logged as they happen, but don't count on it.
+  std::stable_sort(
+      events.begin(), events.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.time < rhs.time;
+      });
+  return events;
+}
+
+} // namespace ccreplay
+} // namespace quic
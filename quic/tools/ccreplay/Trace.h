@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <quic/codec/Types.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace quic {
+namespace ccreplay {
+
+struct TraceEvent {
+  enum class Type : uint8_t {
+    Sent,
+    Ack,
+    Lost,
+  };
+
+  Type type;
+  // Since the start of the trace
+  std::chrono::microseconds time;
+  // The sent or lost packets
+  std::vector<PacketNum> packets;
+  uint64_t bytes{0};
+  folly::Optional<ReadAckFrame> ack;
+};
+
+/**
+ * Every line of a text trace is an event, in time order:
+ *   <time us> sent <packet num> <bytes>
+ *   <time us> ack <ack delay us> <start>-<end> [<start>-<end> ...]
+ *   <time us> lost <packet num> [<packet num> ...]
+ * Ack ranges are inclusive and in descending order, the first one ends at the
+ * largest acked packet. Lines starting with # are ignored.
+ *
+ * Throws std::invalid_argument on a malformed line.
+ */
+TraceEvent parseTextTraceEvent(folly::StringPiece line);
+std::vector<TraceEvent> readTextTrace(const std::string& path);
+
+/**
+ * The 1-RTT packets a FileQLogger recorded on the sending side of a
+ * connection: every sent packet, and the ACK frames of every received one.
+ * Losses are left to the ack processing of the replay.
+ */
+std::vector<TraceEvent> readQLogTrace(const std::string& path);
+
+} // namespace ccreplay
+} // namespace quic
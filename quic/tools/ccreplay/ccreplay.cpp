@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+/**
+ * Runs a congestion controller, either a built in one or one registered with
+ * CongestionControllerRegistry, on a virtual clock, one event at a time.
+ * Controllers under test are linked into the binary and register themselves,
+ * e.g. from a static initializer.
+ *
+ * With --trace it replays the sent packets, acks and losses of a recorded
+ * connection, a text trace (see Trace.h) or the qlog of the sender, and
+ * reports the cwnd it ends up at and how long it took per event. Acks go
+ * through the transport's ack processing, so they also detect losses.
+ *
+ * Without a trace it runs a sender with unlimited data over a bottleneck
+ * link model, and reports the throughput, queueing delay and losses it got.
+ * With --competing_congestion more senders share the bottleneck with it, e.g.
+ * --congestion=copa --copa_competitive_mode --competing_congestion=cubic
+ * shows how Copa's competitive mode holds up against a buffer filling flow,
+ * and each flow's share of the delivered bytes is reported too.
+ *
+ * Runs take the same inputs to the same results, the controllers and the
+ * pacer only see the simulated time.
+ */
+
+#include <glog/logging.h>
+
+#include <folly/String.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/tools/ccreplay/LinkSimulator.h>
+#include <quic/tools/ccreplay/SimSender.h>
+#include <quic/tools/ccreplay/Trace.h>
+
+#include <iostream>
+#include <memory>
+
+DEFINE_string(trace, "", "Path of the trace to replay, none for a link model");
+DEFINE_string(
+    trace_format,
+    "",
+    "text or qlog, by default qlog for .qlog and .json files");
+DEFINE_string(
+    congestion,
+    "cubic",
+    "newreno/cubic/copa/bbr/bbr2, or the name of a registered controller");
+DEFINE_string(
+    congestion_params,
+    "",
+    "Parameter blob handed to a registered controller");
+DEFINE_uint64(mss, quic::kDefaultUDPSendPacketLen, "Packet size in bytes");
+DEFINE_bool(pacing, false, "Whether the sender paces");
+DEFINE_bool(token_bucket_pacing, false, "Pace with the TokenBucketPacer");
+DEFINE_bool(cubic_fixed_point, false, "Cubic with integer math");
+DEFINE_bool(copa_competitive_mode, false, "Copa with its competitive mode");
+DEFINE_string(
+    competing_congestion,
+    "",
+    "Comma separated controllers of the flows competing with --congestion");
+DEFINE_bool(print_cwnd, false, "Print the cwnd after every event as csv");
+DEFINE_uint32(iterations, 1, "Number of times to replay the trace");
+DEFINE_double(bandwidth_mbps, 10, "Bottleneck bandwidth of the link model");
+DEFINE_uint32(rtt_ms, 40, "Base rtt of the link model");
+DEFINE_uint64(buffer_bytes, 0, "Bottleneck buffer size, 0 for one BDP");
+DEFINE_double(loss_rate, 0, "Random loss rate of the link model");
+DEFINE_uint32(duration_s, 30, "How long to run the link model for");
+DEFINE_uint32(seed, 1, "Seed of the link model's random losses");
+
+namespace quic {
+namespace ccreplay {
+
+SimSender::Config senderConfig(const std::string& congestion) {
+  SimSender::Config config;
+  config.congestion = congestion;
+  config.congestionParams = FLAGS_congestion_params;
+  config.mss = FLAGS_mss;
+  config.transportSettings.pacingEnabled = FLAGS_pacing;
+  config.transportSettings.tokenBucketPacing = FLAGS_token_bucket_pacing;
+  config.transportSettings.cubicFixedPoint = FLAGS_cubic_fixed_point;
+  config.transportSettings.copaCompetitiveMode = FLAGS_copa_competitive_mode;
+  return config;
+}
+
+void replay(SimSender& sender, const TraceEvent& event, TimePoint start) {
+  sender.advanceTo(std::max(sender.now(), start + event.time));
+  switch (event.type) {
+    case TraceEvent::Type::Sent:
+      sender.onPacketSent(event.packets.front(), event.bytes);
+      break;
+    case TraceEvent::Type::Ack:
+      sender.onAck(*event.ack);
+      break;
+    case TraceEvent::Type::Lost:
+      sender.onPacketsLost(event.packets);
+      break;
+  }
+}
+
+int runTrace() {
+  auto format = FLAGS_trace_format;
+  if (format.empty()) {
+    auto path = folly::StringPiece(FLAGS_trace);
+    format = path.endsWith(".qlog") || path.endsWith(".json") ? "qlog" : "text";
+  }
+  if (format != "text" && format != "qlog") {
+    LOG(ERROR) << "Unknown trace format " << format;
+    return 1;
+  }
+  auto events = format == "qlog" ? readQLogTrace(FLAGS_trace)
+                                 : readTextTrace(FLAGS_trace);
+  if (FLAGS_print_cwnd) {
+    std::cout << "time_us,cwnd,writable" << std::endl;
+  }
+  auto config = senderConfig(FLAGS_congestion);
+  std::chrono::nanoseconds elapsed{0};
+  uint64_t cwnd = 0;
+  for (uint32_t i = 0; i < FLAGS_iterations; i++) {
+    SimSender sender(config);
+    auto start = sender.now();
+    for (const auto& event : events) {
+      auto before = std::chrono::steady_clock::now();
+      replay(sender, event, start);
+      elapsed += std::chrono::steady_clock::now() - before;
+      if (FLAGS_print_cwnd && i == 0) {
+        std::cout << event.time.count() << "," << sender.cwnd() << ","
+                  << sender.writableBytes() << std::endl;
+      }
+    }
+    cwnd = sender.cwnd();
+  }
+  auto replayed = events.size() * FLAGS_iterations;
+  LOG(INFO) << "controller=" << FLAGS_congestion << " events=" << replayed
+            << " final cwnd=" << cwnd << " ns/event="
+            << (replayed ? elapsed.count() / replayed : 0);
+  return 0;
+}
+
+int runLinkModel() {
+  LinkModel link;
+  link.bandwidthBytesPerSec =
+      static_cast<uint64_t>(FLAGS_bandwidth_mbps * 1000000 / 8);
+  link.rtt = std::chrono::milliseconds(FLAGS_rtt_ms);
+  link.bufferBytes = FLAGS_buffer_bytes;
+  link.lossRate = FLAGS_loss_rate;
+  link.seed = FLAGS_seed;
+  if (link.bandwidthBytesPerSec == 0) {
+    LOG(ERROR) << "--bandwidth_mbps must be positive";
+    return 1;
+  }
+  std::vector<std::string> controllers{FLAGS_congestion};
+  if (!FLAGS_competing_congestion.empty()) {
+    std::vector<std::string> competing;
+    folly::split(',', FLAGS_competing_congestion, competing);
+    controllers.insert(controllers.end(), competing.begin(), competing.end());
+  }
+  std::vector<std::unique_ptr<SimSender>> senders;
+  std::vector<SimSender*> flows;
+  for (const auto& controller : controllers) {
+    senders.push_back(std::make_unique<SimSender>(senderConfig(controller)));
+    flows.push_back(senders.back().get());
+  }
+  LinkSimulator simulator(std::move(flows), link);
+  auto before = std::chrono::steady_clock::now();
+  auto results = simulator.runFlows(std::chrono::seconds(FLAGS_duration_s));
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - before);
+  uint64_t deliveredBytes = 0;
+  for (const auto& result : results) {
+    deliveredBytes += result.deliveredBytes;
+  }
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto& result = results[i];
+    LOG(INFO) << "flow=" << i << " controller=" << controllers[i]
+              << " throughput_mbps=" << result.throughput() * 8 / 1000000.0
+              << " share="
+              << (deliveredBytes
+                      ? static_cast<double>(result.deliveredBytes) /
+                          deliveredBytes
+                      : 0)
+              << " avg_queueing_delay_us=" << result.avgQueueingDelay.count()
+              << " max_queueing_delay_us=" << result.maxQueueingDelay.count()
+              << " sent=" << result.sentPackets
+              << " dropped=" << result.droppedPackets
+              << " loss_rate=" << result.lossRate()
+              << " declared_lost=" << result.lostPackets
+              << " final cwnd=" << result.finalCwnd;
+  }
+  LOG(INFO) << "wall_ms=" << elapsed.count();
+  return 0;
+}
+
+int run() {
+  try {
+    return FLAGS_trace.empty() ? runLinkModel() : runTrace();
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << ex.what();
+    return 1;
+  }
+}
+
+} // namespace ccreplay
+} // namespace quic
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+  return quic::ccreplay::run();
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/tools/loopbench/LoopbackSocket.h>
+
+#include <folly/io/Cursor.h>
+
+namespace quic {
+namespace loopbench {
+
+namespace {
+constexpr std::chrono::microseconds kLoopbackTimerTick = 50us;
+
+std::chrono::nanoseconds transmissionTime(
+    uint64_t bytes,
+    uint64_t bandwidthBytesPerSec) {
+  return std::chrono::nanoseconds(bytes * 1000000000 / bandwidthBytesPerSec);
+}
+} // namespace
+
+LoopbackLink::LoopbackLink(
+    folly::EventBase* evb,
+    const LoopbackLinkModel& model)
+    : evb_(evb),
+      model_(model),
+      timer_(TimerHighRes::newTimer(evb, kLoopbackTimerTick)),
+      linkFreeAt_(Clock::now()),
+      random_(model.seed),
+      loss_(model.lossRate) {
+  CHECK(evb_);
+}
+
+LoopbackLink::~LoopbackLink() {
+  cancelLoopCallback();
+  cancelTimeout();
+}
+
+void LoopbackLink::setReceiver(LoopbackUDPSocket* receiver) noexcept {
+  receiver_ = receiver;
+}
+
+void LoopbackLink::send(
+    const folly::SocketAddress& from,
+    const folly::IOBuf& data) {
+  auto len = data.computeChainDataLength();
+  stats_.sentPackets++;
+  stats_.sentBytes += len;
+  auto now = Clock::now();
+  auto departure = now;
+  if (model_.bandwidthBytesPerSec > 0) {
+    if (model_.bufferBytes > 0 && linkFreeAt_ > now) {
+      auto backlog = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         linkFreeAt_ - now)
+                         .count() *
+          model_.bandwidthBytesPerSec / 1000000000;
+      if (backlog + len > model_.bufferBytes) {
+        stats_.droppedPackets++;
+        return;
+      }
+    }
+    linkFreeAt_ = std::max(linkFreeAt_, now) +
+        transmissionTime(len, model_.bandwidthBytesPerSec);
+    departure = linkFreeAt_;
+  }
+  if (loss_(random_)) {
+    stats_.droppedPackets++;
+    return;
+  }
+  // Both the serialization and the delay only grow, so the queue stays in
+  // the order the datagrams are due in.
+  queue_.push_back(Datagram{departure + model_.delay, from, data.clone()});
+  schedule();
+}
+
+const LoopbackLinkStats& LoopbackLink::getStats() const noexcept {
+  return stats_;
+}
+
+void LoopbackLink::schedule() {
+  if (queue_.empty() || isLoopCallbackScheduled()) {
+    return;
+  }
+  auto now = Clock::now();
+  auto deliverAt = queue_.front().deliverAt;
+  if (deliverAt <= now) {
+    cancelTimeout();
+    evb_->runInLoop(this);
+  } else if (!isScheduled()) {
+    timer_->scheduleTimeout(
+        this,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            deliverAt - now));
+  }
+}
+
+void LoopbackLink::deliver() {
+  auto now = Clock::now();
+  while (!queue_.empty() && queue_.front().deliverAt <= now) {
+    auto datagram = std::move(queue_.front());
+    queue_.pop_front();
+    if (receiver_) {
+      stats_.deliveredPackets++;
+      receiver_->onDatagram(datagram.from, *datagram.data);
+    } else {
+      stats_.droppedPackets++;
+    }
+  }
+  schedule();
+}
+
+void LoopbackLink::runLoopCallback() noexcept {
+  deliver();
+}
+
+void LoopbackLink::timeoutExpired() noexcept {
+  deliver();
+}
+
+LoopbackUDPSocket::LoopbackUDPSocket(
+    folly::EventBase* evb,
+    LoopbackLink& link,
+    const folly::SocketAddress& address)
+    : folly::AsyncUDPSocket(evb), link_(link), address_(address) {}
+
+void LoopbackUDPSocket::bind(const folly::SocketAddress& /*address*/) {}
+
+const folly::SocketAddress& LoopbackUDPSocket::address() const {
+  return address_;
+}
+
+bool LoopbackUDPSocket::isBound() const {
+  return true;
+}
+
+ssize_t LoopbackUDPSocket::write(
+    const folly::SocketAddress& /*address*/,
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  link_.send(address_, *buf);
+  return buf->computeChainDataLength();
+}
+
+ssize_t LoopbackUDPSocket::writeGSO(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf,
+    int gso) {
+  if (gso <= 0) {
+    return write(address, buf);
+  }
+  // Split into the datagrams the kernel would have sent.
+  auto data = buf->cloneCoalesced();
+  size_t offset = 0;
+  while (offset < data->length()) {
+    auto len = std::min<size_t>(gso, data->length() - offset);
+    link_.send(
+        address_,
+        folly::IOBuf(
+            folly::IOBuf::WRAP_BUFFER, data->data() + offset, len));
+    offset += len;
+  }
+  return data->length();
+}
+
+int LoopbackUDPSocket::getGSO() {
+  // supported, but not set on the socket
+  return 0;
+}
+
+void LoopbackUDPSocket::resumeRead(ReadCallback* callback) {
+  CHECK(callback);
+  CHECK(!callback->shouldOnlyNotify())
+      << "Batched reads are not supported on loopback sockets";
+  readCallback_ = callback;
+}
+
+void LoopbackUDPSocket::pauseRead() {
+  readCallback_ = nullptr;
+}
+
+void LoopbackUDPSocket::close() {
+  readCallback_ = nullptr;
+}
+
+void LoopbackUDPSocket::setReuseAddr(bool /*reuseAddr*/) {}
+
+void LoopbackUDPSocket::setDFAndTurnOffPMTU() {}
+
+void LoopbackUDPSocket::dontFragment(bool /*df*/) {}
+
+void LoopbackUDPSocket::setErrMessageCallback(
+    ErrMessageCallback* /*callback*/) {}
+
+void LoopbackUDPSocket::onDatagram(
+    const folly::SocketAddress& from,
+    const folly::IOBuf& data) {
+  if (!readCallback_) {
+    return;
+  }
+  void* buf = nullptr;
+  size_t len = 0;
+  readCallback_->getReadBuffer(&buf, &len);
+  auto dataLen = data.computeChainDataLength();
+  auto copied = std::min(dataLen, len);
+  folly::io::Cursor cursor(&data);
+  cursor.pull(buf, copied);
+  readCallback_->onDataAvailable(from, copied, copied < dataLen);
+}
+
+} // namespace loopbench
+} // namespace quic
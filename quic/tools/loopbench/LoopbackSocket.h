@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+
+#include <quic/QuicConstants.h>
+#include <quic/common/Timers.h>
+
+#include <deque>
+#include <random>
+
+namespace quic {
+namespace loopbench {
+
+/**
+ * One direction of the path, a single bottleneck with a FIFO drop tail buffer
+ * followed by a fixed delay.
+ */
+struct LoopbackLinkModel {
+  // 0 for no bottleneck
+  uint64_t bandwidthBytesPerSec{0};
+  std::chrono::microseconds delay{0us};
+  // 0 for no limit
+  uint64_t bufferBytes{0};
+  // Of the packets the buffer let in
+  double lossRate{0};
+  uint32_t seed{1};
+};
+
+struct LoopbackLinkStats {
+  uint64_t sentPackets{0};
+  uint64_t sentBytes{0};
+  uint64_t deliveredPackets{0};
+  // Dropped by the buffer or lost on the link
+  uint64_t droppedPackets{0};
+};
+
+class LoopbackUDPSocket;
+
+/**
+ * Carries the datagrams sent on one direction of the path to the socket at
+ * its end, on the timers of the event base that both ends run on. Datagrams
+ * that are due are delivered from a loop callback, never from within the
+ * write that sent them.
+ */
+class LoopbackLink : private folly::EventBase::LoopCallback,
+                     private folly::HHWheelTimerHighRes::Callback {
+ public:
+  LoopbackLink(folly::EventBase* evb, const LoopbackLinkModel& model);
+  ~LoopbackLink() override;
+
+  void setReceiver(LoopbackUDPSocket* receiver) noexcept;
+
+  void send(const folly::SocketAddress& from, const folly::IOBuf& data);
+
+  const LoopbackLinkStats& getStats() const noexcept;
+
+ private:
+  struct Datagram {
+    TimePoint deliverAt;
+    folly::SocketAddress from;
+    std::unique_ptr<folly::IOBuf> data;
+  };
+
+  void schedule();
+  void deliver();
+
+  void runLoopCallback() noexcept override;
+  void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override {}
+
+  folly::EventBase* evb_;
+  LoopbackLinkModel model_;
+  TimerHighRes::SharedPtr timer_;
+  LoopbackUDPSocket* receiver_{nullptr};
+  std::deque<Datagram> queue_;
+  uint64_t queuedBytes_{0};
+  // When the bottleneck is done with the datagrams queued so far
+  TimePoint linkFreeAt_;
+  std::mt19937 random_;
+  std::bernoulli_distribution loss_;
+  LoopbackLinkStats stats_;
+};
+
+/**
+ * A UDP socket without a file descriptor, that sends on a LoopbackLink and
+ * reads what the link of the other direction delivers to it. Only what the
+ * transports and the server worker use is supported, reads are handed to the
+ * read callback one datagram at a time, shouldOnlyNotify is not supported.
+ */
+class LoopbackUDPSocket : public folly::AsyncUDPSocket {
+ public:
+  LoopbackUDPSocket(
+      folly::EventBase* evb,
+      LoopbackLink& link,
+      const folly::SocketAddress& address);
+  ~LoopbackUDPSocket() override = default;
+
+  // The socket keeps the address it was made with, whatever it binds to.
+  void bind(const folly::SocketAddress& address) override;
+  const folly::SocketAddress& address() const override;
+  bool isBound() const override;
+
+  ssize_t write(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf) override;
+  ssize_t writeGSO(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int gso) override;
+  int getGSO() override;
+
+  void resumeRead(ReadCallback* callback) override;
+  void pauseRead() override;
+  void close() override;
+
+  void setReuseAddr(bool reuseAddr) override;
+  void setDFAndTurnOffPMTU() override;
+  void dontFragment(bool df) override;
+  void setErrMessageCallback(ErrMessageCallback* callback) override;
+
+  void onDatagram(const folly::SocketAddress& from, const folly::IOBuf& data);
+
+ private:
+  LoopbackLink& link_;
+  folly::SocketAddress address_;
+  ReadCallback* readCallback_{nullptr};
+};
+
+} // namespace loopbench
+} // namespace quic
@@ -0,0 +1,573 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+// Runs a client and a server worker in one process, on one thread, over
+// loopback sockets instead of the kernel's, and reports the CPU the
+// transports spent per byte and per packet of a workload. The network
+// stack is out of the picture, so runs are far less noisy than tperf's.
+
+#include <glog/logging.h>
+
+#include <fizz/crypto/Utils.h>
+#include <folly/chrono/Hardware.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/client/QuicClientTransport.h>
+#include <quic/client/handshake/FizzClientQuicHandshakeContext.h>
+#include <quic/codec/DefaultConnectionIdAlgo.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/server/QuicServerTransport.h>
+#include <quic/server/QuicServerWorker.h>
+#include <quic/tools/loopbench/LoopbackSocket.h>
+
+#include <time.h>
+
+DEFINE_string(workload, "bulk", "bulk, rpc or streams");
+DEFINE_uint64(bytes, 100 * 1024 * 1024, "Bytes the bulk workload uploads");
+DEFINE_uint64(requests, 10000, "Requests the rpc workload makes in turn");
+DEFINE_uint64(request_size, 100, "Request size of the rpc workload");
+DEFINE_uint64(response_size, 1000, "Response size of the rpc workload");
+DEFINE_uint64(streams, 1000, "Streams the streams workload opens at once");
+DEFINE_uint64(stream_bytes, 10000, "Bytes uploaded on each of the streams");
+DEFINE_uint64(window, 16 * 1024 * 1024, "Stream flow control window");
+DEFINE_uint64(bandwidth, 0, "Bytes/s of each direction of the path, 0 for any");
+DEFINE_uint64(delay_us, 0, "One way delay of the path");
+DEFINE_uint64(buffer_bytes, 0, "Bottleneck buffer, 0 for no limit");
+DEFINE_double(loss, 0, "Random loss rate of each direction of the path");
+DEFINE_uint32(seed, 1, "Seed of the random losses");
+DEFINE_string(congestion, "cubic", "newreno/cubic/bbr/copa/none");
+DEFINE_bool(pacing, false, "Enable pacing");
+DEFINE_bool(gso, false, "Write with GSO batches");
+DEFINE_uint32(max_batch_size, 16, "Packets of a GSO batch");
+DEFINE_bool(
+    jumbo_frames,
+    false,
+    "Use the jumbo frame profile, 9K packets instead of 1.5K ones");
+
+namespace quic {
+namespace loopbench {
+
+namespace {
+const folly::SocketAddress kClientAddress("10.0.0.1", 10000);
+const folly::SocketAddress kServerAddress("10.0.0.2", 4433);
+constexpr size_t kPayloadBlockSize = 64 * 1024;
+
+enum class Workload : uint8_t {
+  // one stream with FLAGS_bytes
+  Bulk,
+  // FLAGS_requests requests and responses in turn, one stream each
+  Rpc,
+  // FLAGS_streams streams at once, with FLAGS_stream_bytes each
+  Streams,
+};
+
+Workload flagsToWorkload(const std::string& workload) {
+  if (workload == "bulk") {
+    return Workload::Bulk;
+  } else if (workload == "rpc") {
+    return Workload::Rpc;
+  } else if (workload == "streams") {
+    return Workload::Streams;
+  }
+  throw std::invalid_argument(
+      folly::to<std::string>("Unknown workload ", workload));
+}
+
+CongestionControlType flagsToCongestionControlType(
+    const std::string& congestionControlType) {
+  if (congestionControlType == "cubic") {
+    return CongestionControlType::Cubic;
+  } else if (congestionControlType == "newreno") {
+    return CongestionControlType::NewReno;
+  } else if (congestionControlType == "bbr") {
+    return CongestionControlType::BBR;
+  } else if (congestionControlType == "copa") {
+    return CongestionControlType::Copa;
+  } else if (congestionControlType == "none") {
+    return CongestionControlType::None;
+  }
+  throw std::invalid_argument(folly::to<std::string>(
+      "Unknown congestion controller ", congestionControlType));
+}
+
+TransportSettings makeTransportSettings() {
+  TransportSettings settings;
+  settings.advertisedInitialConnectionWindowSize =
+      std::numeric_limits<uint32_t>::max();
+  settings.advertisedInitialBidiLocalStreamWindowSize = FLAGS_window;
+  settings.advertisedInitialBidiRemoteStreamWindowSize = FLAGS_window;
+  settings.advertisedInitialUniStreamWindowSize = FLAGS_window;
+  settings.advertisedInitialMaxStreamsBidi =
+      std::max<uint64_t>(kDefaultMaxStreamsBidirectional, FLAGS_streams);
+  settings.defaultCongestionController =
+      flagsToCongestionControlType(FLAGS_congestion);
+  settings.pacingEnabled = FLAGS_pacing;
+  if (FLAGS_gso) {
+    settings.batchingMode = QuicBatchingMode::BATCHING_MODE_GSO;
+    settings.maxBatchSize = FLAGS_max_batch_size;
+  }
+  if (FLAGS_jumbo_frames) {
+    // The packet size is discovered, as it would be in the datacenter,
+    // instead of taken from the peer up to kDefaultMaxUDPPayload.
+    applyJumboFrameProfile(settings);
+  } else {
+    settings.canIgnorePathMTU = true;
+  }
+  return settings;
+}
+
+// What the thread spent so far
+struct CpuSample {
+  std::chrono::nanoseconds cpu;
+  uint64_t cycles;
+  TimePoint time;
+
+  static CpuSample now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return CpuSample{
+        std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec),
+        folly::hardware_timestamp(),
+        Clock::now()};
+  }
+};
+
+} // namespace
+
+/**
+ * Writes the bytes queued for the streams of a socket as flow control lets
+ * them out, from chains of one shared payload block.
+ */
+class StreamSender : public QuicSocket::WriteCallback {
+ public:
+  StreamSender() : block_(folly::IOBuf::create(kPayloadBlockSize)) {
+    memset(block_->writableData(), 'a', kPayloadBlockSize);
+    block_->append(kPayloadBlockSize);
+  }
+
+  void sendOnStream(StreamId id, uint64_t bytes) {
+    if (bytes == 0) {
+      sock_->writeChain(id, folly::IOBuf::create(0), true, false);
+      return;
+    }
+    pending_[id] += bytes;
+    notifyDataForStream(id);
+  }
+
+  void onStreamWriteReady(StreamId id, uint64_t maxToSend) noexcept override {
+    auto it = pending_.find(id);
+    if (it == pending_.end()) {
+      return;
+    }
+    auto toSend = std::min(maxToSend, it->second);
+    it->second -= toSend;
+    bool eof = it->second == 0;
+    auto res = sock_->writeChain(id, makePayload(toSend), eof, false);
+    if (res.hasError()) {
+      LOG(FATAL) << "Got error on write: " << toString(res.error());
+    }
+    if (eof) {
+      pending_.erase(it);
+    } else {
+      notifyDataForStream(id);
+    }
+  }
+
+  void onStreamWriteError(
+      StreamId id,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    LOG(ERROR) << "Write error on stream=" << id
+               << " error=" << toString(error);
+    pending_.erase(id);
+  }
+
+ protected:
+  std::shared_ptr<QuicSocket> sock_;
+
+ private:
+  void notifyDataForStream(StreamId id) {
+    sock_->getEventBase()->runInLoop([this, id] {
+      if (!sock_) {
+        return;
+      }
+      auto res = sock_->notifyPendingWriteOnStream(id, this);
+      if (res.hasError()) {
+        LOG(FATAL) << toString(res.error());
+      }
+    });
+  }
+
+  Buf makePayload(uint64_t len) const {
+    auto payload = folly::IOBuf::create(0);
+    while (len > 0) {
+      auto piece = block_->clone();
+      auto pieceLen = std::min<uint64_t>(len, kPayloadBlockSize);
+      piece->trimEnd(kPayloadBlockSize - pieceLen);
+      len -= pieceLen;
+      payload->prependChain(std::move(piece));
+    }
+    return payload;
+  }
+
+  Buf block_;
+  std::unordered_map<StreamId, uint64_t> pending_;
+};
+
+/**
+ * Reads a request to its end, then answers it on the same stream.
+ */
+class ServerHandler : public StreamSender,
+                      public QuicSocket::ConnectionCallback,
+                      public QuicSocket::ReadCallback {
+ public:
+  explicit ServerHandler(uint64_t responseSize) : responseSize_(responseSize) {}
+
+  void setQuicSocket(std::shared_ptr<QuicSocket> socket) {
+    sock_ = std::move(socket);
+  }
+
+  void onNewBidirectionalStream(StreamId id) noexcept override {
+    sock_->setReadCallback(id, this);
+  }
+
+  void onNewUnidirectionalStream(StreamId id) noexcept override {
+    sock_->setReadCallback(id, this);
+  }
+
+  void onStopSending(StreamId, ApplicationErrorCode) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    sock_.reset();
+  }
+
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string> error) noexcept override {
+    LOG(ERROR) << "Server connection error=" << toString(error.first);
+    sock_.reset();
+  }
+
+  void readAvailable(StreamId id) noexcept override {
+    auto res = sock_->read(id, 0);
+    if (res.hasError()) {
+      LOG(ERROR) << "Server read error=" << toString(res.error());
+      return;
+    }
+    if (res->second) {
+      sendOnStream(id, responseSize_);
+    }
+  }
+
+  void readError(
+      StreamId id,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    LOG(ERROR) << "Server read error on stream=" << id
+               << " error=" << toString(error);
+  }
+
+ private:
+  uint64_t responseSize_;
+};
+
+class ServerTransportFactory : public QuicServerTransportFactory {
+ public:
+  explicit ServerTransportFactory(uint64_t responseSize)
+      : responseSize_(responseSize) {}
+  ~ServerTransportFactory() override = default;
+
+  QuicServerTransport::Ptr make(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> sock,
+      const folly::SocketAddress&,
+      std::shared_ptr<const fizz::server::FizzServerContext>
+          ctx) noexcept override {
+    auto handler = std::make_unique<ServerHandler>(responseSize_);
+    auto transport =
+        QuicServerTransport::make(evb, std::move(sock), *handler, ctx);
+    handler->setQuicSocket(transport);
+    handlers_.push_back(std::move(handler));
+    return transport;
+  }
+
+ private:
+  uint64_t responseSize_;
+  std::vector<std::unique_ptr<ServerHandler>> handlers_;
+};
+
+// The sockets of the connections of the worker all send on its link.
+class SocketFactory : public QuicUDPSocketFactory {
+ public:
+  explicit SocketFactory(LoopbackLink& link) : link_(link) {}
+
+  std::unique_ptr<folly::AsyncUDPSocket> make(
+      folly::EventBase* evb,
+      int /*fd*/) override {
+    return std::make_unique<LoopbackUDPSocket>(evb, link_, kServerAddress);
+  }
+
+ private:
+  LoopbackLink& link_;
+};
+
+// There is only the one worker, whatever the routing data says.
+class WorkerCallback : public QuicServerWorker::WorkerCallback {
+ public:
+  void setWorker(QuicServerWorker* worker) {
+    worker_ = worker;
+  }
+
+  void handleWorkerError(LocalErrorCode error) override {
+    LOG(ERROR) << "Worker error=" << toString(error);
+  }
+
+  void routeDataToWorker(
+      const folly::SocketAddress& client,
+      RoutingData&& routingData,
+      NetworkData&& networkData,
+      bool isForwardedData) override {
+    worker_->dispatchPacketData(
+        client,
+        std::move(routingData),
+        std::move(networkData),
+        isForwardedData);
+  }
+
+ private:
+  QuicServerWorker* worker_{nullptr};
+};
+
+/**
+ * Runs the workload once the handshake is done and reports what it took.
+ */
+class Client : public StreamSender,
+               public QuicSocket::ConnectionCallback,
+               public QuicSocket::ReadCallback {
+ public:
+  Client(
+      std::shared_ptr<QuicClientTransport> transport,
+      Workload workload,
+      const LoopbackLink& uplink,
+      const LoopbackLink& downlink,
+      std::function<void()> onDone)
+      : transport_(transport),
+        workload_(workload),
+        uplink_(uplink),
+        downlink_(downlink),
+        onDone_(std::move(onDone)) {
+    sock_ = std::move(transport);
+  }
+
+  void onTransportReady() noexcept override {
+    start_ = CpuSample::now();
+    uplinkStart_ = uplink_.getStats();
+    downlinkStart_ = downlink_.getStats();
+    switch (workload_) {
+      case Workload::Bulk:
+        sendRequest(FLAGS_bytes);
+        break;
+      case Workload::Rpc:
+        sendRequest(FLAGS_request_size);
+        break;
+      case Workload::Streams:
+        for (uint64_t i = 0; i < FLAGS_streams; i++) {
+          sendRequest(FLAGS_stream_bytes);
+        }
+        break;
+    }
+  }
+
+  void onNewBidirectionalStream(StreamId) noexcept override {}
+  void onNewUnidirectionalStream(StreamId) noexcept override {}
+  void onStopSending(StreamId, ApplicationErrorCode) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    finish();
+  }
+
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string> error) noexcept override {
+    LOG(ERROR) << "Client connection error=" << toString(error.first);
+    finish();
+  }
+
+  void readAvailable(StreamId id) noexcept override {
+    auto res = sock_->read(id, 0);
+    if (res.hasError()) {
+      LOG(ERROR) << "Client read error=" << toString(res.error());
+      return;
+    }
+    if (res->first) {
+      responseBytes_ += res->first->computeChainDataLength();
+    }
+    if (!res->second) {
+      return;
+    }
+    outstanding_--;
+    completed_++;
+    if (workload_ == Workload::Rpc && completed_ < FLAGS_requests) {
+      sendRequest(FLAGS_request_size);
+    } else if (outstanding_ == 0) {
+      report();
+      finish();
+    }
+  }
+
+  void readError(
+      StreamId id,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    LOG(ERROR) << "Client read error on stream=" << id
+               << " error=" << toString(error);
+  }
+
+ private:
+  void sendRequest(uint64_t size) {
+    auto id = sock_->createBidirectionalStream();
+    CHECK(id.hasValue()) << "Out of streams";
+    sock_->setReadCallback(*id, this);
+    outstanding_++;
+    requestBytes_ += size;
+    sendOnStream(*id, size);
+  }
+
+  void report() {
+    auto end = CpuSample::now();
+    auto cpuNs = (end.cpu - start_.cpu).count();
+    auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end.time - start_.time);
+    // The cycles the cpu time is worth at the rate of the cycle counter
+    double cycles = wall.count() > 0
+        ? static_cast<double>(end.cycles - start_.cycles) * cpuNs / wall.count()
+        : 0;
+    auto bytes = requestBytes_ + responseBytes_;
+    auto& uplink = uplink_.getStats();
+    auto& downlink = downlink_.getStats();
+    auto packets = uplink.sentPackets - uplinkStart_.sentPackets +
+        downlink.sentPackets - downlinkStart_.sentPackets;
+    auto dropped = uplink.droppedPackets - uplinkStart_.droppedPackets +
+        downlink.droppedPackets - downlinkStart_.droppedPackets;
+    LOG(INFO) << "Completed " << completed_ << " streams, " << bytes
+              << " bytes in " << packets << " packets, " << dropped
+              << " dropped";
+    LOG(INFO) << "Wall time " << wall.count() / 1000 << "us, cpu time "
+              << cpuNs / 1000 << "us";
+    if (bytes > 0 && packets > 0) {
+      LOG(INFO) << "CPU per byte " << static_cast<double>(cpuNs) / bytes
+                << "ns, " << cycles / bytes << " cycles";
+      LOG(INFO) << "CPU per packet " << static_cast<double>(cpuNs) / packets
+                << "ns, " << cycles / packets << " cycles";
+    }
+  }
+
+  void finish() {
+    if (!onDone_) {
+      return;
+    }
+    auto onDone = std::move(onDone_);
+    onDone_ = nullptr;
+    sock_.reset();
+    transport_->closeNow(folly::none);
+    onDone();
+  }
+
+  std::shared_ptr<QuicClientTransport> transport_;
+  Workload workload_;
+  const LoopbackLink& uplink_;
+  const LoopbackLink& downlink_;
+  std::function<void()> onDone_;
+  CpuSample start_;
+  LoopbackLinkStats uplinkStart_;
+  LoopbackLinkStats downlinkStart_;
+  uint64_t requestBytes_{0};
+  uint64_t responseBytes_{0};
+  uint64_t outstanding_{0};
+  uint64_t completed_{0};
+};
+
+int run() {
+  auto workload = flagsToWorkload(FLAGS_workload);
+  LoopbackLinkModel model;
+  model.bandwidthBytesPerSec = FLAGS_bandwidth;
+  model.delay = std::chrono::microseconds(FLAGS_delay_us);
+  model.bufferBytes = FLAGS_buffer_bytes;
+  model.lossRate = FLAGS_loss;
+  model.seed = FLAGS_seed;
+
+  folly::EventBase evb;
+  LoopbackLink uplink(&evb, model);
+  model.seed++;
+  LoopbackLink downlink(&evb, model);
+
+  auto workerSock =
+      std::make_unique<LoopbackUDPSocket>(&evb, downlink, kServerAddress);
+  uplink.setReceiver(workerSock.get());
+  auto workerCallback = std::make_shared<WorkerCallback>();
+  ServerTransportFactory transportFactory(
+      workload == Workload::Rpc ? FLAGS_response_size : 0);
+  SocketFactory socketFactory(downlink);
+  auto worker = std::make_unique<QuicServerWorker>(workerCallback);
+  workerCallback->setWorker(worker.get());
+  worker->setSocket(std::move(workerSock));
+  worker->setSupportedVersions(
+      {QuicVersion::MVFST, QuicVersion::MVFST_OLD, QuicVersion::QUIC_DRAFT});
+  auto serverCtx = test::createServerCtx();
+  serverCtx->setClock(std::make_shared<fizz::SystemClock>());
+  worker->setFizzContext(serverCtx);
+  worker->setTransportFactory(&transportFactory);
+  worker->setNewConnectionSocketFactory(&socketFactory);
+  worker->setConnectionIdAlgo(std::make_unique<DefaultConnectionIdAlgo>());
+  worker->setCongestionControllerFactory(
+      std::make_shared<DefaultCongestionControllerFactory>());
+  worker->setTransportSettings(makeTransportSettings());
+  worker->bind(kServerAddress);
+  worker->start();
+
+  auto clientSock =
+      std::make_unique<LoopbackUDPSocket>(&evb, uplink, kClientAddress);
+  downlink.setReceiver(clientSock.get());
+  auto transport = std::make_shared<QuicClientTransport>(
+      &evb,
+      std::move(clientSock),
+      FizzClientQuicHandshakeContext::Builder()
+          .setCertificateVerifier(test::createTestCertificateVerifier())
+          .build());
+  transport->setHostname("loopbench");
+  transport->addNewPeerAddress(kServerAddress);
+  transport->setCongestionControllerFactory(
+      std::make_shared<DefaultCongestionControllerFactory>());
+  transport->setTransportSettings(makeTransportSettings());
+
+  Client client(transport, workload, uplink, downlink, [&] {
+    // Nothing is delivered to the sockets once they start going away.
+    uplink.setReceiver(nullptr);
+    downlink.setReceiver(nullptr);
+    worker->shutdownAllConnections(LocalErrorCode::SHUTTING_DOWN);
+    evb.terminateLoopSoon();
+  });
+  transport->start(&client);
+  evb.loopForever();
+  return 0;
+}
+
+} // namespace loopbench
+} // namespace quic
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+  fizz::CryptoUtils::init();
+  return quic::loopbench::run();
+}
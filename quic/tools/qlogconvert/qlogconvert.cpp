@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+/**
+ * Converts a binary qlog, written by BinaryQLoggers, to standard qlog JSON,
+ * one <dcid>.qlog file per connection in --output_dir like the FileQLogger
+ * writes them.
+ */
+
+#include <glog/logging.h>
+
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/logging/BinaryQLogger.h>
+
+DEFINE_string(input, "", "Path of the binary qlog");
+DEFINE_string(output_dir, ".", "Directory to write the qlog files to");
+DEFINE_bool(pretty_json, false, "Whether to pretty print the JSON");
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+
+  std::string data;
+  if (FLAGS_input.empty() || !folly::readFile(FLAGS_input.c_str(), data)) {
+    LOG(ERROR) << "Can't read binary qlog from --input=" << FLAGS_input;
+    return 1;
+  }
+  auto connections =
+      quic::readBinaryQLog(folly::ByteRange(folly::StringPiece(data)));
+  size_t written = 0;
+  for (auto& connection : connections) {
+    if (!connection->dcid) {
+      LOG(WARNING) << "Skipping a connection without dcid, "
+                   << connection->logs.size() << " events";
+      continue;
+    }
+    connection->outputLogsToFile(FLAGS_output_dir, FLAGS_pretty_json);
+    written++;
+  }
+  LOG(INFO) << "Wrote " << written << " of " << connections.size()
+            << " connections to " << FLAGS_output_dir;
+  return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/tools/tperf/TperfServerStats.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace quic {
+namespace tperf {
+
+namespace {
+std::atomic<bool> allocationCountingEnabled{false};
+std::atomic<uint64_t> allocationCount{0};
+
+inline void* countedAllocation(size_t size) noexcept {
+  if (allocationCountingEnabled.load(std::memory_order_relaxed)) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  return std::malloc(size ? size : 1);
+}
+} // namespace
+
+TperfServerCounters& TperfServerCounters::operator+=(
+    const TperfServerCounters& other) {
+  packetsReceived += other.packetsReceived;
+  bytesRead += other.bytesRead;
+  packetsSent += other.packetsSent;
+  bytesWritten += other.bytesWritten;
+  retransmissions += other.retransmissions;
+  writeSyscalls += other.writeSyscalls;
+  syscallMessages += other.syscallMessages;
+  syscallPackets += other.syscallPackets;
+  return *this;
+}
+
+TperfServerCounters TperfServerCounters::operator-(
+    const TperfServerCounters& other) const {
+  TperfServerCounters delta;
+  delta.packetsReceived = packetsReceived - other.packetsReceived;
+  delta.bytesRead = bytesRead - other.bytesRead;
+  delta.packetsSent = packetsSent - other.packetsSent;
+  delta.bytesWritten = bytesWritten - other.bytesWritten;
+  delta.retransmissions = retransmissions - other.retransmissions;
+  delta.writeSyscalls = writeSyscalls - other.writeSyscalls;
+  delta.syscallMessages = syscallMessages - other.syscallMessages;
+  delta.syscallPackets = syscallPackets - other.syscallPackets;
+  return delta;
+}
+
+TperfServerCounters TperfServerStats::getCounters() const noexcept {
+  TperfServerCounters counters;
+  counters.packetsReceived = packetsReceived_.get();
+  counters.bytesRead = bytesRead_.get();
+  counters.packetsSent = packetsSent_.get();
+  counters.bytesWritten = bytesWritten_.get();
+  counters.retransmissions = retransmissions_.get();
+  counters.writeSyscalls = writeSyscalls_.get();
+  counters.syscallMessages = syscallMessages_.get();
+  counters.syscallPackets = syscallPackets_.get();
+  return counters;
+}
+
+void TperfServerStats::onPacketReceived() {
+  packetsReceived_.add(1);
+}
+
+void TperfServerStats::onPacketSent() {
+  packetsSent_.add(1);
+}
+
+void TperfServerStats::onPacketRetransmission() {
+  retransmissions_.add(1);
+}
+
+void TperfServerStats::onRead(size_t bufSize) {
+  bytesRead_.add(bufSize);
+}
+
+void TperfServerStats::onWrite(size_t bufSize) {
+  bytesWritten_.add(bufSize);
+}
+
+void TperfServerStats::onWriteSyscall(
+    size_t numMessages,
+    size_t numPackets,
+    size_t /*bytes*/) {
+  writeSyscalls_.add(1);
+  syscallMessages_.add(numMessages);
+  syscallPackets_.add(numPackets);
+}
+
+void TperfServerStats::onStatsCounters(
+    const QuicTransportStatsCounters::Snapshot& delta) {
+  using Counter = QuicTransportStatsCounters::Counter;
+  packetsReceived_.add(delta[Counter::PacketsReceived]);
+  bytesRead_.add(delta[Counter::BytesRead]);
+  packetsSent_.add(delta[Counter::PacketsSent]);
+  bytesWritten_.add(delta[Counter::BytesWritten]);
+  retransmissions_.add(delta[Counter::PacketRetransmissions]);
+}
+
+std::unique_ptr<QuicTransportStatsCallback> TperfServerStatsFactory::make(
+    folly::EventBase* evb) {
+  auto stats = std::make_unique<TperfServerStats>();
+  std::lock_guard<std::mutex> guard(mutex_);
+  stats_.emplace_back(evb, stats.get());
+  return stats;
+}
+
+TperfServerCounters TperfServerStatsFactory::getCounters() const {
+  TperfServerCounters counters;
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (const auto& stats : stats_) {
+    counters += stats.second->getCounters();
+  }
+  return counters;
+}
+
+PipelineStageHistograms TperfServerStatsFactory::getPipelineStageHistograms()
+    const {
+  std::vector<folly::EventBase*> evbs;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (const auto& stats : stats_) {
+      evbs.push_back(stats.first);
+    }
+  }
+  PipelineStageHistograms merged;
+  for (auto evb : evbs) {
+    // The histograms are thread local to the worker.
+    evb->runInEventBaseThreadAndWait([&] {
+      const auto& histograms = quic::getPipelineStageHistograms();
+      for (auto stage : histograms.keys()) {
+        merged[stage].merge(histograms[stage]);
+      }
+    });
+  }
+  return merged;
+}
+
+void setAllocationCountingEnabled(bool enabled) noexcept {
+  allocationCountingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t getAllocationCount() noexcept {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+} // namespace tperf
+} // namespace quic
+
+void* operator new(size_t size) {
+  auto ptr = quic::tperf::countedAllocation(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return quic::tperf::countedAllocation(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return quic::tperf::countedAllocation(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t /*size*/) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/common/PipelineTiming.h>
+#include <quic/state/QuicTransportStatsCallback.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace quic {
+namespace tperf {
+
+/**
+ * What the server did, summed over its workers.
+ */
+struct TperfServerCounters {
+  uint64_t packetsReceived{0};
+  uint64_t bytesRead{0};
+  uint64_t packetsSent{0};
+  uint64_t bytesWritten{0};
+  uint64_t retransmissions{0};
+  uint64_t writeSyscalls{0};
+  // The messages and packets of the write syscalls, packets past one per
+  // message are GSO segments.
+  uint64_t syscallMessages{0};
+  uint64_t syscallPackets{0};
+
+  TperfServerCounters& operator+=(const TperfServerCounters& other);
+  TperfServerCounters operator-(const TperfServerCounters& other) const;
+};
+
+/**
+ * The stats callback of a worker, counting for the reports of the tperf
+ * server. Only the worker's evb writes the counters, the reports read them
+ * from their own thread.
+ */
+class TperfServerStats : public QuicTransportStatsCallback {
+ public:
+  ~TperfServerStats() override = default;
+
+  TperfServerCounters getCounters() const noexcept;
+
+  void onPacketReceived() override;
+  void onDuplicatedPacketReceived() override {}
+  void onOutOfOrderPacketReceived() override {}
+  void onPacketProcessed() override {}
+  void onPacketSent() override;
+  void onPacketRetransmission() override;
+  void onPacketDropped(PacketDropReason /*reason*/) override {}
+  void onPacketForwarded() override {}
+  void onForwardedPacketReceived() override {}
+  void onForwardedPacketProcessed() override {}
+  void onClientInitialReceived() override {}
+  void onNewConnection() override {}
+  void onConnectionClose(
+      folly::Optional<ConnectionCloseReason> /*reason*/) override {}
+  void onNewQuicStream() override {}
+  void onQuicStreamClosed() override {}
+  void onQuicStreamReset() override {}
+  void onConnFlowControlUpdate() override {}
+  void onConnFlowControlBlocked() override {}
+  void onStatelessReset() override {}
+  void onRetrySent() override {}
+  void onStreamFlowControlUpdate() override {}
+  void onStreamFlowControlBlocked() override {}
+  void onCwndBlocked() override {}
+  void onPTO() override {}
+  void onPTOProbe(PTOProbeType /*type*/) override {}
+  void onSpuriousPTO() override {}
+  void onRead(size_t bufSize) override;
+  void onWrite(size_t bufSize) override;
+  void onUDPSocketWriteError(SocketErrorType /*errorType*/) override {}
+  void onWriteBatch(size_t /*numPackets*/) override {}
+  void onWriteSyscall(size_t numMessages, size_t numPackets, size_t bytes)
+      override;
+  void onWriteFlush(WriteFlushReason /*reason*/) override {}
+  void onSpuriousLoss() override {}
+  void onStatsCounters(
+      const QuicTransportStatsCounters::Snapshot& delta) override;
+
+ private:
+  struct Counter {
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t amount) noexcept {
+      value.store(
+          value.load(std::memory_order_relaxed) + amount,
+          std::memory_order_relaxed);
+    }
+
+    uint64_t get() const noexcept {
+      return value.load(std::memory_order_relaxed);
+    }
+  };
+
+  Counter packetsReceived_;
+  Counter bytesRead_;
+  Counter packetsSent_;
+  Counter bytesWritten_;
+  Counter retransmissions_;
+  Counter writeSyscalls_;
+  Counter syscallMessages_;
+  Counter syscallPackets_;
+};
+
+/**
+ * Makes the stats of the workers and keeps track of them for the reports.
+ */
+class TperfServerStatsFactory : public QuicTransportStatsCallbackFactory {
+ public:
+  ~TperfServerStatsFactory() override = default;
+
+  std::unique_ptr<QuicTransportStatsCallback> make(
+      folly::EventBase* evb) override;
+
+  TperfServerCounters getCounters() const;
+
+  /**
+   * The cycles of the pipeline stages that ran on the workers, merged. Runs
+   * on each worker's evb, so it must not be called from one.
+   */
+  PipelineStageHistograms getPipelineStageHistograms() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<std::pair<folly::EventBase*, const TperfServerStats*>> stats_;
+};
+
+/**
+ * Counts the allocations of operator new while enabled, together with the
+ * replacements of the global operator new and delete of this binary. The
+ * buffers of IOBufs come from malloc and are not counted.
+ */
+void setAllocationCountingEnabled(bool enabled) noexcept;
+uint64_t getAllocationCount() noexcept;
+
+} // namespace tperf
+} // namespace quic
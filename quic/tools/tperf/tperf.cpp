@@ -10,23 +10,42 @@
 
 #include <fizz/crypto/Utils.h>
 #include <folly/init/Init.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/async/AsyncSignalHandler.h>
+#include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/HHWheelTimer.h>
 #include <folly/portability/GFlags.h>
 #include <folly/stats/Histogram.h>
 
 #include <quic/client/QuicClientTransport.h>
 #include <quic/client/handshake/FizzClientQuicHandshakeContext.h>
+#include <quic/client/handshake/QuicPskCache.h>
+#include <quic/common/LatencyHistogram.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/server/QuicServer.h>
 #include <quic/server/QuicServerTransport.h>
 #include <quic/server/QuicSharedUDPSocketFactory.h>
+#include <quic/state/QuicStreamUtilities.h>
 #include <quic/tools/tperf/PacingObserver.h>
 #include <quic/tools/tperf/TperfQLogger.h>
+#include <quic/tools/tperf/TperfServerStats.h>
+
+#include <sys/resource.h>
+
+#include <deque>
+#include <random>
+#include <thread>
 
 DEFINE_string(host, "::1", "TPerf server hostname/IP");
 DEFINE_int32(port, 6666, "TPerf server port");
-DEFINE_string(mode, "server", "Mode to run in: 'client' or 'server'");
+DEFINE_string(
+    mode,
+    "server",
+    "Mode to run in: 'client', 'server', 'load' or 'rpc'. 'load' runs many "
+    "client connections doing requests, 'rpc' measures the latency of the "
+    "requests of one connection, both against a server with "
+    "--num_streams=0");
 DEFINE_int32(duration, 10, "Duration of test in seconds");
 DEFINE_uint64(
     block_size,
@@ -66,10 +85,82 @@ DEFINE_uint32(
         quic::kDefaultV4UDPSendPacketLen,
         quic::kDefaultV6UDPSendPacketLen),
     "Maximum packet size to advertise to the peer.");
+DEFINE_uint32(connections, 1, "load: Number of concurrent connections");
+DEFINE_uint32(
+    client_threads,
+    1,
+    "load: Number of client threads the connections are spread over");
+DEFINE_uint64(
+    request_size,
+    64,
+    "load/rpc: Bytes sent by a request, at least 16");
+DEFINE_uint64(response_size, 4096, "load/rpc: Bytes sent back for a request");
+DEFINE_uint32(
+    requests_per_connection,
+    0,
+    "load: Requests after which a connection is closed and a new one is "
+    "opened. 0 (the default) keeps the connections for the whole test.");
+DEFINE_uint32(
+    zero_rtt_percent,
+    0,
+    "load: Percentage of the connections resumed with 0-RTT, the server must "
+    "run with --zero_rtt");
+DEFINE_uint32(rpc_streams, 1, "rpc: Number of streams to send requests on");
+DEFINE_uint32(
+    rpc_depth,
+    1,
+    "rpc: Number of requests outstanding at once on each stream");
+DEFINE_double(
+    rpc_rate,
+    0,
+    "rpc: Requests per second arriving as a Poisson process, queueing while "
+    "all the streams are at --rpc_depth. 0 (the default) is closed loop, each "
+    "response is followed by the next request on its stream.");
+DEFINE_uint32(
+    server_report_interval,
+    0,
+    "server: Seconds between the reports of the cost of what the server sent, "
+    "0 (the default) for only the report at the end, on SIGINT or SIGTERM");
+DEFINE_bool(
+    count_allocations,
+    false,
+    "server: Count the allocations of operator new for the reports");
+DEFINE_bool(
+    zero_rtt,
+    false,
+    "server: Accept the 0-RTT resumptions of the load mode");
 
 namespace quic {
 namespace tperf {
 
+const std::string kTPerfHostname = "tperf";
+const std::string kTPerfAlpn = "tperf";
+
+// A request on a bidirectional stream starts with its own size and the size
+// of the response, both big endian uint64, followed by padding.
+constexpr size_t kRequestHeaderSize = 2 * sizeof(uint64_t);
+
+Buf makeRequest(uint64_t requestSize, uint64_t responseSize) {
+  requestSize = std::max<uint64_t>(requestSize, kRequestHeaderSize);
+  auto request = folly::IOBuf::create(requestSize);
+  request->append(requestSize);
+  folly::io::RWPrivateCursor cursor(request.get());
+  cursor.writeBE<uint64_t>(requestSize);
+  cursor.writeBE<uint64_t>(responseSize);
+  return request;
+}
+
+void logLatencyPercentiles(
+    folly::StringPiece name,
+    const LatencyHistogram& histogram) {
+  LOG(INFO) << name
+            << " latency us: p50=" << histogram.getPercentile(0.5).count()
+            << " p90=" << histogram.getPercentile(0.9).count()
+            << " p99=" << histogram.getPercentile(0.99).count()
+            << " max=" << histogram.max().count() << " ("
+            << histogram.count() << " samples)";
+}
+
 class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
                             public quic::QuicSocket::ReadCallback,
                             public quic::QuicSocket::WriteCallback {
@@ -147,7 +238,53 @@ class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
   }
 
   void readAvailable(quic::StreamId id) noexcept override {
-    LOG(INFO) << "read available for stream id=" << id;
+    if (!isBidirectionalStream(id)) {
+      LOG(INFO) << "read available for stream id=" << id;
+      return;
+    }
+    // Requests of the load and rpc modes, each answered as soon as it is
+    // complete, and the fin with a fin.
+    auto readData = sock_->read(id, 0);
+    if (readData.hasError()) {
+      LOG(ERROR) << "Got error on read: " << quic::toString(readData.error());
+      requests_.erase(id);
+      return;
+    }
+    auto it = requests_.find(id);
+    if (it == requests_.end()) {
+      it = requests_
+               .emplace(
+                   id, folly::IOBufQueue(folly::IOBufQueue::cacheChainLength()))
+               .first;
+    }
+    auto& requests = it->second;
+    requests.append(std::move(readData->first));
+    while (requests.chainLength() >= kRequestHeaderSize) {
+      folly::io::Cursor cursor(requests.front());
+      auto requestSize =
+          std::max<uint64_t>(cursor.readBE<uint64_t>(), kRequestHeaderSize);
+      auto responseSize = cursor.readBE<uint64_t>();
+      if (requests.chainLength() < requestSize) {
+        break;
+      }
+      requests.trimStart(requestSize);
+      auto response = folly::IOBuf::create(responseSize);
+      response->append(responseSize);
+      auto res =
+          sock_->writeChain(id, std::move(response), false, false, nullptr);
+      if (res.hasError()) {
+        LOG(ERROR) << "Got error on write: " << quic::toString(res.error());
+      }
+    }
+    if (!readData->second) {
+      return;
+    }
+    requests_.erase(it);
+    auto res =
+        sock_->writeChain(id, folly::IOBuf::create(0), true, false, nullptr);
+    if (res.hasError()) {
+      LOG(ERROR) << "Got error on write: " << quic::toString(res.error());
+    }
   }
 
   void readError(
@@ -211,6 +348,7 @@ class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
   uint32_t numStreams_;
   uint64_t maxBytesPerStream_;
   std::unordered_map<quic::StreamId, uint64_t> bytesPerStream_;
+  std::unordered_map<quic::StreamId, folly::IOBufQueue> requests_;
 };
 
 class TPerfServerTransportFactory : public quic::QuicServerTransportFactory {
@@ -269,6 +407,23 @@ class TPerfServerTransportFactory : public quic::QuicServerTransportFactory {
   uint64_t maxBytesPerStream_;
 };
 
+/**
+ * Ends the server's loop on SIGINT and SIGTERM, for its final report.
+ */
+class TPerfServerSignalHandler : public folly::AsyncSignalHandler {
+ public:
+  explicit TPerfServerSignalHandler(folly::EventBase* evb)
+      : folly::AsyncSignalHandler(evb) {
+    registerSignalHandler(SIGINT);
+    registerSignalHandler(SIGTERM);
+  }
+
+  void signalReceived(int signum) noexcept override {
+    LOG(INFO) << "tperf server got signal " << signum << ", stopping";
+    getEventBase()->terminateLoopSoon();
+  }
+};
+
 class TPerfServer {
  public:
   explicit TPerfServer(
@@ -282,14 +437,29 @@ class TPerfServer {
       bool pacing,
       uint32_t numStreams,
       uint64_t maxBytesPerStream,
-      uint32_t maxReceivePacketSize)
+      uint32_t maxReceivePacketSize,
+      bool zeroRtt)
       : host_(host), port_(port), server_(QuicServer::createQuicServer()) {
     eventBase_.setName("tperf_server");
     server_->setQuicServerTransportFactory(
         std::make_unique<TPerfServerTransportFactory>(
             blockSize, numStreams, maxBytesPerStream));
+    auto statsFactory = std::make_unique<TperfServerStatsFactory>();
+    statsFactory_ = statsFactory.get();
+    server_->setTransportStatsCallbackFactory(std::move(statsFactory));
     auto serverCtx = quic::test::createServerCtx();
     serverCtx->setClock(std::make_shared<fizz::SystemClock>());
+    if (zeroRtt) {
+      // Accepts the resumption ticket the load clients make up, with the same
+      // alpn, version and secrets.
+      fizz::client::FizzClientContext clientCtx;
+      clientCtx.setSupportedAlpns({kTPerfAlpn});
+      serverCtx->setSupportedAlpns({kTPerfAlpn});
+      test::setupZeroRttOnServerCtx(
+          *serverCtx,
+          test::setupZeroRttOnClientCtx(
+              clientCtx, kTPerfHostname, QuicVersion::MVFST));
+    }
     server_->setFizzContext(serverCtx);
     quic::TransportSettings settings;
     settings.maxCwndInMss = maxCwndInMss;
@@ -308,20 +478,124 @@ class TPerfServer {
     server_->setTransportSettings(settings);
   }
 
-  void start() {
+  void start(
+      std::chrono::seconds reportInterval = std::chrono::seconds(0),
+      bool countAllocations = false) {
     // Create a SocketAddress and the default or passed in host.
     folly::SocketAddress addr1(host_.c_str(), port_);
     addr1.setFromHostPort(host_, port_);
     server_->start(addr1, 0);
     LOG(INFO) << "tperf server started at: " << addr1.describe();
+    countAllocations_ = countAllocations;
+    setAllocationCountingEnabled(countAllocations);
+    start_ = sample();
+    last_ = start_;
+    std::unique_ptr<folly::AsyncTimeout> reportTimeout;
+    if (reportInterval.count() > 0) {
+      reportTimeout = folly::AsyncTimeout::make(
+          eventBase_, [this, reportInterval, &reportTimeout]() noexcept {
+            auto now = sample();
+            report("Interval", last_, now, false);
+            last_ = now;
+            reportTimeout->scheduleTimeout(reportInterval);
+          });
+      reportTimeout->scheduleTimeout(reportInterval);
+    }
+    TPerfServerSignalHandler signalHandler(&eventBase_);
     eventBase_.loopForever();
+    reportTimeout.reset();
+    report("Total", start_, sample(), true);
+    server_->shutdown();
   }
 
  private:
+  struct CostSample {
+    TimePoint time;
+    std::chrono::microseconds userCpu;
+    std::chrono::microseconds systemCpu;
+    uint64_t allocations;
+    TperfServerCounters counters;
+  };
+
+  CostSample sample() const {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    auto toMicros = [](const struct timeval& tv) {
+      return std::chrono::seconds(tv.tv_sec) +
+          std::chrono::microseconds(tv.tv_usec);
+    };
+    return CostSample{Clock::now(),
+                      toMicros(usage.ru_utime),
+                      toMicros(usage.ru_stime),
+                      getAllocationCount(),
+                      statsFactory_->getCounters()};
+  }
+
+  // The cost of what was sent between the samples, the cpu time is the
+  // whole process's.
+  void report(
+      folly::StringPiece label,
+      const CostSample& from,
+      const CostSample& to,
+      bool withStages) const {
+    auto delta = to.counters - from.counters;
+    double seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(
+            to.time - from.time)
+            .count();
+    auto userCpu = (to.userCpu - from.userCpu).count();
+    auto systemCpu = (to.systemCpu - from.systemCpu).count();
+    auto cpuNs = 1000.0 * (userCpu + systemCpu);
+    double packets = std::max<uint64_t>(delta.packetsSent, 1);
+    double gigabytes =
+        std::max<uint64_t>(delta.bytesWritten, 1) / (1024.0 * 1024 * 1024);
+    LOG(INFO) << label << ": sent " << delta.packetsSent << " packets, "
+              << delta.bytesWritten << " bytes in " << seconds << "s, "
+              << delta.bytesWritten * 8 / std::max(seconds, 1e-9) / 1e9
+              << "Gb/s, " << delta.retransmissions << " retransmissions, "
+              << "received " << delta.packetsReceived << " packets";
+    LOG(INFO) << label << " CPU: user " << userCpu / 1000 << "ms, sys "
+              << systemCpu / 1000 << "ms, " << cpuNs / 1e6 / gigabytes
+              << "ms per GB sent, " << cpuNs / packets << "ns per packet";
+    LOG(INFO) << label << " syscalls: " << delta.writeSyscalls << " writes, "
+              << delta.writeSyscalls / packets << " per packet, "
+              << delta.syscallMessages << " messages, "
+              << delta.syscallPackets << " packets in them";
+    if (countAllocations_) {
+      auto allocations = to.allocations - from.allocations;
+      LOG(INFO) << label << " allocations: " << allocations << ", "
+                << allocations / packets << " per packet";
+    }
+    if (!withStages) {
+      return;
+    }
+    if (!kPipelineTimingEnabled) {
+      LOG(INFO) << "Build with MVFST_PIPELINE_TIMING for the pipeline stages";
+      return;
+    }
+    auto stages = statsFactory_->getPipelineStageHistograms();
+    LOG(INFO) << "Stage\tCount\tCycles/packet\tp50\tp99";
+    for (auto stage : stages.keys()) {
+      const auto& histogram = stages[stage];
+      if (histogram.count() == 0) {
+        continue;
+      }
+      LOG(INFO) << toString(stage) << "\t" << histogram.count()
+                << "\t" << histogram.sum().count() / packets << "\t"
+                << histogram.getPercentileValue(0.5) << "\t"
+                << histogram.getPercentileValue(0.99);
+    }
+  }
+
   std::string host_;
   uint16_t port_;
   folly::EventBase eventBase_;
   std::shared_ptr<quic::QuicServer> server_;
+  // Owned by the server
+  TperfServerStatsFactory* statsFactory_{nullptr};
+  bool countAllocations_{false};
+  CostSample start_;
+  CostSample last_;
 };
 
 class TPerfClient : public quic::QuicSocket::ConnectionCallback,
@@ -467,7 +741,7 @@ class TPerfClient : public quic::QuicSocket::ConnectionCallback,
             .build();
     quicClient_ = std::make_shared<quic::QuicClientTransport>(
         &eventBase_, std::move(sock), std::move(fizzClientContext));
-    quicClient_->setHostname("tperf");
+    quicClient_->setHostname(kTPerfHostname);
     quicClient_->addNewPeerAddress(addr);
     quicClient_->setCongestionControllerFactory(
         std::make_shared<DefaultCongestionControllerFactory>());
@@ -480,7 +754,8 @@ class TPerfClient : public quic::QuicSocket::ConnectionCallback,
     settings.connectUDP = true;
     settings.shouldRecvBatch = true;
     settings.defaultCongestionController = congestionControlType_;
-    if (congestionControlType_ == quic::CongestionControlType::BBR) {
+    if (congestionControlType_ == quic::CongestionControlType::BBR ||
+        congestionControlType_ == quic::CongestionControlType::BBR2) {
       settings.pacingEnabled = true;
       settings.pacingTimerTickInterval = 200us;
     }
@@ -518,6 +793,697 @@ class TPerfClient : public quic::QuicSocket::ConnectionCallback,
   uint32_t maxReceivePacketSize_;
 };
 
+struct LoadOptions {
+  std::string host;
+  uint16_t port;
+  std::chrono::milliseconds transportTimerResolution;
+  std::chrono::seconds duration;
+  uint32_t connections;
+  uint64_t requestSize;
+  uint64_t responseSize;
+  uint32_t requestsPerConnection;
+  uint32_t zeroRttPercent;
+  uint64_t window;
+  bool gso;
+  quic::CongestionControlType congestionControlType;
+  uint32_t maxReceivePacketSize;
+};
+
+struct LoadStats {
+  uint64_t connectionsStarted{0};
+  uint64_t zeroRttConnections{0};
+  uint64_t handshakes{0};
+  uint64_t connectionErrors{0};
+  uint64_t requests{0};
+  uint64_t receivedBytes{0};
+  // From start() to onReplaySafe, the whole handshake also when resumed.
+  LatencyHistogram handshakeLatency;
+  // From writing a request to the first and the last byte of its response.
+  LatencyHistogram ttfbLatency;
+  LatencyHistogram completionLatency;
+
+  void merge(const LoadStats& other) {
+    connectionsStarted += other.connectionsStarted;
+    zeroRttConnections += other.zeroRttConnections;
+    handshakes += other.handshakes;
+    connectionErrors += other.connectionErrors;
+    requests += other.requests;
+    receivedBytes += other.receivedBytes;
+    handshakeLatency.merge(other.handshakeLatency);
+    ttfbLatency.merge(other.ttfbLatency);
+    completionLatency.merge(other.completionLatency);
+  }
+};
+
+class LoadWorker;
+
+/**
+ * One connection slot of the load mode, doing one request at a time and
+ * opening a new connection after requestsPerConnection of them, or when the
+ * connection fails.
+ */
+class LoadConnection : public quic::QuicSocket::ConnectionCallback,
+                       public quic::QuicSocket::ReadCallback {
+ public:
+  LoadConnection(
+      LoadWorker& worker,
+      folly::EventBase& evb,
+      const LoadOptions& options,
+      LoadStats& stats,
+      uint32_t seed)
+      : worker_(worker),
+        evb_(evb),
+        options_(options),
+        stats_(stats),
+        random_(seed) {}
+
+  ~LoadConnection() override {
+    stop();
+  }
+
+  void start(
+      std::shared_ptr<FizzClientQuicHandshakeContext> handshakeContext,
+      const folly::Optional<QuicCachedPsk>& cachedPsk) {
+    auto sock = std::make_unique<folly::AsyncUDPSocket>(&evb_);
+    quicClient_ = std::make_shared<quic::QuicClientTransport>(
+        &evb_, std::move(sock), std::move(handshakeContext));
+    quicClient_->setHostname(kTPerfHostname);
+    quicClient_->addNewPeerAddress(
+        folly::SocketAddress(options_.host.c_str(), options_.port));
+    quicClient_->setCongestionControllerFactory(
+        std::make_shared<DefaultCongestionControllerFactory>());
+    auto pskCache = std::make_shared<BasicQuicPskCache>();
+    if (cachedPsk && random_() % 100 < options_.zeroRttPercent) {
+      pskCache->putPsk(kTPerfHostname, *cachedPsk);
+      stats_.zeroRttConnections++;
+    }
+    quicClient_->setPskCache(std::move(pskCache));
+    auto settings = quicClient_->getTransportSettings();
+    settings.advertisedInitialBidiLocalStreamWindowSize = options_.window;
+    settings.advertisedInitialConnectionWindowSize =
+        std::numeric_limits<uint32_t>::max();
+    settings.connectUDP = true;
+    settings.defaultCongestionController = options_.congestionControlType;
+    if (options_.congestionControlType == quic::CongestionControlType::BBR ||
+        options_.congestionControlType == quic::CongestionControlType::BBR2) {
+      settings.pacingEnabled = true;
+      settings.pacingTimerTickInterval = 200us;
+    }
+    if (options_.gso) {
+      settings.batchingMode = QuicBatchingMode::BATCHING_MODE_GSO;
+      settings.maxBatchSize = 16;
+    }
+    settings.maxRecvPacketSize = options_.maxReceivePacketSize;
+    settings.canIgnorePathMTU = true;
+    quicClient_->setTransportSettings(settings);
+    requestsDone_ = 0;
+    startTime_ = Clock::now();
+    stats_.connectionsStarted++;
+    quicClient_->start(this);
+  }
+
+  void stop() {
+    stopped_ = true;
+    if (quicClient_) {
+      quicClient_->closeNow(folly::none);
+      quicClient_.reset();
+    }
+  }
+
+  void onTransportReady() noexcept override {
+    sendRequest();
+  }
+
+  void onReplaySafe() noexcept override {
+    stats_.handshakes++;
+    stats_.handshakeLatency.addSample(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - startTime_));
+  }
+
+  void onNewBidirectionalStream(quic::StreamId /*id*/) noexcept override {}
+
+  void onNewUnidirectionalStream(quic::StreamId id) noexcept override {
+    VLOG(5) << "Server is not in the load mode, got stream=" << id;
+    quicClient_->setReadCallback(id, nullptr);
+  }
+
+  void onStopSending(
+      quic::StreamId /*id*/,
+      quic::ApplicationErrorCode /*error*/) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    reconnect();
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    VLOG(2) << "Load connection error: " << toString(error.first);
+    stats_.connectionErrors++;
+    reconnect();
+  }
+
+  void readAvailable(quic::StreamId streamId) noexcept override {
+    auto readData = quicClient_->read(streamId, 0);
+    if (readData.hasError()) {
+      LOG(ERROR) << "Load connection failed read from stream=" << streamId
+                 << ", error=" << (uint32_t)readData.error();
+      reconnect();
+      return;
+    }
+    auto now = Clock::now();
+    if (readData->first) {
+      auto readBytes = readData->first->computeChainDataLength();
+      stats_.receivedBytes += readBytes;
+      if (readBytes > 0 && !gotFirstByte_) {
+        gotFirstByte_ = true;
+        stats_.ttfbLatency.addSample(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                now - requestTime_));
+      }
+    }
+    if (!readData->second) {
+      return;
+    }
+    stats_.requests++;
+    stats_.completionLatency.addSample(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - requestTime_));
+    requestsDone_++;
+    if (options_.requestsPerConnection > 0 &&
+        requestsDone_ >= options_.requestsPerConnection) {
+      // close() drops the connection callback, no onConnectionEnd.
+      quicClient_->close(folly::none);
+      reconnect();
+      return;
+    }
+    sendRequest();
+  }
+
+  void readError(
+      quic::StreamId /*streamId*/,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    VLOG(2) << "Load connection read error: " << toString(error);
+    reconnect();
+  }
+
+ private:
+  void sendRequest() {
+    if (stopped_ || !quicClient_) {
+      return;
+    }
+    auto stream = quicClient_->createBidirectionalStream();
+    if (stream.hasError()) {
+      LOG(ERROR) << "Load connection failed to create a stream, error="
+                 << toString(stream.error());
+      reconnect();
+      return;
+    }
+    quicClient_->setReadCallback(*stream, this);
+    gotFirstByte_ = false;
+    requestTime_ = Clock::now();
+    auto res = quicClient_->writeChain(
+        *stream,
+        makeRequest(options_.requestSize, options_.responseSize),
+        true,
+        false,
+        nullptr);
+    if (res.hasError()) {
+      LOG(ERROR) << "Load connection failed to write, error="
+                 << toString(res.error());
+      reconnect();
+    }
+  }
+
+  void reconnect();
+
+  LoadWorker& worker_;
+  folly::EventBase& evb_;
+  const LoadOptions& options_;
+  LoadStats& stats_;
+  std::minstd_rand random_;
+  std::shared_ptr<quic::QuicClientTransport> quicClient_;
+  TimePoint startTime_;
+  TimePoint requestTime_;
+  uint32_t requestsDone_{0};
+  bool gotFirstByte_{false};
+  bool stopped_{false};
+};
+
+/**
+ * The connections of one client thread, all on the event base of the thread.
+ */
+class LoadWorker {
+ public:
+  LoadWorker(const LoadOptions& options, uint32_t numConnections, uint32_t id)
+      : options_(options), evb_(options.transportTimerResolution) {
+    evb_.setName(folly::to<std::string>("tperf_load", id));
+    auto clientCtx = std::make_shared<fizz::client::FizzClientContext>();
+    if (options_.zeroRttPercent > 0) {
+      clientCtx->setSupportedAlpns({kTPerfAlpn});
+      cachedPsk_ = test::setupZeroRttOnClientCtx(
+          *clientCtx, kTPerfHostname, QuicVersion::MVFST);
+    }
+    handshakeContext_ =
+        FizzClientQuicHandshakeContext::Builder()
+            .setFizzClientContext(std::move(clientCtx))
+            .setCertificateVerifier(test::createTestCertificateVerifier())
+            .build();
+    for (uint32_t i = 0; i < numConnections; ++i) {
+      connections_.push_back(std::make_unique<LoadConnection>(
+          *this, evb_, options_, stats_, id * numConnections + i));
+    }
+  }
+
+  void run() {
+    for (auto& connection : connections_) {
+      connection->start(handshakeContext_, cachedPsk_);
+    }
+    evb_.runAfterDelay(
+        [this] {
+          stopping_ = true;
+          for (auto& connection : connections_) {
+            connection->stop();
+          }
+          evb_.terminateLoopSoon();
+        },
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            options_.duration)
+            .count());
+    evb_.loopForever();
+  }
+
+  // Opens the next connection of the slot from the loop, not from within
+  // the callbacks of the connection it replaces.
+  void reconnect(LoadConnection* connection) {
+    evb_.runInLoop([this, connection] {
+      if (!stopping_) {
+        connection->start(handshakeContext_, cachedPsk_);
+      }
+    });
+  }
+
+  const LoadStats& getStats() const {
+    return stats_;
+  }
+
+ private:
+  const LoadOptions& options_;
+  folly::EventBase evb_;
+  std::shared_ptr<FizzClientQuicHandshakeContext> handshakeContext_;
+  folly::Optional<QuicCachedPsk> cachedPsk_;
+  LoadStats stats_;
+  std::vector<std::unique_ptr<LoadConnection>> connections_;
+  bool stopping_{false};
+};
+
+void LoadConnection::reconnect() {
+  if (stopped_ || !quicClient_) {
+    return;
+  }
+  // The transport may be the one calling back, keep it until the next loop.
+  evb_.runInLoop([transport = std::move(quicClient_)] {});
+  worker_.reconnect(this);
+}
+
+struct RpcOptions {
+  std::string host;
+  uint16_t port;
+  std::chrono::milliseconds transportTimerResolution;
+  std::chrono::seconds duration;
+  uint32_t numStreams;
+  uint32_t depth;
+  double rate;
+  uint64_t requestSize;
+  uint64_t responseSize;
+  uint64_t window;
+  bool gso;
+  quic::CongestionControlType congestionControlType;
+  uint32_t maxReceivePacketSize;
+};
+
+/**
+ * Requests and responses on the streams of one connection, pipelined up to
+ * depth on each stream. In the open loop the latencies are taken from the
+ * arrival of the requests, so that they include the wait for a stream.
+ */
+class TPerfRpcClient : public quic::QuicSocket::ConnectionCallback,
+                       public quic::QuicSocket::ReadCallback,
+                       public folly::AsyncTimeout {
+ public:
+  explicit TPerfRpcClient(RpcOptions options)
+      : options_(std::move(options)),
+        eventBase_(options_.transportTimerResolution),
+        interArrival_(options_.rate > 0 ? options_.rate : 1) {
+    eventBase_.setName("tperf_rpc");
+    attachEventBase(&eventBase_);
+    // A response ends with its last byte.
+    options_.responseSize = std::max<uint64_t>(options_.responseSize, 1);
+    options_.depth = std::max<uint32_t>(options_.depth, 1);
+    options_.numStreams = std::max<uint32_t>(options_.numStreams, 1);
+  }
+
+  ~TPerfRpcClient() override {
+    cancelTimeout();
+  }
+
+  void start() {
+    folly::SocketAddress addr(options_.host.c_str(), options_.port);
+    auto sock = std::make_unique<folly::AsyncUDPSocket>(&eventBase_);
+    auto fizzClientContext =
+        FizzClientQuicHandshakeContext::Builder()
+            .setCertificateVerifier(test::createTestCertificateVerifier())
+            .build();
+    quicClient_ = std::make_shared<quic::QuicClientTransport>(
+        &eventBase_, std::move(sock), std::move(fizzClientContext));
+    quicClient_->setHostname(kTPerfHostname);
+    quicClient_->addNewPeerAddress(addr);
+    quicClient_->setCongestionControllerFactory(
+        std::make_shared<DefaultCongestionControllerFactory>());
+    auto settings = quicClient_->getTransportSettings();
+    settings.advertisedInitialBidiLocalStreamWindowSize = options_.window;
+    settings.advertisedInitialConnectionWindowSize =
+        std::numeric_limits<uint32_t>::max();
+    settings.connectUDP = true;
+    settings.shouldRecvBatch = true;
+    settings.defaultCongestionController = options_.congestionControlType;
+    if (options_.congestionControlType == quic::CongestionControlType::BBR ||
+        options_.congestionControlType == quic::CongestionControlType::BBR2) {
+      settings.pacingEnabled = true;
+      settings.pacingTimerTickInterval = 200us;
+    }
+    if (options_.gso) {
+      settings.batchingMode = QuicBatchingMode::BATCHING_MODE_GSO;
+      settings.maxBatchSize = 16;
+    }
+    settings.maxRecvPacketSize = options_.maxReceivePacketSize;
+    settings.canIgnorePathMTU = true;
+    quicClient_->setTransportSettings(settings);
+
+    LOG(INFO) << "TPerfRpcClient connecting to " << addr.describe();
+    quicClient_->start(this);
+    eventBase_.loopForever();
+  }
+
+  void onTransportReady() noexcept override {
+    for (uint32_t i = 0; i < options_.numStreams; ++i) {
+      auto stream = quicClient_->createBidirectionalStream();
+      if (stream.hasError()) {
+        LOG(ERROR) << "TPerfRpcClient failed to create a stream, error="
+                   << toString(stream.error());
+        break;
+      }
+      quicClient_->setReadCallback(*stream, this);
+      streamIds_.push_back(*stream);
+      streams_.emplace(*stream, std::deque<OutstandingRequest>());
+    }
+    if (streamIds_.empty()) {
+      quicClient_->closeNow(folly::none);
+      eventBase_.terminateLoopSoon();
+      return;
+    }
+    startTime_ = Clock::now();
+    eventBase_.runAfterDelay(
+        [this] { finish(); },
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            options_.duration)
+            .count());
+    if (options_.rate > 0) {
+      nextArrival_ = startTime_ + nextInterArrival();
+      timeoutExpired();
+      return;
+    }
+    for (auto id : streamIds_) {
+      for (uint32_t i = 0; i < options_.depth; ++i) {
+        sendRequest(id, Clock::now());
+      }
+    }
+  }
+
+  // Next arrivals of the open loop.
+  void timeoutExpired() noexcept override {
+    auto now = Clock::now();
+    while (nextArrival_ <= now) {
+      pendingArrivals_.push_back(nextArrival_);
+      nextArrival_ += nextInterArrival();
+    }
+    maxPendingArrivals_ =
+        std::max<uint64_t>(maxPendingArrivals_, pendingArrivals_.size());
+    dispatchArrivals();
+    scheduleTimeoutHighRes(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            nextArrival_ - now));
+  }
+
+  void readAvailable(quic::StreamId streamId) noexcept override {
+    auto readData = quicClient_->read(streamId, 0);
+    if (readData.hasError()) {
+      LOG(ERROR) << "TPerfRpcClient failed read from stream=" << streamId
+                 << ", error=" << (uint32_t)readData.error();
+      finish();
+      return;
+    }
+    if (!readData->first) {
+      return;
+    }
+    auto now = Clock::now();
+    auto& outstanding = streams_[streamId];
+    auto readBytes = readData->first->computeChainDataLength();
+    receivedBytes_ += readBytes;
+    // The responses come back in the order of the requests on a stream.
+    while (readBytes > 0 && !outstanding.empty()) {
+      auto& request = outstanding.front();
+      if (!request.gotFirstByte) {
+        request.gotFirstByte = true;
+        ttfbLatency_.addSample(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                now - request.arrival));
+      }
+      auto consumed = std::min(readBytes, request.remaining);
+      request.remaining -= consumed;
+      readBytes -= consumed;
+      if (request.remaining > 0) {
+        break;
+      }
+      completionLatency_.addSample(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              now - request.arrival));
+      completedRequests_++;
+      outstanding.pop_front();
+      if (finished_) {
+        continue;
+      }
+      if (options_.rate > 0) {
+        dispatchArrivals();
+      } else {
+        sendRequest(streamId, now);
+      }
+    }
+  }
+
+  void readError(
+      quic::StreamId streamId,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    LOG(ERROR) << "TPerfRpcClient read error on stream=" << streamId
+               << " error=" << toString(error);
+  }
+
+  void onNewBidirectionalStream(quic::StreamId /*id*/) noexcept override {}
+
+  void onNewUnidirectionalStream(quic::StreamId id) noexcept override {
+    VLOG(5) << "Server is not in the rpc mode, got stream=" << id;
+  }
+
+  void onStopSending(
+      quic::StreamId /*id*/,
+      quic::ApplicationErrorCode /*error*/) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    LOG(INFO) << "TPerfRpcClient connection end";
+    finish();
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    LOG(ERROR) << "TPerfRpcClient error: " << toString(error.first);
+    finish();
+  }
+
+ private:
+  struct OutstandingRequest {
+    TimePoint arrival;
+    uint64_t remaining;
+    bool gotFirstByte{false};
+  };
+
+  std::chrono::nanoseconds nextInterArrival() {
+    return std::chrono::nanoseconds(
+        static_cast<uint64_t>(interArrival_(random_) * 1000000000));
+  }
+
+  // Sends the pending arrivals on the streams with room, round robin.
+  void dispatchArrivals() {
+    size_t fullStreams = 0;
+    while (!pendingArrivals_.empty() && fullStreams < streamIds_.size()) {
+      auto id = streamIds_[nextStream_];
+      nextStream_ = (nextStream_ + 1) % streamIds_.size();
+      if (streams_[id].size() >= options_.depth) {
+        fullStreams++;
+        continue;
+      }
+      fullStreams = 0;
+      sendRequest(id, pendingArrivals_.front());
+      pendingArrivals_.pop_front();
+    }
+  }
+
+  void sendRequest(quic::StreamId id, TimePoint arrival) {
+    streams_[id].push_back(OutstandingRequest{arrival, options_.responseSize});
+    sentRequests_++;
+    auto res = quicClient_->writeChain(
+        id,
+        makeRequest(options_.requestSize, options_.responseSize),
+        false,
+        false,
+        nullptr);
+    if (res.hasError()) {
+      LOG(ERROR) << "TPerfRpcClient write error with stream=" << id
+                 << " error=" << toString(res.error());
+      finish();
+    }
+  }
+
+  void finish() {
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    cancelTimeout();
+    if (!streamIds_.empty()) {
+      report(std::chrono::duration_cast<std::chrono::duration<double>>(
+                 Clock::now() - startTime_)
+                 .count());
+    }
+    quicClient_->closeNow(folly::none);
+    eventBase_.terminateLoopSoon();
+  }
+
+  void report(double seconds) {
+    constexpr double bytesPerMegabit = 131072;
+    LOG(INFO) << "Sent " << sentRequests_ << " requests, completed "
+              << completedRequests_ << " in " << seconds << " seconds, "
+              << completedRequests_ / seconds << " requests/s, "
+              << (receivedBytes_ / bytesPerMegabit) / seconds << "Mb/s";
+    if (options_.rate > 0) {
+      LOG(INFO) << "Offered " << options_.rate << " requests/s, at most "
+                << maxPendingArrivals_ << " waited for a stream";
+    }
+    logLatencyPercentiles("TTFB", ttfbLatency_);
+    logLatencyPercentiles("Completion", completionLatency_);
+    logLatencyDistribution("Completion", completionLatency_);
+  }
+
+  // In the percentile distribution format of HdrHistogram, one line per
+  // bucket with samples.
+  static void logLatencyDistribution(
+      folly::StringPiece name,
+      const LatencyHistogram& histogram) {
+    LOG(INFO) << name << " latency distribution";
+    LOG(INFO) << "Value(us)\tPercentile\tTotalCount";
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+      auto count = histogram.getBucketCount(i);
+      if (count == 0) {
+        continue;
+      }
+      seen += count;
+      LOG(INFO) << std::min<uint64_t>(
+                       LatencyHistogram::bucketUpperBound(i),
+                       histogram.max().count())
+                << "\t" << static_cast<double>(seen) / histogram.count()
+                << "\t" << seen;
+    }
+  }
+
+  RpcOptions options_;
+  folly::EventBase eventBase_;
+  std::shared_ptr<quic::QuicClientTransport> quicClient_;
+  std::vector<quic::StreamId> streamIds_;
+  std::unordered_map<quic::StreamId, std::deque<OutstandingRequest>>
+      streams_;
+  size_t nextStream_{0};
+  std::mt19937 random_;
+  std::exponential_distribution<double> interArrival_;
+  TimePoint startTime_;
+  TimePoint nextArrival_;
+  std::deque<TimePoint> pendingArrivals_;
+  uint64_t maxPendingArrivals_{0};
+  uint64_t sentRequests_{0};
+  uint64_t completedRequests_{0};
+  uint64_t receivedBytes_{0};
+  LatencyHistogram ttfbLatency_;
+  LatencyHistogram completionLatency_;
+  bool finished_{false};
+};
+
+class TPerfLoadClient {
+ public:
+  explicit TPerfLoadClient(LoadOptions options, uint32_t numThreads)
+      : options_(std::move(options)) {
+    numThreads = std::max<uint32_t>(
+        1, std::min<uint32_t>(numThreads, options_.connections));
+    for (uint32_t i = 0; i < numThreads; ++i) {
+      // The first threads take the remainder.
+      auto numConnections = options_.connections / numThreads +
+          (i < options_.connections % numThreads ? 1 : 0);
+      workers_.push_back(
+          std::make_unique<LoadWorker>(options_, numConnections, i));
+    }
+  }
+
+  void start() {
+    LOG(INFO) << "TPerfLoadClient running " << options_.connections
+              << " connections on " << workers_.size() << " threads for "
+              << options_.duration.count() << " seconds";
+    std::vector<std::thread> threads;
+    for (auto& worker : workers_) {
+      threads.emplace_back([&worker] { worker->run(); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    LoadStats stats;
+    for (const auto& worker : workers_) {
+      stats.merge(worker->getStats());
+    }
+    report(stats);
+  }
+
+ private:
+  void report(const LoadStats& stats) {
+    constexpr double bytesPerMegabit = 131072;
+    double seconds = options_.duration.count();
+    LOG(INFO) << "Received " << stats.receivedBytes << " bytes in "
+              << stats.requests << " responses";
+    LOG(INFO) << "Overall throughput: "
+              << (stats.receivedBytes / bytesPerMegabit) / seconds << "Mb/s, "
+              << stats.requests / seconds << " requests/s";
+    LOG(INFO) << "Connections: " << stats.connectionsStarted << " started, "
+              << stats.zeroRttConnections << " with 0-RTT, "
+              << stats.handshakes << " handshakes done ("
+              << stats.handshakes / seconds << "/s), "
+              << stats.connectionErrors << " errors";
+    logLatencyPercentiles("Handshake", stats.handshakeLatency);
+    logLatencyPercentiles("TTFB", stats.ttfbLatency);
+    logLatencyPercentiles("Completion", stats.completionLatency);
+  }
+
+  LoadOptions options_;
+  std::vector<std::unique_ptr<LoadWorker>> workers_;
+};
+
 } // namespace tperf
 } // namespace quic
 
@@ -531,6 +1497,8 @@ quic::CongestionControlType flagsToCongestionControlType(
     return quic::CongestionControlType::NewReno;
   } else if (congestionControlType == "bbr") {
     return quic::CongestionControlType::BBR;
+  } else if (congestionControlType == "bbr2") {
+    return quic::CongestionControlType::BBR2;
   } else if (congestionControlType == "copa") {
     return quic::CongestionControlType::Copa;
   } else if (congestionControlType == "none") {
@@ -562,8 +1530,11 @@ int main(int argc, char* argv[]) {
         FLAGS_pacing,
         FLAGS_num_streams,
         FLAGS_bytes_per_stream,
-        FLAGS_max_receive_packet_size);
-    server.start();
+        FLAGS_max_receive_packet_size,
+        FLAGS_zero_rtt);
+    server.start(
+        std::chrono::seconds(FLAGS_server_report_interval),
+        FLAGS_count_allocations);
   } else if (FLAGS_mode == "client") {
     if (FLAGS_num_streams != 1) {
       LOG(ERROR) << "num_streams option is server only";
@@ -583,6 +1554,44 @@ int main(int argc, char* argv[]) {
         flagsToCongestionControlType(FLAGS_congestion),
         FLAGS_max_receive_packet_size);
     client.start();
+  } else if (FLAGS_mode == "load") {
+    LoadOptions options;
+    options.host = FLAGS_host;
+    options.port = FLAGS_port;
+    options.transportTimerResolution =
+        std::chrono::milliseconds(FLAGS_client_transport_timer_resolution_ms);
+    options.duration = std::chrono::seconds(FLAGS_duration);
+    options.connections = FLAGS_connections;
+    options.requestSize = FLAGS_request_size;
+    options.responseSize = FLAGS_response_size;
+    options.requestsPerConnection = FLAGS_requests_per_connection;
+    options.zeroRttPercent = std::min<uint32_t>(FLAGS_zero_rtt_percent, 100);
+    options.window = FLAGS_window;
+    options.gso = FLAGS_gso;
+    options.congestionControlType =
+        flagsToCongestionControlType(FLAGS_congestion);
+    options.maxReceivePacketSize = FLAGS_max_receive_packet_size;
+    TPerfLoadClient client(std::move(options), FLAGS_client_threads);
+    client.start();
+  } else if (FLAGS_mode == "rpc") {
+    RpcOptions options;
+    options.host = FLAGS_host;
+    options.port = FLAGS_port;
+    options.transportTimerResolution =
+        std::chrono::milliseconds(FLAGS_client_transport_timer_resolution_ms);
+    options.duration = std::chrono::seconds(FLAGS_duration);
+    options.numStreams = FLAGS_rpc_streams;
+    options.depth = FLAGS_rpc_depth;
+    options.rate = FLAGS_rpc_rate;
+    options.requestSize = FLAGS_request_size;
+    options.responseSize = FLAGS_response_size;
+    options.window = FLAGS_window;
+    options.gso = FLAGS_gso;
+    options.congestionControlType =
+        flagsToCongestionControlType(FLAGS_congestion);
+    options.maxReceivePacketSize = FLAGS_max_receive_packet_size;
+    TPerfRpcClient client(std::move(options));
+    client.start();
   }
   return 0;
 }